@@ -29,6 +29,12 @@ extern "C" {
  */
 int InitVulkan(void);
 
+/* Point the entrypoints called with a VkDevice, its queues or its command buffers at the ones
+ * vkGetDeviceProcAddr returns for device, which skip the loader's dispatch. They then only work
+ * with device and its children, so this is for applications with a single device.
+ */
+void InitVulkanDevice(VkDevice device);
+
 // VK_core
 extern PFN_vkCreateInstance vkCreateInstance;
 extern PFN_vkDestroyInstance vkDestroyInstance;
@@ -24,12 +24,15 @@
 #include <linux/input.h>
 #endif
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <csignal>
 #include <memory>
+#include <vector>
 
 #if defined(VK_USE_PLATFORM_MIR_KHR)
 #warning "Cubepp does not have code for Mir at this time"
@@ -52,8 +55,10 @@
 #define APP_NAME_STR_LEN 80
 #endif
 
-// Allow a maximum of two outstanding presentation operations.
+// Allow a maximum of two outstanding presentation operations by default.
 #define FRAME_LAG 2
+// Upper limit for --frames_in_flight.
+#define MAX_FRAME_LAG 8
 
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
 
@@ -213,6 +218,8 @@ struct Demo {
     void build_image_ownership_cmd(uint32_t const &);
     vk::Bool32 check_layers(uint32_t, const char *const *, uint32_t, vk::LayerProperties *);
     void cleanup();
+    void collect_frame_stats();
+    void collect_present_timings();
     void create_device();
     void destroy_texture_image(texture_object *);
     void draw();
@@ -236,6 +243,7 @@ struct Demo {
     vk::ShaderModule prepare_shader_module(const void *, size_t);
     void prepare_texture_image(const char *, texture_object *, vk::ImageTiling, vk::ImageUsageFlags, vk::MemoryPropertyFlags);
     void prepare_textures();
+    void print_frame_stats();
     vk::ShaderModule prepare_vs();
     char *read_spv(const char *, size_t *);
     void resize();
@@ -305,9 +313,9 @@ struct Demo {
     vk::Queue present_queue;
     uint32_t graphics_queue_family_index;
     uint32_t present_queue_family_index;
-    vk::Semaphore image_acquired_semaphores[FRAME_LAG];
-    vk::Semaphore draw_complete_semaphores[FRAME_LAG];
-    vk::Semaphore image_ownership_semaphores[FRAME_LAG];
+    vk::Semaphore image_acquired_semaphores[MAX_FRAME_LAG];
+    vk::Semaphore draw_complete_semaphores[MAX_FRAME_LAG];
+    vk::Semaphore image_ownership_semaphores[MAX_FRAME_LAG];
     vk::PhysicalDeviceProperties gpu_props;
     std::unique_ptr<vk::QueueFamilyProperties[]> queue_props;
     vk::PhysicalDeviceMemoryProperties memory_properties;
@@ -326,8 +334,10 @@ struct Demo {
     vk::SwapchainKHR swapchain;
     std::unique_ptr<SwapchainImageResources[]> swapchain_image_resources;
     vk::PresentModeKHR presentMode;
-    vk::Fence fences[FRAME_LAG];
+    vk::Fence fences[MAX_FRAME_LAG];
     uint32_t frame_index;
+    uint32_t frame_lag;
+    uint32_t desired_image_count;
 
     vk::CommandPool cmd_pool;
     vk::CommandPool present_cmd_pool;
@@ -381,6 +391,22 @@ struct Demo {
     bool use_break;
     bool suppress_popups;
 
+    // Frame pacing statistics, collected with --stats and printed by cleanup().
+    // All samples are in milliseconds.
+    bool stats;
+    bool display_timing_enabled;
+    PFN_vkGetPastPresentationTimingGOOGLE fpGetPastPresentationTimingGOOGLE;
+    uint32_t next_present_id;
+    uint64_t present_submit_times[64];  // indexed by present ID modulo 64
+    std::chrono::steady_clock::time_point last_frame_time;
+    std::vector<double> cpu_frame_times;
+    std::vector<double> gpu_frame_times;
+    std::vector<double> present_latencies;
+    vk::QueryPool timestamp_pool;
+    double timestamp_period;  // nanoseconds per tick, 0 if timestamps are not supported
+    uint64_t timestamp_mask;
+    uint32_t frame_images[MAX_FRAME_LAG];  // swapchain image rendered by each frame in flight
+
     uint32_t current_buffer;
     uint32_t queue_family_count;
 };
@@ -538,6 +564,8 @@ Demo::Demo()
       height{0},
       swapchainImageCount{0},
       frame_index{0},
+      frame_lag{FRAME_LAG},
+      desired_image_count{3},
       spin_angle{0.0f},
       spin_increment{0.0f},
       pause{false},
@@ -547,6 +575,12 @@ Demo::Demo()
       validate{false},
       use_break{false},
       suppress_popups{false},
+      stats{false},
+      display_timing_enabled{false},
+      fpGetPastPresentationTimingGOOGLE{nullptr},
+      next_present_id{0},
+      timestamp_period{0.0},
+      timestamp_mask{0},
       current_buffer{0},
       queue_family_count{0} {
 #if defined(VK_USE_PLATFORM_WIN32_KHR)
@@ -555,6 +589,10 @@ Demo::Demo()
         memset(projection_matrix, 0, sizeof(projection_matrix));
         memset(view_matrix, 0, sizeof(view_matrix));
         memset(model_matrix, 0, sizeof(model_matrix));
+        memset(present_submit_times, 0, sizeof(present_submit_times));
+        for (uint32_t i = 0; i < MAX_FRAME_LAG; i++) {
+            frame_images[i] = UINT32_MAX;
+        }
     }
 
     void Demo::build_image_ownership_cmd(uint32_t const &i) {
@@ -603,8 +641,13 @@ Demo::Demo()
         prepared = false;
         device.waitIdle();
 
+        if (stats) {
+            collect_present_timings();
+            print_frame_stats();
+        }
+
         // Wait for fences from present operations
-        for (uint32_t i = 0; i < FRAME_LAG; i++) {
+        for (uint32_t i = 0; i < frame_lag; i++) {
             device.waitForFences(1, &fences[i], VK_TRUE, UINT64_MAX);
             device.destroyFence(fences[i], nullptr);
             device.destroySemaphore(image_acquired_semaphores[i], nullptr);
@@ -645,6 +688,7 @@ Demo::Demo()
         }
 
         device.destroyCommandPool(cmd_pool, nullptr);
+        device.destroyQueryPool(timestamp_pool, nullptr);
 
         if (separate_present_queue) {
             device.destroyCommandPool(present_cmd_pool, nullptr);
@@ -676,6 +720,56 @@ Demo::Demo()
         inst.destroy(nullptr);
     }
 
+    void Demo::collect_frame_stats() {
+        auto const now = std::chrono::steady_clock::now();
+        if (last_frame_time != std::chrono::steady_clock::time_point()) {
+            cpu_frame_times.push_back(std::chrono::duration<double, std::milli>(now - last_frame_time).count());
+        }
+        last_frame_time = now;
+
+        // The fence of this frame has signaled, so the timestamps its command
+        // buffer wrote are available unless a later frame has already reset
+        // them by rendering to the same image again.
+        uint32_t const image = frame_images[frame_index];
+        frame_images[frame_index] = UINT32_MAX;
+        if (!timestamp_pool || image == UINT32_MAX) {
+            return;
+        }
+
+        uint64_t ticks[2];
+        auto const result = device.getQueryPoolResults(timestamp_pool, 2 * image, 2, sizeof(ticks), ticks, sizeof(uint64_t),
+                                                       vk::QueryResultFlagBits::e64);
+        if (result == vk::Result::eSuccess) {
+            gpu_frame_times.push_back(((ticks[1] - ticks[0]) & timestamp_mask) * timestamp_period / 1e6);
+        }
+    }
+
+    void Demo::collect_present_timings() {
+        if (!display_timing_enabled) {
+            return;
+        }
+
+        vk::PastPresentationTimingGOOGLE timings[16];
+        uint32_t count;
+        do {
+            count = ARRAY_SIZE(timings);
+            auto const result = fpGetPastPresentationTimingGOOGLE(device, swapchain, &count,
+                                                                  reinterpret_cast<VkPastPresentationTimingGOOGLE *>(timings));
+            if (result != VK_SUCCESS && result != VK_INCOMPLETE) {
+                return;
+            }
+
+            // actualPresentTime uses the same clock as steady_clock on Linux
+            // (CLOCK_MONOTONIC), so it can be compared with the submit time.
+            for (uint32_t i = 0; i < count; i++) {
+                uint64_t const submitted = present_submit_times[timings[i].presentID % ARRAY_SIZE(present_submit_times)];
+                if (submitted != 0 && timings[i].actualPresentTime >= submitted) {
+                    present_latencies.push_back((timings[i].actualPresentTime - submitted) / 1e6);
+                }
+            }
+        } while (count == ARRAY_SIZE(timings));
+    }
+
     void Demo::create_device() {
         float const priorities[1] = {0.0};
 
@@ -711,10 +805,14 @@ Demo::Demo()
     }
 
     void Demo::draw() {
-        // Ensure no more than FRAME_LAG renderings are outstanding
+        // Ensure no more than frame_lag renderings are outstanding
         device.waitForFences(1, &fences[frame_index], VK_TRUE, UINT64_MAX);
         device.resetFences(1, &fences[frame_index]);
 
+        if (stats) {
+            collect_frame_stats();
+        }
+
         vk::Result result;
         do {
             result = device.acquireNextImageKHR(swapchain, UINT64_MAX, image_acquired_semaphores[frame_index],
@@ -731,6 +829,7 @@ Demo::Demo()
                 VERIFY(result == vk::Result::eSuccess);
             }
         } while (result != vk::Result::eSuccess);
+        frame_images[frame_index] = current_buffer;
 
         update_data_buffer();
 
@@ -771,7 +870,7 @@ Demo::Demo()
 
         // If we are using separate queues we have to wait for image ownership,
         // otherwise wait for draw complete
-        auto const presentInfo = vk::PresentInfoKHR()
+        auto presentInfo = vk::PresentInfoKHR()
                                      .setWaitSemaphoreCount(1)
                                      .setPWaitSemaphores(separate_present_queue ? &image_ownership_semaphores[frame_index]
                                                                                 : &draw_complete_semaphores[frame_index])
@@ -779,9 +878,23 @@ Demo::Demo()
                                      .setPSwapchains(&swapchain)
                                      .setPImageIndices(&current_buffer);
 
+        // Tag each present with an ID so that its timing can be matched with
+        // the time it was queued
+        auto const present_time = vk::PresentTimeGOOGLE().setPresentID(next_present_id);
+        auto const present_times_info = vk::PresentTimesInfoGOOGLE().setSwapchainCount(1).setPTimes(&present_time);
+        if (display_timing_enabled) {
+            presentInfo.setPNext(&present_times_info);
+            present_submit_times[next_present_id % ARRAY_SIZE(present_submit_times)] =
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            next_present_id++;
+        }
+
         result = present_queue.presentKHR(&presentInfo);
         frame_index += 1;
-        frame_index %= FRAME_LAG;
+        frame_index %= frame_lag;
+        if (display_timing_enabled) {
+            collect_present_timings();
+        }
         if (result == vk::Result::eErrorOutOfDateKHR) {
             // swapchain is out of date (e.g. the window was resized) and
             // must be recreated:
@@ -810,6 +923,11 @@ Demo::Demo()
         auto result = commandBuffer.begin(&commandInfo);
         VERIFY(result == vk::Result::eSuccess);
 
+        if (timestamp_pool) {
+            commandBuffer.resetQueryPool(timestamp_pool, 2 * current_buffer, 2);
+            commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, timestamp_pool, 2 * current_buffer);
+        }
+
         commandBuffer.beginRenderPass(&passInfo, vk::SubpassContents::eInline);
         commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
         commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout, 0, 1, &swapchain_image_resources[current_buffer].descriptor_set, 0, nullptr);
@@ -851,6 +969,10 @@ Demo::Demo()
                                           nullptr, 1, &image_ownership_barrier);
         }
 
+        if (timestamp_pool) {
+            commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, timestamp_pool, 2 * current_buffer + 1);
+        }
+
         result = commandBuffer.end();
         VERIFY(result == vk::Result::eSuccess);
     }
@@ -927,16 +1049,32 @@ Demo::Demo()
                 suppress_popups = true;
                 continue;
             }
+            if (strcmp(argv[i], "--image_count") == 0 && i < argc - 1 && sscanf(argv[i + 1], "%u", &desired_image_count) == 1 &&
+                desired_image_count > 0) {
+                i++;
+                continue;
+            }
+            if (strcmp(argv[i], "--frames_in_flight") == 0 && i < argc - 1 && sscanf(argv[i + 1], "%u", &frame_lag) == 1 &&
+                frame_lag > 0 && frame_lag <= MAX_FRAME_LAG) {
+                i++;
+                continue;
+            }
+            if (strcmp(argv[i], "--stats") == 0) {
+                stats = true;
+                continue;
+            }
 
             fprintf(stderr,
                     "Usage:\n  %s [--use_staging] [--validate] [--break] "
                     "[--c <framecount>] [--suppress_popups] [--present_mode <present mode enum>]\n"
+                    "       [--image_count <swapchain images>] [--frames_in_flight <1-%d>] [--stats]\n"
                     "VK_PRESENT_MODE_IMMEDIATE_KHR = %d\n"
                     "VK_PRESENT_MODE_MAILBOX_KHR = %d\n"
                     "VK_PRESENT_MODE_FIFO_KHR = %d\n"
-                    "VK_PRESENT_MODE_FIFO_RELAXED_KHR = %d\n",
-                    APP_SHORT_NAME, VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR,
-                    VK_PRESENT_MODE_FIFO_RELAXED_KHR);
+                    "VK_PRESENT_MODE_FIFO_RELAXED_KHR = %d\n"
+                    "--stats prints CPU and GPU frame time and present latency percentiles at exit.\n",
+                    APP_SHORT_NAME, MAX_FRAME_LAG, VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR,
+                    VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR);
             fflush(stderr);
             exit(1);
         }
@@ -1248,6 +1386,10 @@ Demo::Demo()
                     swapchainExtFound = 1;
                     extension_names[enabled_extension_count++] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
                 }
+                if (stats && !strcmp(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME, device_extensions[i].extensionName)) {
+                    display_timing_enabled = true;
+                    extension_names[enabled_extension_count++] = VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME;
+                }
                 assert(enabled_extension_count < 64);
             }
         }
@@ -1362,6 +1504,18 @@ Demo::Demo()
 
         create_device();
 
+        if (display_timing_enabled) {
+            fpGetPastPresentationTimingGOOGLE =
+                (PFN_vkGetPastPresentationTimingGOOGLE)device.getProcAddr("vkGetPastPresentationTimingGOOGLE");
+            display_timing_enabled = fpGetPastPresentationTimingGOOGLE != nullptr;
+        }
+
+        uint32_t const timestamp_bits = queue_props[graphics_queue_family_index].timestampValidBits;
+        if (stats && timestamp_bits > 0) {
+            timestamp_period = gpu_props.limits.timestampPeriod;
+            timestamp_mask = timestamp_bits >= 64 ? UINT64_MAX : (UINT64_C(1) << timestamp_bits) - 1;
+        }
+
         device.getQueue(graphics_queue_family_index, 0, &graphics_queue);
         if (!separate_present_queue) {
             present_queue = graphics_queue;
@@ -1399,7 +1553,7 @@ Demo::Demo()
         // Create fences that we can use to throttle if we get too far
         // ahead of the image presents
         auto const fence_ci = vk::FenceCreateInfo().setFlags(vk::FenceCreateFlagBits::eSignaled);
-        for (uint32_t i = 0; i < FRAME_LAG; i++) {
+        for (uint32_t i = 0; i < frame_lag; i++) {
             result = device.createFence(&fence_ci, nullptr, &fences[i]);
             VERIFY(result == vk::Result::eSuccess);
 
@@ -1439,6 +1593,19 @@ Demo::Demo()
         VERIFY(result == vk::Result::eSuccess);
 
         prepare_buffers();
+
+        if (timestamp_period > 0.0) {
+            // Two timestamps per swapchain image, written at the start and end
+            // of its command buffer
+            auto const query_pool_info =
+                vk::QueryPoolCreateInfo().setQueryType(vk::QueryType::eTimestamp).setQueryCount(2 * swapchainImageCount);
+            result = device.createQueryPool(&query_pool_info, nullptr, &timestamp_pool);
+            VERIFY(result == vk::Result::eSuccess);
+            for (uint32_t i = 0; i < MAX_FRAME_LAG; i++) {
+                frame_images[i] = UINT32_MAX;
+            }
+        }
+
         prepare_depth();
         prepare_textures();
         prepare_cube_data_buffers();
@@ -1575,8 +1742,8 @@ Demo::Demo()
 
         // Determine the number of VkImages to use in the swap chain.
         // Application desires to acquire 3 images at a time for triple
-        // buffering
-        uint32_t desiredNumOfSwapchainImages = 3;
+        // buffering unless --image_count says otherwise
+        uint32_t desiredNumOfSwapchainImages = desired_image_count;
         if (desiredNumOfSwapchainImages < surfCapabilities.minImageCount) {
             desiredNumOfSwapchainImages = surfCapabilities.minImageCount;
         }
@@ -2198,6 +2365,26 @@ Demo::Demo()
         return (char *)shader_code;
     }
 
+    void Demo::print_frame_stats() {
+        auto const print_percentiles = [](char const *name, std::vector<double> &samples) {
+            if (samples.empty()) {
+                printf("%-20s not available\n", name);
+                return;
+            }
+            std::sort(samples.begin(), samples.end());
+            auto const percentile = [&samples](double p) { return samples[(size_t)(p / 100.0 * (samples.size() - 1) + 0.5)]; };
+            printf("%-20s n=%zu min=%.3f p50=%.3f p90=%.3f p99=%.3f max=%.3f\n", name, samples.size(), samples.front(),
+                   percentile(50.0), percentile(90.0), percentile(99.0), samples.back());
+        };
+
+        printf("present mode %d, %u swapchain images, %u frames in flight, %u frames\n", (int)presentMode, swapchainImageCount,
+               frame_lag, curFrame);
+        print_percentiles("cpu frame time (ms)", cpu_frame_times);
+        print_percentiles("gpu frame time (ms)", gpu_frame_times);
+        print_percentiles("present latency (ms)", present_latencies);
+        fflush(stdout);
+    }
+
     void Demo::resize() {
         uint32_t i;
 
@@ -2246,6 +2433,8 @@ Demo::Demo()
         }
 
         device.destroyCommandPool(cmd_pool, nullptr);
+        device.destroyQueryPool(timestamp_pool, nullptr);
+        timestamp_pool = vk::QueryPool();
         if (separate_present_queue) {
             device.destroyCommandPool(present_cmd_pool, nullptr);
         }
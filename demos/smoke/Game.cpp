@@ -14,11 +14,64 @@
 * limitations under the License.
 */
 
+#include <algorithm>
 #include <sstream>
 
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
 #include "Game.h"
 #include "Shell.h"
 
+double Game::process_cpu_time() {
+#if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) / 1e7;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#endif
+}
+
+long long Game::peak_memory_kb() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize / 1024;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    // ru_maxrss is in bytes on macOS and in kilobytes elsewhere
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+void Game::count_frame(int draws) {
+    frame_count++;
+    draw_count += draws;
+
+    if (settings_.benchmark) {
+        auto now = std::chrono::steady_clock::now();
+        frame_times.push_back(std::chrono::duration<float, std::milli>(now - last_frame_time).count());
+        last_frame_time = now;
+    }
+}
+
 void Game::print_stats() {
     // Output frame count and measured elapsed time
     auto now = std::chrono::system_clock::now();
@@ -27,6 +80,24 @@ void Game::print_stats() {
     std::stringstream ss;
     ss << "frames:" << frame_count << ", elapsedms:" << elapsed_millis;
     shell_->log(Shell::LogPriority::LOG_INFO, ss.str().c_str());
+
+    if (!settings_.benchmark || frame_count == 0) return;
+
+    // One line of key:value pairs, so scripts can compare runs.  CPU time is
+    // summed over all threads, including the ones of the driver and layers.
+    const double cpu_ms = (process_cpu_time() - start_cpu_time) * 1000.0;
+    std::vector<float> sorted(frame_times);
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&sorted](float p) { return sorted[static_cast<size_t>(p * (sorted.size() - 1))]; };
+
+    std::stringstream bench;
+    bench << "benchmark objects:" << settings_.object_count << ", workers:" << settings_.worker_count
+          << ", seed:" << settings_.rng_seed << ", frames:" << frame_count << ", frame_ms_avg:"
+          << static_cast<double>(elapsed_millis) / frame_count << ", frame_ms_p50:" << percentile(0.5f)
+          << ", frame_ms_p99:" << percentile(0.99f) << ", frame_ms_max:" << sorted.back()
+          << ", cpu_ms_per_frame:" << cpu_ms / frame_count
+          << ", cpu_us_per_draw:" << (draw_count ? cpu_ms * 1000.0 / draw_count : 0.0) << ", peak_memory_kb:" << peak_memory_kb();
+    shell_->log(Shell::LogPriority::LOG_INFO, bench.str().c_str());
 }
 
 void Game::quit() {
@@ -51,6 +51,14 @@ class Game {
         bool flush_buffers;
 
         int max_frame_count;
+
+        // Benchmark mode: one simulation tick per frame, no vsync, and
+        // timing and memory stats printed at exit
+        bool benchmark;
+        int object_count;
+        int worker_count;  // -1 for one per core
+        int rng_seed;      // -1 for a random seed
+        std::vector<std::string> layers;
     };
     const Settings &settings() const { return settings_; }
 
@@ -82,6 +90,14 @@ class Game {
     int frame_count;
     std::chrono::time_point<std::chrono::system_clock> start_time;
 
+    // called once per frame by on_frame
+    void count_frame(int draws);
+
+    long long draw_count;
+    std::vector<float> frame_times;  // in milliseconds, benchmark mode only
+    std::chrono::time_point<std::chrono::steady_clock> last_frame_time;
+    double start_cpu_time;
+
     Game(const std::string &name, const std::vector<std::string> &args) : settings_(), shell_(nullptr) {
         settings_.name = name;
         settings_.initial_width = 1280;
@@ -103,17 +119,34 @@ class Game {
 
         settings_.max_frame_count = -1;
 
+        settings_.benchmark = false;
+        settings_.object_count = 5000;
+        settings_.worker_count = -1;
+        settings_.rng_seed = -1;
+
         parse_args(args);
 
+        if (settings_.benchmark) {
+            settings_.vsync = false;
+            if (settings_.max_frame_count == -1) settings_.max_frame_count = 1000;
+            if (settings_.rng_seed == -1) settings_.rng_seed = 0;
+        }
+
         frame_count = 0;
+        draw_count = 0;
         // Record start time for printing stats later
         start_time = std::chrono::system_clock::now();
+        last_frame_time = std::chrono::steady_clock::now();
+        start_cpu_time = process_cpu_time();
     }
 
     Settings settings_;
     Shell *shell_;
 
    private:
+    static double process_cpu_time();
+    static long long peak_memory_kb();
+
     void parse_args(const std::vector<std::string> &args) {
         for (auto it = args.begin(); it != args.end(); ++it) {
             if (*it == "--b") {
@@ -142,6 +175,20 @@ class Game {
             } else if (*it == "--c") {
                 ++it;
                 settings_.max_frame_count = std::stoi(*it);
+            } else if (*it == "--benchmark") {
+                settings_.benchmark = true;
+            } else if (*it == "--objects") {
+                ++it;
+                settings_.object_count = std::stoi(*it);
+            } else if (*it == "--workers") {
+                ++it;
+                settings_.worker_count = std::stoi(*it);
+            } else if (*it == "--seed") {
+                ++it;
+                settings_.rng_seed = std::stoi(*it);
+            } else if (*it == "--layer") {
+                ++it;
+                settings_.layers.push_back(*it);
             }
         }
     }
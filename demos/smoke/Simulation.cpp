@@ -14,12 +14,20 @@
  * limitations under the License.
  */
 
-#include <cassert>
+#include <algorithm>
 #include <cmath>
 #include <array>
 #include <glm/gtc/matrix_transform.hpp>
 #include "Simulation.h"
 
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMULATION_USE_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SIMULATION_USE_NEON 1
+#include <arm_neon.h>
+#endif
+
 namespace {
 
 class MeshPicker {
@@ -68,35 +76,65 @@ class ColorPicker {
     std::uniform_real_distribution<float> blue_;
 };
 
-}  // namespace
-
-Animation::Animation(unsigned int rng_seed, float scale) : rng_(rng_seed), dir_(-1.0f, 1.0f), speed_(0.1f, 1.0f) {
-    float x = dir_(rng_);
-    float y = dir_(rng_);
-    float z = dir_(rng_);
-    if (std::abs(x) + std::abs(y) + std::abs(z) == 0.0f) x = 1.0f;
-
-    current_.axis = glm::normalize(glm::vec3(x, y, z));
-
-    current_.speed = speed_(rng_);
-    current_.scale = scale;
-
-    current_.matrix = glm::scale(glm::mat4(1.0f), glm::vec3(current_.scale));
+// A float of each lane of a Simulation::Block
+#if defined(SIMULATION_USE_SSE2)
+typedef __m128 Lanes;
+inline Lanes load(const float *p) { return _mm_loadu_ps(p); }
+inline void store(float *p, Lanes v) { _mm_storeu_ps(p, v); }
+inline Lanes splat(float f) { return _mm_set1_ps(f); }
+inline Lanes add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+inline Lanes sub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+inline Lanes mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+#elif defined(SIMULATION_USE_NEON)
+typedef float32x4_t Lanes;
+inline Lanes load(const float *p) { return vld1q_f32(p); }
+inline void store(float *p, Lanes v) { vst1q_f32(p, v); }
+inline Lanes splat(float f) { return vdupq_n_f32(f); }
+inline Lanes add(Lanes a, Lanes b) { return vaddq_f32(a, b); }
+inline Lanes sub(Lanes a, Lanes b) { return vsubq_f32(a, b); }
+inline Lanes mul(Lanes a, Lanes b) { return vmulq_f32(a, b); }
+#else
+struct Lanes {
+    float v[Simulation::LANES];
+};
+inline Lanes load(const float *p) {
+    Lanes r;
+    for (int l = 0; l < Simulation::LANES; l++) r.v[l] = p[l];
+    return r;
 }
-
-glm::mat4 Animation::transformation(float t) {
-    current_.matrix = glm::rotate(current_.matrix, current_.speed * t, current_.axis);
-
-    return current_.matrix;
+inline void store(float *p, Lanes v) {
+    for (int l = 0; l < Simulation::LANES; l++) p[l] = v.v[l];
+}
+inline Lanes splat(float f) {
+    Lanes r;
+    for (int l = 0; l < Simulation::LANES; l++) r.v[l] = f;
+    return r;
+}
+inline Lanes add(Lanes a, Lanes b) {
+    for (int l = 0; l < Simulation::LANES; l++) a.v[l] += b.v[l];
+    return a;
+}
+inline Lanes sub(Lanes a, Lanes b) {
+    for (int l = 0; l < Simulation::LANES; l++) a.v[l] -= b.v[l];
+    return a;
+}
+inline Lanes mul(Lanes a, Lanes b) {
+    for (int l = 0; l < Simulation::LANES; l++) a.v[l] *= b.v[l];
+    return a;
+}
+#endif
+static_assert(sizeof(Lanes) == sizeof(float) * Simulation::LANES, "a vector holds a float of each lane");
+
+// Store lanes [first, end) of v, leaving the others to whichever thread owns them
+inline void store_lanes(float *p, Lanes v, int first, int end) {
+    if (first == 0 && end == Simulation::LANES) {
+        store(p, v);
+        return;
+    }
+    float lanes[Simulation::LANES];
+    store(lanes, v);
+    for (int l = first; l < end; l++) p[l] = lanes[l];
 }
-
-class Curve {
-   public:
-    virtual ~Curve() {}
-    virtual glm::vec3 evaluate(float t) = 0;
-};
-
-namespace {
 
 enum CurveType {
     CURVE_RANDOM,
@@ -104,171 +142,229 @@ enum CurveType {
     CURVE_COUNT,
 };
 
-class RandomCurve : public Curve {
-   public:
-    RandomCurve(unsigned int rng_seed)
-        : rng_(rng_seed),
-          direction_(-0.3f, 0.3f),
-          duration_(1.0f, 5.0f),
-          segment_start_(0.0f),
-          segment_direction_(0.0f),
-          time_start_(0.0f),
-          time_duration_(0.0f) {}
-
-    glm::vec3 evaluate(float t) {
-        if (t >= time_start_ + time_duration_) new_segment(t);
-
-        pos_ += unit_dir_ * (t - last_);
-        last_ = t;
-
-        return pos_;
+// Unit vectors a and b that span the plane of a circle around axis
+void circle_axes(glm::vec3 axis, glm::vec3 &a, glm::vec3 &b) {
+    glm::vec3 v;
+
+    if (axis.x != 0.0f) {
+        v.x = -axis.z / axis.x;
+        v.y = 0.0f;
+        v.z = 1.0f;
+    } else if (axis.y != 0.0f) {
+        v.x = 1.0f;
+        v.y = -axis.x / axis.y;
+        v.z = 0.0f;
+    } else {
+        v.x = 1.0f;
+        v.y = 0.0f;
+        v.z = -axis.x / axis.z;
     }
 
-   private:
-    void new_segment(float time_start) {
-        segment_start_ += segment_direction_;
-        segment_direction_ = glm::vec3(direction_(rng_), direction_(rng_), direction_(rng_));
+    a = glm::normalize(v);
+    b = glm::normalize(glm::cross(a, axis));
+}
 
-        time_start_ = time_start;
-        time_duration_ = duration_(rng_);
+// Each component drawn in turn, unlike the arguments of a constructor
+glm::vec3 random_vec3(std::minstd_rand &rng, std::uniform_real_distribution<float> &dist) {
+    glm::vec3 v;
+    v.x = dist(rng);
+    v.y = dist(rng);
+    v.z = dist(rng);
+    return v;
+}
 
-        unit_dir_ = segment_direction_ / time_duration_;
-        pos_ = segment_start_;
-        last_ = time_start_;
-    }
+}  // namespace
 
-    std::mt19937 rng_;
-    std::uniform_real_distribution<float> direction_;
-    std::uniform_real_distribution<float> duration_;
+Simulation::Simulation(int object_count, unsigned int rng_seed) : rng_(rng_seed) {
+    MeshPicker mesh;
+    ColorPicker color(rng_());
 
-    glm::vec3 segment_start_;
-    glm::vec3 segment_direction_;
-    float time_start_;
-    float time_duration_;
+    objects_.reserve(object_count);
+    paths_.resize(object_count);
+    blocks_.resize((object_count + LANES - 1) / LANES);
+    for (int i = 0; i < object_count; i++) {
+        Meshes::Type type = mesh.pick();
+        float scale = mesh.scale(type);
 
-    glm::vec3 unit_dir_;
-    glm::vec3 pos_;
-    float last_;
-};
+        objects_.emplace_back(Object{
+            type, glm::vec3(0.5f + 0.5f * (float)i / object_count), color.pick(), 0, glm::mat4(1.0f),
+        });
+        Object &obj = objects_.back();
 
-class CircleCurve : public Curve {
-   public:
-    CircleCurve(float radius, glm::vec3 axis) : r_(radius) {
-        glm::vec3 a;
-
-        if (axis.x != 0.0f) {
-            a.x = -axis.z / axis.x;
-            a.y = 0.0f;
-            a.z = 1.0f;
-        } else if (axis.y != 0.0f) {
-            a.x = 1.0f;
-            a.y = -axis.x / axis.y;
-            a.z = 0.0f;
-        } else {
-            a.x = 1.0f;
-            a.y = 0.0f;
-            a.z = -axis.x / axis.z;
-        }
+        Path &path = paths_[i];
+        path.rng.seed(rng_());
 
-        a_ = glm::normalize(a);
-        b_ = glm::normalize(glm::cross(a_, axis));
-    }
+        std::uniform_real_distribution<float> dir(-1.0f, 1.0f);
+        glm::vec3 axis = random_vec3(path.rng, dir);
+        if (std::abs(axis.x) + std::abs(axis.y) + std::abs(axis.z) == 0.0f) axis.x = 1.0f;
+        path.spin_axis = glm::normalize(axis);
+        std::uniform_real_distribution<float> speed(0.1f, 1.0f);
+        path.spin_speed = speed(path.rng);
 
-    glm::vec3 evaluate(float t) {
-        return (a_ * (glm::vec3(std::cos(t)) - glm::vec3(1.0f)) + b_ * glm::vec3(std::sin(t))) * glm::vec3(r_);
+        // the first update starts a subpath here
+        std::uniform_real_distribution<float> origin(0.0f, 2.0f);
+        path.type = CURVE_RANDOM;
+        path.origin = random_vec3(path.rng, origin);
+        path.velocity = glm::vec3(0.0f);
+        path.circle_a = glm::vec3(0.0f);
+        path.circle_b = glm::vec3(0.0f);
+        path.segment_start = 0.0f;
+        path.segment_end = 0.0f;
+        path.subpath_end = 0.0f;
+        path.now = 0.0f;
+        path.step = 0.0f;
+
+        Block &block = blocks_[i / LANES];
+        for (int k = 0; k < 9; k++) block.rotation[k][i % LANES] = (k % 4 == 0) ? scale : 0.0f;
+
+        // where the object stays when the simulation never ticks
+        for (int c = 0; c < 3; c++) obj.model[c][c] = scale;
+        obj.model[3] = glm::vec4(path.origin, 1.0f);
     }
-
-   private:
-    float r_;
-    glm::vec3 a_;
-    glm::vec3 b_;
-};
-
-}  // namespace
-
-Path::Path(unsigned int rng_seed) : rng_(rng_seed), type_(0, CURVE_COUNT - 1), duration_(5.0f, 20.0f) {
-    // trigger a subpath generation
-    current_.end = -1.0f;
-    current_.now = 0.0f;
 }
 
-glm::vec3 Path::position(float t) {
-    current_.now += t;
-
-    while (current_.now >= current_.end) generate_subpath();
-
-    return current_.origin + current_.curve->evaluate(current_.now - current_.start);
+void Simulation::set_frame_data_size(uint32_t size) {
+    uint32_t offset = 0;
+    for (auto &obj : objects_) {
+        obj.frame_data_offset = offset;
+        offset += size;
+    }
 }
 
-void Path::generate_subpath() {
-    float duration = duration_(rng_);
-    CurveType type = static_cast<CurveType>(type_(rng_));
+glm::vec3 Simulation::position(const Path &path, float t) const {
+    float angle = t - path.segment_start;
+    return path.origin + path.velocity * angle + path.circle_a * (std::cos(angle) - 1.0f) + path.circle_b * std::sin(angle);
+}
 
-    if (current_.curve) {
-        current_.origin += current_.curve->evaluate(current_.end - current_.start);
-        current_.origin = glm::mod(current_.origin, glm::vec3(2.0f));
-        current_.start = current_.end;
+void Simulation::next_segment(Path &path, float t) {
+    glm::vec3 pos = position(path, t);
+    if (t >= path.subpath_end) {
+        std::uniform_real_distribution<float> duration(5.0f, 20.0f);
+        std::uniform_int_distribution<> type(0, CURVE_COUNT - 1);
+        path.origin = glm::mod(pos, glm::vec3(2.0f));
+        path.subpath_end = t + duration(path.rng);
+        path.type = type(path.rng);
     } else {
-        std::uniform_real_distribution<float> origin(0.0f, 2.0f);
-        current_.origin = glm::vec3(origin(rng_), origin(rng_), origin(rng_));
-        current_.start = current_.now;
+        path.origin = pos;
     }
-
-    current_.end = current_.start + duration;
-
-    Curve *curve;
-
-    switch (type) {
-        case CURVE_RANDOM:
-            curve = new RandomCurve(rng_());
-            break;
-        case CURVE_CIRCLE: {
-            std::uniform_real_distribution<float> dir(-1.0f, 1.0f);
-            glm::vec3 axis(dir(rng_), dir(rng_), dir(rng_));
-            if (axis.x == 0.0f && axis.y == 0.0f && axis.z == 0.0f) axis.x = 1.0f;
-
-            std::uniform_real_distribution<float> radius_(0.02f, 0.2f);
-            curve = new CircleCurve(radius_(rng_), axis);
-        } break;
-        default:
-            assert(!"unreachable");
-            curve = nullptr;
-            break;
+    path.segment_start = t;
+
+    if (path.type == CURVE_RANDOM) {
+        // a straight segment, a few of which make up the subpath
+        std::uniform_real_distribution<float> direction(-0.3f, 0.3f);
+        std::uniform_real_distribution<float> duration(1.0f, 5.0f);
+        glm::vec3 dir = random_vec3(path.rng, direction);
+        float length = duration(path.rng);
+        path.velocity = dir / length;
+        path.circle_a = glm::vec3(0.0f);
+        path.circle_b = glm::vec3(0.0f);
+        path.segment_end = std::min(t + length, path.subpath_end);
+    } else {
+        std::uniform_real_distribution<float> dir(-1.0f, 1.0f);
+        glm::vec3 axis = random_vec3(path.rng, dir);
+        if (axis.x == 0.0f && axis.y == 0.0f && axis.z == 0.0f) axis.x = 1.0f;
+        std::uniform_real_distribution<float> radius(0.02f, 0.2f);
+        float r = radius(path.rng);
+
+        glm::vec3 a, b;
+        circle_axes(axis, a, b);
+        path.velocity = glm::vec3(0.0f);
+        path.circle_a = a * r;
+        path.circle_b = b * r;
+        path.segment_end = path.subpath_end;
     }
-
-    current_.curve.reset(curve);
 }
 
-Simulation::Simulation(int object_count) : random_dev_() {
-    MeshPicker mesh;
-    ColorPicker color(random_dev_());
-
-    objects_.reserve(object_count);
-    for (int i = 0; i < object_count; i++) {
-        Meshes::Type type = mesh.pick();
-        float scale = mesh.scale(type);
+bool Simulation::advance(int i, float time) {
+    Path &path = paths_[i];
+    bool changed = path.step != time;
+    path.now += time;
+    while (path.now >= path.segment_end) {
+        next_segment(path, path.segment_end);
+        changed = true;
+    }
+    path.step = time;
+    return changed;
+}
 
-        objects_.emplace_back(Object{
-            type, glm::vec3(0.5f + 0.5f * (float)i / object_count), color.pick(), Animation(random_dev_(), scale),
-            Path(random_dev_()),
-        });
+void Simulation::set_lanes(int i, float time) {
+    const Path &path = paths_[i];
+    Block &block = blocks_[i / LANES];
+    int l = i % LANES;
+
+    // where the object was a step ago, as if the segment had already started then
+    float angle = path.now - time - path.segment_start;
+    glm::vec3 base = path.origin + path.velocity * angle;
+    for (int k = 0; k < 3; k++) {
+        block.base[k][l] = base[k];
+        block.velocity[k][l] = path.velocity[k] * time;
+        block.circle_a[k][l] = path.circle_a[k];
+        block.circle_b[k][l] = path.circle_b[k];
+    }
+    block.cos[l] = std::cos(angle);
+    block.sin[l] = std::sin(angle);
+    block.cos_step[l] = std::cos(time);
+    block.sin_step[l] = std::sin(time);
+
+    glm::mat4 step = glm::rotate(glm::mat4(1.0f), path.spin_speed * time, path.spin_axis);
+    for (int c = 0; c < 3; c++) {
+        for (int r = 0; r < 3; r++) block.rotation_step[c * 3 + r][l] = step[c][r];
     }
 }
 
-void Simulation::set_frame_data_size(uint32_t size) {
-    uint32_t offset = 0;
-    for (auto &obj : objects_) {
-        obj.frame_data_offset = offset;
-        offset += size;
+void Simulation::step_block(int index, int first, int end) {
+    Block &block = blocks_[index];
+
+    Lanes cos = load(block.cos);
+    Lanes sin = load(block.sin);
+    Lanes cos_step = load(block.cos_step);
+    Lanes sin_step = load(block.sin_step);
+    Lanes next_cos = sub(mul(cos, cos_step), mul(sin, sin_step));
+    Lanes next_sin = add(mul(sin, cos_step), mul(cos, sin_step));
+    Lanes cos_minus_one = sub(next_cos, splat(1.0f));
+
+    float pos[3][LANES];
+    for (int k = 0; k < 3; k++) {
+        Lanes base = add(load(block.base[k]), load(block.velocity[k]));
+        Lanes circle = add(mul(load(block.circle_a[k]), cos_minus_one), mul(load(block.circle_b[k]), next_sin));
+        store(pos[k], add(base, circle));
+        store_lanes(block.base[k], base, first, end);
+    }
+    store_lanes(block.cos, next_cos, first, end);
+    store_lanes(block.sin, next_sin, first, end);
+
+    // rotation * rotation_step, column by column
+    Lanes rotation[9];
+    for (int k = 0; k < 9; k++) rotation[k] = load(block.rotation[k]);
+    float model[9][LANES];
+    for (int c = 0; c < 3; c++) {
+        Lanes step0 = load(block.rotation_step[c * 3 + 0]);
+        Lanes step1 = load(block.rotation_step[c * 3 + 1]);
+        Lanes step2 = load(block.rotation_step[c * 3 + 2]);
+        for (int r = 0; r < 3; r++) {
+            Lanes v = add(add(mul(rotation[r], step0), mul(rotation[3 + r], step1)), mul(rotation[6 + r], step2));
+            store(model[c * 3 + r], v);
+            store_lanes(block.rotation[c * 3 + r], v, first, end);
+        }
+    }
+
+    for (int l = first; l < end; l++) {
+        glm::mat4 &m = objects_[index * LANES + l].model;
+        for (int c = 0; c < 3; c++) m[c] = glm::vec4(model[c * 3 + 0][l], model[c * 3 + 1][l], model[c * 3 + 2][l], 0.0f);
+        m[3] = glm::vec4(pos[0][l], pos[1][l], pos[2][l], 1.0f);
     }
 }
 
 void Simulation::update(float time, int begin, int end) {
+    // changes of course, one object at a time
     for (int i = begin; i < end; i++) {
-        auto &obj = objects_[i];
+        if (advance(i, time)) set_lanes(i, time);
+    }
 
-        glm::vec3 pos = obj.path.position(time);
-        glm::mat4 trans = obj.animation.transformation(time);
-        obj.model = glm::translate(glm::mat4(1.0f), pos) * trans;
+    for (int first = begin; first < end;) {
+        int index = first / LANES;
+        int last = std::min(end, (index + 1) * LANES);
+        step_block(index, first - index * LANES, last - index * LANES);
+        first = last;
     }
 }
@@ -17,7 +17,6 @@
 #ifndef SIMULATION_H
 #define SIMULATION_H
 
-#include <memory>
 #include <random>
 #include <vector>
 
@@ -25,67 +24,20 @@
 
 #include "Meshes.h"
 
-class Animation {
-   public:
-    Animation(unsigned rng_seed, float scale);
-
-    glm::mat4 transformation(float t);
-
-   private:
-    struct Data {
-        glm::vec3 axis;
-        float speed;
-        float scale;
-
-        glm::mat4 matrix;
-    };
-
-    std::mt19937 rng_;
-    std::uniform_real_distribution<float> dir_;
-    std::uniform_real_distribution<float> speed_;
-
-    Data current_;
-};
-
-class Curve;
-
-class Path {
-   public:
-    Path(unsigned rng_seed);
-
-    glm::vec3 position(float t);
-
-   private:
-    struct Subpath {
-        glm::vec3 origin;
-        float start;
-        float end;
-        float now;
-
-        std::shared_ptr<Curve> curve;
-    };
-
-    void generate_subpath();
-
-    std::mt19937 rng_;
-    std::uniform_int_distribution<> type_;
-    std::uniform_real_distribution<float> duration_;
-
-    Subpath current_;
-};
-
+// Moves and spins objects along random paths. The state that changes every tick is kept as a
+// structure of arrays in blocks of LANES objects and stepped with SIMD, so that at high object
+// counts the demo stays bound by Vulkan and the layers rather than by the simulation. A path
+// changes course only every few seconds, which is done one object at a time.
 class Simulation {
    public:
-    Simulation(int object_count);
+    // objects are generated from rng_seed, so equal seeds give equal simulations
+    Simulation(int object_count, unsigned int rng_seed);
 
     struct Object {
         Meshes::Type mesh;
         glm::vec3 light_pos;
         glm::vec3 light_color;
 
-        Animation animation;
-        Path path;
-
         uint32_t frame_data_offset;
 
         glm::mat4 model;
@@ -93,14 +45,60 @@ class Simulation {
 
     const std::vector<Object> &objects() const { return objects_; }
 
-    unsigned int rng_seed() { return random_dev_(); }
-
     void set_frame_data_size(uint32_t size);
+    // Objects in ranges that don't overlap may be updated on different threads. Ranges that start
+    // at a multiple of LANES are faster.
     void update(float time, int begin, int end);
 
+    static const int LANES = 4;
+
    private:
-    std::random_device random_dev_;
+    // What changes every tick. The position is base + a * (cos - 1) + b * sin, where base moves by
+    // velocity and (cos, sin) turns by (cos_step, sin_step) each tick. The model matrix without its
+    // translation is multiplied by rotation_step each tick.
+    struct Block {
+        float base[3][LANES];
+        float velocity[3][LANES];
+        float circle_a[3][LANES];
+        float circle_b[3][LANES];
+        float cos[LANES];
+        float sin[LANES];
+        float cos_step[LANES];
+        float sin_step[LANES];
+        float rotation[9][LANES];  // column major
+        float rotation_step[9][LANES];
+    };
+
+    // The current segment of an object's path, a line or a circle, and what its Block lanes were
+    // set up from
+    struct Path {
+        std::minstd_rand rng;
+        glm::vec3 spin_axis;
+        float spin_speed;
+
+        int type;
+        glm::vec3 origin;
+        glm::vec3 velocity;
+        glm::vec3 circle_a;
+        glm::vec3 circle_b;
+        float segment_start;
+        float segment_end;
+        float subpath_end;
+
+        float now;
+        float step;  // time the lanes step by, 0 before the first update
+    };
+
+    glm::vec3 position(const Path &path, float t) const;
+    void next_segment(Path &path, float t);
+    bool advance(int i, float time);
+    void set_lanes(int i, float time);
+    void step_block(int block, int first_lane, int end_lane);
+
+    std::mt19937 rng_;
     std::vector<Object> objects_;
+    std::vector<Path> paths_;
+    std::vector<Block> blocks_;
 };
 
 #endif  // SIMULATION_H
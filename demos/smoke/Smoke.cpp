@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <array>
 
 #include <glm/gtc/type_ptr.hpp>
@@ -42,7 +43,8 @@ Smoke::Smoke(const std::vector<std::string> &args)
       multithread_(true),
       use_push_constants_(false),
       sim_paused_(false),
-      sim_(5000),
+      sim_(settings_.object_count,
+           settings_.rng_seed >= 0 ? static_cast<unsigned int>(settings_.rng_seed) : std::random_device()()),
       camera_(2.5f),
       frame_data_(),
       render_pass_clear_value_({{{0.0f, 0.1f, 0.2f, 1.0f}}}),
@@ -62,30 +64,40 @@ Smoke::Smoke(const std::vector<std::string> &args)
 Smoke::~Smoke() {}
 
 void Smoke::init_workers() {
-    int worker_count = std::thread::hardware_concurrency();
+    int worker_count = settings_.worker_count > 0 ? settings_.worker_count : std::thread::hardware_concurrency();
 
     // not enough cores
     if (!multithread_ || worker_count < 2) {
         multithread_ = false;
         worker_count = 1;
     }
+    settings_.worker_count = worker_count;
 
-    const int object_per_worker = static_cast<int>(sim_.objects().size()) / worker_count;
-    int object_begin = 0, object_end = 0;
+    // several chunks per worker to even out the load, but not so small
+    // that claiming them costs more than the work, and whole blocks of
+    // simulation lanes so no two workers step the same block
+    object_chunk_size_ = std::max(static_cast<int>(sim_.objects().size()) / (worker_count * 8), 16);
+    object_chunk_size_ = (object_chunk_size_ + Simulation::LANES - 1) / Simulation::LANES * Simulation::LANES;
+    next_sim_object_ = 0;
+    next_draw_object_ = 0;
 
     workers_.reserve(worker_count);
     for (int i = 0; i < worker_count; i++) {
-        object_begin = object_end;
-        if (i < worker_count - 1)
-            object_end += object_per_worker;
-        else
-            object_end = static_cast<int>(sim_.objects().size());
-
-        Worker *worker = new Worker(*this, i, object_begin, object_end);
+        Worker *worker = new Worker(*this, i);
         workers_.emplace_back(std::unique_ptr<Worker>(worker));
     }
 }
 
+bool Smoke::claim_objects(std::atomic<int> &next, int &begin, int &end) const {
+    const int object_count = static_cast<int>(sim_.objects().size());
+
+    begin = next.fetch_add(object_chunk_size_, std::memory_order_relaxed);
+    if (begin >= object_count) return false;
+
+    end = std::min(begin + object_chunk_size_, object_count);
+    return true;
+}
+
 void Smoke::attach_shell(Shell &sh) {
     Game::attach_shell(sh);
 
@@ -637,7 +649,8 @@ void Smoke::draw_object(const Simulation::Object &obj, FrameData &data, VkComman
 }
 
 void Smoke::update_simulation(const Worker &worker) {
-    sim_.update(worker.tick_interval_, worker.object_begin_, worker.object_end_);
+    int begin, end;
+    while (claim_objects(next_sim_object_, begin, end)) sim_.update(worker.tick_interval_, begin, end);
 }
 
 void Smoke::draw_objects(Worker &worker) {
@@ -663,10 +676,13 @@ void Smoke::draw_objects(Worker &worker) {
 
     meshes_->cmd_bind_buffers(cmd);
 
-    for (int i = worker.object_begin_; i < worker.object_end_; i++) {
-        auto &obj = sim_.objects()[i];
+    int begin, end;
+    while (claim_objects(next_draw_object_, begin, end)) {
+        for (int i = begin; i < end; i++) {
+            auto &obj = sim_.objects()[i];
 
-        draw_object(obj, data, cmd);
+            draw_object(obj, data, cmd);
+        }
     }
 
     vk::EndCommandBuffer(cmd);
@@ -697,11 +713,15 @@ void Smoke::on_key(Key key) {
 void Smoke::on_tick() {
     if (sim_paused_) return;
 
+    // all workers must be done with the last tick before the counter is reset
+    for (auto &worker : workers_) worker->wait_idle();
+    next_sim_object_ = 0;
+
     for (auto &worker : workers_) worker->update_simulation();
 }
 
 void Smoke::on_frame(float frame_pred) {
-    frame_count++;
+    count_frame(static_cast<int>(sim_.objects().size()));
 
     // Limit number of frames if argument was specified
     if (settings_.max_frame_count != -1 && frame_count == settings_.max_frame_count) {
@@ -717,6 +737,11 @@ void Smoke::on_frame(float frame_pred) {
 
     const Shell::BackBuffer &back = shell_->context().acquired_back_buffer;
 
+    // any worker may draw any object, so the whole simulation step must
+    // finish before drawing starts
+    for (auto &worker : workers_) worker->wait_idle();
+    next_draw_object_ = 0;
+
     // ignore frame_pred
     for (auto &worker : workers_) worker->draw_objects(framebuffers_[back.image_index]);
 
@@ -772,11 +797,9 @@ void Smoke::on_frame(float frame_pred) {
     (void)res;
 }
 
-Smoke::Worker::Worker(Smoke &smoke, int index, int object_begin, int object_end)
+Smoke::Worker::Worker(Smoke &smoke, int index)
     : smoke_(smoke),
       index_(index),
-      object_begin_(object_begin),
-      object_end_(object_end),
       tick_interval_(1.0f / smoke.settings_.ticks_per_second),
       state_(INIT) {}
 
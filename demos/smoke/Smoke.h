@@ -17,6 +17,7 @@
 #ifndef SMOKE_H
 #define SMOKE_H
 
+#include <atomic>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
@@ -51,7 +52,7 @@ class Smoke : public Game {
    private:
     class Worker {
        public:
-        Worker(Smoke &smoke, int index, int object_begin, int object_end);
+        Worker(Smoke &smoke, int index);
 
         void start();
         void stop();
@@ -62,8 +63,6 @@ class Smoke : public Game {
         Smoke &smoke_;
 
         const int index_;
-        const int object_begin_;
-        const int object_end_;
 
         const float tick_interval_;
 
@@ -121,6 +120,14 @@ class Smoke : public Game {
 
     std::vector<std::unique_ptr<Worker>> workers_;
 
+    // Workers don't own fixed object ranges.  They claim chunks of
+    // object_chunk_size_ objects from these counters until all objects are
+    // taken, so a slow worker doesn't hold up the frame.
+    int object_chunk_size_;
+    std::atomic<int> next_sim_object_;
+    std::atomic<int> next_draw_object_;
+    bool claim_objects(std::atomic<int> &next, int &begin, int &end) const;
+
     // called by attach_shell
     void create_render_pass();
     void create_shader_modules();
@@ -40,6 +40,8 @@
 #ifdef _WIN32
 #include <fcntl.h>
 #include <io.h>
+#else
+#include <pthread.h>
 #endif  // _WIN32
 
 #if defined(VK_USE_PLATFORM_XLIB_KHR) || defined(VK_USE_PLATFORM_XCB_KHR)
@@ -474,13 +476,14 @@ static bool CheckExtensionEnabled(const char *extension_to_check, const char **e
 }
 
 static void AppDevInitFormats(struct AppDev *dev) {
+    const bool props2 = CheckExtensionEnabled(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME,
+                                              dev->gpu->inst->inst_extensions, dev->gpu->inst->inst_extensions_count);
     VkFormat f;
     for (f = 0; f < VK_FORMAT_RANGE_SIZE; f++) {
         const VkFormat fmt = f;
         vkGetPhysicalDeviceFormatProperties(dev->gpu->obj, fmt, &dev->format_props[f]);
 
-        if (CheckExtensionEnabled(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME, dev->gpu->inst->inst_extensions,
-                                  dev->gpu->inst->inst_extensions_count)) {
+        if (props2) {
             dev->format_props2[f].sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_2_KHR;
             dev->format_props2[f].pNext = NULL;
             dev->gpu->inst->vkGetPhysicalDeviceFormatProperties2KHR(dev->gpu->obj, fmt, &dev->format_props2[f]);
@@ -814,6 +817,72 @@ static void AppGpuInit(struct AppGpu *gpu, struct AppInstance *inst, uint32_t id
     AppDevInitFormats(&gpu->dev);
 }
 
+struct AppGpuInitArgs {
+    struct AppGpu *gpu;
+    struct AppInstance *inst;
+    uint32_t id;
+    VkPhysicalDevice obj;
+};
+
+#ifdef _WIN32
+static DWORD WINAPI AppGpuInitThread(LPVOID arg) {
+    struct AppGpuInitArgs *args = arg;
+    AppGpuInit(args->gpu, args->inst, args->id, args->obj);
+    return 0;
+}
+#else
+static void *AppGpuInitThread(void *arg) {
+    struct AppGpuInitArgs *args = arg;
+    AppGpuInit(args->gpu, args->inst, args->id, args->obj);
+    return NULL;
+}
+#endif
+
+// Initializes every GPU on its own thread.  The queries of different physical
+// devices are independent, and querying the properties of every format takes
+// most of the time on systems with several GPUs.  A GPU is initialized on the
+// calling thread if its thread cannot be created.
+static void AppGpuInitAll(struct AppGpu *gpus, struct AppInstance *inst, const VkPhysicalDevice *objs, uint32_t gpu_count) {
+    struct AppGpuInitArgs *args = malloc(sizeof(args[0]) * gpu_count);
+    bool *threaded = malloc(sizeof(threaded[0]) * gpu_count);
+#ifdef _WIN32
+    HANDLE *threads = malloc(sizeof(threads[0]) * gpu_count);
+#else
+    pthread_t *threads = malloc(sizeof(threads[0]) * gpu_count);
+#endif
+    if (!args || !threaded || !threads) ERR_EXIT(VK_ERROR_OUT_OF_HOST_MEMORY);
+
+    for (uint32_t i = 0; i < gpu_count; i++) {
+        args[i].gpu = &gpus[i];
+        args[i].inst = inst;
+        args[i].id = i;
+        args[i].obj = objs[i];
+#ifdef _WIN32
+        threads[i] = CreateThread(NULL, 0, AppGpuInitThread, &args[i], 0, NULL);
+        threaded[i] = threads[i] != NULL;
+#else
+        threaded[i] = pthread_create(&threads[i], NULL, AppGpuInitThread, &args[i]) == 0;
+#endif
+        if (!threaded[i]) {
+            AppGpuInitThread(&args[i]);
+        }
+    }
+
+    for (uint32_t i = 0; i < gpu_count; i++) {
+        if (!threaded[i]) continue;
+#ifdef _WIN32
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    }
+
+    free(threads);
+    free(threaded);
+    free(args);
+}
+
 static void AppGpuDestroy(struct AppGpu *gpu) {
     AppDevDestroy(&gpu->dev);
     free(gpu->device_extensions);
@@ -1609,6 +1678,397 @@ static void AppGpuDump(const struct AppGpu *gpu) {
     AppDevDump(&gpu->dev);
 }
 
+//---------------------------JSON----------------------------
+// The JSON output follows the DevSim schema, so it can be used as a
+// configuration file of VK_LAYER_LUNARG_device_simulation.
+
+#define DEVSIM_SCHEMA "https://schema.khronos.org/vulkan/devsim_1_0_0.json#"
+
+static uint32_t json_depth;
+static bool json_need_comma;
+
+static void JsonPrintString(const char *str) {
+    putchar('"');
+    for (const unsigned char *c = (const unsigned char *)str; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            printf("\\%c", *c);
+        } else if (*c < 0x20) {
+            printf("\\u%04x", *c);
+        } else {
+            putchar(*c);
+        }
+    }
+    putchar('"');
+}
+
+// Starts a value inside the current object or array.  name is NULL for array
+// elements.
+static void JsonKey(const char *name) {
+    if (json_depth > 0) {
+        printf(json_need_comma ? ",\n" : "\n");
+        for (uint32_t i = 0; i < json_depth; i++) printf("    ");
+    }
+    if (name) {
+        JsonPrintString(name);
+        printf(": ");
+    }
+    json_need_comma = true;
+}
+
+static void JsonOpen(const char *name, char bracket) {
+    JsonKey(name);
+    putchar(bracket);
+    json_depth++;
+    json_need_comma = false;
+}
+
+static void JsonClose(char bracket) {
+    json_depth--;
+    if (json_need_comma) {
+        putchar('\n');
+        for (uint32_t i = 0; i < json_depth; i++) printf("    ");
+    }
+    putchar(bracket);
+    json_need_comma = true;
+}
+
+static void JsonUint(const char *name, uint64_t value) {
+    JsonKey(name);
+    printf("%" PRIu64, value);
+}
+
+static void JsonInt(const char *name, int64_t value) {
+    JsonKey(name);
+    printf("%" PRId64, value);
+}
+
+static void JsonFloat(const char *name, float value) {
+    JsonKey(name);
+    printf("%.9g", value);
+}
+
+static void JsonString(const char *name, const char *value) {
+    JsonKey(name);
+    JsonPrintString(value);
+}
+
+static void JsonUintArray(const char *name, const uint32_t *values, uint32_t count) {
+    JsonKey(name);
+    putchar('[');
+    for (uint32_t i = 0; i < count; i++) printf(i ? ", %u" : "%u", values[i]);
+    putchar(']');
+}
+
+static void JsonByteArray(const char *name, const uint8_t *values, uint32_t count) {
+    JsonKey(name);
+    putchar('[');
+    for (uint32_t i = 0; i < count; i++) printf(i ? ", %u" : "%u", values[i]);
+    putchar(']');
+}
+
+static void JsonFloatArray(const char *name, const float *values, uint32_t count) {
+    JsonKey(name);
+    putchar('[');
+    for (uint32_t i = 0; i < count; i++) printf(i ? ", %.9g" : "%.9g", values[i]);
+    putchar(']');
+}
+
+static void AppJsonLimits(const VkPhysicalDeviceLimits *limits) {
+    JsonOpen("limits", '{');
+    JsonUint("maxImageDimension1D", limits->maxImageDimension1D);
+    JsonUint("maxImageDimension2D", limits->maxImageDimension2D);
+    JsonUint("maxImageDimension3D", limits->maxImageDimension3D);
+    JsonUint("maxImageDimensionCube", limits->maxImageDimensionCube);
+    JsonUint("maxImageArrayLayers", limits->maxImageArrayLayers);
+    JsonUint("maxTexelBufferElements", limits->maxTexelBufferElements);
+    JsonUint("maxUniformBufferRange", limits->maxUniformBufferRange);
+    JsonUint("maxStorageBufferRange", limits->maxStorageBufferRange);
+    JsonUint("maxPushConstantsSize", limits->maxPushConstantsSize);
+    JsonUint("maxMemoryAllocationCount", limits->maxMemoryAllocationCount);
+    JsonUint("maxSamplerAllocationCount", limits->maxSamplerAllocationCount);
+    JsonUint("bufferImageGranularity", limits->bufferImageGranularity);
+    JsonUint("sparseAddressSpaceSize", limits->sparseAddressSpaceSize);
+    JsonUint("maxBoundDescriptorSets", limits->maxBoundDescriptorSets);
+    JsonUint("maxPerStageDescriptorSamplers", limits->maxPerStageDescriptorSamplers);
+    JsonUint("maxPerStageDescriptorUniformBuffers", limits->maxPerStageDescriptorUniformBuffers);
+    JsonUint("maxPerStageDescriptorStorageBuffers", limits->maxPerStageDescriptorStorageBuffers);
+    JsonUint("maxPerStageDescriptorSampledImages", limits->maxPerStageDescriptorSampledImages);
+    JsonUint("maxPerStageDescriptorStorageImages", limits->maxPerStageDescriptorStorageImages);
+    JsonUint("maxPerStageDescriptorInputAttachments", limits->maxPerStageDescriptorInputAttachments);
+    JsonUint("maxPerStageResources", limits->maxPerStageResources);
+    JsonUint("maxDescriptorSetSamplers", limits->maxDescriptorSetSamplers);
+    JsonUint("maxDescriptorSetUniformBuffers", limits->maxDescriptorSetUniformBuffers);
+    JsonUint("maxDescriptorSetUniformBuffersDynamic", limits->maxDescriptorSetUniformBuffersDynamic);
+    JsonUint("maxDescriptorSetStorageBuffers", limits->maxDescriptorSetStorageBuffers);
+    JsonUint("maxDescriptorSetStorageBuffersDynamic", limits->maxDescriptorSetStorageBuffersDynamic);
+    JsonUint("maxDescriptorSetSampledImages", limits->maxDescriptorSetSampledImages);
+    JsonUint("maxDescriptorSetStorageImages", limits->maxDescriptorSetStorageImages);
+    JsonUint("maxDescriptorSetInputAttachments", limits->maxDescriptorSetInputAttachments);
+    JsonUint("maxVertexInputAttributes", limits->maxVertexInputAttributes);
+    JsonUint("maxVertexInputBindings", limits->maxVertexInputBindings);
+    JsonUint("maxVertexInputAttributeOffset", limits->maxVertexInputAttributeOffset);
+    JsonUint("maxVertexInputBindingStride", limits->maxVertexInputBindingStride);
+    JsonUint("maxVertexOutputComponents", limits->maxVertexOutputComponents);
+    JsonUint("maxTessellationGenerationLevel", limits->maxTessellationGenerationLevel);
+    JsonUint("maxTessellationPatchSize", limits->maxTessellationPatchSize);
+    JsonUint("maxTessellationControlPerVertexInputComponents", limits->maxTessellationControlPerVertexInputComponents);
+    JsonUint("maxTessellationControlPerVertexOutputComponents", limits->maxTessellationControlPerVertexOutputComponents);
+    JsonUint("maxTessellationControlPerPatchOutputComponents", limits->maxTessellationControlPerPatchOutputComponents);
+    JsonUint("maxTessellationControlTotalOutputComponents", limits->maxTessellationControlTotalOutputComponents);
+    JsonUint("maxTessellationEvaluationInputComponents", limits->maxTessellationEvaluationInputComponents);
+    JsonUint("maxTessellationEvaluationOutputComponents", limits->maxTessellationEvaluationOutputComponents);
+    JsonUint("maxGeometryShaderInvocations", limits->maxGeometryShaderInvocations);
+    JsonUint("maxGeometryInputComponents", limits->maxGeometryInputComponents);
+    JsonUint("maxGeometryOutputComponents", limits->maxGeometryOutputComponents);
+    JsonUint("maxGeometryOutputVertices", limits->maxGeometryOutputVertices);
+    JsonUint("maxGeometryTotalOutputComponents", limits->maxGeometryTotalOutputComponents);
+    JsonUint("maxFragmentInputComponents", limits->maxFragmentInputComponents);
+    JsonUint("maxFragmentOutputAttachments", limits->maxFragmentOutputAttachments);
+    JsonUint("maxFragmentDualSrcAttachments", limits->maxFragmentDualSrcAttachments);
+    JsonUint("maxFragmentCombinedOutputResources", limits->maxFragmentCombinedOutputResources);
+    JsonUint("maxComputeSharedMemorySize", limits->maxComputeSharedMemorySize);
+    JsonUintArray("maxComputeWorkGroupCount", limits->maxComputeWorkGroupCount, 3);
+    JsonUint("maxComputeWorkGroupInvocations", limits->maxComputeWorkGroupInvocations);
+    JsonUintArray("maxComputeWorkGroupSize", limits->maxComputeWorkGroupSize, 3);
+    JsonUint("subPixelPrecisionBits", limits->subPixelPrecisionBits);
+    JsonUint("subTexelPrecisionBits", limits->subTexelPrecisionBits);
+    JsonUint("mipmapPrecisionBits", limits->mipmapPrecisionBits);
+    JsonUint("maxDrawIndexedIndexValue", limits->maxDrawIndexedIndexValue);
+    JsonUint("maxDrawIndirectCount", limits->maxDrawIndirectCount);
+    JsonFloat("maxSamplerLodBias", limits->maxSamplerLodBias);
+    JsonFloat("maxSamplerAnisotropy", limits->maxSamplerAnisotropy);
+    JsonUint("maxViewports", limits->maxViewports);
+    JsonUintArray("maxViewportDimensions", limits->maxViewportDimensions, 2);
+    JsonFloatArray("viewportBoundsRange", limits->viewportBoundsRange, 2);
+    JsonUint("viewportSubPixelBits", limits->viewportSubPixelBits);
+    JsonUint("minMemoryMapAlignment", limits->minMemoryMapAlignment);
+    JsonUint("minTexelBufferOffsetAlignment", limits->minTexelBufferOffsetAlignment);
+    JsonUint("minUniformBufferOffsetAlignment", limits->minUniformBufferOffsetAlignment);
+    JsonUint("minStorageBufferOffsetAlignment", limits->minStorageBufferOffsetAlignment);
+    JsonInt("minTexelOffset", limits->minTexelOffset);
+    JsonUint("maxTexelOffset", limits->maxTexelOffset);
+    JsonInt("minTexelGatherOffset", limits->minTexelGatherOffset);
+    JsonUint("maxTexelGatherOffset", limits->maxTexelGatherOffset);
+    JsonFloat("minInterpolationOffset", limits->minInterpolationOffset);
+    JsonFloat("maxInterpolationOffset", limits->maxInterpolationOffset);
+    JsonUint("subPixelInterpolationOffsetBits", limits->subPixelInterpolationOffsetBits);
+    JsonUint("maxFramebufferWidth", limits->maxFramebufferWidth);
+    JsonUint("maxFramebufferHeight", limits->maxFramebufferHeight);
+    JsonUint("maxFramebufferLayers", limits->maxFramebufferLayers);
+    JsonUint("framebufferColorSampleCounts", limits->framebufferColorSampleCounts);
+    JsonUint("framebufferDepthSampleCounts", limits->framebufferDepthSampleCounts);
+    JsonUint("framebufferStencilSampleCounts", limits->framebufferStencilSampleCounts);
+    JsonUint("framebufferNoAttachmentsSampleCounts", limits->framebufferNoAttachmentsSampleCounts);
+    JsonUint("maxColorAttachments", limits->maxColorAttachments);
+    JsonUint("sampledImageColorSampleCounts", limits->sampledImageColorSampleCounts);
+    JsonUint("sampledImageIntegerSampleCounts", limits->sampledImageIntegerSampleCounts);
+    JsonUint("sampledImageDepthSampleCounts", limits->sampledImageDepthSampleCounts);
+    JsonUint("sampledImageStencilSampleCounts", limits->sampledImageStencilSampleCounts);
+    JsonUint("storageImageSampleCounts", limits->storageImageSampleCounts);
+    JsonUint("maxSampleMaskWords", limits->maxSampleMaskWords);
+    JsonUint("timestampComputeAndGraphics", limits->timestampComputeAndGraphics);
+    JsonFloat("timestampPeriod", limits->timestampPeriod);
+    JsonUint("maxClipDistances", limits->maxClipDistances);
+    JsonUint("maxCullDistances", limits->maxCullDistances);
+    JsonUint("maxCombinedClipAndCullDistances", limits->maxCombinedClipAndCullDistances);
+    JsonUint("discreteQueuePriorities", limits->discreteQueuePriorities);
+    JsonFloatArray("pointSizeRange", limits->pointSizeRange, 2);
+    JsonFloatArray("lineWidthRange", limits->lineWidthRange, 2);
+    JsonFloat("pointSizeGranularity", limits->pointSizeGranularity);
+    JsonFloat("lineWidthGranularity", limits->lineWidthGranularity);
+    JsonUint("strictLines", limits->strictLines);
+    JsonUint("standardSampleLocations", limits->standardSampleLocations);
+    JsonUint("optimalBufferCopyOffsetAlignment", limits->optimalBufferCopyOffsetAlignment);
+    JsonUint("optimalBufferCopyRowPitchAlignment", limits->optimalBufferCopyRowPitchAlignment);
+    JsonUint("nonCoherentAtomSize", limits->nonCoherentAtomSize);
+    JsonClose('}');
+}
+
+static void AppJsonSparseProps(const VkPhysicalDeviceSparseProperties *sparse_props) {
+    JsonOpen("sparseProperties", '{');
+    JsonUint("residencyStandard2DBlockShape", sparse_props->residencyStandard2DBlockShape);
+    JsonUint("residencyStandard2DMultisampleBlockShape", sparse_props->residencyStandard2DMultisampleBlockShape);
+    JsonUint("residencyStandard3DBlockShape", sparse_props->residencyStandard3DBlockShape);
+    JsonUint("residencyAlignedMipSize", sparse_props->residencyAlignedMipSize);
+    JsonUint("residencyNonResidentStrict", sparse_props->residencyNonResidentStrict);
+    JsonClose('}');
+}
+
+static void AppGpuJsonProps(const struct AppGpu *gpu) {
+    const VkPhysicalDeviceProperties *props = &gpu->props;
+
+    JsonOpen("VkPhysicalDeviceProperties", '{');
+    JsonUint("apiVersion", props->apiVersion);
+    JsonUint("driverVersion", props->driverVersion);
+    JsonUint("vendorID", props->vendorID);
+    JsonUint("deviceID", props->deviceID);
+    JsonInt("deviceType", props->deviceType);
+    JsonString("deviceName", props->deviceName);
+    JsonByteArray("pipelineCacheUUID", props->pipelineCacheUUID, VK_UUID_SIZE);
+    AppJsonLimits(&props->limits);
+    AppJsonSparseProps(&props->sparseProperties);
+    JsonClose('}');
+}
+
+static void AppGpuJsonFeatures(const struct AppGpu *gpu) {
+    const VkPhysicalDeviceFeatures *features = &gpu->features;
+
+    JsonOpen("VkPhysicalDeviceFeatures", '{');
+    JsonUint("robustBufferAccess", features->robustBufferAccess);
+    JsonUint("fullDrawIndexUint32", features->fullDrawIndexUint32);
+    JsonUint("imageCubeArray", features->imageCubeArray);
+    JsonUint("independentBlend", features->independentBlend);
+    JsonUint("geometryShader", features->geometryShader);
+    JsonUint("tessellationShader", features->tessellationShader);
+    JsonUint("sampleRateShading", features->sampleRateShading);
+    JsonUint("dualSrcBlend", features->dualSrcBlend);
+    JsonUint("logicOp", features->logicOp);
+    JsonUint("multiDrawIndirect", features->multiDrawIndirect);
+    JsonUint("drawIndirectFirstInstance", features->drawIndirectFirstInstance);
+    JsonUint("depthClamp", features->depthClamp);
+    JsonUint("depthBiasClamp", features->depthBiasClamp);
+    JsonUint("fillModeNonSolid", features->fillModeNonSolid);
+    JsonUint("depthBounds", features->depthBounds);
+    JsonUint("wideLines", features->wideLines);
+    JsonUint("largePoints", features->largePoints);
+    JsonUint("alphaToOne", features->alphaToOne);
+    JsonUint("multiViewport", features->multiViewport);
+    JsonUint("samplerAnisotropy", features->samplerAnisotropy);
+    JsonUint("textureCompressionETC2", features->textureCompressionETC2);
+    JsonUint("textureCompressionASTC_LDR", features->textureCompressionASTC_LDR);
+    JsonUint("textureCompressionBC", features->textureCompressionBC);
+    JsonUint("occlusionQueryPrecise", features->occlusionQueryPrecise);
+    JsonUint("pipelineStatisticsQuery", features->pipelineStatisticsQuery);
+    JsonUint("vertexPipelineStoresAndAtomics", features->vertexPipelineStoresAndAtomics);
+    JsonUint("fragmentStoresAndAtomics", features->fragmentStoresAndAtomics);
+    JsonUint("shaderTessellationAndGeometryPointSize", features->shaderTessellationAndGeometryPointSize);
+    JsonUint("shaderImageGatherExtended", features->shaderImageGatherExtended);
+    JsonUint("shaderStorageImageExtendedFormats", features->shaderStorageImageExtendedFormats);
+    JsonUint("shaderStorageImageMultisample", features->shaderStorageImageMultisample);
+    JsonUint("shaderStorageImageReadWithoutFormat", features->shaderStorageImageReadWithoutFormat);
+    JsonUint("shaderStorageImageWriteWithoutFormat", features->shaderStorageImageWriteWithoutFormat);
+    JsonUint("shaderUniformBufferArrayDynamicIndexing", features->shaderUniformBufferArrayDynamicIndexing);
+    JsonUint("shaderSampledImageArrayDynamicIndexing", features->shaderSampledImageArrayDynamicIndexing);
+    JsonUint("shaderStorageBufferArrayDynamicIndexing", features->shaderStorageBufferArrayDynamicIndexing);
+    JsonUint("shaderStorageImageArrayDynamicIndexing", features->shaderStorageImageArrayDynamicIndexing);
+    JsonUint("shaderClipDistance", features->shaderClipDistance);
+    JsonUint("shaderCullDistance", features->shaderCullDistance);
+    JsonUint("shaderFloat64", features->shaderFloat64);
+    JsonUint("shaderInt64", features->shaderInt64);
+    JsonUint("shaderInt16", features->shaderInt16);
+    JsonUint("shaderResourceResidency", features->shaderResourceResidency);
+    JsonUint("shaderResourceMinLod", features->shaderResourceMinLod);
+    JsonUint("sparseBinding", features->sparseBinding);
+    JsonUint("sparseResidencyBuffer", features->sparseResidencyBuffer);
+    JsonUint("sparseResidencyImage2D", features->sparseResidencyImage2D);
+    JsonUint("sparseResidencyImage3D", features->sparseResidencyImage3D);
+    JsonUint("sparseResidency2Samples", features->sparseResidency2Samples);
+    JsonUint("sparseResidency4Samples", features->sparseResidency4Samples);
+    JsonUint("sparseResidency8Samples", features->sparseResidency8Samples);
+    JsonUint("sparseResidency16Samples", features->sparseResidency16Samples);
+    JsonUint("sparseResidencyAliased", features->sparseResidencyAliased);
+    JsonUint("variableMultisampleRate", features->variableMultisampleRate);
+    JsonUint("inheritedQueries", features->inheritedQueries);
+    JsonClose('}');
+}
+
+static void AppGpuJsonMemoryProps(const struct AppGpu *gpu) {
+    const VkPhysicalDeviceMemoryProperties *props = &gpu->memory_props;
+
+    JsonOpen("VkPhysicalDeviceMemoryProperties", '{');
+    JsonUint("memoryTypeCount", props->memoryTypeCount);
+    JsonOpen("memoryTypes", '[');
+    for (uint32_t i = 0; i < props->memoryTypeCount; i++) {
+        JsonOpen(NULL, '{');
+        JsonUint("heapIndex", props->memoryTypes[i].heapIndex);
+        JsonUint("propertyFlags", props->memoryTypes[i].propertyFlags);
+        JsonClose('}');
+    }
+    JsonClose(']');
+    JsonUint("memoryHeapCount", props->memoryHeapCount);
+    JsonOpen("memoryHeaps", '[');
+    for (uint32_t i = 0; i < props->memoryHeapCount; i++) {
+        JsonOpen(NULL, '{');
+        JsonUint("flags", props->memoryHeaps[i].flags);
+        JsonUint("size", props->memoryHeaps[i].size);
+        JsonClose('}');
+    }
+    JsonClose(']');
+    JsonClose('}');
+}
+
+static void AppGpuJsonQueueProps(const struct AppGpu *gpu) {
+    JsonOpen("ArrayOfVkQueueFamilyProperties", '[');
+    for (uint32_t i = 0; i < gpu->queue_count; i++) {
+        const VkQueueFamilyProperties *props = &gpu->queue_props[i];
+
+        JsonOpen(NULL, '{');
+        JsonOpen("minImageTransferGranularity", '{');
+        JsonUint("depth", props->minImageTransferGranularity.depth);
+        JsonUint("height", props->minImageTransferGranularity.height);
+        JsonUint("width", props->minImageTransferGranularity.width);
+        JsonClose('}');
+        JsonUint("queueCount", props->queueCount);
+        JsonUint("queueFlags", props->queueFlags);
+        JsonUint("timestampValidBits", props->timestampValidBits);
+        JsonClose('}');
+    }
+    JsonClose(']');
+}
+
+// Formats without any supported feature are left out.
+static void AppDevJsonFormatProps(const struct AppDev *dev) {
+    JsonOpen("ArrayOfVkFormatProperties", '[');
+    for (VkFormat fmt = 0; fmt < VK_FORMAT_RANGE_SIZE; fmt++) {
+        const VkFormatProperties *props = &dev->format_props[fmt];
+        if (!props->linearTilingFeatures && !props->optimalTilingFeatures && !props->bufferFeatures) continue;
+
+        JsonOpen(NULL, '{');
+        JsonInt("formatID", fmt);
+        JsonUint("linearTilingFeatures", props->linearTilingFeatures);
+        JsonUint("optimalTilingFeatures", props->optimalTilingFeatures);
+        JsonUint("bufferFeatures", props->bufferFeatures);
+        JsonClose('}');
+    }
+    JsonClose(']');
+}
+
+static void AppGpuJson(const struct AppGpu *gpu) {
+    char desc[VK_MAX_PHYSICAL_DEVICE_NAME_SIZE + 64];
+    char api_version[32];
+
+    snprintf(desc, sizeof(desc), "Generated by vulkaninfo from GPU%u (%s)", gpu->id, gpu->props.deviceName);
+    snprintf(api_version, sizeof(api_version), "%d.%d.%d", VK_VERSION_MAJOR(VK_API_VERSION_1_0),
+             VK_VERSION_MINOR(VK_API_VERSION_1_0), VK_VERSION_PATCH(VK_HEADER_VERSION));
+
+    JsonOpen(NULL, '{');
+    JsonString("$schema", DEVSIM_SCHEMA);
+    JsonOpen("comments", '{');
+    JsonString("desc", desc);
+    JsonString("vulkanApiVersion", api_version);
+    JsonClose('}');
+    AppGpuJsonProps(gpu);
+    AppGpuJsonFeatures(gpu);
+    AppGpuJsonMemoryProps(gpu);
+    AppGpuJsonQueueProps(gpu);
+    AppDevJsonFormatProps(&gpu->dev);
+    JsonClose('}');
+}
+
+// Prints the GPU with index gpu_id as a DevSim configuration, or all GPUs as
+// a DevSim profile library if gpu_id is UINT32_MAX.
+static void AppDumpJson(const struct AppGpu *gpus, uint32_t gpu_count, uint32_t gpu_id) {
+    if (gpu_id == UINT32_MAX) {
+        JsonOpen(NULL, '[');
+        for (uint32_t i = 0; i < gpu_count; i++) AppGpuJson(&gpus[i]);
+        JsonClose(']');
+    } else {
+        AppGpuJson(&gpus[gpu_id]);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
 #ifdef _WIN32
 // Enlarges the console window to have a large scrollback size.
 static void ConsoleEnlarge() {
@@ -1634,54 +2094,13 @@ static void ConsoleEnlarge() {
 }
 #endif
 
-int main(int argc, char **argv) {
-    uint32_t vulkan_major, vulkan_minor, vulkan_patch;
-    struct AppGpu *gpus;
-    VkPhysicalDevice *objs;
-    uint32_t gpu_count;
-    VkResult err;
-    struct AppInstance inst;
-
-#ifdef _WIN32
-    if (ConsoleIsExclusive()) ConsoleEnlarge();
-#endif
-
-    vulkan_major = VK_VERSION_MAJOR(VK_API_VERSION_1_0);
-    vulkan_minor = VK_VERSION_MINOR(VK_API_VERSION_1_0);
-    vulkan_patch = VK_VERSION_PATCH(VK_HEADER_VERSION);
-
-    printf("===========\n");
-    printf("VULKAN INFO\n");
-    printf("===========\n\n");
-    printf("Vulkan API Version: %d.%d.%d\n\n", vulkan_major, vulkan_minor, vulkan_patch);
-
-    AppCreateInstance(&inst);
-
-    printf("\nInstance Extensions:\n");
-    printf("====================\n");
-    AppDumpExtensions("", "Instance", inst.global_extension_count, inst.global_extensions);
-
-    err = vkEnumeratePhysicalDevices(inst.instance, &gpu_count, NULL);
-    if (err) ERR_EXIT(err);
-    objs = malloc(sizeof(objs[0]) * gpu_count);
-    if (!objs) ERR_EXIT(VK_ERROR_OUT_OF_HOST_MEMORY);
-    err = vkEnumeratePhysicalDevices(inst.instance, &gpu_count, objs);
-    if (err) ERR_EXIT(err);
-
-    gpus = malloc(sizeof(gpus[0]) * gpu_count);
-    if (!gpus) ERR_EXIT(VK_ERROR_OUT_OF_HOST_MEMORY);
-    for (uint32_t i = 0; i < gpu_count; i++) {
-        AppGpuInit(&gpus[i], &inst, i, objs[i]);
-        printf("\n\n");
-    }
-
-    //---Layer-Device-Extensions---
-    printf("Layers: count = %d\n", inst.global_layer_count);
+static void AppDumpLayers(const struct AppInstance *inst, struct AppGpu *gpus, uint32_t gpu_count) {
+    printf("Layers: count = %d\n", inst->global_layer_count);
     printf("=======\n");
-    for (uint32_t i = 0; i < inst.global_layer_count; i++) {
+    for (uint32_t i = 0; i < inst->global_layer_count; i++) {
         uint32_t layer_major, layer_minor, layer_patch;
         char spec_version[64], layer_version[64];
-        VkLayerProperties const *layer_prop = &inst.global_layers[i].layer_properties;
+        VkLayerProperties const *layer_prop = &inst->global_layers[i].layer_properties;
 
         ExtractVersion(layer_prop->specVersion, &layer_major, &layer_minor, &layer_patch);
         snprintf(spec_version, sizeof(spec_version), "%d.%d.%d", layer_major, layer_minor, layer_patch);
@@ -1689,9 +2108,9 @@ int main(int argc, char **argv) {
         printf("%s (%s) Vulkan version %s, layer version %s\n", layer_prop->layerName, (char *)layer_prop->description,
                spec_version, layer_version);
 
-        AppDumpExtensions("\t", "Layer", inst.global_layers[i].extension_count, inst.global_layers[i].extension_properties);
+        AppDumpExtensions("\t", "Layer", inst->global_layers[i].extension_count, inst->global_layers[i].extension_properties);
 
-        char *layer_name = inst.global_layers[i].layer_properties.layerName;
+        char *layer_name = inst->global_layers[i].layer_properties.layerName;
         printf("\tDevices \tcount = %d\n", gpu_count);
         for (uint32_t j = 0; j < gpu_count; j++) {
             printf("\t\tGPU id       : %u (%s)\n", j, gpus[j].props.deviceName);
@@ -1704,12 +2123,13 @@ int main(int argc, char **argv) {
         printf("\n");
     }
     fflush(stdout);
-    //-----------------------------
+}
 
+static void AppDumpSurfaces(struct AppInstance *inst, struct AppGpu *gpus, uint32_t gpu_count) {
     printf("Presentable Surfaces:\n");
     printf("=====================\n");
-    inst.width = 256;
-    inst.height = 256;
+    inst->width = 256;
+    inst->height = 256;
     int format_count = 0;
     int present_mode_count = 0;
 
@@ -1722,57 +2142,129 @@ int main(int argc, char **argv) {
 #endif
 //--WIN32--
 #ifdef VK_USE_PLATFORM_WIN32_KHR
-    if (CheckExtensionEnabled(VK_KHR_WIN32_SURFACE_EXTENSION_NAME, inst.inst_extensions, inst.inst_extensions_count)) {
-        AppCreateWin32Window(&inst);
+    if (CheckExtensionEnabled(VK_KHR_WIN32_SURFACE_EXTENSION_NAME, inst->inst_extensions, inst->inst_extensions_count)) {
+        AppCreateWin32Window(inst);
         for (uint32_t i = 0; i < gpu_count; i++) {
-            AppCreateWin32Surface(&inst);
+            AppCreateWin32Surface(inst);
             printf("GPU id       : %u (%s)\n", i, gpus[i].props.deviceName);
             printf("Surface type : %s\n", VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
-            format_count += AppDumpSurfaceFormats(&inst, &gpus[i]);
-            present_mode_count += AppDumpSurfacePresentModes(&inst, &gpus[i]);
-            AppDumpSurfaceCapabilities(&inst, &gpus[i]);
-            AppDestroySurface(&inst);
+            format_count += AppDumpSurfaceFormats(inst, &gpus[i]);
+            present_mode_count += AppDumpSurfacePresentModes(inst, &gpus[i]);
+            AppDumpSurfaceCapabilities(inst, &gpus[i]);
+            AppDestroySurface(inst);
         }
-        AppDestroyWin32Window(&inst);
+        AppDestroyWin32Window(inst);
     }
 //--XCB--
 #elif VK_USE_PLATFORM_XCB_KHR
-    if (CheckExtensionEnabled(VK_KHR_XCB_SURFACE_EXTENSION_NAME, inst.inst_extensions, inst.inst_extensions_count)) {
-        AppCreateXcbWindow(&inst);
+    if (CheckExtensionEnabled(VK_KHR_XCB_SURFACE_EXTENSION_NAME, inst->inst_extensions, inst->inst_extensions_count)) {
+        AppCreateXcbWindow(inst);
         for (uint32_t i = 0; i < gpu_count; i++) {
-            AppCreateXcbSurface(&inst);
+            AppCreateXcbSurface(inst);
             printf("GPU id       : %u (%s)\n", i, gpus[i].props.deviceName);
             printf("Surface type : %s\n", VK_KHR_XCB_SURFACE_EXTENSION_NAME);
-            format_count += AppDumpSurfaceFormats(&inst, &gpus[i]);
-            present_mode_count += AppDumpSurfacePresentModes(&inst, &gpus[i]);
-            AppDumpSurfaceCapabilities(&inst, &gpus[i]);
-            AppDestroySurface(&inst);
+            format_count += AppDumpSurfaceFormats(inst, &gpus[i]);
+            present_mode_count += AppDumpSurfacePresentModes(inst, &gpus[i]);
+            AppDumpSurfaceCapabilities(inst, &gpus[i]);
+            AppDestroySurface(inst);
         }
-        AppDestroyXcbWindow(&inst);
+        AppDestroyXcbWindow(inst);
     }
 //--XLIB--
 #elif VK_USE_PLATFORM_XLIB_KHR
-    if (CheckExtensionEnabled(VK_KHR_XLIB_SURFACE_EXTENSION_NAME, inst.inst_extensions, inst.inst_extensions_count)) {
-        AppCreateXlibWindow(&inst);
+    if (CheckExtensionEnabled(VK_KHR_XLIB_SURFACE_EXTENSION_NAME, inst->inst_extensions, inst->inst_extensions_count)) {
+        AppCreateXlibWindow(inst);
         for (uint32_t i = 0; i < gpu_count; i++) {
-            AppCreateXlibSurface(&inst);
+            AppCreateXlibSurface(inst);
             printf("GPU id       : %u (%s)\n", i, gpus[i].props.deviceName);
             printf("Surface type : %s\n", VK_KHR_XLIB_SURFACE_EXTENSION_NAME);
-            format_count += AppDumpSurfaceFormats(&inst, &gpus[i]);
-            present_mode_count += AppDumpSurfacePresentModes(&inst, &gpus[i]);
-            AppDumpSurfaceCapabilities(&inst, &gpus[i]);
-            AppDestroySurface(&inst);
+            format_count += AppDumpSurfaceFormats(inst, &gpus[i]);
+            present_mode_count += AppDumpSurfacePresentModes(inst, &gpus[i]);
+            AppDumpSurfaceCapabilities(inst, &gpus[i]);
+            AppDestroySurface(inst);
         }
-        AppDestroyXlibWindow(&inst);
+        AppDestroyXlibWindow(inst);
     }
 #endif
     // TODO: Android / Wayland / MIR
     if (!format_count && !present_mode_count) printf("None found\n");
-    //---------
+}
 
-    for (uint32_t i = 0; i < gpu_count; i++) {
-        AppGpuDump(&gpus[i]);
+int main(int argc, char **argv) {
+    uint32_t vulkan_major, vulkan_minor, vulkan_patch;
+    struct AppGpu *gpus;
+    VkPhysicalDevice *objs;
+    uint32_t gpu_count;
+    VkResult err;
+    struct AppInstance inst;
+    bool json_output = false;
+    uint32_t json_gpu = UINT32_MAX;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--json")) {
+            json_output = true;
+        } else if (!strncmp(argv[i], "--json=", 7) && sscanf(argv[i] + 7, "%u", &json_gpu) == 1) {
+            json_output = true;
+        } else {
+            fprintf(stderr,
+                    "Usage:\n  %s [--json[=<gpu id>]]\n"
+                    "  --json           print every GPU as a device_simulation profile library\n"
+                    "  --json=<gpu id>  print one GPU as a device_simulation configuration file\n",
+                    APP_SHORT_NAME);
+            exit(1);
+        }
+    }
+
+#ifdef _WIN32
+    if (!json_output && ConsoleIsExclusive()) ConsoleEnlarge();
+#endif
+
+    vulkan_major = VK_VERSION_MAJOR(VK_API_VERSION_1_0);
+    vulkan_minor = VK_VERSION_MINOR(VK_API_VERSION_1_0);
+    vulkan_patch = VK_VERSION_PATCH(VK_HEADER_VERSION);
+
+    if (!json_output) {
+        printf("===========\n");
+        printf("VULKAN INFO\n");
+        printf("===========\n\n");
+        printf("Vulkan API Version: %d.%d.%d\n\n", vulkan_major, vulkan_minor, vulkan_patch);
+    }
+
+    AppCreateInstance(&inst);
+
+    if (!json_output) {
+        printf("\nInstance Extensions:\n");
+        printf("====================\n");
+        AppDumpExtensions("", "Instance", inst.global_extension_count, inst.global_extensions);
+    }
+
+    err = vkEnumeratePhysicalDevices(inst.instance, &gpu_count, NULL);
+    if (err) ERR_EXIT(err);
+    objs = malloc(sizeof(objs[0]) * gpu_count);
+    if (!objs) ERR_EXIT(VK_ERROR_OUT_OF_HOST_MEMORY);
+    err = vkEnumeratePhysicalDevices(inst.instance, &gpu_count, objs);
+    if (err) ERR_EXIT(err);
+
+    if (json_gpu != UINT32_MAX && json_gpu >= gpu_count) {
+        fprintf(stderr, "GPU id %u is out of range, found %u GPUs\n", json_gpu, gpu_count);
+        exit(1);
+    }
+
+    gpus = malloc(sizeof(gpus[0]) * gpu_count);
+    if (!gpus) ERR_EXIT(VK_ERROR_OUT_OF_HOST_MEMORY);
+    AppGpuInitAll(gpus, &inst, objs, gpu_count);
+
+    if (json_output) {
+        AppDumpJson(gpus, gpu_count, json_gpu);
+    } else {
         printf("\n\n");
+        AppDumpLayers(&inst, gpus, gpu_count);
+        AppDumpSurfaces(&inst, gpus, gpu_count);
+
+        for (uint32_t i = 0; i < gpu_count; i++) {
+            AppGpuDump(&gpus[i]);
+            printf("\n\n");
+        }
     }
 
     for (uint32_t i = 0; i < gpu_count; i++) AppGpuDestroy(&gpus[i]);
@@ -1783,7 +2275,7 @@ int main(int argc, char **argv) {
 
     fflush(stdout);
 #ifdef _WIN32
-    if (ConsoleIsExclusive()) Sleep(INFINITE);
+    if (!json_output && ConsoleIsExclusive()) Sleep(INFINITE);
 #endif
 
     return 0;
@@ -0,0 +1,685 @@
+/*
+ * Copyright (c) 2015-2017 The Khronos Group Inc.
+ * Copyright (c) 2015-2017 Valve Corporation
+ * Copyright (c) 2015-2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// A driver that accepts every call, hands out unique handles and reports the properties of a capable device, without
+// touching any hardware.  Replaying a trace through it measures the cost of the loader and the layers on their own.
+
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vk_layer.h"
+#include "vulkan/vk_icd.h"
+
+namespace mock_icd {
+
+typedef std::lock_guard<std::mutex> lock_guard_t;
+
+static std::mutex global_lock;
+static std::atomic<uint64_t> global_unique_handle(1);
+
+static const uint32_t icd_physical_device_count = 1;
+static const uint32_t icd_swapchain_image_count = 3;
+
+struct MemoryInfo {
+    VkDeviceSize size;
+    void *data;
+};
+
+struct SwapchainInfo {
+    std::vector<VkImage> images;
+    uint32_t next_image;
+};
+
+// The loader writes its dispatch pointer into a physical device, so every instance gets one of its own
+static std::unordered_map<VkInstance, VkPhysicalDevice> physical_device_map;
+static std::unordered_map<VkDevice, std::unordered_map<uint32_t, VkQueue>> queue_map;
+static std::unordered_map<VkCommandPool, std::vector<VkCommandBuffer>> command_pool_map;
+static std::unordered_map<VkDeviceMemory, MemoryInfo> memory_map;
+static std::unordered_map<VkBuffer, VkDeviceSize> buffer_size_map;
+static std::unordered_map<VkImage, VkDeviceSize> image_size_map;
+static std::unordered_map<VkSwapchainKHR, SwapchainInfo> swapchain_map;
+
+// Dispatchable handles start with the loader's dispatch pointer, so they need memory of their own
+static void *CreateDispatchableHandle() {
+    VK_LOADER_DATA *handle = new VK_LOADER_DATA;
+    set_loader_magic_value(handle);
+    return handle;
+}
+
+static void DestroyDispatchableHandle(void *handle) { delete reinterpret_cast<VK_LOADER_DATA *>(handle); }
+
+static uint64_t NewHandle() { return global_unique_handle++; }
+
+}  // namespace mock_icd
+
+#include "mock_icd_entrypoints.h"
+
+namespace mock_icd {
+
+// Copy the first *pCount entries of a property array, the way every Vulkan enumeration does
+template <typename T>
+static VkResult EnumerateProperties(uint32_t source_count, const T *source, uint32_t *pCount, T *pProperties) {
+    if (!pProperties) {
+        *pCount = source_count;
+        return VK_SUCCESS;
+    }
+    uint32_t copy_count = (*pCount < source_count) ? *pCount : source_count;
+    for (uint32_t i = 0; i < copy_count; ++i) {
+        pProperties[i] = source[i];
+    }
+    *pCount = copy_count;
+    return (copy_count < source_count) ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL CreateInstance(const VkInstanceCreateInfo *pCreateInfo,
+                                                     const VkAllocationCallbacks *pAllocator, VkInstance *pInstance) {
+    *pInstance = (VkInstance)CreateDispatchableHandle();
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL DestroyInstance(VkInstance instance, const VkAllocationCallbacks *pAllocator) {
+    if (!instance) return;
+    lock_guard_t lock(global_lock);
+    auto physical_device = physical_device_map.find(instance);
+    if (physical_device != physical_device_map.end()) {
+        DestroyDispatchableHandle(physical_device->second);
+        physical_device_map.erase(physical_device);
+    }
+    DestroyDispatchableHandle(instance);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL EnumeratePhysicalDevices(VkInstance instance, uint32_t *pPhysicalDeviceCount,
+                                                               VkPhysicalDevice *pPhysicalDevices) {
+    if (!pPhysicalDevices) {
+        *pPhysicalDeviceCount = icd_physical_device_count;
+        return VK_SUCCESS;
+    }
+    if (*pPhysicalDeviceCount < icd_physical_device_count) return VK_INCOMPLETE;
+    lock_guard_t lock(global_lock);
+    VkPhysicalDevice &physical_device = physical_device_map[instance];
+    if (!physical_device) physical_device = (VkPhysicalDevice)CreateDispatchableHandle();
+    pPhysicalDevices[0] = physical_device;
+    *pPhysicalDeviceCount = icd_physical_device_count;
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetInstanceProcAddr(VkInstance instance, const char *pName) {
+    auto item = name_to_funcptr_map.find(pName);
+    if (item == name_to_funcptr_map.end()) return nullptr;
+    return reinterpret_cast<PFN_vkVoidFunction>(item->second);
+}
+
+static VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetDeviceProcAddr(VkDevice device, const char *pName) {
+    return GetInstanceProcAddr(VK_NULL_HANDLE, pName);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL EnumerateInstanceExtensionProperties(const char *pLayerName, uint32_t *pPropertyCount,
+                                                                           VkExtensionProperties *pProperties) {
+    if (pLayerName) {
+        *pPropertyCount = 0;
+        return VK_SUCCESS;
+    }
+    uint32_t count = sizeof(instance_extensions) / sizeof(instance_extensions[0]);
+    return EnumerateProperties(count, instance_extensions, pPropertyCount, pProperties);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL EnumerateInstanceLayerProperties(uint32_t *pPropertyCount, VkLayerProperties *pProperties) {
+    *pPropertyCount = 0;
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL EnumerateDeviceExtensionProperties(VkPhysicalDevice physicalDevice, const char *pLayerName,
+                                                                         uint32_t *pPropertyCount,
+                                                                         VkExtensionProperties *pProperties) {
+    if (pLayerName) {
+        *pPropertyCount = 0;
+        return VK_SUCCESS;
+    }
+    uint32_t count = sizeof(device_extensions) / sizeof(device_extensions[0]);
+    return EnumerateProperties(count, device_extensions, pPropertyCount, pProperties);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL EnumerateDeviceLayerProperties(VkPhysicalDevice physicalDevice, uint32_t *pPropertyCount,
+                                                                     VkLayerProperties *pProperties) {
+    *pPropertyCount = 0;
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceFeatures(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures *pFeatures) {
+    // Every member is a VkBool32, so the device supports every feature
+    VkBool32 *feature = reinterpret_cast<VkBool32 *>(pFeatures);
+    for (size_t i = 0; i < sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32); ++i) {
+        feature[i] = VK_TRUE;
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceFeatures2KHR(VkPhysicalDevice physicalDevice,
+                                                                VkPhysicalDeviceFeatures2KHR *pFeatures) {
+    GetPhysicalDeviceFeatures(physicalDevice, &pFeatures->features);
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceProperties(VkPhysicalDevice physicalDevice,
+                                                              VkPhysicalDeviceProperties *pProperties) {
+    memset(pProperties, 0, sizeof(*pProperties));
+    pProperties->apiVersion = VK_API_VERSION_1_0 | VK_HEADER_VERSION;
+    pProperties->driverVersion = 1;
+    pProperties->vendorID = 0xba5eba11;
+    pProperties->deviceID = 0xf005ba11;
+    pProperties->deviceType = VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU;
+    strncpy(pProperties->deviceName, "Vulkan Mock Device", VK_MAX_PHYSICAL_DEVICE_NAME_SIZE - 1);
+    pProperties->pipelineCacheUUID[0] = 18;
+
+    // Limits of a typical desktop GPU, so that validation doesn't reject what a trace from real hardware asks for
+    VkPhysicalDeviceLimits &limits = pProperties->limits;
+    limits.maxImageDimension1D = 16384;
+    limits.maxImageDimension2D = 16384;
+    limits.maxImageDimension3D = 2048;
+    limits.maxImageDimensionCube = 16384;
+    limits.maxImageArrayLayers = 2048;
+    limits.maxTexelBufferElements = 128 * 1024 * 1024;
+    limits.maxUniformBufferRange = 64 * 1024;
+    limits.maxStorageBufferRange = 0xffffffff;
+    limits.maxPushConstantsSize = 256;
+    limits.maxMemoryAllocationCount = 4096;
+    limits.maxSamplerAllocationCount = 4000;
+    limits.bufferImageGranularity = 1;
+    limits.sparseAddressSpaceSize = 0xffffffffffffffffULL;
+    limits.maxBoundDescriptorSets = 8;
+    limits.maxPerStageDescriptorSamplers = 1024 * 1024;
+    limits.maxPerStageDescriptorUniformBuffers = 1024 * 1024;
+    limits.maxPerStageDescriptorStorageBuffers = 1024 * 1024;
+    limits.maxPerStageDescriptorSampledImages = 1024 * 1024;
+    limits.maxPerStageDescriptorStorageImages = 1024 * 1024;
+    limits.maxPerStageDescriptorInputAttachments = 1024 * 1024;
+    limits.maxPerStageResources = 1024 * 1024;
+    limits.maxDescriptorSetSamplers = 1024 * 1024;
+    limits.maxDescriptorSetUniformBuffers = 1024 * 1024;
+    limits.maxDescriptorSetUniformBuffersDynamic = 16;
+    limits.maxDescriptorSetStorageBuffers = 1024 * 1024;
+    limits.maxDescriptorSetStorageBuffersDynamic = 16;
+    limits.maxDescriptorSetSampledImages = 1024 * 1024;
+    limits.maxDescriptorSetStorageImages = 1024 * 1024;
+    limits.maxDescriptorSetInputAttachments = 1024 * 1024;
+    limits.maxVertexInputAttributes = 32;
+    limits.maxVertexInputBindings = 32;
+    limits.maxVertexInputAttributeOffset = 2047;
+    limits.maxVertexInputBindingStride = 2048;
+    limits.maxVertexOutputComponents = 128;
+    limits.maxTessellationGenerationLevel = 64;
+    limits.maxTessellationPatchSize = 32;
+    limits.maxTessellationControlPerVertexInputComponents = 128;
+    limits.maxTessellationControlPerVertexOutputComponents = 128;
+    limits.maxTessellationControlPerPatchOutputComponents = 120;
+    limits.maxTessellationControlTotalOutputComponents = 4096;
+    limits.maxTessellationEvaluationInputComponents = 128;
+    limits.maxTessellationEvaluationOutputComponents = 128;
+    limits.maxGeometryShaderInvocations = 32;
+    limits.maxGeometryInputComponents = 128;
+    limits.maxGeometryOutputComponents = 128;
+    limits.maxGeometryOutputVertices = 1024;
+    limits.maxGeometryTotalOutputComponents = 1024;
+    limits.maxFragmentInputComponents = 128;
+    limits.maxFragmentOutputAttachments = 8;
+    limits.maxFragmentDualSrcAttachments = 1;
+    limits.maxFragmentCombinedOutputResources = 16;
+    limits.maxComputeSharedMemorySize = 48 * 1024;
+    limits.maxComputeWorkGroupCount[0] = 65535;
+    limits.maxComputeWorkGroupCount[1] = 65535;
+    limits.maxComputeWorkGroupCount[2] = 65535;
+    limits.maxComputeWorkGroupInvocations = 1024;
+    limits.maxComputeWorkGroupSize[0] = 1024;
+    limits.maxComputeWorkGroupSize[1] = 1024;
+    limits.maxComputeWorkGroupSize[2] = 64;
+    limits.subPixelPrecisionBits = 8;
+    limits.subTexelPrecisionBits = 8;
+    limits.mipmapPrecisionBits = 8;
+    limits.maxDrawIndexedIndexValue = 0xffffffff;
+    limits.maxDrawIndirectCount = 0xffffffff;
+    limits.maxSamplerLodBias = 15.0f;
+    limits.maxSamplerAnisotropy = 16.0f;
+    limits.maxViewports = 16;
+    limits.maxViewportDimensions[0] = 16384;
+    limits.maxViewportDimensions[1] = 16384;
+    limits.viewportBoundsRange[0] = -32768.0f;
+    limits.viewportBoundsRange[1] = 32767.0f;
+    limits.viewportSubPixelBits = 8;
+    limits.minMemoryMapAlignment = 64;
+    limits.minTexelBufferOffsetAlignment = 16;
+    limits.minUniformBufferOffsetAlignment = 16;
+    limits.minStorageBufferOffsetAlignment = 16;
+    limits.minTexelOffset = -8;
+    limits.maxTexelOffset = 7;
+    limits.minTexelGatherOffset = -32;
+    limits.maxTexelGatherOffset = 31;
+    limits.minInterpolationOffset = -0.5f;
+    limits.maxInterpolationOffset = 0.4375f;
+    limits.subPixelInterpolationOffsetBits = 4;
+    limits.maxFramebufferWidth = 16384;
+    limits.maxFramebufferHeight = 16384;
+    limits.maxFramebufferLayers = 2048;
+    limits.framebufferColorSampleCounts = 0x7f;
+    limits.framebufferDepthSampleCounts = 0x7f;
+    limits.framebufferStencilSampleCounts = 0x7f;
+    limits.framebufferNoAttachmentsSampleCounts = 0x7f;
+    limits.maxColorAttachments = 8;
+    limits.sampledImageColorSampleCounts = 0x7f;
+    limits.sampledImageIntegerSampleCounts = 0x7f;
+    limits.sampledImageDepthSampleCounts = 0x7f;
+    limits.sampledImageStencilSampleCounts = 0x7f;
+    limits.storageImageSampleCounts = 0x7f;
+    limits.maxSampleMaskWords = 1;
+    limits.timestampComputeAndGraphics = VK_TRUE;
+    limits.timestampPeriod = 1.0f;
+    limits.maxClipDistances = 8;
+    limits.maxCullDistances = 8;
+    limits.maxCombinedClipAndCullDistances = 8;
+    limits.discreteQueuePriorities = 2;
+    limits.pointSizeRange[0] = 1.0f;
+    limits.pointSizeRange[1] = 64.0f;
+    limits.lineWidthRange[0] = 1.0f;
+    limits.lineWidthRange[1] = 8.0f;
+    limits.pointSizeGranularity = 1.0f;
+    limits.lineWidthGranularity = 1.0f;
+    limits.strictLines = VK_TRUE;
+    limits.standardSampleLocations = VK_TRUE;
+    limits.optimalBufferCopyOffsetAlignment = 1;
+    limits.optimalBufferCopyRowPitchAlignment = 1;
+    limits.nonCoherentAtomSize = 1;
+
+    pProperties->sparseProperties.residencyStandard2DBlockShape = VK_TRUE;
+    pProperties->sparseProperties.residencyStandard3DBlockShape = VK_TRUE;
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceProperties2KHR(VkPhysicalDevice physicalDevice,
+                                                                  VkPhysicalDeviceProperties2KHR *pProperties) {
+    GetPhysicalDeviceProperties(physicalDevice, &pProperties->properties);
+}
+
+// A single queue family that can do everything
+static void SetQueueFamilyProperties(VkQueueFamilyProperties *pProperties) {
+    pProperties->queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT | VK_QUEUE_SPARSE_BINDING_BIT;
+    pProperties->queueCount = 1;
+    pProperties->timestampValidBits = 64;
+    pProperties->minImageTransferGranularity = {1, 1, 1};
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceQueueFamilyProperties(VkPhysicalDevice physicalDevice,
+                                                                         uint32_t *pQueueFamilyPropertyCount,
+                                                                         VkQueueFamilyProperties *pQueueFamilyProperties) {
+    if (pQueueFamilyProperties && *pQueueFamilyPropertyCount >= 1) {
+        SetQueueFamilyProperties(pQueueFamilyProperties);
+    }
+    *pQueueFamilyPropertyCount = (pQueueFamilyProperties && *pQueueFamilyPropertyCount == 0) ? 0 : 1;
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceQueueFamilyProperties2KHR(VkPhysicalDevice physicalDevice,
+                                                                             uint32_t *pQueueFamilyPropertyCount,
+                                                                             VkQueueFamilyProperties2KHR *pQueueFamilyProperties) {
+    if (pQueueFamilyProperties && *pQueueFamilyPropertyCount >= 1) {
+        SetQueueFamilyProperties(&pQueueFamilyProperties->queueFamilyProperties);
+    }
+    *pQueueFamilyPropertyCount = (pQueueFamilyProperties && *pQueueFamilyPropertyCount == 0) ? 0 : 1;
+}
+
+// Device local, host cached and a combined type, which covers the types a trace from real hardware picks
+static VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceMemoryProperties(VkPhysicalDevice physicalDevice,
+                                                                    VkPhysicalDeviceMemoryProperties *pMemoryProperties) {
+    memset(pMemoryProperties, 0, sizeof(*pMemoryProperties));
+    pMemoryProperties->memoryTypeCount = 3;
+    pMemoryProperties->memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    pMemoryProperties->memoryTypes[0].heapIndex = 0;
+    pMemoryProperties->memoryTypes[1].propertyFlags =
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    pMemoryProperties->memoryTypes[1].heapIndex = 1;
+    pMemoryProperties->memoryTypes[2].propertyFlags =
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    pMemoryProperties->memoryTypes[2].heapIndex = 0;
+    pMemoryProperties->memoryHeapCount = 2;
+    pMemoryProperties->memoryHeaps[0].size = 8ULL * 1024 * 1024 * 1024;
+    pMemoryProperties->memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+    pMemoryProperties->memoryHeaps[1].size = 8ULL * 1024 * 1024 * 1024;
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceMemoryProperties2KHR(VkPhysicalDevice physicalDevice,
+                                                                        VkPhysicalDeviceMemoryProperties2KHR *pMemoryProperties) {
+    GetPhysicalDeviceMemoryProperties(physicalDevice, &pMemoryProperties->memoryProperties);
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceFormatProperties(VkPhysicalDevice physicalDevice, VkFormat format,
+                                                                    VkFormatProperties *pFormatProperties) {
+    if (format == VK_FORMAT_UNDEFINED) {
+        memset(pFormatProperties, 0, sizeof(*pFormatProperties));
+        return;
+    }
+    // Every format supports every use
+    pFormatProperties->linearTilingFeatures = 0x1FFF;
+    pFormatProperties->optimalTilingFeatures = 0x1FFF;
+    pFormatProperties->bufferFeatures = VK_FORMAT_FEATURE_UNIFORM_TEXEL_BUFFER_BIT | VK_FORMAT_FEATURE_STORAGE_TEXEL_BUFFER_BIT |
+                                        VK_FORMAT_FEATURE_STORAGE_TEXEL_BUFFER_ATOMIC_BIT | VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT;
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceFormatProperties2KHR(VkPhysicalDevice physicalDevice, VkFormat format,
+                                                                        VkFormatProperties2KHR *pFormatProperties) {
+    GetPhysicalDeviceFormatProperties(physicalDevice, format, &pFormatProperties->formatProperties);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceImageFormatProperties(VkPhysicalDevice physicalDevice, VkFormat format,
+                                                                             VkImageType type, VkImageTiling tiling,
+                                                                             VkImageUsageFlags usage, VkImageCreateFlags flags,
+                                                                             VkImageFormatProperties *pImageFormatProperties) {
+    pImageFormatProperties->maxExtent = {16384, 16384, (type == VK_IMAGE_TYPE_3D) ? 2048u : 1u};
+    pImageFormatProperties->maxMipLevels = 15;
+    pImageFormatProperties->maxArrayLayers = (type == VK_IMAGE_TYPE_3D) ? 1 : 2048;
+    pImageFormatProperties->sampleCounts = (tiling == VK_IMAGE_TILING_LINEAR) ? VK_SAMPLE_COUNT_1_BIT : 0x7F;
+    pImageFormatProperties->maxResourceSize = 4ULL * 1024 * 1024 * 1024;
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceImageFormatProperties2KHR(
+    VkPhysicalDevice physicalDevice, const VkPhysicalDeviceImageFormatInfo2KHR *pImageFormatInfo,
+    VkImageFormatProperties2KHR *pImageFormatProperties) {
+    return GetPhysicalDeviceImageFormatProperties(physicalDevice, pImageFormatInfo->format, pImageFormatInfo->type,
+                                                  pImageFormatInfo->tiling, pImageFormatInfo->usage, pImageFormatInfo->flags,
+                                                  &pImageFormatProperties->imageFormatProperties);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL CreateDevice(VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo *pCreateInfo,
+                                                   const VkAllocationCallbacks *pAllocator, VkDevice *pDevice) {
+    *pDevice = (VkDevice)CreateDispatchableHandle();
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL DestroyDevice(VkDevice device, const VkAllocationCallbacks *pAllocator) {
+    if (!device) return;
+    lock_guard_t lock(global_lock);
+    auto queues = queue_map.find(device);
+    if (queues != queue_map.end()) {
+        for (auto &queue : queues->second) {
+            DestroyDispatchableHandle(queue.second);
+        }
+        queue_map.erase(queues);
+    }
+    DestroyDispatchableHandle(device);
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetDeviceQueue(VkDevice device, uint32_t queueFamilyIndex, uint32_t queueIndex, VkQueue *pQueue) {
+    // Hand out the same queue every time it is asked for
+    lock_guard_t lock(global_lock);
+    VkQueue &queue = queue_map[device][(queueFamilyIndex << 16) | queueIndex];
+    if (!queue) queue = (VkQueue)CreateDispatchableHandle();
+    *pQueue = queue;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL AllocateCommandBuffers(VkDevice device, const VkCommandBufferAllocateInfo *pAllocateInfo,
+                                                            VkCommandBuffer *pCommandBuffers) {
+    lock_guard_t lock(global_lock);
+    std::vector<VkCommandBuffer> &pool_buffers = command_pool_map[pAllocateInfo->commandPool];
+    for (uint32_t i = 0; i < pAllocateInfo->commandBufferCount; ++i) {
+        pCommandBuffers[i] = (VkCommandBuffer)CreateDispatchableHandle();
+        pool_buffers.push_back(pCommandBuffers[i]);
+    }
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL FreeCommandBuffers(VkDevice device, VkCommandPool commandPool, uint32_t commandBufferCount,
+                                                    const VkCommandBuffer *pCommandBuffers) {
+    lock_guard_t lock(global_lock);
+    std::vector<VkCommandBuffer> &pool_buffers = command_pool_map[commandPool];
+    for (uint32_t i = 0; i < commandBufferCount; ++i) {
+        if (!pCommandBuffers[i]) continue;
+        for (auto it = pool_buffers.begin(); it != pool_buffers.end(); ++it) {
+            if (*it == pCommandBuffers[i]) {
+                pool_buffers.erase(it);
+                break;
+            }
+        }
+        DestroyDispatchableHandle(pCommandBuffers[i]);
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL DestroyCommandPool(VkDevice device, VkCommandPool commandPool,
+                                                    const VkAllocationCallbacks *pAllocator) {
+    // Command buffers still allocated from the pool are freed with it
+    lock_guard_t lock(global_lock);
+    auto pool = command_pool_map.find(commandPool);
+    if (pool == command_pool_map.end()) return;
+    for (VkCommandBuffer command_buffer : pool->second) {
+        DestroyDispatchableHandle(command_buffer);
+    }
+    command_pool_map.erase(pool);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL AllocateMemory(VkDevice device, const VkMemoryAllocateInfo *pAllocateInfo,
+                                                    const VkAllocationCallbacks *pAllocator, VkDeviceMemory *pMemory) {
+    *pMemory = (VkDeviceMemory)NewHandle();
+    lock_guard_t lock(global_lock);
+    memory_map[*pMemory] = {pAllocateInfo->allocationSize, nullptr};
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL FreeMemory(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks *pAllocator) {
+    lock_guard_t lock(global_lock);
+    auto info = memory_map.find(memory);
+    if (info == memory_map.end()) return;
+    free(info->second.data);
+    memory_map.erase(info);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL MapMemory(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size,
+                                               VkMemoryMapFlags flags, void **ppData) {
+    // Host memory backs an allocation from its first map until it is freed, so its contents survive an unmap
+    lock_guard_t lock(global_lock);
+    auto info = memory_map.find(memory);
+    if (info == memory_map.end()) return VK_ERROR_MEMORY_MAP_FAILED;
+    if (!info->second.data) {
+        info->second.data = malloc((size_t)info->second.size);
+        if (!info->second.data) return VK_ERROR_MEMORY_MAP_FAILED;
+    }
+    *ppData = static_cast<char *>(info->second.data) + offset;
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL UnmapMemory(VkDevice device, VkDeviceMemory memory) {}
+
+static VKAPI_ATTR VkResult VKAPI_CALL CreateBuffer(VkDevice device, const VkBufferCreateInfo *pCreateInfo,
+                                                  const VkAllocationCallbacks *pAllocator, VkBuffer *pBuffer) {
+    *pBuffer = (VkBuffer)NewHandle();
+    lock_guard_t lock(global_lock);
+    buffer_size_map[*pBuffer] = pCreateInfo->size;
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL DestroyBuffer(VkDevice device, VkBuffer buffer, const VkAllocationCallbacks *pAllocator) {
+    lock_guard_t lock(global_lock);
+    buffer_size_map.erase(buffer);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL CreateImage(VkDevice device, const VkImageCreateInfo *pCreateInfo,
+                                                 const VkAllocationCallbacks *pAllocator, VkImage *pImage) {
+    *pImage = (VkImage)NewHandle();
+    // One byte per texel of the top mip level, which is never more than a real driver asks for
+    VkDeviceSize size = (VkDeviceSize)pCreateInfo->extent.width * pCreateInfo->extent.height * pCreateInfo->extent.depth *
+                        pCreateInfo->arrayLayers;
+    lock_guard_t lock(global_lock);
+    image_size_map[*pImage] = size;
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL DestroyImage(VkDevice device, VkImage image, const VkAllocationCallbacks *pAllocator) {
+    lock_guard_t lock(global_lock);
+    image_size_map.erase(image);
+}
+
+// Requirements are kept as small as the object allows and any memory type will do, so that the sizes and offsets recorded
+// on real hardware always fit
+static void SetMemoryRequirements(VkDeviceSize size, VkMemoryRequirements *pMemoryRequirements) {
+    pMemoryRequirements->size = size;
+    pMemoryRequirements->alignment = 1;
+    pMemoryRequirements->memoryTypeBits = 0x7;
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetBufferMemoryRequirements(VkDevice device, VkBuffer buffer,
+                                                              VkMemoryRequirements *pMemoryRequirements) {
+    lock_guard_t lock(global_lock);
+    auto size = buffer_size_map.find(buffer);
+    SetMemoryRequirements((size == buffer_size_map.end()) ? 0 : size->second, pMemoryRequirements);
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetBufferMemoryRequirements2KHR(VkDevice device, const VkBufferMemoryRequirementsInfo2KHR *pInfo,
+                                                                  VkMemoryRequirements2KHR *pMemoryRequirements) {
+    GetBufferMemoryRequirements(device, pInfo->buffer, &pMemoryRequirements->memoryRequirements);
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetImageMemoryRequirements(VkDevice device, VkImage image,
+                                                             VkMemoryRequirements *pMemoryRequirements) {
+    lock_guard_t lock(global_lock);
+    auto size = image_size_map.find(image);
+    SetMemoryRequirements((size == image_size_map.end()) ? 0 : size->second, pMemoryRequirements);
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetImageMemoryRequirements2KHR(VkDevice device, const VkImageMemoryRequirementsInfo2KHR *pInfo,
+                                                                 VkMemoryRequirements2KHR *pMemoryRequirements) {
+    GetImageMemoryRequirements(device, pInfo->image, &pMemoryRequirements->memoryRequirements);
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetRenderAreaGranularity(VkDevice device, VkRenderPass renderPass, VkExtent2D *pGranularity) {
+    *pGranularity = {1, 1};
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL GetEventStatus(VkDevice device, VkEvent event) {
+    // Work completes as soon as it is submitted
+    return VK_EVENT_SET;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceSurfaceSupportKHR(VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex,
+                                                                         VkSurfaceKHR surface, VkBool32 *pSupported) {
+    *pSupported = VK_TRUE;
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceSurfaceCapabilitiesKHR(VkPhysicalDevice physicalDevice,
+                                                                              VkSurfaceKHR surface,
+                                                                              VkSurfaceCapabilitiesKHR *pSurfaceCapabilities) {
+    pSurfaceCapabilities->minImageCount = 1;
+    pSurfaceCapabilities->maxImageCount = 0;
+    // The extent follows whatever the swapchain asks for
+    pSurfaceCapabilities->currentExtent = {0xFFFFFFFF, 0xFFFFFFFF};
+    pSurfaceCapabilities->minImageExtent = {1, 1};
+    pSurfaceCapabilities->maxImageExtent = {16384, 16384};
+    pSurfaceCapabilities->maxImageArrayLayers = 2048;
+    pSurfaceCapabilities->supportedTransforms = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+    pSurfaceCapabilities->currentTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+    pSurfaceCapabilities->supportedCompositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR | VK_COMPOSITE_ALPHA_PRE_MULTIPLIED_BIT_KHR |
+                                                    VK_COMPOSITE_ALPHA_POST_MULTIPLIED_BIT_KHR |
+                                                    VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR;
+    pSurfaceCapabilities->supportedUsageFlags = 0xFF;
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceSurfaceFormatsKHR(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface,
+                                                                         uint32_t *pSurfaceFormatCount,
+                                                                         VkSurfaceFormatKHR *pSurfaceFormats) {
+    static const VkSurfaceFormatKHR formats[] = {
+        {VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR},
+        {VK_FORMAT_B8G8R8A8_SRGB, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR},
+        {VK_FORMAT_R8G8B8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR},
+        {VK_FORMAT_R8G8B8A8_SRGB, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR},
+    };
+    return EnumerateProperties((uint32_t)(sizeof(formats) / sizeof(formats[0])), formats, pSurfaceFormatCount, pSurfaceFormats);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceSurfacePresentModesKHR(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface,
+                                                                              uint32_t *pPresentModeCount,
+                                                                              VkPresentModeKHR *pPresentModes) {
+    static const VkPresentModeKHR present_modes[] = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR,
+                                                     VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+    return EnumerateProperties((uint32_t)(sizeof(present_modes) / sizeof(present_modes[0])), present_modes, pPresentModeCount,
+                               pPresentModes);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL CreateSwapchainKHR(VkDevice device, const VkSwapchainCreateInfoKHR *pCreateInfo,
+                                                        const VkAllocationCallbacks *pAllocator, VkSwapchainKHR *pSwapchain) {
+    *pSwapchain = (VkSwapchainKHR)NewHandle();
+    // At least as many images as were asked for, so a trace that acquired any image index can be replayed
+    uint32_t image_count = (pCreateInfo->minImageCount > icd_swapchain_image_count) ? pCreateInfo->minImageCount
+                                                                                     : icd_swapchain_image_count;
+    lock_guard_t lock(global_lock);
+    SwapchainInfo &info = swapchain_map[*pSwapchain];
+    info.next_image = 0;
+    for (uint32_t i = 0; i < image_count; ++i) {
+        info.images.push_back((VkImage)NewHandle());
+    }
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL DestroySwapchainKHR(VkDevice device, VkSwapchainKHR swapchain,
+                                                     const VkAllocationCallbacks *pAllocator) {
+    lock_guard_t lock(global_lock);
+    swapchain_map.erase(swapchain);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL GetSwapchainImagesKHR(VkDevice device, VkSwapchainKHR swapchain,
+                                                           uint32_t *pSwapchainImageCount, VkImage *pSwapchainImages) {
+    lock_guard_t lock(global_lock);
+    auto info = swapchain_map.find(swapchain);
+    if (info == swapchain_map.end()) {
+        *pSwapchainImageCount = 0;
+        return VK_SUCCESS;
+    }
+    const std::vector<VkImage> &images = info->second.images;
+    return EnumerateProperties((uint32_t)images.size(), images.data(), pSwapchainImageCount, pSwapchainImages);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL AcquireNextImageKHR(VkDevice device, VkSwapchainKHR swapchain, uint64_t timeout,
+                                                         VkSemaphore semaphore, VkFence fence, uint32_t *pImageIndex) {
+    // Images come back in order, as on a FIFO presentation engine
+    lock_guard_t lock(global_lock);
+    auto info = swapchain_map.find(swapchain);
+    if (info == swapchain_map.end() || info->second.images.empty()) {
+        *pImageIndex = 0;
+        return VK_SUCCESS;
+    }
+    *pImageIndex = info->second.next_image;
+    info->second.next_image = (info->second.next_image + 1) % (uint32_t)info->second.images.size();
+    return VK_SUCCESS;
+}
+
+}  // namespace mock_icd
+
+extern "C" {
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vk_icdNegotiateLoaderICDInterfaceVersion(uint32_t *pSupportedVersion) {
+    if (*pSupportedVersion > CURRENT_LOADER_ICD_INTERFACE_VERSION) {
+        *pSupportedVersion = CURRENT_LOADER_ICD_INTERFACE_VERSION;
+    }
+    return VK_SUCCESS;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vk_icdGetInstanceProcAddr(VkInstance instance, const char *pName) {
+    return mock_icd::GetInstanceProcAddr(instance, pName);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vk_icdGetPhysicalDeviceProcAddr(VkInstance instance, const char *pName) {
+    return mock_icd::GetInstanceProcAddr(instance, pName);
+}
+
+}  // extern "C"
@@ -138,6 +138,14 @@ extern "C" {
 
 VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVersion(VkNegotiateLayerInterface *pVersionStruct);
 
+// Fills an application's VkLayerDispatchTable with the device's entry points in
+// one call, as vkGetDeviceProcAddr would return them one at a time. tableSize
+// is the sizeof(VkLayerDispatchTable) the application was built with; entries
+// the loader doesn't know of are set to NULL.
+typedef VkResult(VKAPI_PTR *PFN_vkGetDeviceDispatchTableLUNARG)(VkDevice device, size_t tableSize,
+                                                                 VkLayerDispatchTable *pTable);
+VKAPI_ATTR VkResult VKAPI_CALL vkGetDeviceDispatchTableLUNARG(VkDevice device, size_t tableSize, VkLayerDispatchTable *pTable);
+
 #ifdef __cplusplus
 }
 #endif
@@ -47,8 +47,11 @@ std::string to_string(T var) {
 #endif
 
 void SetLayout(layer_data *device_data, GLOBAL_CB_NODE *pCB, ImageSubresourcePair imgpair, const VkImageLayout &layout) {
-    if (pCB->imageLayoutMap.find(imgpair) != pCB->imageLayoutMap.end()) {
-        pCB->imageLayoutMap[imgpair].layout = layout;
+    if (!pCB->deferred_descriptor_checks.empty()) core_validation::FlushDeferredDrawChecks(device_data, pCB);
+    auto it = pCB->imageLayoutMap.find(imgpair);
+    if (it != pCB->imageLayoutMap.end()) {
+        if (it->second.layout != layout) pCB->passed_descriptor_checks.clear();
+        it->second.layout = layout;
     } else {
         assert(imgpair.hasSubresource);
         IMAGE_CMD_BUF_LAYOUT_NODE node;
@@ -77,7 +80,7 @@ void SetLayout(layer_data *device_data, OBJECT *pObject, ImageSubresourcePair im
 }
 
 // Set the layout in supplied map
-void SetLayout(std::unordered_map<ImageSubresourcePair, IMAGE_LAYOUT_NODE> &imageLayoutMap, ImageSubresourcePair imgpair,
+void SetLayout(ImageLayoutMap<IMAGE_LAYOUT_NODE> &imageLayoutMap, ImageSubresourcePair imgpair,
                VkImageLayout layout) {
     imageLayoutMap[imgpair].layout = layout;
 }
@@ -191,7 +194,7 @@ bool FindLayouts(layer_data *device_data, VkImage image, std::vector<VkImageLayo
     }
     return true;
 }
-bool FindLayout(const std::unordered_map<ImageSubresourcePair, IMAGE_LAYOUT_NODE> &imageLayoutMap, ImageSubresourcePair imgpair,
+bool FindLayout(const ImageLayoutMap<IMAGE_LAYOUT_NODE> &imageLayoutMap, ImageSubresourcePair imgpair,
                 VkImageLayout &layout, const VkImageAspectFlags aspectMask) {
     if (!(imgpair.subresource.aspectMask & aspectMask)) {
         return false;
@@ -206,7 +209,7 @@ bool FindLayout(const std::unordered_map<ImageSubresourcePair, IMAGE_LAYOUT_NODE
 }
 
 // find layout in supplied map
-bool FindLayout(const std::unordered_map<ImageSubresourcePair, IMAGE_LAYOUT_NODE> &imageLayoutMap, ImageSubresourcePair imgpair,
+bool FindLayout(const ImageLayoutMap<IMAGE_LAYOUT_NODE> &imageLayoutMap, ImageSubresourcePair imgpair,
                 VkImageLayout &layout) {
     layout = VK_IMAGE_LAYOUT_MAX_ENUM;
     FindLayout(imageLayoutMap, imgpair, layout, VK_IMAGE_ASPECT_COLOR_BIT);
@@ -225,16 +228,22 @@ bool FindLayout(const std::unordered_map<ImageSubresourcePair, IMAGE_LAYOUT_NODE
 // Set the layout on the global level
 void SetGlobalLayout(layer_data *device_data, ImageSubresourcePair imgpair, const VkImageLayout &layout) {
     VkImage &image = imgpair.image;
-    (*core_validation::GetImageLayoutMap(device_data))[imgpair].layout = layout;
-    auto &image_subresources = (*core_validation::GetImageSubresourceMap(device_data))[image];
-    auto subresource = std::find(image_subresources.begin(), image_subresources.end(), imgpair);
-    if (subresource == image_subresources.end()) {
-        image_subresources.push_back(imgpair);
+    auto image_layout_map = core_validation::GetImageLayoutMap(device_data);
+    auto image_layout = image_layout_map->find(imgpair);
+    if (image_layout == image_layout_map->end()) {
+        // The subresource map lists the same subresources as the layout map
+        (*core_validation::GetImageSubresourceMap(device_data))[image].push_back(imgpair);
     }
+    if (image_layout == image_layout_map->end() || image_layout->second.layout != layout) {
+        (*core_validation::GetImageLayoutGeneration(device_data))++;
+    }
+    (*image_layout_map)[imgpair].layout = layout;
 }
 
 // Set the layout on the cmdbuf level
 void SetLayout(layer_data *device_data, GLOBAL_CB_NODE *pCB, ImageSubresourcePair imgpair, const IMAGE_CMD_BUF_LAYOUT_NODE &node) {
+    if (!pCB->deferred_descriptor_checks.empty()) core_validation::FlushDeferredDrawChecks(device_data, pCB);
+    pCB->passed_descriptor_checks.clear();
     pCB->imageLayoutMap[imgpair] = node;
 }
 // Set image layout for given VkImageSubresourceRange struct
@@ -298,6 +307,10 @@ bool VerifyFramebufferAndRenderPassLayouts(layer_data *device_data, GLOBAL_CB_NO
         const VkImage &image = view_state->create_info.image;
         const VkImageSubresourceRange &subRange = view_state->create_info.subresourceRange;
         auto initial_layout = pRenderPassInfo->pAttachments[i].initialLayout;
+        if (initial_layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+            // Any previous layout is allowed, so there is nothing to compare against
+            continue;
+        }
         // TODO: Do not iterate over every possibility - consolidate where possible
         for (uint32_t j = 0; j < subRange.levelCount; j++) {
             uint32_t level = subRange.baseMipLevel + j;
@@ -309,7 +322,7 @@ bool VerifyFramebufferAndRenderPassLayouts(layer_data *device_data, GLOBAL_CB_NO
                     // Missing layouts will be added during state update
                     continue;
                 }
-                if (initial_layout != VK_IMAGE_LAYOUT_UNDEFINED && initial_layout != node.layout) {
+                if (initial_layout != node.layout) {
                     skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_UNKNOWN_EXT, 0,
                                     __LINE__, DRAWSTATE_INVALID_RENDERPASS, "DS",
                                     "You cannot start a render pass using attachment %u "
@@ -338,41 +351,31 @@ void TransitionSubpassLayouts(layer_data *device_data, GLOBAL_CB_NODE *pCB, cons
     assert(render_pass_state);
 
     if (framebuffer_state) {
-        auto const &subpass = render_pass_state->createInfo.pSubpasses[subpass_index];
-        for (uint32_t j = 0; j < subpass.inputAttachmentCount; ++j) {
-            TransitionAttachmentRefLayout(device_data, pCB, framebuffer_state, subpass.pInputAttachments[j]);
-        }
-        for (uint32_t j = 0; j < subpass.colorAttachmentCount; ++j) {
-            TransitionAttachmentRefLayout(device_data, pCB, framebuffer_state, subpass.pColorAttachments[j]);
-        }
-        if (subpass.pDepthStencilAttachment) {
-            TransitionAttachmentRefLayout(device_data, pCB, framebuffer_state, *subpass.pDepthStencilAttachment);
+        for (auto const &ref : render_pass_state->subpass_attachment_refs[subpass_index]) {
+            TransitionAttachmentRefLayout(device_data, pCB, framebuffer_state, ref);
         }
     }
 }
 
+// Check the layouts the command buffer has recorded for one aspect of the subresources in range against the barrier's oldLayout
 bool ValidateImageAspectLayout(layer_data *device_data, GLOBAL_CB_NODE const *pCB, const VkImageMemoryBarrier *mem_barrier,
-                               uint32_t level, uint32_t layer, VkImageAspectFlags aspect) {
+                               const VkImageSubresourceRange &range, VkImageAspectFlags aspect) {
     if (!(mem_barrier->subresourceRange.aspectMask & aspect)) {
         return false;
     }
-    VkImageSubresource sub = {aspect, level, layer};
-    IMAGE_CMD_BUF_LAYOUT_NODE node;
-    if (!FindCmdBufLayout(device_data, pCB, mem_barrier->image, sub, node)) {
-        return false;
-    }
     bool skip = false;
-    if (mem_barrier->oldLayout == VK_IMAGE_LAYOUT_UNDEFINED) {
-        // TODO: Set memory invalid which is in mem_tracker currently
-    } else if (node.layout != mem_barrier->oldLayout) {
-        skip |=
-            log_msg(core_validation::GetReportData(device_data), VK_DEBUG_REPORT_ERROR_BIT_EXT,
-                    VK_DEBUG_REPORT_OBJECT_TYPE_COMMAND_BUFFER_EXT, HandleToUint64(pCB->commandBuffer), __LINE__,
-                    DRAWSTATE_INVALID_IMAGE_LAYOUT, "DS",
-                    "For image 0x%" PRIxLEAST64 " you cannot transition the layout of aspect %d from %s when current layout is %s.",
-                    HandleToUint64(mem_barrier->image), aspect, string_VkImageLayout(mem_barrier->oldLayout),
-                    string_VkImageLayout(node.layout));
-    }
+    pCB->imageLayoutMap.ForEachInRange(
+        mem_barrier->image, aspect, range, [&](const VkImageSubresource &, const IMAGE_CMD_BUF_LAYOUT_NODE &node) {
+            if (node.layout != mem_barrier->oldLayout) {
+                skip |= log_msg(core_validation::GetReportData(device_data), VK_DEBUG_REPORT_ERROR_BIT_EXT,
+                                VK_DEBUG_REPORT_OBJECT_TYPE_COMMAND_BUFFER_EXT, HandleToUint64(pCB->commandBuffer), __LINE__,
+                                DRAWSTATE_INVALID_IMAGE_LAYOUT, "DS",
+                                "For image 0x%" PRIxLEAST64
+                                " you cannot transition the layout of aspect %d from %s when current layout is %s.",
+                                HandleToUint64(mem_barrier->image), aspect, string_VkImageLayout(mem_barrier->oldLayout),
+                                string_VkImageLayout(node.layout));
+            }
+        });
     return skip;
 }
 
@@ -391,22 +394,28 @@ void TransitionBeginRenderPassLayouts(layer_data *device_data, GLOBAL_CB_NODE *c
     TransitionSubpassLayouts(device_data, cb_state, render_pass_state, 0, framebuffer_state);
 }
 
-void TransitionImageAspectLayout(layer_data *device_data, GLOBAL_CB_NODE *pCB, const VkImageMemoryBarrier *mem_barrier,
-                                 uint32_t level, uint32_t layer, VkImageAspectFlags aspect) {
+// Record the barrier's newLayout for one aspect of the subresources in range. Returns true if any layout changed.
+bool TransitionImageAspectLayout(GLOBAL_CB_NODE *pCB, const VkImageMemoryBarrier *mem_barrier, const VkImageSubresourceRange &range,
+                                 VkImageAspectFlags aspect) {
     if (!(mem_barrier->subresourceRange.aspectMask & aspect)) {
-        return;
-    }
-    VkImageSubresource sub = {aspect, level, layer};
-    IMAGE_CMD_BUF_LAYOUT_NODE node;
-    if (!FindCmdBufLayout(device_data, pCB, mem_barrier->image, sub, node)) {
-        SetLayout(device_data, pCB, mem_barrier->image, sub,
-                  IMAGE_CMD_BUF_LAYOUT_NODE(mem_barrier->oldLayout, mem_barrier->newLayout));
-        return;
-    }
-    if (mem_barrier->oldLayout == VK_IMAGE_LAYOUT_UNDEFINED) {
-        // TODO: Set memory invalid
+        return false;
     }
-    SetLayout(device_data, pCB, mem_barrier->image, sub, mem_barrier->newLayout);
+    bool changed = false;
+    pCB->imageLayoutMap.UpdateRange(
+        mem_barrier->image, aspect, range, [&](IMAGE_CMD_BUF_LAYOUT_NODE &node, const IMAGE_CMD_BUF_LAYOUT_NODE *found) {
+            if (!found) {
+                node = IMAGE_CMD_BUF_LAYOUT_NODE(mem_barrier->oldLayout, mem_barrier->newLayout);
+                changed = true;
+            } else if (found != &node) {
+                // Only the whole image had a layout, which this subresource starts from
+                node = IMAGE_CMD_BUF_LAYOUT_NODE(found->initialLayout, mem_barrier->newLayout);
+                changed = true;
+            } else if (node.layout != mem_barrier->newLayout) {
+                node.layout = mem_barrier->newLayout;
+                changed = true;
+            }
+        });
+    return changed;
 }
 
 bool VerifyAspectsPresent(VkImageAspectFlags aspect_mask, VkFormat format) {
@@ -522,18 +531,15 @@ bool ValidateBarriersToImages(layer_data *device_data, GLOBAL_CB_NODE const *cb_
                             aspect_mask, validation_error_map[VALIDATION_ERROR_0a00096e]);
             }
         }
-        uint32_t level_count = ResolveRemainingLevels(&img_barrier->subresourceRange, image_create_info->mipLevels);
-        uint32_t layer_count = ResolveRemainingLayers(&img_barrier->subresourceRange, image_create_info->arrayLayers);
-
-        for (uint32_t j = 0; j < level_count; j++) {
-            uint32_t level = img_barrier->subresourceRange.baseMipLevel + j;
-            for (uint32_t k = 0; k < layer_count; k++) {
-                uint32_t layer = img_barrier->subresourceRange.baseArrayLayer + k;
-                skip |= ValidateImageAspectLayout(device_data, cb_state, img_barrier, level, layer, VK_IMAGE_ASPECT_COLOR_BIT);
-                skip |= ValidateImageAspectLayout(device_data, cb_state, img_barrier, level, layer, VK_IMAGE_ASPECT_DEPTH_BIT);
-                skip |= ValidateImageAspectLayout(device_data, cb_state, img_barrier, level, layer, VK_IMAGE_ASPECT_STENCIL_BIT);
-                skip |= ValidateImageAspectLayout(device_data, cb_state, img_barrier, level, layer, VK_IMAGE_ASPECT_METADATA_BIT);
-            }
+        // Any previous layout may be transitioned from UNDEFINED, so only other old layouts are checked
+        if (img_barrier->oldLayout != VK_IMAGE_LAYOUT_UNDEFINED) {
+            VkImageSubresourceRange range = img_barrier->subresourceRange;
+            range.levelCount = ResolveRemainingLevels(&range, image_create_info->mipLevels);
+            range.layerCount = ResolveRemainingLayers(&range, image_create_info->arrayLayers);
+            skip |= ValidateImageAspectLayout(device_data, cb_state, img_barrier, range, VK_IMAGE_ASPECT_COLOR_BIT);
+            skip |= ValidateImageAspectLayout(device_data, cb_state, img_barrier, range, VK_IMAGE_ASPECT_DEPTH_BIT);
+            skip |= ValidateImageAspectLayout(device_data, cb_state, img_barrier, range, VK_IMAGE_ASPECT_STENCIL_BIT);
+            skip |= ValidateImageAspectLayout(device_data, cb_state, img_barrier, range, VK_IMAGE_ASPECT_METADATA_BIT);
         }
     }
     return skip;
@@ -542,26 +548,25 @@ bool ValidateBarriersToImages(layer_data *device_data, GLOBAL_CB_NODE const *cb_
 void TransitionImageLayouts(layer_data *device_data, VkCommandBuffer cmdBuffer, uint32_t memBarrierCount,
                             const VkImageMemoryBarrier *pImgMemBarriers) {
     GLOBAL_CB_NODE *pCB = GetCBNode(device_data, cmdBuffer);
+    if (memBarrierCount == 0) return;
 
+    // Draw checks deferred against the current layouts are settled once for all the barriers of the call
+    if (!pCB->deferred_descriptor_checks.empty()) core_validation::FlushDeferredDrawChecks(device_data, pCB);
+    bool changed = false;
     for (uint32_t i = 0; i < memBarrierCount; ++i) {
         auto mem_barrier = &pImgMemBarriers[i];
         if (!mem_barrier) continue;
 
         VkImageCreateInfo *image_create_info = &(GetImageState(device_data, mem_barrier->image)->createInfo);
-        uint32_t level_count = ResolveRemainingLevels(&mem_barrier->subresourceRange, image_create_info->mipLevels);
-        uint32_t layer_count = ResolveRemainingLayers(&mem_barrier->subresourceRange, image_create_info->arrayLayers);
-
-        for (uint32_t j = 0; j < level_count; j++) {
-            uint32_t level = mem_barrier->subresourceRange.baseMipLevel + j;
-            for (uint32_t k = 0; k < layer_count; k++) {
-                uint32_t layer = mem_barrier->subresourceRange.baseArrayLayer + k;
-                TransitionImageAspectLayout(device_data, pCB, mem_barrier, level, layer, VK_IMAGE_ASPECT_COLOR_BIT);
-                TransitionImageAspectLayout(device_data, pCB, mem_barrier, level, layer, VK_IMAGE_ASPECT_DEPTH_BIT);
-                TransitionImageAspectLayout(device_data, pCB, mem_barrier, level, layer, VK_IMAGE_ASPECT_STENCIL_BIT);
-                TransitionImageAspectLayout(device_data, pCB, mem_barrier, level, layer, VK_IMAGE_ASPECT_METADATA_BIT);
-            }
-        }
+        VkImageSubresourceRange range = mem_barrier->subresourceRange;
+        range.levelCount = ResolveRemainingLevels(&range, image_create_info->mipLevels);
+        range.layerCount = ResolveRemainingLayers(&range, image_create_info->arrayLayers);
+        changed |= TransitionImageAspectLayout(pCB, mem_barrier, range, VK_IMAGE_ASPECT_COLOR_BIT);
+        changed |= TransitionImageAspectLayout(pCB, mem_barrier, range, VK_IMAGE_ASPECT_DEPTH_BIT);
+        changed |= TransitionImageAspectLayout(pCB, mem_barrier, range, VK_IMAGE_ASPECT_STENCIL_BIT);
+        changed |= TransitionImageAspectLayout(pCB, mem_barrier, range, VK_IMAGE_ASPECT_METADATA_BIT);
     }
+    if (changed) pCB->passed_descriptor_checks.clear();
 }
 
 bool VerifyImageLayout(layer_data const *device_data, GLOBAL_CB_NODE const *cb_node, IMAGE_STATE *image_state,
@@ -857,7 +862,7 @@ bool PreCallValidateDestroyImage(layer_data *device_data, VkImage image, IMAGE_S
 }
 
 void PostCallRecordDestroyImage(layer_data *device_data, VkImage image, IMAGE_STATE *image_state, VK_OBJECT obj_struct) {
-    core_validation::invalidateCommandBuffers(device_data, image_state->cb_bindings, obj_struct);
+    core_validation::recordDestroyedObject(device_data, obj_struct);
     // Clean up memory mapping, bindings and range references for image
     for (auto mem_binding : image_state->GetBoundMemory()) {
         auto mem_info = core_validation::GetMemObjInfo(device_data, mem_binding);
@@ -1053,11 +1058,7 @@ void PreCallRecordCmdClearImage(layer_data *dev_data, VkCommandBuffer commandBuf
     auto image_state = GetImageState(dev_data, image);
     if (cb_node && image_state) {
         AddCommandBufferBindingImage(dev_data, cb_node, image_state);
-        std::function<bool()> function = [=]() {
-            SetImageMemoryValid(dev_data, image_state, true);
-            return false;
-        };
-        cb_node->queue_submit_functions.push_back(function);
+        core_validation::DeferImageMemoryValid(cb_node, image_state, true);
         for (uint32_t i = 0; i < rangeCount; ++i) {
             RecordClearImageLayout(dev_data, cb_node, image, pRanges[i], imageLayout);
         }
@@ -1223,6 +1224,29 @@ static inline VkExtent3D GetScaledItg(layer_data *device_data, const GLOBAL_CB_N
     return granularity;
 }
 
+// Properties of an image that every region of a copy command checks, looked up once per command
+struct COPY_IMAGE_INFO {
+    const IMAGE_STATE *image_state;
+    VkImageType image_type;
+    VkFormat format;
+    bool compressed;
+    VkExtent3D block_extent;  // (1, 1, 1) unless compressed
+    size_t format_size;
+    VkExtent3D granularity;  // Image transfer granularity of the command buffer's queue family, scaled by block_extent
+};
+
+static COPY_IMAGE_INFO GetCopyImageInfo(layer_data *device_data, const GLOBAL_CB_NODE *cb_node, const IMAGE_STATE *image_state) {
+    COPY_IMAGE_INFO info;
+    info.image_state = image_state;
+    info.image_type = image_state->createInfo.imageType;
+    info.format = image_state->createInfo.format;
+    info.compressed = FormatIsCompressed(info.format);
+    info.block_extent = info.compressed ? FormatCompressedTexelBlockExtent(info.format) : VkExtent3D{1, 1, 1};
+    info.format_size = FormatSize(info.format);
+    info.granularity = GetScaledItg(device_data, cb_node, image_state);
+    return info;
+}
+
 // Test elements of a VkExtent3D structure against alignment constraints contained in another VkExtent3D structure
 static inline bool IsExtentAligned(const VkExtent3D *extent, const VkExtent3D *granularity) {
     bool valid = true;
@@ -1359,11 +1383,12 @@ static inline bool CheckItgSize(layer_data *device_data, const GLOBAL_CB_NODE *c
 }
 
 // Check valid usage Image Tranfer Granularity requirements for elements of a VkBufferImageCopy structure
-bool ValidateCopyBufferImageTransferGranularityRequirements(layer_data *device_data, const GLOBAL_CB_NODE *cb_node,
-                                                            const IMAGE_STATE *img, const VkBufferImageCopy *region,
-                                                            const uint32_t i, const char *function) {
+static bool ValidateCopyBufferImageTransferGranularityRequirements(layer_data *device_data, const GLOBAL_CB_NODE *cb_node,
+                                                                   const COPY_IMAGE_INFO &info, const VkBufferImageCopy &region,
+                                                                   const VkExtent3D &mip_extent, const uint32_t i,
+                                                                   const char *function) {
     bool skip = false;
-    if (FormatIsCompressed(img->createInfo.format) == true) {
+    if (info.compressed) {
         // TODO: Add granularity checking for compressed formats
 
         // bufferRowLength must be a multiple of the compressed texel block width
@@ -1377,41 +1402,41 @@ bool ValidateCopyBufferImageTransferGranularityRequirements(layer_data *device_d
         // imageExtent.depth must be a multiple of the compressed texel block depth or (imageExtent.depth + imageOffset.z)
         //     must equal the image subresource depth
     } else {
-        VkExtent3D granularity = GetScaledItg(device_data, cb_node, img);
-        skip |= CheckItgSize(device_data, cb_node, region->bufferOffset, granularity.width, i, function, "bufferOffset");
-        skip |= CheckItgInt(device_data, cb_node, region->bufferRowLength, granularity.width, i, function, "bufferRowLength");
-        skip |= CheckItgInt(device_data, cb_node, region->bufferImageHeight, granularity.width, i, function, "bufferImageHeight");
-        skip |= CheckItgOffset(device_data, cb_node, &region->imageOffset, &granularity, i, function, "imageOffset");
-        VkExtent3D subresource_extent = GetImageSubresourceExtent(img, &region->imageSubresource);
-        skip |= CheckItgExtent(device_data, cb_node, &region->imageExtent, &region->imageOffset, &granularity, &subresource_extent,
-                               img->createInfo.imageType, i, function, "imageExtent");
+        const VkExtent3D &granularity = info.granularity;
+        skip |= CheckItgSize(device_data, cb_node, region.bufferOffset, granularity.width, i, function, "bufferOffset");
+        skip |= CheckItgInt(device_data, cb_node, region.bufferRowLength, granularity.width, i, function, "bufferRowLength");
+        skip |= CheckItgInt(device_data, cb_node, region.bufferImageHeight, granularity.width, i, function, "bufferImageHeight");
+        skip |= CheckItgOffset(device_data, cb_node, &region.imageOffset, &granularity, i, function, "imageOffset");
+        skip |= CheckItgExtent(device_data, cb_node, &region.imageExtent, &region.imageOffset, &granularity, &mip_extent,
+                               info.image_type, i, function, "imageExtent");
     }
     return skip;
 }
 
 // Check valid usage Image Tranfer Granularity requirements for elements of a VkImageCopy structure
-bool ValidateCopyImageTransferGranularityRequirements(layer_data *device_data, const GLOBAL_CB_NODE *cb_node,
-                                                      const IMAGE_STATE *src_img, const IMAGE_STATE *dst_img,
-                                                      const VkImageCopy *region, const uint32_t i, const char *function) {
+static bool ValidateCopyImageTransferGranularityRequirements(layer_data *device_data, const GLOBAL_CB_NODE *cb_node,
+                                                             const COPY_IMAGE_INFO &src_info, const COPY_IMAGE_INFO &dst_info,
+                                                             const VkImageCopy &region, const uint32_t i, const char *function) {
     bool skip = false;
-    VkExtent3D granularity = GetScaledItg(device_data, cb_node, src_img);
-    skip |= CheckItgOffset(device_data, cb_node, &region->srcOffset, &granularity, i, function, "srcOffset");
-    VkExtent3D subresource_extent = GetImageSubresourceExtent(src_img, &region->srcSubresource);
-    skip |= CheckItgExtent(device_data, cb_node, &region->extent, &region->srcOffset, &granularity, &subresource_extent,
-                           src_img->createInfo.imageType, i, function, "extent");
-
-    granularity = GetScaledItg(device_data, cb_node, dst_img);
-    skip |= CheckItgOffset(device_data, cb_node, &region->dstOffset, &granularity, i, function, "dstOffset");
-    subresource_extent = GetImageSubresourceExtent(dst_img, &region->dstSubresource);
-    skip |= CheckItgExtent(device_data, cb_node, &region->extent, &region->dstOffset, &granularity, &subresource_extent,
-                           dst_img->createInfo.imageType, i, function, "extent");
+    skip |= CheckItgOffset(device_data, cb_node, &region.srcOffset, &src_info.granularity, i, function, "srcOffset");
+    VkExtent3D subresource_extent = GetImageSubresourceExtent(src_info.image_state, &region.srcSubresource);
+    skip |= CheckItgExtent(device_data, cb_node, &region.extent, &region.srcOffset, &src_info.granularity, &subresource_extent,
+                           src_info.image_type, i, function, "extent");
+
+    skip |= CheckItgOffset(device_data, cb_node, &region.dstOffset, &dst_info.granularity, i, function, "dstOffset");
+    subresource_extent = GetImageSubresourceExtent(dst_info.image_state, &region.dstSubresource);
+    skip |= CheckItgExtent(device_data, cb_node, &region.extent, &region.dstOffset, &dst_info.granularity, &subresource_extent,
+                           dst_info.image_type, i, function, "extent");
     return skip;
 }
 
 // Validate contents of a VkImageCopy struct
-bool ValidateImageCopyData(const layer_data *device_data, const debug_report_data *report_data, const uint32_t regionCount,
-                           const VkImageCopy *ic_regions, const IMAGE_STATE *src_state, const IMAGE_STATE *dst_state) {
+static bool ValidateImageCopyData(const layer_data *device_data, const debug_report_data *report_data, const uint32_t regionCount,
+                                  const VkImageCopy *ic_regions, const COPY_IMAGE_INFO &src_info,
+                                  const COPY_IMAGE_INFO &dst_info) {
     bool skip = false;
+    const IMAGE_STATE *src_state = src_info.image_state;
+    const IMAGE_STATE *dst_state = dst_info.image_state;
 
     for (uint32_t i = 0; i < regionCount; i++) {
         VkImageCopy image_copy = ic_regions[i];
@@ -1493,8 +1518,8 @@ bool ValidateImageCopyData(const layer_data *device_data, const debug_report_dat
         }
 
         // Checks that apply only to compressed images
-        if (FormatIsCompressed(src_state->createInfo.format)) {
-            VkExtent3D block_size = FormatCompressedTexelBlockExtent(src_state->createInfo.format);
+        if (src_info.compressed) {
+            const VkExtent3D &block_size = src_info.block_extent;
 
             //  image offsets must be multiples of block dimensions
             if ((SafeModulo(image_copy.srcOffset.x, block_size.width) != 0) ||
@@ -1621,8 +1646,8 @@ bool ValidateImageCopyData(const layer_data *device_data, const debug_report_dat
         }
 
         // Checks that apply only to compressed images
-        if (FormatIsCompressed(dst_state->createInfo.format)) {
-            VkExtent3D block_size = FormatCompressedTexelBlockExtent(dst_state->createInfo.format);
+        if (dst_info.compressed) {
+            const VkExtent3D &block_size = dst_info.block_extent;
 
             //  image offsets must be multiples of block dimensions
             if ((SafeModulo(image_copy.dstOffset.x, block_size.width) != 0) ||
@@ -1682,7 +1707,9 @@ bool PreCallValidateCmdCopyImage(layer_data *device_data, GLOBAL_CB_NODE *cb_nod
                                  VkImageLayout src_image_layout, VkImageLayout dst_image_layout) {
     bool skip = false;
     const debug_report_data *report_data = core_validation::GetReportData(device_data);
-    skip = ValidateImageCopyData(device_data, report_data, region_count, regions, src_image_state, dst_image_state);
+    const COPY_IMAGE_INFO src_info = GetCopyImageInfo(device_data, cb_node, src_image_state);
+    const COPY_IMAGE_INFO dst_info = GetCopyImageInfo(device_data, cb_node, dst_image_state);
+    skip = ValidateImageCopyData(device_data, report_data, region_count, regions, src_info, dst_info);
 
     VkCommandBuffer command_buffer = cb_node->commandBuffer;
 
@@ -1987,8 +2014,8 @@ bool PreCallValidateCmdCopyImage(layer_data *device_data, GLOBAL_CB_NODE *cb_nod
                                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, "vkCmdCopyImage()", VALIDATION_ERROR_19000102, &hit_error);
         skip |= VerifyImageLayout(device_data, cb_node, dst_image_state, regions[i].dstSubresource, dst_image_layout,
                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, "vkCmdCopyImage()", VALIDATION_ERROR_1900010c, &hit_error);
-        skip |= ValidateCopyImageTransferGranularityRequirements(device_data, cb_node, src_image_state, dst_image_state,
-                                                                 &regions[i], i, "vkCmdCopyImage()");
+        skip |= ValidateCopyImageTransferGranularityRequirements(device_data, cb_node, src_info, dst_info, regions[i], i,
+                                                                 "vkCmdCopyImage()");
     }
 
     return skip;
@@ -2005,13 +2032,8 @@ void PreCallRecordCmdCopyImage(layer_data *device_data, GLOBAL_CB_NODE *cb_node,
     // Update bindings between images and cmd buffer
     AddCommandBufferBindingImage(device_data, cb_node, src_image_state);
     AddCommandBufferBindingImage(device_data, cb_node, dst_image_state);
-    std::function<bool()> function = [=]() { return ValidateImageMemoryIsValid(device_data, src_image_state, "vkCmdCopyImage()"); };
-    cb_node->queue_submit_functions.push_back(function);
-    function = [=]() {
-        SetImageMemoryValid(device_data, dst_image_state, true);
-        return false;
-    };
-    cb_node->queue_submit_functions.push_back(function);
+    core_validation::DeferImageMemoryCheck(cb_node, src_image_state, "vkCmdCopyImage()");
+    core_validation::DeferImageMemoryValid(cb_node, dst_image_state, true);
 }
 
 // Returns true if sub_rect is entirely contained within rect
@@ -2219,15 +2241,8 @@ void PreCallRecordCmdResolveImage(layer_data *device_data, GLOBAL_CB_NODE *cb_no
     AddCommandBufferBindingImage(device_data, cb_node, src_image_state);
     AddCommandBufferBindingImage(device_data, cb_node, dst_image_state);
 
-    std::function<bool()> function = [=]() {
-        return ValidateImageMemoryIsValid(device_data, src_image_state, "vkCmdResolveImage()");
-    };
-    cb_node->queue_submit_functions.push_back(function);
-    function = [=]() {
-        SetImageMemoryValid(device_data, dst_image_state, true);
-        return false;
-    };
-    cb_node->queue_submit_functions.push_back(function);
+    core_validation::DeferImageMemoryCheck(cb_node, src_image_state, "vkCmdResolveImage()");
+    core_validation::DeferImageMemoryValid(cb_node, dst_image_state, true);
 }
 
 bool PreCallValidateCmdBlitImage(layer_data *device_data, GLOBAL_CB_NODE *cb_node, IMAGE_STATE *src_image_state,
@@ -2605,23 +2620,29 @@ void PreCallRecordCmdBlitImage(layer_data *device_data, GLOBAL_CB_NODE *cb_node,
     AddCommandBufferBindingImage(device_data, cb_node, src_image_state);
     AddCommandBufferBindingImage(device_data, cb_node, dst_image_state);
 
-    std::function<bool()> function = [=]() { return ValidateImageMemoryIsValid(device_data, src_image_state, "vkCmdBlitImage()"); };
-    cb_node->queue_submit_functions.push_back(function);
-    function = [=]() {
-        SetImageMemoryValid(device_data, dst_image_state, true);
-        return false;
-    };
-    cb_node->queue_submit_functions.push_back(function);
+    core_validation::DeferImageMemoryCheck(cb_node, src_image_state, "vkCmdBlitImage()");
+    core_validation::DeferImageMemoryValid(cb_node, dst_image_state, true);
 }
 
 // This validates that the initial layout specified in the command buffer for
 // the IMAGE is the same
 // as the global IMAGE layout
 bool ValidateCmdBufImageLayouts(layer_data *device_data, GLOBAL_CB_NODE *pCB,
-                                std::unordered_map<ImageSubresourcePair, IMAGE_LAYOUT_NODE> const & globalImageLayoutMap,
-                                std::unordered_map<ImageSubresourcePair, IMAGE_LAYOUT_NODE> & overlayLayoutMap) {
+                                ImageLayoutMap<IMAGE_LAYOUT_NODE> const & globalImageLayoutMap,
+                                ImageLayoutMap<IMAGE_LAYOUT_NODE> & overlayLayoutMap) {
+    CheckProfileScope profile(device_data, CHECK_PROFILE_CMD_BUF_IMAGE_LAYOUTS);
     bool skip = false;
     const debug_report_data *report_data = core_validation::GetReportData(device_data);
+    // Unless an earlier command buffer of this submission changed layouts, the result only depends on the global ones
+    uint64_t generation = *core_validation::GetImageLayoutGeneration(device_data);
+    bool cacheable = overlayLayoutMap.empty();
+    if (cacheable && pCB->image_layouts_validated_generation == generation) {
+        for (auto const &validated_layout : pCB->validated_image_layouts) {
+            SetLayout(overlayLayoutMap, validated_layout.first, validated_layout.second);
+        }
+        return skip;
+    }
+    pCB->validated_image_layouts.clear();
     for (auto cb_image_data : pCB->imageLayoutMap) {
         VkImageLayout imageLayout;
 
@@ -2650,8 +2671,10 @@ bool ValidateCmdBufImageLayouts(layer_data *device_data, GLOBAL_CB_NODE *pCB,
                 }
             }
             SetLayout(overlayLayoutMap, cb_image_data.first, cb_image_data.second.layout);
+            pCB->validated_image_layouts.emplace_back(cb_image_data.first, cb_image_data.second.layout);
         }
     }
+    pCB->image_layouts_validated_generation = (cacheable && !skip) ? generation : 0;
     return skip;
 }
 
@@ -3467,15 +3490,8 @@ void PreCallRecordCmdCopyBuffer(layer_data *device_data, GLOBAL_CB_NODE *cb_node
     AddCommandBufferBindingBuffer(device_data, cb_node, src_buffer_state);
     AddCommandBufferBindingBuffer(device_data, cb_node, dst_buffer_state);
 
-    std::function<bool()> function = [=]() {
-        return ValidateBufferMemoryIsValid(device_data, src_buffer_state, "vkCmdCopyBuffer()");
-    };
-    cb_node->queue_submit_functions.push_back(function);
-    function = [=]() {
-        SetBufferMemoryValid(device_data, dst_buffer_state, true);
-        return false;
-    };
-    cb_node->queue_submit_functions.push_back(function);
+    core_validation::DeferBufferMemoryCheck(cb_node, src_buffer_state, "vkCmdCopyBuffer()");
+    core_validation::DeferBufferMemoryValid(cb_node, dst_buffer_state, true);
 }
 
 static bool validateIdleBuffer(layer_data *device_data, VkBuffer buffer) {
@@ -3513,7 +3529,7 @@ bool PreCallValidateDestroyImageView(layer_data *device_data, VkImageView image_
 void PostCallRecordDestroyImageView(layer_data *device_data, VkImageView image_view, IMAGE_VIEW_STATE *image_view_state,
                                     VK_OBJECT obj_struct) {
     // Any bound cmd buffers are now invalid
-    invalidateCommandBuffers(device_data, image_view_state->cb_bindings, obj_struct);
+    recordDestroyedObject(device_data, obj_struct);
     (*GetImageViewMap(device_data)).erase(image_view);
 }
 
@@ -3529,7 +3545,7 @@ bool PreCallValidateDestroyBuffer(layer_data *device_data, VkBuffer buffer, BUFF
 }
 
 void PostCallRecordDestroyBuffer(layer_data *device_data, VkBuffer buffer, BUFFER_STATE *buffer_state, VK_OBJECT obj_struct) {
-    invalidateCommandBuffers(device_data, buffer_state->cb_bindings, obj_struct);
+    recordDestroyedObject(device_data, obj_struct);
     for (auto mem_binding : buffer_state->GetBoundMemory()) {
         auto mem_info = GetMemObjInfo(device_data, mem_binding);
         if (mem_info) {
@@ -3556,7 +3572,7 @@ bool PreCallValidateDestroyBufferView(layer_data *device_data, VkBufferView buff
 void PostCallRecordDestroyBufferView(layer_data *device_data, VkBufferView buffer_view, BUFFER_VIEW_STATE *buffer_view_state,
                                      VK_OBJECT obj_struct) {
     // Any bound cmd buffers are now invalid
-    invalidateCommandBuffers(device_data, buffer_view_state->cb_bindings, obj_struct);
+    recordDestroyedObject(device_data, obj_struct);
     GetBufferViewMap(device_data)->erase(buffer_view);
 }
 
@@ -3574,317 +3590,331 @@ bool PreCallValidateCmdFillBuffer(layer_data *device_data, GLOBAL_CB_NODE *cb_no
 }
 
 void PreCallRecordCmdFillBuffer(layer_data *device_data, GLOBAL_CB_NODE *cb_node, BUFFER_STATE *buffer_state) {
-    std::function<bool()> function = [=]() {
-        SetBufferMemoryValid(device_data, buffer_state, true);
-        return false;
-    };
-    cb_node->queue_submit_functions.push_back(function);
+    core_validation::DeferBufferMemoryValid(cb_node, buffer_state, true);
     // Update bindings between buffer and cmd buffer
     AddCommandBufferBindingBuffer(device_data, cb_node, buffer_state);
 }
 
-bool ValidateBufferImageCopyData(const debug_report_data *report_data, uint32_t regionCount, const VkBufferImageCopy *pRegions,
-                                 IMAGE_STATE *image_state, const char *function) {
+// Validate one region of a vkCmdCopyBufferToImage or vkCmdCopyImageToBuffer against its image, with mip_extent the extent of
+// its image subresource
+static bool ValidateBufferImageCopyRegion(const debug_report_data *report_data, const COPY_IMAGE_INFO &info,
+                                          const VkBufferImageCopy &region, const VkExtent3D &mip_extent, uint32_t i,
+                                          const char *function) {
     bool skip = false;
 
-    for (uint32_t i = 0; i < regionCount; i++) {
-        if (image_state->createInfo.imageType == VK_IMAGE_TYPE_1D) {
-            if ((pRegions[i].imageOffset.y != 0) || (pRegions[i].imageExtent.height != 1)) {
-                skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
-                                HandleToUint64(image_state->image), __LINE__, VALIDATION_ERROR_0160018e, "IMAGE",
-                                "%s(): pRegion[%d] imageOffset.y is %d and imageExtent.height is %d. For 1D images these "
-                                "must be 0 and 1, respectively. %s",
-                                function, i, pRegions[i].imageOffset.y, pRegions[i].imageExtent.height,
-                                validation_error_map[VALIDATION_ERROR_0160018e]);
-            }
-        }
-
-        if ((image_state->createInfo.imageType == VK_IMAGE_TYPE_1D) || (image_state->createInfo.imageType == VK_IMAGE_TYPE_2D)) {
-            if ((pRegions[i].imageOffset.z != 0) || (pRegions[i].imageExtent.depth != 1)) {
-                skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
-                                HandleToUint64(image_state->image), __LINE__, VALIDATION_ERROR_01600192, "IMAGE",
-                                "%s(): pRegion[%d] imageOffset.z is %d and imageExtent.depth is %d. For 1D and 2D images these "
-                                "must be 0 and 1, respectively. %s",
-                                function, i, pRegions[i].imageOffset.z, pRegions[i].imageExtent.depth,
-                                validation_error_map[VALIDATION_ERROR_01600192]);
-            }
-        }
-
-        if (image_state->createInfo.imageType == VK_IMAGE_TYPE_3D) {
-            if ((0 != pRegions[i].imageSubresource.baseArrayLayer) || (1 != pRegions[i].imageSubresource.layerCount)) {
-                skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
-                                HandleToUint64(image_state->image), __LINE__, VALIDATION_ERROR_016001aa, "IMAGE",
-                                "%s(): pRegion[%d] imageSubresource.baseArrayLayer is %d and imageSubresource.layerCount is "
-                                "%d. For 3D images these must be 0 and 1, respectively. %s",
-                                function, i, pRegions[i].imageSubresource.baseArrayLayer, pRegions[i].imageSubresource.layerCount,
-                                validation_error_map[VALIDATION_ERROR_016001aa]);
-            }
+    if (info.image_type == VK_IMAGE_TYPE_1D) {
+        if ((region.imageOffset.y != 0) || (region.imageExtent.height != 1)) {
+            skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
+                            HandleToUint64(info.image_state->image), __LINE__, VALIDATION_ERROR_0160018e, "IMAGE",
+                            "%s: pRegion[%d] imageOffset.y is %d and imageExtent.height is %d. For 1D images these "
+                            "must be 0 and 1, respectively. %s",
+                            function, i, region.imageOffset.y, region.imageExtent.height,
+                            validation_error_map[VALIDATION_ERROR_0160018e]);
         }
+    }
 
-        // If the the calling command's VkImage parameter's format is not a depth/stencil format,
-        // then bufferOffset must be a multiple of the calling command's VkImage parameter's texel size
-        auto texel_size = FormatSize(image_state->createInfo.format);
-        if (!FormatIsDepthAndStencil(image_state->createInfo.format) && SafeModulo(pRegions[i].bufferOffset, texel_size) != 0) {
+    if ((info.image_type == VK_IMAGE_TYPE_1D) || (info.image_type == VK_IMAGE_TYPE_2D)) {
+        if ((region.imageOffset.z != 0) || (region.imageExtent.depth != 1)) {
             skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
-                            HandleToUint64(image_state->image), __LINE__, VALIDATION_ERROR_01600182, "IMAGE",
-                            "%s(): pRegion[%d] bufferOffset 0x%" PRIxLEAST64
-                            " must be a multiple of this format's texel size (" PRINTF_SIZE_T_SPECIFIER "). %s",
-                            function, i, pRegions[i].bufferOffset, texel_size, validation_error_map[VALIDATION_ERROR_01600182]);
+                            HandleToUint64(info.image_state->image), __LINE__, VALIDATION_ERROR_01600192, "IMAGE",
+                            "%s: pRegion[%d] imageOffset.z is %d and imageExtent.depth is %d. For 1D and 2D images these "
+                            "must be 0 and 1, respectively. %s",
+                            function, i, region.imageOffset.z, region.imageExtent.depth,
+                            validation_error_map[VALIDATION_ERROR_01600192]);
         }
+    }
 
-        //  BufferOffset must be a multiple of 4
-        if (SafeModulo(pRegions[i].bufferOffset, 4) != 0) {
+    if (info.image_type == VK_IMAGE_TYPE_3D) {
+        if ((0 != region.imageSubresource.baseArrayLayer) || (1 != region.imageSubresource.layerCount)) {
             skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
-                            HandleToUint64(image_state->image), __LINE__, VALIDATION_ERROR_01600184, "IMAGE",
-                            "%s(): pRegion[%d] bufferOffset 0x%" PRIxLEAST64 " must be a multiple of 4. %s", function, i,
-                            pRegions[i].bufferOffset, validation_error_map[VALIDATION_ERROR_01600184]);
+                            HandleToUint64(info.image_state->image), __LINE__, VALIDATION_ERROR_016001aa, "IMAGE",
+                            "%s: pRegion[%d] imageSubresource.baseArrayLayer is %d and imageSubresource.layerCount is "
+                            "%d. For 3D images these must be 0 and 1, respectively. %s",
+                            function, i, region.imageSubresource.baseArrayLayer, region.imageSubresource.layerCount,
+                            validation_error_map[VALIDATION_ERROR_016001aa]);
         }
+    }
 
-        //  BufferRowLength must be 0, or greater than or equal to the width member of imageExtent
-        if ((pRegions[i].bufferRowLength != 0) && (pRegions[i].bufferRowLength < pRegions[i].imageExtent.width)) {
-            skip |= log_msg(
-                report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
-                HandleToUint64(image_state->image), __LINE__, VALIDATION_ERROR_01600186, "IMAGE",
-                "%s(): pRegion[%d] bufferRowLength (%d) must be zero or greater-than-or-equal-to imageExtent.width (%d). %s",
-                function, i, pRegions[i].bufferRowLength, pRegions[i].imageExtent.width,
-                validation_error_map[VALIDATION_ERROR_01600186]);
-        }
+    // If the the calling command's VkImage parameter's format is not a depth/stencil format,
+    // then bufferOffset must be a multiple of the calling command's VkImage parameter's texel size
+    size_t texel_size = info.format_size;
+    if (!FormatIsDepthAndStencil(info.format) && SafeModulo(region.bufferOffset, texel_size) != 0) {
+        skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
+                        HandleToUint64(info.image_state->image), __LINE__, VALIDATION_ERROR_01600182, "IMAGE",
+                        "%s: pRegion[%d] bufferOffset 0x%" PRIxLEAST64
+                        " must be a multiple of this format's texel size (" PRINTF_SIZE_T_SPECIFIER "). %s",
+                        function, i, region.bufferOffset, texel_size, validation_error_map[VALIDATION_ERROR_01600182]);
+    }
 
-        //  BufferImageHeight must be 0, or greater than or equal to the height member of imageExtent
-        if ((pRegions[i].bufferImageHeight != 0) && (pRegions[i].bufferImageHeight < pRegions[i].imageExtent.height)) {
+    //  BufferOffset must be a multiple of 4
+    if (SafeModulo(region.bufferOffset, 4) != 0) {
+        skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
+                        HandleToUint64(info.image_state->image), __LINE__, VALIDATION_ERROR_01600184, "IMAGE",
+                        "%s: pRegion[%d] bufferOffset 0x%" PRIxLEAST64 " must be a multiple of 4. %s", function, i,
+                        region.bufferOffset, validation_error_map[VALIDATION_ERROR_01600184]);
+    }
+
+    //  BufferRowLength must be 0, or greater than or equal to the width member of imageExtent
+    if ((region.bufferRowLength != 0) && (region.bufferRowLength < region.imageExtent.width)) {
+        skip |= log_msg(
+            report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
+            HandleToUint64(info.image_state->image), __LINE__, VALIDATION_ERROR_01600186, "IMAGE",
+            "%s: pRegion[%d] bufferRowLength (%d) must be zero or greater-than-or-equal-to imageExtent.width (%d). %s",
+            function, i, region.bufferRowLength, region.imageExtent.width,
+            validation_error_map[VALIDATION_ERROR_01600186]);
+    }
+
+    //  BufferImageHeight must be 0, or greater than or equal to the height member of imageExtent
+    if ((region.bufferImageHeight != 0) && (region.bufferImageHeight < region.imageExtent.height)) {
+        skip |= log_msg(
+            report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
+            HandleToUint64(info.image_state->image), __LINE__, VALIDATION_ERROR_01600188, "IMAGE",
+            "%s: pRegion[%d] bufferImageHeight (%d) must be zero or greater-than-or-equal-to imageExtent.height (%d). %s",
+            function, i, region.bufferImageHeight, region.imageExtent.height,
+            validation_error_map[VALIDATION_ERROR_01600188]);
+    }
+
+    // subresource aspectMask must have exactly 1 bit set
+    const int num_bits = sizeof(VkFlags) * CHAR_BIT;
+    std::bitset<num_bits> aspect_mask_bits(region.imageSubresource.aspectMask);
+    if (aspect_mask_bits.count() != 1) {
+        skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
+                        HandleToUint64(info.image_state->image), __LINE__, VALIDATION_ERROR_016001a8, "IMAGE",
+                        "%s: aspectMasks for imageSubresource in each region must have only a single bit set. %s", function,
+                        validation_error_map[VALIDATION_ERROR_016001a8]);
+    }
+
+    // image subresource aspect bit must match format
+    if (!VerifyAspectsPresent(region.imageSubresource.aspectMask, info.format)) {
+        skip |= log_msg(
+            report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
+            HandleToUint64(info.image_state->image), __LINE__, VALIDATION_ERROR_016001a6, "IMAGE",
+            "%s: pRegion[%d] subresource aspectMask 0x%x specifies aspects that are not present in image format 0x%x. %s",
+            function, i, region.imageSubresource.aspectMask, info.format,
+            validation_error_map[VALIDATION_ERROR_016001a6]);
+    }
+
+    // Checks that apply only to compressed images
+    // TODO: there is a comment in ValidateCopyBufferImageTransferGranularityRequirements() in core_validation.cpp that
+    //       reserves a place for these compressed image checks.  This block of code could move there once the image
+    //       stuff is moved into core validation.
+    if (info.compressed) {
+        const VkExtent3D &block_size = info.block_extent;
+
+        //  BufferRowLength must be a multiple of block width
+        if (SafeModulo(region.bufferRowLength, block_size.width) != 0) {
             skip |= log_msg(
                 report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
-                HandleToUint64(image_state->image), __LINE__, VALIDATION_ERROR_01600188, "IMAGE",
-                "%s(): pRegion[%d] bufferImageHeight (%d) must be zero or greater-than-or-equal-to imageExtent.height (%d). %s",
-                function, i, pRegions[i].bufferImageHeight, pRegions[i].imageExtent.height,
-                validation_error_map[VALIDATION_ERROR_01600188]);
+                HandleToUint64(info.image_state->image), __LINE__, VALIDATION_ERROR_01600196, "IMAGE",
+                "%s: pRegion[%d] bufferRowLength (%d) must be a multiple of the compressed image's texel width (%d). %s.",
+                function, i, region.bufferRowLength, block_size.width, validation_error_map[VALIDATION_ERROR_01600196]);
         }
 
-        // subresource aspectMask must have exactly 1 bit set
-        const int num_bits = sizeof(VkFlags) * CHAR_BIT;
-        std::bitset<num_bits> aspect_mask_bits(pRegions[i].imageSubresource.aspectMask);
-        if (aspect_mask_bits.count() != 1) {
+        //  BufferRowHeight must be a multiple of block height
+        if (SafeModulo(region.bufferImageHeight, block_size.height) != 0) {
             skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
-                            HandleToUint64(image_state->image), __LINE__, VALIDATION_ERROR_016001a8, "IMAGE",
-                            "%s: aspectMasks for imageSubresource in each region must have only a single bit set. %s", function,
-                            validation_error_map[VALIDATION_ERROR_016001a8]);
+                            HandleToUint64(info.image_state->image), __LINE__, VALIDATION_ERROR_01600198, "IMAGE",
+                            "%s: pRegion[%d] bufferImageHeight (%d) must be a multiple of the compressed image's texel "
+                            "height (%d). %s.",
+                            function, i, region.bufferImageHeight, block_size.height,
+                            validation_error_map[VALIDATION_ERROR_01600198]);
         }
 
-        // image subresource aspect bit must match format
-        if (!VerifyAspectsPresent(pRegions[i].imageSubresource.aspectMask, image_state->createInfo.format)) {
-            skip |= log_msg(
-                report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
-                HandleToUint64(image_state->image), __LINE__, VALIDATION_ERROR_016001a6, "IMAGE",
-                "%s(): pRegion[%d] subresource aspectMask 0x%x specifies aspects that are not present in image format 0x%x. %s",
-                function, i, pRegions[i].imageSubresource.aspectMask, image_state->createInfo.format,
-                validation_error_map[VALIDATION_ERROR_016001a6]);
+        //  image offsets must be multiples of block dimensions
+        if ((SafeModulo(region.imageOffset.x, block_size.width) != 0) ||
+            (SafeModulo(region.imageOffset.y, block_size.height) != 0) ||
+            (SafeModulo(region.imageOffset.z, block_size.depth) != 0)) {
+            skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
+                            HandleToUint64(info.image_state->image), __LINE__, VALIDATION_ERROR_0160019a, "IMAGE",
+                            "%s: pRegion[%d] imageOffset(x,y) (%d, %d) must be multiples of the compressed image's texel "
+                            "width & height (%d, %d). %s.",
+                            function, i, region.imageOffset.x, region.imageOffset.y, block_size.width,
+                            block_size.height, validation_error_map[VALIDATION_ERROR_0160019a]);
         }
 
-        // Checks that apply only to compressed images
-        // TODO: there is a comment in ValidateCopyBufferImageTransferGranularityRequirements() in core_validation.cpp that
-        //       reserves a place for these compressed image checks.  This block of code could move there once the image
-        //       stuff is moved into core validation.
-        if (FormatIsCompressed(image_state->createInfo.format)) {
-            auto block_size = FormatCompressedTexelBlockExtent(image_state->createInfo.format);
-
-            //  BufferRowLength must be a multiple of block width
-            if (SafeModulo(pRegions[i].bufferRowLength, block_size.width) != 0) {
-                skip |= log_msg(
-                    report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
-                    HandleToUint64(image_state->image), __LINE__, VALIDATION_ERROR_01600196, "IMAGE",
-                    "%s(): pRegion[%d] bufferRowLength (%d) must be a multiple of the compressed image's texel width (%d). %s.",
-                    function, i, pRegions[i].bufferRowLength, block_size.width, validation_error_map[VALIDATION_ERROR_01600196]);
-            }
-
-            //  BufferRowHeight must be a multiple of block height
-            if (SafeModulo(pRegions[i].bufferImageHeight, block_size.height) != 0) {
-                skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
-                                HandleToUint64(image_state->image), __LINE__, VALIDATION_ERROR_01600198, "IMAGE",
-                                "%s(): pRegion[%d] bufferImageHeight (%d) must be a multiple of the compressed image's texel "
-                                "height (%d). %s.",
-                                function, i, pRegions[i].bufferImageHeight, block_size.height,
-                                validation_error_map[VALIDATION_ERROR_01600198]);
-            }
-
-            //  image offsets must be multiples of block dimensions
-            if ((SafeModulo(pRegions[i].imageOffset.x, block_size.width) != 0) ||
-                (SafeModulo(pRegions[i].imageOffset.y, block_size.height) != 0) ||
-                (SafeModulo(pRegions[i].imageOffset.z, block_size.depth) != 0)) {
-                skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
-                                HandleToUint64(image_state->image), __LINE__, VALIDATION_ERROR_0160019a, "IMAGE",
-                                "%s(): pRegion[%d] imageOffset(x,y) (%d, %d) must be multiples of the compressed image's texel "
-                                "width & height (%d, %d). %s.",
-                                function, i, pRegions[i].imageOffset.x, pRegions[i].imageOffset.y, block_size.width,
-                                block_size.height, validation_error_map[VALIDATION_ERROR_0160019a]);
-            }
+        // bufferOffset must be a multiple of block size (linear bytes)
+        size_t block_size_in_bytes = info.format_size;
+        if (SafeModulo(region.bufferOffset, block_size_in_bytes) != 0) {
+            skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
+                            HandleToUint64(info.image_state->image), __LINE__, VALIDATION_ERROR_0160019c, "IMAGE",
+                            "%s: pRegion[%d] bufferOffset (0x%" PRIxLEAST64
+                            ") must be a multiple of the compressed image's texel block "
+                            "size (" PRINTF_SIZE_T_SPECIFIER "). %s.",
+                            function, i, region.bufferOffset, block_size_in_bytes,
+                            validation_error_map[VALIDATION_ERROR_0160019c]);
+        }
 
-            // bufferOffset must be a multiple of block size (linear bytes)
-            size_t block_size_in_bytes = FormatSize(image_state->createInfo.format);
-            if (SafeModulo(pRegions[i].bufferOffset, block_size_in_bytes) != 0) {
-                skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
-                                HandleToUint64(image_state->image), __LINE__, VALIDATION_ERROR_0160019c, "IMAGE",
-                                "%s(): pRegion[%d] bufferOffset (0x%" PRIxLEAST64
-                                ") must be a multiple of the compressed image's texel block "
-                                "size (" PRINTF_SIZE_T_SPECIFIER "). %s.",
-                                function, i, pRegions[i].bufferOffset, block_size_in_bytes,
-                                validation_error_map[VALIDATION_ERROR_0160019c]);
-            }
-
-            // imageExtent width must be a multiple of block width, or extent+offset width must equal subresource width
-            VkExtent3D mip_extent = GetImageSubresourceExtent(image_state, &(pRegions[i].imageSubresource));
-            if ((SafeModulo(pRegions[i].imageExtent.width, block_size.width) != 0) &&
-                (pRegions[i].imageExtent.width + pRegions[i].imageOffset.x != mip_extent.width)) {
-                skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
-                                HandleToUint64(image_state->image), __LINE__, VALIDATION_ERROR_0160019e, "IMAGE",
-                                "%s(): pRegion[%d] extent width (%d) must be a multiple of the compressed texture block width "
-                                "(%d), or when added to offset.x (%d) must equal the image subresource width (%d). %s.",
-                                function, i, pRegions[i].imageExtent.width, block_size.width, pRegions[i].imageOffset.x,
-                                mip_extent.width, validation_error_map[VALIDATION_ERROR_0160019e]);
-            }
+        // imageExtent width must be a multiple of block width, or extent+offset width must equal subresource width
+        if ((SafeModulo(region.imageExtent.width, block_size.width) != 0) &&
+            (region.imageExtent.width + region.imageOffset.x != mip_extent.width)) {
+            skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
+                            HandleToUint64(info.image_state->image), __LINE__, VALIDATION_ERROR_0160019e, "IMAGE",
+                            "%s: pRegion[%d] extent width (%d) must be a multiple of the compressed texture block width "
+                            "(%d), or when added to offset.x (%d) must equal the image subresource width (%d). %s.",
+                            function, i, region.imageExtent.width, block_size.width, region.imageOffset.x,
+                            mip_extent.width, validation_error_map[VALIDATION_ERROR_0160019e]);
+        }
 
-            // imageExtent height must be a multiple of block height, or extent+offset height must equal subresource height
-            if ((SafeModulo(pRegions[i].imageExtent.height, block_size.height) != 0) &&
-                (pRegions[i].imageExtent.height + pRegions[i].imageOffset.y != mip_extent.height)) {
-                skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
-                                HandleToUint64(image_state->image), __LINE__, VALIDATION_ERROR_016001a0, "IMAGE",
-                                "%s(): pRegion[%d] extent height (%d) must be a multiple of the compressed texture block height "
-                                "(%d), or when added to offset.y (%d) must equal the image subresource height (%d). %s.",
-                                function, i, pRegions[i].imageExtent.height, block_size.height, pRegions[i].imageOffset.y,
-                                mip_extent.height, validation_error_map[VALIDATION_ERROR_016001a0]);
-            }
+        // imageExtent height must be a multiple of block height, or extent+offset height must equal subresource height
+        if ((SafeModulo(region.imageExtent.height, block_size.height) != 0) &&
+            (region.imageExtent.height + region.imageOffset.y != mip_extent.height)) {
+            skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
+                            HandleToUint64(info.image_state->image), __LINE__, VALIDATION_ERROR_016001a0, "IMAGE",
+                            "%s: pRegion[%d] extent height (%d) must be a multiple of the compressed texture block height "
+                            "(%d), or when added to offset.y (%d) must equal the image subresource height (%d). %s.",
+                            function, i, region.imageExtent.height, block_size.height, region.imageOffset.y,
+                            mip_extent.height, validation_error_map[VALIDATION_ERROR_016001a0]);
+        }
 
-            // imageExtent depth must be a multiple of block depth, or extent+offset depth must equal subresource depth
-            if ((SafeModulo(pRegions[i].imageExtent.depth, block_size.depth) != 0) &&
-                (pRegions[i].imageExtent.depth + pRegions[i].imageOffset.z != mip_extent.depth)) {
-                skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
-                                HandleToUint64(image_state->image), __LINE__, VALIDATION_ERROR_016001a2, "IMAGE",
-                                "%s(): pRegion[%d] extent width (%d) must be a multiple of the compressed texture block depth "
-                                "(%d), or when added to offset.z (%d) must equal the image subresource depth (%d). %s.",
-                                function, i, pRegions[i].imageExtent.depth, block_size.depth, pRegions[i].imageOffset.z,
-                                mip_extent.depth, validation_error_map[VALIDATION_ERROR_016001a2]);
-            }
+        // imageExtent depth must be a multiple of block depth, or extent+offset depth must equal subresource depth
+        if ((SafeModulo(region.imageExtent.depth, block_size.depth) != 0) &&
+            (region.imageExtent.depth + region.imageOffset.z != mip_extent.depth)) {
+            skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
+                            HandleToUint64(info.image_state->image), __LINE__, VALIDATION_ERROR_016001a2, "IMAGE",
+                            "%s: pRegion[%d] extent width (%d) must be a multiple of the compressed texture block depth "
+                            "(%d), or when added to offset.z (%d) must equal the image subresource depth (%d). %s.",
+                            function, i, region.imageExtent.depth, block_size.depth, region.imageOffset.z,
+                            mip_extent.depth, validation_error_map[VALIDATION_ERROR_016001a2]);
         }
     }
 
     return skip;
 }
 
-static bool ValidateImageBounds(const debug_report_data *report_data, const IMAGE_STATE *image_state, const uint32_t regionCount,
-                                const VkBufferImageCopy *pRegions, const char *func_name, UNIQUE_VALIDATION_ERROR_CODE msg_code) {
+// Validate that a region of a vkCmdCopyBufferToImage or vkCmdCopyImageToBuffer lies within its image subresource
+static bool ValidateBufferImageCopyImageBounds(const debug_report_data *report_data, const COPY_IMAGE_INFO &info,
+                                               const VkBufferImageCopy &region, VkExtent3D image_extent, uint32_t i,
+                                               const char *func_name, UNIQUE_VALIDATION_ERROR_CODE msg_code) {
     bool skip = false;
-    const VkImageCreateInfo *image_info = &(image_state->createInfo);
+    VkExtent3D extent = region.imageExtent;
+    VkOffset3D offset = region.imageOffset;
 
-    for (uint32_t i = 0; i < regionCount; i++) {
-        VkExtent3D extent = pRegions[i].imageExtent;
-        VkOffset3D offset = pRegions[i].imageOffset;
+    if (IsExtentSizeZero(&extent))  // Warn on zero area subresource
+    {
+        skip |= log_msg(report_data, VK_DEBUG_REPORT_WARNING_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_COMMAND_BUFFER_EXT, (uint64_t)0,
+                        __LINE__, IMAGE_ZERO_AREA_SUBREGION, "IMAGE",
+                        "%s: pRegion[%d] imageExtent of {%1d, %1d, %1d} has zero area", func_name, i, extent.width,
+                        extent.height, extent.depth);
+    }
 
-        if (IsExtentSizeZero(&extent))  // Warn on zero area subresource
-        {
-            skip |= log_msg(report_data, VK_DEBUG_REPORT_WARNING_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_COMMAND_BUFFER_EXT,
-                            (uint64_t)0, __LINE__, IMAGE_ZERO_AREA_SUBREGION, "IMAGE",
-                            "%s: pRegion[%d] imageExtent of {%1d, %1d, %1d} has zero area", func_name, i, extent.width,
-                            extent.height, extent.depth);
+    // If we're using a compressed format, valid extent is rounded up to multiple of block size (per 18.1)
+    if (info.compressed) {
+        const VkExtent3D &block_extent = info.block_extent;
+        if (image_extent.width % block_extent.width) {
+            image_extent.width += (block_extent.width - (image_extent.width % block_extent.width));
         }
-
-        VkExtent3D image_extent = GetImageSubresourceExtent(image_state, &(pRegions[i].imageSubresource));
-
-        // If we're using a compressed format, valid extent is rounded up to multiple of block size (per 18.1)
-        if (FormatIsCompressed(image_info->format)) {
-            auto block_extent = FormatCompressedTexelBlockExtent(image_info->format);
-            if (image_extent.width % block_extent.width) {
-                image_extent.width += (block_extent.width - (image_extent.width % block_extent.width));
-            }
-            if (image_extent.height % block_extent.height) {
-                image_extent.height += (block_extent.height - (image_extent.height % block_extent.height));
-            }
-            if (image_extent.depth % block_extent.depth) {
-                image_extent.depth += (block_extent.depth - (image_extent.depth % block_extent.depth));
-            }
+        if (image_extent.height % block_extent.height) {
+            image_extent.height += (block_extent.height - (image_extent.height % block_extent.height));
         }
-
-        if (0 != ExceedsBounds(&offset, &extent, &image_extent)) {
-            skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_COMMAND_BUFFER_EXT, (uint64_t)0,
-                            __LINE__, msg_code, "IMAGE", "%s: pRegion[%d] exceeds image bounds. %s.", func_name, i,
-                            validation_error_map[msg_code]);
+        if (image_extent.depth % block_extent.depth) {
+            image_extent.depth += (block_extent.depth - (image_extent.depth % block_extent.depth));
         }
     }
 
+    if (0 != ExceedsBounds(&offset, &extent, &image_extent)) {
+        skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_COMMAND_BUFFER_EXT, (uint64_t)0,
+                        __LINE__, msg_code, "IMAGE", "%s: pRegion[%d] exceeds image bounds. %s.", func_name, i,
+                        validation_error_map[msg_code]);
+    }
+
     return skip;
 }
 
-static inline bool ValidateBufferBounds(const debug_report_data *report_data, IMAGE_STATE *image_state, BUFFER_STATE *buff_state,
-                                        uint32_t regionCount, const VkBufferImageCopy *pRegions, const char *func_name,
-                                        UNIQUE_VALIDATION_ERROR_CODE msg_code) {
+// Validate that a region of a vkCmdCopyBufferToImage or vkCmdCopyImageToBuffer lies within the buffer
+static inline bool ValidateBufferImageCopyBufferBounds(const debug_report_data *report_data, const COPY_IMAGE_INFO &info,
+                                                       VkDeviceSize buffer_size, const VkBufferImageCopy &region, uint32_t i,
+                                                       const char *func_name, UNIQUE_VALIDATION_ERROR_CODE msg_code) {
     bool skip = false;
-
-    VkDeviceSize buffer_size = buff_state->createInfo.size;
-
-    for (uint32_t i = 0; i < regionCount; i++) {
-        VkExtent3D copy_extent = pRegions[i].imageExtent;
-
-        VkDeviceSize buffer_width = (0 == pRegions[i].bufferRowLength ? copy_extent.width : pRegions[i].bufferRowLength);
-        VkDeviceSize buffer_height = (0 == pRegions[i].bufferImageHeight ? copy_extent.height : pRegions[i].bufferImageHeight);
-        VkDeviceSize unit_size = FormatSize(image_state->createInfo.format);  // size (bytes) of texel or block
-
-        // Handle special buffer packing rules for specific depth/stencil formats
-        if (pRegions[i].imageSubresource.aspectMask & VK_IMAGE_ASPECT_STENCIL_BIT) {
-            unit_size = FormatSize(VK_FORMAT_S8_UINT);
-        } else if (pRegions[i].imageSubresource.aspectMask & VK_IMAGE_ASPECT_DEPTH_BIT) {
-            switch (image_state->createInfo.format) {
-                case VK_FORMAT_D16_UNORM_S8_UINT:
-                    unit_size = FormatSize(VK_FORMAT_D16_UNORM);
-                    break;
-                case VK_FORMAT_D32_SFLOAT_S8_UINT:
-                    unit_size = FormatSize(VK_FORMAT_D32_SFLOAT);
-                    break;
-                case VK_FORMAT_X8_D24_UNORM_PACK32:  // Fall through
-                case VK_FORMAT_D24_UNORM_S8_UINT:
-                    unit_size = 4;
-                    break;
-                default:
-                    break;
-            }
+    VkExtent3D copy_extent = region.imageExtent;
+
+    VkDeviceSize buffer_width = (0 == region.bufferRowLength ? copy_extent.width : region.bufferRowLength);
+    VkDeviceSize buffer_height = (0 == region.bufferImageHeight ? copy_extent.height : region.bufferImageHeight);
+    VkDeviceSize unit_size = info.format_size;  // size (bytes) of texel or block
+
+    // Handle special buffer packing rules for specific depth/stencil formats
+    if (region.imageSubresource.aspectMask & VK_IMAGE_ASPECT_STENCIL_BIT) {
+        unit_size = FormatSize(VK_FORMAT_S8_UINT);
+    } else if (region.imageSubresource.aspectMask & VK_IMAGE_ASPECT_DEPTH_BIT) {
+        switch (info.format) {
+            case VK_FORMAT_D16_UNORM_S8_UINT:
+                unit_size = FormatSize(VK_FORMAT_D16_UNORM);
+                break;
+            case VK_FORMAT_D32_SFLOAT_S8_UINT:
+                unit_size = FormatSize(VK_FORMAT_D32_SFLOAT);
+                break;
+            case VK_FORMAT_X8_D24_UNORM_PACK32:  // Fall through
+            case VK_FORMAT_D24_UNORM_S8_UINT:
+                unit_size = 4;
+                break;
+            default:
+                break;
         }
+    }
 
-        if (FormatIsCompressed(image_state->createInfo.format)) {
-            // Switch to texel block units, rounding up for any partially-used blocks
-            auto block_dim = FormatCompressedTexelBlockExtent(image_state->createInfo.format);
-            buffer_width = (buffer_width + block_dim.width - 1) / block_dim.width;
-            buffer_height = (buffer_height + block_dim.height - 1) / block_dim.height;
+    if (info.compressed) {
+        // Switch to texel block units, rounding up for any partially-used blocks
+        const VkExtent3D &block_dim = info.block_extent;
+        buffer_width = (buffer_width + block_dim.width - 1) / block_dim.width;
+        buffer_height = (buffer_height + block_dim.height - 1) / block_dim.height;
 
-            copy_extent.width = (copy_extent.width + block_dim.width - 1) / block_dim.width;
-            copy_extent.height = (copy_extent.height + block_dim.height - 1) / block_dim.height;
-            copy_extent.depth = (copy_extent.depth + block_dim.depth - 1) / block_dim.depth;
-        }
+        copy_extent.width = (copy_extent.width + block_dim.width - 1) / block_dim.width;
+        copy_extent.height = (copy_extent.height + block_dim.height - 1) / block_dim.height;
+        copy_extent.depth = (copy_extent.depth + block_dim.depth - 1) / block_dim.depth;
+    }
 
-        // Either depth or layerCount may be greater than 1 (not both). This is the number of 'slices' to copy
-        uint32_t z_copies = std::max(copy_extent.depth, pRegions[i].imageSubresource.layerCount);
-        if (IsExtentSizeZero(&copy_extent) || (0 == z_copies)) {
-            // TODO: Issue warning here? Already warned in ValidateImageBounds()...
-        } else {
-            // Calculate buffer offset of final copied byte, + 1.
-            VkDeviceSize max_buffer_offset = (z_copies - 1) * buffer_height * buffer_width;      // offset to slice
-            max_buffer_offset += ((copy_extent.height - 1) * buffer_width) + copy_extent.width;  // add row,col
-            max_buffer_offset *= unit_size;                                                      // convert to bytes
-            max_buffer_offset += pRegions[i].bufferOffset;                                       // add initial offset (bytes)
+    // Either depth or layerCount may be greater than 1 (not both). This is the number of 'slices' to copy
+    uint32_t z_copies = std::max(copy_extent.depth, region.imageSubresource.layerCount);
+    if (IsExtentSizeZero(&copy_extent) || (0 == z_copies)) {
+        // TODO: Issue warning here? Already warned in ValidateBufferImageCopyImageBounds()...
+    } else {
+        // Calculate buffer offset of final copied byte, + 1.
+        VkDeviceSize max_buffer_offset = (z_copies - 1) * buffer_height * buffer_width;      // offset to slice
+        max_buffer_offset += ((copy_extent.height - 1) * buffer_width) + copy_extent.width;  // add row,col
+        max_buffer_offset *= unit_size;                                                      // convert to bytes
+        max_buffer_offset += region.bufferOffset;                                            // add initial offset (bytes)
 
-            if (buffer_size < max_buffer_offset) {
-                skip |=
-                    log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_COMMAND_BUFFER_EXT, (uint64_t)0,
+        if (buffer_size < max_buffer_offset) {
+            skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_COMMAND_BUFFER_EXT, (uint64_t)0,
                             __LINE__, msg_code, "IMAGE", "%s: pRegion[%d] exceeds buffer size of %" PRIu64 " bytes. %s.", func_name,
                             i, buffer_size, validation_error_map[msg_code]);
-            }
         }
     }
 
     return skip;
 }
 
+// Validate the regions of a vkCmdCopyBufferToImage or vkCmdCopyImageToBuffer in a single pass, with the image's format
+// properties and the transfer granularity looked up once
+static bool ValidateBufferImageCopyRegions(layer_data *device_data, GLOBAL_CB_NODE *cb_node, IMAGE_STATE *image_state,
+                                           BUFFER_STATE *buffer_state, uint32_t region_count, const VkBufferImageCopy *regions,
+                                           VkImageLayout layout, VkImageLayout optimal_layout, const char *func_name,
+                                           UNIQUE_VALIDATION_ERROR_CODE image_bounds_code,
+                                           UNIQUE_VALIDATION_ERROR_CODE buffer_bounds_code,
+                                           UNIQUE_VALIDATION_ERROR_CODE layout_code) {
+    const debug_report_data *report_data = core_validation::GetReportData(device_data);
+    const COPY_IMAGE_INFO info = GetCopyImageInfo(device_data, cb_node, image_state);
+    const VkDeviceSize buffer_size = buffer_state->createInfo.size;
+    bool skip = false;
+    bool hit_error = false;
+    for (uint32_t i = 0; i < region_count; ++i) {
+        const VkBufferImageCopy &region = regions[i];
+        const VkExtent3D mip_extent = GetImageSubresourceExtent(image_state, &region.imageSubresource);
+        skip |= ValidateBufferImageCopyRegion(report_data, info, region, mip_extent, i, func_name);
+        skip |= ValidateBufferImageCopyImageBounds(report_data, info, region, mip_extent, i, func_name, image_bounds_code);
+        skip |= ValidateBufferImageCopyBufferBounds(report_data, info, buffer_size, region, i, func_name, buffer_bounds_code);
+        skip |= VerifyImageLayout(device_data, cb_node, image_state, region.imageSubresource, layout, optimal_layout, func_name,
+                                  layout_code, &hit_error);
+        skip |= ValidateCopyBufferImageTransferGranularityRequirements(device_data, cb_node, info, region, mip_extent, i,
+                                                                       func_name);
+    }
+    return skip;
+}
+
 bool PreCallValidateCmdCopyImageToBuffer(layer_data *device_data, VkImageLayout srcImageLayout, GLOBAL_CB_NODE *cb_node,
                                          IMAGE_STATE *src_image_state, BUFFER_STATE *dst_buffer_state, uint32_t regionCount,
                                          const VkBufferImageCopy *pRegions, const char *func_name) {
     const debug_report_data *report_data = core_validation::GetReportData(device_data);
-    bool skip = ValidateBufferImageCopyData(report_data, regionCount, pRegions, src_image_state, "vkCmdCopyImageToBuffer");
+    bool skip = false;
 
     // Validate command buffer state
     if (CB_RECORDING != cb_node->state) {
@@ -3907,11 +3937,9 @@ bool PreCallValidateCmdCopyImageToBuffer(layer_data *device_data, VkImageLayout
                         "or transfer capabilities. %s.",
                         validation_error_map[VALIDATION_ERROR_19202415]);
     }
-    skip |= ValidateImageBounds(report_data, src_image_state, regionCount, pRegions, "vkCmdCopyBufferToImage()",
-                                VALIDATION_ERROR_1920016c);
-    skip |= ValidateBufferBounds(report_data, src_image_state, dst_buffer_state, regionCount, pRegions, "vkCmdCopyImageToBuffer()",
-                                 VALIDATION_ERROR_1920016e);
-
+    skip |= ValidateBufferImageCopyRegions(device_data, cb_node, src_image_state, dst_buffer_state, regionCount, pRegions,
+                                           srcImageLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, "vkCmdCopyImageToBuffer()",
+                                           VALIDATION_ERROR_1920016c, VALIDATION_ERROR_1920016e, VALIDATION_ERROR_1920017c);
     skip |= ValidateImageSampleCount(device_data, src_image_state, VK_SAMPLE_COUNT_1_BIT, "vkCmdCopyImageToBuffer(): srcImage",
                                      VALIDATION_ERROR_19200178);
     skip |= ValidateMemoryIsBoundToImage(device_data, src_image_state, "vkCmdCopyImageToBuffer()", VALIDATION_ERROR_19200176);
@@ -3923,14 +3951,6 @@ bool PreCallValidateCmdCopyImageToBuffer(layer_data *device_data, VkImageLayout
     skip |= ValidateBufferUsageFlags(device_data, dst_buffer_state, VK_BUFFER_USAGE_TRANSFER_DST_BIT, true,
                                      VALIDATION_ERROR_1920017e, "vkCmdCopyImageToBuffer()", "VK_BUFFER_USAGE_TRANSFER_DST_BIT");
     skip |= insideRenderPass(device_data, cb_node, "vkCmdCopyImageToBuffer()", VALIDATION_ERROR_19200017);
-    bool hit_error = false;
-    for (uint32_t i = 0; i < regionCount; ++i) {
-        skip |= VerifyImageLayout(device_data, cb_node, src_image_state, pRegions[i].imageSubresource, srcImageLayout,
-                                  VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, "vkCmdCopyImageToBuffer()", VALIDATION_ERROR_1920017c,
-                                  &hit_error);
-        skip |= ValidateCopyBufferImageTransferGranularityRequirements(device_data, cb_node, src_image_state, &pRegions[i], i,
-                                                                       "vkCmdCopyImageToBuffer()");
-    }
     return skip;
 }
 
@@ -3945,22 +3965,15 @@ void PreCallRecordCmdCopyImageToBuffer(layer_data *device_data, GLOBAL_CB_NODE *
     AddCommandBufferBindingImage(device_data, cb_node, src_image_state);
     AddCommandBufferBindingBuffer(device_data, cb_node, dst_buffer_state);
 
-    std::function<bool()> function = [=]() {
-        return ValidateImageMemoryIsValid(device_data, src_image_state, "vkCmdCopyImageToBuffer()");
-    };
-    cb_node->queue_submit_functions.push_back(function);
-    function = [=]() {
-        SetBufferMemoryValid(device_data, dst_buffer_state, true);
-        return false;
-    };
-    cb_node->queue_submit_functions.push_back(function);
+    core_validation::DeferImageMemoryCheck(cb_node, src_image_state, "vkCmdCopyImageToBuffer()");
+    core_validation::DeferBufferMemoryValid(cb_node, dst_buffer_state, true);
 }
 
 bool PreCallValidateCmdCopyBufferToImage(layer_data *device_data, VkImageLayout dstImageLayout, GLOBAL_CB_NODE *cb_node,
                                          BUFFER_STATE *src_buffer_state, IMAGE_STATE *dst_image_state, uint32_t regionCount,
                                          const VkBufferImageCopy *pRegions, const char *func_name) {
     const debug_report_data *report_data = core_validation::GetReportData(device_data);
-    bool skip = ValidateBufferImageCopyData(report_data, regionCount, pRegions, dst_image_state, "vkCmdCopyBufferToImage");
+    bool skip = false;
 
     // Validate command buffer state
     if (CB_RECORDING != cb_node->state) {
@@ -3982,10 +3995,9 @@ bool PreCallValidateCmdCopyBufferToImage(layer_data *device_data, VkImageLayout
                         "or transfer capabilities. %s.",
                         validation_error_map[VALIDATION_ERROR_18e02415]);
     }
-    skip |= ValidateImageBounds(report_data, dst_image_state, regionCount, pRegions, "vkCmdCopyBufferToImage()",
-                                VALIDATION_ERROR_18e00158);
-    skip |= ValidateBufferBounds(report_data, dst_image_state, src_buffer_state, regionCount, pRegions, "vkCmdCopyBufferToImage()",
-                                 VALIDATION_ERROR_18e00156);
+    skip |= ValidateBufferImageCopyRegions(device_data, cb_node, dst_image_state, src_buffer_state, regionCount, pRegions,
+                                           dstImageLayout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, "vkCmdCopyBufferToImage()",
+                                           VALIDATION_ERROR_18e00158, VALIDATION_ERROR_18e00156, VALIDATION_ERROR_18e0016a);
     skip |= ValidateImageSampleCount(device_data, dst_image_state, VK_SAMPLE_COUNT_1_BIT, "vkCmdCopyBufferToImage(): dstImage",
                                      VALIDATION_ERROR_18e00166);
     skip |= ValidateMemoryIsBoundToBuffer(device_data, src_buffer_state, "vkCmdCopyBufferToImage()", VALIDATION_ERROR_18e00160);
@@ -3995,14 +4007,6 @@ bool PreCallValidateCmdCopyBufferToImage(layer_data *device_data, VkImageLayout
     skip |= ValidateImageUsageFlags(device_data, dst_image_state, VK_IMAGE_USAGE_TRANSFER_DST_BIT, true, VALIDATION_ERROR_18e00162,
                                     "vkCmdCopyBufferToImage()", "VK_IMAGE_USAGE_TRANSFER_DST_BIT");
     skip |= insideRenderPass(device_data, cb_node, "vkCmdCopyBufferToImage()", VALIDATION_ERROR_18e00017);
-    bool hit_error = false;
-    for (uint32_t i = 0; i < regionCount; ++i) {
-        skip |= VerifyImageLayout(device_data, cb_node, dst_image_state, pRegions[i].imageSubresource, dstImageLayout,
-                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, "vkCmdCopyBufferToImage()", VALIDATION_ERROR_18e0016a,
-                                  &hit_error);
-        skip |= ValidateCopyBufferImageTransferGranularityRequirements(device_data, cb_node, dst_image_state, &pRegions[i], i,
-                                                                       "vkCmdCopyBufferToImage()");
-    }
     return skip;
 }
 
@@ -4015,13 +4019,8 @@ void PreCallRecordCmdCopyBufferToImage(layer_data *device_data, GLOBAL_CB_NODE *
     }
     AddCommandBufferBindingBuffer(device_data, cb_node, src_buffer_state);
     AddCommandBufferBindingImage(device_data, cb_node, dst_image_state);
-    std::function<bool()> function = [=]() {
-        SetImageMemoryValid(device_data, dst_image_state, true);
-        return false;
-    };
-    cb_node->queue_submit_functions.push_back(function);
-    function = [=]() { return ValidateBufferMemoryIsValid(device_data, src_buffer_state, "vkCmdCopyBufferToImage()"); };
-    cb_node->queue_submit_functions.push_back(function);
+    core_validation::DeferImageMemoryValid(cb_node, dst_image_state, true);
+    core_validation::DeferBufferMemoryCheck(cb_node, src_buffer_state, "vkCmdCopyBufferToImage()");
 }
 
 bool PreCallValidateGetImageSubresourceLayout(layer_data *device_data, VkImage image, const VkImageSubresource *pSubresource) {
@@ -38,6 +38,9 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
 #include <list>
 #include <map>
@@ -49,7 +52,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <string>
+#include <thread>
 #include <inttypes.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #include "vk_loader_platform.h"
 #include "vk_dispatch_table_helper.h"
@@ -95,7 +103,50 @@ std::string to_string(T var) {
 // This intentionally includes a cpp file
 #include "vk_safe_struct.cpp"
 
-using mutex_t = std::mutex;
+// A lock that any number of threads can hold shared, or one thread exclusively. Once a thread waits for exclusive
+// access no new shared owners get in, so object creation and destruction isn't starved by command buffer recording.
+class shared_mutex_t {
+   public:
+    void lock() {
+        std::unique_lock<std::mutex> guard(mutex_);
+        waiting_writers_++;
+        writer_cv_.wait(guard, [this] { return !writer_ && readers_ == 0; });
+        waiting_writers_--;
+        writer_ = true;
+    }
+
+    void unlock() {
+        std::lock_guard<std::mutex> guard(mutex_);
+        writer_ = false;
+        if (waiting_writers_) {
+            writer_cv_.notify_one();
+        } else {
+            reader_cv_.notify_all();
+        }
+    }
+
+    void lock_shared() {
+        std::unique_lock<std::mutex> guard(mutex_);
+        reader_cv_.wait(guard, [this] { return !writer_ && waiting_writers_ == 0; });
+        readers_++;
+    }
+
+    void unlock_shared() {
+        std::lock_guard<std::mutex> guard(mutex_);
+        readers_--;
+        if (readers_ == 0 && waiting_writers_) writer_cv_.notify_one();
+    }
+
+   private:
+    std::mutex mutex_;
+    std::condition_variable reader_cv_;
+    std::condition_variable writer_cv_;
+    uint32_t readers_ = 0;
+    uint32_t waiting_writers_ = 0;
+    bool writer_ = false;
+};
+
+using mutex_t = shared_mutex_t;
 using lock_guard_t = std::lock_guard<mutex_t>;
 using unique_lock_t = std::unique_lock<mutex_t>;
 
@@ -119,6 +170,39 @@ static const VkDeviceMemory MEMORY_UNBOUND = VkDeviceMemory(~((uint64_t)(0)) - 1
 // by the extent of a swapchain targeting the surface.
 static const uint32_t kSurfaceSizeFromSwapchain = 0xFFFFFFFFu;
 
+// The lunarg_core_validation options of vk_layer_settings.txt, see core_validation_option_definitions
+struct core_validation_options {
+    // Run the descriptor set checks of draws and dispatches when needed, not while recording each one
+    bool deferred_draw_validation;
+    // Also run them on a worker thread of each device once command buffers are ended
+    bool async_draw_validation;
+    // Validate draws and dispatches of one frame in sample_frames, one in sample_draws of each command buffer, and only until
+    //  frame_budget_us of CPU time has been spent validating them in the frame. 0 means no limit.
+    uint32_t sample_frames;
+    uint32_t sample_draws;
+    uint32_t frame_budget_us;
+    // Measure the calls of the validation functions in CHECK_PROFILE_ID, reported at vkDestroyDevice
+    bool profile_checks;
+    // Threads that validate the pipelines of one vkCreateGraphicsPipelines call, 0 means one per CPU core
+    uint32_t pipeline_validation_threads;
+    // Report the performance pitfalls in PERF_HINT as performance warnings
+    bool perf_hints;
+    // Put inaccessible pages around the shadow copies of mapped non-coherent memory
+    bool noncoherent_guard_pages;
+};
+
+static const LayerOptionDefinition core_validation_option_definitions[] = {
+    {"deferred_draw_validation", LAYER_OPTION_BOOL, offsetof(core_validation_options, deferred_draw_validation), "false"},
+    {"async_draw_validation", LAYER_OPTION_BOOL, offsetof(core_validation_options, async_draw_validation), "false"},
+    {"sample_frames", LAYER_OPTION_UINT, offsetof(core_validation_options, sample_frames), "0"},
+    {"sample_draws", LAYER_OPTION_UINT, offsetof(core_validation_options, sample_draws), "0"},
+    {"frame_budget_us", LAYER_OPTION_UINT, offsetof(core_validation_options, frame_budget_us), "0"},
+    {"profile_checks", LAYER_OPTION_BOOL, offsetof(core_validation_options, profile_checks), "false"},
+    {"pipeline_validation_threads", LAYER_OPTION_UINT, offsetof(core_validation_options, pipeline_validation_threads), "0"},
+    {"perf_hints", LAYER_OPTION_BOOL, offsetof(core_validation_options, perf_hints), "false"},
+    {"noncoherent_guard_pages", LAYER_OPTION_BOOL, offsetof(core_validation_options, noncoherent_guard_pages), "false"},
+};
+
 struct instance_layer_data {
     VkInstance instance = VK_NULL_HANDLE;
     debug_report_data *report_data = nullptr;
@@ -130,6 +214,9 @@ struct instance_layer_data {
     CALL_STATE vkEnumeratePhysicalDeviceGroupsState = UNCALLED;
     uint32_t physical_device_groups_count = 0;
     CHECK_DISABLED disabled = {};
+    core_validation_options options = {};
+    // Generation of the settings options was read from, see RefreshLayerOptions()
+    uint32_t options_generation = 0;
 
     unordered_map<VkPhysicalDevice, PHYSICAL_DEVICE_STATE> physical_device_map;
     unordered_map<VkSurfaceKHR, SURFACE_STATE> surface_map;
@@ -137,6 +224,8 @@ struct instance_layer_data {
     InstanceExtensions extensions;
 };
 
+class DrawValidationWorker;
+
 struct layer_data {
     debug_report_data *report_data = nullptr;
     VkLayerDispatchTable dispatch_table;
@@ -159,15 +248,15 @@ struct layer_data {
     unordered_map<VkFence, FENCE_NODE> fenceMap;
     unordered_map<VkQueue, QUEUE_STATE> queueMap;
     unordered_map<VkEvent, EVENT_STATE> eventMap;
-    unordered_map<QueryObject, bool> queryToStateMap;
     unordered_map<VkQueryPool, QUERY_POOL_NODE> queryPoolMap;
     unordered_map<VkSemaphore, SEMAPHORE_NODE> semaphoreMap;
     unordered_map<VkCommandBuffer, GLOBAL_CB_NODE *> commandBufferMap;
     unordered_map<VkFramebuffer, unique_ptr<FRAMEBUFFER_STATE>> frameBufferMap;
     unordered_map<VkImage, vector<ImageSubresourcePair>> imageSubresourceMap;
-    unordered_map<ImageSubresourcePair, IMAGE_LAYOUT_NODE> imageLayoutMap;
+    ImageLayoutMap<IMAGE_LAYOUT_NODE> imageLayoutMap;
+    uint64_t imageLayoutGeneration = 1;  // Changes whenever a layout in imageLayoutMap does
     unordered_map<VkRenderPass, std::shared_ptr<RENDER_PASS_STATE>> renderPassMap;
-    unordered_map<VkShaderModule, unique_ptr<shader_module>> shaderModuleMap;
+    unordered_map<VkShaderModule, std::shared_ptr<shader_module>> shaderModuleMap;
     unordered_map<VkDescriptorUpdateTemplateKHR, unique_ptr<TEMPLATE_STATE>> desc_template_map;
     unordered_map<VkSwapchainKHR, std::unique_ptr<SWAPCHAIN_NODE>> swapchainMap;
 
@@ -181,6 +270,23 @@ struct layer_data {
     PHYS_DEV_PROPERTIES_NODE phys_dev_properties = {};
     VkPhysicalDeviceMemoryProperties phys_dev_mem_props = {};
     VkPhysicalDeviceProperties phys_dev_props = {};
+
+    // Frames presented, and the time spent validating draws and dispatches in this one, for the draw sampling settings
+    uint64_t frame_count = 0;
+    std::atomic<uint64_t> frame_validation_ns{0};
+
+    CHECK_PROFILE check_profiles[CHECK_PROFILE_COUNT];
+
+    // Times each performance hint was seen, and vkQueueSubmit calls of a single command buffer in this frame
+    std::atomic<uint32_t> perf_hint_counts[PERF_HINT_COUNT] = {};
+    uint32_t frame_single_cb_submits = 0;
+
+    std::unique_ptr<DrawValidationWorker> draw_validation_worker;
+
+    // Images, buffers, their views and samplers destroyed, oldest first. The generation of the first one is
+    // destroyed_objects_base + 1, see CheckDestroyedBindings().
+    std::vector<VK_OBJECT> destroyed_objects;
+    uint64_t destroyed_objects_base = 0;
 };
 
 // TODO : Do we need to guard access to layer_data_map w/ lock?
@@ -207,7 +313,10 @@ void ValidateLayerOrdering(const TCreateInfo &createInfo) {
     }
 }
 
-// TODO : This can be much smarter, using separate locks for separate global data
+// global_lock guards the device-level object maps and the state they hold. Calls that create, destroy or change shared
+// state hold it exclusively (unique_lock_t, lock_guard_t). Calls that only record into one command buffer hold it shared
+// along with that command buffer's record_mutex (record_lock_t), so threads recording different command buffers run in
+// parallel. What they do change in shared objects, the command buffers bound to them, has its own lock in BASE_NODE.
 static mutex_t global_lock;
 
 // Return IMAGE_VIEW_STATE ptr for specified imageView or else NULL
@@ -417,11 +526,67 @@ void SetImageMemoryValid(layer_data *dev_data, IMAGE_STATE *image_state, bool va
 void SetBufferMemoryValid(layer_data *dev_data, BUFFER_STATE *buffer_state, bool valid) {
     SetMemoryValid(dev_data, buffer_state->binding.mem, HandleToUint64(buffer_state->buffer), valid);
 }
+// Queue setting or checking the validity of the memory of an image or buffer for when cb_node is submitted
+void DeferImageMemoryValid(GLOBAL_CB_NODE *cb_node, IMAGE_STATE *image_state, bool valid) {
+    CB_DEFERRED_OP op = {};
+    op.type = CB_OP_SET_IMAGE_MEMORY_VALID;
+    op.valid = valid;
+    op.image_state = image_state;
+    cb_node->deferred_ops.push_back(op);
+}
+void DeferBufferMemoryValid(GLOBAL_CB_NODE *cb_node, BUFFER_STATE *buffer_state, bool valid) {
+    CB_DEFERRED_OP op = {};
+    op.type = CB_OP_SET_BUFFER_MEMORY_VALID;
+    op.valid = valid;
+    op.buffer_state = buffer_state;
+    cb_node->deferred_ops.push_back(op);
+}
+void DeferImageMemoryCheck(GLOBAL_CB_NODE *cb_node, IMAGE_STATE *image_state, const char *functionName) {
+    CB_DEFERRED_OP op = {};
+    op.type = CB_OP_CHECK_IMAGE_MEMORY_VALID;
+    op.image_state = image_state;
+    op.function = functionName;
+    cb_node->deferred_ops.push_back(op);
+}
+void DeferBufferMemoryCheck(GLOBAL_CB_NODE *cb_node, BUFFER_STATE *buffer_state, const char *functionName) {
+    CB_DEFERRED_OP op = {};
+    op.type = CB_OP_CHECK_BUFFER_MEMORY_VALID;
+    op.buffer_state = buffer_state;
+    op.function = functionName;
+    cb_node->deferred_ops.push_back(op);
+}
+// Framebuffer attachments are only looked up when the command buffer is submitted
+static void DeferAttachmentMemoryValid(GLOBAL_CB_NODE *cb_node, VkImage image, bool valid) {
+    CB_DEFERRED_OP op = {};
+    op.type = CB_OP_SET_ATTACHMENT_MEMORY_VALID;
+    op.valid = valid;
+    op.image = image;
+    cb_node->deferred_ops.push_back(op);
+}
+static void DeferAttachmentMemoryCheck(GLOBAL_CB_NODE *cb_node, VkImage image, const char *functionName) {
+    CB_DEFERRED_OP op = {};
+    op.type = CB_OP_CHECK_ATTACHMENT_MEMORY_VALID;
+    op.image = image;
+    op.function = functionName;
+    cb_node->deferred_ops.push_back(op);
+}
+
+// Images, buffers, their views and samplers don't keep the command buffers they're bound to, destroying them is common. A
+//  command buffer remembers the generation of destroyed_objects it first bound each of them at instead, and looks for the ones
+//  destroyed since when it records the next command or is submitted.
+static uint64_t GetDestroyedObjectsGeneration(const layer_data *dev_data) {
+    return dev_data->destroyed_objects_base + dev_data->destroyed_objects.size();
+}
+
+static void AddLazyCommandBufferBinding(const layer_data *dev_data, VK_OBJECT obj, GLOBAL_CB_NODE *cb_node) {
+    // Keep the first generation, an object destroyed after it still breaks the command buffer if another object gets its handle
+    cb_node->binding_generations.emplace(obj, GetDestroyedObjectsGeneration(dev_data));
+    cb_node->object_bindings.insert(obj);
+}
 
 // Create binding link between given sampler and command buffer node
-void AddCommandBufferBindingSampler(GLOBAL_CB_NODE *cb_node, SAMPLER_STATE *sampler_state) {
-    sampler_state->cb_bindings.insert(cb_node);
-    cb_node->object_bindings.insert({HandleToUint64(sampler_state->sampler), kVulkanObjectTypeSampler});
+void AddCommandBufferBindingSampler(const layer_data *dev_data, GLOBAL_CB_NODE *cb_node, SAMPLER_STATE *sampler_state) {
+    AddLazyCommandBufferBinding(dev_data, {HandleToUint64(sampler_state->sampler), kVulkanObjectTypeSampler}, cb_node);
 }
 
 // Create binding link between given image node and command buffer node
@@ -432,22 +597,20 @@ void AddCommandBufferBindingImage(const layer_data *dev_data, GLOBAL_CB_NODE *cb
         for (auto mem_binding : image_state->GetBoundMemory()) {
             DEVICE_MEM_INFO *pMemInfo = GetMemObjInfo(dev_data, mem_binding);
             if (pMemInfo) {
-                pMemInfo->cb_bindings.insert(cb_node);
+                pMemInfo->AddBoundCommandBuffer(cb_node);
                 // Now update CBInfo's Mem reference list
                 cb_node->memObjs.insert(mem_binding);
             }
         }
         // Now update cb binding for image
-        cb_node->object_bindings.insert({HandleToUint64(image_state->image), kVulkanObjectTypeImage});
-        image_state->cb_bindings.insert(cb_node);
+        AddLazyCommandBufferBinding(dev_data, {HandleToUint64(image_state->image), kVulkanObjectTypeImage}, cb_node);
     }
 }
 
 // Create binding link between given image view node and its image with command buffer node
 void AddCommandBufferBindingImageView(const layer_data *dev_data, GLOBAL_CB_NODE *cb_node, IMAGE_VIEW_STATE *view_state) {
     // First add bindings for imageView
-    view_state->cb_bindings.insert(cb_node);
-    cb_node->object_bindings.insert({HandleToUint64(view_state->image_view), kVulkanObjectTypeImageView});
+    AddLazyCommandBufferBinding(dev_data, {HandleToUint64(view_state->image_view), kVulkanObjectTypeImageView}, cb_node);
     auto image_state = GetImageState(dev_data, view_state->create_info.image);
     // Add bindings for image within imageView
     if (image_state) {
@@ -461,21 +624,19 @@ void AddCommandBufferBindingBuffer(const layer_data *dev_data, GLOBAL_CB_NODE *c
     for (auto mem_binding : buffer_state->GetBoundMemory()) {
         DEVICE_MEM_INFO *pMemInfo = GetMemObjInfo(dev_data, mem_binding);
         if (pMemInfo) {
-            pMemInfo->cb_bindings.insert(cb_node);
+            pMemInfo->AddBoundCommandBuffer(cb_node);
             // Now update CBInfo's Mem reference list
             cb_node->memObjs.insert(mem_binding);
         }
     }
     // Now update cb binding for buffer
-    cb_node->object_bindings.insert({HandleToUint64(buffer_state->buffer), kVulkanObjectTypeBuffer});
-    buffer_state->cb_bindings.insert(cb_node);
+    AddLazyCommandBufferBinding(dev_data, {HandleToUint64(buffer_state->buffer), kVulkanObjectTypeBuffer}, cb_node);
 }
 
 // Create binding link between given buffer view node and its buffer with command buffer node
 void AddCommandBufferBindingBufferView(const layer_data *dev_data, GLOBAL_CB_NODE *cb_node, BUFFER_VIEW_STATE *view_state) {
     // First add bindings for bufferView
-    view_state->cb_bindings.insert(cb_node);
-    cb_node->object_bindings.insert({HandleToUint64(view_state->buffer_view), kVulkanObjectTypeBufferView});
+    AddLazyCommandBufferBinding(dev_data, {HandleToUint64(view_state->buffer_view), kVulkanObjectTypeBufferView}, cb_node);
     auto buffer_state = GetBufferState(dev_data, view_state->create_info.buffer);
     // Add bindings for buffer within bufferView
     if (buffer_state) {
@@ -518,8 +679,8 @@ bool ClearMemoryObjectBindings(layer_data *dev_data, uint64_t handle, VulkanObje
         if (!mem_binding->sparse) {
             skip = ClearMemoryObjectBinding(dev_data, handle, type, mem_binding->binding.mem);
         } else {  // Sparse, clear all bindings
-            for (auto &sparse_mem_binding : mem_binding->sparse_bindings) {
-                skip |= ClearMemoryObjectBinding(dev_data, handle, type, sparse_mem_binding.mem);
+            for (auto &sparse_mem_ref : mem_binding->sparse_memory_refs) {
+                skip |= ClearMemoryObjectBinding(dev_data, handle, type, sparse_mem_ref.first);
             }
         }
     }
@@ -651,29 +812,157 @@ static bool ValidateSetMemBinding(layer_data *dev_data, VkDeviceMemory mem, uint
     return skip;
 }
 
-// For NULL mem case, clear any previous binding Else...
-// Make sure given object is in its object map
-//  IF a previous binding existed, update binding
-//  Add reference from objectInfo to memoryInfo
-//  Add reference off of object's binding info
-// Return VK_TRUE if addition is successful, VK_FALSE otherwise
-static bool SetSparseMemBinding(layer_data *dev_data, MEM_BINDING binding, uint64_t handle, VulkanObjectType type) {
-    bool skip = VK_FALSE;
-    // Handle NULL case separately, just clear previous binding & decrement reference
-    if (binding.mem == VK_NULL_HANDLE) {
-        // TODO : This should cause the range of the resource to be unbound according to spec
-    } else {
-        BINDABLE *mem_binding = GetObjectMemBinding(dev_data, handle, type);
-        assert(mem_binding);
-        assert(mem_binding->sparse);
-        DEVICE_MEM_INFO *mem_info = GetMemObjInfo(dev_data, binding.mem);
-        if (mem_info) {
+static void AddSparseMemoryRef(BINDABLE *mem_binding, VkDeviceMemory mem, unordered_set<VkDeviceMemory> *touched_mems) {
+    mem_binding->sparse_memory_refs[mem]++;
+    touched_mems->insert(mem);
+}
+
+static void RemoveSparseMemoryRef(BINDABLE *mem_binding, VkDeviceMemory mem, unordered_set<VkDeviceMemory> *touched_mems) {
+    mem_binding->sparse_memory_refs[mem]--;
+    touched_mems->insert(mem);
+}
+
+// Bind mem at memory_offset to [offset, offset + size) of a sparse resource, or unbind that range if mem is
+// VK_NULL_HANDLE. Ranges it overlaps are cut back, and it is merged with adjacent ranges that continue the same memory.
+// The memory objects whose reference counts changed are added to touched_mems.
+static void SetSparseRangeBinding(BINDABLE *mem_binding, VkDeviceSize offset, VkDeviceSize size, VkDeviceMemory mem,
+                                  VkDeviceSize memory_offset, unordered_set<VkDeviceMemory> *touched_mems) {
+    if (size == 0) return;
+    auto &ranges = mem_binding->sparse_ranges;
+    VkDeviceSize end = offset + size;
+
+    // Cut back a range that starts before offset and overlaps it, keeping any part of it past end
+    auto it = ranges.lower_bound(offset);
+    if (it != ranges.begin()) {
+        auto prev = std::prev(it);
+        if (prev->second.end > offset) {
+            SPARSE_RANGE_BINDING cut = prev->second;
+            prev->second.end = offset;
+            if (cut.end > end) {
+                ranges[end] = {cut.end, cut.mem, cut.memory_offset + (end - prev->first)};
+                AddSparseMemoryRef(mem_binding, cut.mem, touched_mems);
+            }
+        }
+    }
+    // Remove the ranges that start inside it, keeping any part of the last one past end
+    while (it != ranges.end() && it->first < end) {
+        SPARSE_RANGE_BINDING cut = it->second;
+        VkDeviceSize start = it->first;
+        it = ranges.erase(it);
+        if (cut.end > end) {
+            ranges[end] = {cut.end, cut.mem, cut.memory_offset + (end - start)};
+            break;
+        }
+        RemoveSparseMemoryRef(mem_binding, cut.mem, touched_mems);
+    }
+    if (mem == VK_NULL_HANDLE) return;
+
+    auto next = ranges.lower_bound(end);
+    if (next != ranges.end() && next->first == end && next->second.mem == mem &&
+        next->second.memory_offset == memory_offset + size) {
+        end = next->second.end;
+        RemoveSparseMemoryRef(mem_binding, mem, touched_mems);
+        next = ranges.erase(next);
+    }
+    if (next != ranges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->second.end == offset && prev->second.mem == mem &&
+            prev->second.memory_offset + (offset - prev->first) == memory_offset) {
+            prev->second.end = end;
+            return;
+        }
+    }
+    ranges[offset] = {end, mem, memory_offset};
+    AddSparseMemoryRef(mem_binding, mem, touched_mems);
+}
+
+// Bind or unbind a region of a sparse image subresource. The regions of the subresource that start inside it are
+// replaced, which covers them as long as the application binds the subresource with the same granularity throughout.
+static void SetSparseImageRegionBinding(BINDABLE *mem_binding, const VkSparseImageMemoryBind &bind,
+                                        unordered_set<VkDeviceMemory> *touched_mems) {
+    auto &regions = mem_binding->sparse_image_regions;
+    const VkImageSubresource &sub = bind.subresource;
+    const VkOffset3D &offset = bind.offset;
+    const VkExtent3D &extent = bind.extent;
+    SPARSE_IMAGE_REGION first = {sub.aspectMask, sub.mipLevel, sub.arrayLayer, offset.z, offset.y, offset.x};
+    SPARSE_IMAGE_REGION last = {sub.aspectMask, sub.mipLevel, sub.arrayLayer, offset.z + static_cast<int32_t>(extent.depth),
+                                INT32_MIN, INT32_MIN};
+    for (auto it = regions.lower_bound(first); it != regions.end() && it->first < last;) {
+        if (it->first.y >= offset.y && it->first.y < offset.y + static_cast<int32_t>(extent.height) && it->first.x >= offset.x &&
+            it->first.x < offset.x + static_cast<int32_t>(extent.width)) {
+            RemoveSparseMemoryRef(mem_binding, it->second.mem, touched_mems);
+            it = regions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (bind.memory != VK_NULL_HANDLE) {
+        regions[first] = {extent, bind.memory};
+        AddSparseMemoryRef(mem_binding, bind.memory, touched_mems);
+    }
+}
+
+// Once a batch of sparse binds is recorded, add the object to the memory objects it is now bound to, and remove it from
+// the ones it no longer is
+static void UpdateSparseMemoryObjBindings(layer_data *dev_data, BINDABLE *mem_binding, uint64_t handle, VulkanObjectType type,
+                                          const unordered_set<VkDeviceMemory> &touched_mems) {
+    for (auto mem : touched_mems) {
+        DEVICE_MEM_INFO *mem_info = GetMemObjInfo(dev_data, mem);
+        auto ref = mem_binding->sparse_memory_refs.find(mem);
+        if (ref->second == 0) {
+            mem_binding->sparse_memory_refs.erase(ref);
+            if (mem_info) mem_info->obj_bindings.erase({handle, type});
+        } else if (mem_info) {
             mem_info->obj_bindings.insert({handle, type});
-            // Need to set mem binding for this object
-            mem_binding->sparse_bindings.insert(binding);
         }
     }
-    return skip;
+}
+
+// Record the opaque binds of one VkSparse*MemoryBindInfo. Binds of memory objects that don't exist are ignored.
+static void RecordSparseMemoryBinds(layer_data *dev_data, uint64_t handle, VulkanObjectType type, uint32_t bind_count,
+                                    const VkSparseMemoryBind *binds) {
+    BINDABLE *mem_binding = GetObjectMemBinding(dev_data, handle, type);
+    if (!mem_binding || !mem_binding->sparse) return;
+    unordered_set<VkDeviceMemory> touched_mems;
+    VkDeviceMemory known_mem = VK_NULL_HANDLE;
+    for (uint32_t i = 0; i < bind_count; i++) {
+        const VkSparseMemoryBind &bind = binds[i];
+        if (bind.memory != VK_NULL_HANDLE && bind.memory != known_mem) {
+            if (!GetMemObjInfo(dev_data, bind.memory)) continue;
+            known_mem = bind.memory;
+        }
+        SetSparseRangeBinding(mem_binding, bind.resourceOffset, bind.size, bind.memory, bind.memoryOffset, &touched_mems);
+    }
+    UpdateSparseMemoryObjBindings(dev_data, mem_binding, handle, type, touched_mems);
+}
+
+// Record the image region binds of one VkSparseImageMemoryBindInfo
+static void RecordSparseImageMemoryBinds(layer_data *dev_data, const VkSparseImageMemoryBindInfo &image_binds) {
+    uint64_t handle = HandleToUint64(image_binds.image);
+    BINDABLE *mem_binding = GetObjectMemBinding(dev_data, handle, kVulkanObjectTypeImage);
+    if (!mem_binding || !mem_binding->sparse) return;
+    unordered_set<VkDeviceMemory> touched_mems;
+    VkDeviceMemory known_mem = VK_NULL_HANDLE;
+    for (uint32_t i = 0; i < image_binds.bindCount; i++) {
+        const VkSparseImageMemoryBind &bind = image_binds.pBinds[i];
+        if (bind.memory != VK_NULL_HANDLE && bind.memory != known_mem) {
+            if (!GetMemObjInfo(dev_data, bind.memory)) continue;
+            known_mem = bind.memory;
+        }
+        SetSparseImageRegionBinding(mem_binding, bind, &touched_mems);
+    }
+    UpdateSparseMemoryObjBindings(dev_data, mem_binding, handle, kVulkanObjectTypeImage, touched_mems);
+}
+
+// Forget the sparse ranges and regions of an object that are bound to a memory object being freed
+static void ClearSparseMemoryBindings(BINDABLE *mem_binding, VkDeviceMemory mem) {
+    if (!mem_binding->sparse_memory_refs.erase(mem)) return;
+    for (auto it = mem_binding->sparse_ranges.begin(); it != mem_binding->sparse_ranges.end();) {
+        it = (it->second.mem == mem) ? mem_binding->sparse_ranges.erase(it) : std::next(it);
+    }
+    for (auto it = mem_binding->sparse_image_regions.begin(); it != mem_binding->sparse_image_regions.end();) {
+        it = (it->second.mem == mem) ? mem_binding->sparse_image_regions.erase(it) : std::next(it);
+    }
 }
 
 // Check object status for selected flag state
@@ -1130,10 +1419,54 @@ static bool verify_set_layout_compatibility(const cvdescriptorset::DescriptorSet
     return descriptor_set->IsCompatible(layout_node.get(), &errorMsg);
 }
 
+static bool ValidateDescriptorSetDrawState(layer_data *dev_data, GLOBAL_CB_NODE *cb_node,
+                                           cvdescriptorset::DescriptorSet *descriptor_set,
+                                           std::map<uint32_t, descriptor_req> const &bindings,
+                                           std::vector<uint32_t> const &dynamic_offsets, const char *function) {
+    CheckProfileScope profile(dev_data, CHECK_PROFILE_DESCRIPTOR_SET_DRAW_STATE);
+    // Apart from the layouts in imageLayoutMap, whatever the check looks at can only change by invalidating the command buffer,
+    //  as updating the set or destroying what it refers to does. Draws with the same bindings as an earlier one pass again.
+    bool const cacheable = CB_RECORDING == cb_node->state || CB_RECORDED == cb_node->state;
+    DEFERRED_DESCRIPTOR_CHECK check = {descriptor_set, &bindings, dynamic_offsets, function};
+    if (cacheable && cb_node->passed_descriptor_checks.count(check)) return false;
+    std::string err_str;
+    if (!descriptor_set->ValidateDrawState(bindings, dynamic_offsets, cb_node, function, &err_str)) {
+        auto set = descriptor_set->GetSet();
+        return log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_DESCRIPTOR_SET_EXT,
+                       HandleToUint64(set), __LINE__, DRAWSTATE_DESCRIPTOR_SET_NOT_UPDATED, "DS",
+                       "Descriptor set 0x%" PRIxLEAST64 " encountered the following validation error at %s time: %s",
+                       HandleToUint64(set), function, err_str.c_str());
+    }
+    if (cacheable) cb_node->passed_descriptor_checks.insert(std::move(check));
+    return false;
+}
+
+// Run the deferred descriptor set checks of cb_node, see deferred_descriptor_checks. Their image layout checks use the layouts
+//  the command buffer has now, so this is called before those change. Any error found is left in deferred_checks_skip.
+void FlushDeferredDrawChecks(layer_data *dev_data, GLOBAL_CB_NODE *cb_node) {
+    // Objects the checks refer to may be gone once the command buffer is invalid, and it can't be submitted anyway
+    if (CB_RECORDING == cb_node->state || CB_RECORDED == cb_node->state) {
+        for (auto const &check : cb_node->deferred_descriptor_checks) {
+            cb_node->deferred_checks_skip |= ValidateDescriptorSetDrawState(
+                dev_data, cb_node, check.descriptor_set, *check.bindings, check.dynamic_offsets, check.function);
+        }
+    }
+    cb_node->deferred_descriptor_checks.clear();
+}
+
+// Run the deferred descriptor set checks of cb_node and return whether any of them, now or earlier, found an error
+static bool ValidateDeferredDrawChecks(layer_data *dev_data, GLOBAL_CB_NODE *cb_node) {
+    FlushDeferredDrawChecks(dev_data, cb_node);
+    bool skip = cb_node->deferred_checks_skip;
+    cb_node->deferred_checks_skip = false;
+    return skip;
+}
+
 // Validate overall state at the time of a draw call
 static bool ValidateDrawState(layer_data *dev_data, GLOBAL_CB_NODE *cb_node, CMD_TYPE cmd_type, const bool indexed,
                               const VkPipelineBindPoint bind_point, const char *function,
                               UNIQUE_VALIDATION_ERROR_CODE const msg_code) {
+    CheckProfileScope profile(dev_data, CHECK_PROFILE_DRAW_STATE);
     bool result = false;
     auto const &state = cb_node->lastBound[bind_point];
     PIPELINE_STATE *pPipe = state.pipeline_state;
@@ -1177,16 +1510,13 @@ static bool ValidateDrawState(layer_data *dev_data, GLOBAL_CB_NODE *cb_node, CMD
                 // Pull the set node
                 cvdescriptorset::DescriptorSet *descriptor_set = state.boundDescriptorSets[setIndex];
                 // Validate the draw-time state for this descriptor set
-                std::string err_str;
-                if (!descriptor_set->IsPushDescriptor() &&
-                    !descriptor_set->ValidateDrawState(set_binding_pair.second, state.dynamicOffsets[setIndex], cb_node, function,
-                                                       &err_str)) {
-                    auto set = descriptor_set->GetSet();
-                    result |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT,
-                                      VK_DEBUG_REPORT_OBJECT_TYPE_DESCRIPTOR_SET_EXT, HandleToUint64(set), __LINE__,
-                                      DRAWSTATE_DESCRIPTOR_SET_NOT_UPDATED, "DS",
-                                      "Descriptor set 0x%" PRIxLEAST64 " encountered the following validation error at %s time: %s",
-                                      HandleToUint64(set), function, err_str.c_str());
+                if (descriptor_set->IsPushDescriptor()) continue;
+                if (dev_data->instance_data->options.deferred_draw_validation) {
+                    cb_node->deferred_descriptor_checks.insert(
+                        {descriptor_set, &set_binding_pair.second, state.dynamicOffsets[setIndex], function});
+                } else {
+                    result |= ValidateDescriptorSetDrawState(dev_data, cb_node, descriptor_set, set_binding_pair.second,
+                                                             state.dynamicOffsets[setIndex], function);
                 }
             }
         }
@@ -1199,6 +1529,49 @@ static bool ValidateDrawState(layer_data *dev_data, GLOBAL_CB_NODE *cb_node, CMD
     return result;
 }
 
+// Expects global_lock to be held by caller
+static void MarkStoreImagesAndBuffersAsWritten(layer_data *dev_data, GLOBAL_CB_NODE *cb_state,
+                                               std::shared_ptr<const cvdescriptorset::StorageUpdates> const &updates) {
+    // Marking memory as valid again changes nothing unless something else was queued in between
+    if (cb_state->storage_updates_op_count != cb_state->deferred_ops.size()) {
+        cb_state->storage_updates.clear();
+    } else if (std::find(cb_state->storage_updates.begin(), cb_state->storage_updates.end(), updates) !=
+               cb_state->storage_updates.end()) {
+        return;
+    }
+    // Long runs of draws with ever different sets only queue some lists more than once
+    if (cb_state->storage_updates.size() >= 64) {
+        cb_state->storage_updates.clear();
+    }
+    cb_state->storage_updates.push_back(updates);
+    // Queueing the same list again only adds an op, it is held once
+    if (cb_state->deferred_storage_updates.empty() || cb_state->deferred_storage_updates.back() != updates) {
+        cb_state->deferred_storage_updates.push_back(updates);
+    }
+
+    CB_DEFERRED_OP op = {};
+    op.type = CB_OP_MARK_STORAGE_WRITTEN;
+    op.storage_updates = updates.get();
+    cb_state->deferred_ops.push_back(op);
+    cb_state->storage_updates_op_count = cb_state->deferred_ops.size();
+}
+
+static void MarkStorageUpdatesAsWritten(layer_data *dev_data, const cvdescriptorset::StorageUpdates *updates) {
+    for (auto image_view : updates->image_views) {
+        auto view_state = GetImageViewState(dev_data, image_view);
+        if (!view_state) continue;
+
+        auto image_state = GetImageState(dev_data, view_state->create_info.image);
+        assert(image_state);
+        SetImageMemoryValid(dev_data, image_state, true);
+    }
+    for (auto buffer : updates->buffers) {
+        auto buffer_state = GetBufferState(dev_data, buffer);
+        assert(buffer_state);
+        SetBufferMemoryValid(dev_data, buffer_state, true);
+    }
+}
+
 static void UpdateDrawState(layer_data *dev_data, GLOBAL_CB_NODE *cb_state, const VkPipelineBindPoint bind_point) {
     auto const &state = cb_state->lastBound[bind_point];
     PIPELINE_STATE *pPipe = state.pipeline_state;
@@ -1211,7 +1584,8 @@ static void UpdateDrawState(layer_data *dev_data, GLOBAL_CB_NODE *cb_state, cons
                 // Bind this set and its active descriptor resources to the command buffer
                 descriptor_set->BindCommandBuffer(cb_state, set_binding_pair.second);
                 // For given active slots record updated images & buffers
-                descriptor_set->GetStorageUpdates(set_binding_pair.second, &cb_state->updateBuffers, &cb_state->updateImages);
+                auto updates = descriptor_set->GetStorageUpdates(set_binding_pair.second);
+                if (updates) MarkStoreImagesAndBuffersAsWritten(dev_data, cb_state, updates);
             }
         }
     }
@@ -1221,13 +1595,13 @@ static void UpdateDrawState(layer_data *dev_data, GLOBAL_CB_NODE *cb_state, cons
 }
 
 // Validate HW line width capabilities prior to setting requested line width.
-static bool verifyLineWidth(layer_data *dev_data, DRAW_STATE_ERROR dsError, VulkanObjectType object_type, const uint64_t &target,
-                            float lineWidth) {
+static bool verifyLineWidth(layer_data *dev_data, debug_report_data const *report_data, DRAW_STATE_ERROR dsError,
+                            VulkanObjectType object_type, const uint64_t &target, float lineWidth) {
     bool skip = false;
 
     // First check to see if the physical device supports wide lines.
     if ((VK_FALSE == dev_data->enabled_features.wideLines) && (1.0f != lineWidth)) {
-        skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, get_debug_report_enum[object_type], target, __LINE__,
+        skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, get_debug_report_enum[object_type], target, __LINE__,
                         dsError, "DS",
                         "Attempt to set lineWidth to %f but physical device wideLines feature "
                         "not supported/enabled so lineWidth must be 1.0f!",
@@ -1236,7 +1610,7 @@ static bool verifyLineWidth(layer_data *dev_data, DRAW_STATE_ERROR dsError, Vulk
         // Otherwise, make sure the width falls in the valid range.
         if ((dev_data->phys_dev_properties.properties.limits.lineWidthRange[0] > lineWidth) ||
             (dev_data->phys_dev_properties.properties.limits.lineWidthRange[1] < lineWidth)) {
-            skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, get_debug_report_enum[object_type], target,
+            skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, get_debug_report_enum[object_type], target,
                             __LINE__, dsError, "DS",
                             "Attempt to set lineWidth to %f but physical device limits line width "
                             "to between [%f, %f]!",
@@ -1289,7 +1663,9 @@ static bool ValidatePipelineLocked(layer_data *dev_data, std::vector<std::unique
 }
 
 // UNLOCKED pipeline validation. DO NOT lookup objects in the layer_data->* maps in this function.
-static bool ValidatePipelineUnlocked(layer_data *dev_data, std::vector<std::unique_ptr<PIPELINE_STATE>> const &pPipelines, int pipelineIndex) {
+// Messages go to report_data, which isn't always dev_data->report_data, see ValidatePipelinesUnlocked.
+static bool ValidatePipelineUnlocked(layer_data *dev_data, debug_report_data const *report_data,
+                                     std::vector<std::unique_ptr<PIPELINE_STATE>> const &pPipelines, int pipelineIndex) {
     bool skip = false;
 
     PIPELINE_STATE *pPipeline = pPipelines[pipelineIndex].get();
@@ -1299,7 +1675,7 @@ static bool ValidatePipelineUnlocked(layer_data *dev_data, std::vector<std::uniq
     // emit errors for renderpass being invalid.
     auto subpass_desc = &pPipeline->render_pass_ci.pSubpasses[pPipeline->graphicsPipelineCI.subpass];
     if (pPipeline->graphicsPipelineCI.subpass >= pPipeline->render_pass_ci.subpassCount) {
-        skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
+        skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
                         HandleToUint64(pPipeline->pipeline), __LINE__, VALIDATION_ERROR_096005ee, "DS",
                         "Invalid Pipeline CreateInfo State: Subpass index %u "
                             "is out of range for this renderpass (0..%u). %s",
@@ -1312,7 +1688,7 @@ static bool ValidatePipelineUnlocked(layer_data *dev_data, std::vector<std::uniq
         const safe_VkPipelineColorBlendStateCreateInfo *color_blend_state = pPipeline->graphicsPipelineCI.pColorBlendState;
         if (color_blend_state->attachmentCount != subpass_desc->colorAttachmentCount) {
             skip |= log_msg(
-                dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
+                report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
                 HandleToUint64(pPipeline->pipeline), __LINE__, VALIDATION_ERROR_096005d4, "DS",
                 "vkCreateGraphicsPipelines(): Render pass (0x%" PRIxLEAST64
                 ") subpass %u has colorAttachmentCount of %u which doesn't match the pColorBlendState->attachmentCount of %u. %s",
@@ -1330,7 +1706,7 @@ static bool ValidatePipelineUnlocked(layer_data *dev_data, std::vector<std::uniq
                     if (memcmp(static_cast<const void *>(pAttachments), static_cast<const void *>(&pAttachments[i]),
                                sizeof(pAttachments[0]))) {
                         skip |=
-                            log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
+                            log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
                                     HandleToUint64(pPipeline->pipeline), __LINE__, VALIDATION_ERROR_0f4004ba, "DS",
                                     "Invalid Pipeline CreateInfo: If independent blend feature not "
                                     "enabled, all elements of pAttachments must be identical. %s",
@@ -1342,21 +1718,21 @@ static bool ValidatePipelineUnlocked(layer_data *dev_data, std::vector<std::uniq
         }
         if (!dev_data->enabled_features.logicOp && (pPipeline->graphicsPipelineCI.pColorBlendState->logicOpEnable != VK_FALSE)) {
             skip |=
-                log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
+                log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
                         HandleToUint64(pPipeline->pipeline), __LINE__, VALIDATION_ERROR_0f4004bc, "DS",
                         "Invalid Pipeline CreateInfo: If logic operations feature not enabled, logicOpEnable must be VK_FALSE. %s",
                         validation_error_map[VALIDATION_ERROR_0f4004bc]);
         }
     }
 
-    if (validate_and_capture_pipeline_shader_state(dev_data, pPipeline)) {
+    if (validate_and_capture_pipeline_shader_state(dev_data, report_data, pPipeline)) {
         skip = true;
     }
     // Each shader's stage must be unique
     if (pPipeline->duplicate_shaders) {
         for (uint32_t stage = VK_SHADER_STAGE_VERTEX_BIT; stage & VK_SHADER_STAGE_ALL_GRAPHICS; stage <<= 1) {
             if (pPipeline->duplicate_shaders & stage) {
-                skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
+                skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
                                 HandleToUint64(pPipeline->pipeline), __LINE__, DRAWSTATE_INVALID_PIPELINE_CREATE_STATE, "DS",
                                 "Invalid Pipeline CreateInfo State: Multiple shaders provided for stage %s",
                                 string_VkShaderStageFlagBits(VkShaderStageFlagBits(stage)));
@@ -1365,7 +1741,7 @@ static bool ValidatePipelineUnlocked(layer_data *dev_data, std::vector<std::uniq
     }
     // VS is required
     if (!(pPipeline->active_shaders & VK_SHADER_STAGE_VERTEX_BIT)) {
-        skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
+        skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
                         HandleToUint64(pPipeline->pipeline), __LINE__, VALIDATION_ERROR_096005ae, "DS",
                         "Invalid Pipeline CreateInfo State: Vertex Shader required. %s",
                         validation_error_map[VALIDATION_ERROR_096005ae]);
@@ -1374,20 +1750,20 @@ static bool ValidatePipelineUnlocked(layer_data *dev_data, std::vector<std::uniq
     bool has_control = (pPipeline->active_shaders & VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT) != 0;
     bool has_eval = (pPipeline->active_shaders & VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT) != 0;
     if (has_control && !has_eval) {
-        skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
+        skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
                         HandleToUint64(pPipeline->pipeline), __LINE__, VALIDATION_ERROR_096005b2, "DS",
                         "Invalid Pipeline CreateInfo State: TE and TC shaders must be included or excluded as a pair. %s",
                         validation_error_map[VALIDATION_ERROR_096005b2]);
     }
     if (!has_control && has_eval) {
-        skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
+        skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
                         HandleToUint64(pPipeline->pipeline), __LINE__, VALIDATION_ERROR_096005b4, "DS",
                         "Invalid Pipeline CreateInfo State: TE and TC shaders must be included or excluded as a pair. %s",
                         validation_error_map[VALIDATION_ERROR_096005b4]);
     }
     // Compute shaders should be specified independent of Gfx shaders
     if (pPipeline->active_shaders & VK_SHADER_STAGE_COMPUTE_BIT) {
-        skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
+        skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
                         HandleToUint64(pPipeline->pipeline), __LINE__, VALIDATION_ERROR_096005b0, "DS",
                         "Invalid Pipeline CreateInfo State: Do not specify Compute Shader for Gfx Pipeline. %s",
                         validation_error_map[VALIDATION_ERROR_096005b0]);
@@ -1397,7 +1773,7 @@ static bool ValidatePipelineUnlocked(layer_data *dev_data, std::vector<std::uniq
     if (has_control && has_eval &&
         (!pPipeline->graphicsPipelineCI.pInputAssemblyState ||
          pPipeline->graphicsPipelineCI.pInputAssemblyState->topology != VK_PRIMITIVE_TOPOLOGY_PATCH_LIST)) {
-        skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
+        skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
                         HandleToUint64(pPipeline->pipeline), __LINE__, VALIDATION_ERROR_096005c0, "DS",
                         "Invalid Pipeline CreateInfo State: "
                         "VK_PRIMITIVE_TOPOLOGY_PATCH_LIST must be set as IA "
@@ -1407,7 +1783,7 @@ static bool ValidatePipelineUnlocked(layer_data *dev_data, std::vector<std::uniq
     if (pPipeline->graphicsPipelineCI.pInputAssemblyState &&
         pPipeline->graphicsPipelineCI.pInputAssemblyState->topology == VK_PRIMITIVE_TOPOLOGY_PATCH_LIST) {
         if (!has_control || !has_eval) {
-            skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
+            skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
                             HandleToUint64(pPipeline->pipeline), __LINE__, VALIDATION_ERROR_096005c2, "DS",
                             "Invalid Pipeline CreateInfo State: "
                             "VK_PRIMITIVE_TOPOLOGY_PATCH_LIST primitive "
@@ -1420,14 +1796,14 @@ static bool ValidatePipelineUnlocked(layer_data *dev_data, std::vector<std::uniq
     if (pPipeline->graphicsPipelineCI.pRasterizationState) {
         // Make sure that the line width conforms to the HW.
         if (!isDynamic(pPipeline, VK_DYNAMIC_STATE_LINE_WIDTH)) {
-            skip |=
-                verifyLineWidth(dev_data, DRAWSTATE_INVALID_PIPELINE_CREATE_STATE, kVulkanObjectTypePipeline,
-                                HandleToUint64(pPipeline->pipeline), pPipeline->graphicsPipelineCI.pRasterizationState->lineWidth);
+            skip |= verifyLineWidth(dev_data, report_data, DRAWSTATE_INVALID_PIPELINE_CREATE_STATE, kVulkanObjectTypePipeline,
+                                    HandleToUint64(pPipeline->pipeline),
+                                    pPipeline->graphicsPipelineCI.pRasterizationState->lineWidth);
         }
 
         if ((pPipeline->graphicsPipelineCI.pRasterizationState->depthClampEnable == VK_TRUE) &&
             (!dev_data->enabled_features.depthClamp)) {
-            skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
+            skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
                             HandleToUint64(pPipeline->pipeline), __LINE__, VALIDATION_ERROR_1020061c, "DS",
                             "vkCreateGraphicsPipelines(): the depthClamp device feature is disabled: the depthClampEnable "
                             "member of the VkPipelineRasterizationStateCreateInfo structure must be set to VK_FALSE. %s",
@@ -1437,7 +1813,7 @@ static bool ValidatePipelineUnlocked(layer_data *dev_data, std::vector<std::uniq
         if (!isDynamic(pPipeline, VK_DYNAMIC_STATE_DEPTH_BIAS) &&
             (pPipeline->graphicsPipelineCI.pRasterizationState->depthBiasClamp != 0.0) &&
             (!dev_data->enabled_features.depthBiasClamp)) {
-            skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
+            skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
                             HandleToUint64(pPipeline->pipeline), __LINE__, DRAWSTATE_INVALID_FEATURE, "DS",
                             "vkCreateGraphicsPipelines(): the depthBiasClamp device feature is disabled: the depthBiasClamp "
                             "member of the VkPipelineRasterizationStateCreateInfo structure must be set to 0.0 unless the "
@@ -1448,7 +1824,7 @@ static bool ValidatePipelineUnlocked(layer_data *dev_data, std::vector<std::uniq
         if (pPipeline->graphicsPipelineCI.pRasterizationState->rasterizerDiscardEnable == VK_FALSE) {
             if ((pPipeline->graphicsPipelineCI.pMultisampleState->alphaToOneEnable == VK_TRUE) &&
                 (!dev_data->enabled_features.alphaToOne)) {
-                skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
+                skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
                                 HandleToUint64(pPipeline->pipeline), __LINE__, VALIDATION_ERROR_10000622, "DS",
                                 "vkCreateGraphicsPipelines(): the alphaToOne device feature is disabled: the alphaToOneEnable "
                                 "member of the VkPipelineMultisampleStateCreateInfo structure must be set to VK_FALSE. %s",
@@ -1459,7 +1835,7 @@ static bool ValidatePipelineUnlocked(layer_data *dev_data, std::vector<std::uniq
             if (subpass_desc && subpass_desc->pDepthStencilAttachment &&
                 subpass_desc->pDepthStencilAttachment->attachment != VK_ATTACHMENT_UNUSED) {
                 if (!pPipeline->graphicsPipelineCI.pDepthStencilState) {
-                    skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
+                    skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
                                     HandleToUint64(pPipeline->pipeline), __LINE__, VALIDATION_ERROR_096005e0, "DS",
                                     "Invalid Pipeline CreateInfo State: pDepthStencilState is NULL when rasterization is "
                                     "enabled and subpass uses a depth/stencil attachment. %s",
@@ -1468,7 +1844,7 @@ static bool ValidatePipelineUnlocked(layer_data *dev_data, std::vector<std::uniq
                 } else if ((pPipeline->graphicsPipelineCI.pDepthStencilState->depthBoundsTestEnable == VK_TRUE) &&
                            (!dev_data->enabled_features.depthBounds)) {
                     skip |= log_msg(
-                        dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
+                        report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
                         HandleToUint64(pPipeline->pipeline), __LINE__, DRAWSTATE_INVALID_FEATURE, "DS",
                         "vkCreateGraphicsPipelines(): the depthBounds device feature is disabled: the depthBoundsTestEnable "
                         "member of the VkPipelineDepthStencilStateCreateInfo structure must be set to VK_FALSE.");
@@ -1484,7 +1860,7 @@ static bool ValidatePipelineUnlocked(layer_data *dev_data, std::vector<std::uniq
                     }
                 }
                 if (color_attachment_count > 0 && pPipeline->graphicsPipelineCI.pColorBlendState == nullptr) {
-                    skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
+                    skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
                                     HandleToUint64(pPipeline->pipeline), __LINE__, VALIDATION_ERROR_096005e2, "DS",
                                     "Invalid Pipeline CreateInfo State: pColorBlendState is NULL when rasterization is "
                                     "enabled and subpass uses color attachments. %s",
@@ -1503,7 +1879,7 @@ static bool ValidatePipelineUnlocked(layer_data *dev_data, std::vector<std::uniq
             dev_data->instance_data->dispatch_table.GetPhysicalDeviceFormatProperties(dev_data->physical_device, format, &properties);
             if ((properties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT) == 0) {
                 skip |= log_msg(
-                    dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_UNKNOWN_EXT, 0,
+                    report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_UNKNOWN_EXT, 0,
                     __LINE__, VALIDATION_ERROR_14a004de, "IMAGE",
                     "vkCreateGraphicsPipelines: pCreateInfo[%d].pVertexInputState->vertexAttributeDescriptions[%d].format "
                         "(%s) is not a supported vertex buffer format. %s",
@@ -1524,7 +1900,7 @@ static bool ValidatePipelineUnlocked(layer_data *dev_data, std::vector<std::uniq
         }
         if (pPipeline->graphicsPipelineCI.pMultisampleState->rasterizationSamples != max_sample_count) {
             skip |=
-                log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
+                log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT,
                         HandleToUint64(pPipeline->pipeline), __LINE__, VALIDATION_ERROR_09600bc2, "DS",
                         "vkCreateGraphicsPipelines: pCreateInfo[%d].pMultisampleState->rasterizationSamples (%s) != max attachment samples (%s) "
                         "used in subpass %u. %s",
@@ -1537,6 +1913,102 @@ static bool ValidatePipelineUnlocked(layer_data *dev_data, std::vector<std::uniq
     return skip;
 }
 
+// A message logged while validating a pipeline on a worker thread
+struct CAPTURED_MESSAGE {
+    VkFlags flags;
+    VkDebugReportObjectTypeEXT object_type;
+    uint64_t object;
+    size_t location;
+    int32_t code;
+    std::string layer_prefix;
+    std::string message;
+};
+
+static VKAPI_ATTR VkBool32 VKAPI_CALL CaptureMessage(VkFlags msgFlags, VkDebugReportObjectTypeEXT objType, uint64_t srcObject,
+                                                     size_t location, int32_t msgCode, const char *pLayerPrefix, const char *pMsg,
+                                                     void *pUserData) {
+    static_cast<std::vector<CAPTURED_MESSAGE> *>(pUserData)->push_back(
+        {msgFlags, objType, srcObject, location, msgCode, pLayerPrefix, pMsg});
+    return VK_FALSE;
+}
+
+// Runs ValidatePipelineUnlocked for each pipeline, on several threads when there is more than one pipeline. The messages of
+// each pipeline are captured and sent to the application's callbacks afterwards, on this thread and in pipeline order, so
+// they come out as they would from validating one pipeline after the other.
+static bool ValidatePipelinesUnlocked(layer_data *dev_data, std::vector<std::unique_ptr<PIPELINE_STATE>> const &pPipelines) {
+    uint32_t count = static_cast<uint32_t>(pPipelines.size());
+    uint32_t thread_count = dev_data->instance_data->options.pipeline_validation_threads;
+    if (thread_count == 0) {
+        thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    thread_count = std::min(thread_count, count);
+
+    bool skip = false;
+    if (thread_count <= 1) {
+        for (uint32_t i = 0; i < count; i++) {
+            skip |= ValidatePipelineUnlocked(dev_data, dev_data->report_data, pPipelines, i);
+        }
+        return skip;
+    }
+
+    // Object names are added when the messages are sent on
+    std::unordered_map<uint64_t, std::string> no_names;
+    std::vector<std::vector<CAPTURED_MESSAGE>> messages(count);
+    std::vector<uint8_t> results(count, 0);
+    std::atomic<uint32_t> next_pipeline{0};
+
+    auto validate = [&]() {
+        for (uint32_t i = next_pipeline++; i < count; i = next_pipeline++) {
+            VkLayerDbgFunctionNode capture_node = {};
+            // The budget is applied when the messages are sent on, the captured ones are all kept
+            debug_report_message_counts no_budget;
+            capture_node.pfnMsgCallback = CaptureMessage;
+            capture_node.msgFlags = dev_data->report_data->active_flags;
+            capture_node.pUserData = &messages[i];
+
+            debug_report_data capture = *dev_data->report_data;
+            capture.debug_callback_list = &capture_node;
+            capture.default_debug_callback_list = nullptr;
+            capture.debugObjectNameMap = &no_names;
+            capture.delivery_queue = nullptr;
+            capture.message_counts = &no_budget;
+            results[i] = ValidatePipelineUnlocked(dev_data, &capture, pPipelines, i);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < thread_count; i++) {
+        threads.emplace_back(validate);
+    }
+    validate();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    // Sent here rather than through the delivery thread, after what it still has, so the order is kept
+    debug_report_flush_delivery_queue(dev_data->report_data);
+    bool budgeted = dev_data->report_data->message_counts->budget.load(std::memory_order_relaxed) != 0;
+    for (uint32_t i = 0; i < count; i++) {
+        skip |= results[i] != 0;
+        for (auto const &message : messages[i]) {
+            bool message_skip = false;
+            if (budgeted && debug_report_msg_over_budget(dev_data->report_data, message.flags, message.object_type,
+                                                         message.object, message.code, message.layer_prefix.c_str(),
+                                                         &message_skip)) {
+                skip |= message_skip;
+                continue;
+            }
+            message_skip = debug_report_log_msg(dev_data->report_data, message.flags, message.object_type, message.object,
+                                                message.location, message.code, message.layer_prefix.c_str(),
+                                                message.message.c_str());
+            if (budgeted && message_skip) {
+                debug_report_set_msg_skip(dev_data->report_data, message.object, message.code, message_skip);
+            }
+            skip |= message_skip;
+        }
+    }
+    return skip;
+}
+
 // Block of code at start here specifically for managing/tracking DSs
 
 // Return Pool node ptr for specified pool or else NULL
@@ -1573,20 +2045,36 @@ static bool validateIdleDescriptorSet(const layer_data *dev_data, VkDescriptorSe
     return skip;
 }
 
-// Remove set from setMap and delete the set
-static void freeDescriptorSet(layer_data *dev_data, cvdescriptorset::DescriptorSet *descriptor_set) {
+// Remove set from setMap and give it back to its pool for reuse
+static void freeDescriptorSet(layer_data *dev_data, DESCRIPTOR_POOL_STATE *pool_state,
+                              cvdescriptorset::DescriptorSet *descriptor_set) {
     dev_data->setMap.erase(descriptor_set->GetSet());
-    delete descriptor_set;
+    descriptor_set->Free();
+    // Move the last set into the freed set's place
+    auto last_set = pool_state->sets.back();
+    last_set->SetPoolIndex(descriptor_set->GetPoolIndex());
+    pool_state->sets[descriptor_set->GetPoolIndex()] = last_set;
+    pool_state->sets.pop_back();
+    pool_state->free_sets.push_back(descriptor_set);
+}
+// Remove the sets of a pool from setMap and delete them along with the ones kept for reuse
+static void deleteDescriptorSets(layer_data *dev_data, DESCRIPTOR_POOL_STATE *pool_state) {
+    for (auto ds : pool_state->sets) {
+        dev_data->setMap.erase(ds->GetSet());
+        delete ds;
+    }
+    pool_state->sets.clear();
+    for (auto ds : pool_state->free_sets) {
+        delete ds;
+    }
+    pool_state->free_sets.clear();
 }
 // Free all DS Pools including their Sets & related sub-structs
 // NOTE : Calls to this function should be wrapped in mutex
 static void deletePools(layer_data *dev_data) {
     for (auto ii = dev_data->descriptorPoolMap.begin(); ii != dev_data->descriptorPoolMap.end();) {
         // Remove this pools' sets from setMap and delete them
-        for (auto ds : ii->second->sets) {
-            freeDescriptorSet(dev_data, ds);
-        }
-        ii->second->sets.clear();
+        deleteDescriptorSets(dev_data, ii->second);
         delete ii->second;
         ii = dev_data->descriptorPoolMap.erase(ii);
     }
@@ -1596,10 +2084,12 @@ static void clearDescriptorPool(layer_data *dev_data, const VkDevice device, con
                                 VkDescriptorPoolResetFlags flags) {
     DESCRIPTOR_POOL_STATE *pPool = GetDescriptorPoolState(dev_data, pool);
     // TODO: validate flags
-    // For every set off of this pool, clear it, remove from setMap, and free cvdescriptorset::DescriptorSet
+    // For every set off of this pool, clear it, remove from setMap, and keep the cvdescriptorset::DescriptorSet for reuse
     for (auto ds : pPool->sets) {
-        freeDescriptorSet(dev_data, ds);
+        dev_data->setMap.erase(ds->GetSet());
+        ds->Free();
     }
+    pPool->free_sets.insert(pPool->free_sets.end(), pPool->sets.begin(), pPool->sets.end());
     pPool->sets.clear();
     // Reset available count for each type and available sets for this pool
     for (uint32_t i = 0; i < pPool->availableDescriptorTypeCount.size(); ++i) {
@@ -1617,6 +2107,103 @@ GLOBAL_CB_NODE *GetCBNode(layer_data const *dev_data, const VkCommandBuffer cb)
     return it->second;
 }
 
+// Returns the events cb_node had waited on when it last reset query, or nullptr if it doesn't reset query
+static const std::vector<VkEvent> *GetEventsWaitedBeforeQueryReset(GLOBAL_CB_NODE const *cb_node, QueryObject query) {
+    auto const &resets = cb_node->waitedEventsBeforeQueryReset;
+    for (auto reset = resets.rbegin(); reset != resets.rend(); ++reset) {
+        if (reset->pool == query.pool && query.index >= reset->first_query &&
+            query.index < reset->first_query + reset->query_count) {
+            return &reset->events;
+        }
+    }
+    return nullptr;
+}
+
+// Lock for calls that record into a single command buffer, see global_lock. Used like unique_lock_t.
+class record_lock_t {
+   public:
+    record_lock_t(layer_data const *dev_data, VkCommandBuffer command_buffer)
+        : dev_data_(dev_data), command_buffer_(command_buffer) {
+        lock();
+    }
+    ~record_lock_t() {
+        if (owns_lock_) unlock();
+    }
+
+    void lock() {
+        assert(!owns_lock_);
+        global_lock.lock_shared();
+        cb_state_ = GetCBNode(dev_data_, command_buffer_);
+        if (cb_state_) cb_state_->record_mutex.lock();
+        owns_lock_ = true;
+    }
+
+    void unlock() {
+        assert(owns_lock_);
+        if (cb_state_) cb_state_->record_mutex.unlock();
+        global_lock.unlock_shared();
+        owns_lock_ = false;
+    }
+
+   private:
+    layer_data const *dev_data_;
+    VkCommandBuffer command_buffer_;
+    GLOBAL_CB_NODE *cb_state_ = nullptr;
+    bool owns_lock_ = false;
+};
+
+// Runs the deferred descriptor set checks of command buffers once they are ended, so the threads recording them don't wait
+//  on the checks. Errors are reported from the worker thread. Checks it hasn't got to when a command buffer is submitted,
+//  executed or reset are run there, as without the worker.
+class DrawValidationWorker {
+   public:
+    explicit DrawValidationWorker(layer_data *dev_data) : dev_data_(dev_data), thread_(&DrawValidationWorker::Run, this) {}
+    // Runs what is still queued and stops the thread
+    ~DrawValidationWorker() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        condition_.notify_one();
+        thread_.join();
+    }
+
+    void Push(VkCommandBuffer command_buffer) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(command_buffer);
+        }
+        condition_.notify_one();
+    }
+
+   private:
+    void Run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            condition_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (queue_.empty()) return;
+            VkCommandBuffer command_buffer = queue_.front();
+            queue_.pop_front();
+            lock.unlock();
+            {
+                // The handle may have been freed, or even reused, meanwhile. The checks are those of whatever is recorded
+                //  into it now, so running them early is still right.
+                record_lock_t record_lock(dev_data_, command_buffer);
+                GLOBAL_CB_NODE *cb_node = GetCBNode(dev_data_, command_buffer);
+                if (cb_node && !cb_node->deferred_descriptor_checks.empty()) FlushDeferredDrawChecks(dev_data_, cb_node);
+            }
+            lock.lock();
+        }
+    }
+
+    layer_data *dev_data_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::deque<VkCommandBuffer> queue_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
 // If a renderpass is active, verify that the given command type is appropriate for current subpass state
 bool ValidateCmdSubpassState(const layer_data *dev_data, const GLOBAL_CB_NODE *pCB, const CMD_TYPE cmd_type) {
     if (!pCB->activeRenderPass) return false;
@@ -1681,9 +2268,46 @@ static bool ReportInvalidCommandBuffer(layer_data *dev_data, const GLOBAL_CB_NOD
 
 // Validate the given command being added to the specified cmd buffer, flagging errors if CB is not in the recording state or if
 // there's an issue with the Cmd ordering
+static void invalidateCommandBuffer(const layer_data *dev_data, GLOBAL_CB_NODE *cb_node, VK_OBJECT obj) {
+    if (cb_node->state == CB_RECORDING) {
+        log_msg(dev_data->report_data, VK_DEBUG_REPORT_WARNING_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_COMMAND_BUFFER_EXT,
+                HandleToUint64(cb_node->commandBuffer), __LINE__, DRAWSTATE_INVALID_COMMAND_BUFFER, "DS",
+                "Invalidating a command buffer that's currently being recorded: 0x%p.", cb_node->commandBuffer);
+        cb_node->state = CB_INVALID_INCOMPLETE;
+    }
+    else if (cb_node->state == CB_RECORDED) {
+        cb_node->state = CB_INVALID_COMPLETE;
+    }
+    cb_node->broken_bindings.push_back(obj);
+
+    // if secondary, then propagate the invalidation to the primaries that will call us.
+    if (cb_node->createInfo.level == VK_COMMAND_BUFFER_LEVEL_SECONDARY) {
+        invalidateCommandBuffers(dev_data, cb_node->linkedCommandBuffers, obj);
+    }
+}
+
+// Invalidate cb_node if it bound any of the objects destroyed since it was last checked
+static void CheckDestroyedBindings(const layer_data *dev_data, GLOBAL_CB_NODE *cb_node) {
+    uint64_t const generation = GetDestroyedObjectsGeneration(dev_data);
+    if (cb_node->destroyed_objects_checked == generation) return;
+    if (!cb_node->binding_generations.empty()) {
+        for (uint64_t i = cb_node->destroyed_objects_checked; i < generation; ++i) {
+            VK_OBJECT const &obj = dev_data->destroyed_objects[i - dev_data->destroyed_objects_base];
+            auto binding = cb_node->binding_generations.find(obj);
+            // Object i was destroyed at generation i + 1, after bindings made at generation i or earlier
+            if (binding != cb_node->binding_generations.end() && binding->second <= i) {
+                invalidateCommandBuffer(dev_data, cb_node, obj);
+            }
+        }
+    }
+    cb_node->destroyed_objects_checked = generation;
+}
+
 bool ValidateCmd(layer_data *dev_data, const GLOBAL_CB_NODE *cb_state, const CMD_TYPE cmd, const char *caller_name) {
+    if (cb_state->state == CB_RECORDING) CheckDestroyedBindings(dev_data, const_cast<GLOBAL_CB_NODE *>(cb_state));
     switch (cb_state->state) {
         case CB_RECORDING:
+            const_cast<GLOBAL_CB_NODE *>(cb_state)->last_cmd = cmd;
             return ValidateCmdSubpassState(dev_data, cb_state, cmd);
 
         case CB_INVALID_COMPLETE:
@@ -1768,20 +2392,42 @@ BASE_NODE *GetStateStructPtrFromObject(layer_data *dev_data, VK_OBJECT object_st
 // Tie the VK_OBJECT to the cmd buffer which includes:
 //  Add object_binding to cmd buffer
 //  Add cb_binding to object
-static void addCommandBufferBinding(std::unordered_set<GLOBAL_CB_NODE *> *cb_bindings, VK_OBJECT obj, GLOBAL_CB_NODE *cb_node) {
-    cb_bindings->insert(cb_node);
+static void addCommandBufferBinding(BASE_NODE *base_obj, VK_OBJECT obj, GLOBAL_CB_NODE *cb_node) {
+    base_obj->AddBoundCommandBuffer(cb_node);
     cb_node->object_bindings.insert(obj);
 }
 // For a given object, if cb_node is in that objects cb_bindings, remove cb_node
 static void removeCommandBufferBinding(layer_data *dev_data, VK_OBJECT const *object, GLOBAL_CB_NODE *cb_node) {
+    // Objects bound with AddLazyCommandBufferBinding() don't keep the command buffer
+    if (cb_node->binding_generations.count(*object)) return;
     BASE_NODE *base_obj = GetStateStructPtrFromObject(dev_data, *object);
     if (base_obj) base_obj->cb_bindings.erase(cb_node);
 }
 // Reset the command buffer state
 //  Maintain the createInfo and set state to CB_NEW, but clear all other state
+// Empties the containers of pCB that allocate from its recording_arena by replacing them, so none of them holds on to arena
+//  memory, and then gives all of that memory back at once
+static void ResetRecordingArena(GLOBAL_CB_NODE *pCB) {
+    RecordingArena *arena = &pCB->recording_arena;
+    pCB->framebuffers = RecordingSet<VkFramebuffer>(arena);
+    pCB->object_bindings = RecordingSet<VK_OBJECT>(arena);
+    pCB->binding_generations = RecordingMap<VK_OBJECT, uint64_t>(arena);
+    pCB->waitedEvents = RecordingSet<VkEvent>(arena);
+    pCB->query_states = RecordingMap<VkQueryPool, QueryStates>(arena);
+    pCB->activeQueries = RecordingSet<QueryObject>(arena);
+    pCB->startedQueries = RecordingSet<QueryObject>(arena);
+    pCB->eventToStageMap = RecordingMap<VkEvent, VkPipelineStageFlags>(arena);
+    pCB->memObjs = RecordingSet<VkDeviceMemory>(arena);
+    pCB->deferred_ops = RecordingVector<CB_DEFERRED_OP>(arena);
+    pCB->deferred_barrier_checks = RecordingVector<CB_DEFERRED_BARRIER_CHECK>(arena);
+    arena->Reset();
+}
+
 static void resetCB(layer_data *dev_data, const VkCommandBuffer cb) {
     GLOBAL_CB_NODE *pCB = dev_data->commandBufferMap[cb];
     if (pCB) {
+        // With the worker, the checks of ended command buffers run even if they aren't submitted. Finish those it hasn't yet.
+        if (dev_data->draw_validation_worker && !pCB->deferred_descriptor_checks.empty()) FlushDeferredDrawChecks(dev_data, pCB);
         pCB->in_use.store(0);
         // Reset CB state (note that createInfo is not cleared)
         pCB->commandBuffer = cb;
@@ -1804,15 +2450,10 @@ static void resetCB(layer_data *dev_data, const VkCommandBuffer cb) {
         pCB->activeSubpassContents = VK_SUBPASS_CONTENTS_INLINE;
         pCB->activeSubpass = 0;
         pCB->broken_bindings.clear();
-        pCB->waitedEvents.clear();
         pCB->events.clear();
         pCB->writeEventsBeforeWait.clear();
         pCB->waitedEventsBeforeQueryReset.clear();
-        pCB->queryToStateMap.clear();
-        pCB->activeQueries.clear();
-        pCB->startedQueries.clear();
         pCB->imageLayoutMap.clear();
-        pCB->eventToStageMap.clear();
         pCB->drawData.clear();
         pCB->currentDrawData.buffers.clear();
         pCB->vertex_buffer_used = false;
@@ -1829,26 +2470,31 @@ static void resetCB(layer_data *dev_data, const VkCommandBuffer cb) {
             pSubCB->linkedCommandBuffers.erase(pCB);
         }
         pCB->linkedCommandBuffers.clear();
-        pCB->updateImages.clear();
-        pCB->updateBuffers.clear();
+        pCB->storage_updates.clear();
+        pCB->storage_updates_op_count = 0;
+        pCB->deferred_storage_updates.clear();
         clear_cmd_buf_and_mem_references(dev_data, pCB);
-        pCB->queue_submit_functions.clear();
-        pCB->cmd_execute_commands_functions.clear();
-        pCB->eventUpdates.clear();
-        pCB->queryUpdates.clear();
+        pCB->deferred_descriptor_checks.clear();
+        pCB->deferred_checks_skip = false;
+        pCB->passed_descriptor_checks.clear();
+        pCB->resources_validated = false;
+        pCB->draw_sample_count = 0;
+        pCB->last_cmd = CMD_NONE;
+        pCB->image_layouts_validated_generation = 0;
+        pCB->destroyed_objects_checked = GetDestroyedObjectsGeneration(dev_data);
+        pCB->validated_image_layouts.clear();
 
         // Remove object bindings
         for (auto obj : pCB->object_bindings) {
             removeCommandBufferBinding(dev_data, &obj, pCB);
         }
-        pCB->object_bindings.clear();
         // Remove this cmdBuffer's reference from each FrameBuffer's CB ref list
         for (auto framebuffer : pCB->framebuffers) {
             auto fb_state = GetFramebufferState(dev_data, framebuffer);
             if (fb_state) fb_state->cb_bindings.erase(pCB);
         }
-        pCB->framebuffers.clear();
         pCB->activeFramebuffer = VK_NULL_HANDLE;
+        ResetRecordingArena(pCB);
     }
 }
 
@@ -1923,8 +2569,127 @@ bool outsideRenderPass(const layer_data *dev_data, GLOBAL_CB_NODE *pCB, const ch
     return outside;
 }
 
+// Allocations smaller than this get a PERF_HINT_SMALL_ALLOCATION
+static const VkDeviceSize kPerfHintSmallAllocationSize = 256 * 1024;
+// Frames with more vkQueueSubmit calls of a single command buffer than this get a PERF_HINT_SUBMIT_PER_COMMAND_BUFFER
+static const uint32_t kPerfHintSingleSubmitsPerFrame = 4;
+// Descriptor pools reset in this many consecutive frames get a PERF_HINT_DESCRIPTOR_POOL_RESET_PER_FRAME
+static const uint32_t kPerfHintResetFrames = 3;
+
+// Logs a hint of lunarg_core_validation.perf_hints as a performance warning. Each kind of hint is logged the 1st, 2nd, 4th,
+//  8th... time it is seen, along with that count, so a pitfall repeated in every frame doesn't flood the log.
+static void LogPerfHint(layer_data *dev_data, PERF_HINT hint, VkDebugReportObjectTypeEXT object_type, uint64_t object,
+                        const char *format, ...) {
+    uint32_t const count = ++dev_data->perf_hint_counts[hint];
+    if (count & (count - 1)) return;
+
+    char message[1024];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    log_msg(dev_data->report_data, VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT, object_type, object, __LINE__, hint, "PERF",
+            "%s (seen %u times)", message, count);
+}
+
+// Clearing all of an attachment that the render pass loads: the load reads memory that the clear overwrites
+static void PerfHintCmdClearAttachments(layer_data *dev_data, GLOBAL_CB_NODE *cb_state, uint32_t attachmentCount,
+                                        const VkClearAttachment *pAttachments, uint32_t rectCount, const VkClearRect *pRects) {
+    if (!cb_state->activeRenderPass || cb_state->hasDrawCmd || cb_state->createInfo.level != VK_COMMAND_BUFFER_LEVEL_PRIMARY) {
+        return;
+    }
+    auto const &area = cb_state->activeRenderPassBeginInfo.renderArea;
+    bool whole_area = false;
+    for (uint32_t i = 0; i < rectCount; i++) {
+        auto const &rect = pRects[i].rect;
+        whole_area |= rect.offset.x <= area.offset.x && rect.offset.y <= area.offset.y &&
+                      rect.offset.x + rect.extent.width >= area.offset.x + area.extent.width &&
+                      rect.offset.y + rect.extent.height >= area.offset.y + area.extent.height;
+    }
+    if (!whole_area) return;
+
+    auto const render_pass_ci = cb_state->activeRenderPass->createInfo.ptr();
+    auto const &subpass = render_pass_ci->pSubpasses[cb_state->activeSubpass];
+    for (uint32_t i = 0; i < attachmentCount; i++) {
+        auto const aspects = pAttachments[i].aspectMask;
+        uint32_t attachment = VK_ATTACHMENT_UNUSED;
+        if (aspects & VK_IMAGE_ASPECT_COLOR_BIT) {
+            if (pAttachments[i].colorAttachment < subpass.colorAttachmentCount) {
+                attachment = subpass.pColorAttachments[pAttachments[i].colorAttachment].attachment;
+            }
+        } else if (subpass.pDepthStencilAttachment) {
+            attachment = subpass.pDepthStencilAttachment->attachment;
+        }
+        if (attachment == VK_ATTACHMENT_UNUSED) continue;
+
+        auto const &desc = render_pass_ci->pAttachments[attachment];
+        bool loaded = (aspects & (VK_IMAGE_ASPECT_COLOR_BIT | VK_IMAGE_ASPECT_DEPTH_BIT)) && desc.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+        loaded |= (aspects & VK_IMAGE_ASPECT_STENCIL_BIT) && desc.stencilLoadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+        if (!loaded) continue;
+
+        uint64_t const load_kb = static_cast<uint64_t>(area.extent.width) * area.extent.height * FormatSize(desc.format) *
+                                 desc.samples / 1024;
+        LogPerfHint(dev_data, PERF_HINT_LOAD_OP_LOAD_CLEARED, VK_DEBUG_REPORT_OBJECT_TYPE_COMMAND_BUFFER_EXT,
+                    HandleToUint64(cb_state->commandBuffer),
+                    "vkCmdClearAttachments() clears all of attachment %u of render pass 0x%" PRIx64
+                    ", which loads it with VK_ATTACHMENT_LOAD_OP_LOAD. The load reads about %" PRIu64
+                    " KiB per pass that the clear overwrites; use VK_ATTACHMENT_LOAD_OP_CLEAR instead.",
+                    attachment, HandleToUint64(cb_state->activeRenderPass->renderPass), load_kb);
+    }
+}
+
+// Barriers that could be merged into the previous one, and images moved to VK_IMAGE_LAYOUT_GENERAL without need
+static void PerfHintCmdPipelineBarrier(layer_data *dev_data, GLOBAL_CB_NODE *cb_state, bool follows_barrier,
+                                       VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask,
+                                       uint32_t imageMemoryBarrierCount, const VkImageMemoryBarrier *pImageMemoryBarriers) {
+    if (follows_barrier) {
+        LogPerfHint(dev_data, PERF_HINT_REDUNDANT_BARRIER, VK_DEBUG_REPORT_OBJECT_TYPE_COMMAND_BUFFER_EXT,
+                    HandleToUint64(cb_state->commandBuffer),
+                    "vkCmdPipelineBarrier() (srcStageMask 0x%x, dstStageMask 0x%x) directly follows another pipeline barrier. "
+                    "Each barrier can drain the pipeline of the work before it; merge them into one call.",
+                    srcStageMask, dstStageMask);
+    }
+    for (uint32_t i = 0; i < imageMemoryBarrierCount; i++) {
+        auto const &barrier = pImageMemoryBarriers[i];
+        if (barrier.newLayout != VK_IMAGE_LAYOUT_GENERAL || barrier.oldLayout == VK_IMAGE_LAYOUT_GENERAL) continue;
+        auto image_state = GetImageState(dev_data, barrier.image);
+        if (!image_state || (image_state->createInfo.usage & VK_IMAGE_USAGE_STORAGE_BIT)) continue;
+        LogPerfHint(dev_data, PERF_HINT_GENERAL_LAYOUT, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT, HandleToUint64(barrier.image),
+                    "vkCmdPipelineBarrier() moves image 0x%" PRIx64
+                    ", which isn't a storage image, to VK_IMAGE_LAYOUT_GENERAL. Many GPUs can't keep images in that layout "
+                    "compressed, which can cost a decompression here and more bandwidth for every later access; use the "
+                    "layout of the next use instead.",
+                    HandleToUint64(barrier.image));
+    }
+}
+
 static void init_core_validation(instance_layer_data *instance_data, const VkAllocationCallbacks *pAllocator) {
     layer_debug_actions(instance_data->report_data, instance_data->logging_callback, pAllocator, "lunarg_core_validation");
+
+    instance_data->options_generation =
+        ReadLayerOptions("lunarg_core_validation", core_validation_option_definitions,
+                         sizeof(core_validation_option_definitions) / sizeof(core_validation_option_definitions[0]),
+                         &instance_data->options);
+    instance_data->options.deferred_draw_validation |= instance_data->options.async_draw_validation;
+
+    const char *spirv_validation_cache = getLayerOption("lunarg_core_validation.spirv_validation_cache");
+    if (spirv_validation_cache && *spirv_validation_cache) {
+        OpenSpirvValidationCache(spirv_validation_cache);
+    }
+}
+
+// Picks up the options that can change while the application runs when vk_layer_settings.txt changes: sampling, the frame
+// budget and performance hints. The others set up state when devices are created. Must hold global_lock.
+static void RefreshCoreValidationOptions(instance_layer_data *instance_data) {
+    if (!RefreshLayerOptions(&instance_data->options_generation)) return;
+
+    core_validation_options options;
+    ReadLayerOptions("lunarg_core_validation", core_validation_option_definitions,
+                     sizeof(core_validation_option_definitions) / sizeof(core_validation_option_definitions[0]), &options);
+    instance_data->options.sample_frames = options.sample_frames;
+    instance_data->options.sample_draws = options.sample_draws;
+    instance_data->options.frame_budget_us = options.frame_budget_us;
+    instance_data->options.perf_hints = options.perf_hints;
 }
 
 // For the given ValidationCheck enum, set all relevant instance disabled flags to true
@@ -2183,6 +2948,7 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateDevice(VkPhysicalDevice gpu, const VkDevice
     // Store physical device properties and physical device mem limits into device layer_data structs
     instance_data->dispatch_table.GetPhysicalDeviceMemoryProperties(gpu, &device_data->phys_dev_mem_props);
     instance_data->dispatch_table.GetPhysicalDeviceProperties(gpu, &device_data->phys_dev_props);
+    if (instance_data->options.async_draw_validation) device_data->draw_validation_worker.reset(new DrawValidationWorker(device_data));
     lock.unlock();
 
     ValidateLayerOrdering(*pCreateInfo);
@@ -2190,11 +2956,29 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateDevice(VkPhysicalDevice gpu, const VkDevice
     return result;
 }
 
+// Logs the calls and time of each profiled validation function since the last report, and starts over
+static void ReportCheckProfiles(layer_data *device_data) {
+    if (!device_data->instance_data->options.profile_checks) return;
+    for (uint32_t id = 0; id < CHECK_PROFILE_COUNT; id++) {
+        auto &profile = device_data->check_profiles[id];
+        uint64_t const calls = profile.calls.load();
+        if (!calls) continue;
+        double const total_ms = profile.total_ns.load() / 1000000.0;
+        log_msg(device_data->report_data, VK_DEBUG_REPORT_INFORMATION_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_DEVICE_EXT,
+                HandleToUint64(device_data->device), __LINE__, DRAWSTATE_CHECK_PROFILE, "DS",
+                "%s: %" PRIu64 " calls, %.3f ms total, %.3f us mean, p99 under %.3f us.", check_profile_names[id], calls,
+                total_ms, total_ms * 1000.0 / calls, profile.Percentile(0.99) / 1000.0);
+        profile.Reset();
+    }
+}
+
 // prototype
 VKAPI_ATTR void VKAPI_CALL DestroyDevice(VkDevice device, const VkAllocationCallbacks *pAllocator) {
     // TODOSC : Shouldn't need any customization here
     dispatch_key key = get_dispatch_key(device);
     layer_data *dev_data = GetLayerDataPtr(key, layer_data_map);
+    // The worker takes global_lock to finish its checks
+    dev_data->draw_validation_worker.reset();
     // Free all the memory
     unique_lock_t lock(global_lock);
     dev_data->pipelineMap.clear();
@@ -2216,6 +3000,7 @@ VKAPI_ATTR void VKAPI_CALL DestroyDevice(VkDevice device, const VkAllocationCall
     dev_data->bufferMap.clear();
     // Queues persist until device is destroyed
     dev_data->queueMap.clear();
+    ReportCheckProfiles(dev_data);
     // Report any memory leaks
     layer_debug_report_destroy_device(device);
     lock.unlock();
@@ -2294,51 +3079,66 @@ static void incrementResources(layer_data *dev_data, GLOBAL_CB_NODE *cb_node) {
 static bool VerifyQueueStateToSeq(layer_data *dev_data, QUEUE_STATE *initial_queue, uint64_t initial_seq) {
     bool skip = false;
 
-    // sequence number we want to validate up to, per queue
-    std::unordered_map<QUEUE_STATE *, uint64_t> target_seqs { { initial_queue, initial_seq } };
-    // sequence number we've completed validation for, per queue
-    std::unordered_map<QUEUE_STATE *, uint64_t> done_seqs;
+    // sequence number we want to validate up to, and we've completed validation for, per queue. There are only a few
+    // queues, so a vector is searched rather than hashing.
+    struct QueueSeqs {
+        QUEUE_STATE *queue;
+        uint64_t target_seq;
+        uint64_t done_seq;
+    };
+    std::vector<QueueSeqs> queue_seqs{{initial_queue, initial_seq, 0}};
+    auto get_seqs = [&queue_seqs](QUEUE_STATE *queue) -> QueueSeqs & {
+        for (auto &seqs : queue_seqs) {
+            if (seqs.queue == queue) return seqs;
+        }
+        queue_seqs.push_back({queue, 0, 0});
+        return queue_seqs.back();
+    };
     std::vector<QUEUE_STATE *> worklist { initial_queue };
 
     while (worklist.size()) {
         auto queue = worklist.back();
         worklist.pop_back();
 
-        auto target_seq = target_seqs[queue];
-        auto seq = std::max(done_seqs[queue], queue->seq);
-        auto sub_it = queue->submissions.begin() + int(seq - queue->seq);  // seq >= queue->seq
+        auto target_seq = get_seqs(queue).target_seq;
+        auto seq = std::max(get_seqs(queue).done_seq, queue->seq);
 
-        for (; seq < target_seq; ++sub_it, ++seq) {
-            for (auto &wait : sub_it->waitSemaphores) {
+        for (; seq < target_seq; ++seq) {
+            auto &submission = queue->submissions[seq - queue->seq];  // seq >= queue->seq
+            for (auto &wait : submission.waitSemaphores) {
                 auto other_queue = GetQueueState(dev_data, wait.queue);
 
                 if (other_queue == queue)
                     continue;   // semaphores /always/ point backwards, so no point here.
 
-                auto other_target_seq = std::max(target_seqs[other_queue], wait.seq);
-                auto other_done_seq = std::max(done_seqs[other_queue], other_queue->seq);
+                auto &other_seqs = get_seqs(other_queue);
+                auto other_target_seq = std::max(other_seqs.target_seq, wait.seq);
+                auto other_done_seq = std::max(other_seqs.done_seq, other_queue->seq);
 
                 // if this wait is for another queue, and covers new sequence
                 // numbers beyond what we've already validated, mark the new
                 // target seq and (possibly-re)add the queue to the worklist.
                 if (other_done_seq < other_target_seq) {
-                    target_seqs[other_queue] = other_target_seq;
+                    other_seqs.target_seq = other_target_seq;
                     worklist.push_back(other_queue);
                 }
             }
 
-            for (auto cb : sub_it->cbs) {
+            for (auto cb : submission.cbs) {
                 auto cb_node = GetCBNode(dev_data, cb);
                 if (cb_node) {
-                    for (auto queryEventsPair : cb_node->waitedEventsBeforeQueryReset) {
-                        for (auto event : queryEventsPair.second) {
-                            if (dev_data->eventMap[event].needsSignaled) {
+                    for (auto const &reset : cb_node->waitedEventsBeforeQueryReset) {
+                        for (auto event : reset.events) {
+                            if (!dev_data->eventMap[event].needsSignaled) continue;
+                            for (uint32_t i = 0; i < reset.query_count; ++i) {
+                                QueryObject query = {reset.pool, reset.first_query + i};
+                                // Skip queries whose events were replaced by a later reset
+                                if (GetEventsWaitedBeforeQueryReset(cb_node, query) != &reset.events) continue;
                                 skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT,
                                                 VK_DEBUG_REPORT_OBJECT_TYPE_QUERY_POOL_EXT, 0, 0, DRAWSTATE_INVALID_QUERY, "DS",
                                                 "Cannot get query results on queryPool 0x%" PRIx64
                                                 " with index %d which was guarded by unsignaled event 0x%" PRIx64 ".",
-                                                HandleToUint64(queryEventsPair.first.pool), queryEventsPair.first.index,
-                                                HandleToUint64(event));
+                                                HandleToUint64(query.pool), query.index, HandleToUint64(event));
                             }
                         }
                     }
@@ -2347,7 +3147,7 @@ static bool VerifyQueueStateToSeq(layer_data *dev_data, QUEUE_STATE *initial_que
         }
 
         // finally mark the point we've now validated this queue to.
-        done_seqs[queue] = seq;
+        get_seqs(queue).done_seq = seq;
     }
 
     return skip;
@@ -2374,7 +3174,8 @@ static void DecrementBoundResources(layer_data *dev_data, GLOBAL_CB_NODE const *
 }
 
 static void RetireWorkOnQueue(layer_data *dev_data, QUEUE_STATE *pQueue, uint64_t seq) {
-    std::unordered_map<VkQueue, uint64_t> otherQueueSeqs;
+    // Highest seq waited for on each other queue, only a few of them
+    std::vector<std::pair<VkQueue, uint64_t>> otherQueueSeqs;
 
     // Roll this queue forward, one submission at a time.
     while (pQueue->seq < seq) {
@@ -2385,8 +3186,13 @@ static void RetireWorkOnQueue(layer_data *dev_data, QUEUE_STATE *pQueue, uint64_
             if (pSemaphore) {
                 pSemaphore->in_use.fetch_sub(1);
             }
-            auto &lastSeq = otherQueueSeqs[wait.queue];
-            lastSeq = std::max(lastSeq, wait.seq);
+            auto other_queue_seq = std::find_if(otherQueueSeqs.begin(), otherQueueSeqs.end(),
+                                                [&wait](std::pair<VkQueue, uint64_t> const &qs) { return qs.first == wait.queue; });
+            if (other_queue_seq == otherQueueSeqs.end()) {
+                otherQueueSeqs.emplace_back(wait.queue, wait.seq);
+            } else {
+                other_queue_seq->second = std::max(other_queue_seq->second, wait.seq);
+            }
         }
 
         for (auto &semaphore : submission.signalSemaphores) {
@@ -2417,8 +3223,9 @@ static void RetireWorkOnQueue(layer_data *dev_data, QUEUE_STATE *pQueue, uint64_
                     eventNode->second.write_in_use--;
                 }
             }
-            for (auto queryStatePair : cb_node->queryToStateMap) {
-                dev_data->queryToStateMap[queryStatePair.first] = queryStatePair.second;
+            for (auto const &pool_states : cb_node->query_states) {
+                auto qp_state = GetQueryPoolNode(dev_data, pool_states.first);
+                if (qp_state) MergeQueryStates(qp_state->query_states, pool_states.second);
             }
             for (auto eventStagePair : cb_node->eventToStageMap) {
                 dev_data->eventMap[eventStagePair.first].stageMask = eventStagePair.second;
@@ -2505,6 +3312,8 @@ static bool validateCommandBufferState(layer_data *dev_data, GLOBAL_CB_NODE *cb_
 
 static bool validateResources(layer_data *dev_data, GLOBAL_CB_NODE *cb_node) {
     bool skip = false;
+    // Destroying a buffer invalidates the command buffers using it, so the result holds until the command buffer is reset
+    if (cb_node->resources_validated) return skip;
 
     // TODO : We should be able to remove the NULL look-up checks from the code below as long as
     //  all the corresponding cases are verified to cause CB_INVALID state and the CB_INVALID state
@@ -2519,6 +3328,7 @@ static bool validateResources(layer_data *dev_data, GLOBAL_CB_NODE *cb_node) {
             }
         }
     }
+    cb_node->resources_validated = !skip;
     return skip;
 }
 
@@ -2586,6 +3396,7 @@ static bool validateQueueFamilyIndices(layer_data *dev_data, GLOBAL_CB_NODE *pCB
 }
 
 static bool validatePrimaryCommandBufferState(layer_data *dev_data, GLOBAL_CB_NODE *pCB, int current_submit_count) {
+    CheckProfileScope profile(dev_data, CHECK_PROFILE_PRIMARY_CMD_BUF_STATE);
     // Track in-use for resources off of primary and any secondary CBs
     bool skip = false;
 
@@ -2595,6 +3406,13 @@ static bool validatePrimaryCommandBufferState(layer_data *dev_data, GLOBAL_CB_NO
 
     skip |= validateResources(dev_data, pCB);
 
+    // Objects destroyed since the command buffers were recorded break them now, the invalidation of a secondary one spreads to
+    //  the primary ones
+    for (auto pSubCB : pCB->linkedCommandBuffers) {
+        CheckDestroyedBindings(dev_data, pSubCB);
+    }
+    CheckDestroyedBindings(dev_data, pCB);
+
     for (auto pSubCB : pCB->linkedCommandBuffers) {
         skip |= validateResources(dev_data, pSubCB);
         // TODO: replace with invalidateCommandBuffers() at recording.
@@ -2610,6 +3428,7 @@ static bool validatePrimaryCommandBufferState(layer_data *dev_data, GLOBAL_CB_NO
     }
 
     skip |= validateCommandBufferState(dev_data, pCB, "vkQueueSubmit()", current_submit_count, VALIDATION_ERROR_31a00090);
+    skip |= ValidateDeferredDrawChecks(dev_data, pCB);
 
     return skip;
 }
@@ -2649,10 +3468,11 @@ static void PostCallRecordQueueSubmit(layer_data *dev_data, VkQueue queue, uint3
 
     // Now process each individual submit
     for (uint32_t submit_idx = 0; submit_idx < submitCount; submit_idx++) {
-        std::vector<VkCommandBuffer> cbs;
         const VkSubmitInfo *submit = &pSubmits[submit_idx];
-        vector<SEMAPHORE_WAIT> semaphore_waits;
-        vector<VkSemaphore> semaphore_signals;
+        auto &submission = pQueue->submissions.push_back();
+        auto &cbs = submission.cbs;
+        auto &semaphore_waits = submission.waitSemaphores;
+        auto &semaphore_signals = submission.signalSemaphores;
         for (uint32_t i = 0; i < submit->waitSemaphoreCount; ++i) {
             VkSemaphore semaphore = submit->pWaitSemaphores[i];
             auto pSemaphore = GetSemaphoreNode(dev_data, semaphore);
@@ -2670,7 +3490,7 @@ static void PostCallRecordQueueSubmit(layer_data *dev_data, VkQueue queue, uint3
             auto pSemaphore = GetSemaphoreNode(dev_data, semaphore);
             if (pSemaphore) {
                 pSemaphore->signaler.first = queue;
-                pSemaphore->signaler.second = pQueue->seq + pQueue->submissions.size() + 1;
+                pSemaphore->signaler.second = pQueue->seq + pQueue->submissions.size();  // Includes this submission
                 pSemaphore->signaled = true;
                 pSemaphore->in_use.fetch_add(1);
                 semaphore_signals.push_back(semaphore);
@@ -2690,19 +3510,19 @@ static void PostCallRecordQueueSubmit(layer_data *dev_data, VkQueue queue, uint3
                 }
             }
         }
-        pQueue->submissions.emplace_back(cbs, semaphore_waits, semaphore_signals,
-                                         submit_idx == submitCount - 1 ? fence : VK_NULL_HANDLE);
+        submission.fence = submit_idx == submitCount - 1 ? fence : VK_NULL_HANDLE;
     }
 
     if (pFence && !submitCount) {
         // If no submissions, but just dropping a fence on the end of the queue,
         // record an empty submission with just the fence, so we can determine
         // its completion.
-        pQueue->submissions.emplace_back(std::vector<VkCommandBuffer>(), std::vector<SEMAPHORE_WAIT>(), std::vector<VkSemaphore>(),
-                                         fence);
+        pQueue->submissions.push_back().fence = fence;
     }
 }
 
+static bool RunDeferredOps(layer_data *dev_data, GLOBAL_CB_NODE *cb_node, VkQueue queue);
+
 static bool PreCallValidateQueueSubmit(layer_data *dev_data, VkQueue queue, uint32_t submitCount, const VkSubmitInfo *pSubmits,
                                        VkFence fence) {
     auto pFence = GetFenceNode(dev_data, fence);
@@ -2714,7 +3534,7 @@ static bool PreCallValidateQueueSubmit(layer_data *dev_data, VkQueue queue, uint
     unordered_set<VkSemaphore> signaled_semaphores;
     unordered_set<VkSemaphore> unsignaled_semaphores;
     vector<VkCommandBuffer> current_cmds;
-    unordered_map<ImageSubresourcePair, IMAGE_LAYOUT_NODE> localImageLayoutMap;
+    ImageLayoutMap<IMAGE_LAYOUT_NODE> localImageLayoutMap;
     // Now verify each individual submit
     for (uint32_t submit_idx = 0; submit_idx < submitCount; submit_idx++) {
         const VkSubmitInfo *submit = &pSubmits[submit_idx];
@@ -2766,16 +3586,8 @@ static bool PreCallValidateQueueSubmit(layer_data *dev_data, VkQueue queue, uint
                     return true;
                 }
 
-                // Call submit-time functions to validate/update state
-                for (auto &function : cb_node->queue_submit_functions) {
-                    skip |= function();
-                }
-                for (auto &function : cb_node->eventUpdates) {
-                    skip |= function(queue);
-                }
-                for (auto &function : cb_node->queryUpdates) {
-                    skip |= function(queue);
-                }
+                // Validate and update the state the command buffer deferred to submit time
+                skip |= RunDeferredOps(dev_data, cb_node, queue);
             }
         }
     }
@@ -2795,6 +3607,9 @@ VKAPI_ATTR VkResult VKAPI_CALL QueueSubmit(VkQueue queue, uint32_t submitCount,
 
     lock.lock();
     PostCallRecordQueueSubmit(dev_data, queue, submitCount, pSubmits, fence);
+    if (dev_data->instance_data->options.perf_hints && submitCount == 1 && pSubmits[0].commandBufferCount == 1) {
+        dev_data->frame_single_cb_submits++;
+    }
     lock.unlock();
     return result;
 }
@@ -2828,6 +3643,17 @@ VKAPI_ATTR VkResult VKAPI_CALL AllocateMemory(VkDevice device, const VkMemoryAll
         lock.lock();
         if (VK_SUCCESS == result) {
             PostCallRecordAllocateMemory(dev_data, pAllocateInfo, pMemory);
+            if (dev_data->instance_data->options.perf_hints && pAllocateInfo->allocationSize < kPerfHintSmallAllocationSize) {
+                LogPerfHint(dev_data, PERF_HINT_SMALL_ALLOCATION, VK_DEBUG_REPORT_OBJECT_TYPE_DEVICE_MEMORY_EXT,
+                            HandleToUint64(*pMemory),
+                            "vkAllocateMemory() allocates only %" PRIu64
+                            " bytes. Each allocation is a call into the kernel driver, may be padded to a page or more, and "
+                            "counts against maxMemoryAllocationCount (%u, " PRINTF_SIZE_T_SPECIFIER
+                            " in use); suballocate small resources from larger allocations.",
+                            pAllocateInfo->allocationSize,
+                            dev_data->phys_dev_properties.properties.limits.maxMemoryAllocationCount,
+                            dev_data->memObjMap.size());
+            }
         }
     }
     return result;
@@ -2869,12 +3695,14 @@ static void PostCallRecordFreeMemory(layer_data *dev_data, VkDeviceMemory mem, D
                 auto image_state = GetImageState(dev_data, reinterpret_cast<VkImage &>(obj.handle));
                 assert(image_state);  // Any destroyed images should already be removed from bindings
                 image_state->binding.mem = MEMORY_UNBOUND;
+                ClearSparseMemoryBindings(image_state, mem_info->mem);
                 break;
             }
             case kVulkanObjectTypeBuffer: {
                 auto buffer_state = GetBufferState(dev_data, reinterpret_cast<VkBuffer &>(obj.handle));
                 assert(buffer_state);  // Any destroyed buffers should already be removed from bindings
                 buffer_state->binding.mem = MEMORY_UNBOUND;
+                ClearSparseMemoryBindings(buffer_state, mem_info->mem);
                 break;
             }
             default:
@@ -2957,6 +3785,44 @@ static void storeMemRanges(layer_data *dev_data, VkDeviceMemory mem, VkDeviceSiz
     }
 }
 
+// Shadow copies are allocated in whole pages straight from the OS, so the pages of a mapped range the application never
+//  touches take no memory
+static uint64_t GetShadowPageSize() {
+#ifdef _WIN32
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    return system_info.dwPageSize;
+#else
+    return static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+static void *AllocateShadowPages(size_t size) {
+#ifdef _WIN32
+    return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    void *pages = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return (pages == MAP_FAILED) ? nullptr : pages;
+#endif
+}
+
+static void FreeShadowPages(void *pages, size_t size) {
+#ifdef _WIN32
+    VirtualFree(pages, 0, MEM_RELEASE);
+#else
+    munmap(pages, size);
+#endif
+}
+
+static void ProtectShadowPages(void *pages, size_t size) {
+#ifdef _WIN32
+    DWORD old_protection;
+    VirtualProtect(pages, size, PAGE_NOACCESS, &old_protection);
+#else
+    mprotect(pages, size, PROT_NONE);
+#endif
+}
+
 static bool deleteMemRanges(layer_data *dev_data, VkDeviceMemory mem) {
     bool skip = false;
     auto mem_info = GetMemObjInfo(dev_data, mem);
@@ -2970,7 +3836,7 @@ static bool deleteMemRanges(layer_data *dev_data, VkDeviceMemory mem) {
         }
         mem_info->mem_range.size = 0;
         if (mem_info->shadow_copy) {
-            free(mem_info->shadow_copy_base);
+            FreeShadowPages(mem_info->shadow_copy_base, mem_info->shadow_copy_size);
             mem_info->shadow_copy_base = 0;
             mem_info->shadow_copy = 0;
         }
@@ -2981,6 +3847,23 @@ static bool deleteMemRanges(layer_data *dev_data, VkDeviceMemory mem) {
 // Guard value for pad data
 static char NoncoherentMemoryFillValue = 0xb;
 
+// Whether the size bytes of a guard band all still hold NoncoherentMemoryFillValue. Words are compared without branching, which
+//  compilers turn into vector compares.
+static bool IsGuardBandIntact(const char *band, uint64_t size) {
+    const uint64_t fill_word = 0x0101010101010101ULL * static_cast<unsigned char>(NoncoherentMemoryFillValue);
+    uint64_t diff = 0;
+    uint64_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, band + i, sizeof(word));
+        diff |= word ^ fill_word;
+    }
+    for (; i < size; ++i) {
+        diff |= (band[i] != NoncoherentMemoryFillValue) ? 1 : 0;
+    }
+    return diff == 0;
+}
+
 static void initializeAndTrackMemory(layer_data *dev_data, VkDeviceMemory mem, VkDeviceSize offset, VkDeviceSize size,
                                      void **ppData) {
     auto mem_info = GetMemObjInfo(dev_data, mem);
@@ -2993,26 +3876,43 @@ static void initializeAndTrackMemory(layer_data *dev_data, VkDeviceMemory mem, V
             if (size == VK_WHOLE_SIZE) {
                 size = mem_info->alloc_info.allocationSize - offset;
             }
-            mem_info->shadow_pad_size = dev_data->phys_dev_properties.properties.limits.minMemoryMapAlignment;
-            assert(SafeModulo(mem_info->shadow_pad_size,
-                                  dev_data->phys_dev_properties.properties.limits.minMemoryMapAlignment) == 0);
             // Ensure start of mapped region reflects hardware alignment constraints
             uint64_t map_alignment = dev_data->phys_dev_properties.properties.limits.minMemoryMapAlignment;
-
             // From spec: (ppData - offset) must be aligned to at least limits::minMemoryMapAlignment.
             uint64_t start_offset = offset % map_alignment;
-            // Data passed to driver will be wrapped by a guardband of data to detect over- or under-writes.
-            mem_info->shadow_copy_base =
-                malloc(static_cast<size_t>(2 * mem_info->shadow_pad_size + size + map_alignment + start_offset));
-
-            mem_info->shadow_copy =
-                reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(mem_info->shadow_copy_base) + map_alignment) &
-                                         ~(map_alignment - 1)) +
-                start_offset;
-            assert(SafeModulo(reinterpret_cast<uintptr_t>(mem_info->shadow_copy) + mem_info->shadow_pad_size - start_offset,
-                                  map_alignment) == 0);
-
-            memset(mem_info->shadow_copy, NoncoherentMemoryFillValue, static_cast<size_t>(2 * mem_info->shadow_pad_size + size));
+
+            // Data passed to driver will be wrapped by a guardband of data to detect over- or under-writes. With guard pages the
+            //  bands only fill the rest of the pages holding the data, and accessing the pages around them faults right away.
+            bool guard_pages = dev_data->instance_data->options.noncoherent_guard_pages;
+            uint64_t page_size = GetShadowPageSize();
+            uint64_t alignment = guard_pages ? std::max(page_size, map_alignment) : map_alignment;
+            uint64_t guard_size = guard_pages ? page_size : 0;
+            mem_info->shadow_pad_size = (guard_pages ? 0 : map_alignment) + start_offset;
+            uint64_t padded_size = mem_info->shadow_pad_size + size;
+            mem_info->shadow_tail_pad_size =
+                guard_pages ? ((padded_size + page_size - 1) / page_size * page_size - padded_size) : map_alignment;
+            uint64_t region_size = padded_size + mem_info->shadow_tail_pad_size;
+            mem_info->shadow_copy_size =
+                static_cast<size_t>((alignment + 2 * guard_size + region_size + page_size - 1) / page_size * page_size);
+            mem_info->shadow_copy_base = AllocateShadowPages(mem_info->shadow_copy_size);
+            if (!mem_info->shadow_copy_base) {
+                // Let the application write to the driver's memory directly
+                mem_info->shadow_copy = 0;
+                return;
+            }
+
+            char *region = reinterpret_cast<char *>(
+                (reinterpret_cast<uintptr_t>(mem_info->shadow_copy_base) + guard_size + alignment - 1) & ~(alignment - 1));
+            mem_info->shadow_copy = region;
+            assert(SafeModulo(reinterpret_cast<uintptr_t>(region) + mem_info->shadow_pad_size - start_offset, map_alignment) == 0);
+            if (guard_pages) {
+                ProtectShadowPages(region - guard_size, static_cast<size_t>(guard_size));
+                ProtectShadowPages(region + region_size, static_cast<size_t>(guard_size));
+            }
+
+            // Only the bands are filled, the data pages stay untouched until the application writes them
+            memset(region, NoncoherentMemoryFillValue, static_cast<size_t>(mem_info->shadow_pad_size));
+            memset(region + padded_size, NoncoherentMemoryFillValue, static_cast<size_t>(mem_info->shadow_tail_pad_size));
             *ppData = static_cast<char *>(mem_info->shadow_copy) + mem_info->shadow_pad_size;
         }
     }
@@ -3072,14 +3972,20 @@ static void PostCallRecordWaitForFences(layer_data *dev_data, uint32_t fence_cou
     //  vkGetFenceStatus() at which point we'll clean/remove their CBs if complete.
 }
 
+// The wait entrypoints below only take global_lock before the call down the chain to validate. Their <false> instantiations
+//  leave that out, GetDeviceProcAddr hands them to devices whose instance disabled the check, see unchecked_entrypoints.
+template <bool kValidate>
 VKAPI_ATTR VkResult VKAPI_CALL WaitForFences(VkDevice device, uint32_t fenceCount, const VkFence *pFences, VkBool32 waitAll,
                                              uint64_t timeout) {
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
-    // Verify fence status of submitted fences
-    unique_lock_t lock(global_lock);
-    bool skip = PreCallValidateWaitForFences(dev_data, fenceCount, pFences);
-    lock.unlock();
-    if (skip) return VK_ERROR_VALIDATION_FAILED_EXT;
+    unique_lock_t lock(global_lock, std::defer_lock);
+    if (kValidate) {
+        // Verify fence status of submitted fences
+        lock.lock();
+        bool skip = PreCallValidateWaitForFences(dev_data, fenceCount, pFences);
+        lock.unlock();
+        if (skip) return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
 
     VkResult result = dev_data->dispatch_table.WaitForFences(device, fenceCount, pFences, waitAll, timeout);
 
@@ -3098,12 +4004,16 @@ static bool PreCallValidateGetFenceStatus(layer_data *dev_data, VkFence fence) {
 
 static void PostCallRecordGetFenceStatus(layer_data *dev_data, VkFence fence) { RetireFence(dev_data, fence); }
 
+template <bool kValidate>
 VKAPI_ATTR VkResult VKAPI_CALL GetFenceStatus(VkDevice device, VkFence fence) {
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
-    unique_lock_t lock(global_lock);
-    bool skip = PreCallValidateGetFenceStatus(dev_data, fence);
-    lock.unlock();
-    if (skip) return VK_ERROR_VALIDATION_FAILED_EXT;
+    unique_lock_t lock(global_lock, std::defer_lock);
+    if (kValidate) {
+        lock.lock();
+        bool skip = PreCallValidateGetFenceStatus(dev_data, fence);
+        lock.unlock();
+        if (skip) return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
 
     VkResult result = dev_data->dispatch_table.GetFenceStatus(device, fence);
     if (result == VK_SUCCESS) {
@@ -3143,16 +4053,21 @@ static void PostCallRecordQueueWaitIdle(layer_data *dev_data, QUEUE_STATE *queue
     RetireWorkOnQueue(dev_data, queue_state, queue_state->seq + queue_state->submissions.size());
 }
 
+template <bool kValidate>
 VKAPI_ATTR VkResult VKAPI_CALL QueueWaitIdle(VkQueue queue) {
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(queue), layer_data_map);
     QUEUE_STATE *queue_state = nullptr;
-    unique_lock_t lock(global_lock);
-    bool skip = PreCallValidateQueueWaitIdle(dev_data, queue, &queue_state);
-    lock.unlock();
-    if (skip) return VK_ERROR_VALIDATION_FAILED_EXT;
+    unique_lock_t lock(global_lock, std::defer_lock);
+    if (kValidate) {
+        lock.lock();
+        bool skip = PreCallValidateQueueWaitIdle(dev_data, queue, &queue_state);
+        lock.unlock();
+        if (skip) return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
     VkResult result = dev_data->dispatch_table.QueueWaitIdle(queue);
     if (VK_SUCCESS == result) {
         lock.lock();
+        if (!queue_state) queue_state = GetQueueState(dev_data, queue);
         PostCallRecordQueueWaitIdle(dev_data, queue_state);
         lock.unlock();
     }
@@ -3174,12 +4089,16 @@ static void PostCallRecordDeviceWaitIdle(layer_data *dev_data) {
     }
 }
 
+template <bool kValidate>
 VKAPI_ATTR VkResult VKAPI_CALL DeviceWaitIdle(VkDevice device) {
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
-    unique_lock_t lock(global_lock);
-    bool skip = PreCallValidateDeviceWaitIdle(dev_data);
-    lock.unlock();
-    if (skip) return VK_ERROR_VALIDATION_FAILED_EXT;
+    unique_lock_t lock(global_lock, std::defer_lock);
+    if (kValidate) {
+        lock.lock();
+        bool skip = PreCallValidateDeviceWaitIdle(dev_data);
+        lock.unlock();
+        if (skip) return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
     VkResult result = dev_data->dispatch_table.DeviceWaitIdle(device);
     if (VK_SUCCESS == result) {
         lock.lock();
@@ -3317,89 +4236,77 @@ VKAPI_ATTR void VKAPI_CALL DestroyQueryPool(VkDevice device, VkQueryPool queryPo
 }
 static bool PreCallValidateGetQueryPoolResults(layer_data *dev_data, VkQueryPool query_pool, uint32_t first_query,
                                                uint32_t query_count, VkQueryResultFlags flags,
-                                               unordered_map<QueryObject, vector<VkCommandBuffer>> *queries_in_flight) {
-    // TODO: clean this up, it's insanely wasteful.
+                                               vector<vector<VkCommandBuffer>> *queries_in_flight) {
+    // Indexed from first_query
+    queries_in_flight->resize(query_count);
     for (auto cmd_buffer : dev_data->commandBufferMap) {
-        if (cmd_buffer.second->in_use.load()) {
-            for (auto query_state_pair : cmd_buffer.second->queryToStateMap) {
-                (*queries_in_flight)[query_state_pair.first].push_back(
-                    cmd_buffer.first);
+        if (!cmd_buffer.second->in_use.load()) continue;
+        auto pool_states = cmd_buffer.second->query_states.find(query_pool);
+        if (pool_states == cmd_buffer.second->query_states.end()) continue;
+        for (uint32_t i = 0; i < query_count; ++i) {
+            if (GetQueryState(pool_states->second, first_query + i) != QUERYSTATE_UNKNOWN) {
+                (*queries_in_flight)[i].push_back(cmd_buffer.first);
             }
         }
     }
     if (dev_data->instance_data->disabled.get_query_pool_results) return false;
     bool skip = false;
+    auto qp_state = GetQueryPoolNode(dev_data, query_pool);
+    if (!qp_state) return false;
     for (uint32_t i = 0; i < query_count; ++i) {
         QueryObject query = {query_pool, first_query + i};
-        auto qif_pair = queries_in_flight->find(query);
-        auto query_state_pair = dev_data->queryToStateMap.find(query);
-        if (query_state_pair != dev_data->queryToStateMap.end()) {
-            // Available and in flight
-            if (qif_pair != queries_in_flight->end() && query_state_pair != dev_data->queryToStateMap.end() &&
-                query_state_pair->second) {
-                for (auto cmd_buffer : qif_pair->second) {
-                    auto cb = GetCBNode(dev_data, cmd_buffer);
-                    auto query_event_pair = cb->waitedEventsBeforeQueryReset.find(query);
-                    if (query_event_pair == cb->waitedEventsBeforeQueryReset.end()) {
-                        skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT,
-                                        VK_DEBUG_REPORT_OBJECT_TYPE_QUERY_POOL_EXT, 0, __LINE__, DRAWSTATE_INVALID_QUERY, "DS",
-                                        "Cannot get query results on queryPool 0x%" PRIx64 " with index %d which is in flight.",
-                                        HandleToUint64(query_pool), first_query + i);
-                    }
-                }
-                // Unavailable and in flight
-            } else if (qif_pair != queries_in_flight->end() && query_state_pair != dev_data->queryToStateMap.end() &&
-                       !query_state_pair->second) {
-                // TODO : Can there be the same query in use by multiple command buffers in flight?
-                bool make_available = false;
-                for (auto cmd_buffer : qif_pair->second) {
-                    auto cb = GetCBNode(dev_data, cmd_buffer);
-                    make_available |= cb->queryToStateMap[query];
-                }
-                if (!(((flags & VK_QUERY_RESULT_PARTIAL_BIT) || (flags & VK_QUERY_RESULT_WAIT_BIT)) && make_available)) {
-                    skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT,
-                                    VK_DEBUG_REPORT_OBJECT_TYPE_QUERY_POOL_EXT, 0, __LINE__, DRAWSTATE_INVALID_QUERY, "DS",
-                                    "Cannot get query results on queryPool 0x%" PRIx64 " with index %d which is unavailable.",
-                                    HandleToUint64(query_pool), first_query + i);
+        auto const &in_flight = (*queries_in_flight)[i];
+        auto state = GetQueryState(qp_state->query_states, query.index);
+        // Available and in flight
+        if (!in_flight.empty() && state == QUERYSTATE_AVAILABLE) {
+            for (auto cmd_buffer : in_flight) {
+                if (!GetEventsWaitedBeforeQueryReset(GetCBNode(dev_data, cmd_buffer), query)) {
+                    skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_QUERY_POOL_EXT,
+                                    0, __LINE__, DRAWSTATE_INVALID_QUERY, "DS",
+                                    "Cannot get query results on queryPool 0x%" PRIx64 " with index %d which is in flight.",
+                                    HandleToUint64(query_pool), query.index);
                 }
-                // Unavailable
-            } else if (query_state_pair != dev_data->queryToStateMap.end() && !query_state_pair->second) {
+            }
+            // Unavailable and in flight
+        } else if (!in_flight.empty() && state == QUERYSTATE_UNAVAILABLE) {
+            // TODO : Can there be the same query in use by multiple command buffers in flight?
+            bool make_available = false;
+            for (auto cmd_buffer : in_flight) {
+                auto const &cb_states = GetCBNode(dev_data, cmd_buffer)->query_states;
+                auto pool_states = cb_states.find(query_pool);
+                make_available |=
+                    pool_states != cb_states.end() && GetQueryState(pool_states->second, query.index) == QUERYSTATE_AVAILABLE;
+            }
+            if (!(((flags & VK_QUERY_RESULT_PARTIAL_BIT) || (flags & VK_QUERY_RESULT_WAIT_BIT)) && make_available)) {
                 skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_QUERY_POOL_EXT, 0,
                                 __LINE__, DRAWSTATE_INVALID_QUERY, "DS",
                                 "Cannot get query results on queryPool 0x%" PRIx64 " with index %d which is unavailable.",
-                                HandleToUint64(query_pool), first_query + i);
-                // Uninitialized
-            } else if (query_state_pair == dev_data->queryToStateMap.end()) {
-                skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_QUERY_POOL_EXT, 0,
-                                __LINE__, DRAWSTATE_INVALID_QUERY, "DS",
-                                "Cannot get query results on queryPool 0x%" PRIx64
-                                " with index %d as data has not been collected for this index.",
-                                HandleToUint64(query_pool), first_query + i);
+                                HandleToUint64(query_pool), query.index);
             }
+            // Unavailable
+        } else if (state == QUERYSTATE_UNAVAILABLE) {
+            skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_QUERY_POOL_EXT, 0,
+                            __LINE__, DRAWSTATE_INVALID_QUERY, "DS",
+                            "Cannot get query results on queryPool 0x%" PRIx64 " with index %d which is unavailable.",
+                            HandleToUint64(query_pool), query.index);
         }
     }
     return skip;
 }
 
 static void PostCallRecordGetQueryPoolResults(layer_data *dev_data, VkQueryPool query_pool, uint32_t first_query,
-                                              uint32_t query_count,
-                                              unordered_map<QueryObject, vector<VkCommandBuffer>> *queries_in_flight) {
+                                              uint32_t query_count, vector<vector<VkCommandBuffer>> *queries_in_flight) {
+    auto qp_state = GetQueryPoolNode(dev_data, query_pool);
+    if (!qp_state) return;
     for (uint32_t i = 0; i < query_count; ++i) {
         QueryObject query = {query_pool, first_query + i};
-        auto qif_pair = queries_in_flight->find(query);
-        auto query_state_pair = dev_data->queryToStateMap.find(query);
-        if (query_state_pair != dev_data->queryToStateMap.end()) {
-            // Available and in flight
-            if (qif_pair != queries_in_flight->end() && query_state_pair != dev_data->queryToStateMap.end() &&
-                query_state_pair->second) {
-                for (auto cmd_buffer : qif_pair->second) {
-                    auto cb = GetCBNode(dev_data, cmd_buffer);
-                    auto query_event_pair = cb->waitedEventsBeforeQueryReset.find(query);
-                    if (query_event_pair != cb->waitedEventsBeforeQueryReset.end()) {
-                        for (auto event : query_event_pair->second) {
-                            dev_data->eventMap[event].needsSignaled = true;
-                        }
-                    }
+        // Available and in flight
+        if (GetQueryState(qp_state->query_states, query.index) != QUERYSTATE_AVAILABLE) continue;
+        for (auto cmd_buffer : (*queries_in_flight)[i]) {
+            auto events = GetEventsWaitedBeforeQueryReset(GetCBNode(dev_data, cmd_buffer), query);
+            if (events) {
+                for (auto event : *events) {
+                    dev_data->eventMap[event].needsSignaled = true;
                 }
             }
         }
@@ -3409,7 +4316,7 @@ static void PostCallRecordGetQueryPoolResults(layer_data *dev_data, VkQueryPool
 VKAPI_ATTR VkResult VKAPI_CALL GetQueryPoolResults(VkDevice device, VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount,
                                                    size_t dataSize, void *pData, VkDeviceSize stride, VkQueryResultFlags flags) {
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
-    unordered_map<QueryObject, vector<VkCommandBuffer>> queries_in_flight;
+    vector<vector<VkCommandBuffer>> queries_in_flight;
     unique_lock_t lock(global_lock);
     bool skip = PreCallValidateGetQueryPoolResults(dev_data, queryPool, firstQuery, queryCount, flags, &queries_in_flight);
     lock.unlock();
@@ -3472,6 +4379,23 @@ bool rangesIntersect(layer_data const *dev_data, MEMORY_RANGE const *range1, VkD
     bool tmp_bool;
     return rangesIntersect(dev_data, range1, &range_wrap, &tmp_bool, true);
 }
+// Call func for each range bound to mem_info that rangesIntersect may find intersecting [start, end], using
+//  bound_ranges_by_start rather than looking at every bound range
+template <typename FUNC>
+static void ForEachNearbyMemoryRange(layer_data const *dev_data, DEVICE_MEM_INFO *mem_info, VkDeviceSize start,
+                                     VkDeviceSize end, FUNC func) {
+    // Ranges are compared aligned down to bufferImageGranularity when one is linear and the other isn't
+    VkDeviceSize pad_align = std::max<VkDeviceSize>(dev_data->phys_dev_properties.properties.limits.bufferImageGranularity, 1);
+    VkDeviceSize aligned_start = start & ~(pad_align - 1);
+    VkDeviceSize first = aligned_start > mem_info->max_bound_range_size ? aligned_start - mem_info->max_bound_range_size : 0;
+    VkDeviceSize last = (end & ~(pad_align - 1)) + (pad_align - 1);
+    auto range = mem_info->bound_ranges_by_start.lower_bound(first);
+    auto range_end = mem_info->bound_ranges_by_start.upper_bound(last);
+    for (; range != range_end; ++range) {
+        func(range->second);
+    }
+}
+
 // For given mem_info, set all ranges valid that intersect [offset-end] range
 // TODO : For ranges where there is no alias, we may want to create new buffer ranges that are valid
 static void SetMemRangesValid(layer_data const *dev_data, DEVICE_MEM_INFO *mem_info, VkDeviceSize offset, VkDeviceSize end) {
@@ -3480,12 +4404,12 @@ static void SetMemRangesValid(layer_data const *dev_data, DEVICE_MEM_INFO *mem_i
     map_range.linear = true;
     map_range.start = offset;
     map_range.end = end;
-    for (auto &handle_range_pair : mem_info->bound_ranges) {
-        if (rangesIntersect(dev_data, &handle_range_pair.second, &map_range, &tmp_bool, false)) {
+    ForEachNearbyMemoryRange(dev_data, mem_info, offset, end, [&](MEMORY_RANGE *check_range) {
+        if (rangesIntersect(dev_data, check_range, &map_range, &tmp_bool, false)) {
             // TODO : WARN here if tmp_bool true?
-            handle_range_pair.second.valid = true;
+            check_range->valid = true;
         }
-    }
+    });
 }
 
 static bool ValidateInsertMemoryRange(layer_data const *dev_data, uint64_t handle, DEVICE_MEM_INFO *mem_info,
@@ -3505,14 +4429,13 @@ static bool ValidateInsertMemoryRange(layer_data const *dev_data, uint64_t handl
     range.aliases.clear();
 
     // Check for aliasing problems.
-    for (auto &obj_range_pair : mem_info->bound_ranges) {
-        auto check_range = &obj_range_pair.second;
+    ForEachNearbyMemoryRange(dev_data, mem_info, range.start, range.end, [&](MEMORY_RANGE *check_range) {
         bool intersection_error = false;
         if (rangesIntersect(dev_data, &range, check_range, &intersection_error, false)) {
             skip |= intersection_error;
             range.aliases.insert(check_range);
         }
-    }
+    });
 
     if (memoryOffset >= mem_info->alloc_info.allocationSize) {
         UNIQUE_VALIDATION_ERROR_CODE error_code = is_image ? VALIDATION_ERROR_1740082c : VALIDATION_ERROR_1700080e;
@@ -3527,6 +4450,17 @@ static bool ValidateInsertMemoryRange(layer_data const *dev_data, uint64_t handl
     return skip;
 }
 
+// Remove range, one of the bound_ranges of mem_info, from bound_ranges_by_start
+static void RemoveMemoryRangeByStart(DEVICE_MEM_INFO *mem_info, MEMORY_RANGE *range) {
+    auto same_start = mem_info->bound_ranges_by_start.equal_range(range->start);
+    for (auto it = same_start.first; it != same_start.second; ++it) {
+        if (it->second == range) {
+            mem_info->bound_ranges_by_start.erase(it);
+            return;
+        }
+    }
+}
+
 // Object with given handle is being bound to memory w/ given mem_info struct.
 //  Track the newly bound memory range with given memoryOffset
 //  Also scan any previous ranges, track aliased ranges with new range, and flag an error if a linear
@@ -3551,17 +4485,23 @@ static void InsertMemoryRange(layer_data const *dev_data, uint64_t handle, DEVIC
     // Save aliased ranges so we can copy into final map entry below. Can't do it in loop b/c we don't yet have final ptr. If we
     // inserted into map before loop to get the final ptr, then we may enter loop when not needed & we check range against itself
     std::unordered_set<MEMORY_RANGE *> tmp_alias_ranges;
-    for (auto &obj_range_pair : mem_info->bound_ranges) {
-        auto check_range = &obj_range_pair.second;
+    ForEachNearbyMemoryRange(dev_data, mem_info, range.start, range.end, [&](MEMORY_RANGE *check_range) {
         bool intersection_error = false;
         if (rangesIntersect(dev_data, &range, check_range, &intersection_error, true)) {
             range.aliases.insert(check_range);
             tmp_alias_ranges.insert(check_range);
         }
+    });
+    auto existing_range = mem_info->bound_ranges.find(handle);
+    if (existing_range != mem_info->bound_ranges.end()) {
+        RemoveMemoryRangeByStart(mem_info, &existing_range->second);
     }
-    mem_info->bound_ranges[handle] = std::move(range);
+    auto &bound_range = mem_info->bound_ranges[handle];
+    bound_range = std::move(range);
+    mem_info->bound_ranges_by_start.insert(std::make_pair(bound_range.start, &bound_range));
+    mem_info->max_bound_range_size = std::max(mem_info->max_bound_range_size, bound_range.size);
     for (auto tmp_range : tmp_alias_ranges) {
-        tmp_range->aliases.insert(&mem_info->bound_ranges[handle]);
+        tmp_range->aliases.insert(&bound_range);
     }
     if (is_image)
         mem_info->bound_images.insert(handle);
@@ -3598,6 +4538,7 @@ static void RemoveMemoryRange(uint64_t handle, DEVICE_MEM_INFO *mem_info, bool i
         alias_range->aliases.erase(erase_range);
     }
     erase_range->aliases.clear();
+    RemoveMemoryRangeByStart(mem_info, erase_range);
     mem_info->bound_ranges.erase(handle);
     if (is_image) {
         mem_info->bound_images.erase(handle);
@@ -3909,7 +4850,7 @@ static bool PreCallValidateDestroySampler(layer_data *dev_data, VkSampler sample
 static void PostCallRecordDestroySampler(layer_data *dev_data, VkSampler sampler, SAMPLER_STATE *sampler_state,
                                          VK_OBJECT obj_struct) {
     // Any bound cmd buffers are now invalid
-    if (sampler_state) invalidateCommandBuffers(dev_data, sampler_state->cb_bindings, obj_struct);
+    if (sampler_state) recordDestroyedObject(dev_data, obj_struct);
     dev_data->samplerMap.erase(sampler);
 }
 
@@ -3959,9 +4900,7 @@ static void PostCallRecordDestroyDescriptorPool(layer_data *dev_data, VkDescript
     // Any bound cmd buffers are now invalid
     invalidateCommandBuffers(dev_data, desc_pool_state->cb_bindings, obj_struct);
     // Free sets that were in this pool
-    for (auto ds : desc_pool_state->sets) {
-        freeDescriptorSet(dev_data, ds);
-    }
+    deleteDescriptorSets(dev_data, desc_pool_state);
     dev_data->descriptorPoolMap.erase(descriptorPool);
     delete desc_pool_state;
 }
@@ -4080,6 +5019,7 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateQueryPool(VkDevice device, const VkQueryPoo
         lock_guard_t lock(global_lock);
         QUERY_POOL_NODE *qp_node = &dev_data->queryPoolMap[*pQueryPool];
         qp_node->createInfo = *pCreateInfo;
+        qp_node->query_states.assign(pCreateInfo->queryCount, QUERYSTATE_UNKNOWN);
     }
     return result;
 }
@@ -4191,21 +5131,23 @@ VKAPI_ATTR VkResult VKAPI_CALL ResetFences(VkDevice device, uint32_t fenceCount,
 // For given cb_nodes, invalidate them and track object causing invalidation
 void invalidateCommandBuffers(const layer_data *dev_data, std::unordered_set<GLOBAL_CB_NODE *> const &cb_nodes, VK_OBJECT obj) {
     for (auto cb_node : cb_nodes) {
-        if (cb_node->state == CB_RECORDING) {
-            log_msg(dev_data->report_data, VK_DEBUG_REPORT_WARNING_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_COMMAND_BUFFER_EXT,
-                    HandleToUint64(cb_node->commandBuffer), __LINE__, DRAWSTATE_INVALID_COMMAND_BUFFER, "DS",
-                    "Invalidating a command buffer that's currently being recorded: 0x%p.", cb_node->commandBuffer);
-            cb_node->state = CB_INVALID_INCOMPLETE;
-        }
-        else if (cb_node->state == CB_RECORDED) {
-            cb_node->state = CB_INVALID_COMPLETE;
-        }
-        cb_node->broken_bindings.push_back(obj);
+        invalidateCommandBuffer(dev_data, cb_node, obj);
+    }
+}
+
+// Destroyed objects kept before every command buffer is checked against them
+static const size_t max_destroyed_objects = 4096;
 
-        // if secondary, then propagate the invalidation to the primaries that will call us.
-        if (cb_node->createInfo.level == VK_COMMAND_BUFFER_LEVEL_SECONDARY) {
-            invalidateCommandBuffers(dev_data, cb_node->linkedCommandBuffers, obj);
+// Record that a lazily tracked object was destroyed, see GetDestroyedObjectsGeneration()
+void recordDestroyedObject(layer_data *dev_data, VK_OBJECT obj) {
+    dev_data->destroyed_objects.push_back(obj);
+    // Bring every command buffer up to date once in a while, so the ones that are never used again don't keep the objects
+    if (dev_data->destroyed_objects.size() >= max_destroyed_objects) {
+        for (auto &cb_pair : dev_data->commandBufferMap) {
+            CheckDestroyedBindings(dev_data, cb_pair.second);
         }
+        dev_data->destroyed_objects_base += dev_data->destroyed_objects.size();
+        dev_data->destroyed_objects.clear();
     }
 }
 
@@ -4347,14 +5289,20 @@ std::unordered_map<VkImage, std::vector<ImageSubresourcePair>> *GetImageSubresou
     return &device_data->imageSubresourceMap;
 }
 
-std::unordered_map<ImageSubresourcePair, IMAGE_LAYOUT_NODE> *GetImageLayoutMap(layer_data *device_data) {
+ImageLayoutMap<IMAGE_LAYOUT_NODE> *GetImageLayoutMap(layer_data *device_data) {
     return &device_data->imageLayoutMap;
 }
 
-std::unordered_map<ImageSubresourcePair, IMAGE_LAYOUT_NODE> const *GetImageLayoutMap(layer_data const *device_data) {
+ImageLayoutMap<IMAGE_LAYOUT_NODE> const *GetImageLayoutMap(layer_data const *device_data) {
     return &device_data->imageLayoutMap;
 }
 
+uint64_t *GetImageLayoutGeneration(layer_data *device_data) { return &device_data->imageLayoutGeneration; }
+
+CHECK_PROFILE *GetCheckProfile(layer_data *device_data, CHECK_PROFILE_ID id) {
+    return device_data->instance_data->options.profile_checks ? &device_data->check_profiles[id] : nullptr;
+}
+
 std::unordered_map<VkBuffer, std::unique_ptr<BUFFER_STATE>> *GetBufferMap(layer_data *device_data) {
     return &device_data->bufferMap;
 }
@@ -4518,6 +5466,7 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateGraphicsPipelines(VkDevice device, VkPipeli
         pipe_state[i]->initGraphicsPipeline(&pCreateInfos[i], GetRenderPassStateSharedPtr(dev_data, pCreateInfos[i].renderPass));
         pipe_state[i]->render_pass_ci.initialize(GetRenderPassState(dev_data, pCreateInfos[i].renderPass)->createInfo.ptr());
         pipe_state[i]->pipeline_layout = *getPipelineLayout(dev_data, pCreateInfos[i].layout);
+        set_pipeline_state(pipe_state[i].get());
     }
 
     for (i = 0; i < count; i++) {
@@ -4526,9 +5475,7 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateGraphicsPipelines(VkDevice device, VkPipeli
 
     lock.unlock();
 
-    for (i = 0; i < count; i++) {
-        skip |= ValidatePipelineUnlocked(dev_data, pipe_state, i);
-    }
+    skip |= ValidatePipelinesUnlocked(dev_data, pipe_state);
 
     if (skip) {
         for (i = 0; i < count; i++) {
@@ -4813,6 +5760,23 @@ VKAPI_ATTR VkResult VKAPI_CALL ResetDescriptorPool(VkDevice device, VkDescriptor
     VkResult result = dev_data->dispatch_table.ResetDescriptorPool(device, descriptorPool, flags);
     if (VK_SUCCESS == result) {
         lock_guard_t lock(global_lock);
+        auto pool_state = GetDescriptorPoolState(dev_data, descriptorPool);
+        if (dev_data->instance_data->options.perf_hints && pool_state) {
+            if (pool_state->reset_frame_streak && pool_state->last_reset_frame + 1 == dev_data->frame_count) {
+                pool_state->reset_frame_streak++;
+            } else if (!pool_state->reset_frame_streak || pool_state->last_reset_frame != dev_data->frame_count) {
+                pool_state->reset_frame_streak = 1;
+            }
+            pool_state->last_reset_frame = dev_data->frame_count;
+            if (pool_state->reset_frame_streak >= kPerfHintResetFrames && !pool_state->sets.empty()) {
+                LogPerfHint(dev_data, PERF_HINT_DESCRIPTOR_POOL_RESET_PER_FRAME, VK_DEBUG_REPORT_OBJECT_TYPE_DESCRIPTOR_POOL_EXT,
+                            HandleToUint64(descriptorPool),
+                            "Descriptor pool 0x%" PRIx64 " was reset in each of the last %u frames, freeing " PRINTF_SIZE_T_SPECIFIER
+                            " descriptor sets. Allocating and writing the same sets again every frame costs CPU time; keep "
+                            "the sets whose contents don't change.",
+                            HandleToUint64(descriptorPool), pool_state->reset_frame_streak, pool_state->sets.size());
+            }
+        }
         clearDescriptorPool(dev_data, device, descriptorPool, flags);
     }
     return result;
@@ -4897,8 +5861,7 @@ static void PostCallRecordFreeDescriptorSets(layer_data *dev_data, VkDescriptorP
                 descriptor_count = descriptor_set->GetDescriptorCountFromIndex(j);
                 pool_state->availableDescriptorTypeCount[type_index] += descriptor_count;
             }
-            freeDescriptorSet(dev_data, descriptor_set);
-            pool_state->sets.erase(descriptor_set);
+            freeDescriptorSet(dev_data, pool_state, descriptor_set);
         }
     }
 }
@@ -4991,8 +5954,7 @@ VKAPI_ATTR VkResult VKAPI_CALL AllocateCommandBuffers(VkDevice device, const VkC
 
 // Add bindings between the given cmd buffer & framebuffer and the framebuffer's children
 static void AddFramebufferBinding(layer_data *dev_data, GLOBAL_CB_NODE *cb_state, FRAMEBUFFER_STATE *fb_state) {
-    addCommandBufferBinding(&fb_state->cb_bindings, {HandleToUint64(fb_state->framebuffer), kVulkanObjectTypeFramebuffer},
-                            cb_state);
+    addCommandBufferBinding(fb_state, {HandleToUint64(fb_state->framebuffer), kVulkanObjectTypeFramebuffer}, cb_state);
     for (auto attachment : fb_state->attachments) {
         auto view_state = attachment.view_state;
         if (view_state) {
@@ -5117,7 +6079,7 @@ VKAPI_ATTR VkResult VKAPI_CALL BeginCommandBuffer(VkCommandBuffer commandBuffer,
 VKAPI_ATTR VkResult VKAPI_CALL EndCommandBuffer(VkCommandBuffer commandBuffer) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     GLOBAL_CB_NODE *pCB = GetCBNode(dev_data, commandBuffer);
     if (pCB) {
         if ((VK_COMMAND_BUFFER_LEVEL_PRIMARY == pCB->createInfo.level) ||
@@ -5133,6 +6095,10 @@ VKAPI_ATTR VkResult VKAPI_CALL EndCommandBuffer(VkCommandBuffer commandBuffer) {
                             "Ending command buffer with in progress query: queryPool 0x%" PRIx64 ", index %d. %s",
                             HandleToUint64(query.pool), query.index, validation_error_map[VALIDATION_ERROR_2740007a]);
         }
+        // Secondary command buffers aren't submitted themselves
+        if (VK_COMMAND_BUFFER_LEVEL_SECONDARY == pCB->createInfo.level && !dev_data->draw_validation_worker) {
+            skip |= ValidateDeferredDrawChecks(dev_data, pCB);
+        }
     }
     if (!skip) {
         lock.unlock();
@@ -5140,6 +6106,9 @@ VKAPI_ATTR VkResult VKAPI_CALL EndCommandBuffer(VkCommandBuffer commandBuffer) {
         lock.lock();
         if (VK_SUCCESS == result) {
             pCB->state = CB_RECORDED;
+            if (dev_data->draw_validation_worker && !pCB->deferred_descriptor_checks.empty()) {
+                dev_data->draw_validation_worker->Push(commandBuffer);
+            }
         }
         return result;
     } else {
@@ -5177,7 +6146,7 @@ VKAPI_ATTR void VKAPI_CALL CmdBindPipeline(VkCommandBuffer commandBuffer, VkPipe
                                            VkPipeline pipeline) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     GLOBAL_CB_NODE *cb_state = GetCBNode(dev_data, commandBuffer);
     if (cb_state) {
         skip |= ValidateCmdQueueFlags(dev_data, cb_state, "vkCmdBindPipeline()", VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT,
@@ -5192,9 +6161,8 @@ VKAPI_ATTR void VKAPI_CALL CmdBindPipeline(VkCommandBuffer commandBuffer, VkPipe
             cb_state->status |= cb_state->static_status;
         }
         cb_state->lastBound[pipelineBindPoint].pipeline_state = pipe_state;
-        set_pipeline_state(pipe_state);
         skip |= validate_dual_src_blend_feature(dev_data, pipe_state);
-        addCommandBufferBinding(&pipe_state->cb_bindings, {HandleToUint64(pipeline), kVulkanObjectTypePipeline}, cb_state);
+        addCommandBufferBinding(pipe_state, {HandleToUint64(pipeline), kVulkanObjectTypePipeline}, cb_state);
     }
     lock.unlock();
     if (!skip) dev_data->dispatch_table.CmdBindPipeline(commandBuffer, pipelineBindPoint, pipeline);
@@ -5204,7 +6172,7 @@ VKAPI_ATTR void VKAPI_CALL CmdSetViewport(VkCommandBuffer commandBuffer, uint32_
                                           const VkViewport *pViewports) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     GLOBAL_CB_NODE *pCB = GetCBNode(dev_data, commandBuffer);
     if (pCB) {
         skip |= ValidateCmdQueueFlags(dev_data, pCB, "vkCmdSetViewport()", VK_QUEUE_GRAPHICS_BIT, VALIDATION_ERROR_1e002415);
@@ -5228,7 +6196,7 @@ VKAPI_ATTR void VKAPI_CALL CmdSetScissor(VkCommandBuffer commandBuffer, uint32_t
                                          const VkRect2D *pScissors) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     GLOBAL_CB_NODE *pCB = GetCBNode(dev_data, commandBuffer);
     if (pCB) {
         skip |= ValidateCmdQueueFlags(dev_data, pCB, "vkCmdSetScissor()", VK_QUEUE_GRAPHICS_BIT, VALIDATION_ERROR_1d802415);
@@ -5251,7 +6219,7 @@ VKAPI_ATTR void VKAPI_CALL CmdSetScissor(VkCommandBuffer commandBuffer, uint32_t
 VKAPI_ATTR void VKAPI_CALL CmdSetLineWidth(VkCommandBuffer commandBuffer, float lineWidth) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     GLOBAL_CB_NODE *pCB = GetCBNode(dev_data, commandBuffer);
     if (pCB) {
         skip |= ValidateCmdQueueFlags(dev_data, pCB, "vkCmdSetLineWidth()", VK_QUEUE_GRAPHICS_BIT, VALIDATION_ERROR_1d602415);
@@ -5264,8 +6232,8 @@ VKAPI_ATTR void VKAPI_CALL CmdSetLineWidth(VkCommandBuffer commandBuffer, float
                             "flag. %s",
                             validation_error_map[VALIDATION_ERROR_1d600626]);
         } else {
-            skip |= verifyLineWidth(dev_data, DRAWSTATE_INVALID_SET, kVulkanObjectTypeCommandBuffer, HandleToUint64(commandBuffer),
-                                    lineWidth);
+            skip |= verifyLineWidth(dev_data, dev_data->report_data, DRAWSTATE_INVALID_SET, kVulkanObjectTypeCommandBuffer,
+                                    HandleToUint64(commandBuffer), lineWidth);
         }
         if (!skip) {
             pCB->status |= CBSTATUS_LINE_WIDTH_SET;
@@ -5279,7 +6247,7 @@ VKAPI_ATTR void VKAPI_CALL CmdSetDepthBias(VkCommandBuffer commandBuffer, float
                                            float depthBiasSlopeFactor) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     GLOBAL_CB_NODE *pCB = GetCBNode(dev_data, commandBuffer);
     if (pCB) {
         skip |= ValidateCmdQueueFlags(dev_data, pCB, "vkCmdSetDepthBias()", VK_QUEUE_GRAPHICS_BIT, VALIDATION_ERROR_1cc02415);
@@ -5309,7 +6277,7 @@ VKAPI_ATTR void VKAPI_CALL CmdSetDepthBias(VkCommandBuffer commandBuffer, float
 VKAPI_ATTR void VKAPI_CALL CmdSetBlendConstants(VkCommandBuffer commandBuffer, const float blendConstants[4]) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     GLOBAL_CB_NODE *pCB = GetCBNode(dev_data, commandBuffer);
     if (pCB) {
         skip |= ValidateCmdQueueFlags(dev_data, pCB, "vkCmdSetBlendConstants()", VK_QUEUE_GRAPHICS_BIT, VALIDATION_ERROR_1ca02415);
@@ -5331,7 +6299,7 @@ VKAPI_ATTR void VKAPI_CALL CmdSetBlendConstants(VkCommandBuffer commandBuffer, c
 VKAPI_ATTR void VKAPI_CALL CmdSetDepthBounds(VkCommandBuffer commandBuffer, float minDepthBounds, float maxDepthBounds) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     GLOBAL_CB_NODE *pCB = GetCBNode(dev_data, commandBuffer);
     if (pCB) {
         skip |= ValidateCmdQueueFlags(dev_data, pCB, "vkCmdSetDepthBounds()", VK_QUEUE_GRAPHICS_BIT, VALIDATION_ERROR_1ce02415);
@@ -5354,7 +6322,7 @@ VKAPI_ATTR void VKAPI_CALL CmdSetStencilCompareMask(VkCommandBuffer commandBuffe
                                                     uint32_t compareMask) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     GLOBAL_CB_NODE *pCB = GetCBNode(dev_data, commandBuffer);
     if (pCB) {
         skip |=
@@ -5377,7 +6345,7 @@ VKAPI_ATTR void VKAPI_CALL CmdSetStencilCompareMask(VkCommandBuffer commandBuffe
 VKAPI_ATTR void VKAPI_CALL CmdSetStencilWriteMask(VkCommandBuffer commandBuffer, VkStencilFaceFlags faceMask, uint32_t writeMask) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     GLOBAL_CB_NODE *pCB = GetCBNode(dev_data, commandBuffer);
     if (pCB) {
         skip |=
@@ -5400,7 +6368,7 @@ VKAPI_ATTR void VKAPI_CALL CmdSetStencilWriteMask(VkCommandBuffer commandBuffer,
 VKAPI_ATTR void VKAPI_CALL CmdSetStencilReference(VkCommandBuffer commandBuffer, VkStencilFaceFlags faceMask, uint32_t reference) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     GLOBAL_CB_NODE *pCB = GetCBNode(dev_data, commandBuffer);
     if (pCB) {
         skip |=
@@ -5440,12 +6408,6 @@ static void PreCallRecordCmdBindDescriptorSets(layer_data *device_data, GLOBAL_C
         if (descriptor_set) {
             last_bound->pipeline_layout = *pipeline_layout;
 
-            if ((last_bound->boundDescriptorSets[set_idx + firstSet] != nullptr) &&
-                last_bound->boundDescriptorSets[set_idx + firstSet]->IsPushDescriptor()) {
-                last_bound->push_descriptors[set_idx + firstSet] = nullptr;
-                last_bound->boundDescriptorSets[set_idx + firstSet] = nullptr;
-            }
-
             last_bound->boundDescriptorSets[set_idx + firstSet] = descriptor_set;
 
             auto set_dynamic_descriptor_count = descriptor_set->GetDynamicDescriptorCount();
@@ -5590,7 +6552,7 @@ VKAPI_ATTR void VKAPI_CALL CmdBindDescriptorSets(VkCommandBuffer commandBuffer,
                                                  const uint32_t *pDynamicOffsets) {
     bool skip = false;
     layer_data *device_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(device_data, commandBuffer);
     GLOBAL_CB_NODE *cb_state = GetCBNode(device_data, commandBuffer);
     assert(cb_state);
     skip = PreCallValidateCmdBindDescriptorSets(device_data, cb_state, pipelineBindPoint, layout, firstSet, setCount,
@@ -5620,17 +6582,35 @@ static void PreCallRecordCmdPushDescriptorSetKHR(layer_data *device_data, VkComm
         cb_state->lastBound[pipelineBindPoint].dynamicOffsets.resize(set + 1);
     }
     const auto &layout_state = getPipelineLayout(device_data, layout);
-    std::unique_ptr<cvdescriptorset::DescriptorSet> new_desc{
-        new cvdescriptorset::DescriptorSet(0, 0, layout_state->set_layouts[set], device_data)};
-    cb_state->lastBound[pipelineBindPoint].boundDescriptorSets[set] = new_desc.get();
-    cb_state->lastBound[pipelineBindPoint].push_descriptors[set] = std::move(new_desc);
+    const auto &set_layout = layout_state->set_layouts[set];
+    // The set pushed to a bind point and set index is kept for the next push there, also across resets of the command buffer,
+    //  so pushing per draw doesn't allocate. Pushing again to a set still bound with the same layout updates it in place.
+    auto &push_descriptor = cb_state->lastBound[pipelineBindPoint].push_descriptors[set];
+    if (!push_descriptor) {
+        push_descriptor.reset(new cvdescriptorset::DescriptorSet(0, 0, set_layout, device_data));
+    } else if (cb_state->lastBound[pipelineBindPoint].boundDescriptorSets[set] != push_descriptor.get() ||
+               push_descriptor->GetLayout() != set_layout) {
+        push_descriptor->Reuse(VK_NULL_HANDLE, set_layout);
+    }
+    for (uint32_t i = 0; i < descriptorWriteCount; i++) {
+        const auto &write = pDescriptorWrites[i];
+        // The writes aren't validated here, skip those that don't fit the set rather than write out of bounds
+        if (!push_descriptor->HasBinding(write.dstBinding) ||
+            push_descriptor->GetTypeFromBinding(write.dstBinding) != write.descriptorType ||
+            push_descriptor->GetGlobalStartIndexFromBinding(write.dstBinding) + write.dstArrayElement + write.descriptorCount >
+                push_descriptor->GetTotalDescriptorCount()) {
+            continue;
+        }
+        push_descriptor->PerformWriteUpdate(&write);
+    }
+    cb_state->lastBound[pipelineBindPoint].boundDescriptorSets[set] = push_descriptor.get();
 }
 
 VKAPI_ATTR void VKAPI_CALL CmdPushDescriptorSetKHR(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint,
                                                    VkPipelineLayout layout, uint32_t set, uint32_t descriptorWriteCount,
                                                    const VkWriteDescriptorSet *pDescriptorWrites) {
     layer_data *device_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(device_data, commandBuffer);
     PreCallRecordCmdPushDescriptorSetKHR(device_data, commandBuffer, pipelineBindPoint, layout, set, descriptorWriteCount,
                                          pDescriptorWrites);
     lock.unlock();
@@ -5655,7 +6635,7 @@ VKAPI_ATTR void VKAPI_CALL CmdBindIndexBuffer(VkCommandBuffer commandBuffer, VkB
                                               VkIndexType indexType) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
 
     auto buffer_state = GetBufferState(dev_data, buffer);
     auto cb_node = GetCBNode(dev_data, commandBuffer);
@@ -5679,10 +6659,7 @@ VKAPI_ATTR void VKAPI_CALL CmdBindIndexBuffer(VkCommandBuffer commandBuffer, VkB
     if (skip)
         return;
 
-    std::function<bool()> function = [=]() {
-        return ValidateBufferMemoryIsValid(dev_data, buffer_state, "vkCmdBindIndexBuffer()");
-    };
-    cb_node->queue_submit_functions.push_back(function);
+    DeferBufferMemoryCheck(cb_node, buffer_state, "vkCmdBindIndexBuffer()");
     cb_node->status |= CBSTATUS_INDEX_BUFFER_BOUND;
 
     lock.unlock();
@@ -5705,7 +6682,7 @@ VKAPI_ATTR void VKAPI_CALL CmdBindVertexBuffers(VkCommandBuffer commandBuffer, u
                                                 const VkBuffer *pBuffers, const VkDeviceSize *pOffsets) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
 
     auto cb_node = GetCBNode(dev_data, commandBuffer);
     assert(cb_node);
@@ -5732,10 +6709,7 @@ VKAPI_ATTR void VKAPI_CALL CmdBindVertexBuffers(VkCommandBuffer commandBuffer, u
     for (uint32_t i = 0; i < bindingCount; ++i) {
         auto buffer_state = GetBufferState(dev_data, pBuffers[i]);
         assert(buffer_state);
-        std::function<bool()> function = [=]() {
-            return ValidateBufferMemoryIsValid(dev_data, buffer_state, "vkCmdBindVertexBuffers()");
-        };
-        cb_node->queue_submit_functions.push_back(function);
+        DeferBufferMemoryCheck(cb_node, buffer_state, "vkCmdBindVertexBuffers()");
     }
 
     updateResourceTracking(cb_node, firstBinding, bindingCount, pBuffers);
@@ -5744,29 +6718,12 @@ VKAPI_ATTR void VKAPI_CALL CmdBindVertexBuffers(VkCommandBuffer commandBuffer, u
     dev_data->dispatch_table.CmdBindVertexBuffers(commandBuffer, firstBinding, bindingCount, pBuffers, pOffsets);
 }
 
-// Expects global_lock to be held by caller
-static void MarkStoreImagesAndBuffersAsWritten(layer_data *dev_data, GLOBAL_CB_NODE *pCB) {
-    for (auto imageView : pCB->updateImages) {
-        auto view_state = GetImageViewState(dev_data, imageView);
-        if (!view_state) continue;
-
-        auto image_state = GetImageState(dev_data, view_state->create_info.image);
-        assert(image_state);
-        std::function<bool()> function = [=]() {
-            SetImageMemoryValid(dev_data, image_state, true);
-            return false;
-        };
-        pCB->queue_submit_functions.push_back(function);
-    }
-    for (auto buffer : pCB->updateBuffers) {
-        auto buffer_state = GetBufferState(dev_data, buffer);
-        assert(buffer_state);
-        std::function<bool()> function = [=]() {
-            SetBufferMemoryValid(dev_data, buffer_state, true);
-            return false;
-        };
-        pCB->queue_submit_functions.push_back(function);
-    }
+// Whether to validate the draw or dispatch being recorded into cb_state, see sample_frames, sample_draws and frame_budget_us
+static bool SampleDrawValidation(layer_data *dev_data, GLOBAL_CB_NODE *cb_state) {
+    auto const instance_data = dev_data->instance_data;
+    if (instance_data->options.sample_draws > 1 && (cb_state->draw_sample_count++ % instance_data->options.sample_draws)) return false;
+    if (instance_data->options.sample_frames > 1 && (dev_data->frame_count % instance_data->options.sample_frames)) return false;
+    return !instance_data->options.frame_budget_us || dev_data->frame_validation_ns.load() < instance_data->options.frame_budget_us * 1000ull;
 }
 
 // Generic function to handle validation for all CmdDraw* type functions
@@ -5779,9 +6736,18 @@ static bool ValidateCmdDrawType(layer_data *dev_data, VkCommandBuffer cmd_buffer
     if (*cb_state) {
         skip |= ValidateCmdQueueFlags(dev_data, *cb_state, caller, queue_flags, queue_flag_code);
         skip |= ValidateCmd(dev_data, *cb_state, cmd_type, caller);
-        skip |= ValidateDrawState(dev_data, *cb_state, cmd_type, indexed, bind_point, caller, dynamic_state_msg_code);
         skip |= (VK_PIPELINE_BIND_POINT_GRAPHICS == bind_point) ? outsideRenderPass(dev_data, *cb_state, caller, msg_code)
                                                                 : insideRenderPass(dev_data, *cb_state, caller, msg_code);
+        // The descriptor and pipeline state checks are what makes draws expensive, so only they are sampled and timed
+        if (SampleDrawValidation(dev_data, *cb_state)) {
+            auto const timed = dev_data->instance_data->options.frame_budget_us != 0;
+            auto const start = timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+            skip |= ValidateDrawState(dev_data, *cb_state, cmd_type, indexed, bind_point, caller, dynamic_state_msg_code);
+            if (timed) {
+                auto const elapsed = std::chrono::steady_clock::now() - start;
+                dev_data->frame_validation_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+            }
+        }
     }
     return skip;
 }
@@ -5789,7 +6755,6 @@ static bool ValidateCmdDrawType(layer_data *dev_data, VkCommandBuffer cmd_buffer
 // Generic function to handle state update for all CmdDraw* and CmdDispatch* type functions
 static void UpdateStateCmdDrawDispatchType(layer_data *dev_data, GLOBAL_CB_NODE *cb_state, VkPipelineBindPoint bind_point) {
     UpdateDrawState(dev_data, cb_state, bind_point);
-    MarkStoreImagesAndBuffersAsWritten(dev_data, cb_state);
 }
 
 // Generic function to handle state update for all CmdDraw* type functions
@@ -5813,7 +6778,7 @@ VKAPI_ATTR void VKAPI_CALL CmdDraw(VkCommandBuffer commandBuffer, uint32_t verte
                                    uint32_t firstVertex, uint32_t firstInstance) {
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
     GLOBAL_CB_NODE *cb_state = nullptr;
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     bool skip = PreCallValidateCmdDraw(dev_data, commandBuffer, false, VK_PIPELINE_BIND_POINT_GRAPHICS, &cb_state, "vkCmdDraw()");
     lock.unlock();
     if (!skip) {
@@ -5838,7 +6803,7 @@ VKAPI_ATTR void VKAPI_CALL CmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_
                                           uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance) {
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
     GLOBAL_CB_NODE *cb_state = nullptr;
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     bool skip = PreCallValidateCmdDrawIndexed(dev_data, commandBuffer, true, VK_PIPELINE_BIND_POINT_GRAPHICS, &cb_state,
                                               "vkCmdDrawIndexed()");
     lock.unlock();
@@ -5874,7 +6839,7 @@ VKAPI_ATTR void VKAPI_CALL CmdDrawIndirect(VkCommandBuffer commandBuffer, VkBuff
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
     GLOBAL_CB_NODE *cb_state = nullptr;
     BUFFER_STATE *buffer_state = nullptr;
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     bool skip = PreCallValidateCmdDrawIndirect(dev_data, commandBuffer, buffer, false, VK_PIPELINE_BIND_POINT_GRAPHICS, &cb_state,
                                                &buffer_state, "vkCmdDrawIndirect()");
     lock.unlock();
@@ -5911,7 +6876,7 @@ VKAPI_ATTR void VKAPI_CALL CmdDrawIndexedIndirect(VkCommandBuffer commandBuffer,
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
     GLOBAL_CB_NODE *cb_state = nullptr;
     BUFFER_STATE *buffer_state = nullptr;
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     bool skip = PreCallValidateCmdDrawIndexedIndirect(dev_data, commandBuffer, buffer, true, VK_PIPELINE_BIND_POINT_GRAPHICS,
                                                       &cb_state, &buffer_state, "vkCmdDrawIndexedIndirect()");
     lock.unlock();
@@ -5936,7 +6901,7 @@ static void PostCallRecordCmdDispatch(layer_data *dev_data, GLOBAL_CB_NODE *cb_s
 VKAPI_ATTR void VKAPI_CALL CmdDispatch(VkCommandBuffer commandBuffer, uint32_t x, uint32_t y, uint32_t z) {
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
     GLOBAL_CB_NODE *cb_state = nullptr;
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     bool skip =
         PreCallValidateCmdDispatch(dev_data, commandBuffer, false, VK_PIPELINE_BIND_POINT_COMPUTE, &cb_state, "vkCmdDispatch()");
     lock.unlock();
@@ -5969,7 +6934,7 @@ VKAPI_ATTR void VKAPI_CALL CmdDispatchIndirect(VkCommandBuffer commandBuffer, Vk
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
     GLOBAL_CB_NODE *cb_state = nullptr;
     BUFFER_STATE *buffer_state = nullptr;
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     bool skip = PreCallValidateCmdDispatchIndirect(dev_data, commandBuffer, buffer, false, VK_PIPELINE_BIND_POINT_COMPUTE,
                                                    &cb_state, &buffer_state, "vkCmdDispatchIndirect()");
     lock.unlock();
@@ -5984,7 +6949,7 @@ VKAPI_ATTR void VKAPI_CALL CmdDispatchIndirect(VkCommandBuffer commandBuffer, Vk
 VKAPI_ATTR void VKAPI_CALL CmdCopyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer,
                                          uint32_t regionCount, const VkBufferCopy *pRegions) {
     layer_data *device_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(device_data, commandBuffer);
 
     auto cb_node = GetCBNode(device_data, commandBuffer);
     auto src_buffer_state = GetBufferState(device_data, srcBuffer);
@@ -6008,7 +6973,7 @@ VKAPI_ATTR void VKAPI_CALL CmdCopyImage(VkCommandBuffer commandBuffer, VkImage s
                                         const VkImageCopy *pRegions) {
     bool skip = false;
     layer_data *device_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(device_data, commandBuffer);
 
     auto cb_node = GetCBNode(device_data, commandBuffer);
     auto src_image_state = GetImageState(device_data, srcImage);
@@ -6047,7 +7012,7 @@ VKAPI_ATTR void VKAPI_CALL CmdBlitImage(VkCommandBuffer commandBuffer, VkImage s
                                         VkImage dstImage, VkImageLayout dstImageLayout, uint32_t regionCount,
                                         const VkImageBlit *pRegions, VkFilter filter) {
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
 
     auto cb_node = GetCBNode(dev_data, commandBuffer);
     auto src_image_state = GetImageState(dev_data, srcImage);
@@ -6067,7 +7032,7 @@ VKAPI_ATTR void VKAPI_CALL CmdCopyBufferToImage(VkCommandBuffer commandBuffer, V
                                                 VkImageLayout dstImageLayout, uint32_t regionCount,
                                                 const VkBufferImageCopy *pRegions) {
     layer_data *device_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(device_data, commandBuffer);
     bool skip = false;
     auto cb_node = GetCBNode(device_data, commandBuffer);
     auto src_buffer_state = GetBufferState(device_data, srcBuffer);
@@ -6092,7 +7057,7 @@ VKAPI_ATTR void VKAPI_CALL CmdCopyImageToBuffer(VkCommandBuffer commandBuffer, V
                                                 VkBuffer dstBuffer, uint32_t regionCount, const VkBufferImageCopy *pRegions) {
     bool skip = false;
     layer_data *device_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(device_data, commandBuffer);
 
     auto cb_node = GetCBNode(device_data, commandBuffer);
     auto src_image_state = GetImageState(device_data, srcImage);
@@ -6129,18 +7094,14 @@ static bool PreCallCmdUpdateBuffer(layer_data *device_data, const GLOBAL_CB_NODE
 static void PostCallRecordCmdUpdateBuffer(layer_data *device_data, GLOBAL_CB_NODE *cb_state, BUFFER_STATE *dst_buffer_state) {
     // Update bindings between buffer and cmd buffer
     AddCommandBufferBindingBuffer(device_data, cb_state, dst_buffer_state);
-    std::function<bool()> function = [=]() {
-        SetBufferMemoryValid(device_data, dst_buffer_state, true);
-        return false;
-    };
-    cb_state->queue_submit_functions.push_back(function);
+    DeferBufferMemoryValid(cb_state, dst_buffer_state, true);
 }
 
 VKAPI_ATTR void VKAPI_CALL CmdUpdateBuffer(VkCommandBuffer commandBuffer, VkBuffer dstBuffer, VkDeviceSize dstOffset,
                                            VkDeviceSize dataSize, const uint32_t *pData) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
 
     auto cb_state = GetCBNode(dev_data, commandBuffer);
     assert(cb_state);
@@ -6159,7 +7120,7 @@ VKAPI_ATTR void VKAPI_CALL CmdUpdateBuffer(VkCommandBuffer commandBuffer, VkBuff
 VKAPI_ATTR void VKAPI_CALL CmdFillBuffer(VkCommandBuffer commandBuffer, VkBuffer dstBuffer, VkDeviceSize dstOffset,
                                          VkDeviceSize size, uint32_t data) {
     layer_data *device_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(device_data, commandBuffer);
     auto cb_node = GetCBNode(device_data, commandBuffer);
     auto buffer_state = GetBufferState(device_data, dstBuffer);
 
@@ -6182,8 +7143,12 @@ VKAPI_ATTR void VKAPI_CALL CmdClearAttachments(VkCommandBuffer commandBuffer, ui
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
     {
-        lock_guard_t lock(global_lock);
+        record_lock_t lock(dev_data, commandBuffer);
         skip = PreCallValidateCmdClearAttachments(dev_data, commandBuffer, attachmentCount, pAttachments, rectCount, pRects);
+        GLOBAL_CB_NODE *cb_state = GetCBNode(dev_data, commandBuffer);
+        if (!skip && cb_state && dev_data->instance_data->options.perf_hints) {
+            PerfHintCmdClearAttachments(dev_data, cb_state, attachmentCount, pAttachments, rectCount, pRects);
+        }
     }
     if (!skip) dev_data->dispatch_table.CmdClearAttachments(commandBuffer, attachmentCount, pAttachments, rectCount, pRects);
 }
@@ -6192,7 +7157,7 @@ VKAPI_ATTR void VKAPI_CALL CmdClearColorImage(VkCommandBuffer commandBuffer, VkI
                                               const VkClearColorValue *pColor, uint32_t rangeCount,
                                               const VkImageSubresourceRange *pRanges) {
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
 
     bool skip = PreCallValidateCmdClearColorImage(dev_data, commandBuffer, image, imageLayout, rangeCount, pRanges);
     if (!skip) {
@@ -6206,7 +7171,7 @@ VKAPI_ATTR void VKAPI_CALL CmdClearDepthStencilImage(VkCommandBuffer commandBuff
                                                      const VkClearDepthStencilValue *pDepthStencil, uint32_t rangeCount,
                                                      const VkImageSubresourceRange *pRanges) {
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
 
     bool skip = PreCallValidateCmdClearDepthStencilImage(dev_data, commandBuffer, image, imageLayout, rangeCount, pRanges);
     if (!skip) {
@@ -6220,7 +7185,7 @@ VKAPI_ATTR void VKAPI_CALL CmdResolveImage(VkCommandBuffer commandBuffer, VkImag
                                            VkImage dstImage, VkImageLayout dstImageLayout, uint32_t regionCount,
                                            const VkImageResolve *pRegions) {
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
 
     auto cb_node = GetCBNode(dev_data, commandBuffer);
     auto src_image_state = GetImageState(dev_data, srcImage);
@@ -6246,6 +7211,14 @@ VKAPI_ATTR void VKAPI_CALL GetImageSubresourceLayout(VkDevice device, VkImage im
     }
 }
 
+static void DeferEventStageMask(GLOBAL_CB_NODE *cb_state, VkEvent event, VkPipelineStageFlags stageMask) {
+    CB_DEFERRED_OP op = {};
+    op.type = CB_OP_SET_EVENT_STAGE_MASK;
+    op.stage_mask = stageMask;
+    op.event = event;
+    cb_state->deferred_ops.push_back(op);
+}
+
 bool setEventStageMask(VkQueue queue, VkCommandBuffer commandBuffer, VkEvent event, VkPipelineStageFlags stageMask) {
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
     GLOBAL_CB_NODE *pCB = GetCBNode(dev_data, commandBuffer);
@@ -6262,7 +7235,7 @@ bool setEventStageMask(VkQueue queue, VkCommandBuffer commandBuffer, VkEvent eve
 VKAPI_ATTR void VKAPI_CALL CmdSetEvent(VkCommandBuffer commandBuffer, VkEvent event, VkPipelineStageFlags stageMask) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     GLOBAL_CB_NODE *pCB = GetCBNode(dev_data, commandBuffer);
     if (pCB) {
         skip |= ValidateCmdQueueFlags(dev_data, pCB, "vkCmdSetEvent()", VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT,
@@ -6273,14 +7246,13 @@ VKAPI_ATTR void VKAPI_CALL CmdSetEvent(VkCommandBuffer commandBuffer, VkEvent ev
                                              VALIDATION_ERROR_1d4008fe);
         auto event_state = GetEventNode(dev_data, event);
         if (event_state) {
-            addCommandBufferBinding(&event_state->cb_bindings, {HandleToUint64(event), kVulkanObjectTypeEvent}, pCB);
-            event_state->cb_bindings.insert(pCB);
+            addCommandBufferBinding(event_state, {HandleToUint64(event), kVulkanObjectTypeEvent}, pCB);
         }
         pCB->events.push_back(event);
         if (!pCB->waitedEvents.count(event)) {
             pCB->writeEventsBeforeWait.push_back(event);
         }
-        pCB->eventUpdates.emplace_back([=](VkQueue q){return setEventStageMask(q, commandBuffer, event, stageMask);});
+        DeferEventStageMask(pCB, event, stageMask);
     }
     lock.unlock();
     if (!skip) dev_data->dispatch_table.CmdSetEvent(commandBuffer, event, stageMask);
@@ -6289,7 +7261,7 @@ VKAPI_ATTR void VKAPI_CALL CmdSetEvent(VkCommandBuffer commandBuffer, VkEvent ev
 VKAPI_ATTR void VKAPI_CALL CmdResetEvent(VkCommandBuffer commandBuffer, VkEvent event, VkPipelineStageFlags stageMask) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     GLOBAL_CB_NODE *pCB = GetCBNode(dev_data, commandBuffer);
     if (pCB) {
         skip |= ValidateCmdQueueFlags(dev_data, pCB, "vkCmdResetEvent()", VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT,
@@ -6300,15 +7272,14 @@ VKAPI_ATTR void VKAPI_CALL CmdResetEvent(VkCommandBuffer commandBuffer, VkEvent
                                              VALIDATION_ERROR_1c400906);
         auto event_state = GetEventNode(dev_data, event);
         if (event_state) {
-            addCommandBufferBinding(&event_state->cb_bindings, {HandleToUint64(event), kVulkanObjectTypeEvent}, pCB);
-            event_state->cb_bindings.insert(pCB);
+            addCommandBufferBinding(event_state, {HandleToUint64(event), kVulkanObjectTypeEvent}, pCB);
         }
         pCB->events.push_back(event);
         if (!pCB->waitedEvents.count(event)) {
             pCB->writeEventsBeforeWait.push_back(event);
         }
         // TODO : Add check for VALIDATION_ERROR_32c008f8
-        pCB->eventUpdates.emplace_back([=](VkQueue q){return setEventStageMask(q, commandBuffer, event, VkPipelineStageFlags(0));});
+        DeferEventStageMask(pCB, event, VkPipelineStageFlags(0));
     }
     lock.unlock();
     if (!skip) dev_data->dispatch_table.CmdResetEvent(commandBuffer, event, stageMask);
@@ -6406,6 +7377,16 @@ static bool ValidateImageBarrierImage(layer_data *device_data, const char *funcN
     return skip;
 }
 
+// Checks an image barrier a secondary command buffer recorded against the framebuffer of the primary executing it
+static bool ValidateDeferredBarrierCheck(layer_data *device_data, GLOBAL_CB_NODE const *cb_state, VkFramebuffer framebuffer,
+                                         const CB_DEFERRED_BARRIER_CHECK &check) {
+    auto rp_state = GetRenderPassState(device_data, check.render_pass);
+    if (!rp_state) return false;
+    const auto &sub_desc = rp_state->createInfo.pSubpasses[check.active_subpass];
+    return ValidateImageBarrierImage(device_data, check.function, cb_state, framebuffer, check.active_subpass, sub_desc,
+                                     HandleToUint64(check.render_pass), check.barrier_index, check.barrier);
+}
+
 // Validate image barriers within a renderPass
 static bool ValidateRenderPassImageBarriers(layer_data *device_data, const char *funcName, GLOBAL_CB_NODE *cb_state,
                                             uint32_t active_subpass, const safe_VkSubpassDescription &sub_desc, uint64_t rp_handle,
@@ -6447,10 +7428,8 @@ static bool ValidateRenderPassImageBarriers(layer_data *device_data, const char
         if (VK_NULL_HANDLE == cb_state->activeFramebuffer) {
             assert(VK_COMMAND_BUFFER_LEVEL_SECONDARY == cb_state->createInfo.level);
             // Secondary CB case w/o FB specified delay validation
-            cb_state->cmd_execute_commands_functions.emplace_back([=](VkFramebuffer fb) {
-                return ValidateImageBarrierImage(device_data, funcName, cb_state, fb, active_subpass, sub_desc, rp_handle, i,
-                                                 img_barrier);
-            });
+            cb_state->deferred_barrier_checks.push_back(
+                {funcName, cb_state->activeRenderPass->renderPass, active_subpass, i, img_barrier});
         } else {
             skip |= ValidateImageBarrierImage(device_data, funcName, cb_state, cb_state->activeFramebuffer, active_subpass,
                                               sub_desc, rp_handle, i, img_barrier);
@@ -6866,7 +7845,7 @@ bool ValidateStageMasksAgainstQueueCapabilities(layer_data *dev_data, GLOBAL_CB_
                                                 VkPipelineStageFlags source_stage_mask, VkPipelineStageFlags dest_stage_mask,
                                                 const char *function, UNIQUE_VALIDATION_ERROR_CODE error_code) {
     bool skip = false;
-    uint32_t queue_family_index = dev_data->commandPoolMap[cb_state->createInfo.commandPool].queueFamilyIndex;
+    uint32_t queue_family_index = GetCommandPoolNode(dev_data, cb_state->createInfo.commandPool)->queueFamilyIndex;
     instance_layer_data *instance_data = GetLayerDataPtr(get_dispatch_key(dev_data->physical_device), instance_layer_data_map);
     auto physical_device_state = GetPhysicalDeviceState(instance_data, dev_data->physical_device);
 
@@ -6896,7 +7875,7 @@ VKAPI_ATTR void VKAPI_CALL CmdWaitEvents(VkCommandBuffer commandBuffer, uint32_t
                                          uint32_t imageMemoryBarrierCount, const VkImageMemoryBarrier *pImageMemoryBarriers) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     GLOBAL_CB_NODE *cb_state = GetCBNode(dev_data, commandBuffer);
     if (cb_state) {
         skip |= ValidateStageMasksAgainstQueueCapabilities(dev_data, cb_state, sourceStageMask, dstStageMask, "vkCmdWaitEvents",
@@ -6917,15 +7896,17 @@ VKAPI_ATTR void VKAPI_CALL CmdWaitEvents(VkCommandBuffer commandBuffer, uint32_t
             for (uint32_t i = 0; i < eventCount; ++i) {
                 auto event_state = GetEventNode(dev_data, pEvents[i]);
                 if (event_state) {
-                    addCommandBufferBinding(&event_state->cb_bindings, {HandleToUint64(pEvents[i]), kVulkanObjectTypeEvent}, cb_state);
-                    event_state->cb_bindings.insert(cb_state);
+                    addCommandBufferBinding(event_state, {HandleToUint64(pEvents[i]), kVulkanObjectTypeEvent}, cb_state);
                 }
                 cb_state->waitedEvents.insert(pEvents[i]);
                 cb_state->events.push_back(pEvents[i]);
             }
-            cb_state->eventUpdates.emplace_back([=](VkQueue q){
-                return validateEventStageMask(q, cb_state, eventCount, first_event_index, sourceStageMask);
-            });
+            CB_DEFERRED_OP op = {};
+            op.type = CB_OP_VALIDATE_EVENT_STAGE_MASK;
+            op.first = static_cast<uint32_t>(first_event_index);
+            op.count = eventCount;
+            op.stage_mask = sourceStageMask;
+            cb_state->deferred_ops.push_back(op);
             TransitionImageLayouts(dev_data, commandBuffer, imageMemoryBarrierCount, pImageMemoryBarriers);
         }
     }
@@ -6941,6 +7922,7 @@ static bool PreCallValidateCmdPipelineBarrier(layer_data *device_data, GLOBAL_CB
                                               uint32_t memoryBarrierCount, const VkMemoryBarrier *pMemoryBarriers,
                                               uint32_t bufferMemoryBarrierCount, const VkBufferMemoryBarrier *pBufferMemoryBarriers,
                                               uint32_t imageMemoryBarrierCount, const VkImageMemoryBarrier *pImageMemoryBarriers) {
+    CheckProfileScope profile(device_data, CHECK_PROFILE_PIPELINE_BARRIER);
     bool skip = false;
     skip |= ValidateStageMasksAgainstQueueCapabilities(device_data, cb_state, srcStageMask, dstStageMask, "vkCmdPipelineBarrier",
                                                        VALIDATION_ERROR_1b80093e);
@@ -6977,14 +7959,19 @@ VKAPI_ATTR void VKAPI_CALL CmdPipelineBarrier(VkCommandBuffer commandBuffer, VkP
                                               uint32_t imageMemoryBarrierCount, const VkImageMemoryBarrier *pImageMemoryBarriers) {
     bool skip = false;
     layer_data *device_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(device_data, commandBuffer);
     GLOBAL_CB_NODE *cb_state = GetCBNode(device_data, commandBuffer);
     if (cb_state) {
+        bool const follows_barrier = cb_state->last_cmd == CMD_PIPELINEBARRIER;
         skip |= PreCallValidateCmdPipelineBarrier(device_data, cb_state, srcStageMask, dstStageMask, dependencyFlags,
                                                   memoryBarrierCount, pMemoryBarriers, bufferMemoryBarrierCount,
                                                   pBufferMemoryBarriers, imageMemoryBarrierCount, pImageMemoryBarriers);
         if (!skip) {
             PreCallRecordCmdPipelineBarrier(device_data, cb_state, commandBuffer, imageMemoryBarrierCount, pImageMemoryBarriers);
+            if (device_data->instance_data->options.perf_hints) {
+                PerfHintCmdPipelineBarrier(device_data, cb_state, follows_barrier, srcStageMask, dstStageMask,
+                                           imageMemoryBarrierCount, pImageMemoryBarriers);
+            }
         }
     } else {
         assert(0);
@@ -6997,15 +7984,29 @@ VKAPI_ATTR void VKAPI_CALL CmdPipelineBarrier(VkCommandBuffer commandBuffer, VkP
     }
 }
 
-static bool setQueryState(VkQueue queue, VkCommandBuffer commandBuffer, QueryObject object, bool value) {
+// Query ops keep the command buffer that recorded them, a primary that executes it runs them as well
+static void DeferQueryOp(GLOBAL_CB_NODE *cb_state, CB_DEFERRED_OP_TYPE type, VkQueryPool queryPool, uint32_t firstQuery,
+                         uint32_t queryCount, QUERY_STATE value) {
+    CB_DEFERRED_OP op = {};
+    op.type = type;
+    op.first = firstQuery;
+    op.count = queryCount;
+    op.query_state = value;
+    op.query_pool = queryPool;
+    op.command_buffer = cb_state->commandBuffer;
+    cb_state->deferred_ops.push_back(op);
+}
+
+static bool setQueryState(VkQueue queue, VkCommandBuffer commandBuffer, VkQueryPool queryPool, uint32_t firstQuery,
+                          uint32_t queryCount, QUERY_STATE value) {
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
     GLOBAL_CB_NODE *pCB = GetCBNode(dev_data, commandBuffer);
     if (pCB) {
-        pCB->queryToStateMap[object] = value;
+        SetQueryStates(pCB->query_states[queryPool], firstQuery, queryCount, value);
     }
     auto queue_data = dev_data->queueMap.find(queue);
     if (queue_data != dev_data->queueMap.end()) {
-        queue_data->second.queryToStateMap[object] = value;
+        SetQueryStates(queue_data->second.query_states[queryPool], firstQuery, queryCount, value);
     }
     return false;
 }
@@ -7013,7 +8014,7 @@ static bool setQueryState(VkQueue queue, VkCommandBuffer commandBuffer, QueryObj
 VKAPI_ATTR void VKAPI_CALL CmdBeginQuery(VkCommandBuffer commandBuffer, VkQueryPool queryPool, uint32_t slot, VkFlags flags) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     GLOBAL_CB_NODE *pCB = GetCBNode(dev_data, commandBuffer);
     if (pCB) {
         skip |= ValidateCmdQueueFlags(dev_data, pCB, "vkCmdBeginQuery()", VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT,
@@ -7031,7 +8032,7 @@ VKAPI_ATTR void VKAPI_CALL CmdBeginQuery(VkCommandBuffer commandBuffer, VkQueryP
         QueryObject query = {queryPool, slot};
         pCB->activeQueries.insert(query);
         pCB->startedQueries.insert(query);
-        addCommandBufferBinding(&GetQueryPoolNode(dev_data, queryPool)->cb_bindings,
+        addCommandBufferBinding(GetQueryPoolNode(dev_data, queryPool),
                                 {HandleToUint64(queryPool), kVulkanObjectTypeQueryPool}, pCB);
     }
 }
@@ -7039,7 +8040,7 @@ VKAPI_ATTR void VKAPI_CALL CmdBeginQuery(VkCommandBuffer commandBuffer, VkQueryP
 VKAPI_ATTR void VKAPI_CALL CmdEndQuery(VkCommandBuffer commandBuffer, VkQueryPool queryPool, uint32_t slot) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     QueryObject query = {queryPool, slot};
     GLOBAL_CB_NODE *cb_state = GetCBNode(dev_data, commandBuffer);
     if (cb_state) {
@@ -7062,8 +8063,8 @@ VKAPI_ATTR void VKAPI_CALL CmdEndQuery(VkCommandBuffer commandBuffer, VkQueryPoo
     lock.lock();
     if (cb_state) {
         cb_state->activeQueries.erase(query);
-        cb_state->queryUpdates.emplace_back([=](VkQueue q){return setQueryState(q, commandBuffer, query, true);});
-        addCommandBufferBinding(&GetQueryPoolNode(dev_data, queryPool)->cb_bindings,
+        DeferQueryOp(cb_state, CB_OP_SET_QUERY_STATE, queryPool, slot, 1, QUERYSTATE_AVAILABLE);
+        addCommandBufferBinding(GetQueryPoolNode(dev_data, queryPool),
                                 {HandleToUint64(queryPool), kVulkanObjectTypeQueryPool}, cb_state);
     }
 }
@@ -7072,7 +8073,7 @@ VKAPI_ATTR void VKAPI_CALL CmdResetQueryPool(VkCommandBuffer commandBuffer, VkQu
                                              uint32_t queryCount) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     GLOBAL_CB_NODE *cb_state = GetCBNode(dev_data, commandBuffer);
         skip |= insideRenderPass(dev_data, cb_state, "vkCmdResetQueryPool()", VALIDATION_ERROR_1c600017);
         skip |= ValidateCmd(dev_data, cb_state, CMD_RESETQUERYPOOL, "VkCmdResetQueryPool()");
@@ -7085,40 +8086,80 @@ VKAPI_ATTR void VKAPI_CALL CmdResetQueryPool(VkCommandBuffer commandBuffer, VkQu
     dev_data->dispatch_table.CmdResetQueryPool(commandBuffer, queryPool, firstQuery, queryCount);
 
     lock.lock();
-    for (uint32_t i = 0; i < queryCount; i++) {
-        QueryObject query = {queryPool, firstQuery + i};
-        cb_state->waitedEventsBeforeQueryReset[query] = cb_state->waitedEvents;
-        cb_state->queryUpdates.emplace_back([=](VkQueue q){return setQueryState(q, commandBuffer, query, false);});
-    }
-    addCommandBufferBinding(&GetQueryPoolNode(dev_data, queryPool)->cb_bindings,
+    cb_state->waitedEventsBeforeQueryReset.push_back(
+        {queryPool, firstQuery, queryCount, std::vector<VkEvent>(cb_state->waitedEvents.begin(), cb_state->waitedEvents.end())});
+    DeferQueryOp(cb_state, CB_OP_SET_QUERY_STATE, queryPool, firstQuery, queryCount, QUERYSTATE_UNAVAILABLE);
+    addCommandBufferBinding(GetQueryPoolNode(dev_data, queryPool),
                             {HandleToUint64(queryPool), kVulkanObjectTypeQueryPool}, cb_state);
 }
 
-static bool IsQueryInvalid(layer_data *dev_data, QUEUE_STATE *queue_data, VkQueryPool queryPool, uint32_t queryIndex) {
-    QueryObject query = {queryPool, queryIndex};
-    auto query_data = queue_data->queryToStateMap.find(query);
-    if (query_data != queue_data->queryToStateMap.end()) {
-        if (!query_data->second) return true;
-    } else {
-        auto it = dev_data->queryToStateMap.find(query);
-        if (it == dev_data->queryToStateMap.end() || !it->second)
-            return true;
-    }
-
-    return false;
-}
-
 static bool validateQuery(VkQueue queue, GLOBAL_CB_NODE *pCB, VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(pCB->commandBuffer), layer_data_map);
     auto queue_data = GetQueueState(dev_data, queue);
     if (!queue_data) return false;
+    // States set by earlier submissions to the queue take precedence over those of retired command buffers
+    auto queue_states = queue_data->query_states.find(queryPool);
+    auto qp_state = GetQueryPoolNode(dev_data, queryPool);
     for (uint32_t i = 0; i < queryCount; i++) {
-        if (IsQueryInvalid(dev_data, queue_data, queryPool, firstQuery + i)) {
+        uint32_t query = firstQuery + i;
+        auto state = queue_states != queue_data->query_states.end() ? GetQueryState(queue_states->second, query)
+                                                                    : QUERYSTATE_UNKNOWN;
+        if (state == QUERYSTATE_UNKNOWN && qp_state) state = GetQueryState(qp_state->query_states, query);
+        if (state != QUERYSTATE_AVAILABLE) {
             skip |= log_msg(dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_COMMAND_BUFFER_EXT,
                             HandleToUint64(pCB->commandBuffer), __LINE__, DRAWSTATE_INVALID_QUERY, "DS",
                             "Requesting a copy from query to buffer with invalid query: queryPool 0x%" PRIx64 ", index %d",
-                            HandleToUint64(queryPool), firstQuery + i);
+                            HandleToUint64(queryPool), query);
+        }
+    }
+    return skip;
+}
+
+// Runs the ops cb_node deferred to its submission to queue, in the order they were recorded
+static bool RunDeferredOps(layer_data *dev_data, GLOBAL_CB_NODE *cb_node, VkQueue queue) {
+    bool skip = false;
+    for (const auto &op : cb_node->deferred_ops) {
+        switch (op.type) {
+            case CB_OP_SET_IMAGE_MEMORY_VALID:
+                SetImageMemoryValid(dev_data, op.image_state, op.valid);
+                break;
+            case CB_OP_SET_BUFFER_MEMORY_VALID:
+                SetBufferMemoryValid(dev_data, op.buffer_state, op.valid);
+                break;
+            case CB_OP_CHECK_IMAGE_MEMORY_VALID:
+                skip |= ValidateImageMemoryIsValid(dev_data, op.image_state, op.function);
+                break;
+            case CB_OP_CHECK_BUFFER_MEMORY_VALID:
+                skip |= ValidateBufferMemoryIsValid(dev_data, op.buffer_state, op.function);
+                break;
+            case CB_OP_SET_ATTACHMENT_MEMORY_VALID: {
+                auto image_state = GetImageState(dev_data, op.image);
+                if (image_state) SetImageMemoryValid(dev_data, image_state, op.valid);
+                break;
+            }
+            case CB_OP_CHECK_ATTACHMENT_MEMORY_VALID: {
+                auto image_state = GetImageState(dev_data, op.image);
+                if (image_state) skip |= ValidateImageMemoryIsValid(dev_data, image_state, op.function);
+                break;
+            }
+            case CB_OP_MARK_STORAGE_WRITTEN:
+                MarkStorageUpdatesAsWritten(dev_data, op.storage_updates);
+                break;
+            case CB_OP_SET_EVENT_STAGE_MASK:
+                skip |= setEventStageMask(queue, cb_node->commandBuffer, op.event, op.stage_mask);
+                break;
+            case CB_OP_VALIDATE_EVENT_STAGE_MASK:
+                skip |= validateEventStageMask(queue, cb_node, op.count, op.first, op.stage_mask);
+                break;
+            case CB_OP_SET_QUERY_STATE:
+                skip |= setQueryState(queue, op.command_buffer, op.query_pool, op.first, op.count, op.query_state);
+                break;
+            case CB_OP_VALIDATE_QUERY: {
+                auto recording_cb = GetCBNode(dev_data, op.command_buffer);
+                if (recording_cb) skip |= validateQuery(queue, recording_cb, op.query_pool, op.first, op.count);
+                break;
+            }
         }
     }
     return skip;
@@ -7129,7 +8170,7 @@ VKAPI_ATTR void VKAPI_CALL CmdCopyQueryPoolResults(VkCommandBuffer commandBuffer
                                                    VkDeviceSize stride, VkQueryResultFlags flags) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
 
     auto cb_node = GetCBNode(dev_data, commandBuffer);
     auto dst_buff_state = GetBufferState(dev_data, dstBuffer);
@@ -7154,14 +8195,9 @@ VKAPI_ATTR void VKAPI_CALL CmdCopyQueryPoolResults(VkCommandBuffer commandBuffer
     lock.lock();
     if (cb_node && dst_buff_state) {
         AddCommandBufferBindingBuffer(dev_data, cb_node, dst_buff_state);
-        cb_node->queue_submit_functions.emplace_back([=]() {
-            SetBufferMemoryValid(dev_data, dst_buff_state, true);
-            return false;
-        });
-        cb_node->queryUpdates.emplace_back([=](VkQueue q) {
-            return validateQuery(q, cb_node, queryPool, firstQuery, queryCount);
-        });
-        addCommandBufferBinding(&GetQueryPoolNode(dev_data, queryPool)->cb_bindings,
+        DeferBufferMemoryValid(cb_node, dst_buff_state, true);
+        DeferQueryOp(cb_node, CB_OP_VALIDATE_QUERY, queryPool, firstQuery, queryCount, QUERYSTATE_UNKNOWN);
+        addCommandBufferBinding(GetQueryPoolNode(dev_data, queryPool),
                                 {HandleToUint64(queryPool), kVulkanObjectTypeQueryPool}, cb_node);
     }
 }
@@ -7170,7 +8206,7 @@ VKAPI_ATTR void VKAPI_CALL CmdPushConstants(VkCommandBuffer commandBuffer, VkPip
                                             uint32_t offset, uint32_t size, const void *pValues) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     GLOBAL_CB_NODE *cb_state = GetCBNode(dev_data, commandBuffer);
     if (cb_state) {
         skip |= ValidateCmdQueueFlags(dev_data, cb_state, "vkCmdPushConstants()", VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT,
@@ -7215,7 +8251,7 @@ VKAPI_ATTR void VKAPI_CALL CmdWriteTimestamp(VkCommandBuffer commandBuffer, VkPi
                                              VkQueryPool queryPool, uint32_t slot) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     GLOBAL_CB_NODE *cb_state = GetCBNode(dev_data, commandBuffer);
     if (cb_state) {
         skip |= ValidateCmdQueueFlags(dev_data, cb_state, "vkCmdWriteTimestamp()", VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT,
@@ -7230,8 +8266,7 @@ VKAPI_ATTR void VKAPI_CALL CmdWriteTimestamp(VkCommandBuffer commandBuffer, VkPi
 
     lock.lock();
     if (cb_state) {
-        QueryObject query = {queryPool, slot};
-        cb_state->queryUpdates.emplace_back([=](VkQueue q) {return setQueryState(q, commandBuffer, query, true);});
+        DeferQueryOp(cb_state, CB_OP_SET_QUERY_STATE, queryPool, slot, 1, QUERYSTATE_AVAILABLE);
     }
 }
 
@@ -7700,6 +8735,25 @@ static bool ValidateDependencies(const layer_data *dev_data, FRAMEBUFFER_STATE c
     return skip;
 }
 
+// ValidateDependencies() only looks at the render pass and the framebuffer's attachments, neither of which can change, so a
+// pair that passed once is remembered on the framebuffer and not walked again. Failing pairs are rechecked so that every
+// vkCmdBeginRenderPass() using them still reports its errors.
+static bool ValidateFramebufferDependencies(const layer_data *dev_data, FRAMEBUFFER_STATE *framebuffer, VkRenderPass render_pass) {
+    auto render_pass_state = GetRenderPassStateSharedPtr(dev_data, render_pass);
+    {
+        std::lock_guard<std::mutex> lock(framebuffer->dependencies_lock);
+        for (auto const &validated : framebuffer->dependencies_validated) {
+            if (validated == render_pass_state) return false;
+        }
+    }
+    bool skip = ValidateDependencies(dev_data, framebuffer, render_pass_state.get());
+    if (!skip) {
+        std::lock_guard<std::mutex> lock(framebuffer->dependencies_lock);
+        framebuffer->dependencies_validated.push_back(std::move(render_pass_state));
+    }
+    return skip;
+}
+
 static bool CreatePassDAG(const layer_data *dev_data, const VkRenderPassCreateInfo *pCreateInfo,
                           std::vector<DAGNode> &subpass_to_node, std::vector<bool> &has_self_dependency,
                           std::vector<int32_t> &subpass_to_dep_index) {
@@ -7738,15 +8792,23 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateShaderModule(VkDevice device, const VkShade
                                                   const VkAllocationCallbacks *pAllocator, VkShaderModule *pShaderModule) {
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
     bool spirv_valid;
+    std::shared_ptr<shader_module> new_shader_module;
 
-    if (PreCallValidateCreateShaderModule(dev_data, pCreateInfo, &spirv_valid))
+    if (PreCallValidateCreateShaderModule(dev_data, pCreateInfo, &spirv_valid, &new_shader_module))
         return VK_ERROR_VALIDATION_FAILED_EXT;
 
     VkResult res = dev_data->dispatch_table.CreateShaderModule(device, pCreateInfo, pAllocator, pShaderModule);
 
     if (res == VK_SUCCESS) {
+        if (!spirv_valid) {
+            new_shader_module = std::make_shared<shader_module>();
+        } else if (GetDisables(dev_data)->shader_validation) {
+            // Code that wasn't validated isn't shared
+            new_shader_module = std::make_shared<shader_module>(pCreateInfo);
+        } else if (!new_shader_module) {
+            new_shader_module = GetSharedShaderModule(pCreateInfo);
+        }
         lock_guard_t lock(global_lock);
-        unique_ptr<shader_module> new_shader_module(spirv_valid ? new shader_module(pCreateInfo) : new shader_module());
         dev_data->shaderModuleMap[*pShaderModule] = std::move(new_shader_module);
     }
     return res;
@@ -7955,8 +9017,20 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateRenderPass(VkDevice device, const VkRenderP
         render_pass->subpassToNode = subpass_to_node;
         render_pass->subpass_to_dependency_index = subpass_to_dep_index;
 
+        render_pass->subpass_attachment_refs.resize(pCreateInfo->subpassCount);
         for (uint32_t i = 0; i < pCreateInfo->subpassCount; ++i) {
             const VkSubpassDescription &subpass = pCreateInfo->pSubpasses[i];
+            auto &refs = render_pass->subpass_attachment_refs[i];
+            for (uint32_t j = 0; j < subpass.inputAttachmentCount; ++j) {
+                if (subpass.pInputAttachments[j].attachment != VK_ATTACHMENT_UNUSED) refs.push_back(subpass.pInputAttachments[j]);
+            }
+            for (uint32_t j = 0; j < subpass.colorAttachmentCount; ++j) {
+                if (subpass.pColorAttachments[j].attachment != VK_ATTACHMENT_UNUSED) refs.push_back(subpass.pColorAttachments[j]);
+            }
+            if (subpass.pDepthStencilAttachment && subpass.pDepthStencilAttachment->attachment != VK_ATTACHMENT_UNUSED) {
+                refs.push_back(*subpass.pDepthStencilAttachment);
+            }
+
             for (uint32_t j = 0; j < subpass.colorAttachmentCount; ++j) {
                 MarkAttachmentFirstUse(render_pass.get(), subpass.pColorAttachments[j].attachment, false);
 
@@ -8028,7 +9102,7 @@ VKAPI_ATTR void VKAPI_CALL CmdBeginRenderPass(VkCommandBuffer commandBuffer, con
                                               VkSubpassContents contents) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     GLOBAL_CB_NODE *cb_node = GetCBNode(dev_data, commandBuffer);
     auto render_pass_state = pRenderPassBegin ? GetRenderPassState(dev_data, pRenderPassBegin->renderPass) : nullptr;
     auto framebuffer = pRenderPassBegin ? GetFramebufferState(dev_data, pRenderPassBegin->framebuffer) : nullptr;
@@ -8042,32 +9116,16 @@ VKAPI_ATTR void VKAPI_CALL CmdBeginRenderPass(VkCommandBuffer commandBuffer, con
                 if (FormatSpecificLoadAndStoreOpSettings(pAttachment->format, pAttachment->loadOp, pAttachment->stencilLoadOp,
                                                          VK_ATTACHMENT_LOAD_OP_CLEAR)) {
                     clear_op_size = static_cast<uint32_t>(i) + 1;
-                    std::function<bool()> function = [=]() {
-                        SetImageMemoryValid(dev_data, GetImageState(dev_data, fb_info.image), true);
-                        return false;
-                    };
-                    cb_node->queue_submit_functions.push_back(function);
+                    DeferAttachmentMemoryValid(cb_node, fb_info.image, true);
                 } else if (FormatSpecificLoadAndStoreOpSettings(pAttachment->format, pAttachment->loadOp,
                                                                 pAttachment->stencilLoadOp, VK_ATTACHMENT_LOAD_OP_DONT_CARE)) {
-                    std::function<bool()> function = [=]() {
-                        SetImageMemoryValid(dev_data, GetImageState(dev_data, fb_info.image), false);
-                        return false;
-                    };
-                    cb_node->queue_submit_functions.push_back(function);
+                    DeferAttachmentMemoryValid(cb_node, fb_info.image, false);
                 } else if (FormatSpecificLoadAndStoreOpSettings(pAttachment->format, pAttachment->loadOp,
                                                                 pAttachment->stencilLoadOp, VK_ATTACHMENT_LOAD_OP_LOAD)) {
-                    std::function<bool()> function = [=]() {
-                        return ValidateImageMemoryIsValid(dev_data, GetImageState(dev_data, fb_info.image),
-                                                          "vkCmdBeginRenderPass()");
-                    };
-                    cb_node->queue_submit_functions.push_back(function);
+                    DeferAttachmentMemoryCheck(cb_node, fb_info.image, "vkCmdBeginRenderPass()");
                 }
                 if (render_pass_state->attachment_first_read[i]) {
-                    std::function<bool()> function = [=]() {
-                        return ValidateImageMemoryIsValid(dev_data, GetImageState(dev_data, fb_info.image),
-                                                          "vkCmdBeginRenderPass()");
-                    };
-                    cb_node->queue_submit_functions.push_back(function);
+                    DeferAttachmentMemoryCheck(cb_node, fb_info.image, "vkCmdBeginRenderPass()");
                 }
             }
             if (clear_op_size > pRenderPassBegin->clearValueCount) {
@@ -8092,7 +9150,7 @@ VKAPI_ATTR void VKAPI_CALL CmdBeginRenderPass(VkCommandBuffer commandBuffer, con
                                                         VALIDATION_ERROR_12000710);
             }
             skip |= insideRenderPass(dev_data, cb_node, "vkCmdBeginRenderPass()", VALIDATION_ERROR_17a00017);
-            skip |= ValidateDependencies(dev_data, framebuffer, render_pass_state);
+            skip |= ValidateFramebufferDependencies(dev_data, framebuffer, pRenderPassBegin->renderPass);
             skip |= validatePrimaryCommandBuffer(dev_data, cb_node, "vkCmdBeginRenderPass()", VALIDATION_ERROR_17a00019);
             skip |= ValidateCmdQueueFlags(dev_data, cb_node, "vkCmdBeginRenderPass()", VK_QUEUE_GRAPHICS_BIT,
                                           VALIDATION_ERROR_17a02415);
@@ -8106,7 +9164,7 @@ VKAPI_ATTR void VKAPI_CALL CmdBeginRenderPass(VkCommandBuffer commandBuffer, con
             // Connect this framebuffer and its children to this cmdBuffer
             AddFramebufferBinding(dev_data, cb_node, framebuffer);
             // Connect this RP to cmdBuffer
-            addCommandBufferBinding(&render_pass_state->cb_bindings,
+            addCommandBufferBinding(render_pass_state,
                                     {HandleToUint64(render_pass_state->renderPass), kVulkanObjectTypeRenderPass}, cb_node);
             // transition attachments to the correct layouts for beginning of renderPass and first subpass
             TransitionBeginRenderPassLayouts(dev_data, cb_node, render_pass_state, framebuffer);
@@ -8121,7 +9179,7 @@ VKAPI_ATTR void VKAPI_CALL CmdBeginRenderPass(VkCommandBuffer commandBuffer, con
 VKAPI_ATTR void VKAPI_CALL CmdNextSubpass(VkCommandBuffer commandBuffer, VkSubpassContents contents) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     GLOBAL_CB_NODE *pCB = GetCBNode(dev_data, commandBuffer);
     if (pCB) {
         skip |= validatePrimaryCommandBuffer(dev_data, pCB, "vkCmdNextSubpass()", VALIDATION_ERROR_1b600019);
@@ -8155,7 +9213,7 @@ VKAPI_ATTR void VKAPI_CALL CmdNextSubpass(VkCommandBuffer commandBuffer, VkSubpa
 VKAPI_ATTR void VKAPI_CALL CmdEndRenderPass(VkCommandBuffer commandBuffer) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
-    unique_lock_t lock(global_lock);
+    record_lock_t lock(dev_data, commandBuffer);
     auto pCB = GetCBNode(dev_data, commandBuffer);
     FRAMEBUFFER_STATE *framebuffer = NULL;
     if (pCB) {
@@ -8174,18 +9232,10 @@ VKAPI_ATTR void VKAPI_CALL CmdEndRenderPass(VkCommandBuffer commandBuffer) {
                 auto pAttachment = &rp_state->createInfo.pAttachments[i];
                 if (FormatSpecificLoadAndStoreOpSettings(pAttachment->format, pAttachment->storeOp, pAttachment->stencilStoreOp,
                                                          VK_ATTACHMENT_STORE_OP_STORE)) {
-                    std::function<bool()> function = [=]() {
-                        SetImageMemoryValid(dev_data, GetImageState(dev_data, fb_info.image), true);
-                        return false;
-                    };
-                    pCB->queue_submit_functions.push_back(function);
+                    DeferAttachmentMemoryValid(pCB, fb_info.image, true);
                 } else if (FormatSpecificLoadAndStoreOpSettings(pAttachment->format, pAttachment->storeOp,
                                                                 pAttachment->stencilStoreOp, VK_ATTACHMENT_STORE_OP_DONT_CARE)) {
-                    std::function<bool()> function = [=]() {
-                        SetImageMemoryValid(dev_data, GetImageState(dev_data, fb_info.image), false);
-                        return false;
-                    };
-                    pCB->queue_submit_functions.push_back(function);
+                    DeferAttachmentMemoryValid(pCB, fb_info.image, false);
                 }
             }
         }
@@ -8295,6 +9345,7 @@ VKAPI_ATTR void VKAPI_CALL CmdExecuteCommands(VkCommandBuffer commandBuffer, uin
                                               const VkCommandBuffer *pCommandBuffers) {
     bool skip = false;
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
+    // Not a record_lock_t, this links the state of the secondary command buffers to pCB
     unique_lock_t lock(global_lock);
     GLOBAL_CB_NODE *pCB = GetCBNode(dev_data, commandBuffer);
     if (pCB) {
@@ -8333,8 +9384,8 @@ VKAPI_ATTR void VKAPI_CALL CmdExecuteCommands(VkCommandBuffer commandBuffer, uin
                             validateFramebuffer(dev_data, commandBuffer, pCB, pCommandBuffers[i], pSubCB, "vkCmdExecuteCommands()");
                         if (VK_NULL_HANDLE == pSubCB->activeFramebuffer) {
                             //  Inherit primary's activeFramebuffer and while running validate functions
-                            for (auto &function : pSubCB->cmd_execute_commands_functions) {
-                                skip |= function(pCB->activeFramebuffer);
+                            for (const auto &check : pSubCB->deferred_barrier_checks) {
+                                skip |= ValidateDeferredBarrierCheck(dev_data, pSubCB, pCB->activeFramebuffer, check);
                             }
                         }
                     }
@@ -8342,6 +9393,7 @@ VKAPI_ATTR void VKAPI_CALL CmdExecuteCommands(VkCommandBuffer commandBuffer, uin
             }
             // TODO(mlentine): Move more logic into this method
             skip |= validateSecondaryCommandBufferState(dev_data, pCB, pSubCB);
+            CheckDestroyedBindings(dev_data, pSubCB);
             skip |= validateCommandBufferState(dev_data, pSubCB, "vkCmdExecuteCommands()", 0, VALIDATION_ERROR_1b2000b2);
             if (!(pSubCB->beginInfo.flags & VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT)) {
                 if (pSubCB->in_use.load() || pCB->linkedCommandBuffers.count(pSubCB)) {
@@ -8377,6 +9429,8 @@ VKAPI_ATTR void VKAPI_CALL CmdExecuteCommands(VkCommandBuffer commandBuffer, uin
             }
             // TODO: separate validate from update! This is very tangled.
             // Propagate layout transitions to the primary cmd buffer
+            FlushDeferredDrawChecks(dev_data, pCB);
+            if (!pSubCB->imageLayoutMap.empty()) pCB->passed_descriptor_checks.clear();
             for (auto ilm_entry : pSubCB->imageLayoutMap) {
                 if (pCB->imageLayoutMap.find(ilm_entry.first) != pCB->imageLayoutMap.end()) {
                     pCB->imageLayoutMap[ilm_entry.first].layout = ilm_entry.second.layout;
@@ -8393,12 +9447,14 @@ VKAPI_ATTR void VKAPI_CALL CmdExecuteCommands(VkCommandBuffer commandBuffer, uin
             pSubCB->primaryCommandBuffer = pCB->commandBuffer;
             pCB->linkedCommandBuffers.insert(pSubCB);
             pSubCB->linkedCommandBuffers.insert(pCB);
-            for (auto &function : pSubCB->queryUpdates) {
-                pCB->queryUpdates.push_back(function);
-            }
-            for (auto &function : pSubCB->queue_submit_functions) {
-                pCB->queue_submit_functions.push_back(function);
+            // The events a secondary sets are left to its own submission
+            for (const auto &op : pSubCB->deferred_ops) {
+                if (op.type != CB_OP_SET_EVENT_STAGE_MASK && op.type != CB_OP_VALIDATE_EVENT_STAGE_MASK) {
+                    pCB->deferred_ops.push_back(op);
+                }
             }
+            pCB->deferred_storage_updates.insert(pCB->deferred_storage_updates.end(), pSubCB->deferred_storage_updates.begin(),
+                                                 pSubCB->deferred_storage_updates.end());
         }
         skip |= validatePrimaryCommandBuffer(dev_data, pCB, "vkCmdExecuteCommands()", VALIDATION_ERROR_1b200019);
         skip |=
@@ -8500,6 +9556,17 @@ static bool validateMemoryIsMapped(layer_data *dev_data, const char *funcName, u
     return skip;
 }
 
+// Get the part of the mapped range of mem_info that mem_range covers, as an offset from the start of the mapped range and a size
+static void GetMappedRangeOverlap(const DEVICE_MEM_INFO *mem_info, VkDeviceSize mapped_size, const VkMappedMemoryRange &mem_range,
+                                  VkDeviceSize *offset, VkDeviceSize *size) {
+    VkDeviceSize start = std::max(mem_range.offset, mem_info->mem_range.offset) - mem_info->mem_range.offset;
+    VkDeviceSize end = (mem_range.size == VK_WHOLE_SIZE) ? mapped_size : (mem_range.offset + mem_range.size - mem_info->mem_range.offset);
+    start = std::min(start, mapped_size);
+    end = std::max(start, std::min(end, mapped_size));
+    *offset = start;
+    *size = end - start;
+}
+
 static bool ValidateAndCopyNoncoherentMemoryToDriver(layer_data *dev_data, uint32_t mem_range_count,
                                                      const VkMappedMemoryRange *mem_ranges) {
     bool skip = false;
@@ -8511,23 +9578,23 @@ static bool ValidateAndCopyNoncoherentMemoryToDriver(layer_data *dev_data, uint3
                                         ? mem_info->mem_range.size
                                         : (mem_info->alloc_info.allocationSize - mem_info->mem_range.offset);
                 char *data = static_cast<char *>(mem_info->shadow_copy);
-                for (uint64_t j = 0; j < mem_info->shadow_pad_size; ++j) {
-                    if (data[j] != NoncoherentMemoryFillValue) {
-                        skip |= log_msg(
-                            dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_DEVICE_MEMORY_EXT,
-                            HandleToUint64(mem_ranges[i].memory), __LINE__, MEMTRACK_INVALID_MAP, "MEM",
-                            "Memory underflow was detected on mem obj 0x%" PRIxLEAST64, HandleToUint64(mem_ranges[i].memory));
-                    }
+                if (!IsGuardBandIntact(data, mem_info->shadow_pad_size)) {
+                    skip |= log_msg(
+                        dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_DEVICE_MEMORY_EXT,
+                        HandleToUint64(mem_ranges[i].memory), __LINE__, MEMTRACK_INVALID_MAP, "MEM",
+                        "Memory underflow was detected on mem obj 0x%" PRIxLEAST64, HandleToUint64(mem_ranges[i].memory));
                 }
-                for (uint64_t j = (size + mem_info->shadow_pad_size); j < (2 * mem_info->shadow_pad_size + size); ++j) {
-                    if (data[j] != NoncoherentMemoryFillValue) {
-                        skip |= log_msg(
-                            dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_DEVICE_MEMORY_EXT,
-                            HandleToUint64(mem_ranges[i].memory), __LINE__, MEMTRACK_INVALID_MAP, "MEM",
-                            "Memory overflow was detected on mem obj 0x%" PRIxLEAST64, HandleToUint64(mem_ranges[i].memory));
-                    }
+                if (!IsGuardBandIntact(data + mem_info->shadow_pad_size + size, mem_info->shadow_tail_pad_size)) {
+                    skip |= log_msg(
+                        dev_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_DEVICE_MEMORY_EXT,
+                        HandleToUint64(mem_ranges[i].memory), __LINE__, MEMTRACK_INVALID_MAP, "MEM",
+                        "Memory overflow was detected on mem obj 0x%" PRIxLEAST64, HandleToUint64(mem_ranges[i].memory));
                 }
-                memcpy(mem_info->p_driver_data, static_cast<void *>(data + mem_info->shadow_pad_size), (size_t)(size));
+                // Only the flushed range is made visible to the device
+                VkDeviceSize copy_offset, copy_size;
+                GetMappedRangeOverlap(mem_info, size, mem_ranges[i], &copy_offset, &copy_size);
+                memcpy(static_cast<char *>(mem_info->p_driver_data) + copy_offset, data + mem_info->shadow_pad_size + copy_offset,
+                       static_cast<size_t>(copy_size));
             }
         }
     }
@@ -8540,9 +9607,13 @@ static void CopyNoncoherentMemoryFromDriver(layer_data *dev_data, uint32_t mem_r
         if (mem_info && mem_info->shadow_copy) {
             VkDeviceSize size = (mem_info->mem_range.size != VK_WHOLE_SIZE)
                                     ? mem_info->mem_range.size
-                                    : (mem_info->alloc_info.allocationSize - mem_ranges[i].offset);
+                                    : (mem_info->alloc_info.allocationSize - mem_info->mem_range.offset);
+            // Only the invalidated range is made visible to the host
+            VkDeviceSize copy_offset, copy_size;
+            GetMappedRangeOverlap(mem_info, size, mem_ranges[i], &copy_offset, &copy_size);
             char *data = static_cast<char *>(mem_info->shadow_copy);
-            memcpy(data + mem_info->shadow_pad_size, mem_info->p_driver_data, (size_t)(size));
+            memcpy(data + mem_info->shadow_pad_size + copy_offset, static_cast<char *>(mem_info->p_driver_data) + copy_offset,
+                   static_cast<size_t>(copy_size));
         }
     }
 }
@@ -8806,31 +9877,22 @@ static void PostCallRecordQueueBindSparse(layer_data *dev_data, VkQueue queue, u
         const VkBindSparseInfo &bindInfo = pBindInfo[bindIdx];
         // Track objects tied to memory
         for (uint32_t j = 0; j < bindInfo.bufferBindCount; j++) {
-            for (uint32_t k = 0; k < bindInfo.pBufferBinds[j].bindCount; k++) {
-                auto sparse_binding = bindInfo.pBufferBinds[j].pBinds[k];
-                SetSparseMemBinding(dev_data, {sparse_binding.memory, sparse_binding.memoryOffset, sparse_binding.size},
-                                    HandleToUint64(bindInfo.pBufferBinds[j].buffer), kVulkanObjectTypeBuffer);
-            }
+            const VkSparseBufferMemoryBindInfo &buffer_binds = bindInfo.pBufferBinds[j];
+            RecordSparseMemoryBinds(dev_data, HandleToUint64(buffer_binds.buffer), kVulkanObjectTypeBuffer, buffer_binds.bindCount,
+                                    buffer_binds.pBinds);
         }
         for (uint32_t j = 0; j < bindInfo.imageOpaqueBindCount; j++) {
-            for (uint32_t k = 0; k < bindInfo.pImageOpaqueBinds[j].bindCount; k++) {
-                auto sparse_binding = bindInfo.pImageOpaqueBinds[j].pBinds[k];
-                SetSparseMemBinding(dev_data, {sparse_binding.memory, sparse_binding.memoryOffset, sparse_binding.size},
-                                    HandleToUint64(bindInfo.pImageOpaqueBinds[j].image), kVulkanObjectTypeImage);
-            }
+            const VkSparseImageOpaqueMemoryBindInfo &opaque_binds = bindInfo.pImageOpaqueBinds[j];
+            RecordSparseMemoryBinds(dev_data, HandleToUint64(opaque_binds.image), kVulkanObjectTypeImage, opaque_binds.bindCount,
+                                    opaque_binds.pBinds);
         }
         for (uint32_t j = 0; j < bindInfo.imageBindCount; j++) {
-            for (uint32_t k = 0; k < bindInfo.pImageBinds[j].bindCount; k++) {
-                auto sparse_binding = bindInfo.pImageBinds[j].pBinds[k];
-                // TODO: This size is broken for non-opaque bindings, need to update to comprehend full sparse binding data
-                VkDeviceSize size = sparse_binding.extent.depth * sparse_binding.extent.height * sparse_binding.extent.width * 4;
-                SetSparseMemBinding(dev_data, {sparse_binding.memory, sparse_binding.memoryOffset, size},
-                                    HandleToUint64(bindInfo.pImageBinds[j].image), kVulkanObjectTypeImage);
-            }
+            RecordSparseImageMemoryBinds(dev_data, bindInfo.pImageBinds[j]);
         }
 
-        std::vector<SEMAPHORE_WAIT> semaphore_waits;
-        std::vector<VkSemaphore> semaphore_signals;
+        auto &submission = pQueue->submissions.push_back();
+        auto &semaphore_waits = submission.waitSemaphores;
+        auto &semaphore_signals = submission.signalSemaphores;
         for (uint32_t i = 0; i < bindInfo.waitSemaphoreCount; ++i) {
             VkSemaphore semaphore = bindInfo.pWaitSemaphores[i];
             auto pSemaphore = GetSemaphoreNode(dev_data, semaphore);
@@ -8848,21 +9910,19 @@ static void PostCallRecordQueueBindSparse(layer_data *dev_data, VkQueue queue, u
             auto pSemaphore = GetSemaphoreNode(dev_data, semaphore);
             if (pSemaphore) {
                 pSemaphore->signaler.first = queue;
-                pSemaphore->signaler.second = pQueue->seq + pQueue->submissions.size() + 1;
+                pSemaphore->signaler.second = pQueue->seq + pQueue->submissions.size();  // Includes this submission
                 pSemaphore->signaled = true;
                 pSemaphore->in_use.fetch_add(1);
                 semaphore_signals.push_back(semaphore);
             }
         }
 
-        pQueue->submissions.emplace_back(std::vector<VkCommandBuffer>(), semaphore_waits, semaphore_signals,
-                                         bindIdx == bindInfoCount - 1 ? fence : VK_NULL_HANDLE);
+        submission.fence = bindIdx == bindInfoCount - 1 ? fence : VK_NULL_HANDLE;
     }
 
     if (pFence && !bindInfoCount) {
         // No work to do, just dropping a fence in the queue by itself.
-        pQueue->submissions.emplace_back(std::vector<VkCommandBuffer>(), std::vector<SEMAPHORE_WAIT>(), std::vector<VkSemaphore>(),
-                                         fence);
+        pQueue->submissions.push_back().fence = fence;
     }
 }
 
@@ -9329,6 +10389,16 @@ VKAPI_ATTR VkResult VKAPI_CALL QueuePresentKHR(VkQueue queue, const VkPresentInf
 
     lock_guard_t lock(global_lock);
     auto queue_state = GetQueueState(dev_data, queue);
+    if (dev_data->frame_single_cb_submits > kPerfHintSingleSubmitsPerFrame) {
+        LogPerfHint(dev_data, PERF_HINT_SUBMIT_PER_COMMAND_BUFFER, VK_DEBUG_REPORT_OBJECT_TYPE_QUEUE_EXT, HandleToUint64(queue),
+                    "Frame %" PRIu64 " made %u vkQueueSubmit() calls of a single command buffer. Each call has a fixed cost "
+                    "in the driver and kernel, often tens of microseconds; submit the command buffers of a frame together.",
+                    dev_data->frame_count, dev_data->frame_single_cb_submits);
+    }
+    dev_data->frame_single_cb_submits = 0;
+    dev_data->frame_count++;
+    dev_data->frame_validation_ns = 0;
+    RefreshCoreValidationOptions(dev_data->instance_data);
 
     for (uint32_t i = 0; i < pPresentInfo->waitSemaphoreCount; ++i) {
         auto pSemaphore = GetSemaphoreNode(dev_data, pPresentInfo->pWaitSemaphores[i]);
@@ -10339,6 +11409,12 @@ VKAPI_ATTR void VKAPI_CALL DebugReportMessageEXT(VkInstance instance, VkDebugRep
                                                  VkDebugReportObjectTypeEXT objType, uint64_t object, size_t location,
                                                  int32_t msgCode, const char *pLayerPrefix, const char *pMsg) {
     instance_layer_data *instance_data = GetLayerDataPtr(get_dispatch_key(instance), instance_layer_data_map);
+    if (pMsg && !strcmp(pMsg, "lunarg_core_validation.report_check_profiles")) {
+        lock_guard_t lock(global_lock);
+        for (auto &entry : layer_data_map) {
+            if (entry.second->instance_data == instance_data) ReportCheckProfiles(entry.second);
+        }
+    }
     instance_data->dispatch_table.DebugReportMessageEXT(instance, flags, objType, object, location, msgCode, pLayerPrefix, pMsg);
 }
 
@@ -10441,6 +11517,7 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateDescriptorUpdateTemplateKHR(VkDevice device
         safe_VkDescriptorUpdateTemplateCreateInfoKHR *local_create_info =
             new safe_VkDescriptorUpdateTemplateCreateInfoKHR(pCreateInfo);
         std::unique_ptr<TEMPLATE_STATE> template_state(new TEMPLATE_STATE(*pDescriptorUpdateTemplate, local_create_info));
+        cvdescriptorset::CompileUpdateTemplate(dev_data, template_state.get());
         dev_data->desc_template_map[*pDescriptorUpdateTemplate] = std::move(template_state);
     }
     return result;
@@ -10584,7 +11661,7 @@ VKAPI_ATTR VkResult VKAPI_CALL GetDisplayPlaneCapabilitiesKHR(VkPhysicalDevice p
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL DebugMarkerSetObjectNameEXT(VkDevice device, const VkDebugMarkerObjectNameInfoEXT *pNameInfo) {
-    std::unique_lock<std::mutex> lock(global_lock);
+    unique_lock_t lock(global_lock);
     layer_data *device_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
     if (pNameInfo->pObjectName) {
         device_data->report_data->debugObjectNameMap->insert(
@@ -10647,10 +11724,10 @@ static const std::unordered_map<std::string, void*> name_to_funcptr_map = {
     {"vkAcquireNextImageKHR", (void*)AcquireNextImageKHR},
     {"vkQueuePresentKHR", (void*)QueuePresentKHR},
     {"vkQueueSubmit", (void*)QueueSubmit},
-    {"vkWaitForFences", (void*)WaitForFences},
-    {"vkGetFenceStatus", (void*)GetFenceStatus},
-    {"vkQueueWaitIdle", (void*)QueueWaitIdle},
-    {"vkDeviceWaitIdle", (void*)DeviceWaitIdle},
+    {"vkWaitForFences", (void*)WaitForFences<true>},
+    {"vkGetFenceStatus", (void*)GetFenceStatus<true>},
+    {"vkQueueWaitIdle", (void*)QueueWaitIdle<true>},
+    {"vkDeviceWaitIdle", (void*)DeviceWaitIdle<true>},
     {"vkGetDeviceQueue", (void*)GetDeviceQueue},
     {"vkDestroyDevice", (void*)DestroyDevice},
     {"vkDestroyFence", (void*)DestroyFence},
@@ -10808,10 +11885,29 @@ static const std::unordered_map<std::string, void*> name_to_funcptr_map = {
     {"GetDisplayPlaneCapabilitiesKHR", (void*)GetDisplayPlaneCapabilitiesKHR},
 };
 
+// Entrypoints with an instantiation that leaves out checks the instance can disable, by VkValidationFlagsEXT. The ones in
+//  name_to_funcptr_map still look at the flag, GetInstanceProcAddr doesn't know the device.
+struct unchecked_entrypoint {
+    bool CHECK_DISABLED::*disabled;
+    void *function;
+};
+
+static const std::unordered_map<std::string, unchecked_entrypoint> unchecked_entrypoints = {
+    {"vkWaitForFences", {&CHECK_DISABLED::wait_for_fences, (void*)WaitForFences<false>}},
+    {"vkGetFenceStatus", {&CHECK_DISABLED::get_fence_state, (void*)GetFenceStatus<false>}},
+    {"vkQueueWaitIdle", {&CHECK_DISABLED::queue_wait_idle, (void*)QueueWaitIdle<false>}},
+    {"vkDeviceWaitIdle", {&CHECK_DISABLED::device_wait_idle, (void*)DeviceWaitIdle<false>}},
+};
+
 VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetDeviceProcAddr(VkDevice device, const char *funcName) {
     assert(device);
     layer_data *device_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
 
+    const auto &unchecked = unchecked_entrypoints.find(funcName);
+    if (unchecked != unchecked_entrypoints.end() && device_data->instance_data->disabled.*unchecked->second.disabled) {
+        return reinterpret_cast<PFN_vkVoidFunction>(unchecked->second.function);
+    }
+
     // Is API to be intercepted by this layer?
     const auto &item = name_to_funcptr_map.find(funcName);
     if (item != name_to_funcptr_map.end()) {
@@ -10848,6 +11944,9 @@ VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetPhysicalDeviceProcAddr(VkInstance in
 
 }  // namespace core_validation
 
+// In the combined validation layer combined_validation.cpp provides the loader-layer interface
+#ifndef VK_LAYER_COMBINED
+
 // loader-layer interface v0, just wrappers since there is only a layer
 
 VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceExtensionProperties(const char *pLayerName, uint32_t *pCount,
@@ -10907,3 +12006,5 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
 
     return VK_SUCCESS;
 }
+
+#endif  // VK_LAYER_COMBINED
@@ -129,15 +129,16 @@ class QUEUE_STATE {
     VkQueue queue;
     uint32_t queueFamilyIndex;
     std::unordered_map<VkEvent, VkPipelineStageFlags> eventToStageMap;
-    std::unordered_map<QueryObject, bool> queryToStateMap;  // 0 is unavailable, 1 is available
+    std::unordered_map<VkQueryPool, QueryStates> query_states;
 
     uint64_t seq;
-    std::deque<CB_SUBMISSION> submissions;
+    CB_SUBMISSION_RING submissions;
 };
 
 class QUERY_POOL_NODE : public BASE_NODE {
    public:
     VkQueryPoolCreateInfo createInfo;
+    QueryStates query_states;  // As of the last command buffer retired that set them
 };
 
 struct PHYSICAL_DEVICE_STATE {
@@ -161,6 +161,17 @@ enum DRAW_STATE_ERROR {
     DRAWSTATE_SWAPCHAIN_IMAGES_NOT_FOUND,
     DRAWSTATE_EXTENSION_NOT_ENABLED,
     DRAWSTATE_INVALID_IMAGE_SUBRANGE,
+    DRAWSTATE_CHECK_PROFILE,  // Report of the cost of validation functions, see lunarg_core_validation.profile_checks
+};
+// Performance hint codes, see lunarg_core_validation.perf_hints
+enum PERF_HINT {
+    PERF_HINT_LOAD_OP_LOAD_CLEARED,             // Attachment loaded, then cleared completely
+    PERF_HINT_REDUNDANT_BARRIER,                // Pipeline barrier right after another one
+    PERF_HINT_GENERAL_LAYOUT,                   // Image that isn't a storage image moved to VK_IMAGE_LAYOUT_GENERAL
+    PERF_HINT_SMALL_ALLOCATION,                 // vkAllocateMemory of less than kPerfHintSmallAllocationSize
+    PERF_HINT_SUBMIT_PER_COMMAND_BUFFER,        // Frames with many vkQueueSubmit calls of a single command buffer
+    PERF_HINT_DESCRIPTOR_POOL_RESET_PER_FRAME,  // Descriptor pool reset in every frame
+    PERF_HINT_COUNT,
 };
 
 // Shader Checker ERROR codes
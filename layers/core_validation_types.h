@@ -52,7 +52,10 @@
 #include "vk_layer_logging.h"
 #include "vk_object_types.h"
 #include "vk_extension_helper.h"
+#include "vk_timeline.h"
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <functional>
 #include <map>
 #include <string.h>
@@ -60,12 +63,16 @@
 #include <unordered_set>
 #include <vector>
 #include <memory>
+#include <mutex>
 #include <list>
+#include <set>
+#include <type_traits>
 
 // Fwd declarations
 namespace cvdescriptorset {
 class DescriptorSetLayout;
 class DescriptorSet;
+struct StorageUpdates;
 };
 
 struct GLOBAL_CB_NODE;
@@ -76,6 +83,154 @@ enum CALL_STATE {
     QUERY_DETAILS,  // Function called w/ a count to query details
 };
 
+// Memory for objects of type T, handed out from slabs of SLAB_SIZE objects. Freed objects are reused before a new slab
+//  is allocated, so creating and destroying many objects doesn't go to the heap each time, and live objects stay close
+//  together. Slabs are never freed.
+template <typename T, size_t SLAB_SIZE = 256>
+class ObjectSlabPool {
+   public:
+    void *Allocate() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_) {
+            Slot *slab = new Slot[SLAB_SIZE];
+            for (size_t i = 0; i < SLAB_SIZE; i++) {
+                slab[i].next = free_;
+                free_ = &slab[i];
+            }
+        }
+        Slot *slot = free_;
+        free_ = slot->next;
+        return slot;
+    }
+    void Free(void *object) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Slot *slot = static_cast<Slot *>(object);
+        slot->next = free_;
+        free_ = slot;
+    }
+
+   private:
+    union Slot {
+        Slot *next;
+        typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type storage;
+    };
+    std::mutex mutex_;
+    Slot *free_ = nullptr;
+};
+
+// Deriving T from SlabAllocated<T> makes new and delete of T use an ObjectSlabPool. The pool is shared by all devices
+//  and outlives them all.
+template <typename T>
+class SlabAllocated {
+   public:
+    static void *operator new(size_t size) {
+        if (size != sizeof(T)) return ::operator new(size);
+        return Pool().Allocate();
+    }
+    static void operator delete(void *object, size_t size) {
+        if (!object) return;
+        if (size != sizeof(T)) return ::operator delete(object);
+        Pool().Free(object);
+    }
+
+   private:
+    static ObjectSlabPool<T> &Pool() {
+        static ObjectSlabPool<T> *pool = new ObjectSlabPool<T>;
+        return *pool;
+    }
+};
+
+// Memory for the recording state of one command buffer, handed out in order from blocks that are kept when it is reset. Freeing
+//  memory does nothing and Reset() makes all of it available again, so recording into a command buffer that was recorded
+//  before doesn't go to the heap and resetting it doesn't free node by node. Must only be used by one thread at a time.
+class RecordingArena {
+   public:
+    RecordingArena() {}
+    RecordingArena(const RecordingArena &) = delete;
+    RecordingArena &operator=(const RecordingArena &) = delete;
+
+    void *Allocate(size_t size, size_t alignment) {
+        while (true) {
+            if (block_ < blocks_.size()) {
+                size_t offset = (used_ + alignment - 1) & ~(alignment - 1);
+                if (offset + size <= blocks_[block_].size) {
+                    used_ = offset + size;
+                    return blocks_[block_].data.get() + offset;
+                }
+                if (block_ + 1 < blocks_.size()) {
+                    ++block_;
+                    used_ = 0;
+                    continue;
+                }
+            }
+            blocks_.push_back(Block(size + alignment > kBlockSize ? size + alignment : kBlockSize));
+            block_ = blocks_.size() - 1;
+            used_ = 0;
+        }
+    }
+
+    // Everything allocated before is given back, the containers using it must have been emptied first
+    void Reset() {
+        block_ = 0;
+        used_ = 0;
+    }
+
+   private:
+    static const size_t kBlockSize = 4096;
+
+    struct Block {
+        explicit Block(size_t block_size) : data(new char[block_size]), size(block_size) {}
+        Block(Block &&other) : data(std::move(other.data)), size(other.size) {}
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+    std::vector<Block> blocks_;
+    size_t block_ = 0;
+    size_t used_ = 0;
+};
+
+// Standard allocator over a RecordingArena
+template <typename T>
+class RecordingArenaAllocator {
+   public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+    template <typename U>
+    struct rebind {
+        typedef RecordingArenaAllocator<U> other;
+    };
+
+    RecordingArenaAllocator(RecordingArena *arena) : arena_(arena) {}
+    template <typename U>
+    RecordingArenaAllocator(const RecordingArenaAllocator<U> &other) : arena_(other.arena_) {}
+
+    T *allocate(size_t n) { return static_cast<T *>(arena_->Allocate(n * sizeof(T), std::alignment_of<T>::value)); }
+    void deallocate(T *, size_t) {}
+
+    template <typename U>
+    bool operator==(const RecordingArenaAllocator<U> &other) const {
+        return arena_ == other.arena_;
+    }
+    template <typename U>
+    bool operator!=(const RecordingArenaAllocator<U> &other) const {
+        return arena_ != other.arena_;
+    }
+
+   private:
+    template <typename U>
+    friend class RecordingArenaAllocator;
+    RecordingArena *arena_;
+};
+
+template <typename T>
+using RecordingSet = std::unordered_set<T, std::hash<T>, std::equal_to<T>, RecordingArenaAllocator<T>>;
+template <typename K, typename V>
+using RecordingMap = std::unordered_map<K, V, std::hash<K>, std::equal_to<K>, RecordingArenaAllocator<std::pair<const K, V>>>;
+template <typename T>
+using RecordingVector = std::vector<T, RecordingArenaAllocator<T>>;
+
 class BASE_NODE {
    public:
     // Track when object is being used by an in-flight command buffer
@@ -85,8 +240,16 @@ class BASE_NODE {
     //  binding removed when command buffer is reset or destroyed
     // When an object is destroyed, any bound cbs are set to INVALID
     std::unordered_set<GLOBAL_CB_NODE *> cb_bindings;
+    // Command buffers recorded on different threads can bind this object at the same time, so bindings are added under
+    //  this lock. Everything else that touches cb_bindings holds global_lock exclusively.
+    std::mutex cb_bindings_lock;
 
     BASE_NODE() { in_use.store(0); };
+
+    void AddBoundCommandBuffer(GLOBAL_CB_NODE *cb_node) {
+        std::lock_guard<std::mutex> lock(cb_bindings_lock);
+        cb_bindings.insert(cb_node);
+    }
 };
 
 // Track command pools and their command buffers
@@ -142,9 +305,13 @@ struct DESCRIPTOR_POOL_STATE : BASE_NODE {
     uint32_t availableSets;  // Available descriptor sets in this pool
 
     safe_VkDescriptorPoolCreateInfo createInfo;
-    std::unordered_set<cvdescriptorset::DescriptorSet *> sets;  // Collection of all sets in this pool
+    std::vector<cvdescriptorset::DescriptorSet *> sets;         // Collection of all sets in this pool, see GetPoolIndex()
+    std::vector<cvdescriptorset::DescriptorSet *> free_sets;    // Sets freed or reset back to this pool, to be allocated again
     std::vector<uint32_t> maxDescriptorTypeCount;               // Max # of descriptors of each type in this pool
     std::vector<uint32_t> availableDescriptorTypeCount;         // Available # of descriptors of each type in this pool
+    // Frame this pool was last reset in and the number of consecutive frames it was reset in, for the performance hints
+    uint64_t last_reset_frame = 0;
+    uint32_t reset_frame_streak = 0;
 
     DESCRIPTOR_POOL_STATE(const VkDescriptorPool pool, const VkDescriptorPoolCreateInfo *pCreateInfo)
         : pool(pool),
@@ -170,18 +337,36 @@ struct MEM_BINDING {
     VkDeviceSize size;
 };
 
-inline bool operator==(MEM_BINDING a, MEM_BINDING b) NOEXCEPT { return a.mem == b.mem && a.offset == b.offset && a.size == b.size; }
+// Memory bound to a range of a sparse resource, from the range's start up to end
+struct SPARSE_RANGE_BINDING {
+    VkDeviceSize end;
+    VkDeviceMemory mem;
+    VkDeviceSize memory_offset;
+};
 
-namespace std {
-template <>
-struct hash<MEM_BINDING> {
-    size_t operator()(MEM_BINDING mb) const NOEXCEPT {
-        auto intermediate = hash<uint64_t>()(reinterpret_cast<uint64_t &>(mb.mem)) ^ hash<uint64_t>()(mb.offset);
-        return intermediate ^ hash<uint64_t>()(mb.size);
-    }
+// Subresource and offset of a region bound with VkSparseImageMemoryBind, ordered so that the regions of a subresource
+// are adjacent and sorted by z, then y, then x
+struct SPARSE_IMAGE_REGION {
+    VkImageAspectFlags aspect_mask;
+    uint32_t mip_level;
+    uint32_t array_layer;
+    int32_t z, y, x;
 };
+
+inline bool operator<(const SPARSE_IMAGE_REGION &a, const SPARSE_IMAGE_REGION &b) {
+    if (a.aspect_mask != b.aspect_mask) return a.aspect_mask < b.aspect_mask;
+    if (a.mip_level != b.mip_level) return a.mip_level < b.mip_level;
+    if (a.array_layer != b.array_layer) return a.array_layer < b.array_layer;
+    if (a.z != b.z) return a.z < b.z;
+    if (a.y != b.y) return a.y < b.y;
+    return a.x < b.x;
 }
 
+struct SPARSE_IMAGE_REGION_BINDING {
+    VkExtent3D extent;
+    VkDeviceMemory mem;
+};
+
 // Superclass for bindable object state (currently images and buffers)
 class BINDABLE : public BASE_NODE {
    public:
@@ -192,26 +377,28 @@ class BINDABLE : public BASE_NODE {
     VkMemoryRequirements requirements;
     // bool to track if memory requirements were checked
     bool memory_requirements_checked;
-    // Sparse binding data, initially just tracking MEM_BINDING per mem object
-    //  There's more data for sparse bindings so need better long-term solution
-    // TODO : Need to update solution to track all sparse binding data
-    std::unordered_set<MEM_BINDING> sparse_bindings;
-    BINDABLE() : sparse(false), binding{}, requirements{}, memory_requirements_checked(false), sparse_bindings{} {};
+    // Sparse binding data: the bound ranges of the resource by their start, with adjacent ranges of the same memory
+    // merged, and for sparse images the bound regions of each subresource. Unbinding removes them.
+    std::map<VkDeviceSize, SPARSE_RANGE_BINDING> sparse_ranges;
+    std::map<SPARSE_IMAGE_REGION, SPARSE_IMAGE_REGION_BINDING> sparse_image_regions;
+    // Number of sparse ranges and regions bound to each memory object
+    std::unordered_map<VkDeviceMemory, uint32_t> sparse_memory_refs;
+    BINDABLE() : sparse(false), binding{}, requirements{}, memory_requirements_checked(false) {};
     // Return unordered set of memory objects that are bound
     std::unordered_set<VkDeviceMemory> GetBoundMemory() {
         std::unordered_set<VkDeviceMemory> mem_set;
         if (!sparse) {
             mem_set.insert(binding.mem);
         } else {
-            for (auto sb : sparse_bindings) {
-                mem_set.insert(sb.mem);
+            for (auto &ref : sparse_memory_refs) {
+                mem_set.insert(ref.first);
             }
         }
         return mem_set;
     }
 };
 
-class BUFFER_STATE : public BINDABLE {
+class BUFFER_STATE : public BINDABLE, public SlabAllocated<BUFFER_STATE> {
    public:
     VkBuffer buffer;
     VkBufferCreateInfo createInfo;
@@ -239,7 +426,7 @@ class BUFFER_STATE : public BINDABLE {
     };
 };
 
-class BUFFER_VIEW_STATE : public BASE_NODE {
+class BUFFER_VIEW_STATE : public BASE_NODE, public SlabAllocated<BUFFER_VIEW_STATE> {
    public:
     VkBufferView buffer_view;
     VkBufferViewCreateInfo create_info;
@@ -247,14 +434,14 @@ class BUFFER_VIEW_STATE : public BASE_NODE {
     BUFFER_VIEW_STATE(const BUFFER_VIEW_STATE &rh_obj) = delete;
 };
 
-struct SAMPLER_STATE : public BASE_NODE {
+struct SAMPLER_STATE : public BASE_NODE, public SlabAllocated<SAMPLER_STATE> {
     VkSampler sampler;
     VkSamplerCreateInfo createInfo;
 
     SAMPLER_STATE(const VkSampler *ps, const VkSamplerCreateInfo *pci) : sampler(*ps), createInfo(*pci){};
 };
 
-class IMAGE_STATE : public BINDABLE {
+class IMAGE_STATE : public BINDABLE, public SlabAllocated<IMAGE_STATE> {
    public:
     VkImage image;
     VkImageCreateInfo createInfo;
@@ -287,7 +474,7 @@ class IMAGE_STATE : public BINDABLE {
     };
 };
 
-class IMAGE_VIEW_STATE : public BASE_NODE {
+class IMAGE_VIEW_STATE : public BASE_NODE, public SlabAllocated<IMAGE_VIEW_STATE> {
    public:
     VkImageView image_view;
     VkImageViewCreateInfo create_info;
@@ -314,33 +501,41 @@ struct MEMORY_RANGE {
 };
 
 // Data struct for tracking memory object
-struct DEVICE_MEM_INFO : public BASE_NODE {
+struct DEVICE_MEM_INFO : public BASE_NODE, public SlabAllocated<DEVICE_MEM_INFO> {
     void *object;       // Dispatchable object used to create this memory (device of swapchain)
     bool global_valid;  // If allocation is mapped, set to "true" to be picked up by subsequently bound ranges
     VkDeviceMemory mem;
     VkMemoryAllocateInfo alloc_info;
     std::unordered_set<VK_OBJECT> obj_bindings;               // objects bound to this memory
     std::unordered_map<uint64_t, MEMORY_RANGE> bound_ranges;  // Map of object to its binding range
+    // bound_ranges ordered by start, and the largest size any of them has had, to find the ranges near an address range
+    std::multimap<VkDeviceSize, MEMORY_RANGE *> bound_ranges_by_start;
+    VkDeviceSize max_bound_range_size;
     // Convenience vectors image/buff handles to speed up iterating over images or buffers independently
     std::unordered_set<uint64_t> bound_images;
     std::unordered_set<uint64_t> bound_buffers;
 
     MemRange mem_range;
-    void *shadow_copy_base;    // Base of layer's allocation for guard band, data, and alignment space
-    void *shadow_copy;         // Pointer to start of guard-band data before mapped region
-    uint64_t shadow_pad_size;  // Size of the guard-band data before and after actual data. It MUST be a
-                               // multiple of limits.minMemoryMapAlignment
-    void *p_driver_data;       // Pointer to application's actual memory
+    void *shadow_copy_base;         // Base of layer's allocation for guard band, data, and alignment space
+    size_t shadow_copy_size;        // Size of the allocation, in whole pages
+    void *shadow_copy;              // Pointer to start of guard-band data before mapped region
+    uint64_t shadow_pad_size;       // Size of the guard-band data before actual data, which starts aligned to
+                                    // limits.minMemoryMapAlignment plus the map offset's remainder
+    uint64_t shadow_tail_pad_size;  // Size of the guard-band data after actual data
+    void *p_driver_data;            // Pointer to application's actual memory
 
     DEVICE_MEM_INFO(void *disp_object, const VkDeviceMemory in_mem, const VkMemoryAllocateInfo *p_alloc_info)
         : object(disp_object),
           global_valid(false),
           mem(in_mem),
           alloc_info(*p_alloc_info),
+          max_bound_range_size(0),
           mem_range{},
           shadow_copy_base(0),
+          shadow_copy_size(0),
           shadow_copy(0),
           shadow_pad_size(0),
+          shadow_tail_pad_size(0),
           p_driver_data(0){};
 };
 
@@ -381,6 +576,9 @@ struct RENDER_PASS_STATE : public BASE_NODE {
     std::vector<DAGNode> subpassToNode;
     std::vector<int32_t> subpass_to_dependency_index;  // Map srcSubpass to its pDependency index (or -1 if none)
     std::unordered_map<uint32_t, bool> attachment_first_read;
+    // Input, color and depth/stencil references of each subpass, skipping VK_ATTACHMENT_UNUSED. Built once at create time
+    //  so that beginning a render pass and moving between subpasses only walks the attachments that are transitioned.
+    std::vector<std::vector<VkAttachmentReference>> subpass_attachment_refs;
 
     RENDER_PASS_STATE(VkRenderPassCreateInfo const *pCreateInfo) : createInfo(pCreateInfo) {}
 };
@@ -469,9 +667,21 @@ enum CBStatusFlagBits {
     // clang-format on
 };
 
+// Descriptors of one binding that a descriptor update template writes, descriptor i read from offset + i * stride in the data
+struct TEMPLATE_WRITE {
+    uint32_t binding;
+    uint32_t array_element;
+    uint32_t count;
+    VkDescriptorType type;
+    size_t offset;
+    size_t stride;
+};
+
 struct TEMPLATE_STATE {
     VkDescriptorUpdateTemplateKHR desc_update_template;
     safe_VkDescriptorUpdateTemplateCreateInfoKHR create_info;
+    // The writes of create_info split at binding boundaries, see cvdescriptorset::CompileUpdateTemplate()
+    std::vector<TEMPLATE_WRITE> writes;
 
     TEMPLATE_STATE(VkDescriptorUpdateTemplateKHR update_template, safe_VkDescriptorUpdateTemplateCreateInfoKHR *pCreateInfo)
         : desc_update_template(update_template), create_info(*pCreateInfo) {}
@@ -495,6 +705,42 @@ struct hash<QueryObject> {
     }
 };
 }
+
+// Availability of a query, as set by the commands that reset, end and write it
+enum QUERY_STATE : uint8_t {
+    QUERYSTATE_UNKNOWN,      // Not reset, ended or written
+    QUERYSTATE_UNAVAILABLE,  // Reset
+    QUERYSTATE_AVAILABLE,    // Ended or written
+};
+
+// The states of the queries of one pool, indexed by query, so ranges of queries are set and checked without hashing each one.
+//  Queries past the end are unknown.
+typedef std::vector<QUERY_STATE> QueryStates;
+
+inline QUERY_STATE GetQueryState(const QueryStates &states, uint32_t query) {
+    return query < states.size() ? states[query] : QUERYSTATE_UNKNOWN;
+}
+
+inline void SetQueryStates(QueryStates &states, uint32_t first_query, uint32_t query_count, QUERY_STATE state) {
+    if (states.size() < first_query + query_count) states.resize(first_query + query_count, QUERYSTATE_UNKNOWN);
+    std::fill(states.begin() + first_query, states.begin() + first_query + query_count, state);
+}
+
+// Copies the known states of src over dst
+inline void MergeQueryStates(QueryStates &dst, const QueryStates &src) {
+    if (dst.size() < src.size()) dst.resize(src.size(), QUERYSTATE_UNKNOWN);
+    for (size_t query = 0; query < src.size(); ++query) {
+        if (src[query] != QUERYSTATE_UNKNOWN) dst[query] = src[query];
+    }
+}
+
+// The events a command buffer had waited on when it reset a range of queries
+struct QueryResetEvents {
+    VkQueryPool pool;
+    uint32_t first_query;
+    uint32_t query_count;
+    std::vector<VkEvent> events;
+};
 struct DRAW_DATA {
     std::vector<VkBuffer> buffers;
 };
@@ -528,6 +774,221 @@ struct hash<ImageSubresourcePair> {
 };
 }
 
+// Image layouts keyed by ImageSubresourcePair, used like an unordered_map of them. The entries of an image are kept together in
+//  one array, with the whole-image entry first and then one entry per aspect mask, mip level and array layer, so finding an
+//  entry hashes just the image and the entries of an image are walked in order.
+template <typename NODE>
+class ImageLayoutMap {
+   public:
+    typedef std::pair<ImageSubresourcePair, NODE> value_type;
+
+   private:
+    struct ImageLayouts {
+        std::vector<VkImageAspectFlags> aspect_masks;
+        uint32_t mip_levels = 0;
+        uint32_t array_layers = 0;
+        // Entries whose image is VK_NULL_HANDLE are not in the map
+        std::vector<value_type> entries = std::vector<value_type>(1);
+        size_t count = 0;
+    };
+    typedef std::unordered_map<VkImage, ImageLayouts> ImageMap;
+
+    template <typename IMAGE_IT, typename VALUE>
+    class iterator_base {
+       public:
+        iterator_base(IMAGE_IT image, IMAGE_IT end, size_t index) : image_(image), end_(end), index_(index) { SkipUnused(); }
+        VALUE &operator*() const { return image_->second.entries[index_]; }
+        VALUE *operator->() const { return &image_->second.entries[index_]; }
+        iterator_base &operator++() {
+            ++index_;
+            SkipUnused();
+            return *this;
+        }
+        bool operator==(const iterator_base &rhs) const { return image_ == rhs.image_ && index_ == rhs.index_; }
+        bool operator!=(const iterator_base &rhs) const { return !(*this == rhs); }
+
+       private:
+        friend class ImageLayoutMap;
+        void SkipUnused() {
+            for (; image_ != end_; ++image_, index_ = 0) {
+                auto const &entries = image_->second.entries;
+                while (index_ < entries.size() && entries[index_].first.image == VK_NULL_HANDLE) ++index_;
+                if (index_ < entries.size()) return;
+            }
+        }
+
+        IMAGE_IT image_;
+        IMAGE_IT end_;
+        size_t index_;
+    };
+
+   public:
+    typedef iterator_base<typename ImageMap::iterator, value_type> iterator;
+    typedef iterator_base<typename ImageMap::const_iterator, const value_type> const_iterator;
+
+    iterator begin() { return iterator(images_.begin(), images_.end(), 0); }
+    iterator end() { return iterator(images_.end(), images_.end(), 0); }
+    const_iterator begin() const { return const_iterator(images_.begin(), images_.end(), 0); }
+    const_iterator end() const { return const_iterator(images_.end(), images_.end(), 0); }
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+    iterator find(const ImageSubresourcePair &key) {
+        auto image = images_.find(key.image);
+        size_t index;
+        if (image == images_.end() || !FindIndex(image->second, key, &index)) return end();
+        return iterator(image, images_.end(), index);
+    }
+
+    const_iterator find(const ImageSubresourcePair &key) const {
+        auto image = images_.find(key.image);
+        size_t index;
+        if (image == images_.end() || !FindIndex(image->second, key, &index)) return end();
+        return const_iterator(image, images_.end(), index);
+    }
+
+    NODE &operator[](const ImageSubresourcePair &key) {
+        auto &image = images_[key.image];
+        auto &entry = image.entries[AddIndex(image, key)];
+        if (entry.first.image == VK_NULL_HANDLE) {
+            entry = value_type(key, NODE());
+            image.count++;
+            count_++;
+        }
+        return entry.second;
+    }
+
+    void erase(iterator it) {
+        it->first.image = VK_NULL_HANDLE;
+        count_--;
+        if (--it.image_->second.count == 0) images_.erase(it.image_);
+    }
+
+    void erase(const ImageSubresourcePair &key) {
+        auto it = find(key);
+        if (it != end()) erase(it);
+    }
+
+    void clear() {
+        images_.clear();
+        count_ = 0;
+    }
+
+    // Calls fn(subresource, node) for each mip level and array layer of range in the single aspect `aspect` of image, where node is
+    //  the entry of the subresource or, if it has none, the whole-image entry. Subresources with neither are skipped. The image
+    //  is hashed once for the range instead of once per subresource. The level and layer counts of range must be resolved.
+    template <typename FN>
+    void ForEachInRange(VkImage image, VkImageAspectFlags aspect, const VkImageSubresourceRange &range, FN fn) const {
+        auto it = images_.find(image);
+        if (it == images_.end()) return;
+        auto const &layouts = it->second;
+        const NODE *whole = layouts.entries[0].first.image != VK_NULL_HANDLE ? &layouts.entries[0].second : nullptr;
+        auto const &masks = layouts.aspect_masks;
+        size_t aspect_index = std::find(masks.begin(), masks.end(), aspect) - masks.begin();
+        if (aspect_index == masks.size() && !whole) return;
+        for (uint32_t level = range.baseMipLevel; level < range.baseMipLevel + range.levelCount; ++level) {
+            for (uint32_t layer = range.baseArrayLayer; layer < range.baseArrayLayer + range.layerCount; ++layer) {
+                VkImageSubresource subresource = {aspect, level, layer};
+                const NODE *node = whole;
+                if (aspect_index < masks.size() && level < layouts.mip_levels && layer < layouts.array_layers) {
+                    auto const &entry = layouts.entries[SubresourceIndex(layouts, aspect_index, subresource)];
+                    if (entry.first.image != VK_NULL_HANDLE) node = &entry.second;
+                }
+                if (node) fn(subresource, *node);
+            }
+        }
+    }
+
+    // Calls fn(node, found) for each mip level and array layer of range in the single aspect `aspect` of image, adding an entry
+    //  for every subresource that has none. found is what ForEachInRange() would have passed before the entry was added: the
+    //  subresource's own entry (node itself), the whole-image entry or nullptr, in which case fn must fill in node.
+    template <typename FN>
+    void UpdateRange(VkImage image, VkImageAspectFlags aspect, const VkImageSubresourceRange &range, FN fn) {
+        if (range.levelCount == 0 || range.layerCount == 0) return;
+        auto &layouts = images_[image];
+        // Make room for the whole range up front, so entries don't move while fn holds them
+        ImageSubresourcePair last = {
+            image, true, {aspect, range.baseMipLevel + range.levelCount - 1, range.baseArrayLayer + range.layerCount - 1}};
+        AddIndex(layouts, last);
+        auto const &masks = layouts.aspect_masks;
+        size_t aspect_index = std::find(masks.begin(), masks.end(), aspect) - masks.begin();
+        const NODE *whole = layouts.entries[0].first.image != VK_NULL_HANDLE ? &layouts.entries[0].second : nullptr;
+        for (uint32_t level = range.baseMipLevel; level < range.baseMipLevel + range.levelCount; ++level) {
+            for (uint32_t layer = range.baseArrayLayer; layer < range.baseArrayLayer + range.layerCount; ++layer) {
+                VkImageSubresource subresource = {aspect, level, layer};
+                auto &entry = layouts.entries[SubresourceIndex(layouts, aspect_index, subresource)];
+                const NODE *found = whole;
+                if (entry.first.image != VK_NULL_HANDLE) {
+                    found = &entry.second;
+                } else {
+                    entry = value_type({image, true, subresource}, NODE());
+                    layouts.count++;
+                    count_++;
+                }
+                fn(entry.second, found);
+            }
+        }
+    }
+
+   private:
+    static size_t SubresourceIndex(const ImageLayouts &image, size_t aspect_index, const VkImageSubresource &subresource) {
+        return 1 + (aspect_index * image.mip_levels + subresource.mipLevel) * image.array_layers + subresource.arrayLayer;
+    }
+
+    static bool FindIndex(const ImageLayouts &image, const ImageSubresourcePair &key, size_t *index) {
+        if (!key.hasSubresource) {
+            *index = 0;
+        } else {
+            auto const &masks = image.aspect_masks;
+            auto aspect = std::find(masks.begin(), masks.end(), key.subresource.aspectMask);
+            if (aspect == masks.end() || key.subresource.mipLevel >= image.mip_levels ||
+                key.subresource.arrayLayer >= image.array_layers) {
+                return false;
+            }
+            *index = SubresourceIndex(image, aspect - masks.begin(), key.subresource);
+        }
+        return image.entries[*index].first.image != VK_NULL_HANDLE;
+    }
+
+    // Returns the index of the entry for key, making room for it if needed
+    static size_t AddIndex(ImageLayouts &image, const ImageSubresourcePair &key) {
+        if (!key.hasSubresource) return 0;
+        auto &masks = image.aspect_masks;
+        size_t aspect_index = std::find(masks.begin(), masks.end(), key.subresource.aspectMask) - masks.begin();
+        if (key.subresource.mipLevel >= image.mip_levels || key.subresource.arrayLayer >= image.array_layers) {
+            // Grow geometrically, as the subresources of an image are often added one at a time
+            ImageLayouts grown;
+            grown.aspect_masks = masks;
+            grown.mip_levels = image.mip_levels;
+            grown.array_layers = image.array_layers;
+            if (key.subresource.mipLevel >= grown.mip_levels) {
+                grown.mip_levels = std::max(key.subresource.mipLevel + 1, 2 * grown.mip_levels);
+            }
+            if (key.subresource.arrayLayer >= grown.array_layers) {
+                grown.array_layers = std::max(key.subresource.arrayLayer + 1, 2 * grown.array_layers);
+            }
+            grown.entries.resize(1 + masks.size() * grown.mip_levels * grown.array_layers);
+            grown.entries[0] = image.entries[0];
+            for (size_t i = 1; i < image.entries.size(); ++i) {
+                auto const &entry = image.entries[i];
+                if (entry.first.image == VK_NULL_HANDLE) continue;
+                size_t entry_aspect = (i - 1) / (image.mip_levels * image.array_layers);
+                grown.entries[SubresourceIndex(grown, entry_aspect, entry.first.subresource)] = entry;
+            }
+            grown.count = image.count;
+            image = std::move(grown);
+        }
+        if (aspect_index == masks.size()) {
+            masks.push_back(key.subresource.aspectMask);
+            image.entries.resize(1 + masks.size() * image.mip_levels * image.array_layers);
+        }
+        return SubresourceIndex(image, aspect_index, key.subresource);
+    }
+
+    ImageMap images_;
+    size_t count_ = 0;
+};
+
 // Store layouts and pushconstants for PipelineLayout
 struct PIPELINE_LAYOUT_NODE {
     VkPipelineLayout layout;
@@ -628,6 +1089,7 @@ struct LAST_BOUND_STATE {
     // Track each set that has been bound
     // Ordered bound set tracking where index is set# that given set is bound to
     std::vector<cvdescriptorset::DescriptorSet *> boundDescriptorSets;
+    // The sets pushed to each set index, kept by reset() to be reused by the next push
     std::vector<std::unique_ptr<cvdescriptorset::DescriptorSet>> push_descriptors;
     // one dynamic offset per dynamic descriptor bound to this CB
     std::vector<std::vector<uint32_t>> dynamicOffsets;
@@ -636,12 +1098,131 @@ struct LAST_BOUND_STATE {
         pipeline_state = nullptr;
         pipeline_layout.reset();
         boundDescriptorSets.clear();
-        push_descriptors.clear();
         dynamicOffsets.clear();
     }
 };
+// A descriptor set check of a draw or dispatch, kept to be run later when lunarg_core_validation.deferred_draw_validation is set,
+//  or to skip running it again once it passed
+struct DEFERRED_DESCRIPTOR_CHECK {
+    cvdescriptorset::DescriptorSet *descriptor_set;
+    std::map<uint32_t, descriptor_req> const *bindings;  // Points into the active_slots of the bound pipeline
+    std::vector<uint32_t> dynamic_offsets;
+    const char *function;
+
+    bool operator<(const DEFERRED_DESCRIPTOR_CHECK &rhs) const {
+        if (descriptor_set != rhs.descriptor_set) return descriptor_set < rhs.descriptor_set;
+        if (bindings != rhs.bindings) return bindings < rhs.bindings;
+        if (function != rhs.function) return function < rhs.function;
+        return dynamic_offsets < rhs.dynamic_offsets;
+    }
+};
+
+// What a CB_DEFERRED_OP does when the command buffer is submitted
+enum CB_DEFERRED_OP_TYPE : uint8_t {
+    CB_OP_SET_IMAGE_MEMORY_VALID,         // image_state, valid
+    CB_OP_SET_BUFFER_MEMORY_VALID,        // buffer_state, valid
+    CB_OP_CHECK_IMAGE_MEMORY_VALID,       // image_state, function
+    CB_OP_CHECK_BUFFER_MEMORY_VALID,      // buffer_state, function
+    CB_OP_SET_ATTACHMENT_MEMORY_VALID,    // image, valid. The framebuffer attachment's state is looked up at submit
+    CB_OP_CHECK_ATTACHMENT_MEMORY_VALID,  // image, function
+    CB_OP_MARK_STORAGE_WRITTEN,           // storage_updates, held by GLOBAL_CB_NODE::deferred_storage_updates
+    CB_OP_SET_EVENT_STAGE_MASK,           // event, stage_mask
+    CB_OP_VALIDATE_EVENT_STAGE_MASK,      // first and count of the events in GLOBAL_CB_NODE::events, stage_mask
+    CB_OP_SET_QUERY_STATE,                // command_buffer, query_pool, first, count, query_state
+    CB_OP_VALIDATE_QUERY,                 // command_buffer, query_pool, first, count
+};
+
+// State a command buffer recorded that is only updated or checked when it is submitted, in the order it was recorded. These
+//  are plain records, so queueing one doesn't allocate and running them is a single loop, see RunDeferredOps().
+struct CB_DEFERRED_OP {
+    CB_DEFERRED_OP_TYPE type;
+    bool valid;
+    uint32_t first;
+    uint32_t count;
+    union {
+        VkPipelineStageFlags stage_mask;
+        QUERY_STATE query_state;
+    };
+    union {
+        IMAGE_STATE *image_state;
+        BUFFER_STATE *buffer_state;
+        const cvdescriptorset::StorageUpdates *storage_updates;
+        VkImage image;
+        VkEvent event;
+        VkQueryPool query_pool;
+    };
+    union {
+        const char *function;
+        VkCommandBuffer command_buffer;  // The secondary that recorded a query op a primary runs
+    };
+};
+
+// An image barrier a secondary command buffer recorded inside a render pass without knowing the framebuffer. It is checked
+//  against the framebuffer of the primary when that executes it.
+struct CB_DEFERRED_BARRIER_CHECK {
+    const char *function;
+    VkRenderPass render_pass;
+    uint32_t active_subpass;
+    uint32_t barrier_index;
+    VkImageMemoryBarrier barrier;
+};
+
+// Validation functions whose cost is measured when lunarg_core_validation.profile_checks is set
+enum CHECK_PROFILE_ID {
+    CHECK_PROFILE_DRAW_STATE,
+    CHECK_PROFILE_DESCRIPTOR_SET_DRAW_STATE,
+    CHECK_PROFILE_PIPELINE_SHADER_STATE,
+    CHECK_PROFILE_CMD_BUF_IMAGE_LAYOUTS,
+    CHECK_PROFILE_PRIMARY_CMD_BUF_STATE,
+    CHECK_PROFILE_PIPELINE_BARRIER,
+    CHECK_PROFILE_COUNT
+};
+
+static const char *const check_profile_names[CHECK_PROFILE_COUNT] = {
+    "ValidateDrawState",
+    "DescriptorSet::ValidateDrawState",
+    "validate_and_capture_pipeline_shader_state",
+    "ValidateCmdBufImageLayouts",
+    "validatePrimaryCommandBufferState",
+    "PreCallValidateCmdPipelineBarrier",
+};
+
+// Calls and CPU time of a validation function. Each call is also counted in the bucket of its duration, bucket i holding
+//  the calls that took [2^i, 2^(i+1)) ns, which bounds the percentiles well enough to tell the costly checks apart.
+struct CHECK_PROFILE {
+    static const uint32_t bucket_count = 40;
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> total_ns;
+    std::atomic<uint64_t> buckets[bucket_count];
+
+    CHECK_PROFILE() { Reset(); }
+
+    void Add(uint64_t ns) {
+        calls.fetch_add(1, std::memory_order_relaxed);
+        total_ns.fetch_add(ns, std::memory_order_relaxed);
+        uint32_t bucket = 0;
+        while (bucket + 1 < bucket_count && (ns >> (bucket + 1))) bucket++;
+        buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+    // Duration in ns that at least the given fraction of the calls took no longer than
+    uint64_t Percentile(double fraction) const {
+        uint64_t const wanted = static_cast<uint64_t>(fraction * calls.load());
+        uint64_t count = 0;
+        for (uint32_t bucket = 0; bucket < bucket_count; bucket++) {
+            count += buckets[bucket].load();
+            if (count >= wanted) return 2ull << bucket;
+        }
+        return 2ull << (bucket_count - 1);
+    }
+    void Reset() {
+        calls = 0;
+        total_ns = 0;
+        for (auto &bucket : buckets) bucket = 0;
+    }
+};
+
 // Cmd Buffer Wrapper Struct - TODO : This desperately needs its own class
-struct GLOBAL_CB_NODE : public BASE_NODE {
+struct GLOBAL_CB_NODE : public BASE_NODE, public SlabAllocated<GLOBAL_CB_NODE> {
     VkCommandBuffer commandBuffer;
     VkCommandBufferAllocateInfo createInfo = {};
     VkCommandBufferBeginInfo beginInfo;
@@ -666,38 +1247,62 @@ struct GLOBAL_CB_NODE : public BASE_NODE {
     VkSubpassContents activeSubpassContents;
     uint32_t activeSubpass;
     VkFramebuffer activeFramebuffer;
-    std::unordered_set<VkFramebuffer> framebuffers;
+    // The Recording* containers below allocate from this, and start over empty when the command buffer is reset, see
+    //  ResetRecordingArena(). Anything added to them is gone after that.
+    RecordingArena recording_arena;
+    RecordingSet<VkFramebuffer> framebuffers{&recording_arena};
     // Unified data structs to track objects bound to this command buffer as well as object
     //  dependencies that have been broken : either destroyed objects, or updated descriptor sets
-    std::unordered_set<VK_OBJECT> object_bindings;
+    RecordingSet<VK_OBJECT> object_bindings{&recording_arena};
+    // Generation of destroyed_objects the images, buffers, their views and samplers were first bound at, and the generation
+    // the command buffer was checked against the destroyed objects up to
+    RecordingMap<VK_OBJECT, uint64_t> binding_generations{&recording_arena};
+    uint64_t destroyed_objects_checked;
     std::vector<VK_OBJECT> broken_bindings;
 
-    std::unordered_set<VkEvent> waitedEvents;
+    RecordingSet<VkEvent> waitedEvents{&recording_arena};
     std::vector<VkEvent> writeEventsBeforeWait;
     std::vector<VkEvent> events;
-    std::unordered_map<QueryObject, std::unordered_set<VkEvent>> waitedEventsBeforeQueryReset;
-    std::unordered_map<QueryObject, bool> queryToStateMap;  // 0 is unavailable, 1 is available
-    std::unordered_set<QueryObject> activeQueries;
-    std::unordered_set<QueryObject> startedQueries;
-    std::unordered_map<ImageSubresourcePair, IMAGE_CMD_BUF_LAYOUT_NODE> imageLayoutMap;
-    std::unordered_map<VkEvent, VkPipelineStageFlags> eventToStageMap;
+    std::vector<QueryResetEvents> waitedEventsBeforeQueryReset;  // In the order the resets were recorded
+    RecordingMap<VkQueryPool, QueryStates> query_states{&recording_arena};
+    RecordingSet<QueryObject> activeQueries{&recording_arena};
+    RecordingSet<QueryObject> startedQueries{&recording_arena};
+    ImageLayoutMap<IMAGE_CMD_BUF_LAYOUT_NODE> imageLayoutMap;
+    RecordingMap<VkEvent, VkPipelineStageFlags> eventToStageMap{&recording_arena};
     std::vector<DRAW_DATA> drawData;
     DRAW_DATA currentDrawData;
     bool vertex_buffer_used;  // Track for perf warning to make sure any bound vtx buffer used
     VkCommandBuffer primaryCommandBuffer;
-    // Track images and buffers that are updated by this CB at the point of a draw
-    std::unordered_set<VkImageView> updateImages;
-    std::unordered_set<VkBuffer> updateBuffers;
+    // Storage images and buffers of the draws since the last deferred op queued by something else. Their memory is marked
+    // as written at submit, and draws using the same lists again in the meantime don't queue them again.
+    std::vector<std::shared_ptr<const cvdescriptorset::StorageUpdates>> storage_updates;
+    size_t storage_updates_op_count;  // size of deferred_ops once storage_updates were last queued
     // If primary, the secondary command buffers we will call.
     // If secondary, the primary command buffers we will be called by.
     std::unordered_set<GLOBAL_CB_NODE *> linkedCommandBuffers;
-    // Validation functions run at primary CB queue submit time
-    std::vector<std::function<bool()>> queue_submit_functions;
-    // Validation functions run when secondary CB is executed in primary
-    std::vector<std::function<bool(VkFramebuffer)>> cmd_execute_commands_functions;
-    std::unordered_set<VkDeviceMemory> memObjs;
-    std::vector<std::function<bool(VkQueue)>> eventUpdates;
-    std::vector<std::function<bool(VkQueue)>> queryUpdates;
+    // Memory validity, event and query updates and checks run at primary CB queue submit time. A primary gets the ones of the
+    // secondaries it executes, except for their event updates.
+    RecordingVector<CB_DEFERRED_OP> deferred_ops{&recording_arena};
+    // The storage lists that CB_OP_MARK_STORAGE_WRITTEN ops point to
+    std::vector<std::shared_ptr<const cvdescriptorset::StorageUpdates>> deferred_storage_updates;
+    // Checks run when secondary CB is executed in primary
+    RecordingVector<CB_DEFERRED_BARRIER_CHECK> deferred_barrier_checks{&recording_arena};
+    RecordingSet<VkDeviceMemory> memObjs{&recording_arena};
+    // Descriptor set checks of draws and dispatches not run yet. They are run before the image layouts of the command buffer
+    //  change and when it is first submitted, or ended if secondary, so draws using the same sets are only checked once.
+    std::set<DEFERRED_DESCRIPTOR_CHECK> deferred_descriptor_checks;
+    bool deferred_checks_skip;  // Whether deferred checks that have been run found an error not yet reported to the caller
+    // Results of submit-time checks that passed, so resubmitting the command buffer doesn't repeat them. They are cleared
+    //  when it is reset, and anything destroyed or updated that it uses invalidates it.
+    bool resources_validated;
+    // Descriptor set checks of draws and dispatches that passed since imageLayoutMap last changed
+    std::set<DEFERRED_DESCRIPTOR_CHECK> passed_descriptor_checks;
+    uint64_t draw_sample_count;  // Draws and dispatches recorded, for lunarg_core_validation.sample_draws
+    CMD_TYPE last_cmd;           // Last command recorded, set by ValidateCmd
+    uint64_t image_layouts_validated_generation;  // imageLayoutGeneration the initial layouts were checked against, 0 if none
+    std::vector<std::pair<ImageSubresourcePair, VkImageLayout>> validated_image_layouts;  // Final layouts of the images checked
+    // Held while recording into this command buffer, with global_lock held shared
+    std::mutex record_mutex;
 };
 
 struct SEMAPHORE_WAIT {
@@ -707,14 +1312,48 @@ struct SEMAPHORE_WAIT {
 };
 
 struct CB_SUBMISSION {
-    CB_SUBMISSION(std::vector<VkCommandBuffer> const &cbs, std::vector<SEMAPHORE_WAIT> const &waitSemaphores,
-                  std::vector<VkSemaphore> const &signalSemaphores, VkFence fence)
-        : cbs(cbs), waitSemaphores(waitSemaphores), signalSemaphores(signalSemaphores), fence(fence) {}
-
     std::vector<VkCommandBuffer> cbs;
     std::vector<SEMAPHORE_WAIT> waitSemaphores;
     std::vector<VkSemaphore> signalSemaphores;
-    VkFence fence;
+    VkFence fence = VK_NULL_HANDLE;
+};
+
+// The submissions of a queue not retired yet, oldest first. The slots of retired submissions are reused along with the space
+//  their vectors hold, so a steady stream of submissions doesn't allocate.
+class CB_SUBMISSION_RING {
+   public:
+    size_t size() const { return count_; }
+    CB_SUBMISSION &operator[](size_t index) { return slots_[(head_ + index) & (slots_.size() - 1)]; }
+    CB_SUBMISSION &front() { return (*this)[0]; }
+
+    void pop_front() {
+        head_ = (head_ + 1) & (slots_.size() - 1);
+        count_--;
+    }
+
+    // Add an empty submission at the end and return it
+    CB_SUBMISSION &push_back() {
+        if (count_ == slots_.size()) {
+            // Keep the slot count a power of two, oldest submission first
+            std::vector<CB_SUBMISSION> grown(std::max<size_t>(8, 2 * slots_.size()));
+            for (size_t i = 0; i < count_; ++i) {
+                grown[i] = std::move((*this)[i]);
+            }
+            slots_.swap(grown);
+            head_ = 0;
+        }
+        auto &submission = (*this)[count_++];
+        submission.cbs.clear();
+        submission.waitSemaphores.clear();
+        submission.signalSemaphores.clear();
+        submission.fence = VK_NULL_HANDLE;
+        return submission;
+    }
+
+   private:
+    std::vector<CB_SUBMISSION> slots_;
+    size_t head_ = 0;
+    size_t count_ = 0;
 };
 
 struct IMAGE_LAYOUT_NODE {
@@ -771,6 +1410,11 @@ public:
     safe_VkFramebufferCreateInfo createInfo;
     std::shared_ptr<RENDER_PASS_STATE> rp_state;
     std::vector<MT_FB_ATTACHMENT_INFO> attachments;
+    // Render passes whose subpass dependencies have already been validated against this framebuffer without error. Holding
+    //  the state keeps a destroyed render pass from being mistaken for a new one. Guarded by dependencies_lock, as render
+    //  passes may be begun on several threads at once.
+    std::mutex dependencies_lock;
+    std::vector<std::shared_ptr<RENDER_PASS_STATE>> dependencies_validated;
     FRAMEBUFFER_STATE(VkFramebuffer fb, const VkFramebufferCreateInfo *pCreateInfo, std::shared_ptr<RENDER_PASS_STATE> &&rpstate)
         : framebuffer(fb), createInfo(pCreateInfo), rp_state(rpstate){};
 };
@@ -802,9 +1446,10 @@ const VkPhysicalDeviceFeatures *GetEnabledFeatures(const layer_data *device_data
 const DeviceExtensions *GetEnabledExtensions(const layer_data *device_data);
 
 void invalidateCommandBuffers(const layer_data *, std::unordered_set<GLOBAL_CB_NODE *> const &, VK_OBJECT);
+void recordDestroyedObject(layer_data *, VK_OBJECT);
 bool ValidateMemoryIsBoundToBuffer(const layer_data *, const BUFFER_STATE *, const char *, UNIQUE_VALIDATION_ERROR_CODE);
 bool ValidateMemoryIsBoundToImage(const layer_data *, const IMAGE_STATE *, const char *, UNIQUE_VALIDATION_ERROR_CODE);
-void AddCommandBufferBindingSampler(GLOBAL_CB_NODE *, SAMPLER_STATE *);
+void AddCommandBufferBindingSampler(const layer_data *, GLOBAL_CB_NODE *, SAMPLER_STATE *);
 void AddCommandBufferBindingImage(const layer_data *, GLOBAL_CB_NODE *, IMAGE_STATE *);
 void AddCommandBufferBindingImageView(const layer_data *, GLOBAL_CB_NODE *, IMAGE_VIEW_STATE *);
 void AddCommandBufferBindingBuffer(const layer_data *, GLOBAL_CB_NODE *, BUFFER_STATE *);
@@ -821,6 +1466,7 @@ bool ValidateCmd(layer_data *my_data, const GLOBAL_CB_NODE *pCB, const CMD_TYPE
 bool insideRenderPass(const layer_data *my_data, const GLOBAL_CB_NODE *pCB, const char *apiName, UNIQUE_VALIDATION_ERROR_CODE msgCode);
 void SetImageMemoryValid(layer_data *dev_data, IMAGE_STATE *image_state, bool valid);
 bool outsideRenderPass(const layer_data *my_data, GLOBAL_CB_NODE *pCB, const char *apiName, UNIQUE_VALIDATION_ERROR_CODE msgCode);
+void FlushDeferredDrawChecks(layer_data *dev_data, GLOBAL_CB_NODE *cb_node);
 void SetLayout(GLOBAL_CB_NODE *pCB, ImageSubresourcePair imgpair, const IMAGE_CMD_BUF_LAYOUT_NODE &node);
 void SetLayout(GLOBAL_CB_NODE *pCB, ImageSubresourcePair imgpair, const VkImageLayout &layout);
 bool ValidateImageMemoryIsValid(layer_data *dev_data, IMAGE_STATE *image_state, const char *functionName);
@@ -829,6 +1475,10 @@ bool ValidateImageSampleCount(layer_data *dev_data, IMAGE_STATE *image_state, Vk
 bool rangesIntersect(layer_data const *dev_data, MEMORY_RANGE const *range1, VkDeviceSize offset, VkDeviceSize end);
 bool ValidateBufferMemoryIsValid(layer_data *dev_data, BUFFER_STATE *buffer_state, const char *functionName);
 void SetBufferMemoryValid(layer_data *dev_data, BUFFER_STATE *buffer_state, bool valid);
+void DeferImageMemoryValid(GLOBAL_CB_NODE *cb_node, IMAGE_STATE *image_state, bool valid);
+void DeferBufferMemoryValid(GLOBAL_CB_NODE *cb_node, BUFFER_STATE *buffer_state, bool valid);
+void DeferImageMemoryCheck(GLOBAL_CB_NODE *cb_node, IMAGE_STATE *image_state, const char *functionName);
+void DeferBufferMemoryCheck(GLOBAL_CB_NODE *cb_node, BUFFER_STATE *buffer_state, const char *functionName);
 bool ValidateCmdSubpassState(const layer_data *dev_data, const GLOBAL_CB_NODE *pCB, const CMD_TYPE cmd_type);
 
 
@@ -843,12 +1493,38 @@ const VkPhysicalDeviceProperties *GetPhysicalDeviceProperties(layer_data *);
 const CHECK_DISABLED *GetDisables(layer_data *);
 std::unordered_map<VkImage, std::unique_ptr<IMAGE_STATE>> *GetImageMap(core_validation::layer_data *);
 std::unordered_map<VkImage, std::vector<ImageSubresourcePair>> *GetImageSubresourceMap(layer_data *);
-std::unordered_map<ImageSubresourcePair, IMAGE_LAYOUT_NODE> *GetImageLayoutMap(layer_data *);
-std::unordered_map<ImageSubresourcePair, IMAGE_LAYOUT_NODE> const *GetImageLayoutMap(layer_data const *);
+ImageLayoutMap<IMAGE_LAYOUT_NODE> *GetImageLayoutMap(layer_data *);
+ImageLayoutMap<IMAGE_LAYOUT_NODE> const *GetImageLayoutMap(layer_data const *);
+uint64_t *GetImageLayoutGeneration(layer_data *);
+// Returns null unless lunarg_core_validation.profile_checks is set
+CHECK_PROFILE *GetCheckProfile(layer_data *, CHECK_PROFILE_ID);
 std::unordered_map<VkBuffer, std::unique_ptr<BUFFER_STATE>> *GetBufferMap(layer_data *device_data);
 std::unordered_map<VkBufferView, std::unique_ptr<BUFFER_VIEW_STATE>> *GetBufferViewMap(layer_data *device_data);
 std::unordered_map<VkImageView, std::unique_ptr<IMAGE_VIEW_STATE>> *GetImageViewMap(layer_data *device_data);
 const DeviceExtensions *GetDeviceExtensions(const layer_data *);
 }
 
+// Adds the time from its construction to its destruction to the profile of a check, when profiling, and records it as a zone
+//  named after the check, when the timeline is recording (see vk_timeline.h)
+class CheckProfileScope {
+   public:
+    CheckProfileScope(core_validation::layer_data *device_data, CHECK_PROFILE_ID id)
+        : profile_(core_validation::GetCheckProfile(device_data, id)),
+          id_(id),
+          timeline_(vk_timeline_enabled()),
+          start_((profile_ || timeline_) ? vk_timeline_now() : 0) {}
+    ~CheckProfileScope() {
+        if (!profile_ && !timeline_) return;
+        uint64_t const end = vk_timeline_now();
+        if (profile_) profile_->Add(end - start_);
+        if (timeline_) vk_timeline_zone("core_validation", check_profile_names[id_], start_, end);
+    }
+
+   private:
+    CHECK_PROFILE *profile_;
+    CHECK_PROFILE_ID id_;
+    bool timeline_;
+    uint64_t start_;
+};
+
 #endif  // CORE_VALIDATION_TYPES_H_
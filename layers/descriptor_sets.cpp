@@ -28,17 +28,11 @@
 #include <sstream>
 #include <algorithm>
 
-// Construct DescriptorSetLayout instance from given create info
-cvdescriptorset::DescriptorSetLayout::DescriptorSetLayout(const VkDescriptorSetLayoutCreateInfo *p_create_info,
-                                                          const VkDescriptorSetLayout layout)
-    : layout_(layout),
-      flags_(p_create_info->flags),
-      binding_count_(p_create_info->bindingCount),
-      descriptor_count_(0),
-      dynamic_descriptor_count_(0) {
-    // Dyn array indicies are ordered by binding # and array index of any array within the binding
-    //  so we store up bindings w/ count in ordered map in order to create dyn array mappings below
-    std::map<uint32_t, uint32_t> binding_to_dyn_count;
+const uint32_t cvdescriptorset::DescriptorSetLayoutDef::invalid_index;
+
+// Construct DescriptorSetLayoutDef instance from given create info
+cvdescriptorset::DescriptorSetLayoutDef::DescriptorSetLayoutDef(const VkDescriptorSetLayoutCreateInfo *p_create_info)
+    : flags_(p_create_info->flags), binding_count_(p_create_info->bindingCount), descriptor_count_(0), dynamic_descriptor_count_(0) {
     for (uint32_t i = 0; i < binding_count_; ++i) {
         auto binding_num = p_create_info->pBindings[i].binding;
         descriptor_count_ += p_create_info->pBindings[i].descriptorCount;
@@ -62,31 +56,94 @@ cvdescriptorset::DescriptorSetLayout::DescriptorSetLayout(const VkDescriptorSetL
              (p_create_info->pBindings[i].descriptorType != VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER))) {
             bindings_[insert_index].pImmutableSamplers = nullptr;
         }
-        if (p_create_info->pBindings[i].descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC ||
-            p_create_info->pBindings[i].descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC) {
-            binding_to_dyn_count[p_create_info->pBindings[i].binding] = p_create_info->pBindings[i].descriptorCount;
-            dynamic_descriptor_count_ += p_create_info->pBindings[i].descriptorCount;
-        }
     }
     assert(bindings_.size() == binding_count_);
+    // Vector order is finalized so create the binding# lookup. Bindings are small dense integers in
+    //  practice, the table only gives way to a map when it would be mostly gaps.
+    uint32_t max_binding = bindings_.empty() ? 0 : bindings_.back().binding;
+    bool sparse = !bindings_.empty() && max_binding >= 4 * binding_count_ + 64;
+    if (!sparse && !bindings_.empty()) {
+        binding_to_index_.assign(max_binding + 1, invalid_index);
+    }
+    // Dyn array indicies are ordered by binding # and array index of any array within the binding, which is the vector order
     uint32_t global_index = 0;
-    // Vector order is finalized so create maps of bindings to indices
+    global_start_index_.resize(binding_count_);
+    dynamic_offset_index_.resize(binding_count_, -1);
+    hash_ = std::hash<uint32_t>()(flags_);
     for (uint32_t i = 0; i < binding_count_; ++i) {
         auto binding_num = bindings_[i].binding;
-        binding_to_index_map_[binding_num] = i;
-        binding_to_global_start_index_map_[binding_num] = global_index;
-        global_index += bindings_[i].descriptorCount ? bindings_[i].descriptorCount - 1 : 0;
-        binding_to_global_end_index_map_[binding_num] = global_index;
-        global_index += bindings_[i].descriptorCount ? 1 : 0;
+        if (sparse) {
+            sparse_binding_to_index_map_[binding_num] = i;
+        } else {
+            binding_to_index_[binding_num] = i;
+        }
+        global_start_index_[i] = global_index;
+        global_index += bindings_[i].descriptorCount;
+        if (bindings_[i].descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC ||
+            bindings_[i].descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC) {
+            dynamic_offset_index_[i] = static_cast<int32_t>(dynamic_descriptor_count_);
+            dynamic_descriptor_count_ += bindings_[i].descriptorCount;
+        }
+        hash_ = hash_ * 31 + std::hash<uint32_t>()(binding_num);
+        hash_ = hash_ * 31 + std::hash<uint32_t>()(bindings_[i].descriptorType);
+        hash_ = hash_ * 31 + std::hash<uint32_t>()(bindings_[i].descriptorCount);
+        hash_ = hash_ * 31 + std::hash<uint32_t>()(bindings_[i].stageFlags);
+        if (bindings_[i].pImmutableSamplers) {
+            for (uint32_t j = 0; j < bindings_[i].descriptorCount; ++j) {
+                hash_ = hash_ * 31 + std::hash<uint64_t>()(HandleToUint64(bindings_[i].pImmutableSamplers[j]));
+            }
+        }
+    }
+}
+
+bool cvdescriptorset::DescriptorSetLayoutDef::operator==(const DescriptorSetLayoutDef &rh) const {
+    if (hash_ != rh.hash_ || flags_ != rh.flags_ || binding_count_ != rh.binding_count_) return false;
+    for (uint32_t i = 0; i < binding_count_; ++i) {
+        const auto &binding = bindings_[i];
+        const auto &rh_binding = rh.bindings_[i];
+        if (binding.binding != rh_binding.binding || binding.descriptorType != rh_binding.descriptorType ||
+            binding.descriptorCount != rh_binding.descriptorCount || binding.stageFlags != rh_binding.stageFlags ||
+            (binding.pImmutableSamplers == nullptr) != (rh_binding.pImmutableSamplers == nullptr)) {
+            return false;
+        }
+        if (binding.pImmutableSamplers &&
+            !std::equal(binding.pImmutableSamplers, binding.pImmutableSamplers + binding.descriptorCount,
+                        rh_binding.pImmutableSamplers)) {
+            return false;
+        }
     }
-    // Now create dyn offset array mapping for any dynamic descriptors
-    uint32_t dyn_array_idx = 0;
-    for (const auto &bc_pair : binding_to_dyn_count) {
-        binding_to_dynamic_array_idx_map_[bc_pair.first] = dyn_array_idx;
-        dyn_array_idx += bc_pair.second;
+    return true;
+}
+
+// Definitions of the live layouts by hash, shared by all devices
+static std::unordered_map<size_t, std::vector<std::weak_ptr<cvdescriptorset::DescriptorSetLayoutDef const>>> layout_def_dict;
+static std::mutex layout_def_dict_mutex;
+
+std::shared_ptr<cvdescriptorset::DescriptorSetLayoutDef const> cvdescriptorset::DescriptorSetLayoutDef::Get(
+    const VkDescriptorSetLayoutCreateInfo *p_create_info) {
+    auto layout_def = std::make_shared<DescriptorSetLayoutDef const>(p_create_info);
+    std::lock_guard<std::mutex> lock(layout_def_dict_mutex);
+    auto &defs = layout_def_dict[layout_def->GetHash()];
+    // Forget the definitions of destroyed layouts with this hash while looking for a match
+    for (auto it = defs.begin(); it != defs.end();) {
+        auto def = it->lock();
+        if (!def) {
+            it = defs.erase(it);
+        } else if (*def == *layout_def) {
+            return def;
+        } else {
+            ++it;
+        }
     }
+    defs.push_back(layout_def);
+    return layout_def;
 }
 
+// Construct DescriptorSetLayout instance from given create info
+cvdescriptorset::DescriptorSetLayout::DescriptorSetLayout(const VkDescriptorSetLayoutCreateInfo *p_create_info,
+                                                          const VkDescriptorSetLayout layout)
+    : layout_(layout), layout_def_(DescriptorSetLayoutDef::Get(p_create_info)) {}
+
 // Validate descriptor set layout create info
 bool cvdescriptorset::DescriptorSetLayout::ValidateCreateInfo(debug_report_data *report_data,
                                                               const VkDescriptorSetLayoutCreateInfo *create_info) {
@@ -103,103 +160,105 @@ bool cvdescriptorset::DescriptorSetLayout::ValidateCreateInfo(debug_report_data
 }
 
 // put all bindings into the given set
-void cvdescriptorset::DescriptorSetLayout::FillBindingSet(std::unordered_set<uint32_t> *binding_set) const {
-    for (auto binding_index_pair : binding_to_index_map_) binding_set->insert(binding_index_pair.first);
+void cvdescriptorset::DescriptorSetLayoutDef::FillBindingSet(std::unordered_set<uint32_t> *binding_set) const {
+    for (const auto &binding : bindings_) binding_set->insert(binding.binding);
 }
 
-VkDescriptorSetLayoutBinding const *cvdescriptorset::DescriptorSetLayout::GetDescriptorSetLayoutBindingPtrFromBinding(
+VkDescriptorSetLayoutBinding const *cvdescriptorset::DescriptorSetLayoutDef::GetDescriptorSetLayoutBindingPtrFromBinding(
     const uint32_t binding) const {
-    const auto &bi_itr = binding_to_index_map_.find(binding);
-    if (bi_itr != binding_to_index_map_.end()) {
-        return bindings_[bi_itr->second].ptr();
+    uint32_t index = GetIndexFromBinding(binding);
+    if (index != invalid_index) {
+        return bindings_[index].ptr();
     }
     return nullptr;
 }
-VkDescriptorSetLayoutBinding const *cvdescriptorset::DescriptorSetLayout::GetDescriptorSetLayoutBindingPtrFromIndex(
+VkDescriptorSetLayoutBinding const *cvdescriptorset::DescriptorSetLayoutDef::GetDescriptorSetLayoutBindingPtrFromIndex(
     const uint32_t index) const {
     if (index >= bindings_.size()) return nullptr;
     return bindings_[index].ptr();
 }
 // Return descriptorCount for given binding, 0 if index is unavailable
-uint32_t cvdescriptorset::DescriptorSetLayout::GetDescriptorCountFromBinding(const uint32_t binding) const {
-    const auto &bi_itr = binding_to_index_map_.find(binding);
-    if (bi_itr != binding_to_index_map_.end()) {
-        return bindings_[bi_itr->second].descriptorCount;
+uint32_t cvdescriptorset::DescriptorSetLayoutDef::GetDescriptorCountFromBinding(const uint32_t binding) const {
+    uint32_t index = GetIndexFromBinding(binding);
+    if (index != invalid_index) {
+        return bindings_[index].descriptorCount;
     }
     return 0;
 }
 // Return descriptorCount for given index, 0 if index is unavailable
-uint32_t cvdescriptorset::DescriptorSetLayout::GetDescriptorCountFromIndex(const uint32_t index) const {
+uint32_t cvdescriptorset::DescriptorSetLayoutDef::GetDescriptorCountFromIndex(const uint32_t index) const {
     if (index >= bindings_.size()) return 0;
     return bindings_[index].descriptorCount;
 }
 // For the given binding, return descriptorType
-VkDescriptorType cvdescriptorset::DescriptorSetLayout::GetTypeFromBinding(const uint32_t binding) const {
-    assert(binding_to_index_map_.count(binding));
-    const auto &bi_itr = binding_to_index_map_.find(binding);
-    if (bi_itr != binding_to_index_map_.end()) {
-        return bindings_[bi_itr->second].descriptorType;
+VkDescriptorType cvdescriptorset::DescriptorSetLayoutDef::GetTypeFromBinding(const uint32_t binding) const {
+    uint32_t index = GetIndexFromBinding(binding);
+    assert(index != invalid_index);
+    if (index != invalid_index) {
+        return bindings_[index].descriptorType;
     }
     return VK_DESCRIPTOR_TYPE_MAX_ENUM;
 }
 // For the given index, return descriptorType
-VkDescriptorType cvdescriptorset::DescriptorSetLayout::GetTypeFromIndex(const uint32_t index) const {
+VkDescriptorType cvdescriptorset::DescriptorSetLayoutDef::GetTypeFromIndex(const uint32_t index) const {
     assert(index < bindings_.size());
     return bindings_[index].descriptorType;
 }
 // For the given global index, return descriptorType
-//  Currently just counting up through bindings_, may improve this in future
-VkDescriptorType cvdescriptorset::DescriptorSetLayout::GetTypeFromGlobalIndex(const uint32_t index) const {
-    uint32_t global_offset = 0;
-    for (auto binding : bindings_) {
-        global_offset += binding.descriptorCount;
-        if (index < global_offset) return binding.descriptorType;
+VkDescriptorType cvdescriptorset::DescriptorSetLayoutDef::GetTypeFromGlobalIndex(const uint32_t index) const {
+    // The last binding with descriptors starting at or before the index holds it
+    auto it = std::upper_bound(global_start_index_.begin(), global_start_index_.end(), index);
+    while (index < descriptor_count_ && it != global_start_index_.begin()) {
+        --it;
+        auto binding_index = it - global_start_index_.begin();
+        if (bindings_[binding_index].descriptorCount) return bindings_[binding_index].descriptorType;
     }
     assert(0);  // requested global index is out of bounds
     return VK_DESCRIPTOR_TYPE_MAX_ENUM;
 }
 // For the given binding, return stageFlags
-VkShaderStageFlags cvdescriptorset::DescriptorSetLayout::GetStageFlagsFromBinding(const uint32_t binding) const {
-    assert(binding_to_index_map_.count(binding));
-    const auto &bi_itr = binding_to_index_map_.find(binding);
-    if (bi_itr != binding_to_index_map_.end()) {
-        return bindings_[bi_itr->second].stageFlags;
+VkShaderStageFlags cvdescriptorset::DescriptorSetLayoutDef::GetStageFlagsFromBinding(const uint32_t binding) const {
+    uint32_t index = GetIndexFromBinding(binding);
+    assert(index != invalid_index);
+    if (index != invalid_index) {
+        return bindings_[index].stageFlags;
     }
     return VkShaderStageFlags(0);
 }
 // For the given binding, return start index
-uint32_t cvdescriptorset::DescriptorSetLayout::GetGlobalStartIndexFromBinding(const uint32_t binding) const {
-    assert(binding_to_global_start_index_map_.count(binding));
-    const auto &btgsi_itr = binding_to_global_start_index_map_.find(binding);
-    if (btgsi_itr != binding_to_global_start_index_map_.end()) {
-        return btgsi_itr->second;
+uint32_t cvdescriptorset::DescriptorSetLayoutDef::GetGlobalStartIndexFromBinding(const uint32_t binding) const {
+    uint32_t index = GetIndexFromBinding(binding);
+    assert(index != invalid_index);
+    if (index != invalid_index) {
+        return global_start_index_[index];
     }
     // In error case max uint32_t so index is out of bounds to break ASAP
     assert(0);
     return 0xFFFFFFFF;
 }
 // For the given binding, return end index
-uint32_t cvdescriptorset::DescriptorSetLayout::GetGlobalEndIndexFromBinding(const uint32_t binding) const {
-    assert(binding_to_global_end_index_map_.count(binding));
-    const auto &btgei_itr = binding_to_global_end_index_map_.find(binding);
-    if (btgei_itr != binding_to_global_end_index_map_.end()) {
-        return btgei_itr->second;
+uint32_t cvdescriptorset::DescriptorSetLayoutDef::GetGlobalEndIndexFromBinding(const uint32_t binding) const {
+    uint32_t index = GetIndexFromBinding(binding);
+    assert(index != invalid_index);
+    if (index != invalid_index) {
+        uint32_t count = bindings_[index].descriptorCount;
+        return global_start_index_[index] + (count ? count - 1 : 0);
     }
     // In error case max uint32_t so index is out of bounds to break ASAP
     assert(0);
     return 0xFFFFFFFF;
 }
 // For given binding, return ptr to ImmutableSampler array
-VkSampler const *cvdescriptorset::DescriptorSetLayout::GetImmutableSamplerPtrFromBinding(const uint32_t binding) const {
-    assert(binding_to_index_map_.count(binding));
-    const auto &bi_itr = binding_to_index_map_.find(binding);
-    if (bi_itr != binding_to_index_map_.end()) {
-        return bindings_[bi_itr->second].pImmutableSamplers;
+VkSampler const *cvdescriptorset::DescriptorSetLayoutDef::GetImmutableSamplerPtrFromBinding(const uint32_t binding) const {
+    uint32_t index = GetIndexFromBinding(binding);
+    assert(index != invalid_index);
+    if (index != invalid_index) {
+        return bindings_[index].pImmutableSamplers;
     }
     return nullptr;
 }
 // Move to next valid binding having a non-zero binding count
-uint32_t cvdescriptorset::DescriptorSetLayout::GetNextValidBinding(const uint32_t binding) const {
+uint32_t cvdescriptorset::DescriptorSetLayoutDef::GetNextValidBinding(const uint32_t binding) const {
     uint32_t new_binding = binding;
     do {
         new_binding++;
@@ -207,7 +266,7 @@ uint32_t cvdescriptorset::DescriptorSetLayout::GetNextValidBinding(const uint32_
     return new_binding;
 }
 // For given index, return ptr to ImmutableSampler array
-VkSampler const *cvdescriptorset::DescriptorSetLayout::GetImmutableSamplerPtrFromIndex(const uint32_t index) const {
+VkSampler const *cvdescriptorset::DescriptorSetLayoutDef::GetImmutableSamplerPtrFromIndex(const uint32_t index) const {
     assert(index < bindings_.size());
     return bindings_[index].pImmutableSamplers;
 }
@@ -215,19 +274,21 @@ VkSampler const *cvdescriptorset::DescriptorSetLayout::GetImmutableSamplerPtrFro
 //  else return false and fill in error_msg will description of what causes incompatibility
 bool cvdescriptorset::DescriptorSetLayout::IsCompatible(DescriptorSetLayout const *const rh_ds_layout,
                                                         std::string *error_msg) const {
-    // Trivial case
-    if (layout_ == rh_ds_layout->GetDescriptorSetLayout()) return true;
-    if (descriptor_count_ != rh_ds_layout->descriptor_count_) {
+    // Trivial case, which includes layouts created alike as they share their definition
+    if (layout_ == rh_ds_layout->GetDescriptorSetLayout() || layout_def_ == rh_ds_layout->layout_def_) return true;
+    uint32_t descriptor_count = GetTotalDescriptorCount();
+    if (descriptor_count != rh_ds_layout->GetTotalDescriptorCount()) {
         std::stringstream error_str;
-        error_str << "DescriptorSetLayout " << layout_ << " has " << descriptor_count_ << " descriptors, but DescriptorSetLayout "
+        error_str << "DescriptorSetLayout " << layout_ << " has " << descriptor_count << " descriptors, but DescriptorSetLayout "
                   << rh_ds_layout->GetDescriptorSetLayout() << ", which comes from pipelineLayout, has "
-                  << rh_ds_layout->descriptor_count_ << " descriptors.";
+                  << rh_ds_layout->GetTotalDescriptorCount() << " descriptors.";
         *error_msg = error_str.str();
         return false;  // trivial fail case
     }
     // Descriptor counts match so need to go through bindings one-by-one
     //  and verify that type and stageFlags match
-    for (auto binding : bindings_) {
+    for (uint32_t i = 0; i < GetBindingCount(); ++i) {
+        const auto &binding = *GetDescriptorSetLayoutBindingPtrFromIndex(i);
         // TODO : Do we also need to check immutable samplers?
         // VkDescriptorSetLayoutBinding *rh_binding;
         if (binding.descriptorCount != rh_ds_layout->GetDescriptorCountFromBinding(binding.binding)) {
@@ -260,32 +321,26 @@ bool cvdescriptorset::DescriptorSetLayout::IsCompatible(DescriptorSetLayout cons
     return true;
 }
 
-bool cvdescriptorset::DescriptorSetLayout::IsNextBindingConsistent(const uint32_t binding) const {
-    if (!binding_to_index_map_.count(binding + 1)) return false;
-    auto const &bi_itr = binding_to_index_map_.find(binding);
-    if (bi_itr != binding_to_index_map_.end()) {
-        const auto &next_bi_itr = binding_to_index_map_.find(binding + 1);
-        if (next_bi_itr != binding_to_index_map_.end()) {
-            auto type = bindings_[bi_itr->second].descriptorType;
-            auto stage_flags = bindings_[bi_itr->second].stageFlags;
-            auto immut_samp = bindings_[bi_itr->second].pImmutableSamplers ? true : false;
-            if ((type != bindings_[next_bi_itr->second].descriptorType) ||
-                (stage_flags != bindings_[next_bi_itr->second].stageFlags) ||
-                (immut_samp != (bindings_[next_bi_itr->second].pImmutableSamplers ? true : false))) {
-                return false;
-            }
-            return true;
-        }
+bool cvdescriptorset::DescriptorSetLayoutDef::IsNextBindingConsistent(const uint32_t binding) const {
+    uint32_t index = GetIndexFromBinding(binding);
+    uint32_t next_index = GetIndexFromBinding(binding + 1);
+    if (index == invalid_index || next_index == invalid_index) return false;
+    auto type = bindings_[index].descriptorType;
+    auto stage_flags = bindings_[index].stageFlags;
+    auto immut_samp = bindings_[index].pImmutableSamplers ? true : false;
+    if ((type != bindings_[next_index].descriptorType) || (stage_flags != bindings_[next_index].stageFlags) ||
+        (immut_samp != (bindings_[next_index].pImmutableSamplers ? true : false))) {
+        return false;
     }
-    return false;
+    return true;
 }
 // Starting at offset descriptor of given binding, parse over update_count
 //  descriptor updates and verify that for any binding boundaries that are crossed, the next binding(s) are all consistent
 //  Consistency means that their type, stage flags, and whether or not they use immutable samplers matches
 //  If so, return true. If not, fill in error_msg and return false
-bool cvdescriptorset::DescriptorSetLayout::VerifyUpdateConsistency(uint32_t current_binding, uint32_t offset, uint32_t update_count,
-                                                                   const char *type, const VkDescriptorSet set,
-                                                                   std::string *error_msg) const {
+bool cvdescriptorset::DescriptorSetLayoutDef::VerifyUpdateConsistency(uint32_t current_binding, uint32_t offset,
+                                                                      uint32_t update_count, const char *type,
+                                                                      const VkDescriptorSet set, std::string *error_msg) const {
     // Verify consecutive bindings match (if needed)
     auto orig_binding = current_binding;
     // Track count of descriptors in the current_bindings that are remaining to be updated
@@ -318,15 +373,51 @@ bool cvdescriptorset::DescriptorSetLayout::VerifyUpdateConsistency(uint32_t curr
 cvdescriptorset::AllocateDescriptorSetsData::AllocateDescriptorSetsData(uint32_t count)
     : required_descriptors_by_type{}, layout_nodes(count, nullptr) {}
 
+// The class of the descriptors of the given type
+static cvdescriptorset::DescriptorClass DescriptorClassFromType(VkDescriptorType type) {
+    switch (type) {
+        case VK_DESCRIPTOR_TYPE_SAMPLER:
+            return cvdescriptorset::PlainSampler;
+        case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+            return cvdescriptorset::ImageSampler;
+        case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+        case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+        case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+            return cvdescriptorset::Image;
+        case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+        case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+            return cvdescriptorset::TexelBuffer;
+        default:
+            return cvdescriptorset::GeneralBuffer;
+    }
+}
+
 cvdescriptorset::DescriptorSet::DescriptorSet(const VkDescriptorSet set, const VkDescriptorPool pool,
                                               const std::shared_ptr<DescriptorSetLayout const> &layout, const layer_data *dev_data)
     : some_update_(false),
+      change_count_(0),
+      storage_updates_cache_next_(0),
       set_(set),
       pool_state_(nullptr),
       p_layout_(layout),
+      pool_index_(0),
       device_data_(dev_data),
       limits_(GetPhysDevProperties(dev_data)->properties.limits) {
     pool_state_ = GetDescriptorPoolState(dev_data, pool);
+    CreateDescriptors();
+}
+
+void cvdescriptorset::DescriptorSet::CreateDescriptors() {
+    uint32_t class_counts[GeneralBuffer + 1] = {};
+    for (uint32_t i = 0; i < p_layout_->GetBindingCount(); ++i) {
+        class_counts[DescriptorClassFromType(p_layout_->GetTypeFromIndex(i))] += p_layout_->GetDescriptorCountFromIndex(i);
+    }
+    descriptors_.reserve(p_layout_->GetTotalDescriptorCount());
+    sampler_descriptors_.reserve(class_counts[PlainSampler]);
+    image_sampler_descriptors_.reserve(class_counts[ImageSampler]);
+    image_descriptors_.reserve(class_counts[Image]);
+    texel_descriptors_.reserve(class_counts[TexelBuffer]);
+    buffer_descriptors_.reserve(class_counts[GeneralBuffer]);
     // Foreach binding, create default descriptors of given type
     for (uint32_t i = 0; i < p_layout_->GetBindingCount(); ++i) {
         auto type = p_layout_->GetTypeFromIndex(i);
@@ -335,10 +426,11 @@ cvdescriptorset::DescriptorSet::DescriptorSet(const VkDescriptorSet set, const V
                 auto immut_sampler = p_layout_->GetImmutableSamplerPtrFromIndex(i);
                 for (uint32_t di = 0; di < p_layout_->GetDescriptorCountFromIndex(i); ++di) {
                     if (immut_sampler) {
-                        descriptors_.emplace_back(new SamplerDescriptor(immut_sampler + di));
+                        sampler_descriptors_.emplace_back(immut_sampler + di);
                         some_update_ = true;  // Immutable samplers are updated at creation
                     } else
-                        descriptors_.emplace_back(new SamplerDescriptor(nullptr));
+                        sampler_descriptors_.emplace_back(nullptr);
+                    descriptors_.push_back(&sampler_descriptors_.back());
                 }
                 break;
             }
@@ -346,10 +438,11 @@ cvdescriptorset::DescriptorSet::DescriptorSet(const VkDescriptorSet set, const V
                 auto immut = p_layout_->GetImmutableSamplerPtrFromIndex(i);
                 for (uint32_t di = 0; di < p_layout_->GetDescriptorCountFromIndex(i); ++di) {
                     if (immut) {
-                        descriptors_.emplace_back(new ImageSamplerDescriptor(immut + di));
+                        image_sampler_descriptors_.emplace_back(immut + di);
                         some_update_ = true;  // Immutable samplers are updated at creation
                     } else
-                        descriptors_.emplace_back(new ImageSamplerDescriptor(nullptr));
+                        image_sampler_descriptors_.emplace_back(nullptr);
+                    descriptors_.push_back(&image_sampler_descriptors_.back());
                 }
                 break;
             }
@@ -357,20 +450,26 @@ cvdescriptorset::DescriptorSet::DescriptorSet(const VkDescriptorSet set, const V
             case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
             case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
             case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
-                for (uint32_t di = 0; di < p_layout_->GetDescriptorCountFromIndex(i); ++di)
-                    descriptors_.emplace_back(new ImageDescriptor(type));
+                for (uint32_t di = 0; di < p_layout_->GetDescriptorCountFromIndex(i); ++di) {
+                    image_descriptors_.emplace_back(type);
+                    descriptors_.push_back(&image_descriptors_.back());
+                }
                 break;
             case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
             case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
-                for (uint32_t di = 0; di < p_layout_->GetDescriptorCountFromIndex(i); ++di)
-                    descriptors_.emplace_back(new TexelDescriptor(type));
+                for (uint32_t di = 0; di < p_layout_->GetDescriptorCountFromIndex(i); ++di) {
+                    texel_descriptors_.emplace_back(type);
+                    descriptors_.push_back(&texel_descriptors_.back());
+                }
                 break;
             case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
             case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
             case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
             case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
-                for (uint32_t di = 0; di < p_layout_->GetDescriptorCountFromIndex(i); ++di)
-                    descriptors_.emplace_back(new BufferDescriptor(type));
+                for (uint32_t di = 0; di < p_layout_->GetDescriptorCountFromIndex(i); ++di) {
+                    buffer_descriptors_.emplace_back(type);
+                    descriptors_.push_back(&buffer_descriptors_.back());
+                }
                 break;
             default:
                 assert(0);  // Bad descriptor type specified
@@ -381,6 +480,27 @@ cvdescriptorset::DescriptorSet::DescriptorSet(const VkDescriptorSet set, const V
 
 cvdescriptorset::DescriptorSet::~DescriptorSet() { InvalidateBoundCmdBuffers(); }
 
+void cvdescriptorset::DescriptorSet::Free() {
+    InvalidateBoundCmdBuffers();
+    cb_bindings.clear();
+}
+
+void cvdescriptorset::DescriptorSet::Reuse(const VkDescriptorSet set, const std::shared_ptr<DescriptorSetLayout const> &layout) {
+    set_ = set;
+    p_layout_ = layout;
+    some_update_ = false;
+    storage_updates_cache_.clear();
+    storage_updates_cache_next_ = 0;
+    in_use.store(0);
+    descriptors_.clear();
+    sampler_descriptors_.clear();
+    image_sampler_descriptors_.clear();
+    image_descriptors_.clear();
+    texel_descriptors_.clear();
+    buffer_descriptors_.clear();
+    CreateDescriptors();
+}
+
 static std::string string_descriptor_req_view_type(descriptor_req req) {
     std::string result("");
     for (unsigned i = 0; i <= VK_IMAGE_VIEW_TYPE_END_RANGE; i++) {
@@ -430,7 +550,7 @@ bool cvdescriptorset::DescriptorSet::ValidateDrawState(const std::map<uint32_t,
                 auto descriptor_class = descriptors_[i]->GetClass();
                 if (descriptor_class == GeneralBuffer) {
                     // Verify that buffers are valid
-                    auto buffer = static_cast<BufferDescriptor *>(descriptors_[i].get())->GetBuffer();
+                    auto buffer = static_cast<BufferDescriptor *>(descriptors_[i])->GetBuffer();
                     auto buffer_node = GetBufferState(device_data_, buffer);
                     if (!buffer_node) {
                         std::stringstream error_str;
@@ -452,8 +572,8 @@ bool cvdescriptorset::DescriptorSet::ValidateDrawState(const std::map<uint32_t,
                     if (descriptors_[i]->IsDynamic()) {
                         // Validate that dynamic offsets are within the buffer
                         auto buffer_size = buffer_node->createInfo.size;
-                        auto range = static_cast<BufferDescriptor *>(descriptors_[i].get())->GetRange();
-                        auto desc_offset = static_cast<BufferDescriptor *>(descriptors_[i].get())->GetOffset();
+                        auto range = static_cast<BufferDescriptor *>(descriptors_[i])->GetRange();
+                        auto desc_offset = static_cast<BufferDescriptor *>(descriptors_[i])->GetOffset();
                         auto dyn_offset = dynamic_offsets[GetDynamicOffsetIndexFromBinding(binding) + array_idx];
                         if (VK_WHOLE_SIZE == range) {
                             if ((dyn_offset + desc_offset) > buffer_size) {
@@ -481,11 +601,11 @@ bool cvdescriptorset::DescriptorSet::ValidateDrawState(const std::map<uint32_t,
                     VkImageView image_view;
                     VkImageLayout image_layout;
                     if (descriptor_class == ImageSampler) {
-                        image_view = static_cast<ImageSamplerDescriptor *>(descriptors_[i].get())->GetImageView();
-                        image_layout = static_cast<ImageSamplerDescriptor *>(descriptors_[i].get())->GetImageLayout();
+                        image_view = static_cast<ImageSamplerDescriptor *>(descriptors_[i])->GetImageView();
+                        image_layout = static_cast<ImageSamplerDescriptor *>(descriptors_[i])->GetImageLayout();
                     } else {
-                        image_view = static_cast<ImageDescriptor *>(descriptors_[i].get())->GetImageView();
-                        image_layout = static_cast<ImageDescriptor *>(descriptors_[i].get())->GetImageLayout();
+                        image_view = static_cast<ImageDescriptor *>(descriptors_[i])->GetImageView();
+                        image_layout = static_cast<ImageDescriptor *>(descriptors_[i])->GetImageLayout();
                     }
                     auto reqs = binding_pair.second;
 
@@ -555,11 +675,24 @@ bool cvdescriptorset::DescriptorSet::ValidateDrawState(const std::map<uint32_t,
     return true;
 }
 
-// For given bindings, place any update buffers or images into the passed-in unordered_sets
-uint32_t cvdescriptorset::DescriptorSet::GetStorageUpdates(const std::map<uint32_t, descriptor_req> &bindings,
-                                                           std::unordered_set<VkBuffer> *buffer_set,
-                                                           std::unordered_set<VkImageView> *image_set) const {
-    auto num_updates = 0;
+// For given bindings, get the lists of the storage buffers and images that will be updated
+std::shared_ptr<const cvdescriptorset::StorageUpdates> cvdescriptorset::DescriptorSet::GetStorageUpdates(
+    const std::map<uint32_t, descriptor_req> &bindings) const {
+    // Draws mostly use the bindings of a few pipelines with sets that aren't updated in between, so look for the lists made last
+    {
+        std::lock_guard<std::mutex> lock(storage_updates_cache_lock_);
+        for (const auto &entry : storage_updates_cache_) {
+            if (entry.change_count == change_count_ && entry.bindings.size() == bindings.size() &&
+                std::equal(entry.bindings.begin(), entry.bindings.end(), bindings.begin(),
+                           [](uint32_t binding, const std::pair<const uint32_t, descriptor_req> &binding_pair) {
+                               return binding == binding_pair.first;
+                           })) {
+                return entry.updates;
+            }
+        }
+    }
+
+    StorageUpdates updates;
     for (auto binding_pair : bindings) {
         auto binding = binding_pair.first;
         // If a binding doesn't exist, skip it
@@ -571,32 +704,53 @@ uint32_t cvdescriptorset::DescriptorSet::GetStorageUpdates(const std::map<uint32
             if (Image == descriptors_[start_idx]->descriptor_class) {
                 for (uint32_t i = 0; i < p_layout_->GetDescriptorCountFromBinding(binding); ++i) {
                     if (descriptors_[start_idx + i]->updated) {
-                        image_set->insert(static_cast<ImageDescriptor *>(descriptors_[start_idx + i].get())->GetImageView());
-                        num_updates++;
+                        updates.image_views.push_back(static_cast<ImageDescriptor *>(descriptors_[start_idx + i])->GetImageView());
                     }
                 }
             } else if (TexelBuffer == descriptors_[start_idx]->descriptor_class) {
                 for (uint32_t i = 0; i < p_layout_->GetDescriptorCountFromBinding(binding); ++i) {
                     if (descriptors_[start_idx + i]->updated) {
-                        auto bufferview = static_cast<TexelDescriptor *>(descriptors_[start_idx + i].get())->GetBufferView();
+                        auto bufferview = static_cast<TexelDescriptor *>(descriptors_[start_idx + i])->GetBufferView();
                         auto bv_state = GetBufferViewState(device_data_, bufferview);
                         if (bv_state) {
-                            buffer_set->insert(bv_state->create_info.buffer);
-                            num_updates++;
+                            updates.buffers.push_back(bv_state->create_info.buffer);
                         }
                     }
                 }
             } else if (GeneralBuffer == descriptors_[start_idx]->descriptor_class) {
                 for (uint32_t i = 0; i < p_layout_->GetDescriptorCountFromBinding(binding); ++i) {
                     if (descriptors_[start_idx + i]->updated) {
-                        buffer_set->insert(static_cast<BufferDescriptor *>(descriptors_[start_idx + i].get())->GetBuffer());
-                        num_updates++;
+                        updates.buffers.push_back(static_cast<BufferDescriptor *>(descriptors_[start_idx + i])->GetBuffer());
                     }
                 }
             }
         }
     }
-    return num_updates;
+    // The same resource may be in several descriptors
+    std::sort(updates.buffers.begin(), updates.buffers.end());
+    updates.buffers.erase(std::unique(updates.buffers.begin(), updates.buffers.end()), updates.buffers.end());
+    std::sort(updates.image_views.begin(), updates.image_views.end());
+    updates.image_views.erase(std::unique(updates.image_views.begin(), updates.image_views.end()), updates.image_views.end());
+
+    StorageUpdatesCacheEntry entry;
+    entry.bindings.reserve(bindings.size());
+    for (const auto &binding_pair : bindings) {
+        entry.bindings.push_back(binding_pair.first);
+    }
+    entry.change_count = change_count_;
+    if (!updates.buffers.empty() || !updates.image_views.empty()) {
+        entry.updates = std::make_shared<const StorageUpdates>(std::move(updates));
+    }
+    // Return the caller's own reference, since another draw may replace the entry as soon as the lock is released
+    auto result = entry.updates;
+    std::lock_guard<std::mutex> lock(storage_updates_cache_lock_);
+    if (storage_updates_cache_.size() < storage_updates_cache_size) {
+        storage_updates_cache_.push_back(std::move(entry));
+    } else {
+        storage_updates_cache_[storage_updates_cache_next_] = std::move(entry);
+        storage_updates_cache_next_ = (storage_updates_cache_next_ + 1) % storage_updates_cache_size;
+    }
+    return result;
 }
 // Set is being deleted or updates so invalidate all bound cmd buffers
 void cvdescriptorset::DescriptorSet::InvalidateBoundCmdBuffers() {
@@ -622,6 +776,7 @@ void cvdescriptorset::DescriptorSet::PerformWriteUpdate(const VkWriteDescriptorS
         binding_being_updated++;
     }
     if (update->descriptorCount) some_update_ = true;
+    ++change_count_;
 
     InvalidateBoundCmdBuffers();
 }
@@ -722,9 +877,10 @@ void cvdescriptorset::DescriptorSet::PerformCopyUpdate(const VkCopyDescriptorSet
     auto dst_start_idx = p_layout_->GetGlobalStartIndexFromBinding(update->dstBinding) + update->dstArrayElement;
     // Update parameters all look good so perform update
     for (uint32_t di = 0; di < update->descriptorCount; ++di) {
-        descriptors_[dst_start_idx + di]->CopyUpdate(src_set->descriptors_[src_start_idx + di].get());
+        descriptors_[dst_start_idx + di]->CopyUpdate(src_set->descriptors_[src_start_idx + di]);
     }
     if (update->descriptorCount) some_update_ = true;
+    ++change_count_;
 
     InvalidateBoundCmdBuffers();
 }
@@ -735,10 +891,10 @@ void cvdescriptorset::DescriptorSet::PerformCopyUpdate(const VkCopyDescriptorSet
 void cvdescriptorset::DescriptorSet::BindCommandBuffer(GLOBAL_CB_NODE *cb_node,
                                                        const std::map<uint32_t, descriptor_req> &binding_req_map) {
     // bind cb to this descriptor set
-    cb_bindings.insert(cb_node);
+    AddBoundCommandBuffer(cb_node);
     // Add bindings for descriptor set, the set's pool, and individual objects in the set
     cb_node->object_bindings.insert({HandleToUint64(set_), kVulkanObjectTypeDescriptorSet});
-    pool_state_->cb_bindings.insert(cb_node);
+    pool_state_->AddBoundCommandBuffer(cb_node);
     cb_node->object_bindings.insert({HandleToUint64(pool_state_->pool), kVulkanObjectTypeDescriptorPool});
     // For the active slots, use set# to look up descriptorSet from boundDescriptorSets, and bind all of that descriptor set's
     // resources
@@ -968,7 +1124,7 @@ void cvdescriptorset::SamplerDescriptor::CopyUpdate(const Descriptor *src) {
 void cvdescriptorset::SamplerDescriptor::BindCommandBuffer(const layer_data *dev_data, GLOBAL_CB_NODE *cb_node) {
     if (!immutable_) {
         auto sampler_state = GetSamplerState(dev_data, sampler_);
-        if (sampler_state) core_validation::AddCommandBufferBindingSampler(cb_node, sampler_state);
+        if (sampler_state) core_validation::AddCommandBufferBindingSampler(dev_data, cb_node, sampler_state);
     }
 }
 
@@ -1006,7 +1162,7 @@ void cvdescriptorset::ImageSamplerDescriptor::BindCommandBuffer(const layer_data
     // First add binding for any non-immutable sampler
     if (!immutable_) {
         auto sampler_state = GetSamplerState(dev_data, sampler_);
-        if (sampler_state) core_validation::AddCommandBufferBindingSampler(cb_node, sampler_state);
+        if (sampler_state) core_validation::AddCommandBufferBindingSampler(dev_data, cb_node, sampler_state);
     }
     // Add binding for image
     auto iv_state = GetImageViewState(dev_data, image_view_);
@@ -1183,71 +1339,85 @@ void cvdescriptorset::PerformUpdateDescriptorSets(const layer_data *dev_data, ui
         }
     }
 }
-// This helper function carries out the state updates for descriptor updates peformed via update templates. It basically collects
-// data and leverages the PerformUpdateDescriptor helper functions to do this.
-void cvdescriptorset::PerformUpdateDescriptorSetsWithTemplateKHR(layer_data *device_data, VkDescriptorSet descriptorSet,
-                                                                 std::unique_ptr<TEMPLATE_STATE> const &template_state,
-                                                                 const void *pData) {
+void cvdescriptorset::CompileUpdateTemplate(const layer_data *device_data, TEMPLATE_STATE *template_state) {
     auto const &create_info = template_state->create_info;
-
-    // Create a vector of write structs
-    std::vector<VkWriteDescriptorSet> desc_writes;
+    if (create_info.templateType != VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR) return;
     auto layout_obj = GetDescriptorSetLayout(device_data, create_info.descriptorSetLayout);
+    if (!layout_obj) return;
 
-    // Create a WriteDescriptorSet struct for each template update entry
     for (uint32_t i = 0; i < create_info.descriptorUpdateEntryCount; i++) {
-        auto binding_count = layout_obj->GetDescriptorCountFromBinding(create_info.pDescriptorUpdateEntries[i].dstBinding);
-        auto binding_being_updated = create_info.pDescriptorUpdateEntries[i].dstBinding;
-        auto dst_array_element = create_info.pDescriptorUpdateEntries[i].dstArrayElement;
-
-        for (uint32_t j = 0; j < create_info.pDescriptorUpdateEntries[i].descriptorCount; j++) {
-            desc_writes.emplace_back();
-            auto &write_entry = desc_writes.back();
-
-            size_t offset = create_info.pDescriptorUpdateEntries[i].offset + j * create_info.pDescriptorUpdateEntries[i].stride;
-            char *update_entry = (char *)(pData) + offset;
-
-            if (dst_array_element >= binding_count) {
-                dst_array_element = 0;
-                binding_being_updated = layout_obj->GetNextValidBinding(binding_being_updated);
+        auto const &entry = create_info.pDescriptorUpdateEntries[i];
+        auto binding = entry.dstBinding;
+        auto array_element = entry.dstArrayElement;
+        auto offset = entry.offset;
+        auto remaining = entry.descriptorCount;
+        // Like a VkWriteDescriptorSet, an entry rolls over into the next bindings
+        while (remaining && layout_obj->HasBinding(binding)) {
+            auto binding_count = layout_obj->GetDescriptorCountFromBinding(binding);
+            if (array_element >= binding_count) {
+                if (layout_obj->GetGlobalEndIndexFromBinding(binding) + 1 >= layout_obj->GetTotalDescriptorCount()) break;
+                binding = layout_obj->GetNextValidBinding(binding);
+                array_element -= binding_count;
+                continue;
             }
+            auto count = std::min(remaining, binding_count - array_element);
+            template_state->writes.push_back({binding, array_element, count, entry.descriptorType, offset, entry.stride});
+            array_element += count;
+            offset += count * entry.stride;
+            remaining -= count;
+        }
+    }
+}
 
-            write_entry.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            write_entry.pNext = NULL;
-            write_entry.dstSet = descriptorSet;
-            write_entry.dstBinding = binding_being_updated;
-            write_entry.dstArrayElement = dst_array_element;
-            write_entry.descriptorCount = 1;
-            write_entry.descriptorType = create_info.pDescriptorUpdateEntries[i].descriptorType;
-
-            switch (create_info.pDescriptorUpdateEntries[i].descriptorType) {
-                case VK_DESCRIPTOR_TYPE_SAMPLER:
-                case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
-                case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
-                case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
-                case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
-                    write_entry.pImageInfo = reinterpret_cast<VkDescriptorImageInfo *>(update_entry);
-                    break;
-
-                case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
-                case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
-                case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
-                case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
-                    write_entry.pBufferInfo = reinterpret_cast<VkDescriptorBufferInfo *>(update_entry);
-                    break;
+// This helper function carries out the state updates for descriptor updates peformed via update templates. It uses the writes
+//  worked out when the template was created, with one VkWriteDescriptorSet for each run of tightly packed descriptors.
+void cvdescriptorset::PerformUpdateDescriptorSetsWithTemplateKHR(layer_data *device_data, VkDescriptorSet descriptorSet,
+                                                                 std::unique_ptr<TEMPLATE_STATE> const &template_state,
+                                                                 const void *pData) {
+    auto set_node = core_validation::GetSetNode(device_data, descriptorSet);
+    if (!set_node) return;
 
-                case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
-                case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
-                    write_entry.pTexelBufferView = reinterpret_cast<VkBufferView *>(update_entry);
-                    break;
-                default:
-                    assert(0);
-                    break;
-            }
-            dst_array_element++;
+    VkWriteDescriptorSet write_entry = {};
+    write_entry.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write_entry.dstSet = descriptorSet;
+    for (auto const &write : template_state->writes) {
+        size_t info_size = 0;
+        switch (write.type) {
+            case VK_DESCRIPTOR_TYPE_SAMPLER:
+            case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+            case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+            case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+            case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+                info_size = sizeof(VkDescriptorImageInfo);
+                break;
+            case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+            case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+            case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+            case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+                info_size = sizeof(VkDescriptorBufferInfo);
+                break;
+            case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+            case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+                info_size = sizeof(VkBufferView);
+                break;
+            default:
+                assert(0);
+                continue;
+        }
+        // Packed descriptors are read like the array of a VkWriteDescriptorSet, others are written one at a time
+        uint32_t const per_write = (write.stride == info_size) ? write.count : 1;
+        write_entry.dstBinding = write.binding;
+        write_entry.descriptorType = write.type;
+        write_entry.descriptorCount = per_write;
+        for (uint32_t i = 0; i < write.count; i += per_write) {
+            auto update_entry = static_cast<const char *>(pData) + write.offset + i * write.stride;
+            write_entry.dstArrayElement = write.array_element + i;
+            write_entry.pImageInfo = reinterpret_cast<const VkDescriptorImageInfo *>(update_entry);
+            write_entry.pBufferInfo = reinterpret_cast<const VkDescriptorBufferInfo *>(update_entry);
+            write_entry.pTexelBufferView = reinterpret_cast<const VkBufferView *>(update_entry);
+            set_node->PerformWriteUpdate(&write_entry);
         }
     }
-    PerformUpdateDescriptorSets(device_data, static_cast<uint32_t>(desc_writes.size()), desc_writes.data(), 0, NULL);
 }
 // Validate the state for a given write update but don't actually perform the update
 //  If an error would occur for this update, return false and fill in details in error_msg string
@@ -1467,7 +1637,7 @@ bool cvdescriptorset::DescriptorSet::VerifyWriteUpdateContents(const VkWriteDesc
         }
         case VK_DESCRIPTOR_TYPE_SAMPLER: {
             for (uint32_t di = 0; di < update->descriptorCount; ++di) {
-                if (!descriptors_[index + di].get()->IsImmutableSampler()) {
+                if (!descriptors_[index + di]->IsImmutableSampler()) {
                     if (!ValidateSampler(update->pImageInfo[di].sampler, device_data_)) {
                         *error_code = VALIDATION_ERROR_15c0028a;
                         std::stringstream error_str;
@@ -1551,7 +1721,7 @@ bool cvdescriptorset::DescriptorSet::VerifyCopyUpdateContents(const VkCopyDescri
         case PlainSampler: {
             for (uint32_t di = 0; di < update->descriptorCount; ++di) {
                 if (!src_set->descriptors_[index + di]->IsImmutableSampler()) {
-                    auto update_sampler = static_cast<SamplerDescriptor *>(src_set->descriptors_[index + di].get())->GetSampler();
+                    auto update_sampler = static_cast<SamplerDescriptor *>(src_set->descriptors_[index + di])->GetSampler();
                     if (!ValidateSampler(update_sampler, device_data_)) {
                         *error_code = VALIDATION_ERROR_15c0028a;
                         std::stringstream error_str;
@@ -1567,7 +1737,7 @@ bool cvdescriptorset::DescriptorSet::VerifyCopyUpdateContents(const VkCopyDescri
         }
         case ImageSampler: {
             for (uint32_t di = 0; di < update->descriptorCount; ++di) {
-                auto img_samp_desc = static_cast<const ImageSamplerDescriptor *>(src_set->descriptors_[index + di].get());
+                auto img_samp_desc = static_cast<const ImageSamplerDescriptor *>(src_set->descriptors_[index + di]);
                 // First validate sampler
                 if (!img_samp_desc->IsImmutableSampler()) {
                     auto update_sampler = img_samp_desc->GetSampler();
@@ -1595,7 +1765,7 @@ bool cvdescriptorset::DescriptorSet::VerifyCopyUpdateContents(const VkCopyDescri
         }
         case Image: {
             for (uint32_t di = 0; di < update->descriptorCount; ++di) {
-                auto img_desc = static_cast<const ImageDescriptor *>(src_set->descriptors_[index + di].get());
+                auto img_desc = static_cast<const ImageDescriptor *>(src_set->descriptors_[index + di]);
                 auto image_view = img_desc->GetImageView();
                 auto image_layout = img_desc->GetImageLayout();
                 if (!ValidateImageUpdate(image_view, image_layout, type, device_data_, error_code, error_msg)) {
@@ -1609,7 +1779,7 @@ bool cvdescriptorset::DescriptorSet::VerifyCopyUpdateContents(const VkCopyDescri
         }
         case TexelBuffer: {
             for (uint32_t di = 0; di < update->descriptorCount; ++di) {
-                auto buffer_view = static_cast<TexelDescriptor *>(src_set->descriptors_[index + di].get())->GetBufferView();
+                auto buffer_view = static_cast<TexelDescriptor *>(src_set->descriptors_[index + di])->GetBufferView();
                 auto bv_state = GetBufferViewState(device_data_, buffer_view);
                 if (!bv_state) {
                     *error_code = VALIDATION_ERROR_15c00286;
@@ -1630,7 +1800,7 @@ bool cvdescriptorset::DescriptorSet::VerifyCopyUpdateContents(const VkCopyDescri
         }
         case GeneralBuffer: {
             for (uint32_t di = 0; di < update->descriptorCount; ++di) {
-                auto buffer = static_cast<BufferDescriptor *>(src_set->descriptors_[index + di].get())->GetBuffer();
+                auto buffer = static_cast<BufferDescriptor *>(src_set->descriptors_[index + di])->GetBuffer();
                 if (!ValidateBufferUsage(GetBufferState(device_data_, buffer), type, error_code, error_msg)) {
                     std::stringstream error_str;
                     error_str << "Attempted copy update to buffer descriptor failed due to: " << error_msg->c_str();
@@ -1721,12 +1891,21 @@ void cvdescriptorset::PerformAllocateDescriptorSets(const VkDescriptorSetAllocat
     for (uint32_t i = 0; i < VK_DESCRIPTOR_TYPE_RANGE_SIZE; i++) {
         pool_state->availableDescriptorTypeCount[i] -= ds_data->required_descriptors_by_type[i];
     }
-    // Create tracking object for each descriptor set; insert into global map and the pool's set.
+    // Create tracking object for each descriptor set, reusing the ones freed back to the pool; insert into global map and the
+    // pool's sets.
     for (uint32_t i = 0; i < p_alloc_info->descriptorSetCount; i++) {
-        auto new_ds = new cvdescriptorset::DescriptorSet(descriptor_sets[i], p_alloc_info->descriptorPool, ds_data->layout_nodes[i],
-                                                         dev_data);
+        cvdescriptorset::DescriptorSet *new_ds;
+        if (!pool_state->free_sets.empty()) {
+            new_ds = pool_state->free_sets.back();
+            pool_state->free_sets.pop_back();
+            new_ds->Reuse(descriptor_sets[i], ds_data->layout_nodes[i]);
+        } else {
+            new_ds = new cvdescriptorset::DescriptorSet(descriptor_sets[i], p_alloc_info->descriptorPool, ds_data->layout_nodes[i],
+                                                        dev_data);
+        }
 
-        pool_state->sets.insert(new_ds);
+        new_ds->SetPoolIndex(pool_state->sets.size());
+        pool_state->sets.push_back(new_ds);
         new_ds->in_use.store(0);
         (*set_map)[descriptor_sets[i]] = new_ds;
     }
@@ -53,6 +53,7 @@
 #include "vk_object_types.h"
 #include <map>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -90,32 +91,38 @@ using core_validation::layer_data;
  *  increments from there. So if the lowest binding# in this example had descriptorCount of
  *  10, then the GlobalStartIndex of the 2nd lowest binding# will be 10 where 0-9 are the
  *  global indices for the lowest binding#.
+ *
+ * Layout Definition - The contents of a layout live in a DescriptorSetLayoutDef, which layouts
+ *  created with the same bindings and flags share, as engines tend to create the same layouts
+ *  over and over. Binding numbers are looked up in a table indexed by binding#, which only falls
+ *  back to a hash map for layouts whose binding numbers are far sparser than their bindings.
+ *  The per-binding global indices and dynamic offset indices are kept by binding index.
  */
 namespace cvdescriptorset {
-class DescriptorSetLayout {
+class DescriptorSetLayoutDef {
    public:
-    // Constructors and destructor
-    DescriptorSetLayout(const VkDescriptorSetLayoutCreateInfo *p_create_info, const VkDescriptorSetLayout layout);
-    // Validate create info - should be called prior to creation
-    static bool ValidateCreateInfo(debug_report_data *, const VkDescriptorSetLayoutCreateInfo *);
-    // Straightforward Get functions
-    VkDescriptorSetLayout GetDescriptorSetLayout() const { return layout_; };
+    DescriptorSetLayoutDef(const VkDescriptorSetLayoutCreateInfo *p_create_info);
+    // Return the definition of a layout with the given create info, shared with any live layout created alike
+    static std::shared_ptr<DescriptorSetLayoutDef const> Get(const VkDescriptorSetLayoutCreateInfo *p_create_info);
+    size_t GetHash() const { return hash_; }
+    bool operator==(const DescriptorSetLayoutDef &rh) const;
+
     uint32_t GetTotalDescriptorCount() const { return descriptor_count_; };
     uint32_t GetDynamicDescriptorCount() const { return dynamic_descriptor_count_; };
     VkDescriptorSetLayoutCreateFlags GetCreateFlags() const { return flags_; }
-    // For a given binding, return the number of descriptors in that binding and all successive bindings
     uint32_t GetBindingCount() const { return binding_count_; };
-    // Fill passed-in set with bindings
+    // Return the index of the given binding, or invalid_index if the layout doesn't have it
+    static const uint32_t invalid_index = 0xFFFFFFFF;
+    uint32_t GetIndexFromBinding(const uint32_t binding) const {
+        if (!sparse_binding_to_index_map_.empty()) {
+            auto it = sparse_binding_to_index_map_.find(binding);
+            return it != sparse_binding_to_index_map_.end() ? it->second : invalid_index;
+        }
+        return binding < binding_to_index_.size() ? binding_to_index_[binding] : invalid_index;
+    }
     void FillBindingSet(std::unordered_set<uint32_t> *) const;
-    // Return true if given binding is present in this layout
-    bool HasBinding(const uint32_t binding) const { return binding_to_index_map_.count(binding) > 0; };
-    // Return true if this layout is compatible with passed in layout from a pipelineLayout,
-    //   else return false and update error_msg with description of incompatibility
-    bool IsCompatible(DescriptorSetLayout const *const, std::string *) const;
-    // Return true if binding 1 beyond given exists and has same type, stageFlags & immutable sampler use
+    bool HasBinding(const uint32_t binding) const { return GetIndexFromBinding(binding) != invalid_index; };
     bool IsNextBindingConsistent(const uint32_t) const;
-    // Various Get functions that can either be passed a binding#, which will
-    //  be automatically translated into the appropriate index, or the index# can be passed in directly
     VkDescriptorSetLayoutBinding const *GetDescriptorSetLayoutBindingPtrFromBinding(const uint32_t) const;
     VkDescriptorSetLayoutBinding const *GetDescriptorSetLayoutBindingPtrFromIndex(const uint32_t) const;
     uint32_t GetDescriptorCountFromBinding(const uint32_t) const;
@@ -126,37 +133,107 @@ class DescriptorSetLayout {
     VkShaderStageFlags GetStageFlagsFromBinding(const uint32_t) const;
     VkSampler const *GetImmutableSamplerPtrFromBinding(const uint32_t) const;
     VkSampler const *GetImmutableSamplerPtrFromIndex(const uint32_t) const;
-    // For a given binding and array index, return the corresponding index into the dynamic offset array
     int32_t GetDynamicOffsetIndexFromBinding(uint32_t binding) const {
-        auto dyn_off = binding_to_dynamic_array_idx_map_.find(binding);
-        if (dyn_off == binding_to_dynamic_array_idx_map_.end()) {
+        uint32_t index = GetIndexFromBinding(binding);
+        if (index == invalid_index || dynamic_offset_index_[index] < 0) {
             assert(0);  // Requesting dyn offset for invalid binding/array idx pair
             return -1;
         }
-        return dyn_off->second;
+        return dynamic_offset_index_[index];
     }
-    // For a particular binding, get the global index
-    //  These calls should be guarded by a call to "HasBinding(binding)" to verify that the given binding exists
     uint32_t GetGlobalStartIndexFromBinding(const uint32_t) const;
     uint32_t GetGlobalEndIndexFromBinding(const uint32_t) const;
-    // Helper function to get the next valid binding for a descriptor
     uint32_t GetNextValidBinding(const uint32_t) const;
-    // For a particular binding starting at offset and having update_count descriptors
-    //  updated, verify that for any binding boundaries crossed, the update is consistent
     bool VerifyUpdateConsistency(uint32_t, uint32_t, uint32_t, const char *, const VkDescriptorSet, std::string *) const;
 
    private:
-    VkDescriptorSetLayout layout_;
-    std::map<uint32_t, uint32_t> binding_to_index_map_;
-    std::unordered_map<uint32_t, uint32_t> binding_to_global_start_index_map_;
-    std::unordered_map<uint32_t, uint32_t> binding_to_global_end_index_map_;
-    // For a given binding map to associated index in the dynamic offset array
-    std::unordered_map<uint32_t, uint32_t> binding_to_dynamic_array_idx_map_;
     VkDescriptorSetLayoutCreateFlags flags_;
     uint32_t binding_count_;  // # of bindings in this layout
     std::vector<safe_VkDescriptorSetLayoutBinding> bindings_;
+    // Index into bindings_ of each binding# up to the largest one, invalid_index for the gaps
+    std::vector<uint32_t> binding_to_index_;
+    // Used instead of binding_to_index_ when the binding numbers are too sparse for a table
+    std::unordered_map<uint32_t, uint32_t> sparse_binding_to_index_map_;
+    // By binding index, the global index of its first descriptor and the index of its first
+    //  descriptor in the dynamic offset array, or -1 if it isn't dynamic
+    std::vector<uint32_t> global_start_index_;
+    std::vector<int32_t> dynamic_offset_index_;
     uint32_t descriptor_count_;  // total # descriptors in this layout
     uint32_t dynamic_descriptor_count_;
+    size_t hash_;
+};
+
+class DescriptorSetLayout {
+   public:
+    // Constructors and destructor
+    DescriptorSetLayout(const VkDescriptorSetLayoutCreateInfo *p_create_info, const VkDescriptorSetLayout layout);
+    // Validate create info - should be called prior to creation
+    static bool ValidateCreateInfo(debug_report_data *, const VkDescriptorSetLayoutCreateInfo *);
+    // Straightforward Get functions
+    VkDescriptorSetLayout GetDescriptorSetLayout() const { return layout_; };
+    std::shared_ptr<DescriptorSetLayoutDef const> const &GetLayoutDef() const { return layout_def_; }
+    uint32_t GetTotalDescriptorCount() const { return layout_def_->GetTotalDescriptorCount(); };
+    uint32_t GetDynamicDescriptorCount() const { return layout_def_->GetDynamicDescriptorCount(); };
+    VkDescriptorSetLayoutCreateFlags GetCreateFlags() const { return layout_def_->GetCreateFlags(); }
+    // For a given binding, return the number of descriptors in that binding and all successive bindings
+    uint32_t GetBindingCount() const { return layout_def_->GetBindingCount(); };
+    // Fill passed-in set with bindings
+    void FillBindingSet(std::unordered_set<uint32_t> *binding_set) const { layout_def_->FillBindingSet(binding_set); }
+    // Return true if given binding is present in this layout
+    bool HasBinding(const uint32_t binding) const { return layout_def_->HasBinding(binding); };
+    // Return true if this layout is compatible with passed in layout from a pipelineLayout,
+    //   else return false and update error_msg with description of incompatibility
+    bool IsCompatible(DescriptorSetLayout const *const, std::string *) const;
+    // Return true if binding 1 beyond given exists and has same type, stageFlags & immutable sampler use
+    bool IsNextBindingConsistent(const uint32_t binding) const { return layout_def_->IsNextBindingConsistent(binding); }
+    // Various Get functions that can either be passed a binding#, which will
+    //  be automatically translated into the appropriate index, or the index# can be passed in directly
+    VkDescriptorSetLayoutBinding const *GetDescriptorSetLayoutBindingPtrFromBinding(const uint32_t binding) const {
+        return layout_def_->GetDescriptorSetLayoutBindingPtrFromBinding(binding);
+    }
+    VkDescriptorSetLayoutBinding const *GetDescriptorSetLayoutBindingPtrFromIndex(const uint32_t index) const {
+        return layout_def_->GetDescriptorSetLayoutBindingPtrFromIndex(index);
+    }
+    uint32_t GetDescriptorCountFromBinding(const uint32_t binding) const {
+        return layout_def_->GetDescriptorCountFromBinding(binding);
+    }
+    uint32_t GetDescriptorCountFromIndex(const uint32_t index) const { return layout_def_->GetDescriptorCountFromIndex(index); }
+    VkDescriptorType GetTypeFromBinding(const uint32_t binding) const { return layout_def_->GetTypeFromBinding(binding); }
+    VkDescriptorType GetTypeFromIndex(const uint32_t index) const { return layout_def_->GetTypeFromIndex(index); }
+    VkDescriptorType GetTypeFromGlobalIndex(const uint32_t index) const { return layout_def_->GetTypeFromGlobalIndex(index); }
+    VkShaderStageFlags GetStageFlagsFromBinding(const uint32_t binding) const {
+        return layout_def_->GetStageFlagsFromBinding(binding);
+    }
+    VkSampler const *GetImmutableSamplerPtrFromBinding(const uint32_t binding) const {
+        return layout_def_->GetImmutableSamplerPtrFromBinding(binding);
+    }
+    VkSampler const *GetImmutableSamplerPtrFromIndex(const uint32_t index) const {
+        return layout_def_->GetImmutableSamplerPtrFromIndex(index);
+    }
+    // For a given binding and array index, return the corresponding index into the dynamic offset array
+    int32_t GetDynamicOffsetIndexFromBinding(uint32_t binding) const {
+        return layout_def_->GetDynamicOffsetIndexFromBinding(binding);
+    }
+    // For a particular binding, get the global index
+    //  These calls should be guarded by a call to "HasBinding(binding)" to verify that the given binding exists
+    uint32_t GetGlobalStartIndexFromBinding(const uint32_t binding) const {
+        return layout_def_->GetGlobalStartIndexFromBinding(binding);
+    }
+    uint32_t GetGlobalEndIndexFromBinding(const uint32_t binding) const {
+        return layout_def_->GetGlobalEndIndexFromBinding(binding);
+    }
+    // Helper function to get the next valid binding for a descriptor
+    uint32_t GetNextValidBinding(const uint32_t binding) const { return layout_def_->GetNextValidBinding(binding); }
+    // For a particular binding starting at offset and having update_count descriptors
+    //  updated, verify that for any binding boundaries crossed, the update is consistent
+    bool VerifyUpdateConsistency(uint32_t current_binding, uint32_t offset, uint32_t update_count, const char *type,
+                                 const VkDescriptorSet set, std::string *error_msg) const {
+        return layout_def_->VerifyUpdateConsistency(current_binding, offset, update_count, type, set, error_msg);
+    }
+
+   private:
+    VkDescriptorSetLayout layout_;
+    std::shared_ptr<DescriptorSetLayoutDef const> layout_def_;
 };
 
 /*
@@ -280,6 +357,11 @@ struct AllocateDescriptorSetsData {
     std::vector<std::shared_ptr<DescriptorSetLayout const>> layout_nodes;
     AllocateDescriptorSetsData(uint32_t);
 };
+// The storage buffers and image views a set lets the shaders using some of its bindings write to
+struct StorageUpdates {
+    std::vector<VkBuffer> buffers;
+    std::vector<VkImageView> image_views;
+};
 // Helper functions for descriptor set functions that cross multiple sets
 // "Validate" will make sure an update is ok without actually performing it
 bool ValidateUpdateDescriptorSets(const debug_report_data *, const core_validation::layer_data *, uint32_t,
@@ -287,6 +369,8 @@ bool ValidateUpdateDescriptorSets(const debug_report_data *, const core_validati
 // "Perform" does the update with the assumption that ValidateUpdateDescriptorSets() has passed for the given update
 void PerformUpdateDescriptorSets(const core_validation::layer_data *, uint32_t, const VkWriteDescriptorSet *, uint32_t,
                                  const VkCopyDescriptorSet *);
+// Work out the writes of a descriptor update template from the layout of its sets, once when it is created
+void CompileUpdateTemplate(const layer_data *, TEMPLATE_STATE *);
 // Similar to PerformUpdateDescriptorSets, this function will do the same for updating via templates
 void PerformUpdateDescriptorSetsWithTemplateKHR(layer_data *, VkDescriptorSet, std::unique_ptr<TEMPLATE_STATE> const &,
                                                 const void *);
@@ -325,6 +409,13 @@ class DescriptorSet : public BASE_NODE {
     DescriptorSet(const VkDescriptorSet, const VkDescriptorPool, const std::shared_ptr<DescriptorSetLayout const> &,
                   const core_validation::layer_data *);
     ~DescriptorSet();
+    // Freed sets are kept by their pool and given out again. The descriptor storage keeps its capacity, so a set allocated
+    // again with a layout of the same size or smaller doesn't allocate.
+    void Free();
+    void Reuse(const VkDescriptorSet, const std::shared_ptr<DescriptorSetLayout const> &);
+    // Position of the set in the sets of its pool
+    size_t GetPoolIndex() const { return pool_index_; }
+    void SetPoolIndex(size_t pool_index) { pool_index_ = pool_index; }
     // A number of common Get* functions that return data based on layout from which this set was created
     uint32_t GetTotalDescriptorCount() const { return p_layout_->GetTotalDescriptorCount(); };
     uint32_t GetDynamicDescriptorCount() const { return p_layout_->GetDynamicDescriptorCount(); };
@@ -347,10 +438,9 @@ class DescriptorSet : public BASE_NODE {
     // For given bindings validate state at time of draw is correct, returning false on error and writing error details into string*
     bool ValidateDrawState(const std::map<uint32_t, descriptor_req> &, const std::vector<uint32_t> &, const GLOBAL_CB_NODE *,
                            const char *caller, std::string *) const;
-    // For given set of bindings, add any buffers and images that will be updated to their respective unordered_sets & return number
-    // of objects inserted
-    uint32_t GetStorageUpdates(const std::map<uint32_t, descriptor_req> &, std::unordered_set<VkBuffer> *,
-                               std::unordered_set<VkImageView> *) const;
+    // For given set of bindings, get the buffers and images that will be updated, or null if there are none. The lists are kept
+    // until the set is updated, and a set used with the same bindings again gets the same lists.
+    std::shared_ptr<const StorageUpdates> GetStorageUpdates(const std::map<uint32_t, descriptor_req> &) const;
 
     // Descriptor Update functions. These functions validate state and perform update separately
     // Validate contents of a WriteUpdate
@@ -396,11 +486,33 @@ class DescriptorSet : public BASE_NODE {
                               std::string *) const;
     // Private helper to set all bound cmd buffers to INVALID state
     void InvalidateBoundCmdBuffers();
-    bool some_update_;  // has any part of the set ever been updated?
+    // Create the default descriptors of the layout
+    void CreateDescriptors();
+    bool some_update_;      // has any part of the set ever been updated?
+    uint64_t change_count_;  // number of updates performed on the set
+    // The lists GetStorageUpdates() made for the last few sets of bindings, with the change_count_ they were made at. Draws
+    //  recording different command buffers call GetStorageUpdates() concurrently, so the cache has a mutex of its own.
+    struct StorageUpdatesCacheEntry {
+        std::vector<uint32_t> bindings;
+        uint64_t change_count;
+        std::shared_ptr<const StorageUpdates> updates;
+    };
+    static const size_t storage_updates_cache_size = 4;
+    mutable std::vector<StorageUpdatesCacheEntry> storage_updates_cache_;
+    mutable size_t storage_updates_cache_next_;
+    mutable std::mutex storage_updates_cache_lock_;
     VkDescriptorSet set_;
     DESCRIPTOR_POOL_STATE *pool_state_;
-    const std::shared_ptr<DescriptorSetLayout const> p_layout_;
-    std::vector<std::unique_ptr<Descriptor>> descriptors_;
+    std::shared_ptr<DescriptorSetLayout const> p_layout_;
+    size_t pool_index_;
+    // The descriptors in global index order. They live in the arrays of their class below, which are sized when the set
+    //  is created and never grow, so the descriptors of a class are contiguous and the pointers stay valid.
+    std::vector<Descriptor *> descriptors_;
+    std::vector<SamplerDescriptor> sampler_descriptors_;
+    std::vector<ImageSamplerDescriptor> image_sampler_descriptors_;
+    std::vector<ImageDescriptor> image_descriptors_;
+    std::vector<TexelDescriptor> texel_descriptors_;
+    std::vector<BufferDescriptor> buffer_descriptors_;
     // Ptr to device data used for various data look-ups
     const core_validation::layer_data *device_data_;
     const VkPhysicalDeviceLimits limits_;
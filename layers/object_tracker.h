@@ -20,12 +20,14 @@
  * Author: Tobin Ehlis <tobin@lunarg.com>
  */
 
+#include <memory>
 #include <mutex>
 #include <cinttypes>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unordered_map>
+#include <vector>
 
 #include "vk_loader_platform.h"
 #include "vulkan/vulkan.h"
@@ -52,6 +54,7 @@ enum ObjectTrackerError {
     OBJTRACK_UNKNOWN_OBJECT,  // Updating uses of object that's not in global object list
     OBJTRACK_INTERNAL_ERROR,  // Bug with data tracking within the layer
     OBJTRACK_OBJECT_LEAK,     // OBJECT was not correctly freed/destroyed
+    OBJTRACK_OBJECT_SUMMARY,  // Periodic report of the live objects, see summary_frames
 };
 
 // Object Status -- used to track state of individual objects
@@ -74,6 +77,59 @@ struct ObjTrackState {
     VulkanObjectType object_type;  // Object type identifier
     ObjectStatusFlags status;      // Object state
     uint64_t parent_object;        // Parent object
+    // The tracked pool or swapchain this object was allocated from, if any, and the other objects allocated from it. The
+    // objects allocated from a pool or swapchain are listed from its first_child, so freeing them all visits only them.
+    ObjTrackState *parent_node;
+    ObjTrackState *prev_sibling;
+    ObjTrackState *next_sibling;  // Also links the free nodes of ObjTrackStateAllocator
+    ObjTrackState *first_child;
+};
+
+// Allocates ObjTrackStates in blocks and keeps the freed ones for reuse, so creating and destroying objects stops allocating
+// once the number of live objects stops growing. Must hold global_lock.
+class ObjTrackStateAllocator {
+   public:
+    ObjTrackState *allocate() {
+        if (free_list_ == nullptr) {
+            blocks_.emplace_back(new ObjTrackState[kBlockSize]);
+            for (size_t i = 0; i < kBlockSize; ++i) {
+                blocks_.back()[i].next_sibling = free_list_;
+                free_list_ = &blocks_.back()[i];
+            }
+        }
+        ObjTrackState *node = free_list_;
+        free_list_ = node->next_sibling;
+        *node = {};
+        return node;
+    }
+
+    void free(ObjTrackState *node) {
+        node->next_sibling = free_list_;
+        free_list_ = node;
+    }
+
+   private:
+    static const size_t kBlockSize = 256;
+
+    std::vector<std::unique_ptr<ObjTrackState[]>> blocks_;
+    ObjTrackState *free_list_ = nullptr;
+};
+
+// Options read from the lunarg_object_tracker settings, see vk_layer_settings.txt
+struct object_tracker_options {
+    // Report the live objects of each type every this many presented frames, 0 to not report them
+    uint32_t summary_frames;
+    // Only count the objects of the types that no other object frees, without keeping or validating their handles
+    bool summary_only;
+    // Capture the call stack that created one in this many objects, 0 to capture none
+    uint32_t creation_sample_rate;
+};
+
+// An object whose creation call stack was captured
+struct SampledObject {
+    VulkanObjectType object_type;
+    uint64_t frame;  // Frame the object was created in
+    std::vector<void *> creation_stack;
 };
 
 // Track Queue information
@@ -85,7 +141,75 @@ struct ObjTrackQueueInfo {
 // Layer name string to be logged with validation messages.
 const char LayerName[] = "ObjectTracker";
 
-typedef std::unordered_map<uint64_t, ObjTrackState *> object_map_type;
+// The tracked objects of one type, by handle. The handles are spread over shards that each have their own lock, so threads
+// validating handles don't wait on each other unless their handles land in the same shard. Looking a handle up needs no other
+// lock. Adding and removing objects, and using the ObjTrackState found, is still done under global_lock.
+class object_map_type {
+   public:
+    bool contains(uint64_t handle) const {
+        const shard &s = get_shard(handle);
+        std::lock_guard<std::mutex> lock(s.lock);
+        return s.map.count(handle) != 0;
+    }
+
+    // Returns null if the handle isn't tracked
+    ObjTrackState *find(uint64_t handle) const {
+        const shard &s = get_shard(handle);
+        std::lock_guard<std::mutex> lock(s.lock);
+        auto it = s.map.find(handle);
+        return it == s.map.end() ? nullptr : it->second;
+    }
+
+    void insert(uint64_t handle, ObjTrackState *node) {
+        shard &s = get_shard(handle);
+        std::lock_guard<std::mutex> lock(s.lock);
+        s.map[handle] = node;
+    }
+
+    // Returns the node that was removed, or null if the handle wasn't tracked. The caller owns the node.
+    ObjTrackState *erase(uint64_t handle) {
+        shard &s = get_shard(handle);
+        std::lock_guard<std::mutex> lock(s.lock);
+        auto it = s.map.find(handle);
+        if (it == s.map.end()) return nullptr;
+        ObjTrackState *node = it->second;
+        s.map.erase(it);
+        return node;
+    }
+
+    // All the tracked nodes, in no particular order. Objects can be added and removed while walking the result.
+    std::vector<ObjTrackState *> nodes() const {
+        std::vector<ObjTrackState *> result;
+        for (const shard &s : shards_) {
+            std::lock_guard<std::mutex> lock(s.lock);
+            for (const auto &item : s.map) {
+                result.push_back(item.second);
+            }
+        }
+        return result;
+    }
+
+    void clear() {
+        for (shard &s : shards_) {
+            std::lock_guard<std::mutex> lock(s.lock);
+            s.map.clear();
+        }
+    }
+
+   private:
+    static const size_t kShardCount = 16;
+
+    struct shard {
+        mutable std::mutex lock;
+        std::unordered_map<uint64_t, ObjTrackState *> map;
+    };
+
+    // Dispatchable handles are pointers and others are often aligned addresses, so mix the bits before picking a shard
+    shard &get_shard(uint64_t handle) { return shards_[(handle * 0x9E3779B97F4A7C15ull) >> 60]; }
+    const shard &get_shard(uint64_t handle) const { return shards_[(handle * 0x9E3779B97F4A7C15ull) >> 60]; }
+
+    shard shards_[kShardCount];
+};
 
 struct layer_data {
     VkInstance instance;
@@ -94,6 +218,15 @@ struct layer_data {
     uint64_t num_objects[kVulkanObjectTypeMax + 1];
     uint64_t num_total_objects;
 
+    object_tracker_options options;
+    // The most objects of each type there have been, and the counts at the last summary
+    uint64_t max_objects[kVulkanObjectTypeMax + 1];
+    uint64_t summary_objects[kVulkanObjectTypeMax + 1];
+    uint64_t frame_count;
+    uint64_t sample_countdown;
+    // The sampled objects that still exist, by handle
+    std::unordered_map<uint64_t, SampledObject> sampled_objects;
+
     debug_report_data *report_data;
     std::vector<VkDebugReportCallbackEXT> logging_callback;
     // The following are for keeping track of the temporary callbacks that can
@@ -104,10 +237,10 @@ struct layer_data {
 
     std::vector<VkQueueFamilyProperties> queue_family_properties;
 
-    // Vector of unordered_maps per object type to hold ObjTrackState info
-    std::vector<object_map_type> object_map;
+    // ObjTrackState info of each object type
+    object_map_type object_map[kVulkanObjectTypeMax + 1];
     // Special-case map for swapchain images
-    std::unordered_map<uint64_t, ObjTrackState *> swapchainImageMap;
+    object_map_type swapchainImageMap;
     // Map of queue information structures, one per queue
     std::unordered_map<VkQueue, ObjTrackQueueInfo *> queue_info_map;
 
@@ -118,20 +251,23 @@ struct layer_data {
           physical_device(nullptr),
           num_objects{},
           num_total_objects(0),
+          options{},
+          max_objects{},
+          summary_objects{},
+          frame_count(0),
+          sample_countdown(0),
           report_data(nullptr),
           num_tmp_callbacks(0),
           tmp_dbg_create_infos(nullptr),
           tmp_callbacks(nullptr),
-          object_map{},
-          dispatch_table{} {
-        object_map.resize(kVulkanObjectTypeMax + 1);
-    }
+          dispatch_table{} {}
 };
 
 extern std::unordered_map<void *, layer_data *> layer_data_map;
 extern device_table_map ot_device_table_map;
 extern instance_table_map ot_instance_table_map;
 extern std::mutex global_lock;
+extern ObjTrackStateAllocator obj_track_state_allocator;
 extern uint64_t object_track_index;
 extern uint32_t loader_layer_if_version;
 extern const std::unordered_map<std::string, void *> name_to_funcptr_map;
@@ -145,7 +281,69 @@ void AllocateCommandBuffer(VkDevice device, const VkCommandPool command_pool, co
 void AllocateDescriptorSet(VkDevice device, VkDescriptorPool descriptor_pool, VkDescriptorSet descriptor_set);
 void CreateSwapchainImageObject(VkDevice dispatchable_object, VkImage swapchain_image, VkSwapchainKHR swapchain);
 void ReportUndestroyedObjects(VkDevice device, UNIQUE_VALIDATION_ERROR_CODE error_code);
+void ReportUndestroyedObjectCounts(VkDevice device, UNIQUE_VALIDATION_ERROR_CODE error_code);
+void SampleObjectCreation(layer_data *device_data, VulkanObjectType object_type, uint64_t object_handle);
+// Called after every vkQueuePresentKHR, reports the live objects every summary_frames frames
+void EndObjectTrackerFrame(VkQueue queue);
+
+// Whether objects of object_type are only counted, see summary_only. Objects freed along with a pool or swapchain, the objects
+// owning them, and the dispatchable objects are still tracked.
+static inline bool IsObjectTypeCountedOnly(const layer_data *device_data, VulkanObjectType object_type) {
+    if (!device_data->options.summary_only) return false;
+    switch (object_type) {
+        case kVulkanObjectTypeInstance:
+        case kVulkanObjectTypePhysicalDevice:
+        case kVulkanObjectTypeDevice:
+        case kVulkanObjectTypeQueue:
+        case kVulkanObjectTypeCommandBuffer:
+        case kVulkanObjectTypeCommandPool:
+        case kVulkanObjectTypeDescriptorSet:
+        case kVulkanObjectTypeDescriptorPool:
+        case kVulkanObjectTypeSwapchainKHR:
+            return false;
+        default:
+            return true;
+    }
+}
+
+// Counts a new object and samples its creation. Must hold global_lock.
+static inline void CountObjectCreation(layer_data *device_data, VulkanObjectType object_type, uint64_t object_handle) {
+    device_data->num_objects[object_type]++;
+    device_data->num_total_objects++;
+    if (device_data->num_objects[object_type] > device_data->max_objects[object_type]) {
+        device_data->max_objects[object_type] = device_data->num_objects[object_type];
+    }
+    if (device_data->options.creation_sample_rate && device_data->sample_countdown-- == 0) {
+        device_data->sample_countdown = device_data->options.creation_sample_rate - 1;
+        SampleObjectCreation(device_data, object_type, object_handle);
+    }
+}
 
+// Adds child to the objects allocated from parent. Must hold global_lock.
+static inline void LinkChildObject(ObjTrackState *parent, ObjTrackState *child) {
+    child->parent_node = parent;
+    child->prev_sibling = nullptr;
+    child->next_sibling = parent->first_child;
+    if (parent->first_child) parent->first_child->prev_sibling = child;
+    parent->first_child = child;
+}
+
+// Returns a node that has been removed from its object map to obj_track_state_allocator, taking it out of its parent's
+// children and leaving its own children without a parent. Must hold global_lock.
+static inline void FreeObjTrackState(ObjTrackState *node) {
+    if (node->parent_node) {
+        if (node->prev_sibling) {
+            node->prev_sibling->next_sibling = node->next_sibling;
+        } else {
+            node->parent_node->first_child = node->next_sibling;
+        }
+        if (node->next_sibling) node->next_sibling->prev_sibling = node->prev_sibling;
+    }
+    for (ObjTrackState *child = node->first_child; child; child = child->next_sibling) {
+        child->parent_node = nullptr;
+    }
+    obj_track_state_allocator.free(node);
+}
 
 template <typename T1, typename T2>
 bool ValidateObject(T1 dispatchable_object, T2 object, VulkanObjectType object_type, bool null_allowed,
@@ -157,18 +355,17 @@ bool ValidateObject(T1 dispatchable_object, T2 object, VulkanObjectType object_t
     VkDebugReportObjectTypeEXT debug_object_type = get_debug_report_enum[object_type];
 
     layer_data *device_data = GetLayerDataPtr(get_dispatch_key(dispatchable_object), layer_data_map);
+    if (IsObjectTypeCountedOnly(device_data, object_type)) return false;
     // Look for object in device object map
-    if (device_data->object_map[object_type].find(object_handle) == device_data->object_map[object_type].end()) {
+    if (!device_data->object_map[object_type].contains(object_handle)) {
         // If object is an image, also look for it in the swapchain image map
-        if ((object_type != kVulkanObjectTypeImage) ||
-            (device_data->swapchainImageMap.find(object_handle) == device_data->swapchainImageMap.end())) {
+        if ((object_type != kVulkanObjectTypeImage) || !device_data->swapchainImageMap.contains(object_handle)) {
             // Object not found, look for it in other device object maps
             for (auto other_device_data : layer_data_map) {
                 if (other_device_data.second != device_data) {
-                    if (other_device_data.second->object_map[object_type].find(object_handle) !=
-                            other_device_data.second->object_map[object_type].end() ||
-                        (object_type == kVulkanObjectTypeImage && other_device_data.second->swapchainImageMap.find(object_handle) !=
-                                                                      other_device_data.second->swapchainImageMap.end())) {
+                    if (other_device_data.second->object_map[object_type].contains(object_handle) ||
+                        (object_type == kVulkanObjectTypeImage &&
+                         other_device_data.second->swapchainImageMap.contains(object_handle))) {
                         // Object found on other device, report an error if object has a device parent error code
                         if ((wrong_device_code != VALIDATION_ERROR_UNDEFINED) && (object_type != kVulkanObjectTypeSurfaceKHR)) {
                             return log_msg(device_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, debug_object_type,
@@ -198,20 +395,23 @@ void CreateObject(T1 dispatchable_object, T2 object, VulkanObjectType object_typ
     auto object_handle = HandleToUint64(object);
     bool custom_allocator = pAllocator != nullptr;
 
-    if (!instance_data->object_map[object_type].count(object_handle)) {
+    if (IsObjectTypeCountedOnly(instance_data, object_type)) {
+        CountObjectCreation(instance_data, object_type, object_handle);
+        return;
+    }
+    if (!instance_data->object_map[object_type].contains(object_handle)) {
         VkDebugReportObjectTypeEXT debug_object_type = get_debug_report_enum[object_type];
         log_msg(instance_data->report_data, VK_DEBUG_REPORT_INFORMATION_BIT_EXT, debug_object_type, object_handle, __LINE__,
                 OBJTRACK_NONE, LayerName, "OBJ[0x%" PRIxLEAST64 "] : CREATE %s object 0x%" PRIxLEAST64, object_track_index++,
                 object_string[object_type], object_handle);
 
-        ObjTrackState *pNewObjNode = new ObjTrackState;
+        ObjTrackState *pNewObjNode = obj_track_state_allocator.allocate();
         pNewObjNode->object_type = object_type;
         pNewObjNode->status = custom_allocator ? OBJSTATUS_CUSTOM_ALLOCATOR : OBJSTATUS_NONE;
         pNewObjNode->handle = object_handle;
 
-        instance_data->object_map[object_type][object_handle] = pNewObjNode;
-        instance_data->num_objects[object_type]++;
-        instance_data->num_total_objects++;
+        instance_data->object_map[object_type].insert(object_handle, pNewObjNode);
+        CountObjectCreation(instance_data, object_type, object_handle);
     }
 }
 
@@ -225,10 +425,23 @@ void DestroyObject(T1 dispatchable_object, T2 object, VulkanObjectType object_ty
     bool custom_allocator = pAllocator != nullptr;
     VkDebugReportObjectTypeEXT debug_object_type = get_debug_report_enum[object_type];
 
+    if (object_handle != VK_NULL_HANDLE && !device_data->sampled_objects.empty()) {
+        auto sample = device_data->sampled_objects.find(object_handle);
+        if (sample != device_data->sampled_objects.end() && sample->second.object_type == object_type) {
+            device_data->sampled_objects.erase(sample);
+        }
+    }
+    if (IsObjectTypeCountedOnly(device_data, object_type)) {
+        // Objects destroyed twice aren't noticed, don't let them wrap the counts around
+        if (object_handle != VK_NULL_HANDLE && device_data->num_objects[object_type] > 0) {
+            device_data->num_objects[object_type]--;
+            device_data->num_total_objects--;
+        }
+        return;
+    }
     if (object_handle != VK_NULL_HANDLE) {
-        auto item = device_data->object_map[object_type].find(object_handle);
-        if (item != device_data->object_map[object_type].end()) {
-            ObjTrackState *pNode = item->second;
+        ObjTrackState *pNode = device_data->object_map[object_type].erase(object_handle);
+        if (pNode) {
             assert(device_data->num_total_objects > 0);
             device_data->num_total_objects--;
             assert(device_data->num_objects[pNode->object_type] > 0);
@@ -256,8 +469,7 @@ void DestroyObject(T1 dispatchable_object, T2 object, VulkanObjectType object_ty
                         object_string[object_type], object_handle, validation_error_map[expected_default_allocator_code]);
             }
 
-            delete pNode;
-            device_data->object_map[object_type].erase(item);
+            FreeObjTrackState(pNode);
         } else {
             log_msg(device_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_UNKNOWN_EXT, object_handle,
                     __LINE__, OBJTRACK_UNKNOWN_OBJECT, LayerName,
@@ -20,19 +20,153 @@
  * Author: Tobin Ehlis <tobin@lunarg.com>
  */
 
+#include <algorithm>
+#include <map>
+#include <string>
+
 #include "object_tracker.h"
 
+#if defined(__linux__) && !defined(__ANDROID__)
+#include <execinfo.h>
+#endif
+
 namespace object_tracker {
 
 std::unordered_map<void *, layer_data *> layer_data_map;
 device_table_map ot_device_table_map;
 instance_table_map ot_instance_table_map;
 std::mutex global_lock;
+ObjTrackStateAllocator obj_track_state_allocator;
 uint64_t object_track_index = 0;
 uint32_t loader_layer_if_version = CURRENT_LOADER_LAYER_INTERFACE_VERSION;
 
+static const LayerOptionDefinition object_tracker_option_definitions[] = {
+    {"summary_frames", LAYER_OPTION_UINT, offsetof(object_tracker_options, summary_frames), "0"},
+    {"summary_only", LAYER_OPTION_BOOL, offsetof(object_tracker_options, summary_only), "false"},
+    {"creation_sample_rate", LAYER_OPTION_UINT, offsetof(object_tracker_options, creation_sample_rate), "0"},
+};
+
 void InitObjectTracker(layer_data *my_data, const VkAllocationCallbacks *pAllocator) {
     layer_debug_actions(my_data->report_data, my_data->logging_callback, pAllocator, "lunarg_object_tracker");
+    ReadLayerOptions("lunarg_object_tracker", object_tracker_option_definitions,
+                     sizeof(object_tracker_option_definitions) / sizeof(object_tracker_option_definitions[0]), &my_data->options);
+}
+
+// Frames of the creation call stacks that are kept, after skipping the ones in the layer
+static const int sampled_stack_depth = 16;
+static const int sampled_stack_skip = 2;
+
+void SampleObjectCreation(layer_data *device_data, VulkanObjectType object_type, uint64_t object_handle) {
+    SampledObject &sample = device_data->sampled_objects[object_handle];
+    sample.object_type = object_type;
+    sample.frame = device_data->frame_count;
+    sample.creation_stack.clear();
+    void *frames[sampled_stack_depth + sampled_stack_skip];
+    int frame_count = 0;
+#if defined(__linux__) && !defined(__ANDROID__)
+    frame_count = backtrace(frames, sampled_stack_depth + sampled_stack_skip);
+#elif defined(_WIN32)
+    frame_count = CaptureStackBackTrace(0, sampled_stack_depth + sampled_stack_skip, frames, NULL);
+#endif
+    if (frame_count > sampled_stack_skip) {
+        sample.creation_stack.assign(frames + sampled_stack_skip, frames + frame_count);
+    }
+}
+
+static std::string CreationStackString(const std::vector<void *> &stack) {
+    std::string result;
+#if defined(__linux__) && !defined(__ANDROID__)
+    char **symbols = stack.empty() ? nullptr : backtrace_symbols(stack.data(), static_cast<int>(stack.size()));
+#endif
+    for (size_t i = 0; i < stack.size(); ++i) {
+        char frame[32];
+        snprintf(frame, sizeof(frame), "%p", stack[i]);
+        result += "\n    ";
+#if defined(__linux__) && !defined(__ANDROID__)
+        if (symbols) {
+            result += symbols[i];
+            continue;
+        }
+#endif
+        result += frame;
+    }
+#if defined(__linux__) && !defined(__ANDROID__)
+    free(symbols);
+#endif
+    if (result.empty()) result = "\n    (no call stack)";
+    return result;
+}
+
+// Reports the creation sites of the sampled objects that still exist, those with the most objects first
+static void ReportSampledObjects(layer_data *device_data, VkDebugReportFlagsEXT msg_flags, VkDebugReportObjectTypeEXT report_type,
+                                 uint64_t report_handle, ObjectTrackerError error_code, size_t max_sites) {
+    struct CreationSite {
+        uint64_t count;
+        uint64_t oldest_frame;
+    };
+    std::map<std::pair<VulkanObjectType, std::vector<void *>>, CreationSite> sites;
+    for (const auto &sample : device_data->sampled_objects) {
+        auto key = std::make_pair(sample.second.object_type, sample.second.creation_stack);
+        auto site = sites.find(key);
+        if (site == sites.end()) {
+            sites.emplace(std::move(key), CreationSite{1, sample.second.frame});
+        } else {
+            site->second.count++;
+            site->second.oldest_frame = std::min(site->second.oldest_frame, sample.second.frame);
+        }
+    }
+    std::vector<decltype(sites)::const_iterator> ordered;
+    for (auto site = sites.cbegin(); site != sites.cend(); ++site) {
+        ordered.push_back(site);
+    }
+    std::sort(ordered.begin(), ordered.end(), [](decltype(sites)::const_iterator a, decltype(sites)::const_iterator b) {
+        return a->second.count > b->second.count;
+    });
+    if (ordered.size() > max_sites) ordered.resize(max_sites);
+    for (auto site : ordered) {
+        log_msg(device_data->report_data, msg_flags, report_type, report_handle, __LINE__, error_code, LayerName,
+                "%" PRIu64 " sampled %s objects, the oldest created in frame %" PRIu64 ", are still alive. They were created at:%s",
+                site->second.count, object_string[site->first.first], site->second.oldest_frame,
+                CreationStackString(site->first.second).c_str());
+    }
+}
+
+void EndObjectTrackerFrame(VkQueue queue) {
+    std::lock_guard<std::mutex> lock(global_lock);
+    layer_data *device_data = GetLayerDataPtr(get_dispatch_key(queue), layer_data_map);
+    device_data->frame_count++;
+    if (!device_data->options.summary_frames || device_data->frame_count % device_data->options.summary_frames) return;
+
+    for (uint32_t object_type = 0; object_type <= kVulkanObjectTypeMax; ++object_type) {
+        uint64_t count = device_data->num_objects[object_type];
+        if (!count && !device_data->summary_objects[object_type]) continue;
+        log_msg(device_data->report_data, VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_QUEUE_EXT,
+                HandleToUint64(queue), __LINE__, OBJTRACK_OBJECT_SUMMARY, LayerName,
+                "OBJ_STAT Frame %" PRIu64 ": %" PRIu64 " %s objects, %+" PRId64 " since the last summary, at most %" PRIu64 ".",
+                device_data->frame_count, count, object_string[object_type],
+                static_cast<int64_t>(count - device_data->summary_objects[object_type]), device_data->max_objects[object_type]);
+        device_data->summary_objects[object_type] = count;
+    }
+    ReportSampledObjects(device_data, VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_QUEUE_EXT,
+                         HandleToUint64(queue), OBJTRACK_OBJECT_SUMMARY, 8);
+}
+
+void ReportUndestroyedObjectCounts(VkDevice device, UNIQUE_VALIDATION_ERROR_CODE error_code) {
+    layer_data *device_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    for (uint32_t object_type = 0; object_type <= kVulkanObjectTypeMax; ++object_type) {
+        if (!IsObjectTypeCountedOnly(device_data, static_cast<VulkanObjectType>(object_type)) ||
+            !device_data->num_objects[object_type]) {
+            continue;
+        }
+        log_msg(device_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_DEVICE_EXT,
+                HandleToUint64(device), __LINE__, error_code, LayerName,
+                "OBJ ERROR : For device 0x%" PRIxLEAST64 ", %" PRIu64 " %s objects have not been destroyed. %s",
+                HandleToUint64(device), device_data->num_objects[object_type], object_string[object_type],
+                validation_error_map[error_code]);
+    }
+    ReportSampledObjects(device_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_DEVICE_EXT,
+                         HandleToUint64(device), OBJTRACK_OBJECT_LEAK, SIZE_MAX);
+    device_data->sampled_objects.clear();
 }
 
 // Add new queue to head of global queue list
@@ -64,19 +198,18 @@ void DestroyQueueDataStructures(VkDevice device) {
     device_data->queue_info_map.clear();
 
     // Destroy the items in the queue map
-    auto queue = device_data->object_map[kVulkanObjectTypeQueue].begin();
-    while (queue != device_data->object_map[kVulkanObjectTypeQueue].end()) {
-        uint32_t obj_index = queue->second->object_type;
+    for (auto queue : device_data->object_map[kVulkanObjectTypeQueue].nodes()) {
+        uint32_t obj_index = queue->object_type;
         assert(device_data->num_total_objects > 0);
         device_data->num_total_objects--;
         assert(device_data->num_objects[obj_index] > 0);
         device_data->num_objects[obj_index]--;
         log_msg(device_data->report_data, VK_DEBUG_REPORT_INFORMATION_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_QUEUE_EXT,
-                queue->second->handle, __LINE__, OBJTRACK_NONE, LayerName,
+                queue->handle, __LINE__, OBJTRACK_NONE, LayerName,
                 "OBJ_STAT Destroy Queue obj 0x%" PRIxLEAST64 " (%" PRIu64 " total objs remain & %" PRIu64 " Queue objs).",
-                queue->second->handle, device_data->num_total_objects, device_data->num_objects[obj_index]);
-        delete queue->second;
-        queue = device_data->object_map[kVulkanObjectTypeQueue].erase(queue);
+                queue->handle, device_data->num_total_objects, device_data->num_objects[obj_index]);
+        device_data->object_map[kVulkanObjectTypeQueue].erase(queue->handle);
+        FreeObjTrackState(queue);
     }
 }
 
@@ -108,28 +241,27 @@ void AllocateCommandBuffer(VkDevice device, const VkCommandPool command_pool, co
             "OBJ[0x%" PRIxLEAST64 "] : CREATE %s object 0x%" PRIxLEAST64, object_track_index++,
             "VK_DEBUG_REPORT_OBJECT_TYPE_COMMAND_BUFFER_EXT", HandleToUint64(command_buffer));
 
-    ObjTrackState *pNewObjNode = new ObjTrackState;
+    ObjTrackState *pNewObjNode = obj_track_state_allocator.allocate();
     pNewObjNode->object_type = kVulkanObjectTypeCommandBuffer;
     pNewObjNode->handle = HandleToUint64(command_buffer);
     pNewObjNode->parent_object = HandleToUint64(command_pool);
+    ObjTrackState *pool_node = device_data->object_map[kVulkanObjectTypeCommandPool].find(HandleToUint64(command_pool));
+    if (pool_node) LinkChildObject(pool_node, pNewObjNode);
     if (level == VK_COMMAND_BUFFER_LEVEL_SECONDARY) {
         pNewObjNode->status = OBJSTATUS_COMMAND_BUFFER_SECONDARY;
     } else {
         pNewObjNode->status = OBJSTATUS_NONE;
     }
-    device_data->object_map[kVulkanObjectTypeCommandBuffer][HandleToUint64(command_buffer)] = pNewObjNode;
-    device_data->num_objects[kVulkanObjectTypeCommandBuffer]++;
-    device_data->num_total_objects++;
+    device_data->object_map[kVulkanObjectTypeCommandBuffer].insert(HandleToUint64(command_buffer), pNewObjNode);
+    CountObjectCreation(device_data, kVulkanObjectTypeCommandBuffer, HandleToUint64(command_buffer));
 }
 
 bool ValidateCommandBuffer(VkDevice device, VkCommandPool command_pool, VkCommandBuffer command_buffer) {
     layer_data *device_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
     bool skip = false;
     uint64_t object_handle = HandleToUint64(command_buffer);
-    if (device_data->object_map[kVulkanObjectTypeCommandBuffer].find(object_handle) !=
-        device_data->object_map[kVulkanObjectTypeCommandBuffer].end()) {
-        ObjTrackState *pNode = device_data->object_map[kVulkanObjectTypeCommandBuffer][HandleToUint64(command_buffer)];
-
+    ObjTrackState *pNode = device_data->object_map[kVulkanObjectTypeCommandBuffer].find(object_handle);
+    if (pNode) {
         if (pNode->parent_object != HandleToUint64(command_pool)) {
             skip |= log_msg(device_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_COMMAND_BUFFER_EXT,
                             object_handle, __LINE__, VALIDATION_ERROR_28411407, LayerName,
@@ -155,24 +287,23 @@ void AllocateDescriptorSet(VkDevice device, VkDescriptorPool descriptor_pool, Vk
             "OBJ[0x%" PRIxLEAST64 "] : CREATE %s object 0x%" PRIxLEAST64, object_track_index++,
             "VK_DEBUG_REPORT_OBJECT_TYPE_DESCRIPTOR_SET_EXT", HandleToUint64(descriptor_set));
 
-    ObjTrackState *pNewObjNode = new ObjTrackState;
+    ObjTrackState *pNewObjNode = obj_track_state_allocator.allocate();
     pNewObjNode->object_type = kVulkanObjectTypeDescriptorSet;
     pNewObjNode->status = OBJSTATUS_NONE;
     pNewObjNode->handle = HandleToUint64(descriptor_set);
     pNewObjNode->parent_object = HandleToUint64(descriptor_pool);
-    device_data->object_map[kVulkanObjectTypeDescriptorSet][HandleToUint64(descriptor_set)] = pNewObjNode;
-    device_data->num_objects[kVulkanObjectTypeDescriptorSet]++;
-    device_data->num_total_objects++;
+    ObjTrackState *pool_node = device_data->object_map[kVulkanObjectTypeDescriptorPool].find(HandleToUint64(descriptor_pool));
+    if (pool_node) LinkChildObject(pool_node, pNewObjNode);
+    device_data->object_map[kVulkanObjectTypeDescriptorSet].insert(HandleToUint64(descriptor_set), pNewObjNode);
+    CountObjectCreation(device_data, kVulkanObjectTypeDescriptorSet, HandleToUint64(descriptor_set));
 }
 
 bool ValidateDescriptorSet(VkDevice device, VkDescriptorPool descriptor_pool, VkDescriptorSet descriptor_set) {
     layer_data *device_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
     bool skip = false;
     uint64_t object_handle = HandleToUint64(descriptor_set);
-    auto dsItem = device_data->object_map[kVulkanObjectTypeDescriptorSet].find(object_handle);
-    if (dsItem != device_data->object_map[kVulkanObjectTypeDescriptorSet].end()) {
-        ObjTrackState *pNode = dsItem->second;
-
+    ObjTrackState *pNode = device_data->object_map[kVulkanObjectTypeDescriptorSet].find(object_handle);
+    if (pNode) {
         if (pNode->parent_object != HandleToUint64(descriptor_pool)) {
             skip |= log_msg(device_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_DESCRIPTOR_SET_EXT,
                             object_handle, __LINE__, VALIDATION_ERROR_28613007, LayerName,
@@ -195,7 +326,6 @@ VKAPI_ATTR void VKAPI_CALL CmdPushDescriptorSetKHR(VkCommandBuffer commandBuffer
                                                    const VkWriteDescriptorSet *pDescriptorWrites) {
     bool skip = false;
     {
-        std::lock_guard<std::mutex> lock(global_lock);
         skip |= ValidateObject(commandBuffer, commandBuffer, kVulkanObjectTypeCommandBuffer, false, VALIDATION_ERROR_1be02401,
                                VALIDATION_ERROR_1be00009);
         skip |= ValidateObject(commandBuffer, layout, kVulkanObjectTypePipelineLayout, false, VALIDATION_ERROR_1be0be01,
@@ -241,15 +371,11 @@ void CreateQueue(VkDevice device, VkQueue vkObj) {
             HandleToUint64(vkObj), __LINE__, OBJTRACK_NONE, LayerName, "OBJ[0x%" PRIxLEAST64 "] : CREATE %s object 0x%" PRIxLEAST64,
             object_track_index++, "VK_DEBUG_REPORT_OBJECT_TYPE_QUEUE_EXT", HandleToUint64(vkObj));
 
-    ObjTrackState *p_obj_node = NULL;
-    auto queue_item = device_data->object_map[kVulkanObjectTypeQueue].find(HandleToUint64(vkObj));
-    if (queue_item == device_data->object_map[kVulkanObjectTypeQueue].end()) {
-        p_obj_node = new ObjTrackState;
-        device_data->object_map[kVulkanObjectTypeQueue][HandleToUint64(vkObj)] = p_obj_node;
-        device_data->num_objects[kVulkanObjectTypeQueue]++;
-        device_data->num_total_objects++;
-    } else {
-        p_obj_node = queue_item->second;
+    ObjTrackState *p_obj_node = device_data->object_map[kVulkanObjectTypeQueue].find(HandleToUint64(vkObj));
+    if (!p_obj_node) {
+        p_obj_node = obj_track_state_allocator.allocate();
+        device_data->object_map[kVulkanObjectTypeQueue].insert(HandleToUint64(vkObj), p_obj_node);
+        CountObjectCreation(device_data, kVulkanObjectTypeQueue, HandleToUint64(vkObj));
     }
     p_obj_node->object_type = kVulkanObjectTypeQueue;
     p_obj_node->status = OBJSTATUS_NONE;
@@ -263,23 +389,25 @@ void CreateSwapchainImageObject(VkDevice dispatchable_object, VkImage swapchain_
             "OBJ[0x%" PRIxLEAST64 "] : CREATE %s object 0x%" PRIxLEAST64, object_track_index++, "SwapchainImage",
             HandleToUint64(swapchain_image));
 
-    ObjTrackState *pNewObjNode = new ObjTrackState;
+    ObjTrackState *pNewObjNode = obj_track_state_allocator.allocate();
     pNewObjNode->object_type = kVulkanObjectTypeImage;
     pNewObjNode->status = OBJSTATUS_NONE;
     pNewObjNode->handle = HandleToUint64(swapchain_image);
     pNewObjNode->parent_object = HandleToUint64(swapchain);
-    device_data->swapchainImageMap[HandleToUint64(swapchain_image)] = pNewObjNode;
+    ObjTrackState *swapchain_node = device_data->object_map[kVulkanObjectTypeSwapchainKHR].find(HandleToUint64(swapchain));
+    if (swapchain_node) LinkChildObject(swapchain_node, pNewObjNode);
+    device_data->swapchainImageMap.insert(HandleToUint64(swapchain_image), pNewObjNode);
 }
 
 void DeviceReportUndestroyedObjects(VkDevice device, VulkanObjectType object_type, enum UNIQUE_VALIDATION_ERROR_CODE error_code) {
     layer_data *device_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
-    for (auto item = device_data->object_map[object_type].begin(); item != device_data->object_map[object_type].end();) {
-        ObjTrackState *object_info = item->second;
+    for (auto object_info : device_data->object_map[object_type].nodes()) {
         log_msg(device_data->report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, get_debug_report_enum[object_type], object_info->handle,
                 __LINE__, error_code, LayerName,
                 "OBJ ERROR : For device 0x%" PRIxLEAST64 ", %s object 0x%" PRIxLEAST64 " has not been destroyed. %s",
                 HandleToUint64(device), object_string[object_type], object_info->handle, validation_error_map[error_code]);
-        item = device_data->object_map[object_type].erase(item);
+        device_data->object_map[object_type].erase(object_info->handle);
+        FreeObjTrackState(object_info);
     }
 }
 
@@ -302,23 +430,16 @@ VKAPI_ATTR void VKAPI_CALL DestroyInstance(VkInstance instance, const VkAllocati
     ValidateObject(instance, instance, kVulkanObjectTypeInstance, true, VALIDATION_ERROR_2580bc01, VALIDATION_ERROR_UNDEFINED);
 
     // Destroy physical devices
-    for (auto iit = instance_data->object_map[kVulkanObjectTypePhysicalDevice].begin();
-         iit != instance_data->object_map[kVulkanObjectTypePhysicalDevice].end();) {
-        ObjTrackState *pNode = iit->second;
-
+    for (auto pNode : instance_data->object_map[kVulkanObjectTypePhysicalDevice].nodes()) {
         VkPhysicalDevice physical_device = reinterpret_cast<VkPhysicalDevice>(pNode->handle);
         DestroyObject(instance, physical_device, kVulkanObjectTypePhysicalDevice, nullptr, VALIDATION_ERROR_UNDEFINED,
                       VALIDATION_ERROR_UNDEFINED);
-        iit = instance_data->object_map[kVulkanObjectTypePhysicalDevice].begin();
     }
 
     DestroyObject(instance, instance, kVulkanObjectTypeInstance, pAllocator, VALIDATION_ERROR_258004ec, VALIDATION_ERROR_258004ee);
     // Report any remaining objects in LL
 
-    for (auto iit = instance_data->object_map[kVulkanObjectTypeDevice].begin();
-         iit != instance_data->object_map[kVulkanObjectTypeDevice].end();) {
-        ObjTrackState *pNode = iit->second;
-
+    for (auto pNode : instance_data->object_map[kVulkanObjectTypeDevice].nodes()) {
         VkDevice device = reinterpret_cast<VkDevice>(pNode->handle);
         VkDebugReportObjectTypeEXT debug_object_type = get_debug_report_enum[pNode->object_type];
 
@@ -327,6 +448,8 @@ VKAPI_ATTR void VKAPI_CALL DestroyInstance(VkInstance instance, const VkAllocati
                 string_VkDebugReportObjectTypeEXT(debug_object_type), pNode->handle);
 
         ReportUndestroyedObjects(device, VALIDATION_ERROR_258004ea);
+        ReportUndestroyedObjectCounts(device, VALIDATION_ERROR_258004ea);
+        FreeObjTrackState(pNode);
     }
     instance_data->object_map[kVulkanObjectTypeDevice].clear();
 
@@ -364,6 +487,7 @@ VKAPI_ATTR void VKAPI_CALL DestroyDevice(VkDevice device, const VkAllocationCall
 
     // Report any remaining objects associated with this VkDevice object in LL
     ReportUndestroyedObjects(device, VALIDATION_ERROR_24a002f4);
+    ReportUndestroyedObjectCounts(device, VALIDATION_ERROR_24a002f4);
 
     // Clean up Queue's MemRef Linked Lists
     DestroyQueueDataStructures(device);
@@ -514,14 +638,11 @@ VKAPI_ATTR VkResult VKAPI_CALL ResetDescriptorPool(VkDevice device, VkDescriptor
     }
     // A DescriptorPool's descriptor sets are implicitly deleted when the pool is reset.
     // Remove this pool's descriptor sets from our descriptorSet map.
-    auto itr = device_data->object_map[kVulkanObjectTypeDescriptorSet].begin();
-    while (itr != device_data->object_map[kVulkanObjectTypeDescriptorSet].end()) {
-        ObjTrackState *pNode = (*itr).second;
-        auto del_itr = itr++;
-        if (pNode->parent_object == HandleToUint64(descriptorPool)) {
-            DestroyObject(device, (VkDescriptorSet)((*del_itr).first), kVulkanObjectTypeDescriptorSet, nullptr,
-                          VALIDATION_ERROR_UNDEFINED, VALIDATION_ERROR_UNDEFINED);
-        }
+    ObjTrackState *pool_node = device_data->object_map[kVulkanObjectTypeDescriptorPool].find(HandleToUint64(descriptorPool));
+    for (ObjTrackState *pNode = pool_node ? pool_node->first_child : nullptr, *pNext; pNode; pNode = pNext) {
+        pNext = pNode->next_sibling;
+        DestroyObject(device, (VkDescriptorSet)(pNode->handle), kVulkanObjectTypeDescriptorSet, nullptr,
+                      VALIDATION_ERROR_UNDEFINED, VALIDATION_ERROR_UNDEFINED);
     }
     lock.unlock();
     VkResult result = get_dispatch_table(ot_device_table_map, device)->ResetDescriptorPool(device, descriptorPool, flags);
@@ -535,8 +656,8 @@ VKAPI_ATTR VkResult VKAPI_CALL BeginCommandBuffer(VkCommandBuffer command_buffer
         std::lock_guard<std::mutex> lock(global_lock);
         skip |= ValidateObject(command_buffer, command_buffer, kVulkanObjectTypeCommandBuffer, false, VALIDATION_ERROR_16e02401,
                                VALIDATION_ERROR_UNDEFINED);
-        if (begin_info) {
-            ObjTrackState *pNode = device_data->object_map[kVulkanObjectTypeCommandBuffer][HandleToUint64(command_buffer)];
+        ObjTrackState *pNode = device_data->object_map[kVulkanObjectTypeCommandBuffer].find(HandleToUint64(command_buffer));
+        if (begin_info && pNode) {
             if ((begin_info->pInheritanceInfo) && (pNode->status & OBJSTATUS_COMMAND_BUFFER_SECONDARY) &&
                 (begin_info->flags & VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT)) {
                 skip |= ValidateObject(command_buffer, begin_info->pInheritanceInfo->framebuffer, kVulkanObjectTypeFramebuffer,
@@ -650,6 +771,7 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateDevice(VkPhysicalDevice physicalDevice, con
 
     // Add link back to physDev
     device_data->physical_device = physicalDevice;
+    device_data->options = phy_dev_data->options;
 
     initDeviceTable(*pDevice, fpGetDeviceProcAddr, ot_device_table_map);
 
@@ -853,16 +975,11 @@ VKAPI_ATTR void VKAPI_CALL DestroySwapchainKHR(VkDevice device, VkSwapchainKHR s
     std::unique_lock<std::mutex> lock(global_lock);
     // A swapchain's images are implicitly deleted when the swapchain is deleted.
     // Remove this swapchain's images from our map of such images.
-    std::unordered_map<uint64_t, ObjTrackState *>::iterator itr = device_data->swapchainImageMap.begin();
-    while (itr != device_data->swapchainImageMap.end()) {
-        ObjTrackState *pNode = (*itr).second;
-        if (pNode->parent_object == HandleToUint64(swapchain)) {
-            delete pNode;
-            auto delete_item = itr++;
-            device_data->swapchainImageMap.erase(delete_item);
-        } else {
-            ++itr;
-        }
+    ObjTrackState *swapchain_node = device_data->object_map[kVulkanObjectTypeSwapchainKHR].find(HandleToUint64(swapchain));
+    for (ObjTrackState *pNode = swapchain_node ? swapchain_node->first_child : nullptr, *pNext; pNode; pNode = pNext) {
+        pNext = pNode->next_sibling;
+        device_data->swapchainImageMap.erase(pNode->handle);
+        FreeObjTrackState(pNode);
     }
     DestroyObject(device, swapchain, kVulkanObjectTypeSwapchainKHR, pAllocator, VALIDATION_ERROR_26e00a06,
                   VALIDATION_ERROR_26e00a08);
@@ -913,14 +1030,11 @@ VKAPI_ATTR void VKAPI_CALL DestroyDescriptorPool(VkDevice device, VkDescriptorPo
     // A DescriptorPool's descriptor sets are implicitly deleted when the pool is deleted.
     // Remove this pool's descriptor sets from our descriptorSet map.
     lock.lock();
-    std::unordered_map<uint64_t, ObjTrackState *>::iterator itr = device_data->object_map[kVulkanObjectTypeDescriptorSet].begin();
-    while (itr != device_data->object_map[kVulkanObjectTypeDescriptorSet].end()) {
-        ObjTrackState *pNode = (*itr).second;
-        auto del_itr = itr++;
-        if (pNode->parent_object == HandleToUint64(descriptorPool)) {
-            DestroyObject(device, (VkDescriptorSet)((*del_itr).first), kVulkanObjectTypeDescriptorSet, nullptr,
-                          VALIDATION_ERROR_UNDEFINED, VALIDATION_ERROR_UNDEFINED);
-        }
+    ObjTrackState *pool_node = device_data->object_map[kVulkanObjectTypeDescriptorPool].find(HandleToUint64(descriptorPool));
+    for (ObjTrackState *pNode = pool_node ? pool_node->first_child : nullptr, *pNext; pNode; pNode = pNext) {
+        pNext = pNode->next_sibling;
+        DestroyObject(device, (VkDescriptorSet)(pNode->handle), kVulkanObjectTypeDescriptorSet, nullptr,
+                      VALIDATION_ERROR_UNDEFINED, VALIDATION_ERROR_UNDEFINED);
     }
     DestroyObject(device, descriptorPool, kVulkanObjectTypeDescriptorPool, pAllocator, VALIDATION_ERROR_24400260,
                   VALIDATION_ERROR_24400262);
@@ -942,16 +1056,13 @@ VKAPI_ATTR void VKAPI_CALL DestroyCommandPool(VkDevice device, VkCommandPool com
     lock.lock();
     // A CommandPool's command buffers are implicitly deleted when the pool is deleted.
     // Remove this pool's cmdBuffers from our cmd buffer map.
-    auto itr = device_data->object_map[kVulkanObjectTypeCommandBuffer].begin();
-    auto del_itr = itr;
-    while (itr != device_data->object_map[kVulkanObjectTypeCommandBuffer].end()) {
-        ObjTrackState *pNode = (*itr).second;
-        del_itr = itr++;
-        if (pNode->parent_object == HandleToUint64(commandPool)) {
-            skip |= ValidateCommandBuffer(device, commandPool, reinterpret_cast<VkCommandBuffer>((*del_itr).first));
-            DestroyObject(device, reinterpret_cast<VkCommandBuffer>((*del_itr).first), kVulkanObjectTypeCommandBuffer, nullptr,
-                          VALIDATION_ERROR_UNDEFINED, VALIDATION_ERROR_UNDEFINED);
-        }
+    ObjTrackState *pool_node = device_data->object_map[kVulkanObjectTypeCommandPool].find(HandleToUint64(commandPool));
+    for (ObjTrackState *pNode = pool_node ? pool_node->first_child : nullptr, *pNext; pNode; pNode = pNext) {
+        pNext = pNode->next_sibling;
+        VkCommandBuffer command_buffer = reinterpret_cast<VkCommandBuffer>(pNode->handle);
+        skip |= ValidateCommandBuffer(device, commandPool, command_buffer);
+        DestroyObject(device, command_buffer, kVulkanObjectTypeCommandBuffer, nullptr, VALIDATION_ERROR_UNDEFINED,
+                      VALIDATION_ERROR_UNDEFINED);
     }
     DestroyObject(device, commandPool, kVulkanObjectTypeCommandPool, pAllocator, VALIDATION_ERROR_24000054,
                   VALIDATION_ERROR_24000056);
@@ -1037,6 +1148,9 @@ VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetInstanceProcAddr(VkInstance instance
 
 }  // namespace object_tracker
 
+// In the combined validation layer combined_validation.cpp provides the loader-layer interface
+#ifndef VK_LAYER_COMBINED
+
 VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceExtensionProperties(const char *pLayerName, uint32_t *pCount,
                                                                                       VkExtensionProperties *pProperties) {
     return object_tracker::EnumerateInstanceExtensionProperties(pLayerName, pCount, pProperties);
@@ -1094,3 +1208,5 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
 
     return VK_SUCCESS;
 }
+
+#endif  // VK_LAYER_COMBINED
@@ -19,9 +19,10 @@
 #define PARAMETER_NAME_H
 
 #include <cassert>
+#include <cstring>
+#include <initializer_list>
 #include <sstream>
 #include <string>
-#include <vector>
 
 /**
  * Parameter name string supporting deferred formatting for array subscripts.
@@ -36,19 +37,36 @@
  *         sprintf(name, "pCreateInfo[%d].sType", i);
  *         validate_stype(name, pCreateInfo[i].sType);
  *
- * With the ParameterName class, a format string and a vector of format values are stored by the ParameterName object that is
+ * With the ParameterName class, a format string and up to MaxIndices format values are stored by the ParameterName object that is
  * provided to the validation function.  String formatting is then performed only when the validation function retrieves the
  * name string from the ParameterName object:
  *         validate_stype(ParameterName("pCreateInfo[%i].sType", IndexVector{ i }), pCreateInfo[i].sType);
  */
 class ParameterName {
    public:
-    /// Container for index values to be used with parameter name string formatting.
-    typedef std::vector<size_t> IndexVector;
+    /// Most array subscripts a parameter name can have.
+    static const size_t MaxIndices = 4;
+
+    /// Container for index values to be used with parameter name string formatting.  The values are held inline, so that the
+    /// names of array elements can be built for every element of large arrays without allocating.
+    class IndexVector {
+       public:
+        IndexVector(std::initializer_list<size_t> values) : size_(0) {
+            assert(values.size() <= MaxIndices);
+            for (size_t value : values) {
+                if (size_ < MaxIndices) values_[size_++] = value;
+            }
+        }
 
-    /// Format specifier for the parameter name string, to be replaced by an index value.  The parameter name string must contain
-    /// one format specifier for each index value specified.
-    const std::string IndexFormatSpecifier = "%i";
+        const size_t *begin() const { return values_; }
+        const size_t *end() const { return values_ + size_; }
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+
+       private:
+        size_t values_[MaxIndices];
+        size_t size_;
+    };
 
    public:
     /**
@@ -58,16 +76,7 @@ class ParameterName {
      *
      * @pre The source string must not contain the %i format specifier.
      */
-    ParameterName(const char *source) : source_(source) { assert(IsValid()); }
-
-    /**
-    * Construct a ParameterName object from a std::string object, without formatting.
-    *
-    * @param source Paramater name string without format specifiers.
-    *
-    * @pre The source string must not contain the %i format specifier.
-    */
-    ParameterName(const std::string &source) : source_(source) { assert(IsValid()); }
+    ParameterName(const char *source) : literal_(source), args_({}) { assert(IsValid()); }
 
     /**
     * Construct a ParameterName object from a std::string object, without formatting.
@@ -76,10 +85,10 @@ class ParameterName {
     *
     * @pre The source string must not contain the %i format specifier.
     */
-    ParameterName(const std::string &&source) : source_(std::move(source)) { assert(IsValid()); }
+    ParameterName(std::string source) : literal_(nullptr), source_(std::move(source)), args_({}) { assert(IsValid()); }
 
     /**
-    * Construct a ParameterName object from a std::string object, with formatting.
+    * Construct a ParameterName object from a string literal, with formatting.  The literal isn't copied.
     *
     * @param source Paramater name string with format specifiers.
     * @param args Array index values to be used for formatting.
@@ -87,7 +96,7 @@ class ParameterName {
     * @pre The number of %i format specifiers contained by the source string must match the number of elements contained
     *      by the index vector.
     */
-    ParameterName(const std::string &source, const IndexVector &args) : source_(source), args_(args) { assert(IsValid()); }
+    ParameterName(const char *source, const IndexVector &args) : literal_(source), args_(args) { assert(IsValid()); }
 
     /**
     * Construct a ParameterName object from a std::string object, with formatting.
@@ -98,30 +107,37 @@ class ParameterName {
     * @pre The number of %i format specifiers contained by the source string must match the number of elements contained
     *      by the index vector.
     */
-    ParameterName(const std::string &&source, const IndexVector &&args) : source_(std::move(source)), args_(std::move(args)) {
+    ParameterName(std::string source, const IndexVector &args) : literal_(nullptr), source_(std::move(source)), args_(args) {
         assert(IsValid());
     }
 
     /// Retrive the formatted name string.
-    std::string get_name() const { return (args_.empty()) ? source_ : Format(); }
+    std::string get_name() const { return (args_.empty()) ? std::string(source()) : Format(); }
 
    private:
+    /// Format specifier for the parameter name string, to be replaced by an index value.  The parameter name string must contain
+    /// one format specifier for each index value specified.
+    static const char *IndexFormatSpecifier() { return "%i"; }
+
+    const char *source() const { return literal_ ? literal_ : source_.c_str(); }
+
     /// Replace the %i format specifiers in the source string with the values from the index vector.
     std::string Format() const {
+        std::string source_string(source());
         std::string::size_type current = 0;
         std::string::size_type last = 0;
         std::stringstream format;
 
         for (size_t index : args_) {
-            current = source_.find(IndexFormatSpecifier, last);
+            current = source_string.find(IndexFormatSpecifier(), last);
             if (current == std::string::npos) {
                 break;
             }
-            format << source_.substr(last, (current - last)) << index;
-            last = current + IndexFormatSpecifier.length();
+            format << source_string.substr(last, (current - last)) << index;
+            last = current + 2;
         }
 
-        format << source_.substr(last, std::string::npos);
+        format << source_string.substr(last, std::string::npos);
 
         return format.str();
     }
@@ -130,19 +146,20 @@ class ParameterName {
     bool IsValid() {
         // Count the number of occurances of the format specifier
         uint32_t count = 0;
-        std::string::size_type pos = source_.find(IndexFormatSpecifier);
+        const char *pos = strstr(source(), IndexFormatSpecifier());
 
-        while (pos != std::string::npos) {
+        while (pos != nullptr) {
             ++count;
-            pos = source_.find(IndexFormatSpecifier, pos + 1);
+            pos = strstr(pos + 1, IndexFormatSpecifier());
         }
 
         return (count == args_.size());
     }
 
    private:
-    std::string source_;  ///< Format string.
-    IndexVector args_;    ///< Array index values for formatting.
+    const char *literal_;  ///< Format string when constructed from a literal, which outlives the object.
+    std::string source_;   ///< Format string otherwise.
+    IndexVector args_;     ///< Array index values for formatting.
 };
 
 #endif  // PARAMETER_NAME_H
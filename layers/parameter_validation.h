@@ -520,8 +520,11 @@ static bool validate_struct_pnext(debug_report_data *report_data, const char *ap
                                   const VkStructureType *allowed_types, uint32_t header_version,
                                   UNIQUE_VALIDATION_ERROR_CODE vuid) {
     bool skip_call = false;
-    std::unordered_set<const void *> cycle_check;
-    std::unordered_set<VkStructureType, std::hash<int>> unique_stype_check;
+
+    // Most structures have no chain, and the checks below run for every element of the arrays of structures
+    if (next == NULL) {
+        return skip_call;
+    }
 
     const char disclaimer[] =
         "This warning is based on the Valid Usage documentation for version %d of the Vulkan header.  It "
@@ -539,6 +542,8 @@ static bool validate_struct_pnext(debug_report_data *report_data, const char *ap
                                  vuid, LayerName, message.c_str(), api_name, parameter_name.get_name().c_str(),
                                  validation_error_map[vuid], header_version, parameter_name.get_name().c_str());
         } else {
+            std::unordered_set<const void *> cycle_check;
+            std::unordered_set<VkStructureType, std::hash<int>> unique_stype_check;
             const VkStructureType *start = allowed_types;
             const VkStructureType *end = allowed_types + allowed_type_count;
             const GenericHeader *current = reinterpret_cast<const GenericHeader *>(next);
@@ -632,7 +637,7 @@ static bool validate_bool32(debug_report_data *report_data, const char *apiName,
 * @param apiName Name of API call being validated.
 * @param parameterName Name of parameter being validated.
 * @param enumName Name of the enumeration being validated.
-* @param valid_values The list of valid values for the enumeration.
+* @param valid_values The list of valid values for the enumeration, sorted by value.
 * @param value Enumeration value to validate.
 * @return Boolean value indicating that the call should be skipped.
 */
@@ -641,7 +646,7 @@ bool validate_ranged_enum(debug_report_data *report_data, const char *apiName, c
                           const char *enumName, const std::vector<T> &valid_values, T value, UNIQUE_VALIDATION_ERROR_CODE vuid) {
     bool skip = false;
 
-    if (std::find(valid_values.begin(), valid_values.end(), value) == valid_values.end()) {
+    if (!std::binary_search(valid_values.begin(), valid_values.end(), value)) {
         skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_UNKNOWN_EXT, 0, __LINE__, vuid,
                         LayerName,
                         "%s: value of %s (%d) does not fall within the begin..end range of the core %s "
@@ -667,7 +672,7 @@ bool validate_ranged_enum(debug_report_data *report_data, const char *apiName, c
 * @param countName Name of count parameter.
 * @param arrayName Name of array parameter.
 * @param enumName Name of the enumeration being validated.
-* @param valid_values The list of valid values for the enumeration.
+* @param valid_values The list of valid values for the enumeration, sorted by value.
 * @param count Number of enumeration values in the array.
 * @param array Array of enumeration values to validate.
 * @param countRequired The 'count' parameter may not be 0 when true.
@@ -685,7 +690,7 @@ static bool validate_ranged_enum_array(debug_report_data *report_data, const cha
                                     VALIDATION_ERROR_UNDEFINED, VALIDATION_ERROR_UNDEFINED);
     } else {
         for (uint32_t i = 0; i < count; ++i) {
-            if (std::find(valid_values.begin(), valid_values.end(), array[i]) == valid_values.end()) {
+            if (!std::binary_search(valid_values.begin(), valid_values.end(), array[i])) {
                 skip_call |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_UNKNOWN_EXT, 0,
                                      __LINE__, UNRECOGNIZED_VALUE, LayerName,
                                      "%s: value of %s[%d] (%d) does not fall within the begin..end range of the core %s "
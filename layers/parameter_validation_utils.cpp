@@ -2438,6 +2438,9 @@ void InitializeManualParameterValidationFunctionPointers() {
 
 }  // namespace parameter_validation
 
+// In the combined validation layer combined_validation.cpp provides the loader-layer interface
+#ifndef VK_LAYER_COMBINED
+
 VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceExtensionProperties(const char *pLayerName, uint32_t *pCount,
                                                                                       VkExtensionProperties *pProperties) {
     return parameter_validation::vkEnumerateInstanceExtensionProperties(pLayerName, pCount, pProperties);
@@ -2495,3 +2498,5 @@ VK_LAYER_EXPORT bool pv_vkNegotiateLoaderLayerInterfaceVersion(VkNegotiateLayerI
 
     return VK_SUCCESS;
 }
+
+#endif  // VK_LAYER_COMBINED
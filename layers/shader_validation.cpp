@@ -20,8 +20,12 @@
 
 #include <cinttypes>
 #include <cassert>
+#include <algorithm>
 #include <vector>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
 #include <sstream>
 #include <SPIRV/spirv.hpp>
@@ -42,18 +46,6 @@ enum FORMAT_TYPE {
     FORMAT_TYPE_UINT = 4,
 };
 
-typedef std::pair<unsigned, unsigned> location_t;
-
-struct interface_var {
-    uint32_t id;
-    uint32_t type_id;
-    uint32_t offset;
-    bool is_patch;
-    bool is_block_member;
-    bool is_relaxed_precision;
-    // TODO: collect the name, too? Isn't required to be present.
-};
-
 struct shader_stage_attributes {
     char const *const name;
     bool arrayed_input;
@@ -122,6 +114,14 @@ void shader_module::build_def_index() {
                 def_index[insn.word(2)] = insn.offset();
                 break;
 
+            case spv::OpEntryPoint:
+                entrypoint_index.push_back(insn.offset());
+                break;
+
+            case spv::OpCapability:
+                capabilities.push_back(insn.word(1));
+                break;
+
             default:
                 // We don't care about any other defs for now.
                 break;
@@ -130,14 +130,13 @@ void shader_module::build_def_index() {
 }
 
 static spirv_inst_iter find_entrypoint(shader_module const *src, char const *name, VkShaderStageFlagBits stageBits) {
-    for (auto insn : *src) {
-        if (insn.opcode() == spv::OpEntryPoint) {
-            auto entrypointName = (char const *)&insn.word(3);
-            auto entrypointStageBits = 1u << insn.word(1);
+    for (auto offset : src->entrypoint_index) {
+        auto insn = src->at(offset);
+        auto entrypointName = (char const *)&insn.word(3);
+        auto entrypointStageBits = 1u << insn.word(1);
 
-            if (!strcmp(entrypointName, name) && (entrypointStageBits & stageBits)) {
-                return insn;
-            }
+        if (!strcmp(entrypointName, name) && (entrypointStageBits & stageBits)) {
+            return insn;
         }
     }
 
@@ -348,38 +347,48 @@ static unsigned value_or_default(std::unordered_map<unsigned, unsigned> const &m
         return it->second;
 }
 
-static unsigned get_locations_consumed_by_type(shader_module const *src, unsigned type, bool strip_array_level) {
-    auto insn = src->get_def(type);
-    assert(insn != src->end());
+// Interface matching asks for the locations of the same types over and over, so they are worked out once per module.
+// Types are declared before they are used, so a pass in module order has the element type of each one already.
+void shader_module::build_type_locations() {
+    for (auto insn : *this) {
+        switch (insn.opcode()) {
+            case spv::OpTypeArray:
+                type_locations[insn.word(1)] =
+                    get_constant_value(this, insn.word(3)) * value_or_default(type_locations, insn.word(2), 1);
+                break;
+            case spv::OpTypeMatrix:
+                // Num locations is the dimension * element size
+                type_locations[insn.word(1)] = insn.word(3) * value_or_default(type_locations, insn.word(2), 1);
+                break;
+            case spv::OpTypeVector: {
+                auto scalar_type = get_def(insn.word(2));
+                auto bit_width =
+                    (scalar_type.opcode() == spv::OpTypeInt || scalar_type.opcode() == spv::OpTypeFloat) ? scalar_type.word(2) : 32;
 
-    switch (insn.opcode()) {
-        case spv::OpTypePointer:
-            // See through the ptr -- this is only ever at the toplevel for graphics shaders we're never actually passing
-            // pointers around.
-            return get_locations_consumed_by_type(src, insn.word(3), strip_array_level);
-        case spv::OpTypeArray:
-            if (strip_array_level) {
-                return get_locations_consumed_by_type(src, insn.word(2), false);
-            } else {
-                return get_constant_value(src, insn.word(3)) * get_locations_consumed_by_type(src, insn.word(2), false);
+                // Locations are 128-bit wide; 3- and 4-component vectors of 64 bit types require two.
+                type_locations[insn.word(1)] = (bit_width * insn.word(3) + 127) / 128;
+                break;
             }
-        case spv::OpTypeMatrix:
-            // Num locations is the dimension * element size
-            return insn.word(3) * get_locations_consumed_by_type(src, insn.word(2), false);
-        case spv::OpTypeVector: {
-            auto scalar_type = src->get_def(insn.word(2));
-            auto bit_width =
-                (scalar_type.opcode() == spv::OpTypeInt || scalar_type.opcode() == spv::OpTypeFloat) ? scalar_type.word(2) : 32;
-
-            // Locations are 128-bit wide; 3- and 4-component vectors of 64 bit types require two.
-            return (bit_width * insn.word(3) + 127) / 128;
+            default:
+                // Everything else is just 1.
+                break;
         }
-        default:
-            // Everything else is just 1.
-            return 1;
+    }
+}
+
+static unsigned get_locations_consumed_by_type(shader_module const *src, unsigned type, bool strip_array_level) {
+    auto insn = src->get_def(type);
+    assert(insn != src->end());
 
-            // TODO: extend to handle 64bit scalar types, whose vectors may need multiple locations.
+    if (insn.opcode() == spv::OpTypePointer) {
+        // See through the ptr -- this is only ever at the toplevel for graphics shaders we're never actually passing
+        // pointers around.
+        return get_locations_consumed_by_type(src, insn.word(3), strip_array_level);
+    }
+    if (strip_array_level && insn.opcode() == spv::OpTypeArray) {
+        return value_or_default(src->type_locations, insn.word(2), 1);
     }
+    return value_or_default(src->type_locations, type, 1);
 }
 
 static unsigned get_locations_consumed_by_format(VkFormat format) {
@@ -644,7 +653,7 @@ static std::vector<std::pair<uint32_t, interface_var>> collect_interface_by_inpu
 }
 
 static std::vector<std::pair<descriptor_slot_t, interface_var>> collect_interface_by_descriptor_slot(
-    debug_report_data const *report_data, shader_module const *src, std::unordered_set<uint32_t> const &accessible_ids) {
+    shader_module const *src, std::unordered_set<uint32_t> const &accessible_ids) {
     std::unordered_map<unsigned, unsigned> var_sets;
     std::unordered_map<unsigned, unsigned> var_bindings;
 
@@ -708,10 +717,10 @@ static bool validate_vi_consistency(debug_report_data const *report_data, VkPipe
 }
 
 static bool validate_vi_against_vs_inputs(debug_report_data const *report_data, VkPipelineVertexInputStateCreateInfo const *vi,
-                                          shader_module const *vs, spirv_inst_iter entrypoint) {
+                                          shader_module const *vs, shader_entrypoint const *entrypoint) {
     bool skip = false;
 
-    auto inputs = collect_interface_by_location(vs, entrypoint, spv::StorageClassInput, false);
+    auto const &inputs = entrypoint->inputs;
 
     // Build index by location
     std::map<uint32_t, VkVertexInputAttributeDescription const *> attribs;
@@ -768,7 +777,7 @@ static bool validate_vi_against_vs_inputs(debug_report_data const *report_data,
 }
 
 static bool validate_fs_outputs_against_render_pass(debug_report_data const *report_data, shader_module const *fs,
-                                                    spirv_inst_iter entrypoint, PIPELINE_STATE const *pipeline,
+                                                    shader_entrypoint const *entrypoint, PIPELINE_STATE const *pipeline,
                                                     uint32_t subpass_index) {
     auto rpci = pipeline->render_pass_ci.ptr();
 
@@ -786,7 +795,7 @@ static bool validate_fs_outputs_against_render_pass(debug_report_data const *rep
 
     // TODO: dual source blend index (spv::DecIndex, zero if not provided)
 
-    auto outputs = collect_interface_by_location(fs, entrypoint, spv::StorageClassOutput, false);
+    auto const &outputs = entrypoint->outputs;
 
     auto it_a = outputs.begin();
     auto it_b = color_attachments.begin();
@@ -950,69 +959,108 @@ static std::unordered_set<uint32_t> mark_accessible_ids(shader_module const *src
     return ids;
 }
 
-static bool validate_push_constant_block_against_pipeline(debug_report_data const *report_data,
-                                                          std::vector<VkPushConstantRange> const *push_constant_ranges,
-                                                          shader_module const *src, spirv_inst_iter type,
-                                                          VkShaderStageFlagBits stage) {
-    bool skip = false;
-
+static void collect_push_constant_block_offsets(shader_module const *src, spirv_inst_iter type, std::vector<uint32_t> *out) {
     // Strip off ptrs etc
     type = get_struct_type(src, type, false);
     assert(type != src->end());
 
-    // Validate directly off the offsets. this isn't quite correct for arrays and matrices, but is a good first step.
+    // Take the member offsets directly. this isn't quite correct for arrays and matrices, but is a good first step.
     // TODO: arrays, matrices, weird sizes
     for (auto insn : *src) {
         if (insn.opcode() == spv::OpMemberDecorate && insn.word(1) == type.word(1)) {
             if (insn.word(3) == spv::DecorationOffset) {
-                unsigned offset = insn.word(4);
-                auto size = 4;  // Bytes; TODO: calculate this based on the type
-
-                bool found_range = false;
-                for (auto const &range : *push_constant_ranges) {
-                    if (range.offset <= offset && range.offset + range.size >= offset + size) {
-                        found_range = true;
-
-                        if ((range.stageFlags & stage) == 0) {
-                            skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_UNKNOWN_EXT, 0,
-                                            __LINE__, SHADER_CHECKER_PUSH_CONSTANT_NOT_ACCESSIBLE_FROM_STAGE, "SC",
-                                            "Push constant range covering variable starting at "
-                                                "offset %u not accessible from stage %s",
-                                            offset, string_VkShaderStageFlagBits(stage));
-                        }
+                out->push_back(insn.word(4));
+            }
+        }
+    }
+}
 
-                        break;
-                    }
-                }
+static std::vector<uint32_t> collect_push_constant_offsets(shader_module const *src,
+                                                           std::unordered_set<uint32_t> const &accessible_ids) {
+    std::vector<uint32_t> out;
+
+    for (auto id : accessible_ids) {
+        auto def_insn = src->get_def(id);
+        if (def_insn.opcode() == spv::OpVariable && def_insn.word(3) == spv::StorageClassPushConstant) {
+            collect_push_constant_block_offsets(src, src->get_def(def_insn.word(1)), &out);
+        }
+    }
+
+    return out;
+}
+
+static bool validate_push_constant_usage(debug_report_data const *report_data,
+                                         std::vector<VkPushConstantRange> const *push_constant_ranges,
+                                         shader_entrypoint const *entrypoint, VkShaderStageFlagBits stage) {
+    bool skip = false;
 
-                if (!found_range) {
+    for (auto offset : entrypoint->push_constant_offsets) {
+        auto size = 4;  // Bytes; TODO: calculate this based on the type
+
+        bool found_range = false;
+        for (auto const &range : *push_constant_ranges) {
+            if (range.offset <= offset && range.offset + range.size >= offset + size) {
+                found_range = true;
+
+                if ((range.stageFlags & stage) == 0) {
                     skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_UNKNOWN_EXT, 0,
-                                    __LINE__, SHADER_CHECKER_PUSH_CONSTANT_OUT_OF_RANGE, "SC",
+                                    __LINE__, SHADER_CHECKER_PUSH_CONSTANT_NOT_ACCESSIBLE_FROM_STAGE, "SC",
                                     "Push constant range covering variable starting at "
-                                        "offset %u not declared in layout",
-                                    offset);
+                                        "offset %u not accessible from stage %s",
+                                    offset, string_VkShaderStageFlagBits(stage));
                 }
+
+                break;
             }
         }
+
+        if (!found_range) {
+            skip |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_UNKNOWN_EXT, 0, __LINE__,
+                            SHADER_CHECKER_PUSH_CONSTANT_OUT_OF_RANGE, "SC",
+                            "Push constant range covering variable starting at "
+                                "offset %u not declared in layout",
+                            offset);
+        }
     }
 
     return skip;
 }
 
-static bool validate_push_constant_usage(debug_report_data const *report_data,
-                                         std::vector<VkPushConstantRange> const *push_constant_ranges, shader_module const *src,
-                                         std::unordered_set<uint32_t> accessible_ids, VkShaderStageFlagBits stage) {
-    bool skip = false;
-
-    for (auto id : accessible_ids) {
-        auto def_insn = src->get_def(id);
-        if (def_insn.opcode() == spv::OpVariable && def_insn.word(3) == spv::StorageClassPushConstant) {
-            skip |= validate_push_constant_block_against_pipeline(report_data, push_constant_ranges, src,
-                                                                  src->get_def(def_insn.word(1)), stage);
+// Looks up the reflection of an entrypoint, working it out on first use. Returns null if the module has no such entrypoint.
+static shader_entrypoint const *get_entrypoint(shader_module const *src, char const *name, VkShaderStageFlagBits stage) {
+    auto key = std::make_pair(std::string(name), static_cast<uint32_t>(stage));
+    {
+        std::lock_guard<std::mutex> lock(src->entrypoint_lock);
+        auto it = src->entrypoints.find(key);
+        if (it != src->entrypoints.end()) {
+            return it->second.get();
         }
     }
 
-    return skip;
+    auto insn = find_entrypoint(src, name, stage);
+    if (insn == src->end()) {
+        return nullptr;
+    }
+
+    std::unique_ptr<shader_entrypoint> entrypoint(new shader_entrypoint());
+    entrypoint->offset = insn.offset();
+    auto accessible_ids = mark_accessible_ids(src, insn);
+    entrypoint->descriptor_uses = collect_interface_by_descriptor_slot(src, accessible_ids);
+    entrypoint->push_constant_offsets = collect_push_constant_offsets(src, accessible_ids);
+    if (stage == VK_SHADER_STAGE_FRAGMENT_BIT) {
+        entrypoint->input_attachment_uses = collect_interface_by_input_attachment_index(src, accessible_ids);
+    }
+    auto stage_id = get_shader_stage_id(stage);
+    if (stage_id < sizeof(shader_stage_attribs) / sizeof(shader_stage_attribs[0])) {
+        entrypoint->inputs =
+            collect_interface_by_location(src, insn, spv::StorageClassInput, shader_stage_attribs[stage_id].arrayed_input);
+        entrypoint->outputs =
+            collect_interface_by_location(src, insn, spv::StorageClassOutput, shader_stage_attribs[stage_id].arrayed_output);
+    }
+
+    // Another thread may have got here first, in which case its result is kept
+    std::lock_guard<std::mutex> lock(src->entrypoint_lock);
+    return src->entrypoints.emplace(key, std::move(entrypoint)).first->second.get();
 }
 
 // Validate that data for each specialization entry is fully contained within the buffer.
@@ -1144,14 +1192,14 @@ static bool require_extension(debug_report_data const *report_data, bool extensi
     return false;
 }
 
-static bool validate_shader_capabilities(layer_data *dev_data, shader_module const *src) {
+static bool validate_shader_capabilities(layer_data *dev_data, debug_report_data const *report_data, shader_module const *src) {
     bool skip = false;
 
-    auto report_data = GetReportData(dev_data);
     auto const & enabledFeatures = GetEnabledFeatures(dev_data);
     auto const & extensions = GetEnabledExtensions(dev_data);
 
     struct CapabilityInfo {
+        uint32_t capability;
         char const *name;
         VkBool32 const VkPhysicalDeviceFeatures::*feature;
         bool const DeviceExtensions::*extension;
@@ -1160,68 +1208,67 @@ static bool validate_shader_capabilities(layer_data *dev_data, shader_module con
     using F = VkPhysicalDeviceFeatures;
     using E = DeviceExtensions;
 
+    // Sorted by capability for the binary search below. Constant-initialized, so unlike a map it costs nothing to set up
+    // and a lookup doesn't hash.
     // clang-format off
-    static const std::unordered_map<uint32_t, CapabilityInfo> capabilities = {
-        // Capabilities always supported by a Vulkan 1.0 implementation -- no
-        // feature bits.
-        {spv::CapabilityMatrix, {nullptr}},
-        {spv::CapabilityShader, {nullptr}},
-        {spv::CapabilityInputAttachment, {nullptr}},
-        {spv::CapabilitySampled1D, {nullptr}},
-        {spv::CapabilityImage1D, {nullptr}},
-        {spv::CapabilitySampledBuffer, {nullptr}},
-        {spv::CapabilityImageQuery, {nullptr}},
-        {spv::CapabilityDerivativeControl, {nullptr}},
-
-        // Capabilities that are optionally supported, but require a feature to
-        // be enabled on the device
-        {spv::CapabilityGeometry, {"geometryShader", &F::geometryShader}},
-        {spv::CapabilityTessellation, {"tessellationShader", &F::tessellationShader}},
-        {spv::CapabilityFloat64, {"shaderFloat64", &F::shaderFloat64}},
-        {spv::CapabilityInt64, {"shaderInt64", &F::shaderInt64}},
-        {spv::CapabilityTessellationPointSize, {"shaderTessellationAndGeometryPointSize", &F::shaderTessellationAndGeometryPointSize}},
-        {spv::CapabilityGeometryPointSize, {"shaderTessellationAndGeometryPointSize", &F::shaderTessellationAndGeometryPointSize}},
-        {spv::CapabilityImageGatherExtended, {"shaderImageGatherExtended", &F::shaderImageGatherExtended}},
-        {spv::CapabilityStorageImageMultisample, {"shaderStorageImageMultisample", &F::shaderStorageImageMultisample}},
-        {spv::CapabilityUniformBufferArrayDynamicIndexing, {"shaderUniformBufferArrayDynamicIndexing", &F::shaderUniformBufferArrayDynamicIndexing}},
-        {spv::CapabilitySampledImageArrayDynamicIndexing, {"shaderSampledImageArrayDynamicIndexing", &F::shaderSampledImageArrayDynamicIndexing}},
-        {spv::CapabilityStorageBufferArrayDynamicIndexing, {"shaderStorageBufferArrayDynamicIndexing", &F::shaderStorageBufferArrayDynamicIndexing}},
-        {spv::CapabilityStorageImageArrayDynamicIndexing, {"shaderStorageImageArrayDynamicIndexing", &F::shaderStorageBufferArrayDynamicIndexing}},
-        {spv::CapabilityClipDistance, {"shaderClipDistance", &F::shaderClipDistance}},
-        {spv::CapabilityCullDistance, {"shaderCullDistance", &F::shaderCullDistance}},
-        {spv::CapabilityImageCubeArray, {"imageCubeArray", &F::imageCubeArray}},
-        {spv::CapabilitySampleRateShading, {"sampleRateShading", &F::sampleRateShading}},
-        {spv::CapabilitySparseResidency, {"shaderResourceResidency", &F::shaderResourceResidency}},
-        {spv::CapabilityMinLod, {"shaderResourceMinLod", &F::shaderResourceMinLod}},
-        {spv::CapabilitySampledCubeArray, {"imageCubeArray", &F::imageCubeArray}},
-        {spv::CapabilityImageMSArray, {"shaderStorageImageMultisample", &F::shaderStorageImageMultisample}},
-        {spv::CapabilityStorageImageExtendedFormats, {"shaderStorageImageExtendedFormats", &F::shaderStorageImageExtendedFormats}},
-        {spv::CapabilityInterpolationFunction, {"sampleRateShading", &F::sampleRateShading}},
-        {spv::CapabilityStorageImageReadWithoutFormat, {"shaderStorageImageReadWithoutFormat", &F::shaderStorageImageReadWithoutFormat}},
-        {spv::CapabilityStorageImageWriteWithoutFormat, {"shaderStorageImageWriteWithoutFormat", &F::shaderStorageImageWriteWithoutFormat}},
-        {spv::CapabilityMultiViewport, {"multiViewport", &F::multiViewport}},
-
-        // Capabilities that require an extension
-        {spv::CapabilityDrawParameters, {VK_KHR_SHADER_DRAW_PARAMETERS_EXTENSION_NAME, nullptr, &E::vk_khr_shader_draw_parameters}},
-        {spv::CapabilityGeometryShaderPassthroughNV, {VK_NV_GEOMETRY_SHADER_PASSTHROUGH_EXTENSION_NAME, nullptr, &E::vk_nv_geometry_shader_passthrough}},
-        {spv::CapabilitySampleMaskOverrideCoverageNV, {VK_NV_SAMPLE_MASK_OVERRIDE_COVERAGE_EXTENSION_NAME, nullptr, &E::vk_nv_sample_mask_override_coverage}},
-        {spv::CapabilityShaderViewportIndexLayerNV, {VK_NV_VIEWPORT_ARRAY2_EXTENSION_NAME, nullptr, &E::vk_nv_viewport_array2}},
-        {spv::CapabilityShaderViewportMaskNV, {VK_NV_VIEWPORT_ARRAY2_EXTENSION_NAME, nullptr, &E::vk_nv_viewport_array2}},
-        {spv::CapabilitySubgroupBallotKHR, {VK_EXT_SHADER_SUBGROUP_BALLOT_EXTENSION_NAME, nullptr, &E::vk_ext_shader_subgroup_ballot }},
-        {spv::CapabilitySubgroupVoteKHR, {VK_EXT_SHADER_SUBGROUP_VOTE_EXTENSION_NAME, nullptr, &E::vk_ext_shader_subgroup_vote }},
+    static const CapabilityInfo capabilities[] = {
+        // Capabilities always supported by a Vulkan 1.0 implementation have no feature bits, the others require a feature
+        // to be enabled on the device or an extension.
+        {spv::CapabilityMatrix, nullptr},
+        {spv::CapabilityShader, nullptr},
+        {spv::CapabilityGeometry, "geometryShader", &F::geometryShader},
+        {spv::CapabilityTessellation, "tessellationShader", &F::tessellationShader},
+        {spv::CapabilityFloat64, "shaderFloat64", &F::shaderFloat64},
+        {spv::CapabilityInt64, "shaderInt64", &F::shaderInt64},
+        {spv::CapabilityTessellationPointSize, "shaderTessellationAndGeometryPointSize", &F::shaderTessellationAndGeometryPointSize},
+        {spv::CapabilityGeometryPointSize, "shaderTessellationAndGeometryPointSize", &F::shaderTessellationAndGeometryPointSize},
+        {spv::CapabilityImageGatherExtended, "shaderImageGatherExtended", &F::shaderImageGatherExtended},
+        {spv::CapabilityStorageImageMultisample, "shaderStorageImageMultisample", &F::shaderStorageImageMultisample},
+        {spv::CapabilityUniformBufferArrayDynamicIndexing, "shaderUniformBufferArrayDynamicIndexing", &F::shaderUniformBufferArrayDynamicIndexing},
+        {spv::CapabilitySampledImageArrayDynamicIndexing, "shaderSampledImageArrayDynamicIndexing", &F::shaderSampledImageArrayDynamicIndexing},
+        {spv::CapabilityStorageBufferArrayDynamicIndexing, "shaderStorageBufferArrayDynamicIndexing", &F::shaderStorageBufferArrayDynamicIndexing},
+        {spv::CapabilityStorageImageArrayDynamicIndexing, "shaderStorageImageArrayDynamicIndexing", &F::shaderStorageBufferArrayDynamicIndexing},
+        {spv::CapabilityClipDistance, "shaderClipDistance", &F::shaderClipDistance},
+        {spv::CapabilityCullDistance, "shaderCullDistance", &F::shaderCullDistance},
+        {spv::CapabilityImageCubeArray, "imageCubeArray", &F::imageCubeArray},
+        {spv::CapabilitySampleRateShading, "sampleRateShading", &F::sampleRateShading},
+        {spv::CapabilityInputAttachment, nullptr},
+        {spv::CapabilitySparseResidency, "shaderResourceResidency", &F::shaderResourceResidency},
+        {spv::CapabilityMinLod, "shaderResourceMinLod", &F::shaderResourceMinLod},
+        {spv::CapabilitySampled1D, nullptr},
+        {spv::CapabilityImage1D, nullptr},
+        {spv::CapabilitySampledCubeArray, "imageCubeArray", &F::imageCubeArray},
+        {spv::CapabilitySampledBuffer, nullptr},
+        {spv::CapabilityImageMSArray, "shaderStorageImageMultisample", &F::shaderStorageImageMultisample},
+        {spv::CapabilityStorageImageExtendedFormats, "shaderStorageImageExtendedFormats", &F::shaderStorageImageExtendedFormats},
+        {spv::CapabilityImageQuery, nullptr},
+        {spv::CapabilityDerivativeControl, nullptr},
+        {spv::CapabilityInterpolationFunction, "sampleRateShading", &F::sampleRateShading},
+        {spv::CapabilityStorageImageReadWithoutFormat, "shaderStorageImageReadWithoutFormat", &F::shaderStorageImageReadWithoutFormat},
+        {spv::CapabilityStorageImageWriteWithoutFormat, "shaderStorageImageWriteWithoutFormat", &F::shaderStorageImageWriteWithoutFormat},
+        {spv::CapabilityMultiViewport, "multiViewport", &F::multiViewport},
+        {spv::CapabilitySubgroupBallotKHR, VK_EXT_SHADER_SUBGROUP_BALLOT_EXTENSION_NAME, nullptr, &E::vk_ext_shader_subgroup_ballot},
+        {spv::CapabilityDrawParameters, VK_KHR_SHADER_DRAW_PARAMETERS_EXTENSION_NAME, nullptr, &E::vk_khr_shader_draw_parameters},
+        {spv::CapabilitySubgroupVoteKHR, VK_EXT_SHADER_SUBGROUP_VOTE_EXTENSION_NAME, nullptr, &E::vk_ext_shader_subgroup_vote},
+        {spv::CapabilitySampleMaskOverrideCoverageNV, VK_NV_SAMPLE_MASK_OVERRIDE_COVERAGE_EXTENSION_NAME, nullptr, &E::vk_nv_sample_mask_override_coverage},
+        {spv::CapabilityGeometryShaderPassthroughNV, VK_NV_GEOMETRY_SHADER_PASSTHROUGH_EXTENSION_NAME, nullptr, &E::vk_nv_geometry_shader_passthrough},
+        {spv::CapabilityShaderViewportIndexLayerNV, VK_NV_VIEWPORT_ARRAY2_EXTENSION_NAME, nullptr, &E::vk_nv_viewport_array2},
+        {spv::CapabilityShaderViewportMaskNV, VK_NV_VIEWPORT_ARRAY2_EXTENSION_NAME, nullptr, &E::vk_nv_viewport_array2},
     };
     // clang-format on
-
-    for (auto insn : *src) {
-        if (insn.opcode() == spv::OpCapability) {
-            auto it = capabilities.find(insn.word(1));
-            if (it != capabilities.end()) {
-                if (it->second.feature) {
-                    skip |= require_feature(report_data, enabledFeatures->*(it->second.feature), it->second.name);
-                }
-                if (it->second.extension) {
-                    skip |= require_extension(report_data, extensions->*(it->second.extension), it->second.name);
-                }
+    auto const capabilities_end = capabilities + sizeof(capabilities) / sizeof(capabilities[0]);
+    assert(std::is_sorted(capabilities, capabilities_end,
+                          [](CapabilityInfo const &a, CapabilityInfo const &b) { return a.capability < b.capability; }));
+
+    for (auto capability : src->capabilities) {
+        auto it = std::lower_bound(capabilities, capabilities_end, capability,
+                                   [](CapabilityInfo const &info, uint32_t value) { return info.capability < value; });
+        if (it != capabilities_end && it->capability == capability) {
+            if (it->feature) {
+                skip |= require_feature(report_data, enabledFeatures->*(it->feature), it->name);
+            }
+            if (it->extension) {
+                skip |= require_extension(report_data, extensions->*(it->extension), it->name);
             }
         }
     }
@@ -1280,39 +1327,31 @@ static VkDescriptorSetLayoutBinding const *get_descriptor_binding(PIPELINE_LAYOU
 }
 
 
-static bool validate_pipeline_shader_stage(
-    layer_data *dev_data, VkPipelineShaderStageCreateInfo const *pStage, PIPELINE_STATE *pipeline,
-    shader_module const **out_module, spirv_inst_iter *out_entrypoint) {
+static bool validate_pipeline_shader_stage(layer_data *dev_data, debug_report_data const *report_data,
+                                           VkPipelineShaderStageCreateInfo const *pStage, PIPELINE_STATE *pipeline,
+                                           shader_module const **out_module, shader_entrypoint const **out_entrypoint) {
     bool skip = false;
     auto module = *out_module = GetShaderModuleState(dev_data, pStage->module);
-    auto report_data = GetReportData(dev_data);
 
     if (!module->has_valid_spirv) return false;
 
     // Find the entrypoint
-    auto entrypoint = *out_entrypoint = find_entrypoint(module, pStage->pName, pStage->stage);
-    if (entrypoint == module->end()) {
-        if (log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_UNKNOWN_EXT, 0, __LINE__,
-                    VALIDATION_ERROR_10600586, "SC", "No entrypoint found named `%s` for stage %s. %s.", pStage->pName,
-                    string_VkShaderStageFlagBits(pStage->stage), validation_error_map[VALIDATION_ERROR_10600586])) {
-            return true;  // no point continuing beyond here, any analysis is just going to be garbage.
-        }
+    auto entrypoint = *out_entrypoint = get_entrypoint(module, pStage->pName, pStage->stage);
+    if (!entrypoint) {
+        // No point continuing beyond here, any analysis is just going to be garbage.
+        return log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_UNKNOWN_EXT, 0, __LINE__,
+                       VALIDATION_ERROR_10600586, "SC", "No entrypoint found named `%s` for stage %s. %s.", pStage->pName,
+                       string_VkShaderStageFlagBits(pStage->stage), validation_error_map[VALIDATION_ERROR_10600586]);
     }
 
     // Validate shader capabilities against enabled device features
-    skip |= validate_shader_capabilities(dev_data, module);
-
-    // Mark accessible ids
-    auto accessible_ids = mark_accessible_ids(module, entrypoint);
-
-    // Validate descriptor set layout against what the entrypoint actually uses
-    auto descriptor_uses = collect_interface_by_descriptor_slot(report_data, module, accessible_ids);
+    skip |= validate_shader_capabilities(dev_data, report_data, module);
 
     skip |= validate_specialization_offsets(report_data, pStage);
-    skip |= validate_push_constant_usage(report_data, &pipeline->pipeline_layout.push_constant_ranges, module, accessible_ids, pStage->stage);
+    skip |= validate_push_constant_usage(report_data, &pipeline->pipeline_layout.push_constant_ranges, entrypoint, pStage->stage);
 
-    // Validate descriptor use
-    for (auto use : descriptor_uses) {
+    // Validate descriptor set layout against what the entrypoint actually uses
+    for (auto const &use : entrypoint->descriptor_uses) {
         // While validating shaders capture which slots are used by the pipeline
         auto &reqs = pipeline->active_slots[use.first.first][use.first.second];
         reqs = descriptor_req(reqs | descriptor_type_to_reqs(module, use.second.type_id));
@@ -1353,12 +1392,10 @@ static bool validate_pipeline_shader_stage(
 
     // Validate use of input attachments against subpass structure
     if (pStage->stage == VK_SHADER_STAGE_FRAGMENT_BIT) {
-        auto input_attachment_uses = collect_interface_by_input_attachment_index(module, accessible_ids);
-
         auto rpci = pipeline->render_pass_ci.ptr();
         auto subpass = pipeline->graphicsPipelineCI.subpass;
 
-        for (auto use : input_attachment_uses) {
+        for (auto const &use : entrypoint->input_attachment_uses) {
             auto input_attachments = rpci->pSubpasses[subpass].pInputAttachments;
             auto index = (input_attachments && use.first < rpci->pSubpasses[subpass].inputAttachmentCount)
                          ? input_attachments[use.first].attachment
@@ -1382,15 +1419,14 @@ static bool validate_pipeline_shader_stage(
 }
 
 static bool validate_interface_between_stages(debug_report_data const *report_data, shader_module const *producer,
-                                              spirv_inst_iter producer_entrypoint, shader_stage_attributes const *producer_stage,
-                                              shader_module const *consumer, spirv_inst_iter consumer_entrypoint,
+                                              shader_entrypoint const *producer_entrypoint,
+                                              shader_stage_attributes const *producer_stage, shader_module const *consumer,
+                                              shader_entrypoint const *consumer_entrypoint,
                                               shader_stage_attributes const *consumer_stage) {
     bool skip = false;
 
-    auto outputs =
-        collect_interface_by_location(producer, producer_entrypoint, spv::StorageClassOutput, producer_stage->arrayed_output);
-    auto inputs =
-        collect_interface_by_location(consumer, consumer_entrypoint, spv::StorageClassInput, consumer_stage->arrayed_input);
+    auto const &outputs = producer_entrypoint->outputs;
+    auto const &inputs = consumer_entrypoint->inputs;
 
     auto a_it = outputs.begin();
     auto b_it = inputs.begin();
@@ -1450,22 +1486,23 @@ static bool validate_interface_between_stages(debug_report_data const *report_da
 
 // Validate that the shaders used by the given pipeline and store the active_slots
 //  that are actually used by the pipeline into pPipeline->active_slots
-bool validate_and_capture_pipeline_shader_state(layer_data *dev_data, PIPELINE_STATE *pipeline) {
+bool validate_and_capture_pipeline_shader_state(layer_data *dev_data, debug_report_data const *report_data,
+                                                PIPELINE_STATE *pipeline) {
+    CheckProfileScope profile(dev_data, CHECK_PROFILE_PIPELINE_SHADER_STATE);
     auto pCreateInfo = pipeline->graphicsPipelineCI.ptr();
     int vertex_stage = get_shader_stage_id(VK_SHADER_STAGE_VERTEX_BIT);
     int fragment_stage = get_shader_stage_id(VK_SHADER_STAGE_FRAGMENT_BIT);
-    auto report_data = GetReportData(dev_data);
 
     shader_module const *shaders[5];
     memset(shaders, 0, sizeof(shaders));
-    spirv_inst_iter entrypoints[5];
+    shader_entrypoint const *entrypoints[5];
     memset(entrypoints, 0, sizeof(entrypoints));
     bool skip = false;
 
     for (uint32_t i = 0; i < pCreateInfo->stageCount; i++) {
         auto pStage = &pCreateInfo->pStages[i];
         auto stage_id = get_shader_stage_id(pStage->stage);
-        skip |= validate_pipeline_shader_stage(dev_data, pStage, pipeline, &shaders[stage_id], &entrypoints[stage_id]);
+        skip |= validate_pipeline_shader_stage(dev_data, report_data, pStage, pipeline, &shaders[stage_id], &entrypoints[stage_id]);
     }
 
     // if the shader stages are no good individually, cross-stage validation is pointless.
@@ -1477,7 +1514,7 @@ bool validate_and_capture_pipeline_shader_state(layer_data *dev_data, PIPELINE_S
         skip |= validate_vi_consistency(report_data, vi);
     }
 
-    if (shaders[vertex_stage] && shaders[vertex_stage]->has_valid_spirv) {
+    if (entrypoints[vertex_stage]) {
         skip |= validate_vi_against_vs_inputs(report_data, vi, shaders[vertex_stage], entrypoints[vertex_stage]);
     }
 
@@ -1491,7 +1528,7 @@ bool validate_and_capture_pipeline_shader_state(layer_data *dev_data, PIPELINE_S
 
     for (; producer != fragment_stage && consumer <= fragment_stage; consumer++) {
         assert(shaders[producer]);
-        if (shaders[consumer] && shaders[consumer]->has_valid_spirv && shaders[producer]->has_valid_spirv) {
+        if (shaders[consumer] && entrypoints[consumer] && entrypoints[producer]) {
             skip |= validate_interface_between_stages(report_data, shaders[producer], entrypoints[producer],
                                                       &shader_stage_attribs[producer], shaders[consumer], entrypoints[consumer],
                                                       &shader_stage_attribs[consumer]);
@@ -1500,7 +1537,7 @@ bool validate_and_capture_pipeline_shader_state(layer_data *dev_data, PIPELINE_S
         }
     }
 
-    if (shaders[fragment_stage] && shaders[fragment_stage]->has_valid_spirv) {
+    if (entrypoints[fragment_stage]) {
         skip |= validate_fs_outputs_against_render_pass(report_data, shaders[fragment_stage], entrypoints[fragment_stage],
                                                         pipeline, pCreateInfo->subpass);
     }
@@ -1512,17 +1549,172 @@ bool validate_compute_pipeline(layer_data *dev_data, PIPELINE_STATE *pipeline) {
     auto pCreateInfo = pipeline->computePipelineCI.ptr();
 
     shader_module const *module;
-    spirv_inst_iter entrypoint;
+    shader_entrypoint const *entrypoint;
+
+    return validate_pipeline_shader_stage(dev_data, GetReportData(dev_data), &pCreateInfo->stage, pipeline, &module, &entrypoint);
+}
+
+// Modules created from the same valid SPIR-V share their shader_module, whichever device created them, so engines creating
+// the same module per material or per device validate and parse the code once. The modules are only held weakly here, and
+// once the last one is destroyed the next module with that code is validated again.
+static std::mutex shared_modules_lock;
+static std::unordered_multimap<uint64_t, std::weak_ptr<shader_module>> shared_modules;
+static size_t shared_modules_sweep_size = 64;
+
+static uint64_t hash_shader_code(VkShaderModuleCreateInfo const *pCreateInfo) {
+    // FNV-1a over the words
+    uint64_t hash = 14695981039346656037ull;
+    auto code = pCreateInfo->pCode;
+    for (size_t i = 0; i < pCreateInfo->codeSize / sizeof(uint32_t); i++) {
+        hash = (hash ^ code[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Must hold shared_modules_lock
+static std::shared_ptr<shader_module> find_shared_module(uint64_t hash, VkShaderModuleCreateInfo const *pCreateInfo) {
+    auto range = shared_modules.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        auto module = it->second.lock();
+        if (module && module->words.size() * sizeof(uint32_t) == pCreateInfo->codeSize &&
+            !memcmp(module->words.data(), pCreateInfo->pCode, pCreateInfo->codeSize)) {
+            return module;
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<shader_module> GetSharedShaderModule(VkShaderModuleCreateInfo const *pCreateInfo) {
+    auto hash = hash_shader_code(pCreateInfo);
+    {
+        std::lock_guard<std::mutex> lock(shared_modules_lock);
+        auto module = find_shared_module(hash, pCreateInfo);
+        if (module) {
+            return module;
+        }
+    }
 
-    return validate_pipeline_shader_stage(dev_data, &pCreateInfo->stage, pipeline, &module, &entrypoint);
+    // Not make_shared, which would keep the module's memory until its expired entry is swept
+    std::shared_ptr<shader_module> module(new shader_module(pCreateInfo));
+
+    std::lock_guard<std::mutex> lock(shared_modules_lock);
+    // Another thread may have created the same module meanwhile, in which case its module is kept
+    auto other = find_shared_module(hash, pCreateInfo);
+    if (other) {
+        return other;
+    }
+    if (shared_modules.size() >= shared_modules_sweep_size) {
+        for (auto it = shared_modules.begin(); it != shared_modules.end();) {
+            it = it->second.expired() ? shared_modules.erase(it) : std::next(it);
+        }
+        shared_modules_sweep_size = std::max<size_t>(64, shared_modules.size() * 2);
+    }
+    shared_modules.emplace(hash, module);
+    return module;
+}
+
+// The code that passed spirv-tools validation in earlier runs, kept in a text file. Its first line names the spirv-tools
+// version and target environment, and a file written with others is started over. Each further line is the key of some valid
+// code: its size and two 64-bit hashes of it, computed differently so that a collision has to happen in both.
+static const spv_target_env spirv_validation_env = SPV_ENV_VULKAN_1_0;
+
+struct spirv_cache_key {
+    uint64_t size;
+    uint64_t hash[2];
+
+    bool operator==(spirv_cache_key const &other) const {
+        return size == other.size && hash[0] == other.hash[0] && hash[1] == other.hash[1];
+    }
+};
+
+struct spirv_cache_key_hash {
+    size_t operator()(spirv_cache_key const &key) const { return static_cast<size_t>(key.hash[0]); }
+};
+
+static std::mutex spirv_cache_lock;
+static FILE *spirv_cache_file = nullptr;
+static std::unordered_set<spirv_cache_key, spirv_cache_key_hash> spirv_cache;
+
+static spirv_cache_key get_spirv_cache_key(VkShaderModuleCreateInfo const *pCreateInfo) {
+    spirv_cache_key key = {pCreateInfo->codeSize, {hash_shader_code(pCreateInfo), 0}};
+    // A multiply-rotate hash, unrelated to FNV-1a
+    uint64_t hash = pCreateInfo->codeSize;
+    for (size_t i = 0; i < pCreateInfo->codeSize / sizeof(uint32_t); i++) {
+        hash = (hash ^ pCreateInfo->pCode[i]) * 0x9e3779b97f4a7c15ull;
+        hash = (hash << 31) | (hash >> 33);
+    }
+    key.hash[1] = hash;
+    return key;
+}
+
+static std::string get_spirv_cache_header() {
+    std::ostringstream header;
+    header << "spirv-tools " << spvSoftwareVersionString() << " env " << static_cast<int>(spirv_validation_env);
+    return header.str();
+}
+
+void OpenSpirvValidationCache(char const *path) {
+    std::lock_guard<std::mutex> lock(spirv_cache_lock);
+    // The cache is shared by all instances, the first to be created opens it
+    if (spirv_cache_file) return;
+
+    auto header = get_spirv_cache_header();
+    bool header_matches = false;
+    FILE *file = fopen(path, "r");
+    if (file) {
+        char line[256];
+        if (fgets(line, sizeof(line), file) && header == std::string(line, strcspn(line, "\n"))) {
+            header_matches = true;
+            spirv_cache_key key;
+            while (fscanf(file, "%" SCNx64 " %" SCNx64 " %" SCNx64, &key.size, &key.hash[0], &key.hash[1]) == 3) {
+                spirv_cache.insert(key);
+            }
+        }
+        fclose(file);
+    }
+
+    spirv_cache_file = fopen(path, header_matches ? "a" : "w");
+    if (spirv_cache_file && !header_matches) {
+        fprintf(spirv_cache_file, "%s\n", header.c_str());
+        fflush(spirv_cache_file);
+    }
 }
 
-bool PreCallValidateCreateShaderModule(layer_data *dev_data, VkShaderModuleCreateInfo const *pCreateInfo, bool *spirv_valid) {
+// Returns whether an earlier run validated the code, adding code that was just validated when valid is set
+static bool check_spirv_validation_cache(VkShaderModuleCreateInfo const *pCreateInfo, bool valid) {
+    std::lock_guard<std::mutex> lock(spirv_cache_lock);
+    if (!spirv_cache_file) return false;
+
+    auto key = get_spirv_cache_key(pCreateInfo);
+    if (!valid) {
+        return spirv_cache.count(key) != 0;
+    }
+    if (spirv_cache.insert(key).second) {
+        fprintf(spirv_cache_file, "%" PRIx64 " %" PRIx64 " %" PRIx64 "\n", key.size, key.hash[0], key.hash[1]);
+        fflush(spirv_cache_file);
+    }
+    return true;
+}
+
+bool PreCallValidateCreateShaderModule(layer_data *dev_data, VkShaderModuleCreateInfo const *pCreateInfo, bool *spirv_valid,
+                                       std::shared_ptr<shader_module> *shared_module) {
     bool skip = false;
     spv_result_t spv_valid = SPV_SUCCESS;
     auto report_data = GetReportData(dev_data);
 
+    *shared_module = nullptr;
     if (GetDisables(dev_data)->shader_validation) {
+        *spirv_valid = true;
+        return false;
+    }
+
+    if (pCreateInfo->codeSize % 4 == 0) {
+        std::lock_guard<std::mutex> lock(shared_modules_lock);
+        *shared_module = find_shared_module(hash_shader_code(pCreateInfo), pCreateInfo);
+    }
+    if (*shared_module) {
+        // Only valid SPIR-V is shared
+        *spirv_valid = true;
         return false;
     }
 
@@ -1533,9 +1725,11 @@ bool PreCallValidateCreateShaderModule(layer_data *dev_data, VkShaderModuleCreat
                         __LINE__, VALIDATION_ERROR_12a00ac0, "SC",
                         "SPIR-V module not valid: Codesize must be a multiple of 4 but is " PRINTF_SIZE_T_SPECIFIER ". %s",
                         pCreateInfo->codeSize, validation_error_map[VALIDATION_ERROR_12a00ac0]);
+    } else if (pCreateInfo->codeSize % 4 == 0 && check_spirv_validation_cache(pCreateInfo, false)) {
+        // Validated by an earlier run
     } else {
         // Use SPIRV-Tools validator to try and catch any issues with the module itself
-        spv_context ctx = spvContextCreate(SPV_ENV_VULKAN_1_0);
+        spv_context ctx = spvContextCreate(spirv_validation_env);
         spv_const_binary_t binary{ pCreateInfo->pCode, pCreateInfo->codeSize / sizeof(uint32_t) };
         spv_diagnostic diag = nullptr;
 
@@ -1551,6 +1745,9 @@ bool PreCallValidateCreateShaderModule(layer_data *dev_data, VkShaderModuleCreat
 
         spvDiagnosticDestroy(diag);
         spvContextDestroy(ctx);
+        if (spv_valid == SPV_SUCCESS) {
+            check_spirv_validation_cache(pCreateInfo, true);
+        }
     }
 
     *spirv_valid = (spv_valid == SPV_SUCCESS);
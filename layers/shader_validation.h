@@ -65,19 +65,55 @@ struct spirv_inst_iter {
     spirv_inst_iter const &operator*() const { return *this; }
 };
 
+typedef std::pair<unsigned, unsigned> location_t;
+typedef std::pair<unsigned, unsigned> descriptor_slot_t;
+
+struct interface_var {
+    uint32_t id;
+    uint32_t type_id;
+    uint32_t offset;
+    bool is_patch;
+    bool is_block_member;
+    bool is_relaxed_precision;
+    // TODO: collect the name, too? Isn't required to be present.
+};
+
+// What pipeline validation needs to know about one entrypoint of a module. None of it depends on the pipeline, so it is
+// worked out the first time a pipeline uses the entrypoint and shared by all later ones.
+struct shader_entrypoint {
+    uint32_t offset;  // Of the OpEntryPoint instruction
+    std::vector<std::pair<descriptor_slot_t, interface_var>> descriptor_uses;
+    std::vector<std::pair<uint32_t, interface_var>> input_attachment_uses;
+    // Offsets of the members of the push constant blocks the entrypoint uses
+    std::vector<uint32_t> push_constant_offsets;
+    // Location interfaces, empty for compute
+    std::map<location_t, interface_var> inputs;
+    std::map<location_t, interface_var> outputs;
+};
+
 struct shader_module {
     // The spirv image itself
     std::vector<uint32_t> words;
     // A mapping of <id> to the first word of its def. this is useful because walking type
     // trees, constant expressions, etc requires jumping all over the instruction stream.
     std::unordered_map<unsigned, unsigned> def_index;
+    // Offsets of the OpEntryPoint instructions, and the capabilities the module declares
+    std::vector<unsigned> entrypoint_index;
+    std::vector<uint32_t> capabilities;
+    // Locations consumed by the array, matrix and vector types, with arrays counted whole. Any other type takes one.
+    std::unordered_map<unsigned, unsigned> type_locations;
     bool has_valid_spirv;
+    // Entrypoints pipelines have used, by name and stage. Filled in during pipeline validation, which doesn't hold the
+    // global lock, so entrypoint_lock guards the map. Entries are never removed.
+    mutable std::map<std::pair<std::string, uint32_t>, std::unique_ptr<shader_entrypoint>> entrypoints;
+    mutable std::mutex entrypoint_lock;
 
     shader_module(VkShaderModuleCreateInfo const *pCreateInfo)
         : words((uint32_t *)pCreateInfo->pCode, (uint32_t *)pCreateInfo->pCode + pCreateInfo->codeSize / sizeof(uint32_t)),
           def_index(),
           has_valid_spirv(true) {
         build_def_index();
+        build_type_locations();
     }
 
     shader_module() : has_valid_spirv(false) {}
@@ -98,11 +134,18 @@ struct shader_module {
     }
 
     void build_def_index();
+    void build_type_locations();
 };
 
-bool validate_and_capture_pipeline_shader_state(layer_data *dev_data, PIPELINE_STATE *pPipeline);
+bool validate_and_capture_pipeline_shader_state(layer_data *dev_data, debug_report_data const *report_data,
+                                                PIPELINE_STATE *pPipeline);
 bool validate_compute_pipeline(layer_data *dev_data, PIPELINE_STATE *pPipeline);
-typedef std::pair<unsigned, unsigned> descriptor_slot_t;
-bool PreCallValidateCreateShaderModule(layer_data *dev_data, VkShaderModuleCreateInfo const *pCreateInfo, bool *spirv_valid);
+// Sets shared_module to a module already created from the same code, in which case the code isn't validated again
+bool PreCallValidateCreateShaderModule(layer_data *dev_data, VkShaderModuleCreateInfo const *pCreateInfo, bool *spirv_valid,
+                                       std::shared_ptr<shader_module> *shared_module);
+// Keeps the code that passes SPIR-V validation in the file at path, and skips validating code the file has, across runs
+void OpenSpirvValidationCache(char const *path);
+// Returns the module for valid SPIR-V, shared with the other modules created from the same code while any of them lives
+std::shared_ptr<shader_module> GetSharedShaderModule(VkShaderModuleCreateInfo const *pCreateInfo);
 
 #endif //VULKAN_SHADER_VALIDATION_H
@@ -92,15 +92,13 @@ VKAPI_ATTR void VKAPI_CALL DestroyInstance(VkInstance instance, const VkAllocati
         }
     }
 
-    bool threadChecks = startMultiThread();
+    bool threadChecks = startMultiThread(my_data);
     if (threadChecks) {
         startWriteObject(my_data, instance);
     }
     pTable->DestroyInstance(instance, pAllocator);
     if (threadChecks) {
         finishWriteObject(my_data, instance);
-    } else {
-        finishMultiThread();
     }
 
     // Disable and cleanup the temporary callback(s):
@@ -158,15 +156,13 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateDevice(VkPhysicalDevice gpu, const VkDevice
 VKAPI_ATTR void VKAPI_CALL DestroyDevice(VkDevice device, const VkAllocationCallbacks *pAllocator) {
     dispatch_key key = get_dispatch_key(device);
     layer_data *dev_data = GetLayerDataPtr(key, layer_data_map);
-    bool threadChecks = startMultiThread();
+    bool threadChecks = startMultiThread(dev_data);
     if (threadChecks) {
         startWriteObject(dev_data, device);
     }
     dev_data->device_dispatch_table->DestroyDevice(device, pAllocator);
     if (threadChecks) {
         finishWriteObject(dev_data, device);
-    } else {
-        finishMultiThread();
     }
 
     delete dev_data->device_dispatch_table;
@@ -179,7 +175,7 @@ VKAPI_ATTR VkResult VKAPI_CALL GetSwapchainImagesKHR(VkDevice device, VkSwapchai
     layer_data *my_data = GetLayerDataPtr(key, layer_data_map);
     VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
     VkResult result;
-    bool threadChecks = startMultiThread();
+    bool threadChecks = startMultiThread(my_data);
     if (threadChecks) {
         startReadObject(my_data, device);
         startReadObject(my_data, swapchain);
@@ -188,8 +184,6 @@ VKAPI_ATTR VkResult VKAPI_CALL GetSwapchainImagesKHR(VkDevice device, VkSwapchai
     if (threadChecks) {
         finishReadObject(my_data, device);
         finishReadObject(my_data, swapchain);
-    } else {
-        finishMultiThread();
     }
     return result;
 }
@@ -276,7 +270,7 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateDebugReportCallbackEXT(VkInstance instance,
                                                             const VkAllocationCallbacks *pAllocator,
                                                             VkDebugReportCallbackEXT *pMsgCallback) {
     layer_data *my_data = GetLayerDataPtr(get_dispatch_key(instance), layer_data_map);
-    bool threadChecks = startMultiThread();
+    bool threadChecks = startMultiThread(my_data);
     if (threadChecks) {
         startReadObject(my_data, instance);
     }
@@ -287,8 +281,6 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateDebugReportCallbackEXT(VkInstance instance,
     }
     if (threadChecks) {
         finishReadObject(my_data, instance);
-    } else {
-        finishMultiThread();
     }
     return result;
 }
@@ -296,7 +288,7 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateDebugReportCallbackEXT(VkInstance instance,
 VKAPI_ATTR void VKAPI_CALL DestroyDebugReportCallbackEXT(VkInstance instance, VkDebugReportCallbackEXT callback,
                                                          const VkAllocationCallbacks *pAllocator) {
     layer_data *my_data = GetLayerDataPtr(get_dispatch_key(instance), layer_data_map);
-    bool threadChecks = startMultiThread();
+    bool threadChecks = startMultiThread(my_data);
     if (threadChecks) {
         startReadObject(my_data, instance);
         startWriteObject(my_data, callback);
@@ -306,8 +298,6 @@ VKAPI_ATTR void VKAPI_CALL DestroyDebugReportCallbackEXT(VkInstance instance, Vk
     if (threadChecks) {
         finishReadObject(my_data, instance);
         finishWriteObject(my_data, callback);
-    } else {
-        finishMultiThread();
     }
 }
 
@@ -317,7 +307,7 @@ VKAPI_ATTR VkResult VKAPI_CALL AllocateCommandBuffers(VkDevice device, const VkC
     layer_data *my_data = GetLayerDataPtr(key, layer_data_map);
     VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
     VkResult result;
-    bool threadChecks = startMultiThread();
+    bool threadChecks = startMultiThread(my_data);
     if (threadChecks) {
         startReadObject(my_data, device);
         startWriteObject(my_data, pAllocateInfo->commandPool);
@@ -327,8 +317,6 @@ VKAPI_ATTR VkResult VKAPI_CALL AllocateCommandBuffers(VkDevice device, const VkC
     if (threadChecks) {
         finishReadObject(my_data, device);
         finishWriteObject(my_data, pAllocateInfo->commandPool);
-    } else {
-        finishMultiThread();
     }
 
     // Record mapping from command buffer to command pool
@@ -348,7 +336,7 @@ VKAPI_ATTR VkResult VKAPI_CALL AllocateDescriptorSets(VkDevice device, const VkD
     layer_data *my_data = GetLayerDataPtr(key, layer_data_map);
     VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
     VkResult result;
-    bool threadChecks = startMultiThread();
+    bool threadChecks = startMultiThread(my_data);
     if (threadChecks) {
         startReadObject(my_data, device);
         startWriteObject(my_data, pAllocateInfo->descriptorPool);
@@ -359,8 +347,6 @@ VKAPI_ATTR VkResult VKAPI_CALL AllocateDescriptorSets(VkDevice device, const VkD
         finishReadObject(my_data, device);
         finishWriteObject(my_data, pAllocateInfo->descriptorPool);
         // Host access to pAllocateInfo::descriptorPool must be externally synchronized
-    } else {
-        finishMultiThread();
     }
     return result;
 }
@@ -371,7 +357,7 @@ VKAPI_ATTR void VKAPI_CALL FreeCommandBuffers(VkDevice device, VkCommandPool com
     layer_data *my_data = GetLayerDataPtr(key, layer_data_map);
     VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
     const bool lockCommandPool = false;  // pool is already directly locked
-    bool threadChecks = startMultiThread();
+    bool threadChecks = startMultiThread(my_data);
     if (threadChecks) {
         startReadObject(my_data, device);
         startWriteObject(my_data, commandPool);
@@ -391,8 +377,6 @@ VKAPI_ATTR void VKAPI_CALL FreeCommandBuffers(VkDevice device, VkCommandPool com
     if (threadChecks) {
         finishReadObject(my_data, device);
         finishWriteObject(my_data, commandPool);
-    } else {
-        finishMultiThread();
     }
 }
 
@@ -418,6 +402,9 @@ VKAPI_ATTR void VKAPI_CALL vkDebugReportMessageEXT(VkInstance instance, VkDebugR
     threading::DebugReportMessageEXT(instance, flags, objType, object, location, msgCode, pLayerPrefix, pMsg);
 }
 
+// In the combined validation layer combined_validation.cpp provides the loader-layer interface
+#ifndef VK_LAYER_COMBINED
+
 // loader-layer interface v0, just wrappers since there is only a layer
 
 VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceExtensionProperties(const char *pLayerName, uint32_t *pCount,
@@ -477,3 +464,5 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
 
     return VK_SUCCESS;
 }
+
+#endif  // VK_LAYER_COMBINED
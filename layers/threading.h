@@ -20,8 +20,10 @@
 
 #ifndef THREADING_H
 #define THREADING_H
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
+#include <unordered_map>
 #include <vector>
 #include "vk_layer_config.h"
 #include "vk_layer_logging.h"
@@ -48,103 +50,51 @@ struct object_use_data {
 
 struct layer_data;
 
-namespace threading {
-volatile bool vulkan_in_use = false;
-volatile bool vulkan_multi_threaded = false;
-// starting check if an application is using vulkan from multiple threads.
-inline bool startMultiThread() {
-    if (vulkan_multi_threaded) {
-        return true;
-    }
-    if (vulkan_in_use) {
-        vulkan_multi_threaded = true;
-        return true;
-    }
-    vulkan_in_use = true;
-    return false;
-}
-
-// finishing check if an application is using vulkan from multiple threads.
-inline void finishMultiThread() { vulkan_in_use = false; }
-}  // namespace threading
-
 template <typename T>
 class counter {
    public:
     const char *typeName;
     VkDebugReportObjectTypeEXT objectType;
-    std::unordered_map<T, object_use_data> uses;
-    std::mutex counter_lock;
-    std::condition_variable counter_condition;
     void startWrite(debug_report_data *report_data, T object) {
         if (object == VK_NULL_HANDLE) {
             return;
         }
         bool skipCall = false;
         loader_platform_thread_id tid = loader_platform_get_thread_id();
-        std::unique_lock<std::mutex> lock(counter_lock);
-        if (uses.find(object) == uses.end()) {
+        counter_shard &shard = getShard(object);
+        std::unique_lock<std::mutex> lock(shard.lock);
+        auto use = shard.uses.find(object);
+        if (use == shard.uses.end()) {
             // There is no current use of the object.  Record writer thread.
-            struct object_use_data *use_data = &uses[object];
+            struct object_use_data *use_data = &shard.uses[object];
             use_data->reader_count = 0;
             use_data->writer_count = 1;
             use_data->thread = tid;
         } else {
-            struct object_use_data *use_data = &uses[object];
-            if (use_data->reader_count == 0) {
-                // There are no readers.  Two writers just collided.
-                if (use_data->thread != tid) {
-                    skipCall |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, objectType, (uint64_t)(object), 0,
-                                        THREADING_CHECKER_MULTIPLE_THREADS, "THREADING",
-                                        "THREADING ERROR : object of type %s is simultaneously used in thread %ld and thread %ld",
-                                        typeName, use_data->thread, tid);
-                    if (skipCall) {
-                        // Wait for thread-safe access to object instead of skipping call.
-                        while (uses.find(object) != uses.end()) {
-                            counter_condition.wait(lock);
-                        }
-                        // There is now no current use of the object.  Record writer thread.
-                        struct object_use_data *new_use_data = &uses[object];
-                        new_use_data->thread = tid;
-                        new_use_data->reader_count = 0;
-                        new_use_data->writer_count = 1;
-                    } else {
-                        // Continue with an unsafe use of the object.
-                        use_data->thread = tid;
-                        use_data->writer_count += 1;
-                    }
+            struct object_use_data *use_data = &use->second;
+            if (use_data->thread != tid) {
+                // Either two writers collided, or this writer collided with readers.
+                skipCall |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, objectType, (uint64_t)(object), 0,
+                                    THREADING_CHECKER_MULTIPLE_THREADS, "THREADING",
+                                    "THREADING ERROR : object of type %s is simultaneously used in thread %ld and thread %ld",
+                                    typeName, use_data->thread, tid);
+                if (skipCall) {
+                    // Wait for thread-safe access to object instead of skipping call.
+                    waitForNoUse(shard, lock, object);
+                    // There is now no current use of the object.  Record writer thread.
+                    struct object_use_data *new_use_data = &shard.uses[object];
+                    new_use_data->thread = tid;
+                    new_use_data->reader_count = 0;
+                    new_use_data->writer_count = 1;
                 } else {
-                    // This is either safe multiple use in one call, or recursive use.
-                    // There is no way to make recursion safe.  Just forge ahead.
+                    // Continue with an unsafe use of the object.
+                    use_data->thread = tid;
                     use_data->writer_count += 1;
                 }
             } else {
-                // There are readers.  This writer collided with them.
-                if (use_data->thread != tid) {
-                    skipCall |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, objectType, (uint64_t)(object), 0,
-                                        THREADING_CHECKER_MULTIPLE_THREADS, "THREADING",
-                                        "THREADING ERROR : object of type %s is simultaneously used in thread %ld and thread %ld",
-                                        typeName, use_data->thread, tid);
-                    if (skipCall) {
-                        // Wait for thread-safe access to object instead of skipping call.
-                        while (uses.find(object) != uses.end()) {
-                            counter_condition.wait(lock);
-                        }
-                        // There is now no current use of the object.  Record writer thread.
-                        struct object_use_data *new_use_data = &uses[object];
-                        new_use_data->thread = tid;
-                        new_use_data->reader_count = 0;
-                        new_use_data->writer_count = 1;
-                    } else {
-                        // Continue with an unsafe use of the object.
-                        use_data->thread = tid;
-                        use_data->writer_count += 1;
-                    }
-                } else {
-                    // This is either safe multiple use in one call, or recursive use.
-                    // There is no way to make recursion safe.  Just forge ahead.
-                    use_data->writer_count += 1;
-                }
+                // This is either safe multiple use in one call, or recursive use.
+                // There is no way to make recursion safe.  Just forge ahead.
+                use_data->writer_count += 1;
             }
         }
     }
@@ -154,14 +104,16 @@ class counter {
             return;
         }
         // Object is no longer in use
-        std::unique_lock<std::mutex> lock(counter_lock);
-        uses[object].writer_count -= 1;
-        if ((uses[object].reader_count == 0) && (uses[object].writer_count == 0)) {
-            uses.erase(object);
+        counter_shard &shard = getShard(object);
+        std::unique_lock<std::mutex> lock(shard.lock);
+        auto use = shard.uses.find(object);
+        if (use != shard.uses.end()) {
+            use->second.writer_count -= 1;
+            if ((use->second.reader_count == 0) && (use->second.writer_count == 0)) {
+                shard.uses.erase(use);
+            }
         }
-        // Notify any waiting threads that this object may be safe to use
-        lock.unlock();
-        counter_condition.notify_all();
+        notifyWaiters(shard, lock);
     }
 
     void startRead(debug_report_data *report_data, T object) {
@@ -170,54 +122,93 @@ class counter {
         }
         bool skipCall = false;
         loader_platform_thread_id tid = loader_platform_get_thread_id();
-        std::unique_lock<std::mutex> lock(counter_lock);
-        if (uses.find(object) == uses.end()) {
+        counter_shard &shard = getShard(object);
+        std::unique_lock<std::mutex> lock(shard.lock);
+        auto use = shard.uses.find(object);
+        if (use == shard.uses.end()) {
             // There is no current use of the object.  Record reader count
-            struct object_use_data *use_data = &uses[object];
+            struct object_use_data *use_data = &shard.uses[object];
             use_data->reader_count = 1;
             use_data->writer_count = 0;
             use_data->thread = tid;
-        } else if (uses[object].writer_count > 0 && uses[object].thread != tid) {
+        } else if (use->second.writer_count > 0 && use->second.thread != tid) {
             // There is a writer of the object.
             skipCall |= log_msg(report_data, VK_DEBUG_REPORT_ERROR_BIT_EXT, objectType, (uint64_t)(object), 0,
                                 THREADING_CHECKER_MULTIPLE_THREADS, "THREADING",
                                 "THREADING ERROR : object of type %s is simultaneously used in thread %ld and thread %ld", typeName,
-                                uses[object].thread, tid);
+                                use->second.thread, tid);
             if (skipCall) {
                 // Wait for thread-safe access to object instead of skipping call.
-                while (uses.find(object) != uses.end()) {
-                    counter_condition.wait(lock);
-                }
+                waitForNoUse(shard, lock, object);
                 // There is no current use of the object.  Record reader count
-                struct object_use_data *use_data = &uses[object];
+                struct object_use_data *use_data = &shard.uses[object];
                 use_data->reader_count = 1;
                 use_data->writer_count = 0;
                 use_data->thread = tid;
             } else {
-                uses[object].reader_count += 1;
+                use->second.reader_count += 1;
             }
         } else {
             // There are other readers of the object.  Increase reader count
-            uses[object].reader_count += 1;
+            use->second.reader_count += 1;
         }
     }
     void finishRead(T object) {
         if (object == VK_NULL_HANDLE) {
             return;
         }
-        std::unique_lock<std::mutex> lock(counter_lock);
-        uses[object].reader_count -= 1;
-        if ((uses[object].reader_count == 0) && (uses[object].writer_count == 0)) {
-            uses.erase(object);
+        counter_shard &shard = getShard(object);
+        std::unique_lock<std::mutex> lock(shard.lock);
+        auto use = shard.uses.find(object);
+        if (use != shard.uses.end()) {
+            use->second.reader_count -= 1;
+            if ((use->second.reader_count == 0) && (use->second.writer_count == 0)) {
+                shard.uses.erase(use);
+            }
         }
-        // Notify any waiting threads that this object may be safe to use
-        lock.unlock();
-        counter_condition.notify_all();
+        notifyWaiters(shard, lock);
     }
     counter(const char *name = "", VkDebugReportObjectTypeEXT type = VK_DEBUG_REPORT_OBJECT_TYPE_UNKNOWN_EXT) {
         typeName = name;
         objectType = type;
     }
+
+   private:
+    // The objects in use are spread over shards that each have their own lock, so threads using different objects of a type
+    // rarely wait on each other. Only threads that had to wait for an object sleep on the condition variable, so releasing
+    // an object nobody is waiting for doesn't wake anyone.
+    static const size_t kShardCount = 16;
+
+    struct counter_shard {
+        std::unordered_map<T, object_use_data> uses;
+        std::mutex lock;
+        std::condition_variable condition;
+        uint32_t waiters = 0;
+    };
+
+    counter_shard &getShard(T object) {
+        // Handles are mostly aligned addresses, so mix the bits before picking a shard
+        return shards[(HandleToUint64(object) * 0x9E3779B97F4A7C15ull) >> 60];
+    }
+
+    void waitForNoUse(counter_shard &shard, std::unique_lock<std::mutex> &lock, T object) {
+        shard.waiters++;
+        while (shard.uses.find(object) != shard.uses.end()) {
+            shard.condition.wait(lock);
+        }
+        shard.waiters--;
+    }
+
+    void notifyWaiters(counter_shard &shard, std::unique_lock<std::mutex> &lock) {
+        bool waiting = shard.waiters > 0;
+        lock.unlock();
+        // Notify any waiting threads that this object may be safe to use
+        if (waiting) {
+            shard.condition.notify_all();
+        }
+    }
+
+    counter_shard shards[kShardCount];
 };
 
 struct layer_data {
@@ -232,6 +223,10 @@ struct layer_data {
     uint32_t num_tmp_callbacks;
     VkDebugReportCallbackCreateInfoEXT *tmp_dbg_create_infos;
     VkDebugReportCallbackEXT *tmp_callbacks;
+    // The thread that created the instance or device, and whether any other thread has called into it since.
+    // See startMultiThread().
+    loader_platform_thread_id owner_thread;
+    std::atomic<bool> multi_threaded;
     counter<VkCommandBuffer> c_VkCommandBuffer;
     counter<VkDevice> c_VkDevice;
     counter<VkInstance> c_VkInstance;
@@ -276,6 +271,8 @@ struct layer_data {
           num_tmp_callbacks(0),
           tmp_dbg_create_infos(nullptr),
           tmp_callbacks(nullptr),
+          owner_thread(loader_platform_get_thread_id()),
+          multi_threaded(false),
           c_VkCommandBuffer("VkCommandBuffer", VK_DEBUG_REPORT_OBJECT_TYPE_COMMAND_BUFFER_EXT),
           c_VkDevice("VkDevice", VK_DEBUG_REPORT_OBJECT_TYPE_DEVICE_EXT),
           c_VkInstance("VkInstance", VK_DEBUG_REPORT_OBJECT_TYPE_INSTANCE_EXT),
@@ -316,6 +313,23 @@ struct layer_data {
               {};
 };
 
+namespace threading {
+// Checks whether a call needs its objects tracked. Until a thread other than the one that created the instance or device
+// calls into it, no two calls can overlap, so the tracking is skipped and a call costs only this thread id check. Once a
+// second thread shows up every later call is tracked; a call already in flight on the first thread when that happens is
+// not, so a collision with it can go unreported.
+inline bool startMultiThread(layer_data *my_data) {
+    if (my_data->multi_threaded.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    if (loader_platform_get_thread_id() == my_data->owner_thread) {
+        return false;
+    }
+    my_data->multi_threaded.store(true, std::memory_order_relaxed);
+    return true;
+}
+}  // namespace threading
+
 #define WRAPPER(type)                                                                                                 \
     static void startWriteObject(struct layer_data *my_data, type object) {                                           \
         my_data->c_##type.startWrite(my_data->report_data, object);                                                   \
@@ -49,7 +49,10 @@
 #include "vulkan/vk_layer.h"
 
 // This intentionally includes a cpp file
+// The combined validation layer gets these from core_validation.cpp
+#ifndef VK_LAYER_COMBINED
 #include "vk_safe_struct.cpp"
+#endif
 
 #include "unique_objects_wrappers.h"
 
@@ -283,12 +286,13 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateComputePipelines(VkDevice device, VkPipelin
                                                       const VkComputePipelineCreateInfo *pCreateInfos,
                                                       const VkAllocationCallbacks *pAllocator, VkPipeline *pPipelines) {
     layer_data *device_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    ScratchArenaScope scratch_scope;
     safe_VkComputePipelineCreateInfo *local_pCreateInfos = NULL;
     if (pCreateInfos) {
         std::lock_guard<std::mutex> lock(global_lock);
-        local_pCreateInfos = new safe_VkComputePipelineCreateInfo[createInfoCount];
+        local_pCreateInfos = scratch_arena.NewArray<safe_VkComputePipelineCreateInfo>(createInfoCount);
         for (uint32_t idx0 = 0; idx0 < createInfoCount; ++idx0) {
-            local_pCreateInfos[idx0].initialize(&pCreateInfos[idx0]);
+            local_pCreateInfos[idx0].initialize(&pCreateInfos[idx0], &scratch_arena);
             if (pCreateInfos[idx0].basePipelineHandle) {
                 local_pCreateInfos[idx0].basePipelineHandle = Unwrap(device_data, pCreateInfos[idx0].basePipelineHandle);
             }
@@ -307,7 +311,6 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateComputePipelines(VkDevice device, VkPipelin
 
     VkResult result = device_data->dispatch_table.CreateComputePipelines(
         device, pipelineCache, createInfoCount, local_pCreateInfos->ptr(), pAllocator, pPipelines);
-    delete[] local_pCreateInfos;
     {
         std::lock_guard<std::mutex> lock(global_lock);
         for (uint32_t i = 0; i < createInfoCount; ++i) {
@@ -323,12 +326,13 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateGraphicsPipelines(VkDevice device, VkPipeli
                                                        const VkGraphicsPipelineCreateInfo *pCreateInfos,
                                                        const VkAllocationCallbacks *pAllocator, VkPipeline *pPipelines) {
     layer_data *device_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    ScratchArenaScope scratch_scope;
     safe_VkGraphicsPipelineCreateInfo *local_pCreateInfos = nullptr;
     if (pCreateInfos) {
-        local_pCreateInfos = new safe_VkGraphicsPipelineCreateInfo[createInfoCount];
+        local_pCreateInfos = scratch_arena.NewArray<safe_VkGraphicsPipelineCreateInfo>(createInfoCount);
         std::lock_guard<std::mutex> lock(global_lock);
         for (uint32_t idx0 = 0; idx0 < createInfoCount; ++idx0) {
-            local_pCreateInfos[idx0].initialize(&pCreateInfos[idx0]);
+            local_pCreateInfos[idx0].initialize(&pCreateInfos[idx0], &scratch_arena);
             if (pCreateInfos[idx0].basePipelineHandle) {
                 local_pCreateInfos[idx0].basePipelineHandle = Unwrap(device_data, pCreateInfos[idx0].basePipelineHandle);
             }
@@ -354,7 +358,6 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateGraphicsPipelines(VkDevice device, VkPipeli
 
     VkResult result = device_data->dispatch_table.CreateGraphicsPipelines(
         device, pipelineCache, createInfoCount, local_pCreateInfos->ptr(), pAllocator, pPipelines);
-    delete[] local_pCreateInfos;
     {
         std::lock_guard<std::mutex> lock(global_lock);
         for (uint32_t i = 0; i < createInfoCount; ++i) {
@@ -446,11 +449,12 @@ VKAPI_ATTR VkResult VKAPI_CALL GetSwapchainImagesKHR(VkDevice device, VkSwapchai
 
 VKAPI_ATTR VkResult VKAPI_CALL QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo) {
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(queue), layer_data_map);
+    ScratchArenaScope scratch_scope;
     safe_VkPresentInfoKHR *local_pPresentInfo = NULL;
     {
         std::lock_guard<std::mutex> lock(global_lock);
         if (pPresentInfo) {
-            local_pPresentInfo = new safe_VkPresentInfoKHR(pPresentInfo);
+            local_pPresentInfo = scratch_arena.New<safe_VkPresentInfoKHR>(pPresentInfo);
             if (local_pPresentInfo->pWaitSemaphores) {
                 for (uint32_t index1 = 0; index1 < local_pPresentInfo->waitSemaphoreCount; ++index1) {
                     local_pPresentInfo->pWaitSemaphores[index1] = Unwrap(dev_data, pPresentInfo->pWaitSemaphores[index1]);
@@ -472,11 +476,98 @@ VKAPI_ATTR VkResult VKAPI_CALL QueuePresentKHR(VkQueue queue, const VkPresentInf
             pPresentInfo->pResults[i] = local_pPresentInfo->pResults[i];
         }
     }
-
-    if (local_pPresentInfo) delete local_pPresentInfo;
     return result;
 }
 
+static size_t DescriptorInfoSize(VkDescriptorType type) {
+    switch (type) {
+        case VK_DESCRIPTOR_TYPE_SAMPLER:
+        case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+        case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+        case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+        case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+            return sizeof(VkDescriptorImageInfo);
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+            return sizeof(VkDescriptorBufferInfo);
+        case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+        case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+            return sizeof(VkBufferView);
+        default:
+            assert(0);
+            return 0;
+    }
+}
+
+// Fill in where the handles are in the update data of a template, so updates don't have to decode create_info again
+static void CompileUpdateTemplate(TEMPLATE_STATE *template_state) {
+    auto const &create_info = template_state->create_info;
+    for (uint32_t i = 0; i < create_info.descriptorUpdateEntryCount; i++) {
+        auto const &entry = create_info.pDescriptorUpdateEntries[i];
+        for (uint32_t j = 0; j < entry.descriptorCount; j++) {
+            size_t offset = entry.offset + j * entry.stride;
+            template_state->handle_offsets.emplace_back(offset, entry.descriptorType);
+            template_state->data_size = std::max(template_state->data_size, offset + DescriptorInfoSize(entry.descriptorType));
+        }
+    }
+}
+
+// A copy of the data of an update through a descriptor update template, with its handles unwrapped. Only data larger than
+//  most templates read needs a heap allocation.
+class UnwrappedTemplateData {
+   public:
+    // Must be called with global_lock held
+    UnwrappedTemplateData(layer_data *dev_data, TEMPLATE_STATE const &template_state, const void *pData) : data_(local_data_) {
+        if (template_state.data_size > sizeof(local_data_)) {
+            heap_data_.reset(new uint64_t[(template_state.data_size + sizeof(uint64_t) - 1) / sizeof(uint64_t)]);
+            data_ = heap_data_.get();
+        }
+        for (auto const &handle_offset : template_state.handle_offsets) {
+            const char *source = static_cast<const char *>(pData) + handle_offset.first;
+            char *destination = reinterpret_cast<char *>(data_) + handle_offset.first;
+            switch (handle_offset.second) {
+                case VK_DESCRIPTOR_TYPE_SAMPLER:
+                case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+                case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+                case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+                case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT: {
+                    VkDescriptorImageInfo image_info = *reinterpret_cast<const VkDescriptorImageInfo *>(source);
+                    image_info.sampler = Unwrap(dev_data, image_info.sampler);
+                    image_info.imageView = Unwrap(dev_data, image_info.imageView);
+                    *reinterpret_cast<VkDescriptorImageInfo *>(destination) = image_info;
+                } break;
+
+                case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+                case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+                case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+                case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC: {
+                    VkDescriptorBufferInfo buffer_info = *reinterpret_cast<const VkDescriptorBufferInfo *>(source);
+                    buffer_info.buffer = Unwrap(dev_data, buffer_info.buffer);
+                    *reinterpret_cast<VkDescriptorBufferInfo *>(destination) = buffer_info;
+                } break;
+
+                case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+                case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+                    *reinterpret_cast<VkBufferView *>(destination) =
+                        Unwrap(dev_data, *reinterpret_cast<const VkBufferView *>(source));
+                    break;
+                default:
+                    assert(0);
+                    break;
+            }
+        }
+    }
+
+    const void *data() const { return data_; }
+
+   private:
+    uint64_t local_data_[256];
+    std::unique_ptr<uint64_t[]> heap_data_;
+    uint64_t *data_;
+};
+
 VKAPI_ATTR VkResult VKAPI_CALL CreateDescriptorUpdateTemplateKHR(VkDevice device,
                                                                  const VkDescriptorUpdateTemplateCreateInfoKHR *pCreateInfo,
                                                                  const VkAllocationCallbacks *pAllocator,
@@ -503,6 +594,7 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateDescriptorUpdateTemplateKHR(VkDevice device
 
         // Shadow template createInfo for later updates
         std::unique_ptr<TEMPLATE_STATE> template_state(new TEMPLATE_STATE(*pDescriptorUpdateTemplate, local_create_info));
+        CompileUpdateTemplate(template_state.get());
         dev_data->desc_template_map[(uint64_t)*pDescriptorUpdateTemplate] = std::move(template_state);
     }
     return result;
@@ -515,108 +607,25 @@ VKAPI_ATTR void VKAPI_CALL DestroyDescriptorUpdateTemplateKHR(VkDevice device,
     std::unique_lock<std::mutex> lock(global_lock);
     uint64_t descriptor_update_template_id = reinterpret_cast<uint64_t &>(descriptorUpdateTemplate);
     dev_data->desc_template_map.erase(descriptor_update_template_id);
-    descriptorUpdateTemplate = (VkDescriptorUpdateTemplateKHR)dev_data->unique_id_mapping[descriptor_update_template_id];
-    dev_data->unique_id_mapping.erase(descriptor_update_template_id);
+    descriptorUpdateTemplate = (VkDescriptorUpdateTemplateKHR)dev_data->unique_id_mapping.erase(descriptor_update_template_id);
     lock.unlock();
     dev_data->dispatch_table.DestroyDescriptorUpdateTemplateKHR(device, descriptorUpdateTemplate, pAllocator);
 }
 
-void *BuildUnwrappedUpdateTemplateBuffer(layer_data *dev_data, uint64_t descriptorUpdateTemplate, const void *pData) {
-    auto const template_map_entry = dev_data->desc_template_map.find(descriptorUpdateTemplate);
-    if (template_map_entry == dev_data->desc_template_map.end()) {
-        assert(0);
-    }
-    auto const &create_info = template_map_entry->second->create_info;
-    size_t allocation_size = 0;
-    std::vector<std::tuple<size_t, VulkanObjectType, void *>> template_entries;
-
-    for (uint32_t i = 0; i < create_info.descriptorUpdateEntryCount; i++) {
-        for (uint32_t j = 0; j < create_info.pDescriptorUpdateEntries[i].descriptorCount; j++) {
-            size_t offset = create_info.pDescriptorUpdateEntries[i].offset + j * create_info.pDescriptorUpdateEntries[i].stride;
-            char *update_entry = (char *)(pData) + offset;
-
-            switch (create_info.pDescriptorUpdateEntries[i].descriptorType) {
-                case VK_DESCRIPTOR_TYPE_SAMPLER:
-                case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
-                case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
-                case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
-                case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT: {
-                    auto image_entry = reinterpret_cast<VkDescriptorImageInfo *>(update_entry);
-                    allocation_size = std::max(allocation_size, offset + sizeof(VkDescriptorImageInfo));
-
-                    VkDescriptorImageInfo *wrapped_entry = new VkDescriptorImageInfo(*image_entry);
-                    wrapped_entry->sampler = Unwrap(dev_data, image_entry->sampler);
-                    wrapped_entry->imageView = Unwrap(dev_data, image_entry->imageView);
-                    template_entries.emplace_back(offset, kVulkanObjectTypeImage, reinterpret_cast<void *>(wrapped_entry));
-                } break;
-
-                case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
-                case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
-                case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
-                case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC: {
-                    auto buffer_entry = reinterpret_cast<VkDescriptorBufferInfo *>(update_entry);
-                    allocation_size = std::max(allocation_size, offset + sizeof(VkDescriptorBufferInfo));
-
-                    VkDescriptorBufferInfo *wrapped_entry = new VkDescriptorBufferInfo(*buffer_entry);
-                    wrapped_entry->buffer = Unwrap(dev_data, buffer_entry->buffer);
-                    template_entries.emplace_back(offset, kVulkanObjectTypeBuffer, reinterpret_cast<void *>(wrapped_entry));
-                } break;
-
-                case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
-                case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER: {
-                    auto buffer_view_handle = reinterpret_cast<VkBufferView *>(update_entry);
-                    allocation_size = std::max(allocation_size, offset + sizeof(VkBufferView));
-
-                    VkBufferView wrapped_entry = Unwrap(dev_data, *buffer_view_handle);
-                    template_entries.emplace_back(offset, kVulkanObjectTypeBufferView, reinterpret_cast<void *>(wrapped_entry));
-                } break;
-                default:
-                    assert(0);
-                    break;
-            }
-        }
-    }
-    // Allocate required buffer size and populate with source/unwrapped data
-    void *unwrapped_data = malloc(allocation_size);
-    for (auto &this_entry : template_entries) {
-        VulkanObjectType type = std::get<1>(this_entry);
-        void *destination = (char *)unwrapped_data + std::get<0>(this_entry);
-        void *source = (char *)std::get<2>(this_entry);
-
-        switch (type) {
-            case kVulkanObjectTypeImage:
-                *(reinterpret_cast<VkDescriptorImageInfo *>(destination)) = *(reinterpret_cast<VkDescriptorImageInfo *>(source));
-                delete reinterpret_cast<VkDescriptorImageInfo *>(source);
-                break;
-            case kVulkanObjectTypeBuffer:
-                *(reinterpret_cast<VkDescriptorBufferInfo *>(destination)) = *(reinterpret_cast<VkDescriptorBufferInfo *>(source));
-                delete reinterpret_cast<VkDescriptorBufferInfo *>(source);
-                break;
-            case kVulkanObjectTypeBufferView:
-                *(reinterpret_cast<VkBufferView *>(destination)) = reinterpret_cast<VkBufferView>(source);
-                break;
-            default:
-                assert(0);
-                break;
-        }
-    }
-    return (void *)unwrapped_data;
-}
-
 VKAPI_ATTR void VKAPI_CALL UpdateDescriptorSetWithTemplateKHR(VkDevice device, VkDescriptorSet descriptorSet,
                                                               VkDescriptorUpdateTemplateKHR descriptorUpdateTemplate,
                                                               const void *pData) {
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
     uint64_t template_handle = reinterpret_cast<uint64_t &>(descriptorUpdateTemplate);
-    {
-        std::lock_guard<std::mutex> lock(global_lock);
-        descriptorSet = Unwrap(dev_data, descriptorSet);
-        descriptorUpdateTemplate = (VkDescriptorUpdateTemplateKHR)dev_data->unique_id_mapping[template_handle];
-    }
-    void *unwrapped_buffer = BuildUnwrappedUpdateTemplateBuffer(dev_data, template_handle, pData);
+    std::unique_lock<std::mutex> lock(global_lock);
+    descriptorSet = Unwrap(dev_data, descriptorSet);
+    descriptorUpdateTemplate = (VkDescriptorUpdateTemplateKHR)dev_data->unique_id_mapping.find(template_handle);
+    auto const template_map_entry = dev_data->desc_template_map.find(template_handle);
+    assert(template_map_entry != dev_data->desc_template_map.end());
+    UnwrappedTemplateData unwrapped_data(dev_data, *template_map_entry->second, pData);
+    lock.unlock();
     dev_data->dispatch_table.UpdateDescriptorSetWithTemplateKHR(device, descriptorSet, descriptorUpdateTemplate,
-                                                                        unwrapped_buffer);
-    free(unwrapped_buffer);
+                                                                        unwrapped_data.data());
 }
 
 VKAPI_ATTR void VKAPI_CALL CmdPushDescriptorSetWithTemplateKHR(VkCommandBuffer commandBuffer,
@@ -624,15 +633,15 @@ VKAPI_ATTR void VKAPI_CALL CmdPushDescriptorSetWithTemplateKHR(VkCommandBuffer c
                                                                VkPipelineLayout layout, uint32_t set, const void *pData) {
     layer_data *dev_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
     uint64_t template_handle = reinterpret_cast<uint64_t &>(descriptorUpdateTemplate);
-    {
-        std::lock_guard<std::mutex> lock(global_lock);
-        descriptorUpdateTemplate = Unwrap(dev_data, descriptorUpdateTemplate);
-        layout = Unwrap(dev_data, layout);
-    }
-    void *unwrapped_buffer = BuildUnwrappedUpdateTemplateBuffer(dev_data, template_handle, pData);
+    std::unique_lock<std::mutex> lock(global_lock);
+    descriptorUpdateTemplate = Unwrap(dev_data, descriptorUpdateTemplate);
+    layout = Unwrap(dev_data, layout);
+    auto const template_map_entry = dev_data->desc_template_map.find(template_handle);
+    assert(template_map_entry != dev_data->desc_template_map.end());
+    UnwrappedTemplateData unwrapped_data(dev_data, *template_map_entry->second, pData);
+    lock.unlock();
     dev_data->dispatch_table.CmdPushDescriptorSetWithTemplateKHR(commandBuffer, descriptorUpdateTemplate, layout, set,
-                                                                         unwrapped_buffer);
-    free(unwrapped_buffer);
+                                                                         unwrapped_data.data());
 }
 
 #ifndef __ANDROID__
@@ -661,9 +670,9 @@ VKAPI_ATTR VkResult VKAPI_CALL GetDisplayPlaneSupportedDisplaysKHR(VkPhysicalDev
             std::lock_guard<std::mutex> lock(global_lock);
             for (uint32_t i = 0; i < *pDisplayCount; i++) {
                 // TODO: this looks like it really wants a /reverse/ mapping. What's going on here?
-                auto it = my_map_data->unique_id_mapping.find(reinterpret_cast<const uint64_t &>(pDisplays[i]));
-                assert(it != my_map_data->unique_id_mapping.end());
-                pDisplays[i] = reinterpret_cast<VkDisplayKHR &>(it->second);
+                uint64_t handle = my_map_data->unique_id_mapping.find(reinterpret_cast<const uint64_t &>(pDisplays[i]));
+                assert(handle != 0);
+                pDisplays[i] = reinterpret_cast<VkDisplayKHR &>(handle);
             }
         }
     }
@@ -707,9 +716,9 @@ VKAPI_ATTR VkResult VKAPI_CALL DebugMarkerSetObjectTagEXT(VkDevice device, const
     auto local_tag_info = new safe_VkDebugMarkerObjectTagInfoEXT(pTagInfo);
     {
         std::lock_guard<std::mutex> lock(global_lock);
-        auto it = device_data->unique_id_mapping.find(reinterpret_cast<uint64_t &>(local_tag_info->object));
-        if (it != device_data->unique_id_mapping.end()) {
-            local_tag_info->object = it->second;
+        uint64_t handle = device_data->unique_id_mapping.find(local_tag_info->object);
+        if (handle != 0) {
+            local_tag_info->object = handle;
         }
     }
     VkResult result = device_data->dispatch_table.DebugMarkerSetObjectTagEXT(
@@ -722,9 +731,9 @@ VKAPI_ATTR VkResult VKAPI_CALL DebugMarkerSetObjectNameEXT(VkDevice device, cons
     auto local_name_info = new safe_VkDebugMarkerObjectNameInfoEXT(pNameInfo);
     {
         std::lock_guard<std::mutex> lock(global_lock);
-        auto it = device_data->unique_id_mapping.find(reinterpret_cast<uint64_t &>(local_name_info->object));
-        if (it != device_data->unique_id_mapping.end()) {
-            local_name_info->object = it->second;
+        uint64_t handle = device_data->unique_id_mapping.find(local_name_info->object);
+        if (handle != 0) {
+            local_name_info->object = handle;
         }
     }
     VkResult result = device_data->dispatch_table.DebugMarkerSetObjectNameEXT(
@@ -734,6 +743,9 @@ VKAPI_ATTR VkResult VKAPI_CALL DebugMarkerSetObjectNameEXT(VkDevice device, cons
 
 }  // namespace unique_objects
 
+// In the combined validation layer combined_validation.cpp provides the loader-layer interface
+#ifndef VK_LAYER_COMBINED
+
 VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceExtensionProperties(const char *pLayerName, uint32_t *pCount,
                                                                                       VkExtensionProperties *pProperties) {
     return unique_objects::EnumerateInstanceExtensionProperties(pLayerName, pCount, pProperties);
@@ -789,3 +801,5 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
 
     return VK_SUCCESS;
 }
+
+#endif  // VK_LAYER_COMBINED
@@ -25,20 +25,148 @@
 #include "vk_safe_struct.h"
 #include "vk_layer_utils.h"
 #include "mutex"
+#include <atomic>
 
 #pragma once
 
 namespace unique_objects {
 
-// All increments must be guarded by global_lock
-static uint64_t global_unique_id = 1;
+// Maps the unique IDs handed to the application to the actual object handles. A unique ID holds the index of the slot
+// of its handle in the low 32 bits, the generation of that slot in the next 16 bits and the tag of the table in the high
+// 16 bits, so a lookup is an array index and a compare instead of a hash. Freed slots are reused with the next
+// generation, so stale IDs find nothing. Each instance and device table has its own tag, so the IDs of one are never
+// found in another, as when the IDs were unique across the process.
+// All accesses must be guarded by global_lock
+class UniqueIdTable {
+   public:
+    UniqueIdTable() : tag_(NextTag()) {}
+
+    uint64_t insert(uint64_t handle) {
+        uint32_t index;
+        if (free_slots_.empty()) {
+            index = static_cast<uint32_t>(slots_.size());
+            slots_.push_back({handle, 0});
+        } else {
+            index = free_slots_.back();
+            free_slots_.pop_back();
+            slots_[index].handle = handle;
+        }
+        return (static_cast<uint64_t>(tag_) << 48) | (static_cast<uint64_t>(slots_[index].generation) << 32) | index;
+    }
+
+    // Returns the handle for unique_id, or VK_NULL_HANDLE if there is none
+    uint64_t find(uint64_t unique_id) const {
+        uint32_t index = static_cast<uint32_t>(unique_id);
+        if (static_cast<uint16_t>(unique_id >> 48) == tag_ && index < slots_.size() &&
+            slots_[index].generation == static_cast<uint16_t>(unique_id >> 32)) {
+            return slots_[index].handle;
+        }
+        return 0;
+    }
+
+    // Removes unique_id and returns the handle it mapped to, or VK_NULL_HANDLE if there was none
+    uint64_t erase(uint64_t unique_id) {
+        uint64_t handle = find(unique_id);
+        if (handle != 0) {
+            uint32_t index = static_cast<uint32_t>(unique_id);
+            ++slots_[index].generation;
+            slots_[index].handle = 0;
+            free_slots_.push_back(index);
+        }
+        return handle;
+    }
+
+   private:
+    // Tag 0 is never handed out, so that no unique ID is VK_NULL_HANDLE
+    static uint16_t NextTag() {
+        static std::atomic<uint16_t> next_tag(0);
+        uint16_t tag;
+        do {
+            tag = ++next_tag;
+        } while (tag == 0);
+        return tag;
+    }
+
+    struct Slot {
+        uint64_t handle;
+        uint16_t generation;
+    };
+    uint16_t tag_;
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> free_slots_;
+};
+
+// Scratch memory for the unwrapped copies of handle arrays passed down the chain, so the vkCmd* calls that take them
+// don't allocate. Each thread has its own buffer, which ScratchArrays take from and give back to in stack order.
+static const size_t kScratchBufferSize = 8 * 1024;
+static thread_local uint64_t scratch_buffer[kScratchBufferSize / sizeof(uint64_t)];
+static thread_local size_t scratch_buffer_used = 0;
+
+// An array of handles in the thread's scratch buffer, or on the heap if it doesn't fit in what is left of the buffer.
+// Must be destroyed on the thread that allocated it.
+template <typename T>
+class ScratchArray {
+   public:
+    ScratchArray() : data_(nullptr), mark_(0), heap_(false) {}
+    ScratchArray(const ScratchArray &) = delete;
+    ScratchArray &operator=(const ScratchArray &) = delete;
+    ~ScratchArray() {
+        if (heap_) {
+            delete[] data_;
+        } else if (data_) {
+            scratch_buffer_used = mark_;
+        }
+    }
+
+    void allocate(size_t count) {
+        assert(data_ == nullptr);
+        size_t words = (count * sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+        if (scratch_buffer_used + words * sizeof(uint64_t) <= kScratchBufferSize) {
+            mark_ = scratch_buffer_used;
+            data_ = reinterpret_cast<T *>(&scratch_buffer[mark_ / sizeof(uint64_t)]);
+            scratch_buffer_used += words * sizeof(uint64_t);
+        } else {
+            data_ = new T[count];
+            heap_ = true;
+        }
+    }
+
+    operator T *() const { return data_; }
+
+   private:
+    T *data_;
+    size_t mark_;
+    bool heap_;
+};
+
+// Arena for the unwrapped safe_struct copies of the create infos, submit infos and pNext chains passed down the chain.
+// Copies are only taken while a ScratchArenaScope is alive on the thread, and are all released when the outermost scope
+// ends, so a call that re-enters the layer from below doesn't free its caller's copies.
+static thread_local SafeStructArena scratch_arena;
+static thread_local uint32_t scratch_arena_depth = 0;
+
+class ScratchArenaScope {
+   public:
+    ScratchArenaScope() { ++scratch_arena_depth; }
+    ScratchArenaScope(const ScratchArenaScope &) = delete;
+    ScratchArenaScope &operator=(const ScratchArenaScope &) = delete;
+    ~ScratchArenaScope() {
+        if (--scratch_arena_depth == 0) {
+            scratch_arena.Reset();
+        }
+    }
+};
 
 struct TEMPLATE_STATE {
     VkDescriptorUpdateTemplateKHR desc_update_template;
     safe_VkDescriptorUpdateTemplateCreateInfoKHR create_info;
+    // Offset in the update data and type of each descriptor the template writes, and the size of the data it reads.
+    //  Worked out once from create_info, see CompileUpdateTemplate().
+    std::vector<std::pair<size_t, VkDescriptorType>> handle_offsets;
+    size_t data_size;
 
     TEMPLATE_STATE(VkDescriptorUpdateTemplateKHR update_template, safe_VkDescriptorUpdateTemplateCreateInfoKHR *pCreateInfo)
-        : desc_update_template(update_template), create_info(*pCreateInfo) {}
+        : desc_update_template(update_template), create_info(*pCreateInfo), data_size(0) {}
 };
 
 struct instance_layer_data {
@@ -54,7 +182,7 @@ struct instance_layer_data {
     VkDebugReportCallbackCreateInfoEXT *tmp_dbg_create_infos;
     VkDebugReportCallbackEXT *tmp_callbacks;
 
-    std::unordered_map<uint64_t, uint64_t> unique_id_mapping;  // Map uniqueID to actual object handle
+    UniqueIdTable unique_id_mapping;  // Map uniqueID to actual object handle
 };
 
 struct layer_data {
@@ -66,7 +194,7 @@ struct layer_data {
     std::unordered_map<uint64_t, std::unique_ptr<TEMPLATE_STATE>> desc_template_map;
 
     bool wsi_enabled;
-    std::unordered_map<uint64_t, uint64_t> unique_id_mapping;  // Map uniqueID to actual object handle
+    UniqueIdTable unique_id_mapping;  // Map uniqueID to actual object handle
     VkPhysicalDevice gpu;
 
     layer_data() : wsi_enabled(false), gpu(VK_NULL_HANDLE){};
@@ -104,16 +232,14 @@ bool ContainsExtStruct(const T *target, VkStructureType ext_type) {
 // must hold lock!
 template<typename HandleType, typename MapType>
 HandleType Unwrap(MapType *layer_data, HandleType wrappedHandle) {
-    // TODO: don't use operator[] here.
-    return (HandleType)layer_data->unique_id_mapping[reinterpret_cast<uint64_t const &>(wrappedHandle)];
+    return (HandleType)layer_data->unique_id_mapping.find(reinterpret_cast<uint64_t const &>(wrappedHandle));
 }
 
 /* Wrap a newly created handle with a new unique ID, and return the new ID. */
 // must hold lock!
 template<typename HandleType, typename MapType>
 HandleType WrapNew(MapType *layer_data, HandleType newlyCreatedHandle) {
-    auto unique_id = global_unique_id++;
-    layer_data->unique_id_mapping[unique_id] = reinterpret_cast<uint64_t const &>(newlyCreatedHandle);
+    auto unique_id = layer_data->unique_id_mapping.insert(reinterpret_cast<uint64_t const &>(newlyCreatedHandle));
     return (HandleType)unique_id;
 }
 
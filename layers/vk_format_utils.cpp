@@ -22,7 +22,6 @@
 #include <string.h>
 #include <string>
 #include <vector>
-#include <map>
 #include "vulkan/vulkan.h"
 #include "vk_format_utils.h"
 
@@ -32,11 +31,17 @@ struct VULKAN_FORMAT_INFO {
     VkFormatCompatibilityClass format_class;
 };
 
+struct VULKAN_FORMAT_TABLE_ENTRY {
+    VkFormat format;
+    VULKAN_FORMAT_INFO info;
+};
+
 // Disable auto-formatting for this large table
 // clang-format off
 
-// Set up data structure with number of bytes and number of channels for each Vulkan format
-const std::map<VkFormat, VULKAN_FORMAT_INFO> vk_format_table = {
+// Set up data structure with number of bytes and number of channels for each Vulkan format. The core formats are listed in
+// order of their values, so they are looked up by index. The formats added by extensions are in tables of their own.
+static constexpr VULKAN_FORMAT_TABLE_ENTRY vk_format_table[] = {
     {VK_FORMAT_UNDEFINED,                   {0, 0, VK_FORMAT_COMPATIBILITY_CLASS_NONE_BIT }},
     {VK_FORMAT_R4G4_UNORM_PACK8,            {1, 2, VK_FORMAT_COMPATIBILITY_CLASS_8_BIT}},
     {VK_FORMAT_R4G4B4A4_UNORM_PACK16,       {2, 4, VK_FORMAT_COMPATIBILITY_CLASS_16_BIT}},
@@ -221,7 +226,10 @@ const std::map<VkFormat, VULKAN_FORMAT_INFO> vk_format_table = {
     {VK_FORMAT_ASTC_12x10_UNORM_BLOCK,      {16, 4, VK_FORMAT_COMPATIBILITY_CLASS_ASTC_12X10_BIT}},
     {VK_FORMAT_ASTC_12x10_SRGB_BLOCK,       {16, 4, VK_FORMAT_COMPATIBILITY_CLASS_ASTC_12X10_BIT}},
     {VK_FORMAT_ASTC_12x12_UNORM_BLOCK,      {16, 4, VK_FORMAT_COMPATIBILITY_CLASS_ASTC_12X12_BIT}},
-    {VK_FORMAT_ASTC_12x12_SRGB_BLOCK,       {16, 4, VK_FORMAT_COMPATIBILITY_CLASS_ASTC_12X12_BIT}},
+    {VK_FORMAT_ASTC_12x12_SRGB_BLOCK,       {16, 4, VK_FORMAT_COMPATIBILITY_CLASS_ASTC_12X12_BIT}}
+};
+
+static constexpr VULKAN_FORMAT_TABLE_ENTRY vk_format_table_pvrtc[] = {
     {VK_FORMAT_PVRTC1_2BPP_UNORM_BLOCK_IMG, {8, 4, VK_FORMAT_COMPATIBILITY_CLASS_PVRTC1_2BPP_BIT}},
     {VK_FORMAT_PVRTC1_4BPP_UNORM_BLOCK_IMG, {8, 4, VK_FORMAT_COMPATIBILITY_CLASS_PVRTC1_4BPP_BIT}},
     {VK_FORMAT_PVRTC2_2BPP_UNORM_BLOCK_IMG, {8, 4, VK_FORMAT_COMPATIBILITY_CLASS_PVRTC2_2BPP_BIT}},
@@ -235,6 +243,31 @@ const std::map<VkFormat, VULKAN_FORMAT_INFO> vk_format_table = {
 // Renable formatting
 // clang-format on
 
+// Check that each entry of a table is at the index of its format, counting from the first format of the table
+template <size_t N>
+constexpr bool FormatTableIsDense(const VULKAN_FORMAT_TABLE_ENTRY (&table)[N], VkFormat first, size_t index = 0) {
+    return (index == N) ||
+           ((static_cast<size_t>(table[index].format) == static_cast<size_t>(first) + index) &&
+            FormatTableIsDense(table, first, index + 1));
+}
+
+static_assert(sizeof(vk_format_table) / sizeof(vk_format_table[0]) == VK_FORMAT_RANGE_SIZE,
+              "vk_format_table must list every core format");
+static_assert(FormatTableIsDense(vk_format_table, VK_FORMAT_BEGIN_RANGE), "vk_format_table must be in format order");
+static_assert(FormatTableIsDense(vk_format_table_pvrtc, VK_FORMAT_PVRTC1_2BPP_UNORM_BLOCK_IMG),
+              "vk_format_table_pvrtc must be in format order");
+
+// Return the table entry of the specified format, or nullptr if there is none
+static const VULKAN_FORMAT_INFO *FormatInfo(VkFormat format) {
+    if ((format >= VK_FORMAT_BEGIN_RANGE) && (format <= VK_FORMAT_END_RANGE)) {
+        return &vk_format_table[format - VK_FORMAT_BEGIN_RANGE].info;
+    }
+    if ((format >= VK_FORMAT_PVRTC1_2BPP_UNORM_BLOCK_IMG) && (format <= VK_FORMAT_PVRTC2_4BPP_SRGB_BLOCK_IMG)) {
+        return &vk_format_table_pvrtc[format - VK_FORMAT_PVRTC1_2BPP_UNORM_BLOCK_IMG].info;
+    }
+    return nullptr;
+}
+
 // Return true if format is an ETC2 or EAC compressed texture format
 VK_LAYER_EXPORT bool FormatIsCompressed_ETC2_EAC(VkFormat format) {
     bool found = false;
@@ -349,17 +382,16 @@ VK_LAYER_EXPORT bool FormatIsCompressed_PVRTC(VkFormat format) {
     return found;
 }
 
-// Return true if format is compressed
+// Return true if format is compressed. The BC, ETC2, EAC and ASTC formats are one run of core format values, and the
+// PVRTC formats are another.
 VK_LAYER_EXPORT bool FormatIsCompressed(VkFormat format) {
-    return (FormatIsCompressed_ASTC_LDR(format) || 
-            FormatIsCompressed_BC(format) || 
-            FormatIsCompressed_ETC2_EAC(format) ||
-            FormatIsCompressed_PVRTC(format));
+    return ((format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK) && (format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK)) ||
+           ((format >= VK_FORMAT_PVRTC1_2BPP_UNORM_BLOCK_IMG) && (format <= VK_FORMAT_PVRTC2_4BPP_SRGB_BLOCK_IMG));
 }
 
-// Return true if format is a depth or stencil format
+// Return true if format is a depth or stencil format. These are one run of core format values.
 VK_LAYER_EXPORT bool FormatIsDepthOrStencil(VkFormat format) {
-    return (FormatIsDepthAndStencil(format) || FormatIsDepthOnly(format) || FormatIsStencilOnly(format));
+    return (format >= VK_FORMAT_D16_UNORM) && (format <= VK_FORMAT_D32_SFLOAT_S8_UINT);
 }
 
 // Return true if format contains depth and stencil information
@@ -868,29 +900,20 @@ VK_LAYER_EXPORT VkExtent3D FormatCompressedTexelBlockExtent(VkFormat format) {
 
 // Return format class of the specified format
 VK_LAYER_EXPORT VkFormatCompatibilityClass FormatCompatibilityClass(VkFormat format) {
-    auto item = vk_format_table.find(format);
-    if (item != vk_format_table.end()) {
-        return item->second.format_class;
-    }
-    return VK_FORMAT_COMPATIBILITY_CLASS_NONE_BIT;
+    auto info = FormatInfo(format);
+    return info ? info->format_class : VK_FORMAT_COMPATIBILITY_CLASS_NONE_BIT;
 }
 
 // Return size, in bytes, of a pixel of the specified format
 VK_LAYER_EXPORT size_t FormatSize(VkFormat format) {
-    auto item = vk_format_table.find(format);
-    if (item != vk_format_table.end()) {
-        return item->second.size;
-    }
-    return 0;
+    auto info = FormatInfo(format);
+    return info ? info->size : 0;
 }
 
 // Return the number of channels for a given format
 unsigned int FormatChannelCount(VkFormat format) {
-    auto item = vk_format_table.find(format);
-    if (item != vk_format_table.end()) {
-        return item->second.channel_count;
-    }
-    return 0;
+    auto info = FormatInfo(format);
+    return info ? info->channel_count : 0;
 }
 
 // Perform a zero-tolerant modulo operation
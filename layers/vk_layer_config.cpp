@@ -23,9 +23,12 @@
  **************************************************************************/
 #include "vk_layer_config.h"
 #include "vulkan/vk_sdk_platform.h"
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <mutex>
+#include <stdlib.h>
 #include <string.h>
 #include <string>
 #include <sys/stat.h>
@@ -40,13 +43,29 @@ class ConfigFile {
 
     const char *getOption(const std::string &_option);
     void setOption(const std::string &_option, const std::string &_val);
+    uint32_t readOptions(const char *layer_name, const LayerOptionDefinition *definitions, uint32_t definition_count,
+                         void *options);
+    bool refresh(uint32_t *generation);
 
    private:
     bool m_fileIsParsed;
     std::string m_fileName;
     std::map<std::string, std::string> m_valueMap;
+    // The values before the file is read, and the ones set by setOption(), which override the file's
+    std::map<std::string, std::string> m_defaultValues;
+    std::map<std::string, std::string> m_setValues;
 
-    void parseFile(const char *filename);
+    // For refresh(): the modification time and size of the file when it was read, when it was last checked, and how many
+    // times it has been read
+    time_t m_fileTime;
+    off_t m_fileSize;
+    std::chrono::steady_clock::time_point m_lastCheck;
+    uint32_t m_generation;
+
+    std::mutex m_lock;
+
+    std::string settingsFileName();
+    void parseFile();
 };
 
 static ConfigFile g_configFileObj;
@@ -72,6 +91,13 @@ std::string getEnvironment(const char *variable) {
 
 const char *getLayerOption(const char *_option) { return g_configFileObj.getOption(_option); }
 
+uint32_t ReadLayerOptions(const char *layer_name, const LayerOptionDefinition *definitions, uint32_t definition_count,
+                          void *options) {
+    return g_configFileObj.readOptions(layer_name, definitions, definition_count, options);
+}
+
+bool RefreshLayerOptions(uint32_t *generation) { return g_configFileObj.refresh(generation); }
+
 // If option is NULL or stdout, return stdout, otherwise try to open option
 // as a filename. If successful, return file handle, otherwise stdout
 FILE *getLayerLogOutput(const char *_option, const char *layerName) {
@@ -133,7 +159,7 @@ void setLayerOption(const char *_option, const char *_val) { g_configFileObj.set
 
 // Constructor for ConfigFile. Initialize layers to log error messages to stdout by default. If a vk_layer_settings file is present,
 // its settings will override the defaults.
-ConfigFile::ConfigFile() : m_fileIsParsed(false) {
+ConfigFile::ConfigFile() : m_fileIsParsed(false), m_fileTime(0), m_fileSize(0), m_generation(0) {
 
 #ifdef ANDROID
     m_fileName = "/sdcard/Android/vk_layer_settings.txt";
@@ -141,57 +167,63 @@ ConfigFile::ConfigFile() : m_fileIsParsed(false) {
     m_fileName = "vk_layer_settings.txt";
 #endif
 
-    m_valueMap["lunarg_core_validation.report_flags"] = "error";
-    m_valueMap["lunarg_object_tracker.report_flags"] = "error";
-    m_valueMap["lunarg_parameter_validation.report_flags"] = "error";
-    m_valueMap["google_threading.report_flags"] = "error";
-    m_valueMap["google_unique_objects.report_flags"] = "error";
+    m_defaultValues["lunarg_core_validation.report_flags"] = "error";
+    m_defaultValues["lunarg_object_tracker.report_flags"] = "error";
+    m_defaultValues["lunarg_parameter_validation.report_flags"] = "error";
+    m_defaultValues["google_threading.report_flags"] = "error";
+    m_defaultValues["google_unique_objects.report_flags"] = "error";
 
 #ifdef WIN32
     // For Windows, enable message logging AND OutputDebugString
-    m_valueMap["lunarg_core_validation.debug_action"] =
+    m_defaultValues["lunarg_core_validation.debug_action"] =
         "VK_DBG_LAYER_ACTION_DEFAULT,VK_DBG_LAYER_ACTION_LOG_MSG,VK_DBG_LAYER_ACTION_DEBUG_OUTPUT";
-    m_valueMap["lunarg_object_tracker.debug_action"] =
+    m_defaultValues["lunarg_object_tracker.debug_action"] =
         "VK_DBG_LAYER_ACTION_DEFAULT,VK_DBG_LAYER_ACTION_LOG_MSG,VK_DBG_LAYER_ACTION_DEBUG_OUTPUT";
-    m_valueMap["lunarg_parameter_validation.debug_action"] =
+    m_defaultValues["lunarg_parameter_validation.debug_action"] =
         "VK_DBG_LAYER_ACTION_DEFAULT,VK_DBG_LAYER_ACTION_LOG_MSG,VK_DBG_LAYER_ACTION_DEBUG_OUTPUT";
-    m_valueMap["google_threading.debug_action"] =
+    m_defaultValues["google_threading.debug_action"] =
         "VK_DBG_LAYER_ACTION_DEFAULT,VK_DBG_LAYER_ACTION_LOG_MSG,VK_DBG_LAYER_ACTION_DEBUG_OUTPUT";
-    m_valueMap["google_unique_objects.debug_action"] =
+    m_defaultValues["google_unique_objects.debug_action"] =
         "VK_DBG_LAYER_ACTION_DEFAULT,VK_DBG_LAYER_ACTION_LOG_MSG,VK_DBG_LAYER_ACTION_DEBUG_OUTPUT";
 #else   // WIN32
-    m_valueMap["lunarg_core_validation.debug_action"] = "VK_DBG_LAYER_ACTION_DEFAULT,VK_DBG_LAYER_ACTION_LOG_MSG";
-    m_valueMap["lunarg_object_tracker.debug_action"] = "VK_DBG_LAYER_ACTION_DEFAULT,VK_DBG_LAYER_ACTION_LOG_MSG";
-    m_valueMap["lunarg_parameter_validation.debug_action"] = "VK_DBG_LAYER_ACTION_DEFAULT,VK_DBG_LAYER_ACTION_LOG_MSG";
-    m_valueMap["google_threading.debug_action"] = "VK_DBG_LAYER_ACTION_DEFAULT,VK_DBG_LAYER_ACTION_LOG_MSG";
-    m_valueMap["google_unique_objects.debug_action"] = "VK_DBG_LAYER_ACTION_DEFAULT,VK_DBG_LAYER_ACTION_LOG_MSG";
+    m_defaultValues["lunarg_core_validation.debug_action"] = "VK_DBG_LAYER_ACTION_DEFAULT,VK_DBG_LAYER_ACTION_LOG_MSG";
+    m_defaultValues["lunarg_object_tracker.debug_action"] = "VK_DBG_LAYER_ACTION_DEFAULT,VK_DBG_LAYER_ACTION_LOG_MSG";
+    m_defaultValues["lunarg_parameter_validation.debug_action"] = "VK_DBG_LAYER_ACTION_DEFAULT,VK_DBG_LAYER_ACTION_LOG_MSG";
+    m_defaultValues["google_threading.debug_action"] = "VK_DBG_LAYER_ACTION_DEFAULT,VK_DBG_LAYER_ACTION_LOG_MSG";
+    m_defaultValues["google_unique_objects.debug_action"] = "VK_DBG_LAYER_ACTION_DEFAULT,VK_DBG_LAYER_ACTION_LOG_MSG";
 #endif  // WIN32
 
-    m_valueMap["lunarg_core_validation.log_filename"] = "stdout";
-    m_valueMap["lunarg_object_tracker.log_filename"] = "stdout";
-    m_valueMap["lunarg_parameter_validation.log_filename"] = "stdout";
-    m_valueMap["google_threading.log_filename"] = "stdout";
-    m_valueMap["google_unique_objects.log_filename"] = "stdout";
+    m_defaultValues["lunarg_core_validation.log_filename"] = "stdout";
+    m_defaultValues["lunarg_object_tracker.log_filename"] = "stdout";
+    m_defaultValues["lunarg_parameter_validation.log_filename"] = "stdout";
+    m_defaultValues["google_threading.log_filename"] = "stdout";
+    m_defaultValues["google_unique_objects.log_filename"] = "stdout";
+    m_valueMap = m_defaultValues;
 }
 
 ConfigFile::~ConfigFile() {}
 
+// The file named by VK_LAYER_SETTINGS_PATH, or vk_layer_settings.txt in the directory it names, or else the default file
+std::string ConfigFile::settingsFileName() {
+    std::string envPath = getEnvironment("VK_LAYER_SETTINGS_PATH");
+
+    // If the path exists use it, else use vk_layer_settings
+    struct stat info;
+    if (stat(envPath.c_str(), &info) == 0) {
+        // If this is a directory, look for vk_layer_settings within the directory
+        if (info.st_mode & S_IFDIR) {
+            envPath += "/vk_layer_settings.txt";
+        }
+        return envPath;
+    }
+    return m_fileName;
+}
+
 const char *ConfigFile::getOption(const std::string &_option) {
+    std::lock_guard<std::mutex> lock(m_lock);
     std::map<std::string, std::string>::const_iterator it;
     if (!m_fileIsParsed) {
-        std::string envPath = getEnvironment("VK_LAYER_SETTINGS_PATH");
-
-        // If the path exists use it, else use vk_layer_settings
-        struct stat info;
-        if (stat(envPath.c_str(), &info) == 0) {
-            // If this is a directory, look for vk_layer_settings within the directory
-            if (info.st_mode & S_IFDIR) {
-                envPath += "/vk_layer_settings.txt";
-            }
-            parseFile(envPath.c_str());
-        } else {
-            parseFile(m_fileName.c_str());
-        }
+        parseFile();
     }
 
     if ((it = m_valueMap.find(_option)) == m_valueMap.end())
@@ -201,54 +233,115 @@ const char *ConfigFile::getOption(const std::string &_option) {
 }
 
 void ConfigFile::setOption(const std::string &_option, const std::string &_val) {
+    std::lock_guard<std::mutex> lock(m_lock);
     if (!m_fileIsParsed) {
-        std::string envPath = getEnvironment("VK_LAYER_SETTINGS_PATH");
+        parseFile();
+    }
 
-        // If the path exists use it, else use vk_layer_settings
-        struct stat info;
-        if (stat(envPath.c_str(), &info) == 0) {
-            // If this is a directory, look for vk_layer_settings within the directory
-            if (info.st_mode & S_IFDIR) {
-                envPath += "/vk_layer_settings.txt";
+    m_setValues[_option] = _val;
+    m_valueMap[_option] = _val;
+}
+
+uint32_t ConfigFile::readOptions(const char *layer_name, const LayerOptionDefinition *definitions, uint32_t definition_count,
+                                 void *options) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (!m_fileIsParsed) {
+        parseFile();
+    }
+
+    std::string prefix = std::string(layer_name) + ".";
+    for (uint32_t i = 0; i < definition_count; ++i) {
+        const LayerOptionDefinition &definition = definitions[i];
+        auto it = m_valueMap.find(prefix + definition.name);
+        const char *value = (it == m_valueMap.end() || it->second.empty()) ? definition.default_value : it->second.c_str();
+        char *member = static_cast<char *>(options) + definition.offset;
+
+        switch (definition.type) {
+            case LAYER_OPTION_BOOL:
+                *reinterpret_cast<bool *>(member) = !strcmp(value, "true") || !strcmp(value, "TRUE");
+                break;
+            case LAYER_OPTION_UINT: {
+                char *end;
+                unsigned long number = strtoul(value, &end, 10);
+                if (end == value || *end != '\0') number = strtoul(definition.default_value, nullptr, 10);
+                *reinterpret_cast<uint32_t *>(member) = static_cast<uint32_t>(number);
+                break;
             }
-            parseFile(envPath.c_str());
-        } else {
-            parseFile(m_fileName.c_str());
         }
     }
+    return m_generation;
+}
 
-    m_valueMap[_option] = _val;
+bool ConfigFile::refresh(uint32_t *generation) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (!m_fileIsParsed) {
+        parseFile();
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - m_lastCheck >= std::chrono::seconds(1)) {
+        m_lastCheck = now;
+        struct stat info;
+        time_t file_time = 0;
+        off_t file_size = 0;
+        if (stat(settingsFileName().c_str(), &info) == 0) {
+            file_time = info.st_mtime;
+            file_size = info.st_size;
+        }
+        if (file_time != m_fileTime || file_size != m_fileSize) {
+            parseFile();
+        }
+    }
+
+    bool changed = *generation != m_generation;
+    *generation = m_generation;
+    return changed;
 }
 
-void ConfigFile::parseFile(const char *filename) {
+// Must hold m_lock, or be in the constructor
+void ConfigFile::parseFile() {
     std::ifstream file;
     char buf[MAX_CHARS_PER_LINE];
+    std::string filename = settingsFileName();
 
     m_fileIsParsed = true;
-
-    file.open(filename);
-    if (!file.good()) {
-        return;
+    ++m_generation;
+    m_valueMap = m_defaultValues;
+    m_fileTime = 0;
+    m_fileSize = 0;
+    m_lastCheck = std::chrono::steady_clock::now();
+
+    struct stat info;
+    if (stat(filename.c_str(), &info) == 0) {
+        m_fileTime = info.st_mtime;
+        m_fileSize = info.st_size;
     }
 
-    // read tokens from the file and form option, value pairs
-    file.getline(buf, MAX_CHARS_PER_LINE);
-    while (!file.eof()) {
-        char option[512];
-        char value[512];
+    file.open(filename.c_str());
+    if (file.good()) {
+        // read tokens from the file and form option, value pairs
+        file.getline(buf, MAX_CHARS_PER_LINE);
+        while (!file.eof()) {
+            char option[512];
+            char value[512];
 
-        char *pComment;
+            char *pComment;
 
-        // discard any comments delimited by '#' in the line
-        pComment = strchr(buf, '#');
-        if (pComment) *pComment = '\0';
+            // discard any comments delimited by '#' in the line
+            pComment = strchr(buf, '#');
+            if (pComment) *pComment = '\0';
 
-        if (sscanf(buf, " %511[^\n\t =] = %511[^\n \t]", option, value) == 2) {
-            std::string optStr(option);
-            std::string valStr(value);
-            m_valueMap[optStr] = valStr;
+            if (sscanf(buf, " %511[^\n\t =] = %511[^\n \t]", option, value) == 2) {
+                std::string optStr(option);
+                std::string valStr(value);
+                m_valueMap[optStr] = valStr;
+            }
+            file.getline(buf, MAX_CHARS_PER_LINE);
         }
-        file.getline(buf, MAX_CHARS_PER_LINE);
+    }
+
+    for (auto const &set_value : m_setValues) {
+        m_valueMap[set_value.first] = set_value.second;
     }
 }
 
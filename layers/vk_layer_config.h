@@ -23,6 +23,7 @@
 #include <string>
 #include <unordered_map>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 
 #ifdef __cplusplus
@@ -63,6 +64,32 @@ VkFlags GetLayerOptionFlags(std::string _option, std::unordered_map<std::string,
                             uint32_t option_default);
 
 void setLayerOption(const char *_option, const char *_val);
+
+// Types of the members of a layer's options struct, see LayerOptionDefinition
+typedef enum LayerOptionType {
+    LAYER_OPTION_BOOL,  // bool, set by "true" or "TRUE"
+    LAYER_OPTION_UINT,  // uint32_t
+} LayerOptionType;
+
+// Declares an option of a layer and the member of the layer's options struct it is read into. A layer declares a table of
+// these and reads all of its options into the struct with ReadLayerOptions(), so nothing looks options up by name after that.
+// The options struct must be standard layout, so that offsetof() works on it.
+struct LayerOptionDefinition {
+    const char *name;           // The name after the "<layer>." prefix
+    LayerOptionType type;
+    size_t offset;              // offsetof() the member
+    const char *default_value;  // Used when the option isn't set or can't be parsed
+};
+
+// Reads the options in definitions, prefixed by "<layer_name>.", into options and returns the generation of the settings
+// they were read from, for RefreshLayerOptions()
+uint32_t ReadLayerOptions(const char *layer_name, const LayerOptionDefinition *definitions, uint32_t definition_count,
+                          void *options);
+
+// Re-reads the settings file if it changed since it was last read, checking it at most once a second, and returns whether
+// the settings are newer than generation, which is then updated. Strings returned by getLayerOption() before the file is
+// re-read are no longer valid.
+bool RefreshLayerOptions(uint32_t *generation);
 void print_msg_flags(VkFlags msgFlags, char *msg_flags);
 
 #ifdef __cplusplus
@@ -20,13 +20,38 @@
 #ifndef LAYER_DATA_H
 #define LAYER_DATA_H
 
+#include <atomic>
 #include <cassert>
 #include <unordered_map>
 #include "vk_layer_table.h"
 
+// Bumped whenever a layer_data instance is freed, so the per-thread caches below never hand out a freed one. A new
+// dispatchable object may get the dispatch key of a destroyed one.
+template <typename DATA_T>
+std::atomic<uint64_t> &LayerDataGeneration() {
+    static std::atomic<uint64_t> generation(0);
+    return generation;
+}
+
+// The last layer_data instance each thread looked up. Calls on one device or instance mostly come in runs from the same
+// thread, so this saves hashing into layer_data_map on nearly every entrypoint.
+template <typename DATA_T>
+struct LayerDataCache {
+    const void *map;
+    void *data_key;
+    DATA_T *data;
+    uint64_t generation;
+};
+
 // For the given data key, look up the layer_data instance from given layer_data_map
 template <typename DATA_T>
 DATA_T *GetLayerDataPtr(void *data_key, std::unordered_map<void *, DATA_T *> &layer_data_map) {
+    static thread_local LayerDataCache<DATA_T> cache = {};
+    uint64_t generation = LayerDataGeneration<DATA_T>().load(std::memory_order_acquire);
+    if (cache.data_key == data_key && cache.map == &layer_data_map && cache.generation == generation) {
+        return cache.data;
+    }
+
     DATA_T *debug_data;
     typename std::unordered_map<void *, DATA_T *>::const_iterator got;
 
@@ -40,6 +65,10 @@ DATA_T *GetLayerDataPtr(void *data_key, std::unordered_map<void *, DATA_T *> &la
         debug_data = got->second;
     }
 
+    cache.map = &layer_data_map;
+    cache.data_key = data_key;
+    cache.data = debug_data;
+    cache.generation = generation;
     return debug_data;
 }
 
@@ -48,6 +77,7 @@ void FreeLayerDataPtr(void *data_key, std::unordered_map<void *, DATA_T *> &laye
     auto got = layer_data_map.find(data_key);
     assert(got != layer_data_map.end());
 
+    LayerDataGeneration<DATA_T>().fetch_add(1, std::memory_order_acq_rel);
     delete got->second;
     layer_data_map.erase(got);
 }
@@ -33,9 +33,18 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
 #include <unordered_map>
 #include <vector>
 
+struct debug_report_delivery_queue;
+struct debug_report_message_counts;
 
 typedef struct _debug_report_data {
     VkLayerDbgFunctionNode *debug_callback_list;
@@ -43,6 +52,10 @@ typedef struct _debug_report_data {
     VkFlags active_flags;
     bool g_DEBUG_REPORT;
     std::unordered_map<uint64_t, std::string> *debugObjectNameMap;
+    // Set when log_msg hands messages to a delivery thread, see debug_report_start_delivery_thread()
+    debug_report_delivery_queue *delivery_queue;
+    // How often log_msg has seen each message code for each object, see debug_report_set_message_budget()
+    debug_report_message_counts *message_counts;
 } debug_report_data;
 
 template debug_report_data *GetLayerDataPtr<debug_report_data>(void *data_key,
@@ -53,6 +66,20 @@ static inline bool debug_report_log_msg(const debug_report_data *debug_data, VkF
                                         VkDebugReportObjectTypeEXT objectType, uint64_t srcObject, size_t location, int32_t msgCode,
                                         const char *pLayerPrefix, const char *pMsg);
 
+// Work out which message flags the callbacks take. Messages go to the callbacks the application created, or to the default
+// ones from the layer settings when there are none, so only the flags of that list count.
+static inline void UpdateActiveFlags(debug_report_data *debug_data) {
+    VkLayerDbgFunctionNode *pTrav = debug_data->debug_callback_list;
+    if (pTrav == NULL) {
+        pTrav = debug_data->default_debug_callback_list;
+    }
+    VkFlags active_flags = 0;
+    for (; pTrav; pTrav = pTrav->pNext) {
+        active_flags |= pTrav->msgFlags;
+    }
+    debug_data->active_flags = active_flags;
+}
+
 // Add a debug message callback node structure to the specified callback linked list
 static inline void AddDebugMessageCallback(debug_report_data *debug_data, VkLayerDbgFunctionNode **list_head,
                                            VkLayerDbgFunctionNode *new_node) {
@@ -66,7 +93,6 @@ static inline void RemoveDebugMessageCallback(debug_report_data *debug_data, VkL
     VkLayerDbgFunctionNode *cur_callback = *list_head;
     VkLayerDbgFunctionNode *prev_callback = cur_callback;
     bool matched = false;
-    VkFlags local_flags = 0;
 
     while (cur_callback) {
         if (cur_callback->msgCallback == callback) {
@@ -80,7 +106,6 @@ static inline void RemoveDebugMessageCallback(debug_report_data *debug_data, VkL
                                  "Destroyed callback\n");
         } else {
             matched = false;
-            local_flags |= cur_callback->msgFlags;
         }
         prev_callback = cur_callback;
         cur_callback = cur_callback->pNext;
@@ -88,7 +113,7 @@ static inline void RemoveDebugMessageCallback(debug_report_data *debug_data, VkL
             free(prev_callback);
         }
     }
-    debug_data->active_flags = local_flags;
+    UpdateActiveFlags(debug_data);
 }
 
 // Removes all debug callback function nodes from the specified callback linked lists and frees their resources
@@ -107,10 +132,24 @@ static inline void RemoveAllMessageCallbacks(debug_report_data *debug_data, VkLa
     *list_head = NULL;
 }
 
-// Utility function to handle reporting
-static inline bool debug_report_log_msg(const debug_report_data *debug_data, VkFlags msgFlags,
-                                        VkDebugReportObjectTypeEXT objectType, uint64_t srcObject, size_t location, int32_t msgCode,
-                                        const char *pLayerPrefix, const char *pMsg) {
+// Add the name the application gave srcObject, if any, to the front of a message
+static inline const char *debug_report_named_msg(const debug_report_data *debug_data, uint64_t srcObject, const char *pMsg,
+                                                 std::string &named_msg) {
+    auto it = debug_data->debugObjectNameMap->find(srcObject);
+    if (it == debug_data->debugObjectNameMap->end()) {
+        return pMsg;
+    }
+    named_msg = "SrcObject name = ";
+    named_msg.append(it->second);
+    named_msg.append(" ");
+    named_msg.append(pMsg);
+    return named_msg.c_str();
+}
+
+// Send a message to each callback that takes its flags
+static inline bool debug_report_call_callbacks(const debug_report_data *debug_data, VkFlags msgFlags,
+                                               VkDebugReportObjectTypeEXT objectType, uint64_t srcObject, size_t location,
+                                               int32_t msgCode, const char *pLayerPrefix, const char *pMsg) {
     bool bail = false;
     VkLayerDbgFunctionNode *pTrav = NULL;
 
@@ -122,21 +161,8 @@ static inline bool debug_report_log_msg(const debug_report_data *debug_data, VkF
 
     while (pTrav) {
         if (pTrav->msgFlags & msgFlags) {
-            auto it = debug_data->debugObjectNameMap->find(srcObject);
-            if (it == debug_data->debugObjectNameMap->end()) {
-                if (pTrav->pfnMsgCallback(msgFlags, objectType, srcObject, location, msgCode, pLayerPrefix, pMsg,
-                                          pTrav->pUserData)) {
-                    bail = true;
-                }
-            } else {
-                std::string newMsg = "SrcObject name = ";
-                newMsg.append(it->second.c_str());
-                newMsg.append(" ");
-                newMsg.append(pMsg);
-                if (pTrav->pfnMsgCallback(msgFlags, objectType, srcObject, location, msgCode, pLayerPrefix, newMsg.c_str(),
-                                          pTrav->pUserData)) {
-                    bail = true;
-                }
+            if (pTrav->pfnMsgCallback(msgFlags, objectType, srcObject, location, msgCode, pLayerPrefix, pMsg, pTrav->pUserData)) {
+                bail = true;
             }
         }
         pTrav = pTrav->pNext;
@@ -145,6 +171,215 @@ static inline bool debug_report_log_msg(const debug_report_data *debug_data, VkF
     return bail;
 }
 
+// Utility function to handle reporting
+static inline bool debug_report_log_msg(const debug_report_data *debug_data, VkFlags msgFlags,
+                                        VkDebugReportObjectTypeEXT objectType, uint64_t srcObject, size_t location, int32_t msgCode,
+                                        const char *pLayerPrefix, const char *pMsg) {
+    if (!(debug_data->active_flags & msgFlags)) {
+        return false;
+    }
+    std::string named_msg;
+    return debug_report_call_callbacks(debug_data, msgFlags, objectType, srcObject, location, msgCode, pLayerPrefix,
+                                       debug_report_named_msg(debug_data, srcObject, pMsg, named_msg));
+}
+
+// Messages that log_msg has queued for the delivery thread. A message with the same flags, code and object as one that is
+// still waiting is only counted, and the count is added to the text of the one that gets delivered.
+struct debug_report_delivery_queue {
+    struct message {
+        VkFlags flags;
+        VkDebugReportObjectTypeEXT object_type;
+        uint64_t object;
+        size_t location;
+        int32_t code;
+        std::string layer_prefix;
+        std::string text;
+        uint32_t count;
+    };
+    typedef std::tuple<VkFlags, int32_t, uint64_t> message_key;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::vector<message> pending;
+    std::map<message_key, size_t> pending_index;
+    bool delivering = false;
+    bool stop = false;
+    std::thread thread;
+};
+
+static inline void debug_report_deliver_queued_msgs(debug_report_data *debug_data) {
+    debug_report_delivery_queue *queue = debug_data->delivery_queue;
+    std::vector<debug_report_delivery_queue::message> batch;
+    std::unique_lock<std::mutex> lock(queue->lock);
+    while (true) {
+        queue->wake.wait(lock, [queue] { return queue->stop || !queue->pending.empty(); });
+        if (queue->pending.empty()) {
+            break;
+        }
+        batch.swap(queue->pending);
+        queue->pending_index.clear();
+        queue->delivering = true;
+        lock.unlock();
+
+        for (auto &msg : batch) {
+            if (msg.count > 1) {
+                msg.text.append(" [repeated " + std::to_string(msg.count) + " times]");
+            }
+            debug_report_call_callbacks(debug_data, msg.flags, msg.object_type, msg.object, msg.location, msg.code,
+                                        msg.layer_prefix.c_str(), msg.text.c_str());
+        }
+        batch.clear();
+
+        lock.lock();
+        queue->delivering = false;
+        queue->idle.notify_all();
+    }
+}
+
+// Have log_msg queue its messages for a thread that sends them to the callbacks, so the threads making Vulkan calls don't
+// wait on the callbacks. The calls are then never skipped because of a message.
+static inline void debug_report_start_delivery_thread(debug_report_data *debug_data) {
+    if (debug_data->delivery_queue) {
+        return;
+    }
+    debug_data->delivery_queue = new debug_report_delivery_queue;
+    debug_data->delivery_queue->thread = std::thread(debug_report_deliver_queued_msgs, debug_data);
+}
+
+// Wait until the delivery thread has sent all queued messages. Called before the callback lists change.
+static inline void debug_report_flush_delivery_queue(debug_report_data *debug_data) {
+    debug_report_delivery_queue *queue = debug_data->delivery_queue;
+    if (!queue || std::this_thread::get_id() == queue->thread.get_id()) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(queue->lock);
+    queue->idle.wait(lock, [queue] { return queue->pending.empty() && !queue->delivering; });
+}
+
+// Send the queued messages and stop the delivery thread
+static inline void debug_report_stop_delivery_thread(debug_report_data *debug_data) {
+    debug_report_delivery_queue *queue = debug_data->delivery_queue;
+    if (!queue) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue->lock);
+        queue->stop = true;
+    }
+    queue->wake.notify_one();
+    queue->thread.join();
+    delete queue;
+    debug_data->delivery_queue = nullptr;
+}
+
+// Count a message with the given key as a repeat of a waiting one, if there is one. Must be called with the queue lock held.
+static inline bool debug_report_count_repeated_msg(debug_report_delivery_queue *queue,
+                                                   const debug_report_delivery_queue::message_key &key) {
+    auto index = queue->pending_index.find(key);
+    if (index == queue->pending_index.end()) {
+        return false;
+    }
+    queue->pending[index->second].count++;
+    return true;
+}
+
+// Queue a message for the delivery thread
+static inline void debug_report_queue_msg(debug_report_delivery_queue *queue, debug_report_delivery_queue::message &&msg) {
+    debug_report_delivery_queue::message_key key(msg.flags, msg.code, msg.object);
+    {
+        std::lock_guard<std::mutex> lock(queue->lock);
+        if (debug_report_count_repeated_msg(queue, key)) {
+            return;
+        }
+        queue->pending_index[key] = queue->pending.size();
+        queue->pending.push_back(std::move(msg));
+    }
+    queue->wake.notify_one();
+}
+
+// Messages log_msg has seen, by message code and object. Once a message has been seen more times than the budget it is no
+// longer formatted or sent, just counted, until debug_report_report_suppressed_msgs() reports the count.
+struct debug_report_message_counts {
+    struct entry {
+        VkFlags flags;
+        VkDebugReportObjectTypeEXT object_type;
+        std::string layer_prefix;
+        uint32_t count;
+        // What the callbacks returned for the last message that was sent, returned again for the suppressed ones
+        bool skip;
+    };
+    typedef std::pair<int32_t, uint64_t> message_key;
+
+    std::mutex lock;
+    // Changed under the lock, but read without it by log_msg to see whether messages are counted at all
+    std::atomic<uint32_t> budget{0};
+    std::map<message_key, entry> counts;
+};
+
+// Only send each message code for an object budget times, 0 sends them all
+static inline void debug_report_set_message_budget(debug_report_data *debug_data, uint32_t budget) {
+    std::lock_guard<std::mutex> lock(debug_data->message_counts->lock);
+    debug_data->message_counts->budget = budget;
+    debug_data->message_counts->counts.clear();
+}
+
+// Count a message against the budget. Returns true, and what to return for it in skip, if it is over the budget.
+static inline bool debug_report_msg_over_budget(const debug_report_data *debug_data, VkFlags msgFlags,
+                                                VkDebugReportObjectTypeEXT objectType, uint64_t srcObject, int32_t msgCode,
+                                                const char *pLayerPrefix, bool *skip) {
+    debug_report_message_counts *counts = debug_data->message_counts;
+    std::lock_guard<std::mutex> lock(counts->lock);
+    auto it = counts->counts.find(debug_report_message_counts::message_key(msgCode, srcObject));
+    if (it == counts->counts.end()) {
+        counts->counts.emplace(debug_report_message_counts::message_key(msgCode, srcObject),
+                               debug_report_message_counts::entry{msgFlags, objectType, pLayerPrefix, 1, false});
+        return false;
+    }
+    it->second.count++;
+    *skip = it->second.skip;
+    return it->second.count > counts->budget;
+}
+
+// Remember what the callbacks returned for a message that was sent
+static inline void debug_report_set_msg_skip(const debug_report_data *debug_data, uint64_t srcObject, int32_t msgCode, bool skip) {
+    debug_report_message_counts *counts = debug_data->message_counts;
+    std::lock_guard<std::mutex> lock(counts->lock);
+    auto it = counts->counts.find(debug_report_message_counts::message_key(msgCode, srcObject));
+    if (it != counts->counts.end()) {
+        it->second.skip = skip;
+    }
+}
+
+// Send one message for each message code and object that went over the budget, saying how many were not sent, and start
+// counting again. Called when the instance is destroyed.
+static inline void debug_report_report_suppressed_msgs(debug_report_data *debug_data) {
+    debug_report_message_counts *counts = debug_data->message_counts;
+    std::map<debug_report_message_counts::message_key, debug_report_message_counts::entry> seen;
+    uint32_t budget;
+    {
+        std::lock_guard<std::mutex> lock(counts->lock);
+        if (counts->budget == 0) {
+            return;
+        }
+        seen.swap(counts->counts);
+        budget = counts->budget;
+    }
+    debug_report_flush_delivery_queue(debug_data);
+    for (const auto &msg : seen) {
+        if (msg.second.count <= budget) {
+            continue;
+        }
+        std::string text = std::to_string(msg.second.count - budget) + " more messages with code " +
+                           std::to_string(msg.first.first) + " were not reported after the first " + std::to_string(budget) +
+                           " (message_budget)";
+        std::string named_msg;
+        debug_report_call_callbacks(debug_data, msg.second.flags, msg.second.object_type, msg.first.second, 0, msg.first.first,
+                                    msg.second.layer_prefix.c_str(),
+                                    debug_report_named_msg(debug_data, msg.first.second, text.c_str(), named_msg));
+    }
+}
+
 static inline debug_report_data *debug_report_create_instance(
     VkLayerInstanceDispatchTable *table, VkInstance inst, uint32_t extension_count,
     const char *const *ppEnabledExtensions)  // layer or extension name to be enabled
@@ -160,14 +395,18 @@ static inline debug_report_data *debug_report_create_instance(
         }
     }
     debug_data->debugObjectNameMap = new std::unordered_map<uint64_t, std::string>;
+    debug_data->message_counts = new debug_report_message_counts;
     return debug_data;
 }
 
 static inline void layer_debug_report_destroy_instance(debug_report_data *debug_data) {
     if (debug_data) {
+        debug_report_report_suppressed_msgs(debug_data);
+        debug_report_stop_delivery_thread(debug_data);
         RemoveAllMessageCallbacks(debug_data, &debug_data->default_debug_callback_list);
         RemoveAllMessageCallbacks(debug_data, &debug_data->debug_callback_list);
         delete debug_data->debugObjectNameMap;
+        delete debug_data->message_counts;
         free(debug_data);
     }
 }
@@ -179,11 +418,13 @@ static inline debug_report_data *layer_debug_report_create_device(debug_report_d
 }
 
 static inline void layer_debug_report_destroy_device(VkDevice device) {
-    // Nothing to do since we're using instance data record
+    // Nothing to do since we're using instance data record. The message counts are kept for all the devices of the instance,
+    //  so what the message budget held back is only reported when the instance is destroyed.
 }
 
 static inline void layer_destroy_msg_callback(debug_report_data *debug_data, VkDebugReportCallbackEXT callback,
                                               const VkAllocationCallbacks *pAllocator) {
+    debug_report_flush_delivery_queue(debug_data);
     RemoveDebugMessageCallback(debug_data, &debug_data->debug_callback_list, callback);
     RemoveDebugMessageCallback(debug_data, &debug_data->default_debug_callback_list, callback);
 }
@@ -201,13 +442,13 @@ static inline VkResult layer_create_msg_callback(debug_report_data *debug_data,
     pNewDbgFuncNode->msgFlags = pCreateInfo->flags;
     pNewDbgFuncNode->pUserData = pCreateInfo->pUserData;
 
+    debug_report_flush_delivery_queue(debug_data);
     if (default_callback) {
         AddDebugMessageCallback(debug_data, &debug_data->default_debug_callback_list, pNewDbgFuncNode);
-        debug_data->active_flags |= pCreateInfo->flags;
     } else {
         AddDebugMessageCallback(debug_data, &debug_data->debug_callback_list, pNewDbgFuncNode);
-        debug_data->active_flags = pCreateInfo->flags;
     }
+    UpdateActiveFlags(debug_data);
 
     debug_report_log_msg(debug_data, VK_DEBUG_REPORT_DEBUG_BIT_EXT, VK_DEBUG_REPORT_OBJECT_TYPE_DEBUG_REPORT_EXT,
                          (uint64_t)*pCallback, 0, 0, "DebugReport", "Added callback");
@@ -355,6 +596,26 @@ static inline bool log_msg(const debug_report_data *debug_data, VkFlags msgFlags
         return false;
     }
 
+    bool budgeted = debug_data->message_counts->budget.load(std::memory_order_relaxed) != 0;
+    if (budgeted) {
+        bool skip = false;
+        if (debug_report_msg_over_budget(debug_data, msgFlags, objectType, srcObject, msgCode, pLayerPrefix, &skip)) {
+            return skip;
+        }
+    }
+
+    debug_report_delivery_queue *queue = debug_data->delivery_queue;
+    if (queue) {
+        // Don't format repeats of a message that is still waiting for the delivery thread
+        debug_report_delivery_queue::message_key key(msgFlags, msgCode, srcObject);
+        {
+            std::lock_guard<std::mutex> lock(queue->lock);
+            if (debug_report_count_repeated_msg(queue, key)) {
+                return false;
+            }
+        }
+    }
+
     va_list argptr;
     va_start(argptr, format);
     char *str;
@@ -363,8 +624,19 @@ static inline bool log_msg(const debug_report_data *debug_data, VkFlags msgFlags
         str = nullptr;
     }
     va_end(argptr);
-    bool result = debug_report_log_msg(debug_data, msgFlags, objectType, srcObject, location, msgCode, pLayerPrefix,
-                                       str ? str : "Allocation failure");
+    bool result = false;
+    if (queue) {
+        std::string named_msg;
+        debug_report_queue_msg(queue, {msgFlags, objectType, srcObject, location, msgCode, pLayerPrefix,
+                                       debug_report_named_msg(debug_data, srcObject, str ? str : "Allocation failure", named_msg),
+                                       1});
+    } else {
+        result = debug_report_log_msg(debug_data, msgFlags, objectType, srcObject, location, msgCode, pLayerPrefix,
+                                      str ? str : "Allocation failure");
+        if (budgeted && result) {
+            debug_report_set_msg_skip(debug_data, srcObject, msgCode, result);
+        }
+    }
     free(str);
     return result;
 }
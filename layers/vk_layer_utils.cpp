@@ -98,9 +98,13 @@ VK_LAYER_EXPORT void layer_debug_actions(debug_report_data *report_data, std::ve
     std::string report_flags_key = layer_identifier;
     std::string debug_action_key = layer_identifier;
     std::string log_filename_key = layer_identifier;
+    std::string async_reporting_key = layer_identifier;
+    std::string message_budget_key = layer_identifier;
     report_flags_key.append(".report_flags");
     debug_action_key.append(".debug_action");
     log_filename_key.append(".log_filename");
+    async_reporting_key.append(".async_reporting");
+    message_budget_key.append(".message_budget");
 
     // Initialize layer options
     VkDebugReportFlagsEXT report_flags = GetLayerOptionFlags(report_flags_key, report_flags_option_definitions, 0);
@@ -147,4 +151,13 @@ VK_LAYER_EXPORT void layer_debug_actions(debug_report_data *report_data, std::ve
         logging_callback.push_back(callback);
     }
 
+    const char *async_reporting = getLayerOption(async_reporting_key.c_str());
+    if (async_reporting && !strcmp(async_reporting, "true")) {
+        debug_report_start_delivery_thread(report_data);
+    }
+
+    const char *message_budget = getLayerOption(message_budget_key.c_str());
+    if (message_budget && *message_budget) {
+        debug_report_set_message_budget(report_data, (uint32_t)strtoul(message_budget, nullptr, 10));
+    }
 }
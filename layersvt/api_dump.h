@@ -30,15 +30,20 @@
 #include "vk_layer_utils.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <ostream>
 #include <sstream>
 #include <string.h>
 #include <string>
 #include <type_traits>
 #include <map>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 #include <unordered_set>
@@ -46,30 +51,38 @@
 
 #define MAX_STRING_LENGTH 1024
 
+// The commands in the order of the ApiDumpCommand values, generated in api_dump.cpp
+extern const char *const api_dump_command_names[];
+extern const size_t api_dump_command_count;
+
 enum class ApiDumpFormat {
     Text,
     Html,
+    Json,
 };
 
 class ApiDumpSettings {
    public:
     ApiDumpSettings() {
         // Get the output file settings and create a stream for it
+        output_format = readFormatOption("lunarg_api_dump.output_format", ApiDumpFormat::Text);
         const char *file_option = getLayerOption("lunarg_api_dump.file");
         if (file_option != NULL && strcmp(file_option, "TRUE") == 0) {
             use_cout = false;
             const char *filename_option = getLayerOption("lunarg_api_dump.log_filename");
             if (filename_option != NULL && strcmp(filename_option, "") != 0)
-                output_stream.open(filename_option, std::ofstream::out | std::ostream::trunc);
+                filename = filename_option;
             else
-                output_stream.open("vk_apidump.txt", std::ofstream::out | std::ostream::trunc);
+                filename = "vk_apidump.txt";
+            per_thread_files = (output_format == ApiDumpFormat::Text || output_format == ApiDumpFormat::Json) &&
+                               readBoolOption("lunarg_api_dump.per_thread_files", false);
+            if (!per_thread_files) output_stream.open(filename, std::ofstream::out | std::ostream::trunc);
         } else {
             use_cout = true;
+            per_thread_files = false;
         }
 
         // Get the remaining settings
-        output_format = readFormatOption("lunarg_api_dump.output_format", ApiDumpFormat::Text);
-
         show_params = readBoolOption("lunarg_api_dump.detailed", true);
         show_address = !readBoolOption("lunarg_api_dump.no_addr", false);
         should_flush = readBoolOption("lunarg_api_dump.flush", true);
@@ -80,6 +93,14 @@ class ApiDumpSettings {
         use_spaces = readBoolOption("lunarg_api_dump.use_spaces", true);
         show_shader = readBoolOption("lunarg_api_dump.show_shader", false);
 
+        // Work out which calls to dump
+        readCommandsOption("lunarg_api_dump.commands", command_enabled);
+        first_frame = 0;
+        last_frame = UINT64_MAX;
+        readFramesOption("lunarg_api_dump.frames", first_frame, last_frame);
+        readThreadsOption("lunarg_api_dump.threads", thread_enabled);
+        filter_calls = first_frame != 0 || last_frame != UINT64_MAX || !thread_enabled.empty();
+
         // Generate HTML heading if specified
         if (output_format == ApiDumpFormat::Html) {
             // Find the layer path
@@ -114,7 +135,7 @@ class ApiDumpSettings {
 
             // clang-format off
             // Insert html heading
-            stream() <<
+            output() <<
                 "<!doctype html>"
                 "<html>"
                     "<head>"
@@ -216,7 +237,7 @@ class ApiDumpSettings {
     ~ApiDumpSettings() {
         if (output_format == ApiDumpFormat::Html) {
             // Close off html
-            stream() << "</div></body></html>";
+            output() << "</div></body></html>";
         }
         if (!use_cout)
             output_stream.close();
@@ -257,9 +278,69 @@ class ApiDumpSettings {
 
     inline bool showType() const { return show_type; }
 
-    inline std::ostream &stream() const { return use_cout ? std::cout : *(std::ofstream *)&output_stream; }
+    // Whether calls of the command, an ApiDumpCommand, are dumped at all
+    inline bool shouldDumpCommand(uint32_t command) const { return command_enabled[command]; }
+
+    // Whether only some frames or threads are dumped
+    inline bool filtersCalls() const { return filter_calls; }
+
+    inline bool shouldDumpFrame(uint64_t frame) const { return frame >= first_frame && frame <= last_frame; }
+
+    inline bool shouldDumpThread(uint32_t thread) const {
+        return thread_enabled.empty() || (thread < thread_enabled.size() && thread_enabled[thread]);
+    }
+
+    // The dump functions write a call to a buffer of the calling thread, so threads don't wait on each other to format their
+    // calls. writeStream() then adds the call to the output.
+    inline std::ostream &stream() const { return threadStream(); }
+
+    // Add what the calling thread wrote to stream() to the output. Must be called with the output mutex held.
+    inline void writeStream() const { writeStream(output()); }
+
+    // Add what the calling thread wrote to stream() to the given output instead
+    void writeStream(std::ostream &out) const {
+        if (output_format == ApiDumpFormat::Json) {
+            std::string &buffer = threadJsonBuffer();
+            out.write(buffer.data(), buffer.size());
+            buffer.clear();
+        } else {
+            std::ostringstream &buffer = threadStream();
+            const std::string text = buffer.str();
+            out.write(text.data(), text.size());
+            buffer.str(std::string());
+        }
+        if (should_flush) out.flush();
+    }
+
+    // The Json back end appends a call to this buffer of the calling thread instead of stream(), so that none of it goes
+    // through iostream formatting. It keeps its capacity from one call to the next.
+    inline std::string &jsonBuffer() const { return threadJsonBuffer(); }
+
+    // Whether each thread writes its calls to a file of its own, see threadFilename()
+    inline bool perThreadFiles() const { return per_thread_files; }
+
+    // The log filename with the number of the thread added before the extension
+    std::string threadFilename(uint32_t thread) const {
+        size_t extension = filename.rfind('.');
+        if (extension == std::string::npos || filename.find_first_of("/\\", extension) != std::string::npos) {
+            extension = filename.size();
+        }
+        return filename.substr(0, extension) + "-" + std::to_string(thread) + filename.substr(extension);
+    }
 
    private:
+    inline std::ostream &output() const { return use_cout ? std::cout : *(std::ofstream *)&output_stream; }
+
+    inline static std::ostringstream &threadStream() {
+        static thread_local std::ostringstream buffer;
+        return buffer;
+    }
+
+    inline static std::string &threadJsonBuffer() {
+        static thread_local std::string buffer;
+        return buffer;
+    }
+
     inline static bool readBoolOption(const char *option, bool default_value) {
         const char *string_option = getLayerOption(option);
         if (string_option != NULL && strcmp(string_option, "TRUE") == 0)
@@ -286,15 +367,71 @@ class ApiDumpSettings {
             return ApiDumpFormat::Text;
         else if (strcmp(string_option, "Html") == 0)
             return ApiDumpFormat::Html;
+        else if (strcmp(string_option, "Json") == 0)
+            return ApiDumpFormat::Json;
         else
             return default_value;
     }
 
+    // A comma separated list of command names, where a name ending in * stands for all commands starting with the rest of it.
+    // All commands are dumped if it is not set.
+    static void readCommandsOption(const char *option, std::vector<bool> &enabled) {
+        const char *string_option = getLayerOption(option);
+        if (string_option == NULL || strcmp(string_option, "") == 0) {
+            enabled.assign(api_dump_command_count, true);
+            return;
+        }
+        enabled.assign(api_dump_command_count, false);
+        std::istringstream list(string_option);
+        std::string name;
+        while (std::getline(list, name, ',')) {
+            name.erase(0, name.find_first_not_of(" \t"));
+            name.erase(name.find_last_not_of(" \t") + 1);
+            bool prefix = !name.empty() && name.back() == '*';
+            if (prefix) name.pop_back();
+            for (size_t i = 0; i < api_dump_command_count; ++i) {
+                if (prefix ? strncmp(api_dump_command_names[i], name.c_str(), name.size()) == 0
+                           : name == api_dump_command_names[i]) {
+                    enabled[i] = true;
+                }
+            }
+        }
+    }
+
+    // <first>-<last>, the frames to dump
+    static void readFramesOption(const char *option, uint64_t &first, uint64_t &last) {
+        const char *string_option = getLayerOption(option);
+        unsigned long long first_value, last_value;
+        if (string_option != NULL && sscanf(string_option, "%llu-%llu", &first_value, &last_value) == 2 &&
+            first_value <= last_value) {
+            first = first_value;
+            last = last_value;
+        }
+    }
+
+    // A comma separated list of the numbers of the threads to dump, as shown in the output. All threads are dumped if it is
+    // not set.
+    static void readThreadsOption(const char *option, std::vector<bool> &enabled) {
+        const char *string_option = getLayerOption(option);
+        if (string_option == NULL) return;
+        std::istringstream list(string_option);
+        std::string number;
+        while (std::getline(list, number, ',')) {
+            unsigned int thread;
+            if (sscanf(number.c_str(), "%u", &thread) == 1) {
+                if (thread >= enabled.size()) enabled.resize(thread + 1, false);
+                enabled[thread] = true;
+            }
+        }
+    }
+
     inline static const char *spaces(int count) { return SPACES + (MAX_SPACES - std::max(count, 0)); }
 
     inline static const char *tabs(int count) { return TABS + (MAX_TABS - std::max(count, 0)); }
 
     bool use_cout;
+    std::string filename;
+    bool per_thread_files;
     std::ofstream output_stream;
     ApiDumpFormat output_format;
     bool show_params;
@@ -308,6 +445,12 @@ class ApiDumpSettings {
     bool use_spaces;
     bool show_shader;
 
+    std::vector<bool> command_enabled;
+    bool filter_calls;
+    uint64_t first_frame;
+    uint64_t last_frame;
+    std::vector<bool> thread_enabled;
+
     static const char *const SPACES;
     static const int MAX_SPACES = 72;
     static const char *const TABS;
@@ -319,7 +462,7 @@ const char *const ApiDumpSettings::TABS = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t"
 
 class ApiDumpInstance {
    public:
-    inline ApiDumpInstance() : dump_settings(NULL), frame_count(0), thread_count(0) {
+    inline ApiDumpInstance() : dump_settings(NULL), frame_count(0), thread_count(0), thread_files(), call_count(0) {
         loader_platform_thread_create_mutex(&output_mutex);
         loader_platform_thread_create_mutex(&frame_mutex);
         loader_platform_thread_create_mutex(&thread_mutex);
@@ -328,6 +471,9 @@ class ApiDumpInstance {
 
     inline ~ApiDumpInstance() {
         if (dump_settings != NULL) delete dump_settings;
+        for (uint32_t i = 0; i < MAX_THREADS; ++i) {
+            delete thread_files[i];
+        }
 
         loader_platform_thread_delete_mutex(&thread_mutex);
         loader_platform_thread_delete_mutex(&frame_mutex);
@@ -350,8 +496,42 @@ class ApiDumpInstance {
 
     inline loader_platform_thread_mutex *outputMutex() { return &output_mutex; }
 
+    // Whether to dump a call of the command, from the commands, frames and threads settings. Checked before anything about the
+    // call is formatted.
+    inline bool shouldDump(uint32_t command) {
+        const ApiDumpSettings &dump_settings = settings();
+        if (!dump_settings.shouldDumpCommand(command)) return false;
+        return !dump_settings.filtersCalls() ||
+               (dump_settings.shouldDumpFrame(frameCount()) && dump_settings.shouldDumpThread(threadID()));
+    }
+
+    // Add the call the calling thread has formatted to the output. With per-thread files the call goes to the file of the
+    // thread without taking the output mutex, numbered so that the files can be merged back in order. Json calls carry their
+    // number in the line already.
+    inline void writeCall() {
+        const ApiDumpSettings &dump_settings = settings();
+        if (dump_settings.perThreadFiles()) {
+            uint32_t thread = threadID();
+            // Only the one running thread with this ID uses the file. A later thread that gets the same ID carries on with it.
+            if (thread_files[thread] == NULL) {
+                thread_files[thread] =
+                    new std::ofstream(dump_settings.threadFilename(thread), std::ofstream::out | std::ostream::trunc);
+            }
+            if (dump_settings.format() != ApiDumpFormat::Json) *thread_files[thread] << "Call " << nextCallNumber() << ", ";
+            dump_settings.writeStream(*thread_files[thread]);
+        } else {
+            loader_platform_thread_lock_mutex(&output_mutex);
+            dump_settings.writeStream();
+            loader_platform_thread_unlock_mutex(&output_mutex);
+        }
+    }
+
+    // The number of a new call, counting the calls of all threads
+    inline uint64_t nextCallNumber() { return call_count++; }
+
     inline const ApiDumpSettings &settings() {
-        if (dump_settings == NULL) dump_settings = new ApiDumpSettings();
+        // Calls are formatted without holding the output mutex, so the first ones may get here at the same time
+        std::call_once(settings_once, [this] { dump_settings = new ApiDumpSettings(); });
 
         return *dump_settings;
     }
@@ -441,6 +621,7 @@ class ApiDumpInstance {
     static ApiDumpInstance current_instance;
 
     ApiDumpSettings *dump_settings;
+    std::once_flag settings_once;
     loader_platform_thread_mutex output_mutex;
     loader_platform_thread_mutex frame_mutex;
     uint64_t frame_count;
@@ -449,6 +630,8 @@ class ApiDumpInstance {
     loader_platform_thread_mutex thread_mutex;
     loader_platform_thread_id thread_map[MAX_THREADS];
     uint32_t thread_count;
+    std::ofstream *thread_files[MAX_THREADS];
+    std::atomic<uint64_t> call_count;
 
     loader_platform_thread_mutex cmd_buffer_state_mutex;
     std::map<std::pair<VkDevice, VkCommandPool>, std::unordered_set<VkCommandBuffer> > cmd_buffer_pools;
@@ -736,3 +919,236 @@ inline std::ostream &dump_html_int(int object, const ApiDumpSettings &settings,
     settings.stream() << object;
     return settings.stream() << "</div>";
 }
+
+//==================================== Json Backend Helpers ======================================//
+
+// The Json back end writes each call as one line of JSON to settings.jsonBuffer(). Every value written is followed by a comma,
+// which json_write_close() takes back when the object or array holding the value is closed.
+
+inline void json_write_key(std::string &out, const char *name) {
+    out += '"';
+    out += name;
+    out += "\":";
+}
+
+inline void json_write_open(std::string &out, char bracket) { out += bracket; }
+
+inline void json_write_close(std::string &out, char bracket) {
+    if (out.back() == ',')
+        out.back() = bracket;
+    else
+        out += bracket;
+    out += ',';
+}
+
+inline void json_write_uint(std::string &out, uint64_t value) {
+    char digits[20];
+    char *begin = digits + sizeof(digits);
+    do {
+        *--begin = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    out.append(begin, digits + sizeof(digits));
+    out += ',';
+}
+
+inline void json_write_int(std::string &out, int64_t value) {
+    if (value < 0) out += '-';
+    json_write_uint(out, value < 0 ? 0 - (uint64_t)value : (uint64_t)value);
+}
+
+// JSON has no numbers for NaN and the infinities, so they are written as strings
+inline void json_write_float(std::string &out, double value, int precision) {
+    if (std::isnan(value)) {
+        out += "\"nan\",";
+    } else if (std::isinf(value)) {
+        out += value < 0 ? "\"-inf\"," : "\"inf\",";
+    } else {
+        char text[32];
+        out.append(text, snprintf(text, sizeof(text), "%.*g", precision, value));
+        out += ',';
+    }
+}
+
+template <typename T>
+inline void json_write_number(std::string &out, T value) {
+    if (std::is_floating_point<T>::value)
+        json_write_float(out, (double)value, std::numeric_limits<T>::max_digits10);
+    else if (std::is_signed<T>::value)
+        json_write_int(out, (int64_t)value);
+    else
+        json_write_uint(out, (uint64_t)value);
+}
+
+inline void json_write_string(std::string &out, const char *text) {
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    const char *plain = text;
+    for (const char *c = text; *c != '\0'; ++c) {
+        unsigned char code = (unsigned char)*c;
+        if (code >= 0x20 && code != '"' && code != '\\') continue;
+        out.append(plain, c);
+        plain = c + 1;
+        if (code == '"' || code == '\\') {
+            out += '\\';
+            out += *c;
+        } else if (code == '\n') {
+            out += "\\n";
+        } else if (code == '\t') {
+            out += "\\t";
+        } else {
+            out += "\\u00";
+            out += hex[code >> 4];
+            out += hex[code & 0xf];
+        }
+    }
+    out += plain;
+    out += "\",";
+}
+
+// Addresses are strings of hex digits, or "address" when addresses are hidden
+inline void json_write_address(std::string &out, uint64_t address, const ApiDumpSettings &settings) {
+    static const char hex[] = "0123456789abcdef";
+    if (!settings.showAddress()) {
+        out += "\"address\",";
+        return;
+    }
+    char digits[16];
+    char *begin = digits + sizeof(digits);
+    do {
+        *--begin = hex[address & 0xf];
+        address >>= 4;
+    } while (address != 0);
+    out += "\"0x";
+    out.append(begin, digits + sizeof(digits));
+    out += "\",";
+}
+
+// Non-dispatchable handles are 64 bit integers rather than pointers on 32 bit platforms
+template <typename T>
+inline void json_write_handle(std::string &out, T *handle, const ApiDumpSettings &settings) {
+    json_write_address(out, (uint64_t)(uintptr_t)handle, settings);
+}
+
+inline void json_write_handle(std::string &out, uint64_t handle, const ApiDumpSettings &settings) {
+    json_write_address(out, handle, settings);
+}
+
+// For the platform types, which are pointers on some platforms and integers on others
+template <typename T>
+inline void json_write_scalar(std::string &out, T value, const ApiDumpSettings &settings, std::true_type is_pointer) {
+    json_write_address(out, (uint64_t)(uintptr_t)value, settings);
+}
+
+template <typename T>
+inline void json_write_scalar(std::string &out, T value, const ApiDumpSettings &settings, std::false_type is_pointer) {
+    json_write_number(out, value);
+}
+
+template <typename T>
+inline void json_write_scalar(std::string &out, T value, const ApiDumpSettings &settings) {
+    json_write_scalar(out, value, settings, std::is_pointer<T>());
+}
+
+template <typename T, typename... Args>
+inline void dump_json_array(const T *array, size_t len, const ApiDumpSettings &settings, const char *name,
+                            void (*dump)(const T, const ApiDumpSettings &, Args... args), Args... args) {
+    std::string &out = settings.jsonBuffer();
+    json_write_key(out, name);
+    if (array == NULL) {
+        out += "null,";
+        return;
+    }
+    json_write_open(out, '[');
+    for (size_t i = 0; i < len; ++i) dump(array[i], settings, args...);
+    json_write_close(out, ']');
+}
+
+template <typename T, typename... Args>
+inline void dump_json_array(const T *array, size_t len, const ApiDumpSettings &settings, const char *name,
+                            void (*dump)(const T &, const ApiDumpSettings &, Args... args), Args... args) {
+    std::string &out = settings.jsonBuffer();
+    json_write_key(out, name);
+    if (array == NULL) {
+        out += "null,";
+        return;
+    }
+    json_write_open(out, '[');
+    for (size_t i = 0; i < len; ++i) dump(array[i], settings, args...);
+    json_write_close(out, ']');
+}
+
+template <typename T, typename... Args>
+inline void dump_json_pointer(const T *pointer, const ApiDumpSettings &settings, const char *name,
+                              void (*dump)(const T, const ApiDumpSettings &, Args... args), Args... args) {
+    json_write_key(settings.jsonBuffer(), name);
+    if (pointer == NULL)
+        settings.jsonBuffer() += "null,";
+    else
+        dump(*pointer, settings, args...);
+}
+
+template <typename T, typename... Args>
+inline void dump_json_pointer(const T *pointer, const ApiDumpSettings &settings, const char *name,
+                              void (*dump)(const T &, const ApiDumpSettings &, Args... args), Args... args) {
+    json_write_key(settings.jsonBuffer(), name);
+    if (pointer == NULL)
+        settings.jsonBuffer() += "null,";
+    else
+        dump(*pointer, settings, args...);
+}
+
+template <typename T, typename... Args>
+inline void dump_json_value(const T object, const ApiDumpSettings &settings, const char *name,
+                            void (*dump)(const T, const ApiDumpSettings &, Args... args), Args... args) {
+    json_write_key(settings.jsonBuffer(), name);
+    dump(object, settings, args...);
+}
+
+template <typename T, typename... Args>
+inline void dump_json_value(const T &object, const ApiDumpSettings &settings, const char *name,
+                            void (*dump)(const T &, const ApiDumpSettings &, Args... args), Args... args) {
+    json_write_key(settings.jsonBuffer(), name);
+    dump(object, settings, args...);
+}
+
+inline void dump_json_special(const char *text, const ApiDumpSettings &settings, const char *name) {
+    json_write_key(settings.jsonBuffer(), name);
+    json_write_string(settings.jsonBuffer(), text);
+}
+
+inline void dump_json_cstring(const char *object, const ApiDumpSettings &settings) {
+    if (object == NULL)
+        settings.jsonBuffer() += "null,";
+    else
+        json_write_string(settings.jsonBuffer(), object);
+}
+
+inline void dump_json_void(const void *object, const ApiDumpSettings &settings) {
+    if (object == NULL)
+        settings.jsonBuffer() += "null,";
+    else
+        json_write_address(settings.jsonBuffer(), (uint64_t)(uintptr_t)object, settings);
+}
+
+inline void dump_json_int(int object, const ApiDumpSettings &settings) { json_write_int(settings.jsonBuffer(), object); }
+
+// Start the line of a call with the fields every call has. The object is left open for the result and the parameters.
+inline void dump_json_call_begin(ApiDumpInstance &dump_inst, const char *function) {
+    std::string &out = dump_inst.settings().jsonBuffer();
+    json_write_open(out, '{');
+    json_write_key(out, "call");
+    json_write_uint(out, dump_inst.nextCallNumber());
+    json_write_key(out, "thread");
+    json_write_uint(out, dump_inst.threadID());
+    json_write_key(out, "frame");
+    json_write_uint(out, dump_inst.frameCount());
+    json_write_key(out, "function");
+    json_write_string(out, function);
+}
+
+inline void dump_json_call_end(const ApiDumpSettings &settings) {
+    std::string &out = settings.jsonBuffer();
+    json_write_close(out, '}');
+    out.back() = '\n';
+}
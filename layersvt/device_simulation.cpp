@@ -24,6 +24,8 @@
  * from a Vulkan implementation.  Configuration files must validate with the DevSim schema; this layer does not redundantly
  * check for configuration errors that would be caught by schema validation.
  * See JsonLoader::IdentifySchema() for the URIs of supported schemas.
+ * A configuration file may also be a binary profile precompiled from JSON by the devsim_compile tool, see BinaryProfile, and
+ * may hold a library of profiles that are exposed as separate simulated physical devices, see Configuration.
  *
  * References (several documents are also included in the LunarG Vulkan SDK, see [SDK]):
  * [SPEC]   https://www.khronos.org/registry/vulkan/specs/1.0-extensions/html/vkspec.html
@@ -43,6 +45,8 @@
 #include <inttypes.h>
 #include <string.h>
 
+#include <algorithm>
+#include <array>
 #include <functional>
 #include <unordered_map>
 #include <vector>
@@ -62,7 +66,7 @@ namespace {
 // For any changes, at least increment the patch level.
 // When making ANY changes to the version, be sure to also update layersvt/{linux|windows}/VkLayer_device_simulation.json
 const uint32_t kVersionDevsimMajor = 1;
-const uint32_t kVersionDevsimMinor = 1;
+const uint32_t kVersionDevsimMinor = 4;
 const uint32_t kVersionDevsimPatch = 0;
 const uint32_t kVersionDevsimImplementation = VK_MAKE_VERSION(kVersionDevsimMajor, kVersionDevsimMinor, kVersionDevsimPatch);
 
@@ -237,14 +241,21 @@ uint32_t loader_layer_iface_version = CURRENT_LOADER_LAYER_INTERFACE_VERSION;
 
 typedef std::vector<VkQueueFamilyProperties> ArrayOfVkQueueFamilyProperties;
 
+// Indexed by VkFormat, for the core formats.
+typedef std::array<VkFormatProperties, VK_FORMAT_RANGE_SIZE> ArrayOfVkFormatProperties;
+
+// True if format indexes an ArrayOfVkFormatProperties; formats of extensions are passed down the chain instead.
+bool IsCoreFormat(VkFormat format) { return format >= VK_FORMAT_BEGIN_RANGE && format <= VK_FORMAT_END_RANGE; }
+
 // PhysicalDeviceData : creates and manages the simulated device configurations //////////////////////////////////////////////////
 
 class PhysicalDeviceData {
    public:
     // Create a new PDD element, allocated from our map.
-    static PhysicalDeviceData &Create(VkPhysicalDevice pd, VkInstance instance) {
+    // real_pd is the physical device below this layer; it differs from pd when pd is a simulated device of a profile library.
+    static PhysicalDeviceData &Create(VkPhysicalDevice pd, VkInstance instance, VkPhysicalDevice real_pd) {
         assert(!Find(pd));  // Verify this instance does not already exist.
-        const auto result = map_.emplace(pd, PhysicalDeviceData(pd, instance));
+        const auto result = map_.emplace(pd, PhysicalDeviceData(real_pd, instance));
         assert(result.second);  // true=insertion, false=replacement
         auto iter = result.first;
         PhysicalDeviceData *pdd = &iter->second;
@@ -259,12 +270,21 @@ class PhysicalDeviceData {
         return (iter != map_.end()) ? &iter->second : nullptr;
     }
 
+    // Destroy all PDDs of an instance.
+    static void Destroy(VkInstance instance) {
+        for (auto iter = map_.begin(); iter != map_.end();) {
+            iter = (iter->second.instance_ == instance) ? map_.erase(iter) : std::next(iter);
+        }
+    }
+
     VkInstance instance() const { return instance_; }
+    VkPhysicalDevice physical_device() const { return physical_device_; }
 
     VkPhysicalDeviceProperties physical_device_properties_;
     VkPhysicalDeviceFeatures physical_device_features_;
     VkPhysicalDeviceMemoryProperties physical_device_memory_properties_;
     ArrayOfVkQueueFamilyProperties arrayof_queue_family_properties_;
+    ArrayOfVkFormatProperties arrayof_format_properties_;
 
    private:
     PhysicalDeviceData() = delete;
@@ -273,6 +293,7 @@ class PhysicalDeviceData {
         physical_device_properties_ = {};
         physical_device_features_ = {};
         physical_device_memory_properties_ = {};
+        arrayof_format_properties_ = {};
     }
 
     const VkPhysicalDevice physical_device_;
@@ -284,6 +305,21 @@ class PhysicalDeviceData {
 
 PhysicalDeviceData::Map PhysicalDeviceData::map_;
 
+// Handle of a simulated physical device of a profile library.  Its first member is the loader's dispatch pointer, copied from the
+// real physical device, so dispatch keys are the same for both.
+struct SimulatedPhysicalDevice {
+    void *loader_data;
+};
+
+// The simulated physical devices of each instance created with a profile library, in enumeration order.
+std::unordered_map<VkInstance, std::vector<VkPhysicalDevice>> simulated_physical_devices;
+
+// The physical device to pass down the chain for physicalDevice.
+VkPhysicalDevice RealPhysicalDevice(VkPhysicalDevice physicalDevice) {
+    const PhysicalDeviceData *pdd = PhysicalDeviceData::Find(physicalDevice);
+    return pdd ? pdd->physical_device() : physicalDevice;
+}
+
 // Loader for DevSim JSON configuration files ////////////////////////////////////////////////////////////////////////////////////
 
 class JsonLoader {
@@ -294,6 +330,10 @@ class JsonLoader {
     JsonLoader &operator=(const JsonLoader &) = delete;
 
     bool LoadFile(const char *filename);
+    bool LoadProfile(const Json::Value &root);
+
+    // Parse a JSON file into root.
+    static bool ParseFile(const char *filename, Json::Value *root);
 
    private:
     enum class SchemaId {
@@ -311,6 +351,7 @@ class JsonLoader {
     void GetValue(const Json::Value &parent, const char *name, VkPhysicalDeviceMemoryProperties *dest);
     void GetValue(const Json::Value &parent, const char *name, VkExtent3D *dest);
     void GetValue(const Json::Value &parent, int index, VkQueueFamilyProperties *dest);
+    void GetValue(const Json::Value &parent, int index, VkFormatProperties *dest);
 
     // For use as warn_func in GET_VALUE_WARN().  Return true if warning occurred.
     static bool WarnIfGreater(const char *name, const uint64_t new_value, const uint64_t old_value) {
@@ -479,10 +520,35 @@ class JsonLoader {
         return dest->size();
     }
 
+    // Formats missing from the array support no features, as vulkaninfo leaves those out.
+    int GetArray(const Json::Value &parent, const char *name, ArrayOfVkFormatProperties *dest) {
+        DebugPrintf("\t\tJsonLoader::GetArray(ArrayOfVkFormatProperties)\n");
+        const Json::Value value = parent[name];
+        if (value.type() != Json::arrayValue) {
+            return -1;
+        }
+        dest->fill(VkFormatProperties{});
+        const int count = static_cast<int>(value.size());
+        for (int i = 0; i < count; ++i) {
+            const Json::Value format_id = value[i]["formatID"];
+            if (!format_id.isInt() || !IsCoreFormat(static_cast<VkFormat>(format_id.asInt()))) {
+                DebugPrintf("WARN ArrayOfVkFormatProperties element %d has no core formatID, ignored\n", i);
+                continue;
+            }
+            GetValue(value, i, &(*dest)[format_id.asInt()]);
+        }
+        return count;
+    }
+
     PhysicalDeviceData &pdd_;
 };
 
 bool JsonLoader::LoadFile(const char *filename) {
+    Json::Value root = Json::nullValue;
+    return ParseFile(filename, &root) && LoadProfile(root);
+}
+
+bool JsonLoader::ParseFile(const char *filename, Json::Value *root) {
     std::ifstream json_file(filename);
     if (!json_file) {
         ErrorPrintf("JsonLoader failed to open file \"%s\"\n", filename);
@@ -491,19 +557,21 @@ bool JsonLoader::LoadFile(const char *filename) {
 
     DebugPrintf("JsonCpp version %s\n", JSONCPP_VERSION_STRING);
     Json::Reader reader;
-    Json::Value root = Json::nullValue;
-    bool success = reader.parse(json_file, root, false);
+    bool success = reader.parse(json_file, *root, false);
     if (!success) {
         ErrorPrintf("Json::Reader failed {\n%s}\n", reader.getFormattedErrorMessages().c_str());
         return false;
     }
     json_file.close();
+    return true;
+}
 
+bool JsonLoader::LoadProfile(const Json::Value &root) {
     if (root.type() != Json::objectValue) {
         DebugPrintf("Json document root is not an object\n");
         return false;
     }
-    DebugPrintf("\t\tJsonLoader::LoadFile() OK\n");
+    DebugPrintf("\t\tJsonLoader::LoadProfile() OK\n");
 
     const Json::Value schema_value = root["$schema"];
     const SchemaId schema_id = IdentifySchema(schema_value);
@@ -513,6 +581,7 @@ bool JsonLoader::LoadFile(const char *filename) {
             GetValue(root, "VkPhysicalDeviceFeatures", &pdd_.physical_device_features_);
             GetValue(root, "VkPhysicalDeviceMemoryProperties", &pdd_.physical_device_memory_properties_);
             GetArray(root, "ArrayOfVkQueueFamilyProperties", &pdd_.arrayof_queue_family_properties_);
+            GetArray(root, "ArrayOfVkFormatProperties", &pdd_.arrayof_format_properties_);
             break;
         case SchemaId::kUnknown:
         default:
@@ -778,6 +847,16 @@ void JsonLoader::GetValue(const Json::Value &parent, int index, VkQueueFamilyPro
     GET_VALUE(minImageTransferGranularity);
 }
 
+void JsonLoader::GetValue(const Json::Value &parent, int index, VkFormatProperties *dest) {
+    const Json::Value value = parent[index];
+    if (value.type() != Json::objectValue) {
+        return;
+    }
+    GET_VALUE(linearTilingFeatures);
+    GET_VALUE(optimalTilingFeatures);
+    GET_VALUE(bufferFeatures);
+}
+
 void JsonLoader::GetValue(const Json::Value &parent, int index, VkMemoryType *dest) {
     DebugPrintf("\t\tJsonLoader::GetValue(VkMemoryType %d)\n", index);
     const Json::Value value = parent[index];
@@ -823,6 +902,271 @@ void JsonLoader::GetValue(const Json::Value &parent, const char *name, VkPhysica
 #undef GET_VALUE
 #undef GET_ARRAY
 
+// Precompiled binary configuration files ////////////////////////////////////////////////////////////////////////////////////////
+
+// A binary profile holds the values that JsonLoader would load from a configuration file, so that short-lived processes can
+// apply them without parsing JSON.  It is written by the devsim_compile tool, which is this file built with
+// DEVSIM_COMPILE_TOOL defined.  The Vulkan structures are stored as raw bytes, so a binary profile is only valid for the
+// VK_HEADER_VERSION and ABI it was compiled with; other files are rejected.
+//
+// Each structure is followed by a mask of the same size whose bytes are 0xff where the profile sets a value, so values absent
+// from the JSON keep their previous value, as with JsonLoader.  The format properties are replaced as a whole, like the JSON
+// array they come from, so they have no mask.  queue_family_count VkQueueFamilyProperties follow the header,
+// and the next profile of a library, if any, follows them.
+const char kBinaryProfileMagic[8] = {'D', 'E', 'V', 'S', 'I', 'M', 'B', 'P'};
+const uint32_t kBinaryProfileVersion = 2;
+
+struct BinaryProfile {
+    char magic[8];                   // kBinaryProfileMagic
+    uint32_t version;                // kBinaryProfileVersion
+    uint32_t vk_header_version;      // VK_HEADER_VERSION
+    uint32_t size;                   // sizeof(BinaryProfile)
+    int32_t queue_family_count;      // -1 if the profile has no ArrayOfVkQueueFamilyProperties
+    uint32_t has_format_properties;  // 0 if the profile has no ArrayOfVkFormatProperties
+    VkPhysicalDeviceProperties physical_device_properties;
+    VkPhysicalDeviceProperties physical_device_properties_mask;
+    VkPhysicalDeviceFeatures physical_device_features;
+    VkPhysicalDeviceFeatures physical_device_features_mask;
+    VkPhysicalDeviceMemoryProperties physical_device_memory_properties;
+    VkPhysicalDeviceMemoryProperties physical_device_memory_properties_mask;
+    VkFormatProperties format_properties[VK_FORMAT_RANGE_SIZE];
+};
+
+// A binary file holds one or more profiles back to back; more than one makes it a profile library.
+class BinaryProfileLoader {
+   public:
+    BinaryProfileLoader() {}
+    BinaryProfileLoader(const BinaryProfileLoader &) = delete;
+    BinaryProfileLoader &operator=(const BinaryProfileLoader &) = delete;
+
+    // Return true if filename is a binary file, whether or not its profiles could be loaded.
+    bool LoadFile(const char *filename);
+    size_t profile_count() const { return profiles_.size(); }
+    void Apply(size_t index, PhysicalDeviceData &pdd) const;
+
+   private:
+    struct Profile {
+        BinaryProfile header;
+        ArrayOfVkQueueFamilyProperties arrayof_queue_family_properties;
+    };
+
+    template <typename T>
+    static void ApplyMasked(const T &src, const T &mask, T *dest) {
+        const uint8_t *src_bytes = reinterpret_cast<const uint8_t *>(&src);
+        const uint8_t *mask_bytes = reinterpret_cast<const uint8_t *>(&mask);
+        uint8_t *dest_bytes = reinterpret_cast<uint8_t *>(dest);
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            dest_bytes[i] = (dest_bytes[i] & ~mask_bytes[i]) | (src_bytes[i] & mask_bytes[i]);
+        }
+    }
+
+    std::vector<Profile> profiles_;
+};
+
+bool BinaryProfileLoader::LoadFile(const char *filename) {
+    std::ifstream binary_file(filename, std::ios::binary);
+    if (!binary_file) {
+        return false;
+    }
+    char magic[sizeof(kBinaryProfileMagic)] = {};
+    if (!binary_file.read(magic, sizeof(magic)) || memcmp(magic, kBinaryProfileMagic, sizeof(magic)) != 0) {
+        return false;
+    }
+    DebugPrintf("\t\tBinaryProfileLoader::LoadFile()\n");
+
+    binary_file.seekg(0);
+    std::vector<Profile> profiles;
+    Profile profile;
+    bool truncated = false;
+    while (binary_file.read(reinterpret_cast<char *>(&profile.header), sizeof(profile.header))) {
+        if (memcmp(profile.header.magic, kBinaryProfileMagic, sizeof(magic)) != 0 ||
+            profile.header.version != kBinaryProfileVersion || profile.header.vk_header_version != VK_HEADER_VERSION ||
+            profile.header.size != sizeof(profile.header)) {
+            ErrorPrintf("Binary profile \"%s\" was compiled for a different version of %s, recompile it with devsim_compile\n",
+                        filename, kOurLayerName);
+            return true;
+        }
+        profile.arrayof_queue_family_properties.clear();
+        if (profile.header.queue_family_count > 0) {
+            profile.arrayof_queue_family_properties.resize(profile.header.queue_family_count);
+            if (!binary_file.read(reinterpret_cast<char *>(profile.arrayof_queue_family_properties.data()),
+                                  profile.header.queue_family_count * sizeof(VkQueueFamilyProperties))) {
+                truncated = true;
+                break;
+            }
+        }
+        profiles.push_back(profile);
+    }
+    if (truncated || binary_file.gcount() != 0) {
+        ErrorPrintf("Binary profile \"%s\" is truncated\n", filename);
+        return true;
+    }
+    profiles_.swap(profiles);
+    DebugPrintf("\t\tBinaryProfileLoader::LoadFile() OK, %zu profiles\n", profiles_.size());
+    return true;
+}
+
+void BinaryProfileLoader::Apply(size_t index, PhysicalDeviceData &pdd) const {
+    if (index >= profiles_.size()) {
+        return;
+    }
+    const BinaryProfile &header = profiles_[index].header;
+    ApplyMasked(header.physical_device_properties, header.physical_device_properties_mask, &pdd.physical_device_properties_);
+    ApplyMasked(header.physical_device_features, header.physical_device_features_mask, &pdd.physical_device_features_);
+    ApplyMasked(header.physical_device_memory_properties, header.physical_device_memory_properties_mask,
+                &pdd.physical_device_memory_properties_);
+    if (header.queue_family_count >= 0) {
+        pdd.arrayof_queue_family_properties_ = profiles_[index].arrayof_queue_family_properties;
+    }
+    if (header.has_format_properties) {
+        std::copy(std::begin(header.format_properties), std::end(header.format_properties),
+                  pdd.arrayof_format_properties_.begin());
+    }
+}
+
+// Configuration files ///////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The configuration file, read once per process and reused by every instance.
+// A JSON file holds one configuration object, or is a profile library holding an array of them; a binary file holds one or more
+// precompiled profiles.  With a single profile, every physical device is simulated with it; a library with several profiles
+// exposes one simulated physical device per profile and physical device.
+class Configuration {
+   public:
+    Configuration() : loaded_(false), is_binary_(false), json_root_(Json::nullValue) {}
+    Configuration(const Configuration &) = delete;
+    Configuration &operator=(const Configuration &) = delete;
+
+    void Load(const std::string &filename) {
+        if (loaded_ && filename == filename_) {
+            return;
+        }
+        loaded_ = true;
+        filename_ = filename;
+        is_binary_ = binary_loader_.LoadFile(filename.c_str());
+        json_root_ = Json::nullValue;
+        if (!is_binary_ && !JsonLoader::ParseFile(filename.c_str(), &json_root_)) {
+            json_root_ = Json::nullValue;
+        }
+    }
+
+    size_t profile_count() const {
+        if (is_binary_) {
+            return binary_loader_.profile_count();
+        }
+        return json_root_.isArray() ? json_root_.size() : json_root_.isObject() ? 1 : 0;
+    }
+
+    // Override PDD members with values from profile `index`.
+    void Apply(size_t index, PhysicalDeviceData &pdd) const {
+        if (is_binary_) {
+            binary_loader_.Apply(index, pdd);
+        } else if (index < profile_count()) {
+            JsonLoader json_loader(pdd);
+            json_loader.LoadProfile(json_root_.isArray() ? json_root_[static_cast<Json::ArrayIndex>(index)] : json_root_);
+        }
+    }
+
+   private:
+    bool loaded_;
+    std::string filename_;
+    bool is_binary_;
+    BinaryProfileLoader binary_loader_;
+    Json::Value json_root_;
+};
+
+Configuration configuration;
+
+#if defined(DEVSIM_COMPILE_TOOL)
+// Write the values a JSON configuration object sets as a binary profile.
+// The object is loaded twice, over all-zero and all-one bytes; the bytes that come out equal are the ones the profile sets.
+bool CompileProfile(const Json::Value &root, std::ofstream &binary_file) {
+    static uintptr_t next_key = 1;
+    PhysicalDeviceData &zeros = PhysicalDeviceData::Create(reinterpret_cast<VkPhysicalDevice>(next_key), VK_NULL_HANDLE,
+                                                           reinterpret_cast<VkPhysicalDevice>(next_key));
+    next_key++;
+    PhysicalDeviceData &ones = PhysicalDeviceData::Create(reinterpret_cast<VkPhysicalDevice>(next_key), VK_NULL_HANDLE,
+                                                          reinterpret_cast<VkPhysicalDevice>(next_key));
+    next_key++;
+    memset(&ones.physical_device_properties_, 0xff, sizeof(ones.physical_device_properties_));
+    memset(&ones.physical_device_features_, 0xff, sizeof(ones.physical_device_features_));
+    memset(&ones.physical_device_memory_properties_, 0xff, sizeof(ones.physical_device_memory_properties_));
+    ones.arrayof_queue_family_properties_.resize(1);
+    memset(ones.arrayof_format_properties_.data(), 0xff, sizeof(ones.arrayof_format_properties_));
+
+    JsonLoader zeros_loader(zeros);
+    JsonLoader ones_loader(ones);
+    if (!zeros_loader.LoadProfile(root) || !ones_loader.LoadProfile(root)) {
+        return false;
+    }
+
+    BinaryProfile profile = {};
+    memcpy(profile.magic, kBinaryProfileMagic, sizeof(profile.magic));
+    profile.version = kBinaryProfileVersion;
+    profile.vk_header_version = VK_HEADER_VERSION;
+    profile.size = sizeof(profile);
+
+    const auto compute_mask = [](const void *zero_values, const void *one_values, size_t size, void *values, void *mask) {
+        const uint8_t *zero_bytes = static_cast<const uint8_t *>(zero_values);
+        const uint8_t *one_bytes = static_cast<const uint8_t *>(one_values);
+        uint8_t *mask_bytes = static_cast<uint8_t *>(mask);
+        memcpy(values, zero_values, size);
+        for (size_t i = 0; i < size; ++i) {
+            mask_bytes[i] = (zero_bytes[i] == one_bytes[i]) ? 0xff : 0x00;
+        }
+    };
+    compute_mask(&zeros.physical_device_properties_, &ones.physical_device_properties_, sizeof(profile.physical_device_properties),
+                 &profile.physical_device_properties, &profile.physical_device_properties_mask);
+    compute_mask(&zeros.physical_device_features_, &ones.physical_device_features_, sizeof(profile.physical_device_features),
+                 &profile.physical_device_features, &profile.physical_device_features_mask);
+    compute_mask(&zeros.physical_device_memory_properties_, &ones.physical_device_memory_properties_,
+                 sizeof(profile.physical_device_memory_properties), &profile.physical_device_memory_properties,
+                 &profile.physical_device_memory_properties_mask);
+
+    // An absent array leaves the one-element placeholder in place, a loaded array replaces both.
+    const ArrayOfVkQueueFamilyProperties &queue_families = zeros.arrayof_queue_family_properties_;
+    const bool has_queue_families = queue_families.size() == ones.arrayof_queue_family_properties_.size();
+    profile.queue_family_count = has_queue_families ? static_cast<int32_t>(queue_families.size()) : -1;
+
+    // Likewise, a loaded format array overwrites every byte of both tables.
+    const ArrayOfVkFormatProperties &formats = zeros.arrayof_format_properties_;
+    profile.has_format_properties = memcmp(formats.data(), ones.arrayof_format_properties_.data(), sizeof(formats)) == 0;
+    if (profile.has_format_properties) {
+        std::copy(formats.begin(), formats.end(), profile.format_properties);
+    }
+
+    binary_file.write(reinterpret_cast<const char *>(&profile), sizeof(profile));
+    if (has_queue_families) {
+        binary_file.write(reinterpret_cast<const char *>(queue_families.data()),
+                          queue_families.size() * sizeof(VkQueueFamilyProperties));
+    }
+    return true;
+}
+
+// Compile JSON configuration files, including profile libraries, into one binary file.
+bool CompileProfiles(const std::vector<const char *> &json_filenames, const char *binary_filename) {
+    std::ofstream binary_file(binary_filename, std::ios::binary);
+    for (const char *json_filename : json_filenames) {
+        Json::Value root = Json::nullValue;
+        if (!JsonLoader::ParseFile(json_filename, &root)) {
+            return false;
+        }
+        const Json::Value::ArrayIndex count = root.isArray() ? root.size() : 1;
+        for (Json::Value::ArrayIndex i = 0; i < count; ++i) {
+            if (!CompileProfile(root.isArray() ? root[i] : root, binary_file)) {
+                ErrorPrintf("Failed to load profile %u of \"%s\"\n", i, json_filename);
+                return false;
+            }
+        }
+    }
+    binary_file.close();
+    if (!binary_file) {
+        ErrorPrintf("Failed to write \"%s\"\n", binary_filename);
+        return false;
+    }
+    return true;
+}
+#endif
+
 // Layer-specific wrappers for Vulkan functions, accessed via vkGet*ProcAddr() ///////////////////////////////////////////////////
 
 // Generic layer dispatch table setup, see [LALI].
@@ -867,6 +1211,9 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateInstance(const VkInstanceCreateInfo *pCreat
         ErrorPrintf("envar %s is unset\n", kEnvarDevsimFilename);
     }
 
+    configuration.Load(filename);
+    const size_t profile_count = configuration.profile_count();
+
     const auto dt = instance_dispatch_table(*pInstance);
 
     std::vector<VkPhysicalDevice> physical_devices;
@@ -877,9 +1224,9 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateInstance(const VkInstanceCreateInfo *pCreat
         return result;
     }
 
-    // For each physical device, create and populate a PDD instance.
-    for (const auto &physical_device : physical_devices) {
-        PhysicalDeviceData &pdd = PhysicalDeviceData::Create(physical_device, *pInstance);
+    // Create and populate a PDD instance for pd, backed by physical_device.
+    const auto create_pdd = [&](VkPhysicalDevice pd, VkPhysicalDevice physical_device, size_t profile_index) {
+        PhysicalDeviceData &pdd = PhysicalDeviceData::Create(pd, *pInstance, physical_device);
 
         // Initialize PDD members to the actual Vulkan implementation's defaults.
         dt->GetPhysicalDeviceProperties(physical_device, &pdd.physical_device_properties_);
@@ -890,10 +1237,32 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateInstance(const VkInstanceCreateInfo *pCreat
                                                   dt->GetPhysicalDeviceQueueFamilyProperties(physical_device, count, results);
                                                   return VK_SUCCESS;
                                               });
+        for (uint32_t format = VK_FORMAT_BEGIN_RANGE; format <= VK_FORMAT_END_RANGE; ++format) {
+            dt->GetPhysicalDeviceFormatProperties(physical_device, static_cast<VkFormat>(format),
+                                                  &pdd.arrayof_format_properties_[format]);
+        }
 
         // Override PDD members with values from the configuration file.
-        JsonLoader json_loader(pdd);
-        json_loader.LoadFile(filename.c_str());
+        configuration.Apply(profile_index, pdd);
+    };
+
+    if (profile_count <= 1) {
+        // For each physical device, create and populate a PDD instance.
+        for (const auto &physical_device : physical_devices) {
+            create_pdd(physical_device, physical_device, 0);
+        }
+    } else {
+        // For each profile of the library and each physical device, create a simulated physical device.
+        DebugPrintf("\t\tprofile library with %zu profiles\n", profile_count);
+        std::vector<VkPhysicalDevice> &simulated = simulated_physical_devices[*pInstance];
+        for (size_t i = 0; i < profile_count; ++i) {
+            for (const auto &physical_device : physical_devices) {
+                SimulatedPhysicalDevice *handle = new SimulatedPhysicalDevice;
+                handle->loader_data = *reinterpret_cast<void **>(physical_device);
+                simulated.push_back(reinterpret_cast<VkPhysicalDevice>(handle));
+                create_pdd(simulated.back(), physical_device, i);
+            }
+        }
     }
 
     DebugPrintf("CreateInstance END instance %p }\n", *pInstance);
@@ -910,6 +1279,15 @@ VKAPI_ATTR void VKAPI_CALL DestroyInstance(VkInstance instance, const VkAllocati
         dt->DestroyInstance(instance, pAllocator);
     }
     destroy_instance_dispatch_table(get_dispatch_key(instance));
+
+    PhysicalDeviceData::Destroy(instance);
+    const auto iter = simulated_physical_devices.find(instance);
+    if (iter != simulated_physical_devices.end()) {
+        for (VkPhysicalDevice handle : iter->second) {
+            delete reinterpret_cast<SimulatedPhysicalDevice *>(handle);
+        }
+        simulated_physical_devices.erase(iter);
+    }
 }
 
 VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceProperties(VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties *pProperties) {
@@ -977,7 +1355,7 @@ VKAPI_ATTR VkResult VKAPI_CALL EnumerateDeviceExtensionProperties(VkPhysicalDevi
     if (pLayerName && !strcmp(pLayerName, kOurLayerName)) {
         return EnumerateProperties(kExtensionPropertiesCount, kExtensionProperties, pCount, pProperties);
     }
-    return dt->EnumerateDeviceExtensionProperties(physicalDevice, pLayerName, pCount, pProperties);
+    return dt->EnumerateDeviceExtensionProperties(RealPhysicalDevice(physicalDevice), pLayerName, pCount, pProperties);
 }
 
 VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceMemoryProperties(VkPhysicalDevice physicalDevice,
@@ -1010,6 +1388,309 @@ VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceQueueFamilyProperties(VkPhysicalDevi
     }
 }
 
+VKAPI_ATTR VkResult VKAPI_CALL EnumeratePhysicalDevices(VkInstance instance, uint32_t *pPhysicalDeviceCount,
+                                                        VkPhysicalDevice *pPhysicalDevices) {
+    std::lock_guard<std::mutex> lock(global_lock);
+    const auto dt = instance_dispatch_table(instance);
+
+    const auto iter = simulated_physical_devices.find(instance);
+    DebugPrintf("EnumeratePhysicalDevices instance %p simulated %d\n", instance, iter != simulated_physical_devices.end());
+    if (iter != simulated_physical_devices.end()) {
+        return EnumerateProperties(static_cast<uint32_t>(iter->second.size()), iter->second.data(), pPhysicalDeviceCount,
+                                   pPhysicalDevices);
+    }
+    return dt->EnumeratePhysicalDevices(instance, pPhysicalDeviceCount, pPhysicalDevices);
+}
+
+// The remaining physical device functions pass simulated physical devices down the chain as their real physical device.
+// Physical device functions of extensions not listed in GetInstanceProcAddr() do not support profile libraries.
+
+// False if the simulated format has no features with tiling, so image format queries fail without going down the chain.
+bool SupportsTiling(const PhysicalDeviceData &pdd, VkFormat format, VkImageTiling tiling) {
+    if (!IsCoreFormat(format)) {
+        return true;
+    }
+    const VkFormatProperties &properties = pdd.arrayof_format_properties_[format];
+    switch (tiling) {
+        case VK_IMAGE_TILING_LINEAR:
+            return properties.linearTilingFeatures != 0;
+        case VK_IMAGE_TILING_OPTIMAL:
+            return properties.optimalTilingFeatures != 0;
+        default:
+            return true;
+    }
+}
+
+VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceFormatProperties(VkPhysicalDevice physicalDevice, VkFormat format,
+                                                             VkFormatProperties *pFormatProperties) {
+    std::lock_guard<std::mutex> lock(global_lock);
+    const auto dt = instance_dispatch_table(physicalDevice);
+
+    // The table is filled when the instance is created, so applications querying every format don't go down the chain.
+    const PhysicalDeviceData *pdd = PhysicalDeviceData::Find(physicalDevice);
+    if (pdd && IsCoreFormat(format)) {
+        *pFormatProperties = pdd->arrayof_format_properties_[format];
+    } else {
+        dt->GetPhysicalDeviceFormatProperties(RealPhysicalDevice(physicalDevice), format, pFormatProperties);
+    }
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceImageFormatProperties(VkPhysicalDevice physicalDevice, VkFormat format,
+                                                                      VkImageType type, VkImageTiling tiling,
+                                                                      VkImageUsageFlags usage, VkImageCreateFlags flags,
+                                                                      VkImageFormatProperties *pImageFormatProperties) {
+    std::lock_guard<std::mutex> lock(global_lock);
+    const auto dt = instance_dispatch_table(physicalDevice);
+
+    const PhysicalDeviceData *pdd = PhysicalDeviceData::Find(physicalDevice);
+    if (pdd && !SupportsTiling(*pdd, format, tiling)) {
+        *pImageFormatProperties = {};
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+    return dt->GetPhysicalDeviceImageFormatProperties(RealPhysicalDevice(physicalDevice), format, type, tiling, usage, flags,
+                                                      pImageFormatProperties);
+}
+
+VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceSparseImageFormatProperties(VkPhysicalDevice physicalDevice, VkFormat format,
+                                                                        VkImageType type, VkSampleCountFlagBits samples,
+                                                                        VkImageUsageFlags usage, VkImageTiling tiling,
+                                                                        uint32_t *pPropertyCount,
+                                                                        VkSparseImageFormatProperties *pProperties) {
+    std::lock_guard<std::mutex> lock(global_lock);
+    const auto dt = instance_dispatch_table(physicalDevice);
+    dt->GetPhysicalDeviceSparseImageFormatProperties(RealPhysicalDevice(physicalDevice), format, type, samples, usage, tiling,
+                                                     pPropertyCount, pProperties);
+}
+
+VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceProperties2KHR(VkPhysicalDevice physicalDevice,
+                                                           VkPhysicalDeviceProperties2KHR *pProperties) {
+    std::lock_guard<std::mutex> lock(global_lock);
+    const auto dt = instance_dispatch_table(physicalDevice);
+
+    PhysicalDeviceData *pdd = PhysicalDeviceData::Find(physicalDevice);
+    dt->GetPhysicalDeviceProperties2KHR(RealPhysicalDevice(physicalDevice), pProperties);
+    if (pdd) {
+        pProperties->properties = pdd->physical_device_properties_;
+    }
+}
+
+VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceFeatures2KHR(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures2KHR *pFeatures) {
+    std::lock_guard<std::mutex> lock(global_lock);
+    const auto dt = instance_dispatch_table(physicalDevice);
+
+    PhysicalDeviceData *pdd = PhysicalDeviceData::Find(physicalDevice);
+    dt->GetPhysicalDeviceFeatures2KHR(RealPhysicalDevice(physicalDevice), pFeatures);
+    if (pdd) {
+        pFeatures->features = pdd->physical_device_features_;
+    }
+}
+
+VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceMemoryProperties2KHR(VkPhysicalDevice physicalDevice,
+                                                                 VkPhysicalDeviceMemoryProperties2KHR *pMemoryProperties) {
+    std::lock_guard<std::mutex> lock(global_lock);
+    const auto dt = instance_dispatch_table(physicalDevice);
+
+    PhysicalDeviceData *pdd = PhysicalDeviceData::Find(physicalDevice);
+    dt->GetPhysicalDeviceMemoryProperties2KHR(RealPhysicalDevice(physicalDevice), pMemoryProperties);
+    if (pdd) {
+        pMemoryProperties->memoryProperties = pdd->physical_device_memory_properties_;
+    }
+}
+
+VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceQueueFamilyProperties2KHR(VkPhysicalDevice physicalDevice,
+                                                                      uint32_t *pQueueFamilyPropertyCount,
+                                                                      VkQueueFamilyProperties2KHR *pQueueFamilyProperties) {
+    std::lock_guard<std::mutex> lock(global_lock);
+    const auto dt = instance_dispatch_table(physicalDevice);
+
+    PhysicalDeviceData *pdd = PhysicalDeviceData::Find(physicalDevice);
+    if (!pdd) {
+        dt->GetPhysicalDeviceQueueFamilyProperties2KHR(physicalDevice, pQueueFamilyPropertyCount, pQueueFamilyProperties);
+        return;
+    }
+    // The simulated families need not match the real ones, so structures chained to them are left as they are.
+    const ArrayOfVkQueueFamilyProperties &families = pdd->arrayof_queue_family_properties_;
+    if (!pQueueFamilyProperties) {
+        *pQueueFamilyPropertyCount = static_cast<uint32_t>(families.size());
+        return;
+    }
+    *pQueueFamilyPropertyCount = std::min(*pQueueFamilyPropertyCount, static_cast<uint32_t>(families.size()));
+    for (uint32_t i = 0; i < *pQueueFamilyPropertyCount; ++i) {
+        pQueueFamilyProperties[i].queueFamilyProperties = families[i];
+    }
+}
+
+VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceFormatProperties2KHR(VkPhysicalDevice physicalDevice, VkFormat format,
+                                                                 VkFormatProperties2KHR *pFormatProperties) {
+    std::lock_guard<std::mutex> lock(global_lock);
+    const auto dt = instance_dispatch_table(physicalDevice);
+
+    // Structures chained to pFormatProperties still come from down the chain.
+    const PhysicalDeviceData *pdd = PhysicalDeviceData::Find(physicalDevice);
+    if (pdd && IsCoreFormat(format)) {
+        if (pFormatProperties->pNext) {
+            dt->GetPhysicalDeviceFormatProperties2KHR(RealPhysicalDevice(physicalDevice), format, pFormatProperties);
+        }
+        pFormatProperties->formatProperties = pdd->arrayof_format_properties_[format];
+    } else {
+        dt->GetPhysicalDeviceFormatProperties2KHR(RealPhysicalDevice(physicalDevice), format, pFormatProperties);
+    }
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceImageFormatProperties2KHR(VkPhysicalDevice physicalDevice,
+                                                                          const VkPhysicalDeviceImageFormatInfo2KHR *pImageFormatInfo,
+                                                                          VkImageFormatProperties2KHR *pImageFormatProperties) {
+    std::lock_guard<std::mutex> lock(global_lock);
+    const auto dt = instance_dispatch_table(physicalDevice);
+
+    const PhysicalDeviceData *pdd = PhysicalDeviceData::Find(physicalDevice);
+    if (pdd && !SupportsTiling(*pdd, pImageFormatInfo->format, pImageFormatInfo->tiling)) {
+        pImageFormatProperties->imageFormatProperties = {};
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+    return dt->GetPhysicalDeviceImageFormatProperties2KHR(RealPhysicalDevice(physicalDevice), pImageFormatInfo,
+                                                          pImageFormatProperties);
+}
+
+VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceSparseImageFormatProperties2KHR(
+    VkPhysicalDevice physicalDevice, const VkPhysicalDeviceSparseImageFormatInfo2KHR *pFormatInfo, uint32_t *pPropertyCount,
+    VkSparseImageFormatProperties2KHR *pProperties) {
+    std::lock_guard<std::mutex> lock(global_lock);
+    const auto dt = instance_dispatch_table(physicalDevice);
+    dt->GetPhysicalDeviceSparseImageFormatProperties2KHR(RealPhysicalDevice(physicalDevice), pFormatInfo, pPropertyCount,
+                                                         pProperties);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceSurfaceSupportKHR(VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex,
+                                                                  VkSurfaceKHR surface, VkBool32 *pSupported) {
+    std::lock_guard<std::mutex> lock(global_lock);
+    const auto dt = instance_dispatch_table(physicalDevice);
+    return dt->GetPhysicalDeviceSurfaceSupportKHR(RealPhysicalDevice(physicalDevice), queueFamilyIndex, surface, pSupported);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceSurfaceCapabilitiesKHR(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface,
+                                                                       VkSurfaceCapabilitiesKHR *pSurfaceCapabilities) {
+    std::lock_guard<std::mutex> lock(global_lock);
+    const auto dt = instance_dispatch_table(physicalDevice);
+    return dt->GetPhysicalDeviceSurfaceCapabilitiesKHR(RealPhysicalDevice(physicalDevice), surface, pSurfaceCapabilities);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceSurfaceFormatsKHR(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface,
+                                                                  uint32_t *pSurfaceFormatCount,
+                                                                  VkSurfaceFormatKHR *pSurfaceFormats) {
+    std::lock_guard<std::mutex> lock(global_lock);
+    const auto dt = instance_dispatch_table(physicalDevice);
+    return dt->GetPhysicalDeviceSurfaceFormatsKHR(RealPhysicalDevice(physicalDevice), surface, pSurfaceFormatCount,
+                                                  pSurfaceFormats);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceSurfacePresentModesKHR(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface,
+                                                                       uint32_t *pPresentModeCount,
+                                                                       VkPresentModeKHR *pPresentModes) {
+    std::lock_guard<std::mutex> lock(global_lock);
+    const auto dt = instance_dispatch_table(physicalDevice);
+    return dt->GetPhysicalDeviceSurfacePresentModesKHR(RealPhysicalDevice(physicalDevice), surface, pPresentModeCount,
+                                                       pPresentModes);
+}
+
+#if defined(VK_USE_PLATFORM_XCB_KHR)
+VKAPI_ATTR VkBool32 VKAPI_CALL GetPhysicalDeviceXcbPresentationSupportKHR(VkPhysicalDevice physicalDevice,
+                                                                          uint32_t queueFamilyIndex,
+                                                                          xcb_connection_t *connection,
+                                                                          xcb_visualid_t visual_id) {
+    std::lock_guard<std::mutex> lock(global_lock);
+    const auto dt = instance_dispatch_table(physicalDevice);
+    return dt->GetPhysicalDeviceXcbPresentationSupportKHR(RealPhysicalDevice(physicalDevice), queueFamilyIndex, connection,
+                                                          visual_id);
+}
+#endif
+
+#if defined(VK_USE_PLATFORM_XLIB_KHR)
+VKAPI_ATTR VkBool32 VKAPI_CALL GetPhysicalDeviceXlibPresentationSupportKHR(VkPhysicalDevice physicalDevice,
+                                                                           uint32_t queueFamilyIndex, Display *dpy,
+                                                                           VisualID visualID) {
+    std::lock_guard<std::mutex> lock(global_lock);
+    const auto dt = instance_dispatch_table(physicalDevice);
+    return dt->GetPhysicalDeviceXlibPresentationSupportKHR(RealPhysicalDevice(physicalDevice), queueFamilyIndex, dpy, visualID);
+}
+#endif
+
+#if defined(VK_USE_PLATFORM_WAYLAND_KHR)
+VKAPI_ATTR VkBool32 VKAPI_CALL GetPhysicalDeviceWaylandPresentationSupportKHR(VkPhysicalDevice physicalDevice,
+                                                                              uint32_t queueFamilyIndex,
+                                                                              struct wl_display *display) {
+    std::lock_guard<std::mutex> lock(global_lock);
+    const auto dt = instance_dispatch_table(physicalDevice);
+    return dt->GetPhysicalDeviceWaylandPresentationSupportKHR(RealPhysicalDevice(physicalDevice), queueFamilyIndex, display);
+}
+#endif
+
+#if defined(VK_USE_PLATFORM_WIN32_KHR)
+VKAPI_ATTR VkBool32 VKAPI_CALL GetPhysicalDeviceWin32PresentationSupportKHR(VkPhysicalDevice physicalDevice,
+                                                                            uint32_t queueFamilyIndex) {
+    std::lock_guard<std::mutex> lock(global_lock);
+    const auto dt = instance_dispatch_table(physicalDevice);
+    return dt->GetPhysicalDeviceWin32PresentationSupportKHR(RealPhysicalDevice(physicalDevice), queueFamilyIndex);
+}
+#endif
+
+// DevSim joins the device chain only to create devices on the real physical device of a simulated one.
+VKAPI_ATTR VkResult VKAPI_CALL CreateDevice(VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo *pCreateInfo,
+                                            const VkAllocationCallbacks *pAllocator, VkDevice *pDevice) {
+    VkLayerDeviceCreateInfo *chain_info = get_chain_info(pCreateInfo, VK_LAYER_LINK_INFO);
+    assert(chain_info->u.pLayerInfo);
+
+    PFN_vkGetInstanceProcAddr fp_get_instance_proc_addr = chain_info->u.pLayerInfo->pfnNextGetInstanceProcAddr;
+    PFN_vkGetDeviceProcAddr fp_get_device_proc_addr = chain_info->u.pLayerInfo->pfnNextGetDeviceProcAddr;
+    PFN_vkCreateDevice fp_create_device = (PFN_vkCreateDevice)fp_get_instance_proc_addr(nullptr, "vkCreateDevice");
+    if (!fp_create_device) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    std::lock_guard<std::mutex> lock(global_lock);
+    DebugPrintf("CreateDevice physicalDevice %p\n", physicalDevice);
+
+    chain_info->u.pLayerInfo = chain_info->u.pLayerInfo->pNext;
+    VkResult result = fp_create_device(RealPhysicalDevice(physicalDevice), pCreateInfo, pAllocator, pDevice);
+    if (!result) {
+        initDeviceTable(*pDevice, fp_get_device_proc_addr);
+    }
+    return result;
+}
+
+VKAPI_ATTR void VKAPI_CALL DestroyDevice(VkDevice device, const VkAllocationCallbacks *pAllocator) {
+    DebugPrintf("DestroyDevice device %p\n", device);
+
+    std::lock_guard<std::mutex> lock(global_lock);
+
+    {
+        const auto dt = device_dispatch_table(device);
+        dt->DestroyDevice(device, pAllocator);
+    }
+    destroy_device_dispatch_table(get_dispatch_key(device));
+}
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetDeviceProcAddr(VkDevice device, const char *pName) {
+// Apply the DRY principle, see https://en.wikipedia.org/wiki/Don%27t_repeat_yourself
+#define GET_PROC_ADDR(func) \
+    if (strcmp("vk" #func, pName) == 0) return reinterpret_cast<PFN_vkVoidFunction>(func);
+    GET_PROC_ADDR(GetDeviceProcAddr);
+    GET_PROC_ADDR(DestroyDevice);
+#undef GET_PROC_ADDR
+
+    if (!device) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(global_lock);
+    const auto dt = device_dispatch_table(device);
+
+    if (!dt->GetDeviceProcAddr) {
+        return nullptr;
+    }
+    return dt->GetDeviceProcAddr(device, pName);
+}
+
 VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetInstanceProcAddr(VkInstance instance, const char *pName) {
 // Apply the DRY principle, see https://en.wikipedia.org/wiki/Don%27t_repeat_yourself
 #define GET_PROC_ADDR(func) \
@@ -1024,6 +1705,35 @@ VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetInstanceProcAddr(VkInstance instance
     GET_PROC_ADDR(GetPhysicalDeviceFeatures);
     GET_PROC_ADDR(GetPhysicalDeviceMemoryProperties);
     GET_PROC_ADDR(GetPhysicalDeviceQueueFamilyProperties);
+    GET_PROC_ADDR(EnumeratePhysicalDevices);
+    GET_PROC_ADDR(GetPhysicalDeviceFormatProperties);
+    GET_PROC_ADDR(GetPhysicalDeviceImageFormatProperties);
+    GET_PROC_ADDR(GetPhysicalDeviceSparseImageFormatProperties);
+    GET_PROC_ADDR(GetPhysicalDeviceProperties2KHR);
+    GET_PROC_ADDR(GetPhysicalDeviceFeatures2KHR);
+    GET_PROC_ADDR(GetPhysicalDeviceMemoryProperties2KHR);
+    GET_PROC_ADDR(GetPhysicalDeviceQueueFamilyProperties2KHR);
+    GET_PROC_ADDR(GetPhysicalDeviceFormatProperties2KHR);
+    GET_PROC_ADDR(GetPhysicalDeviceImageFormatProperties2KHR);
+    GET_PROC_ADDR(GetPhysicalDeviceSparseImageFormatProperties2KHR);
+    GET_PROC_ADDR(GetPhysicalDeviceSurfaceSupportKHR);
+    GET_PROC_ADDR(GetPhysicalDeviceSurfaceCapabilitiesKHR);
+    GET_PROC_ADDR(GetPhysicalDeviceSurfaceFormatsKHR);
+    GET_PROC_ADDR(GetPhysicalDeviceSurfacePresentModesKHR);
+#if defined(VK_USE_PLATFORM_XCB_KHR)
+    GET_PROC_ADDR(GetPhysicalDeviceXcbPresentationSupportKHR);
+#endif
+#if defined(VK_USE_PLATFORM_XLIB_KHR)
+    GET_PROC_ADDR(GetPhysicalDeviceXlibPresentationSupportKHR);
+#endif
+#if defined(VK_USE_PLATFORM_WAYLAND_KHR)
+    GET_PROC_ADDR(GetPhysicalDeviceWaylandPresentationSupportKHR);
+#endif
+#if defined(VK_USE_PLATFORM_WIN32_KHR)
+    GET_PROC_ADDR(GetPhysicalDeviceWin32PresentationSupportKHR);
+#endif
+    GET_PROC_ADDR(CreateDevice);
+    GET_PROC_ADDR(GetDeviceProcAddr);
 #undef GET_PROC_ADDR
 
     if (!instance) {
@@ -1047,6 +1757,10 @@ VK_LAYER_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr(V
     return GetInstanceProcAddr(instance, pName);
 }
 
+VK_LAYER_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(VkDevice device, const char *pName) {
+    return GetDeviceProcAddr(device, pName);
+}
+
 VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(const VkInstanceCreateInfo *pCreateInfo,
                                                                 const VkAllocationCallbacks *pAllocator, VkInstance *pInstance) {
     return CreateInstance(pCreateInfo, pAllocator, pInstance);
@@ -1076,11 +1790,23 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
 
     if (pVersionStruct->loaderLayerInterfaceVersion >= 2) {
         pVersionStruct->pfnGetInstanceProcAddr = vkGetInstanceProcAddr;
-        pVersionStruct->pfnGetDeviceProcAddr = nullptr;
+        pVersionStruct->pfnGetDeviceProcAddr = vkGetDeviceProcAddr;
         pVersionStruct->pfnGetPhysicalDeviceProcAddr = nullptr;
     }
 
     return VK_SUCCESS;
 }
 
+#if defined(DEVSIM_COMPILE_TOOL)
+// devsim_compile: precompile DevSim JSON configuration files into a binary profile, or a profile library if there are several.
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <config.json>... <profile.bin>\n", argv[0]);
+        return 1;
+    }
+    const std::vector<const char *> json_filenames(argv + 1, argv + argc - 1);
+    return CompileProfiles(json_filenames, argv[argc - 1]) ? 0 : 1;
+}
+#endif
+
 // vim: set sw=4 ts=8 et ic ai:
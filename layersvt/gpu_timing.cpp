@@ -0,0 +1,825 @@
+/*
+ * Vulkan
+ *
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// winsock2.h has to come before windows.h
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include "vk_layer_config.h"
+#include "vk_layer_data.h"
+#include "vk_layer_extension_utils.h"
+#include "vk_layer_table.h"
+#include <algorithm>
+#include <assert.h>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vk_dispatch_table_helper.h>
+#include <vk_loader_platform.h>
+#include <vulkan/vk_layer.h>
+#include <vulkan/vulkan.h>
+
+// Times the regions that applications mark with vkCmdDebugMarkerBeginEXT and
+// vkCmdDebugMarkerEndEXT, and their render passes, on the GPU.  Timestamps are
+// written around each region into query pools the layer hands out to command
+// buffers, and read back without waiting once the GPU is done with them,
+// usually a few frames later.  Each timed region is written as a line to
+// lunarg_gpu_timing.output.
+//
+// Only primary command buffers are timed; regions in secondary command
+// buffers are covered by the region around vkCmdExecuteCommands.  A query
+// pool can only be reset outside a render pass, so regions begun inside a
+// render pass after the command buffer's pool is used up are not timed.
+
+#define QUERIES_PER_POOL 256
+#define NO_REGION UINT32_MAX
+
+#if defined(_WIN32)
+typedef SOCKET output_socket;
+#define NO_SOCKET INVALID_SOCKET
+#else
+typedef int output_socket;
+#define NO_SOCKET (-1)
+#endif
+
+enum TimingFormat { TIMING_FORMAT_CSV, TIMING_FORMAT_JSON };
+
+// Settings from vk_layer_settings.txt, read when the first device is created.
+struct gpu_timing_settings {
+    FILE *outputFile;            // NULL when writing to a socket or not timing
+    output_socket outputSocket;  // NO_SOCKET when writing to a file or not timing
+    TimingFormat format;
+    bool renderPasses;
+    uint32_t maxQueryPools;  // per device
+    bool headerWritten;
+};
+
+static gpu_timing_settings settings;
+static std::once_flag settingsOnce;
+static std::mutex outputLock;
+
+struct timed_region {
+    std::string name;
+    uint32_t depth;
+    uint32_t pool;   // index into command_buffer_timing::pools
+    uint32_t query;  // begin timestamp, end is the next query
+    bool ended;
+};
+
+// The regions recorded into a primary command buffer.  Its state is only
+// touched by the thread recording or submitting the command buffer, the
+// device's timingLock guards the maps and lists that reference it.
+struct command_buffer_timing {
+    VkCommandPool commandPool;
+    bool timed;  // primary, allocated from a pool whose queue family has timestamps
+    bool inRenderPass;
+    std::vector<VkQueryPool> pools;
+    std::vector<uint32_t> poolQueries;  // queries used in each pool
+    std::vector<timed_region> regions;
+    std::vector<uint32_t> open;  // begun regions, innermost last
+    uint32_t renderPassRegion;
+    bool pending;    // submitted, results not read yet
+    uint64_t frame;  // of the last submit
+};
+
+struct layer_data {
+    VkLayerDispatchTable *device_dispatch_table;
+    VkLayerInstanceDispatchTable *instance_dispatch_table;
+
+    VkPhysicalDevice gpu;
+    VkDevice device;
+
+    // Guards the maps and lists below
+    std::mutex *timingLock;
+    std::vector<uint64_t> *familyValidMasks;  // timestamp bits of each queue family, 0 without timestamps
+    double nsPerTick;
+    std::unordered_map<VkCommandPool, uint32_t> *poolFamilies;
+    std::unordered_map<VkCommandBuffer, command_buffer_timing *> *commandBuffers;
+    std::unordered_map<uint64_t, std::string> *objectNames;  // render pass and framebuffer names
+    std::vector<command_buffer_timing *> *pending;
+    std::vector<VkQueryPool> *freeQueryPools;
+    uint32_t queryPoolCount;
+    uint64_t frame;
+    bool presented;
+    bool haveOrigin;
+    uint64_t originTick;  // first timestamp read back, the start of the timeline
+};
+
+static std::unordered_map<void *, layer_data *> layer_data_map;
+
+template layer_data *GetLayerDataPtr<layer_data>(void *data_key, std::unordered_map<void *, layer_data *> &data_map);
+
+static void closeSocket(output_socket s) {
+#if defined(_WIN32)
+    closesocket(s);
+#else
+    close(s);
+#endif
+}
+
+// Connect to "host:port".
+// return:
+//      NO_SOCKET if the address can't be parsed or the connection fails.
+static output_socket connectOutput(const char *address) {
+    std::string host(address);
+    size_t colon = host.rfind(':');
+    if (colon == std::string::npos) return NO_SOCKET;
+    std::string port = host.substr(colon + 1);
+    host.resize(colon);
+
+#if defined(_WIN32)
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) return NO_SOCKET;
+#endif
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *addresses = NULL;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0) return NO_SOCKET;
+
+    output_socket s = NO_SOCKET;
+    for (addrinfo *ai = addresses; ai && s == NO_SOCKET; ai = ai->ai_next) {
+        s = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (s != NO_SOCKET && connect(s, ai->ai_addr, (int)ai->ai_addrlen) != 0) {
+            closeSocket(s);
+            s = NO_SOCKET;
+        }
+    }
+    freeaddrinfo(addresses);
+#if defined(SO_NOSIGPIPE)
+    // A reader that goes away must not kill the application
+    int one = 1;
+    if (s != NO_SOCKET) setsockopt(s, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    return s;
+}
+
+static void readSettings() {
+    settings.outputFile = NULL;
+    settings.outputSocket = NO_SOCKET;
+    const char *output = getLayerOption("lunarg_gpu_timing.output");
+    if (!strncmp(output, "tcp:", 4)) {
+        settings.outputSocket = connectOutput(output + 4);
+        if (settings.outputSocket == NO_SOCKET) fprintf(stderr, "lunarg_gpu_timing: Could not connect to %s.\n", output + 4);
+    } else if (output[0] != '\0') {
+        settings.outputFile = getLayerLogOutput(output, "lunarg_gpu_timing");
+    }
+
+    settings.format = strcmp(getLayerOption("lunarg_gpu_timing.format"), "JSON") ? TIMING_FORMAT_CSV : TIMING_FORMAT_JSON;
+    settings.renderPasses = strcmp(getLayerOption("lunarg_gpu_timing.render_passes"), "FALSE") != 0;
+
+    settings.maxQueryPools = 64;
+    unsigned count;
+    if (sscanf(getLayerOption("lunarg_gpu_timing.max_query_pools"), "%u", &count) == 1 && count > 0) settings.maxQueryPools = count;
+    settings.headerWritten = false;
+}
+
+static bool timingEnabled() { return settings.outputFile != NULL || settings.outputSocket != NO_SOCKET; }
+
+// Write lines of output; a socket whose reader has gone away stops the timing.
+static void writeOutput(const std::string &text) {
+    std::lock_guard<std::mutex> lock(outputLock);
+    if (settings.outputFile) {
+        fwrite(text.data(), 1, text.size(), settings.outputFile);
+        fflush(settings.outputFile);
+        return;
+    }
+    if (settings.outputSocket == NO_SOCKET) return;
+#if defined(MSG_NOSIGNAL)
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    size_t sent = 0;
+    while (sent < text.size()) {
+        int result = (int)send(settings.outputSocket, text.data() + sent, (int)(text.size() - sent), flags);
+        if (result <= 0) {
+            closeSocket(settings.outputSocket);
+            settings.outputSocket = NO_SOCKET;
+            return;
+        }
+        sent += result;
+    }
+}
+
+// Append name as a quoted CSV field or JSON string.
+static void appendQuoted(std::string *out, const std::string &name, TimingFormat format) {
+    out->push_back('"');
+    for (char c : name) {
+        if (c == '"') {
+            out->append(format == TIMING_FORMAT_CSV ? "\"\"" : "\\\"");
+        } else if (format == TIMING_FORMAT_JSON && c == '\\') {
+            out->append("\\\\");
+        } else if ((unsigned char)c < 0x20) {
+            out->push_back(' ');
+        } else {
+            out->push_back(c);
+        }
+    }
+    out->push_back('"');
+}
+
+// Take a query pool off the free list or create one.
+// return:
+//      VK_NULL_HANDLE once the device has max_query_pools of them in use.
+static VkQueryPool acquireQueryPool(layer_data *my_data) {
+    std::lock_guard<std::mutex> lock(*my_data->timingLock);
+    if (!my_data->freeQueryPools->empty()) {
+        VkQueryPool pool = my_data->freeQueryPools->back();
+        my_data->freeQueryPools->pop_back();
+        return pool;
+    }
+    if (my_data->queryPoolCount >= settings.maxQueryPools) return VK_NULL_HANDLE;
+
+    VkQueryPoolCreateInfo queryInfo = {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO, NULL, 0, VK_QUERY_TYPE_TIMESTAMP,
+                                       QUERIES_PER_POOL, 0};
+    VkQueryPool pool;
+    if (my_data->device_dispatch_table->CreateQueryPool(my_data->device, &queryInfo, NULL, &pool) != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+    my_data->queryPoolCount++;
+    return pool;
+}
+
+// Reserve the begin and end queries of a region, resetting a new pool if the
+// command buffer's current one is used up.
+// return:
+//      false if there is no pool to be had or it can't be reset here.
+static bool allocateQueries(layer_data *my_data, VkCommandBuffer commandBuffer, command_buffer_timing *timing, uint32_t *pPool,
+                            uint32_t *pQuery) {
+    if (timing->pools.empty() || timing->poolQueries.back() + 2 > QUERIES_PER_POOL) {
+        if (timing->inRenderPass) return false;
+        VkQueryPool pool = acquireQueryPool(my_data);
+        if (pool == VK_NULL_HANDLE) return false;
+        my_data->device_dispatch_table->CmdResetQueryPool(commandBuffer, pool, 0, QUERIES_PER_POOL);
+        timing->pools.push_back(pool);
+        timing->poolQueries.push_back(0);
+    }
+    *pPool = (uint32_t)timing->pools.size() - 1;
+    *pQuery = timing->poolQueries.back();
+    timing->poolQueries.back() += 2;
+    return true;
+}
+
+static void beginRegion(layer_data *my_data, VkCommandBuffer commandBuffer, command_buffer_timing *timing, const char *name) {
+    timed_region region;
+    if (!allocateQueries(my_data, commandBuffer, timing, &region.pool, &region.query)) {
+        // Keep the nesting so the matching end is still paired correctly
+        timing->open.push_back(NO_REGION);
+        return;
+    }
+    region.name = name ? name : "";
+    region.depth = (uint32_t)timing->open.size();
+    region.ended = false;
+    my_data->device_dispatch_table->CmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timing->pools[region.pool],
+                                                      region.query);
+    timing->open.push_back((uint32_t)timing->regions.size());
+    timing->regions.push_back(std::move(region));
+}
+
+static void endRegion(layer_data *my_data, VkCommandBuffer commandBuffer, command_buffer_timing *timing) {
+    if (timing->open.empty()) return;
+    uint32_t index = timing->open.back();
+    timing->open.pop_back();
+    if (index == NO_REGION) return;
+    timed_region &region = timing->regions[index];
+    my_data->device_dispatch_table->CmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                                      timing->pools[region.pool], region.query + 1);
+    region.ended = true;
+}
+
+// Write the times of a submitted command buffer's regions if the GPU is done
+// with them.  Called with timingLock held.
+// return:
+//      false if some are still to come.
+static bool resolveCommandBuffer(layer_data *my_data, command_buffer_timing *timing) {
+    VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
+    // Each query is followed by its availability
+    std::vector<std::vector<uint64_t>> results(timing->pools.size());
+    for (size_t i = 0; i < timing->pools.size(); i++) {
+        uint32_t count = timing->poolQueries[i];
+        results[i].assign(2 * count, 0);
+        VkResult result = pTable->GetQueryPoolResults(my_data->device, timing->pools[i], 0, count,
+                                                      results[i].size() * sizeof(uint64_t), results[i].data(), 2 * sizeof(uint64_t),
+                                                      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (result != VK_SUCCESS && result != VK_NOT_READY) return true;
+    }
+    for (const timed_region &region : timing->regions) {
+        if (!region.ended) continue;
+        const uint64_t *begin = &results[region.pool][2 * region.query];
+        if (!begin[1] || !begin[3]) return false;
+    }
+
+    uint64_t validMask = (*my_data->familyValidMasks)[my_data->poolFamilies->at(timing->commandPool)];
+    std::string text;
+    char number[96];
+    for (const timed_region &region : timing->regions) {
+        if (!region.ended) continue;
+        const uint64_t *begin = &results[region.pool][2 * region.query];
+        if (!my_data->haveOrigin) {
+            my_data->haveOrigin = true;
+            my_data->originTick = begin[0];
+        }
+        double startMs = ((begin[0] - my_data->originTick) & validMask) * my_data->nsPerTick / 1000000.0;
+        double gpuMs = ((begin[2] - begin[0]) & validMask) * my_data->nsPerTick / 1000000.0;
+        if (settings.format == TIMING_FORMAT_JSON) {
+            snprintf(number, sizeof(number), "{\"device\": \"%p\", \"frame\": %llu, \"depth\": %u, \"region\": ",
+                     (void *)my_data->device, (unsigned long long)timing->frame, region.depth);
+            text.append(number);
+            appendQuoted(&text, region.name, TIMING_FORMAT_JSON);
+            snprintf(number, sizeof(number), ", \"start_ms\": %.6f, \"gpu_ms\": %.6f}\n", startMs, gpuMs);
+        } else {
+            snprintf(number, sizeof(number), "%p,%llu,%u,", (void *)my_data->device, (unsigned long long)timing->frame,
+                     region.depth);
+            text.append(number);
+            appendQuoted(&text, region.name, TIMING_FORMAT_CSV);
+            snprintf(number, sizeof(number), ",%.6f,%.6f\n", startMs, gpuMs);
+        }
+        text.append(number);
+    }
+    if (settings.format == TIMING_FORMAT_CSV && !text.empty()) {
+        std::lock_guard<std::mutex> lock(outputLock);
+        if (!settings.headerWritten) {
+            text.insert(0, "device,frame,depth,region,start_ms,gpu_ms\n");
+            settings.headerWritten = true;
+        }
+    }
+    if (!text.empty()) writeOutput(text);
+    return true;
+}
+
+// Read back the regions of all submitted command buffers the GPU is done with.
+// Called with timingLock held.
+static void resolvePending(layer_data *my_data) {
+    std::vector<command_buffer_timing *> &pending = *my_data->pending;
+    size_t kept = 0;
+    for (size_t i = 0; i < pending.size(); i++) {
+        if (resolveCommandBuffer(my_data, pending[i])) {
+            pending[i]->pending = false;
+        } else {
+            pending[kept++] = pending[i];
+        }
+    }
+    pending.resize(kept);
+}
+
+// Forget the regions of a command buffer that is reset, re-recorded or freed,
+// writing those of its last submit first.  The GPU is done with it by then.
+// Called with timingLock held.
+static void resetCommandBufferTiming(layer_data *my_data, command_buffer_timing *timing) {
+    if (timing->pending) {
+        resolveCommandBuffer(my_data, timing);
+        timing->pending = false;
+        auto &pending = *my_data->pending;
+        pending.erase(std::remove(pending.begin(), pending.end(), timing), pending.end());
+    }
+    my_data->freeQueryPools->insert(my_data->freeQueryPools->end(), timing->pools.begin(), timing->pools.end());
+    timing->pools.clear();
+    timing->poolQueries.clear();
+    timing->regions.clear();
+    timing->open.clear();
+    timing->inRenderPass = false;
+    timing->renderPassRegion = NO_REGION;
+}
+
+// return:
+//      NULL if the command buffer is not timed.
+static command_buffer_timing *getTiming(layer_data *my_data, VkCommandBuffer commandBuffer) {
+    if (!timingEnabled()) return NULL;
+    std::lock_guard<std::mutex> lock(*my_data->timingLock);
+    auto it = my_data->commandBuffers->find(commandBuffer);
+    if (it == my_data->commandBuffers->end() || !it->second->timed) return NULL;
+    return it->second;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(VkPhysicalDevice gpu, const VkDeviceCreateInfo *pCreateInfo,
+                                                              const VkAllocationCallbacks *pAllocator, VkDevice *pDevice) {
+    VkLayerDeviceCreateInfo *chain_info = get_chain_info(pCreateInfo, VK_LAYER_LINK_INFO);
+
+    assert(chain_info->u.pLayerInfo);
+    PFN_vkGetInstanceProcAddr fpGetInstanceProcAddr = chain_info->u.pLayerInfo->pfnNextGetInstanceProcAddr;
+    PFN_vkGetDeviceProcAddr fpGetDeviceProcAddr = chain_info->u.pLayerInfo->pfnNextGetDeviceProcAddr;
+    PFN_vkCreateDevice fpCreateDevice = (PFN_vkCreateDevice)fpGetInstanceProcAddr(NULL, "vkCreateDevice");
+    if (fpCreateDevice == NULL) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    // Advance the link info for the next element on the chain
+    chain_info->u.pLayerInfo = chain_info->u.pLayerInfo->pNext;
+
+    VkResult result = fpCreateDevice(gpu, pCreateInfo, pAllocator, pDevice);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    layer_data *my_device_data = GetLayerDataPtr(get_dispatch_key(*pDevice), layer_data_map);
+
+    // Setup device dispatch table
+    my_device_data->device_dispatch_table = new VkLayerDispatchTable;
+    layer_init_device_dispatch_table(*pDevice, my_device_data->device_dispatch_table, fpGetDeviceProcAddr);
+
+    my_device_data->gpu = gpu;
+    my_device_data->device = *pDevice;
+
+    std::call_once(settingsOnce, readSettings);
+    my_device_data->timingLock = new std::mutex;
+    my_device_data->poolFamilies = new std::unordered_map<VkCommandPool, uint32_t>;
+    my_device_data->commandBuffers = new std::unordered_map<VkCommandBuffer, command_buffer_timing *>;
+    my_device_data->objectNames = new std::unordered_map<uint64_t, std::string>;
+    my_device_data->pending = new std::vector<command_buffer_timing *>;
+    my_device_data->freeQueryPools = new std::vector<VkQueryPool>;
+    my_device_data->queryPoolCount = 0;
+    my_device_data->frame = 0;
+    my_device_data->presented = false;
+    my_device_data->haveOrigin = false;
+    my_device_data->originTick = 0;
+
+    layer_data *my_instance_data = GetLayerDataPtr(get_dispatch_key(gpu), layer_data_map);
+    VkLayerInstanceDispatchTable *pInstanceTable = my_instance_data->instance_dispatch_table;
+    uint32_t familyCount = 0;
+    pInstanceTable->GetPhysicalDeviceQueueFamilyProperties(gpu, &familyCount, NULL);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    pInstanceTable->GetPhysicalDeviceQueueFamilyProperties(gpu, &familyCount, families.data());
+    my_device_data->familyValidMasks = new std::vector<uint64_t>(familyCount);
+    for (uint32_t i = 0; i < familyCount; i++) {
+        uint32_t validBits = families[i].timestampValidBits;
+        (*my_device_data->familyValidMasks)[i] = validBits >= 64 ? ~0ULL : (1ULL << validBits) - 1;
+    }
+    VkPhysicalDeviceProperties properties;
+    pInstanceTable->GetPhysicalDeviceProperties(gpu, &properties);
+    my_device_data->nsPerTick = properties.limits.timestampPeriod;
+
+    return result;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroyDevice(VkDevice device, const VkAllocationCallbacks *pAllocator) {
+    dispatch_key key = get_dispatch_key(device);
+    layer_data *my_data = GetLayerDataPtr(key, layer_data_map);
+    VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
+    pTable->DeviceWaitIdle(device);
+    {
+        std::lock_guard<std::mutex> lock(*my_data->timingLock);
+        for (auto &entry : *my_data->commandBuffers) {
+            resetCommandBufferTiming(my_data, entry.second);
+            delete entry.second;
+        }
+        for (VkQueryPool pool : *my_data->freeQueryPools) pTable->DestroyQueryPool(device, pool, NULL);
+    }
+    delete my_data->freeQueryPools;
+    delete my_data->pending;
+    delete my_data->objectNames;
+    delete my_data->commandBuffers;
+    delete my_data->poolFamilies;
+    delete my_data->familyValidMasks;
+    delete my_data->timingLock;
+    pTable->DestroyDevice(device, pAllocator);
+    delete pTable;
+    FreeLayerDataPtr(key, layer_data_map);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(const VkInstanceCreateInfo *pCreateInfo,
+                                                                const VkAllocationCallbacks *pAllocator, VkInstance *pInstance) {
+    VkLayerInstanceCreateInfo *chain_info = get_chain_info(pCreateInfo, VK_LAYER_LINK_INFO);
+
+    assert(chain_info->u.pLayerInfo);
+    PFN_vkGetInstanceProcAddr fpGetInstanceProcAddr = chain_info->u.pLayerInfo->pfnNextGetInstanceProcAddr;
+    PFN_vkCreateInstance fpCreateInstance = (PFN_vkCreateInstance)fpGetInstanceProcAddr(NULL, "vkCreateInstance");
+    if (fpCreateInstance == NULL) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    // Advance the link info for the next element on the chain
+    chain_info->u.pLayerInfo = chain_info->u.pLayerInfo->pNext;
+
+    VkResult result = fpCreateInstance(pCreateInfo, pAllocator, pInstance);
+    if (result != VK_SUCCESS) return result;
+
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(*pInstance), layer_data_map);
+    my_data->instance_dispatch_table = new VkLayerInstanceDispatchTable;
+    layer_init_instance_dispatch_table(*pInstance, my_data->instance_dispatch_table, fpGetInstanceProcAddr);
+
+    return result;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroyInstance(VkInstance instance, const VkAllocationCallbacks *pAllocator) {
+    dispatch_key key = get_dispatch_key(instance);
+    layer_data *my_data = GetLayerDataPtr(key, layer_data_map);
+    VkLayerInstanceDispatchTable *pTable = my_data->instance_dispatch_table;
+    pTable->DestroyInstance(instance, pAllocator);
+    delete pTable;
+    FreeLayerDataPtr(key, layer_data_map);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateCommandPool(VkDevice device, const VkCommandPoolCreateInfo *pCreateInfo,
+                                                                   const VkAllocationCallbacks *pAllocator,
+                                                                   VkCommandPool *pCommandPool) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    VkResult result = my_data->device_dispatch_table->CreateCommandPool(device, pCreateInfo, pAllocator, pCommandPool);
+    if (result == VK_SUCCESS) {
+        std::lock_guard<std::mutex> lock(*my_data->timingLock);
+        (*my_data->poolFamilies)[*pCommandPool] = pCreateInfo->queueFamilyIndex;
+    }
+    return result;
+}
+
+// Forget the command buffers of a pool that is reset or destroyed.  Called
+// with timingLock held.
+static void resetPoolTiming(layer_data *my_data, VkCommandPool commandPool, bool destroyed) {
+    auto &commandBuffers = *my_data->commandBuffers;
+    for (auto it = commandBuffers.begin(); it != commandBuffers.end();) {
+        if (it->second->commandPool != commandPool) {
+            ++it;
+            continue;
+        }
+        resetCommandBufferTiming(my_data, it->second);
+        if (destroyed) {
+            delete it->second;
+            it = commandBuffers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroyCommandPool(VkDevice device, VkCommandPool commandPool,
+                                                                const VkAllocationCallbacks *pAllocator) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    {
+        std::lock_guard<std::mutex> lock(*my_data->timingLock);
+        resetPoolTiming(my_data, commandPool, true);
+        my_data->poolFamilies->erase(commandPool);
+    }
+    my_data->device_dispatch_table->DestroyCommandPool(device, commandPool, pAllocator);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkResetCommandPool(VkDevice device, VkCommandPool commandPool,
+                                                                  VkCommandPoolResetFlags flags) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    {
+        std::lock_guard<std::mutex> lock(*my_data->timingLock);
+        resetPoolTiming(my_data, commandPool, false);
+    }
+    return my_data->device_dispatch_table->ResetCommandPool(device, commandPool, flags);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkAllocateCommandBuffers(VkDevice device,
+                                                                        const VkCommandBufferAllocateInfo *pAllocateInfo,
+                                                                        VkCommandBuffer *pCommandBuffers) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    VkResult result = my_data->device_dispatch_table->AllocateCommandBuffers(device, pAllocateInfo, pCommandBuffers);
+    if (result != VK_SUCCESS || !timingEnabled()) return result;
+
+    std::lock_guard<std::mutex> lock(*my_data->timingLock);
+    auto family = my_data->poolFamilies->find(pAllocateInfo->commandPool);
+    bool timed = pAllocateInfo->level == VK_COMMAND_BUFFER_LEVEL_PRIMARY && family != my_data->poolFamilies->end() &&
+                 family->second < my_data->familyValidMasks->size() && (*my_data->familyValidMasks)[family->second] != 0;
+    for (uint32_t i = 0; i < pAllocateInfo->commandBufferCount; i++) {
+        command_buffer_timing *timing = new command_buffer_timing();
+        timing->commandPool = pAllocateInfo->commandPool;
+        timing->timed = timed;
+        timing->inRenderPass = false;
+        timing->renderPassRegion = NO_REGION;
+        timing->pending = false;
+        timing->frame = 0;
+        (*my_data->commandBuffers)[pCommandBuffers[i]] = timing;
+    }
+    return result;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkFreeCommandBuffers(VkDevice device, VkCommandPool commandPool,
+                                                                uint32_t commandBufferCount,
+                                                                const VkCommandBuffer *pCommandBuffers) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    {
+        std::lock_guard<std::mutex> lock(*my_data->timingLock);
+        for (uint32_t i = 0; i < commandBufferCount; i++) {
+            auto it = my_data->commandBuffers->find(pCommandBuffers[i]);
+            if (it == my_data->commandBuffers->end()) continue;
+            resetCommandBufferTiming(my_data, it->second);
+            delete it->second;
+            my_data->commandBuffers->erase(it);
+        }
+    }
+    my_data->device_dispatch_table->FreeCommandBuffers(device, commandPool, commandBufferCount, pCommandBuffers);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkBeginCommandBuffer(VkCommandBuffer commandBuffer,
+                                                                    const VkCommandBufferBeginInfo *pBeginInfo) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
+    command_buffer_timing *timing = getTiming(my_data, commandBuffer);
+    if (timing) {
+        std::lock_guard<std::mutex> lock(*my_data->timingLock);
+        resetCommandBufferTiming(my_data, timing);
+    }
+    return my_data->device_dispatch_table->BeginCommandBuffer(commandBuffer, pBeginInfo);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkEndCommandBuffer(VkCommandBuffer commandBuffer) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
+    command_buffer_timing *timing = getTiming(my_data, commandBuffer);
+    if (timing) {
+        // Markers left open end with the command buffer
+        while (!timing->open.empty()) endRegion(my_data, commandBuffer, timing);
+    }
+    return my_data->device_dispatch_table->EndCommandBuffer(commandBuffer);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkResetCommandBuffer(VkCommandBuffer commandBuffer,
+                                                                    VkCommandBufferResetFlags flags) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
+    command_buffer_timing *timing = getTiming(my_data, commandBuffer);
+    if (timing) {
+        std::lock_guard<std::mutex> lock(*my_data->timingLock);
+        resetCommandBufferTiming(my_data, timing);
+    }
+    return my_data->device_dispatch_table->ResetCommandBuffer(commandBuffer, flags);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkCmdDebugMarkerBeginEXT(VkCommandBuffer commandBuffer,
+                                                                    const VkDebugMarkerMarkerInfoEXT *pMarkerInfo) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
+    command_buffer_timing *timing = getTiming(my_data, commandBuffer);
+    if (timing) beginRegion(my_data, commandBuffer, timing, pMarkerInfo->pMarkerName);
+    my_data->device_dispatch_table->CmdDebugMarkerBeginEXT(commandBuffer, pMarkerInfo);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkCmdDebugMarkerEndEXT(VkCommandBuffer commandBuffer) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
+    my_data->device_dispatch_table->CmdDebugMarkerEndEXT(commandBuffer);
+    command_buffer_timing *timing = getTiming(my_data, commandBuffer);
+    // The render pass region closes at vkCmdEndRenderPass, not at a marker end
+    if (timing && (timing->open.empty() || timing->open.back() != timing->renderPassRegion)) {
+        endRegion(my_data, commandBuffer, timing);
+    }
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkDebugMarkerSetObjectNameEXT(VkDevice device,
+                                                                             const VkDebugMarkerObjectNameInfoEXT *pNameInfo) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    if (timingEnabled() && (pNameInfo->objectType == VK_DEBUG_REPORT_OBJECT_TYPE_RENDER_PASS_EXT ||
+                            pNameInfo->objectType == VK_DEBUG_REPORT_OBJECT_TYPE_FRAMEBUFFER_EXT)) {
+        std::lock_guard<std::mutex> lock(*my_data->timingLock);
+        (*my_data->objectNames)[pNameInfo->object] = pNameInfo->pObjectName ? pNameInfo->pObjectName : "";
+    }
+    return my_data->device_dispatch_table->DebugMarkerSetObjectNameEXT(device, pNameInfo);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkCmdBeginRenderPass(VkCommandBuffer commandBuffer,
+                                                                const VkRenderPassBeginInfo *pRenderPassBegin,
+                                                                VkSubpassContents contents) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
+    command_buffer_timing *timing = getTiming(my_data, commandBuffer);
+    if (timing && settings.renderPasses) {
+        // Render passes are named after their framebuffer or render pass if the application named either
+        std::string name;
+        {
+            std::lock_guard<std::mutex> lock(*my_data->timingLock);
+            auto &names = *my_data->objectNames;
+            auto it = names.find((uint64_t)pRenderPassBegin->framebuffer);
+            if (it == names.end()) it = names.find((uint64_t)pRenderPassBegin->renderPass);
+            if (it != names.end()) name = it->second;
+        }
+        if (name.empty()) {
+            char handle[48];
+            snprintf(handle, sizeof(handle), "vkCmdBeginRenderPass 0x%llx", (unsigned long long)pRenderPassBegin->renderPass);
+            name = handle;
+        }
+        beginRegion(my_data, commandBuffer, timing, name.c_str());
+        timing->renderPassRegion = timing->open.back();
+    }
+    if (timing) timing->inRenderPass = true;
+    my_data->device_dispatch_table->CmdBeginRenderPass(commandBuffer, pRenderPassBegin, contents);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkCmdEndRenderPass(VkCommandBuffer commandBuffer) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(commandBuffer), layer_data_map);
+    my_data->device_dispatch_table->CmdEndRenderPass(commandBuffer);
+    command_buffer_timing *timing = getTiming(my_data, commandBuffer);
+    if (!timing) return;
+    timing->inRenderPass = false;
+    if (settings.renderPasses) {
+        // Markers begun inside the render pass and not ended yet end with it
+        while (!timing->open.empty()) {
+            bool renderPass = timing->open.back() == timing->renderPassRegion;
+            endRegion(my_data, commandBuffer, timing);
+            if (renderPass) break;
+        }
+        timing->renderPassRegion = NO_REGION;
+    }
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo *pSubmits,
+                                                             VkFence fence) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(queue), layer_data_map);
+    VkResult result = my_data->device_dispatch_table->QueueSubmit(queue, submitCount, pSubmits, fence);
+    if (result != VK_SUCCESS || !timingEnabled()) return result;
+
+    std::lock_guard<std::mutex> lock(*my_data->timingLock);
+    for (uint32_t i = 0; i < submitCount; i++) {
+        for (uint32_t j = 0; j < pSubmits[i].commandBufferCount; j++) {
+            auto it = my_data->commandBuffers->find(pSubmits[i].pCommandBuffers[j]);
+            if (it == my_data->commandBuffers->end() || it->second->regions.empty()) continue;
+            // A command buffer submitted again before its results were read is read once, for its last submit
+            command_buffer_timing *timing = it->second;
+            if (!timing->pending) my_data->pending->push_back(timing);
+            timing->pending = true;
+            timing->frame = my_data->frame;
+        }
+    }
+    // Applications that never present are read back as they submit
+    if (!my_data->presented) resolvePending(my_data);
+    return result;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(queue), layer_data_map);
+    if (timingEnabled()) {
+        std::lock_guard<std::mutex> lock(*my_data->timingLock);
+        resolvePending(my_data);
+        my_data->presented = true;
+        my_data->frame++;
+    }
+    return my_data->device_dispatch_table->QueuePresentKHR(queue, pPresentInfo);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(VkDevice dev, const char *funcName) {
+#define ADD_HOOK(fn) \
+    if (!strncmp(#fn, funcName, sizeof(#fn))) return (PFN_vkVoidFunction)fn
+
+    ADD_HOOK(vkGetDeviceProcAddr);
+    ADD_HOOK(vkDestroyDevice);
+    ADD_HOOK(vkCreateCommandPool);
+    ADD_HOOK(vkDestroyCommandPool);
+    ADD_HOOK(vkResetCommandPool);
+    ADD_HOOK(vkAllocateCommandBuffers);
+    ADD_HOOK(vkFreeCommandBuffers);
+    ADD_HOOK(vkBeginCommandBuffer);
+    ADD_HOOK(vkEndCommandBuffer);
+    ADD_HOOK(vkResetCommandBuffer);
+    ADD_HOOK(vkCmdBeginRenderPass);
+    ADD_HOOK(vkCmdEndRenderPass);
+    ADD_HOOK(vkQueueSubmit);
+    ADD_HOOK(vkQueuePresentKHR);
+#undef ADD_HOOK
+
+    if (dev == NULL) return NULL;
+
+    layer_data *dev_data;
+    dev_data = GetLayerDataPtr(get_dispatch_key(dev), layer_data_map);
+    VkLayerDispatchTable *pTable = dev_data->device_dispatch_table;
+
+    // The debug marker commands are only there if the application enabled VK_EXT_debug_marker
+#define ADD_EXTENSION_HOOK(fn) \
+    if (!strncmp("vk" #fn, funcName, sizeof("vk" #fn))) return pTable->fn ? (PFN_vkVoidFunction)vk##fn : NULL
+
+    ADD_EXTENSION_HOOK(CmdDebugMarkerBeginEXT);
+    ADD_EXTENSION_HOOK(CmdDebugMarkerEndEXT);
+    ADD_EXTENSION_HOOK(DebugMarkerSetObjectNameEXT);
+#undef ADD_EXTENSION_HOOK
+
+    if (pTable->GetDeviceProcAddr == NULL) return NULL;
+    return pTable->GetDeviceProcAddr(dev, funcName);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr(VkInstance instance, const char *funcName) {
+#define ADD_HOOK(fn) \
+    if (!strncmp(#fn, funcName, sizeof(#fn))) return (PFN_vkVoidFunction)fn
+
+    ADD_HOOK(vkCreateInstance);
+    ADD_HOOK(vkCreateDevice);
+    ADD_HOOK(vkDestroyInstance);
+    ADD_HOOK(vkGetInstanceProcAddr);
+#undef ADD_HOOK
+
+    if (instance == NULL) return NULL;
+
+    layer_data *instance_data;
+    instance_data = GetLayerDataPtr(get_dispatch_key(instance), layer_data_map);
+    VkLayerInstanceDispatchTable *pTable = instance_data->instance_dispatch_table;
+
+    if (pTable->GetInstanceProcAddr == NULL) return NULL;
+    return pTable->GetInstanceProcAddr(instance, funcName);
+}
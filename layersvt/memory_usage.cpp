@@ -0,0 +1,504 @@
+/*
+ * Vulkan
+ *
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "vk_layer_config.h"
+#include "vk_layer_data.h"
+#include "vk_layer_extension_utils.h"
+#include "vk_layer_table.h"
+#include <assert.h>
+#include <atomic>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vk_dispatch_table_helper.h>
+#include <vk_loader_platform.h>
+#include <vulkan/vk_layer.h>
+#include <vulkan/vulkan.h>
+
+// Counts the device memory an application has allocated, bound to buffers
+// and images, and mapped, for each memory type, and writes the counters of
+// each memory heap to lunarg_memory_usage.output once per frame.  Memory that
+// is allocated but not bound is the space lost inside allocations, to
+// suballocators' free lists or alignment.
+//
+// The counters are atomics that are updated as the application allocates and
+// binds, so writing them at present time never waits on the application's
+// other threads.  The maps from handles to sizes, which the updates need, are
+// guarded by the device's usageLock.
+
+enum UsageFormat { USAGE_FORMAT_CSV, USAGE_FORMAT_JSON };
+
+// Settings from vk_layer_settings.txt, read when the first device is created.
+struct memory_usage_settings {
+    FILE *outputFile;  // NULL when nothing is written
+    UsageFormat format;
+    uint32_t frameInterval;
+    bool memoryTypes;
+    bool headerWritten;
+};
+
+static memory_usage_settings settings;
+static std::once_flag settingsOnce;
+static std::mutex outputLock;
+
+struct memory_type_counters {
+    std::atomic<uint64_t> allocated;
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> bound;
+    std::atomic<uint64_t> mapped;
+    std::atomic<uint64_t> peakAllocated;
+};
+
+struct allocation_usage {
+    uint32_t memoryType;
+    VkDeviceSize size;
+    VkDeviceSize bound;
+    VkDeviceSize mapped;
+};
+
+struct binding_usage {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+};
+
+struct layer_data {
+    VkLayerDispatchTable *device_dispatch_table;
+    VkLayerInstanceDispatchTable *instance_dispatch_table;
+
+    VkPhysicalDevice gpu;
+    VkDevice device;
+
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    memory_type_counters *counters;  // one per memory type
+    std::atomic<uint64_t> frame;
+
+    // Guards the maps below
+    std::mutex *usageLock;
+    std::unordered_map<VkDeviceMemory, allocation_usage> *allocations;
+    std::unordered_map<uint64_t, binding_usage> *bindings;  // buffers and images
+};
+
+static std::unordered_map<void *, layer_data *> layer_data_map;
+
+template layer_data *GetLayerDataPtr<layer_data>(void *data_key, std::unordered_map<void *, layer_data *> &data_map);
+
+static void readSettings() {
+    settings.outputFile = NULL;
+    const char *output = getLayerOption("lunarg_memory_usage.output");
+    if (output[0] != '\0') settings.outputFile = getLayerLogOutput(output, "lunarg_memory_usage");
+
+    settings.format = strcmp(getLayerOption("lunarg_memory_usage.format"), "JSON") ? USAGE_FORMAT_CSV : USAGE_FORMAT_JSON;
+    settings.memoryTypes = !strcmp(getLayerOption("lunarg_memory_usage.memory_types"), "TRUE");
+
+    settings.frameInterval = 1;
+    unsigned interval;
+    if (sscanf(getLayerOption("lunarg_memory_usage.frame_interval"), "%u", &interval) == 1 && interval > 0) {
+        settings.frameInterval = interval;
+    }
+    settings.headerWritten = false;
+}
+
+static void addAllocated(memory_type_counters *counters, VkDeviceSize size) {
+    uint64_t allocated = counters->allocated.fetch_add(size) + size;
+    counters->allocations++;
+    uint64_t peak = counters->peakAllocated.load();
+    while (allocated > peak && !counters->peakAllocated.compare_exchange_weak(peak, allocated)) {
+    }
+}
+
+// Count size bytes of memory as bound to a buffer or image.
+static void recordBinding(layer_data *my_data, uint64_t object, VkDeviceMemory memory, VkDeviceSize size) {
+    std::lock_guard<std::mutex> lock(*my_data->usageLock);
+    auto allocation = my_data->allocations->find(memory);
+    if (allocation == my_data->allocations->end()) return;
+    // A resource can't be bound twice, but be robust against invalid usage
+    auto previous = my_data->bindings->find(object);
+    if (previous != my_data->bindings->end()) return;
+    allocation->second.bound += size;
+    my_data->counters[allocation->second.memoryType].bound += size;
+    (*my_data->bindings)[object] = {memory, size};
+}
+
+static void releaseBinding(layer_data *my_data, uint64_t object) {
+    std::lock_guard<std::mutex> lock(*my_data->usageLock);
+    auto binding = my_data->bindings->find(object);
+    if (binding == my_data->bindings->end()) return;
+    auto allocation = my_data->allocations->find(binding->second.memory);
+    // Memory freed before the resources bound to it can have its handle reused by a new allocation
+    if (allocation != my_data->allocations->end() && allocation->second.bound >= binding->second.size) {
+        allocation->second.bound -= binding->second.size;
+        my_data->counters[allocation->second.memoryType].bound -= binding->second.size;
+    }
+    my_data->bindings->erase(binding);
+}
+
+// Append one record of the time series.  heap is the heap's index, type the
+// memory type's or -1 for the totals of the heap.
+static void appendRecord(std::string *text, layer_data *my_data, uint64_t frame, uint32_t heap, int type, uint64_t allocated,
+                         uint64_t allocations, uint64_t bound, uint64_t mapped, uint64_t peak) {
+    char line[384];
+    unsigned long long heapSize = my_data->memoryProperties.memoryHeaps[heap].size;
+    // The counters are read apart, a binding counted without its allocation must not wrap around
+    unsigned long long unbound = allocated > bound ? allocated - bound : 0;
+    if (settings.format == USAGE_FORMAT_JSON) {
+        snprintf(line, sizeof(line),
+                 "{\"device\": \"%p\", \"frame\": %llu, \"heap\": %u, \"memory_type\": %d, \"heap_size\": %llu, "
+                 "\"allocated\": %llu, \"allocations\": %llu, \"bound\": %llu, \"unbound\": %llu, \"mapped\": %llu, "
+                 "\"peak_allocated\": %llu}\n",
+                 (void *)my_data->device, (unsigned long long)frame, heap, type, heapSize, (unsigned long long)allocated,
+                 (unsigned long long)allocations, (unsigned long long)bound, unbound, (unsigned long long)mapped,
+                 (unsigned long long)peak);
+    } else {
+        snprintf(line, sizeof(line), "%p,%llu,%u,%d,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n", (void *)my_data->device,
+                 (unsigned long long)frame, heap, type, heapSize, (unsigned long long)allocated, (unsigned long long)allocations,
+                 (unsigned long long)bound, unbound, (unsigned long long)mapped, (unsigned long long)peak);
+    }
+    text->append(line);
+}
+
+// Write the counters of every heap that has memory allocated from it, and of
+// its memory types if memory_types is set.  The counters are read one at a
+// time while other threads may update them, so a record can be off by the
+// allocations made while it was written.
+static void writeFrame(layer_data *my_data, uint64_t frame) {
+    const VkPhysicalDeviceMemoryProperties &properties = my_data->memoryProperties;
+    std::string text;
+    for (uint32_t heap = 0; heap < properties.memoryHeapCount; heap++) {
+        uint64_t allocated = 0, allocations = 0, bound = 0, mapped = 0, peak = 0;
+        std::string types;
+        for (uint32_t type = 0; type < properties.memoryTypeCount; type++) {
+            if (properties.memoryTypes[type].heapIndex != heap) continue;
+            memory_type_counters &counters = my_data->counters[type];
+            uint64_t typeAllocated = counters.allocated.load(std::memory_order_relaxed);
+            uint64_t typeAllocations = counters.allocations.load(std::memory_order_relaxed);
+            uint64_t typeBound = counters.bound.load(std::memory_order_relaxed);
+            uint64_t typeMapped = counters.mapped.load(std::memory_order_relaxed);
+            uint64_t typePeak = counters.peakAllocated.load(std::memory_order_relaxed);
+            if (typePeak == 0) continue;
+            allocated += typeAllocated;
+            allocations += typeAllocations;
+            bound += typeBound;
+            mapped += typeMapped;
+            // The peaks of the types need not coincide, their sum is an upper bound of the heap's
+            peak += typePeak;
+            if (settings.memoryTypes) {
+                appendRecord(&types, my_data, frame, heap, (int)type, typeAllocated, typeAllocations, typeBound, typeMapped,
+                             typePeak);
+            }
+        }
+        if (peak == 0) continue;
+        appendRecord(&text, my_data, frame, heap, -1, allocated, allocations, bound, mapped, peak);
+        text.append(types);
+    }
+    if (text.empty()) return;
+
+    std::lock_guard<std::mutex> lock(outputLock);
+    if (settings.format == USAGE_FORMAT_CSV && !settings.headerWritten) {
+        fprintf(settings.outputFile,
+                "device,frame,heap,memory_type,heap_size,allocated,allocations,bound,unbound,mapped,peak_allocated\n");
+        settings.headerWritten = true;
+    }
+    fwrite(text.data(), 1, text.size(), settings.outputFile);
+    fflush(settings.outputFile);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(VkPhysicalDevice gpu, const VkDeviceCreateInfo *pCreateInfo,
+                                                              const VkAllocationCallbacks *pAllocator, VkDevice *pDevice) {
+    VkLayerDeviceCreateInfo *chain_info = get_chain_info(pCreateInfo, VK_LAYER_LINK_INFO);
+
+    assert(chain_info->u.pLayerInfo);
+    PFN_vkGetInstanceProcAddr fpGetInstanceProcAddr = chain_info->u.pLayerInfo->pfnNextGetInstanceProcAddr;
+    PFN_vkGetDeviceProcAddr fpGetDeviceProcAddr = chain_info->u.pLayerInfo->pfnNextGetDeviceProcAddr;
+    PFN_vkCreateDevice fpCreateDevice = (PFN_vkCreateDevice)fpGetInstanceProcAddr(NULL, "vkCreateDevice");
+    if (fpCreateDevice == NULL) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    // Advance the link info for the next element on the chain
+    chain_info->u.pLayerInfo = chain_info->u.pLayerInfo->pNext;
+
+    VkResult result = fpCreateDevice(gpu, pCreateInfo, pAllocator, pDevice);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    layer_data *my_device_data = GetLayerDataPtr(get_dispatch_key(*pDevice), layer_data_map);
+
+    // Setup device dispatch table
+    my_device_data->device_dispatch_table = new VkLayerDispatchTable;
+    layer_init_device_dispatch_table(*pDevice, my_device_data->device_dispatch_table, fpGetDeviceProcAddr);
+
+    my_device_data->gpu = gpu;
+    my_device_data->device = *pDevice;
+
+    std::call_once(settingsOnce, readSettings);
+    layer_data *my_instance_data = GetLayerDataPtr(get_dispatch_key(gpu), layer_data_map);
+    my_instance_data->instance_dispatch_table->GetPhysicalDeviceMemoryProperties(gpu, &my_device_data->memoryProperties);
+    my_device_data->counters = new memory_type_counters[VK_MAX_MEMORY_TYPES]();
+    my_device_data->frame = 0;
+    my_device_data->usageLock = new std::mutex;
+    my_device_data->allocations = new std::unordered_map<VkDeviceMemory, allocation_usage>;
+    my_device_data->bindings = new std::unordered_map<uint64_t, binding_usage>;
+
+    return result;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroyDevice(VkDevice device, const VkAllocationCallbacks *pAllocator) {
+    dispatch_key key = get_dispatch_key(device);
+    layer_data *my_data = GetLayerDataPtr(key, layer_data_map);
+    // Applications that never present still get a record of what they used
+    if (settings.outputFile && my_data->frame == 0) writeFrame(my_data, 0);
+    delete my_data->bindings;
+    delete my_data->allocations;
+    delete my_data->usageLock;
+    delete[] my_data->counters;
+    VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
+    pTable->DestroyDevice(device, pAllocator);
+    delete pTable;
+    FreeLayerDataPtr(key, layer_data_map);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(const VkInstanceCreateInfo *pCreateInfo,
+                                                                const VkAllocationCallbacks *pAllocator, VkInstance *pInstance) {
+    VkLayerInstanceCreateInfo *chain_info = get_chain_info(pCreateInfo, VK_LAYER_LINK_INFO);
+
+    assert(chain_info->u.pLayerInfo);
+    PFN_vkGetInstanceProcAddr fpGetInstanceProcAddr = chain_info->u.pLayerInfo->pfnNextGetInstanceProcAddr;
+    PFN_vkCreateInstance fpCreateInstance = (PFN_vkCreateInstance)fpGetInstanceProcAddr(NULL, "vkCreateInstance");
+    if (fpCreateInstance == NULL) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    // Advance the link info for the next element on the chain
+    chain_info->u.pLayerInfo = chain_info->u.pLayerInfo->pNext;
+
+    VkResult result = fpCreateInstance(pCreateInfo, pAllocator, pInstance);
+    if (result != VK_SUCCESS) return result;
+
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(*pInstance), layer_data_map);
+    my_data->instance_dispatch_table = new VkLayerInstanceDispatchTable;
+    layer_init_instance_dispatch_table(*pInstance, my_data->instance_dispatch_table, fpGetInstanceProcAddr);
+
+    return result;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroyInstance(VkInstance instance, const VkAllocationCallbacks *pAllocator) {
+    dispatch_key key = get_dispatch_key(instance);
+    layer_data *my_data = GetLayerDataPtr(key, layer_data_map);
+    VkLayerInstanceDispatchTable *pTable = my_data->instance_dispatch_table;
+    pTable->DestroyInstance(instance, pAllocator);
+    delete pTable;
+    FreeLayerDataPtr(key, layer_data_map);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory(VkDevice device, const VkMemoryAllocateInfo *pAllocateInfo,
+                                                                const VkAllocationCallbacks *pAllocator, VkDeviceMemory *pMemory) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    VkResult result = my_data->device_dispatch_table->AllocateMemory(device, pAllocateInfo, pAllocator, pMemory);
+    if (result != VK_SUCCESS || pAllocateInfo->memoryTypeIndex >= VK_MAX_MEMORY_TYPES) return result;
+
+    addAllocated(&my_data->counters[pAllocateInfo->memoryTypeIndex], pAllocateInfo->allocationSize);
+    std::lock_guard<std::mutex> lock(*my_data->usageLock);
+    (*my_data->allocations)[*pMemory] = {pAllocateInfo->memoryTypeIndex, pAllocateInfo->allocationSize, 0, 0};
+    return result;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice device, VkDeviceMemory memory,
+                                                        const VkAllocationCallbacks *pAllocator) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    {
+        std::lock_guard<std::mutex> lock(*my_data->usageLock);
+        auto allocation = my_data->allocations->find(memory);
+        if (allocation != my_data->allocations->end()) {
+            memory_type_counters &counters = my_data->counters[allocation->second.memoryType];
+            counters.allocated -= allocation->second.size;
+            counters.allocations--;
+            // Freeing memory unmaps it and unbinds the resources still bound to it
+            counters.bound -= allocation->second.bound;
+            counters.mapped -= allocation->second.mapped;
+            my_data->allocations->erase(allocation);
+        }
+    }
+    my_data->device_dispatch_table->FreeMemory(device, memory, pAllocator);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset,
+                                                           VkDeviceSize size, VkMemoryMapFlags flags, void **ppData) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    VkResult result = my_data->device_dispatch_table->MapMemory(device, memory, offset, size, flags, ppData);
+    if (result != VK_SUCCESS) return result;
+
+    std::lock_guard<std::mutex> lock(*my_data->usageLock);
+    auto allocation = my_data->allocations->find(memory);
+    if (allocation != my_data->allocations->end()) {
+        allocation_usage &usage = allocation->second;
+        usage.mapped = size == VK_WHOLE_SIZE ? usage.size - offset : size;
+        my_data->counters[usage.memoryType].mapped += usage.mapped;
+    }
+    return result;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkUnmapMemory(VkDevice device, VkDeviceMemory memory) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    {
+        std::lock_guard<std::mutex> lock(*my_data->usageLock);
+        auto allocation = my_data->allocations->find(memory);
+        if (allocation != my_data->allocations->end()) {
+            my_data->counters[allocation->second.memoryType].mapped -= allocation->second.mapped;
+            allocation->second.mapped = 0;
+        }
+    }
+    my_data->device_dispatch_table->UnmapMemory(device, memory);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory(VkDevice device, VkBuffer buffer, VkDeviceMemory memory,
+                                                                  VkDeviceSize memoryOffset) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
+    VkResult result = pTable->BindBufferMemory(device, buffer, memory, memoryOffset);
+    if (result == VK_SUCCESS) {
+        VkMemoryRequirements requirements;
+        pTable->GetBufferMemoryRequirements(device, buffer, &requirements);
+        recordBinding(my_data, (uint64_t)buffer, memory, requirements.size);
+    }
+    return result;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkBindImageMemory(VkDevice device, VkImage image, VkDeviceMemory memory,
+                                                                 VkDeviceSize memoryOffset) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
+    VkResult result = pTable->BindImageMemory(device, image, memory, memoryOffset);
+    if (result == VK_SUCCESS) {
+        VkMemoryRequirements requirements;
+        pTable->GetImageMemoryRequirements(device, image, &requirements);
+        recordBinding(my_data, (uint64_t)image, memory, requirements.size);
+    }
+    return result;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory2KHR(VkDevice device, uint32_t bindInfoCount,
+                                                                      const VkBindBufferMemoryInfoKHR *pBindInfos) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
+    VkResult result = pTable->BindBufferMemory2KHR(device, bindInfoCount, pBindInfos);
+    if (result == VK_SUCCESS) {
+        for (uint32_t i = 0; i < bindInfoCount; i++) {
+            VkMemoryRequirements requirements;
+            pTable->GetBufferMemoryRequirements(device, pBindInfos[i].buffer, &requirements);
+            recordBinding(my_data, (uint64_t)pBindInfos[i].buffer, pBindInfos[i].memory, requirements.size);
+        }
+    }
+    return result;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkBindImageMemory2KHR(VkDevice device, uint32_t bindInfoCount,
+                                                                     const VkBindImageMemoryInfoKHR *pBindInfos) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
+    VkResult result = pTable->BindImageMemory2KHR(device, bindInfoCount, pBindInfos);
+    if (result == VK_SUCCESS) {
+        for (uint32_t i = 0; i < bindInfoCount; i++) {
+            VkMemoryRequirements requirements;
+            pTable->GetImageMemoryRequirements(device, pBindInfos[i].image, &requirements);
+            recordBinding(my_data, (uint64_t)pBindInfos[i].image, pBindInfos[i].memory, requirements.size);
+        }
+    }
+    return result;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroyBuffer(VkDevice device, VkBuffer buffer,
+                                                           const VkAllocationCallbacks *pAllocator) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    releaseBinding(my_data, (uint64_t)buffer);
+    my_data->device_dispatch_table->DestroyBuffer(device, buffer, pAllocator);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroyImage(VkDevice device, VkImage image,
+                                                          const VkAllocationCallbacks *pAllocator) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    releaseBinding(my_data, (uint64_t)image);
+    my_data->device_dispatch_table->DestroyImage(device, image, pAllocator);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(queue), layer_data_map);
+    if (settings.outputFile) {
+        uint64_t frame = my_data->frame++;
+        if (frame % settings.frameInterval == 0) writeFrame(my_data, frame);
+    }
+    return my_data->device_dispatch_table->QueuePresentKHR(queue, pPresentInfo);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(VkDevice dev, const char *funcName) {
+#define ADD_HOOK(fn) \
+    if (!strncmp(#fn, funcName, sizeof(#fn))) return (PFN_vkVoidFunction)fn
+
+    ADD_HOOK(vkGetDeviceProcAddr);
+    ADD_HOOK(vkDestroyDevice);
+    ADD_HOOK(vkAllocateMemory);
+    ADD_HOOK(vkFreeMemory);
+    ADD_HOOK(vkMapMemory);
+    ADD_HOOK(vkUnmapMemory);
+    ADD_HOOK(vkBindBufferMemory);
+    ADD_HOOK(vkBindImageMemory);
+    ADD_HOOK(vkDestroyBuffer);
+    ADD_HOOK(vkDestroyImage);
+    ADD_HOOK(vkQueuePresentKHR);
+#undef ADD_HOOK
+
+    if (dev == NULL) return NULL;
+
+    layer_data *dev_data;
+    dev_data = GetLayerDataPtr(get_dispatch_key(dev), layer_data_map);
+    VkLayerDispatchTable *pTable = dev_data->device_dispatch_table;
+
+    // VK_KHR_bind_memory2 commands are only there if the application enabled the extension
+#define ADD_EXTENSION_HOOK(fn) \
+    if (!strncmp("vk" #fn, funcName, sizeof("vk" #fn))) return pTable->fn ? (PFN_vkVoidFunction)vk##fn : NULL
+
+    ADD_EXTENSION_HOOK(BindBufferMemory2KHR);
+    ADD_EXTENSION_HOOK(BindImageMemory2KHR);
+#undef ADD_EXTENSION_HOOK
+
+    if (pTable->GetDeviceProcAddr == NULL) return NULL;
+    return pTable->GetDeviceProcAddr(dev, funcName);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr(VkInstance instance, const char *funcName) {
+#define ADD_HOOK(fn) \
+    if (!strncmp(#fn, funcName, sizeof(#fn))) return (PFN_vkVoidFunction)fn
+
+    ADD_HOOK(vkCreateInstance);
+    ADD_HOOK(vkCreateDevice);
+    ADD_HOOK(vkDestroyInstance);
+    ADD_HOOK(vkGetInstanceProcAddr);
+#undef ADD_HOOK
+
+    if (instance == NULL) return NULL;
+
+    layer_data *instance_data;
+    instance_data = GetLayerDataPtr(get_dispatch_key(instance), layer_data_map);
+    VkLayerInstanceDispatchTable *pTable = instance_data->instance_dispatch_table;
+
+    if (pTable->GetInstanceProcAddr == NULL) return NULL;
+    return pTable->GetInstanceProcAddr(instance, funcName);
+}
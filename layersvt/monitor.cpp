@@ -20,25 +20,112 @@
  * Author: Chris Forbes <chrisforbes@google.com>
  * Author: Tony Barbour <tony@lunarg.com>
  */
+#include "vk_layer_config.h"
 #include "vk_layer_data.h"
 #include "vk_layer_extension_utils.h"
 #include "vk_layer_table.h"
+#include <algorithm>
 #include <assert.h>
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 #include <unordered_map>
+#include <vector>
 #include <vk_dispatch_table_helper.h>
 #include <vk_loader_platform.h>
 #include <vulkan/vk_layer.h>
 #include <vulkan/vulkan.h>
 
-#if (!defined(VK_USE_PLATFORM_XCB_KHR) && !defined(VK_USE_PLATFORM_WIN32_KHR))
-#warning "Monitor layer only has code for XCB and Windows at this time"
-#endif
+// The FPS is shown in the title bar on XCB and Windows only.  Frame time
+// statistics are written to lunarg_monitor.stats_file on every platform,
+// including headless and Wayland applications.
 
 #define TITLE_LENGTH 1000
 #define FPS_LENGTH 24
+
+typedef std::chrono::steady_clock monitor_clock;
+
+// The last `capacity` samples, in milliseconds.
+class RollingTimes {
+   public:
+    RollingTimes() : capacity(0), next(0) {}
+
+    void setCapacity(uint32_t count) {
+        capacity = count;
+        samples.clear();
+        samples.reserve(count);
+        next = 0;
+    }
+
+    void add(double ms) {
+        if (capacity == 0) return;
+        if (samples.size() < capacity) {
+            samples.push_back(ms);
+        } else {
+            samples[next] = ms;
+            next = (next + 1) % capacity;
+        }
+    }
+
+    bool empty() const { return samples.empty(); }
+
+    // Fill pPercentiles[i] with the percentiles[i]th percentile (0-100) of the window
+    // and return the mean.
+    double summarize(const double *percentiles, double *pPercentiles, uint32_t count) const {
+        std::vector<double> sorted(samples);
+        double sum = 0.0;
+        for (double ms : sorted) sum += ms;
+        for (uint32_t i = 0; i < count; i++) {
+            size_t rank = (size_t)(percentiles[i] / 100.0 * (sorted.size() - 1) + 0.5);
+            std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+            pPercentiles[i] = sorted[rank];
+        }
+        return sum / sorted.size();
+    }
+
+   private:
+    uint32_t capacity;
+    std::vector<double> samples;
+    size_t next;
+};
+
+enum StatsFormat { STATS_FORMAT_CSV, STATS_FORMAT_JSON };
+
+// Settings from vk_layer_settings.txt, read when the first device is created.
+struct monitor_settings {
+    FILE *statsFile;  // NULL when statistics are not written
+    StatsFormat statsFormat;
+    double statsInterval;  // seconds between reports
+    uint32_t statsWindow;  // frames and submits the percentiles are taken over
+    bool gpuTimestamps;
+    bool headerWritten;
+};
+
+static monitor_settings settings;
+static std::once_flag settingsOnce;
+static std::mutex statsFileLock;
+
+// Timestamp queries written before and after the command buffers of each
+// vkQueueSubmit on one queue.  Slots are reused in order; a submit is left
+// untimed when its slot's previous results have not been read yet.
+#define TIMESTAMP_SLOTS 64
+struct queue_timestamps {
+    VkDevice device;
+    VkCommandPool commandPool;
+    VkQueryPool queryPool;
+    uint64_t validMask;
+    double nsPerTick;
+    struct {
+        VkCommandBuffer begin;  // resets the slot's queries and writes the first timestamp
+        VkCommandBuffer end;    // writes the second timestamp
+        bool pending;           // submitted, results not read yet
+    } slots[TIMESTAMP_SLOTS];
+    uint32_t next;
+    uint32_t oldest;
+};
+
 struct layer_data {
     VkLayerDispatchTable *device_dispatch_table;
     VkLayerInstanceDispatchTable *instance_dispatch_table;
@@ -58,15 +145,192 @@ struct layer_data {
 
     PFN_vkSetDeviceLoaderData pfn_dev_init;
     int lastFrame;
-    time_t lastTime;
+    monitor_clock::time_point lastTime;
     float fps;
     int frame;
+
+    // Frame time statistics, guarded by statsLock.
+    std::mutex *statsLock;
+    monitor_clock::time_point firstPresent;
+    monitor_clock::time_point lastPresent;
+    monitor_clock::time_point lastReport;
+    int lastReportFrame;
+    RollingTimes *frameTimes;
+    RollingTimes *gpuTimes;
+    uint64_t gpuSubmits;
+    std::unordered_map<VkQueue, queue_timestamps *> *queueTimestamps;
 };
 
 static std::unordered_map<void *, layer_data *> layer_data_map;
 
 template layer_data *GetLayerDataPtr<layer_data>(void *data_key, std::unordered_map<void *, layer_data *> &data_map);
 
+static void readSettings() {
+    settings.statsFile = NULL;
+    const char *statsFile = getLayerOption("lunarg_monitor.stats_file");
+    if (statsFile[0] != '\0') settings.statsFile = getLayerLogOutput(statsFile, "lunarg_monitor");
+
+    settings.statsFormat = strcmp(getLayerOption("lunarg_monitor.stats_format"), "JSON") ? STATS_FORMAT_CSV : STATS_FORMAT_JSON;
+
+    settings.statsInterval = 1.0;
+    double interval;
+    if (sscanf(getLayerOption("lunarg_monitor.stats_interval"), "%lf", &interval) == 1 && interval > 0.0)
+        settings.statsInterval = interval;
+
+    settings.statsWindow = 1000;
+    unsigned window;
+    if (sscanf(getLayerOption("lunarg_monitor.stats_window"), "%u", &window) == 1 && window > 0) settings.statsWindow = window;
+
+    settings.gpuTimestamps = settings.statsFile && !strcmp(getLayerOption("lunarg_monitor.gpu_timestamps"), "TRUE");
+    settings.headerWritten = false;
+}
+
+static double elapsedMs(monitor_clock::time_point from, monitor_clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+// Write one line of statistics covering the frames presented since the last report.
+static void writeStats(layer_data *my_data, monitor_clock::time_point now) {
+    static const double percentiles[] = {50.0, 95.0, 99.0, 100.0};
+    double frameMs[4] = {}, gpuMs[4] = {};
+    double frameMean = 0.0;
+    if (!my_data->frameTimes->empty()) frameMean = my_data->frameTimes->summarize(percentiles, frameMs, 4);
+    if (!my_data->gpuTimes->empty()) my_data->gpuTimes->summarize(percentiles, gpuMs, 4);
+    double seconds = elapsedMs(my_data->lastReport, now) / 1000.0;
+    double fps = (my_data->frame - my_data->lastReportFrame) / seconds;
+    double time = elapsedMs(my_data->firstPresent, now) / 1000.0;
+
+    std::lock_guard<std::mutex> lock(statsFileLock);
+    FILE *out = settings.statsFile;
+    if (settings.statsFormat == STATS_FORMAT_JSON) {
+        fprintf(out,
+                "{\"device\": \"%p\", \"time\": %.3f, \"frames\": %d, \"fps\": %.2f, "
+                "\"frame_ms\": {\"mean\": %.3f, \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f}, "
+                "\"gpu_submits\": %llu, \"gpu_ms\": {\"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f}}\n",
+                (void *)my_data->device, time, my_data->frame, fps, frameMean, frameMs[0], frameMs[1], frameMs[2], frameMs[3],
+                (unsigned long long)my_data->gpuSubmits, gpuMs[0], gpuMs[1], gpuMs[2], gpuMs[3]);
+    } else {
+        if (!settings.headerWritten) {
+            fprintf(out,
+                    "device,time,frames,fps,frame_ms_mean,frame_ms_p50,frame_ms_p95,frame_ms_p99,frame_ms_max,"
+                    "gpu_submits,gpu_ms_p50,gpu_ms_p95,gpu_ms_p99,gpu_ms_max\n");
+            settings.headerWritten = true;
+        }
+        fprintf(out, "%p,%.3f,%d,%.2f,%.3f,%.3f,%.3f,%.3f,%.3f,%llu,%.3f,%.3f,%.3f,%.3f\n", (void *)my_data->device, time,
+                my_data->frame, fps, frameMean, frameMs[0], frameMs[1], frameMs[2], frameMs[3],
+                (unsigned long long)my_data->gpuSubmits, gpuMs[0], gpuMs[1], gpuMs[2], gpuMs[3]);
+    }
+    fflush(out);
+
+    my_data->lastReport = now;
+    my_data->lastReportFrame = my_data->frame;
+}
+
+// Create the query pool and the pre-recorded timestamp command buffers for a queue.
+// return:
+//      NULL if the queue family has no timestamp support or creation fails.
+static queue_timestamps *createQueueTimestamps(layer_data *my_data, uint32_t queueFamilyIndex) {
+    layer_data *my_instance_data = GetLayerDataPtr(get_dispatch_key(my_data->gpu), layer_data_map);
+    VkLayerInstanceDispatchTable *pInstanceTable = my_instance_data->instance_dispatch_table;
+    VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
+    VkDevice device = my_data->device;
+
+    uint32_t familyCount = 0;
+    pInstanceTable->GetPhysicalDeviceQueueFamilyProperties(my_data->gpu, &familyCount, NULL);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    pInstanceTable->GetPhysicalDeviceQueueFamilyProperties(my_data->gpu, &familyCount, families.data());
+    if (queueFamilyIndex >= familyCount || families[queueFamilyIndex].timestampValidBits == 0) return NULL;
+    VkPhysicalDeviceProperties properties;
+    pInstanceTable->GetPhysicalDeviceProperties(my_data->gpu, &properties);
+
+    queue_timestamps *timestamps = new queue_timestamps();
+    timestamps->device = device;
+    uint32_t validBits = families[queueFamilyIndex].timestampValidBits;
+    timestamps->validMask = validBits >= 64 ? ~0ULL : (1ULL << validBits) - 1;
+    timestamps->nsPerTick = properties.limits.timestampPeriod;
+
+    VkCommandPoolCreateInfo poolInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, NULL, 0, queueFamilyIndex};
+    VkQueryPoolCreateInfo queryInfo = {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO, NULL, 0, VK_QUERY_TYPE_TIMESTAMP,
+                                       2 * TIMESTAMP_SLOTS, 0};
+    if (pTable->CreateCommandPool(device, &poolInfo, NULL, &timestamps->commandPool) != VK_SUCCESS) {
+        delete timestamps;
+        return NULL;
+    }
+    if (pTable->CreateQueryPool(device, &queryInfo, NULL, &timestamps->queryPool) != VK_SUCCESS) {
+        pTable->DestroyCommandPool(device, timestamps->commandPool, NULL);
+        delete timestamps;
+        return NULL;
+    }
+
+    VkCommandBuffer commandBuffers[2 * TIMESTAMP_SLOTS];
+    VkCommandBufferAllocateInfo allocInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, NULL, timestamps->commandPool,
+                                             VK_COMMAND_BUFFER_LEVEL_PRIMARY, 2 * TIMESTAMP_SLOTS};
+    VkResult result = pTable->AllocateCommandBuffers(device, &allocInfo, commandBuffers);
+    for (uint32_t i = 0; result == VK_SUCCESS && i < 2 * TIMESTAMP_SLOTS; i++) {
+        // Command buffers are dispatchable objects and need the loader's dispatch pointer.
+        if (my_data->pfn_dev_init) {
+            result = my_data->pfn_dev_init(device, (void *)commandBuffers[i]);
+        } else {
+            *((const void **)commandBuffers[i]) = *(void **)device;
+        }
+    }
+
+    VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
+                                          VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT, NULL};
+    for (uint32_t i = 0; result == VK_SUCCESS && i < TIMESTAMP_SLOTS; i++) {
+        VkCommandBuffer begin = commandBuffers[2 * i];
+        VkCommandBuffer end = commandBuffers[2 * i + 1];
+        timestamps->slots[i].begin = begin;
+        timestamps->slots[i].end = end;
+
+        pTable->BeginCommandBuffer(begin, &beginInfo);
+        pTable->CmdResetQueryPool(begin, timestamps->queryPool, 2 * i, 2);
+        pTable->CmdWriteTimestamp(begin, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamps->queryPool, 2 * i);
+        result = pTable->EndCommandBuffer(begin);
+        if (result != VK_SUCCESS) break;
+
+        pTable->BeginCommandBuffer(end, &beginInfo);
+        pTable->CmdWriteTimestamp(end, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamps->queryPool, 2 * i + 1);
+        result = pTable->EndCommandBuffer(end);
+    }
+
+    if (result != VK_SUCCESS) {
+        pTable->DestroyQueryPool(device, timestamps->queryPool, NULL);
+        pTable->DestroyCommandPool(device, timestamps->commandPool, NULL);
+        delete timestamps;
+        return NULL;
+    }
+    return timestamps;
+}
+
+static void destroyQueueTimestamps(VkLayerDispatchTable *pTable, queue_timestamps *timestamps) {
+    if (!timestamps) return;
+    pTable->DestroyQueryPool(timestamps->device, timestamps->queryPool, NULL);
+    pTable->DestroyCommandPool(timestamps->device, timestamps->commandPool, NULL);
+    delete timestamps;
+}
+
+// Read back the results of finished submits, oldest first, without waiting.
+// Called with statsLock held.
+static void collectTimestamps(layer_data *my_data, queue_timestamps *timestamps) {
+    VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
+    while (timestamps->slots[timestamps->oldest].pending) {
+        uint32_t slot = timestamps->oldest;
+        // Each query is followed by its availability.
+        uint64_t data[4];
+        VkResult result = pTable->GetQueryPoolResults(timestamps->device, timestamps->queryPool, 2 * slot, 2, sizeof(data), data,
+                                                      2 * sizeof(uint64_t),
+                                                      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if ((result != VK_SUCCESS && result != VK_NOT_READY) || !data[1] || !data[3]) break;
+
+        uint64_t ticks = (data[2] - data[0]) & timestamps->validMask;
+        my_data->gpuTimes->add(ticks * timestamps->nsPerTick / 1000000.0);
+        my_data->gpuSubmits++;
+        timestamps->slots[slot].pending = false;
+        timestamps->oldest = (slot + 1) % TIMESTAMP_SLOTS;
+    }
+}
+
 VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(VkPhysicalDevice gpu, const VkDeviceCreateInfo *pCreateInfo,
                                                               const VkAllocationCallbacks *pAllocator, VkDevice *pDevice) {
     VkLayerDeviceCreateInfo *chain_info = get_chain_info(pCreateInfo, VK_LAYER_LINK_INFO);
@@ -106,7 +370,17 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(VkPhysicalDevice g
     my_device_data->frame = 0;
     my_device_data->lastFrame = 0;
     my_device_data->fps = 0.0;
-    time(&my_device_data->lastTime);
+    my_device_data->lastTime = monitor_clock::now();
+
+    std::call_once(settingsOnce, readSettings);
+    my_device_data->statsLock = new std::mutex;
+    my_device_data->lastReportFrame = 0;
+    my_device_data->frameTimes = new RollingTimes;
+    my_device_data->frameTimes->setCapacity(settings.statsWindow);
+    my_device_data->gpuTimes = new RollingTimes;
+    my_device_data->gpuTimes->setCapacity(settings.statsWindow);
+    my_device_data->gpuSubmits = 0;
+    my_device_data->queueTimestamps = new std::unordered_map<VkQueue, queue_timestamps *>;
 
     // Get our WSI hooks in
     VkLayerDispatchTable *pTable = my_device_data->device_dispatch_table;
@@ -120,9 +394,14 @@ VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroyDevice(VkDevice device, cons
     layer_data *my_data = GetLayerDataPtr(key, layer_data_map);
     VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
     pTable->DeviceWaitIdle(device);
+    for (auto &entry : *my_data->queueTimestamps) destroyQueueTimestamps(pTable, entry.second);
+    delete my_data->queueTimestamps;
+    delete my_data->frameTimes;
+    delete my_data->gpuTimes;
+    delete my_data->statsLock;
     pTable->DestroyDevice(device, pAllocator);
     delete pTable;
-    layer_data_map.erase(key);
+    FreeLayerDataPtr(key, layer_data_map);
 }
 
 VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(const VkInstanceCreateInfo *pCreateInfo,
@@ -155,23 +434,94 @@ VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroyInstance(VkInstance instance
     VkLayerInstanceDispatchTable *pTable = my_data->instance_dispatch_table;
     pTable->DestroyInstance(instance, pAllocator);
     delete pTable;
-    layer_data_map.erase(key);
+    FreeLayerDataPtr(key, layer_data_map);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkGetDeviceQueue(VkDevice device, uint32_t queueFamilyIndex, uint32_t queueIndex,
+                                                            VkQueue *pQueue) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    my_data->device_dispatch_table->GetDeviceQueue(device, queueFamilyIndex, queueIndex, pQueue);
+
+    if (settings.gpuTimestamps) {
+        std::lock_guard<std::mutex> lock(*my_data->statsLock);
+        if (my_data->queueTimestamps->find(*pQueue) == my_data->queueTimestamps->end())
+            (*my_data->queueTimestamps)[*pQueue] = createQueueTimestamps(my_data, queueFamilyIndex);
+    }
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo *pSubmits,
+                                                             VkFence fence) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(queue), layer_data_map);
+    VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
+
+    queue_timestamps *timestamps = NULL;
+    if (settings.gpuTimestamps && submitCount > 0) {
+        std::lock_guard<std::mutex> lock(*my_data->statsLock);
+        auto it = my_data->queueTimestamps->find(queue);
+        if (it != my_data->queueTimestamps->end() && it->second) {
+            timestamps = it->second;
+            collectTimestamps(my_data, timestamps);
+        }
+    }
+    // The queue is externally synchronized, so its slots can be used without the lock.
+    if (!timestamps || timestamps->slots[timestamps->next].pending) {
+        return pTable->QueueSubmit(queue, submitCount, pSubmits, fence);
+    }
+
+    // Time the whole batch: the first timestamp goes before the first submit's
+    // command buffers and the second after the last submit's.
+    uint32_t slot = timestamps->next;
+    std::vector<VkSubmitInfo> submits(pSubmits, pSubmits + submitCount);
+    std::vector<VkCommandBuffer> first(1, timestamps->slots[slot].begin);
+    first.insert(first.end(), pSubmits[0].pCommandBuffers, pSubmits[0].pCommandBuffers + pSubmits[0].commandBufferCount);
+    std::vector<VkCommandBuffer> last;
+    if (submitCount == 1) {
+        first.push_back(timestamps->slots[slot].end);
+    } else {
+        const VkSubmitInfo &lastSubmit = pSubmits[submitCount - 1];
+        last.assign(lastSubmit.pCommandBuffers, lastSubmit.pCommandBuffers + lastSubmit.commandBufferCount);
+        last.push_back(timestamps->slots[slot].end);
+        submits[submitCount - 1].commandBufferCount = (uint32_t)last.size();
+        submits[submitCount - 1].pCommandBuffers = last.data();
+    }
+    submits[0].commandBufferCount = (uint32_t)first.size();
+    submits[0].pCommandBuffers = first.data();
+
+    VkResult result = pTable->QueueSubmit(queue, submitCount, submits.data(), fence);
+    if (result == VK_SUCCESS) {
+        std::lock_guard<std::mutex> lock(*my_data->statsLock);
+        timestamps->slots[slot].pending = true;
+        timestamps->next = (slot + 1) % TIMESTAMP_SLOTS;
+    }
+    return result;
 }
 
 VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo) {
     layer_data *my_data = GetLayerDataPtr(get_dispatch_key(queue), layer_data_map);
 
-    time_t now;
-    time(&now);
-    float seconds = (float)difftime(now, my_data->lastTime);
+    monitor_clock::time_point now = monitor_clock::now();
+    float seconds = (float)(elapsedMs(my_data->lastTime, now) / 1000.0);
+
+    if (settings.statsFile) {
+        std::lock_guard<std::mutex> lock(*my_data->statsLock);
+        if (my_data->frame == 0) {
+            my_data->firstPresent = now;
+            my_data->lastReport = now;
+        } else {
+            my_data->frameTimes->add(elapsedMs(my_data->lastPresent, now));
+        }
+        my_data->lastPresent = now;
+        if (elapsedMs(my_data->lastReport, now) >= settings.statsInterval * 1000.0) writeStats(my_data, now);
+    }
 
     if (seconds > 0.5) {
-        char str[TITLE_LENGTH + FPS_LENGTH];
-        char fpsstr[FPS_LENGTH];
-        layer_data *my_instance_data = GetLayerDataPtr(get_dispatch_key(my_data->gpu), layer_data_map);
         my_data->fps = (my_data->frame - my_data->lastFrame) / seconds;
         my_data->lastFrame = my_data->frame;
         my_data->lastTime = now;
+#if defined(VK_USE_PLATFORM_WIN32_KHR) || defined(VK_USE_PLATFORM_XCB_KHR)
+        char str[TITLE_LENGTH + FPS_LENGTH];
+        char fpsstr[FPS_LENGTH];
+        layer_data *my_instance_data = GetLayerDataPtr(get_dispatch_key(my_data->gpu), layer_data_map);
         sprintf(fpsstr, "   FPS = %.2f", my_data->fps);
         strcpy(str, my_instance_data->base_title);
         strcat(str, fpsstr);
@@ -183,6 +533,7 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkQueuePresentKHR(VkQueue queue,
                                 XCB_ATOM_STRING, 8, strlen(str), str);
             xcb_flush(my_instance_data->connection);
         }
+#endif
 #endif
     }
     my_data->frame++;
@@ -241,6 +592,8 @@ VK_LAYER_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(VkD
 
     ADD_HOOK(vkGetDeviceProcAddr);
     ADD_HOOK(vkDestroyDevice);
+    ADD_HOOK(vkGetDeviceQueue);
+    ADD_HOOK(vkQueueSubmit);
     ADD_HOOK(vkQueuePresentKHR);
 #undef ADD_HOOK
 
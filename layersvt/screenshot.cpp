@@ -33,6 +33,10 @@
 #include <set>
 #include <vector>
 #include <fstream>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 
 using namespace std;
 
@@ -43,6 +47,10 @@ using namespace std;
 #include "vk_layer_utils.h"
 
 #include "screenshot_parsing.h"
+#include "screenshot_encode.h"
+#ifdef SCREENSHOT_HAVE_CONVERT_SHADER
+#include "screenshot_convert.comp.h"
+#endif
 
 #ifdef ANDROID
 
@@ -56,6 +64,10 @@ const char *env_var_old = env_var;
 const char *env_var_old = "_VK_SCREENSHOT";
 const char *env_var = "VK_SCREENSHOT_FRAMES";
 const char *env_var_format = "VK_SCREENSHOT_FORMAT";
+const char *env_var_file_format = "VK_SCREENSHOT_FILE_FORMAT";
+const char *env_var_gpu_convert = "VK_SCREENSHOT_GPU_CONVERT";
+const char *env_var_thumbnail_scale = "VK_SCREENSHOT_THUMBNAIL_SCALE";
+const char *env_var_thumbnail_only = "VK_SCREENSHOT_THUMBNAIL_ONLY";
 #endif
 
 #ifdef ANDROID
@@ -138,6 +150,21 @@ typedef enum colorSpaceFormat {
 
 colorSpaceFormat userColorSpaceFormat = UNDEFINED;
 
+// File format screenshots are written in, set from VK_SCREENSHOT_FILE_FORMAT.
+ScreenshotFileFormat userFileFormat = SCREENSHOT_FILE_FORMAT_PPM;
+
+// Convert with a compute shader even for formats the blit path can handle,
+// set from VK_SCREENSHOT_GPU_CONVERT.
+bool userGpuConvert = false;
+
+// If greater than 1, also write a thumbnail downsampled by this factor, set
+// from VK_SCREENSHOT_THUMBNAIL_SCALE.  Thumbnails need the compute shader.
+uint32_t userThumbnailScale = 0;
+
+// Write only the thumbnail, not the full size screenshot, when there is one,
+// set from VK_SCREENSHOT_THUMBNAIL_ONLY.
+bool userThumbnailOnly = false;
+
 // unordered map: associates a swap chain with a device, image extent, format,
 // and list of images
 typedef struct {
@@ -156,15 +183,19 @@ typedef struct {
 } ImageMapStruct;
 static unordered_map<VkImage, ImageMapStruct *> imageMap;
 
-// unordered map: associates a device with a queue, commandPool, and physical
-// device also contains per device info including dispatch table
+struct ReadbackRing;
+
+// unordered map: associates a device with a queue, its queue family, and physical
+// device also contains per device info including dispatch table and the
+// resources used to read screenshots back
 typedef struct {
     VkLayerDispatchTable *device_dispatch_table;
     bool wsi_enabled;
     VkQueue queue;
-    std::list<VkCommandPool> commandPools;
+    uint32_t queueFamilyIndex;
     VkPhysicalDevice physicalDevice;
     PFN_vkSetDeviceLoaderData pfn_dev_init;
+    ReadbackRing *readbackRing;
 } DeviceMapStruct;
 static unordered_map<VkDevice, DeviceMapStruct *> deviceMap;
 
@@ -252,6 +283,36 @@ void readScreenShotFormatENV(void) {
 #endif
         }
     }
+
+#ifndef ANDROID
+    const char *vk_screenshot_file_format = local_getenv(env_var_file_format);
+    if (vk_screenshot_file_format && *vk_screenshot_file_format) {
+        if (!parseScreenshotFileFormat(vk_screenshot_file_format, &userFileFormat)) {
+            fprintf(stderr, "Selected file format:%s\nIs NOT in the list:\nPPM, QOI\n"
+                            "PPM will be used instead\n", vk_screenshot_file_format);
+        }
+    }
+    local_free_getenv(vk_screenshot_file_format);
+
+    const char *vk_screenshot_gpu_convert = local_getenv(env_var_gpu_convert);
+    if (vk_screenshot_gpu_convert && *vk_screenshot_gpu_convert) {
+        userGpuConvert = atoi(vk_screenshot_gpu_convert) != 0;
+    }
+    local_free_getenv(vk_screenshot_gpu_convert);
+
+    const char *vk_screenshot_thumbnail_scale = local_getenv(env_var_thumbnail_scale);
+    if (vk_screenshot_thumbnail_scale && *vk_screenshot_thumbnail_scale) {
+        int scale = atoi(vk_screenshot_thumbnail_scale);
+        userThumbnailScale = scale > 1 ? scale : 0;
+    }
+    local_free_getenv(vk_screenshot_thumbnail_scale);
+
+    const char *vk_screenshot_thumbnail_only = local_getenv(env_var_thumbnail_only);
+    if (vk_screenshot_thumbnail_only && *vk_screenshot_thumbnail_only) {
+        userThumbnailOnly = atoi(vk_screenshot_thumbnail_only) != 0;
+    }
+    local_free_getenv(vk_screenshot_thumbnail_only);
+#endif
 }
 
 // detect if frameNumber reach or beyond the right edge for screenshot in the range.
@@ -347,83 +408,121 @@ static void init_screenshot() {
     readScreenShotFormatENV();
 }
 
-// Track allocated resources in writePPM()
-// and clean them up when they go out of scope.
-struct WritePPMCleanupData {
-    VkDevice device;
-    VkLayerDispatchTable *pTableDevice;
+// Number of screenshots that can be in flight at once.  Once all of them are
+// waiting to be written, QueuePresentKHR waits for the oldest one to finish.
+static const uint32_t readbackRingSize = 3;
+
+// One in-flight screenshot: the image(s) the swapchain image is copied into,
+// the command buffer doing the copy and the fence it signals.  The resources
+// are created on first use and reused for as long as the swapchain extent and
+// format stay the same.  The memory the CPU reads stays mapped while the slot
+// exists.
+struct ReadbackSlot {
     VkImage image2;
     VkImage image3;
     VkDeviceMemory mem2;
     VkDeviceMemory mem3;
-    bool mem2mapped;
-    bool mem3mapped;
+    // Compute conversion path: the swapchain image is copied into srcImage,
+    // which the shader samples to write RGBA8 pixels, followed by the
+    // thumbnail if there is one, into buffer.
+    bool useConvert;
+    VkImage srcImage;
+    VkDeviceMemory srcMem;
+    VkImageView srcView;
+    VkBuffer buffer;
+    VkDeviceMemory bufferMem;
+    VkDescriptorSet descriptorSet;
+    uint32_t thumbnailScale;
+    uint32_t thumbnailWidth;
+    uint32_t thumbnailHeight;
+    VkDeviceMemory mappedMem;
+    const char *mappedPtr;
+    bool mappedCoherent;
+    VkSubresourceLayout srLayout;
     VkCommandBuffer commandBuffer;
-    VkCommandPool commandPool;
-    ~WritePPMCleanupData();
+    VkFence fence;
+    uint32_t width;
+    uint32_t height;
+    VkFormat format;
+    VkFormat destformat;
+    uint32_t numChannels;
+    bool need2steps;
+    bool copyOnly;
+    // The copy kept the swapchain's BGR channel order, so the writer swaps
+    // red and blue while converting.
+    bool swapRedBlue;
+    // Set by the present thread when the copy is submitted, cleared by the
+    // writer thread once the file is written.  Guarded by readbackLock.
+    bool busy;
+    string filename;
+    string thumbnailFilename;
 };
 
-WritePPMCleanupData::~WritePPMCleanupData() {
-    if (mem2mapped) pTableDevice->UnmapMemory(device, mem2);
-    if (mem2) pTableDevice->FreeMemory(device, mem2, NULL);
-    if (image2) pTableDevice->DestroyImage(device, image2, NULL);
-
-    if (mem3mapped) pTableDevice->UnmapMemory(device, mem3);
-    if (mem3) pTableDevice->FreeMemory(device, mem3, NULL);
-    if (image3) pTableDevice->DestroyImage(device, image3, NULL);
-
-    if (commandBuffer) pTableDevice->FreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-}
-
-// Save an image to a PPM image file.
-//
-// This function issues commands to copy/convert the swapchain image
-// from whatever compatible format the swapchain image uses
-// to a single format (VK_FORMAT_R8G8B8A8_UNORM) so that the converted
-// result can be easily written to a PPM file.
-//
-// Error handling: If there is a problem, this function should silently
-// fail without affecting the Present operation going on in the caller.
-// The numerous debug asserts are to catch programming errors and are not
-// expected to assert.  Recovery and clean up are implemented for image memory
-// allocation failures.
-// (TODO) It would be nice to pass any failure info to DebugReport or something.
-static void writePPM(const char *filename, VkImage image1) {
-    VkResult err;
-    bool pass;
-
-    // Bail immediately if we can't find the image.
-    if (imageMap.empty() || imageMap.find(image1) == imageMap.end()) return;
+// The readback slots of a device and the command pool their command buffers
+// come from.  The pool belongs to the layer so that the application resetting
+// or destroying its own pools cannot affect pending screenshots.
+struct ReadbackRing {
+    VkCommandPool commandPool;
+    uint32_t next;
+    ReadbackSlot slots[readbackRingSize];
+    // Compute conversion pipeline, created the first time a slot needs it.
+    // If that fails, convertFailed keeps the layer on the blit/copy path.
+    VkDescriptorSetLayout convertSetLayout;
+    VkPipelineLayout convertPipelineLayout;
+    VkPipeline convertPipeline;
+    VkSampler convertSampler;
+    VkDescriptorPool convertDescriptorPool;
+    bool convertFailed;
+};
 
-    // Collect object info from maps.  This info is generally recorded
-    // by the other functions hooked in this layer.
-    VkDevice device = imageMap[image1]->device;
-    VkPhysicalDevice physicalDevice = deviceMap[device]->physicalDevice;
-    VkInstance instance = physDeviceMap[physicalDevice]->instance;
-    VkQueue queue = deviceMap[device]->queue;
-    DeviceMapStruct *devMap = get_dev_info(device);
-    if (NULL == devMap) {
-        assert(0);
-        return;
-    }
-    VkLayerDispatchTable *pTableDevice = devMap->device_dispatch_table;
-    VkLayerDispatchTable *pTableQueue = get_dev_info(static_cast<VkDevice>(static_cast<void *>(queue)))->device_dispatch_table;
-    VkLayerInstanceDispatchTable *pInstanceTable;
-    pInstanceTable = instance_dispatch_table(instance);
+// Push constants of screenshot_convert.comp.
+struct ConvertParams {
+    uint32_t dstWidth;
+    uint32_t dstHeight;
+    uint32_t dstOffset;
+    uint32_t scale;
+    uint32_t encodeSRGB;
+};
 
-    // Gather incoming image info and check image format for compatibility with
-    // the target format.
-    // This function supports both 24-bit and 32-bit swapchain images.
-    uint32_t const width = imageMap[image1]->imageExtent.width;
-    uint32_t const height = imageMap[image1]->imageExtent.height;
-    VkFormat const format = imageMap[image1]->format;
-    uint32_t const numChannels = FormatChannelCount(format);
+struct ReadbackJob {
+    VkDevice device;
+    VkLayerDispatchTable *pTableDevice;
+    ReadbackSlot *slot;
+};
 
-    if ((3 != numChannels) && (4 != numChannels)) {
-        assert(0);
-        return;
+// The writer thread waits on each submitted slot's fence, then converts and
+// writes the image while the application keeps presenting.
+static std::mutex readbackLock;
+static std::condition_variable readbackQueued;
+static std::condition_variable readbackDone;
+static std::deque<ReadbackJob> readbackQueue;
+static bool readbackThreadStarted = false;
+
+static bool formatIsBGR(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_B8G8R8_UNORM:
+        case VK_FORMAT_B8G8R8_SNORM:
+        case VK_FORMAT_B8G8R8_USCALED:
+        case VK_FORMAT_B8G8R8_SSCALED:
+        case VK_FORMAT_B8G8R8_UINT:
+        case VK_FORMAT_B8G8R8_SINT:
+        case VK_FORMAT_B8G8R8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SNORM:
+        case VK_FORMAT_B8G8R8A8_USCALED:
+        case VK_FORMAT_B8G8R8A8_SSCALED:
+        case VK_FORMAT_B8G8R8A8_UINT:
+        case VK_FORMAT_B8G8R8A8_SINT:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            return true;
+        default:
+            return false;
     }
+}
 
+// Pick the format the swapchain image is converted to before it is written.
+// Returns VK_FORMAT_UNDEFINED if the swapchain format cannot be handled.
+static VkFormat getDestFormat(VkFormat format, uint32_t numChannels) {
     // Initial dest format is undefined as we will look for one
     VkFormat destformat = VK_FORMAT_UNDEFINED;
 
@@ -483,12 +582,11 @@ static void writePPM(const char *filename, VkImage image1) {
     if (destformat == VK_FORMAT_UNDEFINED) {
         // Here we reserve swapchain color space only as RGBA swizzle will be later.
         //
-        // One Potential optimization here would be: set destination to RGB all the
-        // time instead RGBA. PPM does not support Alpha channel, so we can write
-        // RGB one row by row but RGBA written one pixel at a time.
-        // This requires BLIT operation to get involved but current drivers (mostly)
-        // does not support BLIT operations on 3 Channel rendertargets.
-        // So format conversion gets costly.
+        // Setting the destination to RGB all the time would save the CPU from
+        // dropping the alpha channel, but that requires BLIT operations on
+        // 3 channel rendertargets, which current drivers (mostly) do not
+        // support.  The RGBA to RGB packing is vectorized in
+        // convertRowToRGB8() instead.
         if (numChannels == 4) {
             if (FormatIsUNorm(format))
                 destformat = VK_FORMAT_R8G8B8A8_UNORM;
@@ -540,14 +638,88 @@ static void writePPM(const char *filename, VkImage image1) {
     }
 
     if ((FormatCompatibilityClass(destformat) != FormatCompatibilityClass(format))) {
-        assert(0);
-        return;
+        return VK_FORMAT_UNDEFINED;
     }
+    return destformat;
+}
+
+// Release everything a slot owns and return it to its initial state.
+// The slot must not be busy.
+static void destroyReadbackSlot(VkDevice device, VkLayerDispatchTable *pTableDevice, ReadbackRing *ring, ReadbackSlot &slot) {
+    if (slot.mappedPtr) pTableDevice->UnmapMemory(device, slot.mappedMem);
+    if (slot.mem2) pTableDevice->FreeMemory(device, slot.mem2, NULL);
+    if (slot.image2) pTableDevice->DestroyImage(device, slot.image2, NULL);
+    if (slot.mem3) pTableDevice->FreeMemory(device, slot.mem3, NULL);
+    if (slot.image3) pTableDevice->DestroyImage(device, slot.image3, NULL);
+    if (slot.descriptorSet) pTableDevice->FreeDescriptorSets(device, ring->convertDescriptorPool, 1, &slot.descriptorSet);
+    if (slot.srcView) pTableDevice->DestroyImageView(device, slot.srcView, NULL);
+    if (slot.srcMem) pTableDevice->FreeMemory(device, slot.srcMem, NULL);
+    if (slot.srcImage) pTableDevice->DestroyImage(device, slot.srcImage, NULL);
+    if (slot.bufferMem) pTableDevice->FreeMemory(device, slot.bufferMem, NULL);
+    if (slot.buffer) pTableDevice->DestroyBuffer(device, slot.buffer, NULL);
+    if (slot.fence) pTableDevice->DestroyFence(device, slot.fence, NULL);
+    if (slot.commandBuffer) {
+        deviceMap.erase(static_cast<VkDevice>(static_cast<void *>(slot.commandBuffer)));
+        pTableDevice->FreeCommandBuffers(device, ring->commandPool, 1, &slot.commandBuffer);
+    }
+    slot = ReadbackSlot();
+}
+
+// Allocate memory for a readback image or buffer, preferring host cached
+// memory for the one the CPU reads from.
+static bool allocateReadbackMemory(VkDevice device, VkLayerDispatchTable *pTableDevice,
+                                   VkPhysicalDeviceMemoryProperties *memoryProperties, const VkMemoryRequirements &memRequirements,
+                                   bool hostRead, VkDeviceMemory *pMem, bool *pCoherent) {
+    VkMemoryAllocateInfo memAllocInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, memRequirements.size, 0};
+    bool pass;
+    if (hostRead) {
+        pass = memory_type_from_properties(memoryProperties, memRequirements.memoryTypeBits,
+                                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                                           &memAllocInfo.memoryTypeIndex) ||
+               memory_type_from_properties(memoryProperties, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                           &memAllocInfo.memoryTypeIndex);
+    } else {
+        pass = memory_type_from_properties(memoryProperties, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                           &memAllocInfo.memoryTypeIndex);
+    }
+    assert(pass);
+    if (!pass) return false;
+    if (pCoherent) {
+        *pCoherent =
+            (memoryProperties->memoryTypes[memAllocInfo.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+    }
+
+    VkResult err = pTableDevice->AllocateMemory(device, &memAllocInfo, NULL, pMem);
+    assert(!err);
+    return VK_SUCCESS == err;
+}
+
+static bool allocateImageMemory(VkDevice device, VkLayerDispatchTable *pTableDevice,
+                                VkPhysicalDeviceMemoryProperties *memoryProperties, VkImage image, bool hostRead,
+                                VkDeviceMemory *pMem, bool *pCoherent) {
+    VkMemoryRequirements memRequirements;
+    pTableDevice->GetImageMemoryRequirements(device, image, &memRequirements);
+    if (!allocateReadbackMemory(device, pTableDevice, memoryProperties, memRequirements, hostRead, pMem, pCoherent)) return false;
+    VkResult err = pTableDevice->BindImageMemory(device, image, *pMem, 0);
+    assert(!err);
+    return VK_SUCCESS == err;
+}
+
+// Create the image(s) the blit/copy path copies the swapchain image into and
+// map the one the CPU reads.
+static bool createBlitResources(VkDevice device, DeviceMapStruct *devMap, ReadbackSlot &slot) {
+    VkLayerDispatchTable *pTableDevice = devMap->device_dispatch_table;
+    VkPhysicalDevice physicalDevice = devMap->physicalDevice;
+    VkLayerInstanceDispatchTable *pInstanceTable = instance_dispatch_table(physDeviceMap[physicalDevice]->instance);
+    uint32_t const width = slot.width;
+    uint32_t const height = slot.height;
+    VkFormat const format = slot.format;
+    VkFormat const destformat = slot.destformat;
 
     // General Approach
     //
     // The idea here is to copy/convert the swapchain image into another image
-    // that can be mapped and read by the CPU to produce a PPM file.
+    // that can be mapped and read by the CPU to produce an image file.
     // The image must be untiled and converted to a specific format for easy
     // parsing.  The memory for the final image must be host-visible.
     // Note that in Vulkan, a BLIT operation must be used to perform a format
@@ -562,12 +734,12 @@ static void writePPM(const char *filename, VkImage image1) {
     // created with TILING_OPTIMAL.
     // 2) COPY image2 to another temp image (image3) that is created with
     // TILING_LINEAR.
-    // 3) Map image 3 and write the PPM file.
+    // 3) Map image 3 and write the image file.
     //
     // If the device can BLIT to a LINEAR image, then:
     // 1) BLIT the swapchain image (image1) to a temp image (image2) that is
     // created with TILING_LINEAR.
-    // 2) Map image 2 and write the PPM file.
+    // 2) Map image 2 and write the image file.
     //
     // There seems to be no way to tell if the swapchain image (image1) is tiled
     // or not.  We therefore assume that the BLIT operation can always read from
@@ -579,10 +751,10 @@ static void writePPM(const char *filename, VkImage image1) {
 
     VkFormatProperties targetFormatProps;
     pInstanceTable->GetPhysicalDeviceFormatProperties(physicalDevice, destformat, &targetFormatProps);
-    bool need2steps = false;
-    bool copyOnly = false;
+    slot.need2steps = false;
+    slot.copyOnly = false;
     if (destformat == format) {
-        copyOnly = true;
+        slot.copyOnly = true;
     } else {
         bool const bltLinear = targetFormatProps.linearTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT ? true : false;
         bool const bltOptimal = targetFormatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT ? true : false;
@@ -591,20 +763,15 @@ static void writePPM(const char *filename, VkImage image1) {
             // unlikely to have a device that cannot blit to either type.
             // But punt by just doing a copy and possibly have the wrong
             // colors.  This should be quite rare.
-            copyOnly = true;
+            slot.copyOnly = true;
         } else if (!bltLinear && bltOptimal) {
             // Cannot blit to a linear target but can blt to optimal, so copy
             // after blit is needed.
-            need2steps = true;
+            slot.need2steps = true;
         }
         // Else bltLinear is available and only 1 step is needed.
     }
-
-    // Put resources that need to be cleaned up in a struct with a destructor
-    // so that things get cleaned up when this function is exited.
-    WritePPMCleanupData data = {};
-    data.device = device;
-    data.pTableDevice = pTableDevice;
+    slot.swapRedBlue = slot.copyOnly && formatIsBGR(format);
 
     // Set up the image creation info for both the blit and copy images, in case
     // both are needed.
@@ -628,93 +795,346 @@ static void writePPM(const char *filename, VkImage image1) {
     VkImageCreateInfo imgCreateInfo3 = imgCreateInfo2;
 
     // If we need both images, set up image2 to be read/write and tiled.
-    if (need2steps) {
+    if (slot.need2steps) {
         imgCreateInfo2.tiling = VK_IMAGE_TILING_OPTIMAL;
         imgCreateInfo2.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
     }
 
-    VkMemoryAllocateInfo memAllocInfo = {
-        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL,
-        0,  // allocationSize, queried later
-        0   // memoryTypeIndex, queried later
-    };
-    VkMemoryRequirements memRequirements;
     VkPhysicalDeviceMemoryProperties memoryProperties;
+    pInstanceTable->GetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
 
     // Create image2 and allocate its memory.  It could be the intermediate or
     // final image.
-    err = pTableDevice->CreateImage(device, &imgCreateInfo2, NULL, &data.image2);
-    assert(!err);
-    if (VK_SUCCESS != err) return;
-    pTableDevice->GetImageMemoryRequirements(device, data.image2, &memRequirements);
-    memAllocInfo.allocationSize = memRequirements.size;
-    pInstanceTable->GetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
-    pass = memory_type_from_properties(&memoryProperties, memRequirements.memoryTypeBits,
-                                       need2steps ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-                                       &memAllocInfo.memoryTypeIndex);
-    assert(pass);
-    err = pTableDevice->AllocateMemory(device, &memAllocInfo, NULL, &data.mem2);
-    assert(!err);
-    if (VK_SUCCESS != err) return;
-    err = pTableQueue->BindImageMemory(device, data.image2, data.mem2, 0);
+    VkResult err = pTableDevice->CreateImage(device, &imgCreateInfo2, NULL, &slot.image2);
     assert(!err);
-    if (VK_SUCCESS != err) return;
+    bool pass = VK_SUCCESS == err && allocateImageMemory(device, pTableDevice, &memoryProperties, slot.image2, !slot.need2steps,
+                                                         &slot.mem2, &slot.mappedCoherent);
 
     // Create image3 and allocate its memory, if needed.
-    if (need2steps) {
-        err = pTableDevice->CreateImage(device, &imgCreateInfo3, NULL, &data.image3);
+    if (pass && slot.need2steps) {
+        err = pTableDevice->CreateImage(device, &imgCreateInfo3, NULL, &slot.image3);
         assert(!err);
-        if (VK_SUCCESS != err) return;
-        pTableDevice->GetImageMemoryRequirements(device, data.image3, &memRequirements);
-        memAllocInfo.allocationSize = memRequirements.size;
-        pInstanceTable->GetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
-        pass = memory_type_from_properties(&memoryProperties, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-                                           &memAllocInfo.memoryTypeIndex);
-        assert(pass);
-        err = pTableDevice->AllocateMemory(device, &memAllocInfo, NULL, &data.mem3);
+        pass = VK_SUCCESS == err &&
+               allocateImageMemory(device, pTableDevice, &memoryProperties, slot.image3, true, &slot.mem3, &slot.mappedCoherent);
+    }
+
+    // Map the final image once; the writer thread reads every screenshot
+    // taken with this slot through the same pointer.
+    if (pass) {
+        const VkImageSubresource sr = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0};
+        void *ptr = nullptr;
+        pTableDevice->GetImageSubresourceLayout(device, slot.need2steps ? slot.image3 : slot.image2, &sr, &slot.srLayout);
+        slot.mappedMem = slot.need2steps ? slot.mem3 : slot.mem2;
+        err = pTableDevice->MapMemory(device, slot.mappedMem, 0, VK_WHOLE_SIZE, 0, &ptr);
         assert(!err);
-        if (VK_SUCCESS != err) return;
-        err = pTableQueue->BindImageMemory(device, data.image3, data.mem3, 0);
+        pass = VK_SUCCESS == err;
+        slot.mappedPtr = static_cast<const char *>(ptr);
+    }
+    return pass;
+}
+
+static void destroyConvertPipeline(VkDevice device, VkLayerDispatchTable *pTableDevice, ReadbackRing *ring) {
+    if (ring->convertPipeline) pTableDevice->DestroyPipeline(device, ring->convertPipeline, NULL);
+    if (ring->convertPipelineLayout) pTableDevice->DestroyPipelineLayout(device, ring->convertPipelineLayout, NULL);
+    if (ring->convertSetLayout) pTableDevice->DestroyDescriptorSetLayout(device, ring->convertSetLayout, NULL);
+    if (ring->convertDescriptorPool) pTableDevice->DestroyDescriptorPool(device, ring->convertDescriptorPool, NULL);
+    if (ring->convertSampler) pTableDevice->DestroySampler(device, ring->convertSampler, NULL);
+    ring->convertPipeline = VK_NULL_HANDLE;
+    ring->convertPipelineLayout = VK_NULL_HANDLE;
+    ring->convertSetLayout = VK_NULL_HANDLE;
+    ring->convertDescriptorPool = VK_NULL_HANDLE;
+    ring->convertSampler = VK_NULL_HANDLE;
+}
+
+// Create the compute pipeline of screenshot_convert.comp and the descriptor
+// pool for the ring's slots.  The shader is only built in if glslangValidator
+// was found at build time.
+static bool createConvertPipeline(VkDevice device, VkLayerDispatchTable *pTableDevice, ReadbackRing *ring) {
+    if (ring->convertPipeline) return true;
+#ifdef SCREENSHOT_HAVE_CONVERT_SHADER
+    VkResult err;
+
+    const VkDescriptorSetLayoutBinding bindings[] = {
+        {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL},
+        {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL},
+    };
+    const VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, NULL, 0,
+                                                                 ARRAY_SIZE(bindings), bindings};
+    err = pTableDevice->CreateDescriptorSetLayout(device, &setLayoutCreateInfo, NULL, &ring->convertSetLayout);
+    assert(!err);
+    bool pass = VK_SUCCESS == err;
+
+    if (pass) {
+        const VkPushConstantRange pushConstantRange = {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ConvertParams)};
+        const VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+            VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO, NULL, 0, 1, &ring->convertSetLayout, 1, &pushConstantRange};
+        err = pTableDevice->CreatePipelineLayout(device, &pipelineLayoutCreateInfo, NULL, &ring->convertPipelineLayout);
         assert(!err);
-        if (VK_SUCCESS != err) return;
+        pass = VK_SUCCESS == err;
     }
 
-    // Set up the command buffer.  We get a command buffer from a pool we saved
-    // in a hooked function, which would be the application's pool.
-    if (deviceMap[device]->commandPools.empty()) {
-        assert(!deviceMap[device]->commandPools.empty());
-        return;
+    if (pass) {
+        VkSamplerCreateInfo samplerCreateInfo = {};
+        samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+        samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+        samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        err = pTableDevice->CreateSampler(device, &samplerCreateInfo, NULL, &ring->convertSampler);
+        assert(!err);
+        pass = VK_SUCCESS == err;
+    }
+
+    if (pass) {
+        const VkDescriptorPoolSize poolSizes[] = {
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, readbackRingSize}, {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, readbackRingSize},
+        };
+        const VkDescriptorPoolCreateInfo poolCreateInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, NULL,
+                                                           VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT, readbackRingSize,
+                                                           ARRAY_SIZE(poolSizes), poolSizes};
+        err = pTableDevice->CreateDescriptorPool(device, &poolCreateInfo, NULL, &ring->convertDescriptorPool);
+        assert(!err);
+        pass = VK_SUCCESS == err;
+    }
+
+    if (pass) {
+        const VkShaderModuleCreateInfo shaderModuleCreateInfo = {VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, NULL, 0,
+                                                                 sizeof(screenshot_convert_comp), screenshot_convert_comp};
+        VkShaderModule shaderModule;
+        err = pTableDevice->CreateShaderModule(device, &shaderModuleCreateInfo, NULL, &shaderModule);
+        assert(!err);
+        pass = VK_SUCCESS == err;
+        if (pass) {
+            const VkComputePipelineCreateInfo pipelineCreateInfo = {
+                VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                NULL,
+                0,
+                {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, NULL, 0, VK_SHADER_STAGE_COMPUTE_BIT, shaderModule, "main",
+                 NULL},
+                ring->convertPipelineLayout,
+                VK_NULL_HANDLE,
+                -1};
+            err = pTableDevice->CreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, NULL,
+                                                       &ring->convertPipeline);
+            assert(!err);
+            pass = VK_SUCCESS == err;
+            pTableDevice->DestroyShaderModule(device, shaderModule, NULL);
+        }
+    }
+
+    if (!pass) destroyConvertPipeline(device, pTableDevice, ring);
+    return pass;
+#else
+    return false;
+#endif
+}
+
+// Swapchain formats the compute shader can sample as floating point.
+static bool formatIsConvertible(VkFormat format) {
+    return FormatIsUNorm(format) || FormatIsSNorm(format) || FormatIsSRGB(format) || FormatIsFloat(format);
+}
+
+// Create the sampled copy of the swapchain image and the mapped buffer the
+// compute shader writes RGBA8 pixels into.
+static bool createConvertResources(VkDevice device, DeviceMapStruct *devMap, ReadbackRing *ring, ReadbackSlot &slot) {
+    VkLayerDispatchTable *pTableDevice = devMap->device_dispatch_table;
+    VkPhysicalDevice physicalDevice = devMap->physicalDevice;
+    VkLayerInstanceDispatchTable *pInstanceTable = instance_dispatch_table(physDeviceMap[physicalDevice]->instance);
+    uint32_t const width = slot.width;
+    uint32_t const height = slot.height;
+    VkResult err;
+
+    if (!createConvertPipeline(device, pTableDevice, ring)) return false;
+
+    // The copy is submitted to the queue the application presents on.
+    uint32_t queueFamilyCount = 0;
+    pInstanceTable->GetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, NULL);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    pInstanceTable->GetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+    if (devMap->queueFamilyIndex >= queueFamilyCount ||
+        !(queueFamilies[devMap->queueFamilyIndex].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+        return false;
     }
 
-    VkCommandPool commandPool = deviceMap[device]->commandPools.front();
+    VkFormatProperties formatProps;
+    pInstanceTable->GetPhysicalDeviceFormatProperties(physicalDevice, slot.format, &formatProps);
+    if (!(formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) return false;
+
+    // The shader writes 4 channels, in RGBA order whatever the swapchain
+    // format's channel order is.
+    slot.numChannels = 4;
+    slot.swapRedBlue = false;
+    slot.thumbnailScale = userThumbnailScale;
+    if (slot.thumbnailScale) {
+        slot.thumbnailWidth = (width + slot.thumbnailScale - 1) / slot.thumbnailScale;
+        slot.thumbnailHeight = (height + slot.thumbnailScale - 1) / slot.thumbnailScale;
+    }
+
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    pInstanceTable->GetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
 
-    const VkCommandBufferAllocateInfo allocCommandBufferInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, NULL,
-        commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1};
-    data.commandPool = commandPool;
-    err = pTableDevice->AllocateCommandBuffers(device, &allocCommandBufferInfo, &data.commandBuffer);
+    const VkImageCreateInfo imgCreateInfo = {
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        NULL,
+        0,
+        VK_IMAGE_TYPE_2D,
+        slot.format,
+        {width, height, 1},
+        1,
+        1,
+        VK_SAMPLE_COUNT_1_BIT,
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_SHARING_MODE_EXCLUSIVE,
+        0,
+        NULL,
+        VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    err = pTableDevice->CreateImage(device, &imgCreateInfo, NULL, &slot.srcImage);
     assert(!err);
-    if (VK_SUCCESS != err) return;
+    bool pass =
+        VK_SUCCESS == err && allocateImageMemory(device, pTableDevice, &memoryProperties, slot.srcImage, false, &slot.srcMem, NULL);
+
+    if (pass) {
+        const VkImageViewCreateInfo viewCreateInfo = {
+            VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            NULL,
+            0,
+            slot.srcImage,
+            VK_IMAGE_VIEW_TYPE_2D,
+            slot.format,
+            {VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
+             VK_COMPONENT_SWIZZLE_IDENTITY},
+            {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
+        err = pTableDevice->CreateImageView(device, &viewCreateInfo, NULL, &slot.srcView);
+        assert(!err);
+        pass = VK_SUCCESS == err;
+    }
 
-    VkDevice cmdBuf = static_cast<VkDevice>(static_cast<void *>(data.commandBuffer));
-    deviceMap.emplace(cmdBuf, devMap);
-    VkLayerDispatchTable *pTableCommandBuffer;
-    pTableCommandBuffer = get_dev_info(cmdBuf)->device_dispatch_table;
-
-    // We have just created a dispatchable object, but the dispatch table has
-    // not been placed in the object yet.  When a "normal" application creates
-    // a command buffer, the dispatch table is installed by the top-level api
-    // binding (trampoline.c). But here, we have to do it ourselves.
-    if (!devMap->pfn_dev_init) {
-        *((const void **)data.commandBuffer) = *(void **)device;
-    } else {
-        err = devMap->pfn_dev_init(device, (void *)data.commandBuffer);
+    VkDeviceSize const bufferSize =
+        (static_cast<VkDeviceSize>(width) * height + static_cast<VkDeviceSize>(slot.thumbnailWidth) * slot.thumbnailHeight) * 4;
+    if (pass) {
+        const VkBufferCreateInfo bufferCreateInfo = {VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                                                     NULL,
+                                                     0,
+                                                     bufferSize,
+                                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                     VK_SHARING_MODE_EXCLUSIVE,
+                                                     0,
+                                                     NULL};
+        err = pTableDevice->CreateBuffer(device, &bufferCreateInfo, NULL, &slot.buffer);
+        assert(!err);
+        pass = VK_SUCCESS == err;
+    }
+
+    if (pass) {
+        VkMemoryRequirements memRequirements;
+        pTableDevice->GetBufferMemoryRequirements(device, slot.buffer, &memRequirements);
+        pass = allocateReadbackMemory(device, pTableDevice, &memoryProperties, memRequirements, true, &slot.bufferMem,
+                                      &slot.mappedCoherent);
+        if (pass) {
+            err = pTableDevice->BindBufferMemory(device, slot.buffer, slot.bufferMem, 0);
+            assert(!err);
+            pass = VK_SUCCESS == err;
+        }
+    }
+
+    // Map the buffer once; the writer thread reads every screenshot taken
+    // with this slot through the same pointer.
+    if (pass) {
+        void *ptr = nullptr;
+        slot.mappedMem = slot.bufferMem;
+        err = pTableDevice->MapMemory(device, slot.mappedMem, 0, VK_WHOLE_SIZE, 0, &ptr);
+        assert(!err);
+        pass = VK_SUCCESS == err;
+        slot.mappedPtr = static_cast<const char *>(ptr);
+        slot.srLayout.offset = 0;
+        slot.srLayout.rowPitch = static_cast<VkDeviceSize>(width) * 4;
+    }
+
+    if (pass) {
+        const VkDescriptorSetAllocateInfo setAllocateInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, NULL,
+                                                             ring->convertDescriptorPool, 1, &ring->convertSetLayout};
+        err = pTableDevice->AllocateDescriptorSets(device, &setAllocateInfo, &slot.descriptorSet);
+        assert(!err);
+        pass = VK_SUCCESS == err;
+    }
+
+    if (pass) {
+        const VkDescriptorImageInfo imageInfo = {ring->convertSampler, slot.srcView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        const VkDescriptorBufferInfo bufferInfo = {slot.buffer, 0, bufferSize};
+        const VkWriteDescriptorSet writes[] = {
+            {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, slot.descriptorSet, 0, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+             &imageInfo, NULL, NULL},
+            {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, slot.descriptorSet, 1, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, NULL,
+             &bufferInfo, NULL},
+        };
+        pTableDevice->UpdateDescriptorSets(device, ARRAY_SIZE(writes), writes, 0, NULL);
+    }
+    return pass;
+}
+
+// Create the images, command buffer and fence of a slot for copying images
+// of the given extent and format.  On failure the slot is left empty.
+static bool createReadbackSlot(VkDevice device, DeviceMapStruct *devMap, ReadbackRing *ring, ReadbackSlot &slot, uint32_t width,
+                               uint32_t height, VkFormat format, uint32_t numChannels, VkFormat destformat, bool useConvert) {
+    VkLayerDispatchTable *pTableDevice = devMap->device_dispatch_table;
+    VkResult err;
+
+    slot.width = width;
+    slot.height = height;
+    slot.format = format;
+    slot.numChannels = numChannels;
+    slot.destformat = destformat;
+    slot.useConvert = useConvert;
+
+    bool pass = useConvert ? createConvertResources(device, devMap, ring, slot) : createBlitResources(device, devMap, slot);
+
+    if (pass) {
+        const VkCommandBufferAllocateInfo allocCommandBufferInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, NULL,
+                                                                    ring->commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1};
+        err = pTableDevice->AllocateCommandBuffers(device, &allocCommandBufferInfo, &slot.commandBuffer);
         assert(!err);
+        pass = VK_SUCCESS == err;
     }
 
+    if (pass) {
+        VkDevice cmdBuf = static_cast<VkDevice>(static_cast<void *>(slot.commandBuffer));
+        deviceMap.emplace(cmdBuf, devMap);
+
+        // We have just created a dispatchable object, but the dispatch table has
+        // not been placed in the object yet.  When a "normal" application creates
+        // a command buffer, the dispatch table is installed by the top-level api
+        // binding (trampoline.c). But here, we have to do it ourselves.
+        if (!devMap->pfn_dev_init) {
+            *((const void **)slot.commandBuffer) = *(void **)device;
+        } else {
+            err = devMap->pfn_dev_init(device, (void *)slot.commandBuffer);
+            assert(!err);
+        }
+
+        const VkFenceCreateInfo fenceCreateInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, NULL, 0};
+        err = pTableDevice->CreateFence(device, &fenceCreateInfo, NULL, &slot.fence);
+        assert(!err);
+        pass = VK_SUCCESS == err;
+    }
+
+    if (!pass) destroyReadbackSlot(device, pTableDevice, ring, slot);
+    return pass;
+}
+
+// Record the blit or copy of image1 into the slot's image(s).
+static void recordBlitCommands(VkLayerDispatchTable *pTableCommandBuffer, ReadbackSlot &slot, VkImage image1) {
+    VkResult err;
+    uint32_t const width = slot.width;
+    uint32_t const height = slot.height;
+
     const VkCommandBufferBeginInfo commandBufferBeginInfo = {
         VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
     };
-    err = pTableCommandBuffer->BeginCommandBuffer(data.commandBuffer, &commandBufferBeginInfo);
+    err = pTableCommandBuffer->BeginCommandBuffer(slot.commandBuffer, &commandBufferBeginInfo);
     assert(!err);
 
     // This barrier is used to transition from/to present Layout
@@ -730,7 +1150,8 @@ static void writePPM(const char *filename, VkImage image1) {
                                                  {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
 
     // This barrier is used to transition from a newly-created layout to a blt
-    // or copy destination layout.
+    // or copy destination layout.  The previous contents of a reused slot
+    // are not needed, so the old layout is always undefined.
     VkImageMemoryBarrier destMemoryBarrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
                                               NULL,
                                               0,
@@ -739,19 +1160,20 @@ static void writePPM(const char *filename, VkImage image1) {
                                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                                               VK_QUEUE_FAMILY_IGNORED,
                                               VK_QUEUE_FAMILY_IGNORED,
-                                              data.image2,
+                                              slot.image2,
                                               {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
 
-    // This barrier is used to transition a dest layout to general layout.
+    // This barrier is used to transition a dest layout to general layout and
+    // make the transfer visible to the host.
     VkImageMemoryBarrier generalMemoryBarrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
                                                  NULL,
                                                  VK_ACCESS_TRANSFER_WRITE_BIT,
-                                                 VK_ACCESS_TRANSFER_READ_BIT,
+                                                 VK_ACCESS_HOST_READ_BIT,
                                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                                                  VK_IMAGE_LAYOUT_GENERAL,
                                                  VK_QUEUE_FAMILY_IGNORED,
                                                  VK_QUEUE_FAMILY_IGNORED,
-                                                 data.image2,
+                                                 slot.image2,
                                                  {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
 
     VkPipelineStageFlags srcStages = VK_PIPELINE_STAGE_TRANSFER_BIT;
@@ -759,18 +1181,18 @@ static void writePPM(const char *filename, VkImage image1) {
 
     // The source image needs to be transitioned from present to transfer
     // source.
-    pTableCommandBuffer->CmdPipelineBarrier(data.commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
+    pTableCommandBuffer->CmdPipelineBarrier(slot.commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
                                             &presentMemoryBarrier);
 
     // image2 needs to be transitioned from its undefined state to transfer
     // destination.
-    pTableCommandBuffer->CmdPipelineBarrier(data.commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1, &destMemoryBarrier);
+    pTableCommandBuffer->CmdPipelineBarrier(slot.commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1, &destMemoryBarrier);
 
     const VkImageCopy imageCopyRegion = {
         {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1}, {0, 0, 0}, {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1}, {0, 0, 0}, {width, height, 1}};
 
-    if (copyOnly) {
-        pTableCommandBuffer->CmdCopyImage(data.commandBuffer, image1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, data.image2,
+    if (slot.copyOnly) {
+        pTableCommandBuffer->CmdCopyImage(slot.commandBuffer, image1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.image2,
                                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageCopyRegion);
     } else {
         VkImageBlit imageBlitRegion = {};
@@ -789,13 +1211,13 @@ static void writePPM(const char *filename, VkImage image1) {
         imageBlitRegion.dstOffsets[1].y = height;
         imageBlitRegion.dstOffsets[1].z = 1;
 
-        pTableCommandBuffer->CmdBlitImage(data.commandBuffer, image1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, data.image2,
+        pTableCommandBuffer->CmdBlitImage(slot.commandBuffer, image1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.image2,
                                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlitRegion, VK_FILTER_NEAREST);
-        if (need2steps) {
+        if (slot.need2steps) {
             // image 3 needs to be transitioned from its undefined state to a
             // transfer destination.
-            destMemoryBarrier.image = data.image3;
-            pTableCommandBuffer->CmdPipelineBarrier(data.commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
+            destMemoryBarrier.image = slot.image3;
+            pTableCommandBuffer->CmdPipelineBarrier(slot.commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
                                                     &destMemoryBarrier);
 
             // Transition image2 so that it can be read for the upcoming copy to
@@ -804,20 +1226,20 @@ static void writePPM(const char *filename, VkImage image1) {
             destMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
             destMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
             destMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            destMemoryBarrier.image = data.image2;
-            pTableCommandBuffer->CmdPipelineBarrier(data.commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
+            destMemoryBarrier.image = slot.image2;
+            pTableCommandBuffer->CmdPipelineBarrier(slot.commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
                                                     &destMemoryBarrier);
 
             // This step essentially untiles the image.
-            pTableCommandBuffer->CmdCopyImage(data.commandBuffer, data.image2, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, data.image3,
+            pTableCommandBuffer->CmdCopyImage(slot.commandBuffer, slot.image2, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.image3,
                                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageCopyRegion);
-            generalMemoryBarrier.image = data.image3;
+            generalMemoryBarrier.image = slot.image3;
         }
     }
 
     // The destination needs to be transitioned from the optimal copy format to
     // the format we can read with the CPU.
-    pTableCommandBuffer->CmdPipelineBarrier(data.commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
+    pTableCommandBuffer->CmdPipelineBarrier(slot.commandBuffer, srcStages, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 0, NULL, 1,
                                             &generalMemoryBarrier);
 
     // Restore the swap chain image layout to what it was before.
@@ -827,89 +1249,325 @@ static void writePPM(const char *filename, VkImage image1) {
     presentMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
     presentMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
     presentMemoryBarrier.dstAccessMask = 0;
-    pTableCommandBuffer->CmdPipelineBarrier(data.commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
+    pTableCommandBuffer->CmdPipelineBarrier(slot.commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
                                             &presentMemoryBarrier);
 
-    err = pTableCommandBuffer->EndCommandBuffer(data.commandBuffer);
+    err = pTableCommandBuffer->EndCommandBuffer(slot.commandBuffer);
     assert(!err);
+}
 
-    VkFence nullFence = {VK_NULL_HANDLE};
-    VkSubmitInfo submitInfo;
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.pNext = NULL;
-    submitInfo.waitSemaphoreCount = 0;
-    submitInfo.pWaitSemaphores = NULL;
-    submitInfo.pWaitDstStageMask = NULL;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &data.commandBuffer;
-    submitInfo.signalSemaphoreCount = 0;
-    submitInfo.pSignalSemaphores = NULL;
+// Record the copy of image1 into the slot's sampled image and the compute
+// dispatches converting it, and the thumbnail if any, into the slot's buffer.
+static void recordConvertCommands(VkLayerDispatchTable *pTableCommandBuffer, ReadbackRing *ring, ReadbackSlot &slot,
+                                  VkImage image1) {
+    VkResult err;
+    uint32_t const width = slot.width;
+    uint32_t const height = slot.height;
 
-    err = pTableQueue->QueueSubmit(queue, 1, &submitInfo, nullFence);
+    const VkCommandBufferBeginInfo commandBufferBeginInfo = {
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    err = pTableCommandBuffer->BeginCommandBuffer(slot.commandBuffer, &commandBufferBeginInfo);
     assert(!err);
 
-    err = pTableQueue->QueueWaitIdle(queue);
-    assert(!err);
+    // This barrier is used to transition from/to present Layout
+    VkImageMemoryBarrier presentMemoryBarrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                                                 NULL,
+                                                 VK_ACCESS_TRANSFER_WRITE_BIT,
+                                                 VK_ACCESS_TRANSFER_READ_BIT,
+                                                 VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                                 VK_QUEUE_FAMILY_IGNORED,
+                                                 VK_QUEUE_FAMILY_IGNORED,
+                                                 image1,
+                                                 {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
 
-    err = pTableDevice->DeviceWaitIdle(device);
-    assert(!err);
+    // This barrier is used to transition the sampled image to a copy
+    // destination and then to a shader resource.
+    VkImageMemoryBarrier srcMemoryBarrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                                             NULL,
+                                             0,
+                                             VK_ACCESS_TRANSFER_WRITE_BIT,
+                                             VK_IMAGE_LAYOUT_UNDEFINED,
+                                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                             VK_QUEUE_FAMILY_IGNORED,
+                                             VK_QUEUE_FAMILY_IGNORED,
+                                             slot.srcImage,
+                                             {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
+
+    VkPipelineStageFlags const transferStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    VkPipelineStageFlags const computeStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+    pTableCommandBuffer->CmdPipelineBarrier(slot.commandBuffer, transferStage, transferStage, 0, 0, NULL, 0, NULL, 1,
+                                            &presentMemoryBarrier);
+    pTableCommandBuffer->CmdPipelineBarrier(slot.commandBuffer, transferStage, transferStage, 0, 0, NULL, 0, NULL, 1,
+                                            &srcMemoryBarrier);
 
-    // Map the final image so that the CPU can read it.
-    const VkImageSubresource sr = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0};
-    VkSubresourceLayout srLayout;
-    const char *ptr;
-    if (!need2steps) {
-        pTableDevice->GetImageSubresourceLayout(device, data.image2, &sr, &srLayout);
-        err = pTableDevice->MapMemory(device, data.mem2, 0, VK_WHOLE_SIZE, 0, (void **)&ptr);
-        assert(!err);
-        if (VK_SUCCESS != err) return;
-        data.mem2mapped = true;
-    } else {
-        pTableDevice->GetImageSubresourceLayout(device, data.image3, &sr, &srLayout);
-        err = pTableDevice->MapMemory(device, data.mem3, 0, VK_WHOLE_SIZE, 0, (void **)&ptr);
-        assert(!err);
-        if (VK_SUCCESS != err) return;
-        data.mem3mapped = true;
+    // The formats are the same, so a copy is always possible.
+    const VkImageCopy imageCopyRegion = {
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1}, {0, 0, 0}, {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1}, {0, 0, 0}, {width, height, 1}};
+    pTableCommandBuffer->CmdCopyImage(slot.commandBuffer, image1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.srcImage,
+                                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageCopyRegion);
+
+    srcMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    srcMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    srcMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    srcMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    pTableCommandBuffer->CmdPipelineBarrier(slot.commandBuffer, transferStage, computeStage, 0, 0, NULL, 0, NULL, 1,
+                                            &srcMemoryBarrier);
+
+    // Restore the swap chain image layout to what it was before.
+    presentMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    presentMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    presentMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    presentMemoryBarrier.dstAccessMask = 0;
+    pTableCommandBuffer->CmdPipelineBarrier(slot.commandBuffer, transferStage, transferStage, 0, 0, NULL, 0, NULL, 1,
+                                            &presentMemoryBarrier);
+
+    pTableCommandBuffer->CmdBindPipeline(slot.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, ring->convertPipeline);
+    pTableCommandBuffer->CmdBindDescriptorSets(slot.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, ring->convertPipelineLayout, 0,
+                                               1, &slot.descriptorSet, 0, NULL);
+
+    // Sampling an sRGB format decodes it, and float formats hold linear
+    // values, so both need encoding before they are written as 8 bit sRGB.
+    ConvertParams params = {width, height, 0, 1, FormatIsSRGB(slot.format) || FormatIsFloat(slot.format) ? 1u : 0u};
+    pTableCommandBuffer->CmdPushConstants(slot.commandBuffer, ring->convertPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                          sizeof(params), &params);
+    pTableCommandBuffer->CmdDispatch(slot.commandBuffer, (width + 7) / 8, (height + 7) / 8, 1);
+
+    if (slot.thumbnailScale) {
+        params.dstWidth = slot.thumbnailWidth;
+        params.dstHeight = slot.thumbnailHeight;
+        params.dstOffset = width * height;
+        params.scale = slot.thumbnailScale;
+        pTableCommandBuffer->CmdPushConstants(slot.commandBuffer, ring->convertPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                              sizeof(params), &params);
+        pTableCommandBuffer->CmdDispatch(slot.commandBuffer, (slot.thumbnailWidth + 7) / 8, (slot.thumbnailHeight + 7) / 8, 1);
     }
 
-    // Write the data to a PPM file.
-    ofstream file(filename, ios::binary);
-    assert(file.is_open());
+    // Make the shader writes visible to the host.
+    const VkBufferMemoryBarrier bufferMemoryBarrier = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                                                       NULL,
+                                                       VK_ACCESS_SHADER_WRITE_BIT,
+                                                       VK_ACCESS_HOST_READ_BIT,
+                                                       VK_QUEUE_FAMILY_IGNORED,
+                                                       VK_QUEUE_FAMILY_IGNORED,
+                                                       slot.buffer,
+                                                       0,
+                                                       VK_WHOLE_SIZE};
+    pTableCommandBuffer->CmdPipelineBarrier(slot.commandBuffer, computeStage, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1,
+                                            &bufferMemoryBarrier, 0, NULL);
+
+    err = pTableCommandBuffer->EndCommandBuffer(slot.commandBuffer);
+    assert(!err);
+}
+
+// Write the image a slot has read back to its file.  Runs on the writer
+// thread once the slot's fence has signaled.
+static void writeScreenshot(VkDevice device, VkLayerDispatchTable *pTableDevice, const ReadbackSlot &slot) {
+    const char *filename = slot.filename.c_str();
+
+    if (!slot.mappedCoherent) {
+        const VkMappedMemoryRange range = {VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, NULL, slot.mappedMem, 0, VK_WHOLE_SIZE};
+        pTableDevice->InvalidateMappedMemoryRanges(device, 1, &range);
+    }
 
-    if (!file.is_open()) {
+    const uint8_t *pixels = reinterpret_cast<const uint8_t *>(slot.mappedPtr) + slot.srLayout.offset;
+    if (!(userThumbnailOnly && slot.thumbnailScale) &&
+        !writeScreenshotFile(filename, userFileFormat, slot.width, slot.height, pixels, slot.srLayout.rowPitch, slot.numChannels,
+                             slot.swapRedBlue)) {
 #ifdef ANDROID
         __android_log_print(ANDROID_LOG_DEBUG, "screenshot",
-                            "Failed to open output file: %s.  Be sure to grant read and write permissions.", filename);
+                            "Failed to write output file: %s.  Be sure to grant read and write permissions.", filename);
 #else
-        fprintf(stderr, "Failed to open output file:%s,  Be sure to grant read and write permissions\n", filename);
+        fprintf(stderr, "Failed to write output file:%s,  Be sure to grant read and write permissions\n", filename);
 #endif
+    }
+
+    if (slot.thumbnailScale) {
+        const uint8_t *thumbnail = reinterpret_cast<const uint8_t *>(slot.mappedPtr) + 4 * slot.width * slot.height;
+        writeScreenshotFile(slot.thumbnailFilename.c_str(), userFileFormat, slot.thumbnailWidth, slot.thumbnailHeight, thumbnail,
+                            4 * slot.thumbnailWidth, 4, false);
+    }
+}
+
+static void readbackThreadFunc() {
+    std::unique_lock<std::mutex> lock(readbackLock);
+    for (;;) {
+        readbackQueued.wait(lock, [] { return !readbackQueue.empty(); });
+        ReadbackJob job = readbackQueue.front();
+        readbackQueue.pop_front();
+        lock.unlock();
+
+        VkResult err = job.pTableDevice->WaitForFences(job.device, 1, &job.slot->fence, VK_TRUE, UINT64_MAX);
+        assert(!err);
+        if (VK_SUCCESS == err) writeScreenshot(job.device, job.pTableDevice, *job.slot);
+
+        lock.lock();
+        job.slot->busy = false;
+        readbackDone.notify_all();
+    }
+}
+
+// Wait until the writer thread has finished with every slot of a ring.
+static void waitForReadbackRing(ReadbackRing *ring) {
+    std::unique_lock<std::mutex> lock(readbackLock);
+    readbackDone.wait(lock, [ring] {
+        for (uint32_t i = 0; i < readbackRingSize; i++) {
+            if (ring->slots[i].busy) return false;
+        }
+        return true;
+    });
+}
+
+static void destroyReadbackRing(VkDevice device, DeviceMapStruct *devMap) {
+    ReadbackRing *ring = devMap->readbackRing;
+    if (!ring) return;
+    waitForReadbackRing(ring);
+    for (uint32_t i = 0; i < readbackRingSize; i++) {
+        destroyReadbackSlot(device, devMap->device_dispatch_table, ring, ring->slots[i]);
+    }
+    destroyConvertPipeline(device, devMap->device_dispatch_table, ring);
+    devMap->device_dispatch_table->DestroyCommandPool(device, ring->commandPool, NULL);
+    delete ring;
+    devMap->readbackRing = nullptr;
+}
+
+// Take a screenshot of image1 into filename.
+//
+// This function records and submits the commands that copy/convert the
+// swapchain image from whatever compatible format the swapchain image uses
+// to a single format (e.g. VK_FORMAT_R8G8B8A8_UNORM) so that the converted
+// result can be easily written to an image file.  It does not wait for the copy:
+// the writer thread waits on the slot's fence and writes the file, so the
+// present thread only stalls when every slot of the ring is still pending.
+//
+// Error handling: If there is a problem, this function should silently
+// fail without affecting the Present operation going on in the caller.
+// The numerous debug asserts are to catch programming errors and are not
+// expected to assert.  Recovery and clean up are implemented for image memory
+// allocation failures.
+// (TODO) It would be nice to pass any failure info to DebugReport or something.
+static void takeScreenshot(const char *filename, VkImage image1) {
+    VkResult err;
+
+    // Bail immediately if we can't find the image.
+    if (imageMap.empty() || imageMap.find(image1) == imageMap.end()) return;
+
+    // Collect object info from maps.  This info is generally recorded
+    // by the other functions hooked in this layer.
+    VkDevice device = imageMap[image1]->device;
+    DeviceMapStruct *devMap = get_dev_info(device);
+    if (NULL == devMap) {
+        assert(0);
         return;
     }
+    VkQueue queue = devMap->queue;
+    VkLayerDispatchTable *pTableDevice = devMap->device_dispatch_table;
 
-    file << "P6\n";
-    file << width << "\n";
-    file << height << "\n";
-    file << 255 << "\n";
+    // Gather incoming image info and check image format for compatibility with
+    // the target format.
+    // This function supports both 24-bit and 32-bit swapchain images.
+    uint32_t const width = imageMap[image1]->imageExtent.width;
+    uint32_t const height = imageMap[image1]->imageExtent.height;
+    VkFormat const format = imageMap[image1]->format;
+    uint32_t const numChannels = FormatChannelCount(format);
 
-    ptr += srLayout.offset;
-    if (3 == numChannels) {
-        for (uint32_t y = 0; y < height; y++) {
-            file.write(ptr, 3 * width);
-            ptr += srLayout.rowPitch;
+    if ((3 != numChannels) && (4 != numChannels)) {
+        assert(0);
+        return;
+    }
+
+    if (!devMap->readbackRing) {
+        const VkCommandPoolCreateInfo commandPoolCreateInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, NULL,
+                                                               VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+                                                               devMap->queueFamilyIndex};
+        VkCommandPool commandPool;
+        err = pTableDevice->CreateCommandPool(device, &commandPoolCreateInfo, NULL, &commandPool);
+        assert(!err);
+        if (VK_SUCCESS != err) return;
+        devMap->readbackRing = new ReadbackRing();
+        devMap->readbackRing->commandPool = commandPool;
+    }
+    ReadbackRing *ring = devMap->readbackRing;
+
+    // Formats that are not 8 bits per channel, such as HDR float swapchains,
+    // cannot be blitted to a format the CPU can write directly, so they go
+    // through the compute shader.  Thumbnails always need it.
+    bool const useConvert = !ring->convertFailed && formatIsConvertible(format) &&
+                            (userGpuConvert || userThumbnailScale || FormatSize(format) != numChannels);
+    VkFormat const destformat = useConvert ? VK_FORMAT_R8G8B8A8_UNORM : getDestFormat(format, numChannels);
+    if (destformat == VK_FORMAT_UNDEFINED) {
+        assert(0);
+        return;
+    }
+
+    // Slots are used in order, so files are written in frame order.  If the
+    // next one is still pending, wait for the writer thread to finish it.
+    ReadbackSlot &slot = ring->slots[ring->next];
+    {
+        std::unique_lock<std::mutex> lock(readbackLock);
+        if (!readbackThreadStarted) {
+            std::thread(readbackThreadFunc).detach();
+            readbackThreadStarted = true;
         }
-    } else if (4 == numChannels) {
-        for (uint32_t y = 0; y < height; y++) {
-            const unsigned int *row = (const unsigned int *)ptr;
-            for (uint32_t x = 0; x < width; x++) {
-                file.write((char *)row, 3);
-                row++;
-            }
-            ptr += srLayout.rowPitch;
+        readbackDone.wait(lock, [&slot] { return !slot.busy; });
+    }
+    ring->next = (ring->next + 1) % readbackRingSize;
+
+    if (slot.commandBuffer && (slot.width != width || slot.height != height || slot.format != format ||
+                               slot.destformat != destformat || slot.useConvert != useConvert)) {
+        destroyReadbackSlot(device, pTableDevice, ring, slot);
+    }
+    if (!slot.commandBuffer &&
+        !createReadbackSlot(device, devMap, ring, slot, width, height, format, numChannels, destformat, useConvert)) {
+        if (useConvert) {
+            // Stay on the blit/copy path from the next frame on.
+            ring->convertFailed = true;
+#ifndef ANDROID
+            fprintf(stderr, "Screenshot compute conversion is not available, blit/copy will be used instead\n");
+#endif
         }
+        return;
+    }
+
+    VkLayerDispatchTable *pTableCommandBuffer =
+        get_dev_info(static_cast<VkDevice>(static_cast<void *>(slot.commandBuffer)))->device_dispatch_table;
+    if (slot.useConvert) {
+        recordConvertCommands(pTableCommandBuffer, ring, slot, image1);
+    } else {
+        recordBlitCommands(pTableCommandBuffer, slot, image1);
     }
-    file.close();
 
-    // Clean up handled by ~WritePPMCleanupData()
+    err = pTableDevice->ResetFences(device, 1, &slot.fence);
+    assert(!err);
+
+    VkSubmitInfo submitInfo;
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = NULL;
+    submitInfo.waitSemaphoreCount = 0;
+    submitInfo.pWaitSemaphores = NULL;
+    submitInfo.pWaitDstStageMask = NULL;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &slot.commandBuffer;
+    submitInfo.signalSemaphoreCount = 0;
+    submitInfo.pSignalSemaphores = NULL;
+
+    VkLayerDispatchTable *pTableQueue = get_dev_info(static_cast<VkDevice>(static_cast<void *>(queue)))->device_dispatch_table;
+    err = pTableQueue->QueueSubmit(queue, 1, &submitInfo, slot.fence);
+    assert(!err);
+    if (VK_SUCCESS != err) return;
+
+    slot.filename = filename;
+    if (slot.thumbnailScale) {
+        slot.thumbnailFilename = filename;
+        size_t dot = slot.thumbnailFilename.rfind('.');
+        slot.thumbnailFilename.insert(dot == string::npos ? slot.thumbnailFilename.size() : dot, "_thumbnail");
+    }
+    std::lock_guard<std::mutex> lock(readbackLock);
+    slot.busy = true;
+    readbackQueue.push_back({device, pTableDevice, &slot});
+    readbackQueued.notify_one();
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL CreateInstance(const VkInstanceCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
@@ -986,6 +1644,7 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateDevice(VkPhysicalDevice gpu, const VkDevice
     createDeviceRegisterExtensions(pCreateInfo, *pDevice);
     // Create a mapping from a device to a physicalDevice
     deviceMapElem->physicalDevice = gpu;
+    deviceMapElem->readbackRing = nullptr;
 
     // store the loader callback for initializing created dispatchable objects
     chain_info = get_chain_info(pCreateInfo, VK_LOADER_DATA_CALLBACK);
@@ -1020,6 +1679,13 @@ VKAPI_ATTR void VKAPI_CALL DestroyDevice(VkDevice device, const VkAllocationCall
     DeviceMapStruct *devMap = get_dev_info(device);
     assert(devMap);
     VkLayerDispatchTable *pDisp = devMap->device_dispatch_table;
+
+    // Let the writer thread finish any screenshots still pending on this
+    // device before its resources go away.
+    loader_platform_thread_lock_mutex(&globalLock);
+    destroyReadbackRing(device, devMap);
+    loader_platform_thread_unlock_mutex(&globalLock);
+
     pDisp->DestroyDevice(device, pAllocator);
 
     local_free_getenv(vk_screenshot_format);
@@ -1050,51 +1716,10 @@ VKAPI_ATTR void VKAPI_CALL GetDeviceQueue(VkDevice device, uint32_t queueNodeInd
 
     // Create a mapping from a device to a queue
     devMap->queue = *pQueue;
+    devMap->queueFamilyIndex = queueNodeIndex;
     loader_platform_thread_unlock_mutex(&globalLock);
 }
 
-VKAPI_ATTR VkResult VKAPI_CALL CreateCommandPool(VkDevice device, const VkCommandPoolCreateInfo *pCreateInfo,
-                                                 const VkAllocationCallbacks *pAllocator, VkCommandPool *pCommandPool) {
-    DeviceMapStruct *devMap = get_dev_info(device);
-    assert(devMap);
-    VkLayerDispatchTable *pDisp = devMap->device_dispatch_table;
-    VkResult result = pDisp->CreateCommandPool(device, pCreateInfo, pAllocator, pCommandPool);
-
-    // Save the command pool on a map if we are taking screenshots.
-    loader_platform_thread_lock_mutex(&globalLock);
-    if (screenshotFramesReceived && screenshotFrames.empty() && !screenShotFrameRange.valid) {
-        // No screenshots in the list to take
-        loader_platform_thread_unlock_mutex(&globalLock);
-        return result;
-    }
-
-    // Create a mapping from a device to a commandPool
-    devMap->commandPools.push_front(*pCommandPool);
-    loader_platform_thread_unlock_mutex(&globalLock);
-    return result;
-}
-
-VKAPI_ATTR void VKAPI_CALL DestroyCommandPool(VkDevice device, VkCommandPool commandPool, const VkAllocationCallbacks *pAllocator) {
-    DeviceMapStruct *devMap = get_dev_info(device);
-    assert(devMap);
-    VkLayerDispatchTable *pDisp = devMap->device_dispatch_table;
-    pDisp->DestroyCommandPool(device, commandPool, pAllocator);
-
-    // Remove the command pool from the map if we are taking screenshots.
-    loader_platform_thread_lock_mutex(&globalLock);
-    if (screenshotFramesReceived && screenshotFrames.empty() && !screenShotFrameRange.valid) {
-        // No screenshots in the list to take
-        loader_platform_thread_unlock_mutex(&globalLock);
-        return;
-    }
-
-    // Remove the commandPool from the device mapping
-    devMap->commandPools.remove(commandPool);
-    loader_platform_thread_unlock_mutex(&globalLock);
-    return;
-}
-
-
 VKAPI_ATTR VkResult VKAPI_CALL CreateSwapchainKHR(VkDevice device, const VkSwapchainCreateInfoKHR *pCreateInfo,
                                                   const VkAllocationCallbacks *pAllocator, VkSwapchainKHR *pSwapchain) {
     DeviceMapStruct *devMap = get_dev_info(device);
@@ -1220,9 +1845,9 @@ VKAPI_ATTR VkResult VKAPI_CALL QueuePresentKHR(VkQueue queue, const VkPresentInf
             char buffer[64];
             snprintf(buffer, sizeof(buffer), "/sdcard/Android/%d", frameNumber);
             std::string base(buffer);
-            fileName = base + ".ppm";
+            fileName = base + "." + screenshotFileExtension(userFileFormat);
 #else
-            fileName = to_string(frameNumber) + ".ppm";
+            fileName = to_string(frameNumber) + "." + screenshotFileExtension(userFileFormat);
             printf("Screen Capture file is: %s \n", fileName.c_str());
 #endif
 
@@ -1231,7 +1856,7 @@ VKAPI_ATTR VkResult VKAPI_CALL QueuePresentKHR(VkQueue queue, const VkPresentInf
             // We'll dump only one image: the first
             swapchain = pPresentInfo->pSwapchains[0];
             image = swapchainMap[swapchain]->imageList[pPresentInfo->pImageIndices[0]];
-            writePPM(fileName.c_str(), image);
+            takeScreenshot(fileName.c_str(), image);
             if (inScreenShotFrames) {
                 screenshotFrames.erase(it);
             }
@@ -1367,8 +1992,6 @@ static PFN_vkVoidFunction intercept_core_device_command(const char *name) {
     } core_device_commands[] = {
         {"vkGetDeviceProcAddr", reinterpret_cast<PFN_vkVoidFunction>(GetDeviceProcAddr)},
         {"vkGetDeviceQueue", reinterpret_cast<PFN_vkVoidFunction>(GetDeviceQueue)},
-        {"vkCreateCommandPool", reinterpret_cast<PFN_vkVoidFunction>(CreateCommandPool)},
-        {"vkDestroyCommandPool", reinterpret_cast<PFN_vkVoidFunction>(DestroyCommandPool)},
         {"vkDestroyDevice", reinterpret_cast<PFN_vkVoidFunction>(DestroyDevice)},
     };
 
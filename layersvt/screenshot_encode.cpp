@@ -0,0 +1,373 @@
+/*
+* Copyright (C) 2015-2016 LunarG, Inc.
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "screenshot_encode.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SCREENSHOT_USE_SSSE3 1
+#include <tmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SCREENSHOT_TARGET_SSSE3
+#else
+#define SCREENSHOT_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SCREENSHOT_USE_NEON 1
+#include <arm_neon.h>
+#endif
+
+using namespace std;
+
+namespace screenshot {
+
+bool parseScreenshotFileFormat(const char *name, ScreenshotFileFormat *pFileFormat) {
+    if (!strcmp(name, "PPM")) {
+        *pFileFormat = SCREENSHOT_FILE_FORMAT_PPM;
+    } else if (!strcmp(name, "QOI")) {
+        *pFileFormat = SCREENSHOT_FILE_FORMAT_QOI;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char *screenshotFileExtension(ScreenshotFileFormat fileFormat) {
+    switch (fileFormat) {
+        case SCREENSHOT_FILE_FORMAT_QOI:
+            return "qoi";
+        case SCREENSHOT_FILE_FORMAT_PPM:
+        default:
+            return "ppm";
+    }
+}
+
+static void convertRowToRGB8Scalar(const uint8_t *src, uint8_t *dst, uint32_t width, uint32_t srcChannels, bool swapRedBlue) {
+    if (3 == srcChannels && !swapRedBlue) {
+        memcpy(dst, src, 3 * width);
+        return;
+    }
+    const uint32_t r = swapRedBlue ? 2 : 0;
+    const uint32_t b = swapRedBlue ? 0 : 2;
+    for (uint32_t x = 0; x < width; x++) {
+        dst[0] = src[r];
+        dst[1] = src[1];
+        dst[2] = src[b];
+        src += srcChannels;
+        dst += 3;
+    }
+}
+
+#if defined(SCREENSHOT_USE_SSSE3)
+static bool cpuHasSSSE3() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 9)) != 0;
+#else
+    return __builtin_cpu_supports("ssse3") != 0;
+#endif
+}
+
+// Four RGBA pixels per shuffle.  Each 16 byte store writes 12 bytes of
+// output and 4 bytes that the next store overwrites, so the loop stops
+// early enough for the last store to stay inside the row.
+SCREENSHOT_TARGET_SSSE3 static uint32_t convertRowToRGB8SSSE3(const uint8_t *src, uint8_t *dst, uint32_t width,
+                                                              bool swapRedBlue) {
+    const __m128i shuffle = swapRedBlue ? _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)
+                                        : _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    uint32_t x = 0;
+    for (; x + 6 <= width; x += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 4 * x));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 3 * x), _mm_shuffle_epi8(pixels, shuffle));
+    }
+    return x;
+}
+#endif
+
+#if defined(SCREENSHOT_USE_NEON)
+static uint32_t convertRowToRGB8NEON(const uint8_t *src, uint8_t *dst, uint32_t width, bool swapRedBlue) {
+    uint32_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x4_t rgba = vld4q_u8(src + 4 * x);
+        uint8x16x3_t rgb;
+        rgb.val[0] = swapRedBlue ? rgba.val[2] : rgba.val[0];
+        rgb.val[1] = rgba.val[1];
+        rgb.val[2] = swapRedBlue ? rgba.val[0] : rgba.val[2];
+        vst3q_u8(dst + 3 * x, rgb);
+    }
+    return x;
+}
+#endif
+
+void convertRowToRGB8(const uint8_t *src, uint8_t *dst, uint32_t width, uint32_t srcChannels, bool swapRedBlue) {
+    uint32_t done = 0;
+    if (4 == srcChannels) {
+#if defined(SCREENSHOT_USE_SSSE3)
+        static const bool hasSSSE3 = cpuHasSSSE3();
+        if (hasSSSE3) done = convertRowToRGB8SSSE3(src, dst, width, swapRedBlue);
+#elif defined(SCREENSHOT_USE_NEON)
+        done = convertRowToRGB8NEON(src, dst, width, swapRedBlue);
+#endif
+    }
+    convertRowToRGB8Scalar(src + srcChannels * done, dst + 3 * done, width - done, srcChannels, swapRedBlue);
+}
+
+// QOI ops, following the specification at https://qoiformat.org.
+enum { QOI_OP_INDEX = 0x00, QOI_OP_DIFF = 0x40, QOI_OP_LUMA = 0x80, QOI_OP_RUN = 0xc0, QOI_OP_RGB = 0xfe, QOI_OP_RGBA = 0xff };
+
+static inline uint32_t qoiHash(uint8_t r, uint8_t g, uint8_t b, uint8_t a) { return (r * 3 + g * 5 + b * 7 + a * 11) % 64; }
+
+// QOI encoder.  Only RGB images are written, so alpha is always 255 and the
+// RGBA op is never needed.
+class QOIEncoder {
+   public:
+    QOIEncoder() : run(0), prevR(0), prevG(0), prevB(0) { memset(index, 0, sizeof(index)); }
+
+    void header(vector<uint8_t> &out, uint32_t width, uint32_t height) {
+        const uint8_t magic[] = {'q', 'o', 'i', 'f'};
+        out.insert(out.end(), magic, magic + sizeof(magic));
+        put32(out, width);
+        put32(out, height);
+        out.push_back(3);  // channels
+        out.push_back(0);  // sRGB with linear alpha
+    }
+
+    void encodeRow(vector<uint8_t> &out, const uint8_t *rgb, uint32_t width) {
+        for (uint32_t x = 0; x < width; x++, rgb += 3) {
+            const uint8_t r = rgb[0], g = rgb[1], b = rgb[2];
+            if (r == prevR && g == prevG && b == prevB) {
+                if (++run == 62) flushRun(out);
+                continue;
+            }
+            flushRun(out);
+
+            const uint32_t hash = qoiHash(r, g, b, 255);
+            if (index[hash][0] == r && index[hash][1] == g && index[hash][2] == b && index[hash][3] == 255) {
+                out.push_back(QOI_OP_INDEX | hash);
+            } else {
+                index[hash][0] = r;
+                index[hash][1] = g;
+                index[hash][2] = b;
+                index[hash][3] = 255;
+
+                const int8_t vr = static_cast<int8_t>(r - prevR);
+                const int8_t vg = static_cast<int8_t>(g - prevG);
+                const int8_t vb = static_cast<int8_t>(b - prevB);
+                const int8_t vgR = static_cast<int8_t>(vr - vg);
+                const int8_t vgB = static_cast<int8_t>(vb - vg);
+                if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                    out.push_back(QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+                } else if (vgR > -9 && vgR < 8 && vg > -33 && vg < 32 && vgB > -9 && vgB < 8) {
+                    out.push_back(QOI_OP_LUMA | (vg + 32));
+                    out.push_back((vgR + 8) << 4 | (vgB + 8));
+                } else {
+                    out.push_back(QOI_OP_RGB);
+                    out.push_back(r);
+                    out.push_back(g);
+                    out.push_back(b);
+                }
+            }
+            prevR = r;
+            prevG = g;
+            prevB = b;
+        }
+    }
+
+    void finish(vector<uint8_t> &out) {
+        flushRun(out);
+        const uint8_t padding[] = {0, 0, 0, 0, 0, 0, 0, 1};
+        out.insert(out.end(), padding, padding + sizeof(padding));
+    }
+
+   private:
+    static void put32(vector<uint8_t> &out, uint32_t value) {
+        out.push_back(static_cast<uint8_t>(value >> 24));
+        out.push_back(static_cast<uint8_t>(value >> 16));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    void flushRun(vector<uint8_t> &out) {
+        if (run > 0) {
+            out.push_back(QOI_OP_RUN | (run - 1));
+            run = 0;
+        }
+    }
+
+    uint32_t run;
+    uint8_t prevR, prevG, prevB;
+    uint8_t index[64][4];
+};
+
+bool writeScreenshotFile(const char *filename, ScreenshotFileFormat fileFormat, uint32_t width, uint32_t height,
+                         const uint8_t *pixels, size_t rowPitch, uint32_t srcChannels, bool swapRedBlue) {
+    // Written under another name and renamed when complete, so that readers
+    // waiting for the file never see part of it.
+    const string partFilename = string(filename) + ".part";
+    ofstream file(partFilename.c_str(), ios::binary);
+    if (!file.is_open()) return false;
+
+    vector<uint8_t> row(3 * width);
+    if (SCREENSHOT_FILE_FORMAT_QOI == fileFormat) {
+        // Encoded rows are collected and written in large chunks.
+        static const size_t flushSize = 1 << 20;
+        vector<uint8_t> out;
+        out.reserve(flushSize + 4 * row.size());
+        QOIEncoder encoder;
+        encoder.header(out, width, height);
+        for (uint32_t y = 0; y < height; y++) {
+            convertRowToRGB8(pixels, row.data(), width, srcChannels, swapRedBlue);
+            encoder.encodeRow(out, row.data(), width);
+            if (out.size() >= flushSize) {
+                file.write(reinterpret_cast<const char *>(out.data()), out.size());
+                out.clear();
+            }
+            pixels += rowPitch;
+        }
+        encoder.finish(out);
+        file.write(reinterpret_cast<const char *>(out.data()), out.size());
+    } else {
+        file << "P6\n";
+        file << width << "\n";
+        file << height << "\n";
+        file << 255 << "\n";
+        for (uint32_t y = 0; y < height; y++) {
+            convertRowToRGB8(pixels, row.data(), width, srcChannels, swapRedBlue);
+            file.write(reinterpret_cast<const char *>(row.data()), row.size());
+            pixels += rowPitch;
+        }
+    }
+    file.close();
+    if (file.fail()) {
+        remove(partFilename.c_str());
+        return false;
+    }
+#if defined(_WIN32)
+    // rename doesn't replace an existing file on Windows.
+    remove(filename);
+#endif
+    return rename(partFilename.c_str(), filename) == 0;
+}
+
+static bool readPPM(const vector<uint8_t> &data, uint32_t *pWidth, uint32_t *pHeight, vector<uint8_t> *pPixels) {
+    // "P6", width, height and maximum value separated by whitespace and
+    // comments, then a single whitespace character before the pixels.
+    size_t pos = 2;
+    uint32_t values[3] = {0, 0, 0};
+    for (int i = 0; i < 3; i++) {
+        for (;;) {
+            while (pos < data.size() && isspace(data[pos])) pos++;
+            if (pos >= data.size() || data[pos] != '#') break;
+            while (pos < data.size() && data[pos] != '\n') pos++;
+        }
+        if (pos >= data.size() || !isdigit(data[pos])) return false;
+        while (pos < data.size() && isdigit(data[pos]) && values[i] < 0x10000000) {
+            values[i] = values[i] * 10 + (data[pos++] - '0');
+        }
+    }
+    if (values[2] != 255 || pos >= data.size() || !isspace(data[pos])) return false;
+    pos++;
+
+    const uint64_t size = 3ull * values[0] * values[1];
+    if (data.size() - pos < size) return false;
+    *pWidth = values[0];
+    *pHeight = values[1];
+    pPixels->assign(data.begin() + pos, data.begin() + pos + (size_t)size);
+    return true;
+}
+
+static bool readQOI(const vector<uint8_t> &data, uint32_t *pWidth, uint32_t *pHeight, vector<uint8_t> *pPixels) {
+    static const size_t headerSize = 14;
+    if (data.size() < headerSize) return false;
+    const uint32_t width = (uint32_t)data[4] << 24 | (uint32_t)data[5] << 16 | (uint32_t)data[6] << 8 | data[7];
+    const uint32_t height = (uint32_t)data[8] << 24 | (uint32_t)data[9] << 16 | (uint32_t)data[10] << 8 | data[11];
+    // Every op encodes at least one pixel, except runs which encode up to 62.
+    const uint64_t pixelCount = (uint64_t)width * height;
+    if (pixelCount > 62ull * data.size()) return false;
+
+    pPixels->resize((size_t)(3 * pixelCount));
+    uint8_t *dst = pPixels->data();
+    uint8_t index[64][4];
+    memset(index, 0, sizeof(index));
+    uint8_t r = 0, g = 0, b = 0, a = 255;
+    size_t pos = headerSize;
+    uint32_t run = 0;
+    for (uint64_t i = 0; i < pixelCount; i++) {
+        if (run > 0) {
+            run--;
+        } else {
+            if (pos >= data.size()) return false;
+            const uint8_t op = data[pos++];
+            if (QOI_OP_RGB == op || QOI_OP_RGBA == op) {
+                const size_t channels = QOI_OP_RGB == op ? 3 : 4;
+                if (data.size() - pos < channels) return false;
+                r = data[pos];
+                g = data[pos + 1];
+                b = data[pos + 2];
+                if (4 == channels) a = data[pos + 3];
+                pos += channels;
+            } else if (QOI_OP_INDEX == (op & 0xc0)) {
+                r = index[op][0];
+                g = index[op][1];
+                b = index[op][2];
+                a = index[op][3];
+            } else if (QOI_OP_DIFF == (op & 0xc0)) {
+                r += ((op >> 4) & 3) - 2;
+                g += ((op >> 2) & 3) - 2;
+                b += (op & 3) - 2;
+            } else if (QOI_OP_LUMA == (op & 0xc0)) {
+                if (pos >= data.size()) return false;
+                const int vg = (op & 0x3f) - 32;
+                const uint8_t next = data[pos++];
+                r += vg + ((next >> 4) & 0x0f) - 8;
+                g += vg;
+                b += vg + (next & 0x0f) - 8;
+            } else {
+                run = op & 0x3f;
+            }
+            const uint32_t hash = qoiHash(r, g, b, a);
+            index[hash][0] = r;
+            index[hash][1] = g;
+            index[hash][2] = b;
+            index[hash][3] = a;
+        }
+        dst[0] = r;
+        dst[1] = g;
+        dst[2] = b;
+        dst += 3;
+    }
+    *pWidth = width;
+    *pHeight = height;
+    return true;
+}
+
+bool readScreenshotFile(const char *filename, uint32_t *pWidth, uint32_t *pHeight, vector<uint8_t> *pPixels) {
+    ifstream file(filename, ios::binary);
+    if (!file.is_open()) return false;
+    vector<uint8_t> data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    if (data.size() >= 4 && !memcmp(data.data(), "qoif", 4)) return readQOI(data, pWidth, pHeight, pPixels);
+    if (data.size() >= 2 && !memcmp(data.data(), "P6", 2)) return readPPM(data, pWidth, pHeight, pPixels);
+    return false;
+}
+}
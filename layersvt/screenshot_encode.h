@@ -0,0 +1,52 @@
+/*
+* Copyright (C) 2015-2016 LunarG, Inc.
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace screenshot {
+
+// File formats a screenshot can be written in.
+typedef enum ScreenshotFileFormat {
+    SCREENSHOT_FILE_FORMAT_PPM = 0,  // binary PPM (P6), uncompressed
+    SCREENSHOT_FILE_FORMAT_QOI = 1,  // "Quite OK Image" format, lossless and cheap to encode
+} ScreenshotFileFormat;
+
+// parse the name of a file format ("PPM" or "QOI", case sensitive).
+// return:
+//      true and set *pFileFormat if the name is known, otherwise false.
+bool parseScreenshotFileFormat(const char *name, ScreenshotFileFormat *pFileFormat);
+
+// file name extension for a file format, without the dot.
+const char *screenshotFileExtension(ScreenshotFileFormat fileFormat);
+
+// convert one row of 8 bit pixels with srcChannels (3 or 4) channels to tightly packed RGB,
+// swapping the red and blue channels if swapRedBlue is set. Alpha is dropped.
+// Uses SSSE3 or NEON when available.
+void convertRowToRGB8(const uint8_t *src, uint8_t *dst, uint32_t width, uint32_t srcChannels, bool swapRedBlue);
+
+// write an image with 8 bit channels to filename in the given file format.
+// pixels points to the first row, rows are rowPitch bytes apart and each pixel has srcChannels (3 or 4) channels.
+// return:
+//      false if the file could not be written.
+bool writeScreenshotFile(const char *filename, ScreenshotFileFormat fileFormat, uint32_t width, uint32_t height,
+                         const uint8_t *pixels, size_t rowPitch, uint32_t srcChannels, bool swapRedBlue);
+
+// read an image written by writeScreenshotFile, in either file format, into tightly packed RGB with 8 bit channels.
+// return:
+//      false if the file could not be read or is not a PPM (P6) or QOI file.
+bool readScreenshotFile(const char *filename, uint32_t *pWidth, uint32_t *pHeight, std::vector<uint8_t> *pPixels);
+}
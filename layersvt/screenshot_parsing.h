@@ -14,6 +14,8 @@
 * limitations under the License.
 */
 
+#pragma once
+
 #include <string.h>
 #include <assert.h>
 #include <iostream>
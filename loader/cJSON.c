@@ -242,27 +242,13 @@ static unsigned parse_hex4(const char *str) {
     return h;
 }
 
-/* Parse the input text into an unescaped cstring, and populate item. */
+/* Unescape the string starting after the opening quote at ptr into ptr2,
+ * which must have room for the raw length of the string plus a terminator.
+ * Returns a pointer to the closing quote (or terminator) of the input. */
 static const unsigned char firstByteMark[7] = {0x00, 0x00, 0xC0, 0xE0, 0xF0, 0xF8, 0xFC};
-static const char *parse_string(cJSON *item, const char *str) {
-    const char *ptr = str + 1;
-    char *ptr2;
-    char *out;
-    int len = 0;
+static const char *unescape_string(const char *ptr, char *ptr2) {
+    int len;
     unsigned uc, uc2;
-    if (*str != '\"') {
-        ep = str;
-        return 0;
-    } /* not a string! */
-
-    while (*ptr != '\"' && *ptr && ++len)
-        if (*ptr++ == '\\') ptr++; /* Skip escaped quotes. */
-
-    out = (char *)cJSON_malloc(len + 1); /* This is how long we need for the string, roughly. */
-    if (!out) return 0;
-
-    ptr = str + 1;
-    ptr2 = out;
     while (*ptr != '\"' && *ptr) {
         if (*ptr != '\\')
             *ptr2++ = *ptr++;
@@ -331,6 +317,26 @@ static const char *parse_string(cJSON *item, const char *str) {
         }
     }
     *ptr2 = 0;
+    return ptr;
+}
+
+/* Parse the input text into an unescaped cstring, and populate item. */
+static const char *parse_string(cJSON *item, const char *str) {
+    const char *ptr = str + 1;
+    char *out;
+    int len = 0;
+    if (*str != '\"') {
+        ep = str;
+        return 0;
+    } /* not a string! */
+
+    while (*ptr != '\"' && *ptr && ++len)
+        if (*ptr++ == '\\') ptr++; /* Skip escaped quotes. */
+
+    out = (char *)cJSON_malloc(len + 1); /* This is how long we need for the string, roughly. */
+    if (!out) return 0;
+
+    ptr = unescape_string(str + 1, out);
     if (*ptr == '\"') ptr++;
     item->valuestring = out;
     item->type = cJSON_String;
@@ -471,6 +477,159 @@ cJSON *cJSON_ParseWithOpts(const char *value, const char **return_parse_end, int
 /* Default options for cJSON_Parse */
 cJSON *cJSON_Parse(const char *value) { return cJSON_ParseWithOpts(value, 0, 0); }
 
+/* Compact parsing: the nodes and the unescaped strings of the tree share one
+ * block.  The text is walked twice, once to size the block and once to fill
+ * it, so a tree costs a single allocation instead of one or two per value. */
+typedef struct {
+    cJSON *nodes; /* NULL while sizing */
+    char *strings;
+    size_t node_count;
+    size_t string_bytes;
+    cJSON scratch; /* written to while sizing */
+} compact_block;
+
+static cJSON *compact_new_item(compact_block *b) {
+    cJSON *item = b->nodes ? &b->nodes[b->node_count] : &b->scratch;
+    b->node_count++;
+    return item;
+}
+
+static const char *compact_parse_string(compact_block *b, char **out, const char *str) {
+    const char *ptr = str + 1;
+    size_t len = 0;
+    if (*str != '\"') {
+        ep = str;
+        return 0;
+    } /* not a string! */
+
+    while (*ptr != '\"' && *ptr && ++len)
+        if (*ptr++ == '\\') ptr++; /* Skip escaped quotes. */
+
+    if (b->nodes) {
+        *out = b->strings + b->string_bytes;
+        unescape_string(str + 1, *out);
+    }
+    b->string_bytes += len + 1;
+    if (*ptr == '\"') ptr++;
+    return ptr;
+}
+
+static const char *compact_parse_value(compact_block *b, cJSON *item, const char *value);
+
+static const char *compact_parse_array(compact_block *b, cJSON *item, const char *value) {
+    cJSON *child;
+    item->type = cJSON_Array;
+    value = skip(value + 1);
+    if (*value == ']') return value + 1; /* empty array. */
+
+    item->child = child = compact_new_item(b);
+    value = skip(compact_parse_value(b, child, skip(value)));
+    if (!value) return 0;
+
+    while (*value == ',') {
+        cJSON *new_item = compact_new_item(b);
+        child->next = new_item;
+        new_item->prev = child;
+        child = new_item;
+        value = skip(compact_parse_value(b, child, skip(value + 1)));
+        if (!value) return 0;
+    }
+
+    if (*value == ']') return value + 1; /* end of array */
+    ep = value;
+    return 0; /* malformed. */
+}
+
+/* Parse one "name": value pair of an object into item. */
+static const char *compact_parse_member(compact_block *b, cJSON *item, const char *value) {
+    value = skip(compact_parse_string(b, &item->string, skip(value)));
+    if (!value) return 0;
+    if (*value != ':') {
+        ep = value;
+        return 0;
+    } /* fail! */
+    return skip(compact_parse_value(b, item, skip(value + 1)));
+}
+
+static const char *compact_parse_object(compact_block *b, cJSON *item, const char *value) {
+    cJSON *child;
+    item->type = cJSON_Object;
+    value = skip(value + 1);
+    if (*value == '}') return value + 1; /* empty object. */
+
+    item->child = child = compact_new_item(b);
+    value = compact_parse_member(b, child, value);
+    if (!value) return 0;
+
+    while (*value == ',') {
+        cJSON *new_item = compact_new_item(b);
+        child->next = new_item;
+        new_item->prev = child;
+        child = new_item;
+        value = compact_parse_member(b, child, value + 1);
+        if (!value) return 0;
+    }
+
+    if (*value == '}') return value + 1; /* end of object */
+    ep = value;
+    return 0; /* malformed. */
+}
+
+static const char *compact_parse_value(compact_block *b, cJSON *item, const char *value) {
+    if (!value) return 0; /* Fail on null. */
+    if (!strncmp(value, "null", 4)) {
+        item->type = cJSON_NULL;
+        return value + 4;
+    }
+    if (!strncmp(value, "false", 5)) {
+        item->type = cJSON_False;
+        return value + 5;
+    }
+    if (!strncmp(value, "true", 4)) {
+        item->type = cJSON_True;
+        item->valueint = 1;
+        return value + 4;
+    }
+    if (*value == '\"') {
+        item->type = cJSON_String;
+        return compact_parse_string(b, &item->valuestring, value);
+    }
+    if (*value == '-' || (*value >= '0' && *value <= '9')) {
+        return parse_number(item, value);
+    }
+    if (*value == '[') {
+        return compact_parse_array(b, item, value);
+    }
+    if (*value == '{') {
+        return compact_parse_object(b, item, value);
+    }
+
+    ep = value;
+    return 0; /* failure. */
+}
+
+cJSON *cJSON_ParseCompact(const char *value) {
+    compact_block b;
+    size_t nodes_size;
+    char *block;
+
+    memset(&b, 0, sizeof(b));
+    ep = 0;
+    if (!compact_parse_value(&b, compact_new_item(&b), skip(value))) return 0; /* parse failure. ep is set. */
+
+    nodes_size = b.node_count * sizeof(cJSON);
+    block = (char *)cJSON_malloc(nodes_size + b.string_bytes);
+    if (!block) return 0; /* memory fail */
+    memset(block, 0, nodes_size);
+
+    b.nodes = (cJSON *)block;
+    b.strings = block + nodes_size;
+    b.node_count = 0;
+    b.string_bytes = 0;
+    compact_parse_value(&b, compact_new_item(&b), skip(value));
+    return b.nodes;
+}
+
 /* Render a cJSON item/entity/structure to text. */
 char *cJSON_Print(cJSON *item) { return print_value(item, 0, 1, 0); }
 char *cJSON_PrintUnformatted(cJSON *item) { return print_value(item, 0, 0, 0); }
@@ -152,6 +152,11 @@ The item->next and ->prev pointers are always zero on return from Duplicate. */
  * terminated, and to retrieve the pointer to the final byte parsed. */
 extern cJSON *cJSON_ParseWithOpts(const char *value, const char **return_parse_end, int require_null_terminated);
 
+/* ParseCompact builds a read-only tree whose nodes and strings share a single
+ * allocation.  Release it with cJSON_Free, never with cJSON_Delete, and don't
+ * add, detach or replace items in it. */
+extern cJSON *cJSON_ParseCompact(const char *value);
+
 extern void cJSON_Minify(char *json);
 
 /* Macros for creating things quickly. */
@@ -40,6 +40,108 @@ static const VkExtensionProperties debug_report_extension_info = {
     .extensionName = VK_EXT_DEBUG_REPORT_EXTENSION_NAME, .specVersion = VK_EXT_DEBUG_REPORT_SPEC_VERSION,
 };
 
+// Messages are dispatched from a copy of the callback list, so they don't take
+// loader_lock and threads reporting at the same time don't wait on each other.
+// The list is still changed with loader_lock held, and each change publishes a
+// new copy.  A replaced copy can't be freed while a thread may still be reading
+// it, so it's retired, and retired copies are freed once a change sees no
+// thread reading, or when the instance is destroyed.
+//
+// Readers count themselves under the current epoch.  Destroying a callback
+// starts a new epoch and waits for the readers of the old one, so the callback
+// is not called anymore once vkDestroyDebugReportCallbackEXT returns.  The wait
+// is done without loader_lock, since a callback may call into the loader.
+struct loader_dbg_callback_array {
+    struct loader_dbg_callback_array *next_retired;
+    uint32_t count;
+    VkLayerDbgFunctionNode *callbacks;
+};
+
+// Number of messages the thread is dispatching in each epoch, so that a
+// callback destroying a callback doesn't wait for itself
+static THREAD_LOCAL_DECL uint32_t tls_dbg_callback_reads[2];
+
+static void free_retired_callback_arrays(struct loader_instance *inst) {
+    struct loader_dbg_callback_array *array = inst->retired_dbg_callbacks;
+    while (array) {
+        struct loader_dbg_callback_array *next = array->next_retired;
+        loader_instance_heap_free(inst, array);
+        array = next;
+    }
+    inst->retired_dbg_callbacks = NULL;
+}
+
+// Publishes a copy of DbgFunctionHead, must be called with loader_lock held.
+// Returns false if the copy can't be allocated, in which case messages go to
+// no callback until the next change is published.
+static bool publish_callback_array(struct loader_instance *inst) {
+    struct loader_dbg_callback_array *array = NULL;
+    uint32_t count = 0;
+    bool result = true;
+
+    for (VkLayerDbgFunctionNode *pTrav = inst->DbgFunctionHead; pTrav; pTrav = pTrav->pNext) {
+        count++;
+    }
+    if (count > 0) {
+        array = (struct loader_dbg_callback_array *)loader_instance_heap_alloc(
+            inst, sizeof(struct loader_dbg_callback_array) + count * sizeof(VkLayerDbgFunctionNode),
+            VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
+        if (array) {
+            array->next_retired = NULL;
+            array->count = count;
+            array->callbacks = (VkLayerDbgFunctionNode *)(array + 1);
+            uint32_t i = 0;
+            for (VkLayerDbgFunctionNode *pTrav = inst->DbgFunctionHead; pTrav; pTrav = pTrav->pNext) {
+                array->callbacks[i] = *pTrav;
+                array->callbacks[i].pNext = NULL;
+                i++;
+            }
+        } else {
+            result = false;
+        }
+    }
+
+    struct loader_dbg_callback_array *old =
+        (struct loader_dbg_callback_array *)loader_platform_atomic_exchange_ptr((void **)&inst->dbg_callbacks, array);
+    if (old) {
+        old->next_retired = inst->retired_dbg_callbacks;
+        inst->retired_dbg_callbacks = old;
+    }
+    // Readers count themselves before loading the pointer, so none of them can
+    // pick up a retired copy once the count is seen at zero after the exchange
+    if (loader_platform_atomic_load_u32(&inst->dbg_callback_readers[0]) == 0 &&
+        loader_platform_atomic_load_u32(&inst->dbg_callback_readers[1]) == 0) {
+        free_retired_callback_arrays(inst);
+    }
+    return result;
+}
+
+// Starts a new epoch for the readers, must be called with loader_lock held
+// after publishing a change.  Returns the old epoch.
+static uint32_t begin_callback_epoch(struct loader_instance *inst) {
+    uint32_t epoch = inst->dbg_callback_epoch;
+    loader_platform_atomic_store_u32(&inst->dbg_callback_epoch, epoch ^ 1);
+    return epoch;
+}
+
+// Waits until no other thread is dispatching a message in the given epoch,
+// must be called without loader_lock held.  A thread that counted itself in
+// the epoch after it ended loads the new copy, so waiting for it is harmless.
+static void wait_for_callback_epoch(struct loader_instance *inst, uint32_t epoch) {
+    while (loader_platform_atomic_load_u32(&inst->dbg_callback_readers[epoch]) > tls_dbg_callback_reads[epoch]) {
+        loader_platform_thread_yield();
+    }
+}
+
+void util_FreeDebugReportCallbackArrays(struct loader_instance *inst) {
+    struct loader_dbg_callback_array *array =
+        (struct loader_dbg_callback_array *)loader_platform_atomic_exchange_ptr((void **)&inst->dbg_callbacks, NULL);
+    if (array) {
+        loader_instance_heap_free(inst, array);
+    }
+    free_retired_callback_arrays(inst);
+}
+
 void debug_report_add_instance_extensions(const struct loader_instance *inst, struct loader_extension_list *ext_list) {
     loader_add_to_ext_list(inst, ext_list, 1, &debug_report_extension_info);
 }
@@ -82,6 +184,11 @@ VkResult util_CreateDebugReportCallback(struct loader_instance *inst, VkDebugRep
     pNewDbgFuncNode->pNext = inst->DbgFunctionHead;
     inst->DbgFunctionHead = pNewDbgFuncNode;
 
+    if (!publish_callback_array(inst)) {
+        util_DestroyDebugReportCallback(inst, callback, pAllocator);
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
     return VK_SUCCESS;
 }
 
@@ -99,15 +206,27 @@ debug_report_CreateDebugReportCallbackEXT(VkInstance instance, const VkDebugRepo
 VkBool32 util_DebugReportMessage(const struct loader_instance *inst, VkFlags msgFlags, VkDebugReportObjectTypeEXT objectType,
                                  uint64_t srcObject, size_t location, int32_t msgCode, const char *pLayerPrefix, const char *pMsg) {
     VkBool32 bail = false;
-    VkLayerDbgFunctionNode *pTrav = inst->DbgFunctionHead;
-    while (pTrav) {
-        if (pTrav->msgFlags & msgFlags) {
-            if (pTrav->pfnMsgCallback(msgFlags, objectType, srcObject, location, msgCode, pLayerPrefix, pMsg, pTrav->pUserData)) {
-                bail = true;
+    // The reader counts are the only state a message changes, so the instance
+    // stays const to callers
+    uint32_t epoch = loader_platform_atomic_load_u32((uint32_t *)&inst->dbg_callback_epoch);
+    uint32_t *readers = (uint32_t *)&inst->dbg_callback_readers[epoch];
+    loader_platform_atomic_increment_u32(readers);
+    tls_dbg_callback_reads[epoch]++;
+    const struct loader_dbg_callback_array *array =
+        (const struct loader_dbg_callback_array *)loader_platform_atomic_load_ptr((void *const *)&inst->dbg_callbacks);
+    if (array) {
+        for (uint32_t i = 0; i < array->count; i++) {
+            const VkLayerDbgFunctionNode *pCallback = &array->callbacks[i];
+            if (pCallback->msgFlags & msgFlags) {
+                if (pCallback->pfnMsgCallback(msgFlags, objectType, srcObject, location, msgCode, pLayerPrefix, pMsg,
+                                              pCallback->pUserData)) {
+                    bail = true;
+                }
             }
         }
-        pTrav = pTrav->pNext;
     }
+    tls_dbg_callback_reads[epoch]--;
+    loader_platform_atomic_decrement_u32(readers);
 
     return bail;
 }
@@ -121,6 +240,7 @@ void util_DestroyDebugReportCallback(struct loader_instance *inst, VkDebugReport
         if (pTrav->msgCallback == callback) {
             pPrev->pNext = pTrav->pNext;
             if (inst->DbgFunctionHead == pTrav) inst->DbgFunctionHead = pTrav->pNext;
+            publish_callback_array(inst);
 #if (DEBUG_DISABLE_APP_ALLOCATORS == 1)
             {
 #else
@@ -259,8 +379,12 @@ static VKAPI_ATTR void VKAPI_CALL debug_report_DestroyDebugReportCallbackEXT(VkI
     inst->disp->layer_inst_disp.DestroyDebugReportCallbackEXT(instance, callback, pAllocator);
 
     util_DestroyDebugReportCallback(inst, callback, pAllocator);
+    uint32_t epoch = begin_callback_epoch(inst);
 
     loader_platform_thread_unlock_mutex(&loader_lock);
+
+    // The application may free pUserData once this returns
+    wait_for_callback_epoch(inst, epoch);
 }
 
 static VKAPI_ATTR void VKAPI_CALL debug_report_DebugReportMessageEXT(VkInstance instance, VkDebugReportFlagsEXT flags,
@@ -285,6 +409,9 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateDebugReportCallbackEXT(VkInstanc
     uint32_t storage_idx;
     VkLayerDbgFunctionNode *pNewDbgFuncNode = NULL;
 
+    // The callback holds a handle for each ICD, so the ICDs must exist first
+    loader_create_pending_icd_instances(inst);
+
 #if (DEBUG_DISABLE_APP_ALLOCATORS == 1)
     {
 #else
@@ -347,6 +474,13 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateDebugReportCallbackEXT(VkInstanc
     *(VkDebugReportCallbackEXT **)pCallback = icd_info;
     pNewDbgFuncNode->msgCallback = *pCallback;
 
+    if (!publish_callback_array(inst)) {
+        inst->DbgFunctionHead = pNewDbgFuncNode->pNext;
+        publish_callback_array(inst);
+        res = VK_ERROR_OUT_OF_HOST_MEMORY;
+        goto out;
+    }
+
 out:
 
     // Roll back on errors
@@ -435,12 +569,12 @@ VKAPI_ATTR void VKAPI_CALL terminator_DebugReportMessageEXT(VkInstance instance,
         }
     }
 
+    loader_platform_thread_unlock_mutex(&loader_lock);
+
     // Now that all ICDs have seen the message, call the necessary callbacks.  Ignoring "bail" return value
-    // as there is nothing to bail from at this point.
+    // as there is nothing to bail from at this point.  They don't need loader_lock.
 
     util_DebugReportMessage(inst, flags, objType, object, location, msgCode, pLayerPrefix, pMsg);
-
-    loader_platform_thread_unlock_mutex(&loader_lock);
 }
 
 bool debug_report_instance_gpa(struct loader_instance *ptr_instance, const char *name, void **addr) {
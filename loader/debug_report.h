@@ -123,6 +123,10 @@ VkResult util_CreateDebugReportCallback(struct loader_instance *inst, VkDebugRep
 void util_DestroyDebugReportCallback(struct loader_instance *inst, VkDebugReportCallbackEXT callback,
                                      const VkAllocationCallbacks *pAllocator);
 
+// Frees the copies of the callback list messages are dispatched from, once no
+// thread can report through the instance anymore
+void util_FreeDebugReportCallbackArrays(struct loader_instance *inst);
+
 VkResult util_CopyDebugReportCreateInfos(const void *pChain, const VkAllocationCallbacks *pAllocator, uint32_t *num_callbacks,
                                          VkDebugReportCallbackCreateInfoEXT **infos, VkDebugReportCallbackEXT **callbacks);
 void util_FreeDebugReportCreateInfos(const VkAllocationCallbacks *pAllocator, VkDebugReportCallbackCreateInfoEXT *infos,
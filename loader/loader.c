@@ -46,6 +46,7 @@
 #include "vulkan/vk_icd.h"
 #include "cJSON.h"
 #include "murmurhash.h"
+#include "vk_timeline.h"
 
 #if defined(_WIN32)
 #include <Cfgmgr32.h>
@@ -81,6 +82,7 @@ enum loader_debug {
     LOADER_PERF_BIT = 0x04,
     LOADER_ERROR_BIT = 0x08,
     LOADER_DEBUG_BIT = 0x10,
+    LOADER_TIMING_BIT = 0x20,
 };
 
 uint32_t g_loader_debug = 0;
@@ -91,6 +93,8 @@ uint32_t g_loader_log_msgs = 0;
 // additionally CreateDevice and DestroyDevice needs to be locked
 loader_platform_thread_mutex loader_lock;
 loader_platform_thread_mutex loader_json_lock;
+loader_platform_thread_mutex loader_icd_create_lock;
+loader_platform_thread_mutex loader_ext_table_lock;
 
 LOADER_PLATFORM_THREAD_ONCE_DECLARATION(once_init);
 
@@ -383,6 +387,40 @@ void loader_log(const struct loader_instance *inst, VkFlags msg_type, int32_t ms
     fputc('\n', stderr);
 }
 
+// Timings go to the timeline (see vk_timeline.h), which VK_LOADER_TRACE_FILE can point at a file of its own
+uint64_t loader_trace_begin(void) {
+    if (0 == (g_loader_debug & LOADER_TIMING_BIT) && !vk_timeline_enabled()) {
+        return 0;
+    }
+    uint64_t now = vk_timeline_now();
+    return now ? now : 1;
+}
+
+void loader_trace_end(const struct loader_instance *inst, uint64_t start, const char *phase, const char *format, ...) {
+    char name[256];
+    va_list ap;
+    int ret;
+
+    if (0 == start) {
+        return;
+    }
+    uint64_t end = vk_timeline_now();
+
+    va_start(ap, format);
+    ret = vsnprintf(name, sizeof(name), format, ap);
+    if ((ret >= (int)sizeof(name)) || ret < 0) {
+        name[sizeof(name) - 1] = '\0';
+    }
+    va_end(ap);
+
+    if (0 != (g_loader_debug & LOADER_TIMING_BIT)) {
+        loader_log(inst, VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT, 0, "Timing: %s %s took %.3f ms", phase, name,
+                   (end - start) / 1000000.0);
+    }
+
+    vk_timeline_zone(phase, name, start, end);
+}
+
 VKAPI_ATTR VkResult VKAPI_CALL vkSetInstanceDispatch(VkInstance instance, void *object) {
     struct loader_instance *inst = loader_get_instance(instance);
     if (!inst) {
@@ -1439,6 +1477,110 @@ static VkExtensionProperties *get_dev_extension_property(const char *name, const
     return NULL;
 }
 
+// Instance extensions of ICD libraries, cached for the life of the loader so that
+// creating an instance does not need to open ICD libraries that were already
+// queried.  Entries are keyed by the library file and checked against its size
+// and modification time.  The cache is guarded by loader_json_lock and uses the
+// system allocator, like the manifest cache.
+struct loader_icd_ext_cache_entry {
+    char *lib_name;
+    uint64_t size;
+    uint64_t mtime;
+    uint32_t count;
+    VkExtensionProperties *list;
+};
+
+static struct {
+    struct loader_icd_ext_cache_entry *entries;
+    uint32_t count;
+    uint32_t capacity;
+} loader_icd_ext_cache;
+
+static struct loader_icd_ext_cache_entry *loader_icd_ext_cache_find(const char *lib_name) {
+    for (uint32_t i = 0; i < loader_icd_ext_cache.count; i++) {
+        if (!strcmp(loader_icd_ext_cache.entries[i].lib_name, lib_name)) {
+            return &loader_icd_ext_cache.entries[i];
+        }
+    }
+    return NULL;
+}
+
+static void loader_icd_ext_cache_store(const char *lib_name, uint64_t size, uint64_t mtime, const struct loader_extension_list *icd_exts) {
+    struct loader_icd_ext_cache_entry *entry = loader_icd_ext_cache_find(lib_name);
+    if (NULL == entry) {
+        if (loader_icd_ext_cache.count == loader_icd_ext_cache.capacity) {
+            uint32_t new_capacity = loader_icd_ext_cache.capacity ? 2 * loader_icd_ext_cache.capacity : 4;
+            struct loader_icd_ext_cache_entry *new_entries =
+                loader_instance_heap_realloc(NULL, loader_icd_ext_cache.entries,
+                                             loader_icd_ext_cache.capacity * sizeof(struct loader_icd_ext_cache_entry),
+                                             new_capacity * sizeof(struct loader_icd_ext_cache_entry), VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
+            if (NULL == new_entries) {
+                return;
+            }
+            loader_icd_ext_cache.entries = new_entries;
+            loader_icd_ext_cache.capacity = new_capacity;
+        }
+        char *name_copy = loader_instance_heap_alloc(NULL, strlen(lib_name) + 1, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
+        if (NULL == name_copy) {
+            return;
+        }
+        strcpy(name_copy, lib_name);
+        entry = &loader_icd_ext_cache.entries[loader_icd_ext_cache.count++];
+        memset(entry, 0, sizeof(*entry));
+        entry->lib_name = name_copy;
+    }
+
+    VkExtensionProperties *list = NULL;
+    if (icd_exts->count > 0) {
+        list = loader_instance_heap_alloc(NULL, icd_exts->count * sizeof(VkExtensionProperties), VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
+        if (NULL == list) {
+            // Leave the entry unusable rather than out of date
+            entry->size = entry->mtime = 0;
+            return;
+        }
+        memcpy(list, icd_exts->list, icd_exts->count * sizeof(VkExtensionProperties));
+    }
+    loader_instance_heap_free(NULL, entry->list);
+    entry->list = list;
+    entry->count = icd_exts->count;
+    entry->size = size;
+    entry->mtime = mtime;
+}
+
+// Add the instance extensions of one ICD to icd_exts, from the cache if the
+// library was queried before.  Otherwise the library is loaded and queried.
+//     @return  VK_ERROR_INCOMPATIBLE_DRIVER if the ICD library can't be used
+static VkResult loader_get_icd_instance_extensions(const struct loader_instance *inst, struct loader_scanned_icd *scanned_icd,
+                                                   struct loader_extension_list *icd_exts) {
+    uint64_t size = 0, mtime = 0;
+    VkResult res;
+
+    // Libraries given without a path are found by the dynamic linker, and
+    // there is no file to check the cache against.
+    bool cacheable = loader_platform_file_info(scanned_icd->lib_name, &size, &mtime);
+    if (cacheable) {
+        loader_platform_thread_lock_mutex(&loader_json_lock);
+        const struct loader_icd_ext_cache_entry *entry = loader_icd_ext_cache_find(scanned_icd->lib_name);
+        if (NULL != entry && entry->size == size && entry->mtime == mtime) {
+            res = loader_add_to_ext_list(inst, icd_exts, entry->count, entry->list);
+            loader_platform_thread_unlock_mutex(&loader_json_lock);
+            return res;
+        }
+        loader_platform_thread_unlock_mutex(&loader_json_lock);
+    }
+
+    if (!loader_scanned_icd_load(inst, scanned_icd)) {
+        return VK_ERROR_INCOMPATIBLE_DRIVER;
+    }
+    res = loader_add_instance_extensions(inst, scanned_icd->EnumerateInstanceExtensionProperties, scanned_icd->lib_name, icd_exts);
+    if (VK_SUCCESS == res && cacheable) {
+        loader_platform_thread_lock_mutex(&loader_json_lock);
+        loader_icd_ext_cache_store(scanned_icd->lib_name, size, mtime, icd_exts);
+        loader_platform_thread_unlock_mutex(&loader_json_lock);
+    }
+    return res;
+}
+
 // For Instance extensions implemented within the loader (i.e. DEBUG_REPORT
 // the extension must provide two entry points for the loader to use:
 // - "trampoline" entry point - this is the address returned by GetProcAddr
@@ -1480,9 +1622,11 @@ VkResult loader_get_icd_loader_instance_extensions(const struct loader_instance
         if (VK_SUCCESS != res) {
             goto out;
         }
-        res = loader_add_instance_extensions(inst, icd_tramp_list->scanned_list[i].EnumerateInstanceExtensionProperties,
-                                             icd_tramp_list->scanned_list[i].lib_name, &icd_exts);
-        if (VK_SUCCESS == res) {
+        res = loader_get_icd_instance_extensions(inst, &icd_tramp_list->scanned_list[i], &icd_exts);
+        if (VK_ERROR_INCOMPATIBLE_DRIVER == res) {
+            // The ICD library couldn't be loaded, so it is skipped
+            res = VK_SUCCESS;
+        } else if (VK_SUCCESS == res) {
             if (filter_extensions) {
                 // Remove any extensions not recognized by the loader
                 for (int32_t j = 0; j < (int32_t)icd_exts.count; j++) {
@@ -1690,7 +1834,9 @@ bool loader_get_icd_interface_version(PFN_vkNegotiateLoaderICDInterfaceVersion f
 void loader_scanned_icd_clear(const struct loader_instance *inst, struct loader_icd_tramp_list *icd_tramp_list) {
     if (0 != icd_tramp_list->capacity) {
         for (uint32_t i = 0; i < icd_tramp_list->count; i++) {
-            loader_platform_close_library(icd_tramp_list->scanned_list[i].handle);
+            if (NULL != icd_tramp_list->scanned_list[i].handle) {
+                loader_platform_close_library(icd_tramp_list->scanned_list[i].handle);
+            }
             loader_instance_heap_free(inst, icd_tramp_list->scanned_list[i].lib_name);
         }
         loader_instance_heap_free(inst, icd_tramp_list->scanned_list);
@@ -1714,35 +1860,85 @@ static VkResult loader_scanned_icd_init(const struct loader_instance *inst, stru
     return err;
 }
 
+// Record an ICD found by loader_icd_scan.  The library itself is only opened
+// when it is first needed, see loader_scanned_icd_load.
 static VkResult loader_scanned_icd_add(const struct loader_instance *inst, struct loader_icd_tramp_list *icd_tramp_list,
                                        const char *filename, uint32_t api_version) {
+    struct loader_scanned_icd *new_scanned_icd;
+    VkResult res = VK_SUCCESS;
+
+    // check for enough capacity
+    if ((icd_tramp_list->count * sizeof(struct loader_scanned_icd)) >= icd_tramp_list->capacity) {
+        void *new_ptr = loader_instance_heap_realloc(inst, icd_tramp_list->scanned_list, icd_tramp_list->capacity,
+                                                     icd_tramp_list->capacity * 2, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
+        if (NULL == new_ptr) {
+            res = VK_ERROR_OUT_OF_HOST_MEMORY;
+            loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
+                       "loader_scanned_icd_add: Realloc failed on icd library list for ICD %s", filename);
+            goto out;
+        }
+        icd_tramp_list->scanned_list = new_ptr;
+
+        // double capacity
+        icd_tramp_list->capacity *= 2;
+    }
+
+    new_scanned_icd = &(icd_tramp_list->scanned_list[icd_tramp_list->count]);
+    memset(new_scanned_icd, 0, sizeof(struct loader_scanned_icd));
+    new_scanned_icd->api_version = api_version;
+
+    new_scanned_icd->lib_name = (char *)loader_instance_heap_alloc(inst, strlen(filename) + 1, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
+    if (NULL == new_scanned_icd->lib_name) {
+        loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0, "loader_scanned_icd_add: Out of memory can't add ICD %s", filename);
+        res = VK_ERROR_OUT_OF_HOST_MEMORY;
+        goto out;
+    }
+    strcpy(new_scanned_icd->lib_name, filename);
+    icd_tramp_list->count++;
+
+out:
+
+    return res;
+}
+
+// Open the library of a scanned ICD and look up its entry points, unless that
+// was already tried.
+//     @return  true if the ICD library is loaded and usable
+bool loader_scanned_icd_load(const struct loader_instance *inst, struct loader_scanned_icd *scanned_icd) {
     loader_platform_dl_handle handle;
     PFN_vkCreateInstance fp_create_inst;
     PFN_vkEnumerateInstanceExtensionProperties fp_get_inst_ext_props;
     PFN_vkGetInstanceProcAddr fp_get_proc_addr;
     PFN_GetPhysicalDeviceProcAddr fp_get_phys_dev_proc_addr = NULL;
     PFN_vkNegotiateLoaderICDInterfaceVersion fp_negotiate_icd_version;
-    struct loader_scanned_icd *new_scanned_icd;
     uint32_t interface_vers;
-    VkResult res = VK_SUCCESS;
+    const char *filename = scanned_icd->lib_name;
 
-    // TODO implement smarter opening/closing of libraries. For now this
-    // function leaves libraries open and the scanned_icd_clear closes them
+    if (scanned_icd->load_attempted) {
+        return NULL != scanned_icd->handle;
+    }
+    scanned_icd->load_attempted = true;
+
+    // The library stays open until loader_scanned_icd_clear closes it
+    uint64_t trace_start = loader_trace_begin();
     handle = loader_platform_open_library(filename);
+    loader_trace_end(inst, trace_start, "open", "ICD library %s", filename);
     if (NULL == handle) {
         loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0, loader_platform_open_library_error(filename));
-        goto out;
+        return false;
     }
 
+    trace_start = loader_trace_begin();
+
     // Get and settle on an ICD interface version
     fp_negotiate_icd_version = loader_platform_get_proc_address(handle, "vk_icdNegotiateLoaderICDInterfaceVersion");
 
     if (!loader_get_icd_interface_version(fp_negotiate_icd_version, &interface_vers)) {
         loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
-                   "loader_scanned_icd_add: ICD %s doesn't support interface"
+                   "loader_scanned_icd_load: ICD %s doesn't support interface"
                    " version compatible with loader, skip this ICD.",
                    filename);
-        goto out;
+        goto fail;
     }
 
     fp_get_proc_addr = loader_platform_get_proc_address(handle, "vk_icdGetInstanceProcAddr");
@@ -1752,14 +1948,14 @@ static VkResult loader_scanned_icd_add(const struct loader_instance *inst, struc
         fp_get_proc_addr = loader_platform_get_proc_address(handle, "vkGetInstanceProcAddr");
         if (NULL == fp_get_proc_addr) {
             loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
-                       "loader_scanned_icd_add: Attempt to retrieve either "
+                       "loader_scanned_icd_load: Attempt to retrieve either "
                        "\'vkGetInstanceProcAddr\' or "
                        "\'vk_icdGetInstanceProcAddr\' from ICD %s failed.",
                        filename);
-            goto out;
+            goto fail;
         } else {
             loader_log(inst, VK_DEBUG_REPORT_WARNING_BIT_EXT, 0,
-                       "loader_scanned_icd_add: Using deprecated ICD "
+                       "loader_scanned_icd_load: Using deprecated ICD "
                        "interface of \'vkGetInstanceProcAddr\' instead of "
                        "\'vk_icdGetInstanceProcAddr\' for ICD %s",
                        filename);
@@ -1767,20 +1963,20 @@ static VkResult loader_scanned_icd_add(const struct loader_instance *inst, struc
         fp_create_inst = loader_platform_get_proc_address(handle, "vkCreateInstance");
         if (NULL == fp_create_inst) {
             loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
-                       "loader_scanned_icd_add:  Failed querying "
+                       "loader_scanned_icd_load:  Failed querying "
                        "\'vkCreateInstance\' via dlsym/loadlibrary for "
                        "ICD %s",
                        filename);
-            goto out;
+            goto fail;
         }
         fp_get_inst_ext_props = loader_platform_get_proc_address(handle, "vkEnumerateInstanceExtensionProperties");
         if (NULL == fp_get_inst_ext_props) {
             loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
-                       "loader_scanned_icd_add: Could not get \'vkEnumerate"
+                       "loader_scanned_icd_load: Could not get \'vkEnumerate"
                        "InstanceExtensionProperties\' via dlsym/loadlibrary "
                        "for ICD %s",
                        filename);
-            goto out;
+            goto fail;
         }
     } else {
         // Use newer interface version 1 or later
@@ -1791,62 +1987,40 @@ static VkResult loader_scanned_icd_add(const struct loader_instance *inst, struc
         fp_create_inst = (PFN_vkCreateInstance)fp_get_proc_addr(NULL, "vkCreateInstance");
         if (NULL == fp_create_inst) {
             loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
-                       "loader_scanned_icd_add: Could not get "
+                       "loader_scanned_icd_load: Could not get "
                        "\'vkCreateInstance\' via \'vk_icdGetInstanceProcAddr\'"
                        " for ICD %s",
                        filename);
-            goto out;
+            goto fail;
         }
         fp_get_inst_ext_props =
             (PFN_vkEnumerateInstanceExtensionProperties)fp_get_proc_addr(NULL, "vkEnumerateInstanceExtensionProperties");
         if (NULL == fp_get_inst_ext_props) {
             loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
-                       "loader_scanned_icd_add: Could not get \'vkEnumerate"
+                       "loader_scanned_icd_load: Could not get \'vkEnumerate"
                        "InstanceExtensionProperties\' via "
                        "\'vk_icdGetInstanceProcAddr\' for ICD %s",
                        filename);
-            goto out;
+            goto fail;
         }
         fp_get_phys_dev_proc_addr = loader_platform_get_proc_address(handle, "vk_icdGetPhysicalDeviceProcAddr");
     }
 
-    // check for enough capacity
-    if ((icd_tramp_list->count * sizeof(struct loader_scanned_icd)) >= icd_tramp_list->capacity) {
-        void *new_ptr = loader_instance_heap_realloc(inst, icd_tramp_list->scanned_list, icd_tramp_list->capacity,
-                                                     icd_tramp_list->capacity * 2, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
-        if (NULL == new_ptr) {
-            res = VK_ERROR_OUT_OF_HOST_MEMORY;
-            loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
-                       "loader_scanned_icd_add: Realloc failed on icd library list for ICD %s", filename);
-            goto out;
-        }
-        icd_tramp_list->scanned_list = new_ptr;
+    loader_trace_end(inst, trace_start, "negotiate", "ICD library %s (interface version %u)", filename, interface_vers);
 
-        // double capacity
-        icd_tramp_list->capacity *= 2;
-    }
-
-    new_scanned_icd = &(icd_tramp_list->scanned_list[icd_tramp_list->count]);
-    new_scanned_icd->handle = handle;
-    new_scanned_icd->api_version = api_version;
-    new_scanned_icd->GetInstanceProcAddr = fp_get_proc_addr;
-    new_scanned_icd->GetPhysicalDeviceProcAddr = fp_get_phys_dev_proc_addr;
-    new_scanned_icd->EnumerateInstanceExtensionProperties = fp_get_inst_ext_props;
-    new_scanned_icd->CreateInstance = fp_create_inst;
-    new_scanned_icd->interface_version = interface_vers;
-
-    new_scanned_icd->lib_name = (char *)loader_instance_heap_alloc(inst, strlen(filename) + 1, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
-    if (NULL == new_scanned_icd->lib_name) {
-        loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0, "loader_scanned_icd_add: Out of memory can't add ICD %s", filename);
-        res = VK_ERROR_OUT_OF_HOST_MEMORY;
-        goto out;
-    }
-    strcpy(new_scanned_icd->lib_name, filename);
-    icd_tramp_list->count++;
+    scanned_icd->handle = handle;
+    scanned_icd->GetInstanceProcAddr = fp_get_proc_addr;
+    scanned_icd->GetPhysicalDeviceProcAddr = fp_get_phys_dev_proc_addr;
+    scanned_icd->EnumerateInstanceExtensionProperties = fp_get_inst_ext_props;
+    scanned_icd->CreateInstance = fp_create_inst;
+    scanned_icd->interface_version = interface_vers;
+    return true;
 
-out:
+fail:
 
-    return res;
+    loader_trace_end(inst, trace_start, "negotiate", "ICD library %s (failed)", filename);
+    loader_platform_close_library(handle);
+    return false;
 }
 
 static void loader_debug_init(void) {
@@ -1886,6 +2060,9 @@ static void loader_debug_init(void) {
             } else if (strncmp(env, "debug", len) == 0) {
                 g_loader_debug |= LOADER_DEBUG_BIT;
                 g_loader_log_msgs |= VK_DEBUG_REPORT_DEBUG_BIT_EXT;
+            } else if (strncmp(env, "timing", len) == 0) {
+                g_loader_debug |= LOADER_TIMING_BIT;
+                g_loader_log_msgs |= VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT;
             }
         }
 
@@ -1895,12 +2072,20 @@ static void loader_debug_init(void) {
     }
 
     loader_free_getenv(orig, NULL);
+
+    char *trace_path = loader_secure_getenv("VK_LOADER_TRACE_FILE", NULL);
+    if (NULL != trace_path && '\0' != trace_path[0]) {
+        vk_timeline_open(trace_path);
+    }
+    loader_free_getenv(trace_path, NULL);
 }
 
 void loader_initialize(void) {
     // initialize mutexs
     loader_platform_thread_create_mutex(&loader_lock);
     loader_platform_thread_create_mutex(&loader_json_lock);
+    loader_platform_thread_create_mutex(&loader_icd_create_lock);
+    loader_platform_thread_create_mutex(&loader_ext_table_lock);
 
     // initialize logging
     loader_debug_init();
@@ -1977,15 +2162,214 @@ static void loader_get_fullpath(const char *file, const char *dirs, size_t out_s
     (void)snprintf(out_fullpath, out_size, "%s", file);
 }
 
+// Manifest cache
+//
+// Manifest files are read and parsed once and kept for the life of the loader, keyed by filename and checked against the
+// file's size and modification time, so repeated vkCreateInstance and vkEnumerateInstance*Properties calls skip the file I/O
+// and JSON parsing.  If VK_LOADER_MANIFEST_CACHE names a file, the contents of the manifests are also saved there and read
+// back by later processes, which then only need to check the size and modification time of each manifest.
+//
+// The cache is guarded by loader_json_lock.  Its entries outlive the instance that read them, so they use the system
+// allocator rather than the instance's allocation callbacks.
+#define LOADER_MANIFEST_CACHE_HEADER "VkLoaderManifestCache 1\n"
+
+struct loader_manifest_cache_entry {
+    char *filename;
+    uint64_t size;
+    uint64_t mtime;
+    char *text;   // contents of the file
+    cJSON *json;  // parse tree of text, NULL until the manifest is used
+    bool used;    // checked against the file by this process, so worth saving
+};
+
+static struct {
+    struct loader_manifest_cache_entry *entries;
+    uint32_t count;
+    uint32_t capacity;
+    bool initialized;
+    bool dirty;         // entries changed since the persistent cache was read or written
+    char *cache_path;   // the persistent cache file, or NULL
+} loader_manifest_cache;
+
+static char *loader_manifest_cache_strdup(const char *str, size_t len) {
+    char *copy = loader_instance_heap_alloc(NULL, len + 1, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
+    if (NULL != copy) {
+        memcpy(copy, str, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+// Parse trees of the cache are allocated with the system allocator whatever instance is current.
+// The loader only reads Manifest trees, so each is parsed into a single compact block.
+static cJSON *loader_manifest_cache_parse(const char *text) {
+    struct loader_instance *saved_instance = tls_instance;
+    tls_instance = NULL;
+    cJSON *json = cJSON_ParseCompact(text);
+    tls_instance = saved_instance;
+    return json;
+}
+
+static void loader_manifest_cache_clear_entry(struct loader_manifest_cache_entry *entry) {
+    if (NULL != entry->json) {
+        struct loader_instance *saved_instance = tls_instance;
+        tls_instance = NULL;
+        cJSON_Free(entry->json);
+        tls_instance = saved_instance;
+        entry->json = NULL;
+    }
+    loader_instance_heap_free(NULL, entry->text);
+    entry->text = NULL;
+}
+
+static struct loader_manifest_cache_entry *loader_manifest_cache_find(const char *filename) {
+    for (uint32_t i = 0; i < loader_manifest_cache.count; i++) {
+        if (!strcmp(loader_manifest_cache.entries[i].filename, filename)) {
+            return &loader_manifest_cache.entries[i];
+        }
+    }
+    return NULL;
+}
+
+// Add an entry for filename without contents, or return NULL if out of memory.
+static struct loader_manifest_cache_entry *loader_manifest_cache_add(const char *filename) {
+    if (loader_manifest_cache.count == loader_manifest_cache.capacity) {
+        uint32_t new_capacity = loader_manifest_cache.capacity ? 2 * loader_manifest_cache.capacity : 16;
+        struct loader_manifest_cache_entry *new_entries =
+            loader_instance_heap_realloc(NULL, loader_manifest_cache.entries,
+                                         loader_manifest_cache.capacity * sizeof(struct loader_manifest_cache_entry),
+                                         new_capacity * sizeof(struct loader_manifest_cache_entry), VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
+        if (NULL == new_entries) {
+            return NULL;
+        }
+        loader_manifest_cache.entries = new_entries;
+        loader_manifest_cache.capacity = new_capacity;
+    }
+    struct loader_manifest_cache_entry *entry = &loader_manifest_cache.entries[loader_manifest_cache.count];
+    memset(entry, 0, sizeof(*entry));
+    entry->filename = loader_manifest_cache_strdup(filename, strlen(filename));
+    if (NULL == entry->filename) {
+        return NULL;
+    }
+    loader_manifest_cache.count++;
+    return entry;
+}
+
+// Read the persistent cache, if any.  Each entry is a line with the size, modification time, filename length and contents
+// length of a manifest, followed by its filename, its contents and a newline.
+static void loader_manifest_cache_read(const struct loader_instance *inst) {
+    FILE *file = fopen(loader_manifest_cache.cache_path, "rb");
+    if (NULL == file) {
+        return;
+    }
+    char header[sizeof(LOADER_MANIFEST_CACHE_HEADER)];
+    if (NULL == fgets(header, sizeof(header), file) || strcmp(header, LOADER_MANIFEST_CACHE_HEADER)) {
+        loader_log(inst, VK_DEBUG_REPORT_INFORMATION_BIT_EXT, 0, "Ignoring manifest cache %s with an unknown format",
+                   loader_manifest_cache.cache_path);
+        fclose(file);
+        return;
+    }
+
+    unsigned long long size, mtime, filename_len, text_len;
+    while (4 == fscanf(file, "%llu %llu %llu %llu", &size, &mtime, &filename_len, &text_len) && '\n' == fgetc(file)) {
+        char *filename = loader_instance_heap_alloc(NULL, filename_len + 1, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND);
+        char *text = loader_instance_heap_alloc(NULL, text_len + 1, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
+        bool ok = NULL != filename && NULL != text && filename_len == fread(filename, 1, filename_len, file) &&
+                  text_len == fread(text, 1, text_len, file) && '\n' == fgetc(file);
+        struct loader_manifest_cache_entry *entry = NULL;
+        if (ok) {
+            filename[filename_len] = '\0';
+            text[text_len] = '\0';
+            entry = loader_manifest_cache_find(filename);
+            if (NULL == entry) {
+                entry = loader_manifest_cache_add(filename);
+            }
+        }
+        loader_instance_heap_free(NULL, filename);
+        if (NULL == entry) {
+            loader_instance_heap_free(NULL, text);
+            break;
+        }
+        loader_manifest_cache_clear_entry(entry);
+        entry->size = size;
+        entry->mtime = mtime;
+        entry->text = text;
+    }
+    fclose(file);
+}
+
+// Write the entries used by this process to the persistent cache.  The file is written next to the cache and renamed over
+// it, so other processes never read a partial cache.
+static void loader_manifest_cache_write(const struct loader_instance *inst) {
+    if (NULL == loader_manifest_cache.cache_path || !loader_manifest_cache.dirty) {
+        return;
+    }
+    loader_manifest_cache.dirty = false;
+
+    size_t tmp_path_len = strlen(loader_manifest_cache.cache_path) + 5;
+    char *tmp_path = loader_stack_alloc(tmp_path_len);
+    snprintf(tmp_path, tmp_path_len, "%s.tmp", loader_manifest_cache.cache_path);
+    FILE *file = fopen(tmp_path, "wb");
+    if (NULL == file) {
+        loader_log(inst, VK_DEBUG_REPORT_WARNING_BIT_EXT, 0, "Failed to write manifest cache %s", tmp_path);
+        return;
+    }
+    bool ok = EOF != fputs(LOADER_MANIFEST_CACHE_HEADER, file);
+    for (uint32_t i = 0; ok && i < loader_manifest_cache.count; i++) {
+        const struct loader_manifest_cache_entry *entry = &loader_manifest_cache.entries[i];
+        if (!entry->used || NULL == entry->text) {
+            continue;
+        }
+        size_t filename_len = strlen(entry->filename);
+        size_t text_len = strlen(entry->text);
+        ok = 0 < fprintf(file, "%llu %llu %llu %llu\n", (unsigned long long)entry->size, (unsigned long long)entry->mtime,
+                         (unsigned long long)filename_len, (unsigned long long)text_len) &&
+             filename_len == fwrite(entry->filename, 1, filename_len, file) && text_len == fwrite(entry->text, 1, text_len, file) &&
+             EOF != fputc('\n', file);
+    }
+    ok = (0 == fclose(file)) && ok;
+    if (ok) {
+#if defined(_WIN32)
+        remove(loader_manifest_cache.cache_path);
+#endif
+        ok = (0 == rename(tmp_path, loader_manifest_cache.cache_path));
+    }
+    if (!ok) {
+        loader_log(inst, VK_DEBUG_REPORT_WARNING_BIT_EXT, 0, "Failed to write manifest cache %s",
+                   loader_manifest_cache.cache_path);
+        remove(tmp_path);
+    }
+}
+
+static void loader_manifest_cache_init(const struct loader_instance *inst) {
+    if (loader_manifest_cache.initialized) {
+        return;
+    }
+    loader_manifest_cache.initialized = true;
+
+    char *cache_path = loader_secure_getenv("VK_LOADER_MANIFEST_CACHE", inst);
+    if (NULL != cache_path && '\0' != cache_path[0]) {
+        loader_manifest_cache.cache_path = loader_manifest_cache_strdup(cache_path, strlen(cache_path));
+    }
+    loader_free_getenv(cache_path, inst);
+    if (NULL != loader_manifest_cache.cache_path) {
+        loader_manifest_cache_read(inst);
+    }
+}
+
 // Read a JSON file into a buffer.
 //
 // @return -  A pointer to a cJSON object representing the JSON parse tree.
-//            This returned buffer should be freed by caller.
+//            The tree belongs to the manifest cache and must not be freed or modified by the caller,
+//            and is only valid while loader_json_lock is held.
 static VkResult loader_get_json(const struct loader_instance *inst, const char *filename, cJSON **json) {
     FILE *file = NULL;
-    char *json_buf;
+    char *json_buf = NULL;
     size_t len;
+    uint64_t size, mtime;
+    struct loader_manifest_cache_entry *entry;
     VkResult res = VK_SUCCESS;
+    uint64_t trace_start = loader_trace_begin();
 
     if (NULL == json) {
         loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0, "loader_get_json: Received invalid JSON file");
@@ -1994,34 +2378,64 @@ static VkResult loader_get_json(const struct loader_instance *inst, const char *
     }
 
     *json = NULL;
+    loader_manifest_cache_init(inst);
 
-    file = fopen(filename, "rb");
-    if (!file) {
+    if (!loader_platform_file_info(filename, &size, &mtime)) {
         loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0, "loader_get_json: Failed to open JSON file %s", filename);
         res = VK_ERROR_INITIALIZATION_FAILED;
         goto out;
     }
-    fseek(file, 0, SEEK_END);
-    len = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    json_buf = (char *)loader_stack_alloc(len + 1);
-    if (json_buf == NULL) {
-        loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
-                   "loader_get_json: Failed to allocate space for "
-                   "JSON file %s buffer of length %d",
-                   filename, len);
-        res = VK_ERROR_OUT_OF_HOST_MEMORY;
-        goto out;
-    }
-    if (fread(json_buf, sizeof(char), len, file) != len) {
-        loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0, "loader_get_json: Failed to read JSON file %s.", filename);
-        res = VK_ERROR_INITIALIZATION_FAILED;
-        goto out;
+
+    entry = loader_manifest_cache_find(filename);
+    if (NULL != entry && NULL != entry->text && entry->size == size && entry->mtime == mtime) {
+        entry->used = true;
+    } else {
+        file = fopen(filename, "rb");
+        if (!file) {
+            loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0, "loader_get_json: Failed to open JSON file %s", filename);
+            res = VK_ERROR_INITIALIZATION_FAILED;
+            goto out;
+        }
+        fseek(file, 0, SEEK_END);
+        len = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        json_buf = (char *)loader_instance_heap_alloc(NULL, len + 1, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
+        if (json_buf == NULL) {
+            loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
+                       "loader_get_json: Failed to allocate space for "
+                       "JSON file %s buffer of length %d",
+                       filename, len);
+            res = VK_ERROR_OUT_OF_HOST_MEMORY;
+            goto out;
+        }
+        if (fread(json_buf, sizeof(char), len, file) != len) {
+            loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0, "loader_get_json: Failed to read JSON file %s.", filename);
+            res = VK_ERROR_INITIALIZATION_FAILED;
+            goto out;
+        }
+        json_buf[len] = '\0';
+
+        if (NULL == entry) {
+            entry = loader_manifest_cache_add(filename);
+            if (NULL == entry) {
+                res = VK_ERROR_OUT_OF_HOST_MEMORY;
+                goto out;
+            }
+        }
+        loader_manifest_cache_clear_entry(entry);
+        entry->size = size;
+        entry->mtime = mtime;
+        entry->text = json_buf;
+        entry->used = true;
+        json_buf = NULL;
+        loader_manifest_cache.dirty = true;
     }
-    json_buf[len] = '\0';
 
     // Parse text from file
-    *json = cJSON_Parse(json_buf);
+    if (NULL == entry->json) {
+        entry->json = loader_manifest_cache_parse(entry->text);
+    }
+    *json = entry->json;
     if (*json == NULL) {
         loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
                    "loader_get_json: Failed to parse JSON file %s, "
@@ -2036,7 +2450,9 @@ out:
     if (NULL != file) {
         fclose(file);
     }
+    loader_instance_heap_free(NULL, json_buf);
 
+    loader_trace_end(inst, trace_start, "parse", "%s", filename);
     return res;
 }
 
@@ -2865,6 +3281,7 @@ static VkResult loader_get_manifest_files(const struct loader_instance *inst, co
     bool list_is_dirs = false;
     struct dirent *dent;
     VkResult res = VK_SUCCESS;
+    uint64_t trace_start = loader_trace_begin();
 
     out_files->count = 0;
     out_files->filename_list = NULL;
@@ -3266,6 +3683,7 @@ out:
     if (NULL != reg && reg != orig_loc) {
         loader_instance_heap_free(inst, reg);
     }
+    loader_trace_end(inst, trace_start, "scan", "%s manifest files (%u found)", is_layer ? "Layer" : "ICD", out_files->count);
     return res;
 }
 
@@ -3319,10 +3737,7 @@ VkResult loader_icd_scan(const struct loader_instance *inst, struct loader_icd_t
 
         VkResult temp_res = loader_get_json(inst, file_str, &json);
         if (NULL == json || temp_res != VK_SUCCESS) {
-            if (NULL != json) {
-                cJSON_Delete(json);
-                json = NULL;
-            }
+            json = NULL;
             // If we haven't already found an ICD, copy this result to
             // the returned result.
             if (num_good_icds == 0) {
@@ -3346,7 +3761,6 @@ VkResult loader_icd_scan(const struct loader_instance *inst, struct loader_icd_t
                        "loader_icd_scan: ICD JSON %s does not have a"
                        " \'file_format_version\' field. Skipping ICD JSON.",
                        file_str);
-            cJSON_Delete(json);
             json = NULL;
             continue;
         }
@@ -3361,7 +3775,6 @@ VkResult loader_icd_scan(const struct loader_instance *inst, struct loader_icd_t
                        "loader_icd_scan: Failed retrieving ICD JSON %s"
                        " \'file_format_version\' field.  Skipping ICD JSON",
                        file_str);
-            cJSON_Delete(json);
             json = NULL;
             continue;
         }
@@ -3402,7 +3815,6 @@ VkResult loader_icd_scan(const struct loader_instance *inst, struct loader_icd_t
                                " \'library_path\' field.  Skipping ICD JSON.",
                                file_str);
                     cJSON_Free(temp);
-                    cJSON_Delete(json);
                     json = NULL;
                     continue;
                 }
@@ -3417,7 +3829,6 @@ VkResult loader_icd_scan(const struct loader_instance *inst, struct loader_icd_t
                                file_str);
                     res = VK_ERROR_OUT_OF_HOST_MEMORY;
                     cJSON_Free(temp);
-                    cJSON_Delete(json);
                     json = NULL;
                     goto out;
                 }
@@ -3428,7 +3839,6 @@ VkResult loader_icd_scan(const struct loader_instance *inst, struct loader_icd_t
                                "loader_icd_scan: ICD JSON %s \'library_path\'"
                                " field is empty.  Skipping ICD JSON.",
                                file_str);
-                    cJSON_Delete(json);
                     json = NULL;
                     continue;
                 }
@@ -3465,7 +3875,6 @@ VkResult loader_icd_scan(const struct loader_instance *inst, struct loader_icd_t
                         }
 
                         cJSON_Free(temp);
-                        cJSON_Delete(json);
                         json = NULL;
                         continue;
                     }
@@ -3484,7 +3893,6 @@ VkResult loader_icd_scan(const struct loader_instance *inst, struct loader_icd_t
                                "loader_icd_scan: Failed to add ICD JSON %s. "
                                " Skipping ICD JSON.",
                                fullpath);
-                    cJSON_Delete(json);
                     json = NULL;
                     continue;
                 }
@@ -3502,16 +3910,11 @@ VkResult loader_icd_scan(const struct loader_instance *inst, struct loader_icd_t
                        file_str);
         }
 
-        cJSON_Delete(json);
         json = NULL;
     }
 
 out:
 
-    if (NULL != json) {
-        cJSON_Delete(json);
-    }
-
     if (NULL != manifest_files.filename_list) {
         for (uint32_t i = 0; i < manifest_files.count; i++) {
             if (NULL != manifest_files.filename_list[i]) {
@@ -3521,6 +3924,7 @@ out:
         loader_instance_heap_free(inst, manifest_files.filename_list);
     }
     if (lockedMutex) {
+        loader_manifest_cache_write(inst);
         loader_platform_thread_unlock_mutex(&loader_json_lock);
     }
 
@@ -3574,7 +3978,6 @@ void loader_layer_scan(const struct loader_instance *inst, struct loader_layer_l
             }
 
             VkResult local_res = loader_add_layer_properties(inst, instance_layers, json, (implicit == 1), file_str);
-            cJSON_Delete(json);
 
             if (VK_SUCCESS != local_res) {
                 goto out;
@@ -3616,6 +4019,7 @@ out:
         }
     }
     if (lockedMutex) {
+        loader_manifest_cache_write(inst);
         loader_platform_thread_unlock_mutex(&loader_json_lock);
     }
 }
@@ -3656,13 +4060,13 @@ void loader_implicit_layer_scan(const struct loader_instance *inst, struct loade
         res = loader_add_layer_properties(inst, instance_layers, json, true, file_str);
 
         loader_instance_heap_free(inst, file_str);
-        cJSON_Delete(json);
 
         if (VK_ERROR_OUT_OF_HOST_MEMORY == res) {
             break;
         }
     }
     loader_instance_heap_free(inst, manifest_files.filename_list);
+    loader_manifest_cache_write(inst);
     loader_platform_thread_unlock_mutex(&loader_json_lock);
 }
 
@@ -3831,14 +4235,19 @@ static void loader_init_dispatch_dev_ext_entry(struct loader_instance *inst, str
 // Find all dev extension in the hash table  and initialize the dispatch table
 // for dev  for each of those extension entrypoints found in hash table.
 void loader_init_dispatch_dev_ext(struct loader_instance *inst, struct loader_device *dev) {
+    // Serialized with loader_dev_ext_gpa, so an entry point added while the
+    // device is created is either seen here or sets up the device itself.
+    loader_platform_thread_lock_mutex(&loader_ext_table_lock);
     for (uint32_t i = 0; i < MAX_NUM_UNKNOWN_EXTS; i++) {
         if (inst->dev_ext_disp_hash[i].func_name != NULL)
             loader_init_dispatch_dev_ext_entry(inst, dev, i, inst->dev_ext_disp_hash[i].func_name);
     }
+    loader_platform_thread_unlock_mutex(&loader_ext_table_lock);
 }
 
 static bool loader_check_icds_for_dev_ext_address(struct loader_instance *inst, const char *funcName) {
     struct loader_icd_term *icd_term;
+    loader_create_pending_icd_instances(inst);
     icd_term = inst->icd_terms;
     while (NULL != icd_term) {
         if (icd_term->scanned_icd->GetInstanceProcAddr(icd_term->instance, funcName))
@@ -3869,103 +4278,58 @@ static bool loader_check_layer_list_for_dev_ext_address(const struct loader_laye
     return false;
 }
 
-static void loader_free_dev_ext_table(struct loader_instance *inst) {
+// Free the names of an unknown entry point hash table.
+static void loader_free_ext_table(struct loader_instance *inst, struct loader_dispatch_hash_entry *table) {
     for (uint32_t i = 0; i < MAX_NUM_UNKNOWN_EXTS; i++) {
-        loader_instance_heap_free(inst, inst->dev_ext_disp_hash[i].func_name);
-        loader_instance_heap_free(inst, inst->dev_ext_disp_hash[i].list.index);
-    }
-    memset(inst->dev_ext_disp_hash, 0, sizeof(inst->dev_ext_disp_hash));
-}
-
-static bool loader_add_dev_ext_table(struct loader_instance *inst, uint32_t *ptr_idx, const char *funcName) {
-    uint32_t i;
-    uint32_t idx = *ptr_idx;
-    struct loader_dispatch_hash_list *list = &inst->dev_ext_disp_hash[idx].list;
-
-    if (!inst->dev_ext_disp_hash[idx].func_name) {
-        // no entry here at this idx, so use it
-        assert(list->capacity == 0);
-        inst->dev_ext_disp_hash[idx].func_name =
-            (char *)loader_instance_heap_alloc(inst, strlen(funcName) + 1, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
-        if (inst->dev_ext_disp_hash[idx].func_name == NULL) {
-            loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
-                       "loader_add_dev_ext_table: Failed to allocate memory "
-                       "for func_name %s",
-                       funcName);
+        loader_instance_heap_free(inst, table[i].func_name);
+    }
+    memset(table, 0, MAX_NUM_UNKNOWN_EXTS * sizeof(struct loader_dispatch_hash_entry));
+}
+
+// Look up funcName in an unknown entry point hash table.  This doesn't need
+// loader_ext_table_lock.
+//     @return  true with *idx set to the entry of funcName if it is in the table,
+//              otherwise false with *idx set to the free entry it would be added
+//              at, or MAX_NUM_UNKNOWN_EXTS if the table is full.
+static bool loader_lookup_ext_table(struct loader_dispatch_hash_entry *table, const char *funcName, uint32_t hash, uint32_t *idx) {
+    uint32_t i = hash % MAX_NUM_UNKNOWN_EXTS;
+    for (uint32_t probe = 0; probe < MAX_NUM_UNKNOWN_EXTS; probe++) {
+        const char *name = loader_platform_atomic_load_ptr((void *const *)&table[i].func_name);
+        if (NULL == name) {
+            *idx = i;
             return false;
         }
-        strncpy(inst->dev_ext_disp_hash[idx].func_name, funcName, strlen(funcName) + 1);
-        return true;
-    }
-
-    // check for enough capacity
-    if (list->capacity == 0) {
-        list->index = loader_instance_heap_alloc(inst, 8 * sizeof(*(list->index)), VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
-        if (list->index == NULL) {
-            loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0, "loader_add_dev_ext_table: Failed to allocate memory for list index",
-                       funcName);
-            return false;
-        }
-        list->capacity = 8 * sizeof(*(list->index));
-    } else if (list->capacity < (list->count + 1) * sizeof(*(list->index))) {
-        void *new_ptr = loader_instance_heap_realloc(inst, list->index, list->capacity, list->capacity * 2,
-                                                     VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
-        if (NULL == new_ptr) {
-            loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
-                       "loader_add_dev_ext_table: Failed to reallocate memory for list index", funcName);
-            return false;
-        }
-        list->index = new_ptr;
-        list->capacity *= 2;
-    }
-
-    // find an unused index in the hash table and use it
-    i = (idx + 1) % MAX_NUM_UNKNOWN_EXTS;
-    do {
-        if (!inst->dev_ext_disp_hash[i].func_name) {
-            assert(inst->dev_ext_disp_hash[i].list.capacity == 0);
-            inst->dev_ext_disp_hash[i].func_name =
-                (char *)loader_instance_heap_alloc(inst, strlen(funcName) + 1, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
-            if (inst->dev_ext_disp_hash[i].func_name == NULL) {
-                loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
-                           "loader_add_dev_ext_table: Failed to allocate memory "
-                           "for func_name %s",
-                           funcName);
-                return false;
-            }
-            strncpy(inst->dev_ext_disp_hash[i].func_name, funcName, strlen(funcName) + 1);
-            list->index[list->count] = i;
-            list->count++;
-            *ptr_idx = i;
+        if (table[i].hash == hash && !strcmp(name, funcName)) {
+            *idx = i;
             return true;
         }
         i = (i + 1) % MAX_NUM_UNKNOWN_EXTS;
-    } while (i != idx);
-
-    loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
-               "loader_add_dev_ext_table:  Could not insert into hash table; is "
-               "it full?");
-
+    }
+    *idx = MAX_NUM_UNKNOWN_EXTS;
     return false;
 }
 
-static bool loader_name_in_dev_ext_table(struct loader_instance *inst, uint32_t *idx, const char *funcName) {
-    uint32_t alt_idx;
-    if (inst->dev_ext_disp_hash[*idx].func_name && !strcmp(inst->dev_ext_disp_hash[*idx].func_name, funcName)) return true;
-
-    // funcName wasn't at the primary spot in the hash table
-    // search the list of secondary locations (shallow search, not deep search)
-    for (uint32_t i = 0; i < inst->dev_ext_disp_hash[*idx].list.count; i++) {
-        alt_idx = inst->dev_ext_disp_hash[*idx].list.index[i];
-        if (!strcmp(inst->dev_ext_disp_hash[*idx].func_name, funcName)) {
-            *idx = alt_idx;
-            return true;
-        }
+// Make a copy of funcName for a new hash table entry, which the caller
+// publishes with loader_publish_ext_table_entry once the dispatch entries for
+// it are set up.  The caller must hold loader_ext_table_lock.
+static char *loader_copy_ext_table_name(const struct loader_instance *inst, const char *funcName) {
+    char *name = (char *)loader_instance_heap_alloc(inst, strlen(funcName) + 1, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
+    if (name == NULL) {
+        loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0, "loader_copy_ext_table_name: Failed to allocate memory for func_name %s",
+                   funcName);
+        return NULL;
     }
+    strcpy(name, funcName);
+    return name;
+}
 
-    return false;
+static void loader_publish_ext_table_entry(struct loader_dispatch_hash_entry *table, uint32_t idx, char *name, uint32_t hash) {
+    table[idx].hash = hash;
+    loader_platform_atomic_store_ptr((void **)&table[idx].func_name, name);
 }
 
+static void loader_free_dev_ext_table(struct loader_instance *inst) { loader_free_ext_table(inst, inst->dev_ext_disp_hash); }
+
 // This function returns generic trampoline code address for unknown entry
 // points.
 // Presumably, these unknown entry points (as given by funcName) are device
@@ -3974,21 +4338,19 @@ static bool loader_name_in_dev_ext_table(struct loader_instance *inst, uint32_t
 // (struct loader_dev_ext_dispatch_table).
 // \returns
 // For a given entry point string (funcName), if an existing mapping is found
-// the
-// trampoline address for that mapping is returned. Otherwise, this unknown
-// entry point
-// has not been seen yet. Next check if a layer or ICD supports it.  If so then
-// a
-// new entry in the hash table is initialized and that trampoline address for
-// the new entry is returned. Null is returned if the hash table is full or
-// if no discovered layer or ICD returns a non-NULL GetProcAddr for it.
+// the trampoline address for that mapping is returned, without taking any
+// lock. Otherwise, this unknown entry point has not been seen yet. Next check
+// if a layer or ICD supports it.  If so then a new entry in the hash table is
+// initialized and that trampoline address for the new entry is returned. Null
+// is returned if the hash table is full or if no discovered layer or ICD
+// returns a non-NULL GetProcAddr for it.
 void *loader_dev_ext_gpa(struct loader_instance *inst, const char *funcName) {
     uint32_t idx;
     uint32_t seed = 0;
+    uint32_t hash = murmurhash(funcName, strlen(funcName), seed);
+    void *addr = NULL;
 
-    idx = murmurhash(funcName, strlen(funcName), seed) % MAX_NUM_UNKNOWN_EXTS;
-
-    if (loader_name_in_dev_ext_table(inst, &idx, funcName))
+    if (loader_lookup_ext_table(inst->dev_ext_disp_hash, funcName, hash, &idx))
         // found funcName already in hash
         return loader_get_dev_ext_trampoline(idx);
 
@@ -3999,18 +4361,31 @@ void *loader_dev_ext_gpa(struct loader_instance *inst, const char *funcName) {
         return NULL;
     }
 
-    if (loader_add_dev_ext_table(inst, &idx, funcName)) {
-        // successfully added new table entry
-        // init any dev dispatch table entries as needed
-        loader_init_dispatch_dev_ext_entry(inst, NULL, idx, funcName);
-        return loader_get_dev_ext_trampoline(idx);
+    loader_platform_thread_lock_mutex(&loader_ext_table_lock);
+    if (loader_lookup_ext_table(inst->dev_ext_disp_hash, funcName, hash, &idx)) {
+        // another thread added it meanwhile
+        addr = loader_get_dev_ext_trampoline(idx);
+    } else if (MAX_NUM_UNKNOWN_EXTS == idx) {
+        loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0, "loader_dev_ext_gpa: Could not insert %s into hash table; is it full?",
+                   funcName);
+    } else {
+        char *name = loader_copy_ext_table_name(inst, funcName);
+        if (NULL != name) {
+            // init any dev dispatch table entries as needed, before any other
+            // thread can find the entry
+            loader_init_dispatch_dev_ext_entry(inst, NULL, idx, funcName);
+            loader_publish_ext_table_entry(inst->dev_ext_disp_hash, idx, name, hash);
+            addr = loader_get_dev_ext_trampoline(idx);
+        }
     }
+    loader_platform_thread_unlock_mutex(&loader_ext_table_lock);
 
-    return NULL;
+    return addr;
 }
 
 static bool loader_check_icds_for_phys_dev_ext_address(struct loader_instance *inst, const char *funcName) {
     struct loader_icd_term *icd_term;
+    loader_create_pending_icd_instances(inst);
     icd_term = inst->icd_terms;
     while (NULL != icd_term) {
         if (icd_term->scanned_icd->interface_version >= MIN_PHYS_DEV_EXTENSION_ICD_INTERFACE_VERSION &&
@@ -4040,109 +4415,18 @@ static bool loader_check_layer_list_for_phys_dev_ext_address(struct loader_insta
     return false;
 }
 
-static void loader_free_phys_dev_ext_table(struct loader_instance *inst) {
-    for (uint32_t i = 0; i < MAX_NUM_UNKNOWN_EXTS; i++) {
-        loader_instance_heap_free(inst, inst->phys_dev_ext_disp_hash[i].func_name);
-        loader_instance_heap_free(inst, inst->phys_dev_ext_disp_hash[i].list.index);
-    }
-    memset(inst->phys_dev_ext_disp_hash, 0, sizeof(inst->phys_dev_ext_disp_hash));
-}
-
-static bool loader_add_phys_dev_ext_table(struct loader_instance *inst, uint32_t *ptr_idx, const char *funcName) {
-    uint32_t i;
-    uint32_t idx = *ptr_idx;
-    struct loader_dispatch_hash_list *list = &inst->phys_dev_ext_disp_hash[idx].list;
-
-    if (!inst->phys_dev_ext_disp_hash[idx].func_name) {
-        // no entry here at this idx, so use it
-        assert(list->capacity == 0);
-        inst->phys_dev_ext_disp_hash[idx].func_name =
-            (char *)loader_instance_heap_alloc(inst, strlen(funcName) + 1, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
-        if (inst->phys_dev_ext_disp_hash[idx].func_name == NULL) {
-            loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
-                       "loader_add_phys_dev_ext_table() can't allocate memory for "
-                       "func_name");
-            return false;
-        }
-        strncpy(inst->phys_dev_ext_disp_hash[idx].func_name, funcName, strlen(funcName) + 1);
-        return true;
-    }
-
-    // check for enough capacity
-    if (list->capacity == 0) {
-        list->index = loader_instance_heap_alloc(inst, 8 * sizeof(*(list->index)), VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
-        if (list->index == NULL) {
-            loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0, "loader_add_phys_dev_ext_table() can't allocate list memory");
-            return false;
-        }
-        list->capacity = 8 * sizeof(*(list->index));
-    } else if (list->capacity < (list->count + 1) * sizeof(*(list->index))) {
-        void *new_ptr = loader_instance_heap_realloc(inst, list->index, list->capacity, list->capacity * 2,
-                                                     VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
-        if (NULL == new_ptr) {
-            loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0, "loader_add_phys_dev_ext_table() can't reallocate list memory");
-            return false;
-        }
-        list->index = new_ptr;
-        list->capacity *= 2;
-    }
-
-    // find an unused index in the hash table and use it
-    i = (idx + 1) % MAX_NUM_UNKNOWN_EXTS;
-    do {
-        if (!inst->phys_dev_ext_disp_hash[i].func_name) {
-            assert(inst->phys_dev_ext_disp_hash[i].list.capacity == 0);
-            inst->phys_dev_ext_disp_hash[i].func_name =
-                (char *)loader_instance_heap_alloc(inst, strlen(funcName) + 1, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
-            if (inst->phys_dev_ext_disp_hash[i].func_name == NULL) {
-                loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
-                           "loader_add_dev_ext_table() can't reallocate "
-                           "func_name memory");
-                return false;
-            }
-            strncpy(inst->phys_dev_ext_disp_hash[i].func_name, funcName, strlen(funcName) + 1);
-            list->index[list->count] = i;
-            list->count++;
-            *ptr_idx = i;
-            return true;
-        }
-        i = (i + 1) % MAX_NUM_UNKNOWN_EXTS;
-    } while (i != idx);
-
-    loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
-               "loader_add_phys_dev_ext_table() couldn't insert into hash table; is "
-               "it full?");
-    return false;
-}
-
-static bool loader_name_in_phys_dev_ext_table(struct loader_instance *inst, uint32_t *idx, const char *funcName) {
-    uint32_t alt_idx;
-    if (inst->phys_dev_ext_disp_hash[*idx].func_name && !strcmp(inst->phys_dev_ext_disp_hash[*idx].func_name, funcName))
-        return true;
-
-    // funcName wasn't at the primary spot in the hash table
-    // search the list of secondary locations (shallow search, not deep search)
-    for (uint32_t i = 0; i < inst->phys_dev_ext_disp_hash[*idx].list.count; i++) {
-        alt_idx = inst->phys_dev_ext_disp_hash[*idx].list.index[i];
-        if (!strcmp(inst->phys_dev_ext_disp_hash[*idx].func_name, funcName)) {
-            *idx = alt_idx;
-            return true;
-        }
-    }
-
-    return false;
-}
+static void loader_free_phys_dev_ext_table(struct loader_instance *inst) { loader_free_ext_table(inst, inst->phys_dev_ext_disp_hash); }
 
 // This function returns a generic trampoline and/or terminator function
 // address for any unknown physical device extension commands.  A hash
 // table is used to keep a list of unknown entry points and their
-// mapping to the physical device extension dispatch table (struct
-// loader_phys_dev_ext_dispatch_table).
+// mapping to the physical device extension dispatch table
+// (struct loader_phys_dev_ext_dispatch_table).
 // For a given entry point string (funcName), if an existing mapping is
 // found, then the trampoline address for that mapping is returned in
 // tramp_addr (if it is not NULL) and the terminator address for that
-// mapping is returned in term_addr (if it is not NULL). Otherwise,
-// this unknown entry point has not been seen yet.
+// mapping is returned in term_addr (if it is not NULL), without taking
+// any lock. Otherwise, this unknown entry point has not been seen yet.
 // If it has not been seen before, and perform_checking is 'true',
 // check if a layer or and ICD supports it.  If so then a new entry in
 // the hash table is initialized and the trampoline and/or terminator
@@ -4153,6 +4437,7 @@ bool loader_phys_dev_ext_gpa(struct loader_instance *inst, const char *funcName,
                              void **term_addr) {
     uint32_t idx;
     uint32_t seed = 0;
+    uint32_t hash;
     bool success = false;
 
     if (inst == NULL) {
@@ -4166,57 +4451,68 @@ bool loader_phys_dev_ext_gpa(struct loader_instance *inst, const char *funcName,
         *term_addr = NULL;
     }
 
-    // We should always check to see if any ICD supports it.
-    if (!loader_check_icds_for_phys_dev_ext_address(inst, funcName)) {
-        // If we're not checking layers, or we are and it's not in a layer, just
-        // return
-        if (!perform_checking || !loader_check_layer_list_for_phys_dev_ext_address(inst, funcName)) {
+    hash = murmurhash(funcName, strlen(funcName), seed);
+    if (!loader_lookup_ext_table(inst->phys_dev_ext_disp_hash, funcName, hash, &idx)) {
+        if (!perform_checking) {
             goto out;
         }
-    }
 
-    idx = murmurhash(funcName, strlen(funcName), seed) % MAX_NUM_UNKNOWN_EXTS;
-    if (perform_checking && !loader_name_in_phys_dev_ext_table(inst, &idx, funcName)) {
-        uint32_t i;
-        bool added = false;
-
-        // Only need to add first one to get index in Instance.  Others will use
-        // the same index.
-        if (!added && loader_add_phys_dev_ext_table(inst, &idx, funcName)) {
-            added = true;
+        // Check if any ICD supports it, or else an enabled layer
+        if (!loader_check_icds_for_phys_dev_ext_address(inst, funcName) &&
+            !loader_check_layer_list_for_phys_dev_ext_address(inst, funcName)) {
+            goto out;
         }
 
-        // Setup the ICD function pointers
-        struct loader_icd_term *icd_term = inst->icd_terms;
-        while (NULL != icd_term) {
-            if (MIN_PHYS_DEV_EXTENSION_ICD_INTERFACE_VERSION <= icd_term->scanned_icd->interface_version &&
-                NULL != icd_term->scanned_icd->GetPhysicalDeviceProcAddr) {
-                icd_term->phys_dev_ext[idx] =
-                    (PFN_PhysDevExt)icd_term->scanned_icd->GetPhysicalDeviceProcAddr(icd_term->instance, funcName);
-
-                // Make sure we set the instance dispatch to point to the
-                // loader's terminator now since we can at least handle it
-                // in one ICD.
-                inst->disp->phys_dev_ext[idx] = loader_get_phys_dev_ext_termin(idx);
+        loader_platform_thread_lock_mutex(&loader_ext_table_lock);
+        if (!loader_lookup_ext_table(inst->phys_dev_ext_disp_hash, funcName, hash, &idx)) {
+            char *name = NULL;
+            if (MAX_NUM_UNKNOWN_EXTS == idx) {
+                loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
+                           "loader_phys_dev_ext_gpa: Could not insert %s into hash table; is it full?", funcName);
             } else {
-                icd_term->phys_dev_ext[idx] = NULL;
+                name = loader_copy_ext_table_name(inst, funcName);
+            }
+            if (NULL == name) {
+                loader_platform_thread_unlock_mutex(&loader_ext_table_lock);
+                goto out;
             }
 
-            icd_term = icd_term->next;
-        }
+            // Setup the ICD function pointers
+            struct loader_icd_term *icd_term = inst->icd_terms;
+            while (NULL != icd_term) {
+                if (MIN_PHYS_DEV_EXTENSION_ICD_INTERFACE_VERSION <= icd_term->scanned_icd->interface_version &&
+                    NULL != icd_term->scanned_icd->GetPhysicalDeviceProcAddr) {
+                    icd_term->phys_dev_ext[idx] =
+                        (PFN_PhysDevExt)icd_term->scanned_icd->GetPhysicalDeviceProcAddr(icd_term->instance, funcName);
+
+                    // Make sure we set the instance dispatch to point to the
+                    // loader's terminator now since we can at least handle it
+                    // in one ICD.
+                    inst->disp->phys_dev_ext[idx] = loader_get_phys_dev_ext_termin(idx);
+                } else {
+                    icd_term->phys_dev_ext[idx] = NULL;
+                }
 
-        // Now, search for the first layer attached and query using it to get
-        // the first entry point.
-        for (i = 0; i < inst->expanded_activated_layer_list.count; i++) {
-            struct loader_layer_properties *layer_prop = &inst->expanded_activated_layer_list.list[i];
-            if (layer_prop->interface_version > 1 && NULL != layer_prop->functions.get_physical_device_proc_addr) {
-                inst->disp->phys_dev_ext[idx] =
-                    (PFN_PhysDevExt)layer_prop->functions.get_physical_device_proc_addr((VkInstance)inst->instance, funcName);
-                if (NULL != inst->disp->phys_dev_ext[idx]) {
-                    break;
+                icd_term = icd_term->next;
+            }
+
+            // Now, search for the first layer attached and query using it to get
+            // the first entry point.
+            for (uint32_t i = 0; i < inst->expanded_activated_layer_list.count; i++) {
+                struct loader_layer_properties *layer_prop = &inst->expanded_activated_layer_list.list[i];
+                if (layer_prop->interface_version > 1 && NULL != layer_prop->functions.get_physical_device_proc_addr) {
+                    inst->disp->phys_dev_ext[idx] =
+                        (PFN_PhysDevExt)layer_prop->functions.get_physical_device_proc_addr((VkInstance)inst->instance, funcName);
+                    if (NULL != inst->disp->phys_dev_ext[idx]) {
+                        break;
+                    }
                 }
             }
+
+            // The dispatch entries are complete, so other threads may use it now
+            loader_publish_ext_table_entry(inst->phys_dev_ext_disp_hash, idx, name, hash);
         }
+        loader_platform_thread_unlock_mutex(&loader_ext_table_lock);
     }
 
     if (NULL != tramp_addr) {
@@ -4249,23 +4545,11 @@ struct loader_instance *loader_get_instance(const VkInstance instance) {
     return ptr_instance;
 }
 
-static loader_platform_dl_handle loader_open_layer_lib(const struct loader_instance *inst, const char *chain_type,
-                                                       struct loader_layer_properties *prop) {
-    if ((prop->lib_handle = loader_platform_open_library(prop->lib_name)) == NULL) {
-        loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0, loader_platform_open_library_error(prop->lib_name));
-    } else {
-        loader_log(inst, VK_DEBUG_REPORT_DEBUG_BIT_EXT, 0, "Loading layer library %s", prop->lib_name);
-    }
-
-    return prop->lib_handle;
-}
-
+// The library itself stays loaded in the layer library cache for reuse by
+// later instance and device chains.
 static void loader_close_layer_lib(const struct loader_instance *inst, struct loader_layer_properties *prop) {
-    if (prop->lib_handle) {
-        loader_platform_close_library(prop->lib_handle);
-        loader_log(inst, VK_DEBUG_REPORT_DEBUG_BIT_EXT, 0, "Unloading layer library %s", prop->lib_name);
-        prop->lib_handle = NULL;
-    }
+    (void)inst;
+    prop->lib_handle = NULL;
 }
 
 void loader_deactivate_layers(const struct loader_instance *instance, struct loader_device *device,
@@ -4386,6 +4670,145 @@ bool loader_get_layer_interface_version(PFN_vkNegotiateLoaderLayerInterfaceVersi
     return true;
 }
 
+// Layer libraries resolved for an instance or device chain, cached for the life
+// of the loader.  Applications that create and destroy instances and devices
+// repeatedly reuse the library handle, the negotiated interface version and the
+// entry points instead of opening, negotiating with and querying each layer
+// again.  Entries are keyed by the library and the entry point names given in
+// the manifest, are only touched while loader_lock is held and use the system
+// allocator.  Libraries that fail to load are not cached.
+struct loader_layer_lib_cache_entry {
+    char *lib_name;
+    char str_negotiate_interface[MAX_STRING_SIZE];
+    char str_gipa[MAX_STRING_SIZE];
+    char str_gdpa[MAX_STRING_SIZE];
+    loader_platform_dl_handle handle;
+    bool negotiated;
+    uint32_t interface_version;
+    PFN_vkNegotiateLoaderLayerInterfaceVersion negotiate_layer_interface;
+    PFN_vkGetInstanceProcAddr get_instance_proc_addr;
+    PFN_vkGetDeviceProcAddr get_device_proc_addr;
+    PFN_GetPhysicalDeviceProcAddr get_physical_device_proc_addr;
+};
+
+static struct {
+    struct loader_layer_lib_cache_entry *entries;
+    uint32_t count;
+    uint32_t capacity;
+} loader_layer_lib_cache;
+
+static struct loader_layer_lib_cache_entry *loader_layer_lib_cache_find(const struct loader_layer_properties *prop) {
+    for (uint32_t i = 0; i < loader_layer_lib_cache.count; i++) {
+        struct loader_layer_lib_cache_entry *entry = &loader_layer_lib_cache.entries[i];
+        if (!strcmp(entry->lib_name, prop->lib_name) &&
+            !strcmp(entry->str_negotiate_interface, prop->functions.str_negotiate_interface) &&
+            !strcmp(entry->str_gipa, prop->functions.str_gipa) && !strcmp(entry->str_gdpa, prop->functions.str_gdpa)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Open a layer library and look up its entry points.
+static bool loader_layer_lib_resolve(const struct loader_instance *inst, const struct loader_layer_properties *prop,
+                                     struct loader_layer_lib_cache_entry *entry) {
+    uint64_t trace_start = loader_trace_begin();
+    entry->handle = loader_platform_open_library(prop->lib_name);
+    loader_trace_end(inst, trace_start, "open", "Layer library %s", prop->lib_name);
+    if (NULL == entry->handle) {
+        loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0, loader_platform_open_library_error(prop->lib_name));
+        return false;
+    }
+    loader_log(inst, VK_DEBUG_REPORT_DEBUG_BIT_EXT, 0, "Loading layer library %s", prop->lib_name);
+
+    trace_start = loader_trace_begin();
+    const char *negotiate_name = strlen(prop->functions.str_negotiate_interface) == 0 ? "vkNegotiateLoaderLayerInterfaceVersion"
+                                                                                        : prop->functions.str_negotiate_interface;
+    entry->negotiate_layer_interface =
+        (PFN_vkNegotiateLoaderLayerInterfaceVersion)loader_platform_get_proc_address(entry->handle, negotiate_name);
+
+    // If we can negotiate an interface version, then we can also get everything
+    // we need from the one function call.
+    if (NULL != entry->negotiate_layer_interface) {
+        VkNegotiateLayerInterface interface_struct;
+
+        if (loader_get_layer_interface_version(entry->negotiate_layer_interface, &interface_struct)) {
+            entry->negotiated = true;
+            entry->interface_version = interface_struct.loaderLayerInterfaceVersion;
+            if (interface_struct.loaderLayerInterfaceVersion > 1) {
+                entry->get_instance_proc_addr = interface_struct.pfnGetInstanceProcAddr;
+                entry->get_device_proc_addr = interface_struct.pfnGetDeviceProcAddr;
+                entry->get_physical_device_proc_addr = interface_struct.pfnGetPhysicalDeviceProcAddr;
+            }
+        }
+    }
+
+    if (NULL == entry->get_instance_proc_addr) {
+        const char *gipa_name = strlen(prop->functions.str_gipa) == 0 ? "vkGetInstanceProcAddr" : prop->functions.str_gipa;
+        entry->get_instance_proc_addr = (PFN_vkGetInstanceProcAddr)loader_platform_get_proc_address(entry->handle, gipa_name);
+    }
+    if (NULL == entry->get_device_proc_addr) {
+        const char *gdpa_name = strlen(prop->functions.str_gdpa) == 0 ? "vkGetDeviceProcAddr" : prop->functions.str_gdpa;
+        entry->get_device_proc_addr = (PFN_vkGetDeviceProcAddr)loader_platform_get_proc_address(entry->handle, gdpa_name);
+    }
+    loader_trace_end(inst, trace_start, "negotiate", "Layer library %s", prop->lib_name);
+    return true;
+}
+
+// Return the cached library and entry points of a layer, opening and resolving
+// the library the first time it is used.  The layer properties are updated
+// with the handle, the negotiated interface version and the entry points.
+static const struct loader_layer_lib_cache_entry *loader_open_layer_lib(const struct loader_instance *inst, const char *chain_type,
+                                                                        struct loader_layer_properties *prop) {
+    struct loader_layer_lib_cache_entry *entry = loader_layer_lib_cache_find(prop);
+    if (NULL == entry) {
+        struct loader_layer_lib_cache_entry new_entry;
+        memset(&new_entry, 0, sizeof(new_entry));
+        if (!loader_layer_lib_resolve(inst, prop, &new_entry)) {
+            return NULL;
+        }
+
+        if (loader_layer_lib_cache.count == loader_layer_lib_cache.capacity) {
+            uint32_t new_capacity = loader_layer_lib_cache.capacity ? 2 * loader_layer_lib_cache.capacity : 8;
+            struct loader_layer_lib_cache_entry *new_entries = loader_instance_heap_realloc(
+                NULL, loader_layer_lib_cache.entries, loader_layer_lib_cache.capacity * sizeof(struct loader_layer_lib_cache_entry),
+                new_capacity * sizeof(struct loader_layer_lib_cache_entry), VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
+            if (NULL == new_entries) {
+                loader_platform_close_library(new_entry.handle);
+                return NULL;
+            }
+            loader_layer_lib_cache.entries = new_entries;
+            loader_layer_lib_cache.capacity = new_capacity;
+        }
+        new_entry.lib_name = loader_instance_heap_alloc(NULL, strlen(prop->lib_name) + 1, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
+        if (NULL == new_entry.lib_name) {
+            loader_platform_close_library(new_entry.handle);
+            return NULL;
+        }
+        strcpy(new_entry.lib_name, prop->lib_name);
+        strncpy(new_entry.str_negotiate_interface, prop->functions.str_negotiate_interface, MAX_STRING_SIZE);
+        strncpy(new_entry.str_gipa, prop->functions.str_gipa, MAX_STRING_SIZE);
+        strncpy(new_entry.str_gdpa, prop->functions.str_gdpa, MAX_STRING_SIZE);
+
+        entry = &loader_layer_lib_cache.entries[loader_layer_lib_cache.count++];
+        *entry = new_entry;
+    } else {
+        loader_log(inst, VK_DEBUG_REPORT_DEBUG_BIT_EXT, 0, "Reusing %s layer library %s", chain_type, prop->lib_name);
+    }
+
+    prop->lib_handle = entry->handle;
+    if (entry->negotiated) {
+        prop->interface_version = entry->interface_version;
+        prop->functions.negotiate_layer_interface = entry->negotiate_layer_interface;
+    }
+    prop->functions.get_instance_proc_addr = entry->get_instance_proc_addr;
+    prop->functions.get_device_proc_addr = entry->get_device_proc_addr;
+    if (prop->interface_version > 1) {
+        prop->functions.get_physical_device_proc_addr = entry->get_physical_device_proc_addr;
+    }
+    return entry;
+}
+
 // Given the list of layers to activate in the loader_instance
 // structure. This function will add a VkLayerInstanceCreateInfo
 // structure to the VkInstanceCreateInfo.pNext pointer.
@@ -4435,75 +4858,20 @@ VkResult loader_create_instance_chain(const VkInstanceCreateInfo *pCreateInfo, c
         // Create instance chain of enabled layers
         for (int32_t i = inst->expanded_activated_layer_list.count - 1; i >= 0; i--) {
             struct loader_layer_properties *layer_prop = &inst->expanded_activated_layer_list.list[i];
-            loader_platform_dl_handle lib_handle;
-
-            lib_handle = loader_open_layer_lib(inst, "instance", layer_prop);
-            if (!lib_handle) {
+            const struct loader_layer_lib_cache_entry *layer_lib = loader_open_layer_lib(inst, "instance", layer_prop);
+            if (NULL == layer_lib) {
                 continue;
             }
 
-            if (NULL == layer_prop->functions.negotiate_layer_interface) {
-                PFN_vkNegotiateLoaderLayerInterfaceVersion negotiate_interface = NULL;
-                bool functions_in_interface = false;
-                if (strlen(layer_prop->functions.str_negotiate_interface) == 0) {
-                    negotiate_interface = (PFN_vkNegotiateLoaderLayerInterfaceVersion)loader_platform_get_proc_address(
-                        lib_handle, "vkNegotiateLoaderLayerInterfaceVersion");
-                } else {
-                    negotiate_interface = (PFN_vkNegotiateLoaderLayerInterfaceVersion)loader_platform_get_proc_address(
-                        lib_handle, layer_prop->functions.str_negotiate_interface);
-                }
-
-                // If we can negotiate an interface version, then we can also
-                // get everything we need from the one function call, so try
-                // that first, and see if we can get all the function pointers
-                // necessary from that one call.
-                if (NULL != negotiate_interface) {
-                    layer_prop->functions.negotiate_layer_interface = negotiate_interface;
-
-                    VkNegotiateLayerInterface interface_struct;
-
-                    if (loader_get_layer_interface_version(negotiate_interface, &interface_struct)) {
-                        // Go ahead and set the properties version to the
-                        // correct value.
-                        layer_prop->interface_version = interface_struct.loaderLayerInterfaceVersion;
-
-                        // If the interface is 2 or newer, we have access to the
-                        // new GetPhysicalDeviceProcAddr function, so grab it,
-                        // and the other necessary functions, from the
-                        // structure.
-                        if (interface_struct.loaderLayerInterfaceVersion > 1) {
-                            cur_gipa = interface_struct.pfnGetInstanceProcAddr;
-                            cur_gpdpa = interface_struct.pfnGetPhysicalDeviceProcAddr;
-                            if (cur_gipa != NULL) {
-                                // We've set the functions, so make sure we
-                                // don't do the unnecessary calls later.
-                                functions_in_interface = true;
-                            }
-                        }
-                    }
-                }
-
-                if (!functions_in_interface) {
-                    if ((cur_gipa = layer_prop->functions.get_instance_proc_addr) == NULL) {
-                        if (strlen(layer_prop->functions.str_gipa) == 0) {
-                            cur_gipa =
-                                (PFN_vkGetInstanceProcAddr)loader_platform_get_proc_address(lib_handle, "vkGetInstanceProcAddr");
-                            layer_prop->functions.get_instance_proc_addr = cur_gipa;
-                        } else {
-                            cur_gipa = (PFN_vkGetInstanceProcAddr)loader_platform_get_proc_address(lib_handle,
-                                                                                                   layer_prop->functions.str_gipa);
-                        }
-
-                        if (NULL == cur_gipa) {
-                            loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
-                                       "loader_create_instance_chain: Failed to"
-                                       " find \'vkGetInstanceProcAddr\' in "
-                                       "layer %s",
-                                       layer_prop->lib_name);
-                            continue;
-                        }
-                    }
-                }
+            cur_gipa = layer_lib->get_instance_proc_addr;
+            cur_gpdpa = layer_lib->get_physical_device_proc_addr;
+            if (NULL == cur_gipa) {
+                loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
+                           "loader_create_instance_chain: Failed to"
+                           " find \'vkGetInstanceProcAddr\' in "
+                           "layer %s",
+                           layer_prop->lib_name);
+                continue;
             }
 
             layer_instance_link_info[activated_layers].pNext = chain_info.u.pLayerInfo;
@@ -4511,7 +4879,6 @@ VkResult loader_create_instance_chain(const VkInstanceCreateInfo *pCreateInfo, c
             layer_instance_link_info[activated_layers].pfnNextGetPhysicalDeviceProcAddr = next_gpdpa;
             next_gipa = cur_gipa;
             if (layer_prop->interface_version > 1 && cur_gpdpa != NULL) {
-                layer_prop->functions.get_physical_device_proc_addr = cur_gpdpa;
                 next_gpdpa = cur_gpdpa;
             }
 
@@ -4535,7 +4902,9 @@ VkResult loader_create_instance_chain(const VkInstanceCreateInfo *pCreateInfo, c
 
         create_info_disp.pNext = loader_create_info.pNext;
         loader_create_info.pNext = &create_info_disp;
+        uint64_t trace_start = loader_trace_begin();
         res = fpCreateInstance(&loader_create_info, pAllocator, created_instance);
+        loader_trace_end(inst, trace_start, "create", "vkCreateInstance through %u layers", activated_layers);
     } else {
         loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
                    "loader_create_instance_chain: Failed to find "
@@ -4632,80 +5001,25 @@ VkResult loader_create_device_chain(const struct loader_physical_device_tramp *p
         // Create instance chain of enabled layers
         for (int32_t i = dev->expanded_activated_layer_list.count - 1; i >= 0; i--) {
             struct loader_layer_properties *layer_prop = &dev->expanded_activated_layer_list.list[i];
-            loader_platform_dl_handle lib_handle;
-            bool functions_in_interface = false;
-
-            lib_handle = loader_open_layer_lib(inst, "device", layer_prop);
-            if (!lib_handle) {
+            const struct loader_layer_lib_cache_entry *layer_lib = loader_open_layer_lib(inst, "device", layer_prop);
+            if (NULL == layer_lib) {
                 continue;
             }
 
-            // If we can negotiate an interface version, then we can also get everything we need from the one function
-            // call, so try that first, and see if we can get all the function pointers necessary from that one call.
-            if (NULL == layer_prop->functions.negotiate_layer_interface) {
-                PFN_vkNegotiateLoaderLayerInterfaceVersion negotiate_interface = NULL;
-                if (strlen(layer_prop->functions.str_negotiate_interface) == 0) {
-                    negotiate_interface = (PFN_vkNegotiateLoaderLayerInterfaceVersion)loader_platform_get_proc_address(
-                        lib_handle, "vkNegotiateLoaderLayerInterfaceVersion");
-                } else {
-                    negotiate_interface = (PFN_vkNegotiateLoaderLayerInterfaceVersion)loader_platform_get_proc_address(
-                        lib_handle, layer_prop->functions.str_negotiate_interface);
-                }
-
-                if (NULL != negotiate_interface) {
-                    layer_prop->functions.negotiate_layer_interface = negotiate_interface;
-
-                    VkNegotiateLayerInterface interface_struct;
-
-                    if (loader_get_layer_interface_version(negotiate_interface, &interface_struct)) {
-                        // Go ahead and set the properties version to the correct value.
-                        layer_prop->interface_version = interface_struct.loaderLayerInterfaceVersion;
-
-                        // If the interface is 2 or newer, we have access to the new GetPhysicalDeviceProcAddr
-                        // function, so grab it, and the other necessary functions, from the structure.
-                        if (interface_struct.loaderLayerInterfaceVersion > 1) {
-                            fpGIPA = interface_struct.pfnGetInstanceProcAddr;
-                            fpGDPA = interface_struct.pfnGetDeviceProcAddr;
-                            if (fpGIPA != NULL && fpGDPA) {
-                                // We've set the functions, so make sure we
-                                // don't do the unnecessary calls later.
-                                functions_in_interface = true;
-                            }
-                        }
-                    }
-                }
+            fpGIPA = layer_lib->get_instance_proc_addr;
+            fpGDPA = layer_lib->get_device_proc_addr;
+            if (!fpGIPA) {
+                loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
+                           "loader_create_device_chain: Failed to find "
+                           "\'vkGetInstanceProcAddr\' in layer %s.  Skipping"
+                           " layer.",
+                           layer_prop->lib_name);
+                continue;
             }
-
-            if (!functions_in_interface) {
-                if ((fpGIPA = layer_prop->functions.get_instance_proc_addr) == NULL) {
-                    if (strlen(layer_prop->functions.str_gipa) == 0) {
-                        fpGIPA = (PFN_vkGetInstanceProcAddr)loader_platform_get_proc_address(lib_handle, "vkGetInstanceProcAddr");
-                        layer_prop->functions.get_instance_proc_addr = fpGIPA;
-                    } else
-                        fpGIPA =
-                            (PFN_vkGetInstanceProcAddr)loader_platform_get_proc_address(lib_handle, layer_prop->functions.str_gipa);
-                    if (!fpGIPA) {
-                        loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
-                                   "loader_create_device_chain: Failed to find "
-                                   "\'vkGetInstanceProcAddr\' in layer %s.  Skipping"
-                                   " layer.",
-                                   layer_prop->lib_name);
-                        continue;
-                    }
-                }
-                if ((fpGDPA = layer_prop->functions.get_device_proc_addr) == NULL) {
-                    if (strlen(layer_prop->functions.str_gdpa) == 0) {
-                        fpGDPA = (PFN_vkGetDeviceProcAddr)loader_platform_get_proc_address(lib_handle, "vkGetDeviceProcAddr");
-                        layer_prop->functions.get_device_proc_addr = fpGDPA;
-                    } else
-                        fpGDPA =
-                            (PFN_vkGetDeviceProcAddr)loader_platform_get_proc_address(lib_handle, layer_prop->functions.str_gdpa);
-                    if (!fpGDPA) {
-                        loader_log(inst, VK_DEBUG_REPORT_INFORMATION_BIT_EXT, 0, "Failed to find vkGetDeviceProcAddr in layer %s",
-                                   layer_prop->lib_name);
-                        continue;
-                    }
-                }
+            if (!fpGDPA) {
+                loader_log(inst, VK_DEBUG_REPORT_INFORMATION_BIT_EXT, 0, "Failed to find vkGetDeviceProcAddr in layer %s",
+                           layer_prop->lib_name);
+                continue;
             }
             layer_device_link_info[activated_layers].pNext = chain_info.u.pLayerInfo;
             layer_device_link_info[activated_layers].pfnNextGetInstanceProcAddr = nextGIPA;
@@ -4733,7 +5047,9 @@ VkResult loader_create_device_chain(const struct loader_physical_device_tramp *p
 
         create_info_disp.pNext = loader_create_info.pNext;
         loader_create_info.pNext = &create_info_disp;
+        uint64_t trace_start = loader_trace_begin();
         res = fpCreateDevice(pd->phys_dev, &loader_create_info, pAllocator, &created_device);
+        loader_trace_end(inst, trace_start, "create", "vkCreateDevice through %u layers", activated_layers);
         if (res != VK_SUCCESS) {
             return res;
         }
@@ -4900,8 +5216,9 @@ VkResult loader_validate_device_extensions(struct loader_physical_device_tramp *
 
 // Terminator functions for the Instance chain
 // All named terminator_<Vulakn API name>
-VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateInstance(const VkInstanceCreateInfo *pCreateInfo,
-                                                         const VkAllocationCallbacks *pAllocator, VkInstance *pInstance) {
+// Create the instance of each ICD for an instance, skipping ICDs that fail.
+static VkResult loader_create_icd_instances(struct loader_instance *ptr_instance, const VkInstanceCreateInfo *pCreateInfo,
+                                            const VkAllocationCallbacks *pAllocator) {
     struct loader_icd_term *icd_term;
     VkExtensionProperties *prop;
     char **filtered_extension_names = NULL;
@@ -4909,7 +5226,6 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateInstance(const VkInstanceCreateI
     VkResult res = VK_SUCCESS;
     bool one_icd_successful = false;
 
-    struct loader_instance *ptr_instance = (struct loader_instance *)*pInstance;
     memcpy(&icd_create_info, pCreateInfo, sizeof(icd_create_info));
 
     icd_create_info.enabledLayerCount = 0;
@@ -4930,7 +5246,12 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateInstance(const VkInstanceCreateI
     icd_create_info.ppEnabledExtensionNames = (const char *const *)filtered_extension_names;
 
     for (uint32_t i = 0; i < ptr_instance->icd_tramp_list.count; i++) {
-        icd_term = loader_icd_add(ptr_instance, &ptr_instance->icd_tramp_list.scanned_list[i]);
+        struct loader_scanned_icd *scanned_icd = &ptr_instance->icd_tramp_list.scanned_list[i];
+        if (!loader_scanned_icd_load(ptr_instance, scanned_icd)) {
+            continue;
+        }
+
+        icd_term = loader_icd_add(ptr_instance, scanned_icd);
         if (NULL == icd_term) {
             loader_log(ptr_instance, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
                        "terminator_CreateInstance: Failed to add ICD %d to ICD trampoline list.", i);
@@ -4959,8 +5280,7 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateInstance(const VkInstanceCreateI
             continue;
         }
 
-        res = loader_add_instance_extensions(ptr_instance, icd_term->scanned_icd->EnumerateInstanceExtensionProperties,
-                                             icd_term->scanned_icd->lib_name, &icd_exts);
+        res = loader_get_icd_instance_extensions(ptr_instance, scanned_icd, &icd_exts);
         if (VK_SUCCESS != res) {
             loader_destroy_generic_list(ptr_instance, (struct loader_generic_list *)&icd_exts);
             if (VK_ERROR_OUT_OF_HOST_MEMORY == res) {
@@ -4985,8 +5305,9 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateInstance(const VkInstanceCreateI
 
         loader_destroy_generic_list(ptr_instance, (struct loader_generic_list *)&icd_exts);
 
-        VkResult icd_result =
-            ptr_instance->icd_tramp_list.scanned_list[i].CreateInstance(&icd_create_info, pAllocator, &(icd_term->instance));
+        uint64_t trace_start = loader_trace_begin();
+        VkResult icd_result = scanned_icd->CreateInstance(&icd_create_info, pAllocator, &(icd_term->instance));
+        loader_trace_end(ptr_instance, trace_start, "create", "vkCreateInstance in ICD %s", scanned_icd->lib_name);
         if (VK_ERROR_OUT_OF_HOST_MEMORY == icd_result) {
             // If out of memory, bail immediately.
             res = VK_ERROR_OUT_OF_HOST_MEMORY;
@@ -5002,8 +5323,7 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateInstance(const VkInstanceCreateI
             continue;
         }
 
-        if (!loader_icd_init_entries(icd_term, icd_term->instance,
-                                     ptr_instance->icd_tramp_list.scanned_list[i].GetInstanceProcAddr)) {
+        if (!loader_icd_init_entries(icd_term, icd_term->instance, scanned_icd->GetInstanceProcAddr)) {
             loader_log(ptr_instance, VK_DEBUG_REPORT_WARNING_BIT_EXT, 0,
                        "terminator_CreateInstance: Failed to CreateInstance and find "
                        "entrypoints with ICD.  Skipping ICD.");
@@ -5039,6 +5359,128 @@ out:
     return res;
 }
 
+// Copy the parts of an instance create info the ICDs are created with, in one
+// allocation that loader_instance_heap_free releases.
+static VkInstanceCreateInfo *loader_copy_icd_create_info(const struct loader_instance *inst, const VkInstanceCreateInfo *pCreateInfo) {
+    const VkApplicationInfo *app_info = pCreateInfo->pApplicationInfo;
+    size_t size = sizeof(VkInstanceCreateInfo) + sizeof(VkApplicationInfo) + pCreateInfo->enabledExtensionCount * sizeof(char *);
+    size_t app_name_len = (NULL != app_info && NULL != app_info->pApplicationName) ? strlen(app_info->pApplicationName) + 1 : 0;
+    size_t engine_name_len = (NULL != app_info && NULL != app_info->pEngineName) ? strlen(app_info->pEngineName) + 1 : 0;
+    size += app_name_len + engine_name_len;
+    for (uint32_t i = 0; i < pCreateInfo->enabledExtensionCount; i++) {
+        size += strlen(pCreateInfo->ppEnabledExtensionNames[i]) + 1;
+    }
+
+    VkInstanceCreateInfo *copy = loader_instance_heap_alloc(inst, size, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
+    if (NULL == copy) {
+        return NULL;
+    }
+    VkApplicationInfo *app_info_copy = (VkApplicationInfo *)(copy + 1);
+    char **extension_names = (char **)(app_info_copy + 1);
+    char *strings = (char *)(extension_names + pCreateInfo->enabledExtensionCount);
+
+    *copy = *pCreateInfo;
+    copy->pNext = NULL;
+    copy->enabledLayerCount = 0;
+    copy->ppEnabledLayerNames = NULL;
+    if (NULL != app_info) {
+        *app_info_copy = *app_info;
+        app_info_copy->pNext = NULL;
+        if (app_name_len > 0) {
+            memcpy(strings, app_info->pApplicationName, app_name_len);
+            app_info_copy->pApplicationName = strings;
+            strings += app_name_len;
+        }
+        if (engine_name_len > 0) {
+            memcpy(strings, app_info->pEngineName, engine_name_len);
+            app_info_copy->pEngineName = strings;
+            strings += engine_name_len;
+        }
+        copy->pApplicationInfo = app_info_copy;
+    }
+    for (uint32_t i = 0; i < pCreateInfo->enabledExtensionCount; i++) {
+        size_t len = strlen(pCreateInfo->ppEnabledExtensionNames[i]) + 1;
+        memcpy(strings, pCreateInfo->ppEnabledExtensionNames[i], len);
+        extension_names[i] = strings;
+        strings += len;
+    }
+    copy->ppEnabledExtensionNames = (const char *const *)extension_names;
+    return copy;
+}
+
+// Create the ICD instances of an instance whose ICD creation was deferred by
+// terminator_CreateInstance.  Anything that needs inst->icd_terms to be
+// complete, such as enumerating physical devices or creating objects that
+// have a handle per ICD, calls this first.
+VkResult loader_create_pending_icd_instances(struct loader_instance *inst) {
+    VkResult res;
+
+    loader_platform_thread_lock_mutex(&loader_icd_create_lock);
+    if (NULL != inst->pending_icd_create_info) {
+        const VkAllocationCallbacks *pAllocator = NULL != inst->alloc_callbacks.pfnAllocation ? &inst->alloc_callbacks : NULL;
+        inst->icd_create_result = loader_create_icd_instances(inst, inst->pending_icd_create_info, pAllocator);
+        if (VK_SUCCESS != inst->icd_create_result && VK_ERROR_OUT_OF_HOST_MEMORY != inst->icd_create_result) {
+            loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
+                       "loader_create_pending_icd_instances: Failed to create an instance with any ICD");
+            inst->icd_create_result = VK_ERROR_INITIALIZATION_FAILED;
+        }
+        loader_instance_heap_free(inst, inst->pending_icd_create_info);
+        inst->pending_icd_create_info = NULL;
+    }
+    res = inst->icd_create_result;
+    loader_platform_thread_unlock_mutex(&loader_icd_create_lock);
+    return res;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateInstance(const VkInstanceCreateInfo *pCreateInfo,
+                                                         const VkAllocationCallbacks *pAllocator, VkInstance *pInstance) {
+    struct loader_instance *ptr_instance = (struct loader_instance *)*pInstance;
+    bool defer_icds = true;
+    char *env_value;
+
+    env_value = loader_getenv("VK_LOADER_DISABLE_LAZY_ICDS", ptr_instance);
+    if (NULL != env_value && atoi(env_value) != 0) {
+        defer_icds = false;
+    }
+    loader_free_getenv(env_value, ptr_instance);
+
+    // Structures the application chained to the create info can't be kept for
+    // later, so ICDs are only created lazily when there are none.  The layer
+    // chain info is only meant for layers.
+    for (const VkLayerInstanceCreateInfo *next = pCreateInfo->pNext; NULL != next; next = next->pNext) {
+        if (VK_STRUCTURE_TYPE_LOADER_INSTANCE_CREATE_INFO != next->sType) {
+            defer_icds = false;
+        }
+    }
+
+    // ICDs whose library failed to load when their extensions were queried
+    // can't be used, the others are only known to work when they are created.
+    uint32_t usable_icd_count = 0;
+    for (uint32_t i = 0; i < ptr_instance->icd_tramp_list.count; i++) {
+        const struct loader_scanned_icd *scanned_icd = &ptr_instance->icd_tramp_list.scanned_list[i];
+        if (!scanned_icd->load_attempted || NULL != scanned_icd->handle) {
+            usable_icd_count++;
+        }
+    }
+    if (0 == usable_icd_count) {
+        return VK_ERROR_INCOMPATIBLE_DRIVER;
+    }
+
+    if (defer_icds) {
+        // Loading the ICDs and creating their instances is left until the
+        // instance needs them.  This keeps drivers of GPUs the application
+        // never uses asleep when it only creates an instance.
+        ptr_instance->pending_icd_create_info = loader_copy_icd_create_info(ptr_instance, pCreateInfo);
+        if (NULL != ptr_instance->pending_icd_create_info) {
+            ptr_instance->icd_create_result = VK_SUCCESS;
+            return VK_SUCCESS;
+        }
+    }
+
+    ptr_instance->icd_create_result = loader_create_icd_instances(ptr_instance, pCreateInfo, pAllocator);
+    return ptr_instance->icd_create_result;
+}
+
 VKAPI_ATTR void VKAPI_CALL terminator_DestroyInstance(VkInstance instance, const VkAllocationCallbacks *pAllocator) {
     struct loader_instance *ptr_instance = loader_instance(instance);
     if (NULL == ptr_instance) {
@@ -5074,6 +5516,7 @@ VKAPI_ATTR void VKAPI_CALL terminator_DestroyInstance(VkInstance instance, const
         icd_terms = next_icd_term;
     }
 
+    loader_instance_heap_free(ptr_instance, ptr_instance->pending_icd_create_info);
     loader_delete_layer_properties(ptr_instance, &ptr_instance->instance_layer_list);
     loader_scanned_icd_clear(ptr_instance, &ptr_instance->icd_tramp_list);
     loader_destroy_generic_list(ptr_instance, (struct loader_generic_list *)&ptr_instance->ext_list);
@@ -5318,20 +5761,6 @@ VkResult setupLoaderTrampPhysDevs(VkInstance instance) {
     // the count up.
     total_count = inst->total_gpu_count;
 
-    // Create an array for the new physical devices, which will be stored
-    // in the instance for the trampoline code.
-    new_phys_devs = (struct loader_physical_device_tramp **)loader_instance_heap_alloc(
-        inst, total_count * sizeof(struct loader_physical_device_tramp *), VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
-    if (NULL == new_phys_devs) {
-        loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
-                   "setupLoaderTrampPhysDevs:  Failed to allocate new physical device"
-                   " array of size %d",
-                   total_count);
-        res = VK_ERROR_OUT_OF_HOST_MEMORY;
-        goto out;
-    }
-    memset(new_phys_devs, 0, total_count * sizeof(struct loader_physical_device_tramp *));
-
     // Create a temporary array (on the stack) to keep track of the
     // returned VkPhysicalDevice values.
     local_phys_devs = loader_stack_alloc(sizeof(VkPhysicalDevice) * total_count);
@@ -5354,6 +5783,32 @@ VkResult setupLoaderTrampPhysDevs(VkInstance instance) {
         goto out;
     }
 
+    // Repeated enumerations normally return the same physical devices in the
+    // same order, in which case the current array is kept.
+    if (total_count == inst->phys_dev_count_tramp) {
+        uint32_t same = 0;
+        while (same < total_count && local_phys_devs[same] == inst->phys_devs_tramp[same]->phys_dev) {
+            same++;
+        }
+        if (same == total_count) {
+            return VK_SUCCESS;
+        }
+    }
+
+    // Create an array for the new physical devices, which will be stored
+    // in the instance for the trampoline code.
+    new_phys_devs = (struct loader_physical_device_tramp **)loader_instance_heap_alloc(
+        inst, total_count * sizeof(struct loader_physical_device_tramp *), VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
+    if (NULL == new_phys_devs) {
+        loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
+                   "setupLoaderTrampPhysDevs:  Failed to allocate new physical device"
+                   " array of size %d",
+                   total_count);
+        res = VK_ERROR_OUT_OF_HOST_MEMORY;
+        goto out;
+    }
+    memset(new_phys_devs, 0, total_count * sizeof(struct loader_physical_device_tramp *));
+
     // Copy or create everything to fill the new array of physical devices
     for (uint32_t new_idx = 0; new_idx < total_count; new_idx++) {
         // Check if this physical device is already in the old buffer
@@ -5428,6 +5883,17 @@ VkResult setupLoaderTermPhysDevs(struct loader_instance *inst) {
     struct loader_phys_dev_per_icd *icd_phys_dev_array = NULL;
     struct loader_physical_device_term **new_phys_devs = NULL;
 
+    res = loader_create_pending_icd_instances(inst);
+    if (VK_SUCCESS != res) {
+        goto out;
+    }
+
+    // The set of ICDs can't change during the life of the instance, and
+    // their physical devices were already enumerated.
+    if (inst->phys_devs_term_valid) {
+        return VK_SUCCESS;
+    }
+
     inst->total_gpu_count = 0;
 
     // Allocate something to store the physical device characteristics
@@ -5569,6 +6035,7 @@ out:
         // Swap out old and new devices list
         inst->phys_dev_count_term = inst->total_gpu_count;
         inst->phys_devs_term = new_phys_devs;
+        inst->phys_devs_term_valid = true;
     }
 
     return res;
@@ -5579,8 +6046,8 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_EnumeratePhysicalDevices(VkInstance in
     struct loader_instance *inst = (struct loader_instance *)instance;
     VkResult res = VK_SUCCESS;
 
-    // Always call the setup loader terminator physical devices because they may
-    // have changed at any point.
+    // Set up the loader terminator physical devices, which only queries the
+    // ICDs the first time.
     res = setupLoaderTermPhysDevs(inst);
     if (VK_SUCCESS != res) {
         goto out;
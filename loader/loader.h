@@ -145,19 +145,16 @@ struct loader_layer_list {
     struct loader_layer_properties *list;
 };
 
-struct loader_dispatch_hash_list {
-    size_t capacity;
-    uint32_t count;
-    uint32_t *index;  // index into the dev_ext dispatch table
-};
-
 // loader_dispatch_hash_entry and loader_dev_ext_dispatch_table.dev_ext have
 // one to one correspondence; one loader_dispatch_hash_entry for one dev_ext
 // dispatch entry.
 // Also have a one to one correspondence with functions in dev_ext_trampoline.c
+// Collisions are resolved by linear probing.  Entries are looked up without
+// locking: func_name is published last with loader_platform_atomic_store_ptr
+// and entries are never removed while the instance exists.
 struct loader_dispatch_hash_entry {
     char *func_name;
-    struct loader_dispatch_hash_list list;  // to handle hashing collisions
+    uint32_t hash;  // murmurhash of func_name
 };
 
 typedef void(VKAPI_PTR *PFN_vkDevExt)(VkDevice device);
@@ -233,6 +230,11 @@ struct loader_instance {
     uint32_t phys_dev_count_tramp;
     struct loader_physical_device_tramp **phys_devs_tramp;
 
+    // The ICDs are only asked for their physical devices and groups the first
+    // time they are needed; later enumerations reuse the terminator lists.
+    bool phys_devs_term_valid;
+    bool phys_dev_groups_term_valid;
+
     // We also need to manually track physical device groups, but we don't need
     // loader specific structures since we have that content in the physical
     // device stored internal to the public structures.
@@ -247,6 +249,12 @@ struct loader_instance {
     struct loader_icd_term *icd_terms;
     struct loader_icd_tramp_list icd_tramp_list;
 
+    // The ICD instances are created when the instance first needs them, see
+    // loader_create_pending_icd_instances.  Until then pending_icd_create_info
+    // holds a copy of the create info they will be created with.
+    VkInstanceCreateInfo *pending_icd_create_info;
+    VkResult icd_create_result;
+
     struct loader_dispatch_hash_entry dev_ext_disp_hash[MAX_NUM_UNKNOWN_EXTS];
     struct loader_dispatch_hash_entry phys_dev_ext_disp_hash[MAX_NUM_UNKNOWN_EXTS];
 
@@ -268,6 +276,12 @@ struct loader_instance {
     union loader_instance_extension_enables enabled_known_extensions;
 
     VkLayerDbgFunctionNode *DbgFunctionHead;
+    // Copy of DbgFunctionHead that messages are dispatched from without
+    // locking, see debug_report.c
+    struct loader_dbg_callback_array *dbg_callbacks;
+    struct loader_dbg_callback_array *retired_dbg_callbacks;
+    uint32_t dbg_callback_readers[2];
+    uint32_t dbg_callback_epoch;
     uint32_t num_tmp_callbacks;
     VkDebugReportCallbackCreateInfoEXT *tmp_dbg_create_infos;
     VkDebugReportCallbackEXT *tmp_callbacks;
@@ -330,7 +344,8 @@ struct loader_struct {
 
 struct loader_scanned_icd {
     char *lib_name;
-    loader_platform_dl_handle handle;
+    loader_platform_dl_handle handle;  // NULL until loader_scanned_icd_load opens the library
+    bool load_attempted;
     uint32_t api_version;
     uint32_t interface_version;
     PFN_vkGetInstanceProcAddr GetInstanceProcAddr;
@@ -378,6 +393,8 @@ extern THREAD_LOCAL_DECL struct loader_instance *tls_instance;
 extern LOADER_PLATFORM_THREAD_ONCE_DEFINITION(once_init);
 extern loader_platform_thread_mutex loader_lock;
 extern loader_platform_thread_mutex loader_json_lock;
+extern loader_platform_thread_mutex loader_icd_create_lock;
+extern loader_platform_thread_mutex loader_ext_table_lock;
 
 struct loader_msg_callback_map_entry {
     VkDebugReportCallbackEXT icd_obj;
@@ -398,6 +415,13 @@ void *loader_device_heap_realloc(const struct loader_device *device, void *pMemo
 
 void loader_log(const struct loader_instance *inst, VkFlags msg_type, int32_t msg_code, const char *format, ...);
 
+// Time a phase of loader work, such as scanning, parsing, opening or creating.  Pass the value returned by
+// loader_trace_begin to loader_trace_end when the phase is over, which adds a zone to the timeline.  Tracing is
+// off unless VK_LOADER_DEBUG has the "timing" option or the timeline is recording, see vk_timeline.h, in which case
+// loader_trace_begin returns 0.
+uint64_t loader_trace_begin(void);
+void loader_trace_end(const struct loader_instance *inst, uint64_t start, const char *phase, const char *format, ...);
+
 bool compare_vk_extension_properties(const VkExtensionProperties *op1, const VkExtensionProperties *op2);
 
 VkResult loader_validate_layers(const struct loader_instance *inst, const uint32_t layer_count,
@@ -435,6 +459,8 @@ void loader_find_layer_name_add_list(const struct loader_instance *inst, const c
                                      struct loader_layer_list *expanded_target_list);
 void loader_scanned_icd_clear(const struct loader_instance *inst, struct loader_icd_tramp_list *icd_tramp_list);
 VkResult loader_icd_scan(const struct loader_instance *inst, struct loader_icd_tramp_list *icd_tramp_list);
+bool loader_scanned_icd_load(const struct loader_instance *inst, struct loader_scanned_icd *scanned_icd);
+VkResult loader_create_pending_icd_instances(struct loader_instance *inst);
 void loader_layer_scan(const struct loader_instance *inst, struct loader_layer_list *instance_layers);
 void loader_implicit_layer_scan(const struct loader_instance *inst, struct loader_layer_list *instance_layers);
 bool loader_is_implicit_layer_enabled(const struct loader_instance *inst, const struct loader_layer_properties *prop);
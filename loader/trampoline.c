@@ -96,6 +96,32 @@ LOADER_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(VkDev
     return disp_table->GetDeviceProcAddr(device, pName);
 }
 
+// Copy the device's dispatch table, which holds what vkGetDeviceProcAddr
+// returns for most device level entry points, into the application's table.
+// @param device
+// @param tableSize  sizeof(VkLayerDispatchTable) in the application
+// @param pTable
+// @return
+//    VK_SUCCESS, or VK_ERROR_INITIALIZATION_FAILED if device has no dispatch
+//    table.
+LOADER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkGetDeviceDispatchTableLUNARG(VkDevice device, size_t tableSize,
+                                                                            VkLayerDispatchTable *pTable) {
+    const VkLayerDispatchTable *disp_table = *(VkLayerDispatchTable **)device;
+    if (disp_table == NULL || pTable == NULL) return VK_ERROR_INITIALIZATION_FAILED;
+
+    // Tables of other loader versions differ only in the extensions at their end
+    size_t copySize = tableSize < sizeof(VkLayerDispatchTable) ? tableSize : sizeof(VkLayerDispatchTable);
+    memcpy(pTable, disp_table, copySize);
+    if (tableSize > copySize) memset((char *)pTable + copySize, 0, tableSize - copySize);
+
+    // The entrypoints the loader must handle itself, as in vkGetDeviceProcAddr
+    pTable->GetDeviceProcAddr = vkGetDeviceProcAddr;
+    pTable->DestroyDevice = vkDestroyDevice;
+    pTable->GetDeviceQueue = vkGetDeviceQueue;
+    pTable->AllocateCommandBuffers = vkAllocateCommandBuffers;
+    return VK_SUCCESS;
+}
+
 LOADER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceExtensionProperties(const char *pLayerName,
                                                                                     uint32_t *pPropertyCount,
                                                                                     VkExtensionProperties *pProperties) {
@@ -229,6 +255,7 @@ LOADER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(const VkInstanceCr
     VkResult res = VK_ERROR_INITIALIZATION_FAILED;
 
     loader_platform_thread_once(&once_init, loader_initialize);
+    uint64_t trace_start = loader_trace_begin();
 
     // Fail if the requested Vulkan apiVersion is > 1.0 since the loader only supports 1.0.
     // Having pCreateInfo == NULL, pCreateInfo->pApplication == NULL, or
@@ -391,6 +418,7 @@ out:
             loader_scanned_icd_clear(ptr_instance, &ptr_instance->icd_tramp_list);
             loader_destroy_generic_list(ptr_instance, (struct loader_generic_list *)&ptr_instance->ext_list);
 
+            util_FreeDebugReportCallbackArrays(ptr_instance);
             loader_instance_heap_free(ptr_instance, ptr_instance);
         } else {
             // Remove temporary debug_report callback
@@ -403,6 +431,8 @@ out:
         }
     }
 
+    // The instance may be gone by now, so the total is only logged
+    loader_trace_end(NULL, trace_start, "create", "vkCreateInstance total (result %d)", res);
     return res;
 }
 
@@ -461,6 +491,7 @@ LOADER_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroyInstance(VkInstance instance,
         util_FreeDebugReportCreateInfos(pAllocator, ptr_instance->tmp_dbg_create_infos, ptr_instance->tmp_callbacks);
     }
     loader_instance_heap_free(ptr_instance, ptr_instance->disp);
+    util_FreeDebugReportCallbackArrays(ptr_instance);
     loader_instance_heap_free(ptr_instance, ptr_instance);
     loader_platform_thread_unlock_mutex(&loader_lock);
 }
@@ -40,11 +40,14 @@
 // Note: The following file is for dynamic loading:
 #include <dlfcn.h>
 #include <pthread.h>
+#include <sched.h>
 #include <assert.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <libgen.h>
+#include <sys/stat.h>
+#include <time.h>
 
 // VK Library Filenames, Paths, etc.:
 #define PATH_SEPARATOR ':'
@@ -86,6 +89,15 @@ static inline bool loader_platform_file_exists(const char *path) {
         return true;
 }
 
+// Get the size and last modification time of a file, or return false if it does not exist.
+static inline bool loader_platform_file_info(const char *path, uint64_t *size, uint64_t *mtime) {
+    struct stat info;
+    if (stat(path, &info)) return false;
+    *size = (uint64_t)info.st_size;
+    *mtime = (uint64_t)info.st_mtim.tv_sec * 1000000000 + (uint64_t)info.st_mtim.tv_nsec;
+    return true;
+}
+
 static inline bool loader_platform_is_path_absolute(const char *path) {
     if (path[0] == '/')
         return true;
@@ -140,6 +152,22 @@ static inline void loader_platform_thread_cond_wait(loader_platform_thread_cond
     pthread_cond_wait(pCond, pMutex);
 }
 static inline void loader_platform_thread_cond_broadcast(loader_platform_thread_cond *pCond) { pthread_cond_broadcast(pCond); }
+static inline void loader_platform_thread_yield() { sched_yield(); }
+
+// Atomic pointers, for data that is read without locking.  A load sees
+// everything written before the store that published the pointer.
+static inline void *loader_platform_atomic_load_ptr(void *const *pPtr) { return __atomic_load_n(pPtr, __ATOMIC_ACQUIRE); }
+static inline void loader_platform_atomic_store_ptr(void **pPtr, void *value) { __atomic_store_n(pPtr, value, __ATOMIC_RELEASE); }
+static inline void *loader_platform_atomic_exchange_ptr(void **pPtr, void *value) {
+    return __atomic_exchange_n(pPtr, value, __ATOMIC_SEQ_CST);
+}
+// Atomic counters, fully ordered with the pointer exchange above
+static inline uint32_t loader_platform_atomic_load_u32(uint32_t *pValue) { return __atomic_load_n(pValue, __ATOMIC_SEQ_CST); }
+static inline void loader_platform_atomic_increment_u32(uint32_t *pValue) { __atomic_add_fetch(pValue, 1, __ATOMIC_SEQ_CST); }
+static inline void loader_platform_atomic_decrement_u32(uint32_t *pValue) { __atomic_sub_fetch(pValue, 1, __ATOMIC_SEQ_CST); }
+static inline void loader_platform_atomic_store_u32(uint32_t *pValue, uint32_t value) {
+    __atomic_store_n(pValue, value, __ATOMIC_SEQ_CST);
+}
 
 #define loader_stack_alloc(size) alloca(size)
 
@@ -221,6 +249,15 @@ static bool loader_platform_file_exists(const char *path) {
         return true;
 }
 
+// Get the size and last modification time of a file, or return false if it does not exist.
+static bool loader_platform_file_info(const char *path, uint64_t *size, uint64_t *mtime) {
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &info)) return false;
+    *size = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+    *mtime = ((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
 static bool loader_platform_is_path_absolute(const char *path) { return !PathIsRelative(path); }
 
 // WIN32 runtime doesn't have dirname().
@@ -328,6 +365,26 @@ static void loader_platform_thread_cond_wait(loader_platform_thread_cond *pCond,
     SleepConditionVariableCS(pCond, pMutex, INFINITE);
 }
 static void loader_platform_thread_cond_broadcast(loader_platform_thread_cond *pCond) { WakeAllConditionVariable(pCond); }
+static void loader_platform_thread_yield() { SwitchToThread(); }
+
+// Atomic pointers, for data that is read without locking.  A load sees
+// everything written before the store that published the pointer.
+static void *loader_platform_atomic_load_ptr(void *const *pPtr) {
+    return InterlockedCompareExchangePointer((PVOID volatile *)pPtr, NULL, NULL);
+}
+static void loader_platform_atomic_store_ptr(void **pPtr, void *value) { InterlockedExchangePointer((PVOID volatile *)pPtr, value); }
+static void *loader_platform_atomic_exchange_ptr(void **pPtr, void *value) {
+    return InterlockedExchangePointer((PVOID volatile *)pPtr, value);
+}
+// Atomic counters, fully ordered with the pointer exchange above
+static uint32_t loader_platform_atomic_load_u32(uint32_t *pValue) {
+    return (uint32_t)InterlockedCompareExchange((LONG volatile *)pValue, 0, 0);
+}
+static void loader_platform_atomic_increment_u32(uint32_t *pValue) { InterlockedIncrement((LONG volatile *)pValue); }
+static void loader_platform_atomic_decrement_u32(uint32_t *pValue) { InterlockedDecrement((LONG volatile *)pValue); }
+static void loader_platform_atomic_store_u32(uint32_t *pValue, uint32_t value) {
+    InterlockedExchange((LONG volatile *)pValue, value);
+}
 
 #define loader_stack_alloc(size) _alloca(size)
 #else  // defined(_WIN32)
@@ -0,0 +1,385 @@
+/*
+ * Copyright (c) 2017 The Khronos Group Inc.
+ * Copyright (c) 2017 Valve Corporation
+ * Copyright (c) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#endif
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vk_timeline.h"
+
+#define TIMELINE_CATEGORY_SIZE 16
+#define TIMELINE_NAME_SIZE 128
+#define TIMELINE_BUFFER_EVENTS 1024
+// Text written at once, and the longest line an event turns into: escaping at most doubles the strings
+#define TIMELINE_TEXT_SIZE (16 * 1024)
+#define TIMELINE_LINE_SIZE (2 * (TIMELINE_CATEGORY_SIZE + TIMELINE_NAME_SIZE) + 192)
+
+enum { TIMELINE_ZONE, TIMELINE_COUNTER, TIMELINE_THREAD_NAME };
+
+typedef struct {
+    uint64_t time;
+    uint64_t duration;  // of a zone
+    double value;       // of a counter
+    uint32_t type;
+    char category[TIMELINE_CATEGORY_SIZE];
+    char name[TIMELINE_NAME_SIZE];
+} timeline_event;
+
+// Events recorded by one thread.  When the thread exits, the next thread to record takes the buffer over.
+typedef struct timeline_buffer {
+    struct timeline_buffer *next;
+    volatile long in_use;
+    uint64_t thread_id;
+    uint32_t count;
+    timeline_event events[TIMELINE_BUFFER_EVENTS];
+} timeline_buffer;
+
+enum { TIMELINE_UNKNOWN, TIMELINE_OFF, TIMELINE_ON };
+static volatile int timeline_state = TIMELINE_UNKNOWN;
+static int timeline_fd = -1;
+static uint64_t timeline_pid = 0;
+// Every buffer, only ever pushed to while the module is loaded
+static timeline_buffer *volatile timeline_buffers = NULL;
+
+static void timeline_write(timeline_buffer *buffer);
+static void timeline_unload(void);
+
+#if defined(_WIN32)
+
+static __declspec(thread) timeline_buffer *timeline_thread_buffer = NULL;
+static SRWLOCK timeline_setup_lock = SRWLOCK_INIT;
+
+static void timeline_lock(void) { AcquireSRWLockExclusive(&timeline_setup_lock); }
+static void timeline_unlock(void) { ReleaseSRWLockExclusive(&timeline_setup_lock); }
+static bool timeline_claim(volatile long *in_use) { return 0 == InterlockedCompareExchange(in_use, 1, 0); }
+static bool timeline_push(timeline_buffer *buffer) {
+    return buffer->next == InterlockedCompareExchangePointer((PVOID volatile *)&timeline_buffers, buffer, buffer->next);
+}
+static void timeline_barrier(void) { MemoryBarrier(); }
+static uint64_t timeline_thread_id(void) { return (uint64_t)GetCurrentThreadId(); }
+static uint64_t timeline_process_id(void) { return (uint64_t)GetCurrentProcessId(); }
+static const char *timeline_getenv(void) { return getenv("VK_TIMELINE_FILE"); }
+static int timeline_create_file(const char *path) {
+    return _open(path, _O_WRONLY | _O_CREAT | _O_EXCL | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE);
+}
+static int timeline_append_file(const char *path) { return _open(path, _O_WRONLY | _O_APPEND | _O_BINARY); }
+static void timeline_write_file(int fd, const char *text, size_t size) { _write(fd, text, (unsigned int)size); }
+static void timeline_close_file(int fd) { _close(fd); }
+
+// A thread that exits keeps its buffer, which is written when the module is unloaded
+static void timeline_thread_started(timeline_buffer *buffer) { (void)buffer; }
+static void timeline_setup_done(void) { atexit(timeline_unload); }
+static void timeline_teardown(void) {}
+
+uint64_t vk_timeline_now(void) {
+    LARGE_INTEGER now, frequency;
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)now.QuadPart / frequency.QuadPart * 1000000000 +
+           (uint64_t)now.QuadPart % frequency.QuadPart * 1000000000 / frequency.QuadPart;
+}
+
+#else
+
+static __thread timeline_buffer *timeline_thread_buffer = NULL;
+static pthread_mutex_t timeline_setup_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t timeline_thread_key;
+
+static void timeline_lock(void) { pthread_mutex_lock(&timeline_setup_lock); }
+static void timeline_unlock(void) { pthread_mutex_unlock(&timeline_setup_lock); }
+static bool timeline_claim(volatile long *in_use) { return __sync_bool_compare_and_swap(in_use, 0, 1); }
+static bool timeline_push(timeline_buffer *buffer) {
+    return __sync_bool_compare_and_swap(&timeline_buffers, buffer->next, buffer);
+}
+static void timeline_barrier(void) { __sync_synchronize(); }
+static uint64_t timeline_thread_id(void) {
+#if defined(__linux__)
+    return (uint64_t)syscall(SYS_gettid);
+#elif defined(__APPLE__)
+    uint64_t id = 0;
+    pthread_threadid_np(NULL, &id);
+    return id;
+#else
+    return (uint64_t)(uintptr_t)pthread_self();
+#endif
+}
+static uint64_t timeline_process_id(void) { return (uint64_t)getpid(); }
+static const char *timeline_getenv(void) {
+    // Don't let the environment name a file for a setuid program to write
+    if (geteuid() != getuid() || getegid() != getgid()) {
+        return NULL;
+    }
+    return getenv("VK_TIMELINE_FILE");
+}
+static int timeline_create_file(const char *path) { return open(path, O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0644); }
+static int timeline_append_file(const char *path) { return open(path, O_WRONLY | O_APPEND | O_CLOEXEC); }
+static void timeline_write_file(int fd, const char *text, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, text, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return;
+        }
+        text += written;
+        size -= (size_t)written;
+    }
+}
+static void timeline_close_file(int fd) { close(fd); }
+
+static void timeline_thread_exit(void *buffer) {
+    timeline_write((timeline_buffer *)buffer);
+    timeline_thread_buffer = NULL;
+    __sync_lock_release(&((timeline_buffer *)buffer)->in_use);
+}
+static void timeline_thread_started(timeline_buffer *buffer) { pthread_setspecific(timeline_thread_key, buffer); }
+static void timeline_setup_done(void) { pthread_key_create(&timeline_thread_key, timeline_thread_exit); }
+static void timeline_teardown(void) { pthread_key_delete(timeline_thread_key); }
+
+// Runs at exit, and when a layer is unloaded
+__attribute__((destructor)) static void timeline_module_unload(void) { timeline_unload(); }
+
+uint64_t vk_timeline_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+#endif
+
+static void timeline_setup(const char *path) {
+    timeline_lock();
+    if (TIMELINE_UNKNOWN == timeline_state) {
+        if (NULL == path) {
+            path = timeline_getenv();
+        }
+        int fd = -1;
+        if (NULL != path && '\0' != path[0]) {
+            // The first module to open the file starts the event array, the others append to it
+            fd = timeline_create_file(path);
+            if (fd >= 0) {
+                timeline_write_file(fd, "[\n", 2);
+            } else {
+                fd = timeline_append_file(path);
+            }
+        }
+        if (fd >= 0) {
+            timeline_fd = fd;
+            timeline_pid = timeline_process_id();
+            timeline_setup_done();
+        }
+        timeline_barrier();
+        timeline_state = (fd >= 0) ? TIMELINE_ON : TIMELINE_OFF;
+    }
+    timeline_unlock();
+}
+
+// Called when the module is unloaded, by which time other threads are expected to be done with it
+static void timeline_unload(void) {
+    if (TIMELINE_ON != timeline_state) {
+        return;
+    }
+    timeline_state = TIMELINE_OFF;
+    timeline_teardown();
+    timeline_buffer *buffer = timeline_buffers;
+    timeline_buffers = NULL;
+    while (NULL != buffer) {
+        timeline_buffer *next = buffer->next;
+        timeline_write(buffer);
+        free(buffer);
+        buffer = next;
+    }
+    timeline_thread_buffer = NULL;
+    timeline_close_file(timeline_fd);
+    timeline_fd = -1;
+}
+
+bool vk_timeline_enabled(void) {
+    if (TIMELINE_UNKNOWN == timeline_state) {
+        timeline_setup(NULL);
+    }
+    return TIMELINE_ON == timeline_state;
+}
+
+bool vk_timeline_open(const char *path) {
+    if (TIMELINE_UNKNOWN == timeline_state) {
+        timeline_setup(path);
+    }
+    return TIMELINE_ON == timeline_state;
+}
+
+static timeline_buffer *timeline_get_thread_buffer(void) {
+    timeline_buffer *buffer = timeline_thread_buffer;
+    if (NULL != buffer) {
+        return buffer;
+    }
+
+    // Take over the buffer of a thread that exited, or add one
+    for (buffer = timeline_buffers; NULL != buffer; buffer = buffer->next) {
+        if (timeline_claim(&buffer->in_use)) {
+            break;
+        }
+    }
+    if (NULL == buffer) {
+        buffer = (timeline_buffer *)malloc(sizeof(timeline_buffer));
+        if (NULL == buffer) {
+            return NULL;
+        }
+        buffer->in_use = 1;
+        do {
+            buffer->next = timeline_buffers;
+        } while (!timeline_push(buffer));
+    }
+    buffer->thread_id = timeline_thread_id();
+    buffer->count = 0;
+    timeline_thread_buffer = buffer;
+    timeline_thread_started(buffer);
+    return buffer;
+}
+
+static void timeline_copy(char *dst, const char *src, size_t size) {
+    size_t len = 0;
+    if (NULL != src) {
+        while (len < size - 1 && '\0' != src[len]) {
+            dst[len] = src[len];
+            len++;
+        }
+    }
+    dst[len] = '\0';
+}
+
+static timeline_event *timeline_record(uint32_t type, const char *category, const char *name) {
+    if (!vk_timeline_enabled()) {
+        return NULL;
+    }
+    timeline_buffer *buffer = timeline_get_thread_buffer();
+    if (NULL == buffer) {
+        return NULL;
+    }
+    if (TIMELINE_BUFFER_EVENTS == buffer->count) {
+        timeline_write(buffer);
+    }
+    timeline_event *event = &buffer->events[buffer->count++];
+    event->type = type;
+    timeline_copy(event->category, category, sizeof(event->category));
+    timeline_copy(event->name, name, sizeof(event->name));
+    return event;
+}
+
+void vk_timeline_zone(const char *category, const char *name, uint64_t begin, uint64_t end) {
+    timeline_event *event = timeline_record(TIMELINE_ZONE, category, name);
+    if (NULL != event) {
+        event->time = begin;
+        event->duration = (end > begin) ? end - begin : 0;
+    }
+}
+
+void vk_timeline_counter(const char *category, const char *name, double value) {
+    timeline_event *event = timeline_record(TIMELINE_COUNTER, category, name);
+    if (NULL != event) {
+        event->time = vk_timeline_now();
+        // JSON has no infinities or NaNs
+        event->value = (value >= -DBL_MAX && value <= DBL_MAX) ? value : 0.0;
+    }
+}
+
+void vk_timeline_thread_name(const char *name) {
+    timeline_event *event = timeline_record(TIMELINE_THREAD_NAME, NULL, name);
+    if (NULL != event) {
+        event->time = 0;
+    }
+}
+
+void vk_timeline_flush(void) {
+    if (TIMELINE_ON == timeline_state && NULL != timeline_thread_buffer) {
+        timeline_write(timeline_thread_buffer);
+    }
+}
+
+// Copy src into dst as the contents of a JSON string, dst must have room for twice its length
+static void timeline_escape(char *dst, const char *src) {
+    for (; '\0' != *src; src++) {
+        if ('\\' == *src || '\"' == *src) {
+            *dst++ = '\\';
+        }
+        *dst++ = ((unsigned char)*src < 0x20) ? ' ' : *src;
+    }
+    *dst = '\0';
+}
+
+static void timeline_write(timeline_buffer *buffer) {
+    char text[TIMELINE_TEXT_SIZE];
+    char category[2 * TIMELINE_CATEGORY_SIZE];
+    char name[2 * TIMELINE_NAME_SIZE];
+    size_t size = 0;
+    unsigned long long pid = (unsigned long long)timeline_pid;
+    unsigned long long tid = (unsigned long long)buffer->thread_id;
+
+    for (uint32_t i = 0; i < buffer->count; i++) {
+        const timeline_event *event = &buffer->events[i];
+        timeline_escape(category, event->category);
+        timeline_escape(name, event->name);
+        char *line = text + size;
+        int len = 0;
+        switch (event->type) {
+            case TIMELINE_ZONE:
+                len = snprintf(line, TIMELINE_LINE_SIZE,
+                               "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%llu,\"tid\":%llu},\n",
+                               name, category, event->time / 1000.0, event->duration / 1000.0, pid, tid);
+                break;
+            case TIMELINE_COUNTER:
+                len = snprintf(line, TIMELINE_LINE_SIZE,
+                               "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":%llu,\"args\":{\"value\":%.17g}},\n",
+                               name, category, event->time / 1000.0, pid, event->value);
+                break;
+            case TIMELINE_THREAD_NAME:
+                len = snprintf(line, TIMELINE_LINE_SIZE,
+                               "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%llu,\"tid\":%llu,\"args\":{\"name\":\"%s\"}},\n", pid,
+                               tid, name);
+                break;
+        }
+        if (len > 0 && len < TIMELINE_LINE_SIZE) {
+            size += (size_t)len;
+        }
+
+        // Whole lines go out in one append, so events of other modules and processes don't interleave with them
+        if (size > TIMELINE_TEXT_SIZE - TIMELINE_LINE_SIZE || i + 1 == buffer->count) {
+            timeline_write_file(timeline_fd, text, size);
+            size = 0;
+        }
+    }
+    buffer->count = 0;
+}
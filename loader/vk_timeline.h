@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2017 The Khronos Group Inc.
+ * Copyright (c) 2017 Valve Corporation
+ * Copyright (c) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Timeline of where the loader, the layers, vktrace and vkreplay spend their time, written as a Chrome trace ("Trace
+// Event Format") file that chrome://tracing and the Perfetto UI open.
+//
+// Every module that uses it compiles vk_timeline.c in and keeps its own state.  Zones, counters and thread names go to
+// a buffer of the calling thread without taking a lock, and a full buffer is written with a single append to the file
+// named by VK_TIMELINE_FILE.  So the loader, the layers and vktrace in an application, and vkreplay with its loader and
+// layers, can all append to the same file and show up on one timeline.  Buffers are also written when their thread
+// exits (except on Windows) and when the module is unloaded.
+//
+// Events are appended, so remove the file before a run.  The JSON array is never closed, which trace viewers accept.
+// Without VK_TIMELINE_FILE, or vk_timeline_open, nothing is recorded and each call returns after a load and a branch.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Whether events are being recorded
+bool vk_timeline_enabled(void);
+
+// Record to path rather than to VK_TIMELINE_FILE.  Only has an effect before anything else is called.
+bool vk_timeline_open(const char *path);
+
+// Monotonic time in nanoseconds, on the same clock in every module
+uint64_t vk_timeline_now(void);
+
+// A zone of the calling thread from begin to end, both from vk_timeline_now.  The strings are copied, and truncated.
+void vk_timeline_zone(const char *category, const char *name, uint64_t begin, uint64_t end);
+
+// Counter name has value from now on
+void vk_timeline_counter(const char *category, const char *name, double value);
+
+// Name the calling thread on the timeline
+void vk_timeline_thread_name(const char *name);
+
+// Write what the calling thread recorded so far
+void vk_timeline_flush(void);
+
+#ifdef __cplusplus
+}
+
+// Records a zone from construction to destruction, see VK_TIMELINE_ZONE
+class VkTimelineZone {
+   public:
+    VkTimelineZone(const char *category, const char *name)
+        : category_(category), name_(name), begin_(vk_timeline_enabled() ? vk_timeline_now() : 0) {}
+    ~VkTimelineZone() {
+        if (begin_ != 0) {
+            vk_timeline_zone(category_, name_, begin_, vk_timeline_now());
+        }
+    }
+
+   private:
+    VkTimelineZone(const VkTimelineZone &);
+    VkTimelineZone &operator=(const VkTimelineZone &);
+
+    const char *category_;
+    const char *name_;
+    uint64_t begin_;
+};
+
+#define VK_TIMELINE_CONCAT_(a, b) a##b
+#define VK_TIMELINE_CONCAT(a, b) VK_TIMELINE_CONCAT_(a, b)
+// Zone named name from here to the end of the enclosing scope
+#define VK_TIMELINE_ZONE(category, name) VkTimelineZone VK_TIMELINE_CONCAT(vk_timeline_zone_, __LINE__)(category, name)
+#endif
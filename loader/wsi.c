@@ -151,22 +151,13 @@ VKAPI_ATTR void VKAPI_CALL terminator_DestroySurfaceKHR(VkInstance instance, VkS
 
     VkIcdSurface *icd_surface = (VkIcdSurface *)(uintptr_t)surface;
     if (NULL != icd_surface) {
-        if (NULL != icd_surface->real_icd_surfaces) {
-            uint32_t i = 0;
-            for (struct loader_icd_term *icd_term = ptr_instance->icd_terms; icd_term != NULL; icd_term = icd_term->next, i++) {
-                if (icd_term->scanned_icd->interface_version >= ICD_VER_SUPPORTS_ICD_SURFACE_KHR) {
-                    if (NULL != icd_term->dispatch.DestroySurfaceKHR && (VkSurfaceKHR)NULL != icd_surface->real_icd_surfaces[i]) {
-                        icd_term->dispatch.DestroySurfaceKHR(icd_term->instance, icd_surface->real_icd_surfaces[i], pAllocator);
-                        icd_surface->real_icd_surfaces[i] = (VkSurfaceKHR)NULL;
-                    }
-                } else {
-                    // The real_icd_surface for any ICD not supporting the
-                    // proper interface version should be NULL.  If not, then
-                    // we have a problem.
-                    assert((VkSurfaceKHR)NULL == icd_surface->real_icd_surfaces[i]);
-                }
+        uint32_t i = 0;
+        for (struct loader_icd_term *icd_term = ptr_instance->icd_terms; icd_term != NULL; icd_term = icd_term->next, i++) {
+            // Only ICDs new enough to create their own surfaces ever get one.
+            VkSurfaceKHR icd_surf = icd_surface->real_icd_surfaces[i].surface;
+            if (NULL != icd_term->dispatch.DestroySurfaceKHR && VK_NULL_HANDLE != icd_surf) {
+                icd_term->dispatch.DestroySurfaceKHR(icd_term->instance, icd_surf, pAllocator);
             }
-            loader_instance_heap_free(ptr_instance, icd_surface->real_icd_surfaces);
         }
 
         loader_instance_heap_free(ptr_instance, (void *)(uintptr_t)surface);
@@ -212,13 +203,13 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_GetPhysicalDeviceSurfaceSupportKHR(VkP
         assert(false && "loader: null GetPhysicalDeviceSurfaceSupportKHR ICD pointer");
     }
 
-    VkIcdSurface *icd_surface = (VkIcdSurface *)(uintptr_t)surface;
-    if (NULL != icd_surface->real_icd_surfaces && (VkSurfaceKHR)NULL != icd_surface->real_icd_surfaces[phys_dev_term->icd_index]) {
-        return icd_term->dispatch.GetPhysicalDeviceSurfaceSupportKHR(
-            phys_dev_term->phys_dev, queueFamilyIndex, icd_surface->real_icd_surfaces[phys_dev_term->icd_index], pSupported);
+    VkSurfaceKHR icd_surface;
+    VkResult res = wsi_unwrap_icd_surface(icd_term, phys_dev_term->icd_index, surface, &icd_surface);
+    if (VK_SUCCESS != res) {
+        return res;
     }
 
-    return icd_term->dispatch.GetPhysicalDeviceSurfaceSupportKHR(phys_dev_term->phys_dev, queueFamilyIndex, surface, pSupported);
+    return icd_term->dispatch.GetPhysicalDeviceSurfaceSupportKHR(phys_dev_term->phys_dev, queueFamilyIndex, icd_surface, pSupported);
 }
 
 // This is the trampoline entrypoint for GetPhysicalDeviceSurfaceCapabilitiesKHR
@@ -258,13 +249,13 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_GetPhysicalDeviceSurfaceCapabilitiesKH
         assert(false && "loader: null GetPhysicalDeviceSurfaceCapabilitiesKHR ICD pointer");
     }
 
-    VkIcdSurface *icd_surface = (VkIcdSurface *)(uintptr_t)surface;
-    if (NULL != icd_surface->real_icd_surfaces && (VkSurfaceKHR)NULL != icd_surface->real_icd_surfaces[phys_dev_term->icd_index]) {
-        return icd_term->dispatch.GetPhysicalDeviceSurfaceCapabilitiesKHR(
-            phys_dev_term->phys_dev, icd_surface->real_icd_surfaces[phys_dev_term->icd_index], pSurfaceCapabilities);
+    VkSurfaceKHR icd_surface;
+    VkResult res = wsi_unwrap_icd_surface(icd_term, phys_dev_term->icd_index, surface, &icd_surface);
+    if (VK_SUCCESS != res) {
+        return res;
     }
 
-    return icd_term->dispatch.GetPhysicalDeviceSurfaceCapabilitiesKHR(phys_dev_term->phys_dev, surface, pSurfaceCapabilities);
+    return icd_term->dispatch.GetPhysicalDeviceSurfaceCapabilitiesKHR(phys_dev_term->phys_dev, icd_surface, pSurfaceCapabilities);
 }
 
 // This is the trampoline entrypoint for GetPhysicalDeviceSurfaceFormatsKHR
@@ -306,14 +297,13 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_GetPhysicalDeviceSurfaceFormatsKHR(VkP
         assert(false && "loader: null GetPhysicalDeviceSurfaceFormatsKHR ICD pointer");
     }
 
-    VkIcdSurface *icd_surface = (VkIcdSurface *)(uintptr_t)surface;
-    if (NULL != icd_surface->real_icd_surfaces && (VkSurfaceKHR)NULL != icd_surface->real_icd_surfaces[phys_dev_term->icd_index]) {
-        return icd_term->dispatch.GetPhysicalDeviceSurfaceFormatsKHR(phys_dev_term->phys_dev,
-                                                                     icd_surface->real_icd_surfaces[phys_dev_term->icd_index],
-                                                                     pSurfaceFormatCount, pSurfaceFormats);
+    VkSurfaceKHR icd_surface;
+    VkResult res = wsi_unwrap_icd_surface(icd_term, phys_dev_term->icd_index, surface, &icd_surface);
+    if (VK_SUCCESS != res) {
+        return res;
     }
 
-    return icd_term->dispatch.GetPhysicalDeviceSurfaceFormatsKHR(phys_dev_term->phys_dev, surface, pSurfaceFormatCount,
+    return icd_term->dispatch.GetPhysicalDeviceSurfaceFormatsKHR(phys_dev_term->phys_dev, icd_surface, pSurfaceFormatCount,
                                                                  pSurfaceFormats);
 }
 
@@ -356,13 +346,13 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_GetPhysicalDeviceSurfacePresentModesKH
         assert(false && "loader: null GetPhysicalDeviceSurfacePresentModesKHR ICD pointer");
     }
 
-    VkIcdSurface *icd_surface = (VkIcdSurface *)(uintptr_t)surface;
-    if (NULL != icd_surface->real_icd_surfaces && (VkSurfaceKHR)NULL != icd_surface->real_icd_surfaces[phys_dev_term->icd_index]) {
-        return icd_term->dispatch.GetPhysicalDeviceSurfacePresentModesKHR(
-            phys_dev_term->phys_dev, icd_surface->real_icd_surfaces[phys_dev_term->icd_index], pPresentModeCount, pPresentModes);
+    VkSurfaceKHR icd_surface;
+    VkResult res = wsi_unwrap_icd_surface(icd_term, phys_dev_term->icd_index, surface, &icd_surface);
+    if (VK_SUCCESS != res) {
+        return res;
     }
 
-    return icd_term->dispatch.GetPhysicalDeviceSurfacePresentModesKHR(phys_dev_term->phys_dev, surface, pPresentModeCount,
+    return icd_term->dispatch.GetPhysicalDeviceSurfacePresentModesKHR(phys_dev_term->phys_dev, icd_surface, pPresentModeCount,
                                                                       pPresentModes);
 }
 
@@ -384,20 +374,17 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateSwapchainKHR(VkDevice device, co
     struct loader_device *dev;
     struct loader_icd_term *icd_term = loader_get_icd_and_device(device, &dev, &icd_index);
     if (NULL != icd_term && NULL != icd_term->dispatch.CreateSwapchainKHR) {
-        VkIcdSurface *icd_surface = (VkIcdSurface *)(uintptr_t)pCreateInfo->surface;
-        if (NULL != icd_surface->real_icd_surfaces) {
-            if ((VkSurfaceKHR)NULL != icd_surface->real_icd_surfaces[icd_index]) {
-                // We found the ICD, and there is an ICD KHR surface
-                // associated with it, so copy the CreateInfo struct
-                // and point it at the ICD's surface.
-                VkSwapchainCreateInfoKHR *pCreateCopy = loader_stack_alloc(sizeof(VkSwapchainCreateInfoKHR));
-                if (NULL == pCreateCopy) {
-                    return VK_ERROR_OUT_OF_HOST_MEMORY;
-                }
-                memcpy(pCreateCopy, pCreateInfo, sizeof(VkSwapchainCreateInfoKHR));
-                pCreateCopy->surface = icd_surface->real_icd_surfaces[icd_index];
-                return icd_term->dispatch.CreateSwapchainKHR(device, pCreateCopy, pAllocator, pSwapchain);
-            }
+        VkSurfaceKHR icd_surface;
+        VkResult res = wsi_unwrap_icd_surface(icd_term, icd_index, pCreateInfo->surface, &icd_surface);
+        if (VK_SUCCESS != res) {
+            return res;
+        }
+        if (icd_surface != pCreateInfo->surface) {
+            // There is an ICD KHR surface, so copy the CreateInfo struct
+            // and point it at the ICD's surface.
+            VkSwapchainCreateInfoKHR create_copy = *pCreateInfo;
+            create_copy.surface = icd_surface;
+            return icd_term->dispatch.CreateSwapchainKHR(device, &create_copy, pAllocator, pSwapchain);
         }
         return icd_term->dispatch.CreateSwapchainKHR(device, pCreateInfo, pAllocator, pSwapchain);
     }
@@ -435,10 +422,18 @@ LOADER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkQueuePresentKHR(VkQueue queue, co
     return disp->QueuePresentKHR(queue, pPresentInfo);
 }
 
-static VkIcdSurface *AllocateIcdSurfaceStruct(struct loader_instance *instance, size_t base_size, size_t platform_size) {
+static VkIcdSurface *AllocateIcdSurfaceStruct(struct loader_instance *instance, const VkAllocationCallbacks *pAllocator,
+                                              size_t base_size, size_t platform_size) {
+    // The surface holds a handle for each ICD, so the ICDs must exist first.
+    // If they all failed, the surface simply has no ICD surfaces.
+    loader_create_pending_icd_instances(instance);
+
     // Next, if so, proceed with the implementation of this function:
-    VkIcdSurface *pIcdSurface = loader_instance_heap_alloc(instance, sizeof(VkIcdSurface), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+    size_t size = sizeof(VkIcdSurface) + sizeof(struct loader_icd_surface) * instance->total_icd_count;
+    VkIcdSurface *pIcdSurface = loader_instance_heap_alloc(instance, size, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
     if (pIcdSurface != NULL) {
+        memset(pIcdSurface, 0, size);
+
         // Setup the new sizes and offsets so we can grow the structures in the
         // future without having problems
         pIcdSurface->base_size = (uint32_t)base_size;
@@ -446,18 +441,126 @@ static VkIcdSurface *AllocateIcdSurfaceStruct(struct loader_instance *instance,
         pIcdSurface->non_platform_offset = (uint32_t)((uint8_t *)(&pIcdSurface->base_size) - (uint8_t *)pIcdSurface);
         pIcdSurface->entire_size = sizeof(VkIcdSurface);
 
-        pIcdSurface->real_icd_surfaces = loader_instance_heap_alloc(instance, sizeof(VkSurfaceKHR) * instance->total_icd_count,
-                                                                    VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
-        if (pIcdSurface->real_icd_surfaces == NULL) {
-            loader_instance_heap_free(instance, pIcdSurface);
-            pIcdSurface = NULL;
-        } else {
-            memset(pIcdSurface->real_icd_surfaces, 0, sizeof(VkSurfaceKHR) * instance->total_icd_count);
+        // The ICD surfaces are only created once an ICD needs its own, see
+        // wsi_unwrap_icd_surface.
+        pIcdSurface->real_icd_surfaces = (struct loader_icd_surface *)(pIcdSurface + 1);
+        if (NULL != pAllocator) {
+            pIcdSurface->has_allocator = true;
+            pIcdSurface->allocator = *pAllocator;
         }
     }
     return pIcdSurface;
 }
 
+// Create the ICD's own surface for icd_surface from the platform info the
+// loader kept.  *pSurface is left VK_NULL_HANDLE if the ICD doesn't create
+// surfaces and takes the VkIcdSurface instead.
+static VkResult wsi_create_icd_surface(struct loader_icd_term *icd_term, const VkIcdSurface *icd_surface, VkSurfaceKHR *pSurface) {
+    const VkAllocationCallbacks *pAllocator = icd_surface->has_allocator ? &icd_surface->allocator : NULL;
+
+    *pSurface = VK_NULL_HANDLE;
+    if (icd_term->scanned_icd->interface_version < ICD_VER_SUPPORTS_ICD_SURFACE_KHR) {
+        return VK_SUCCESS;
+    }
+
+    switch (icd_surface->display_surf.base.platform) {
+#ifdef VK_USE_PLATFORM_WIN32_KHR
+        case VK_ICD_WSI_PLATFORM_WIN32:
+            if (NULL != icd_term->dispatch.CreateWin32SurfaceKHR) {
+                VkWin32SurfaceCreateInfoKHR info = {VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR, NULL, 0,
+                                                    icd_surface->win_surf.hinstance, icd_surface->win_surf.hwnd};
+                return icd_term->dispatch.CreateWin32SurfaceKHR(icd_term->instance, &info, pAllocator, pSurface);
+            }
+            break;
+#endif  // VK_USE_PLATFORM_WIN32_KHR
+#ifdef VK_USE_PLATFORM_MIR_KHR
+        case VK_ICD_WSI_PLATFORM_MIR:
+            if (NULL != icd_term->dispatch.CreateMirSurfaceKHR) {
+                VkMirSurfaceCreateInfoKHR info = {VK_STRUCTURE_TYPE_MIR_SURFACE_CREATE_INFO_KHR, NULL, 0,
+                                                  icd_surface->mir_surf.connection, icd_surface->mir_surf.mirSurface};
+                return icd_term->dispatch.CreateMirSurfaceKHR(icd_term->instance, &info, pAllocator, pSurface);
+            }
+            break;
+#endif  // VK_USE_PLATFORM_MIR_KHR
+#ifdef VK_USE_PLATFORM_WAYLAND_KHR
+        case VK_ICD_WSI_PLATFORM_WAYLAND:
+            if (NULL != icd_term->dispatch.CreateWaylandSurfaceKHR) {
+                VkWaylandSurfaceCreateInfoKHR info = {VK_STRUCTURE_TYPE_WAYLAND_SURFACE_CREATE_INFO_KHR, NULL, 0,
+                                                      icd_surface->wayland_surf.display, icd_surface->wayland_surf.surface};
+                return icd_term->dispatch.CreateWaylandSurfaceKHR(icd_term->instance, &info, pAllocator, pSurface);
+            }
+            break;
+#endif  // VK_USE_PLATFORM_WAYLAND_KHR
+#ifdef VK_USE_PLATFORM_XCB_KHR
+        case VK_ICD_WSI_PLATFORM_XCB:
+            if (NULL != icd_term->dispatch.CreateXcbSurfaceKHR) {
+                VkXcbSurfaceCreateInfoKHR info = {VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR, NULL, 0,
+                                                  icd_surface->xcb_surf.connection, icd_surface->xcb_surf.window};
+                return icd_term->dispatch.CreateXcbSurfaceKHR(icd_term->instance, &info, pAllocator, pSurface);
+            }
+            break;
+#endif  // VK_USE_PLATFORM_XCB_KHR
+#ifdef VK_USE_PLATFORM_XLIB_KHR
+        case VK_ICD_WSI_PLATFORM_XLIB:
+            if (NULL != icd_term->dispatch.CreateXlibSurfaceKHR) {
+                VkXlibSurfaceCreateInfoKHR info = {VK_STRUCTURE_TYPE_XLIB_SURFACE_CREATE_INFO_KHR, NULL, 0,
+                                                   icd_surface->xlib_surf.dpy, icd_surface->xlib_surf.window};
+                return icd_term->dispatch.CreateXlibSurfaceKHR(icd_term->instance, &info, pAllocator, pSurface);
+            }
+            break;
+#endif  // VK_USE_PLATFORM_XLIB_KHR
+        case VK_ICD_WSI_PLATFORM_DISPLAY:
+            if (NULL != icd_term->dispatch.CreateDisplayPlaneSurfaceKHR) {
+                const VkIcdSurfaceDisplay *display = &icd_surface->display_surf;
+                VkDisplaySurfaceCreateInfoKHR info = {VK_STRUCTURE_TYPE_DISPLAY_SURFACE_CREATE_INFO_KHR,
+                                                      NULL,
+                                                      0,
+                                                      display->displayMode,
+                                                      display->planeIndex,
+                                                      display->planeStackIndex,
+                                                      display->transform,
+                                                      display->globalAlpha,
+                                                      display->alphaMode,
+                                                      display->imageExtent};
+                return icd_term->dispatch.CreateDisplayPlaneSurfaceKHR(icd_term->instance, &info, pAllocator, pSurface);
+            }
+            break;
+        default:
+            break;
+    }
+    return VK_SUCCESS;
+}
+
+// Get the surface to pass to the ICD at icd_index in place of the loader's
+// surface, creating the ICD's own surface the first time it's needed.
+//     @return  VK_SUCCESS with *pIcdSurface set to the ICD's surface, or to
+//              surface if the ICD takes the VkIcdSurface itself; otherwise
+//              the error from creating the ICD's surface, which is retried on
+//              the next call.
+VkResult wsi_unwrap_icd_surface(struct loader_icd_term *icd_term, uint32_t icd_index, VkSurfaceKHR surface,
+                                VkSurfaceKHR *pIcdSurface) {
+    VkIcdSurface *icd_surface = (VkIcdSurface *)(uintptr_t)surface;
+    struct loader_icd_surface *entry = &icd_surface->real_icd_surfaces[icd_index];
+    VkResult res = VK_SUCCESS;
+
+    if (NULL == loader_platform_atomic_load_ptr((void *const *)&entry->created)) {
+        loader_platform_thread_lock_mutex(&loader_icd_create_lock);
+        if (NULL == entry->created) {
+            res = wsi_create_icd_surface(icd_term, icd_surface, &entry->surface);
+            if (VK_SUCCESS == res) {
+                loader_platform_atomic_store_ptr(&entry->created, entry);
+            }
+        }
+        loader_platform_thread_unlock_mutex(&loader_icd_create_lock);
+        if (VK_SUCCESS != res) {
+            return res;
+        }
+    }
+
+    *pIcdSurface = VK_NULL_HANDLE != entry->surface ? entry->surface : surface;
+    return VK_SUCCESS;
+}
+
 #ifdef VK_USE_PLATFORM_WIN32_KHR
 
 // Functions for the VK_KHR_win32_surface extension:
@@ -480,7 +583,6 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateWin32SurfaceKHR(VkInstance insta
                                                                 const VkAllocationCallbacks *pAllocator, VkSurfaceKHR *pSurface) {
     VkResult vkRes = VK_SUCCESS;
     VkIcdSurface *pIcdSurface = NULL;
-    uint32_t i = 0;
 
     // Initialize pSurface to NULL just to be safe.
     *pSurface = VK_NULL_HANDLE;
@@ -494,7 +596,8 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateWin32SurfaceKHR(VkInstance insta
     }
 
     // Next, if so, proceed with the implementation of this function:
-    pIcdSurface = AllocateIcdSurfaceStruct(ptr_instance, sizeof(pIcdSurface->win_surf.base), sizeof(pIcdSurface->win_surf));
+    pIcdSurface = AllocateIcdSurfaceStruct(ptr_instance, pAllocator, sizeof(pIcdSurface->win_surf.base),
+                                           sizeof(pIcdSurface->win_surf));
     if (pIcdSurface == NULL) {
         vkRes = VK_ERROR_OUT_OF_HOST_MEMORY;
         goto out;
@@ -504,36 +607,9 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateWin32SurfaceKHR(VkInstance insta
     pIcdSurface->win_surf.hinstance = pCreateInfo->hinstance;
     pIcdSurface->win_surf.hwnd = pCreateInfo->hwnd;
 
-    // Loop through each ICD and determine if they need to create a surface
-    for (struct loader_icd_term *icd_term = ptr_instance->icd_terms; icd_term != NULL; icd_term = icd_term->next, i++) {
-        if (icd_term->scanned_icd->interface_version >= ICD_VER_SUPPORTS_ICD_SURFACE_KHR) {
-            if (NULL != icd_term->dispatch.CreateWin32SurfaceKHR) {
-                vkRes = icd_term->dispatch.CreateWin32SurfaceKHR(icd_term->instance, pCreateInfo, pAllocator,
-                                                                 &pIcdSurface->real_icd_surfaces[i]);
-                if (VK_SUCCESS != vkRes) {
-                    goto out;
-                }
-            }
-        }
-    }
-
-    *pSurface = (VkSurfaceKHR)(pIcdSurface);
+    *pSurface = (VkSurfaceKHR)pIcdSurface;
 
 out:
-
-    if (VK_SUCCESS != vkRes && NULL != pIcdSurface) {
-        if (NULL != pIcdSurface->real_icd_surfaces) {
-            i = 0;
-            for (struct loader_icd_term *icd_term = ptr_instance->icd_terms; icd_term != NULL; icd_term = icd_term->next, i++) {
-                if ((VkSurfaceKHR)NULL != pIcdSurface->real_icd_surfaces[i] && NULL != icd_term->dispatch.DestroySurfaceKHR) {
-                    icd_term->dispatch.DestroySurfaceKHR(icd_term->instance, pIcdSurface->real_icd_surfaces[i], pAllocator);
-                }
-            }
-            loader_instance_heap_free(ptr_instance, pIcdSurface->real_icd_surfaces);
-        }
-        loader_instance_heap_free(ptr_instance, pIcdSurface);
-    }
-
     return vkRes;
 }
 
@@ -594,7 +670,6 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateMirSurfaceKHR(VkInstance instanc
                                                               const VkAllocationCallbacks *pAllocator, VkSurfaceKHR *pSurface) {
     VkResult vkRes = VK_SUCCESS;
     VkIcdSurface *pIcdSurface = NULL;
-    uint32_t i = 0;
 
     // First, check to ensure the appropriate extension was enabled:
     struct loader_instance *ptr_instance = loader_get_instance(instance);
@@ -606,7 +681,8 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateMirSurfaceKHR(VkInstance instanc
     }
 
     // Next, if so, proceed with the implementation of this function:
-    pIcdSurface = AllocateIcdSurfaceStruct(ptr_instance, sizeof(pIcdSurface->mir_surf.base), sizeof(pIcdSurface->mir_surf));
+    pIcdSurface = AllocateIcdSurfaceStruct(ptr_instance, pAllocator, sizeof(pIcdSurface->mir_surf.base),
+                                           sizeof(pIcdSurface->mir_surf));
     if (pIcdSurface == NULL) {
         vkRes = VK_ERROR_OUT_OF_HOST_MEMORY;
         goto out;
@@ -616,36 +692,9 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateMirSurfaceKHR(VkInstance instanc
     pIcdSurface->mir_surf.connection = pCreateInfo->connection;
     pIcdSurface->mir_surf.mirSurface = pCreateInfo->mirSurface;
 
-    // Loop through each ICD and determine if they need to create a surface
-    for (struct loader_icd_term *icd_term = ptr_instance->icd_terms; icd_term != NULL; icd_term = icd_term->next, i++) {
-        if (icd_term->scanned_icd->interface_version >= ICD_VER_SUPPORTS_ICD_SURFACE_KHR) {
-            if (NULL != icd_term->dispatch.CreateMirSurfaceKHR) {
-                vkRes = icd_term->dispatch.CreateMirSurfaceKHR(icd_term->instance, pCreateInfo, pAllocator,
-                                                               &pIcdSurface->real_icd_surfaces[i]);
-                if (VK_SUCCESS != vkRes) {
-                    goto out;
-                }
-            }
-        }
-    }
-
     *pSurface = (VkSurfaceKHR)pIcdSurface;
 
 out:
-
-    if (VK_SUCCESS != vkRes && NULL != pIcdSurface) {
-        if (NULL != pIcdSurface->real_icd_surfaces) {
-            i = 0;
-            for (struct loader_icd_term *icd_term = ptr_instance->icd_terms; icd_term != NULL; icd_term = icd_term->next, i++) {
-                if ((VkSurfaceKHR)NULL != pIcdSurface->real_icd_surfaces[i] && NULL != icd_term->dispatch.DestroySurfaceKHR) {
-                    icd_term->dispatch.DestroySurfaceKHR(icd_term->instance, pIcdSurface->real_icd_surfaces[i], pAllocator);
-                }
-            }
-            loader_instance_heap_free(ptr_instance, pIcdSurface->real_icd_surfaces);
-        }
-        loader_instance_heap_free(ptr_instance, pIcdSurface);
-    }
-
     return vkRes;
 }
 
@@ -707,7 +756,6 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateWaylandSurfaceKHR(VkInstance ins
                                                                   const VkAllocationCallbacks *pAllocator, VkSurfaceKHR *pSurface) {
     VkResult vkRes = VK_SUCCESS;
     VkIcdSurface *pIcdSurface = NULL;
-    uint32_t i = 0;
 
     // First, check to ensure the appropriate extension was enabled:
     struct loader_instance *ptr_instance = loader_get_instance(instance);
@@ -719,7 +767,8 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateWaylandSurfaceKHR(VkInstance ins
     }
 
     // Next, if so, proceed with the implementation of this function:
-    pIcdSurface = AllocateIcdSurfaceStruct(ptr_instance, sizeof(pIcdSurface->wayland_surf.base), sizeof(pIcdSurface->wayland_surf));
+    pIcdSurface = AllocateIcdSurfaceStruct(ptr_instance, pAllocator, sizeof(pIcdSurface->wayland_surf.base),
+                                           sizeof(pIcdSurface->wayland_surf));
     if (pIcdSurface == NULL) {
         vkRes = VK_ERROR_OUT_OF_HOST_MEMORY;
         goto out;
@@ -729,36 +778,9 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateWaylandSurfaceKHR(VkInstance ins
     pIcdSurface->wayland_surf.display = pCreateInfo->display;
     pIcdSurface->wayland_surf.surface = pCreateInfo->surface;
 
-    // Loop through each ICD and determine if they need to create a surface
-    for (struct loader_icd_term *icd_term = ptr_instance->icd_terms; icd_term != NULL; icd_term = icd_term->next, i++) {
-        if (icd_term->scanned_icd->interface_version >= ICD_VER_SUPPORTS_ICD_SURFACE_KHR) {
-            if (NULL != icd_term->dispatch.CreateWaylandSurfaceKHR) {
-                vkRes = icd_term->dispatch.CreateWaylandSurfaceKHR(icd_term->instance, pCreateInfo, pAllocator,
-                                                                   &pIcdSurface->real_icd_surfaces[i]);
-                if (VK_SUCCESS != vkRes) {
-                    goto out;
-                }
-            }
-        }
-    }
-
     *pSurface = (VkSurfaceKHR)pIcdSurface;
 
 out:
-
-    if (VK_SUCCESS != vkRes && NULL != pIcdSurface) {
-        if (NULL != pIcdSurface->real_icd_surfaces) {
-            i = 0;
-            for (struct loader_icd_term *icd_term = ptr_instance->icd_terms; icd_term != NULL; icd_term = icd_term->next, i++) {
-                if ((VkSurfaceKHR)NULL != pIcdSurface->real_icd_surfaces[i] && NULL != icd_term->dispatch.DestroySurfaceKHR) {
-                    icd_term->dispatch.DestroySurfaceKHR(icd_term->instance, pIcdSurface->real_icd_surfaces[i], pAllocator);
-                }
-            }
-            loader_instance_heap_free(ptr_instance, pIcdSurface->real_icd_surfaces);
-        }
-        loader_instance_heap_free(ptr_instance, pIcdSurface);
-    }
-
     return vkRes;
 }
 
@@ -822,7 +844,6 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateXcbSurfaceKHR(VkInstance instanc
                                                               const VkAllocationCallbacks *pAllocator, VkSurfaceKHR *pSurface) {
     VkResult vkRes = VK_SUCCESS;
     VkIcdSurface *pIcdSurface = NULL;
-    uint32_t i = 0;
 
     // First, check to ensure the appropriate extension was enabled:
     struct loader_instance *ptr_instance = loader_get_instance(instance);
@@ -834,7 +855,8 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateXcbSurfaceKHR(VkInstance instanc
     }
 
     // Next, if so, proceed with the implementation of this function:
-    pIcdSurface = AllocateIcdSurfaceStruct(ptr_instance, sizeof(pIcdSurface->xcb_surf.base), sizeof(pIcdSurface->xcb_surf));
+    pIcdSurface = AllocateIcdSurfaceStruct(ptr_instance, pAllocator, sizeof(pIcdSurface->xcb_surf.base),
+                                           sizeof(pIcdSurface->xcb_surf));
     if (pIcdSurface == NULL) {
         vkRes = VK_ERROR_OUT_OF_HOST_MEMORY;
         goto out;
@@ -844,36 +866,9 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateXcbSurfaceKHR(VkInstance instanc
     pIcdSurface->xcb_surf.connection = pCreateInfo->connection;
     pIcdSurface->xcb_surf.window = pCreateInfo->window;
 
-    // Loop through each ICD and determine if they need to create a surface
-    for (struct loader_icd_term *icd_term = ptr_instance->icd_terms; icd_term != NULL; icd_term = icd_term->next, i++) {
-        if (icd_term->scanned_icd->interface_version >= ICD_VER_SUPPORTS_ICD_SURFACE_KHR) {
-            if (NULL != icd_term->dispatch.CreateXcbSurfaceKHR) {
-                vkRes = icd_term->dispatch.CreateXcbSurfaceKHR(icd_term->instance, pCreateInfo, pAllocator,
-                                                               &pIcdSurface->real_icd_surfaces[i]);
-                if (VK_SUCCESS != vkRes) {
-                    goto out;
-                }
-            }
-        }
-    }
-
     *pSurface = (VkSurfaceKHR)pIcdSurface;
 
 out:
-
-    if (VK_SUCCESS != vkRes && NULL != pIcdSurface) {
-        if (NULL != pIcdSurface->real_icd_surfaces) {
-            i = 0;
-            for (struct loader_icd_term *icd_term = ptr_instance->icd_terms; icd_term != NULL; icd_term = icd_term->next, i++) {
-                if ((VkSurfaceKHR)NULL != pIcdSurface->real_icd_surfaces[i] && NULL != icd_term->dispatch.DestroySurfaceKHR) {
-                    icd_term->dispatch.DestroySurfaceKHR(icd_term->instance, pIcdSurface->real_icd_surfaces[i], pAllocator);
-                }
-            }
-            loader_instance_heap_free(ptr_instance, pIcdSurface->real_icd_surfaces);
-        }
-        loader_instance_heap_free(ptr_instance, pIcdSurface);
-    }
-
     return vkRes;
 }
 
@@ -939,7 +934,6 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateXlibSurfaceKHR(VkInstance instan
                                                                const VkAllocationCallbacks *pAllocator, VkSurfaceKHR *pSurface) {
     VkResult vkRes = VK_SUCCESS;
     VkIcdSurface *pIcdSurface = NULL;
-    uint32_t i = 0;
 
     // First, check to ensure the appropriate extension was enabled:
     struct loader_instance *ptr_instance = loader_get_instance(instance);
@@ -951,7 +945,8 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateXlibSurfaceKHR(VkInstance instan
     }
 
     // Next, if so, proceed with the implementation of this function:
-    pIcdSurface = AllocateIcdSurfaceStruct(ptr_instance, sizeof(pIcdSurface->xlib_surf.base), sizeof(pIcdSurface->xlib_surf));
+    pIcdSurface = AllocateIcdSurfaceStruct(ptr_instance, pAllocator, sizeof(pIcdSurface->xlib_surf.base),
+                                           sizeof(pIcdSurface->xlib_surf));
     if (pIcdSurface == NULL) {
         vkRes = VK_ERROR_OUT_OF_HOST_MEMORY;
         goto out;
@@ -961,36 +956,9 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateXlibSurfaceKHR(VkInstance instan
     pIcdSurface->xlib_surf.dpy = pCreateInfo->dpy;
     pIcdSurface->xlib_surf.window = pCreateInfo->window;
 
-    // Loop through each ICD and determine if they need to create a surface
-    for (struct loader_icd_term *icd_term = ptr_instance->icd_terms; icd_term != NULL; icd_term = icd_term->next, i++) {
-        if (icd_term->scanned_icd->interface_version >= ICD_VER_SUPPORTS_ICD_SURFACE_KHR) {
-            if (NULL != icd_term->dispatch.CreateXlibSurfaceKHR) {
-                vkRes = icd_term->dispatch.CreateXlibSurfaceKHR(icd_term->instance, pCreateInfo, pAllocator,
-                                                                &pIcdSurface->real_icd_surfaces[i]);
-                if (VK_SUCCESS != vkRes) {
-                    goto out;
-                }
-            }
-        }
-    }
-
     *pSurface = (VkSurfaceKHR)pIcdSurface;
 
 out:
-
-    if (VK_SUCCESS != vkRes && NULL != pIcdSurface) {
-        if (NULL != pIcdSurface->real_icd_surfaces) {
-            i = 0;
-            for (struct loader_icd_term *icd_term = ptr_instance->icd_terms; icd_term != NULL; icd_term = icd_term->next, i++) {
-                if ((VkSurfaceKHR)NULL != pIcdSurface->real_icd_surfaces[i] && NULL != icd_term->dispatch.DestroySurfaceKHR) {
-                    icd_term->dispatch.DestroySurfaceKHR(icd_term->instance, pIcdSurface->real_icd_surfaces[i], pAllocator);
-                }
-            }
-            loader_instance_heap_free(ptr_instance, pIcdSurface->real_icd_surfaces);
-        }
-        loader_instance_heap_free(ptr_instance, pIcdSurface);
-    }
-
     return vkRes;
 }
 
@@ -1287,7 +1255,6 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateDisplayPlaneSurfaceKHR(VkInstanc
     struct loader_instance *inst = loader_get_instance(instance);
     VkIcdSurface *pIcdSurface = NULL;
     VkResult vkRes = VK_SUCCESS;
-    uint32_t i = 0;
 
     if (!inst->wsi_display_enabled) {
         loader_log(inst, VK_DEBUG_REPORT_ERROR_BIT_EXT, 0,
@@ -1297,7 +1264,8 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateDisplayPlaneSurfaceKHR(VkInstanc
     }
 
     // Next, if so, proceed with the implementation of this function:
-    pIcdSurface = AllocateIcdSurfaceStruct(inst, sizeof(pIcdSurface->display_surf.base), sizeof(pIcdSurface->display_surf));
+    pIcdSurface = AllocateIcdSurfaceStruct(inst, pAllocator, sizeof(pIcdSurface->display_surf.base),
+                                           sizeof(pIcdSurface->display_surf));
     if (pIcdSurface == NULL) {
         vkRes = VK_ERROR_OUT_OF_HOST_MEMORY;
         goto out;
@@ -1312,36 +1280,9 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateDisplayPlaneSurfaceKHR(VkInstanc
     pIcdSurface->display_surf.alphaMode = pCreateInfo->alphaMode;
     pIcdSurface->display_surf.imageExtent = pCreateInfo->imageExtent;
 
-    // Loop through each ICD and determine if they need to create a surface
-    for (struct loader_icd_term *icd_term = inst->icd_terms; icd_term != NULL; icd_term = icd_term->next, i++) {
-        if (icd_term->scanned_icd->interface_version >= ICD_VER_SUPPORTS_ICD_SURFACE_KHR) {
-            if (NULL != icd_term->dispatch.CreateDisplayPlaneSurfaceKHR) {
-                vkRes = icd_term->dispatch.CreateDisplayPlaneSurfaceKHR(icd_term->instance, pCreateInfo, pAllocator,
-                                                                        &pIcdSurface->real_icd_surfaces[i]);
-                if (VK_SUCCESS != vkRes) {
-                    goto out;
-                }
-            }
-        }
-    }
-
     *pSurface = (VkSurfaceKHR)pIcdSurface;
 
 out:
-
-    if (VK_SUCCESS != vkRes && NULL != pIcdSurface) {
-        if (NULL != pIcdSurface->real_icd_surfaces) {
-            i = 0;
-            for (struct loader_icd_term *icd_term = inst->icd_terms; icd_term != NULL; icd_term = icd_term->next, i++) {
-                if ((VkSurfaceKHR)NULL != pIcdSurface->real_icd_surfaces[i] && NULL != icd_term->dispatch.DestroySurfaceKHR) {
-                    icd_term->dispatch.DestroySurfaceKHR(icd_term->instance, pIcdSurface->real_icd_surfaces[i], pAllocator);
-                }
-            }
-            loader_instance_heap_free(inst, pIcdSurface->real_icd_surfaces);
-        }
-        loader_instance_heap_free(inst, pIcdSurface);
-    }
-
     return vkRes;
 }
 
@@ -1364,24 +1305,19 @@ VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateSharedSwapchainsKHR(VkDevice dev
     struct loader_device *dev;
     struct loader_icd_term *icd_term = loader_get_icd_and_device(device, &dev, &icd_index);
     if (NULL != icd_term && NULL != icd_term->dispatch.CreateSharedSwapchainsKHR) {
-        VkIcdSurface *icd_surface = (VkIcdSurface *)(uintptr_t)pCreateInfos->surface;
-        if (NULL != icd_surface->real_icd_surfaces) {
-            if ((VkSurfaceKHR)NULL != icd_surface->real_icd_surfaces[icd_index]) {
-                // We found the ICD, and there is an ICD KHR surface
-                // associated with it, so copy the CreateInfo struct
-                // and point it at the ICD's surface.
-                VkSwapchainCreateInfoKHR *pCreateCopy = loader_stack_alloc(sizeof(VkSwapchainCreateInfoKHR) * swapchainCount);
-                if (NULL == pCreateCopy) {
-                    return VK_ERROR_OUT_OF_HOST_MEMORY;
-                }
-                memcpy(pCreateCopy, pCreateInfos, sizeof(VkSwapchainCreateInfoKHR) * swapchainCount);
-                for (uint32_t sc = 0; sc < swapchainCount; sc++) {
-                    pCreateCopy[sc].surface = icd_surface->real_icd_surfaces[icd_index];
-                }
-                return icd_term->dispatch.CreateSharedSwapchainsKHR(device, swapchainCount, pCreateCopy, pAllocator, pSwapchains);
+        // Copy the CreateInfo structs and point each at its ICD's surface.
+        VkSwapchainCreateInfoKHR *pCreateCopy = loader_stack_alloc(sizeof(VkSwapchainCreateInfoKHR) * swapchainCount);
+        if (NULL == pCreateCopy) {
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+        }
+        memcpy(pCreateCopy, pCreateInfos, sizeof(VkSwapchainCreateInfoKHR) * swapchainCount);
+        for (uint32_t sc = 0; sc < swapchainCount; sc++) {
+            VkResult res = wsi_unwrap_icd_surface(icd_term, icd_index, pCreateInfos[sc].surface, &pCreateCopy[sc].surface);
+            if (VK_SUCCESS != res) {
+                return res;
             }
         }
-        return icd_term->dispatch.CreateSharedSwapchainsKHR(device, swapchainCount, pCreateInfos, pAllocator, pSwapchains);
+        return icd_term->dispatch.CreateSharedSwapchainsKHR(device, swapchainCount, pCreateCopy, pAllocator, pSwapchains);
     }
     return VK_SUCCESS;
 }
@@ -25,6 +25,14 @@
 #include "vk_loader_platform.h"
 #include "loader.h"
 
+// The surface one ICD made for a VkIcdSurface.  It's created the first time
+// the ICD needs it, and created is published last, so once it's set surface
+// can be read without a lock.
+struct loader_icd_surface {
+    VkSurfaceKHR surface;  // VK_NULL_HANDLE if the ICD takes the VkIcdSurface itself
+    void *created;
+};
+
 typedef struct {
     union {
 #ifdef VK_USE_PLATFORM_MIR_KHR
@@ -48,7 +56,11 @@ typedef struct {
     uint32_t platform_size;        // Size of corresponding VkIcdSurfaceXXX
     uint32_t non_platform_offset;  // Start offset to base_size
     uint32_t entire_size;          // Size of entire VkIcdSurface
-    VkSurfaceKHR *real_icd_surfaces;
+    // One entry per ICD, stored right after this struct in the same allocation
+    struct loader_icd_surface *real_icd_surfaces;
+    // Allocator the surface was created with, used for the ICD surfaces
+    bool has_allocator;
+    VkAllocationCallbacks allocator;
 } VkIcdSurface;
 
 bool wsi_swapchain_instance_gpa(struct loader_instance *ptr_instance, const char *name, void **addr);
@@ -56,6 +68,9 @@ bool wsi_swapchain_instance_gpa(struct loader_instance *ptr_instance, const char
 void wsi_create_instance(struct loader_instance *ptr_instance, const VkInstanceCreateInfo *pCreateInfo);
 bool wsi_unsupported_instance_extension(const VkExtensionProperties *ext_prop);
 
+VkResult wsi_unwrap_icd_surface(struct loader_icd_term *icd_term, uint32_t icd_index, VkSurfaceKHR surface,
+                                VkSurfaceKHR *pIcdSurface);
+
 VKAPI_ATTR VkResult VKAPI_CALL terminator_CreateSwapchainKHR(VkDevice device, const VkSwapchainCreateInfoKHR *pCreateInfo,
                                                              const VkAllocationCallbacks *pAllocator, VkSwapchainKHR *pSwapchain);
 
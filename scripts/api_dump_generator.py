@@ -35,6 +35,7 @@
 #   * api_dump.cpp: COMMON_CODEGEN - Provides all entrypoints for functions and dispatches the calls
 #       to the proper back end
 #   * api_dump_text.h: TEXT_CODEGEN - Provides the back end for dumping to a text file
+#   * api_dump_json.h: JSON_CODEGEN - Provides the back end for dumping to a JSON Lines file, one call per line
 #
 
 import generator as gen
@@ -68,13 +69,30 @@ COMMON_CODEGEN = """
 
 #include "api_dump_text.h"
 #include "api_dump_html.h"
+#include "api_dump_json.h"
+
+//============================== Command Filter =============================//
+
+enum ApiDumpCommand {{
+    @foreach function
+    ApiDumpCommand_{funcName},
+    @end function
+}};
+
+const char *const api_dump_command_names[] = {{
+    @foreach function
+    "{funcName}",
+    @end function
+}};
+const size_t api_dump_command_count = ARRAY_SIZE(api_dump_command_names);
 
 //============================= Dump Functions ==============================//
 
 @foreach function where('{funcReturn}' != 'void' and not '{funcName}' in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr'])
 inline void dump_{funcName}(ApiDumpInstance& dump_inst, {funcReturn} result, {funcTypedParams})
 {{
-    loader_platform_thread_lock_mutex(dump_inst.outputMutex());
+    if(!dump_inst.shouldDump(ApiDumpCommand_{funcName}))
+        return;
     switch(dump_inst.settings().format())
     {{
     case ApiDumpFormat::Text:
@@ -83,15 +101,19 @@ inline void dump_{funcName}(ApiDumpInstance& dump_inst, {funcReturn} result, {fu
     case ApiDumpFormat::Html:
         dump_html_{funcName}(dump_inst, result, {funcNamedParams});
         break;
+    case ApiDumpFormat::Json:
+        dump_json_{funcName}(dump_inst, result, {funcNamedParams});
+        break;
     }}
-    loader_platform_thread_unlock_mutex(dump_inst.outputMutex());
+    dump_inst.writeCall();
 }}
 @end function
 
 @foreach function where('{funcReturn}' == 'void')
 inline void dump_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
 {{
-    loader_platform_thread_lock_mutex(dump_inst.outputMutex());
+    if(!dump_inst.shouldDump(ApiDumpCommand_{funcName}))
+        return;
     switch(dump_inst.settings().format())
     {{
     case ApiDumpFormat::Text:
@@ -100,8 +122,11 @@ inline void dump_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
     case ApiDumpFormat::Html:
         dump_html_{funcName}(dump_inst, {funcNamedParams});
         break;
+    case ApiDumpFormat::Json:
+        dump_json_{funcName}(dump_inst, {funcNamedParams});
+        break;
     }}
-    loader_platform_thread_unlock_mutex(dump_inst.outputMutex());
+    dump_inst.writeCall();
 }}
 @end function
 
@@ -616,6 +641,265 @@ std::ostream& dump_text_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams}
 @end function
 """
 
+JSON_CODEGEN = """
+/* Copyright (c) 2015-2016 Valve Corporation
+ * Copyright (c) 2015-2016 LunarG, Inc.
+ * Copyright (c) 2015-2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Lenny Komow <lenny@lunarg.com>
+ */
+
+/*
+ * This file is generated from the Khronos Vulkan XML API Registry.
+ */
+
+#pragma once
+
+#include "api_dump.h"
+
+@foreach struct
+void dump_json_{sctName}(const {sctName}& object, const ApiDumpSettings& settings{sctConditionVars});
+@end struct
+@foreach union
+void dump_json_{unName}(const {unName}& object, const ApiDumpSettings& settings);
+@end union
+
+//=========================== Type Implementations ==========================//
+
+@foreach type where('{etyName}' != 'void')
+inline void dump_json_{etyName}({etyName} object, const ApiDumpSettings& settings)
+{{
+    json_write_number(settings.jsonBuffer(), object);
+}}
+@end type
+
+//========================= Basetype Implementations ========================//
+
+@foreach basetype
+inline void dump_json_{baseName}({baseName} object, const ApiDumpSettings& settings)
+{{
+    json_write_number(settings.jsonBuffer(), object);
+}}
+@end basetype
+
+//======================= System Type Implementations =======================//
+
+@foreach systype
+inline void dump_json_{sysName}(const {sysType} object, const ApiDumpSettings& settings)
+{{
+    json_write_scalar(settings.jsonBuffer(), object, settings);
+}}
+@end systype
+
+//========================== Handle Implementations =========================//
+
+@foreach handle
+inline void dump_json_{hdlName}(const {hdlName} object, const ApiDumpSettings& settings)
+{{
+    json_write_handle(settings.jsonBuffer(), object, settings);
+}}
+@end handle
+
+//=========================== Enum Implementations ==========================//
+
+@foreach enum
+void dump_json_{enumName}({enumName} object, const ApiDumpSettings& settings)
+{{
+    switch((int64_t) object)
+    {{
+    @foreach option
+    case {optValue}:
+        settings.jsonBuffer() += "\\"{optName}\\",";
+        break;
+    @end option
+    default:
+        json_write_int(settings.jsonBuffer(), (int64_t) object);
+    }}
+}}
+@end enum
+
+//========================= Bitmask Implementations =========================//
+
+@foreach bitmask
+inline void dump_json_{bitName}({bitName} object, const ApiDumpSettings& settings)
+{{
+    json_write_uint(settings.jsonBuffer(), object);
+}}
+@end bitmask
+
+//=========================== Flag Implementations ==========================//
+
+@foreach flag
+inline void dump_json_{flagName}({flagName} object, const ApiDumpSettings& settings)
+{{
+    json_write_uint(settings.jsonBuffer(), object);
+}}
+@end flag
+
+//======================= Func Pointer Implementations ======================//
+
+@foreach funcpointer
+inline void dump_json_{pfnName}({pfnName} object, const ApiDumpSettings& settings)
+{{
+    json_write_address(settings.jsonBuffer(), (uint64_t)(uintptr_t) object, settings);
+}}
+@end funcpointer
+
+//========================== Struct Implementations =========================//
+
+@foreach struct where('{sctName}' != 'VkShaderModuleCreateInfo')
+void dump_json_{sctName}(const {sctName}& object, const ApiDumpSettings& settings{sctConditionVars})
+{{
+    json_write_open(settings.jsonBuffer(), '{{');
+
+    @foreach member
+    @if('{memCondition}' != 'None')
+    if({memCondition})
+    @end if
+
+    @if({memPtrLevel} == 0)
+    dump_json_value<const {memBaseType}>(object.{memName}, settings, "{memName}", dump_json_{memTypeID}{memInheritedConditions});
+    @end if
+    @if({memPtrLevel} == 1 and '{memLength}' == 'None')
+    dump_json_pointer<const {memBaseType}>(object.{memName}, settings, "{memName}", dump_json_{memTypeID}{memInheritedConditions});
+    @end if
+    @if({memPtrLevel} == 1 and '{memLength}' != 'None' and not {memLengthIsMember})
+    dump_json_array<const {memBaseType}>(object.{memName}, {memLength}, settings, "{memName}", dump_json_{memTypeID}{memInheritedConditions});
+    @end if
+    @if({memPtrLevel} == 1 and '{memLength}' != 'None' and {memLengthIsMember})
+    dump_json_array<const {memBaseType}>(object.{memName}, object.{memLength}, settings, "{memName}", dump_json_{memTypeID}{memInheritedConditions});
+    @end if
+    @end member
+    json_write_close(settings.jsonBuffer(), '}}');
+}}
+@end struct
+
+@foreach struct where('{sctName}' == 'VkShaderModuleCreateInfo')
+void dump_json_{sctName}(const {sctName}& object, const ApiDumpSettings& settings{sctConditionVars})
+{{
+    json_write_open(settings.jsonBuffer(), '{{');
+
+    @foreach member
+    @if('{memCondition}' != 'None')
+    if({memCondition})
+    @end if
+
+    @if({memPtrLevel} == 0)
+    dump_json_value<const {memBaseType}>(object.{memName}, settings, "{memName}", dump_json_{memTypeID}{memInheritedConditions});
+    @end if
+    @if({memPtrLevel} == 1 and '{memLength}' == 'None')
+    dump_json_pointer<const {memBaseType}>(object.{memName}, settings, "{memName}", dump_json_{memTypeID}{memInheritedConditions});
+    @end if
+    @if({memPtrLevel} == 1 and '{memLength}' != 'None' and not {memLengthIsMember} and '{memName}' != 'pCode')
+    dump_json_array<const {memBaseType}>(object.{memName}, {memLength}, settings, "{memName}", dump_json_{memTypeID}{memInheritedConditions});
+    @end if
+    @if({memPtrLevel} == 1 and '{memLength}' != 'None' and {memLengthIsMember} and '{memName}' != 'pCode')
+    dump_json_array<const {memBaseType}>(object.{memName}, object.{memLength}, settings, "{memName}", dump_json_{memTypeID}{memInheritedConditions});
+    @end if
+    @if('{memName}' == 'pCode')
+    if(settings.showShader())
+        dump_json_array<const {memBaseType}>(object.{memName}, object.{memLength}, settings, "{memName}", dump_json_{memTypeID}{memInheritedConditions});
+    else
+        dump_json_special("SHADER DATA", settings, "{memName}");
+    @end if
+    @end member
+    json_write_close(settings.jsonBuffer(), '}}');
+}}
+@end struct
+
+//========================== Union Implementations ==========================//
+
+@foreach union
+void dump_json_{unName}(const {unName}& object, const ApiDumpSettings& settings)
+{{
+    json_write_open(settings.jsonBuffer(), '{{');
+
+    @foreach choice
+    @if({chcPtrLevel} == 0)
+    dump_json_value<const {chcBaseType}>(object.{chcName}, settings, "{chcName}", dump_json_{chcTypeID});
+    @end if
+    @if({chcPtrLevel} == 1 and '{chcLength}' == 'None')
+    dump_json_pointer<const {chcBaseType}>(object.{chcName}, settings, "{chcName}", dump_json_{chcTypeID});
+    @end if
+    @if({chcPtrLevel} == 1 and '{chcLength}' != 'None')
+    dump_json_array<const {chcBaseType}>(object.{chcName}, {chcLength}, settings, "{chcName}", dump_json_{chcTypeID});
+    @end if
+    @end choice
+    json_write_close(settings.jsonBuffer(), '}}');
+}}
+@end union
+
+//========================= Function Implementations ========================//
+
+@foreach function where('{funcReturn}' != 'void' and not '{funcName}' in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr'])
+void dump_json_{funcName}(ApiDumpInstance& dump_inst, {funcReturn} result, {funcTypedParams})
+{{
+    const ApiDumpSettings& settings(dump_inst.settings());
+    dump_json_call_begin(dump_inst, "{funcName}");
+    json_write_key(settings.jsonBuffer(), "result");
+    dump_json_{funcReturn}(result, settings);
+
+    if(settings.showParams())
+    {{
+        json_write_key(settings.jsonBuffer(), "params");
+        json_write_open(settings.jsonBuffer(), '{{');
+        @foreach parameter
+        @if({prmPtrLevel} == 0)
+        dump_json_value<const {prmBaseType}>({prmName}, settings, "{prmName}", dump_json_{prmTypeID}{prmInheritedConditions});
+        @end if
+        @if({prmPtrLevel} == 1 and '{prmLength}' == 'None')
+        dump_json_pointer<const {prmBaseType}>({prmName}, settings, "{prmName}", dump_json_{prmTypeID}{prmInheritedConditions});
+        @end if
+        @if({prmPtrLevel} == 1 and '{prmLength}' != 'None')
+        dump_json_array<const {prmBaseType}>({prmName}, {prmLength}, settings, "{prmName}", dump_json_{prmTypeID}{prmInheritedConditions});
+        @end if
+        @end parameter
+        json_write_close(settings.jsonBuffer(), '}}');
+    }}
+    dump_json_call_end(settings);
+}}
+@end function
+
+@foreach function where('{funcReturn}' == 'void')
+void dump_json_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
+{{
+    const ApiDumpSettings& settings(dump_inst.settings());
+    dump_json_call_begin(dump_inst, "{funcName}");
+
+    if(settings.showParams())
+    {{
+        json_write_key(settings.jsonBuffer(), "params");
+        json_write_open(settings.jsonBuffer(), '{{');
+        @foreach parameter
+        @if({prmPtrLevel} == 0)
+        dump_json_value<const {prmBaseType}>({prmName}, settings, "{prmName}", dump_json_{prmTypeID}{prmInheritedConditions});
+        @end if
+        @if({prmPtrLevel} == 1 and '{prmLength}' == 'None')
+        dump_json_pointer<const {prmBaseType}>({prmName}, settings, "{prmName}", dump_json_{prmTypeID}{prmInheritedConditions});
+        @end if
+        @if({prmPtrLevel} == 1 and '{prmLength}' != 'None')
+        dump_json_array<const {prmBaseType}>({prmName}, {prmLength}, settings, "{prmName}", dump_json_{prmTypeID}{prmInheritedConditions});
+        @end if
+        @end parameter
+        json_write_close(settings.jsonBuffer(), '}}');
+    }}
+    dump_json_call_end(settings);
+}}
+@end function
+"""
+
 # This HTML Codegen is essentially copied from the format above.
 # Due to the way some of the functions have been organized, some of the HTML tags
 # that are opened are closed in another function. See api_dump.h. This may need refactoring.
@@ -554,10 +554,71 @@ class HelperFileOutputGenerator(OutputGenerator):
         safe_struct_helper_header = '\n'
         safe_struct_helper_header += '#pragma once\n'
         safe_struct_helper_header += '#include <vulkan/vulkan.h>\n'
+        safe_struct_helper_header += '#include <stddef.h>\n'
+        safe_struct_helper_header += '#include <string.h>\n'
+        safe_struct_helper_header += '#include <new>\n'
         safe_struct_helper_header += '\n'
+        safe_struct_helper_header += self.GenerateSafeStructArenaHeader()
         safe_struct_helper_header += self.GenerateSafeStructHeader()
         return safe_struct_helper_header
     #
+    # safe_struct header: bump allocator used by the arena flavor of initialize()
+    def GenerateSafeStructArenaHeader(self):
+        arena_header = '\n'
+        arena_header += '// Bump allocator for short-lived safe_* copies.  A struct initialized with\n'
+        arena_header += '// initialize(in_struct, arena) takes all of its nested arrays from the arena\n'
+        arena_header += '// instead of the heap, so it must itself live in the arena (see New()) and is\n'
+        arena_header += '// never destroyed; the memory of every copy is released together by Reset().\n'
+        arena_header += 'class SafeStructArena {\n'
+        arena_header += '   public:\n'
+        arena_header += '    explicit SafeStructArena(size_t block_size = 16 * 1024) : block_size_(block_size) {}\n'
+        arena_header += '    ~SafeStructArena();\n'
+        arena_header += '    SafeStructArena(const SafeStructArena &) = delete;\n'
+        arena_header += '    SafeStructArena &operator=(const SafeStructArena &) = delete;\n'
+        arena_header += '\n'
+        arena_header += '    void *Allocate(size_t size, size_t alignment) {\n'
+        arena_header += '        char *ptr = reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(cursor_) + alignment - 1) & ~(alignment - 1));\n'
+        arena_header += '        if (!cursor_ || ptr + size > end_) ptr = static_cast<char *>(AllocateBlock(size, alignment));\n'
+        arena_header += '        cursor_ = ptr + size;\n'
+        arena_header += '        return ptr;\n'
+        arena_header += '    }\n'
+        arena_header += '    // Default-constructs count objects; safe_* structs start out with null pointers\n'
+        arena_header += '    template <typename T>\n'
+        arena_header += '    T *NewArray(size_t count) {\n'
+        arena_header += '        T *array = static_cast<T *>(Allocate(sizeof(T) * count, alignof(T)));\n'
+        arena_header += '        for (size_t i = 0; i < count; ++i) new (&array[i]) T;\n'
+        arena_header += '        return array;\n'
+        arena_header += '    }\n'
+        arena_header += '    template <typename T>\n'
+        arena_header += '    T *Copy(const T *src, size_t count) {\n'
+        arena_header += '        T *dst = static_cast<T *>(Allocate(sizeof(T) * count, alignof(T)));\n'
+        arena_header += '        memcpy(dst, src, sizeof(T) * count);\n'
+        arena_header += '        return dst;\n'
+        arena_header += '    }\n'
+        arena_header += '    // Deep copy of in_struct whose nested arrays all live in this arena\n'
+        arena_header += '    template <typename SafeStruct, typename Struct>\n'
+        arena_header += '    SafeStruct *New(const Struct *in_struct) {\n'
+        arena_header += '        SafeStruct *safe_struct = NewArray<SafeStruct>(1);\n'
+        arena_header += '        safe_struct->initialize(in_struct, this);\n'
+        arena_header += '        return safe_struct;\n'
+        arena_header += '    }\n'
+        arena_header += '    // Releases every allocation, keeping the most recent block for reuse\n'
+        arena_header += '    void Reset();\n'
+        arena_header += '\n'
+        arena_header += '   private:\n'
+        arena_header += '    struct Block {\n'
+        arena_header += '        Block *next;\n'
+        arena_header += '        size_t size;\n'
+        arena_header += '    };\n'
+        arena_header += '    void *AllocateBlock(size_t size, size_t alignment);\n'
+        arena_header += '\n'
+        arena_header += '    size_t block_size_;\n'
+        arena_header += '    Block *blocks_ = nullptr;\n'
+        arena_header += '    char *cursor_ = nullptr;\n'
+        arena_header += '    char *end_ = nullptr;\n'
+        arena_header += '};\n'
+        return arena_header
+    #
     # safe_struct header: build function prototypes for header file
     def GenerateSafeStructHeader(self):
         safe_struct_header = ''
@@ -587,6 +648,7 @@ class HelperFileOutputGenerator(OutputGenerator):
                 safe_struct_header += '    ~safe_%s();\n' % item.name
                 safe_struct_header += '    void initialize(const %s* in_struct);\n' % item.name
                 safe_struct_header += '    void initialize(const safe_%s* src);\n' % item.name
+                safe_struct_header += '    void initialize(const %s* in_struct, SafeStructArena* arena);\n' % item.name
                 safe_struct_header += '    %s *ptr() { return reinterpret_cast<%s *>(this); }\n' % (item.name, item.name)
                 safe_struct_header += '    %s const *ptr() const { return reinterpret_cast<%s const *>(this); }\n' % (item.name, item.name)
                 safe_struct_header += '};\n'
@@ -747,10 +809,48 @@ class HelperFileOutputGenerator(OutputGenerator):
         safe_struct_helper_source = '\n'
         safe_struct_helper_source += '#include "vk_safe_struct.h"\n'
         safe_struct_helper_source += '#include <string.h>\n'
+        safe_struct_helper_source += '#include <stdlib.h>\n'
         safe_struct_helper_source += '\n'
+        safe_struct_helper_source += self.GenerateSafeStructArenaSource()
         safe_struct_helper_source += self.GenerateSafeStructSource()
         return safe_struct_helper_source
     #
+    # safe_struct source -- out-of-line parts of SafeStructArena
+    def GenerateSafeStructArenaSource(self):
+        arena_source = '\n'
+        arena_source += 'SafeStructArena::~SafeStructArena() {\n'
+        arena_source += '    while (blocks_) {\n'
+        arena_source += '        Block *next = blocks_->next;\n'
+        arena_source += '        free(blocks_);\n'
+        arena_source += '        blocks_ = next;\n'
+        arena_source += '    }\n'
+        arena_source += '}\n'
+        arena_source += '\n'
+        arena_source += 'void *SafeStructArena::AllocateBlock(size_t size, size_t alignment) {\n'
+        arena_source += '    size_t block_size = sizeof(Block) + size + alignment;\n'
+        arena_source += '    if (block_size < block_size_) block_size = block_size_;\n'
+        arena_source += '    Block *block = static_cast<Block *>(malloc(block_size));\n'
+        arena_source += '    if (!block) throw std::bad_alloc();\n'
+        arena_source += '    block->next = blocks_;\n'
+        arena_source += '    block->size = block_size;\n'
+        arena_source += '    blocks_ = block;\n'
+        arena_source += '    end_ = reinterpret_cast<char *>(block) + block_size;\n'
+        arena_source += '    uintptr_t start = reinterpret_cast<uintptr_t>(block + 1);\n'
+        arena_source += '    return reinterpret_cast<char *>((start + alignment - 1) & ~(alignment - 1));\n'
+        arena_source += '}\n'
+        arena_source += '\n'
+        arena_source += 'void SafeStructArena::Reset() {\n'
+        arena_source += '    if (!blocks_) return;\n'
+        arena_source += '    while (blocks_->next) {\n'
+        arena_source += '        Block *next = blocks_->next->next;\n'
+        arena_source += '        free(blocks_->next);\n'
+        arena_source += '        blocks_->next = next;\n'
+        arena_source += '    }\n'
+        arena_source += '    cursor_ = reinterpret_cast<char *>(blocks_ + 1);\n'
+        arena_source += '    end_ = reinterpret_cast<char *>(blocks_) + blocks_->size;\n'
+        arena_source += '}\n'
+        return arena_source
+    #
     # safe_struct source -- create bodies of safe struct helper functions
     def GenerateSafeStructSource(self):
         safe_struct_body = []
@@ -773,6 +873,7 @@ class HelperFileOutputGenerator(OutputGenerator):
             default_init_list = ''  # Default constructor just inits ptrs to nullptr in initializer
             init_func_txt = ''      # Txt for initialize() function that takes struct ptr and inits members
             construct_txt = ''      # Body of constuctor as well as body of initialize() func following init_func_txt
+            arena_construct_txt = ''  # Same as construct_txt, but nested arrays come from a SafeStructArena
             destruct_txt = ''
             # VkWriteDescriptorSet is special case because pointers may be non-null but ignored
             custom_construct_txt = {'VkWriteDescriptorSet' :
@@ -817,6 +918,10 @@ class HelperFileOutputGenerator(OutputGenerator):
                                     '        pCode = reinterpret_cast<uint32_t *>(new uint8_t[codeSize]);\n'
                                     '        memcpy((void *)pCode, (void *)in_struct->pCode, codeSize);\n'
                                     '    }\n'}
+            custom_arena_construct_txt = {'VkShaderModuleCreateInfo' :
+                                          '    if (in_struct->pCode) {\n'
+                                          '        pCode = arena->Copy(in_struct->pCode, (codeSize + 3) / 4);\n'
+                                          '    }\n'}
             custom_destruct_txt = {'VkShaderModuleCreateInfo' :
                                    '    if (pCode)\n'
                                    '        delete[] reinterpret_cast<const uint8_t *>(pCode);\n' }
@@ -842,6 +947,9 @@ class HelperFileOutputGenerator(OutputGenerator):
                                 construct_txt += '    if (in_struct->%s) {\n' % member.name
                                 construct_txt += '        %s = new %s(*in_struct->%s);\n' % (member.name, m_type, member.name)
                                 construct_txt += '    }\n'
+                                arena_construct_txt += '    if (in_struct->%s) {\n' % member.name
+                                arena_construct_txt += '        %s = arena->Copy(in_struct->%s, 1);\n' % (member.name, member.name)
+                                arena_construct_txt += '    }\n'
                                 destruct_txt += '    if (%s)\n' % member.name
                                 destruct_txt += '        delete %s;\n' % member.name
                             else:
@@ -849,6 +957,9 @@ class HelperFileOutputGenerator(OutputGenerator):
                                 construct_txt += '        %s = new %s[in_struct->%s];\n' % (member.name, m_type, member.len)
                                 construct_txt += '        memcpy ((void *)%s, (void *)in_struct->%s, sizeof(%s)*in_struct->%s);\n' % (member.name, member.name, m_type, member.len)
                                 construct_txt += '    }\n'
+                                arena_construct_txt += '    if (in_struct->%s) {\n' % member.name
+                                arena_construct_txt += '        %s = arena->Copy(in_struct->%s, in_struct->%s);\n' % (member.name, member.name, member.len)
+                                arena_construct_txt += '    }\n'
                                 destruct_txt += '    if (%s)\n' % member.name
                                 destruct_txt += '        delete[] %s;\n' % member.name
                 elif member.isstaticarray or member.len is not None:
@@ -858,6 +969,9 @@ class HelperFileOutputGenerator(OutputGenerator):
                         construct_txt += '    for (uint32_t i=0; i<%s; ++i) {\n' % static_array_size.group(1)
                         construct_txt += '        %s[i] = in_struct->%s[i];\n' % (member.name, member.name)
                         construct_txt += '    }\n'
+                        arena_construct_txt += '    for (uint32_t i=0; i<%s; ++i) {\n' % static_array_size.group(1)
+                        arena_construct_txt += '        %s[i] = in_struct->%s[i];\n' % (member.name, member.name)
+                        arena_construct_txt += '    }\n'
                     else:
                         # Init array ptr to NULL
                         default_init_list += '\n    %s(nullptr),' % member.name
@@ -879,11 +993,24 @@ class HelperFileOutputGenerator(OutputGenerator):
                             construct_txt += '            %s[i] = %s;\n' % (member.name, array_element)
                         construct_txt += '        }\n'
                         construct_txt += '    }\n'
+                        arena_construct_txt += '    if (%s && in_struct->%s) {\n' % (member.len, member.name)
+                        if 'safe_' in m_type:
+                            arena_construct_txt += '        %s = arena->NewArray<%s>(%s);\n' % (member.name, m_type, member.len)
+                            arena_construct_txt += '        for (uint32_t i=0; i<%s; ++i) {\n' % (member.len)
+                            arena_construct_txt += '            %s[i].initialize(&in_struct->%s[i], arena);\n' % (member.name, member.name)
+                            arena_construct_txt += '        }\n'
+                        else:
+                            arena_construct_txt += '        %s = arena->Copy(in_struct->%s, %s);\n' % (member.name, member.name, member.len)
+                        arena_construct_txt += '    }\n'
                 elif member.ispointer == True:
                     construct_txt += '    if (in_struct->%s)\n' % member.name
                     construct_txt += '        %s = new %s(in_struct->%s);\n' % (member.name, m_type, member.name)
                     construct_txt += '    else\n'
                     construct_txt += '        %s = NULL;\n' % member.name
+                    arena_construct_txt += '    if (in_struct->%s)\n' % member.name
+                    arena_construct_txt += '        %s = arena->New<%s>(in_struct->%s);\n' % (member.name, m_type, member.name)
+                    arena_construct_txt += '    else\n'
+                    arena_construct_txt += '        %s = NULL;\n' % member.name
                     destruct_txt += '    if (%s)\n' % member.name
                     destruct_txt += '        delete %s;\n' % member.name
                 elif 'safe_' in m_type:
@@ -896,6 +1023,10 @@ class HelperFileOutputGenerator(OutputGenerator):
                 init_list = init_list[:-1] # hack off final comma
             if item.name in custom_construct_txt:
                 construct_txt = custom_construct_txt[item.name]
+                if item.name in custom_arena_construct_txt:
+                    arena_construct_txt = custom_arena_construct_txt[item.name]
+                else:
+                    arena_construct_txt = re.sub(r'new (\w+)\[(\w+)\]', r'arena->NewArray<\1>(\2)', construct_txt)
             if item.name in custom_destruct_txt:
                 destruct_txt = custom_destruct_txt[item.name]
             safe_struct_body.append("\n%s::%s(const %s* in_struct) :%s\n{\n%s}" % (ss_name, ss_name, item.name, init_list, construct_txt))
@@ -916,6 +1047,9 @@ class HelperFileOutputGenerator(OutputGenerator):
             init_copy = copy_construct_init.replace('src.', 'src->')
             init_construct = copy_construct_txt.replace('src.', 'src->')
             safe_struct_body.append("\nvoid %s::initialize(const %s* src)\n{\n%s%s}" % (ss_name, ss_name, init_copy, init_construct))
+            # Arena initializer: embedded safe structs are initialized from the same arena
+            arena_init = re.sub(r'\.initialize\((&in_struct->\w+)\);', r'.initialize(\1, arena);', init_func_txt)
+            safe_struct_body.append("\nvoid %s::initialize(const %s* in_struct, SafeStructArena* arena)\n{\n%s%s}" % (ss_name, item.name, arena_init, arena_construct_txt))
             if item.ifdef_protect != None:
                 safe_struct_body.append("#endif // %s\n" % item.ifdef_protect)
         return "\n".join(safe_struct_body)
@@ -893,14 +893,14 @@ class LoaderExtensionOutputGenerator(OutputGenerator):
                     requires_terminator = 1
                     always_use_param_name = False
                     surface_type_to_replace = 'VkSurfaceKHR'
-                    surface_name_replacement = 'icd_surface->real_icd_surfaces[icd_index]'
+                    surface_name_replacement = 'unwrapped_surface'
                 if param.type == 'VkPhysicalDeviceSurfaceInfo2KHR':
                     has_surface = 1
                     surface_var_name = param.name + '->surface'
                     requires_terminator = 1
                     update_structure_surface = 1
                     update_structure_string = '        VkPhysicalDeviceSurfaceInfo2KHR info_copy = *pSurfaceInfo;\n'
-                    update_structure_string += '        info_copy.surface = icd_surface->real_icd_surfaces[icd_index];\n'
+                    update_structure_string += '        info_copy.surface = unwrapped_surface;\n'
                     always_use_param_name = False
                     surface_type_to_replace = 'VkPhysicalDeviceSurfaceInfo2KHR'
                     surface_name_replacement = '&info_copy'
@@ -988,9 +988,12 @@ class LoaderExtensionOutputGenerator(OutputGenerator):
                     funcs += '    }\n'
 
                     if has_surface == 1:
-                        funcs += '    VkIcdSurface *icd_surface = (VkIcdSurface *)(%s);\n' % (surface_var_name)
-                        funcs += '    uint8_t icd_index = phys_dev_term->icd_index;\n'
-                        funcs += '    if (NULL != icd_surface->real_icd_surfaces && NULL != (void *)icd_surface->real_icd_surfaces[icd_index]) {\n'
+                        funcs += '    VkSurfaceKHR unwrapped_surface;\n'
+                        funcs += '    VkResult surface_res = wsi_unwrap_icd_surface(icd_term, phys_dev_term->icd_index, %s, &unwrapped_surface);\n' % (surface_var_name)
+                        funcs += '    if (VK_SUCCESS != surface_res) {\n'
+                        funcs += '        return%s;\n' % (' surface_res' if has_return_type else '')
+                        funcs += '    }\n'
+                        funcs += '    if (unwrapped_surface != %s) {\n' % (surface_var_name)
 
                         # If there's a structure with a surface, we need to update its internals with the correct surface for the ICD
                         if update_structure_surface == 1:
@@ -1042,8 +1045,12 @@ class LoaderExtensionOutputGenerator(OutputGenerator):
                     funcs += '    struct loader_device *dev;\n'
                     funcs += '    struct loader_icd_term *icd_term = loader_get_icd_and_device(device, &dev, &icd_index);\n'
                     funcs += '    if (NULL != icd_term && NULL != icd_term->dispatch.%s) {\n' % base_name
-                    funcs += '        VkIcdSurface *icd_surface = (VkIcdSurface *)(uintptr_t)%s;\n' % (surface_var_name)
-                    funcs += '        if (NULL != icd_surface->real_icd_surfaces && (VkSurfaceKHR)NULL != icd_surface->real_icd_surfaces[icd_index]) {\n'
+                    funcs += '        VkSurfaceKHR unwrapped_surface;\n'
+                    funcs += '        VkResult surface_res = wsi_unwrap_icd_surface(icd_term, icd_index, %s, &unwrapped_surface);\n' % (surface_var_name)
+                    funcs += '        if (VK_SUCCESS != surface_res) {\n'
+                    funcs += '            return%s;\n' % (' surface_res' if has_return_type else '')
+                    funcs += '        }\n'
+                    funcs += '        if (unwrapped_surface != %s) {\n' % (surface_var_name)
                     funcs += '        %sicd_term->dispatch.%s(' % (return_prefix, base_name)
                     count = 0
                     for param in ext_cmd.params:
@@ -1051,7 +1058,7 @@ class LoaderExtensionOutputGenerator(OutputGenerator):
                             funcs += ', '
 
                         if param.type == 'VkSurfaceKHR':
-                            funcs += 'icd_surface->real_icd_surfaces[icd_index]'
+                            funcs += 'unwrapped_surface'
                         else:
                             funcs += param.name
 
@@ -1091,9 +1098,10 @@ class LoaderExtensionOutputGenerator(OutputGenerator):
                         funcs += '        // If this is a KHR_surface, and the ICD has created its own, we have to replace it with the proper one for the next call.\n'
                         funcs += '        } else if (pNameInfo->objectType == VK_DEBUG_REPORT_OBJECT_TYPE_SURFACE_KHR_EXT) {\n'
                         funcs += '            if (NULL != icd_term && NULL != icd_term->dispatch.CreateSwapchainKHR) {\n'
-                        funcs += '                VkIcdSurface *icd_surface = (VkIcdSurface *)(uintptr_t)pNameInfo->object;\n'
-                        funcs += '                if (NULL != icd_surface->real_icd_surfaces) {\n'
-                        funcs += '                    local_name_info.object = (uint64_t)icd_surface->real_icd_surfaces[icd_index];\n'
+                        funcs += '                VkSurfaceKHR unwrapped_surface;\n'
+                        funcs += '                if (VK_SUCCESS == wsi_unwrap_icd_surface(icd_term, icd_index, (VkSurfaceKHR)(uintptr_t)pNameInfo->object,\n'
+                        funcs += '                                                         &unwrapped_surface)) {\n'
+                        funcs += '                    local_name_info.object = (uint64_t)unwrapped_surface;\n'
                         funcs += '                }\n'
                     elif 'DebugMarkerSetObjectTag' in ext_cmd.name:
                         funcs += '        VkDebugMarkerObjectTagInfoEXT local_tag_info;\n'
@@ -1105,9 +1113,10 @@ class LoaderExtensionOutputGenerator(OutputGenerator):
                         funcs += '        // If this is a KHR_surface, and the ICD has created its own, we have to replace it with the proper one for the next call.\n'
                         funcs += '        } else if (pTagInfo->objectType == VK_DEBUG_REPORT_OBJECT_TYPE_SURFACE_KHR_EXT) {\n'
                         funcs += '            if (NULL != icd_term && NULL != icd_term->dispatch.CreateSwapchainKHR) {\n'
-                        funcs += '                VkIcdSurface *icd_surface = (VkIcdSurface *)(uintptr_t)pTagInfo->object;\n'
-                        funcs += '                if (NULL != icd_surface->real_icd_surfaces) {\n'
-                        funcs += '                    local_tag_info.object = (uint64_t)icd_surface->real_icd_surfaces[icd_index];\n'
+                        funcs += '                VkSurfaceKHR unwrapped_surface;\n'
+                        funcs += '                if (VK_SUCCESS == wsi_unwrap_icd_surface(icd_term, icd_index, (VkSurfaceKHR)(uintptr_t)pTagInfo->object,\n'
+                        funcs += '                                                         &unwrapped_surface)) {\n'
+                        funcs += '                    local_tag_info.object = (uint64_t)unwrapped_surface;\n'
                         funcs += '                }\n'
                     funcs += '            }\n'
                     funcs += '        }\n'
@@ -0,0 +1,315 @@
+#!/usr/bin/python3 -i
+#
+# Copyright (c) 2015-2017 The Khronos Group Inc.
+# Copyright (c) 2015-2017 Valve Corporation
+# Copyright (c) 2015-2017 LunarG, Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+import os,re,sys
+import xml.etree.ElementTree as etree
+from generator import *
+from collections import namedtuple
+
+# Entrypoints written by hand in icd/mock_icd.cpp.  Everything else gets a generated body.
+MANUAL_FUNCTIONS = [
+    'vkCreateInstance',
+    'vkDestroyInstance',
+    'vkEnumeratePhysicalDevices',
+    'vkGetInstanceProcAddr',
+    'vkGetDeviceProcAddr',
+    'vkEnumerateInstanceExtensionProperties',
+    'vkEnumerateInstanceLayerProperties',
+    'vkEnumerateDeviceExtensionProperties',
+    'vkEnumerateDeviceLayerProperties',
+    'vkGetPhysicalDeviceFeatures',
+    'vkGetPhysicalDeviceFeatures2KHR',
+    'vkGetPhysicalDeviceProperties',
+    'vkGetPhysicalDeviceProperties2KHR',
+    'vkGetPhysicalDeviceQueueFamilyProperties',
+    'vkGetPhysicalDeviceQueueFamilyProperties2KHR',
+    'vkGetPhysicalDeviceMemoryProperties',
+    'vkGetPhysicalDeviceMemoryProperties2KHR',
+    'vkGetPhysicalDeviceFormatProperties',
+    'vkGetPhysicalDeviceFormatProperties2KHR',
+    'vkGetPhysicalDeviceImageFormatProperties',
+    'vkGetPhysicalDeviceImageFormatProperties2KHR',
+    'vkCreateDevice',
+    'vkDestroyDevice',
+    'vkGetDeviceQueue',
+    'vkAllocateCommandBuffers',
+    'vkFreeCommandBuffers',
+    'vkDestroyCommandPool',
+    'vkAllocateMemory',
+    'vkFreeMemory',
+    'vkMapMemory',
+    'vkUnmapMemory',
+    'vkCreateBuffer',
+    'vkDestroyBuffer',
+    'vkCreateImage',
+    'vkDestroyImage',
+    'vkGetBufferMemoryRequirements',
+    'vkGetBufferMemoryRequirements2KHR',
+    'vkGetImageMemoryRequirements',
+    'vkGetImageMemoryRequirements2KHR',
+    'vkGetRenderAreaGranularity',
+    'vkGetEventStatus',
+    'vkGetPhysicalDeviceSurfaceSupportKHR',
+    'vkGetPhysicalDeviceSurfaceCapabilitiesKHR',
+    'vkGetPhysicalDeviceSurfaceFormatsKHR',
+    'vkGetPhysicalDeviceSurfacePresentModesKHR',
+    'vkCreateSwapchainKHR',
+    'vkDestroySwapchainKHR',
+    'vkGetSwapchainImagesKHR',
+    'vkAcquireNextImageKHR',
+    ]
+
+# Scalar outputs that get a fixed value when a command has no hand-written body
+SCALAR_OUTPUT_VALUES = {
+    'uint32_t'     : '0',
+    'uint64_t'     : '0',
+    'size_t'       : '0',
+    'VkDeviceSize' : '0',
+    'VkBool32'     : 'VK_FALSE',
+    'int'          : '-1',
+    'HANDLE'       : 'NULL',
+    }
+
+#
+# MockICDGeneratorOptions - subclass of GeneratorOptions.
+class MockICDGeneratorOptions(GeneratorOptions):
+    def __init__(self,
+                 filename = None,
+                 directory = '.',
+                 apiname = None,
+                 profile = None,
+                 versions = '.*',
+                 emitversions = '.*',
+                 defaultExtensions = None,
+                 addExtensions = None,
+                 removeExtensions = None,
+                 sortProcedure = regSortFeatures,
+                 prefixText = "",
+                 genFuncPointers = True,
+                 protectFile = True,
+                 protectFeature = True,
+                 protectProto = None,
+                 protectProtoStr = None,
+                 apicall = '',
+                 apientry = '',
+                 apientryp = '',
+                 alignFuncParam = 0):
+        GeneratorOptions.__init__(self, filename, directory, apiname, profile,
+                                  versions, emitversions, defaultExtensions,
+                                  addExtensions, removeExtensions, sortProcedure)
+        self.prefixText      = prefixText
+        self.genFuncPointers = genFuncPointers
+        self.protectFile     = protectFile
+        self.protectFeature  = protectFeature
+        self.protectProto    = protectProto
+        self.protectProtoStr = protectProtoStr
+        self.apicall         = apicall
+        self.apientry        = apientry
+        self.apientryp       = apientryp
+        self.alignFuncParam  = alignFuncParam
+#
+# MockICDOutputGenerator - subclass of OutputGenerator.
+# Generates the entrypoints of the mock ICD that don't need hand-written behavior
+class MockICDOutputGenerator(OutputGenerator):
+    """Generate mock ICD entrypoints based on XML element attributes"""
+    def __init__(self,
+                 errFile = sys.stderr,
+                 warnFile = sys.stderr,
+                 diagFile = sys.stdout):
+        OutputGenerator.__init__(self, errFile, warnFile, diagFile)
+        self.instance_extensions = []         # (name macro, spec version macro, protect) per instance extension
+        self.device_extensions = []           # (name macro, spec version macro, protect) per device extension
+        self.manual_decls = []                # Forward declarations of hand-written entrypoints
+        self.function_bodies = []             # Generated entrypoints
+        self.function_names = []              # (name, protect) of every entrypoint
+    #
+    # Called once at the beginning of each run
+    def beginFile(self, genOpts):
+        OutputGenerator.beginFile(self, genOpts)
+        # Protect against multiple inclusions
+        self.protect_header = False
+        if (genOpts.protectFile and genOpts.filename):
+            self.protect_header = True
+            headerSym = '__' + re.sub('\.h', '_h_', os.path.basename(genOpts.filename))
+            write('#ifndef', headerSym, file=self.outFile)
+            write('#define', headerSym, '1', file=self.outFile)
+            self.newline()
+        # File Comment
+        file_comment = '// *** THIS FILE IS GENERATED - DO NOT EDIT ***\n'
+        file_comment += '// See mock_icd_generator.py for modifications\n'
+        write(file_comment, file=self.outFile)
+        # Copyright Notice
+        copyright =  '/*\n'
+        copyright += ' * Copyright (c) 2015-2017 The Khronos Group Inc.\n'
+        copyright += ' * Copyright (c) 2015-2017 Valve Corporation\n'
+        copyright += ' * Copyright (c) 2015-2017 LunarG, Inc.\n'
+        copyright += ' *\n'
+        copyright += ' * Licensed under the Apache License, Version 2.0 (the "License");\n'
+        copyright += ' * you may not use this file except in compliance with the License.\n'
+        copyright += ' * You may obtain a copy of the License at\n'
+        copyright += ' *\n'
+        copyright += ' *     http://www.apache.org/licenses/LICENSE-2.0\n'
+        copyright += ' *\n'
+        copyright += ' * Unless required by applicable law or agreed to in writing, software\n'
+        copyright += ' * distributed under the License is distributed on an "AS IS" BASIS,\n'
+        copyright += ' * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.\n'
+        copyright += ' * See the License for the specific language governing permissions and\n'
+        copyright += ' * limitations under the License.\n'
+        copyright += ' */\n'
+        write(copyright, file=self.outFile)
+        # The including file provides CreateDispatchableHandle() and NewHandle()
+        preamble = ''
+        preamble += '#include <string.h>\n'
+        preamble += '#include <string>\n'
+        preamble += '#include <unordered_map>\n'
+        preamble += '#include <vulkan/vulkan.h>\n'
+        preamble += '#include <vulkan/vk_icd.h>\n'
+        write(preamble, file=self.outFile)
+        write('namespace mock_icd {\n', file=self.outFile)
+    #
+    # Write the extension lists, entrypoints and name map
+    def endFile(self):
+        write(self.OutputExtensionList('instance', self.instance_extensions), file=self.outFile)
+        write(self.OutputExtensionList('device', self.device_extensions), file=self.outFile)
+        write('// Entrypoints implemented in mock_icd.cpp', file=self.outFile)
+        write('\n'.join(self.manual_decls), file=self.outFile)
+        write('\n'.join(self.function_bodies), file=self.outFile)
+        write(self.OutputNameMap(), file=self.outFile)
+        write('}  // namespace mock_icd', file=self.outFile)
+        if self.protect_header:
+            self.newline()
+            write('#endif', file=self.outFile)
+        # Finish processing in superclass
+        OutputGenerator.endFile(self)
+    #
+    # Record the name and spec version of each extension
+    def beginFeature(self, interface, emit):
+        OutputGenerator.beginFeature(self, interface, emit)
+        if self.featureName.startswith('VK_VERSION_'):
+            return
+        name_macro = None
+        version_macro = None
+        for enum in interface.findall('require/enum'):
+            enum_name = enum.get('name')
+            if enum_name.endswith('_EXTENSION_NAME'):
+                name_macro = enum_name
+            elif enum_name.endswith('_SPEC_VERSION'):
+                version_macro = enum_name
+        if name_macro is None or version_macro is None:
+            return
+        if interface.get('type') == 'instance':
+            self.instance_extensions.append((name_macro, version_macro, self.featureExtraProtect))
+        else:
+            self.device_extensions.append((name_macro, version_macro, self.featureExtraProtect))
+    #
+    # Drop the 'vk' prefix so the entrypoints don't collide with the loader's exports
+    def makeProtoName(self, name, tail):
+        return self.genOpts.apientry + name[2:] + tail
+    #
+    # Generate a body for every command that isn't written by hand
+    def genCmd(self, cmdinfo, name):
+        OutputGenerator.genCmd(self, cmdinfo, name)
+        self.function_names.append((name, self.featureExtraProtect))
+        decl = self.makeCDecls(cmdinfo.elem)[0]
+        if name in MANUAL_FUNCTIONS:
+            self.manual_decls.append(self.Protect('static ' + decl, self.featureExtraProtect))
+            return
+        body = 'static ' + decl[:-1] + ' {\n'
+        body += self.GenerateBody(cmdinfo.elem)
+        body += '}\n'
+        self.function_bodies.append(self.Protect(body, self.featureExtraProtect))
+    #
+    # Retrieve the type, name, pointer-ness, const-ness and len attribute of a parameter
+    def getParamInfo(self, param):
+        type = noneStr(param.find('type').text)
+        name = noneStr(param.find('name').text)
+        ispointer = '*' in noneStr(param.find('type').tail)
+        isconst = 'const' in noneStr(param.text)
+        return (type, name, ispointer, isconst, param.get('len'))
+    #
+    # Returns true if the type is a handle, and whether it is dispatchable
+    def handleInfo(self, type):
+        handle = self.registry.tree.find("types/type/[name='" + type + "'][@category='handle']")
+        if handle is None:
+            return (False, False)
+        return (True, handle.find('type').text == 'VK_DEFINE_HANDLE')
+    #
+    # Returns true if the type is a structure without an sType member
+    def isPlainStruct(self, type):
+        struct = self.registry.tree.find("types/type/[@name='" + type + "'][@category='struct']")
+        if struct is None:
+            return False
+        return all(member.find('name').text != 'sType' for member in struct.findall('member'))
+    #
+    # Fill in output handles, counts and plain outputs, then return success
+    def GenerateBody(self, cmd):
+        body = ''
+        params = [self.getParamInfo(param) for param in cmd.findall('param')]
+        outputs = [p for p in params if p[2] and not p[3]]
+        for (type, name, ispointer, isconst, length) in outputs:
+            if length is not None:
+                length = length.split(',')[0].replace('::', '->')
+            (is_handle, is_dispatchable) = self.handleInfo(type)
+            if is_handle:
+                if is_dispatchable:
+                    create = '(%s)CreateDispatchableHandle()' % type
+                else:
+                    create = '(%s)NewHandle()' % type
+                if length is None:
+                    body += '    *%s = %s;\n' % (name, create)
+                elif length in [p[1] for p in outputs]:
+                    # Enumerated handles, the count is set to zero below
+                    continue
+                else:
+                    body += '    for (uint32_t i = 0; i < %s; ++i) {\n' % length
+                    body += '        %s[i] = %s;\n' % (name, create)
+                    body += '    }\n'
+            elif length is not None:
+                continue
+            elif type in SCALAR_OUTPUT_VALUES:
+                body += '    *%s = %s;\n' % (name, SCALAR_OUTPUT_VALUES[type])
+            elif self.isPlainStruct(type):
+                body += '    memset(%s, 0, sizeof(*%s));\n' % (name, name)
+        result = noneStr(cmd.find('proto/type').text)
+        if result == 'VkResult':
+            body += '    return VK_SUCCESS;\n'
+        elif result == 'VkBool32':
+            body += '    return VK_TRUE;\n'
+        return body
+    #
+    # Wrap some code in the platform #ifdef of its extension
+    def Protect(self, text, protect):
+        if protect is None:
+            return text
+        return '#ifdef %s\n%s\n#endif  // %s' % (protect, text.rstrip('\n'), protect)
+    #
+    # Create one of the extension property arrays
+    def OutputExtensionList(self, list_type, extensions):
+        output = 'static const VkExtensionProperties %s_extensions[] = {\n' % list_type
+        for (name_macro, version_macro, protect) in extensions:
+            output += self.Protect('    {%s, %s},' % (name_macro, version_macro), protect) + '\n'
+        output += '};\n'
+        return output
+    #
+    # Create the map from entrypoint names to entrypoints
+    def OutputNameMap(self):
+        output = 'static const std::unordered_map<std::string, void *> name_to_funcptr_map = {\n'
+        for (name, protect) in self.function_names:
+            output += self.Protect('    {"%s", (void *)%s},' % (name, name[2:]), protect) + '\n'
+        output += '};\n'
+        return output
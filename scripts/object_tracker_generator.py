@@ -167,6 +167,10 @@ class ObjectTrackerOutputGenerator(OutputGenerator):
             'vkGetDeviceQueue',
             'vkGetSwapchainImagesKHR',
             ]
+        # Commands that are autogenerated, with a call into the layer added after the down-chain call
+        self.post_call_hooks = {
+            'vkQueuePresentKHR' : '    EndObjectTrackerFrame(queue);',
+            }
         # These VUIDS are not implicit, but are best handled in this layer. Codegen for vkDestroy calls will generate a key
         # which is translated here into a good VU.  Saves ~40 checks.
         self.manual_vuids = dict()
@@ -566,10 +570,6 @@ class ObjectTrackerOutputGenerator(OutputGenerator):
                                                  feature_protect=self.featureExtraProtect))
         self.structMembers.append(self.StructMemberData(name=typeName, members=membersInfo))
     #
-    # Insert a lock_guard line
-    def lock_guard(self, indent):
-        return '%sstd::lock_guard<std::mutex> lock(global_lock);\n' % indent
-    #
     # Determine if a struct has an object as a member or an embedded member
     def struct_contains_object(self, struct_item):
         struct_member_dict = dict(self.structMembers)
@@ -807,16 +807,13 @@ class ObjectTrackerOutputGenerator(OutputGenerator):
             param_post_code = ''
             create_func = True if create_obj_code else False
             destroy_func = True if destroy_object_code else False
-            (paramdecl, param_pre_code, param_post_code) = self.validate_objects(cmd_info, indent, '', 0, create_func, destroy_func, destroy_array, disp_name, proto.text, True)
+            (paramdecl, param_pre_code, param_post_code) = self.validate_objects(cmd_info, '', '', 0, create_func, destroy_func, destroy_array, disp_name, proto.text, True)
             param_post_code += create_obj_code
             if destroy_object_code:
                 if destroy_array == True:
                     param_post_code += destroy_object_code
                 else:
                     param_pre_code += destroy_object_code
-            if param_pre_code:
-                if (not destroy_func) or (destroy_array):
-                    param_pre_code = '%s{\n%s%s%s%s}\n' % ('    ', indent, self.lock_guard(indent), param_pre_code, indent)
         return paramdecl, param_pre_code, param_post_code
     #
     # Capture command parameter info needed to create, destroy, and validate objects
@@ -940,6 +937,8 @@ class ObjectTrackerOutputGenerator(OutputGenerator):
             self.appendSection('command', '    ' + assignresult + API + '(' + paramstext + ');')
             # And add the post-API-call codegen
             self.appendSection('command', "\n".join(str(api_post).rstrip().split("\n")))
+            if cmdname in self.post_call_hooks:
+                self.appendSection('command', self.post_call_hooks[cmdname])
             # Handle the return result variable, if any
             if (resulttype != None):
                 self.appendSection('command', '    return result;')
@@ -526,12 +526,18 @@ class ParameterValidationOutputGenerator(OutputGenerator):
             isEnum = ('FLAG_BITS' not in expandPrefix)
             if isEnum:
                 self.enumRanges[groupName] = (expandPrefix + '_BEGIN_RANGE' + expandSuffix, expandPrefix + '_END_RANGE' + expandSuffix)
-                # Create definition for a list containing valid enum values for this enumerated type
-                enum_entry = 'const std::vector<%s> All%sEnums = {' % (groupName, groupName)
+                # Create definition for a list containing valid enum values for this enumerated type, sorted by value so it can
+                # be binary searched. Aliases have the value of the enum they alias and are left out.
+                enum_values = []
                 for enum in groupElem:
                     name = enum.get('name')
                     if name is not None and enum.get('supported') != 'disabled':
-                        enum_entry += '%s, ' % name
+                        (numVal, strVal) = self.enumToValue(enum, True)
+                        if numVal is not None:
+                            enum_values.append((numVal, name))
+                enum_entry = 'const std::vector<%s> All%sEnums = {' % (groupName, groupName)
+                for (numVal, name) in sorted(enum_values):
+                    enum_entry += '%s, ' % name
                 enum_entry += '};\n'
                 self.enumValueLists += enum_entry
     #
@@ -1157,6 +1163,8 @@ class ParameterValidationOutputGenerator(OutputGenerator):
             # Skip first parameter if it is a dispatch handle (everything except vkCreateInstance)
             startIndex = 0 if command.name == 'vkCreateInstance' else 1
             lines, unused = self.genFuncBody(command.name, command.params[startIndex:], '', '', None)
+            # Commands like vkCmdDraw that have nothing to check from the xml only take the lock for their manual checks
+            no_xml_checks = (lines == ['// No xml-driven validation\n'])
             # Cannot validate extension dependencies for device extension APIs having a physical device as their dispatchable object
             if (command.name in self.required_extensions) and (self.extension_type != 'device' or command.params[0].type != 'VkPhysicalDevice'):
                 ext_test = ''
@@ -1171,6 +1179,7 @@ class ParameterValidationOutputGenerator(OutputGenerator):
                             break
                     ext_test = 'if (!local_data->extensions.%s) skip |= OutputExtensionError(local_data, "%s", %s);\n' % (ext_enable_name, command.name, ext_name_define)
                     lines.insert(0, ext_test)
+                    no_xml_checks = False
             if lines:
                 cmdDef = self.getCmdDef(command) + '\n'
                 # For a validation-only routine, change the function declaration
@@ -1199,7 +1208,8 @@ class ParameterValidationOutputGenerator(OutputGenerator):
                 if not just_validate:
                     if command.result != '':
                         cmdDef += indent + '%s result = VK_ERROR_VALIDATION_FAILED_EXT;\n' % command.result
-                    cmdDef += '%sstd::unique_lock<std::mutex> lock(global_lock);\n' % indent
+                    if not no_xml_checks:
+                        cmdDef += '%sstd::unique_lock<std::mutex> lock(global_lock);\n' % indent
                 for line in lines:
                     cmdDef += '\n'
                     if type(line) is list:
@@ -1214,13 +1224,17 @@ class ParameterValidationOutputGenerator(OutputGenerator):
                     for param in command.params:
                         params_text += '%s, ' % param.name
                     params_text = params_text[:-2]
-                    # Generate call to manual function if its function pointer is non-null
-                    cmdDef += '%sPFN_manual_%s custom_func = (PFN_manual_%s)custom_functions["%s"];\n' % (indent, command.name, command.name, command.name)
+                    # Generate call to manual function if its function pointer is non-null. The pointers are all filled in by
+                    # vkCreateInstance, so the lookup is only done by the first call.
+                    cmdDef += '%sstatic PFN_manual_%s custom_func = (PFN_manual_%s)custom_functions["%s"];\n' % (indent, command.name, command.name, command.name)
                     cmdDef += '%sif (custom_func != nullptr) {\n' % indent
+                    if no_xml_checks:
+                        cmdDef += '    %sstd::lock_guard<std::mutex> lock(global_lock);\n' % indent
                     cmdDef += '    %sskip |= custom_func(%s);\n' % (indent, params_text)
                     cmdDef += '%s}\n\n' % indent
                     # Release the validation lock
-                    cmdDef += '%slock.unlock();\n' % indent
+                    if not no_xml_checks:
+                        cmdDef += '%slock.unlock();\n' % indent
                     # Generate skip check and down-chain call
                     cmdDef += '%sif (!skip) {\n'  % indent
                     down_chain_call = '    %s' % indent
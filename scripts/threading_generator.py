@@ -431,7 +431,7 @@ class ThreadOutputGenerator(OutputGenerator):
         else:
             assignresult = ''
 
-        self.appendSection('command', '    bool threadChecks = startMultiThread();')
+        self.appendSection('command', '    bool threadChecks = startMultiThread(my_data);')
         self.appendSection('command', '    if (threadChecks) {')
         self.appendSection('command', "    "+"\n    ".join(str(startthreadsafety).rstrip().split("\n")))
         self.appendSection('command', '    }')
@@ -441,8 +441,6 @@ class ThreadOutputGenerator(OutputGenerator):
         self.appendSection('command', '    ' + assignresult + API + '(' + paramstext + ');')
         self.appendSection('command', '    if (threadChecks) {')
         self.appendSection('command', "    "+"\n    ".join(str(finishthreadsafety).rstrip().split("\n")))
-        self.appendSection('command', '    } else {')
-        self.appendSection('command', '        finishMultiThread();')
         self.appendSection('command', '    }')
         # Return result variable, if any.
         if (resulttype != None):
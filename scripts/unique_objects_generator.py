@@ -484,8 +484,9 @@ class UniqueObjectsOutputGenerator(OutputGenerator):
     #
     # Generate pNext handling function
     def build_extension_processing_func(self):
-        # Construct helper functions to build and free pNext extension chains
+        # Construct helper function to build unwrapped pNext extension chains in the scratch arena
         pnext_proc = ''
+        pnext_proc += '// The copies are taken from the thread\'s scratch arena, so the caller must hold a ScratchArenaScope\n'
         pnext_proc += 'void *CreateUnwrappedExtensionStructs(layer_data *dev_data, const void *pNext) {\n'
         pnext_proc += '    void *cur_pnext = const_cast<void *>(pNext);\n'
         pnext_proc += '    void *head_pnext = NULL;\n'
@@ -499,8 +500,7 @@ class UniqueObjectsOutputGenerator(OutputGenerator):
             if struct_info[0].feature_protect is not None:
                 pnext_proc += '#ifdef %s \n' % struct_info[0].feature_protect
             pnext_proc += '            case %s: {\n' % self.structTypes[item].value
-            pnext_proc += '                    safe_%s *safe_struct = new safe_%s;\n' % (item, item)
-            pnext_proc += '                    safe_struct->initialize(reinterpret_cast<const %s *>(cur_pnext));\n' % item
+            pnext_proc += '                    safe_%s *safe_struct = scratch_arena.New<safe_%s>(reinterpret_cast<const %s *>(cur_pnext));\n' % (item, item, item)
             # Generate code to unwrap the handles
             indent = '                '
             (tmp_decl, tmp_pre, tmp_post) = self.uniquify_members(struct_info, indent, 'safe_struct->', 0, False, False, False, False)
@@ -524,16 +524,6 @@ class UniqueObjectsOutputGenerator(OutputGenerator):
         pnext_proc += '        cur_pnext = const_cast<void *>(header->pNext);\n'
         pnext_proc += '    }\n'
         pnext_proc += '    return head_pnext;\n'
-        pnext_proc += '}\n\n'
-        pnext_proc += '// Free a pNext extension chain\n'
-        pnext_proc += 'void FreeUnwrappedExtensionStructs(void *head) {\n'
-        pnext_proc += '    void * curr_ptr = head;\n'
-        pnext_proc += '    while (curr_ptr) {\n'
-        pnext_proc += '        GenericHeader *header = reinterpret_cast<GenericHeader *>(curr_ptr);\n'
-        pnext_proc += '        void *temp = curr_ptr;\n'
-        pnext_proc += '        curr_ptr = header->pNext;\n'
-        pnext_proc += '        free(temp);\n'
-        pnext_proc += '    }\n'
         pnext_proc += '}\n'
         return pnext_proc
 
@@ -594,28 +584,11 @@ class UniqueObjectsOutputGenerator(OutputGenerator):
                     # Remove a single handle from the map
                     destroy_ndo_code += '%sstd::unique_lock<std::mutex> lock(global_lock);\n' % (indent)
                     destroy_ndo_code += '%suint64_t %s_id = reinterpret_cast<uint64_t &>(%s);\n' % (indent, cmd_info[param].name, cmd_info[param].name)
-                    destroy_ndo_code += '%s%s = (%s)dev_data->unique_id_mapping[%s_id];\n' % (indent, cmd_info[param].name, cmd_info[param].type, cmd_info[param].name)
-                    destroy_ndo_code += '%sdev_data->unique_id_mapping.erase(%s_id);\n' % (indent, cmd_info[param].name)
+                    destroy_ndo_code += '%s%s = (%s)dev_data->unique_id_mapping.erase(%s_id);\n' % (indent, cmd_info[param].name, cmd_info[param].type, cmd_info[param].name)
                     destroy_ndo_code += '%slock.unlock();\n' % (indent)
         return ndo_array, destroy_ndo_code
 
     #
-    # Clean up local declarations
-    def cleanUpLocalDeclarations(self, indent, prefix, name, len, index, process_pnext):
-        cleanup = '%sif (local_%s%s) {\n' % (indent, prefix, name)
-        if len is not None:
-            if process_pnext:
-                cleanup += '%s    for (uint32_t %s = 0; %s < %s%s; ++%s) {\n' % (indent, index, index, prefix, len, index)
-                cleanup += '%s        FreeUnwrappedExtensionStructs(const_cast<void *>(local_%s%s[%s].pNext));\n' % (indent, prefix, name, index)
-                cleanup += '%s    }\n' % indent
-            cleanup += '%s    delete[] local_%s%s;\n' % (indent, prefix, name)
-        else:
-            if process_pnext:
-                cleanup += '%s    FreeUnwrappedExtensionStructs(const_cast<void *>(local_%s%s->pNext));\n' % (indent, prefix, name)
-            cleanup += '%s    delete local_%s%s;\n' % (indent, prefix, name)
-        cleanup += "%s}\n" % (indent)
-        return cleanup
-    #
     # Output UO code for a single NDO (ndo_count is NULL) or a counted list of NDOs
     def outputNDOs(self, ndo_type, ndo_name, ndo_count, prefix, index, indent, destroy_func, destroy_array, top_level):
         decl_code = ''
@@ -623,11 +596,12 @@ class UniqueObjectsOutputGenerator(OutputGenerator):
         post_call_code = ''
         if ndo_count is not None:
             if top_level == True:
-                decl_code += '%s%s *local_%s%s = NULL;\n' % (indent, ndo_type, prefix, ndo_name)
+                # The unwrapped copy lives in the thread's scratch buffer and is given back when the function returns
+                decl_code += '%sScratchArray<%s> local_%s%s;\n' % (indent, ndo_type, prefix, ndo_name)
             pre_call_code += '%s    if (%s%s) {\n' % (indent, prefix, ndo_name)
             indent = self.incIndent(indent)
             if top_level == True:
-                pre_call_code += '%s    local_%s%s = new %s[%s];\n' % (indent, prefix, ndo_name, ndo_type, ndo_count)
+                pre_call_code += '%s    local_%s%s.allocate(%s);\n' % (indent, prefix, ndo_name, ndo_count)
                 pre_call_code += '%s    for (uint32_t %s = 0; %s < %s; ++%s) {\n' % (indent, index, index, ndo_count, index)
                 indent = self.incIndent(indent)
                 pre_call_code += '%s    local_%s%s[%s] = Unwrap(dev_data, %s[%s]);\n' % (indent, prefix, ndo_name, index, ndo_name, index)
@@ -639,10 +613,6 @@ class UniqueObjectsOutputGenerator(OutputGenerator):
             pre_call_code += '%s    }\n' % indent
             indent = self.decIndent(indent)
             pre_call_code += '%s    }\n' % indent
-            if top_level == True:
-                post_call_code += '%sif (local_%s%s)\n' % (indent, prefix, ndo_name)
-                indent = self.incIndent(indent)
-                post_call_code += '%sdelete[] local_%s;\n' % (indent, ndo_name)
         else:
             if top_level == True:
                 if (destroy_func == False) or (destroy_array == True):
@@ -700,11 +670,11 @@ class UniqueObjectsOutputGenerator(OutputGenerator):
                         pre_code += '%s    if (%s%s) {\n' % (indent, prefix, member.name)
                         indent = self.incIndent(indent)
                         if first_level_param == True:
-                            pre_code += '%s    %s = new safe_%s[%s];\n' % (indent, new_prefix, member.type, member.len)
+                            pre_code += '%s    %s = scratch_arena.NewArray<safe_%s>(%s);\n' % (indent, new_prefix, member.type, member.len)
                         pre_code += '%s    for (uint32_t %s = 0; %s < %s%s; ++%s) {\n' % (indent, index, index, prefix, member.len, index)
                         indent = self.incIndent(indent)
                         if first_level_param == True:
-                            pre_code += '%s    %s[%s].initialize(&%s[%s]);\n' % (indent, new_prefix, index, member.name, index)
+                            pre_code += '%s    %s[%s].initialize(&%s[%s], &scratch_arena);\n' % (indent, new_prefix, index, member.name, index)
                             if process_pnext:
                                 pre_code += '%s    %s[%s].pNext = CreateUnwrappedExtensionStructs(dev_data, %s[%s].pNext);\n' % (indent, new_prefix, index, new_prefix, index)
                         local_prefix = '%s[%s].' % (new_prefix, index)
@@ -717,8 +687,6 @@ class UniqueObjectsOutputGenerator(OutputGenerator):
                         pre_code += '%s    }\n' % indent
                         indent = self.decIndent(indent)
                         pre_code += '%s    }\n' % indent
-                        if first_level_param == True:
-                            post_code += self.cleanUpLocalDeclarations(indent, prefix, member.name, member.len, index, process_pnext)
                     # Single Struct
                     else:
                         # Update struct prefix
@@ -731,7 +699,7 @@ class UniqueObjectsOutputGenerator(OutputGenerator):
                         pre_code += '%s    if (%s%s) {\n' % (indent, prefix, member.name)
                         indent = self.incIndent(indent)
                         if first_level_param == True:
-                            pre_code += '%s    local_%s%s = new safe_%s(%s);\n' % (indent, prefix, member.name, member.type, member.name)
+                            pre_code += '%s    local_%s%s = scratch_arena.New<safe_%s>(%s);\n' % (indent, prefix, member.name, member.type, member.name)
                         # Process sub-structs in this struct
                         (tmp_decl, tmp_pre, tmp_post) = self.uniquify_members(struct_info, indent, new_prefix, array_index, create_func, destroy_func, destroy_array, False)
                         decls += tmp_decl
@@ -741,8 +709,6 @@ class UniqueObjectsOutputGenerator(OutputGenerator):
                             pre_code += '%s    local_%s%s->pNext = CreateUnwrappedExtensionStructs(dev_data, local_%s%s->pNext);\n' % (indent, prefix, member.name, prefix, member.name)
                         indent = self.decIndent(indent)
                         pre_code += '%s    }\n' % indent
-                        if first_level_param == True:
-                            post_code += self.cleanUpLocalDeclarations(indent, prefix, member.name, member.len, index, process_pnext)
         return decls, pre_code, post_code
     #
     # For a particular API, generate the non-dispatchable-object wrapping/unwrapping code
@@ -771,6 +737,9 @@ class UniqueObjectsOutputGenerator(OutputGenerator):
             create_func = True if create_ndo_code else False
             destroy_func = True if destroy_ndo_code else False
             (paramdecl, param_pre_code, param_post_code) = self.uniquify_members(cmd_info, indent, '', 0, create_func, destroy_func, destroy_array, True)
+            if 'scratch_arena' in param_pre_code:
+                # The safe_struct copies are released when the scope ends, after the down-chain call returns
+                paramdecl = '%sScratchArenaScope scratch_scope;\n' % indent + paramdecl
             param_post_code += create_ndo_code
             if destroy_ndo_code:
                 if destroy_array == True:
@@ -910,7 +879,8 @@ class UniqueObjectsOutputGenerator(OutputGenerator):
             # Put all this together for the final down-chain call
             self.appendSection('command', '    ' + assignresult + API + '(' + paramstext + ');')
             # And add the post-API-call codegen
-            self.appendSection('command', "\n".join(str(api_post).rstrip().split("\n")))
+            if api_post:
+                self.appendSection('command', "\n".join(str(api_post).rstrip().split("\n")))
             # Handle the return result variable, if any
             if (resulttype != None):
                 self.appendSection('command', '    return result;')
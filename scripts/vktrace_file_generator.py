@@ -121,6 +121,74 @@ api_exclusions = [
                 # VK_KHR_display_swapchain
                 'CreateSharedSwapchainsKHR'
                 ]
+
+# Entrypoints whose trace hooks are written by hand in vktrace_lib_trace.cpp
+manually_written_hooked_funcs = ['vkAllocateCommandBuffers',
+                                 'vkAllocateMemory',
+                                 'vkAllocateDescriptorSets',
+                                 'vkBeginCommandBuffer',
+                                 'vkCreateDescriptorPool',
+                                 'vkGetPhysicalDeviceProperties',
+                                 'vkCreateDevice',
+                                 'vkCreateFramebuffer',
+                                 'vkCreateImage',
+                                 'vkCreateBuffer',
+                                 'vkCreateInstance',
+                                 'vkCreatePipelineCache',
+                                 'vkCreateRenderPass',
+                                 'vkGetPipelineCacheData',
+                                 'vkCreateGraphicsPipelines',
+                                 'vkCreateComputePipelines',
+                                 'vkCmdPipelineBarrier',
+                                 'vkCmdWaitEvents',
+                                 'vkCmdBeginRenderPass',
+                                 'vkCmdPushConstants',
+                                 'vkDestroyInstance',
+                                 'vkEnumeratePhysicalDevices',
+                                 'vkFreeMemory',
+                                 'vkFreeDescriptorSets',
+                                 'vkQueueSubmit',
+                                 'vkQueueBindSparse',
+                                 'vkFlushMappedMemoryRanges',
+                                 'vkInvalidateMappedMemoryRanges',
+                                 'vkGetDeviceProcAddr',
+                                 'vkGetInstanceProcAddr',
+                                 'vkEnumerateInstanceExtensionProperties',
+                                 'vkEnumerateDeviceExtensionProperties',
+                                 'vkEnumerateInstanceLayerProperties',
+                                 'vkEnumerateDeviceLayerProperties',
+                                 'vkGetPhysicalDeviceQueueFamilyProperties',
+                                 'vkGetQueryPoolResults',
+                                 'vkMapMemory',
+                                 'vkUnmapMemory',
+                                 'vkUpdateDescriptorSets',
+                                 'vkGetPhysicalDeviceSurfaceCapabilitiesKHR',
+                                 'vkGetPhysicalDeviceSurfaceFormatsKHR',
+                                 'vkGetPhysicalDeviceSurfacePresentModesKHR',
+                                 'vkCreateSwapchainKHR',
+                                 'vkGetSwapchainImagesKHR',
+                                 'vkQueuePresentKHR',
+                                 #TODO add Mir
+                                 'vkCreateXcbSurfaceKHR',
+                                 'vkCreateWaylandSurfaceKHR',
+                                 'vkCreateXlibSurfaceKHR',
+                                 'vkGetPhysicalDeviceXcbPresentationSupportKHR',
+                                 'vkGetPhysicalDeviceWaylandPresentationSupportKHR',
+                                 'vkGetPhysicalDeviceXlibPresentationSupportKHR',
+                                 'vkCreateWin32SurfaceKHR',
+                                 'vkGetPhysicalDeviceWin32PresentationSupportKHR',
+                                 'vkCreateAndroidSurfaceKHR',
+                                 'vkCreateDescriptorUpdateTemplateKHR',
+                                 'vkDestroyDescriptorUpdateTemplateKHR',
+                                 'vkUpdateDescriptorSetWithTemplateKHR',
+                                 'vkCmdPushDescriptorSetWithTemplateKHR',
+                                 'vkAcquireXlibDisplayEXT',
+                                 'vkGetRandROutputDisplayEXT',
+                                 'vkCreateObjectTableNVX',
+                                 'vkCmdProcessCommandsNVX',
+                                 'vkCreateIndirectCommandsLayoutNVX',
+                                 # TODO: VK_EXT_display_control
+                                 ]
 #
 # VkTraceFileOutputGeneratorOptions - subclass of GeneratorOptions.
 class VkTraceFileOutputGeneratorOptions(GeneratorOptions):
@@ -444,6 +512,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         replay_objmapper_header += '#pragma once\n\n'
         replay_objmapper_header += '#include <set>\n'
         replay_objmapper_header += '#include <map>\n'
+        replay_objmapper_header += '#include <unordered_map>\n'
         replay_objmapper_header += '#include <list>\n'
         replay_objmapper_header += '#include <vector>\n'
         replay_objmapper_header += '#include <string>\n'
@@ -473,7 +542,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                 obj_name = item[2:].lower() + 'Obj'
             else:
                 obj_name = item
-            replay_objmapper_header += '    std::map<%s, %s> %s;\n' % (item, obj_name, mangled_name)
+            replay_objmapper_header += '    std::unordered_map<%s, %s> %s;\n' % (item, obj_name, mangled_name)
             replay_objmapper_header += '    void add_to_%s_map(%s pTraceVal, %s pReplayVal) {\n' % (map_name, item, obj_name)
             replay_objmapper_header += '        %s[pTraceVal] = pReplayVal;\n' % mangled_name
             replay_objmapper_header += '    }\n\n'
@@ -485,14 +554,14 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             replay_objmapper_header += '    %s remap_%s(const %s& value) {\n' % (item, map_name, item)
             replay_objmapper_header += '        if (value == 0) { return 0; }\n'
             if item in remapped_objects:
-                replay_objmapper_header += '        std::map<%s, %s>::const_iterator q = %s.find(value);\n' % (item, obj_name, mangled_name)
+                replay_objmapper_header += '        std::unordered_map<%s, %s>::const_iterator q = %s.find(value);\n' % (item, obj_name, mangled_name)
                 if item == 'VkDeviceMemory':
                     replay_objmapper_header += '        if (q == %s.end()) { vktrace_LogError("Failed to remap %s."); return VK_NULL_HANDLE; }\n' % (mangled_name, item)
                 else:
                     replay_objmapper_header += '        if (q == %s.end()) return VK_NULL_HANDLE;\n' % mangled_name
                 replay_objmapper_header += '        return q->second.replay%s;\n' % item[2:]
             else:
-                replay_objmapper_header += '        std::map<%s, %s>::const_iterator q = %s.find(value);\n' % (item, obj_name, mangled_name)
+                replay_objmapper_header += '        std::unordered_map<%s, %s>::const_iterator q = %s.find(value);\n' % (item, obj_name, mangled_name)
                 replay_objmapper_header += '        if (q == %s.end()) { vktrace_LogError("Failed to remap %s."); return VK_NULL_HANDLE; }\n' % (mangled_name, item)
                 replay_objmapper_header += '        return q->second;\n'
             replay_objmapper_header += '    }\n\n'
@@ -561,6 +630,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                                  'GetPipelineCacheData',
                                  'CreateGraphicsPipelines',
                                  'CreateComputePipelines',
+                                 'DestroyShaderModule',
                                  'CreatePipelineLayout',
                                  'CreateRenderPass',
                                  'CmdBeginRenderPass',
@@ -587,6 +657,8 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                                  'CreateSwapchainKHR',
                                  'DestroySwapchainKHR',
                                  'GetSwapchainImagesKHR',
+                                 'AcquireNextImageKHR',
+                                 'DestroySurfaceKHR',
                                  'CreateXcbSurfaceKHR',
                                  'CreateWaylandSurfaceKHR',
                                  'CreateXlibSurfaceKHR',
@@ -612,6 +684,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                                  'UpdateDescriptorSetWithTemplateKHR',
                                  'CmdPushDescriptorSetWithTemplateKHR',
                                  'BindBufferMemory',
+                                 'BindImageMemory',
                                  # VK_EXT_display_control
                                  'RegisterDeviceEventEXT',
                                  'RegisterDisplayEventEXT',
@@ -630,6 +703,23 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         do_while_dict = {'GetFenceStatus': 'replayResult != pPacket->result  && pPacket->result == VK_SUCCESS',
                          'GetEventStatus': '(pPacket->result == VK_EVENT_SET || pPacket->result == VK_EVENT_RESET) && replayResult != pPacket->result',
                          'GetQueryPoolResults': 'pPacket->result == VK_SUCCESS && replayResult != pPacket->result'}
+        # GpuTimestamps calls made before and after the real call of generated functions
+        gpu_timestamps_before = {'DestroyDevice': 'destroy_device(remappeddevice)',
+                                 'DestroyCommandPool': 'destroy_command_pool(remappedcommandPool)',
+                                 'FreeCommandBuffers': 'free_command_buffers(pPacket->commandBufferCount, remappedpCommandBuffers)',
+                                 'EndCommandBuffer': 'end_command_buffer(remappedcommandBuffer)',
+                                 'CmdDebugMarkerBeginEXT': 'begin_region(remappedcommandBuffer, vktrace_replay::GPU_TIMESTAMPS_DEBUG_MARKER, pPacket->header->global_packet_index, pPacket->pMarkerInfo->pMarkerName)'}
+        gpu_timestamps_after = {'CmdEndRenderPass': 'end_region(remappedcommandBuffer, vktrace_replay::GPU_TIMESTAMPS_RENDER_PASS)',
+                                'CmdDebugMarkerEndEXT': 'end_region(remappedcommandBuffer, vktrace_replay::GPU_TIMESTAMPS_DEBUG_MARKER)'}
+        # ReplayAnnotations calls made before the real call of generated functions
+        annotations_before = {'DestroyDevice': 'destroy_device(remappeddevice)',
+                              'DestroyCommandPool': 'destroy_command_pool(remappedcommandPool)',
+                              'FreeCommandBuffers': 'free_command_buffers(pPacket->commandBufferCount, remappedpCommandBuffers)',
+                              'EndCommandBuffer': 'end_command_buffer(remappedcommandBuffer)'}
+        # Draws FastForward may leave out, and the calls it follows
+        fast_forward_draws = ['CmdDraw', 'CmdDrawIndexed', 'CmdDrawIndirect', 'CmdDrawIndexedIndirect',
+                              'CmdDrawIndirectCountAMD', 'CmdDrawIndexedIndirectCountAMD']
+        fast_forward_after = {'CreateImageView': 'add_image_view(createInfo.image, local_pView)'}
 
         replay_gen_source  = '\n'
         replay_gen_source += '#include "vkreplay_vkreplay.h"\n'
@@ -640,7 +730,8 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         replay_gen_source += '\n'
         replay_gen_source += 'extern "C" {\n'
         replay_gen_source += '#include "vktrace_vk_vk_packets.h"\n'
-        replay_gen_source += '#include "vktrace_vk_packet_id.h"\n\n'
+        replay_gen_source += '#include "vktrace_vk_packet_id.h"\n'
+        replay_gen_source += '#include "vktrace_cmd_block.h"\n\n'
         replay_gen_source += 'void vkFuncs::init_funcs(void * handle) {\n'
         replay_gen_source += '    m_libHandle = handle;\n'
 
@@ -661,9 +752,17 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             if protect is not None:
                 replay_gen_source += '#endif // %s\n' % protect
         replay_gen_source += '}\n\n'
+        cmd_block_cases = []
         replay_gen_source += 'vktrace_replay::VKTRACE_REPLAY_RESULT vkReplay::replay(vktrace_trace_packet_header *packet) { \n'
         replay_gen_source += '    vktrace_replay::VKTRACE_REPLAY_RESULT returnValue = vktrace_replay::VKTRACE_REPLAY_SUCCESS;\n'
         replay_gen_source += '    VkResult replayResult = VK_ERROR_VALIDATION_FAILED_EXT;\n'
+        replay_gen_source += '    vktrace_replay::ReplayArenaScope arenaScope;\n'
+        replay_gen_source += '    if (!m_pendingPipelines.empty() && !replays_during_pipeline_creation(packet->packet_id)) {\n'
+        replay_gen_source += '        finish_pipeline_creation();\n'
+        replay_gen_source += '    }\n'
+        replay_gen_source += '    if (m_pAnnotations != NULL) {\n'
+        replay_gen_source += '        annotate(packet);\n'
+        replay_gen_source += '    }\n'
         replay_gen_source += '    switch (packet->packet_id) {\n'
         replay_gen_source += '        case VKTRACE_TPI_VK_vkApiVersion: {\n'
         replay_gen_source += '            packet_vkApiVersion* pPacket = (packet_vkApiVersion*)(packet->pBody);\n'
@@ -700,6 +799,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             params = cmd_member_dict[vk_cmdname]
             replay_gen_source += '        case VKTRACE_TPI_VK_vk%s: { \n' % cmdname
             replay_gen_source += '            packet_vk%s* pPacket = (packet_vk%s*)(packet->pBody);\n' % (cmdname, cmdname)
+            body_start = len(replay_gen_source)
 
             if cmdname in manually_replay_funcs:
                 if ret_value == True:
@@ -756,7 +856,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                     else:
                         replay_gen_source += '            %s local_%s;\n' % (params[-1].type.strip('*').replace('const ', ''), params[-1].name)
                 elif cmdname == 'ResetFences':
-                    replay_gen_source += '            VkFence* fences = VKTRACE_NEW_ARRAY(VkFence, pPacket->fenceCount);\n'
+                    replay_gen_source += '            VkFence* fences = VKTRACE_REPLAY_NEW_ARRAY(VkFence, pPacket->fenceCount);\n'
                     replay_gen_source += '            for (uint32_t i = 0; i < pPacket->fenceCount; i++) {\n'
                     replay_gen_source += '                fences[i] = m_objMapper.remap_fences(pPacket->%s[i]);\n' % (params[-1].name)
                     replay_gen_source += '                if (fences[i] == VK_NULL_HANDLE) {\n'
@@ -765,6 +865,11 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                     replay_gen_source += '                }\n'
                     replay_gen_source += '            }\n'
                 elif cmdname in do_while_dict:
+                    replay_gen_source += '            if (m_collapsePolling) {\n'
+                    replay_gen_source += '                replayResult = collapse_vk%s(pPacket);\n' % cmdname
+                    replay_gen_source += '                CHECK_RETURN_VALUE(vk%s);\n' % cmdname
+                    replay_gen_source += '                break;\n'
+                    replay_gen_source += '            }\n'
                     replay_gen_source += '            do {\n'
                 last_name = ''
                 for p in params:
@@ -854,8 +959,34 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                     rr_string = rr_string.replace('pPacket->pSetLayouts', 'pLocalDescSetLayouts')
                 elif cmdname == 'ResetFences':
                    rr_string = rr_string.replace('pPacket->pFences', 'fences')
+                if cmdname == 'DestroyDevice':
+                    replay_gen_source += '            release_loop_state(remappeddevice);\n'
+                    replay_gen_source += '            save_pipeline_cache(remappeddevice);\n'
+                    replay_gen_source += '            if (m_pMemorySuballocator != NULL) {\n'
+                    replay_gen_source += '                m_pMemorySuballocator->destroy_device(remappeddevice);\n'
+                    replay_gen_source += '            }\n'
+                if cmdname in fast_forward_draws:
+                    replay_gen_source += '            if (m_pFastForward != NULL && m_pFastForward->skip_draw(remappedcommandBuffer)) {\n'
+                    replay_gen_source += '                break;\n'
+                    replay_gen_source += '            }\n'
+                if cmdname in gpu_timestamps_before:
+                    replay_gen_source += '            if (m_pGpuTimestamps != NULL) {\n'
+                    replay_gen_source += '                m_pGpuTimestamps->%s;\n' % gpu_timestamps_before[cmdname]
+                    replay_gen_source += '            }\n'
+                if cmdname in annotations_before:
+                    replay_gen_source += '            if (m_pAnnotations != NULL) {\n'
+                    replay_gen_source += '                m_pAnnotations->%s;\n' % annotations_before[cmdname]
+                    replay_gen_source += '            }\n'
                 # Insert the real_*(..) call
                 replay_gen_source += '%s\n' % rr_string
+                if cmdname in gpu_timestamps_after:
+                    replay_gen_source += '            if (m_pGpuTimestamps != NULL) {\n'
+                    replay_gen_source += '                m_pGpuTimestamps->%s;\n' % gpu_timestamps_after[cmdname]
+                    replay_gen_source += '            }\n'
+                if cmdname in fast_forward_after:
+                    replay_gen_source += '            if (m_pFastForward != NULL && replayResult == VK_SUCCESS) {\n'
+                    replay_gen_source += '                m_pFastForward->%s;\n' % fast_forward_after[cmdname]
+                    replay_gen_source += '            }\n'
                 # Handle return values or anything that needs to happen after the real_*(..) call
                 get_ext_layers_proto = ['EnumerateInstanceExtensionProperties', 'EnumerateDeviceExtensionProperties','EnumerateInstanceLayerProperties', 'EnumerateDeviceLayerProperties']
                 if 'DestroyDevice' in cmdname:
@@ -905,8 +1036,6 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                     replay_gen_source += '            if (memcmp(&memProperties, pPacket->pMemoryProperties, sizeof(VkPhysicalDeviceMemoryProperties)) != 0) {\n'
                     replay_gen_source += '                vktrace_LogError("Physical Device Memory properties differ. Memory heaps may not match as expected.");\n'
                     replay_gen_source += '            }\n'
-                elif cmdname == 'ResetFences':
-                    replay_gen_source += '            VKTRACE_DELETE(fences);\n'
                 elif create_func: # Save handle mapping if create successful
                     if ret_value:
                         replay_gen_source += '            if (replayResult == VK_SUCCESS) {\n'
@@ -921,10 +1050,25 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                     replay_gen_source += '            if (pPacket->result != VK_NOT_READY || replayResult != VK_SUCCESS)\n'
             if ret_value:
                 replay_gen_source += '            CHECK_RETURN_VALUE(vk%s);\n' % cmdname
+            cmd_block_fields = self.GetCmdBlockFields(vk_cmdname, params)
+            if cmd_block_fields is not None:
+                cmd_block_cases.append((vk_cmdname, protect, cmd_block_fields, replay_gen_source[body_start:]))
             replay_gen_source += '            break;\n'
             replay_gen_source += '        }\n'
             if protect is not None:
                 replay_gen_source += '#endif // %s\n' % protect
+        replay_gen_source += '        case VKTRACE_TPI_CMD_BLOCK: {\n'
+        replay_gen_source += '            returnValue = replay_cmd_block(packet);\n'
+        replay_gen_source += '            break;\n'
+        replay_gen_source += '        }\n'
+        replay_gen_source += '        case VKTRACE_TPI_GPU_TIMING: {\n'
+        replay_gen_source += '            returnValue = replay_gpu_timing(packet);\n'
+        replay_gen_source += '            break;\n'
+        replay_gen_source += '        }\n'
+        replay_gen_source += '        case VKTRACE_TPI_QUERY_DIGEST: {\n'
+        replay_gen_source += '            returnValue = replay_query_digest(packet);\n'
+        replay_gen_source += '            break;\n'
+        replay_gen_source += '        }\n'
         replay_gen_source += '        default:\n'
         replay_gen_source += '            vktrace_LogWarning("Unrecognized packet_id %u, skipping.", packet->packet_id);\n'
         replay_gen_source += '            returnValue = vktrace_replay::VKTRACE_REPLAY_INVALID_ID;\n'
@@ -932,9 +1076,67 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         replay_gen_source += '    }\n'
         replay_gen_source += '    return returnValue;\n'
         replay_gen_source += '}\n'
+        replay_gen_source += '\n'
+        replay_gen_source += self.GenerateReplayCmdBlock(cmd_block_cases)
         replay_gen_source += '}\n'
         return replay_gen_source
     #
+    # Generate vkReplay::replay_cmd_block(), which decodes the calls in a command block into packet structs on the stack
+    # and replays them the same way as the packets of the calls. cmd_block_cases holds the name, feature protect,
+    # command block fields and replay code of each call that can be in a block.
+    def GenerateReplayCmdBlock(self, cmd_block_cases):
+        src  = 'vktrace_replay::VKTRACE_REPLAY_RESULT vkReplay::replay_cmd_block(vktrace_trace_packet_header *packet) {\n'
+        src += '    vktrace_replay::VKTRACE_REPLAY_RESULT returnValue = vktrace_replay::VKTRACE_REPLAY_SUCCESS;\n'
+        src += '    VkResult replayResult = VK_ERROR_VALIDATION_FAILED_EXT;\n'
+        src += '    const vktrace_cmd_block* pBlock = (const vktrace_cmd_block*)(packet->pBody);\n'
+        src += '    vktrace_cmd_block_reader reader;\n'
+        src += '    uint16_t opcode;\n'
+        src += '    vktrace_cmd_block_reader_init(&reader, pBlock);\n'
+        src += '    while (vktrace_cmd_block_next(&reader, &opcode)) {\n'
+        src += '        vktrace_replay::ReplayArenaScope arenaScope;\n'
+        src += '        switch (opcode) {\n'
+        for (name, protect, fields, body) in cmd_block_cases:
+            if protect is not None:
+                src += '#ifdef %s\n' % protect
+            src += '            case VKTRACE_TPI_VK_%s: {\n' % name
+            src += '                packet_%s body = {};\n' % name
+            src += '                packet_%s* pPacket = &body;\n' % name
+            src += '                pPacket->header = packet;\n'
+            src += '                pPacket->commandBuffer = pBlock->commandBuffer;\n'
+            for (p, size, kind) in fields:
+                if kind == 'value':
+                    src += '                vktrace_cmd_block_get(&reader, &pPacket->%s, sizeof(pPacket->%s));\n' % (p.name, p.name)
+                elif kind == 'static_array':
+                    src += '                vktrace_cmd_block_get(&reader, (void*)pPacket->%s, sizeof(pPacket->%s));\n' % (p.name, p.name)
+                elif p.type == 'void':
+                    src += '                pPacket->%s = vktrace_cmd_block_get_array(&reader, pPacket->%s);\n' % (p.name, p.len)
+                elif kind == 'array':
+                    src += '                pPacket->%s = (const %s*)vktrace_cmd_block_get_array(&reader, pPacket->%s * sizeof(%s));\n' % (p.name, p.type, p.len, p.type)
+                else:
+                    src += '                pPacket->%s = (const %s*)vktrace_cmd_block_get_array(&reader, sizeof(%s));\n' % (p.name, p.type, p.type)
+            src += '                if (!vktrace_cmd_block_entry_done(&reader)) {\n'
+            src += '                    vktrace_LogError("Corrupt %s in command block.");\n' % name
+            src += '                    return vktrace_replay::VKTRACE_REPLAY_ERROR;\n'
+            src += '                }\n'
+            for line in body.splitlines():
+                src += ('    ' + line if line.strip() and not line.startswith('#') else line) + '\n'
+            src += '                break;\n'
+            src += '            }\n'
+            if protect is not None:
+                src += '#endif // %s\n' % protect
+        src += '            default:\n'
+        src += '                vktrace_LogWarning("Unrecognized command %u in command block, skipping.", opcode);\n'
+        src += '                break;\n'
+        src += '        }\n'
+        src += '    }\n'
+        src += '    if (reader.corrupt) {\n'
+        src += '        vktrace_LogError("Command block is corrupt.");\n'
+        src += '        return vktrace_replay::VKTRACE_REPLAY_ERROR;\n'
+        src += '    }\n'
+        src += '    return returnValue;\n'
+        src += '}\n'
+        return src
+    #
     # Parameter remapping utility function
     def RemapPacketParam(self, funcName, param, lastName):
         param_exclude_list = ['pDescriptorSets', 'pFences']
@@ -1065,6 +1267,9 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         trace_pkt_id_hdr += '#include "vktrace_vk_vk_packets.h"\n'
         trace_pkt_id_hdr += '#include "vktrace_trace_packet_utils.h"\n'
         trace_pkt_id_hdr += '#include "vktrace_trace_packet_identifiers.h"\n'
+        trace_pkt_id_hdr += '#include "vktrace_cmd_block.h"\n'
+        trace_pkt_id_hdr += '#include "vktrace_gpu_timing.h"\n'
+        trace_pkt_id_hdr += '#include "vktrace_query_digest.h"\n'
         trace_pkt_id_hdr += '#include "vktrace_interconnect.h"\n'
         trace_pkt_id_hdr += '#include <inttypes.h>\n'
         trace_pkt_id_hdr += '#include "vk_enum_string_helper.h"\n'
@@ -1088,8 +1293,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         trace_pkt_id_hdr += '    pHeader = vktrace_create_trace_packet(VKTRACE_TID_VULKAN, VKTRACE_TPI_VK_##entrypoint, sizeof(packet_##entrypoint), buffer_bytes_needed);\n\n'
         trace_pkt_id_hdr += '#define FINISH_TRACE_PACKET() \\\n'
         trace_pkt_id_hdr += '    vktrace_finalize_trace_packet(pHeader); \\\n'
-        trace_pkt_id_hdr += '    vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file()); \\\n'
-        trace_pkt_id_hdr += '    vktrace_delete_trace_packet(&pHeader);\n'
+        trace_pkt_id_hdr += '    vktrace_submit_trace_packet(&pHeader, vktrace_trace_get_trace_file());\n'
         trace_pkt_id_hdr += '\n'
         trace_pkt_id_hdr += '// Include trace packet identifier definitions\n'
         trace_pkt_id_hdr += '#include "vktrace_trace_packet_identifiers.h"\n\n'
@@ -1110,6 +1314,15 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             trace_pkt_id_hdr += '        case VKTRACE_TPI_VK_%s: {\n' % api.name
             trace_pkt_id_hdr += '            return "%s";\n' % api.name
             trace_pkt_id_hdr += '        };\n'
+        trace_pkt_id_hdr += '        case VKTRACE_TPI_CMD_BLOCK: {\n'
+        trace_pkt_id_hdr += '            return "command block";\n'
+        trace_pkt_id_hdr += '        }\n'
+        trace_pkt_id_hdr += '        case VKTRACE_TPI_GPU_TIMING: {\n'
+        trace_pkt_id_hdr += '            return "GPU timing";\n'
+        trace_pkt_id_hdr += '        }\n'
+        trace_pkt_id_hdr += '        case VKTRACE_TPI_QUERY_DIGEST: {\n'
+        trace_pkt_id_hdr += '            return "query digest";\n'
+        trace_pkt_id_hdr += '        }\n'
         trace_pkt_id_hdr += '        default:\n'
         trace_pkt_id_hdr += '            return NULL;\n'
         trace_pkt_id_hdr += '    }\n'
@@ -1118,7 +1331,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         #
         # Construct packet id stringify helper function
         trace_pkt_id_hdr += 'static const char *vktrace_stringify_vk_packet_id(const VKTRACE_TRACE_PACKET_ID_VK id, const vktrace_trace_packet_header* pHeader) {\n'
-        trace_pkt_id_hdr += '    static char str[1024];\n'
+        trace_pkt_id_hdr += '    static VKTRACE_THREAD_LOCAL char str[1024];\n'
         trace_pkt_id_hdr += '    switch(id) {\n'
         trace_pkt_id_hdr += '        case VKTRACE_TPI_VK_vkApiVersion: {\n'
         trace_pkt_id_hdr += '            packet_vkApiVersion* pPacket = (packet_vkApiVersion*)(pHeader->pBody);\n'
@@ -1157,6 +1370,22 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             trace_pkt_id_hdr += '            snprintf(str, 1024, "%s"%s);\n' % (func_str, print_vals)
             trace_pkt_id_hdr += '            return str;\n'
             trace_pkt_id_hdr += '        }\n'
+        trace_pkt_id_hdr += '        case VKTRACE_TPI_CMD_BLOCK: {\n'
+        trace_pkt_id_hdr += '            vktrace_cmd_block* pPacket = (vktrace_cmd_block*)(pHeader->pBody);\n'
+        trace_pkt_id_hdr += '            snprintf(str, 1024, "command block(commandBuffer = %p, commandCount = %u, streamSize = %u)", (void*)(pPacket->commandBuffer), pPacket->commandCount, pPacket->streamSize);\n'
+        trace_pkt_id_hdr += '            return str;\n'
+        trace_pkt_id_hdr += '        }\n'
+        trace_pkt_id_hdr += '        case VKTRACE_TPI_GPU_TIMING: {\n'
+        trace_pkt_id_hdr += '            vktrace_gpu_timing* pPacket = (vktrace_gpu_timing*)(pHeader->pBody);\n'
+        trace_pkt_id_hdr += '            snprintf(str, 1024, "GPU timing(commandBuffer = %p, beginPacketIndex = %" PRIu64 ", submitPacketIndex = %" PRIu64 ", frame = %u, gpuTime = %.3f ms)", (void*)(pPacket->commandBuffer), pPacket->beginPacketIndex, pPacket->submitPacketIndex, pPacket->frame, pPacket->gpuTime / 1000000.0);\n'
+        trace_pkt_id_hdr += '            return str;\n'
+        trace_pkt_id_hdr += '        }\n'
+        trace_pkt_id_hdr += '        case VKTRACE_TPI_QUERY_DIGEST: {\n'
+        trace_pkt_id_hdr += '            vktrace_query_digest* pPacket = (vktrace_query_digest*)(pHeader->pBody);\n'
+        trace_pkt_id_hdr += '            const char* name = vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)pPacket->callId);\n'
+        trace_pkt_id_hdr += '            snprintf(str, 1024, "query digest(%s, dispatchable = %p, object = 0x%" PRIx64 ", digest = 0x%016" PRIx64 ")", name != NULL ? name : "?", (void*)(uintptr_t)(pPacket->dispatchable), pPacket->object, pPacket->digest);\n'
+        trace_pkt_id_hdr += '            return str;\n'
+        trace_pkt_id_hdr += '        }\n'
         trace_pkt_id_hdr += '        default:\n'
         trace_pkt_id_hdr += '            return NULL;\n'
         trace_pkt_id_hdr += '    }\n'
@@ -1186,6 +1415,22 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                 continue
             interp_func_body += '        case VKTRACE_TPI_VK_%s: {\n' % api.name
             interp_func_body += '            return interpret_body_as_%s(pHeader)->header;\n        }\n' % api.name
+        interp_func_body += '        case VKTRACE_TPI_CMD_BLOCK: {\n'
+        interp_func_body += '            // The stream needs no fixing up, the calls are decoded as they are replayed\n'
+        interp_func_body += '            vktrace_cmd_block* pPacket = (vktrace_cmd_block*)pHeader->pBody;\n'
+        interp_func_body += '            pPacket->header = pHeader;\n'
+        interp_func_body += '            return pHeader;\n'
+        interp_func_body += '        }\n'
+        interp_func_body += '        case VKTRACE_TPI_GPU_TIMING: {\n'
+        interp_func_body += '            vktrace_gpu_timing* pPacket = (vktrace_gpu_timing*)pHeader->pBody;\n'
+        interp_func_body += '            pPacket->header = pHeader;\n'
+        interp_func_body += '            return pHeader;\n'
+        interp_func_body += '        }\n'
+        interp_func_body += '        case VKTRACE_TPI_QUERY_DIGEST: {\n'
+        interp_func_body += '            vktrace_query_digest* pPacket = (vktrace_query_digest*)pHeader->pBody;\n'
+        interp_func_body += '            pPacket->header = pHeader;\n'
+        interp_func_body += '            return pHeader;\n'
+        interp_func_body += '        }\n'
         interp_func_body += '        default:\n'
         interp_func_body += '            return NULL;\n'
         interp_func_body += '    }\n'
@@ -1406,7 +1651,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                                                         'finalize_txt': 'vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pCreateInfo->pQueueFamilyIndices));\n'
                                                                         '    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pCreateInfo))'},
                            'VkShaderModuleCreateInfo': {'add_txt':      'vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pCreateInfo), sizeof(VkShaderModuleCreateInfo), pCreateInfo);\n'
-                                                                        '    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pCreateInfo->pCode), pPacket->pCreateInfo->codeSize, pCreateInfo->pCode)',
+                                                                        '    vktrace_add_blob_to_trace_packet(pHeader, (void**)&(pPacket->pCreateInfo->pCode), pPacket->pCreateInfo->codeSize, pCreateInfo->pCode)',
                                                         'finalize_txt': 'vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pCreateInfo->pCode));\n'
                                                                         '    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pCreateInfo))'},
                           }
@@ -1442,6 +1687,78 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                 ptr_param_list.append(pp_dict)
         return ptr_param_list
 
+    # Returns True if values of type_name can be copied as plain bytes: scalars, enums and handles, and structs and
+    # unions made of those without a pNext chain
+    def IsPlainDataType(self, type_name):
+        if type_name in ['void', 'char'] or type_name.startswith('PFN_'):
+            return False
+        members = next((struct.members for struct in self.structMembers if struct.name == type_name), None)
+        if members is None:
+            return True
+        for member in members:
+            if member.ispointer or member.name == 'sType' or not self.IsPlainDataType(member.type):
+                return False
+        return True
+    #
+    # Returns how the params after commandBuffer of a vkCmd* entrypoint are stored in a command block (see
+    # vktrace_cmd_block.h), as a list of (param, size, kind) in stream order, or None if the entrypoint isn't traced
+    # in command blocks. size is a C expression in terms of the params, with pPacket for static arrays. kind is
+    # 'value', 'static_array', 'array' (a pointer with a len) or 'single' (a pointer to one element).
+    def GetCmdBlockFields(self, name, params):
+        if not name.startswith('vkCmd') or name in manually_written_hooked_funcs or params[0].type != 'VkCommandBuffer':
+            return None
+        fields = []
+        earlier_names = [params[0].name]
+        for p in params[1:]:
+            if p.name == '':
+                continue
+            if p.isstaticarray:
+                fields.append((p, 'sizeof(pPacket->%s)' % p.name, 'static_array'))
+            elif not p.ispointer:
+                if not self.IsPlainDataType(p.type):
+                    return None
+                fields.append((p, 'sizeof(%s)' % p.name, 'value'))
+            elif not p.isconst or '**' in p.cdecl:
+                return None
+            elif p.len:
+                if p.len not in earlier_names:
+                    return None
+                if p.type == 'void':
+                    fields.append((p, p.len, 'array'))
+                elif self.IsPlainDataType(p.type):
+                    fields.append((p, '%s * sizeof(%s)' % (p.len, p.type), 'array'))
+                else:
+                    return None
+            elif self.IsPlainDataType(p.type):
+                fields.append((p, 'sizeof(%s)' % p.type, 'single'))
+            else:
+                return None
+            earlier_names.append(p.name)
+        return fields
+    #
+    # Returns the buffers that follow the body of an entrypoint's packet, as a list of (param, size) in packet order, if
+    # each of its pointer params is copied as it is, or None if any needs custom handling. size is a C expression in
+    # terms of the params. These packets are sized exactly and written in one pass with
+    # vktrace_write_buffer_to_trace_packet: a struct is copied up to its pNext, so only sizeof it is needed, and
+    # pAllocator is never copied.
+    def GetPacketBufferSlots(self, params):
+        if any(p.ispointer and p.name in ['pTag', 'pUserData'] for p in params):
+            return None
+        slots = []
+        for pp_dict in self.GetPacketPtrParamList(params):
+            p = params[pp_dict['index']]
+            if pp_dict['finalize_txt'] != 'vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->%s))' % p.name:
+                return None
+            match = re.match(r'^vktrace_add_buffer_to_trace_packet\(pHeader, \(void\*\*\)&\(pPacket->(\w+)\), ([^;]+), (\w+)\)$', pp_dict['add_txt'])
+            if match is None or match.group(1) != p.name or '_dataSize' in match.group(2):
+                return None
+            if match.group(3) == 'NULL' and p.name == 'pAllocator':
+                continue
+            if match.group(3) != p.name:
+                return None
+            slots.append((p, match.group(2)))
+        return slots
+    #
     # Take a list of params and return a list of packet size elements
     def GetPacketSize(self, params):
         ps = [] # List of elements to be added together to account for packet size for given params
@@ -1769,7 +2086,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             trim_instructions.append("            pInfo->ObjectInfo.Image.memorySize = pMemoryRequirements->size;")
             trim_instructions.append("        }")
             trim_instructions.append("#if TRIM_USE_ORDERED_IMAGE_CREATION")
-            trim_instructions.append("        trim::add_Image_call(trim::copy_packet(pHeader));")
+            trim_instructions.append("        trim::add_Image_call(image, trim::copy_packet(pHeader));")
             trim_instructions.append("#else")
             trim_instructions.append("        if (pInfo != NULL) {")
             trim_instructions.append("            pInfo->ObjectInfo.Image.pGetImageMemoryRequirementsPacket = trim::copy_packet(pHeader);")
@@ -1782,7 +2099,11 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             trim_instructions.append('        }')
         elif 'vkDestroyImage' == proto.name:
             trim_instructions.append("#if TRIM_USE_ORDERED_IMAGE_CREATION")
-            trim_instructions.append("        trim::add_Image_call(trim::copy_packet(pHeader));")
+            trim_instructions.append("        if (g_trimCompact) {")
+            trim_instructions.append("            trim::remove_Image_calls(image);")
+            trim_instructions.append("        } else {")
+            trim_instructions.append("            trim::add_Image_call(image, trim::copy_packet(pHeader));")
+            trim_instructions.append("        }")
             trim_instructions.append("#endif //TRIM_USE_ORDERED_IMAGE_CREATION")
             trim_instructions.append("        trim::remove_Image_object(image);")
             trim_instructions.append('        if (g_trimIsInTrim) {')
@@ -1924,6 +2245,15 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             trim_instructions.append('        } else {')
             trim_instructions.append('            vktrace_delete_trace_packet(&pHeader);')
             trim_instructions.append('        }')
+        elif 'vkResetCommandPool' == proto.name:
+            trim_instructions.append("        if (g_trimCompact) {")
+            trim_instructions.append("            trim::reset_CommandPool(commandPool);")
+            trim_instructions.append("        }")
+            trim_instructions.append('        if (g_trimIsInTrim) {')
+            trim_instructions.append('            trim::write_packet(pHeader);')
+            trim_instructions.append('        } else {')
+            trim_instructions.append('            vktrace_delete_trace_packet(&pHeader);')
+            trim_instructions.append('        }')
         elif 'vkResetDescriptorPool' == proto.name:
             trim_instructions.append("        trim::ObjectInfo* pPoolInfo = trim::get_DescriptorPool_objectInfo(descriptorPool);")
             trim_instructions.append("        pPoolInfo->ObjectInfo.DescriptorPool.numSets = 0;")
@@ -2149,9 +2479,10 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             trim_instructions.append('            vktrace_delete_trace_packet(&pHeader);')
             trim_instructions.append('        }')
         elif 'vkGetPhysicalDeviceMemoryProperties' == proto.name:
-            trim_instructions.append("        if (g_trimIsPreTrim) {")
+            trim_instructions.append("        if (g_trimIsPreTrim || g_trimWindows) {")
             trim_instructions.append("            trim::ObjectInfo* pInfo = trim::get_PhysicalDevice_objectInfo(physicalDevice);")
             trim_instructions.append("            if (pInfo != NULL) {")
+            trim_instructions.append("                vktrace_delete_trace_packet(&pInfo->ObjectInfo.PhysicalDevice.pGetPhysicalDeviceMemoryPropertiesPacket);")
             trim_instructions.append("                pInfo->ObjectInfo.PhysicalDevice.pGetPhysicalDeviceMemoryPropertiesPacket = trim::copy_packet(pHeader);")
             trim_instructions.append("            }")
             trim_instructions.append("        }")
@@ -2186,6 +2517,8 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         trace_vk_src += '#include "vktrace_common.h"\n'
         trace_vk_src += '#include "vktrace_lib_helpers.h"\n'
         trace_vk_src += '#include "vktrace_lib_trim.h"\n'
+        trace_vk_src += '#include "vktrace_lib_cmdblock.h"\n'
+        trace_vk_src += '#include "vktrace_lib_gputiming.h"\n'
         trace_vk_src += '#include "vktrace_vk_vk.h"\n'
         trace_vk_src += '#include "vktrace_interconnect.h"\n'
         trace_vk_src += '#include "vktrace_filelike.h"\n'
@@ -2194,6 +2527,8 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         trace_vk_src += '#include <pthread.h>\n'
         trace_vk_src += '#endif\n'
         trace_vk_src += '#include "vktrace_trace_packet_utils.h"\n'
+        trace_vk_src += '#include "vktrace_blob_store.h"\n'
+        trace_vk_src += '#include "vktrace_packet_arena.h"\n'
         trace_vk_src += '#include <stdio.h>\n'
         trace_vk_src += '#include <string.h>\n'
         trace_vk_src += '\n'
@@ -2203,7 +2538,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         trace_vk_src += 'pthread_once_t gInitOnce = PTHREAD_ONCE_INIT;\n'
         trace_vk_src += '#endif\n'
         trace_vk_src += '\n'
-        trace_vk_src += 'extern VKTRACE_CRITICAL_SECTION g_memInfoLock;\n'
+        trace_vk_src += 'extern VKTRACE_RW_LOCK g_memInfoLock;\n'
         trace_vk_src += '\n'
         trace_vk_src += '#ifdef WIN32\n'
         trace_vk_src += 'BOOL CALLBACK InitTracer(_Inout_ PINIT_ONCE initOnce, _Inout_opt_ PVOID param, _Out_opt_ PVOID *lpContext) {\n'
@@ -2225,7 +2560,8 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         trace_vk_src += '    vktrace_tracelog_set_tracer_id(VKTRACE_TID_VULKAN);\n'
         trace_vk_src += '    trim::initialize();\n'
         trace_vk_src += '    vktrace_initialize_trace_packet_utils();\n'
-        trace_vk_src += '    vktrace_create_critical_section(&g_memInfoLock);\n'
+        trace_vk_src += '    vktrace_packet_arena_initialize();\n'
+        trace_vk_src += '    vktrace_create_rw_lock(&g_memInfoLock);\n'
         trace_vk_src += '#ifdef WIN32\n'
         trace_vk_src += '    return true;\n}\n'
         trace_vk_src += '#elif defined(PLATFORM_LINUX)\n'
@@ -2243,73 +2579,13 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         # Assign packet values
         # FINISH packet
         # return result if needed
-       
-        manually_written_hooked_funcs = ['vkAllocateCommandBuffers',
-                                         'vkAllocateMemory',
-                                         'vkAllocateDescriptorSets',
-                                         'vkBeginCommandBuffer',
-                                         'vkCreateDescriptorPool',
-                                         'vkGetPhysicalDeviceProperties',
-                                         'vkCreateDevice',
-                                         'vkCreateFramebuffer',
-                                         'vkCreateImage',
-                                         'vkCreateBuffer',
-                                         'vkCreateInstance',
-                                         'vkCreatePipelineCache',
-                                         'vkCreateRenderPass',
-                                         'vkGetPipelineCacheData',
-                                         'vkCreateGraphicsPipelines',
-                                         'vkCreateComputePipelines',
-                                         'vkCmdPipelineBarrier',
-                                         'vkCmdWaitEvents',
-                                         'vkCmdBeginRenderPass',
-                                         'vkCmdPushConstants',
-                                         'vkDestroyInstance',
-                                         'vkEnumeratePhysicalDevices',
-                                         'vkFreeMemory',
-                                         'vkFreeDescriptorSets',
-                                         'vkQueueSubmit',
-                                         'vkQueueBindSparse',
-                                         'vkFlushMappedMemoryRanges',
-                                         'vkInvalidateMappedMemoryRanges',
-                                         'vkGetDeviceProcAddr',
-                                         'vkGetInstanceProcAddr',
-                                         'vkEnumerateInstanceExtensionProperties',
-                                         'vkEnumerateDeviceExtensionProperties',
-                                         'vkEnumerateInstanceLayerProperties',
-                                         'vkEnumerateDeviceLayerProperties',
-                                         'vkGetPhysicalDeviceQueueFamilyProperties',
-                                         'vkGetQueryPoolResults',
-                                         'vkMapMemory',
-                                         'vkUnmapMemory',
-                                         'vkUpdateDescriptorSets',
-                                         'vkGetPhysicalDeviceSurfaceCapabilitiesKHR',
-                                         'vkGetPhysicalDeviceSurfaceFormatsKHR',
-                                         'vkGetPhysicalDeviceSurfacePresentModesKHR',
-                                         'vkCreateSwapchainKHR',
-                                         'vkGetSwapchainImagesKHR',
-                                         'vkQueuePresentKHR',
-                                         #TODO add Mir
-                                         'vkCreateXcbSurfaceKHR',
-                                         'vkCreateWaylandSurfaceKHR',
-                                         'vkCreateXlibSurfaceKHR',
-                                         'vkGetPhysicalDeviceXcbPresentationSupportKHR',
-                                         'vkGetPhysicalDeviceWaylandPresentationSupportKHR',
-                                         'vkGetPhysicalDeviceXlibPresentationSupportKHR',
-                                         'vkCreateWin32SurfaceKHR',
-                                         'vkGetPhysicalDeviceWin32PresentationSupportKHR',
-                                         'vkCreateAndroidSurfaceKHR',
-                                         'vkCreateDescriptorUpdateTemplateKHR',
-                                         'vkDestroyDescriptorUpdateTemplateKHR',
-                                         'vkUpdateDescriptorSetWithTemplateKHR',
-                                         'vkCmdPushDescriptorSetWithTemplateKHR',
-                                         'vkAcquireXlibDisplayEXT',
-                                         'vkGetRandROutputDisplayEXT',
-                                         'vkCreateObjectTableNVX',
-                                         'vkCmdProcessCommandsNVX',
-                                         'vkCreateIndirectCommandsLayoutNVX',
-                                         # TODO: VK_EXT_display_control
-                                         ]
+
+        # GPU timing calls made before the packet is created, and after the successful real call, of generated functions
+        gpu_timing_before = {'vkDestroyDevice': 'vktrace_gpu_timing_destroy_device(device)',
+                             'vkDestroyCommandPool': 'vktrace_gpu_timing_destroy_command_pool(commandPool)',
+                             'vkFreeCommandBuffers': 'vktrace_gpu_timing_free_command_buffers(commandBufferCount, pCommandBuffers)',
+                             'vkEndCommandBuffer': 'vktrace_gpu_timing_end_command_buffer(commandBuffer)'}
+        gpu_timing_after = {'vkCreateCommandPool': 'vktrace_gpu_timing_add_command_pool(device, *pCommandPool, pCreateInfo->queueFamilyIndex)'}
 
         # Validate the manually_written_hooked_funcs list
         protoFuncs = [proto.name for proto in self.cmdMembers]
@@ -2364,6 +2640,9 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                 # Get list of packet size modifiers due to ptr params
                 packet_size = self.GetPacketSize(proto.members)
                 ptr_packet_update_list = self.GetPacketPtrParamList(proto.members)
+                buffer_slots = self.GetPacketBufferSlots(proto.members)
+                if buffer_slots is not None:
+                    packet_size = ['ROUNDUP_TO_4(%s)' % size for (p, size) in buffer_slots]
                 # End of function declaration portion, begin function body
                 trace_vk_src += '{\n'
                 if 'void' not in resulttype or '*' in resulttype:
@@ -2375,8 +2654,18 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                 trace_vk_src += '    packet_%s* pPacket = NULL;\n' % proto.name
                 if proto.name == 'vkDestroyInstance' or proto.name == 'vkDestroyDevice':
                     trace_vk_src += '    dispatch_key key = get_dispatch_key(%s);\n' % proto.members[0].name
+                cmd_block_fields = self.GetCmdBlockFields(proto.name, proto.members)
+                if cmd_block_fields is not None:
+                    trace_vk_src += self.GenerateTraceCmdBlockPath(proto, cmd_block_fields)
+                if proto.name in gpu_timing_before:
+                    trace_vk_src += '    if (g_gpuTimingEnabled) {\n'
+                    trace_vk_src += '        %s;\n' % gpu_timing_before[proto.name]
+                    trace_vk_src += '    }\n'
                 if (0 == len(packet_size)):
                     trace_vk_src += '    CREATE_TRACE_PACKET(%s, 0);\n' % (proto.name)
+                elif buffer_slots is not None and all(re.match(r'^sizeof\([\w ]+\)$', size) for (p, size) in buffer_slots):
+                    trace_vk_src += '    constexpr uint64_t buffersSize = %s;\n' % ' + '.join(packet_size)
+                    trace_vk_src += '    CREATE_TRACE_PACKET(%s, buffersSize);\n' % (proto.name)
                 else:
                     trace_vk_src += '    CREATE_TRACE_PACKET(%s, %s);\n' % (proto.name, ' + '.join(packet_size))
                 if proto.name == 'vkCreateImage':
@@ -2410,6 +2699,10 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                 c_call = proto.name[2:] + '(' + paramstext + ')'
                 trace_vk_src += '    %s%s.%s;\n' % (return_txt, table_txt, c_call)
                 trace_vk_src += '    vktrace_set_packet_entrypoint_end_time(pHeader);\n'
+                if proto.name in gpu_timing_after:
+                    trace_vk_src += '    if (g_gpuTimingEnabled && result == VK_SUCCESS) {\n'
+                    trace_vk_src += '        %s;\n' % gpu_timing_after[proto.name]
+                    trace_vk_src += '    }\n'
                 if proto.name == 'vkCreateImage':
                     trace_vk_src += '    if (g_trimEnabled) {\n'
                     trace_vk_src += '        // need to add TRANSFER_DST usage to the image so that we can recreate it.\n'
@@ -2427,12 +2720,16 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                 trace_vk_src += '    pPacket = interpret_body_as_%s(pHeader);\n' % proto.name
                 trace_vk_src += '\n'.join(raw_packet_update_list)
                 trace_vk_src += '\n'
-                for pp_dict in ptr_packet_update_list: # buff_ptr_indices:
-                    trace_vk_src += '    %s;\n' % (pp_dict['add_txt'])
+                if buffer_slots is not None:
+                    for (p, size) in buffer_slots:
+                        trace_vk_src += '    vktrace_write_buffer_to_trace_packet(pHeader, (void**)&(pPacket->%s), %s, %s);\n' % (p.name, size, p.name)
+                else:
+                    for pp_dict in ptr_packet_update_list: # buff_ptr_indices:
+                        trace_vk_src += '    %s;\n' % (pp_dict['add_txt'])
                 if 'void' not in resulttype or '*' in resulttype:
                     trace_vk_src += '    pPacket->result = result;\n'
                 for pp_dict in ptr_packet_update_list:
-                    if ('DeviceCreateInfo' not in proto.members[pp_dict['index']].type):
+                    if buffer_slots is None and ('DeviceCreateInfo' not in proto.members[pp_dict['index']].type):
                         trace_vk_src += '    %s;\n' % (pp_dict['finalize_txt'])
                 trace_vk_src += '    if (!g_trimEnabled) {\n'
                 # All buffers should be finalized by now, and the trace packet can be finished (which sends it over the socket)
@@ -2470,6 +2767,26 @@ class VkTraceFileOutputGenerator(OutputGenerator):
 
         return trace_vk_src
     #
+    # Generate the part of a vkCmd* trace hook that adds the call to the thread's command block
+    def GenerateTraceCmdBlockPath(self, proto, fields):
+        params = [p.name for p in proto.members if p.name != '']
+        conditions = ['g_cmdBlocksEnabled'] + ['%s != NULL' % p.name for (p, size, kind) in fields if kind == 'single']
+        max_size = ' + '.join(['VKTRACE_CMD_BLOCK_FIELD_SIZE(%s)' % size for (p, size, kind) in fields]) or '0'
+        src  = '    if (%s) {\n' % ' && '.join(conditions)
+        src += '        vktrace_cmd_block_writer* pWriter = vktrace_cmd_block_begin(%s, VKTRACE_TPI_VK_%s, %s);\n' % (params[0], proto.name, max_size)
+        src += '        if (pWriter != NULL) {\n'
+        src += '            mdd(%s)->devTable.%s(%s);\n' % (params[0], proto.name[2:], ', '.join(params))
+        for (p, size, kind) in fields:
+            if kind == 'value':
+                src += '            vktrace_cmd_block_put(pWriter, &%s, %s);\n' % (p.name, size)
+            else:
+                src += '            vktrace_cmd_block_put(pWriter, %s, %s);\n' % (p.name, size)
+        src += '            vktrace_cmd_block_end(pWriter);\n'
+        src += '            return;\n'
+        src += '        }\n'
+        src += '    }\n'
+        return src
+    #
     # Construct vktrace packets header file
     def GenerateTraceVkPacketsHeader(self):
         trace_pkt_hdr  = ''
@@ -34,6 +34,11 @@ if ($lastexitcode -ne 0) {
    exit 1
 }
 
+& $dPath\vk_layer_performance_tests
+if ($lastexitcode -ne 0) {
+   exit 1
+}
+
 & .\vkvalidatelayerdoc.ps1 terse_mode
 
 exit $lastexitcode
@@ -47,6 +47,41 @@ RES=$?
 rm ${FILENAME_01_RESULT}
 rm ${FILENAME_01_STDOUT}
 
+#############################################################################
+# Test #2 same datafile precompiled into a binary profile, same gold.
+
+DEVSIM_COMPILE="../layersvt/devsim_compile"
+FILENAME_02_IN="device_simulation_layer_test_2.bin"
+FILENAME_02_RESULT="device_simulation_layer_test_1.json"
+FILENAME_02_STDOUT="device_simulation_layer_test_2.txt"
+
+${DEVSIM_COMPILE} ${FILENAME_01_IN} ${FILENAME_02_IN}
+export VK_DEVSIM_FILENAME="${FILENAME_02_IN}"
+${VKJSON_INFO} > ${FILENAME_02_STDOUT}
+
+diff ${FILENAME_01_GOLD} <(head -n ${NUM_LINES} ${FILENAME_02_RESULT}) >> ${FILENAME_02_STDOUT}
+RES=$(( RES | $? ))
+rm ${FILENAME_02_IN}
+rm ${FILENAME_02_RESULT}
+rm ${FILENAME_02_STDOUT}
+
+#############################################################################
+# Test #3 profile library with the same datafile twice; the second simulated device must match the gold too.
+
+FILENAME_03_IN="device_simulation_layer_test_3.bin"
+FILENAME_03_RESULT="device_simulation_layer_test_1.json"
+FILENAME_03_STDOUT="device_simulation_layer_test_3.txt"
+
+${DEVSIM_COMPILE} ${FILENAME_01_IN} ${FILENAME_01_IN} ${FILENAME_03_IN}
+export VK_DEVSIM_FILENAME="${FILENAME_03_IN}"
+${VKJSON_INFO} --device-index 1 > ${FILENAME_03_STDOUT}
+
+diff ${FILENAME_01_GOLD} <(head -n ${NUM_LINES} ${FILENAME_03_RESULT}) >> ${FILENAME_03_STDOUT}
+RES=$(( RES | $? ))
+rm ${FILENAME_03_IN}
+rm ${FILENAME_03_RESULT}
+rm ${FILENAME_03_STDOUT}
+
 #############################################################################
 
 if [ "$RES" -eq 0 ] ; then
@@ -0,0 +1,448 @@
+/*
+ * Copyright (c) 2017 The Khronos Group Inc.
+ * Copyright (c) 2017 Valve Corporation
+ * Copyright (c) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Microbenchmarks of the entry points whose cost matters most to applications,
+// run once without layers and once for each validation layer configuration.
+// Each benchmark reports the time per call in nanoseconds:
+//
+//     [ PERF     ] core_validation CmdDraw 215.3 ns/call
+//
+// The results are also recorded as gtest properties, so they show up in the
+// --gtest_output=xml report.  The following environment variables control the
+// run:
+//
+//     VK_PERF_ITERATIONS  calls per measurement (default 10000)
+//     VK_PERF_RESULTS     append the results to this file, one
+//                         "<configuration> <benchmark> <ns/call>" per line
+//     VK_PERF_BASELINE    a file in the VK_PERF_RESULTS format; a benchmark
+//                         fails if it is slower than its baseline by more
+//                         than VK_PERF_TOLERANCE percent (default 25)
+
+#ifdef ANDROID
+#include "vulkan_wrapper.h"
+#else
+#include <vulkan/vulkan.h>
+#endif
+
+#include "test_common.h"
+#include "vkrenderframework.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+
+// Number of descriptor sets bound for the draw benchmark.
+static const uint32_t kDrawDescriptorSetCount = 4;
+
+// Number of command buffers in each submit of the submit benchmark.
+static const uint32_t kSubmitCommandBufferCount = 8;
+
+// Each benchmark is measured this many times, and the fastest run is reported.
+static const uint32_t kMeasureRuns = 3;
+
+struct LayerConfig {
+    const char *name;
+    std::vector<const char *> layers;
+};
+
+// Let gtest print the configuration name in test names and failures.
+void PrintTo(const LayerConfig &config, std::ostream *os) { *os << config.name; }
+
+static std::vector<LayerConfig> LayerConfigs() {
+    std::vector<LayerConfig> configs;
+    configs.push_back({"none", {}});
+    configs.push_back({"threading", {"VK_LAYER_GOOGLE_threading"}});
+    configs.push_back({"parameter_validation", {"VK_LAYER_LUNARG_parameter_validation"}});
+    configs.push_back({"object_tracker", {"VK_LAYER_LUNARG_object_tracker"}});
+    configs.push_back({"core_validation", {"VK_LAYER_LUNARG_core_validation"}});
+    configs.push_back({"unique_objects", {"VK_LAYER_GOOGLE_unique_objects"}});
+    // Same order as the layer validation tests.
+    configs.push_back({"all",
+                       {"VK_LAYER_GOOGLE_threading", "VK_LAYER_LUNARG_parameter_validation", "VK_LAYER_LUNARG_object_tracker",
+                        "VK_LAYER_LUNARG_core_validation", "VK_LAYER_GOOGLE_unique_objects"}});
+    return configs;
+}
+
+static uint32_t EnvUint(const char *name, uint32_t default_value) {
+    const char *value = getenv(name);
+    if (value == nullptr || atoi(value) <= 0) {
+        return default_value;
+    }
+    return static_cast<uint32_t>(atoi(value));
+}
+
+// The benchmarks must not trigger validation errors or warnings: the layers
+// take a much slower path when they report something.
+static VKAPI_ATTR VkBool32 VKAPI_CALL CountMessages(VkFlags msgFlags, VkDebugReportObjectTypeEXT objType, uint64_t srcObject,
+                                                   size_t location, int32_t msgCode, const char *pLayerPrefix, const char *pMsg,
+                                                   void *pUserData) {
+    if (msgFlags & (VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT)) {
+        printf("             %s: %s\n", pLayerPrefix, pMsg);
+        (*static_cast<uint32_t *>(pUserData))++;
+    }
+    return VK_FALSE;
+}
+
+class VkLayerPerfTest : public VkRenderFramework, public ::testing::WithParamInterface<LayerConfig> {
+   protected:
+    uint32_t m_messageCount;
+    uint32_t m_iterations;
+
+    virtual void SetUp() {
+        m_instance_layer_names.clear();
+        m_instance_extension_names.clear();
+        m_device_extension_names.clear();
+        m_instance_extension_names.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+
+        this->app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+        this->app_info.pNext = NULL;
+        this->app_info.pApplicationName = "layer_performance_tests";
+        this->app_info.applicationVersion = 1;
+        this->app_info.pEngineName = "unittest";
+        this->app_info.engineVersion = 1;
+        this->app_info.apiVersion = VK_API_VERSION_1_0;
+
+        m_messageCount = 0;
+        m_iterations = EnvUint("VK_PERF_ITERATIONS", 10000);
+    }
+
+    virtual void TearDown() {
+        ShutdownFramework();
+        EXPECT_EQ(0u, m_messageCount) << "The benchmark triggered validation messages";
+    }
+
+    // Create the instance with the layers of this configuration, the device and
+    // a render target.  Returns false if a layer is not installed.
+    bool Init() {
+        for (auto layer : GetParam().layers) {
+            if (!InstanceLayerSupported(layer)) {
+                printf("             %s not found; skipped.\n", layer);
+                return false;
+            }
+            m_instance_layer_names.push_back(layer);
+        }
+        InitFramework(CountMessages, &m_messageCount);
+        InitState();
+        InitViewport();
+        InitRenderTarget();
+        return !::testing::Test::HasFatalFailure();
+    }
+
+    // Time m_iterations calls of body, after one untimed warm-up call.  Returns
+    // the fastest of kMeasureRuns runs, in nanoseconds per call.  after_run is
+    // called after each run, outside of the measurement.
+    template <typename Body>
+    double Measure(Body body, std::function<void()> after_run = nullptr) {
+        double best = 0.0;
+        body(0);
+        for (uint32_t run = 0; run < kMeasureRuns; run++) {
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < m_iterations; i++) {
+                body(i);
+            }
+            std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            if (after_run) {
+                after_run();
+            }
+            double ns_per_call = elapsed.count() / m_iterations;
+            if (run == 0 || ns_per_call < best) {
+                best = ns_per_call;
+            }
+        }
+        return best;
+    }
+
+    void Report(const char *benchmark, double ns_per_call);
+};
+
+void VkLayerPerfTest::Report(const char *benchmark, double ns_per_call) {
+    const char *config = GetParam().name;
+    printf("[ PERF     ] %s %s %.1f ns/call\n", config, benchmark, ns_per_call);
+    RecordProperty(benchmark, static_cast<int>(ns_per_call + 0.5));
+
+    const char *results_file = getenv("VK_PERF_RESULTS");
+    if (results_file) {
+        std::ofstream results(results_file, std::ios::app);
+        results << config << " " << benchmark << " " << ns_per_call << std::endl;
+    }
+
+    const char *baseline_file = getenv("VK_PERF_BASELINE");
+    if (baseline_file) {
+        std::ifstream baseline(baseline_file);
+        std::string line;
+        while (std::getline(baseline, line)) {
+            std::istringstream fields(line);
+            std::string baseline_config, baseline_benchmark;
+            double baseline_ns = 0.0;
+            if (!(fields >> baseline_config >> baseline_benchmark >> baseline_ns)) continue;
+            if (baseline_config != config || baseline_benchmark != benchmark) continue;
+
+            double tolerance = EnvUint("VK_PERF_TOLERANCE", 25) / 100.0;
+            EXPECT_LE(ns_per_call, baseline_ns * (1.0 + tolerance))
+                << benchmark << " with " << config << " regressed from " << baseline_ns << " ns/call";
+        }
+    }
+}
+
+// Create a pipeline layout with one uniform buffer in each of set_count sets,
+// and allocate those sets from a new pool.
+static void CreateDescriptorSets(VkDevice device, uint32_t set_count, VkDescriptorSetLayout *set_layout, VkDescriptorPool *pool,
+                                 std::vector<VkDescriptorSet> *sets, VkPipelineLayout *pipeline_layout) {
+    VkDescriptorSetLayoutBinding binding = {};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutCreateInfo set_layout_ci = {};
+    set_layout_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    set_layout_ci.bindingCount = 1;
+    set_layout_ci.pBindings = &binding;
+    ASSERT_VK_SUCCESS(vkCreateDescriptorSetLayout(device, &set_layout_ci, NULL, set_layout));
+
+    VkDescriptorPoolSize pool_size = {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, set_count};
+    VkDescriptorPoolCreateInfo pool_ci = {};
+    pool_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_ci.maxSets = set_count;
+    pool_ci.poolSizeCount = 1;
+    pool_ci.pPoolSizes = &pool_size;
+    ASSERT_VK_SUCCESS(vkCreateDescriptorPool(device, &pool_ci, NULL, pool));
+
+    std::vector<VkDescriptorSetLayout> set_layouts(set_count, *set_layout);
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = *pool;
+    alloc_info.descriptorSetCount = set_count;
+    alloc_info.pSetLayouts = set_layouts.data();
+    sets->resize(set_count);
+    ASSERT_VK_SUCCESS(vkAllocateDescriptorSets(device, &alloc_info, sets->data()));
+
+    VkPipelineLayoutCreateInfo pipeline_layout_ci = {};
+    pipeline_layout_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_ci.setLayoutCount = set_count;
+    pipeline_layout_ci.pSetLayouts = set_layouts.data();
+    ASSERT_VK_SUCCESS(vkCreatePipelineLayout(device, &pipeline_layout_ci, NULL, pipeline_layout));
+}
+
+static void WriteUniformBuffer(VkDevice device, VkDescriptorSet set, VkBuffer buffer) {
+    VkDescriptorBufferInfo buffer_info = {buffer, 0, VK_WHOLE_SIZE};
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = set;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    write.pBufferInfo = &buffer_info;
+    vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+}
+
+static const char kVertShaderText[] =
+    "#version 450\n"
+    "layout(set=0, binding=0) uniform Transform { mat4 mvp; } transform;\n"
+    "void main() {\n"
+    "   vec2 pos = vec2((gl_VertexIndex & 1) * 2 - 1, (gl_VertexIndex >> 1) * 2 - 1);\n"
+    "   gl_Position = transform.mvp * vec4(pos, 0.0, 1.0);\n"
+    "}\n";
+
+static const char kFragShaderText[] =
+    "#version 450\n"
+    "layout(location=0) out vec4 color;\n"
+    "void main() {\n"
+    "   color = vec4(0.0, 1.0, 0.0, 1.0);\n"
+    "}\n";
+
+// vkCmdDraw with kDrawDescriptorSetCount descriptor sets bound.  Validation
+// checks the bound sets against the pipeline on every draw.
+TEST_P(VkLayerPerfTest, CmdDraw) {
+    if (!Init()) return;
+
+    VkConstantBufferObj uniform_buffer(m_device, 64, nullptr, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorPool pool;
+    std::vector<VkDescriptorSet> sets;
+    VkPipelineLayout pipeline_layout;
+    ASSERT_NO_FATAL_FAILURE(
+        CreateDescriptorSets(device(), kDrawDescriptorSetCount, &set_layout, &pool, &sets, &pipeline_layout));
+    for (auto set : sets) {
+        WriteUniformBuffer(device(), set, uniform_buffer.handle());
+    }
+
+    VkShaderObj vs(m_device, kVertShaderText, VK_SHADER_STAGE_VERTEX_BIT, this);
+    VkShaderObj fs(m_device, kFragShaderText, VK_SHADER_STAGE_FRAGMENT_BIT, this);
+    VkPipelineObj pipe(m_device);
+    pipe.AddShader(&vs);
+    pipe.AddShader(&fs);
+    pipe.AddColorAttachment();
+    ASSERT_VK_SUCCESS(pipe.CreateVKPipeline(pipeline_layout, renderPass()));
+
+    m_commandBuffer->begin();
+    m_commandBuffer->BeginRenderPass(m_renderPassBeginInfo);
+    vkCmdBindPipeline(m_commandBuffer->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipe.handle());
+    vkCmdBindDescriptorSets(m_commandBuffer->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, kDrawDescriptorSetCount,
+                            sets.data(), 0, NULL);
+    vkCmdSetViewport(m_commandBuffer->handle(), 0, 1, m_viewports.data());
+    vkCmdSetScissor(m_commandBuffer->handle(), 0, 1, m_scissors.data());
+
+    VkCommandBuffer command_buffer = m_commandBuffer->handle();
+    Report("CmdDraw", Measure([command_buffer](uint32_t) { vkCmdDraw(command_buffer, 4, 1, 0, 0); }));
+
+    m_commandBuffer->EndRenderPass();
+    m_commandBuffer->end();
+
+    vkDestroyPipelineLayout(device(), pipeline_layout, NULL);
+    vkDestroyDescriptorPool(device(), pool, NULL);
+    vkDestroyDescriptorSetLayout(device(), set_layout, NULL);
+}
+
+// vkQueueSubmit of kSubmitCommandBufferCount command buffers.  The queue is
+// drained between runs, outside of the measurement, so runs are limited to
+// 1000 submits.
+TEST_P(VkLayerPerfTest, QueueSubmit) {
+    if (!Init()) return;
+
+    std::vector<VkCommandBuffer> command_buffers(kSubmitCommandBufferCount);
+    VkCommandBufferAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.commandPool = m_commandPool->handle();
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = kSubmitCommandBufferCount;
+    ASSERT_VK_SUCCESS(vkAllocateCommandBuffers(device(), &alloc_info, command_buffers.data()));
+
+    // Simultaneous use, so the same command buffers can be pending several
+    // times without waiting in the measured loop.
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+    for (auto command_buffer : command_buffers) {
+        vkBeginCommandBuffer(command_buffer, &begin_info);
+        vkEndCommandBuffer(command_buffer);
+    }
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = kSubmitCommandBufferCount;
+    submit_info.pCommandBuffers = command_buffers.data();
+
+    m_iterations = std::min(m_iterations, 1000u);
+    VkQueue queue = m_device->m_queue;
+    Report("QueueSubmit", Measure([queue, &submit_info](uint32_t) { vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE); },
+                                  [queue]() { vkQueueWaitIdle(queue); }));
+
+    vkFreeCommandBuffers(device(), m_commandPool->handle(), kSubmitCommandBufferCount, command_buffers.data());
+}
+
+// vkUpdateDescriptorSets writing one uniform buffer descriptor.
+TEST_P(VkLayerPerfTest, UpdateDescriptorSets) {
+    if (!Init()) return;
+
+    VkConstantBufferObj uniform_buffer(m_device, 64, nullptr, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorPool pool;
+    std::vector<VkDescriptorSet> sets;
+    VkPipelineLayout pipeline_layout;
+    ASSERT_NO_FATAL_FAILURE(CreateDescriptorSets(device(), 1, &set_layout, &pool, &sets, &pipeline_layout));
+
+    VkDevice dev = device();
+    VkDescriptorSet set = sets[0];
+    VkBuffer buffer = uniform_buffer.handle();
+    Report("UpdateDescriptorSets", Measure([dev, set, buffer](uint32_t) { WriteUniformBuffer(dev, set, buffer); }));
+
+    vkDestroyPipelineLayout(device(), pipeline_layout, NULL);
+    vkDestroyDescriptorPool(device(), pool, NULL);
+    vkDestroyDescriptorSetLayout(device(), set_layout, NULL);
+}
+
+// vkCreateGraphicsPipelines followed by vkDestroyPipeline.  Pipelines are
+// expensive, so this runs a hundredth of the iterations of the other tests.
+TEST_P(VkLayerPerfTest, CreateGraphicsPipelines) {
+    if (!Init()) return;
+
+    VkConstantBufferObj uniform_buffer(m_device, 64, nullptr, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorPool pool;
+    std::vector<VkDescriptorSet> sets;
+    VkPipelineLayout pipeline_layout;
+    ASSERT_NO_FATAL_FAILURE(CreateDescriptorSets(device(), 1, &set_layout, &pool, &sets, &pipeline_layout));
+
+    VkShaderObj vs(m_device, kVertShaderText, VK_SHADER_STAGE_VERTEX_BIT, this);
+    VkShaderObj fs(m_device, kFragShaderText, VK_SHADER_STAGE_FRAGMENT_BIT, this);
+    VkPipelineObj pipe(m_device);
+    pipe.AddShader(&vs);
+    pipe.AddShader(&fs);
+    pipe.AddColorAttachment();
+
+    VkGraphicsPipelineCreateInfo pipeline_ci = {};
+    pipe.InitGraphicsPipelineCreateInfo(&pipeline_ci);
+    pipeline_ci.layout = pipeline_layout;
+    pipeline_ci.renderPass = renderPass();
+
+    m_iterations = std::max(m_iterations / 100, 10u);
+    VkDevice dev = device();
+    Report("CreateGraphicsPipelines", Measure([dev, &pipeline_ci](uint32_t) {
+               VkPipeline pipeline;
+               if (vkCreateGraphicsPipelines(dev, VK_NULL_HANDLE, 1, &pipeline_ci, NULL, &pipeline) == VK_SUCCESS) {
+                   vkDestroyPipeline(dev, pipeline, NULL);
+               }
+           }));
+
+    vkDestroyPipelineLayout(device(), pipeline_layout, NULL);
+    vkDestroyDescriptorPool(device(), pool, NULL);
+    vkDestroyDescriptorSetLayout(device(), set_layout, NULL);
+}
+
+// vkMapMemory, a small write, vkFlushMappedMemoryRanges and vkUnmapMemory.
+TEST_P(VkLayerPerfTest, MapFlushUnmap) {
+    if (!Init()) return;
+
+    VkMemoryAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.allocationSize = 4096;
+    ASSERT_TRUE(m_device->phy().set_memory_type(0xffffffff, &alloc_info, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT));
+    VkDeviceMemory memory;
+    ASSERT_VK_SUCCESS(vkAllocateMemory(device(), &alloc_info, NULL, &memory));
+
+    VkDevice dev = device();
+    Report("MapFlushUnmap", Measure([dev, memory](uint32_t i) {
+               void *data;
+               if (vkMapMemory(dev, memory, 0, VK_WHOLE_SIZE, 0, &data) == VK_SUCCESS) {
+                   *static_cast<uint32_t *>(data) = i;
+                   VkMappedMemoryRange range = {VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, NULL, memory, 0, VK_WHOLE_SIZE};
+                   vkFlushMappedMemoryRanges(dev, 1, &range);
+                   vkUnmapMemory(dev, memory);
+               }
+           }));
+
+    vkFreeMemory(device(), memory, NULL);
+}
+
+INSTANTIATE_TEST_CASE_P(Layers, VkLayerPerfTest, ::testing::ValuesIn(LayerConfigs()));
+
+int main(int argc, char **argv) {
+    int result;
+
+    ::testing::InitGoogleTest(&argc, argv);
+    VkTestFramework::InitArgs(&argc, argv);
+
+    result = RUN_ALL_TESTS();
+
+    VkTestFramework::Finish();
+    return result;
+}
@@ -644,6 +644,8 @@ void VkLayerTest::GenericDrawPreparation(VkCommandBufferObj *commandBuffer, VkPi
 class VkPositiveLayerTest : public VkLayerTest {
    public:
    protected:
+    // Positive tests expect no errors and clean up after themselves, so they can run on a shared device
+    VkPositiveLayerTest() { m_shareDevice = true; }
 };
 
 class VkWsiEnabledLayerTest : public VkLayerTest {
@@ -5530,6 +5532,90 @@ TEST_F(VkLayerTest, InvalidCmdBufferBufferDestroyed) {
     vkFreeMemory(m_device->handle(), mem, NULL);
 }
 
+TEST_F(VkLayerTest, InvalidCmdBufferSparseMemoryFreed) {
+    TEST_DESCRIPTION(
+        "Bind two memory objects to the two halves of a sparse buffer, record a command using the buffer, free the "
+        "memory bound to the second half, then attempt to submit the command buffer.");
+
+    ASSERT_NO_FATAL_FAILURE(Init());
+
+    auto index = m_device->graphics_queue_node_index_;
+    if (!m_device->phy().features().sparseBinding || !(m_device->queue_props[index].queueFlags & VK_QUEUE_SPARSE_BINDING_BIT)) {
+        printf("             Device does not support sparse binding; skipped.\n");
+        return;
+    }
+
+    VkBuffer buffer;
+    VkBufferCreateInfo buf_info = {};
+    buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buf_info.flags = VK_BUFFER_CREATE_SPARSE_BINDING_BIT;
+    buf_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buf_info.size = 0x10000;
+    buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkResult err = vkCreateBuffer(m_device->device(), &buf_info, NULL, &buffer);
+    ASSERT_VK_SUCCESS(err);
+
+    VkMemoryRequirements mem_reqs;
+    vkGetBufferMemoryRequirements(m_device->device(), buffer, &mem_reqs);
+    // Grow the buffer until it holds at least two blocks of the sparse alignment
+    while (mem_reqs.size < (mem_reqs.alignment * 2)) {
+        vkDestroyBuffer(m_device->device(), buffer, NULL);
+        buf_info.size *= 2;
+        err = vkCreateBuffer(m_device->device(), &buf_info, NULL, &buffer);
+        ASSERT_VK_SUCCESS(err);
+        vkGetBufferMemoryRequirements(m_device->device(), buffer, &mem_reqs);
+    }
+
+    VkMemoryAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.allocationSize = mem_reqs.size / 2;
+    bool pass = m_device->phy().set_memory_type(mem_reqs.memoryTypeBits, &alloc_info, 0);
+    ASSERT_TRUE(pass);
+    VkDeviceMemory memory_one, memory_two;
+    err = vkAllocateMemory(m_device->device(), &alloc_info, NULL, &memory_one);
+    ASSERT_VK_SUCCESS(err);
+    err = vkAllocateMemory(m_device->device(), &alloc_info, NULL, &memory_two);
+    ASSERT_VK_SUCCESS(err);
+
+    // Bind each half in its own buffer bind info of one VkBindSparseInfo
+    VkSparseMemoryBind binds[2] = {};
+    binds[0].memory = memory_one;
+    binds[0].resourceOffset = 0;
+    binds[0].size = alloc_info.allocationSize;
+    binds[1].memory = memory_two;
+    binds[1].resourceOffset = alloc_info.allocationSize;
+    binds[1].size = alloc_info.allocationSize;
+    VkSparseBufferMemoryBindInfo buffer_binds[2];
+    buffer_binds[0] = {buffer, 1, &binds[0]};
+    buffer_binds[1] = {buffer, 1, &binds[1]};
+
+    VkBindSparseInfo bind_sparse_info = {};
+    bind_sparse_info.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
+    bind_sparse_info.bufferBindCount = 2;
+    bind_sparse_info.pBufferBinds = buffer_binds;
+    vkQueueBindSparse(m_device->m_queue, 1, &bind_sparse_info, VK_NULL_HANDLE);
+    vkQueueWaitIdle(m_device->m_queue);
+
+    m_commandBuffer->begin();
+    vkCmdFillBuffer(m_commandBuffer->handle(), buffer, 0, VK_WHOLE_SIZE, 0);
+    m_commandBuffer->end();
+
+    // The memory of the second bind info is still bound, so freeing it invalidates the command buffer
+    vkFreeMemory(m_device->device(), memory_two, NULL);
+
+    m_errorMonitor->SetDesiredFailureMsg(VK_DEBUG_REPORT_ERROR_BIT_EXT, " that is invalid because bound DeviceMemory ");
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &m_commandBuffer->handle();
+    vkQueueSubmit(m_device->m_queue, 1, &submit_info, VK_NULL_HANDLE);
+    m_errorMonitor->VerifyFound();
+
+    vkQueueWaitIdle(m_device->m_queue);
+    vkDestroyBuffer(m_device->device(), buffer, NULL);
+    vkFreeMemory(m_device->device(), memory_one, NULL);
+}
+
 TEST_F(VkLayerTest, InvalidCmdBufferBufferViewDestroyed) {
     TEST_DESCRIPTION("Delete bufferView bound to cmd buffer, then attempt to submit cmd buffer.");
 
@@ -18358,6 +18444,96 @@ TEST_F(VkLayerTest, ImageBufferCopyTests) {
     }
 }
 
+TEST_F(VkPositiveLayerTest, CopyImageToBufferMipChain) {
+    TEST_DESCRIPTION("Copy every mip level of an image to a buffer in one vkCmdCopyImageToBuffer call, all regions in bounds");
+
+    ASSERT_NO_FATAL_FAILURE(Init());
+
+    // Bail if any dimension of transfer granularity is 0.
+    auto index = m_device->graphics_queue_node_index_;
+    auto queue_family_properties = m_device->phy().queue_properties();
+    if ((queue_family_properties[index].minImageTransferGranularity.depth == 0) ||
+        (queue_family_properties[index].minImageTransferGranularity.width == 0) ||
+        (queue_family_properties[index].minImageTransferGranularity.height == 0)) {
+        printf("             Subresource copies are disallowed when xfer granularity (x|y|z) is 0. Skipped.\n");
+        return;
+    }
+
+    const uint32_t mip_levels = 7;  // 64x64 down to 1x1
+    VkImageObj image(m_device);
+    image.Init(64, 64, mip_levels, VK_FORMAT_R8G8B8A8_UINT, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+               VK_IMAGE_TILING_OPTIMAL, 0);
+    ASSERT_TRUE(image.initialized());
+
+    vk_testing::Buffer buffer;
+    VkMemoryPropertyFlags reqs = 0;
+    buffer.init_as_src_and_dst(*m_device, 32768, reqs);
+
+    VkBufferImageCopy regions[mip_levels] = {};
+    VkDeviceSize offset = 0;
+    for (uint32_t i = 0; i < mip_levels; i++) {
+        uint32_t size = 64 >> i;
+        regions[i].bufferOffset = offset;
+        regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        regions[i].imageSubresource.mipLevel = i;
+        regions[i].imageSubresource.layerCount = 1;
+        regions[i].imageExtent = {size, size, 1};
+        offset += size * size * 4;
+    }
+
+    m_commandBuffer->begin();
+    m_errorMonitor->ExpectSuccess();
+    vkCmdCopyImageToBuffer(m_commandBuffer->handle(), image.handle(), VK_IMAGE_LAYOUT_GENERAL, buffer.handle(), mip_levels,
+                           regions);
+    vkCmdCopyBufferToImage(m_commandBuffer->handle(), buffer.handle(), image.handle(), VK_IMAGE_LAYOUT_GENERAL, mip_levels,
+                           regions);
+    m_errorMonitor->VerifyNotFound();
+    m_commandBuffer->end();
+}
+
+TEST_F(VkLayerTest, CopyImageToBufferExceedsImageBounds) {
+    TEST_DESCRIPTION("Copy a region that is out of bounds of its mip level to a buffer, among regions that are in bounds");
+
+    ASSERT_NO_FATAL_FAILURE(Init());
+
+    // Bail if any dimension of transfer granularity is 0.
+    auto index = m_device->graphics_queue_node_index_;
+    auto queue_family_properties = m_device->phy().queue_properties();
+    if ((queue_family_properties[index].minImageTransferGranularity.depth == 0) ||
+        (queue_family_properties[index].minImageTransferGranularity.width == 0) ||
+        (queue_family_properties[index].minImageTransferGranularity.height == 0)) {
+        printf("             Subresource copies are disallowed when xfer granularity (x|y|z) is 0. Skipped.\n");
+        return;
+    }
+
+    VkImageObj image(m_device);
+    image.Init(64, 64, 2, VK_FORMAT_R8G8B8A8_UINT, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+               VK_IMAGE_TILING_OPTIMAL, 0);
+    ASSERT_TRUE(image.initialized());
+
+    vk_testing::Buffer buffer;
+    VkMemoryPropertyFlags reqs = 0;
+    buffer.init_as_src_and_dst(*m_device, 32768, reqs);
+
+    VkBufferImageCopy regions[2] = {};
+    regions[0].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    regions[0].imageSubresource.layerCount = 1;
+    regions[0].imageExtent = {64, 64, 1};
+    // Mip level 1 is 32x32, so a height of 33 is out of bounds
+    regions[1] = regions[0];
+    regions[1].bufferOffset = 16384;
+    regions[1].imageSubresource.mipLevel = 1;
+    regions[1].imageExtent = {32, 33, 1};
+
+    m_commandBuffer->begin();
+    // The error names the command it came from, not vkCmdCopyBufferToImage()
+    m_errorMonitor->SetDesiredFailureMsg(VK_DEBUG_REPORT_ERROR_BIT_EXT, VALIDATION_ERROR_1920016c);
+    m_errorMonitor->SetDesiredFailureMsg(VK_DEBUG_REPORT_ERROR_BIT_EXT, "vkCmdCopyImageToBuffer(): pRegion[1] exceeds image bounds");
+    vkCmdCopyImageToBuffer(m_commandBuffer->handle(), image.handle(), VK_IMAGE_LAYOUT_GENERAL, buffer.handle(), 2, regions);
+    m_errorMonitor->VerifyFound();
+    m_commandBuffer->end();
+}
+
 TEST_F(VkLayerTest, MiscImageLayerTests) {
     TEST_DESCRIPTION("Image-related tests that don't belong elsewhere");
 
@@ -20797,6 +20973,82 @@ TEST_F(VkPositiveLayerTest, EmptyDescriptorUpdateTest) {
     vkDestroyBuffer(m_device->device(), buffer, NULL);
 }
 
+TEST_F(VkPositiveLayerTest, UpdateDescriptorSetWithTemplateRollOver) {
+    TEST_DESCRIPTION(
+        "Update a descriptor set with a template whose entries write more descriptors than their first binding has, so the "
+        "writes roll over into bindings of a different size");
+
+    ASSERT_NO_FATAL_FAILURE(InitFramework(myDbgFunc, m_errorMonitor));
+    if (DeviceExtensionSupported(gpu(), nullptr, VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME)) {
+        m_device_extension_names.push_back(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME);
+    } else {
+        printf("             Descriptor Update Template Extension not supported, skipping tests\n");
+        return;
+    }
+    ASSERT_NO_FATAL_FAILURE(InitState());
+
+    auto vkCreateDescriptorUpdateTemplateKHR =
+        (PFN_vkCreateDescriptorUpdateTemplateKHR)vkGetDeviceProcAddr(m_device->device(), "vkCreateDescriptorUpdateTemplateKHR");
+    auto vkDestroyDescriptorUpdateTemplateKHR =
+        (PFN_vkDestroyDescriptorUpdateTemplateKHR)vkGetDeviceProcAddr(m_device->device(), "vkDestroyDescriptorUpdateTemplateKHR");
+    auto vkUpdateDescriptorSetWithTemplateKHR =
+        (PFN_vkUpdateDescriptorSetWithTemplateKHR)vkGetDeviceProcAddr(m_device->device(), "vkUpdateDescriptorSetWithTemplateKHR");
+    ASSERT_TRUE(vkCreateDescriptorUpdateTemplateKHR != nullptr);
+    ASSERT_TRUE(vkDestroyDescriptorUpdateTemplateKHR != nullptr);
+    ASSERT_TRUE(vkUpdateDescriptorSetWithTemplateKHR != nullptr);
+
+    // Five descriptors in bindings of 1, 3 and 1. Rolling over with the count of the first binding would leave binding 1
+    // after one descriptor and run past binding 2.
+    OneOffDescriptorSet ds(m_device->device(), {
+        { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_ALL, nullptr },
+        { 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, VK_SHADER_STAGE_ALL, nullptr },
+        { 2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_ALL, nullptr },
+    });
+    ASSERT_TRUE(ds.Initialized());
+
+    uint32_t data[4] = {};
+    VkConstantBufferObj buffer(m_device, sizeof(data), data, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+    // Descriptors for both entries, one after the other
+    VkDescriptorBufferInfo update_data[7];
+    for (auto &info : update_data) {
+        info = {buffer.handle(), 0, VK_WHOLE_SIZE};
+    }
+
+    VkDescriptorUpdateTemplateEntryKHR entries[2] = {};
+    // From the start of binding 0 through the end of binding 2
+    entries[0].dstBinding = 0;
+    entries[0].descriptorCount = 5;
+    entries[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    entries[0].offset = 0;
+    entries[0].stride = sizeof(VkDescriptorBufferInfo);
+    // From the last element of binding 1 into binding 2
+    entries[1].dstBinding = 1;
+    entries[1].dstArrayElement = 2;
+    entries[1].descriptorCount = 2;
+    entries[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    entries[1].offset = 5 * sizeof(VkDescriptorBufferInfo);
+    entries[1].stride = sizeof(VkDescriptorBufferInfo);
+
+    VkDescriptorUpdateTemplateCreateInfoKHR template_ci = {};
+    template_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR;
+    template_ci.descriptorUpdateEntryCount = 2;
+    template_ci.pDescriptorUpdateEntries = entries;
+    template_ci.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR;
+    template_ci.descriptorSetLayout = ds.layout_;
+
+    m_errorMonitor->ExpectSuccess();
+    VkDescriptorUpdateTemplateKHR update_template = VK_NULL_HANDLE;
+    VkResult err = vkCreateDescriptorUpdateTemplateKHR(m_device->device(), &template_ci, nullptr, &update_template);
+    ASSERT_VK_SUCCESS(err);
+    // Twice, since the writes are worked out once when the template is created and reused by every update
+    vkUpdateDescriptorSetWithTemplateKHR(m_device->device(), ds.set_, update_template, update_data);
+    vkUpdateDescriptorSetWithTemplateKHR(m_device->device(), ds.set_, update_template, update_data);
+    m_errorMonitor->VerifyNotFound();
+
+    vkDestroyDescriptorUpdateTemplateKHR(m_device->device(), update_template, nullptr);
+}
+
 // This is a positive test. No failures are expected.
 TEST_F(VkPositiveLayerTest, PushDescriptorNullDstSetTest) {
     TEST_DESCRIPTION("Use null dstSet in CmdPushDescriptorSetKHR");
@@ -21878,6 +22130,79 @@ TEST_F(VkPositiveLayerTest, BindSparse) {
     m_errorMonitor->VerifyNotFound();
 }
 
+// This is a positive test. No failures are expected.
+TEST_F(VkPositiveLayerTest, BindSparseRebindAndUnbind) {
+    TEST_DESCRIPTION(
+        "Bind one memory object to a whole sparse buffer, rebind it to another memory object, record a command using the "
+        "buffer and free the memory that is no longer bound before submitting. Then unbind the buffer with VK_NULL_HANDLE "
+        "memory and free the other memory object.");
+
+    ASSERT_NO_FATAL_FAILURE(Init());
+
+    auto index = m_device->graphics_queue_node_index_;
+    if (!m_device->phy().features().sparseBinding || !(m_device->queue_props[index].queueFlags & VK_QUEUE_SPARSE_BINDING_BIT)) {
+        printf("             Device does not support sparse binding; skipped.\n");
+        return;
+    }
+
+    m_errorMonitor->ExpectSuccess();
+
+    VkBuffer buffer;
+    VkBufferCreateInfo buf_info = {};
+    buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buf_info.flags = VK_BUFFER_CREATE_SPARSE_BINDING_BIT;
+    buf_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buf_info.size = 0x10000;
+    buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkResult err = vkCreateBuffer(m_device->device(), &buf_info, NULL, &buffer);
+    ASSERT_VK_SUCCESS(err);
+
+    VkMemoryRequirements mem_reqs;
+    vkGetBufferMemoryRequirements(m_device->device(), buffer, &mem_reqs);
+    VkMemoryAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.allocationSize = mem_reqs.size;
+    bool pass = m_device->phy().set_memory_type(mem_reqs.memoryTypeBits, &alloc_info, 0);
+    ASSERT_TRUE(pass);
+    VkDeviceMemory memory_one, memory_two;
+    err = vkAllocateMemory(m_device->device(), &alloc_info, NULL, &memory_one);
+    ASSERT_VK_SUCCESS(err);
+    err = vkAllocateMemory(m_device->device(), &alloc_info, NULL, &memory_two);
+    ASSERT_VK_SUCCESS(err);
+
+    VkSparseMemoryBind bind = {};
+    bind.memory = memory_one;
+    bind.resourceOffset = 0;
+    bind.size = mem_reqs.size;
+    VkSparseBufferMemoryBindInfo buffer_bind = {buffer, 1, &bind};
+    VkBindSparseInfo bind_sparse_info = {};
+    bind_sparse_info.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
+    bind_sparse_info.bufferBindCount = 1;
+    bind_sparse_info.pBufferBinds = &buffer_bind;
+    vkQueueBindSparse(m_device->m_queue, 1, &bind_sparse_info, VK_NULL_HANDLE);
+
+    // Replace the whole range with the second memory object
+    bind.memory = memory_two;
+    vkQueueBindSparse(m_device->m_queue, 1, &bind_sparse_info, VK_NULL_HANDLE);
+    vkQueueWaitIdle(m_device->m_queue);
+
+    m_commandBuffer->begin();
+    vkCmdFillBuffer(m_commandBuffer->handle(), buffer, 0, VK_WHOLE_SIZE, 0);
+    m_commandBuffer->end();
+
+    // memory_one is no longer bound to the buffer, so freeing it leaves the command buffer valid
+    vkFreeMemory(m_device->device(), memory_one, NULL);
+    m_commandBuffer->QueueCommandBuffer();
+
+    // Unbinding the whole range leaves no memory bound to the buffer
+    bind.memory = VK_NULL_HANDLE;
+    vkQueueBindSparse(m_device->m_queue, 1, &bind_sparse_info, VK_NULL_HANDLE);
+    vkQueueWaitIdle(m_device->m_queue);
+    vkFreeMemory(m_device->device(), memory_two, NULL);
+    vkDestroyBuffer(m_device->device(), buffer, NULL);
+    m_errorMonitor->VerifyNotFound();
+}
+
 TEST_F(VkPositiveLayerTest, RenderPassInitialLayoutUndefined) {
     TEST_DESCRIPTION(
         "Ensure that CmdBeginRenderPass with an attachment's "
@@ -25270,6 +25595,7 @@ void android_main(struct android_app *app) {
             }
 
             if (app->destroyRequested != 0) {
+                VkRenderFramework::ReleaseSharedDevice();
                 VkTestFramework::Finish();
                 return;
             }
@@ -25349,6 +25675,7 @@ int main(int argc, char **argv) {
 
     result = RUN_ALL_TESTS();
 
+    VkRenderFramework::ReleaseSharedDevice();
     VkTestFramework::Finish();
     return result;
 }
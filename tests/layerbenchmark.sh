@@ -0,0 +1,73 @@
+#!/bin/bash
+# Measure the CPU cost of the loader and of each layer by replaying a trace on
+# the mock ICD, which does no work of its own, once without layers and once
+# with each layer stack.
+#
+# usage: layerbenchmark.sh <trace file> [loop count]
+# Each run reports the calls replayed and the time per call.  The difference
+# from the run without layers is the cost of the layers in that stack.
+
+if [ -t 1 ] ; then
+    RED='\033[0;31m'
+    GREEN='\033[0;32m'
+    NC='\033[0m' # No Color
+else
+    RED=''
+    GREEN=''
+    NC=''
+fi
+
+if [ -z "$1" ] ; then
+	printf "usage: $0 <trace file> [loop count]\n"
+	exit 1
+fi
+TRACE=$(readlink -f $1)
+LOOPS=${2:-1}
+
+printf "$GREEN[ RUN      ]$NC $0\n"
+
+export LD_LIBRARY_PATH=${PWD}/../loader:${LD_LIBRARY_PATH}
+export VK_LAYER_PATH=${PWD}/../layers:${PWD}/../layersvt
+export VK_ICD_FILENAMES=${PWD}/../icd/VkICD_mock_icd.json
+
+VKREPLAY=${PWD}/../vktrace/vkreplay
+
+# api_dump writes to a file so the time isn't spent on the terminal
+SETTINGS=$(mktemp)
+printf "lunarg_api_dump.file = TRUE\nlunarg_api_dump.log_filename = /dev/null\n" > ${SETTINGS}
+export VK_LAYER_SETTINGS_PATH=${SETTINGS}
+trap "rm -f ${SETTINGS}" EXIT
+
+LAYER_STACKS="VK_LAYER_LUNARG_core_validation
+VK_LAYER_LUNARG_object_tracker
+VK_LAYER_GOOGLE_threading
+VK_LAYER_GOOGLE_unique_objects
+VK_LAYER_LUNARG_parameter_validation
+VK_LAYER_LUNARG_standard_validation
+VK_LAYER_LUNARG_api_dump"
+
+# usage: benchmark <name> <layers, separated by colons>
+function benchmark {
+	NAME=$1
+	printf "$GREEN[ BENCH    ]$NC ${NAME}\n"
+	OUTPUT=$(VK_INSTANCE_LAYERS=$2 ${VKREPLAY} --Open ${TRACE} --Headless true --NumLoops ${LOOPS} --Verbosity full 2>&1)
+	RESULT=$(echo "${OUTPUT}" | sed -n 's/.*Replayed \([0-9]*\) calls in \([0-9.]*\) ms, \([0-9.]*\) ns per call.*/\1 \2 \3/p')
+	if [ -z "${RESULT}" ] ; then
+		echo "${OUTPUT}"
+		printf "$RED[  FAILED  ]$NC ${NAME}\n"
+		printf "TEST FAILED\n"
+		exit 1
+	fi
+	read CALLS MS NS_PER_CALL <<< "${RESULT}"
+	[ -z "${BASELINE_NS}" ] && BASELINE_NS=${NS_PER_CALL}
+	printf "%-40s calls:%s, replay_ms:%s, ns_per_call:%s, layer_ns_per_call:%s\n" ${NAME} ${CALLS} ${MS} ${NS_PER_CALL} \
+		$(awk "BEGIN { printf \"%.1f\", ${NS_PER_CALL} - ${BASELINE_NS} }")
+}
+
+benchmark none ""
+for LAYER in ${LAYER_STACKS} ; do
+	benchmark ${LAYER} ${LAYER}
+done
+
+printf "$GREEN[  PASSED  ]$NC $0\n"
+exit 0
@@ -79,7 +79,7 @@ VKAPI_ATTR void VKAPI_CALL DestroyInstance(VkInstance instance, const VkAllocati
     instance_data->instance_dispatch_table->DestroyInstance(instance, pAllocator);
 
     delete instance_data->instance_dispatch_table;
-    layer_data_map.erase(key);
+    FreeLayerDataPtr(key, layer_data_map);
 
     // Marker for testing.
     std::cout << "VK_LAYER_LUNARG_test: DestroyInstance" << '\n';
@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2017 The Khronos Group Inc.
+ * Copyright (c) 2017 Valve Corporation
+ * Copyright (c) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Latency of the loader entry points that every application goes through at
+// startup, measured with the installed drivers plus a number of generated layer
+// and ICD manifests.  Each benchmark times every call separately and reports the
+// distribution in microseconds:
+//
+//     [ PERF     ] layers64_icds4 CreateDestroyInstance min 812.4 median 845.0 p90 901.7 p99 1203.3 max 1540.2 us
+//
+// The manifests are written to a temporary directory that is put in front of
+// XDG_CONFIG_DIRS, so the loader scans it along with the usual locations.  The
+// layer manifests are implicit layers that are only enabled by an environment
+// variable that is never set, so the loader parses them on every call but never
+// loads a library.  The ICD manifests point to a library that doesn't exist,
+// unless VK_PERF_FAKE_ICD_LIBRARY names one, so the loader also pays for a
+// failed library load per ICD.  The following environment variables control the
+// run:
+//
+//     VK_PERF_ITERATIONS        timed calls per benchmark (default 100)
+//     VK_PERF_MANIFESTS         comma separated "<layers>:<icds>" manifest
+//                               counts, one configuration each (default
+//                               "0:0,16:0,128:0,0:4,0:16,128:16")
+//     VK_PERF_FAKE_ICD_LIBRARY  library_path of the generated ICD manifests
+//     VK_PERF_RESULTS           append the results to this file, one
+//                               "<configuration> <benchmark> <median us>" per line
+//     VK_PERF_BASELINE          a file in the VK_PERF_RESULTS format; a benchmark
+//                               fails if its median is slower than its baseline
+//                               by more than VK_PERF_TOLERANCE percent (default 25)
+//
+// Windows finds implicit layers and ICDs through the registry, so the benchmarks
+// are skipped there.
+
+#include "test_common.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct ManifestConfig {
+    uint32_t layer_count;
+    uint32_t icd_count;
+    std::string name;
+};
+
+// Let gtest print the configuration name in test names and failures.
+void PrintTo(const ManifestConfig &config, std::ostream *os) { *os << config.name; }
+
+static uint32_t EnvUint(const char *name, uint32_t default_value) {
+    const char *value = getenv(name);
+    if (value == nullptr || atoi(value) <= 0) {
+        return default_value;
+    }
+    return static_cast<uint32_t>(atoi(value));
+}
+
+static std::vector<ManifestConfig> ManifestConfigs() {
+    const char *value = getenv("VK_PERF_MANIFESTS");
+    std::string list = value ? value : "0:0,16:0,128:0,0:4,0:16,128:16";
+
+    std::vector<ManifestConfig> configs;
+    std::istringstream entries(list);
+    std::string entry;
+    while (std::getline(entries, entry, ',')) {
+        unsigned int layers = 0, icds = 0;
+        if (sscanf(entry.c_str(), "%u:%u", &layers, &icds) != 2) {
+            printf("Ignoring \"%s\" in VK_PERF_MANIFESTS, expected \"<layers>:<icds>\".\n", entry.c_str());
+            continue;
+        }
+        configs.push_back({layers, icds, "layers" + std::to_string(layers) + "_icds" + std::to_string(icds)});
+    }
+    return configs;
+}
+
+// Call durations of one benchmark, in microseconds.
+struct Distribution {
+    std::vector<double> samples;
+
+    double Percentile(double p) const {
+        size_t index = static_cast<size_t>(p / 100.0 * (samples.size() - 1) + 0.5);
+        return samples[index];
+    }
+};
+
+class VkLoaderPerfTest : public ::testing::TestWithParam<ManifestConfig> {
+   protected:
+    uint32_t m_iterations;
+    std::string m_directory;
+    std::vector<std::string> m_files;
+    bool m_had_xdg_config_dirs;
+    std::string m_xdg_config_dirs;
+
+    virtual void SetUp() {
+        m_iterations = EnvUint("VK_PERF_ITERATIONS", 100);
+#if !defined(_WIN32)
+        const char *xdg_config_dirs = getenv("XDG_CONFIG_DIRS");
+        m_had_xdg_config_dirs = xdg_config_dirs != nullptr;
+        m_xdg_config_dirs = xdg_config_dirs ? xdg_config_dirs : "";
+
+        char directory[] = "/tmp/vk_loader_perf_XXXXXX";
+        ASSERT_NE(nullptr, mkdtemp(directory));
+        m_directory = directory;
+        ASSERT_EQ(0, mkdir((m_directory + "/vulkan").c_str(), 0700));
+        ASSERT_EQ(0, mkdir((m_directory + "/vulkan/icd.d").c_str(), 0700));
+        ASSERT_EQ(0, mkdir((m_directory + "/vulkan/implicit_layer.d").c_str(), 0700));
+
+        const char *icd_library = getenv("VK_PERF_FAKE_ICD_LIBRARY");
+        for (uint32_t i = 0; i < GetParam().layer_count; i++) {
+            WriteLayerManifest(i);
+        }
+        for (uint32_t i = 0; i < GetParam().icd_count; i++) {
+            WriteIcdManifest(i, icd_library ? icd_library : "libVkICD_perf_fake.so");
+        }
+
+        // An empty XDG_CONFIG_DIRS means /etc/xdg to the loader, which must
+        // still be searched
+        std::string search_dirs = m_directory + ":" + (m_xdg_config_dirs.empty() ? "/etc/xdg" : m_xdg_config_dirs);
+        setenv("XDG_CONFIG_DIRS", search_dirs.c_str(), 1);
+#endif
+    }
+
+    virtual void TearDown() {
+#if !defined(_WIN32)
+        if (m_had_xdg_config_dirs) {
+            setenv("XDG_CONFIG_DIRS", m_xdg_config_dirs.c_str(), 1);
+        } else {
+            unsetenv("XDG_CONFIG_DIRS");
+        }
+        for (auto &file : m_files) {
+            remove(file.c_str());
+        }
+        if (!m_directory.empty()) {
+            rmdir((m_directory + "/vulkan/implicit_layer.d").c_str());
+            rmdir((m_directory + "/vulkan/icd.d").c_str());
+            rmdir((m_directory + "/vulkan").c_str());
+            rmdir(m_directory.c_str());
+        }
+#endif
+    }
+
+    // Returns false if the benchmarks can't run on this platform.
+    bool Supported() {
+#if defined(_WIN32)
+        printf("             Manifests are found through the registry on Windows; skipped.\n");
+        return false;
+#else
+        return !::testing::Test::HasFatalFailure();
+#endif
+    }
+
+    void WriteFile(const std::string &path, const std::string &contents) {
+        std::ofstream file(path.c_str());
+        file << contents;
+        m_files.push_back(path);
+    }
+
+    void WriteLayerManifest(uint32_t index) {
+        std::string name = "VK_LAYER_PERF_fake_" + std::to_string(index);
+        std::ostringstream manifest;
+        manifest << "{\n"
+                 << "    \"file_format_version\" : \"1.0.0\",\n"
+                 << "    \"layer\" : {\n"
+                 << "        \"name\" : \"" << name << "\",\n"
+                 << "        \"type\" : \"GLOBAL\",\n"
+                 << "        \"library_path\" : \"libVkLayer_perf_fake.so\",\n"
+                 << "        \"api_version\" : \"1.0." << VK_HEADER_VERSION << "\",\n"
+                 << "        \"implementation_version\" : \"1\",\n"
+                 << "        \"description\" : \"Layer manifest generated by vk_loader_performance_tests\",\n"
+                 << "        \"enable_environment\" : { \"VK_PERF_ENABLE_FAKE_LAYERS\" : \"1\" },\n"
+                 << "        \"disable_environment\" : { \"VK_PERF_DISABLE_FAKE_LAYERS\" : \"1\" }\n"
+                 << "    }\n"
+                 << "}\n";
+        WriteFile(m_directory + "/vulkan/implicit_layer.d/" + name + ".json", manifest.str());
+    }
+
+    void WriteIcdManifest(uint32_t index, const char *library) {
+        std::ostringstream manifest;
+        manifest << "{\n"
+                 << "    \"file_format_version\" : \"1.0.0\",\n"
+                 << "    \"ICD\" : {\n"
+                 << "        \"library_path\" : \"" << library << "\",\n"
+                 << "        \"api_version\" : \"1.0." << VK_HEADER_VERSION << "\"\n"
+                 << "    }\n"
+                 << "}\n";
+        WriteFile(m_directory + "/vulkan/icd.d/perf_fake_icd_" + std::to_string(index) + ".json", manifest.str());
+    }
+
+    // Time m_iterations calls of body separately, after one untimed warm-up
+    // call.  body returns false if the call failed, which ends the benchmark.
+    template <typename Body>
+    Distribution Measure(Body body) {
+        Distribution distribution;
+        if (!body()) return distribution;
+        for (uint32_t i = 0; i < m_iterations; i++) {
+            auto start = std::chrono::steady_clock::now();
+            bool succeeded = body();
+            std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+            if (!succeeded) break;
+            distribution.samples.push_back(elapsed.count());
+        }
+        std::sort(distribution.samples.begin(), distribution.samples.end());
+        return distribution;
+    }
+
+    void Report(const char *benchmark, const Distribution &distribution);
+};
+
+void VkLoaderPerfTest::Report(const char *benchmark, const Distribution &distribution) {
+    ASSERT_EQ(m_iterations, distribution.samples.size()) << benchmark << " failed";
+
+    const char *config = GetParam().name.c_str();
+    double median = distribution.Percentile(50);
+    printf("[ PERF     ] %s %s min %.1f median %.1f p90 %.1f p99 %.1f max %.1f us\n", config, benchmark,
+           distribution.samples.front(), median, distribution.Percentile(90), distribution.Percentile(99),
+           distribution.samples.back());
+    RecordProperty(benchmark, static_cast<int>(median + 0.5));
+
+    const char *results_file = getenv("VK_PERF_RESULTS");
+    if (results_file) {
+        std::ofstream results(results_file, std::ios::app);
+        results << config << " " << benchmark << " " << median << std::endl;
+    }
+
+    const char *baseline_file = getenv("VK_PERF_BASELINE");
+    if (baseline_file) {
+        std::ifstream baseline(baseline_file);
+        std::string line;
+        while (std::getline(baseline, line)) {
+            std::istringstream fields(line);
+            std::string baseline_config, baseline_benchmark;
+            double baseline_us = 0.0;
+            if (!(fields >> baseline_config >> baseline_benchmark >> baseline_us)) continue;
+            if (baseline_config != config || baseline_benchmark != benchmark) continue;
+
+            double tolerance = EnvUint("VK_PERF_TOLERANCE", 25) / 100.0;
+            EXPECT_LE(median, baseline_us * (1.0 + tolerance))
+                << benchmark << " with " << config << " regressed from " << baseline_us << " us";
+        }
+    }
+}
+
+static VkInstanceCreateInfo InstanceCreateInfo(const VkApplicationInfo *app_info) {
+    VkInstanceCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    info.pApplicationInfo = app_info;
+    return info;
+}
+
+static const VkApplicationInfo kAppInfo = {VK_STRUCTURE_TYPE_APPLICATION_INFO, nullptr, "loader_performance_tests", 1, "unittest",
+                                           1, VK_API_VERSION_1_0};
+
+// Both calls of the usual count-then-fill pattern.
+TEST_P(VkLoaderPerfTest, EnumerateInstanceExtensionProperties) {
+    if (!Supported()) return;
+
+    std::vector<VkExtensionProperties> properties;
+    Report("EnumerateInstanceExtensionProperties", Measure([&properties]() {
+               uint32_t count = 0;
+               if (vkEnumerateInstanceExtensionProperties(nullptr, &count, nullptr) != VK_SUCCESS) return false;
+               properties.resize(count);
+               return vkEnumerateInstanceExtensionProperties(nullptr, &count, properties.data()) == VK_SUCCESS;
+           }));
+}
+
+TEST_P(VkLoaderPerfTest, CreateDestroyInstance) {
+    if (!Supported()) return;
+
+    VkInstanceCreateInfo info = InstanceCreateInfo(&kAppInfo);
+    Report("CreateDestroyInstance", Measure([&info]() {
+               VkInstance instance;
+               if (vkCreateInstance(&info, nullptr, &instance) != VK_SUCCESS) return false;
+               vkDestroyInstance(instance, nullptr);
+               return true;
+           }));
+}
+
+// Both calls of the count-then-fill pattern on a new instance each time, since
+// the loader only sets up the physical devices on the first call.
+TEST_P(VkLoaderPerfTest, EnumeratePhysicalDevices) {
+    if (!Supported()) return;
+
+    VkInstanceCreateInfo info = InstanceCreateInfo(&kAppInfo);
+    std::vector<VkInstance> instances(m_iterations + 1, VK_NULL_HANDLE);
+    for (auto &instance : instances) {
+        ASSERT_VK_SUCCESS(vkCreateInstance(&info, nullptr, &instance));
+    }
+
+    size_t next = 0;
+    std::vector<VkPhysicalDevice> physical_devices;
+    Report("EnumeratePhysicalDevices", Measure([&instances, &next, &physical_devices]() {
+               VkInstance instance = instances[next++];
+               uint32_t count = 0;
+               if (vkEnumeratePhysicalDevices(instance, &count, nullptr) != VK_SUCCESS) return false;
+               physical_devices.resize(count);
+               VkResult result = vkEnumeratePhysicalDevices(instance, &count, physical_devices.data());
+               return result == VK_SUCCESS || result == VK_INCOMPLETE;
+           }));
+
+    for (auto &instance : instances) {
+        vkDestroyInstance(instance, nullptr);
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(Manifests, VkLoaderPerfTest, ::testing::ValuesIn(ManifestConfigs()));
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
@@ -36,6 +36,7 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "test_common.h"
@@ -983,6 +984,71 @@ TEST_F(ImplicitLayer, Present) {
     vkDestroyInstance(instance, nullptr);
 }
 
+// Test that entry points no ICD or layer supports are not found, however many of them are looked up. Names nothing
+// supports are not added to the loader's unknown entry point tables, so they can't fill them up.
+TEST(GetInstanceProcAddr, UnknownEntryPointsNotFound) {
+    VkInstance instance = VK_NULL_HANDLE;
+    VkResult result = vkCreateInstance(VK::InstanceCreateInfo(), VK_NULL_HANDLE, &instance);
+    ASSERT_EQ(result, VK_SUCCESS);
+
+    // More names than the tables hold, each looked up twice
+    for (uint32_t i = 0; i < 1000; ++i) {
+        std::string const name = "vkLoaderTestUnknownEntryPoint" + std::to_string(i % 500);
+        ASSERT_EQ(vkGetInstanceProcAddr(instance, name.c_str()), nullptr);
+    }
+
+    // Entry points the loader knows are still found
+    ASSERT_NE(vkGetInstanceProcAddr(instance, "vkCreateDevice"), nullptr);
+    ASSERT_NE(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties"), nullptr);
+
+    vkDestroyInstance(instance, nullptr);
+}
+
+// Test that threads looking up the same entry points at once all get the same addresses. The unknown device and
+// physical device entry point tables are read without a lock, so this covers lookups racing with an insert.
+TEST(GetInstanceProcAddr, ConcurrentLookupsAgree) {
+    VkInstance instance = VK_NULL_HANDLE;
+    VkResult result = vkCreateInstance(VK::InstanceCreateInfo(), VK_NULL_HANDLE, &instance);
+    ASSERT_EQ(result, VK_SUCCESS);
+
+    // Known names, extension names an ICD may support that the loader may not know, and names nothing supports
+    char const *const names[] = {"vkCreateDevice",
+                                 "vkGetPhysicalDeviceProperties",
+                                 "vkGetDeviceQueue",
+                                 "vkGetPhysicalDeviceMultisamplePropertiesEXT",
+                                 "vkCmdSetSampleLocationsEXT",
+                                 "vkGetPhysicalDeviceExternalFencePropertiesKHR",
+                                 "vkImportFenceFdKHR",
+                                 "vkLoaderTestUnknownEntryPointA",
+                                 "vkLoaderTestUnknownEntryPointB"};
+    uint32_t const nameCount = sizeof(names) / sizeof(names[0]);
+    uint32_t const threadCount = 8;
+
+    std::vector<std::vector<PFN_vkVoidFunction>> found(threadCount, std::vector<PFN_vkVoidFunction>(nameCount));
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t]() {
+            for (uint32_t n = 0; n < nameCount; ++n) {
+                // Each thread starts at a different name, so first lookups of a name overlap
+                uint32_t const i = (n + t) % nameCount;
+                found[t][i] = vkGetInstanceProcAddr(instance, names[i]);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    for (uint32_t i = 0; i < nameCount; ++i) {
+        PFN_vkVoidFunction const expected = vkGetInstanceProcAddr(instance, names[i]);
+        for (uint32_t t = 0; t < threadCount; ++t) {
+            ASSERT_EQ(found[t][i], expected) << names[i];
+        }
+    }
+
+    vkDestroyInstance(instance, nullptr);
+}
+
 TEST(WrapObjects, Insert) {
     VkInstance instance = VK_NULL_HANDLE;
     VkResult result = vkCreateInstance(VK::InstanceCreateInfo(), VK_NULL_HANDLE, &instance);
@@ -17,5 +17,14 @@ set -e
 # that are wrong
 ./vk_layer_validation_tests
 
+# vk_layer_performance_tests reports the cost per call of hot entry points
+# without layers and with each validation layer.  Set VK_PERF_BASELINE to
+# fail on regressions against the results of a previous run.
+./vk_layer_performance_tests
+
+# vk_loader_performance_tests reports the latency of instance creation and
+# enumeration with generated layer and ICD manifests.
+./vk_loader_performance_tests
+
 # vktracereplay.sh tests vktrace trace and replay
 ./vktracereplay.sh
@@ -0,0 +1,77 @@
+#!/bin/bash
+# Run a gtest binary in parallel shards, one process per shard, and merge the
+# results.  The shards are split with the gtest sharding environment variables.
+#
+# usage: run_sharded_tests.sh [-j <shards>] [test binary] [gtest arguments]
+# The number of shards defaults to the number of CPUs, and the test binary to
+# vk_layer_validation_tests.
+#
+# Each shard runs in its own directory under sharded_tests/, with its own copy
+# of vk_layer_settings.txt, and writes output.txt and results.xml there.  The
+# pipeline cache of each shard is kept in pipeline_cache.bin between runs, so
+# later runs start with a warm cache.
+
+cd $(dirname "$0")
+
+if [ -t 1 ] ; then
+    RED='\033[0;31m'
+    GREEN='\033[0;32m'
+    NC='\033[0m' # No Color
+else
+    RED=''
+    GREEN=''
+    NC=''
+fi
+
+SHARDS=$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)
+if [ "$1" == "-j" ] ; then
+    SHARDS=$2
+    shift 2
+fi
+TEST_BINARY=${1:-./vk_layer_validation_tests}
+shift
+RESULTS_DIR=${PWD}/sharded_tests
+
+printf "$GREEN[ RUN      ]$NC ${TEST_BINARY} in ${SHARDS} shards\n"
+
+PIDS=()
+for (( SHARD=0; SHARD<SHARDS; SHARD++ )) ; do
+    SHARD_DIR=${RESULTS_DIR}/shard_${SHARD}
+    mkdir -p ${SHARD_DIR}
+    rm -f ${SHARD_DIR}/output.txt ${SHARD_DIR}/results.xml
+    cp vk_layer_settings.txt ${SHARD_DIR}/
+
+    GTEST_TOTAL_SHARDS=${SHARDS} GTEST_SHARD_INDEX=${SHARD} \
+    VK_LAYER_SETTINGS_PATH=${SHARD_DIR} \
+    VK_TEST_PIPELINE_CACHE=${SHARD_DIR}/pipeline_cache.bin \
+        ${TEST_BINARY} --gtest_output=xml:${SHARD_DIR}/results.xml "$@" > ${SHARD_DIR}/output.txt 2>&1 &
+    PIDS+=($!)
+done
+
+RESULT=0
+PASSED=0
+FAILED_TESTS=""
+for (( SHARD=0; SHARD<SHARDS; SHARD++ )) ; do
+    SHARD_DIR=${RESULTS_DIR}/shard_${SHARD}
+    if ! wait ${PIDS[$SHARD]} ; then
+        RESULT=1
+        # A crashed shard may not have printed a summary.
+        if ! grep -q "test cases\? ran" ${SHARD_DIR}/output.txt ; then
+            printf "$RED[  FAILED  ]$NC shard ${SHARD} did not finish, see ${SHARD_DIR}/output.txt\n"
+        fi
+    fi
+    COUNT=$(sed -n 's/^\[  PASSED  \] \([0-9]*\) tests\?\.$/\1/p' ${SHARD_DIR}/output.txt)
+    PASSED=$((PASSED + ${COUNT:-0}))
+    FAILED_TESTS+=" $(sed -n 's/^\[  FAILED  \] \([^ ,]*\)\(, .*\)\?$/\1/p' ${SHARD_DIR}/output.txt | grep -v "^[0-9]*$" | sort -u)"
+done
+
+printf "${PASSED} tests passed in ${SHARDS} shards, results are in ${RESULTS_DIR}\n"
+if [ ${RESULT} -ne 0 ] ; then
+    for TEST in ${FAILED_TESTS} ; do
+        printf "$RED[  FAILED  ]$NC ${TEST}\n"
+    done
+    printf "TEST FAILED\n"
+    exit 1
+fi
+
+printf "$GREEN[  PASSED  ]$NC ${TEST_BINARY}\n"
@@ -0,0 +1,52 @@
+#!/bin/bash
+# Measure validation layer overhead by running smoketest in benchmark mode,
+# once without layers and once with each validation layer.
+#
+# usage: smokebenchmark.sh [frame count] [extra smoketest arguments]
+# The smoketest arguments default to "--objects 5000 --seed 0".
+
+if [ -t 1 ] ; then
+    RED='\033[0;31m'
+    GREEN='\033[0;32m'
+    NC='\033[0m' # No Color
+else
+    RED=''
+    GREEN=''
+    NC=''
+fi
+
+printf "$GREEN[ RUN      ]$NC $0\n"
+
+export LD_LIBRARY_PATH=${PWD}/../loader:${LD_LIBRARY_PATH}
+export VK_LAYER_PATH=${PWD}/../layers:${PWD}/../layersvt
+
+FRAMES=${1:-500}
+shift
+SMOKEARGS=${*:-"--objects 5000 --seed 0"}
+SMOKETEST=${PWD}/../demos/smoketest
+
+LAYERS="VK_LAYER_LUNARG_core_validation
+VK_LAYER_LUNARG_object_tracker
+VK_LAYER_GOOGLE_threading
+VK_LAYER_GOOGLE_unique_objects
+VK_LAYER_LUNARG_parameter_validation"
+
+function benchmark {
+	NAME=$1
+	shift
+	printf "$GREEN[ BENCH    ]$NC ${NAME}\n"
+	RESULT=$(${SMOKETEST} --benchmark --c ${FRAMES} ${SMOKEARGS} "$@" | grep "^benchmark ")
+	if [ -z "${RESULT}" ] ; then
+	   printf "$RED[  FAILED  ]$NC ${NAME}\n"
+	   printf "TEST FAILED\n"
+	   exit 1
+	fi
+	printf "${NAME} ${RESULT#benchmark }\n"
+}
+
+benchmark none
+for LAYER in ${LAYERS} ; do
+	benchmark ${LAYER} --layer ${LAYER}
+done
+
+printf "$GREEN[  PASSED  ]$NC $0\n"
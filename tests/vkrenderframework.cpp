@@ -24,6 +24,8 @@
 #include "vkrenderframework.h"
 #include "vk_format_utils.h"
 
+#include <string>
+
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
 #define GET_DEVICE_PROC_ADDR(dev, entrypoint)                                            \
     {                                                                                    \
@@ -31,6 +33,40 @@
         assert(fp##entrypoint != NULL);                                                  \
     }
 
+namespace {
+
+// Instance and device handed from one test to the next when device sharing is enabled.  The pool owns them while no
+// test uses them; the keys describe the configuration they were created with.
+struct SharedDevice {
+    VkInstance inst;
+    uint32_t gpu_count;
+    VkPhysicalDevice objs[16];
+    VkDeviceObj *device;
+    std::string instance_key;
+    std::string device_key;
+};
+
+SharedDevice shared_device = {};
+
+bool DeviceSharingEnabled() {
+    static const char *env = getenv("VK_TEST_SHARE_DEVICE");
+    return env && atoi(env) != 0;
+}
+
+std::string NameListKey(const std::vector<const char *> &names) {
+    std::string key;
+    for (auto name : names) key.append(name).append(";");
+    return key;
+}
+
+}  // namespace
+
+void VkRenderFramework::ReleaseSharedDevice() {
+    delete shared_device.device;
+    if (shared_device.inst) vkDestroyInstance(shared_device.inst, NULL);
+    shared_device = SharedDevice();
+}
+
 VkRenderFramework::VkRenderFramework()
     : inst(VK_NULL_HANDLE),
       m_device(NULL),
@@ -50,7 +86,8 @@ VkRenderFramework::VkRenderFramework()
       m_CreateDebugReportCallback(VK_NULL_HANDLE),
       m_DestroyDebugReportCallback(VK_NULL_HANDLE),
       m_globalMsgCallback(VK_NULL_HANDLE),
-      m_devMsgCallback(VK_NULL_HANDLE) {
+      m_devMsgCallback(VK_NULL_HANDLE),
+      m_shareDevice(false) {
     memset(&m_renderPassBeginInfo, 0, sizeof(m_renderPassBeginInfo));
     m_renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 
@@ -161,24 +198,40 @@ void VkRenderFramework::InitFramework(PFN_vkDebugReportCallbackEXT dbgFunction,
         }
     }
 
-    VkInstanceCreateInfo instInfo = {};
     VkResult U_ASSERT_ONLY err;
 
-    instInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-    instInfo.pNext = NULL;
-    instInfo.pApplicationInfo = &app_info;
-    instInfo.enabledLayerCount = m_instance_layer_names.size();
-    instInfo.ppEnabledLayerNames = m_instance_layer_names.data();
-    instInfo.enabledExtensionCount = m_instance_extension_names.size();
-    instInfo.ppEnabledExtensionNames = m_instance_extension_names.data();
-    err = vkCreateInstance(&instInfo, NULL, &this->inst);
-    ASSERT_VK_SUCCESS(err);
-
-    err = vkEnumeratePhysicalDevices(inst, &this->gpu_count, NULL);
-    ASSERT_LE(this->gpu_count, ARRAY_SIZE(objs)) << "Too many gpus";
-    ASSERT_VK_SUCCESS(err);
-    err = vkEnumeratePhysicalDevices(inst, &this->gpu_count, objs);
-    ASSERT_VK_SUCCESS(err);
+    if (m_shareDevice && DeviceSharingEnabled()) {
+        std::string key = std::to_string(app_info.apiVersion) + "|" + NameListKey(m_instance_layer_names) + "|" +
+                          NameListKey(m_instance_extension_names);
+        if (shared_device.inst && shared_device.instance_key == key) {
+            this->inst = shared_device.inst;
+            this->gpu_count = shared_device.gpu_count;
+            memcpy(objs, shared_device.objs, sizeof(objs));
+            shared_device.inst = VK_NULL_HANDLE;
+        } else {
+            ReleaseSharedDevice();
+            shared_device.instance_key = key;
+        }
+    }
+
+    if (!this->inst) {
+        VkInstanceCreateInfo instInfo = {};
+        instInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+        instInfo.pNext = NULL;
+        instInfo.pApplicationInfo = &app_info;
+        instInfo.enabledLayerCount = m_instance_layer_names.size();
+        instInfo.ppEnabledLayerNames = m_instance_layer_names.data();
+        instInfo.enabledExtensionCount = m_instance_extension_names.size();
+        instInfo.ppEnabledExtensionNames = m_instance_extension_names.data();
+        err = vkCreateInstance(&instInfo, NULL, &this->inst);
+        ASSERT_VK_SUCCESS(err);
+
+        err = vkEnumeratePhysicalDevices(inst, &this->gpu_count, NULL);
+        ASSERT_LE(this->gpu_count, ARRAY_SIZE(objs)) << "Too many gpus";
+        ASSERT_VK_SUCCESS(err);
+        err = vkEnumeratePhysicalDevices(inst, &this->gpu_count, objs);
+        ASSERT_VK_SUCCESS(err);
+    }
     ASSERT_GE(this->gpu_count, (uint32_t)1) << "No GPU available";
     if (dbgFunction) {
         m_CreateDebugReportCallback =
@@ -230,6 +283,21 @@ void VkRenderFramework::ShutdownFramework() {
 
     delete m_depthStencil;
 
+    // Hand the instance and device to the next test only if this one passed and the device went idle; otherwise the
+    // layers may hold state this test left behind, so both are destroyed.
+    if (m_shareDevice && DeviceSharingEnabled() && !HasFailure() &&
+        (!m_device || vkDeviceWaitIdle(m_device->device()) == VK_SUCCESS)) {
+        shared_device.inst = this->inst;
+        shared_device.gpu_count = this->gpu_count;
+        memcpy(shared_device.objs, objs, sizeof(objs));
+        if (m_device) shared_device.device = m_device;
+        m_device = NULL;
+        this->inst = (VkInstance)0;
+        return;
+    }
+    if (m_shareDevice && shared_device.device && shared_device.device != m_device) delete shared_device.device;
+    if (m_shareDevice) shared_device = SharedDevice();
+
     // reset the driver
     delete m_device;
     if (this->inst) vkDestroyInstance(this->inst, NULL);
@@ -268,7 +336,20 @@ void VkRenderFramework::InitState(VkPhysicalDeviceFeatures *features, const VkCo
         }
     }
 
-    m_device = new VkDeviceObj(0, objs[0], m_device_extension_names, features);
+    if (m_shareDevice && DeviceSharingEnabled()) {
+        // A device left in the pool belongs to the instance this test took over in InitFramework
+        std::string key = NameListKey(m_device_extension_names) + "|" +
+                          (features ? std::string(reinterpret_cast<const char *>(features), sizeof(*features)) : "default");
+        if (shared_device.device && shared_device.device_key == key) {
+            m_device = shared_device.device;
+        } else {
+            delete shared_device.device;
+            shared_device.device_key = key;
+        }
+        shared_device.device = NULL;
+    }
+
+    if (!m_device) m_device = new VkDeviceObj(0, objs[0], m_device_extension_names, features);
     m_device->get_device_queue();
 
     m_depthStencil = new VkDepthStencilObj(m_device);
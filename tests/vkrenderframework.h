@@ -79,6 +79,9 @@ class VkRenderFramework : public VkTestFramework {
     void GetPhysicalDeviceFeatures(VkPhysicalDeviceFeatures *features);
     void InitState(VkPhysicalDeviceFeatures *features = nullptr, const VkCommandPoolCreateFlags flags = 0);
 
+    // Destroys the instance and device kept alive for sharing between tests, see m_shareDevice
+    static void ReleaseSharedDevice();
+
     const VkRenderPassBeginInfo &renderPassBeginInfo() const { return m_renderPassBeginInfo; }
 
     bool InstanceLayerSupported(const char *name, uint32_t specVersion = 0, uint32_t implementationVersion = 0);
@@ -129,6 +132,11 @@ class VkRenderFramework : public VkTestFramework {
     std::vector<const char *> m_instance_extension_names;
     std::vector<const char *> m_device_extension_names;
 
+    // When set and VK_TEST_SHARE_DEVICE is enabled, InitFramework and InitState reuse the instance and device of a
+    // previous test with the same layers, extensions and features, and ShutdownFramework keeps them for the next one.
+    // Only fixtures whose tests destroy everything they create and leave no layer state behind may set this.
+    bool m_shareDevice;
+
     /*
      * SetUp and TearDown are called by the Google Test framework
      * to initialize a test framework based on this class.
@@ -21,8 +21,11 @@
 
 #include "vktestbinding.h"
 #include <assert.h>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>  // memset(), memcmp()
 
 namespace {
@@ -70,12 +73,58 @@ VkMemoryAllocateInfo get_resource_alloc_info(const vk_testing::Device &dev, cons
     return info;
 }
 
+// Pipeline cache data shared by all the devices of the process.  If
+// VK_TEST_PIPELINE_CACHE names a file, every pipeline cache starts with the
+// data of that file and of the pipelines created so far.  Otherwise each
+// pipeline gets an empty cache.
+std::vector<char> pipeline_cache_data;
+bool pipeline_cache_loaded = false;
+
+const char *pipeline_cache_file() { return getenv("VK_TEST_PIPELINE_CACHE"); }
+
+VkResult create_pipeline_cache(const vk_testing::Device &dev, VkPipelineCache *cache) {
+    VkPipelineCacheCreateInfo ci = {};
+    ci.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    if (pipeline_cache_file()) {
+        if (!pipeline_cache_loaded) {
+            std::ifstream file(pipeline_cache_file(), std::ios::binary);
+            pipeline_cache_data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            pipeline_cache_loaded = true;
+        }
+        ci.initialDataSize = pipeline_cache_data.size();
+        ci.pInitialData = pipeline_cache_data.data();
+    }
+    return vkCreatePipelineCache(dev.handle(), &ci, NULL, cache);
+}
+
+// Keep the data of the cache for the next pipelines, and destroy it.
+void destroy_pipeline_cache(const vk_testing::Device &dev, VkPipelineCache cache) {
+    if (pipeline_cache_file()) {
+        size_t size = 0;
+        if (vkGetPipelineCacheData(dev.handle(), cache, &size, NULL) == VK_SUCCESS && size > 0) {
+            std::vector<char> data(size);
+            if (vkGetPipelineCacheData(dev.handle(), cache, &size, data.data()) == VK_SUCCESS) {
+                data.resize(size);
+                pipeline_cache_data.swap(data);
+            }
+        }
+    }
+    vkDestroyPipelineCache(dev.handle(), cache, NULL);
+}
+
 }  // namespace
 
 namespace vk_testing {
 
 void set_error_callback(ErrorCallback callback) { error_callback = callback; }
 
+void save_pipeline_cache() {
+    if (pipeline_cache_file() && !pipeline_cache_data.empty()) {
+        std::ofstream file(pipeline_cache_file(), std::ios::binary | std::ios::trunc);
+        file.write(pipeline_cache_data.data(), pipeline_cache_data.size());
+    }
+}
+
 VkPhysicalDeviceProperties PhysicalDevice::properties() const {
     VkPhysicalDeviceProperties info;
 
@@ -579,30 +628,24 @@ NON_DISPATCHABLE_HANDLE_DTOR(Pipeline, vkDestroyPipeline)
 
 void Pipeline::init(const Device &dev, const VkGraphicsPipelineCreateInfo &info) {
     VkPipelineCache cache;
-    VkPipelineCacheCreateInfo ci;
-    memset((void *)&ci, 0, sizeof(VkPipelineCacheCreateInfo));
-    ci.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-    VkResult err = vkCreatePipelineCache(dev.handle(), &ci, NULL, &cache);
+    VkResult err = create_pipeline_cache(dev, &cache);
     if (err == VK_SUCCESS) {
         NON_DISPATCHABLE_HANDLE_INIT(vkCreateGraphicsPipelines, dev, cache, 1, &info);
-        vkDestroyPipelineCache(dev.handle(), cache, NULL);
+        destroy_pipeline_cache(dev, cache);
     }
 }
 
 VkResult Pipeline::init_try(const Device &dev, const VkGraphicsPipelineCreateInfo &info) {
     VkPipeline pipe;
     VkPipelineCache cache;
-    VkPipelineCacheCreateInfo ci;
-    memset((void *)&ci, 0, sizeof(VkPipelineCacheCreateInfo));
-    ci.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-    VkResult err = vkCreatePipelineCache(dev.handle(), &ci, NULL, &cache);
+    VkResult err = create_pipeline_cache(dev, &cache);
     EXPECT(err == VK_SUCCESS);
     if (err == VK_SUCCESS) {
         err = vkCreateGraphicsPipelines(dev.handle(), cache, 1, &info, NULL, &pipe);
         if (err == VK_SUCCESS) {
             NonDispHandle::init(dev.handle(), pipe);
         }
-        vkDestroyPipelineCache(dev.handle(), cache, NULL);
+        destroy_pipeline_cache(dev, cache);
     }
 
     return err;
@@ -610,13 +653,10 @@ VkResult Pipeline::init_try(const Device &dev, const VkGraphicsPipelineCreateInf
 
 void Pipeline::init(const Device &dev, const VkComputePipelineCreateInfo &info) {
     VkPipelineCache cache;
-    VkPipelineCacheCreateInfo ci;
-    memset((void *)&ci, 0, sizeof(VkPipelineCacheCreateInfo));
-    ci.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-    VkResult err = vkCreatePipelineCache(dev.handle(), &ci, NULL, &cache);
+    VkResult err = create_pipeline_cache(dev, &cache);
     if (err == VK_SUCCESS) {
         NON_DISPATCHABLE_HANDLE_INIT(vkCreateComputePipelines, dev, cache, 1, &info);
-        vkDestroyPipelineCache(dev.handle(), cache, NULL);
+        destroy_pipeline_cache(dev, cache);
     }
 }
 
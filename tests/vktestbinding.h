@@ -32,6 +32,10 @@ namespace vk_testing {
 typedef void (*ErrorCallback)(const char *expr, const char *file, unsigned int line, const char *function);
 void set_error_callback(ErrorCallback callback);
 
+// Write the pipeline cache data collected by the tests to the file named by
+// VK_TEST_PIPELINE_CACHE, so the next run starts with a warm cache.
+void save_pipeline_cache();
+
 class PhysicalDevice;
 class Device;
 class Queue;
@@ -227,7 +227,7 @@ VkFormat VkTestFramework::GetFormat(VkInstance instance, vk_testing::Device *dev
     exit(1);
 }
 
-void VkTestFramework::Finish() {}
+void VkTestFramework::Finish() { vk_testing::save_pipeline_cache(); }
 
 //
 // These are the default resources for TBuiltInResources, used for both
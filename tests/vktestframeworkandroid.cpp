@@ -41,7 +41,7 @@ VkFormat VkTestFramework::GetFormat(VkInstance instance, vk_testing::Device *dev
 }
 
 void VkTestFramework::InitArgs(int *argc, char *argv[]) {}
-void VkTestFramework::Finish() {}
+void VkTestFramework::Finish() { vk_testing::save_pipeline_cache(); }
 
 void TestEnvironment::SetUp() { vk_testing::set_error_callback(test_error_callback); }
 
@@ -0,0 +1,170 @@
+#!/bin/bash
+# Measure the capture and replay overhead of vktrace.  cube and smoketest are
+# run natively, under vktrace with and without pageguard (PMB) and with and
+# without trimming, and every trace is replayed with vkreplay.
+#
+# usage: vktracebenchmark.sh [-b <baseline file>] [-t <tolerance %>] [-u] [frame count]
+# Each run reports its wall-clock time, the 50th and 99th percentile frame
+# times (the average for replays, which don't time frames), the peak RSS and
+# the trace size.  The results are compared against the baseline file, which
+# defaults to vktracebenchmark_baseline.txt; a value more than the tolerance
+# (default 10%) above its baseline fails the test.  -u writes the results as
+# the new baseline instead.
+
+if [ -t 1 ] ; then
+    RED='\033[0;31m'
+    GREEN='\033[0;32m'
+    NC='\033[0m' # No Color
+else
+    RED=''
+    GREEN=''
+    NC=''
+fi
+
+BASELINE=vktracebenchmark_baseline.txt
+TOLERANCE=10
+UPDATE_BASELINE=0
+while getopts "b:t:u" OPT ; do
+	case ${OPT} in
+	b) BASELINE=${OPTARG} ;;
+	t) TOLERANCE=${OPTARG} ;;
+	u) UPDATE_BASELINE=1 ;;
+	*) exit 1 ;;
+	esac
+done
+shift $((OPTIND - 1))
+FRAMES=${1:-500}
+
+printf "$GREEN[ RUN      ]$NC $0\n"
+
+export LD_LIBRARY_PATH=${PWD}/../loader:${LD_LIBRARY_PATH}
+export VK_LAYER_PATH=${PWD}/../layersvt
+
+VKTRACE=${PWD}/../vktrace/vktrace
+VKREPLAY=${PWD}/../vktrace/vkreplay
+APPDIR=${PWD}/../demos
+RESULTS=${PWD}/vktracebenchmark_results.txt
+# Trim the middle half of the frames.
+TRIM_FRAMES="frames-$((FRAMES / 4))-$((FRAMES * 3 / 4))"
+# GNU time reports the peak RSS; without it that column is left empty.
+TIME=$(command -v /usr/bin/time)
+
+rm -f ${RESULTS}
+
+# Runs a command, sets WALL_MS and PEAK_RSS_KB and leaves its output in OUTPUT.
+function timed_run {
+	OUTPUT=$(mktemp)
+	RSS_FILE=$(mktemp)
+	START=$(date +%s%N)
+	if [ -n "${TIME}" ] ; then
+		${TIME} -f "%M" -o ${RSS_FILE} "$@" > ${OUTPUT} 2>&1
+	else
+		"$@" > ${OUTPUT} 2>&1
+	fi
+	RUN_RESULT=$?
+	WALL_MS=$((($(date +%s%N) - START) / 1000000))
+	PEAK_RSS_KB=$(tail -n 1 ${RSS_FILE})
+	rm -f ${RSS_FILE}
+}
+
+# Sets FRAME_P50 and FRAME_P99 from the statistics the program printed.
+function frame_times {
+	PGM=$1
+	if [ ${PGM} == "cube" ] ; then
+		STATS=$(grep "^cpu frame time" ${OUTPUT})
+		FRAME_P50=$(echo "${STATS}" | sed -n 's/.* p50=\([0-9.]*\).*/\1/p')
+		FRAME_P99=$(echo "${STATS}" | sed -n 's/.* p99=\([0-9.]*\).*/\1/p')
+	else
+		STATS=$(grep "benchmark " ${OUTPUT})
+		FRAME_P50=$(echo "${STATS}" | sed -n 's/.*frame_ms_p50:\([0-9.]*\).*/\1/p')
+		FRAME_P99=$(echo "${STATS}" | sed -n 's/.*frame_ms_p99:\([0-9.]*\).*/\1/p')
+	fi
+}
+
+# Prints and records the results of the last run under NAME.
+function report {
+	NAME=$1
+	TRACE_KB=$2
+	if [ ${RUN_RESULT} -ne 0 ] ; then
+		cat ${OUTPUT}
+		rm -f ${OUTPUT}
+		printf "$RED[  FAILED  ]$NC ${NAME}\n"
+		printf "TEST FAILED\n"
+		exit 1
+	fi
+	rm -f ${OUTPUT}
+	printf "%-32s wall_ms:%s, frame_ms_p50:%s, frame_ms_p99:%s, peak_rss_kb:%s, trace_kb:%s\n" ${NAME} \
+		"${WALL_MS}" "${FRAME_P50}" "${FRAME_P99}" "${PEAK_RSS_KB}" "${TRACE_KB}"
+	for METRIC in wall_ms:${WALL_MS} frame_ms_p50:${FRAME_P50} frame_ms_p99:${FRAME_P99} \
+		      peak_rss_kb:${PEAK_RSS_KB} trace_kb:${TRACE_KB} ; do
+		[ -n "${METRIC#*:}" ] && echo "${NAME} ${METRIC%%:*} ${METRIC#*:}" >> ${RESULTS}
+	done
+}
+
+# usage: benchmark <program> <program arguments>
+function benchmark {
+	PGM=$1
+	PARGS=$2
+
+	printf "$GREEN[ BENCH    ]$NC ${PGM}\n"
+	cd ${APPDIR}
+	timed_run ./${PGM} --c ${FRAMES} ${PARGS}
+	cd - > /dev/null
+	frame_times ${PGM}
+	report ${PGM}.native
+
+	for PMB in false true ; do
+		for TRIM in "" ${TRIM_FRAMES} ; do
+			NAME=${PGM}.trace
+			[ ${PMB} == "true" ] && NAME=${NAME}.pmb
+			[ -n "${TRIM}" ] && NAME=${NAME}.trim
+			TARGS="--PMB ${PMB}"
+			[ -n "${TRIM}" ] && TARGS="${TARGS} --TraceTrigger ${TRIM}"
+
+			timed_run ${VKTRACE} --Program ${APPDIR}/${PGM} \
+					     --Arguments "--c ${FRAMES} ${PARGS}" \
+					     --WorkingDir ${APPDIR} \
+					     --OutputTrace ${NAME}.vktrace \
+					     ${TARGS}
+			frame_times ${PGM}
+			report ${NAME} $(($(stat -c %s ${NAME}.vktrace 2>/dev/null || echo 0) / 1024))
+
+			timed_run ${VKREPLAY} --Open ${NAME}.vktrace
+			REPLAYED_FRAMES=${FRAMES}
+			[ -n "${TRIM}" ] && REPLAYED_FRAMES=$((FRAMES / 2))
+			FRAME_P50=$(awk "BEGIN { printf \"%.3f\", ${WALL_MS} / ${REPLAYED_FRAMES} }")
+			FRAME_P99=""
+			report ${NAME}.replay
+			rm -f ${NAME}.vktrace
+		done
+	done
+}
+
+benchmark cube "--present_mode 0 --stats"
+benchmark smoketest "--benchmark --seed 0"
+
+if [ ${UPDATE_BASELINE} -eq 1 ] ; then
+	cp ${RESULTS} ${BASELINE}
+	printf "Wrote baseline ${BASELINE}\n"
+elif [ -f ${BASELINE} ] ; then
+	# Print every metric that regressed by more than the tolerance.
+	REGRESSIONS=$(awk -v tolerance=${TOLERANCE} '
+		NR == FNR { baseline[$1 " " $2] = $3; next }
+		($1 " " $2) in baseline {
+			base = baseline[$1 " " $2]
+			if (base > 0 && $3 > base * (1 + tolerance / 100))
+				printf "%s %s: %s, baseline %s (+%.1f%%)\n", $1, $2, $3, base, ($3 / base - 1) * 100
+		}' ${BASELINE} ${RESULTS})
+	if [ -n "${REGRESSIONS}" ] ; then
+		echo "${REGRESSIONS}" | while read LINE ; do
+			printf "$RED[  FAILED  ]$NC %s\n" "${LINE}"
+		done
+		printf "TEST FAILED\n"
+		exit 1
+	fi
+else
+	printf "No baseline ${BASELINE}, run with -u to create it\n"
+fi
+
+printf "$GREEN[  PASSED  ]$NC $0\n"
+exit 0
@@ -31,10 +31,10 @@ function trace_replay {
 			-s 1
 	printf "$GREEN[ REPLAY   ]$NC ${PGM}\n"
 	${VKREPLAY}	--Open ${PGM}.vktrace \
-			-s 1
-	rm -f ${PGM}.vktrace
-	cmp -s 1.ppm ${APPDIR}/1.ppm
+			-s 1 \
+			--CompareGolden ${APPDIR}
 	RES=$?
+	rm -f ${PGM}.vktrace
 	rm 1.ppm ${APPDIR}/1.ppm
 	if [ $RES -eq 0 ] ; then
 	   printf "$GREEN[  PASSED  ]$NC ${PGM}\n"
@@ -21,8 +21,11 @@
 #include <exception>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 #include <time.h>
 #include <inttypes.h>
@@ -69,7 +72,7 @@ struct GlobalItems {
     std::vector<VkDevice> log_devices;
     uint32_t cur_table;
     std::string exe_directory;
-    bool is_odd_row;
+    Json::Value summary;
 
 #ifdef _WIN32
     bool is_wow64;
@@ -135,6 +138,8 @@ int main(int argc, char **argv) {
     char temp[MAX_STRING_LENGTH];
     const char *output_path = NULL;
     bool generate_unique_file = false;
+    bool generate_json = false;
+    std::string json_file_name;
     ErrorResults res = SUCCESSFUL;
     size_t file_name_offset = 0;
 #ifdef _WIN32
@@ -151,10 +156,12 @@ int main(int argc, char **argv) {
             } else if (0 == strcmp("--output_path", argv[iii]) && argc > (iii + 1)) {
                 output_path = argv[iii + 1];
                 ++iii;
+            } else if (0 == strcmp("--json", argv[iii])) {
+                generate_json = true;
             } else {
                 std::cout << "Usage of via.exe:" << std::endl
                           << "    via.exe [--unique_output] "
-                             "[--output_path <path>]"
+                             "[--output_path <path>] [--json]"
                           << std::endl
                           << "          [--unique_output] Optional "
                              "parameter to generate a unique html"
@@ -168,6 +175,12 @@ int main(int argc, char **argv) {
                           << std::endl
                           << "                               "
                              "  a given path"
+                          << std::endl
+                          << "          [--json] Optional parameter to "
+                             "also write a compact JSON summary"
+                          << std::endl
+                          << "                   next to the html output "
+                             "file"
                           << std::endl;
                 return -1;
             }
@@ -224,6 +237,17 @@ int main(int argc, char **argv) {
                       << html_file_name << " or home folder as " << full_file << std::endl;
             goto out;
         }
+        json_file_name = full_file;
+    } else {
+        json_file_name = html_file_name;
+    }
+
+    // The JSON summary has the same name as the HTML file.
+    if (generate_json) {
+        global_items.summary["html_file"] = json_file_name;
+        json_file_name = json_file_name.substr(0, json_file_name.rfind(".html")) + ".json";
+    } else {
+        json_file_name = "";
     }
 
     global_items.cur_table = 0;
@@ -335,6 +359,18 @@ out:
 
     global_items.html_file_stream.close();
 
+    if (!json_file_name.empty()) {
+        std::ofstream json_file_stream(json_file_name.c_str());
+        if (json_file_stream.fail()) {
+            std::cerr << "Error failed opening JSON summary " << json_file_name << std::endl;
+        } else {
+            Json::FastWriter writer;
+            global_items.summary["version"] = APP_VERSION;
+            global_items.summary["result"] = err_val;
+            json_file_stream << writer.write(global_items.summary);
+        }
+    }
+
     return err_val;
 }
 
@@ -474,34 +510,62 @@ void StartOutput(std::string output) {
 // Close out writing to the HTML file.
 void EndOutput() { global_items.html_file_stream << "</BODY>" << std::endl << std::endl << "</HTML>" << std::endl; }
 
+// Parts of the report that are generated on a worker thread are written to
+// their own buffers, which are then appended to the HTML file in order.
+struct ReportSection {
+    std::ostringstream html;
+    Json::Value summary;
+    ErrorResults res;
+};
+
+static thread_local ReportSection *cur_section = nullptr;
+
+// Each thread builds its own tables, so the row style is tracked per thread.
+static thread_local bool is_odd_row = true;
+
+std::ostream &HtmlOutput() {
+    if (nullptr != cur_section) {
+        return cur_section->html;
+    }
+    return global_items.html_file_stream;
+}
+
+// Add an entry to one of the lists in the JSON summary.
+void AddSummaryEntry(const char *list, const Json::Value &entry) {
+    if (nullptr != cur_section) {
+        cur_section->summary[list].append(entry);
+    } else {
+        global_items.summary[list].append(entry);
+    }
+}
+
 void BeginSection(std::string section_str) {
-    global_items.html_file_stream << "    <H1 class=\"section\"><center>" << section_str << "</center></h1>" << std::endl;
+    HtmlOutput() << "    <H1 class=\"section\"><center>" << section_str << "</center></h1>" << std::endl;
 }
 
-void EndSection() { global_items.html_file_stream << "    <BR/>" << std::endl << "    <BR/>" << std::endl; }
+void EndSection() { HtmlOutput() << "    <BR/>" << std::endl << "    <BR/>" << std::endl; }
 
 void PrintStandardText(std::string section) {
-    global_items.html_file_stream << "    <H2><font color=\"White\">" << section << "</font></H2>" << std::endl;
+    HtmlOutput() << "    <H2><font color=\"White\">" << section << "</font></H2>" << std::endl;
 }
 
 void PrintBeginTable(const char *table_name, uint32_t num_cols) {
-    global_items.html_file_stream << "    <table align=\"center\">" << std::endl
-                                  << "        <tr class=\"header\">" << std::endl
-                                  << "            <td colspan=\"" << num_cols << "\" class=\"header\">" << table_name << "</td>"
-                                  << std::endl
-                                  << "         </tr>" << std::endl;
+    HtmlOutput() << "    <table align=\"center\">" << std::endl
+                 << "        <tr class=\"header\">" << std::endl
+                 << "            <td colspan=\"" << num_cols << "\" class=\"header\">" << table_name << "</td>" << std::endl
+                 << "         </tr>" << std::endl;
 
-    global_items.is_odd_row = true;
+    is_odd_row = true;
 }
 
 void PrintBeginTableRow() {
     std::string class_str = "";
-    if (global_items.is_odd_row) {
+    if (is_odd_row) {
         class_str = " class=\"odd\"";
     } else {
         class_str = " class=\"even\"";
     }
-    global_items.html_file_stream << "        <tr" << class_str << ">" << std::endl;
+    HtmlOutput() << "        <tr" << class_str << ">" << std::endl;
 }
 
 void PrintTableElement(std::string element, ElementAlign align = ALIGN_LEFT) {
@@ -512,20 +576,20 @@ void PrintTableElement(std::string element, ElementAlign align = ALIGN_LEFT) {
     } else if (align == ALIGN_CENTER) {
         align_str = " align=\"center\"";
     }
-    if (global_items.is_odd_row) {
+    if (is_odd_row) {
         class_str = " class=\"odd\"";
     } else {
         class_str = " class=\"even\"";
     }
-    global_items.html_file_stream << "            <td" << align_str << class_str << ">" << element << "</td>" << std::endl;
+    HtmlOutput() << "            <td" << align_str << class_str << ">" << element << "</td>" << std::endl;
 }
 
 void PrintEndTableRow() {
-    global_items.html_file_stream << "        </tr>" << std::endl;
-    global_items.is_odd_row = !global_items.is_odd_row;
+    HtmlOutput() << "        </tr>" << std::endl;
+    is_odd_row = !is_odd_row;
 }
 
-void PrintEndTable() { global_items.html_file_stream << "    </table>" << std::endl; }
+void PrintEndTable() { HtmlOutput() << "    </table>" << std::endl; }
 
 // Generate the full library location for a file based on the location of
 // the JSON file referencing it, and the library location contained in that
@@ -2599,6 +2663,21 @@ ErrorResults PrintLayerInfo(void) {
 
 #elif __GNUC__
 
+// Split a colon delimited list of paths, skipping empty entries.  Unlike
+// strtok, this leaves the list (usually an environment variable) untouched,
+// and can be used by several threads at once.
+std::vector<std::string> SplitPathList(const char *path_list) {
+    std::vector<std::string> paths;
+    std::stringstream list_stream(path_list);
+    std::string path;
+    while (std::getline(list_stream, path, ':')) {
+        if (!path.empty()) {
+            paths.push_back(path);
+        }
+    }
+    return paths;
+}
+
 // Utility function to determine if a driver may exist in the folder.
 bool CheckDriver(std::string &folder_loc, std::string &object_name) {
     bool success = false;
@@ -2616,6 +2695,45 @@ bool CheckDriver(std::string &folder_loc, std::string &object_name) {
 // Pointer to a function sed to validate if the system object is found
 typedef bool (*PFN_CheckIfValid)(std::string &folder_loc, std::string &object_name);
 
+typedef ErrorResults (*PFN_PrintSection)(void);
+
+// Generate independent sections of the report at the same time.  The output
+// of each section is appended in the given order, so the report looks the
+// same as if they ran one after the other.  Like the sequential code, the
+// result of the last section is returned.
+ErrorResults PrintSectionsInParallel(const std::vector<PFN_PrintSection> &sections) {
+    ErrorResults res = SUCCESSFUL;
+    std::vector<ReportSection> outputs(sections.size());
+    std::vector<std::thread> threads;
+
+    for (size_t index = 0; index < sections.size(); index++) {
+        ReportSection *output = &outputs[index];
+        PFN_PrintSection section = sections[index];
+        threads.push_back(std::thread([output, section]() {
+            cur_section = output;
+            output->res = section();
+            cur_section = nullptr;
+        }));
+    }
+
+    for (size_t index = 0; index < threads.size(); index++) {
+        threads[index].join();
+
+        HtmlOutput() << outputs[index].html.str();
+        const Json::Value &summary = outputs[index].summary;
+        std::vector<std::string> lists = summary.getMemberNames();
+        for (size_t list = 0; list < lists.size(); list++) {
+            const Json::Value &entries = summary[lists[list]];
+            for (Json::ArrayIndex entry = 0; entry < entries.size(); entry++) {
+                AddSummaryEntry(lists[list].c_str(), entries[entry]);
+            }
+        }
+        res = outputs[index].res;
+    }
+
+    return res;
+}
+
 bool FindLinuxSystemObject(std::string object_name, std::string &location, PFN_CheckIfValid func, bool break_on_first) {
     bool found_one = false;
     std::string path_to_check;
@@ -2668,18 +2786,15 @@ bool FindLinuxSystemObject(std::string object_name, std::string &location, PFN_C
     // LD_LIBRARY_PATH may have multiple folders listed in it (colon
     // ':' delimited)
     if (env_value != NULL) {
-        char *tok = strtok(env_value, ":");
-        while (tok != NULL) {
-            if (strlen(tok) > 0) {
-                path_to_check = tok;
-                if (func(path_to_check, object_name)) {
-                    location = path_to_check + "/" + object_name;
-
-                    // We found one runtime, clear any failures
-                    found_one = true;
-                }
+        std::vector<std::string> ld_paths = SplitPathList(env_value);
+        for (size_t path = 0; path < ld_paths.size(); path++) {
+            path_to_check = ld_paths[path];
+            if (func(path_to_check, object_name)) {
+                location = path_to_check + "/" + object_name;
+
+                // We found one runtime, clear any failures
+                found_one = true;
             }
-            tok = strtok(NULL, ":");
         }
     }
 
@@ -2967,58 +3082,147 @@ ErrorResults PrintSystemInfo(void) {
 
     PrintEndTable();
 
-    // Print out the rest of the useful system information.
-    res = PrintDriverInfo();
-    res = PrintRunTimeInfo();
-    res = PrintSDKInfo();
-    res = PrintLayerInfo();
-    res = PrintLayerSettingsFileInfo();
+    // Print out the rest of the useful system information.  These sections
+    // only look at files and environment variables, so they can be generated
+    // at the same time.
+    std::vector<PFN_PrintSection> sections;
+    sections.push_back(PrintDriverInfo);
+    sections.push_back(PrintRunTimeInfo);
+    sections.push_back(PrintSDKInfo);
+    sections.push_back(PrintLayerInfo);
+    sections.push_back(PrintLayerSettingsFileInfo);
+    res = PrintSectionsInParallel(sections);
     EndSection();
 
     return res;
 }
 
 bool VerifyOpen(std::string library_file, std::string &error) {
-    bool success = false;
-    void *handle = dlopen(library_file.c_str(), RTLD_NOW | RTLD_LOCAL);
-    if (NULL == handle) {
-        error = dlerror();
+    // The same library is often referenced by several manifests, and dlopen
+    // calls are serialized by the dynamic loader anyway, so each library is
+    // only opened once.
+    static std::mutex results_mutex;
+    static std::map<std::string, std::string> results;
+    std::lock_guard<std::mutex> lock(results_mutex);
+
+    std::map<std::string, std::string>::iterator result = results.find(library_file);
+    if (result == results.end()) {
+        std::string open_error;
+        void *handle = dlopen(library_file.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (NULL == handle) {
+            open_error = dlerror();
+        } else {
+            dlclose(handle);
+        }
+        result = results.insert(std::make_pair(library_file, open_error)).first;
+    }
+    error = result->second;
+    return error.empty();
+}
+
+// A JSON manifest.  If the file could not be read or parsed, error says why.
+struct JsonManifest {
+    bool read;
+    bool parsed;
+    Json::Value root;
+    std::string error;
+};
+
+// Read and parse a JSON manifest.  The same manifest is often reached from
+// several sections of the report (for example an SDK folder that is also in
+// VK_LAYER_PATH), so each file is only parsed once.
+const JsonManifest &ReadJsonManifest(const std::string &file_name) {
+    static std::mutex manifests_mutex;
+    static std::map<std::string, JsonManifest> manifests;
+    {
+        std::lock_guard<std::mutex> lock(manifests_mutex);
+        std::map<std::string, JsonManifest>::const_iterator cached = manifests.find(file_name);
+        if (cached != manifests.end()) {
+            return cached->second;
+        }
+    }
+
+    // Parse without holding the lock, so different files are parsed in
+    // parallel.  If two threads race on the same file, the first one wins.
+    JsonManifest manifest = {};
+    std::ifstream stream(file_name.c_str(), std::ifstream::in);
+    if (stream.fail()) {
+        manifest.error = "Unable to read file";
     } else {
-        dlclose(handle);
-        success = true;
+        Json::Reader reader;
+        manifest.read = true;
+        if (!reader.parse(stream, manifest.root, false) || manifest.root.isNull()) {
+            manifest.error = reader.getFormattedErrorMessages();
+        } else {
+            manifest.parsed = true;
+        }
     }
-    return success;
+
+    std::lock_guard<std::mutex> lock(manifests_mutex);
+    return manifests.insert(std::make_pair(file_name, manifest)).first->second;
+}
+
+// Add a layer manifest to the JSON summary.
+void AddLayerSummary(const std::string &file_name, const char *type, const JsonManifest &manifest) {
+    Json::Value entry(Json::objectValue);
+    entry["manifest"] = file_name;
+    entry["type"] = type;
+    entry["valid"] = manifest.parsed;
+    entry["names"] = Json::Value(Json::arrayValue);
+    if (manifest.parsed) {
+        const Json::Value &layer = manifest.root["layer"];
+        const Json::Value &layers = manifest.root["layers"];
+        if (layer.isObject() && layer["name"].isString()) {
+            entry["names"].append(layer["name"]);
+        } else if (layers.isArray()) {
+            for (Json::ArrayIndex index = 0; index < layers.size(); index++) {
+                if (layers[index]["name"].isString()) {
+                    entry["names"].append(layers[index]["name"]);
+                }
+            }
+        }
+    }
+    if (!manifest.error.empty()) {
+        entry["error"] = manifest.error;
+    }
+    AddSummaryEntry("layers", entry);
 }
 
 bool ReadDriverJson(std::string cur_driver_json, bool &found_lib) {
     bool found_json = false;
-    std::ifstream *stream = NULL;
+    const JsonManifest *manifest = NULL;
     Json::Value root = Json::nullValue;
     Json::Value inst_exts = Json::nullValue;
     Json::Value dev_exts = Json::nullValue;
-    Json::Reader reader;
+    Json::Value summary_entry(Json::objectValue);
     char full_driver_path[MAX_STRING_LENGTH];
     char generic_string[MAX_STRING_LENGTH];
     uint32_t j = 0;
 
-    stream = new std::ifstream(cur_driver_json.c_str(), std::ifstream::in);
-    if (nullptr == stream || stream->fail()) {
+    found_lib = false;
+    summary_entry["manifest"] = cur_driver_json;
+
+    manifest = &ReadJsonManifest(cur_driver_json);
+    if (!manifest->read) {
         PrintBeginTableRow();
         PrintTableElement("");
         PrintTableElement("Error reading JSON file");
         PrintTableElement(cur_driver_json);
         PrintEndTableRow();
+        summary_entry["error"] = manifest->error;
         goto out;
     }
 
-    if (!reader.parse(*stream, root, false) || root.isNull()) {
+    if (!manifest->parsed) {
         PrintBeginTableRow();
         PrintTableElement("");
         PrintTableElement("Error reading JSON file");
-        PrintTableElement(reader.getFormattedErrorMessages());
+        PrintTableElement(manifest->error);
         PrintEndTableRow();
+        summary_entry["error"] = manifest->error;
         goto out;
     }
+    root = manifest->root;
 
     PrintBeginTableRow();
     PrintTableElement("");
@@ -3036,6 +3240,7 @@ bool ReadDriverJson(std::string cur_driver_json, bool &found_lib) {
         PrintTableElement("ICD Section");
         PrintTableElement("MISSING!");
         PrintEndTableRow();
+        summary_entry["error"] = "ICD section missing";
         goto out;
     }
 
@@ -3111,6 +3316,13 @@ bool ReadDriverJson(std::string cur_driver_json, bool &found_lib) {
             PrintTableElement(load_error);
             PrintEndTableRow();
         }
+
+        summary_entry["library"] = driver_name;
+        summary_entry["found"] = found_lib;
+        summary_entry["loaded"] = found_lib && could_load;
+        if (!could_load) {
+            summary_entry["error"] = load_error;
+        }
     } else {
         PrintTableElement("MISSING!");
         PrintEndTableRow();
@@ -3171,11 +3383,8 @@ bool ReadDriverJson(std::string cur_driver_json, bool &found_lib) {
 
 out:
 
-    if (nullptr != stream) {
-        stream->close();
-        delete stream;
-        stream = NULL;
-    }
+    summary_entry["valid"] = found_json;
+    AddSummaryEntry("drivers", summary_entry);
 
     return found_json;
 }
@@ -3220,15 +3429,8 @@ ErrorResults PrintDriverInfo(void) {
         drivers_path_index = driver_paths.size();
         // VK_DRIVERS_PATH may have multiple folders listed in it (colon
         // ':' delimited)
-        char *tok = strtok(drivers_env_value, ":");
-        if (tok != NULL) {
-            while (tok != NULL) {
-                driver_paths.push_back(tok);
-                tok = strtok(NULL, ":");
-            }
-        } else {
-            driver_paths.push_back(drivers_env_value);
-        }
+        std::vector<std::string> drivers_env_paths = SplitPathList(drivers_env_value);
+        driver_paths.insert(driver_paths.end(), drivers_env_paths.begin(), drivers_env_paths.end());
     }
 
     // Loop through all folders discovered above.
@@ -3299,42 +3501,21 @@ ErrorResults PrintDriverInfo(void) {
 
         // VK_ICD_FILENAMES may have multiple folders listed in it (colon
         // ':' delimited)
-        char *tok = strtok(icd_env_value, ":");
-        if (tok != NULL) {
-            while (tok != NULL) {
-                if (access(tok, R_OK) != -1) {
-                    PrintBeginTableRow();
-                    PrintTableElement(tok, ALIGN_RIGHT);
-                    PrintTableElement("");
-                    PrintTableElement("");
-                    PrintEndTableRow();
-                    if (ReadDriverJson(tok, found_this_lib)) {
-                        found_json = true;
-                        found_lib |= found_this_lib;
-                    }
-                } else {
-                    PrintBeginTableRow();
-                    PrintTableElement(tok, ALIGN_RIGHT);
-                    PrintTableElement("No such file");
-                    PrintTableElement("");
-                    PrintEndTableRow();
-                }
-                tok = strtok(NULL, ":");
-            }
-        } else {
-            if (access(icd_env_value, R_OK) != -1) {
+        std::vector<std::string> icd_files = SplitPathList(icd_env_value);
+        for (size_t file = 0; file < icd_files.size(); file++) {
+            if (access(icd_files[file].c_str(), R_OK) != -1) {
                 PrintBeginTableRow();
-                PrintTableElement(icd_env_value, ALIGN_RIGHT);
+                PrintTableElement(icd_files[file], ALIGN_RIGHT);
                 PrintTableElement("");
                 PrintTableElement("");
                 PrintEndTableRow();
-                if (ReadDriverJson(icd_env_value, found_this_lib)) {
+                if (ReadDriverJson(icd_files[file], found_this_lib)) {
                     found_json = true;
                     found_lib |= found_this_lib;
                 }
             } else {
                 PrintBeginTableRow();
-                PrintTableElement(icd_env_value, ALIGN_RIGHT);
+                PrintTableElement(icd_files[file], ALIGN_RIGHT);
                 PrintTableElement("No such file");
                 PrintTableElement("");
                 PrintEndTableRow();
@@ -3575,9 +3756,8 @@ ErrorResults PrintExplicitLayersInFolder(std::string &id, std::string &folder_lo
                 cur_layer += cur_ent->d_name;
 
                 // Parse the JSON file
-                std::ifstream *stream = NULL;
-                stream = new std::ifstream(cur_layer, std::ifstream::in);
-                if (nullptr == stream || stream->fail()) {
+                const JsonManifest &manifest = ReadJsonManifest(cur_layer);
+                if (!manifest.read) {
                     PrintBeginTableRow();
                     PrintTableElement("");
                     PrintTableElement(generic_string, ALIGN_RIGHT);
@@ -3585,35 +3765,28 @@ ErrorResults PrintExplicitLayersInFolder(std::string &id, std::string &folder_lo
                     PrintTableElement("ERROR reading JSON file!");
                     PrintEndTableRow();
                     res = MISSING_LAYER_JSON;
+                } else if (!manifest.parsed) {
+                    // Report to the user the failure and their
+                    // locations in the document.
+                    PrintBeginTableRow();
+                    PrintTableElement("");
+                    PrintTableElement(generic_string, ALIGN_RIGHT);
+                    PrintTableElement(cur_ent->d_name);
+                    PrintTableElement(manifest.error);
+                    PrintEndTableRow();
+                    res = LAYER_JSON_PARSING_ERROR;
                 } else {
-                    Json::Value root = Json::nullValue;
-                    Json::Reader reader;
-                    if (!reader.parse(*stream, root, false) || root.isNull()) {
-                        // Report to the user the failure and their
-                        // locations in the document.
-                        PrintBeginTableRow();
-                        PrintTableElement("");
-                        PrintTableElement(generic_string, ALIGN_RIGHT);
-                        PrintTableElement(cur_ent->d_name);
-                        PrintTableElement(reader.getFormattedErrorMessages());
-                        PrintEndTableRow();
-                        res = LAYER_JSON_PARSING_ERROR;
-                    } else {
-                        PrintBeginTableRow();
-                        PrintTableElement("");
-                        PrintTableElement(generic_string, ALIGN_RIGHT);
-                        PrintTableElement(cur_ent->d_name);
-                        PrintTableElement("");
-                        PrintEndTableRow();
-
-                        // Dump out the standard explicit layer information.
-                        PrintExplicitLayerJsonInfo(cur_layer.c_str(), root);
-                    }
+                    PrintBeginTableRow();
+                    PrintTableElement("");
+                    PrintTableElement(generic_string, ALIGN_RIGHT);
+                    PrintTableElement(cur_ent->d_name);
+                    PrintTableElement("");
+                    PrintEndTableRow();
 
-                    stream->close();
-                    delete stream;
-                    stream = NULL;
+                    // Dump out the standard explicit layer information.
+                    PrintExplicitLayerJsonInfo(cur_layer.c_str(), manifest.root);
                 }
+                AddLayerSummary(cur_layer, "explicit", manifest);
             }
         }
         if (!found_json) {
@@ -3775,9 +3948,8 @@ ErrorResults PrintLayerInfo(void) {
                     PrintTableElement("");
                     PrintEndTableRow();
 
-                    std::ifstream *stream = NULL;
-                    stream = new std::ifstream(cur_vulkan_layer_json, std::ifstream::in);
-                    if (nullptr == stream || stream->fail()) {
+                    const JsonManifest &manifest = ReadJsonManifest(cur_vulkan_layer_json);
+                    if (!manifest.read) {
                         PrintBeginTableRow();
                         PrintTableElement("");
                         PrintTableElement("ERROR reading JSON file!");
@@ -3785,27 +3957,20 @@ ErrorResults PrintLayerInfo(void) {
                         PrintTableElement("");
                         PrintEndTableRow();
                         res = MISSING_LAYER_JSON;
+                    } else if (!manifest.parsed) {
+                        // Report to the user the failure and their
+                        // locations in the document.
+                        PrintBeginTableRow();
+                        PrintTableElement("");
+                        PrintTableElement("ERROR parsing JSON file!");
+                        PrintTableElement(manifest.error);
+                        PrintTableElement("");
+                        PrintEndTableRow();
+                        res = LAYER_JSON_PARSING_ERROR;
                     } else {
-                        Json::Value root = Json::nullValue;
-                        Json::Reader reader;
-                        if (!reader.parse(*stream, root, false) || root.isNull()) {
-                            // Report to the user the failure and their
-                            // locations in the document.
-                            PrintBeginTableRow();
-                            PrintTableElement("");
-                            PrintTableElement("ERROR parsing JSON file!");
-                            PrintTableElement(reader.getFormattedErrorMessages());
-                            PrintTableElement("");
-                            PrintEndTableRow();
-                            res = LAYER_JSON_PARSING_ERROR;
-                        } else {
-                            PrintImplicitLayerJsonInfo(cur_vulkan_layer_json, root, override_search_paths);
-                        }
-
-                        stream->close();
-                        delete stream;
-                        stream = NULL;
+                        PrintImplicitLayerJsonInfo(cur_vulkan_layer_json, manifest.root, override_search_paths);
                     }
+                    AddLayerSummary(cur_vulkan_layer_json, "implicit", manifest);
                 }
             }
             closedir(layer_dir);
@@ -3840,10 +4005,8 @@ ErrorResults PrintLayerInfo(void) {
 
     // Look at the VK_LAYER_PATH environment variable paths if it is set.
     env_value = getenv("VK_LAYER_PATH");
-    std::string cur_json;
     if (NULL != env_value) {
-        char *tok = strtok(env_value, ":");
-        explicit_layer_id = "VK_LAYER_PATH";
+        std::vector<std::string> layer_env_paths = SplitPathList(env_value);
 
         PrintBeginTableRow();
         PrintTableElement("VK_LAYER_PATH");
@@ -3852,20 +4015,12 @@ ErrorResults PrintLayerInfo(void) {
         PrintTableElement("");
         PrintEndTableRow();
 
-        if (NULL != tok) {
-            uint32_t offset = 0;
-            std::stringstream cur_name;
-            while (NULL != tok) {
-                cur_json = tok;
-                cur_name.str("");
-                cur_name << "Path " << offset++;
-                explicit_layer_id = cur_name.str();
-                res = PrintExplicitLayersInFolder(explicit_layer_id, cur_json);
-                tok = strtok(NULL, ":");
-            }
-        } else {
-            cur_json = env_value;
-            res = PrintExplicitLayersInFolder(explicit_layer_id, cur_json);
+        std::stringstream cur_name;
+        for (size_t path = 0; path < layer_env_paths.size(); path++) {
+            cur_name.str("");
+            cur_name << "Path " << path;
+            explicit_layer_id = cur_name.str();
+            res = PrintExplicitLayersInFolder(explicit_layer_id, layer_env_paths[path]);
         }
     }
 
@@ -4430,7 +4585,8 @@ static bool checkExpiration(struct override_expiration expiration) {
     minute = static_cast<uint8_t>(cur_time.wMinute);
 #else
     time_t t = time(NULL);
-    struct tm tm = *localtime(&t);
+    struct tm tm;
+    localtime_r(&t, &tm);
     year = tm.tm_year + 1900;
     month = tm.tm_mon + 1;
     day = tm.tm_mday;
@@ -4830,6 +4986,16 @@ ErrorResults PrintPhysDevInfo(void) {
             PrintTableElement("");
             PrintEndTableRow();
 
+            Json::Value device(Json::objectValue);
+            device["name"] = props.deviceName;
+            device["vendor_id"] = props.vendorID;
+            device["device_id"] = props.deviceID;
+            device["driver_version"] = props.driverVersion;
+            snprintf(generic_string, MAX_STRING_LENGTH - 1, "%d.%d.%d", VK_VERSION_MAJOR(props.apiVersion),
+                     VK_VERSION_MINOR(props.apiVersion), VK_VERSION_PATCH(props.apiVersion));
+            device["api_version"] = generic_string;
+            AddSummaryEntry("devices", device);
+
             PrintBeginTableRow();
             PrintTableElement("");
             PrintTableElement("Device ID");
@@ -5275,6 +5441,20 @@ void PrintCleanupInfo(void) {
 
 // Run any external tests we can find, and print the results of those
 // tests.
+// Add the result of RunTestInDirectory to the JSON summary.
+void AddTestSummary(const std::string &command, int test_result) {
+    Json::Value entry(Json::objectValue);
+    entry["command"] = command;
+    if (test_result == 0) {
+        entry["result"] = "SUCCESSFUL";
+    } else if (test_result == 1) {
+        entry["result"] = "Not Found";
+    } else {
+        entry["result"] = "FAILED";
+    }
+    AddSummaryEntry("tests", entry);
+}
+
 ErrorResults PrintTestResults(void) {
     ErrorResults res = SUCCESSFUL;
 
@@ -5304,6 +5484,7 @@ ErrorResults PrintTestResults(void) {
         PrintBeginTableRow();
         PrintTableElement(full_cmd);
         int test_result = RunTestInDirectory(path, cube_exe, full_cmd);
+        AddTestSummary(full_cmd, test_result);
         if (test_result == 0) {
             PrintTableElement("SUCCESSFUL");
         } else if (test_result == 1) {
@@ -5319,6 +5500,7 @@ ErrorResults PrintTestResults(void) {
         PrintBeginTableRow();
         PrintTableElement(full_cmd);
         test_result = RunTestInDirectory(path, cube_exe, full_cmd);
+        AddTestSummary(full_cmd, test_result);
         if (test_result == 0) {
             PrintTableElement("SUCCESSFUL");
         } else if (test_result == 1) {
@@ -0,0 +1,349 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "vktrace_blob_store.h"
+#include "vktrace_pageguard_memorycopy.h"
+#include "vktrace_platform.h"
+#include "vktrace_trace_packet_utils.h"
+
+#include <inttypes.h>
+
+#define BLOB_ID_NONE UINT64_MAX
+
+// A payload the tracer has seen, id is BLOB_ID_NONE until it has been seen twice. Unused slots have a size of 0.
+typedef struct BlobEntry {
+    uint64_t hash0;
+    uint64_t hash1;
+    uint64_t size;
+    uint64_t id;
+} BlobEntry;
+
+typedef struct StoredBlob {
+    void* pData;
+    uint64_t size;
+} StoredBlob;
+
+static BOOL s_initialized = FALSE;
+static VKTRACE_CRITICAL_SECTION s_blobLock;
+
+// Tracing, an open addressed hash table of the payloads seen so far
+static BOOL s_tracing = FALSE;
+static FileLike* s_pBlobFile = NULL;
+static BlobEntry* s_pEntries = NULL;
+static uint64_t s_entryCapacity = 0;
+static uint64_t s_entryCount = 0;
+static uint64_t s_nextBlobId = 0;
+
+// Reading, the payloads by blob id
+static StoredBlob* s_pBlobs = NULL;
+static uint64_t s_blobCapacity = 0;
+static uint64_t s_blobCount = 0;
+
+// ------------------------------------------------------------------------------------------------
+static uint64_t vktrace_blob_rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+// ------------------------------------------------------------------------------------------------
+static uint64_t vktrace_blob_fmix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+// ------------------------------------------------------------------------------------------------
+// MurmurHash3 x64_128. Together with the size, 128 bits of hash are what a payload is known by,
+// the tracer doesn't keep the payloads to compare them.
+void vktrace_blob_hash(const void* pData, uint64_t size, uint64_t* pHash0, uint64_t* pHash1) {
+    const uint64_t c1 = 0x87c37b91114253d5ULL;
+    const uint64_t c2 = 0x4cf5ad432745937fULL;
+    const uint8_t* pBytes = (const uint8_t*)pData;
+    uint64_t h0 = 0;
+    uint64_t h1 = 0;
+    uint64_t k0, k1;
+    uint64_t i;
+
+    for (i = 0; i + 16 <= size; i += 16) {
+        memcpy(&k0, pBytes + i, sizeof(k0));
+        memcpy(&k1, pBytes + i + 8, sizeof(k1));
+
+        k0 *= c1;
+        k0 = vktrace_blob_rotl64(k0, 31);
+        k0 *= c2;
+        h0 ^= k0;
+        h0 = vktrace_blob_rotl64(h0, 27);
+        h0 += h1;
+        h0 = h0 * 5 + 0x52dce729;
+
+        k1 *= c2;
+        k1 = vktrace_blob_rotl64(k1, 33);
+        k1 *= c1;
+        h1 ^= k1;
+        h1 = vktrace_blob_rotl64(h1, 31);
+        h1 += h0;
+        h1 = h1 * 5 + 0x38495ab5;
+    }
+
+    if (i < size) {
+        uint8_t tail[16] = {0};
+        memcpy(tail, pBytes + i, (size_t)(size - i));
+        memcpy(&k0, tail, sizeof(k0));
+        memcpy(&k1, tail + 8, sizeof(k1));
+
+        k1 *= c2;
+        k1 = vktrace_blob_rotl64(k1, 33);
+        k1 *= c1;
+        h1 ^= k1;
+
+        k0 *= c1;
+        k0 = vktrace_blob_rotl64(k0, 31);
+        k0 *= c2;
+        h0 ^= k0;
+    }
+
+    h0 ^= size;
+    h1 ^= size;
+    h0 += h1;
+    h1 += h0;
+    h0 = vktrace_blob_fmix64(h0);
+    h1 = vktrace_blob_fmix64(h1);
+    h0 += h1;
+    h1 += h0;
+
+    *pHash0 = h0;
+    *pHash1 = h1;
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_blob_store_initialize() {
+    if (s_initialized) return;
+
+    vktrace_create_critical_section(&s_blobLock);
+    s_initialized = TRUE;
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_blob_store_deinitialize() {
+    uint64_t i;
+
+    if (!s_initialized) return;
+
+    vktrace_blob_store_stop_tracing();
+    for (i = 0; i < s_blobCount; i++) {
+        vktrace_free(s_pBlobs[i].pData);
+    }
+    vktrace_free(s_pBlobs);
+    s_pBlobs = NULL;
+    s_blobCapacity = 0;
+    s_blobCount = 0;
+
+    vktrace_delete_critical_section(&s_blobLock);
+    s_initialized = FALSE;
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_blob_store_start_tracing(FileLike* pFile) {
+    assert(s_initialized);
+
+    vktrace_enter_critical_section(&s_blobLock);
+    s_pBlobFile = pFile;
+    s_tracing = TRUE;
+    vktrace_leave_critical_section(&s_blobLock);
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_blob_store_stop_tracing() {
+    if (!s_initialized) return;
+
+    vktrace_enter_critical_section(&s_blobLock);
+    if (s_tracing) {
+        vktrace_LogVerbose("Blob store: %" PRIu64 " payloads traced, %" PRIu64 " of them repeated.", s_entryCount, s_nextBlobId);
+    }
+    s_tracing = FALSE;
+    s_pBlobFile = NULL;
+    vktrace_free(s_pEntries);
+    s_pEntries = NULL;
+    s_entryCapacity = 0;
+    s_entryCount = 0;
+    s_nextBlobId = 0;
+    vktrace_leave_critical_section(&s_blobLock);
+}
+
+// ------------------------------------------------------------------------------------------------
+BOOL vktrace_blob_store_is_tracing() { return s_tracing; }
+
+// ------------------------------------------------------------------------------------------------
+// Returns the entry of the payload, or the unused slot it should go in
+static BlobEntry* vktrace_blob_store_find_entry(BlobEntry* pEntries, uint64_t capacity, uint64_t hash0, uint64_t hash1,
+                                                uint64_t size) {
+    uint64_t slot = hash0 & (capacity - 1);
+    for (;;) {
+        BlobEntry* pEntry = &pEntries[slot];
+        if (pEntry->size == 0 || (pEntry->hash0 == hash0 && pEntry->hash1 == hash1 && pEntry->size == size)) {
+            return pEntry;
+        }
+        slot = (slot + 1) & (capacity - 1);
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+// Keeps the table at most half full. Returns FALSE if there was no memory for it to grow.
+static BOOL vktrace_blob_store_reserve_entry() {
+    uint64_t capacity = s_entryCapacity > 0 ? s_entryCapacity * 2 : 1024;
+    BlobEntry* pEntries;
+    uint64_t i;
+
+    if ((s_entryCount + 1) * 2 <= s_entryCapacity) {
+        return TRUE;
+    }
+
+    pEntries = (BlobEntry*)vktrace_malloc((size_t)(capacity * sizeof(BlobEntry)));
+    if (pEntries == NULL) {
+        return FALSE;
+    }
+    memset(pEntries, 0, (size_t)(capacity * sizeof(BlobEntry)));
+    for (i = 0; i < s_entryCapacity; i++) {
+        if (s_pEntries[i].size != 0) {
+            *vktrace_blob_store_find_entry(pEntries, capacity, s_pEntries[i].hash0, s_pEntries[i].hash1, s_pEntries[i].size) =
+                s_pEntries[i];
+        }
+    }
+    vktrace_free(s_pEntries);
+    s_pEntries = pEntries;
+    s_entryCapacity = capacity;
+    return TRUE;
+}
+
+// ------------------------------------------------------------------------------------------------
+static void vktrace_blob_store_send_blob(uint64_t id, uint64_t size, const void* pBuffer) {
+    vktrace_trace_packet_header* pHeader =
+        vktrace_create_trace_packet(VKTRACE_TID_VULKAN, VKTRACE_TPI_BLOB, sizeof(vktrace_blob_packet), ROUNDUP_TO_4(size));
+    vktrace_blob_packet* pBlob = (vktrace_blob_packet*)pHeader->pBody;
+    void* pPayload = vktrace_trace_packet_get_new_buffer_address(pHeader, ROUNDUP_TO_4(size));
+
+    pBlob->id = id;
+    pBlob->size = size;
+    vktrace_pageguard_memcpy(pPayload, pBuffer, (size_t)size);
+    vktrace_finalize_trace_packet(pHeader);
+    vktrace_submit_trace_packet(&pHeader, s_pBlobFile);
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_add_blob_to_trace_packet(vktrace_trace_packet_header* pHeader, void** ptr_address, uint64_t size,
+                                      const void* pBuffer) {
+    uint64_t hash0, hash1;
+    uint64_t id = BLOB_ID_NONE;
+    BlobEntry* pEntry;
+
+    assert(ptr_address != NULL);
+    assert((size & 0x3) == 0);
+
+    if (!s_tracing || pBuffer == NULL || size < VKTRACE_BLOB_MIN_SIZE) {
+        vktrace_add_buffer_to_trace_packet(pHeader, ptr_address, size, pBuffer);
+        return;
+    }
+
+    vktrace_blob_hash(pBuffer, size, &hash0, &hash1);
+
+    // The blob packet has to be queued before any packet referencing it, so it is sent with the lock held
+    vktrace_enter_critical_section(&s_blobLock);
+    if (s_tracing && vktrace_blob_store_reserve_entry()) {
+        pEntry = vktrace_blob_store_find_entry(s_pEntries, s_entryCapacity, hash0, hash1, size);
+        if (pEntry->size == 0) {
+            pEntry->hash0 = hash0;
+            pEntry->hash1 = hash1;
+            pEntry->size = size;
+            pEntry->id = BLOB_ID_NONE;
+            s_entryCount++;
+        } else {
+            // References have to fit in a pointer
+            if (pEntry->id == BLOB_ID_NONE && VKTRACE_BLOB_REFERENCE(s_nextBlobId) <= UINTPTR_MAX) {
+                pEntry->id = s_nextBlobId++;
+                vktrace_blob_store_send_blob(pEntry->id, size, pBuffer);
+            }
+            id = pEntry->id;
+        }
+    }
+    vktrace_leave_critical_section(&s_blobLock);
+
+    if (id == BLOB_ID_NONE) {
+        vktrace_add_buffer_to_trace_packet(pHeader, ptr_address, size, pBuffer);
+    } else {
+        *ptr_address = (void*)(uintptr_t)VKTRACE_BLOB_REFERENCE(id);
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+BOOL vktrace_blob_store_add_packet(const vktrace_trace_packet_header* pHeader) {
+    const vktrace_blob_packet* pBlob = (const vktrace_blob_packet*)pHeader->pBody;
+    BOOL result = TRUE;
+
+    assert(s_initialized);
+    assert(pHeader->packet_id == VKTRACE_TPI_BLOB);
+
+    if (pHeader->size < sizeof(vktrace_trace_packet_header) + sizeof(vktrace_blob_packet) ||
+        pBlob->size > pHeader->size - sizeof(vktrace_trace_packet_header) - sizeof(vktrace_blob_packet)) {
+        vktrace_LogError("Blob packet %" PRIu64 " is corrupt.", pHeader->global_packet_index);
+        return FALSE;
+    }
+
+    vktrace_enter_critical_section(&s_blobLock);
+    if (pBlob->id < s_blobCount) {
+        // Seen before, when replay went around a loop
+    } else if (pBlob->id > s_blobCount) {
+        // Ids are handed out in the order the blob packets are written
+        vktrace_LogError("Blob packet %" PRIu64 " is out of order.", pHeader->global_packet_index);
+        result = FALSE;
+    } else {
+        void* pData = NULL;
+        if (s_blobCount == s_blobCapacity) {
+            uint64_t capacity = s_blobCapacity > 0 ? s_blobCapacity * 2 : 256;
+            StoredBlob* pBlobs = (StoredBlob*)vktrace_realloc(s_pBlobs, (size_t)(capacity * sizeof(StoredBlob)));
+            if (pBlobs != NULL) {
+                s_pBlobs = pBlobs;
+                s_blobCapacity = capacity;
+            }
+        }
+        if (s_blobCount < s_blobCapacity) {
+            pData = vktrace_malloc((size_t)pBlob->size);
+        }
+        if (pData != NULL) {
+            memcpy(pData, pBlob + 1, (size_t)pBlob->size);
+            s_pBlobs[s_blobCount].pData = pData;
+            s_pBlobs[s_blobCount].size = pBlob->size;
+            s_blobCount++;
+        } else {
+            vktrace_LogError("Out of memory for the payload of blob packet %" PRIu64 ".", pHeader->global_packet_index);
+            result = FALSE;
+        }
+    }
+    vktrace_leave_critical_section(&s_blobLock);
+    return result;
+}
+
+// ------------------------------------------------------------------------------------------------
+const void* vktrace_blob_store_get(uint64_t id) {
+    const void* pData = NULL;
+
+    if (!s_initialized) return NULL;
+
+    vktrace_enter_critical_section(&s_blobLock);
+    if (id < s_blobCount) {
+        pData = s_pBlobs[id].pData;
+    }
+    vktrace_leave_critical_section(&s_blobLock);
+    return pData;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  Blob store
+//
+//     Applications tend to hand the same large payloads to the driver over and over: shader code
+//     for pipelines that get rebuilt, mapped memory that is flushed again with the same contents.
+//     The blob store keeps each payload that repeats in the trace only once.
+//
+//     While tracing, vktrace_add_blob_to_trace_packet() hashes the payloads of at least
+//     VKTRACE_BLOB_MIN_SIZE bytes it is given. The first time a payload comes up it is added to the
+//     packet like any other buffer. The second time, it is sent in a VKTRACE_TPI_BLOB packet of its
+//     own ahead of the packet that uses it, and from then on packets only hold a reference to the
+//     blob where the payload would have been. Payloads that never repeat never become blobs, so
+//     readers don't have to hold on to them.
+//
+//     Readers hand each VKTRACE_TPI_BLOB packet to vktrace_blob_store_add_packet() in the order
+//     they come across them, and vktrace_trace_packet_interpret_buffer_pointer() turns references
+//     into pointers to the payload kept in the store, which every packet using it shares. Stored
+//     payloads must not be modified.
+
+#pragma once
+
+#include "vktrace_common.h"
+#include "vktrace_filelike.h"
+#include "vktrace_trace_packet_identifiers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Smaller payloads are always added to the packet
+#define VKTRACE_BLOB_MIN_SIZE 4096
+
+// Buffer offsets in packets are multiples of 4, so a set low bit marks a reference to a blob.
+// The blob's id is in the bits above the lowest two.
+#define VKTRACE_BLOB_REFERENCE_BIT 0x1
+#define VKTRACE_BLOB_REFERENCE(_id) ((((uint64_t)(_id)) << 2) | VKTRACE_BLOB_REFERENCE_BIT)
+#define VKTRACE_BLOB_REFERENCE_ID(_ref) (((uint64_t)(_ref)) >> 2)
+
+// Body of a VKTRACE_TPI_BLOB packet, the payload follows it. Ids count up from 0 in each trace file.
+typedef struct {
+    ALIGN8 uint64_t id;
+    ALIGN8 uint64_t size;
+} vktrace_blob_packet;
+
+void vktrace_blob_store_initialize();
+void vktrace_blob_store_deinitialize();
+
+// Tracing
+
+// Starts deduplicating the payloads given to vktrace_add_blob_to_trace_packet, blob packets are
+// written to pFile.
+void vktrace_blob_store_start_tracing(FileLike* pFile);
+void vktrace_blob_store_stop_tracing();
+BOOL vktrace_blob_store_is_tracing();
+
+// Same as vktrace_add_buffer_to_trace_packet, for payloads that are only read once they are in the
+// packet. *ptr_address may be set to a blob reference, which vktrace_finalize_buffer_address keeps.
+void vktrace_add_blob_to_trace_packet(vktrace_trace_packet_header* pHeader, void** ptr_address, uint64_t size,
+                                      const void* pBuffer);
+
+// 128 bit hash of size bytes at pData, the one payloads are known by
+void vktrace_blob_hash(const void* pData, uint64_t size, uint64_t* pHash0, uint64_t* pHash1);
+
+// Reading
+
+// Keeps a copy of the payload of a VKTRACE_TPI_BLOB packet. Returns FALSE if the packet is corrupt.
+BOOL vktrace_blob_store_add_packet(const vktrace_trace_packet_header* pHeader);
+
+// Returns the payload of the blob, or NULL if its packet hasn't been added
+const void* vktrace_blob_store_get(uint64_t id);
+
+#ifdef __cplusplus
+}
+#endif
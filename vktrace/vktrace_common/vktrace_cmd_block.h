@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  Command blocks
+//
+//     Recording a command buffer is a long run of small vkCmd* calls, and as packets of their own
+//     each of them carries a full packet header and packet struct around a few bytes of
+//     parameters. A VKTRACE_TPI_CMD_BLOCK packet holds a run of consecutive vkCmd* calls the same
+//     thread made on the same command buffer, as a stream of entries:
+//
+//         uint16_t opcode    VKTRACE_TPI_VK_vkCmd* id of the call
+//         uint16_t size      size of the fields that follow, in 4 byte words
+//         fields             the parameters after commandBuffer, in order
+//
+//     Scalars, enums, handles and static arrays are stored by value, arrays and single structs
+//     passed by pointer are stored inline. Every field is padded to a multiple of 4 bytes. Only
+//     calls whose parameters are all plain data go in blocks, the other vkCmd* calls are traced as
+//     packets of their own after the block holding the calls made before them.
+//
+//     The encoding of each call is generated along with its trace hook and its replay, see
+//     GetCmdBlockFields in vktrace_file_generator.py.
+
+#pragma once
+
+#include <string.h>
+#include "vulkan/vulkan.h"
+#include "vktrace_common.h"
+#include "vktrace_trace_packet_identifiers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Blocks are written out before their stream grows past this
+#define VKTRACE_CMD_BLOCK_MAX_STREAM_SIZE (64 * 1024)
+
+#define VKTRACE_CMD_BLOCK_ENTRY_HEADER_SIZE 4
+
+// Space a field of _size bytes takes in the stream
+#define VKTRACE_CMD_BLOCK_FIELD_SIZE(_size) ROUNDUP_TO_4(_size)
+
+// Body of a VKTRACE_TPI_CMD_BLOCK packet, the stream follows it. The first two members are the
+// same as in the packets of the vkCmd* calls.
+typedef struct {
+    vktrace_trace_packet_header* header;
+    VkCommandBuffer commandBuffer;
+    uint32_t commandCount;
+    uint32_t streamSize;
+} vktrace_cmd_block;
+
+static uint8_t* vktrace_cmd_block_stream(const vktrace_cmd_block* pBlock) { return (uint8_t*)(pBlock + 1); }
+
+// Writing
+
+typedef struct {
+    uint8_t* pStream;
+    uint32_t offset;
+} vktrace_cmd_block_writer;
+
+static void vktrace_cmd_block_put(vktrace_cmd_block_writer* pWriter, const void* pData, size_t size) {
+    uint8_t* pDst = pWriter->pStream + pWriter->offset;
+    if (size > 0) {
+        memcpy(pDst, pData, size);
+    }
+    memset(pDst + size, 0, VKTRACE_CMD_BLOCK_FIELD_SIZE(size) - size);
+    pWriter->offset += (uint32_t)VKTRACE_CMD_BLOCK_FIELD_SIZE(size);
+}
+
+// Reading
+
+typedef struct {
+    const uint8_t* pStream;
+    uint32_t streamSize;
+    uint32_t offset;
+    uint32_t entryEnd;
+    BOOL corrupt;
+} vktrace_cmd_block_reader;
+
+static void vktrace_cmd_block_reader_init(vktrace_cmd_block_reader* pReader, const vktrace_cmd_block* pBlock) {
+    pReader->pStream = vktrace_cmd_block_stream(pBlock);
+    pReader->streamSize = pBlock->streamSize;
+    pReader->offset = 0;
+    pReader->entryEnd = 0;
+    pReader->corrupt = FALSE;
+}
+
+// Moves on to the next entry. Returns FALSE at the end of the stream, or if the entry runs past it,
+// in which case corrupt is set.
+static BOOL vktrace_cmd_block_next(vktrace_cmd_block_reader* pReader, uint16_t* pOpcode) {
+    uint16_t entryHeader[2];
+    pReader->offset = pReader->entryEnd;
+    if (pReader->offset == pReader->streamSize) {
+        return FALSE;
+    }
+    if (pReader->streamSize - pReader->offset < VKTRACE_CMD_BLOCK_ENTRY_HEADER_SIZE) {
+        pReader->corrupt = TRUE;
+        return FALSE;
+    }
+    memcpy(entryHeader, pReader->pStream + pReader->offset, sizeof(entryHeader));
+    pReader->offset += VKTRACE_CMD_BLOCK_ENTRY_HEADER_SIZE;
+    if ((uint32_t)entryHeader[1] * 4 > pReader->streamSize - pReader->offset) {
+        pReader->corrupt = TRUE;
+        return FALSE;
+    }
+    pReader->entryEnd = pReader->offset + (uint32_t)entryHeader[1] * 4;
+    *pOpcode = entryHeader[0];
+    return TRUE;
+}
+
+static void vktrace_cmd_block_get(vktrace_cmd_block_reader* pReader, void* pDst, size_t size) {
+    if (VKTRACE_CMD_BLOCK_FIELD_SIZE(size) > pReader->entryEnd - pReader->offset) {
+        pReader->corrupt = TRUE;
+        memset(pDst, 0, size);
+        return;
+    }
+    memcpy(pDst, pReader->pStream + pReader->offset, size);
+    pReader->offset += (uint32_t)VKTRACE_CMD_BLOCK_FIELD_SIZE(size);
+}
+
+// Returns a pointer to an array of size bytes in the stream, or NULL if size is 0.
+static const void* vktrace_cmd_block_get_array(vktrace_cmd_block_reader* pReader, size_t size) {
+    const void* pData = pReader->pStream + pReader->offset;
+    if (VKTRACE_CMD_BLOCK_FIELD_SIZE(size) > pReader->entryEnd - pReader->offset) {
+        pReader->corrupt = TRUE;
+        return NULL;
+    }
+    pReader->offset += (uint32_t)VKTRACE_CMD_BLOCK_FIELD_SIZE(size);
+    return size > 0 ? pData : NULL;
+}
+
+// Returns TRUE if the fields read so far are exactly those of the current entry
+static BOOL vktrace_cmd_block_entry_done(const vktrace_cmd_block_reader* pReader) {
+    return !pReader->corrupt && pReader->offset == pReader->entryEnd;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -92,6 +92,32 @@
 // primary use is for debugging the trace layer.
 #define _VKTRACE_PMB_TARGET_RANGE_SIZE_ENV "_VKTRACE_PMB_TARGET_RANGE_SIZE"
 
+// VKTRACE_PMB_TRACKING env var selects how the trace layer finds out
+// which pages of mapped memory were written to on Linux. If it is
+// "softdirty", the soft-dirty bits in /proc/self/pagemap are read at
+// every flush. If it is "userfaultfd", or undefined, mapped memory is
+// write-protected with userfaultfd and the first write to a page is
+// reported to a handler thread. When userfaultfd write-protection isn't
+// available the soft-dirty bits are used.
+#define VKTRACE_PMB_TRACKING_ENV "VKTRACE_PMB_TRACKING"
+
+// VKTRACE_PMB_BLOCK_SIZE env var sets the size of the blocks writes to
+// mapped memory are tracked in, a power of two of at least the page
+// size. Larger blocks take one write fault each instead of one per page,
+// at the cost of saving more unchanged data. It only applies to
+// userfaultfd tracking, the other methods always track pages.
+#define VKTRACE_PMB_BLOCK_SIZE_ENV "VKTRACE_PMB_BLOCK_SIZE"
+
+// VKTRACE_PMB_HUGE_PAGES env var, when set to 1, asks for the copies of
+// mapped memory handed to the application to be backed by transparent
+// huge pages on Linux, when they are at least a huge page large.
+#define VKTRACE_PMB_HUGE_PAGES_ENV "VKTRACE_PMB_HUGE_PAGES"
+
+// VKTRACE_PMB_PARALLEL_COPY_SIZE env var sets the size in bytes from
+// which copies of mapped memory are split across worker threads. When it
+// isn't set the size is measured once when the workers start.
+#define VKTRACE_PMB_PARALLEL_COPY_SIZE_ENV "VKTRACE_PMB_PARALLEL_COPY_SIZE"
+
 // VKTRACE_PAGEGUARD_ENABLE_READ_PMB env var enables read PMB support.
 // It is only supported on Windows. If PMB data changes comes from the
 // GPU side, PMB tracking does not usually capture those changes. This
@@ -106,11 +132,93 @@
 // processing to fix missed pmb writes.
 #define VKTRACE_PAGEGUARD_ENABLE_READ_POST_PROCESS_ENV "VKTRACE_PAGEGUARD_ENABLE_READ_POST_PROCESS"
 
+// VKTRACE_PAGEGUARD_ENABLE_PAGE_DIFF env var enables page diffing. PMB
+// tracking normally saves every dirty page in full. With page diffing
+// the trace layer keeps a copy of each mapped memory as of the last
+// flush and only saves the ranges of a dirty page that really changed,
+// at the cost of doubling the host memory used for mapped memory.
+#define VKTRACE_PAGEGUARD_ENABLE_PAGE_DIFF_ENV "VKTRACE_PAGEGUARD_ENABLE_PAGE_DIFF"
+
+// VKTRACE_PAGEGUARD_ENABLE_ADAPTIVE_FLUSH env var enables hashing of
+// mapped memory that PMB tracking doesn't cover, such as memory smaller
+// than the PMB target range size, so flushes only save the parts that
+// changed since the last flush instead of the whole range.
+#define VKTRACE_PAGEGUARD_ENABLE_ADAPTIVE_FLUSH_ENV "VKTRACE_PAGEGUARD_ENABLE_ADAPTIVE_FLUSH"
+
 // VKTRACE_TRIM_TRIGGER env var is set by the vktrace program to
 // communicate the --TraceTrigger command line argument to the
 // trace layer.
 #define VKTRACE_TRIM_TRIGGER_ENV "VKTRACE_TRIM_TRIGGER"
 
+// VKTRACE_TRIM_COMPACT env var makes the trim state tracker of the trace
+// layer drop what a trimmed trace can't need any more if the value is 1,
+// and share identical shader code. The env var is set by the vktrace
+// program to communicate the --TrimCompact arg value to the trace layer.
+#define VKTRACE_TRIM_COMPACT_ENV "VKTRACE_TRIM_COMPACT"
+
+// VKTRACE_TRIM_WINDOWS env var lets a hotkey or port trim trigger start
+// another trim window after the last one stopped if the value is 1. The
+// env var is set by the vktrace program to communicate the --TrimWindows
+// arg value to the trace layer.
+#define VKTRACE_TRIM_WINDOWS_ENV "VKTRACE_TRIM_WINDOWS"
+
+// VKTRACE_TRIM_RING_FRAMES env var makes the trace layer keep the last
+// frames in a ring instead of writing them, and a hotkey, port or hitch
+// trim trigger write them out, if the value is not 0. The env var is set by the
+// vktrace program to communicate the --TrimRingFrames arg value to the
+// trace layer.
+#define VKTRACE_TRIM_RING_FRAMES_ENV "VKTRACE_TRIM_RING_FRAMES"
+
+// VKTRACE_SHARED_MEMORY env var names the shared memory ring the trace
+// layer sends the trace through instead of the socket. The env var is set
+// by the vktrace program when it launches the program to trace itself, and
+// is empty otherwise.
+#define VKTRACE_SHARED_MEMORY_ENV "VKTRACE_SHARED_MEMORY"
+
+// VKTRACE_ASYNC_WRITER env var enables the background trace writer in
+// the trace layer if the value is 1. Packets are then queued by the
+// application threads and sent to vktrace from a dedicated thread. The
+// env var is set by the vktrace program to communicate the --AsyncWriter
+// arg value to the trace layer.
+#define VKTRACE_ASYNC_WRITER_ENV "VKTRACE_ASYNC_WRITER"
+
+// VKTRACE_SHARD_DIR env var makes each thread of the traced program write
+// its packets to a trace shard of its own in the directory it names, if
+// it isn't empty, see vktrace_lib_shardwriter.h. The env var is set by the
+// vktrace program to communicate the --ShardDir arg value to the trace
+// layer.
+#define VKTRACE_SHARD_DIR_ENV "VKTRACE_SHARD_DIR"
+
+// Path of a trace shard from the shard directory, the process id and the
+// index of the shard, which count up from 0 in each process
+#define VKTRACE_SHARD_FILE_FORMAT "%s/vktrace_shard_%u_%u"
+
+// VKTRACE_DEDUP_BLOBS env var makes the trace layer keep large payloads
+// that repeat, like shader code and flushed memory, only once in the
+// trace if the value is 1, see vktrace_blob_store.h. The env var is set by
+// the vktrace program to communicate the --DedupBlobs arg value to the
+// trace layer.
+#define VKTRACE_DEDUP_BLOBS_ENV "VKTRACE_DEDUP_BLOBS"
+
+// VKTRACE_CMD_BLOCKS env var makes the trace layer trace consecutive
+// vkCmd* calls on a command buffer as command block packets if the value
+// is 1, see vktrace_cmd_block.h. The env var is set by the vktrace program
+// to communicate the --CmdBlocks arg value to the trace layer.
+#define VKTRACE_CMD_BLOCKS_ENV "VKTRACE_CMD_BLOCKS"
+
+// VKTRACE_GPU_TIMING env var makes the trace layer time every primary
+// command buffer on the GPU and write the times as packets of their own
+// if the value is 1, see vktrace_gpu_timing.h. The env var is set by the
+// vktrace program to communicate the --GpuTiming arg value to the trace
+// layer.
+#define VKTRACE_GPU_TIMING_ENV "VKTRACE_GPU_TIMING"
+
+// VKTRACE_QUERY_DIGESTS env var makes the trace layer keep only a digest
+// of the query calls vkreplay doesn't need the results of if the value is
+// 1, see vktrace_query_digest.h. The env var is set by the vktrace program
+// to communicate the --QueryDigests arg value to the trace layer.
+#define VKTRACE_QUERY_DIGESTS_ENV "VKTRACE_QUERY_DIGESTS"
+
 // _VKTRACE_VERBOSITY env var is set by the vktrace program to
 // communicate verbosity level to the trace layer. It is set to
 // one of "quiet", "errors", "warnings", "full", or "debug".
@@ -0,0 +1,753 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vktrace_compression.h"
+#include <inttypes.h>
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// LZ4 block format, see https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+// The compressor is a plain greedy single-probe matcher; it is meant to keep up with trace capture,
+// not to get the best ratio.
+
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5  // the last 5 bytes of a block are always literals
+#define LZ4_MF_LIMIT 12      // the last match must start at least 12 bytes before the end of the block
+#define LZ4_MAX_OFFSET 65535
+#define LZ4_MAX_INPUT_SIZE 0x7E000000
+#define LZ4_HASH_LOG 16
+#define LZ4_SKIP_TRIGGER 6  // step through incompressible data faster the longer we go without a match
+
+static uint32_t lz4_read32(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t lz4_hash(uint32_t sequence) { return (sequence * 2654435761U) >> (32 - LZ4_HASH_LOG); }
+
+static uint8_t* lz4_write_length(uint8_t* pOut, size_t length) {
+    while (length >= 255) {
+        *pOut++ = 255;
+        length -= 255;
+    }
+    *pOut++ = (uint8_t)length;
+    return pOut;
+}
+
+static uint8_t* lz4_write_literals(uint8_t* pOut, uint8_t* pToken, const uint8_t* pLiterals, size_t length) {
+    if (length >= 15) {
+        *pToken = 15 << 4;
+        pOut = lz4_write_length(pOut, length - 15);
+    } else {
+        *pToken = (uint8_t)(length << 4);
+    }
+    memcpy(pOut, pLiterals, length);
+    return pOut + length;
+}
+
+size_t vktrace_lz4_compress_bound(size_t srcSize) { return srcSize + srcSize / 255 + 16; }
+
+size_t vktrace_lz4_compress(const void* pSrc, size_t srcSize, void* pDst, size_t dstCapacity) {
+    const uint8_t* src = (const uint8_t*)pSrc;
+    const uint8_t* ip = src;
+    const uint8_t* anchor = src;
+    const uint8_t* iend = src + srcSize;
+    uint8_t* op = (uint8_t*)pDst;
+    uint32_t* pTable;
+
+    if (srcSize > LZ4_MAX_INPUT_SIZE || dstCapacity < vktrace_lz4_compress_bound(srcSize)) {
+        return 0;
+    }
+
+    pTable = (uint32_t*)calloc((size_t)1 << LZ4_HASH_LOG, sizeof(uint32_t));
+    if (pTable == NULL) {
+        return 0;
+    }
+
+    if (srcSize > LZ4_MF_LIMIT) {
+        const uint8_t* mflimit = iend - LZ4_MF_LIMIT;
+        const uint8_t* matchlimit = iend - LZ4_LAST_LITERALS;
+        uint32_t misses = 0;
+
+        while (ip <= mflimit) {
+            uint32_t sequence = lz4_read32(ip);
+            uint32_t hash = lz4_hash(sequence);
+            const uint8_t* ref = src + pTable[hash];
+            pTable[hash] = (uint32_t)(ip - src);
+
+            if (ref < ip && (size_t)(ip - ref) <= LZ4_MAX_OFFSET && lz4_read32(ref) == sequence) {
+                const uint8_t* mp = ip + LZ4_MIN_MATCH;
+                const uint8_t* rp = ref + LZ4_MIN_MATCH;
+                size_t matchLength;
+                size_t offset = (size_t)(ip - ref);
+                uint8_t* pToken = op++;
+
+                while (mp < matchlimit && *mp == *rp) {
+                    mp++;
+                    rp++;
+                }
+                matchLength = (size_t)(mp - ip) - LZ4_MIN_MATCH;
+
+                op = lz4_write_literals(op, pToken, anchor, (size_t)(ip - anchor));
+                *op++ = (uint8_t)(offset & 0xff);
+                *op++ = (uint8_t)(offset >> 8);
+                if (matchLength >= 15) {
+                    *pToken |= 15;
+                    op = lz4_write_length(op, matchLength - 15);
+                } else {
+                    *pToken |= (uint8_t)matchLength;
+                }
+
+                ip = mp;
+                anchor = ip;
+                misses = 0;
+            } else {
+                ip += 1 + (misses++ >> LZ4_SKIP_TRIGGER);
+            }
+        }
+    }
+
+    // Whatever is left goes out as the final literal-only sequence
+    {
+        uint8_t* pToken = op++;
+        op = lz4_write_literals(op, pToken, anchor, (size_t)(iend - anchor));
+    }
+
+    free(pTable);
+    return (size_t)(op - (uint8_t*)pDst);
+}
+
+static BOOL lz4_read_length(const uint8_t** ppIn, const uint8_t* iend, size_t* pLength) {
+    uint8_t b;
+    do {
+        if (*ppIn >= iend) return FALSE;
+        b = *(*ppIn)++;
+        *pLength += b;
+    } while (b == 255);
+    return TRUE;
+}
+
+BOOL vktrace_lz4_decompress(const void* pSrc, size_t srcSize, void* pDst, size_t dstSize) {
+    const uint8_t* ip = (const uint8_t*)pSrc;
+    const uint8_t* iend = ip + srcSize;
+    uint8_t* dst = (uint8_t*)pDst;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + dstSize;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        size_t length = token >> 4;
+        size_t offset;
+        const uint8_t* match;
+
+        if (length == 15 && !lz4_read_length(&ip, iend, &length)) return FALSE;
+        if (length > (size_t)(iend - ip) || length > (size_t)(oend - op)) return FALSE;
+        memcpy(op, ip, length);
+        op += length;
+        ip += length;
+
+        // The last sequence has no match
+        if (ip == iend) break;
+
+        if (iend - ip < 2) return FALSE;
+        offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst)) return FALSE;
+
+        length = token & 15;
+        if (length == 15 && !lz4_read_length(&ip, iend, &length)) return FALSE;
+        length += LZ4_MIN_MATCH;
+        if (length > (size_t)(oend - op)) return FALSE;
+
+        match = op - offset;
+        if (offset >= length) {
+            memcpy(op, match, length);
+            op += length;
+        } else {
+            // Overlapping match, repeats the last offset bytes
+            while (length--) *op++ = *match++;
+        }
+    }
+
+    return op == oend;
+}
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// Compact packet headers, see vktrace_compression.h
+
+// Longest compact header: ten varints of at most 10 bytes each
+#define COMPACT_HEADER_MAX_SIZE 100
+
+// The previous packet of the frame
+typedef struct {
+    uint64_t global_packet_index;
+    uint64_t vktrace_begin_time;
+} CompactState;
+
+static void compact_reset(CompactState* pState) {
+    // So that the first packet of a frame starting at index 0 has a delta of 0
+    pState->global_packet_index = UINT64_MAX;
+    pState->vktrace_begin_time = 0;
+}
+
+static uint8_t* compact_put(uint8_t* pOut, uint64_t value) {
+    while (value >= 0x80) {
+        *pOut++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *pOut++ = (uint8_t)value;
+    return pOut;
+}
+
+// Zigzag encodes the difference a - b
+static uint8_t* compact_put_delta(uint8_t* pOut, uint64_t a, uint64_t b) {
+    int64_t delta = (int64_t)(a - b);
+    return compact_put(pOut, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+}
+
+static BOOL compact_get(const uint8_t** ppIn, const uint8_t* pEnd, uint64_t* pValue) {
+    uint64_t value = 0;
+    unsigned shift = 0;
+    while (*ppIn < pEnd && shift < 64) {
+        uint8_t byte = *(*ppIn)++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            *pValue = value;
+            return TRUE;
+        }
+        shift += 7;
+    }
+    return FALSE;
+}
+
+// Reads a zigzag encoded difference and returns it added to b
+static BOOL compact_get_delta(const uint8_t** ppIn, const uint8_t* pEnd, uint64_t b, uint64_t* pValue) {
+    uint64_t zigzag;
+    if (!compact_get(ppIn, pEnd, &zigzag)) return FALSE;
+    *pValue = b + ((zigzag >> 1) ^ (uint64_t)(-(int64_t)(zigzag & 1)));
+    return TRUE;
+}
+
+// Writes the compact header of a packet of size bytes, returning where it ends
+static uint8_t* compact_encode_header(const vktrace_trace_packet_header* pHeader, uint64_t size, BOOL timing, CompactState* pState,
+                                      uint8_t* pOut) {
+    pOut = compact_put(pOut, size - sizeof(vktrace_trace_packet_header));
+    pOut = compact_put(pOut, pHeader->packet_id);
+    pOut = compact_put(pOut, pHeader->tracer_id);
+    pOut = compact_put(pOut, pHeader->thread_id);
+    pOut = compact_put_delta(pOut, pHeader->global_packet_index, pState->global_packet_index + 1);
+    pOut = compact_put_delta(pOut, size, pHeader->next_buffers_offset);
+    if (timing) {
+        pOut = compact_put_delta(pOut, pHeader->vktrace_begin_time, pState->vktrace_begin_time);
+        pOut = compact_put_delta(pOut, pHeader->entrypoint_begin_time, pHeader->vktrace_begin_time);
+        pOut = compact_put_delta(pOut, pHeader->entrypoint_end_time, pHeader->entrypoint_begin_time);
+        pOut = compact_put_delta(pOut, pHeader->vktrace_end_time, pHeader->entrypoint_end_time);
+        pState->vktrace_begin_time = pHeader->vktrace_begin_time;
+    }
+    pState->global_packet_index = pHeader->global_packet_index;
+    return pOut;
+}
+
+static BOOL compact_decode_header(const uint8_t** ppIn, const uint8_t* pEnd, BOOL timing, CompactState* pState,
+                                  vktrace_trace_packet_header* pHeader) {
+    uint64_t bodySize, packetId, tracerId, threadId, size;
+    memset(pHeader, 0, sizeof(*pHeader));
+    if (!compact_get(ppIn, pEnd, &bodySize) || !compact_get(ppIn, pEnd, &packetId) || !compact_get(ppIn, pEnd, &tracerId) ||
+        !compact_get(ppIn, pEnd, &threadId) ||
+        !compact_get_delta(ppIn, pEnd, pState->global_packet_index + 1, &pHeader->global_packet_index)) {
+        return FALSE;
+    }
+    size = sizeof(vktrace_trace_packet_header) + bodySize;
+    if (!compact_get_delta(ppIn, pEnd, 0, &pHeader->next_buffers_offset)) return FALSE;
+    pHeader->next_buffers_offset = size - pHeader->next_buffers_offset;
+    if (timing) {
+        if (!compact_get_delta(ppIn, pEnd, pState->vktrace_begin_time, &pHeader->vktrace_begin_time) ||
+            !compact_get_delta(ppIn, pEnd, pHeader->vktrace_begin_time, &pHeader->entrypoint_begin_time) ||
+            !compact_get_delta(ppIn, pEnd, pHeader->entrypoint_begin_time, &pHeader->entrypoint_end_time) ||
+            !compact_get_delta(ppIn, pEnd, pHeader->entrypoint_end_time, &pHeader->vktrace_end_time)) {
+            return FALSE;
+        }
+        pState->vktrace_begin_time = pHeader->vktrace_begin_time;
+    }
+    pHeader->size = size;
+    pHeader->packet_id = (uint16_t)packetId;
+    pHeader->tracer_id = (uint8_t)tracerId;
+    pHeader->thread_id = (uint32_t)threadId;
+    pState->global_packet_index = pHeader->global_packet_index;
+    return (uint64_t)(pEnd - *ppIn) >= bodySize;
+}
+
+// Expands the compact packets of a frame into pOut, which must hold exactly outSize bytes
+static BOOL compact_decode_frame(const uint8_t* pIn, size_t inSize, BOOL timing, uint8_t* pOut, size_t outSize) {
+    const uint8_t* pEnd = pIn + inSize;
+    uint8_t* pOutEnd = pOut + outSize;
+    CompactState state;
+    compact_reset(&state);
+    while (pIn < pEnd) {
+        vktrace_trace_packet_header header;
+        size_t bodySize;
+        if (!compact_decode_header(&pIn, pEnd, timing, &state, &header) || (uint64_t)(pOutEnd - pOut) < header.size) {
+            return FALSE;
+        }
+        bodySize = (size_t)header.size - sizeof(header);
+        memcpy(pOut, &header, sizeof(header));
+        memcpy(pOut + sizeof(header), pIn, bodySize);
+        pIn += bodySize;
+        pOut += header.size;
+    }
+    return pOut == pOutEnd;
+}
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+struct CompressedWriter {
+    FILE* pFile;
+    uint64_t fileOffset;          // where the next frame header will be written
+    uint64_t uncompressedOffset;  // uncompressed offset of the first packet in the current frame
+    BOOL lz4;
+    BOOL compact;
+    BOOL timing;  // compact headers keep the times
+    CompactState compactState;
+
+    uint8_t* pFrame;
+    size_t frameSize;              // what is stored of the frame's packets, before LZ4
+    size_t frameUncompressedSize;  // size of the frame's packets with full headers
+    size_t frameCapacity;
+    uint32_t framePacketCount;
+
+    uint8_t* pCompressed;
+    size_t compressedCapacity;
+
+    vktrace_compressed_frame_index_entry* pIndex;
+    uint64_t frameCount;
+    size_t indexCapacity;
+};
+
+// ------------------------------------------------------------------------------------------------
+static BOOL vktrace_compression_grow(void** ppBuffer, size_t* pCapacity, size_t required, size_t elementSize) {
+    size_t newCapacity;
+    void* pNewBuffer;
+
+    if (required <= *pCapacity) return TRUE;
+
+    newCapacity = (*pCapacity == 0) ? required : *pCapacity;
+    while (newCapacity < required) newCapacity *= 2;
+
+    pNewBuffer = VKTRACE_REALLOC(*ppBuffer, newCapacity * elementSize);
+    if (pNewBuffer == NULL) return FALSE;
+
+    *ppBuffer = pNewBuffer;
+    *pCapacity = newCapacity;
+    return TRUE;
+}
+
+// ------------------------------------------------------------------------------------------------
+static BOOL vktrace_CompressedWriter_WriteFrame(CompressedWriter* pWriter) {
+    vktrace_compressed_frame_header frameHeader;
+    uint64_t encodedSize = pWriter->frameSize;
+    size_t headerSize = sizeof(frameHeader) + (pWriter->compact ? sizeof(encodedSize) : 0);
+    const void* pData = pWriter->pFrame;
+    size_t compressedSize = 0;
+
+    if (pWriter->frameSize == 0) return TRUE;
+
+    if (pWriter->lz4 && vktrace_compression_grow((void**)&pWriter->pCompressed, &pWriter->compressedCapacity,
+                                                 vktrace_lz4_compress_bound(pWriter->frameSize), 1)) {
+        compressedSize = vktrace_lz4_compress(pWriter->pFrame, pWriter->frameSize, pWriter->pCompressed, pWriter->compressedCapacity);
+    }
+
+    // Store the frame as is if it didn't get any smaller
+    if (compressedSize == 0 || compressedSize >= pWriter->frameSize) {
+        compressedSize = pWriter->frameSize;
+    } else {
+        pData = pWriter->pCompressed;
+    }
+
+    frameHeader.compressed_size = compressedSize;
+    frameHeader.uncompressed_size = pWriter->frameUncompressedSize;
+    if (1 != fwrite(&frameHeader, sizeof(frameHeader), 1, pWriter->pFile) ||
+        (pWriter->compact && 1 != fwrite(&encodedSize, sizeof(encodedSize), 1, pWriter->pFile)) ||
+        1 != fwrite(pData, compressedSize, 1, pWriter->pFile)) {
+        vktrace_LogError("Failed to write compressed frame to trace file.");
+        return FALSE;
+    }
+    fflush(pWriter->pFile);
+
+    if (!vktrace_compression_grow((void**)&pWriter->pIndex, &pWriter->indexCapacity, (size_t)pWriter->frameCount + 1,
+                                       sizeof(vktrace_compressed_frame_index_entry))) {
+        vktrace_LogError("Out of memory while compressing trace file.");
+        return FALSE;
+    }
+    pWriter->pIndex[pWriter->frameCount].uncompressed_offset = pWriter->uncompressedOffset;
+    pWriter->pIndex[pWriter->frameCount].file_offset = pWriter->fileOffset;
+    pWriter->frameCount++;
+
+    pWriter->fileOffset += headerSize + compressedSize;
+    pWriter->uncompressedOffset += pWriter->frameUncompressedSize;
+    pWriter->frameSize = 0;
+    pWriter->frameUncompressedSize = 0;
+    pWriter->framePacketCount = 0;
+    compact_reset(&pWriter->compactState);
+    return TRUE;
+}
+
+// ------------------------------------------------------------------------------------------------
+CompressedWriter* vktrace_CompressedWriter_create(FILE* pFile, uint64_t compressionType) {
+    CompressedWriter* pWriter = VKTRACE_NEW(CompressedWriter);
+    if (pWriter != NULL) {
+        memset(pWriter, 0, sizeof(CompressedWriter));
+        pWriter->pFile = pFile;
+        pWriter->lz4 = (compressionType & VKTRACE_COMPRESSION_LZ4) != 0;
+        pWriter->compact = (compressionType & VKTRACE_COMPRESSION_COMPACT) != 0;
+        pWriter->timing = (compressionType & VKTRACE_COMPRESSION_NO_TIMING) == 0;
+        compact_reset(&pWriter->compactState);
+        // The file header is stored uncompressed, so up to here both offsets are the same
+        pWriter->fileOffset = Ftell(pFile);
+        pWriter->uncompressedOffset = pWriter->fileOffset;
+    }
+    return pWriter;
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_CompressedWriter_destroy(CompressedWriter** ppWriter) {
+    if (ppWriter == NULL || *ppWriter == NULL) return;
+
+    VKTRACE_DELETE((*ppWriter)->pFrame);
+    VKTRACE_DELETE((*ppWriter)->pCompressed);
+    VKTRACE_DELETE((*ppWriter)->pIndex);
+    VKTRACE_DELETE(*ppWriter);
+    *ppWriter = NULL;
+}
+
+// ------------------------------------------------------------------------------------------------
+uint64_t vktrace_CompressedWriter_GetPosition(CompressedWriter* pWriter) {
+    return pWriter->uncompressedOffset + pWriter->frameUncompressedSize;
+}
+
+// ------------------------------------------------------------------------------------------------
+BOOL vktrace_CompressedWriter_WritePacket(CompressedWriter* pWriter, const void* pPacket, size_t size) {
+    // Don't let a large packet drag the rest of the frame along with it
+    if (pWriter->frameSize > 0 && pWriter->frameSize + size > VKTRACE_COMPRESSION_FRAME_SIZE) {
+        if (!vktrace_CompressedWriter_WriteFrame(pWriter)) return FALSE;
+    }
+
+    if (!vktrace_compression_grow((void**)&pWriter->pFrame, &pWriter->frameCapacity,
+                                  pWriter->frameSize + size + (pWriter->compact ? COMPACT_HEADER_MAX_SIZE : 0), 1)) {
+        vktrace_LogError("Out of memory while compressing trace file.");
+        return FALSE;
+    }
+    if (pWriter->compact) {
+        const vktrace_trace_packet_header* pHeader = (const vktrace_trace_packet_header*)pPacket;
+        size_t bodySize = size - sizeof(vktrace_trace_packet_header);
+        uint8_t* pOut = compact_encode_header(pHeader, size, pWriter->timing, &pWriter->compactState,
+                                              pWriter->pFrame + pWriter->frameSize);
+        memcpy(pOut, pHeader + 1, bodySize);
+        pWriter->frameSize = (size_t)(pOut + bodySize - pWriter->pFrame);
+    } else {
+        memcpy(pWriter->pFrame + pWriter->frameSize, pPacket, size);
+        pWriter->frameSize += size;
+    }
+    pWriter->frameUncompressedSize += size;
+    pWriter->framePacketCount++;
+
+    if (pWriter->framePacketCount >= VKTRACE_COMPRESSION_FRAME_PACKETS || pWriter->frameSize >= VKTRACE_COMPRESSION_FRAME_SIZE) {
+        return vktrace_CompressedWriter_WriteFrame(pWriter);
+    }
+    return TRUE;
+}
+
+// ------------------------------------------------------------------------------------------------
+uint64_t vktrace_CompressedWriter_Finish(CompressedWriter* pWriter) {
+    vktrace_compressed_frame_index_header indexHeader;
+    uint64_t indexOffset;
+
+    if (!vktrace_CompressedWriter_WriteFrame(pWriter)) return 0;
+
+    indexOffset = pWriter->fileOffset;
+    indexHeader.frame_count = pWriter->frameCount;
+    indexHeader.uncompressed_size = pWriter->uncompressedOffset;
+    if (0 != Fseek(pWriter->pFile, indexOffset, SEEK_SET) || 1 != fwrite(&indexHeader, sizeof(indexHeader), 1, pWriter->pFile) ||
+        (pWriter->frameCount > 0 && pWriter->frameCount != fwrite(pWriter->pIndex, sizeof(vktrace_compressed_frame_index_entry),
+                                                                  (size_t)pWriter->frameCount, pWriter->pFile))) {
+        vktrace_LogError("Failed to write frame index to trace file.");
+        return 0;
+    }
+    fflush(pWriter->pFile);
+    return indexOffset;
+}
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+#define VKTRACE_NO_FRAME UINT64_MAX
+
+struct CompressedReader {
+    FILE* pFile;
+    BOOL compact;
+    BOOL timing;
+    size_t frameHeaderSize;  // including the compact size
+    uint64_t firstPacketOffset;
+    uint64_t length;
+    uint64_t position;
+
+    vktrace_compressed_frame_index_entry* pIndex;
+    uint64_t frameCount;
+
+    // The frame most recently decompressed
+    uint64_t currentFrame;
+    uint8_t* pFrame;
+    size_t frameSize;
+    size_t frameCapacity;
+
+    uint8_t* pCompressed;
+    size_t compressedCapacity;
+    uint8_t* pEncoded;  // compact packets
+    size_t encodedCapacity;
+};
+
+// ------------------------------------------------------------------------------------------------
+// Reads the frame header at the current file position. The encoded size is the size of what the frame's
+// LZ4 block decompresses to.
+static BOOL vktrace_CompressedReader_ReadFrameHeader(CompressedReader* pReader, vktrace_compressed_frame_header* pFrameHeader,
+                                                     uint64_t* pEncodedSize) {
+    if (1 != fread(pFrameHeader, sizeof(*pFrameHeader), 1, pReader->pFile)) return FALSE;
+    *pEncodedSize = pFrameHeader->uncompressed_size;
+    if (pReader->compact && 1 != fread(pEncodedSize, sizeof(*pEncodedSize), 1, pReader->pFile)) return FALSE;
+    return pFrameHeader->compressed_size <= *pEncodedSize && *pEncodedSize <= pFrameHeader->uncompressed_size;
+}
+
+// ------------------------------------------------------------------------------------------------
+static BOOL vktrace_CompressedReader_LoadIndex(CompressedReader* pReader, uint64_t frameIndexOffset) {
+    vktrace_compressed_frame_index_header indexHeader;
+
+    if (0 != Fseek(pReader->pFile, frameIndexOffset, SEEK_SET) || 1 != fread(&indexHeader, sizeof(indexHeader), 1, pReader->pFile)) {
+        return FALSE;
+    }
+    if (indexHeader.frame_count > 0) {
+        pReader->pIndex = VKTRACE_NEW_ARRAY(vktrace_compressed_frame_index_entry, (size_t)indexHeader.frame_count);
+        if (pReader->pIndex == NULL || indexHeader.frame_count != fread(pReader->pIndex, sizeof(vktrace_compressed_frame_index_entry),
+                                                                        (size_t)indexHeader.frame_count, pReader->pFile)) {
+            return FALSE;
+        }
+    }
+    pReader->frameCount = indexHeader.frame_count;
+    pReader->length = indexHeader.uncompressed_size;
+    return TRUE;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Used when the trace was never finished: walk the frame headers, stopping at the first frame that
+// wasn't written out completely.
+static BOOL vktrace_CompressedReader_RebuildIndex(CompressedReader* pReader) {
+    vktrace_compressed_frame_header frameHeader;
+    uint64_t encodedSize;
+    uint64_t fileOffset = pReader->firstPacketOffset;
+    uint64_t uncompressedOffset = pReader->firstPacketOffset;
+    size_t indexCapacity = 0;
+    uint64_t fileLength;
+
+    if (0 != Fseek(pReader->pFile, 0, SEEK_END)) return FALSE;
+    fileLength = Ftell(pReader->pFile);
+
+    while (fileOffset + pReader->frameHeaderSize <= fileLength) {
+        if (0 != Fseek(pReader->pFile, fileOffset, SEEK_SET) ||
+            !vktrace_CompressedReader_ReadFrameHeader(pReader, &frameHeader, &encodedSize)) {
+            break;
+        }
+        if (frameHeader.uncompressed_size == 0 || fileOffset + pReader->frameHeaderSize + frameHeader.compressed_size > fileLength) {
+            break;
+        }
+        if (!vktrace_compression_grow((void**)&pReader->pIndex, &indexCapacity, (size_t)pReader->frameCount + 1,
+                                           sizeof(vktrace_compressed_frame_index_entry))) {
+            return FALSE;
+        }
+        pReader->pIndex[pReader->frameCount].uncompressed_offset = uncompressedOffset;
+        pReader->pIndex[pReader->frameCount].file_offset = fileOffset;
+        pReader->frameCount++;
+
+        fileOffset += pReader->frameHeaderSize + frameHeader.compressed_size;
+        uncompressedOffset += frameHeader.uncompressed_size;
+    }
+
+    pReader->length = uncompressedOffset;
+    vktrace_LogWarning("Trace file has no frame index, it may be truncated. Recovered %" PRIu64 " frames.", pReader->frameCount);
+    return TRUE;
+}
+
+// ------------------------------------------------------------------------------------------------
+static BOOL vktrace_CompressedReader_LoadFrame(CompressedReader* pReader, uint64_t frame) {
+    vktrace_compressed_frame_header frameHeader;
+    uint64_t encodedSize;
+    uint8_t* pEncoded;
+    uint64_t frameEnd = (frame + 1 < pReader->frameCount) ? pReader->pIndex[frame + 1].uncompressed_offset : pReader->length;
+    uint64_t expectedSize = frameEnd - pReader->pIndex[frame].uncompressed_offset;
+
+    if (frame == pReader->currentFrame) return TRUE;
+    pReader->currentFrame = VKTRACE_NO_FRAME;
+
+    if (0 != Fseek(pReader->pFile, pReader->pIndex[frame].file_offset, SEEK_SET) ||
+        !vktrace_CompressedReader_ReadFrameHeader(pReader, &frameHeader, &encodedSize) ||
+        frameHeader.uncompressed_size != expectedSize) {
+        vktrace_LogError("Trace file frame %" PRIu64 " is corrupt.", frame);
+        return FALSE;
+    }
+
+    if (!vktrace_compression_grow((void**)&pReader->pFrame, &pReader->frameCapacity, (size_t)frameHeader.uncompressed_size, 1) ||
+        (pReader->compact &&
+         !vktrace_compression_grow((void**)&pReader->pEncoded, &pReader->encodedCapacity, (size_t)encodedSize, 1))) {
+        vktrace_LogError("Out of memory while reading trace file.");
+        return FALSE;
+    }
+    // Without compact headers, the packets decompress straight into the frame
+    pEncoded = pReader->compact ? pReader->pEncoded : pReader->pFrame;
+
+    if (frameHeader.compressed_size == encodedSize) {
+        if (1 != fread(pEncoded, (size_t)encodedSize, 1, pReader->pFile)) {
+            vktrace_LogError("Failed to read trace file frame %" PRIu64 ".", frame);
+            return FALSE;
+        }
+    } else {
+        if (!vktrace_compression_grow((void**)&pReader->pCompressed, &pReader->compressedCapacity,
+                                           (size_t)frameHeader.compressed_size, 1)) {
+            vktrace_LogError("Out of memory while reading trace file.");
+            return FALSE;
+        }
+        if (1 != fread(pReader->pCompressed, (size_t)frameHeader.compressed_size, 1, pReader->pFile) ||
+            !vktrace_lz4_decompress(pReader->pCompressed, (size_t)frameHeader.compressed_size, pEncoded, (size_t)encodedSize)) {
+            vktrace_LogError("Failed to decompress trace file frame %" PRIu64 ".", frame);
+            return FALSE;
+        }
+    }
+    if (pReader->compact && !compact_decode_frame(pEncoded, (size_t)encodedSize, pReader->timing, pReader->pFrame,
+                                                  (size_t)frameHeader.uncompressed_size)) {
+        vktrace_LogError("Failed to expand the packet headers of trace file frame %" PRIu64 ".", frame);
+        return FALSE;
+    }
+
+    pReader->frameSize = (size_t)frameHeader.uncompressed_size;
+    pReader->currentFrame = frame;
+    return TRUE;
+}
+
+// ------------------------------------------------------------------------------------------------
+static uint64_t vktrace_CompressedReader_FindFrame(CompressedReader* pReader, uint64_t offset) {
+    uint64_t low = 0;
+    uint64_t high = pReader->frameCount;
+
+    if (pReader->currentFrame != VKTRACE_NO_FRAME && offset >= pReader->pIndex[pReader->currentFrame].uncompressed_offset &&
+        offset < pReader->pIndex[pReader->currentFrame].uncompressed_offset + pReader->frameSize) {
+        return pReader->currentFrame;
+    }
+
+    // Find the last frame starting at or before offset
+    while (high - low > 1) {
+        uint64_t mid = low + (high - low) / 2;
+        if (pReader->pIndex[mid].uncompressed_offset <= offset) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// ------------------------------------------------------------------------------------------------
+CompressedReader* vktrace_CompressedReader_create(FILE* pFile, uint64_t compressionType, uint64_t firstPacketOffset,
+                                                  uint64_t frameIndexOffset) {
+    CompressedReader* pReader = VKTRACE_NEW(CompressedReader);
+    BOOL loaded;
+    if (pReader == NULL) return NULL;
+
+    memset(pReader, 0, sizeof(CompressedReader));
+    pReader->pFile = pFile;
+    pReader->compact = (compressionType & VKTRACE_COMPRESSION_COMPACT) != 0;
+    pReader->timing = (compressionType & VKTRACE_COMPRESSION_NO_TIMING) == 0;
+    pReader->frameHeaderSize = sizeof(vktrace_compressed_frame_header) + (pReader->compact ? sizeof(uint64_t) : 0);
+    pReader->firstPacketOffset = firstPacketOffset;
+    pReader->currentFrame = VKTRACE_NO_FRAME;
+
+    loaded = (frameIndexOffset != 0) ? vktrace_CompressedReader_LoadIndex(pReader, frameIndexOffset)
+                                     : vktrace_CompressedReader_RebuildIndex(pReader);
+    if (!loaded) {
+        vktrace_LogError("Failed to read the frame index from the trace file.");
+        vktrace_CompressedReader_destroy(&pReader);
+    }
+    return pReader;
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_CompressedReader_destroy(CompressedReader** ppReader) {
+    if (ppReader == NULL || *ppReader == NULL) return;
+
+    VKTRACE_DELETE((*ppReader)->pIndex);
+    VKTRACE_DELETE((*ppReader)->pFrame);
+    VKTRACE_DELETE((*ppReader)->pCompressed);
+    VKTRACE_DELETE((*ppReader)->pEncoded);
+    VKTRACE_DELETE(*ppReader);
+    *ppReader = NULL;
+}
+
+// ------------------------------------------------------------------------------------------------
+BOOL vktrace_CompressedReader_Read(CompressedReader* pReader, void* pBytes, size_t len) {
+    uint8_t* pOut = (uint8_t*)pBytes;
+
+    if (pReader->position + len > pReader->length) {
+        vktrace_LogVerbose("Reached end of file.");
+        return FALSE;
+    }
+
+    while (len > 0) {
+        size_t count;
+        if (pReader->position < pReader->firstPacketOffset) {
+            // Still in the uncompressed file header
+            count = (size_t)(pReader->firstPacketOffset - pReader->position);
+            if (count > len) count = len;
+            if (0 != Fseek(pReader->pFile, pReader->position, SEEK_SET) || 1 != fread(pOut, count, 1, pReader->pFile)) {
+                return FALSE;
+            }
+        } else {
+            uint64_t frame = vktrace_CompressedReader_FindFrame(pReader, pReader->position);
+            size_t frameOffset;
+            if (!vktrace_CompressedReader_LoadFrame(pReader, frame)) return FALSE;
+            frameOffset = (size_t)(pReader->position - pReader->pIndex[frame].uncompressed_offset);
+            count = pReader->frameSize - frameOffset;
+            if (count > len) count = len;
+            memcpy(pOut, pReader->pFrame + frameOffset, count);
+        }
+        pOut += count;
+        len -= count;
+        pReader->position += count;
+    }
+    return TRUE;
+}
+
+// ------------------------------------------------------------------------------------------------
+uint64_t vktrace_CompressedReader_GetPosition(CompressedReader* pReader) { return pReader->position; }
+
+// ------------------------------------------------------------------------------------------------
+BOOL vktrace_CompressedReader_SetPosition(CompressedReader* pReader, uint64_t offset) {
+    if (offset > pReader->length) return FALSE;
+    pReader->position = offset;
+    return TRUE;
+}
+
+// ------------------------------------------------------------------------------------------------
+uint64_t vktrace_CompressedReader_GetLength(CompressedReader* pReader) { return pReader->length; }
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  Compressed trace files
+//
+//     A compressed trace file starts with the usual vktrace_trace_file_header and gpuinfo array,
+//     stored uncompressed, with compression_type set to VKTRACE_COMPRESSION_LZ4. The packets that
+//     follow are grouped into frames of up to VKTRACE_COMPRESSION_FRAME_PACKETS packets. Each
+//     frame is a vktrace_compressed_frame_header followed by the frame's packets compressed as a
+//     single LZ4 block, or stored as is if they didn't compress.
+//
+//     After the last frame comes the frame index: a vktrace_compressed_frame_index_header and one
+//     vktrace_compressed_frame_index_entry per frame. frame_index_offset in the file header points
+//     at it. If the index is missing, e.g. because vktrace was killed, readers rebuild it by walking
+//     the frame headers.
+//
+//     Offsets everywhere else in the trace (first_packet_offset, the portability table, replay
+//     bookmarks) are offsets into the uncompressed stream, so code that reads through a FileLike
+//     doesn't have to know whether the file is compressed.
+//
+//  Compact packet headers
+//
+//     With VKTRACE_COMPRESSION_COMPACT set in compression_type, the packets of a frame are stored
+//     with compact headers, with or without LZ4 on top. The frame header is then followed by a
+//     uint64_t with the size of the compact packets, which the LZ4 block decompresses to. Each
+//     packet is its compact header and then its body. The compact header is a list of LEB128
+//     varints, those marked (s) zigzag encoded:
+//
+//         size - sizeof(vktrace_trace_packet_header)
+//         packet_id, tracer_id, thread_id
+//         (s) global_packet_index - (global_packet_index of the previous packet + 1)
+//         (s) size - next_buffers_offset
+//         (s) vktrace_begin_time - vktrace_begin_time of the previous packet
+//         (s) entrypoint_begin_time - vktrace_begin_time
+//         (s) entrypoint_end_time - entrypoint_begin_time
+//         (s) vktrace_end_time - entrypoint_end_time
+//
+//     "Previous packet" values start at 0 in every frame, so frames decode on their own. The four
+//     times are left out if VKTRACE_COMPRESSION_NO_TIMING is set too, and read back as 0. Readers
+//     get the packets with their full headers back, and frame sizes and all offsets are those of
+//     the full packets.
+
+#pragma once
+
+#include "vktrace_common.h"
+#include "vktrace_trace_packet_identifiers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// compression_type is a combination of these bits
+#define VKTRACE_COMPRESSION_NONE 0
+#define VKTRACE_COMPRESSION_LZ4 1
+#define VKTRACE_COMPRESSION_COMPACT 2
+#define VKTRACE_COMPRESSION_NO_TIMING 4  // only with VKTRACE_COMPRESSION_COMPACT
+#define VKTRACE_COMPRESSION_ALL (VKTRACE_COMPRESSION_LZ4 | VKTRACE_COMPRESSION_COMPACT | VKTRACE_COMPRESSION_NO_TIMING)
+
+// A frame is closed once it holds this many packets or this many bytes, whichever comes first.
+// A single packet larger than VKTRACE_COMPRESSION_FRAME_SIZE gets a frame of its own.
+#define VKTRACE_COMPRESSION_FRAME_PACKETS 256
+#define VKTRACE_COMPRESSION_FRAME_SIZE (4 * 1024 * 1024)
+
+typedef struct {
+    ALIGN8 uint64_t compressed_size;  // equal to uncompressed_size if the frame is stored as is
+    ALIGN8 uint64_t uncompressed_size;
+} vktrace_compressed_frame_header;
+
+typedef struct {
+    ALIGN8 uint64_t frame_count;
+    ALIGN8 uint64_t uncompressed_size;  // offset just past the last packet in the uncompressed stream
+} vktrace_compressed_frame_index_header;
+
+typedef struct {
+    ALIGN8 uint64_t uncompressed_offset;  // offset of the frame's first packet in the uncompressed stream
+    ALIGN8 uint64_t file_offset;          // offset of the frame header in the file
+} vktrace_compressed_frame_index_entry;
+
+// LZ4 block format codec.
+// vktrace_lz4_compress returns the compressed size, or 0 if pDst is smaller than vktrace_lz4_compress_bound(srcSize)
+// or the input is too large for a single block.
+size_t vktrace_lz4_compress_bound(size_t srcSize);
+size_t vktrace_lz4_compress(const void* pSrc, size_t srcSize, void* pDst, size_t dstCapacity);
+BOOL vktrace_lz4_decompress(const void* pSrc, size_t srcSize, void* pDst, size_t dstSize);
+
+// Writes packets to a trace file as compressed frames. The file must be positioned just past the
+// file header and gpuinfo array, which is where the writer starts the first frame. compressionType
+// is the compression_type of the file header.
+typedef struct CompressedWriter CompressedWriter;
+
+CompressedWriter* vktrace_CompressedWriter_create(FILE* pFile, uint64_t compressionType);
+void vktrace_CompressedWriter_destroy(CompressedWriter** ppWriter);
+
+// Queue a packet for the current frame, writing the frame out once it is full. The packet must start
+// with its vktrace_trace_packet_header.
+BOOL vktrace_CompressedWriter_WritePacket(CompressedWriter* pWriter, const void* pPacket, size_t size);
+
+// Offset in the uncompressed stream at which the next packet will start.
+uint64_t vktrace_CompressedWriter_GetPosition(CompressedWriter* pWriter);
+
+// Write out the last frame and the frame index. Returns the file offset of the index, or 0 on failure.
+uint64_t vktrace_CompressedWriter_Finish(CompressedWriter* pWriter);
+
+// Reads the uncompressed stream back out of a compressed trace file.
+typedef struct CompressedReader CompressedReader;
+
+CompressedReader* vktrace_CompressedReader_create(FILE* pFile, uint64_t compressionType, uint64_t firstPacketOffset,
+                                                  uint64_t frameIndexOffset);
+void vktrace_CompressedReader_destroy(CompressedReader** ppReader);
+
+BOOL vktrace_CompressedReader_Read(CompressedReader* pReader, void* pBytes, size_t len);
+uint64_t vktrace_CompressedReader_GetPosition(CompressedReader* pReader);
+BOOL vktrace_CompressedReader_SetPosition(CompressedReader* pReader, uint64_t offset);
+uint64_t vktrace_CompressedReader_GetLength(CompressedReader* pReader);
+
+#ifdef __cplusplus
+}
+#endif
@@ -22,6 +22,7 @@
 #include "vktrace_filelike.h"
 #include "vktrace_common.h"
 #include "vktrace_interconnect.h"
+#include "vktrace_compression.h"
 #include <assert.h>
 #include <stdlib.h>
 
@@ -95,11 +96,26 @@ FileLike* vktrace_FileLike_create_file(FILE* fp) {
         pFile->mMode = File;
         pFile->mFile = fp;
         pFile->mMessageStream = NULL;
+        pFile->mCompressedReader = NULL;
         pFile->mFileLen = vktrace_FileLike_GetFileLength(fp);
     }
     return pFile;
 }
 
+// ------------------------------------------------------------------------------------------------
+FileLike* vktrace_FileLike_create_stream(FILE* fp) {
+    FileLike* pFile = NULL;
+    if (fp != NULL) {
+        pFile = VKTRACE_NEW(FileLike);
+        pFile->mMode = File;
+        pFile->mFile = fp;
+        pFile->mMessageStream = NULL;
+        pFile->mCompressedReader = NULL;
+        pFile->mFileLen = 0;
+    }
+    return pFile;
+}
+
 // ------------------------------------------------------------------------------------------------
 FileLike* vktrace_FileLike_create_msg(MessageStream* _msgStream) {
     FileLike* pFile = NULL;
@@ -108,11 +124,44 @@ FileLike* vktrace_FileLike_create_msg(MessageStream* _msgStream) {
         pFile->mMode = Socket;
         pFile->mFile = NULL;
         pFile->mMessageStream = _msgStream;
+        pFile->mCompressedReader = NULL;
         pFile->mFileLen = 0;
     }
     return pFile;
 }
 
+// ------------------------------------------------------------------------------------------------
+BOOL vktrace_FileLike_EnableDecompression(FileLike* pFile, const vktrace_trace_file_header* pHeader) {
+    size_t offset;
+    assert(pFile->mMode == File && pFile->mCompressedReader == NULL);
+
+    if (pHeader->compression_type == VKTRACE_COMPRESSION_NONE) {
+        return TRUE;
+    }
+    if ((pHeader->compression_type & ~(uint64_t)VKTRACE_COMPRESSION_ALL) != 0) {
+        vktrace_LogError("Unknown trace file compression type %u.", (unsigned int)pHeader->compression_type);
+        return FALSE;
+    }
+
+    offset = vktrace_FileLike_GetCurrentPosition(pFile);
+    pFile->mCompressedReader = vktrace_CompressedReader_create(pFile->mFile, pHeader->compression_type, pHeader->first_packet_offset,
+                                                               pHeader->frame_index_offset);
+    if (pFile->mCompressedReader == NULL) {
+        return FALSE;
+    }
+    pFile->mFileLen = (size_t)vktrace_CompressedReader_GetLength(pFile->mCompressedReader);
+    return vktrace_FileLike_SetCurrentPosition(pFile, offset);
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_FileLike_destroy(FileLike** ppFile) {
+    if (ppFile == NULL || *ppFile == NULL) return;
+
+    vktrace_CompressedReader_destroy(&(*ppFile)->mCompressedReader);
+    VKTRACE_DELETE(*ppFile);
+    *ppFile = NULL;
+}
+
 // ------------------------------------------------------------------------------------------------
 size_t vktrace_FileLike_Read(FileLike* pFileLike, void* _bytes, size_t _len) {
     size_t minSize = 0;
@@ -135,7 +184,9 @@ BOOL vktrace_FileLike_ReadRaw(FileLike* pFileLike, void* _bytes, size_t _len) {
 
     switch (pFileLike->mMode) {
         case File: {
-            if (1 != fread(_bytes, _len, 1, pFileLike->mFile)) {
+            if (pFileLike->mCompressedReader != NULL) {
+                result = vktrace_CompressedReader_Read(pFileLike->mCompressedReader, _bytes, _len);
+            } else if (1 != fread(_bytes, _len, 1, pFileLike->mFile)) {
                 if (ferror(pFileLike->mFile) != 0) {
                     perror("fread error");
                 } else if (feof(pFileLike->mFile) != 0) {
@@ -185,6 +236,29 @@ BOOL vktrace_FileLike_WriteRaw(FileLike* pFile, const void* _bytes, size_t _len)
     return result;
 }
 
+// ------------------------------------------------------------------------------------------------
+BOOL vktrace_FileLike_WriteRawGather(FileLike* pFile, const MessageStreamBuffer* pBuffers, size_t count) {
+    BOOL result = TRUE;
+    assert((pFile->mFile != 0) ^ (pFile->mMessageStream != 0));
+    switch (pFile->mMode) {
+        case File:
+            for (size_t i = 0; i < count && result; i++) {
+                if (pBuffers[i].size > 0 && 1 != fwrite(pBuffers[i].pBytes, pBuffers[i].size, 1, pFile->mFile)) {
+                    result = FALSE;
+                }
+            }
+            break;
+        case Socket:
+            result = vktrace_MessageStream_SendGather(pFile->mMessageStream, pBuffers, count, FALSE);
+            break;
+        default:
+            assert(!"Invalid mode in FileLike_WriteRawGather");
+            result = FALSE;
+            break;
+    }
+    return result;
+}
+
 // ------------------------------------------------------------------------------------------------
 size_t vktrace_FileLike_GetCurrentPosition(FileLike* pFileLike) {
     size_t offset = 0;
@@ -192,7 +266,11 @@ size_t vktrace_FileLike_GetCurrentPosition(FileLike* pFileLike) {
 
     switch (pFileLike->mMode) {
         case File: {
-            offset = Ftell(pFileLike->mFile);
+            if (pFileLike->mCompressedReader != NULL) {
+                offset = (size_t)vktrace_CompressedReader_GetPosition(pFileLike->mCompressedReader);
+            } else {
+                offset = Ftell(pFileLike->mFile);
+            }
             break;
         }
 
@@ -209,7 +287,9 @@ BOOL vktrace_FileLike_SetCurrentPosition(FileLike* pFileLike, size_t offset) {
 
     switch (pFileLike->mMode) {
         case File: {
-            if (Fseek(pFileLike->mFile, offset, SEEK_SET) == 0) {
+            if (pFileLike->mCompressedReader != NULL) {
+                ret = vktrace_CompressedReader_SetPosition(pFileLike->mCompressedReader, offset);
+            } else if (Fseek(pFileLike->mFile, offset, SEEK_SET) == 0) {
                 ret = TRUE;
             }
             break;
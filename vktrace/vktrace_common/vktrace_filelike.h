@@ -29,8 +29,10 @@
 
 #include "vktrace_common.h"
 #include "vktrace_interconnect.h"
+#include "vktrace_trace_packet_identifiers.h"
 
 typedef struct MessageStream MessageStream;
+struct CompressedReader;
 
 struct FileLike;
 typedef struct FileLike FileLike;
@@ -39,6 +41,7 @@ typedef struct FileLike {
     FILE* mFile;
     size_t mFileLen;
     MessageStream* mMessageStream;
+    struct CompressedReader* mCompressedReader;
 } FileLike;
 
 // For creating checkpoints (consistency checks) in the various streams we're interacting with.
@@ -62,9 +65,19 @@ BOOL vktrace_Checkpoint_read(Checkpoint* pCheckpoint, FileLike* _in);
 // create a filelike interface for file streaming
 FileLike* vktrace_FileLike_create_file(FILE* fp);
 
+// create a filelike interface for a stream that can't seek, like a pipe; mFileLen is 0
+FileLike* vktrace_FileLike_create_stream(FILE* fp);
+
 // create a filelike interface for network streaming
 FileLike* vktrace_FileLike_create_msg(MessageStream* _msgStream);
 
+// If the trace file described by pHeader is compressed, make reads, positions and mFileLen refer to
+// the uncompressed stream from now on. Returns FALSE if the file can't be decompressed.
+BOOL vktrace_FileLike_EnableDecompression(FileLike* pFile, const vktrace_trace_file_header* pHeader);
+
+// free a filelike interface and anything it allocated; does not close the file or stream
+void vktrace_FileLike_destroy(FileLike** ppFile);
+
 // read a size and then a buffer of that size
 size_t vktrace_FileLike_Read(FileLike* pFileLike, void* _bytes, size_t _len);
 
@@ -79,6 +92,9 @@ void vktrace_FileLike_Write(FileLike* pFileLike, const void* _bytes, size_t _len
 // no size parameter first.
 BOOL vktrace_FileLike_WriteRaw(FileLike* pFile, const void* _bytes, size_t _len);
 
+// WriteRaw of each of the buffers, which a socket sends together without copying them
+BOOL vktrace_FileLike_WriteRawGather(FileLike* pFile, const MessageStreamBuffer* pBuffers, size_t count);
+
 // Get the starting position for the next vktrace_FileLike_ReadRaw
 size_t vktrace_FileLike_GetCurrentPosition(FileLike* pFile);
 
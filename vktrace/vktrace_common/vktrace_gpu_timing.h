@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  GPU timing packets
+//
+//     Packets only carry the CPU times of the calls, which say little about how long the GPU took
+//     in the traced run. When the trace layer times the GPU (see vktrace_lib_gputiming.h), it
+//     writes a VKTRACE_TPI_GPU_TIMING packet for every execution of a primary command buffer once
+//     the execution has finished. The packet doesn't stand for a call and isn't replayed, vkreplay
+//     --GpuTimestamps writes the times next to the ones of the replay.
+
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include "vktrace_trace_packet_identifiers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Body of a VKTRACE_TPI_GPU_TIMING packet
+typedef struct {
+    vktrace_trace_packet_header* header;
+    VkCommandBuffer commandBuffer;
+    // global_packet_index of the vkBeginCommandBuffer that recorded the command buffer, and of the
+    // vkQueueSubmit that submitted it
+    uint64_t beginPacketIndex;
+    uint64_t submitPacketIndex;
+    // Nanoseconds from the start to the end of the command buffer on the GPU
+    uint64_t gpuTime;
+    // vkQueuePresentKHR calls traced before the vkQueueSubmit
+    uint32_t frame;
+} vktrace_gpu_timing;
+
+#ifdef __cplusplus
+}
+#endif
@@ -19,6 +19,11 @@
  * Author: Peter Lohrmann <peterl@valvesoftware.com>
  */
 
+#if defined(PLATFORM_LINUX)
+// For splice, which the system headers only declare if this comes before all of them
+#define _GNU_SOURCE 1
+#endif
+
 #include "vktrace_interconnect.h"
 #include "vktrace_common.h"
 
@@ -28,8 +33,32 @@
 #include <sys/un.h>
 #endif
 
+#if defined(PLATFORM_POSIX)
+#include <sys/select.h>
+#include <sys/uio.h>
+#endif
+
+#if defined(PLATFORM_LINUX)
+#include <poll.h>
+#endif
+
+#if defined(PLATFORM_POSIX)
+#include <sched.h>
+#define vktrace_MessageStream_Yield() sched_yield()
+#else
+#define vktrace_MessageStream_Yield() SwitchToThread()
+#endif
+
 const size_t kSendBufferSize = 1024 * 1024;
 
+// Most buffers vktrace_MessageStream_SendGather passes to one writev
+#define kMaxGatherBuffers 64
+
+// How often to yield waiting on the shared memory ring before sleeping instead, and how many of
+// those yields go by between looking at the socket
+#define kRingSpinAttempts 1024
+#define kRingPeerCheckInterval 64
+
 MessageStream* gMessageStream = NULL;
 static VKTRACE_CRITICAL_SECTION gSendLock;
 // ------------------------------------------------------------------------------------------------
@@ -38,13 +67,16 @@ static VKTRACE_CRITICAL_SECTION gSendLock;
 // private functions
 BOOL vktrace_MessageStream_SetupSocket(MessageStream* pStream);
 BOOL vktrace_MessageStream_SetupHostSocket(MessageStream* pStream);
+SOCKET vktrace_MessageStream_ListenSocket(const char* _port, int _backlog);
+BOOL vktrace_MessageStream_FinishHostSocket(MessageStream* pStream);
 BOOL vktrace_MessageStream_SetupClientSocket(MessageStream* pStream);
 BOOL vktrace_MessageStream_Handshake(MessageStream* pStream);
+BOOL vktrace_MessageStream_NegotiateSharedRing(MessageStream* pStream, FileLike* fileLike);
 BOOL vktrace_MessageStream_ReallySend(MessageStream* pStream, const void* _bytes, size_t _size, BOOL _optional);
 void vktrace_MessageStream_FlushSendBuffer(MessageStream* pStream, BOOL _optional);
 
 // public functions
-MessageStream* vktrace_MessageStream_create_port_string(BOOL _isHost, const char* _address, const char* _port) {
+static MessageStream* vktrace_MessageStream_alloc(BOOL _isHost, const char* _address, const char* _port) {
     MessageStream* pStream;
     // make sure the strings are shorter than the destination buffer we have to store them!
     assert(strlen(_address) + 1 <= 64);
@@ -61,7 +93,17 @@ MessageStream* vktrace_MessageStream_create_port_string(BOOL _isHost, const char
     pStream->mNextPacketId = 0;
     pStream->mSocket = INVALID_SOCKET;
     pStream->mSendBuffer = NULL;
+    pStream->mSharedRing = NULL;
+    pStream->mPeerProcessId = 0;
+#if defined(PLATFORM_LINUX)
+    pStream->mSplicePipe[0] = -1;
+    pStream->mSplicePipe[1] = -1;
+#endif
+    return pStream;
+}
 
+MessageStream* vktrace_MessageStream_create_port_string(BOOL _isHost, const char* _address, const char* _port) {
+    MessageStream* pStream = vktrace_MessageStream_alloc(_isHost, _address, _port);
     if (vktrace_MessageStream_SetupSocket(pStream) == FALSE) {
         VKTRACE_DELETE(pStream);
         pStream = NULL;
@@ -77,6 +119,62 @@ MessageStream* vktrace_MessageStream_create(BOOL _isHost, const char* _address,
     return vktrace_MessageStream_create_port_string(_isHost, _address, portBuf);
 }
 
+SOCKET vktrace_MessageStream_listen(unsigned int _port) {
+    char portBuf[32];
+    sprintf(portBuf, "%u", _port);
+#if defined(WIN32)
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != NO_ERROR) {
+        return INVALID_SOCKET;
+    }
+#endif
+    vktrace_create_critical_section(&gSendLock);
+    // Clients that connect at the same time wait in the backlog until they are accepted
+    SOCKET listenSocket = vktrace_MessageStream_ListenSocket(portBuf, SOMAXCONN);
+    if (listenSocket == INVALID_SOCKET) {
+#if defined(WIN32)
+        WSACleanup();
+#endif
+        return INVALID_SOCKET;
+    }
+    vktrace_LogVerbose("Listening for connections on port %s.", portBuf);
+    return listenSocket;
+}
+
+MessageStream* vktrace_MessageStream_accept(SOCKET listenSocket, unsigned int _port, unsigned int _timeoutMs) {
+    fd_set readSet;
+    struct timeval timeout;
+    FD_ZERO(&readSet);
+    FD_SET(listenSocket, &readSet);
+    timeout.tv_sec = _timeoutMs / 1000;
+    timeout.tv_usec = (_timeoutMs % 1000) * 1000;
+    // Windows ignores the first argument
+    if (select((int)listenSocket + 1, &readSet, NULL, NULL, &timeout) <= 0) {
+        return NULL;
+    }
+
+    char portBuf[32];
+    sprintf(portBuf, "%u", _port);
+    MessageStream* pStream = vktrace_MessageStream_alloc(TRUE, "", portBuf);
+#if defined(WIN32)
+    // Each stream cleans up after itself when it is destroyed
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+    pStream->mSocket = accept(listenSocket, NULL, NULL);
+    if (!vktrace_MessageStream_FinishHostSocket(pStream)) {
+        vktrace_MessageStream_destroy(&pStream);
+    }
+    return pStream;
+}
+
+void vktrace_MessageStream_close_listener(SOCKET listenSocket) {
+    closesocket(listenSocket);
+#if defined(WIN32)
+    WSACleanup();
+#endif
+}
+
 void vktrace_MessageStream_destroy(MessageStream** ppStream) {
     if ((*ppStream)->mSendBuffer != NULL) {
         // Try to get our data out.
@@ -89,6 +187,20 @@ void vktrace_MessageStream_destroy(MessageStream** ppStream) {
         (*ppStream)->mHostAddressInfo = NULL;
     }
 
+    vktrace_SharedRing_destroy(&(*ppStream)->mSharedRing);
+
+    // The host takes a socket for every traced process, which shouldn't stay open once it is done
+    if ((*ppStream)->mSocket != INVALID_SOCKET) {
+        closesocket((*ppStream)->mSocket);
+    }
+
+#if defined(PLATFORM_LINUX)
+    if ((*ppStream)->mSplicePipe[0] != -1) {
+        close((*ppStream)->mSplicePipe[0]);
+        close((*ppStream)->mSplicePipe[1]);
+    }
+#endif
+
     vktrace_LogDebug("Destroyed socket connection.");
 #if defined(WIN32)
     WSACleanup();
@@ -121,78 +233,94 @@ BOOL vktrace_MessageStream_SetupSocket(MessageStream* pStream) {
 }
 
 BOOL vktrace_MessageStream_SetupHostSocket(MessageStream* pStream) {
+    SOCKET listenSocket;
+
+    vktrace_create_critical_section(&gSendLock);
+    listenSocket = vktrace_MessageStream_ListenSocket(pStream->mPort, 1);
+    if (listenSocket == INVALID_SOCKET) {
+        return FALSE;
+    }
+
+    // Fo reals.
+    vktrace_LogVerbose("Listening for connections on port %s.", pStream->mPort);
+    pStream->mSocket = accept(listenSocket, NULL, NULL);
+    closesocket(listenSocket);
+
+    if (pStream->mSocket == INVALID_SOCKET) {
+        vktrace_LogError("Host: Failed accepting socket connection.");
+        return FALSE;
+    }
+    vktrace_MessageStream_FinishHostSocket(pStream);
+    return TRUE;
+}
+
+// Returns a socket listening on _port, or INVALID_SOCKET
+SOCKET vktrace_MessageStream_ListenSocket(const char* _port, int _backlog) {
     int hr = 0;
 #if defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
     int yes = 1;
 #endif
     struct addrinfo hostAddrInfo = {0};
+    struct addrinfo* pAddressInfo = NULL;
     SOCKET listenSocket;
 
-    vktrace_create_critical_section(&gSendLock);
     hostAddrInfo.ai_family = AF_INET;
     hostAddrInfo.ai_socktype = SOCK_STREAM;
     hostAddrInfo.ai_protocol = IPPROTO_TCP;
     hostAddrInfo.ai_flags = AI_PASSIVE;
 
-    hr = getaddrinfo(NULL, pStream->mPort, &hostAddrInfo, &pStream->mHostAddressInfo);
+    hr = getaddrinfo(NULL, _port, &hostAddrInfo, &pAddressInfo);
     if (hr != 0) {
         vktrace_LogError("Host: Failed getaddrinfo.");
-        return FALSE;
+        return INVALID_SOCKET;
     }
 
-    listenSocket = socket(pStream->mHostAddressInfo->ai_family, pStream->mHostAddressInfo->ai_socktype,
-                          pStream->mHostAddressInfo->ai_protocol);
+    listenSocket = socket(pAddressInfo->ai_family, pAddressInfo->ai_socktype, pAddressInfo->ai_protocol);
     if (listenSocket == INVALID_SOCKET) {
         // TODO: Figure out errors
         vktrace_LogError("Host: Failed creating a listen socket.");
-        freeaddrinfo(pStream->mHostAddressInfo);
-        pStream->mHostAddressInfo = NULL;
-        return FALSE;
+        freeaddrinfo(pAddressInfo);
+        return INVALID_SOCKET;
     }
 
 #if defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
     setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
 #endif
-    hr = bind(listenSocket, pStream->mHostAddressInfo->ai_addr, (int)pStream->mHostAddressInfo->ai_addrlen);
+    hr = bind(listenSocket, pAddressInfo->ai_addr, (int)pAddressInfo->ai_addrlen);
+    // Done with this.
+    freeaddrinfo(pAddressInfo);
     if (hr == SOCKET_ERROR) {
         vktrace_LogError("Host: Failed binding socket err=%d.", VKTRACE_WSAGetLastError());
-        freeaddrinfo(pStream->mHostAddressInfo);
-        pStream->mHostAddressInfo = NULL;
         closesocket(listenSocket);
-        return FALSE;
+        return INVALID_SOCKET;
     }
 
-    // Done with this.
-    freeaddrinfo(pStream->mHostAddressInfo);
-    pStream->mHostAddressInfo = NULL;
-
-    hr = listen(listenSocket, 1);
+    hr = listen(listenSocket, _backlog);
     if (hr == SOCKET_ERROR) {
         vktrace_LogError("Host: Failed listening on socket err=%d.", VKTRACE_WSAGetLastError());
         closesocket(listenSocket);
-        return FALSE;
+        return INVALID_SOCKET;
     }
+    return listenSocket;
+}
 
-    // Fo reals.
-    vktrace_LogVerbose("Listening for connections on port %s.", pStream->mPort);
-    pStream->mSocket = accept(listenSocket, NULL, NULL);
-    closesocket(listenSocket);
-
+// Shakes hands with the client that was just accepted
+BOOL vktrace_MessageStream_FinishHostSocket(MessageStream* pStream) {
     if (pStream->mSocket == INVALID_SOCKET) {
         vktrace_LogError("Host: Failed accepting socket connection.");
         return FALSE;
     }
 
     vktrace_LogVerbose("Connected on port %s.", pStream->mPort);
-    if (vktrace_MessageStream_Handshake(pStream)) {
-        // TODO: The SendBuffer can cause big delays in sending messages back to the client.
-        // We haven't verified if this improves performance in real applications,
-        // so disable it for now.
-        // pStream->mSendBuffer = vktrace_SimpleBuffer_create(kSendBufferSize);
-        pStream->mSendBuffer = NULL;
-    } else {
+    if (!vktrace_MessageStream_Handshake(pStream)) {
         vktrace_LogError("vktrace_MessageStream_SetupHostSocket failed handshake.");
+        return FALSE;
     }
+    // TODO: The SendBuffer can cause big delays in sending messages back to the client.
+    // We haven't verified if this improves performance in real applications,
+    // so disable it for now.
+    // pStream->mSendBuffer = vktrace_SimpleBuffer_create(kSendBufferSize);
+    pStream->mSendBuffer = NULL;
     return TRUE;
 }
 
@@ -285,17 +413,26 @@ BOOL vktrace_MessageStream_Handshake(MessageStream* pStream) {
     Checkpoint* syn = vktrace_Checkpoint_create("It's a trap!");
     Checkpoint* ack = vktrace_Checkpoint_create(" - Admiral Ackbar");
 
+    // The client also tells the host which process it is
+    uint32_t processId = 0;
     if (pStream->mHost) {
         vktrace_Checkpoint_write(syn, fileLike);
-        result = vktrace_Checkpoint_read(ack, fileLike);
+        result = vktrace_Checkpoint_read(ack, fileLike) && vktrace_FileLike_ReadRaw(fileLike, &processId, sizeof(processId));
+        pStream->mPeerProcessId = (vktrace_process_id)processId;
     } else {
         if (vktrace_Checkpoint_read(syn, fileLike)) {
             vktrace_Checkpoint_write(ack, fileLike);
+            processId = (uint32_t)vktrace_get_pid();
+            result = vktrace_FileLike_WriteRaw(fileLike, &processId, sizeof(processId));
         } else {
             result = FALSE;
         }
     }
 
+    if (result) {
+        result = vktrace_MessageStream_NegotiateSharedRing(pStream, fileLike);
+    }
+
     // Turn on non-blocking modes for sockets now.
     if (result) {
 #if defined(WIN32)
@@ -313,6 +450,122 @@ BOOL vktrace_MessageStream_Handshake(MessageStream* pStream) {
     return result;
 }
 
+// ------------------------------------------------------------------------------------------------
+BOOL vktrace_MessageStream_NegotiateSharedRing(MessageStream* pStream, FileLike* fileLike) {
+    // The client asks for the ring if it can open it, and the host answers whether it can too.
+    // Until it is set on the stream, the answers still go through the socket.
+    SharedRing* pRing = NULL;
+    uint8_t useRing = 0;
+    if (pStream->mHost) {
+        if (!vktrace_FileLike_ReadRaw(fileLike, &useRing, sizeof(useRing))) {
+            return FALSE;
+        }
+        if (useRing) {
+            pRing = vktrace_SharedRing_open(vktrace_get_global_var(VKTRACE_SHARED_MEMORY_ENV));
+            useRing = pRing != NULL;
+        }
+        if (!vktrace_FileLike_WriteRaw(fileLike, &useRing, sizeof(useRing))) {
+            vktrace_SharedRing_destroy(&pRing);
+            return FALSE;
+        }
+    } else {
+        pRing = vktrace_SharedRing_open(vktrace_get_global_var(VKTRACE_SHARED_MEMORY_ENV));
+        if (pRing != NULL && !vktrace_SharedRing_claim(pRing)) {
+            // Another process started by the same vktrace, which inherited the ring, is using it
+            vktrace_SharedRing_destroy(&pRing);
+        }
+        useRing = pRing != NULL;
+        if (!vktrace_FileLike_WriteRaw(fileLike, &useRing, sizeof(useRing)) ||
+            !vktrace_FileLike_ReadRaw(fileLike, &useRing, sizeof(useRing))) {
+            vktrace_SharedRing_destroy(&pRing);
+            return FALSE;
+        }
+        if (!useRing) {
+            vktrace_SharedRing_destroy(&pRing);
+        }
+    }
+
+    if (pRing != NULL) {
+        vktrace_LogVerbose("Sending the message stream through shared memory ring %s.", vktrace_SharedRing_get_name(pRing));
+    }
+    pStream->mSharedRing = pRing;
+    return TRUE;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Once the stream uses the shared memory ring neither end sends anything through the socket, so
+// the socket can only become readable by being closed.
+static BOOL vktrace_MessageStream_PeerClosed(MessageStream* pStream) {
+    char peekByte;
+    int peeked = recv(pStream->mSocket, &peekByte, 1, MSG_PEEK);
+    if (peeked == SOCKET_ERROR) {
+        int socketError = VKTRACE_WSAGetLastError();
+        return socketError != WSAEWOULDBLOCK && socketError != EAGAIN;
+    }
+    return peeked == 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Waits a moment for the other end of the shared memory ring, and returns FALSE if it went away
+static BOOL vktrace_MessageStream_WaitForRing(MessageStream* pStream, unsigned int attempt) {
+    if (attempt < kRingSpinAttempts) {
+        vktrace_MessageStream_Yield();
+        if (attempt % kRingPeerCheckInterval != kRingPeerCheckInterval - 1) {
+            return TRUE;
+        }
+    } else {
+        Sleep(1);
+    }
+    return !vktrace_MessageStream_PeerClosed(pStream);
+}
+
+// ------------------------------------------------------------------------------------------------
+static BOOL vktrace_MessageStream_RingSend(MessageStream* pStream, const void* _bytes, size_t _size) {
+    size_t bytesSent = 0;
+    unsigned int attempt = 0;
+    while (bytesSent < _size) {
+        size_t sentThisTime = vktrace_SharedRing_write(pStream->mSharedRing, (const char*)_bytes + bytesSent, _size - bytesSent);
+        if (sentThisTime > 0) {
+            bytesSent += sentThisTime;
+            attempt = 0;
+        } else if (!vktrace_MessageStream_WaitForRing(pStream, attempt++)) {
+            vktrace_LogDebug("Host went away while the shared memory ring was full.");
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// ------------------------------------------------------------------------------------------------
+static BOOL vktrace_MessageStream_RingRecv(MessageStream* pStream, void* _out, size_t _len) {
+    size_t totalDataRead = 0;
+    unsigned int attempt = 0;
+    while (totalDataRead < _len) {
+        size_t dataRead = vktrace_SharedRing_read(pStream->mSharedRing, (char*)_out + totalDataRead, _len - totalDataRead);
+        if (dataRead > 0) {
+            totalDataRead += dataRead;
+            attempt = 0;
+            continue;
+        }
+        if (totalDataRead == 0 && attempt == kRingSpinAttempts) {
+            // Nothing came while spinning, let the caller sleep instead
+            pStream->mErrorNum = WSAEWOULDBLOCK;
+            return FALSE;
+        }
+        if (!vktrace_MessageStream_WaitForRing(pStream, attempt++)) {
+            // Everything the client wrote before closing the socket is in the ring by now
+            dataRead = vktrace_SharedRing_read(pStream->mSharedRing, (char*)_out + totalDataRead, _len - totalDataRead);
+            if (dataRead == 0) {
+                pStream->mErrorNum = WSAECONNRESET;
+                vktrace_LogDebug("Connection was reset by client.");
+                return FALSE;
+            }
+            totalDataRead += dataRead;
+        }
+    }
+    return TRUE;
+}
+
 // ------------------------------------------------------------------------------------------------
 void vktrace_MessageStream_FlushSendBuffer(MessageStream* pStream, BOOL _optional) {
     size_t bufferedByteSize = 0;
@@ -352,12 +605,88 @@ BOOL vktrace_MessageStream_Send(MessageStream* pStream, const void* _bytes, size
     return vktrace_MessageStream_BufferedSend(pStream, _bytes, _len, FALSE);
 }
 
+// ------------------------------------------------------------------------------------------------
+BOOL vktrace_MessageStream_SendGather(MessageStream* pStream, const MessageStreamBuffer* pBuffers, size_t count, BOOL _optional) {
+    if (pStream->mSendBuffer != NULL) {
+        // What is buffered already has to go first
+        vktrace_MessageStream_FlushSendBuffer(pStream, FALSE);
+    }
+
+    if (pStream->mSharedRing != NULL) {
+        vktrace_enter_critical_section(&gSendLock);
+        BOOL result = TRUE;
+        for (size_t i = 0; i < count && result; i++) {
+            result = vktrace_MessageStream_RingSend(pStream, pBuffers[i].pBytes, pBuffers[i].size);
+        }
+        vktrace_leave_critical_section(&gSendLock);
+        return result || _optional;
+    }
+
+#if defined(PLATFORM_POSIX)
+    vktrace_enter_critical_section(&gSendLock);
+    size_t next = 0;
+    while (next < count) {
+        struct iovec iov[kMaxGatherBuffers];
+        int iovCount = 0;
+        for (; iovCount < kMaxGatherBuffers && next < count; iovCount++, next++) {
+            iov[iovCount].iov_base = (void*)pBuffers[next].pBytes;
+            iov[iovCount].iov_len = pBuffers[next].size;
+        }
+
+        struct iovec* pIov = iov;
+        while (iovCount > 0) {
+            ssize_t sentThisTime = writev(pStream->mSocket, pIov, iovCount);
+            if (sentThisTime == SOCKET_ERROR && VKTRACE_WSAGetLastError() == WSAEWOULDBLOCK) {
+                // Try again. Don't sleep, because that nukes performance from orbit.
+                continue;
+            }
+            if (sentThisTime <= 0) {
+                vktrace_leave_critical_section(&gSendLock);
+                if (_optional) {
+                    vktrace_LogDebug("Send on socket failed, giving up on optional message.");
+                }
+                return _optional;
+            }
+
+            // Skip what was sent, which may end in the middle of a buffer
+            while (iovCount > 0 && (size_t)sentThisTime >= pIov->iov_len) {
+                sentThisTime -= pIov->iov_len;
+                pIov++;
+                iovCount--;
+            }
+            if (iovCount > 0) {
+                pIov->iov_base = (char*)pIov->iov_base + sentThisTime;
+                pIov->iov_len -= sentThisTime;
+            }
+        }
+    }
+    vktrace_leave_critical_section(&gSendLock);
+    return TRUE;
+#else
+    // The critical section can be entered again by ReallySend, and keeps the buffers together
+    vktrace_enter_critical_section(&gSendLock);
+    BOOL result = TRUE;
+    for (size_t i = 0; i < count && result; i++) {
+        if (pBuffers[i].size > 0) {
+            result = vktrace_MessageStream_ReallySend(pStream, pBuffers[i].pBytes, pBuffers[i].size, _optional);
+        }
+    }
+    vktrace_leave_critical_section(&gSendLock);
+    return result;
+#endif
+}
+
 // ------------------------------------------------------------------------------------------------
 BOOL vktrace_MessageStream_ReallySend(MessageStream* pStream, const void* _bytes, size_t _size, BOOL _optional) {
     size_t bytesSent = 0;
     assert(_size > 0);
 
     vktrace_enter_critical_section(&gSendLock);
+    if (pStream->mSharedRing != NULL) {
+        BOOL result = vktrace_MessageStream_RingSend(pStream, _bytes, _size);
+        vktrace_leave_critical_section(&gSendLock);
+        return result || _optional;
+    }
     do {
         int sentThisTime = send(pStream->mSocket, (const char*)_bytes + bytesSent, (int)_size - (int)bytesSent, 0);
         if (sentThisTime == SOCKET_ERROR) {
@@ -392,6 +721,9 @@ BOOL vktrace_MessageStream_ReallySend(MessageStream* pStream, const void* _bytes
 BOOL vktrace_MessageStream_Recv(MessageStream* pStream, void* _out, size_t _len) {
     unsigned int totalDataRead = 0;
     unsigned int attempts = 0;
+    if (pStream->mSharedRing != NULL) {
+        return vktrace_MessageStream_RingRecv(pStream, _out, _len);
+    }
     do {
         attempts++;
         int dataRead = recv(pStream->mSocket, ((char*)_out) + totalDataRead, (int)_len - totalDataRead, 0);
@@ -448,6 +780,63 @@ BOOL vktrace_MessageStream_BlockingRecv(MessageStream* pStream, void* _outBuffer
     return TRUE;
 }
 
+// ------------------------------------------------------------------------------------------------
+BOOL vktrace_MessageStream_RecvToFile(MessageStream* pStream, FILE* pFile, size_t _len) {
+#if defined(PLATFORM_LINUX)
+    if (pStream->mSharedRing == NULL && pStream->mSplicePipe[0] == -1 && pipe(pStream->mSplicePipe) != 0) {
+        vktrace_LogWarning("Failed to create a pipe to splice the message stream through, error num %d.", errno);
+        pStream->mSplicePipe[0] = -1;
+    }
+    if (pStream->mSharedRing == NULL && pStream->mSplicePipe[0] != -1) {
+        // The bytes go to the descriptor, behind the back of the FILE
+        if (fflush(pFile) != 0) {
+            return FALSE;
+        }
+        int fd = fileno(pFile);
+        size_t received = 0;
+        while (received < _len) {
+            ssize_t inPipe = splice(pStream->mSocket, NULL, pStream->mSplicePipe[1], NULL, _len - received,
+                                    SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (inPipe == SOCKET_ERROR) {
+                pStream->mErrorNum = VKTRACE_WSAGetLastError();
+                if (pStream->mErrorNum == WSAEWOULDBLOCK || pStream->mErrorNum == EAGAIN) {
+                    struct pollfd pollFd = {pStream->mSocket, POLLIN, 0};
+                    poll(&pollFd, 1, -1);
+                    continue;
+                }
+                vktrace_LogError("Unexpected error (%d) while splicing message stream.", pStream->mErrorNum);
+                return FALSE;
+            } else if (inPipe == 0) {
+                pStream->mErrorNum = WSAECONNRESET;
+                vktrace_LogDebug("Connection was reset by client.");
+                return FALSE;
+            }
+            received += inPipe;
+
+            while (inPipe > 0) {
+                ssize_t written = splice(pStream->mSplicePipe[0], NULL, fd, NULL, inPipe, SPLICE_F_MOVE | SPLICE_F_MORE);
+                if (written <= 0) {
+                    vktrace_LogError("Failed to splice message stream to file, error num %d.", errno);
+                    return FALSE;
+                }
+                inPipe -= written;
+            }
+        }
+        return Fseek(pFile, 0, SEEK_END) == 0;
+    }
+#endif
+
+    char buffer[64 * 1024];
+    while (_len > 0) {
+        size_t size = _len < sizeof(buffer) ? _len : sizeof(buffer);
+        if (!vktrace_MessageStream_BlockingRecv(pStream, buffer, size) || fwrite(buffer, 1, size, pFile) != size) {
+            return FALSE;
+        }
+        _len -= size;
+    }
+    return TRUE;
+}
+
 // ------------------------------------------------------------------------------------------------
 // ------------------------------------------------------------------------------------------------
 // ------------------------------------------------------------------------------------------------
@@ -23,6 +23,7 @@
 
 #include <errno.h>
 #include "vktrace_common.h"
+#include "vktrace_shared_ring.h"
 
 #if defined(PLATFORM_POSIX)
 #include <arpa/inet.h>
@@ -68,19 +69,49 @@ typedef struct MessageStream {
 
     BOOL mHost;
     int mErrorNum;
+
+    // Set if the handshake moved the stream to the shared memory ring vktrace created for the
+    // program. The socket then only tells either end when the other one went away.
+    SharedRing* mSharedRing;
+
+    // On the host, the process id the client sent in the handshake
+    vktrace_process_id mPeerProcessId;
+
+#if defined(PLATFORM_LINUX)
+    // Pipe that vktrace_MessageStream_RecvToFile splices through, created on first use
+    int mSplicePipe[2];
+#endif
 } MessageStream;
 
+// One of the buffers vktrace_MessageStream_SendGather sends in order
+typedef struct MessageStreamBuffer {
+    const void* pBytes;
+    size_t size;
+} MessageStreamBuffer;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 MessageStream* vktrace_MessageStream_create_port_string(BOOL _isHost, const char* _address, const char* _port);
 MessageStream* vktrace_MessageStream_create(BOOL _isHost, const char* _address, unsigned int _port);
 void vktrace_MessageStream_destroy(MessageStream** ppStream);
+// A host that takes any number of clients listens with vktrace_MessageStream_listen, and gets each
+// client's stream from vktrace_MessageStream_accept. The accept waits at most _timeoutMs for a
+// client, and returns NULL if none connected by then or the handshake with it failed.
+SOCKET vktrace_MessageStream_listen(unsigned int _port);
+MessageStream* vktrace_MessageStream_accept(SOCKET listenSocket, unsigned int _port, unsigned int _timeoutMs);
+void vktrace_MessageStream_close_listener(SOCKET listenSocket);
 BOOL vktrace_MessageStream_BufferedSend(MessageStream* pStream, const void* _bytes, size_t _size, BOOL _optional);
 BOOL vktrace_MessageStream_Send(MessageStream* pStream, const void* _bytes, size_t _len);
+// Sends the buffers as one message without copying them together first
+BOOL vktrace_MessageStream_SendGather(MessageStream* pStream, const MessageStreamBuffer* pBuffers, size_t count, BOOL _optional);
 
 BOOL vktrace_MessageStream_Recv(MessageStream* pStream, void* _out, size_t _len);
 BOOL vktrace_MessageStream_BlockingRecv(MessageStream* pStream, void* _outBuffer, size_t _len);
+// Receives _len bytes and writes them to the end of pFile. On Linux they are spliced from the
+// socket to the file, without being copied through the process, unless the stream uses a
+// shared memory ring.
+BOOL vktrace_MessageStream_RecvToFile(MessageStream* pStream, FILE* pFile, size_t _len);
 
 extern MessageStream* gMessageStream;
 #ifdef __cplusplus
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "vktrace_packet_arena.h"
+#include "vktrace_platform.h"
+
+#if defined(WIN32)
+#define ARENA_ATOMIC_INC(_p) InterlockedIncrement((volatile LONG*)(_p))
+#define ARENA_ATOMIC_DEC(_p) InterlockedDecrement((volatile LONG*)(_p))
+#define ARENA_ATOMIC_LOAD(_p) InterlockedCompareExchange((volatile LONG*)(_p), 0, 0)
+#else
+#define ARENA_ATOMIC_INC(_p) __sync_add_and_fetch((_p), 1)
+#define ARENA_ATOMIC_DEC(_p) __sync_sub_and_fetch((_p), 1)
+#define ARENA_ATOMIC_LOAD(_p) __sync_fetch_and_add((_p), 0)
+#endif
+
+typedef struct PacketArenaBlock {
+    // One reference per live packet, plus one while a thread is allocating from the block
+    volatile int32_t refCount;
+    // Only touched by the thread allocating from the block
+    uint32_t offset;
+    // Set while a thread is allocating from the block, so teardown can tell its reference from a live packet
+    volatile BOOL threadOwned;
+    struct PacketArenaBlock* pNextFree;
+} PacketArenaBlock;
+
+static uint8_t* s_pRegion = NULL;
+static BOOL s_enabled = FALSE;
+static PacketArenaBlock s_blocks[VKTRACE_PACKET_ARENA_BLOCK_COUNT];
+static PacketArenaBlock* s_pFreeBlocks = NULL;
+static VKTRACE_CRITICAL_SECTION s_freeBlocksLock;
+
+static VKTRACE_THREAD_LOCAL PacketArenaBlock* s_pThreadBlock = NULL;
+#if !defined(WIN32)
+// Gives the thread's block back when the thread exits, on Windows vktrace_packet_arena_thread_exit is called from DllMain
+static pthread_key_t s_threadBlockKey;
+#endif
+
+// ------------------------------------------------------------------------------------------------
+static PacketArenaBlock* vktrace_packet_arena_acquire_block() {
+    PacketArenaBlock* pBlock;
+    vktrace_enter_critical_section(&s_freeBlocksLock);
+    pBlock = s_pFreeBlocks;
+    if (pBlock != NULL) {
+        s_pFreeBlocks = pBlock->pNextFree;
+    }
+    vktrace_leave_critical_section(&s_freeBlocksLock);
+
+    if (pBlock != NULL) {
+        pBlock->pNextFree = NULL;
+        pBlock->offset = 0;
+        pBlock->refCount = 1;
+        pBlock->threadOwned = TRUE;
+    }
+    return pBlock;
+}
+
+// ------------------------------------------------------------------------------------------------
+static void vktrace_packet_arena_release_block(PacketArenaBlock* pBlock) {
+    if (ARENA_ATOMIC_DEC(&pBlock->refCount) != 0) return;
+
+    vktrace_enter_critical_section(&s_freeBlocksLock);
+    pBlock->pNextFree = s_pFreeBlocks;
+    s_pFreeBlocks = pBlock;
+    vktrace_leave_critical_section(&s_freeBlocksLock);
+}
+
+// ------------------------------------------------------------------------------------------------
+// Drops the reference of the thread allocating from pBlock
+static void vktrace_packet_arena_release_thread_block(PacketArenaBlock* pBlock) {
+    pBlock->threadOwned = FALSE;
+    vktrace_packet_arena_release_block(pBlock);
+}
+
+#if !defined(WIN32)
+// ------------------------------------------------------------------------------------------------
+static void vktrace_packet_arena_thread_key_destructor(void* pBlock) {
+    s_pThreadBlock = NULL;
+    vktrace_packet_arena_release_thread_block((PacketArenaBlock*)pBlock);
+}
+#endif
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_packet_arena_thread_exit() {
+    PacketArenaBlock* pBlock = s_pThreadBlock;
+    if (pBlock != NULL && s_enabled) {
+        s_pThreadBlock = NULL;
+        vktrace_packet_arena_release_thread_block(pBlock);
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_packet_arena_initialize() {
+    uint32_t i;
+
+    if (s_pRegion == NULL) {
+        vktrace_create_critical_section(&s_freeBlocksLock);
+        // Only the pages that actually get used are backed by memory
+        s_pRegion = (uint8_t*)malloc((size_t)VKTRACE_PACKET_ARENA_BLOCK_SIZE * VKTRACE_PACKET_ARENA_BLOCK_COUNT);
+        if (s_pRegion == NULL) {
+            vktrace_LogWarning("Unable to allocate the trace packet arena, packets will be allocated individually.");
+            return;
+        }
+        for (i = 0; i < VKTRACE_PACKET_ARENA_BLOCK_COUNT; i++) {
+            s_blocks[i].refCount = 0;
+            s_blocks[i].offset = 0;
+            s_blocks[i].threadOwned = FALSE;
+            s_blocks[i].pNextFree = (i + 1 < VKTRACE_PACKET_ARENA_BLOCK_COUNT) ? &s_blocks[i + 1] : NULL;
+        }
+        s_pFreeBlocks = &s_blocks[0];
+    }
+#if !defined(WIN32)
+    if (pthread_key_create(&s_threadBlockKey, vktrace_packet_arena_thread_key_destructor) != 0) {
+        vktrace_LogWarning("Unable to register the trace packet arena for thread exit, packets will be allocated individually.");
+        return;
+    }
+#endif
+    s_enabled = TRUE;
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_packet_arena_deinitialize() {
+    uint32_t i;
+    BOOL packetsAlive = FALSE;
+
+    if (!s_enabled) {
+        return;
+    }
+    s_enabled = FALSE;
+#if !defined(WIN32)
+    // Threads still holding a block don't give it back anymore, the whole region goes below
+    pthread_key_delete(s_threadBlockKey);
+#endif
+    s_pThreadBlock = NULL;
+
+    // Packets can still be alive if a thread is tracing while the layer unloads, then the region is
+    // left for them rather than pulled from under them
+    for (i = 0; i < VKTRACE_PACKET_ARENA_BLOCK_COUNT; i++) {
+        if (ARENA_ATOMIC_LOAD(&s_blocks[i].refCount) > (s_blocks[i].threadOwned ? 1 : 0)) {
+            packetsAlive = TRUE;
+            break;
+        }
+    }
+    if (packetsAlive) {
+        vktrace_LogVerbose("Trace packets are still alive, the trace packet arena is not freed.");
+        return;
+    }
+    free(s_pRegion);
+    s_pRegion = NULL;
+    s_pFreeBlocks = NULL;
+    vktrace_delete_critical_section(&s_freeBlocksLock);
+}
+
+// ------------------------------------------------------------------------------------------------
+void* vktrace_packet_arena_alloc(size_t size) {
+    PacketArenaBlock* pBlock = s_pThreadBlock;
+    void* pMemory;
+
+    if (!s_enabled || size > VKTRACE_PACKET_ARENA_MAX_PACKET_SIZE) {
+        return NULL;
+    }
+    size = ROUNDUP_TO_8(size);
+
+    if (pBlock != NULL) {
+        if (ARENA_ATOMIC_LOAD(&pBlock->refCount) == 1) {
+            // Everything allocated from the block so far has been deleted, start over at the beginning
+            pBlock->offset = 0;
+        } else if (pBlock->offset + size > VKTRACE_PACKET_ARENA_BLOCK_SIZE) {
+            // Move on, the block is recycled once its last packet is deleted
+            vktrace_packet_arena_release_thread_block(pBlock);
+            pBlock = NULL;
+        }
+    }
+    if (pBlock == NULL) {
+        pBlock = vktrace_packet_arena_acquire_block();
+        s_pThreadBlock = pBlock;
+#if !defined(WIN32)
+        pthread_setspecific(s_threadBlockKey, pBlock);
+#endif
+        if (pBlock == NULL) {
+            return NULL;
+        }
+    }
+
+    pMemory = s_pRegion + (size_t)(pBlock - s_blocks) * VKTRACE_PACKET_ARENA_BLOCK_SIZE + pBlock->offset;
+    pBlock->offset += (uint32_t)size;
+    ARENA_ATOMIC_INC(&pBlock->refCount);
+    return pMemory;
+}
+
+// ------------------------------------------------------------------------------------------------
+BOOL vktrace_packet_arena_free(void* pMemory) {
+    uint8_t* pBytes = (uint8_t*)pMemory;
+    if (s_pRegion == NULL || pBytes < s_pRegion ||
+        pBytes >= s_pRegion + (size_t)VKTRACE_PACKET_ARENA_BLOCK_SIZE * VKTRACE_PACKET_ARENA_BLOCK_COUNT) {
+        return FALSE;
+    }
+
+    vktrace_packet_arena_release_block(&s_blocks[(size_t)(pBytes - s_pRegion) / VKTRACE_PACKET_ARENA_BLOCK_SIZE]);
+    return TRUE;
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  Packet arena
+//
+//     Most intercepted calls produce a packet of a few dozen bytes that lives only until it has
+//     been written to the trace, so going to the heap for each one costs more than building it,
+//     and recording threads contend on the allocator.
+//
+//     The arena is one region carved into fixed size blocks. Each thread bump-allocates small
+//     packets out of a block of its own. A block counts the packets still alive in it, and once
+//     the thread has moved on to another block and the last of them is deleted (normally by
+//     whoever wrote it out) the block goes back on the free list for any thread to reuse.
+//
+//     vktrace_delete_trace_packet hands every packet to vktrace_packet_arena_free first, which
+//     only has to look at the address to tell arena packets from heap packets, so packets from
+//     vktrace_read_trace_packet or those copied with malloc can still be deleted the same way.
+
+#pragma once
+
+#include "vktrace_common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Blocks are this big, and packets larger than VKTRACE_PACKET_ARENA_MAX_PACKET_SIZE always come from the heap.
+#define VKTRACE_PACKET_ARENA_BLOCK_SIZE (64 * 1024)
+#define VKTRACE_PACKET_ARENA_BLOCK_COUNT 512
+#define VKTRACE_PACKET_ARENA_MAX_PACKET_SIZE (4 * 1024)
+
+// Only the trace layer uses the arena, so only it initializes it; packets of the other tools come
+// from the heap.
+void vktrace_packet_arena_initialize();
+
+// Stops handing out arena memory and frees the region, unless packets are still alive in it.
+void vktrace_packet_arena_deinitialize();
+
+// Gives the calling thread's block back. Called on thread exit, through a pthread key destructor or
+// from DllMain on Windows.
+void vktrace_packet_arena_thread_exit();
+
+// Returns NULL if size is too large, the arena isn't initialized or every block is in use; the
+// caller should use the heap instead.
+void* vktrace_packet_arena_alloc(size_t size);
+
+// Releases pMemory if it came from vktrace_packet_arena_alloc. Returns FALSE, without touching
+// pMemory, if it didn't.
+BOOL vktrace_packet_arena_free(void* pMemory);
+
+#ifdef __cplusplus
+}
+#endif
@@ -17,7 +17,16 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <vector>
+#if defined(PLATFORM_LINUX)
+#include <sched.h>
+#endif
 #include "vktrace_pageguard_memorycopy.h"
+#include "vktrace_common.h"
 
 #define OPTIMIZATION_FUNCTION_IMPLEMENTATION
 
@@ -141,74 +150,187 @@ extern "C" void *vktrace_pageguard_memcpy(void *destination, const void *source,
     }
     return pRet;
 }
+
+void vktrace_pageguard_run_tasks_multithread(vktrace_pageguard_ptr_task_unit_function pfunc, void **ppTaskUnitParas, int amount) {
+    parallel_for(0, amount, [pfunc, ppTaskUnitParas](int i) { pfunc(ppTaskUnitParas[i]); });
+}
 #else  // defined(PAGEGUARD_MEMCPY_USE_PPL_LIB), Linux
 extern "C" void *vktrace_pageguard_memcpy(void *destination, const void *source, size_t size) {
     return memcpy(destination, source, (size_t)size);
 }
+
+void vktrace_pageguard_run_tasks_multithread(vktrace_pageguard_ptr_task_unit_function pfunc, void **ppTaskUnitParas, int amount) {
+    for (int i = 0; i < amount; i++) {
+        pfunc(ppTaskUnitParas[i]);
+    }
+}
 #endif
 
 #else  //! defined(PAGEGUARD_MEMCPY_USE_PPL_LIB), use cross-platform memcpy multithread which exclude PPL
 
-typedef void (*vktrace_pageguard_ptr_task_unit_function)(void *pTaskUnitParaInput);
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PAGEGUARD_MEMCPY_USE_STREAMING
+#include <emmintrin.h>
+#endif
 
-typedef struct {
-    void *src, *dest;
-    size_t size;
-} vktrace_pageguard_task_unit_parameters;
+static const size_t PAGEGUARD_MEMCPY_MULTITHREAD_UNIT_SIZE = 0x10000;
+
+// Copies at least this large are written with non-temporal stores. Their destination is a trace buffer or a copy of mapped
+// memory which won't be read again soon, and caching it would only evict what the application works on.
+static const size_t PAGEGUARD_MEMCPY_STREAMING_SIZE = 8 * 1024 * 1024;
+
+// The copy sizes the calibration times, the largest first.
+static const size_t PAGEGUARD_CALIBRATION_MAX_SIZE = 8 * 1024 * 1024;
+static const size_t PAGEGUARD_CALIBRATION_MIN_SIZE = 64 * 1024;
+static const int PAGEGUARD_CALIBRATION_RUNS = 3;
 
+// vktrace_pageguard_memcpy copies on the workers from this size on. It is measured when the workers start, see
+// pageguard_calibrate_parallel_size.
+static size_t pageguard_memcpy_parallel_size = SIZE_LIMIT_TO_USE_OPTIMIZATION;
+
+// Set on the worker threads. A task that copies memory must not queue the copy to the workers, they are all busy running tasks.
+static VKTRACE_THREAD_LOCAL bool is_pageguard_worker_thread = false;
+
+// The worker threads only exist between vktrace_pageguard_init_multi_threads_memcpy and vktrace_pageguard_done_multi_threads_memcpy.
+static bool pageguard_worker_threads_ready = false;
+
+// The job the workers run, one at a time. If pfunc!=nullptr, unit i runs pfunc(ppTaskUnitParas[i]), otherwise it copies
+// unit_size bytes at offset i * unit_size from src to dest, the last unit also copies what is left. The workers and the
+// thread that queued the job take the units in turn by incrementing next, which needs no lock.
 typedef struct {
-    int index;
-    vktrace_pageguard_task_unit_parameters *ptask_units;
+    vktrace_pageguard_ptr_task_unit_function pfunc;
+    void **ppTaskUnitParas;
+    uint8_t *dest;
+    const uint8_t *src;
+    size_t size;
+    size_t unit_size;
+    bool streaming;
     int amount;
-    vktrace_sem_id sem_id_access;
-} vktrace_pageguard_task_queue;
+    std::atomic<int> next;
+} vktrace_pageguard_job;
+
+static vktrace_pageguard_job pageguard_job;
 
 typedef struct {
-    int index;
     vktrace_pageguard_thread_id thread_id;
     vktrace_sem_id sem_id_task_start;
     vktrace_sem_id sem_id_task_end;
-    // vktrace_pageguard_task_unit_parameters *ptask_para;
-} vktrace_pageguard_task_control_block;
+    int cpu;  // The cpu the worker is pinned to, -1 if it isn't
+} vktrace_pageguard_worker;
+
+static std::vector<vktrace_pageguard_worker> pageguard_workers;
+
+// Makes the workers return instead of running a job the next time they are started.
+static bool pageguard_workers_stop = false;
+
+#if defined(PAGEGUARD_MEMCPY_USE_STREAMING)
+static void pageguard_memcpy_streaming(uint8_t *dest, const uint8_t *src, size_t size) {
+    // Non-temporal stores have to be aligned, the head up to the first 16 byte boundary and the tail are copied normally.
+    size_t head = (16 - ((uintptr_t)dest & 15)) & 15;
+    if (head > size) {
+        head = size;
+    }
+    memcpy(dest, src, head);
+    size_t pos = head;
+    for (; pos + 64 <= size; pos += 64) {
+        __m128i data0 = _mm_loadu_si128((const __m128i *)(src + pos));
+        __m128i data1 = _mm_loadu_si128((const __m128i *)(src + pos + 16));
+        __m128i data2 = _mm_loadu_si128((const __m128i *)(src + pos + 32));
+        __m128i data3 = _mm_loadu_si128((const __m128i *)(src + pos + 48));
+        _mm_stream_si128((__m128i *)(dest + pos), data0);
+        _mm_stream_si128((__m128i *)(dest + pos + 16), data1);
+        _mm_stream_si128((__m128i *)(dest + pos + 32), data2);
+        _mm_stream_si128((__m128i *)(dest + pos + 48), data3);
+    }
+    memcpy(dest + pos, src + pos, size - pos);
+    // Non-temporal stores are weakly ordered, they must be visible before the job is reported done.
+    _mm_sfence();
+}
+#endif
+
+static void pageguard_run_job_units() {
+    vktrace_pageguard_job &job = pageguard_job;
+    int i;
+    while ((i = job.next.fetch_add(1)) < job.amount) {
+        if (job.pfunc != nullptr) {
+            job.pfunc(job.ppTaskUnitParas[i]);
+            continue;
+        }
+        size_t offset = i * job.unit_size;
+        size_t size = ((i + 1) == job.amount) ? job.size - offset : job.unit_size;
+#if defined(PAGEGUARD_MEMCPY_USE_STREAMING)
+        if (job.streaming) {
+            pageguard_memcpy_streaming(job.dest + offset, job.src + offset, size);
+            continue;
+        }
+#endif
+        memcpy(job.dest + offset, job.src + offset, size);
+    }
+}
+
+// Runs the job on the workers and the calling thread, and returns once all its units are done. glocal_sem_id must be held.
+static void pageguard_run_job() {
+    for (size_t i = 0; i < pageguard_workers.size(); i++) {
+        vktrace_sem_post(pageguard_workers[i].sem_id_task_start);
+    }
+    is_pageguard_worker_thread = true;
+    pageguard_run_job_units();
+    is_pageguard_worker_thread = false;
+    for (size_t i = 0; i < pageguard_workers.size(); i++) {
+        vktrace_sem_wait(pageguard_workers[i].sem_id_task_end);
+    }
+}
+
+static void pageguard_pin_current_thread(int cpu) {
+    if (cpu < 0) {
+        return;
+    }
+#if defined(WIN32)
+    if (cpu < (int)(sizeof(DWORD_PTR) * 8)) {
+        SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu);
+    }
+#elif defined(PLATFORM_LINUX)
+    if (cpu < CPU_SETSIZE) {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(cpu, &cpuSet);
+        // 0 is the calling thread
+        sched_setaffinity(0, sizeof(cpuSet), &cpuSet);
+    }
+#endif
+}
 
 #if defined(WIN32)
-typedef uint32_t (*vktrace_pageguard_thread_function_ptr)(void *parameters);
+typedef DWORD(WINAPI *vktrace_pageguard_thread_function_ptr)(void *parameters);
 #else
 typedef void *(*vktrace_pageguard_thread_function_ptr)(void *parameters);
 #endif
 bool vktrace_pageguard_create_thread(vktrace_pageguard_thread_id *ptid, vktrace_pageguard_thread_function_ptr pfunc,
-                                     vktrace_pageguard_task_control_block *ptaskpara) {
+                                     void *pparameters) {
     bool create_thread_ok = false;
 #if defined(WIN32)
     DWORD dwThreadID;
-    HANDLE thread_handle;
-    thread_handle = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)pfunc, ptaskpara, 0, &dwThreadID);
-
-    if (thread_handle != INVALID_HANDLE_VALUE) {
+    HANDLE thread_handle = CreateThread(NULL, 0, pfunc, pparameters, 0, &dwThreadID);
+    if (thread_handle != NULL) {
         *ptid = thread_handle;
         create_thread_ok = true;
     }
-
 #else
     pthread_t thread;
-    int state = PTHREAD_CANCEL_ENABLE, oldtype;
-    state = PTHREAD_CANCEL_ASYNCHRONOUS;
-    pthread_setcanceltype(state, &oldtype);
-    if (pthread_create(&thread, NULL, pfunc, (void *)ptaskpara) == 0) {
+    if (pthread_create(&thread, NULL, pfunc, pparameters) == 0) {
         *ptid = thread;
         create_thread_ok = true;
     }
-    pthread_setcanceltype(oldtype, &state);
 #endif
     return create_thread_ok;
 }
 
-void vktrace_pageguard_delete_thread(vktrace_pageguard_thread_id tid) {
+// Waits for a thread that was told to stop to return.
+void vktrace_pageguard_join_thread(vktrace_pageguard_thread_id tid) {
 #if defined(WIN32)
-    DWORD dwExitCode = 0;
-    TerminateThread((HANDLE)tid, dwExitCode);
+    WaitForSingleObject((HANDLE)tid, INFINITE);
+    CloseHandle((HANDLE)tid);
 #else
-    pthread_cancel((pthread_t)tid);
     pthread_join((pthread_t)tid, NULL);
 #endif
 }
@@ -225,77 +347,180 @@ int vktrace_pageguard_get_cpu_core_count() {
     return iret;
 }
 
-vktrace_pageguard_task_queue *vktrace_pageguard_get_task_queue() {
-    static vktrace_pageguard_task_queue *pvktrace_pageguard_task_queue_multi_thread_memcpy = nullptr;
-    if (!pvktrace_pageguard_task_queue_multi_thread_memcpy) {
-        pvktrace_pageguard_task_queue_multi_thread_memcpy = new vktrace_pageguard_task_queue;
-        memset(reinterpret_cast<void *>(pvktrace_pageguard_task_queue_multi_thread_memcpy), 0,
-               sizeof(vktrace_pageguard_task_queue));
-        vktrace_sem_create(&pvktrace_pageguard_task_queue_multi_thread_memcpy->sem_id_access, 1);
+#if defined(PLATFORM_LINUX)
+// Parses a sysfs cpu list like "0-7,16-23".
+static std::vector<int> pageguard_parse_cpu_list(const char *pList) {
+    std::vector<int> cpus;
+    const char *pNext = pList;
+    while (*pNext >= '0' && *pNext <= '9') {
+        char *pEnd;
+        long first = strtol(pNext, &pEnd, 10), last = first;
+        if (*pEnd == '-') {
+            pNext = pEnd + 1;
+            last = strtol(pNext, &pEnd, 10);
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            cpus.push_back((int)cpu);
+        }
+        pNext = (*pEnd == ',') ? pEnd + 1 : pEnd;
     }
-    return pvktrace_pageguard_task_queue_multi_thread_memcpy;
+    return cpus;
 }
+#endif
 
-vktrace_pageguard_task_unit_parameters *vktrace_pageguard_get_task_unit_parameters() {
-    vktrace_pageguard_task_unit_parameters *pret = nullptr;
-    vktrace_pageguard_task_queue *ptaskqueue = vktrace_pageguard_get_task_queue();
-    vktrace_sem_wait(ptaskqueue->sem_id_access);
-    if (ptaskqueue->index < ptaskqueue->amount) {
-        pret = &ptaskqueue->ptask_units[ptaskqueue->index];
-        ptaskqueue->index++;
+// Returns the cpus of the NUMA node the calling thread runs on, the node whose memory the application most likely
+// allocated its buffers from. Returns all cpus if the node can't be found out.
+static std::vector<int> pageguard_get_local_node_cpus() {
+    std::vector<int> cpus;
+#if defined(WIN32)
+    UCHAR node;
+    ULONGLONG mask;
+    if (GetNumaProcessorNode((UCHAR)GetCurrentProcessorNumber(), &node) && GetNumaNodeProcessorMask(node, &mask)) {
+        for (int cpu = 0; cpu < (int)(sizeof(DWORD_PTR) * 8); cpu++) {
+            if ((mask >> cpu) & 1) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#elif defined(PLATFORM_LINUX)
+    int currentCpu = sched_getcpu();
+    for (int node = 0; currentCpu >= 0; node++) {
+        char path[64], list[1024];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *pFile = fopen(path, "r");
+        if (pFile == NULL) {
+            break;
+        }
+        bool read_ok = (fgets(list, sizeof(list), pFile) != NULL);
+        fclose(pFile);
+        std::vector<int> nodeCpus;
+        if (read_ok) {
+            nodeCpus = pageguard_parse_cpu_list(list);
+        }
+        if (std::find(nodeCpus.begin(), nodeCpus.end(), currentCpu) != nodeCpus.end()) {
+            cpus = nodeCpus;
+            break;
+        }
     }
-    vktrace_sem_post(ptaskqueue->sem_id_access);
-    return pret;
+#endif
+    if (cpus.empty()) {
+        int core_count = vktrace_pageguard_get_cpu_core_count();
+        for (int cpu = 0; cpu < core_count; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
 }
 
-vktrace_pageguard_task_control_block *vktrace_pageguard_get_task_control_block() {
-    static vktrace_pageguard_task_control_block *ptask_control_block = nullptr;
-    if (!ptask_control_block) {
-        int thread_number = vktrace_pageguard_get_cpu_core_count();
-        ptask_control_block = reinterpret_cast<vktrace_pageguard_task_control_block *>(
-            new uint8_t[thread_number * sizeof(vktrace_pageguard_task_control_block)]);
-        memset((void *)ptask_control_block, 0, thread_number * sizeof(vktrace_pageguard_task_control_block));
+#if defined(WIN32)
+static DWORD WINAPI vktrace_pageguard_thread_function(void *pworkerpara)
+#else
+static void *vktrace_pageguard_thread_function(void *pworkerpara)
+#endif
+{
+    vktrace_pageguard_worker *pworker = reinterpret_cast<vktrace_pageguard_worker *>(pworkerpara);
+    is_pageguard_worker_thread = true;
+    pageguard_pin_current_thread(pworker->cpu);
+    while (1) {
+        vktrace_sem_wait(pworker->sem_id_task_start);
+        if (pageguard_workers_stop) {
+            break;
+        }
+        pageguard_run_job_units();
+        vktrace_sem_post(pworker->sem_id_task_end);
     }
-    return ptask_control_block;
+    return 0;
 }
 
-uint32_t vktrace_pageguard_thread_function(void *ptcbpara) {
-    vktrace_pageguard_task_control_block *ptasktcb = reinterpret_cast<vktrace_pageguard_task_control_block *>(ptcbpara);
-    vktrace_pageguard_task_unit_parameters *parameters;
-    bool stop_loop;
-    while (1) {
-        vktrace_sem_wait(ptasktcb->sem_id_task_start);
-        stop_loop = false;
-        while (!stop_loop) {
-            parameters = vktrace_pageguard_get_task_unit_parameters();
-            if (parameters != nullptr) {
-                memcpy(parameters->dest, parameters->src, parameters->size);
-            } else {
-                stop_loop = true;
-            }
+// Tells the workers to return and waits for them, running workers are idle as jobs are run under glocal_sem_id.
+static void pageguard_stop_workers() {
+    pageguard_workers_stop = true;
+    for (size_t i = 0; i < pageguard_workers.size(); i++) {
+        vktrace_sem_post(pageguard_workers[i].sem_id_task_start);
+    }
+    for (size_t i = 0; i < pageguard_workers.size(); i++) {
+        vktrace_pageguard_join_thread(pageguard_workers[i].thread_id);
+        vktrace_sem_delete(pageguard_workers[i].sem_id_task_start);
+        vktrace_sem_delete(pageguard_workers[i].sem_id_task_end);
+    }
+    pageguard_workers.clear();
+    pageguard_workers_stop = false;
+}
+
+// Starts one worker on each cpu of the local NUMA node but one, the thread that queues a job runs units too.
+static bool pageguard_start_workers() {
+    std::vector<int> cpus = pageguard_get_local_node_cpus();
+    size_t worker_count = (cpus.size() > 1) ? cpus.size() - 1 : 1;
+    // The workers point to their entry, it must not move while they start.
+    pageguard_workers.reserve(worker_count);
+    for (size_t i = 0; i < worker_count; i++) {
+        vktrace_pageguard_worker worker;
+        worker.cpu = cpus[(i + 1) % cpus.size()];
+        if (!vktrace_sem_create(&worker.sem_id_task_start, 0)) {
+            break;
         }
-        vktrace_sem_post(ptasktcb->sem_id_task_end);
-    }
-}
-
-bool vktrace_pageguard_init_multi_threads_memcpy_custom(vktrace_pageguard_thread_function_ptr pfunc) {
-    bool init_multi_threads_memcpy_custom_ok = false, success_sem_start = false, success_sem_end = false, success_thread = false;
-    vktrace_pageguard_task_control_block *ptcb = vktrace_pageguard_get_task_control_block();
-    int thread_number = vktrace_pageguard_get_cpu_core_count();
-    for (int i = 0; i < thread_number; i++) {
-        success_sem_start = vktrace_sem_create(&ptcb[i].sem_id_task_start, 0);
-        success_sem_end = vktrace_sem_create(&ptcb[i].sem_id_task_end, 0);
-        ptcb[i].index = i;
-        success_thread =
-            vktrace_pageguard_create_thread(&ptcb[i].thread_id, (vktrace_pageguard_thread_function_ptr)pfunc, &ptcb[i]);
-        if (success_sem_start && success_sem_end && success_thread) {
-            init_multi_threads_memcpy_custom_ok = true;
-        } else {
-            init_multi_threads_memcpy_custom_ok = false;
+        if (!vktrace_sem_create(&worker.sem_id_task_end, 0)) {
+            vktrace_sem_delete(worker.sem_id_task_start);
             break;
         }
+        pageguard_workers.push_back(worker);
+        if (!vktrace_pageguard_create_thread(&pageguard_workers.back().thread_id, vktrace_pageguard_thread_function,
+                                             &pageguard_workers.back())) {
+            vktrace_sem_delete(worker.sem_id_task_start);
+            vktrace_sem_delete(worker.sem_id_task_end);
+            pageguard_workers.pop_back();
+            break;
+        }
+    }
+    if (pageguard_workers.size() != worker_count) {
+        pageguard_stop_workers();
+        return false;
+    }
+    return true;
+}
+
+static double pageguard_time_copy(bool parallel, void *dest, const void *src, size_t size) {
+    double best = 0;
+    for (int run = 0; run < PAGEGUARD_CALIBRATION_RUNS; run++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (parallel) {
+            vktrace_pageguard_memcpy_multithread(dest, src, size);
+        } else {
+            memcpy(dest, src, size);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (run == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+// Times copies on the calling thread and on the workers, halving the size from PAGEGUARD_CALIBRATION_MAX_SIZE, and returns
+// the smallest size from which the workers were faster at every size tried. Where the workers start paying off depends on
+// the number of cores and the memory bandwidth, a fixed size is too small for some machines and too large for others.
+static size_t pageguard_calibrate_parallel_size() {
+    uint8_t *pSource = new (std::nothrow) uint8_t[PAGEGUARD_CALIBRATION_MAX_SIZE];
+    uint8_t *pDestination = new (std::nothrow) uint8_t[PAGEGUARD_CALIBRATION_MAX_SIZE];
+    size_t parallel_size = SIZE_LIMIT_TO_USE_OPTIMIZATION;
+    if (pSource != nullptr && pDestination != nullptr) {
+        // Touch both buffers first, so page faults aren't timed
+        memset(pSource, 0x5a, PAGEGUARD_CALIBRATION_MAX_SIZE);
+        memset(pDestination, 0, PAGEGUARD_CALIBRATION_MAX_SIZE);
+        parallel_size = SIZE_MAX;
+        for (size_t size = PAGEGUARD_CALIBRATION_MAX_SIZE; size >= PAGEGUARD_CALIBRATION_MIN_SIZE; size /= 2) {
+            double single = pageguard_time_copy(false, pDestination, pSource, size);
+            double parallel = pageguard_time_copy(true, pDestination, pSource, size);
+            // Ask for a clear win, the workers also take cores away from the application.
+            if (parallel * 1.1 >= single) {
+                break;
+            }
+            parallel_size = size;
+        }
     }
-    return init_multi_threads_memcpy_custom_ok;
+    delete[] pSource;
+    delete[] pDestination;
+    return parallel_size;
 }
 
 static vktrace_sem_id glocal_sem_id;
@@ -322,78 +547,53 @@ int vktrace_pageguard_ref_count(bool release) {
 extern "C" BOOL vktrace_pageguard_init_multi_threads_memcpy() {
     int refnum = vktrace_pageguard_ref_count(false);
     BOOL init_multi_threads_memcpy_ok = TRUE;
-    vktrace_pageguard_thread_function_ptr pfunc = (vktrace_pageguard_thread_function_ptr)vktrace_pageguard_thread_function;
     if (!refnum) {
-        init_multi_threads_memcpy_ok = vktrace_pageguard_init_multi_threads_memcpy_custom(pfunc);
+        init_multi_threads_memcpy_ok = pageguard_start_workers() ? TRUE : FALSE;
+        if (init_multi_threads_memcpy_ok) {
+            // The size is only measured once, later inits reuse it.
+            static size_t calibrated_size = 0;
+            const char *env_parallel_size = vktrace_get_global_var(VKTRACE_PMB_PARALLEL_COPY_SIZE_ENV);
+            if (env_parallel_size != NULL && *env_parallel_size != '\0') {
+                pageguard_memcpy_parallel_size = (size_t)strtoull(env_parallel_size, NULL, 10);
+            } else {
+                if (calibrated_size == 0) {
+                    calibrated_size = pageguard_calibrate_parallel_size();
+                    if (calibrated_size == SIZE_MAX) {
+                        vktrace_LogVerbose("Copies on %zu threads were never faster than on one, large copies stay on one thread.",
+                                           pageguard_workers.size() + 1);
+                    } else {
+                        vktrace_LogVerbose("Copies of %zu bytes or more are split across %zu threads.", calibrated_size,
+                                           pageguard_workers.size() + 1);
+                    }
+                }
+                pageguard_memcpy_parallel_size = calibrated_size;
+            }
+            pageguard_worker_threads_ready = true;
+        }
     }
     return init_multi_threads_memcpy_ok;
 }
 
-void vktrace_pageguard_delete_task_control_block() { delete[] vktrace_pageguard_get_task_control_block(); }
-
-void vktrace_pageguard_delete_task_queue() { delete vktrace_pageguard_get_task_queue(); }
-
 extern "C" void vktrace_pageguard_done_multi_threads_memcpy() {
     int refnum = vktrace_pageguard_ref_count(true);
     if (!refnum) {
-        vktrace_pageguard_task_control_block *task_control_block = vktrace_pageguard_get_task_control_block();
-        if (task_control_block != nullptr) {
-            int thread_number = vktrace_pageguard_get_cpu_core_count();
-
-            for (int i = 0; i < thread_number; i++) {
-                vktrace_pageguard_delete_thread(task_control_block[i].thread_id);
-                vktrace_sem_delete(task_control_block[i].sem_id_task_start);
-                vktrace_sem_delete(task_control_block[i].sem_id_task_end);
-            }
-            vktrace_pageguard_delete_task_control_block();
-            vktrace_sem_delete(vktrace_pageguard_get_task_queue()->sem_id_access);
-            vktrace_pageguard_delete_task_queue();
-        }
+        pageguard_worker_threads_ready = false;
+        vktrace_sem_wait(glocal_sem_id);
+        pageguard_stop_workers();
+        vktrace_sem_post(glocal_sem_id);
     }
 }
 
-// must keep units until vktrace_pageguard_multi_threads_memcpy_run finished
-void vktrace_pageguard_set_task_queue(vktrace_pageguard_task_unit_parameters *units, int unitamount) {
-    vktrace_sem_wait(glocal_sem_id);
-    vktrace_pageguard_task_queue *pqueue = vktrace_pageguard_get_task_queue();
-    pqueue->amount = unitamount;
-    pqueue->ptask_units = units;
-    pqueue->index = 0;
-}
-
-void vktrace_pageguard_clear_task_queue() {
-    vktrace_pageguard_task_queue *pqueue = vktrace_pageguard_get_task_queue();
-    pqueue->amount = 0;
-    pqueue->ptask_units = nullptr;
-    pqueue->index = 0;
-    vktrace_sem_post(glocal_sem_id);
-}
-
 // The steps for using multithreading copy:
 //<1>init_multi_threads_memcpy
 //   it should be put at beginning of the app
 
-//<2>vktrace_pageguard_set_task_queue
-//<3>vktrace_pageguard_multi_threads_memcpy_run
+//<2>vktrace_pageguard_memcpy or vktrace_pageguard_run_tasks_multithread
 
-//<4>done_multi_threads_memcpy()
+//<3>done_multi_threads_memcpy()
 //   it should be putted at end of the app
-void vktrace_pageguard_multi_threads_memcpy_run() {
-    vktrace_pageguard_task_control_block *ptcb = vktrace_pageguard_get_task_control_block();
-    int thread_number = vktrace_pageguard_get_cpu_core_count();
-
-    for (int i = 0; i < thread_number; i++) {
-        vktrace_sem_post(ptcb[i].sem_id_task_start);
-    }
-
-    for (int i = 0; i < thread_number; i++) {
-        vktrace_sem_wait(ptcb[i].sem_id_task_end);
-    }
-}
-
 void vktrace_pageguard_memcpy_multithread(void *dest, const void *src, size_t n) {
-    static const size_t PAGEGUARD_MEMCPY_MULTITHREAD_UNIT_SIZE = 0x10000;
-    int thread_number = vktrace_pageguard_get_cpu_core_count();
+    int thread_number = (int)pageguard_workers.size() + 1;
 
     // taskunitamount should be >=thread_number, but should not >= a value which make the unit too small and the cost of switch
     // thread > memcpy that unit, on the other side, too small is also not best if consider last task will determine the memcpy
@@ -402,28 +602,23 @@ void vktrace_pageguard_memcpy_multithread(void *dest, const void *src, size_t n)
     if (taskunitamount < thread_number) {
         taskunitamount = thread_number;
     }
-    size_t size_per_unit = n / taskunitamount, size_left = n % taskunitamount, size;
-    vktrace_pageguard_task_unit_parameters *units = reinterpret_cast<vktrace_pageguard_task_unit_parameters *>(
-        new uint8_t[taskunitamount * sizeof(vktrace_pageguard_task_unit_parameters)]);
-    assert(units);
-    for (int i = 0; i < taskunitamount; i++) {
-        size = size_per_unit;
-        if ((i + 1) == taskunitamount) {
-            size += size_left;
-        }
-        units[i].src = (void *)((uint8_t *)src + i * size_per_unit);
-        units[i].dest = (void *)((uint8_t *)dest + i * size_per_unit);
-        units[i].size = size;
-    }
-    vktrace_pageguard_set_task_queue(units, taskunitamount);
-    vktrace_pageguard_multi_threads_memcpy_run();
-    delete[] units;
-    vktrace_pageguard_clear_task_queue();
+    vktrace_sem_wait(glocal_sem_id);
+    pageguard_job.pfunc = nullptr;
+    pageguard_job.ppTaskUnitParas = nullptr;
+    pageguard_job.dest = reinterpret_cast<uint8_t *>(dest);
+    pageguard_job.src = reinterpret_cast<const uint8_t *>(src);
+    pageguard_job.size = n;
+    pageguard_job.unit_size = n / taskunitamount;
+    pageguard_job.streaming = (n >= PAGEGUARD_MEMCPY_STREAMING_SIZE);
+    pageguard_job.amount = taskunitamount;
+    pageguard_job.next.store(0);
+    pageguard_run_job();
+    vktrace_sem_post(glocal_sem_id);
 }
 
 extern "C" void *vktrace_pageguard_memcpy(void *destination, const void *source, size_t size) {
     void *pRet = NULL;
-    if (size < SIZE_LIMIT_TO_USE_OPTIMIZATION) {
+    if ((size < pageguard_memcpy_parallel_size) || is_pageguard_worker_thread || !pageguard_worker_threads_ready) {
         pRet = memcpy(destination, source, (size_t)size);
     } else {
         pRet = destination;
@@ -431,4 +626,175 @@ extern "C" void *vktrace_pageguard_memcpy(void *destination, const void *source,
     }
     return pRet;
 }
+
+void vktrace_pageguard_run_tasks_multithread(vktrace_pageguard_ptr_task_unit_function pfunc, void **ppTaskUnitParas, int amount) {
+    if ((amount <= 1) || !pageguard_worker_threads_ready || is_pageguard_worker_thread) {
+        for (int i = 0; i < amount; i++) {
+            pfunc(ppTaskUnitParas[i]);
+        }
+        return;
+    }
+
+    vktrace_sem_wait(glocal_sem_id);
+    pageguard_job.pfunc = pfunc;
+    pageguard_job.ppTaskUnitParas = ppTaskUnitParas;
+    pageguard_job.dest = nullptr;
+    pageguard_job.src = nullptr;
+    pageguard_job.size = 0;
+    pageguard_job.unit_size = 0;
+    pageguard_job.streaming = false;
+    pageguard_job.amount = amount;
+    pageguard_job.next.store(0);
+    pageguard_run_job();
+    vktrace_sem_post(glocal_sem_id);
+}
+#endif
+
+#if (defined(__GNUC__) || defined(_MSC_VER)) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+#define PAGEGUARD_DIFF_USE_AVX2
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PAGEGUARD_DIFF_USE_SSE2
+#include <emmintrin.h>
 #endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PAGEGUARD_DIFF_USE_NEON
+#include <arm_neon.h>
+#endif
+
+// Each scan function walks whole chunks from pos up to end and stops at the first chunk whose
+// contents are equal (findMatch == true) or different (findMatch == false) in the two buffers.
+typedef size_t (*pageguard_diff_scan_function)(const uint8_t *pCurrent, const uint8_t *pReference, size_t pos, size_t end,
+                                               bool findMatch);
+
+static size_t pageguard_diff_scan_scalar(const uint8_t *pCurrent, const uint8_t *pReference, size_t pos, size_t end,
+                                         bool findMatch) {
+    for (; pos < end; pos += PAGEGUARD_DIFF_CHUNK_SIZE) {
+        uint64_t current[PAGEGUARD_DIFF_CHUNK_SIZE / 8], reference[PAGEGUARD_DIFF_CHUNK_SIZE / 8], diff = 0;
+        memcpy(current, pCurrent + pos, PAGEGUARD_DIFF_CHUNK_SIZE);
+        memcpy(reference, pReference + pos, PAGEGUARD_DIFF_CHUNK_SIZE);
+        for (size_t i = 0; i < PAGEGUARD_DIFF_CHUNK_SIZE / 8; i++) {
+            diff |= current[i] ^ reference[i];
+        }
+        if ((diff == 0) == findMatch) {
+            break;
+        }
+    }
+    return pos;
+}
+
+#if defined(PAGEGUARD_DIFF_USE_SSE2)
+static size_t pageguard_diff_scan_sse2(const uint8_t *pCurrent, const uint8_t *pReference, size_t pos, size_t end,
+                                       bool findMatch) {
+    for (; pos < end; pos += PAGEGUARD_DIFF_CHUNK_SIZE) {
+        __m128i eq0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(pCurrent + pos)),
+                                     _mm_loadu_si128((const __m128i *)(pReference + pos)));
+        __m128i eq1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(pCurrent + pos + 16)),
+                                     _mm_loadu_si128((const __m128i *)(pReference + pos + 16)));
+        if ((_mm_movemask_epi8(_mm_and_si128(eq0, eq1)) == 0xffff) == findMatch) {
+            break;
+        }
+    }
+    return pos;
+}
+#endif
+
+#if defined(PAGEGUARD_DIFF_USE_AVX2)
+// Built for AVX2 regardless of the compiler flags, it is only called if the cpu supports it.
+#if defined(__GNUC__)
+__attribute__((target("avx2")))
+#endif
+static size_t pageguard_diff_scan_avx2(const uint8_t *pCurrent, const uint8_t *pReference, size_t pos, size_t end,
+                                       bool findMatch) {
+    for (; pos < end; pos += PAGEGUARD_DIFF_CHUNK_SIZE) {
+        __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(pCurrent + pos)),
+                                       _mm256_loadu_si256((const __m256i *)(pReference + pos)));
+        if ((_mm256_movemask_epi8(eq) == -1) == findMatch) {
+            break;
+        }
+    }
+    return pos;
+}
+
+static bool pageguard_diff_cpu_supports_avx2() {
+#if defined(_MSC_VER)
+    int cpuInfo[4];
+    __cpuid(cpuInfo, 0);
+    if (cpuInfo[0] < 7) {
+        return false;
+    }
+    __cpuid(cpuInfo, 1);
+    // The OS has to save the ymm registers too
+    if ((cpuInfo[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(cpuInfo, 7, 0);
+    return (cpuInfo[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif
+
+#if defined(PAGEGUARD_DIFF_USE_NEON)
+static size_t pageguard_diff_scan_neon(const uint8_t *pCurrent, const uint8_t *pReference, size_t pos, size_t end,
+                                       bool findMatch) {
+    for (; pos < end; pos += PAGEGUARD_DIFF_CHUNK_SIZE) {
+        uint8x16_t eq0 = vceqq_u8(vld1q_u8(pCurrent + pos), vld1q_u8(pReference + pos));
+        uint8x16_t eq1 = vceqq_u8(vld1q_u8(pCurrent + pos + 16), vld1q_u8(pReference + pos + 16));
+        uint64x2_t eq = vreinterpretq_u64_u8(vandq_u8(eq0, eq1));
+        if ((vgetq_lane_u64(eq, 0) == ~0ULL && vgetq_lane_u64(eq, 1) == ~0ULL) == findMatch) {
+            break;
+        }
+    }
+    return pos;
+}
+#endif
+
+static pageguard_diff_scan_function pageguard_diff_get_scan_function() {
+    static pageguard_diff_scan_function scanFunction = nullptr;
+    if (scanFunction == nullptr) {
+        pageguard_diff_scan_function selected = pageguard_diff_scan_scalar;
+#if defined(PAGEGUARD_DIFF_USE_NEON)
+        selected = pageguard_diff_scan_neon;
+#endif
+#if defined(PAGEGUARD_DIFF_USE_SSE2)
+        selected = pageguard_diff_scan_sse2;
+#endif
+#if defined(PAGEGUARD_DIFF_USE_AVX2)
+        if (pageguard_diff_cpu_supports_avx2()) {
+            selected = pageguard_diff_scan_avx2;
+        }
+#endif
+        scanFunction = selected;
+    }
+    return scanFunction;
+}
+
+static size_t pageguard_diff_scan(const void *current, const void *reference, size_t start, size_t size, bool findMatch) {
+    const uint8_t *pCurrent = reinterpret_cast<const uint8_t *>(current);
+    const uint8_t *pReference = reinterpret_cast<const uint8_t *>(reference);
+    size_t wholeChunksEnd = size - size % PAGEGUARD_DIFF_CHUNK_SIZE;
+    assert(start % PAGEGUARD_DIFF_CHUNK_SIZE == 0);
+
+    size_t pos = pageguard_diff_get_scan_function()(pCurrent, pReference, start, wholeChunksEnd, findMatch);
+    if (pos == wholeChunksEnd && pos < size) {
+        // A partial chunk at the end of the buffer
+        if ((memcmp(pCurrent + pos, pReference + pos, size - pos) == 0) != findMatch) {
+            pos = size;
+        }
+    }
+    return pos;
+}
+
+size_t vktrace_pageguard_find_difference(const void *current, const void *reference, size_t start, size_t size) {
+    return pageguard_diff_scan(current, reference, start, size, false);
+}
+
+size_t vktrace_pageguard_find_match(const void *current, const void *reference, size_t start, size_t size) {
+    return pageguard_diff_scan(current, reference, start, size, true);
+}
@@ -67,6 +67,26 @@ void vktrace_sem_wait(vktrace_sem_id sid);
 void vktrace_sem_post(vktrace_sem_id sid);
 void vktrace_pageguard_memcpy_multithread(void *dest, const void *src, size_t n);
 extern "C" void *vktrace_pageguard_memcpy(void *destination, const void *source, size_t size);
+
+#if !defined(PAGEGUARD_MEMCPY_USE_PPL_LIB)
+// Start and stop the threads vktrace_pageguard_memcpy copies large blocks with. Calls nest, and until the first one
+// vktrace_pageguard_memcpy copies on the calling thread.
+extern "C" BOOL vktrace_pageguard_init_multi_threads_memcpy();
+extern "C" void vktrace_pageguard_done_multi_threads_memcpy();
+#endif
+
+// Runs pfunc once for each of the amount entries of ppTaskUnitParas on the threads used by multithread memcpy, and returns
+// once all of them have finished. Tasks may call vktrace_pageguard_memcpy, which copies on the calling thread inside a task.
+typedef void (*vktrace_pageguard_ptr_task_unit_function)(void *pTaskUnitParaInput);
+void vktrace_pageguard_run_tasks_multithread(vktrace_pageguard_ptr_task_unit_function pfunc, void **ppTaskUnitParas, int amount);
+
+// Page diffing compares memory in chunks of PAGEGUARD_DIFF_CHUNK_SIZE bytes, using AVX2, SSE2 or NEON when available.
+// Both functions start at offset start, which must be a multiple of the chunk size, and return size if they reach the end.
+// vktrace_pageguard_find_difference returns the offset of the first chunk in which current and reference differ,
+// vktrace_pageguard_find_match the offset of the first chunk in which they are identical.
+#define PAGEGUARD_DIFF_CHUNK_SIZE 32
+size_t vktrace_pageguard_find_difference(const void *current, const void *reference, size_t start, size_t size);
+size_t vktrace_pageguard_find_match(const void *current, const void *reference, size_t start, size_t size);
 #else
 void* vktrace_pageguard_memcpy(void* destination, const void* source, size_t size);
 #endif
@@ -393,6 +393,53 @@ void vktrace_delete_critical_section(VKTRACE_CRITICAL_SECTION* pCriticalSection)
 #endif
 }
 
+void vktrace_create_rw_lock(VKTRACE_RW_LOCK* pLock) {
+#if defined(WIN32)
+    InitializeSRWLock(pLock);
+#elif defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
+    pthread_rwlock_init(pLock, NULL);
+#endif
+}
+
+void vktrace_enter_rw_lock_shared(VKTRACE_RW_LOCK* pLock) {
+#if defined(WIN32)
+    AcquireSRWLockShared(pLock);
+#elif defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
+    pthread_rwlock_rdlock(pLock);
+#endif
+}
+
+void vktrace_leave_rw_lock_shared(VKTRACE_RW_LOCK* pLock) {
+#if defined(WIN32)
+    ReleaseSRWLockShared(pLock);
+#elif defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
+    pthread_rwlock_unlock(pLock);
+#endif
+}
+
+void vktrace_enter_rw_lock_exclusive(VKTRACE_RW_LOCK* pLock) {
+#if defined(WIN32)
+    AcquireSRWLockExclusive(pLock);
+#elif defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
+    pthread_rwlock_wrlock(pLock);
+#endif
+}
+
+void vktrace_leave_rw_lock_exclusive(VKTRACE_RW_LOCK* pLock) {
+#if defined(WIN32)
+    ReleaseSRWLockExclusive(pLock);
+#elif defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
+    pthread_rwlock_unlock(pLock);
+#endif
+}
+
+// SRW locks need no cleanup
+void vktrace_delete_rw_lock(VKTRACE_RW_LOCK* pLock) {
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
+    pthread_rwlock_destroy(pLock);
+#endif
+}
+
 BOOL vktrace_platform_remote_load_library(vktrace_process_handle pProcessHandle, const char* dllPath,
                                           vktrace_thread* pTracingThread, char** ldPreload) {
     if (dllPath == NULL) return TRUE;
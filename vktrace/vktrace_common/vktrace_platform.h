@@ -44,6 +44,7 @@ typedef pid_t vktrace_thread_id;
 typedef pid_t vktrace_process_id;
 typedef unsigned int VKTRACE_THREAD_ROUTINE_RETURN_TYPE;
 typedef pthread_mutex_t VKTRACE_CRITICAL_SECTION;
+typedef pthread_rwlock_t VKTRACE_RW_LOCK;
 #define VKTRACE_NULL_THREAD 0
 #define _MAX_PATH PATH_MAX
 #define VKTRACE_PATH_SEPARATOR "/"
@@ -61,6 +62,7 @@ typedef DWORD vktrace_thread_id;
 typedef DWORD vktrace_process_id;
 typedef DWORD VKTRACE_THREAD_ROUTINE_RETURN_TYPE;
 typedef CRITICAL_SECTION VKTRACE_CRITICAL_SECTION;
+typedef SRWLOCK VKTRACE_RW_LOCK;
 #define VKTRACE_NULL_THREAD NULL
 #define VKTRACE_PATH_SEPARATOR "\\"
 #define VKTRACE_LIST_SEPARATOR ";"
@@ -90,6 +92,7 @@ typedef pid_t vktrace_thread_id;
 typedef pid_t vktrace_process_id;
 typedef unsigned int VKTRACE_THREAD_ROUTINE_RETURN_TYPE;
 typedef pthread_mutex_t VKTRACE_CRITICAL_SECTION;
+typedef pthread_rwlock_t VKTRACE_RW_LOCK;
 #define VKTRACE_NULL_THREAD 0
 #define _MAX_PATH PATH_MAX
 #define VKTRACE_PATH_SEPARATOR "/"
@@ -164,6 +167,15 @@ void vktrace_enter_critical_section(VKTRACE_CRITICAL_SECTION* pCriticalSection);
 void vktrace_leave_critical_section(VKTRACE_CRITICAL_SECTION* pCriticalSection);
 void vktrace_delete_critical_section(VKTRACE_CRITICAL_SECTION* pCriticalSection);
 
+// A lock that any number of threads can hold shared, or one thread exclusively. Unlike the critical section it isn't
+// recursive, a thread must not take it again while it holds it.
+void vktrace_create_rw_lock(VKTRACE_RW_LOCK* pLock);
+void vktrace_enter_rw_lock_shared(VKTRACE_RW_LOCK* pLock);
+void vktrace_leave_rw_lock_shared(VKTRACE_RW_LOCK* pLock);
+void vktrace_enter_rw_lock_exclusive(VKTRACE_RW_LOCK* pLock);
+void vktrace_leave_rw_lock_exclusive(VKTRACE_RW_LOCK* pLock);
+void vktrace_delete_rw_lock(VKTRACE_RW_LOCK* pLock);
+
 #if defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
 #define VKTRACE_LIBRARY_NAME(projname) (sizeof(void*) == 4) ? "lib" #projname "32.so" : "lib" #projname ".so"
 #endif
@@ -115,6 +115,8 @@ void vktrace_process_info_delete(vktrace_process_info* pInfo) {
     vktrace_platform_delete_thread(&(pInfo->watchdogThread));
 #endif
 
+    vktrace_CompressedWriter_destroy(&pInfo->pCompressedWriter);
+
     if (pInfo->pTraceFile != NULL) {
         vktrace_LogDebug("Closing trace file: '%s'", pInfo->traceFilename);
         fclose(pInfo->pTraceFile);
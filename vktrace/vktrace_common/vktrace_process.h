@@ -23,6 +23,7 @@
 
 #include "vktrace_platform.h"
 #include "vktrace_trace_packet_identifiers.h"
+#include "vktrace_compression.h"
 
 typedef struct vktrace_process_capture_trace_thread_info vktrace_process_capture_trace_thread_info;
 
@@ -34,6 +35,9 @@ typedef struct vktrace_process_info {
     char* traceFilename;
     FILE* pTraceFile;
 
+    // Set if packets are written to pTraceFile as compressed frames
+    CompressedWriter* pCompressedWriter;
+
     // vktrace's thread id
     vktrace_thread_id parentThreadId;
 
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  Query digest packets
+//
+//     Engines call vkGet*MemoryRequirements, vkGetImageSubresourceLayout, the format and feature
+//     queries of vkGetPhysicalDevice* and vkEnumerateDevice* a lot, and what they return on the
+//     traced device means little on the replay device. When the trace layer digests queries (see
+//     vktrace_lib_querydigest.h), such a call is traced as a VKTRACE_TPI_QUERY_DIGEST packet
+//     instead, which keeps the handles the replay needs and a hash of the call's parameters and
+//     results. vkreplay queries the replay device again where it needs the results: the memory
+//     requirements of buffers and images.
+
+#pragma once
+
+#include "vktrace_trace_packet_identifiers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Body of a VKTRACE_TPI_QUERY_DIGEST packet
+typedef struct {
+    vktrace_trace_packet_header* header;
+    // packet_id of the call
+    uint32_t callId;
+    uint32_t reserved;
+    // The VkDevice or VkPhysicalDevice the call was made on, and the object it was about, if any
+    uint64_t dispatchable;
+    uint64_t object;
+    // Hash of the call's packet body after the header pointer, which holds its parameters and results
+    uint64_t digest;
+} vktrace_query_digest;
+
+#ifdef __cplusplus
+}
+#endif
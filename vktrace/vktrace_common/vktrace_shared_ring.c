@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "vktrace_shared_ring.h"
+#include "vktrace_platform.h"
+
+#if defined(PLATFORM_LINUX)
+#include <errno.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(WIN32)
+#define RING_ATOMIC_LOAD(_p) ((uint32_t)InterlockedCompareExchange((volatile LONG*)(_p), 0, 0))
+#define RING_ATOMIC_STORE(_p, _v) InterlockedExchange((volatile LONG*)(_p), (LONG)(_v))
+#define RING_ATOMIC_CLAIM(_p) (InterlockedCompareExchange((volatile LONG*)(_p), 1, 0) == 0)
+#else
+#define RING_ATOMIC_LOAD(_p) __sync_fetch_and_add((_p), 0)
+#define RING_ATOMIC_STORE(_p, _v) \
+    do {                          \
+        __sync_synchronize();     \
+        *(_p) = (_v);             \
+    } while (0)
+#define RING_ATOMIC_CLAIM(_p) __sync_bool_compare_and_swap((_p), 0, 1)
+#endif
+
+// The data starts on the page after the header
+#define SHARED_RING_DATA_OFFSET 4096
+
+typedef struct SharedRingHeader {
+    // The positions only ever grow and wrap around at 2^32. Each is written by one side, and they
+    // are on cache lines of their own so the two sides don't keep taking them from each other.
+    volatile uint32_t writePos;
+    uint8_t writePadding[60];
+    volatile uint32_t readPos;
+    uint8_t readPadding[60];
+    volatile uint32_t writerClaimed;
+    uint32_t size;
+} SharedRingHeader;
+
+struct SharedRing {
+    SharedRingHeader* pHeader;
+    uint8_t* pData;
+    uint32_t size;
+    size_t mappingSize;
+    char name[64];
+#if defined(WIN32)
+    HANDLE hMapping;
+#elif defined(PLATFORM_LINUX)
+    // Only closed by the process that created the ring, the program inherits it
+    int fd;
+#endif
+};
+
+// ------------------------------------------------------------------------------------------------
+static SharedRing* vktrace_SharedRing_wrap(void* pMapping, size_t mappingSize) {
+    SharedRing* pRing = VKTRACE_NEW(SharedRing);
+    memset(pRing, 0, sizeof(SharedRing));
+    pRing->pHeader = (SharedRingHeader*)pMapping;
+    pRing->pData = (uint8_t*)pMapping + SHARED_RING_DATA_OFFSET;
+    pRing->size = pRing->pHeader->size;
+    pRing->mappingSize = mappingSize;
+    return pRing;
+}
+
+// ------------------------------------------------------------------------------------------------
+SharedRing* vktrace_SharedRing_create(uint32_t size) {
+    SharedRing* pRing = NULL;
+    size_t mappingSize = (size_t)SHARED_RING_DATA_OFFSET + size;
+    assert(size > 0 && (size & (size - 1)) == 0);
+
+#if defined(WIN32)
+    char name[64];
+    _snprintf(name, sizeof(name), "Local\\vktrace_ring_%u", vktrace_get_pid());
+    HANDLE hMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)mappingSize >> 32),
+                                         (DWORD)mappingSize, name);
+    if (hMapping == NULL) {
+        vktrace_LogWarning("Failed to create a shared memory ring, error %u.", GetLastError());
+        return NULL;
+    }
+    void* pMapping = MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, mappingSize);
+    if (pMapping == NULL) {
+        vktrace_LogWarning("Failed to map the shared memory ring, error %u.", GetLastError());
+        CloseHandle(hMapping);
+        return NULL;
+    }
+    // A fresh mapping is zeroed
+    ((SharedRingHeader*)pMapping)->size = size;
+    pRing = vktrace_SharedRing_wrap(pMapping, mappingSize);
+    pRing->hMapping = hMapping;
+    memcpy(pRing->name, name, sizeof(name));
+#elif defined(PLATFORM_LINUX) && defined(SYS_memfd_create)
+    // Without MFD_CLOEXEC, so the program started next inherits the descriptor
+    int fd = (int)syscall(SYS_memfd_create, "vktrace_ring", 0);
+    if (fd == -1) {
+        vktrace_LogWarning("Failed to create a shared memory ring, error num %d.", errno);
+        return NULL;
+    }
+    void* pMapping = MAP_FAILED;
+    if (ftruncate(fd, (off_t)mappingSize) == 0) {
+        pMapping = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (pMapping == MAP_FAILED) {
+        vktrace_LogWarning("Failed to map the shared memory ring, error num %d.", errno);
+        close(fd);
+        return NULL;
+    }
+    ((SharedRingHeader*)pMapping)->size = size;
+    pRing = vktrace_SharedRing_wrap(pMapping, mappingSize);
+    pRing->fd = fd;
+    snprintf(pRing->name, sizeof(pRing->name), "%d", fd);
+#else
+    (void)mappingSize;
+#endif
+    return pRing;
+}
+
+// ------------------------------------------------------------------------------------------------
+SharedRing* vktrace_SharedRing_open(const char* name) {
+    SharedRing* pRing = NULL;
+    if (name == NULL || strlen(name) == 0 || strlen(name) >= sizeof(pRing->name)) {
+        return NULL;
+    }
+
+#if defined(WIN32)
+    HANDLE hMapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+    if (hMapping == NULL) {
+        vktrace_LogWarning("Failed to open shared memory ring %s, error %u.", name, GetLastError());
+        return NULL;
+    }
+    void* pMapping = MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION info;
+    if (pMapping == NULL || VirtualQuery(pMapping, &info, sizeof(info)) == 0 ||
+        info.RegionSize < SHARED_RING_DATA_OFFSET + (size_t)((SharedRingHeader*)pMapping)->size) {
+        vktrace_LogWarning("Failed to map shared memory ring %s.", name);
+        if (pMapping != NULL) UnmapViewOfFile(pMapping);
+        CloseHandle(hMapping);
+        return NULL;
+    }
+    pRing = vktrace_SharedRing_wrap(pMapping, (size_t)SHARED_RING_DATA_OFFSET + ((SharedRingHeader*)pMapping)->size);
+    pRing->hMapping = hMapping;
+#elif defined(PLATFORM_LINUX)
+    int fd = atoi(name);
+    struct stat fileStat;
+    if (fd <= 0 || fstat(fd, &fileStat) != 0 || (size_t)fileStat.st_size <= SHARED_RING_DATA_OFFSET) {
+        vktrace_LogWarning("Shared memory ring %s is not open in this process.", name);
+        return NULL;
+    }
+    size_t mappingSize = (size_t)fileStat.st_size;
+    void* pMapping = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (pMapping == MAP_FAILED) {
+        vktrace_LogWarning("Failed to map shared memory ring %s, error num %d.", name, errno);
+        return NULL;
+    }
+    if (SHARED_RING_DATA_OFFSET + (size_t)((SharedRingHeader*)pMapping)->size != mappingSize) {
+        vktrace_LogWarning("Descriptor %s is not a shared memory ring.", name);
+        munmap(pMapping, mappingSize);
+        return NULL;
+    }
+    pRing = vktrace_SharedRing_wrap(pMapping, mappingSize);
+    pRing->fd = -1;
+#endif
+    if (pRing != NULL) {
+        strcpy(pRing->name, name);
+    }
+    return pRing;
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_SharedRing_destroy(SharedRing** ppRing) {
+    SharedRing* pRing = *ppRing;
+    if (pRing == NULL) {
+        return;
+    }
+#if defined(WIN32)
+    UnmapViewOfFile(pRing->pHeader);
+    CloseHandle(pRing->hMapping);
+#elif defined(PLATFORM_LINUX)
+    munmap(pRing->pHeader, pRing->mappingSize);
+    if (pRing->fd != -1) {
+        close(pRing->fd);
+    }
+#endif
+    VKTRACE_DELETE(pRing);
+    *ppRing = NULL;
+}
+
+// ------------------------------------------------------------------------------------------------
+const char* vktrace_SharedRing_get_name(SharedRing* pRing) { return pRing->name; }
+
+// ------------------------------------------------------------------------------------------------
+BOOL vktrace_SharedRing_claim(SharedRing* pRing) { return RING_ATOMIC_CLAIM(&pRing->pHeader->writerClaimed) ? TRUE : FALSE; }
+
+// ------------------------------------------------------------------------------------------------
+size_t vktrace_SharedRing_write(SharedRing* pRing, const void* pBytes, size_t size) {
+    SharedRingHeader* pHeader = pRing->pHeader;
+    uint32_t writePos = pHeader->writePos;
+    size_t count = pRing->size - (writePos - RING_ATOMIC_LOAD(&pHeader->readPos));
+    if (count > size) {
+        count = size;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    uint32_t offset = writePos & (pRing->size - 1);
+    size_t firstCount = count < pRing->size - offset ? count : pRing->size - offset;
+    memcpy(pRing->pData + offset, pBytes, firstCount);
+    memcpy(pRing->pData, (const uint8_t*)pBytes + firstCount, count - firstCount);
+    RING_ATOMIC_STORE(&pHeader->writePos, writePos + (uint32_t)count);
+    return count;
+}
+
+// ------------------------------------------------------------------------------------------------
+size_t vktrace_SharedRing_read(SharedRing* pRing, void* pBytes, size_t size) {
+    SharedRingHeader* pHeader = pRing->pHeader;
+    uint32_t readPos = pHeader->readPos;
+    size_t count = RING_ATOMIC_LOAD(&pHeader->writePos) - readPos;
+    if (count > size) {
+        count = size;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    uint32_t offset = readPos & (pRing->size - 1);
+    size_t firstCount = count < pRing->size - offset ? count : pRing->size - offset;
+    memcpy(pBytes, pRing->pData + offset, firstCount);
+    memcpy((uint8_t*)pBytes + firstCount, pRing->pData, count - firstCount);
+    RING_ATOMIC_STORE(&pHeader->readPos, readPos + (uint32_t)count);
+    return count;
+}
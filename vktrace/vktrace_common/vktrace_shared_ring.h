@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  Shared memory ring
+//
+//     When vktrace launches the traced program itself both ends of the message stream are on the
+//     same machine, yet every packet sent through the socket is copied into the kernel and back
+//     out again, with a system call on each side. The ring is a region of memory both processes
+//     map, which the trace layer writes the packets into and vktrace reads them straight out of.
+//
+//     vktrace creates the ring before it starts the program and names it in the
+//     VKTRACE_SHARED_MEMORY env var. The socket handshake then decides whether the message stream
+//     uses it. There is one writer and one reader, each only publishing how far it got, so neither
+//     side takes a lock or makes a system call unless the ring is full or empty.
+
+#pragma once
+
+#include "vktrace_common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VKTRACE_SHARED_RING_SIZE (64 * 1024 * 1024)
+
+typedef struct SharedRing SharedRing;
+
+// Creates a ring of size bytes, which has to be a power of two. Returns NULL if the platform
+// has no shared memory the traced program can open.
+SharedRing* vktrace_SharedRing_create(uint32_t size);
+SharedRing* vktrace_SharedRing_open(const char* name);
+void vktrace_SharedRing_destroy(SharedRing** ppRing);
+
+// What vktrace_SharedRing_open takes to open the ring in another process
+const char* vktrace_SharedRing_get_name(SharedRing* pRing);
+
+// Makes the caller the only writer of the ring. Returns FALSE if some process already is.
+BOOL vktrace_SharedRing_claim(SharedRing* pRing);
+
+// Copies as much of pBytes into the ring as fits and returns how many bytes that was
+size_t vktrace_SharedRing_write(SharedRing* pRing, const void* pBytes, size_t size);
+
+// Copies up to size bytes out of the ring and returns how many there were
+size_t vktrace_SharedRing_read(SharedRing* pRing, void* pBytes, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
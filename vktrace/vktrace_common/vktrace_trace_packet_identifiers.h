@@ -28,7 +28,11 @@
 #define VKTRACE_TRACE_FILE_VERSION_4 0x0004
 #define VKTRACE_TRACE_FILE_VERSION_5 0x0005
 #define VKTRACE_TRACE_FILE_VERSION_6 0x0006
-#define VKTRACE_TRACE_FILE_VERSION VKTRACE_TRACE_FILE_VERSION_6
+#define VKTRACE_TRACE_FILE_VERSION_7 0x0007  // adds VKTRACE_TPI_BLOB packets
+#define VKTRACE_TRACE_FILE_VERSION_8 0x0008  // adds VKTRACE_TPI_CMD_BLOCK packets
+#define VKTRACE_TRACE_FILE_VERSION_9 0x0009  // adds VKTRACE_TPI_GPU_TIMING packets
+#define VKTRACE_TRACE_FILE_VERSION_10 0x000A  // adds VKTRACE_TPI_QUERY_DIGEST packets
+#define VKTRACE_TRACE_FILE_VERSION VKTRACE_TRACE_FILE_VERSION_10
 #define VKTRACE_TRACE_FILE_VERSION_MINIMUM_COMPATIBLE VKTRACE_TRACE_FILE_VERSION_6
 
 #define VKTRACE_FILE_MAGIC 0xABADD068ADEAFD0C
@@ -312,7 +316,12 @@ typedef enum _VKTRACE_TRACE_PACKET_ID_VK {
     VKTRACE_TPI_VK_vkDisplayPowerControlEXT = 237,
     VKTRACE_TPI_VK_vkRegisterDeviceEventEXT = 238,
     VKTRACE_TPI_VK_vkRegisterDisplayEventEXT = 239,
-    VKTRACE_TPI_VK_vkGetSwapchainCounterEXT = 240
+    VKTRACE_TPI_VK_vkGetSwapchainCounterEXT = 240,
+    VKTRACE_TPI_MARKER_TRIM_WINDOW_END = 241,
+    VKTRACE_TPI_BLOB = 242,      // a payload later packets refer to, see vktrace_blob_store.h
+    VKTRACE_TPI_CMD_BLOCK = 243,  // a run of vkCmd* calls on one command buffer, see vktrace_cmd_block.h
+    VKTRACE_TPI_GPU_TIMING = 244,  // the traced GPU time of a command buffer, see vktrace_gpu_timing.h
+    VKTRACE_TPI_QUERY_DIGEST = 245  // a query call left out of the trace, see vktrace_query_digest.h
 
 } VKTRACE_TRACE_PACKET_ID_VK;
 
@@ -357,14 +366,59 @@ typedef struct {
     ALIGN8 uint64_t arch;
     ALIGN8 uint64_t os;
 
+    // Compression of the packets following the header, see vktrace_compression.h
+    ALIGN8 uint64_t compression_type;    // VKTRACE_COMPRESSION_NONE or a combination of VKTRACE_COMPRESSION_* bits
+    ALIGN8 uint64_t frame_index_offset;  // file offset of the frame index, 0 if not compressed or not finished
+
+    // Offset in the packet stream of the table of frame start offsets, 0 if the trace doesn't have one
+    ALIGN8 uint64_t frame_table_offset;
+
+    // Offset in the packet stream of the table of frame statistics, 0 if the trace doesn't have one
+    ALIGN8 uint64_t frame_stats_offset;
+
     // Reserve some spaece in case more fields need to be added in the future
-    ALIGN8 uint64_t reserved2[8];
+    ALIGN8 uint64_t reserved2[4];
 
     // The header ends with number of gpus and a gpu_id/drv_vers pair for each gpu
     ALIGN8 uint64_t n_gpuinfo;
     // A struct_gpuinfo array of length n_gpuinfo follows this
 } vktrace_trace_file_header;
 
+// Frame table - Where each frame of the trace starts, so a reader can seek straight to frame N.
+// It sits at the start of the portability table packet's body: a vktrace_frame_table_header
+// followed by frame_count entries, entry N being the start of frame N. Frame 0 starts at the
+// first packet, frame N right after the N-th vkQueuePresentKHR.
+typedef struct {
+    ALIGN8 uint64_t frame_count;
+} vktrace_frame_table_header;
+
+typedef struct {
+    ALIGN8 uint64_t packet_offset;        // offset of the frame's first packet in the packet stream
+    ALIGN8 uint64_t present_packet_index;  // global_packet_index of the present that ended the previous frame
+} vktrace_frame_table_entry;
+
+// Frame statistics - What each frame of the trace holds, so a tool can find the frames worth a
+// closer look without reading their packets. The table follows the frame table in the portability
+// table packet's body: a vktrace_frame_table_header followed by frame_count entries, entry N
+// describing frame N of the frame table, which has as many entries.
+typedef enum {
+    VKTRACE_FRAME_STATS_CMD,     // vkCmd* calls other than draws and dispatches, those in command blocks included
+    VKTRACE_FRAME_STATS_DRAW,    // vkCmdDraw* and vkCmdDispatch* calls
+    VKTRACE_FRAME_STATS_SUBMIT,  // vkQueueSubmit and vkQueueBindSparse calls
+    VKTRACE_FRAME_STATS_MEMORY,  // calls that allocate, free, bind, map, unmap, flush or invalidate memory
+    VKTRACE_FRAME_STATS_OBJECT,  // the other vkCreate*, vkDestroy*, vkAllocate* and vkFree* calls
+    VKTRACE_FRAME_STATS_SYNC,    // calls that wait, or set, reset or query fences, events and queries
+    VKTRACE_FRAME_STATS_OTHER,
+    VKTRACE_FRAME_STATS_CATEGORY_COUNT
+} VKTRACE_FRAME_STATS_CATEGORY;
+
+typedef struct {
+    ALIGN8 uint64_t cpu_time;      // ns from the end of the present that ended the previous frame to the end of the frame
+    ALIGN8 uint64_t upload_bytes;  // size of the vkFlushMappedMemoryRanges and vkUnmapMemory packets
+    ALIGN8 uint64_t packet_count;
+    ALIGN8 uint64_t call_count[VKTRACE_FRAME_STATS_CATEGORY_COUNT];
+} vktrace_frame_stats_entry;
+
 typedef struct {
     ALIGN8 uint64_t size;  // total size, including extra data, needed to get to the next packet_header
     ALIGN8 uint64_t global_packet_index;
@@ -21,9 +21,14 @@
  * Author: Peter Lohrmann <peterl@valvesoftware.com>
  **************************************************************************/
 #include "vktrace_trace_packet_utils.h"
+#include "vktrace_blob_store.h"
 #include "vktrace_interconnect.h"
 #include "vktrace_filelike.h"
+#include "vktrace_packet_arena.h"
 #include "vktrace_pageguard_memorycopy.h"
+#include "vk_timeline.h"
+
+#include <inttypes.h>
 
 #ifdef WIN32
 #include <rpc.h>
@@ -43,24 +48,22 @@
 
 #include "vktrace_pageguard_memorycopy.h"
 
-static VKTRACE_CRITICAL_SECTION s_packet_index_lock;
+#if defined(WIN32)
+#define PACKET_INDEX_FETCH_INC(_p) ((uint64_t)InterlockedExchangeAdd64((volatile LONG64*)(_p), 1))
+#else
+#define PACKET_INDEX_FETCH_INC(_p) __sync_fetch_and_add((_p), 1)
+#endif
 
-void vktrace_initialize_trace_packet_utils() { vktrace_create_critical_section(&s_packet_index_lock); }
+void vktrace_initialize_trace_packet_utils() { vktrace_blob_store_initialize(); }
 
-void vktrace_deinitialize_trace_packet_utils() { vktrace_delete_critical_section(&s_packet_index_lock); }
+void vktrace_deinitialize_trace_packet_utils() { vktrace_blob_store_deinitialize(); }
 
 uint64_t vktrace_get_unique_packet_index() {
     // Keep the s_packet_index scope to within this method, to ensure this method is always used to get a unique packet index.
-    static uint64_t s_packet_index = 0;
-
-    vktrace_enter_critical_section(&s_packet_index_lock);
-    // Store the value then increment within the critical section to avoid race conditions.
-    uint64_t index = s_packet_index;
-    s_packet_index += 1;
-    vktrace_leave_critical_section(&s_packet_index_lock);
+    static volatile uint64_t s_packet_index = 0;
 
-    // Return the stored value rather than the actual variable (again to avoid race conditions).
-    return index;
+    // A single atomic increment, since every traced call on every thread comes through here
+    return PACKET_INDEX_FETCH_INC(&s_packet_index);
 }
 
 void vktrace_gen_uuid(uint32_t* pUuid) {
@@ -168,11 +171,22 @@ uint64_t get_os() {
 //=============================================================================
 // Methods for creating, populating, and writing trace packets
 
+static vktrace_packet_created_callback s_pfnPacketCreated = NULL;
+
+void vktrace_set_packet_created_callback(vktrace_packet_created_callback pfnCallback) { s_pfnPacketCreated = pfnCallback; }
+
 vktrace_trace_packet_header* vktrace_create_trace_packet(uint8_t tracer_id, uint16_t packet_id, uint64_t packet_size,
                                                          uint64_t additional_buffers_size) {
+    if (s_pfnPacketCreated != NULL) {
+        s_pfnPacketCreated(packet_id);
+    }
+
     // Always allocate at least enough space for the packet header
     uint64_t total_packet_size = ROUNDUP_TO_4(sizeof(vktrace_trace_packet_header) + packet_size + additional_buffers_size);
-    void* pMemory = vktrace_malloc((size_t)total_packet_size);
+    void* pMemory = vktrace_packet_arena_alloc((size_t)total_packet_size);
+    if (pMemory == NULL) {
+        pMemory = vktrace_malloc((size_t)total_packet_size);
+    }
     memset(pMemory, 0, (size_t)total_packet_size);
 
     vktrace_trace_packet_header* pHeader = (vktrace_trace_packet_header*)pMemory;
@@ -197,7 +211,9 @@ void vktrace_delete_trace_packet(vktrace_trace_packet_header** ppHeader) {
     if (ppHeader == NULL) return;
     if (*ppHeader == NULL) return;
 
-    VKTRACE_DELETE(*ppHeader);
+    if (!vktrace_packet_arena_free(*ppHeader)) {
+        VKTRACE_DELETE(*ppHeader);
+    }
     *ppHeader = NULL;
 }
 
@@ -246,26 +262,87 @@ void vktrace_add_buffer_to_trace_packet(vktrace_trace_packet_header* pHeader, vo
 void vktrace_finalize_buffer_address(vktrace_trace_packet_header* pHeader, void** ptr_address) {
     assert(ptr_address != NULL);
 
-    if (*ptr_address != NULL) {
+    // blob references stay as they are
+    if (*ptr_address != NULL && ((uintptr_t)*ptr_address & VKTRACE_BLOB_REFERENCE_BIT) == 0) {
         // turn ptr into an offset from the packet body
         uint64_t offset = (uint64_t)*ptr_address - (uint64_t)(pHeader->pBody);
         *ptr_address = (void*)offset;
     }
 }
 
+void vktrace_write_buffer_to_trace_packet(vktrace_trace_packet_header* pHeader, void** ptr_address, uint64_t size,
+                                          const void* pBuffer) {
+    assert(ptr_address != NULL);
+
+    if (pBuffer == NULL || size == 0) {
+        *ptr_address = NULL;
+        return;
+    }
+    uint64_t offset = pHeader->next_buffers_offset;
+    assert((offset & 0x3) == 0);
+    assert(pHeader->size >= offset + ROUNDUP_TO_4(size));
+    vktrace_pageguard_memcpy((char*)pHeader + offset, pBuffer, (size_t)size);
+    // the offset from the packet body, as vktrace_finalize_buffer_address leaves it
+    *ptr_address = (void*)(uintptr_t)(offset - sizeof(vktrace_trace_packet_header));
+    pHeader->next_buffers_offset = offset + ROUNDUP_TO_4(size);
+}
+
 void vktrace_set_packet_entrypoint_end_time(vktrace_trace_packet_header* pHeader) {
     pHeader->entrypoint_end_time = vktrace_get_time();
 }
 
+static void timeline_serialize_zone(uint64_t begin, uint64_t end) {
+    if (end > begin) {
+        vk_timeline_zone("vktrace", "serialize", begin, end);
+    }
+}
+
 void vktrace_finalize_trace_packet(vktrace_trace_packet_header* pHeader) {
     if (pHeader->entrypoint_end_time == 0) {
         vktrace_set_packet_entrypoint_end_time(pHeader);
     }
+    if (vktrace_blob_store_is_tracing() && pHeader->next_buffers_offset < pHeader->size) {
+        // Payloads that went into blobs leave the end of the packet unused
+        pHeader->size = ROUNDUP_TO_4(pHeader->next_buffers_offset);
+    }
     pHeader->vktrace_end_time = vktrace_get_time();
+
+    if (vk_timeline_enabled()) {
+        // The time vktrace spent serializing the call, before and after calling down the chain. vktrace_get_time
+        // isn't on the timeline's clock everywhere, so the times are moved over to it.
+        uint64_t offset = vk_timeline_now() - pHeader->vktrace_end_time;
+        if (pHeader->entrypoint_begin_time >= pHeader->vktrace_begin_time &&
+            pHeader->entrypoint_end_time >= pHeader->entrypoint_begin_time) {
+            timeline_serialize_zone(pHeader->vktrace_begin_time + offset, pHeader->entrypoint_begin_time + offset);
+            timeline_serialize_zone(pHeader->entrypoint_end_time + offset, pHeader->vktrace_end_time + offset);
+        } else {
+            timeline_serialize_zone(pHeader->vktrace_begin_time + offset, pHeader->vktrace_end_time + offset);
+        }
+    }
 }
 
+static const vktrace_trace_packet_writer* s_pPacketWriter = NULL;
+
+void vktrace_set_trace_packet_writer(const vktrace_trace_packet_writer* pWriter) { s_pPacketWriter = pWriter; }
+
 void vktrace_write_trace_packet(const vktrace_trace_packet_header* pHeader, FileLike* pFile) {
+    if (s_pPacketWriter != NULL) {
+        // The caller keeps ownership of pHeader, so the writer gets its own copy.
+        vktrace_trace_packet_header* pCopy = (vktrace_trace_packet_header*)vktrace_packet_arena_alloc((size_t)pHeader->size);
+        if (pCopy == NULL) {
+            pCopy = (vktrace_trace_packet_header*)vktrace_malloc((size_t)pHeader->size);
+        }
+        memcpy(pCopy, pHeader, (size_t)pHeader->size);
+        pCopy->pBody = (uintptr_t)pCopy + sizeof(vktrace_trace_packet_header);
+        s_pPacketWriter->pfnQueuePacket(pCopy, pFile);
+        return;
+    }
+
+    uint64_t writeStart = vk_timeline_enabled() ? vk_timeline_now() : 0;
     BOOL res = vktrace_FileLike_WriteRaw(pFile, pHeader, (size_t)pHeader->size);
+    if (writeStart != 0) {
+        vk_timeline_zone("vktrace", "write", writeStart, vk_timeline_now());
+    }
     if (!res && pHeader->packet_id != VKTRACE_TPI_MARKER_TERMINATE_PROCESS) {
         // We don't retry on failure because vktrace_FileLike_WriteRaw already retried and gave up.
         vktrace_LogWarning("Failed to write trace packet.");
@@ -273,6 +350,24 @@ void vktrace_write_trace_packet(const vktrace_trace_packet_header* pHeader, File
     }
 }
 
+static vktrace_packet_submit_callback s_pfnPacketSubmit = NULL;
+
+void vktrace_set_packet_submit_callback(vktrace_packet_submit_callback pfnCallback) { s_pfnPacketSubmit = pfnCallback; }
+
+void vktrace_submit_trace_packet(vktrace_trace_packet_header** ppHeader, FileLike* pFile) {
+    assert(ppHeader != NULL && *ppHeader != NULL);
+    if (s_pfnPacketSubmit != NULL) {
+        s_pfnPacketSubmit(*ppHeader);
+    }
+    if (s_pPacketWriter != NULL) {
+        s_pPacketWriter->pfnQueuePacket(*ppHeader, pFile);
+        *ppHeader = NULL;
+    } else {
+        vktrace_write_trace_packet(*ppHeader, pFile);
+        vktrace_delete_trace_packet(ppHeader);
+    }
+}
+
 //=============================================================================
 // Methods for Reading and interpretting trace packets
 
@@ -306,6 +401,82 @@ vktrace_trace_packet_header* vktrace_read_trace_packet(FileLike* pFile) {
     return pHeader;
 }
 
+// Reads a vktrace_frame_table_header and the entries of entrySize bytes that follow it at tableOffset
+static BOOL read_frame_indexed_table(FileLike* pFile, uint64_t tableOffset, size_t entrySize, const char* tableName,
+                                     uint64_t* pFrameCount, void** ppEntries) {
+    vktrace_frame_table_header tableHeader;
+    void* pEntries = NULL;
+    size_t originalPosition;
+    BOOL result = FALSE;
+
+    *pFrameCount = 0;
+    *ppEntries = NULL;
+    if (tableOffset == 0) {
+        return FALSE;
+    }
+
+    originalPosition = vktrace_FileLike_GetCurrentPosition(pFile);
+    if (!vktrace_FileLike_SetCurrentPosition(pFile, (size_t)tableOffset) ||
+        !vktrace_FileLike_ReadRaw(pFile, &tableHeader, sizeof(tableHeader))) {
+        goto out;
+    }
+    if (tableHeader.frame_count == 0 || tableHeader.frame_count > (pFile->mFileLen - tableOffset) / entrySize) {
+        vktrace_LogError("%s in trace file is corrupt.", tableName);
+        goto out;
+    }
+
+    pEntries = vktrace_malloc((size_t)tableHeader.frame_count * entrySize);
+    if (pEntries == NULL || !vktrace_FileLike_ReadRaw(pFile, pEntries, (size_t)tableHeader.frame_count * entrySize)) {
+        vktrace_free(pEntries);
+        goto out;
+    }
+
+    *pFrameCount = tableHeader.frame_count;
+    *ppEntries = pEntries;
+    result = TRUE;
+
+out:
+    vktrace_FileLike_SetCurrentPosition(pFile, originalPosition);
+    return result;
+}
+
+BOOL vktrace_read_frame_table(FileLike* pFile, const vktrace_trace_file_header* pHeader, uint64_t* pFrameCount,
+                              vktrace_frame_table_entry** ppEntries) {
+    return read_frame_indexed_table(pFile, pHeader->frame_table_offset, sizeof(vktrace_frame_table_entry), "Frame table",
+                                    pFrameCount, (void**)ppEntries);
+}
+
+BOOL vktrace_read_frame_stats(FileLike* pFile, const vktrace_trace_file_header* pHeader, uint64_t* pFrameCount,
+                              vktrace_frame_stats_entry** ppEntries) {
+    return read_frame_indexed_table(pFile, pHeader->frame_stats_offset, sizeof(vktrace_frame_stats_entry),
+                                    "Frame statistics table", pFrameCount, (void**)ppEntries);
+}
+
+static BOOL name_starts_with(const char* name, const char* prefix) { return strncmp(name, prefix, strlen(prefix)) == 0; }
+
+int vktrace_frame_stats_call_category(const char* name) {
+    if (name == NULL || !name_starts_with(name, "vk") || strcmp(name, "vkApiVersion") == 0) {
+        return VKTRACE_FRAME_STATS_CATEGORY_COUNT;
+    }
+    if (name_starts_with(name, "vkCmdDraw") || name_starts_with(name, "vkCmdDispatch")) return VKTRACE_FRAME_STATS_DRAW;
+    if (name_starts_with(name, "vkCmd")) return VKTRACE_FRAME_STATS_CMD;
+    if (strcmp(name, "vkQueueSubmit") == 0 || strcmp(name, "vkQueueBindSparse") == 0) return VKTRACE_FRAME_STATS_SUBMIT;
+    if (name_starts_with(name, "vkAllocateMemory") || name_starts_with(name, "vkFreeMemory") || name_starts_with(name, "vkMapMemory") ||
+        name_starts_with(name, "vkUnmapMemory") || name_starts_with(name, "vkBind") ||
+        strcmp(name, "vkFlushMappedMemoryRanges") == 0 || strcmp(name, "vkInvalidateMappedMemoryRanges") == 0) {
+        return VKTRACE_FRAME_STATS_MEMORY;
+    }
+    if (name_starts_with(name, "vkCreate") || name_starts_with(name, "vkDestroy") || name_starts_with(name, "vkAllocate") ||
+        name_starts_with(name, "vkFree")) {
+        return VKTRACE_FRAME_STATS_OBJECT;
+    }
+    if (name_starts_with(name, "vkWait") || strcmp(name, "vkQueueWaitIdle") == 0 || strcmp(name, "vkDeviceWaitIdle") == 0 ||
+        strstr(name, "Fence") != NULL || strstr(name, "Event") != NULL || strcmp(name, "vkGetQueryPoolResults") == 0) {
+        return VKTRACE_FRAME_STATS_SYNC;
+    }
+    return VKTRACE_FRAME_STATS_OTHER;
+}
+
 void* vktrace_trace_packet_interpret_buffer_pointer(vktrace_trace_packet_header* pHeader, intptr_t ptr_variable) {
     // the pointer variable actually contains a byte offset from the packet body to the start of the buffer.
     uint64_t offset = ptr_variable;
@@ -314,6 +485,15 @@ void* vktrace_trace_packet_interpret_buffer_pointer(vktrace_trace_packet_header*
     // if the offset is 0, then we know the pointer to the buffer was NULL, so no buffer exists and we return NULL.
     if (offset == 0) return NULL;
 
+    if (offset & VKTRACE_BLOB_REFERENCE_BIT) {
+        buffer_location = (void*)vktrace_blob_store_get(VKTRACE_BLOB_REFERENCE_ID(offset));
+        if (buffer_location == NULL) {
+            vktrace_LogError("Packet %" PRIu64 " refers to blob %" PRIu64 ", which isn't in the trace before it.",
+                             pHeader->global_packet_index, VKTRACE_BLOB_REFERENCE_ID(offset));
+        }
+        return buffer_location;
+    }
+
     buffer_location = (char*)(pHeader->pBody) + offset;
     return buffer_location;
 }
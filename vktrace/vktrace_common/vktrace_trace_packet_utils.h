@@ -90,6 +90,12 @@ void vktrace_add_buffer_to_trace_packet(vktrace_trace_packet_header* pHeader, vo
 // converts buffer pointers into byte offset so that pointer can be interpretted after being read into memory
 void vktrace_finalize_buffer_address(vktrace_trace_packet_header* pHeader, void** ptr_address);
 
+// copies a buffer to the next free offset of a trace packet and stores that offset in *ptr_address, as
+// vktrace_add_buffer_to_trace_packet and vktrace_finalize_buffer_address would together. for packets sized exactly by
+// their buffers, which are written in the order they were sized in.
+void vktrace_write_buffer_to_trace_packet(vktrace_trace_packet_header* pHeader, void** ptr_address, uint64_t size,
+                                          const void* pBuffer);
+
 // sets entrypoint end time
 void vktrace_set_packet_entrypoint_end_time(vktrace_trace_packet_header* pHeader);
 
@@ -99,14 +105,53 @@ void vktrace_finalize_trace_packet(vktrace_trace_packet_header* pHeader);
 
 // Write the trace packet to the filelike thing.
 // This has no knowledge of the details of the packet other than its size.
+// If a packet writer is installed, a copy of the packet is queued to it instead.
 void vktrace_write_trace_packet(const vktrace_trace_packet_header* pHeader, FileLike* pFile);
 
+// Write the trace packet to the filelike thing and delete it, setting *ppHeader to NULL.
+// If a packet writer is installed, ownership of the packet is handed to it without a copy.
+void vktrace_submit_trace_packet(vktrace_trace_packet_header** ppHeader, FileLike* pFile);
+
+// A packet writer moves the actual writing of trace packets off the calling thread.
+// Packets are written in the order they were queued.
+typedef struct vktrace_trace_packet_writer {
+    // Takes ownership of pHeader. The writer writes it to pFile and then deletes it.
+    void (*pfnQueuePacket)(vktrace_trace_packet_header* pHeader, FileLike* pFile);
+} vktrace_trace_packet_writer;
+
+// Install a packet writer, or pass NULL to go back to writing packets on the calling thread.
+void vktrace_set_trace_packet_writer(const vktrace_trace_packet_writer* pWriter);
+
+// Called by vktrace_create_trace_packet before the new packet gets its index, so that packets the
+// tracer is holding back can be written ahead of it. Pass NULL to remove the callback.
+typedef void (*vktrace_packet_created_callback)(uint16_t packet_id);
+void vktrace_set_packet_created_callback(vktrace_packet_created_callback pfnCallback);
+
+// Called by vktrace_submit_trace_packet with each finished packet before it is written, which the
+// callback may rewrite in place into a packet no larger than it. Pass NULL to remove the callback.
+typedef void (*vktrace_packet_submit_callback)(vktrace_trace_packet_header* pHeader);
+void vktrace_set_packet_submit_callback(vktrace_packet_submit_callback pfnCallback);
+
 //=============================================================================
 // Methods for Reading and interpretting trace packets
 
 // Reads in the trace packet header, the body of the packet, and additional buffers
 vktrace_trace_packet_header* vktrace_read_trace_packet(FileLike* pFile);
 
+// Reads the frame table of the trace described by pHeader, see vktrace_frame_table_header.
+// On success *ppEntries must be freed with vktrace_free. Leaves the file position unchanged.
+BOOL vktrace_read_frame_table(FileLike* pFile, const vktrace_trace_file_header* pHeader, uint64_t* pFrameCount,
+                              vktrace_frame_table_entry** ppEntries);
+
+// Reads the frame statistics of the trace described by pHeader, see vktrace_frame_stats_entry, the
+// same way.
+BOOL vktrace_read_frame_stats(FileLike* pFile, const vktrace_trace_file_header* pHeader, uint64_t* pFrameCount,
+                              vktrace_frame_stats_entry** ppEntries);
+
+// Category of the call named name in the frame statistics, VKTRACE_FRAME_STATS_CATEGORY_COUNT if it
+// isn't a call. Names come from vktrace_vk_packet_id_name.
+int vktrace_frame_stats_call_category(const char* name);
+
 // converts a pointer variable that is currently byte offset into a pointer to the actual offset location
 void* vktrace_trace_packet_interpret_buffer_pointer(vktrace_trace_packet_header* pHeader, intptr_t ptr_variable);
 
@@ -0,0 +1,235 @@
+/**************************************************************************
+ *
+ * Copyright (C) 2017 LunarG, Inc.
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **************************************************************************/
+#include "vktraceedit.h"
+
+#include <algorithm>
+#include <thread>
+
+vktraceedit_settings g_settings;
+vktraceedit_settings g_default_settings;
+
+vktrace_SettingInfo g_settings_info[] = {
+    {"i",
+     "InputTraces",
+     VKTRACE_SETTING_STRING,
+     {&g_settings.input_traces},
+     {&g_default_settings.input_traces},
+     TRUE,
+     "Comma separated list of the trace files to read, which are spliced together in that order."},
+    {"o",
+     "OutputTrace",
+     VKTRACE_SETTING_STRING,
+     {&g_settings.output_trace},
+     {&g_default_settings.output_trace},
+     TRUE,
+     "Path to the trace file to write. Further files get -1, -2 and so on added to the name."},
+    {"f",
+     "Frames",
+     VKTRACE_SETTING_STRING,
+     {&g_settings.frames},
+     {&g_default_settings.frames},
+     TRUE,
+     "Frames to write, <first>-<last>, counted over all input traces. Default is all frames."},
+    {"sf",
+     "SplitFrames",
+     VKTRACE_SETTING_UINT,
+     {&g_settings.split_frames},
+     {&g_default_settings.split_frames},
+     TRUE,
+     "Write a trace file for every <uint> frames, 0 writes all frames to one file. Default is 0."},
+    {"ks",
+     "KeepSetup",
+     VKTRACE_SETTING_BOOL,
+     {&g_settings.keep_setup},
+     {&g_default_settings.keep_setup},
+     TRUE,
+     "Keep the calls of earlier frames that don't submit or wait on queue work, so the frames written can be replayed. Default "
+     "is TRUE."},
+    {"t",
+     "Threads",
+     VKTRACE_SETTING_UINT,
+     {&g_settings.threads},
+     {&g_default_settings.threads},
+     TRUE,
+     "Number of threads that read and write packets, 0 uses one per CPU core. Default is 0."},
+    {"v",
+     "Verbosity",
+     VKTRACE_SETTING_STRING,
+     {&g_settings.verbosity},
+     {&g_default_settings.verbosity},
+     TRUE,
+     "Verbosity mode. Modes are \"quiet\", \"errors\", \"warnings\", \"full\"."},
+};
+
+vktrace_SettingGroup g_settingGroup = {"vktraceedit", sizeof(g_settings_info) / sizeof(g_settings_info[0]), &g_settings_info[0]};
+
+// ------------------------------------------------------------------------------------------------
+void loggingCallback(VktraceLogLevel level, const char* pMessage) {
+    if (level == VKTRACE_LOG_NONE) return;
+
+    switch (level) {
+        case VKTRACE_LOG_DEBUG:
+            printf("vktraceedit debug: %s\n", pMessage);
+            break;
+        case VKTRACE_LOG_ERROR:
+            printf("vktraceedit error: %s\n", pMessage);
+            break;
+        case VKTRACE_LOG_WARNING:
+            printf("vktraceedit warning: %s\n", pMessage);
+            break;
+        case VKTRACE_LOG_VERBOSE:
+            printf("vktraceedit info: %s\n", pMessage);
+            break;
+        default:
+            printf("%s\n", pMessage);
+            break;
+    }
+    fflush(stdout);
+
+#if defined(WIN32)
+#if _DEBUG
+    OutputDebugString(pMessage);
+#endif
+#endif
+}
+
+// ------------------------------------------------------------------------------------------------
+static char* output_filename(uint32_t index) {
+    if (index == 0) {
+        return vktrace_allocate_and_copy(g_settings.output_trace);
+    }
+
+    // Like the trace files of later trim windows
+    const char* pExtension = strrchr(g_settings.output_trace, '.');
+    char* basename = vktrace_allocate_and_copy_n(
+        g_settings.output_trace,
+        (int)((pExtension == NULL) ? strlen(g_settings.output_trace) : pExtension - g_settings.output_trace));
+    char num[17];
+#ifdef PLATFORM_LINUX
+    snprintf(num, 17, "-%u", index);
+#elif defined(WIN32)
+    _snprintf_s(num, 17, _TRUNCATE, "-%u", index);
+#endif
+    char* pFilename = vktrace_copy_and_append(basename, num, pExtension);
+    vktrace_free(basename);
+    return pFilename;
+}
+
+// ------------------------------------------------------------------------------------------------
+int main(int argc, char* argv[]) {
+    memset(&g_settings, 0, sizeof(vktraceedit_settings));
+
+    vktrace_LogSetCallback(loggingCallback);
+    vktrace_LogSetLevel(VKTRACE_LOG_ERROR);
+
+    // setup defaults
+    memset(&g_default_settings, 0, sizeof(vktraceedit_settings));
+    g_default_settings.output_trace = "vktraceedit_out.vktrace";
+    g_default_settings.keep_setup = TRUE;
+    g_default_settings.verbosity = "errors";
+
+    if (vktrace_SettingGroup_init(&g_settingGroup, NULL, argc, argv, NULL) != 0) {
+        // invalid cmd-line parameters
+        vktrace_SettingGroup_delete(&g_settingGroup);
+        return -1;
+    }
+
+    // Validate vktraceedit inputs
+    BOOL validArgs = TRUE;
+    if (g_settings.input_traces == NULL || strlen(g_settings.input_traces) == 0 || g_settings.output_trace == NULL ||
+        strlen(g_settings.output_trace) == 0) {
+        validArgs = FALSE;
+    }
+
+    if (strcmp(g_settings.verbosity, "quiet") == 0)
+        vktrace_LogSetLevel(VKTRACE_LOG_NONE);
+    else if (strcmp(g_settings.verbosity, "errors") == 0)
+        vktrace_LogSetLevel(VKTRACE_LOG_ERROR);
+    else if (strcmp(g_settings.verbosity, "warnings") == 0)
+        vktrace_LogSetLevel(VKTRACE_LOG_WARNING);
+    else if (strcmp(g_settings.verbosity, "full") == 0)
+        vktrace_LogSetLevel(VKTRACE_LOG_VERBOSE);
+    else {
+        vktrace_LogSetLevel(VKTRACE_LOG_ERROR);
+        validArgs = FALSE;
+    }
+
+    uint64_t firstFrame = 0;
+    uint64_t lastFrame = UINT64_MAX;
+    if (g_settings.frames != NULL && strlen(g_settings.frames) > 0) {
+        unsigned long long first = 0, last = 0;
+        char end = 0;
+        if (sscanf(g_settings.frames, "%llu-%llu%c", &first, &last, &end) != 2 || last < first) {
+            vktrace_LogError("Frames must be given as <first>-<last>.");
+            validArgs = FALSE;
+        }
+        firstFrame = first;
+        lastFrame = last;
+    }
+
+    if (validArgs == FALSE) {
+        vktrace_SettingGroup_print(&g_settingGroup);
+        vktrace_SettingGroup_delete(&g_settingGroup);
+        return -1;
+    }
+
+    unsigned int threadCount = g_settings.threads;
+    if (threadCount == 0) {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    std::vector<InputTrace> inputs;
+    std::vector<FramePiece> pieces;
+    int result = 0;
+    if (!vktraceedit_load_inputs(inputs, g_settings.input_traces) || !vktraceedit_index_inputs(inputs, pieces, threadCount)) {
+        result = -1;
+    } else if (pieces.empty() || firstFrame > pieces.back().frame) {
+        vktrace_LogError("The input traces have %" PRIu64 " frames, there is no frame %" PRIu64 ".",
+                         pieces.empty() ? 0 : pieces.back().frame + 1, firstFrame);
+        result = -1;
+    } else {
+        if (lastFrame > pieces.back().frame) {
+            if (lastFrame != UINT64_MAX) {
+                vktrace_LogWarning("The input traces end with frame %" PRIu64 ".", pieces.back().frame);
+            }
+            lastFrame = pieces.back().frame;
+        }
+
+        // Blobs may be used by any later packet, so they are kept even when setup isn't
+        PieceContents earlierContents = g_settings.keep_setup ? PieceContents_Setup : PieceContents_Blobs;
+        uint64_t framesPerOutput = g_settings.split_frames > 0 ? g_settings.split_frames : lastFrame - firstFrame + 1;
+        uint32_t outputIndex = 0;
+        for (uint64_t frame = firstFrame; frame <= lastFrame && result == 0; frame += framesPerOutput) {
+            char* pFilename = output_filename(outputIndex++);
+            uint64_t outputLastFrame = std::min(lastFrame, frame + framesPerOutput - 1);
+            if (!vktraceedit_write_output(pFilename, inputs, pieces, frame, outputLastFrame, earlierContents, threadCount)) {
+                result = -1;
+            }
+            vktrace_free(pFilename);
+            if (outputLastFrame == lastFrame) {
+                break;
+            }
+        }
+    }
+
+    for (InputTrace& input : inputs) {
+        vktrace_free(input.filename);
+    }
+    vktrace_SettingGroup_delete(&g_settingGroup);
+    return result;
+}
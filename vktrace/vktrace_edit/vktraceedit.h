@@ -0,0 +1,118 @@
+/**************************************************************************
+ *
+ * Copyright (C) 2017 LunarG, Inc.
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **************************************************************************/
+#pragma once
+
+extern "C" {
+#include "vktrace_common.h"
+#include "vktrace_filelike.h"
+#include "vktrace_settings.h"
+#include "vktrace_trace_packet_identifiers.h"
+}
+
+#include <inttypes.h>
+#include <functional>
+#include <vector>
+
+// vktraceedit writes new trace files made of frames of existing ones. The input traces are taken
+// as one long trace, in the order they are given, and the frames are numbered across all of
+// them. Each output gets a range of those frames.
+//
+// The packets are never all in memory at once. The inputs are first indexed from their packet
+// headers into pieces of at most one frame each, and then every output is written by worker
+// threads that each copy a run of pieces to a place in the output file worked out up front.
+
+typedef struct vktraceedit_settings {
+    const char* input_traces;
+    const char* output_trace;
+    const char* frames;
+    unsigned int split_frames;
+    BOOL keep_setup;
+    unsigned int threads;
+    const char* verbosity;
+} vktraceedit_settings;
+
+extern vktraceedit_settings g_settings;
+
+// A piece is closed once it holds this many bytes of packets, so large frames are copied by
+// several threads.
+#define VKTRACEEDIT_PIECE_SIZE (64 * 1024 * 1024)
+
+// Which packets of a piece go into an output
+enum PieceContents {
+    // All of them, for frames in the output's range
+    PieceContents_All,
+
+    // All but those that do or wait on queue work, for the frames before the range. They
+    // create the state the frames in the range use.
+    PieceContents_Setup,
+
+    // Only the blob packets, for the frames before the range when setup isn't kept. Later
+    // packets may refer to any of them.
+    PieceContents_Blobs,
+
+    PieceContents_Count
+};
+
+struct InputTrace {
+    char* filename;
+    vktrace_trace_file_header header;
+    std::vector<struct_gpuinfo> gpuinfo;
+
+    // Offsets of the packets listed in the trace's portability table, sorted
+    std::vector<size_t> portabilityTable;
+    bool hasPortabilityTable;
+
+    // Frame numbers, counted over all inputs, of the first frame and one past the last
+    uint64_t firstFrame;
+    uint64_t endFrame;
+
+    bool hasBlobs;
+};
+
+// A run of packets from one frame of one input
+struct FramePiece {
+    uint32_t input;
+    uint64_t frame;
+    uint64_t beginOffset;
+    uint64_t endOffset;
+    uint64_t packetCount[PieceContents_Count];
+    uint64_t size[PieceContents_Count];
+};
+
+// Returns true if the packet does or waits on queue work, see PieceContents_Setup
+bool vktraceedit_is_queue_work(const vktrace_trace_packet_header* pHeader);
+
+// Calls func(i, worker) for each i in [0, count) on up to threadCount threads, worker being the
+// number of the thread in [0, threadCount). Returns once all calls are done.
+void vktraceedit_parallel_for(size_t count, unsigned int threadCount, const std::function<void(size_t, unsigned int)>& func);
+
+// Opens an input trace for reading packets, decompressing it if needed. Returns NULL on failure.
+FileLike* vktraceedit_open_input(const InputTrace& input, FILE** ppFile);
+void vktraceedit_close_input(FileLike** ppFileLike, FILE** ppFile);
+
+// Reads the header, gpuinfo and portability table of each input.
+bool vktraceedit_load_inputs(std::vector<InputTrace>& inputs, const char* pInputList);
+
+// Splits all packets of the inputs into pieces, in order, using worker threads for inputs with
+// a frame table. Sets the frame numbers of the inputs.
+bool vktraceedit_index_inputs(std::vector<InputTrace>& inputs, std::vector<FramePiece>& pieces, unsigned int threadCount);
+
+// Writes frames [firstFrame, lastFrame] to a new trace file, with the packets of pieces before
+// firstFrame as given by earlierContents.
+bool vktraceedit_write_output(const char* pFilename, const std::vector<InputTrace>& inputs, const std::vector<FramePiece>& pieces,
+                              uint64_t firstFrame, uint64_t lastFrame, PieceContents earlierContents, unsigned int threadCount);
@@ -0,0 +1,372 @@
+/**************************************************************************
+ *
+ * Copyright (C) 2017 LunarG, Inc.
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **************************************************************************/
+#include "vktraceedit.h"
+
+extern "C" {
+#include "vktrace_trace_packet_utils.h"
+#include "vktrace_vk_packet_id.h"
+}
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+
+// ------------------------------------------------------------------------------------------------
+bool vktraceedit_is_queue_work(const vktrace_trace_packet_header* pHeader) {
+    if (pHeader->tracer_id != VKTRACE_TID_VULKAN) return false;
+
+    // Without the submits of a frame its fences, events and queries are never signaled and no
+    // swapchain image is given back, so the calls waiting on those go too
+    switch (pHeader->packet_id) {
+        case VKTRACE_TPI_VK_vkQueueSubmit:
+        case VKTRACE_TPI_VK_vkQueueBindSparse:
+        case VKTRACE_TPI_VK_vkQueuePresentKHR:
+        case VKTRACE_TPI_VK_vkQueueWaitIdle:
+        case VKTRACE_TPI_VK_vkAcquireNextImageKHR:
+        case VKTRACE_TPI_VK_vkAcquireNextImage2KHX:
+        case VKTRACE_TPI_VK_vkWaitForFences:
+        case VKTRACE_TPI_VK_vkGetFenceStatus:
+        case VKTRACE_TPI_VK_vkGetEventStatus:
+        case VKTRACE_TPI_VK_vkGetQueryPoolResults:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+FileLike* vktraceedit_open_input(const InputTrace& input, FILE** ppFile) {
+    *ppFile = fopen(input.filename, "rb");
+    if (*ppFile == NULL) {
+        return NULL;
+    }
+
+    FileLike* pFileLike = vktrace_FileLike_create_file(*ppFile);
+    if (pFileLike == NULL || !vktrace_FileLike_EnableDecompression(pFileLike, &input.header)) {
+        vktraceedit_close_input(&pFileLike, ppFile);
+        return NULL;
+    }
+    return pFileLike;
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktraceedit_close_input(FileLike** ppFileLike, FILE** ppFile) {
+    vktrace_FileLike_destroy(ppFileLike);
+    if (*ppFile != NULL) {
+        fclose(*ppFile);
+        *ppFile = NULL;
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+static bool load_input(InputTrace& input) {
+    FILE* pFile = fopen(input.filename, "rb");
+    if (pFile == NULL) {
+        vktrace_LogError("Unable to open trace file %s.", input.filename);
+        return false;
+    }
+
+    bool loaded = 1 == fread(&input.header, sizeof(input.header), 1, pFile);
+    if (!loaded || input.header.magic != VKTRACE_FILE_MAGIC || input.header.n_gpuinfo < 1 ||
+        input.header.first_packet_offset != sizeof(input.header) + input.header.n_gpuinfo * sizeof(struct_gpuinfo)) {
+        vktrace_LogError("%s does not appear to be a valid Vulkan trace file.", input.filename);
+        fclose(pFile);
+        return false;
+    }
+    if (input.header.trace_file_version < VKTRACE_TRACE_FILE_VERSION_MINIMUM_COMPATIBLE) {
+        vktrace_LogError("Trace file version %u of %s is older than minimum compatible version (%u).",
+                         input.header.trace_file_version, input.filename, VKTRACE_TRACE_FILE_VERSION_MINIMUM_COMPATIBLE);
+        fclose(pFile);
+        return false;
+    }
+
+    input.gpuinfo.resize((size_t)input.header.n_gpuinfo);
+    loaded = 1 == fread(&input.gpuinfo[0], input.gpuinfo.size() * sizeof(struct_gpuinfo), 1, pFile);
+    fclose(pFile);
+    if (!loaded) {
+        vktrace_LogError("Unable to read header from file %s.", input.filename);
+        return false;
+    }
+
+    // The portability table is the last words of the file, the last one being its length
+    input.hasPortabilityTable = false;
+    if (input.header.portability_table_valid) {
+        FileLike* pFileLike = vktraceedit_open_input(input, &pFile);
+        size_t tableSize = 0;
+        if (pFileLike != NULL && pFileLike->mFileLen >= input.header.first_packet_offset + sizeof(size_t) &&
+            vktrace_FileLike_SetCurrentPosition(pFileLike, pFileLike->mFileLen - sizeof(size_t)) &&
+            vktrace_FileLike_ReadRaw(pFileLike, &tableSize, sizeof(size_t)) &&
+            tableSize < (pFileLike->mFileLen - input.header.first_packet_offset) / sizeof(size_t)) {
+            input.portabilityTable.resize(tableSize);
+            input.hasPortabilityTable =
+                tableSize == 0 ||
+                (vktrace_FileLike_SetCurrentPosition(pFileLike, pFileLike->mFileLen - (tableSize + 1) * sizeof(size_t)) &&
+                 vktrace_FileLike_ReadRaw(pFileLike, &input.portabilityTable[0], tableSize * sizeof(size_t)));
+        }
+        vktraceedit_close_input(&pFileLike, &pFile);
+    }
+    if (!input.hasPortabilityTable) {
+        vktrace_LogWarning("%s does not contain a portability table.", input.filename);
+        input.portabilityTable.clear();
+    }
+    std::sort(input.portabilityTable.begin(), input.portabilityTable.end());
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+bool vktraceedit_load_inputs(std::vector<InputTrace>& inputs, const char* pInputList) {
+    std::string list(pInputList);
+    size_t begin = 0;
+    while (begin <= list.size()) {
+        size_t end = std::min(list.find(',', begin), list.size());
+        if (end > begin) {
+            InputTrace input = {};
+            input.filename = vktrace_allocate_and_copy(list.substr(begin, end - begin).c_str());
+            inputs.push_back(input);
+            if (!load_input(inputs.back())) {
+                return false;
+            }
+        }
+        begin = end + 1;
+    }
+    if (inputs.empty()) {
+        vktrace_LogError("No input trace files were given.");
+        return false;
+    }
+
+    // The packets are copied as they are, so they must all have been made the same way
+    const InputTrace& first = inputs[0];
+    for (size_t i = 1; i < inputs.size(); i++) {
+        const vktrace_trace_file_header& header = inputs[i].header;
+        if (header.trace_file_version != first.header.trace_file_version || header.ptrsize != first.header.ptrsize ||
+            header.arch != first.header.arch || header.os != first.header.os || header.endianess != first.header.endianess) {
+            vktrace_LogError("%s was traced with another version of vktrace or on another platform than %s.", inputs[i].filename,
+                             first.filename);
+            return false;
+        }
+        if (inputs[i].gpuinfo.size() != first.gpuinfo.size() ||
+            memcmp(&inputs[i].gpuinfo[0], &first.gpuinfo[0], first.gpuinfo.size() * sizeof(struct_gpuinfo)) != 0) {
+            vktrace_LogWarning("%s was traced on other GPUs than %s, the output gets the GPU info of %s.", inputs[i].filename,
+                               first.filename, first.filename);
+        }
+    }
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktraceedit_parallel_for(size_t count, unsigned int threadCount, const std::function<void(size_t, unsigned int)>& func) {
+    std::atomic<size_t> next(0);
+    auto thread_func = [&](unsigned int worker) {
+        for (size_t i = next++; i < count; i = next++) {
+            func(i, worker);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int worker = 1; worker < threadCount && worker < count; worker++) {
+        threads.push_back(std::thread(thread_func, worker));
+    }
+    thread_func(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// Pieces of a run of packets of one input, with frames numbered from the input's first
+struct IndexRun {
+    uint64_t beginOffset;
+    uint64_t endOffset;  // UINT64_MAX to go to the end of the packets
+    uint64_t firstFrame;
+    uint64_t endFrame;  // frame the next packet after the run would be in
+    std::vector<FramePiece> pieces;
+    bool hasBlobs;
+    bool failed;
+};
+
+// ------------------------------------------------------------------------------------------------
+static void start_piece(FramePiece& piece, uint32_t input, uint64_t frame, uint64_t offset) {
+    memset(&piece, 0, sizeof(piece));
+    piece.input = input;
+    piece.frame = frame;
+    piece.beginOffset = offset;
+}
+
+// ------------------------------------------------------------------------------------------------
+static void index_packets(FileLike* pFile, const InputTrace& input, uint32_t inputIndex, IndexRun& run) {
+    vktrace_trace_packet_header header;
+    uint64_t offset = run.beginOffset;
+    uint64_t frame = run.firstFrame;
+    FramePiece piece;
+
+    start_piece(piece, inputIndex, frame, offset);
+    while (offset < run.endOffset) {
+        if (offset == pFile->mFileLen) {
+            break;
+        }
+        if (offset + sizeof(header) > pFile->mFileLen || !vktrace_FileLike_SetCurrentPosition(pFile, (size_t)offset) ||
+            !vktrace_FileLike_ReadRaw(pFile, &header, sizeof(header)) || header.size < sizeof(header) ||
+            offset + header.size > pFile->mFileLen) {
+            vktrace_LogWarning("The last packet in %s is incomplete, it is left out.", input.filename);
+            break;
+        }
+
+        // The portability table is always the last packet, and the output gets a new one
+        if (header.packet_id == VKTRACE_TPI_PORTABILITY_TABLE) {
+            break;
+        }
+
+        piece.packetCount[PieceContents_All]++;
+        piece.size[PieceContents_All] += header.size;
+        if (!vktraceedit_is_queue_work(&header)) {
+            piece.packetCount[PieceContents_Setup]++;
+            piece.size[PieceContents_Setup] += header.size;
+        }
+        if (header.packet_id == VKTRACE_TPI_BLOB) {
+            piece.packetCount[PieceContents_Blobs]++;
+            piece.size[PieceContents_Blobs] += header.size;
+            run.hasBlobs = true;
+        }
+        offset += header.size;
+
+        bool bPresent = header.tracer_id == VKTRACE_TID_VULKAN && header.packet_id == VKTRACE_TPI_VK_vkQueuePresentKHR;
+        if (bPresent || piece.size[PieceContents_All] >= VKTRACEEDIT_PIECE_SIZE) {
+            piece.endOffset = offset;
+            run.pieces.push_back(piece);
+            if (bPresent) {
+                frame++;
+            }
+            start_piece(piece, inputIndex, frame, offset);
+        }
+    }
+
+    if (piece.packetCount[PieceContents_All] > 0) {
+        piece.endOffset = offset;
+        run.pieces.push_back(piece);
+    }
+
+    // A run in the middle of the trace has to end where the next one starts
+    run.failed = run.endOffset != UINT64_MAX && (offset != run.endOffset || frame != run.endFrame);
+    run.endOffset = offset;
+    run.endFrame = frame;
+}
+
+// ------------------------------------------------------------------------------------------------
+static bool index_input(InputTrace& input, uint32_t inputIndex, std::vector<FramePiece>& pieces, unsigned int threadCount) {
+    FILE* pFile = NULL;
+    FileLike* pFileLike = vktraceedit_open_input(input, &pFile);
+    if (pFileLike == NULL) {
+        vktrace_LogError("Unable to read trace file %s.", input.filename);
+        return false;
+    }
+
+    // Frames the frame table says start at known offsets can be walked at the same time
+    std::vector<IndexRun> runs;
+    uint64_t frameCount = 0;
+    vktrace_frame_table_entry* pFrameTable = NULL;
+    if (threadCount > 1 && vktrace_read_frame_table(pFileLike, &input.header, &frameCount, &pFrameTable)) {
+        uint64_t runCount = std::min<uint64_t>(frameCount, threadCount * 4);
+        for (uint64_t i = 0; i < runCount; i++) {
+            uint64_t firstFrame = frameCount * i / runCount;
+            uint64_t endFrame = frameCount * (i + 1) / runCount;
+            IndexRun run = {};
+            run.beginOffset = pFrameTable[firstFrame].packet_offset;
+            run.endOffset = endFrame < frameCount ? pFrameTable[endFrame].packet_offset : UINT64_MAX;
+            run.firstFrame = firstFrame;
+            run.endFrame = endFrame;
+            runs.push_back(run);
+        }
+        vktrace_free(pFrameTable);
+    }
+    vktraceedit_close_input(&pFileLike, &pFile);
+
+    bool bIndexed = !runs.empty();
+    if (bIndexed) {
+        std::atomic<bool> failed(false);
+        vktraceedit_parallel_for(runs.size(), threadCount, [&](size_t i, unsigned int worker) {
+            FILE* pRunFile = NULL;
+            FileLike* pRunFileLike = failed ? NULL : vktraceedit_open_input(input, &pRunFile);
+            if (pRunFileLike == NULL) {
+                failed = true;
+                return;
+            }
+            index_packets(pRunFileLike, input, inputIndex, runs[i]);
+            if (runs[i].failed) {
+                failed = true;
+            }
+            vktraceedit_close_input(&pRunFileLike, &pRunFile);
+        });
+        if (failed) {
+            vktrace_LogWarning("The frame table of %s doesn't match its packets, reading them in order instead.", input.filename);
+            bIndexed = false;
+        }
+    }
+
+    if (!bIndexed) {
+        IndexRun run = {};
+        run.beginOffset = input.header.first_packet_offset;
+        run.endOffset = UINT64_MAX;
+        runs.assign(1, run);
+
+        pFileLike = vktraceedit_open_input(input, &pFile);
+        if (pFileLike == NULL) {
+            vktrace_LogError("Unable to read trace file %s.", input.filename);
+            return false;
+        }
+        index_packets(pFileLike, input, inputIndex, runs[0]);
+        vktraceedit_close_input(&pFileLike, &pFile);
+    }
+
+    input.hasBlobs = false;
+    for (const IndexRun& run : runs) {
+        for (const FramePiece& piece : run.pieces) {
+            pieces.push_back(piece);
+            pieces.back().frame += input.firstFrame;
+        }
+        input.hasBlobs = input.hasBlobs || run.hasBlobs;
+    }
+    input.endFrame = pieces.empty() || pieces.back().input != inputIndex ? input.firstFrame : pieces.back().frame + 1;
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+bool vktraceedit_index_inputs(std::vector<InputTrace>& inputs, std::vector<FramePiece>& pieces, unsigned int threadCount) {
+    const InputTrace* pBlobInput = NULL;
+    uint64_t frame = 0;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        inputs[i].firstFrame = frame;
+        if (!index_input(inputs[i], (uint32_t)i, pieces, threadCount)) {
+            return false;
+        }
+        frame = inputs[i].endFrame;
+        vktrace_LogVerbose("%s has %" PRIu64 " frames, frames %" PRIu64 " to %" PRIu64 " of the input.", inputs[i].filename,
+                           inputs[i].endFrame - inputs[i].firstFrame, inputs[i].firstFrame, inputs[i].endFrame - 1);
+
+        // Blob ids start over in every trace file, and the packets referring to them can't be
+        // told apart without interpreting them
+        if (inputs[i].hasBlobs) {
+            if (pBlobInput != NULL) {
+                vktrace_LogError("%s and %s both contain blobs (were traced with --DedupBlobs), only one of the inputs can.",
+                                 pBlobInput->filename, inputs[i].filename);
+                return false;
+            }
+            pBlobInput = &inputs[i];
+        }
+    }
+    return true;
+}
@@ -0,0 +1,286 @@
+/**************************************************************************
+ *
+ * Copyright (C) 2017 LunarG, Inc.
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **************************************************************************/
+#include "vktraceedit.h"
+
+extern "C" {
+#include "vktrace_compression.h"
+#include "vktrace_vk_packet_id.h"
+}
+
+#include <algorithm>
+#include <atomic>
+
+// A run of pieces one worker copies, and what it found on the way
+struct WriteTask {
+    size_t firstPiece;
+    size_t endPiece;
+    uint64_t outputOffset;
+    uint64_t firstPacketIndex;
+    uint64_t size;
+
+    std::vector<size_t> portabilityTable;
+    std::vector<vktrace_frame_table_entry> frameTable;
+    uint32_t lastPacketThreadId;
+    uint64_t lastPacketEndTime;
+};
+
+// Files a worker has open, kept from one task to the next
+struct WriteWorker {
+    FILE* pOutputFile;
+    std::vector<FILE*> inputFiles;
+    std::vector<FileLike*> inputFileLikes;
+    std::vector<uint8_t> packet;
+};
+
+// ------------------------------------------------------------------------------------------------
+static PieceContents piece_contents(const FramePiece& piece, uint64_t firstFrame, PieceContents earlierContents) {
+    return piece.frame < firstFrame ? earlierContents : PieceContents_All;
+}
+
+// ------------------------------------------------------------------------------------------------
+static bool keep_packet(const vktrace_trace_packet_header* pHeader, PieceContents contents) {
+    switch (contents) {
+        case PieceContents_All:
+            return true;
+        case PieceContents_Setup:
+            return !vktraceedit_is_queue_work(pHeader);
+        case PieceContents_Blobs:
+            return pHeader->packet_id == VKTRACE_TPI_BLOB;
+        default:
+            return false;
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+static bool copy_pieces(const char* pFilename, const std::vector<InputTrace>& inputs, const std::vector<FramePiece>& pieces,
+                        uint64_t firstFrame, PieceContents earlierContents, WriteTask& task, WriteWorker& worker) {
+    if (worker.pOutputFile == NULL) {
+        worker.pOutputFile = fopen(pFilename, "r+b");
+        if (worker.pOutputFile == NULL) {
+            return false;
+        }
+    }
+    if (Fseek(worker.pOutputFile, task.outputOffset, SEEK_SET) != 0) {
+        return false;
+    }
+
+    uint64_t outputOffset = task.outputOffset;
+    uint64_t packetIndex = task.firstPacketIndex;
+    for (size_t i = task.firstPiece; i < task.endPiece; i++) {
+        const FramePiece& piece = pieces[i];
+        const InputTrace& input = inputs[piece.input];
+        PieceContents contents = piece_contents(piece, firstFrame, earlierContents);
+        if (piece.packetCount[contents] == 0) {
+            continue;
+        }
+
+        FileLike*& pFileLike = worker.inputFileLikes[piece.input];
+        if (pFileLike == NULL) {
+            pFileLike = vktraceedit_open_input(input, &worker.inputFiles[piece.input]);
+            if (pFileLike == NULL) {
+                return false;
+            }
+        }
+
+        uint64_t offset = piece.beginOffset;
+        bool bPositioned = false;
+        while (offset < piece.endOffset) {
+            vktrace_trace_packet_header header;
+            if ((!bPositioned && !vktrace_FileLike_SetCurrentPosition(pFileLike, (size_t)offset)) ||
+                !vktrace_FileLike_ReadRaw(pFileLike, &header, sizeof(header))) {
+                return false;
+            }
+
+            // Skipped packets leave the file somewhere in their body
+            bPositioned = keep_packet(&header, contents);
+            if (bPositioned) {
+                worker.packet.resize((size_t)header.size);
+                header.global_packet_index = packetIndex;
+                memcpy(&worker.packet[0], &header, sizeof(header));
+                if (!vktrace_FileLike_ReadRaw(pFileLike, &worker.packet[sizeof(header)], (size_t)header.size - sizeof(header)) ||
+                    1 != fwrite(&worker.packet[0], (size_t)header.size, 1, worker.pOutputFile)) {
+                    return false;
+                }
+
+                if (input.hasPortabilityTable &&
+                    std::binary_search(input.portabilityTable.begin(), input.portabilityTable.end(), (size_t)offset)) {
+                    task.portabilityTable.push_back((size_t)outputOffset);
+                }
+                outputOffset += header.size;
+                if (header.tracer_id == VKTRACE_TID_VULKAN && header.packet_id == VKTRACE_TPI_VK_vkQueuePresentKHR) {
+                    vktrace_frame_table_entry frame = {outputOffset, packetIndex};
+                    task.frameTable.push_back(frame);
+                }
+                task.lastPacketThreadId = header.thread_id;
+                task.lastPacketEndTime = header.vktrace_end_time;
+                packetIndex++;
+            }
+            offset += header.size;
+        }
+    }
+
+    // The index made the plan, so the packets have to come out the same
+    return outputOffset == task.outputOffset + task.size;
+}
+
+// ------------------------------------------------------------------------------------------------
+static bool append_tables(FILE* pFile, uint64_t packetOffset, const vktrace_trace_packet_header& lastHeader,
+                          const std::vector<vktrace_frame_table_entry>& frameTable, std::vector<size_t>& portabilityTable) {
+    vktrace_trace_packet_header hdr = {};
+    vktrace_frame_table_header frameTableHdr;
+
+    // Laid out as vktrace_appendPortabilityPacket does, the table's size being the last word
+    portabilityTable.push_back(portabilityTable.size());
+    frameTableHdr.frame_count = frameTable.size();
+    std::vector<uint8_t> body(sizeof(frameTableHdr) + frameTable.size() * sizeof(vktrace_frame_table_entry) +
+                              portabilityTable.size() * sizeof(size_t));
+    uint8_t* pBody = &body[0];
+    memcpy(pBody, &frameTableHdr, sizeof(frameTableHdr));
+    pBody += sizeof(frameTableHdr);
+    memcpy(pBody, &frameTable[0], frameTable.size() * sizeof(vktrace_frame_table_entry));
+    pBody += frameTable.size() * sizeof(vktrace_frame_table_entry);
+    memcpy(pBody, &portabilityTable[0], portabilityTable.size() * sizeof(size_t));
+
+    hdr.size = sizeof(hdr) + body.size();
+    hdr.global_packet_index = lastHeader.global_packet_index;
+    hdr.tracer_id = VKTRACE_TID_VULKAN;
+    hdr.packet_id = VKTRACE_TPI_PORTABILITY_TABLE;
+    hdr.thread_id = lastHeader.thread_id;
+    hdr.vktrace_begin_time = hdr.entrypoint_begin_time = hdr.entrypoint_end_time = hdr.vktrace_end_time =
+        lastHeader.vktrace_end_time;
+    hdr.next_buffers_offset = 0;
+    hdr.pBody = (uintptr_t)NULL;
+    return Fseek(pFile, packetOffset, SEEK_SET) == 0 && 1 == fwrite(&hdr, sizeof(hdr), 1, pFile) &&
+           1 == fwrite(&body[0], body.size(), 1, pFile);
+}
+
+// ------------------------------------------------------------------------------------------------
+bool vktraceedit_write_output(const char* pFilename, const std::vector<InputTrace>& inputs, const std::vector<FramePiece>& pieces,
+                              uint64_t firstFrame, uint64_t lastFrame, PieceContents earlierContents, unsigned int threadCount) {
+    vktrace_trace_file_header header = inputs[0].header;
+    const std::vector<struct_gpuinfo>& gpuinfo = inputs[0].gpuinfo;
+
+    // Work out where every run of pieces goes before copying any of them
+    std::vector<WriteTask> tasks;
+    uint64_t outputOffset = header.first_packet_offset;
+    uint64_t packetCount = 0;
+    for (size_t i = 0; i < pieces.size() && pieces[i].frame <= lastFrame; i++) {
+        PieceContents contents = piece_contents(pieces[i], firstFrame, earlierContents);
+        uint64_t size = pieces[i].size[contents];
+        if (size == 0) {
+            continue;
+        }
+        if (tasks.empty() || tasks.back().size + size > VKTRACEEDIT_PIECE_SIZE) {
+            WriteTask task = {};
+            task.firstPiece = i;
+            task.outputOffset = outputOffset;
+            task.firstPacketIndex = packetCount;
+            tasks.push_back(task);
+        }
+        tasks.back().endPiece = i + 1;
+        tasks.back().size += size;
+        outputOffset += size;
+        packetCount += pieces[i].packetCount[contents];
+    }
+    if (packetCount == 0) {
+        vktrace_LogError("There are no packets to write to %s.", pFilename);
+        return false;
+    }
+
+    // The packets are written uncompressed, each worker to its own part of the file
+    header.compression_type = VKTRACE_COMPRESSION_NONE;
+    header.frame_index_offset = 0;
+    header.frame_table_offset = 0;
+    // The statistics of the input frames don't hold for frames whose packets are left out
+    header.frame_stats_offset = 0;
+    header.portability_table_valid = 0;
+    FILE* pFile = fopen(pFilename, "wb");
+    if (pFile == NULL || 1 != fwrite(&header, sizeof(header), 1, pFile) ||
+        1 != fwrite(&gpuinfo[0], gpuinfo.size() * sizeof(struct_gpuinfo), 1, pFile)) {
+        vktrace_LogError("Unable to create trace file %s.", pFilename);
+        if (pFile != NULL) fclose(pFile);
+        return false;
+    }
+    fclose(pFile);
+
+    std::vector<WriteWorker> workers(std::max(threadCount, 1u));
+    for (WriteWorker& worker : workers) {
+        worker.pOutputFile = NULL;
+        worker.inputFiles.resize(inputs.size(), NULL);
+        worker.inputFileLikes.resize(inputs.size(), NULL);
+    }
+    std::atomic<bool> failed(false);
+    vktraceedit_parallel_for(tasks.size(), (unsigned int)workers.size(), [&](size_t i, unsigned int worker) {
+        if (!failed && !copy_pieces(pFilename, inputs, pieces, firstFrame, earlierContents, tasks[i], workers[worker])) {
+            failed = true;
+        }
+    });
+    for (WriteWorker& worker : workers) {
+        if (worker.pOutputFile != NULL && fclose(worker.pOutputFile) != 0) {
+            failed = true;
+        }
+        for (size_t i = 0; i < inputs.size(); i++) {
+            vktraceedit_close_input(&worker.inputFileLikes[i], &worker.inputFiles[i]);
+        }
+    }
+    if (failed) {
+        vktrace_LogError("Failed to copy the packets to %s.", pFilename);
+        return false;
+    }
+
+    // Frame 0 starts with the first packet, the others after each present
+    std::vector<vktrace_frame_table_entry> frameTable;
+    std::vector<size_t> portabilityTable;
+    vktrace_frame_table_entry frame = {header.first_packet_offset, 0};
+    frameTable.push_back(frame);
+    for (const WriteTask& task : tasks) {
+        frameTable.insert(frameTable.end(), task.frameTable.begin(), task.frameTable.end());
+        portabilityTable.insert(portabilityTable.end(), task.portabilityTable.begin(), task.portabilityTable.end());
+    }
+
+    // Only the inputs that had a portability table add to it, so it is only complete if all had one
+    bool bPortable = true;
+    for (const InputTrace& input : inputs) {
+        bPortable = bPortable && input.hasPortabilityTable;
+    }
+    if (!bPortable) {
+        vktrace_LogWarning("Not all input traces have a portability table, %s won't have one either.", pFilename);
+        portabilityTable.clear();
+    }
+
+    vktrace_trace_packet_header lastHeader;
+    lastHeader.global_packet_index = packetCount;
+    lastHeader.thread_id = tasks.back().lastPacketThreadId;
+    lastHeader.vktrace_end_time = tasks.back().lastPacketEndTime;
+    header.portability_table_valid = bPortable ? 1 : 0;
+    header.frame_table_offset = outputOffset + sizeof(vktrace_trace_packet_header);
+    pFile = fopen(pFilename, "r+b");
+    bool bWritten = pFile != NULL && append_tables(pFile, outputOffset, lastHeader, frameTable, portabilityTable) &&
+                    Fseek(pFile, 0, SEEK_SET) == 0 && 1 == fwrite(&header, sizeof(header), 1, pFile);
+    if (pFile != NULL && fclose(pFile) != 0) {
+        bWritten = false;
+    }
+    if (!bWritten) {
+        vktrace_LogError("Unable to write the frame and portability tables to %s.", pFilename);
+        return false;
+    }
+
+    vktrace_LogAlways("Wrote frames %" PRIu64 " to %" PRIu64 " to %s, %" PRIu64 " packets.", firstFrame, lastFrame, pFilename,
+                      packetCount);
+    return true;
+}
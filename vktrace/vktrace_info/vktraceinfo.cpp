@@ -0,0 +1,384 @@
+/**************************************************************************
+ *
+ * Copyright (C) 2017 LunarG, Inc.
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **************************************************************************/
+#include "vktraceinfo.h"
+
+extern "C" {
+#include "vktrace_vk_packet_id.h"
+}
+
+#include <string.h>
+#include <algorithm>
+#include <thread>
+
+// How many of the most called APIs are listed for each trace
+static const size_t TOP_API_COUNT = 20;
+
+vktraceinfo_settings g_settings;
+vktraceinfo_settings g_default_settings;
+
+vktrace_SettingInfo g_settings_info[] = {
+    {"i",
+     "InputTraces",
+     VKTRACE_SETTING_STRING,
+     {&g_settings.input_traces},
+     {&g_default_settings.input_traces},
+     TRUE,
+     "Comma separated list of the trace files to read."},
+    {"o",
+     "Output",
+     VKTRACE_SETTING_STRING,
+     {&g_settings.output_file},
+     {&g_default_settings.output_file},
+     TRUE,
+     "Path to the file to write the statistics to. Default is the standard output."},
+    {"f",
+     "Format",
+     VKTRACE_SETTING_STRING,
+     {&g_settings.format},
+     {&g_default_settings.format},
+     TRUE,
+     "Format of the statistics, \"json\" or \"csv\". Default is \"json\"."},
+    {"pf",
+     "PerFrame",
+     VKTRACE_SETTING_BOOL,
+     {&g_settings.per_frame},
+     {&g_default_settings.per_frame},
+     TRUE,
+     "Write the statistics of every frame, not only those of the whole trace. Default is FALSE."},
+    {"t",
+     "Threads",
+     VKTRACE_SETTING_UINT,
+     {&g_settings.threads},
+     {&g_default_settings.threads},
+     TRUE,
+     "Number of threads that read packets, 0 uses one per CPU core. Default is 0."},
+    {"v",
+     "Verbosity",
+     VKTRACE_SETTING_STRING,
+     {&g_settings.verbosity},
+     {&g_default_settings.verbosity},
+     TRUE,
+     "Verbosity mode. Modes are \"quiet\", \"errors\", \"warnings\", \"full\"."},
+};
+
+vktrace_SettingGroup g_settingGroup = {"vktraceinfo", sizeof(g_settings_info) / sizeof(g_settings_info[0]), &g_settings_info[0]};
+
+// Names of the VKTRACE_FRAME_STATS_CATEGORY values in the output
+static const char* const categoryNames[VKTRACE_FRAME_STATS_CATEGORY_COUNT] = {"cmd",    "draw", "submit", "memory",
+                                                                                "object", "sync", "other"};
+
+// ------------------------------------------------------------------------------------------------
+// Messages go to stderr, so they don't end up in statistics written to stdout
+void loggingCallback(VktraceLogLevel level, const char* pMessage) {
+    if (level == VKTRACE_LOG_NONE) return;
+
+    switch (level) {
+        case VKTRACE_LOG_DEBUG:
+            fprintf(stderr, "vktraceinfo debug: %s\n", pMessage);
+            break;
+        case VKTRACE_LOG_ERROR:
+            fprintf(stderr, "vktraceinfo error: %s\n", pMessage);
+            break;
+        case VKTRACE_LOG_WARNING:
+            fprintf(stderr, "vktraceinfo warning: %s\n", pMessage);
+            break;
+        case VKTRACE_LOG_VERBOSE:
+            fprintf(stderr, "vktraceinfo info: %s\n", pMessage);
+            break;
+        default:
+            fprintf(stderr, "%s\n", pMessage);
+            break;
+    }
+    fflush(stderr);
+
+#if defined(WIN32)
+#if _DEBUG
+    OutputDebugString(pMessage);
+#endif
+#endif
+}
+
+// ------------------------------------------------------------------------------------------------
+static std::string json_string(const std::string& value) {
+    std::string quoted = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if ((unsigned char)c < 0x20) {
+            char escaped[7];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+            quoted += escaped;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+// ------------------------------------------------------------------------------------------------
+static std::string csv_string(const std::string& value) {
+    if (value.find_first_of(",\"\n") == std::string::npos) {
+        return value;
+    }
+    std::string quoted = "\"";
+    for (char c : value) {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// ------------------------------------------------------------------------------------------------
+// CPU time of the frame when traced, from the end of the previous frame to the end of its last packet
+static uint64_t frame_cpu_time(const TraceInfo& info, size_t frame) {
+    uint64_t begin = frame > 0 ? info.frames[frame - 1].endTime : info.frames[0].beginTime;
+    return info.frames[frame].endTime > begin ? info.frames[frame].endTime - begin : 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+static void write_json_frame(FILE* pOut, const TraceInfo& info, size_t frame) {
+    const FrameInfo& frameInfo = info.frames[frame];
+    fprintf(pOut, "{\"frame\": %zu, \"packets\": %" PRIu64 ", \"bytes\": %" PRIu64 ", \"upload_bytes\": %" PRIu64, frame,
+            frameInfo.packetCount, frameInfo.bytes, frameInfo.uploadBytes);
+    for (int category = 0; category < VKTRACE_FRAME_STATS_CATEGORY_COUNT; category++) {
+        fprintf(pOut, ", \"%s\": %" PRIu64, categoryNames[category], frameInfo.callCount[category]);
+    }
+    fprintf(pOut, ", \"cpu_time_ns\": %" PRIu64 "}", frame_cpu_time(info, frame));
+}
+
+// ------------------------------------------------------------------------------------------------
+static void write_json(FILE* pOut, const std::vector<TraceInfo>& traces) {
+    fprintf(pOut, "[\n");
+    for (size_t i = 0; i < traces.size(); i++) {
+        const TraceInfo& info = traces[i];
+        fprintf(pOut, "  {\n    \"file\": %s,\n", json_string(info.filename).c_str());
+        if (!info.error.empty()) {
+            fprintf(pOut, "    \"error\": %s\n  }%s\n", json_string(info.error).c_str(), i + 1 < traces.size() ? "," : "");
+            continue;
+        }
+
+        FrameInfo total = {};
+        uint64_t minDraws = UINT64_MAX, maxDraws = 0;
+        uint64_t minTime = UINT64_MAX, maxTime = 0, totalTime = 0;
+        for (size_t frame = 0; frame < info.frames.size(); frame++) {
+            const FrameInfo& frameInfo = info.frames[frame];
+            total.packetCount += frameInfo.packetCount;
+            total.bytes += frameInfo.bytes;
+            total.uploadBytes += frameInfo.uploadBytes;
+            for (int category = 0; category < VKTRACE_FRAME_STATS_CATEGORY_COUNT; category++) {
+                total.callCount[category] += frameInfo.callCount[category];
+            }
+            uint64_t draws = frameInfo.callCount[VKTRACE_FRAME_STATS_DRAW];
+            uint64_t time = frame_cpu_time(info, frame);
+            minDraws = std::min(minDraws, draws);
+            maxDraws = std::max(maxDraws, draws);
+            minTime = std::min(minTime, time);
+            maxTime = std::max(maxTime, time);
+            totalTime += time;
+        }
+        size_t frameCount = info.frames.size();
+        if (frameCount == 0) {
+            minDraws = minTime = 0;
+        }
+
+        fprintf(pOut, "    \"version\": %u,\n    \"compressed\": %s,\n    \"frame_table\": %s,\n", info.header.trace_file_version,
+                info.header.compression_type != VKTRACE_COMPRESSION_NONE ? "true" : "false", info.hasFrameTable ? "true" : "false");
+        fprintf(pOut, "    \"frames\": %zu,\n    \"packets\": %" PRIu64 ",\n    \"bytes\": %" PRIu64 ",\n", frameCount,
+                total.packetCount, total.bytes);
+        fprintf(pOut, "    \"upload_bytes\": %" PRIu64 ",\n    \"calls\": {", total.uploadBytes);
+        for (int category = 0; category < VKTRACE_FRAME_STATS_CATEGORY_COUNT; category++) {
+            fprintf(pOut, "%s\"%s\": %" PRIu64, category > 0 ? ", " : "", categoryNames[category], total.callCount[category]);
+        }
+        fprintf(pOut, "},\n    \"draws_per_frame\": {\"min\": %" PRIu64 ", \"mean\": %.1f, \"max\": %" PRIu64 "},\n", minDraws,
+                frameCount > 0 ? (double)total.callCount[VKTRACE_FRAME_STATS_DRAW] / frameCount : 0.0, maxDraws);
+        fprintf(pOut, "    \"frame_cpu_time_ns\": {\"min\": %" PRIu64 ", \"mean\": %.0f, \"max\": %" PRIu64 "},\n", minTime,
+                frameCount > 0 ? (double)totalTime / frameCount : 0.0, maxTime);
+
+        std::vector<size_t> apiOrder;
+        for (size_t id = 0; id < info.apis.size(); id++) {
+            if (info.apis[id].callCount > 0) apiOrder.push_back(id);
+        }
+        std::sort(apiOrder.begin(), apiOrder.end(),
+                  [&](size_t a, size_t b) { return info.apis[a].callCount > info.apis[b].callCount; });
+        apiOrder.resize(std::min(apiOrder.size(), TOP_API_COUNT));
+        fprintf(pOut, "    \"apis\": [");
+        for (size_t j = 0; j < apiOrder.size(); j++) {
+            const ApiInfo& api = info.apis[apiOrder[j]];
+            fprintf(pOut, "%s\n      {\"name\": \"%s\", \"calls\": %" PRIu64 ", \"api_time_ns\": %" PRIu64 "}", j > 0 ? "," : "",
+                    vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)apiOrder[j]), api.callCount, api.apiTime);
+        }
+        fprintf(pOut, "%s]", apiOrder.empty() ? "" : "\n    ");
+
+        if (g_settings.per_frame) {
+            fprintf(pOut, ",\n    \"per_frame\": [");
+            for (size_t frame = 0; frame < frameCount; frame++) {
+                fprintf(pOut, "%s\n      ", frame > 0 ? "," : "");
+                write_json_frame(pOut, info, frame);
+            }
+            fprintf(pOut, "%s]", frameCount == 0 ? "" : "\n    ");
+        }
+        fprintf(pOut, "\n  }%s\n", i + 1 < traces.size() ? "," : "");
+    }
+    fprintf(pOut, "]\n");
+}
+
+// ------------------------------------------------------------------------------------------------
+static void write_csv_row(FILE* pOut, const std::string& file, const std::string& frame, const FrameInfo& frameInfo,
+                          uint64_t cpuTime) {
+    fprintf(pOut, "%s,%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64, csv_string(file).c_str(), frame.c_str(), frameInfo.packetCount,
+            frameInfo.bytes, frameInfo.uploadBytes);
+    for (int category = 0; category < VKTRACE_FRAME_STATS_CATEGORY_COUNT; category++) {
+        fprintf(pOut, ",%" PRIu64, frameInfo.callCount[category]);
+    }
+    fprintf(pOut, ",%" PRIu64 "\n", cpuTime);
+}
+
+// ------------------------------------------------------------------------------------------------
+// One row per trace, in which frame is the frame count, or with PerFrame one row per frame
+static void write_csv(FILE* pOut, const std::vector<TraceInfo>& traces) {
+    fprintf(pOut, "file,%s,packets,bytes,upload_bytes", g_settings.per_frame ? "frame" : "frames");
+    for (int category = 0; category < VKTRACE_FRAME_STATS_CATEGORY_COUNT; category++) {
+        fprintf(pOut, ",%s", categoryNames[category]);
+    }
+    fprintf(pOut, ",cpu_time_ns\n");
+
+    for (const TraceInfo& info : traces) {
+        if (!info.error.empty()) continue;
+
+        FrameInfo total = {};
+        uint64_t totalTime = 0;
+        for (size_t frame = 0; frame < info.frames.size(); frame++) {
+            const FrameInfo& frameInfo = info.frames[frame];
+            uint64_t time = frame_cpu_time(info, frame);
+            if (g_settings.per_frame) {
+                write_csv_row(pOut, info.filename, std::to_string(frame), frameInfo, time);
+                continue;
+            }
+            total.packetCount += frameInfo.packetCount;
+            total.bytes += frameInfo.bytes;
+            total.uploadBytes += frameInfo.uploadBytes;
+            for (int category = 0; category < VKTRACE_FRAME_STATS_CATEGORY_COUNT; category++) {
+                total.callCount[category] += frameInfo.callCount[category];
+            }
+            totalTime += time;
+        }
+        if (!g_settings.per_frame) {
+            write_csv_row(pOut, info.filename, std::to_string(info.frames.size()), total, totalTime);
+        }
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+int main(int argc, char* argv[]) {
+    memset(&g_settings, 0, sizeof(vktraceinfo_settings));
+
+    vktrace_LogSetCallback(loggingCallback);
+    vktrace_LogSetLevel(VKTRACE_LOG_ERROR);
+
+    // setup defaults
+    memset(&g_default_settings, 0, sizeof(vktraceinfo_settings));
+    g_default_settings.format = "json";
+    g_default_settings.verbosity = "errors";
+
+    if (vktrace_SettingGroup_init(&g_settingGroup, NULL, argc, argv, NULL) != 0) {
+        // invalid cmd-line parameters
+        vktrace_SettingGroup_delete(&g_settingGroup);
+        return -1;
+    }
+
+    // Validate vktraceinfo inputs
+    BOOL validArgs = TRUE;
+    if (g_settings.input_traces == NULL || strlen(g_settings.input_traces) == 0) {
+        validArgs = FALSE;
+    }
+    bool bCsv = strcmp(g_settings.format, "csv") == 0;
+    if (!bCsv && strcmp(g_settings.format, "json") != 0) {
+        vktrace_LogError("Format must be \"json\" or \"csv\".");
+        validArgs = FALSE;
+    }
+
+    if (strcmp(g_settings.verbosity, "quiet") == 0)
+        vktrace_LogSetLevel(VKTRACE_LOG_NONE);
+    else if (strcmp(g_settings.verbosity, "errors") == 0)
+        vktrace_LogSetLevel(VKTRACE_LOG_ERROR);
+    else if (strcmp(g_settings.verbosity, "warnings") == 0)
+        vktrace_LogSetLevel(VKTRACE_LOG_WARNING);
+    else if (strcmp(g_settings.verbosity, "full") == 0)
+        vktrace_LogSetLevel(VKTRACE_LOG_VERBOSE);
+    else {
+        vktrace_LogSetLevel(VKTRACE_LOG_ERROR);
+        validArgs = FALSE;
+    }
+
+    if (validArgs == FALSE) {
+        vktrace_SettingGroup_print(&g_settingGroup);
+        vktrace_SettingGroup_delete(&g_settingGroup);
+        return -1;
+    }
+
+    unsigned int threadCount = g_settings.threads;
+    if (threadCount == 0) {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    // Traces that can't be read are reported in the output, the others are still gone through
+    std::vector<TraceInfo> traces;
+    std::string list(g_settings.input_traces);
+    size_t begin = 0;
+    while (begin < list.size()) {
+        size_t end = list.find(',', begin);
+        if (end == std::string::npos) end = list.size();
+        if (end > begin) {
+            TraceInfo info = {};
+            info.filename = list.substr(begin, end - begin);
+            traces.push_back(info);
+        }
+        begin = end + 1;
+    }
+
+    int result = 0;
+    for (TraceInfo& info : traces) {
+        vktrace_LogVerbose("Reading %s.", info.filename.c_str());
+        if (!vktraceinfo_read_trace(info, threadCount)) {
+            vktrace_LogError("Unable to read trace file %s: %s.", info.filename.c_str(), info.error.c_str());
+            result = -1;
+        }
+    }
+
+    FILE* pOut = stdout;
+    if (g_settings.output_file != NULL && strlen(g_settings.output_file) > 0) {
+        pOut = fopen(g_settings.output_file, "w");
+        if (pOut == NULL) {
+            vktrace_LogError("Unable to open %s to write the statistics to.", g_settings.output_file);
+            vktrace_SettingGroup_delete(&g_settingGroup);
+            return -1;
+        }
+    }
+    if (bCsv) {
+        write_csv(pOut, traces);
+    } else {
+        write_json(pOut, traces);
+    }
+    if (pOut != stdout) {
+        fclose(pOut);
+    }
+
+    vktrace_SettingGroup_delete(&g_settingGroup);
+    return result;
+}
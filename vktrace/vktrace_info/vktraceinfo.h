@@ -0,0 +1,75 @@
+/**************************************************************************
+ *
+ * Copyright (C) 2017 LunarG, Inc.
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **************************************************************************/
+#pragma once
+
+extern "C" {
+#include "vktrace_common.h"
+#include "vktrace_settings.h"
+#include "vktrace_trace_packet_identifiers.h"
+}
+
+#include <inttypes.h>
+#include <string>
+#include <vector>
+
+// vktraceinfo prints statistics of trace files without replaying them: how many calls of each
+// kind every frame makes, how many bytes of memory it uploads, how long it took when traced, and
+// which APIs are called the most. Only the packet headers are read, and the command blocks, so
+// large traces are gone through quickly.
+//
+// Uncompressed traces are mapped into memory and read in place. The frames of a trace with a
+// frame table are split into runs that worker threads go through at the same time, traces
+// without one are read in order.
+
+typedef struct vktraceinfo_settings {
+    const char* input_traces;
+    const char* output_file;
+    const char* format;
+    BOOL per_frame;
+    unsigned int threads;
+    const char* verbosity;
+} vktraceinfo_settings;
+
+extern vktraceinfo_settings g_settings;
+
+struct FrameInfo {
+    uint64_t packetCount;
+    uint64_t bytes;
+    uint64_t uploadBytes;  // counted like vktrace_frame_stats_entry::upload_bytes
+    uint64_t callCount[VKTRACE_FRAME_STATS_CATEGORY_COUNT];
+    uint64_t beginTime;  // vktrace_begin_time of the first packet
+    uint64_t endTime;    // vktrace_end_time of the last packet
+};
+
+struct ApiInfo {
+    uint64_t callCount;
+    uint64_t apiTime;  // ns spent in the driver when traced, calls in command blocks aren't timed
+};
+
+struct TraceInfo {
+    std::string filename;
+    std::string error;  // empty if the trace was read
+    vktrace_trace_file_header header;
+    bool hasFrameTable;
+    std::vector<FrameInfo> frames;
+    std::vector<ApiInfo> apis;  // by VKTRACE_TPI_VK_* packet id
+};
+
+// Reads the packets of the trace into info, using up to threadCount threads. Sets info.error
+// and returns false on failure.
+bool vktraceinfo_read_trace(TraceInfo& info, unsigned int threadCount);
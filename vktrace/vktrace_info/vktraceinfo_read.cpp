@@ -0,0 +1,417 @@
+/**************************************************************************
+ *
+ * Copyright (C) 2017 LunarG, Inc.
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **************************************************************************/
+#include "vktraceinfo.h"
+
+extern "C" {
+#include "vktrace_cmd_block.h"
+#include "vktrace_filelike.h"
+#include "vktrace_trace_packet_utils.h"
+#include "vktrace_vk_packet_id.h"
+}
+
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#elif defined(WIN32)
+#include <io.h>
+#endif
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+// Each worker thread gets about this many runs of frames, so threads that finish early take more
+static const unsigned int RUNS_PER_THREAD = 4;
+
+// Packet ids of the calls, and of the opcodes in command blocks
+static const size_t API_COUNT = VKTRACE_TPI_QUERY_DIGEST + 1;
+
+// ------------------------------------------------------------------------------------------------
+static int frame_stats_category(uint16_t packetId) {
+    static const std::vector<int> categories = [] {
+        std::vector<int> table(API_COUNT);
+        for (size_t id = 0; id < table.size(); id++) {
+            table[id] = vktrace_frame_stats_call_category(vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)id));
+        }
+        return table;
+    }();
+    return packetId < categories.size() ? categories[packetId] : VKTRACE_FRAME_STATS_CATEGORY_COUNT;
+}
+
+// The packets of a trace, mapped into memory if it isn't compressed
+struct TraceFile {
+    const char* filename;
+    const vktrace_trace_file_header* pHeader;
+    const uint8_t* pMapped;
+    uint64_t mappedSize;
+#if defined(WIN32)
+    HANDLE hMapping;
+#endif
+};
+
+// Reads packets of a trace for one thread, from the mapping or else through a FileLike of its own
+struct PacketReader {
+    const TraceFile* pTrace;
+    FILE* pFile;
+    FileLike* pFileLike;
+    uint64_t size;
+    std::vector<uint64_t> body;  // 8 byte aligned like packets in the mapping
+};
+
+// ------------------------------------------------------------------------------------------------
+static bool map_trace(TraceFile& trace, FILE* pFile) {
+    trace.pMapped = NULL;
+    trace.mappedSize = 0;
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
+    struct stat fileStat;
+    int fd = fileno(pFile);
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+        return false;
+    }
+    void* pBase = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (pBase == MAP_FAILED) {
+        return false;
+    }
+    trace.pMapped = (const uint8_t*)pBase;
+    trace.mappedSize = (uint64_t)fileStat.st_size;
+#elif defined(WIN32)
+    HANDLE hFile = (HANDLE)_get_osfhandle(_fileno(pFile));
+    LARGE_INTEGER fileSize;
+    if (hFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0) {
+        return false;
+    }
+    trace.hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (trace.hMapping == NULL) {
+        return false;
+    }
+    trace.pMapped = (const uint8_t*)MapViewOfFile(trace.hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (trace.pMapped == NULL) {
+        CloseHandle(trace.hMapping);
+        trace.hMapping = NULL;
+        return false;
+    }
+    trace.mappedSize = (uint64_t)fileSize.QuadPart;
+#endif
+    return trace.pMapped != NULL;
+}
+
+// ------------------------------------------------------------------------------------------------
+static void unmap_trace(TraceFile& trace) {
+    if (trace.pMapped == NULL) return;
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
+    munmap((void*)trace.pMapped, (size_t)trace.mappedSize);
+#elif defined(WIN32)
+    UnmapViewOfFile(trace.pMapped);
+    CloseHandle(trace.hMapping);
+    trace.hMapping = NULL;
+#endif
+    trace.pMapped = NULL;
+}
+
+// ------------------------------------------------------------------------------------------------
+static void close_trace_file(FileLike** ppFileLike, FILE** ppFile) {
+    vktrace_FileLike_destroy(ppFileLike);
+    if (*ppFile != NULL) {
+        fclose(*ppFile);
+        *ppFile = NULL;
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+// Opens the trace to read through a FileLike, which decompresses it if it is compressed
+static FileLike* open_trace_file(const TraceFile& trace, FILE** ppFile) {
+    FileLike* pFileLike = NULL;
+    *ppFile = fopen(trace.filename, "rb");
+    if (*ppFile != NULL) {
+        pFileLike = vktrace_FileLike_create_file(*ppFile);
+    }
+    if (pFileLike == NULL || !vktrace_FileLike_EnableDecompression(pFileLike, trace.pHeader)) {
+        close_trace_file(&pFileLike, ppFile);
+    }
+    return pFileLike;
+}
+
+// ------------------------------------------------------------------------------------------------
+static void close_reader(PacketReader& reader) { close_trace_file(&reader.pFileLike, &reader.pFile); }
+
+// ------------------------------------------------------------------------------------------------
+static bool open_reader(PacketReader& reader, const TraceFile& trace) {
+    reader.pTrace = &trace;
+    reader.pFile = NULL;
+    reader.pFileLike = NULL;
+    if (trace.pMapped != NULL) {
+        reader.size = trace.mappedSize;
+        return true;
+    }
+
+    reader.pFileLike = open_trace_file(trace, &reader.pFile);
+    if (reader.pFileLike == NULL) {
+        return false;
+    }
+    reader.size = reader.pFileLike->mFileLen;
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Reads the header of the packet at offset. Returns false if it doesn't fit in the trace.
+static bool read_header(PacketReader& reader, uint64_t offset, vktrace_trace_packet_header& header) {
+    if (offset + sizeof(header) > reader.size) {
+        return false;
+    }
+    if (reader.pTrace->pMapped != NULL) {
+        memcpy(&header, reader.pTrace->pMapped + offset, sizeof(header));
+    } else if (!vktrace_FileLike_SetCurrentPosition(reader.pFileLike, (size_t)offset) ||
+               !vktrace_FileLike_ReadRaw(reader.pFileLike, &header, sizeof(header))) {
+        return false;
+    }
+    return header.size >= sizeof(header) && offset + header.size <= reader.size;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Returns the body of the packet at offset, whose header has been read, or NULL if it can't be read
+static const void* read_body(PacketReader& reader, uint64_t offset, const vktrace_trace_packet_header& header) {
+    size_t bodySize = (size_t)header.size - sizeof(header);
+    if (reader.pTrace->pMapped != NULL) {
+        return reader.pTrace->pMapped + offset + sizeof(header);
+    }
+    reader.body.resize((bodySize + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    if (bodySize > 0 && !vktrace_FileLike_ReadRaw(reader.pFileLike, &reader.body[0], bodySize)) {
+        return NULL;
+    }
+    return reader.body.data();
+}
+
+// Statistics of a run of packets of a trace, with frames numbered from the first of the trace
+struct InfoRun {
+    uint64_t beginOffset;
+    uint64_t endOffset;  // UINT64_MAX to go to the end of the packets
+    uint64_t firstFrame;
+    uint64_t endFrame;  // frame the next packet after the run would be in
+    std::vector<FrameInfo> frames;
+    std::vector<ApiInfo> apis;
+    bool failed;
+};
+
+// ------------------------------------------------------------------------------------------------
+static void add_call(InfoRun& run, FrameInfo& frame, uint16_t packetId) {
+    int category = frame_stats_category(packetId);
+    if (category != VKTRACE_FRAME_STATS_CATEGORY_COUNT) {
+        frame.callCount[category]++;
+    }
+    if (packetId < API_COUNT) {
+        run.apis[packetId].callCount++;
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+static void read_packets(PacketReader& reader, InfoRun& run) {
+    vktrace_trace_packet_header header;
+    uint64_t offset = run.beginOffset;
+    uint64_t frameNumber = run.firstFrame;
+    FrameInfo frame = {};
+
+    run.apis.assign(API_COUNT, ApiInfo());
+    while (offset < run.endOffset && offset != reader.size) {
+        if (!read_header(reader, offset, header)) {
+            vktrace_LogWarning("The last packet in %s is incomplete, it is left out.", reader.pTrace->filename);
+            break;
+        }
+
+        // The portability table is always the last packet
+        if (header.packet_id == VKTRACE_TPI_PORTABILITY_TABLE) {
+            break;
+        }
+
+        if (frame.packetCount == 0) {
+            frame.beginTime = header.vktrace_begin_time;
+        }
+        frame.packetCount++;
+        frame.bytes += header.size;
+        frame.endTime = header.vktrace_end_time;
+
+        if (header.tracer_id == VKTRACE_TID_VULKAN && header.packet_id == VKTRACE_TPI_CMD_BLOCK) {
+            const vktrace_cmd_block* pBlock = (const vktrace_cmd_block*)read_body(reader, offset, header);
+            if (pBlock == NULL || header.size < sizeof(header) + sizeof(vktrace_cmd_block) ||
+                pBlock->streamSize > header.size - sizeof(header) - sizeof(vktrace_cmd_block)) {
+                vktrace_LogWarning("Command block packet %" PRIu64 " in %s is corrupt.", header.global_packet_index,
+                                   reader.pTrace->filename);
+            } else {
+                vktrace_cmd_block_reader blockReader;
+                uint16_t opcode;
+                vktrace_cmd_block_reader_init(&blockReader, pBlock);
+                while (vktrace_cmd_block_next(&blockReader, &opcode)) {
+                    add_call(run, frame, opcode);
+                }
+            }
+        } else if (header.tracer_id == VKTRACE_TID_VULKAN) {
+            add_call(run, frame, header.packet_id);
+            if (header.packet_id < API_COUNT && header.entrypoint_end_time > header.entrypoint_begin_time) {
+                run.apis[header.packet_id].apiTime += header.entrypoint_end_time - header.entrypoint_begin_time;
+            }
+            if (header.packet_id == VKTRACE_TPI_VK_vkFlushMappedMemoryRanges || header.packet_id == VKTRACE_TPI_VK_vkUnmapMemory) {
+                frame.uploadBytes += header.size - sizeof(header);
+            }
+        }
+        offset += header.size;
+
+        if (header.tracer_id == VKTRACE_TID_VULKAN && header.packet_id == VKTRACE_TPI_VK_vkQueuePresentKHR) {
+            run.frames.push_back(frame);
+            memset(&frame, 0, sizeof(frame));
+            frameNumber++;
+        }
+    }
+    if (frame.packetCount > 0) {
+        run.frames.push_back(frame);
+    }
+
+    // A run in the middle of the trace has to end where the next one starts
+    run.failed = run.endOffset != UINT64_MAX && (offset != run.endOffset || frameNumber != run.endFrame);
+}
+
+// ------------------------------------------------------------------------------------------------
+static bool load_header(TraceInfo& info, FILE* pFile) {
+    if (fread(&info.header, sizeof(info.header), 1, pFile) != 1 || info.header.magic != VKTRACE_FILE_MAGIC ||
+        info.header.n_gpuinfo < 1 ||
+        info.header.first_packet_offset != sizeof(info.header) + info.header.n_gpuinfo * sizeof(struct_gpuinfo)) {
+        info.error = "not a valid Vulkan trace file";
+        return false;
+    }
+    if (info.header.trace_file_version < VKTRACE_TRACE_FILE_VERSION_MINIMUM_COMPATIBLE) {
+        info.error = "trace file version " + std::to_string(info.header.trace_file_version) + " is older than the minimum " +
+                     "compatible version " + std::to_string(VKTRACE_TRACE_FILE_VERSION_MINIMUM_COMPATIBLE);
+        return false;
+    }
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+static void parallel_for(size_t count, unsigned int threadCount, const std::function<void(size_t)>& func) {
+    std::atomic<size_t> next(0);
+    auto thread_func = [&]() {
+        for (size_t i = next++; i < count; i = next++) {
+            func(i);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int worker = 1; worker < threadCount && worker < count; worker++) {
+        threads.push_back(std::thread(thread_func));
+    }
+    thread_func();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+bool vktraceinfo_read_trace(TraceInfo& info, unsigned int threadCount) {
+    FILE* pFile = fopen(info.filename.c_str(), "rb");
+    if (pFile == NULL) {
+        info.error = "unable to open the file";
+        return false;
+    }
+    if (!load_header(info, pFile)) {
+        fclose(pFile);
+        return false;
+    }
+
+    TraceFile trace = {};
+    trace.filename = info.filename.c_str();
+    trace.pHeader = &info.header;
+    if (info.header.compression_type == VKTRACE_COMPRESSION_NONE && !map_trace(trace, pFile)) {
+        vktrace_LogVerbose("Unable to map %s into memory, reading it instead.", trace.filename);
+    }
+
+    // Frames the frame table says start at known offsets can be gone through at the same time
+    std::vector<InfoRun> runs;
+    uint64_t frameCount = 0;
+    vktrace_frame_table_entry* pFrameTable = NULL;
+    FILE* pTableFile = NULL;
+    FileLike* pTableFileLike = open_trace_file(trace, &pTableFile);
+    info.hasFrameTable =
+        pTableFileLike != NULL && vktrace_read_frame_table(pTableFileLike, &info.header, &frameCount, &pFrameTable);
+    close_trace_file(&pTableFileLike, &pTableFile);
+
+    if (info.hasFrameTable && threadCount > 1) {
+        uint64_t runCount = std::min<uint64_t>(frameCount, threadCount * RUNS_PER_THREAD);
+        for (uint64_t i = 0; i < runCount; i++) {
+            uint64_t firstFrame = frameCount * i / runCount;
+            uint64_t endFrame = frameCount * (i + 1) / runCount;
+            InfoRun run = {};
+            run.beginOffset = pFrameTable[firstFrame].packet_offset;
+            run.endOffset = endFrame < frameCount ? pFrameTable[endFrame].packet_offset : UINT64_MAX;
+            run.firstFrame = firstFrame;
+            run.endFrame = endFrame;
+            runs.push_back(run);
+        }
+    }
+    if (pFrameTable != NULL) {
+        vktrace_free(pFrameTable);
+    }
+
+    bool bRead = !runs.empty();
+    if (bRead) {
+        std::atomic<bool> failed(false);
+        parallel_for(runs.size(), threadCount, [&](size_t i) {
+            PacketReader runReader;
+            if (failed || !open_reader(runReader, trace)) {
+                failed = true;
+                return;
+            }
+            read_packets(runReader, runs[i]);
+            if (runs[i].failed) {
+                failed = true;
+            }
+            close_reader(runReader);
+        });
+        if (failed) {
+            vktrace_LogWarning("The frame table of %s doesn't match its packets, reading them in order instead.", trace.filename);
+            bRead = false;
+        }
+    }
+
+    if (!bRead) {
+        PacketReader reader;
+        InfoRun run = {};
+        run.beginOffset = info.header.first_packet_offset;
+        run.endOffset = UINT64_MAX;
+        runs.assign(1, run);
+        if (!open_reader(reader, trace)) {
+            info.error = "unable to read the packets";
+            unmap_trace(trace);
+            fclose(pFile);
+            return false;
+        }
+        read_packets(reader, runs[0]);
+        close_reader(reader);
+    }
+    unmap_trace(trace);
+    fclose(pFile);
+
+    info.apis.assign(API_COUNT, ApiInfo());
+    for (const InfoRun& run : runs) {
+        info.frames.insert(info.frames.end(), run.frames.begin(), run.frames.end());
+        for (size_t id = 0; id < API_COUNT; id++) {
+            info.apis[id].callCount += run.apis[id].callCount;
+            info.apis[id].apiTime += run.apis[id].apiTime;
+        }
+    }
+    return true;
+}
@@ -22,6 +22,7 @@
 #include "vktrace_common.h"
 #include "vktrace_filelike.h"
 #include "vktrace_interconnect.h"
+#include "vktrace_packet_arena.h"
 #include "vktrace_vk_vk.h"
 #include "vktrace_lib_trim.h"
 #include "vktrace_lib_helpers.h"
@@ -89,8 +90,7 @@ void loggingCallback(VktraceLogLevel level, const char *pMessage) {
         vktrace_set_packet_entrypoint_end_time(pHeader);
         vktrace_finalize_trace_packet(pHeader);
 
-        vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
-        vktrace_delete_trace_packet(&pHeader);
+        vktrace_submit_trace_packet(&pHeader, vktrace_trace_get_trace_file());
     }
 
 #if defined(WIN32)
@@ -171,6 +171,10 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpReserv
             _Unload();
             break;
         }
+        case DLL_THREAD_DETACH: {
+            vktrace_packet_arena_thread_exit();
+            break;
+        }
         default:
             break;
     }
@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "vktrace_platform.h"
+#include "vktrace_common.h"
+#include "vktrace_interconnect.h"
+#include "vktrace_pageguard_memorycopy.h"
+#include "vktrace_lib_asyncwriter.h"
+#include "vk_timeline.h"
+
+// Number of packets the ring can hold. Must be a power of two.
+static const uint64_t ASYNC_WRITER_RING_SIZE = 4096;
+
+// Packets are gathered until there are this many bytes or packets, and written together
+// without being copied into one buffer.
+static const size_t ASYNC_WRITER_BATCH_SIZE = 256 * 1024;
+static const size_t ASYNC_WRITER_BATCH_COUNT = 64;
+
+typedef struct AsyncWriterSlot {
+    std::atomic<uint64_t> sequence;
+    vktrace_trace_packet_header* pHeader;
+    FileLike* pFile;
+} AsyncWriterSlot;
+
+class AsyncPacketWriter {
+   public:
+    AsyncPacketWriter();
+    ~AsyncPacketWriter();
+
+    bool start();
+    void stop();
+
+    void push(vktrace_trace_packet_header* pHeader, FileLike* pFile);
+
+   private:
+    static VKTRACE_THREAD_ROUTINE_RETURN_TYPE threadFunc(LPVOID pParam);
+
+    bool pop(vktrace_trace_packet_header** ppHeader, FileLike** ppFile);
+    void drain();
+    void writePacket(vktrace_trace_packet_header* pHeader, FileLike* pFile);
+    void writeBatch();
+    void wakeWriter();
+
+    AsyncWriterSlot* m_pSlots;
+
+    // Producers reserve slots by advancing m_enqueuePos. Only the writer advances m_dequeuePos.
+    std::atomic<uint64_t> m_enqueuePos;
+    uint64_t m_dequeuePos;
+
+    std::atomic<bool> m_writerSleeping;
+    std::atomic<bool> m_exit;
+    std::atomic<bool> m_threadDone;
+    vktrace_sem_id m_wakeSem;
+    vktrace_thread m_thread;
+
+    // Packets headed for the same FileLike, which are deleted once they are written in one go.
+    std::vector<MessageStreamBuffer> m_batch;
+    size_t m_batchSize;
+    FileLike* m_pBatchFile;
+};
+
+AsyncPacketWriter::AsyncPacketWriter()
+    : m_pSlots(NULL),
+      m_enqueuePos(0),
+      m_dequeuePos(0),
+      m_writerSleeping(false),
+      m_exit(false),
+      m_threadDone(false),
+      m_thread(VKTRACE_NULL_THREAD),
+      m_batchSize(0),
+      m_pBatchFile(NULL) {}
+
+AsyncPacketWriter::~AsyncPacketWriter() { delete[] m_pSlots; }
+
+bool AsyncPacketWriter::start() {
+    m_pSlots = new AsyncWriterSlot[ASYNC_WRITER_RING_SIZE];
+    for (uint64_t i = 0; i < ASYNC_WRITER_RING_SIZE; i++) {
+        m_pSlots[i].sequence.store(i, std::memory_order_relaxed);
+        m_pSlots[i].pHeader = NULL;
+        m_pSlots[i].pFile = NULL;
+    }
+
+    m_batch.reserve(ASYNC_WRITER_BATCH_COUNT);
+    if (!vktrace_sem_create(&m_wakeSem, 0)) {
+        return false;
+    }
+
+    m_thread = vktrace_platform_create_thread(threadFunc, this);
+    return m_thread != VKTRACE_NULL_THREAD;
+}
+
+void AsyncPacketWriter::stop() {
+    m_exit.store(true);
+    wakeWriter();
+
+#if defined(WIN32)
+    // On Windows the writer thread has already been terminated if we get here from process exit,
+    // so don't wait on it forever. Whatever it didn't get to is written below on this thread.
+    while (!m_threadDone.load()) {
+        if (WaitForSingleObject(m_thread, 1) == WAIT_OBJECT_0) break;
+    }
+#else
+    vktrace_linux_sync_wait_for_thread(&m_thread);
+#endif
+    vktrace_platform_delete_thread(&m_thread);
+
+    drain();
+    vktrace_sem_delete(m_wakeSem);
+}
+
+void AsyncPacketWriter::push(vktrace_trace_packet_header* pHeader, FileLike* pFile) {
+    AsyncWriterSlot* pSlot;
+    uint64_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        pSlot = &m_pSlots[pos & (ASYNC_WRITER_RING_SIZE - 1)];
+        uint64_t seq = pSlot->sequence.load(std::memory_order_acquire);
+        int64_t diff = (int64_t)seq - (int64_t)pos;
+        if (diff == 0) {
+            if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Ring is full, let the writer catch up.
+            wakeWriter();
+            std::this_thread::yield();
+            pos = m_enqueuePos.load(std::memory_order_relaxed);
+        } else {
+            pos = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    pSlot->pHeader = pHeader;
+    pSlot->pFile = pFile;
+    pSlot->sequence.store(pos + 1, std::memory_order_release);
+
+    if (m_writerSleeping.load()) {
+        wakeWriter();
+    }
+}
+
+bool AsyncPacketWriter::pop(vktrace_trace_packet_header** ppHeader, FileLike** ppFile) {
+    AsyncWriterSlot* pSlot = &m_pSlots[m_dequeuePos & (ASYNC_WRITER_RING_SIZE - 1)];
+    uint64_t seq = pSlot->sequence.load(std::memory_order_acquire);
+    if (seq != m_dequeuePos + 1) {
+        return false;
+    }
+
+    *ppHeader = pSlot->pHeader;
+    *ppFile = pSlot->pFile;
+    pSlot->sequence.store(m_dequeuePos + ASYNC_WRITER_RING_SIZE, std::memory_order_release);
+    m_dequeuePos++;
+    return true;
+}
+
+void AsyncPacketWriter::drain() {
+    vktrace_trace_packet_header* pHeader;
+    FileLike* pFile;
+    while (pop(&pHeader, &pFile)) {
+        writePacket(pHeader, pFile);
+    }
+    writeBatch();
+}
+
+void AsyncPacketWriter::writePacket(vktrace_trace_packet_header* pHeader, FileLike* pFile) {
+    size_t size = (size_t)pHeader->size;
+    if (pFile != m_pBatchFile || m_batchSize + size > ASYNC_WRITER_BATCH_SIZE || m_batch.size() == ASYNC_WRITER_BATCH_COUNT) {
+        writeBatch();
+    }
+
+    // A packet larger than the batch size is written in a batch of its own
+    MessageStreamBuffer buffer = {pHeader, size};
+    m_batch.push_back(buffer);
+    m_batchSize += size;
+    m_pBatchFile = pFile;
+}
+
+void AsyncPacketWriter::writeBatch() {
+    if (!m_batch.empty()) {
+        VK_TIMELINE_ZONE("vktrace", "write");
+        BOOL res = vktrace_FileLike_WriteRawGather(m_pBatchFile, m_batch.data(), m_batch.size());
+        const vktrace_trace_packet_header* pLast = (const vktrace_trace_packet_header*)m_batch.back().pBytes;
+        if (!res && pLast->packet_id != VKTRACE_TPI_MARKER_TERMINATE_PROCESS) {
+            vktrace_LogWarning("Failed to write trace packet.");
+            exit(1);
+        }
+        for (size_t i = 0; i < m_batch.size(); i++) {
+            vktrace_trace_packet_header* pHeader = (vktrace_trace_packet_header*)m_batch[i].pBytes;
+            vktrace_delete_trace_packet(&pHeader);
+        }
+        m_batch.clear();
+        m_batchSize = 0;
+    }
+    m_pBatchFile = NULL;
+}
+
+void AsyncPacketWriter::wakeWriter() {
+    if (m_writerSleeping.exchange(false)) {
+        vktrace_sem_post(m_wakeSem);
+    }
+}
+
+VKTRACE_THREAD_ROUTINE_RETURN_TYPE AsyncPacketWriter::threadFunc(LPVOID pParam) {
+    AsyncPacketWriter* pWriter = (AsyncPacketWriter*)pParam;
+    vk_timeline_thread_name("vktrace writer");
+    while (!pWriter->m_exit.load()) {
+        pWriter->drain();
+
+        // Announce that we are about to sleep, then look at the ring once more so a packet pushed
+        // in between can't be missed.
+        pWriter->m_writerSleeping.store(true);
+        AsyncWriterSlot* pSlot = &pWriter->m_pSlots[pWriter->m_dequeuePos & (ASYNC_WRITER_RING_SIZE - 1)];
+        if (pSlot->sequence.load(std::memory_order_acquire) == pWriter->m_dequeuePos + 1 || pWriter->m_exit.load()) {
+            pWriter->m_writerSleeping.store(false);
+            continue;
+        }
+        vktrace_sem_wait(pWriter->m_wakeSem);
+    }
+    pWriter->drain();
+    pWriter->m_threadDone.store(true);
+    return 0;
+}
+
+static AsyncPacketWriter* s_pAsyncWriter = NULL;
+
+static void async_writer_queue_packet(vktrace_trace_packet_header* pHeader, FileLike* pFile) { s_pAsyncWriter->push(pHeader, pFile); }
+
+static const vktrace_trace_packet_writer s_asyncPacketWriter = {async_writer_queue_packet};
+
+void vktrace_async_writer_start() {
+    if (s_pAsyncWriter != NULL) return;
+
+    const char* env_async_writer = vktrace_get_global_var(VKTRACE_ASYNC_WRITER_ENV);
+    if (env_async_writer == NULL || strcmp(env_async_writer, "1") != 0) return;
+
+    s_pAsyncWriter = new AsyncPacketWriter();
+    if (!s_pAsyncWriter->start()) {
+        vktrace_LogError("Failed to start the asynchronous trace writer, writing packets synchronously.");
+        delete s_pAsyncWriter;
+        s_pAsyncWriter = NULL;
+        return;
+    }
+    vktrace_set_trace_packet_writer(&s_asyncPacketWriter);
+    vktrace_LogVerbose("Asynchronous trace writer enabled.");
+}
+
+void vktrace_async_writer_stop() {
+    if (s_pAsyncWriter == NULL) return;
+
+    s_pAsyncWriter->stop();
+    vktrace_set_trace_packet_writer(NULL);
+    delete s_pAsyncWriter;
+    s_pAsyncWriter = NULL;
+}
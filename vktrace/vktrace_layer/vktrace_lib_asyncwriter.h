@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  Asynchronous trace writer
+//
+//     Without it every intercepted call writes its packet to the trace FileLike on the calling
+//     thread, so any stall in the socket (or in vktrace writing the file on the other end) shows
+//     up directly in the application's frame time.
+//
+//     When VKTRACE_ASYNC_WRITER is set to 1, application threads instead push finished packets
+//     into a bounded multi-producer ring and a dedicated thread drains the ring to the FileLike,
+//     batching small packets into larger writes. Packets are written in the order they were
+//     pushed, which is the same order the synchronous path writes them in. If the ring is full
+//     the pushing thread waits for the writer thread to catch up.
+
+#pragma once
+
+#include "vktrace_filelike.h"
+#include "vktrace_trace_packet_utils.h"
+
+// Install the asynchronous packet writer if it has been enabled with VKTRACE_ASYNC_WRITER.
+// Must be called before any thread other than the caller can write trace packets.
+void vktrace_async_writer_start();
+
+// Write everything still queued, stop the writer thread and go back to writing packets on the
+// calling thread. Safe to call if the writer was never started.
+void vktrace_async_writer_stop();
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <assert.h>
+#include <mutex>
+#include <vector>
+#include "vktrace_platform.h"
+#include "vktrace_common.h"
+#include "vktrace_tracelog.h"
+#include "vktrace_trace_packet_utils.h"
+#include "vktrace_lib_trim.h"
+#include "vktrace_lib_cmdblock.h"
+
+bool g_cmdBlocksEnabled = false;
+
+typedef struct CmdBlock {
+    // Held by the owning thread while it adds a call, and by any thread writing the block out
+    std::mutex mutex;
+    uint32_t threadId;
+    VkCommandBuffer commandBuffer;
+    uint32_t commandCount;
+    uint64_t beginTime;
+    uint64_t endTime;
+    // Offset of the entry of the call being added
+    uint32_t entryOffset;
+    vktrace_cmd_block_writer writer;
+    uint8_t stream[VKTRACE_CMD_BLOCK_MAX_STREAM_SIZE];
+} CmdBlock;
+
+// The blocks of all threads that ever traced a vkCmd* call. Blocks are never freed, as other threads
+// may be writing them out when their thread exits. When both are needed, s_blocksLock is taken
+// before the mutex of a block.
+static std::mutex s_blocksLock;
+static std::vector<CmdBlock*> s_blocks;
+
+static VKTRACE_THREAD_LOCAL CmdBlock* s_pThreadBlock = NULL;
+
+// ------------------------------------------------------------------------------------------------
+// pBlock->mutex must be held
+static void write_block(CmdBlock* pBlock) {
+    if (pBlock->commandCount == 0) return;
+
+    vktrace_trace_packet_header* pHeader =
+        vktrace_create_trace_packet(VKTRACE_TID_VULKAN, VKTRACE_TPI_CMD_BLOCK, sizeof(vktrace_cmd_block), pBlock->writer.offset);
+    // May be written out by another thread, the packet belongs to the thread that made the calls
+    pHeader->thread_id = pBlock->threadId;
+    pHeader->vktrace_begin_time = pBlock->beginTime;
+    pHeader->entrypoint_begin_time = pBlock->beginTime;
+    pHeader->entrypoint_end_time = pBlock->endTime;
+    vktrace_cmd_block* pPacket = (vktrace_cmd_block*)pHeader->pBody;
+    pPacket->header = pHeader;
+    pPacket->commandBuffer = pBlock->commandBuffer;
+    pPacket->commandCount = pBlock->commandCount;
+    pPacket->streamSize = pBlock->writer.offset;
+    void* pStream = vktrace_trace_packet_get_new_buffer_address(pHeader, pBlock->writer.offset);
+    memcpy(pStream, pBlock->stream, pBlock->writer.offset);
+    vktrace_finalize_trace_packet(pHeader);
+    vktrace_submit_trace_packet(&pHeader, vktrace_trace_get_trace_file());
+
+    pBlock->commandBuffer = VK_NULL_HANDLE;
+    pBlock->commandCount = 0;
+    pBlock->writer.offset = 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Writes out the blocks holding calls on commandBuffer, or all blocks if it is VK_NULL_HANDLE,
+// except pSkipBlock
+static void write_blocks(VkCommandBuffer commandBuffer, CmdBlock* pSkipBlock) {
+    std::lock_guard<std::mutex> lock(s_blocksLock);
+    for (CmdBlock* pBlock : s_blocks) {
+        if (pBlock == pSkipBlock) continue;
+        std::lock_guard<std::mutex> blockLock(pBlock->mutex);
+        if (commandBuffer == VK_NULL_HANDLE || pBlock->commandBuffer == commandBuffer) {
+            write_block(pBlock);
+        }
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+static void on_packet_created(uint16_t packetId) {
+    switch (packetId) {
+        case VKTRACE_TPI_CMD_BLOCK:
+            break;
+        case VKTRACE_TPI_VK_vkBeginCommandBuffer:
+        case VKTRACE_TPI_VK_vkEndCommandBuffer:
+        case VKTRACE_TPI_VK_vkResetCommandBuffer:
+        case VKTRACE_TPI_VK_vkFreeCommandBuffers:
+        case VKTRACE_TPI_VK_vkResetCommandPool:
+        case VKTRACE_TPI_VK_vkDestroyCommandPool:
+        case VKTRACE_TPI_VK_vkQueueSubmit:
+        case VKTRACE_TPI_VK_vkQueuePresentKHR:
+        case VKTRACE_TPI_VK_vkDestroyDevice:
+        case VKTRACE_TPI_MARKER_TERMINATE_PROCESS:
+            write_blocks(VK_NULL_HANDLE, NULL);
+            break;
+        default:
+            if (s_pThreadBlock != NULL) {
+                std::lock_guard<std::mutex> lock(s_pThreadBlock->mutex);
+                write_block(s_pThreadBlock);
+            }
+            break;
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_cmd_blocks_start() {
+    const char* env_cmd_blocks = vktrace_get_global_var(VKTRACE_CMD_BLOCKS_ENV);
+    if (env_cmd_blocks == NULL || strcmp(env_cmd_blocks, "1") != 0) return;
+
+    if (g_trimEnabled) {
+        vktrace_LogWarning("vkCmd* calls aren't traced as command blocks in trimmed traces.");
+        return;
+    }
+    vktrace_set_packet_created_callback(on_packet_created);
+    g_cmdBlocksEnabled = true;
+    vktrace_LogVerbose("Tracing vkCmd* calls as command blocks.");
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_cmd_blocks_stop() {
+    if (!g_cmdBlocksEnabled) return;
+
+    g_cmdBlocksEnabled = false;
+    vktrace_set_packet_created_callback(NULL);
+}
+
+// ------------------------------------------------------------------------------------------------
+vktrace_cmd_block_writer* vktrace_cmd_block_begin(VkCommandBuffer commandBuffer, uint16_t opcode, size_t maxSize) {
+    if (VKTRACE_CMD_BLOCK_ENTRY_HEADER_SIZE + maxSize > VKTRACE_CMD_BLOCK_MAX_STREAM_SIZE) {
+        return NULL;
+    }
+    uint32_t entrySize = (uint32_t)(VKTRACE_CMD_BLOCK_ENTRY_HEADER_SIZE + maxSize);
+
+    CmdBlock* pBlock = s_pThreadBlock;
+    if (pBlock == NULL) {
+        pBlock = new CmdBlock();
+        pBlock->threadId = vktrace_platform_get_thread_id();
+        pBlock->commandBuffer = VK_NULL_HANDLE;
+        pBlock->commandCount = 0;
+        pBlock->writer.pStream = pBlock->stream;
+        pBlock->writer.offset = 0;
+        std::lock_guard<std::mutex> lock(s_blocksLock);
+        s_blocks.push_back(pBlock);
+        s_pThreadBlock = pBlock;
+    }
+
+    pBlock->mutex.lock();
+    if (pBlock->commandBuffer != commandBuffer || pBlock->writer.offset + entrySize > VKTRACE_CMD_BLOCK_MAX_STREAM_SIZE) {
+        write_block(pBlock);
+    }
+    if (pBlock->commandCount == 0) {
+        // The calls another thread made on the command buffer before handing it over come first
+        pBlock->mutex.unlock();
+        write_blocks(commandBuffer, pBlock);
+        pBlock->mutex.lock();
+        pBlock->commandBuffer = commandBuffer;
+        pBlock->beginTime = vktrace_get_time();
+    }
+
+    pBlock->entryOffset = pBlock->writer.offset;
+    uint16_t entryHeader[2] = {opcode, 0};
+    vktrace_cmd_block_put(&pBlock->writer, entryHeader, sizeof(entryHeader));
+    return &pBlock->writer;
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_cmd_block_end(vktrace_cmd_block_writer* pWriter) {
+    CmdBlock* pBlock = s_pThreadBlock;
+    assert(pBlock != NULL && pWriter == &pBlock->writer);
+
+    uint32_t fieldsSize = pWriter->offset - pBlock->entryOffset - VKTRACE_CMD_BLOCK_ENTRY_HEADER_SIZE;
+    uint16_t words = (uint16_t)(fieldsSize / 4);
+    memcpy(pBlock->stream + pBlock->entryOffset + sizeof(uint16_t), &words, sizeof(words));
+    pBlock->commandCount++;
+    pBlock->endTime = vktrace_get_time();
+    pBlock->mutex.unlock();
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  Command block tracing
+//
+//     When VKTRACE_CMD_BLOCKS is set to 1, the generated hooks of the vkCmd* calls that can go in a
+//     command block (see vktrace_cmd_block.h) add the call to a block kept for the calling thread
+//     instead of creating a packet. A thread's block only ever holds calls on one command buffer.
+//
+//     The block is written out as a VKTRACE_TPI_CMD_BLOCK packet when it is full, when the thread
+//     moves on to another command buffer and when the thread creates any other packet, so packets
+//     stay in the order the calls were made in on each thread. Every thread's block is written out
+//     when a thread starts a block on a command buffer another thread has a block for, and before
+//     the packets of calls that begin, end, reset, free or submit command buffers or present.
+
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include "vktrace_cmd_block.h"
+
+extern bool g_cmdBlocksEnabled;
+
+// Start gathering vkCmd* calls into blocks if it has been enabled with VKTRACE_CMD_BLOCKS.
+void vktrace_cmd_blocks_start();
+
+// Stop gathering calls into blocks. Blocks that still hold calls are not written out, so this
+// must be called after the last packet of the trace has been created.
+void vktrace_cmd_blocks_stop();
+
+// Starts a call with opcode on commandBuffer in the calling thread's block. maxSize is the most
+// space its fields can take in the stream. Returns NULL if the call doesn't fit in a block, and it
+// has to be traced as a packet of its own. Otherwise the fields are put with the returned writer
+// and vktrace_cmd_block_end() must be called, the block is locked until then.
+vktrace_cmd_block_writer* vktrace_cmd_block_begin(VkCommandBuffer commandBuffer, uint16_t opcode, size_t maxSize);
+void vktrace_cmd_block_end(vktrace_cmd_block_writer* pWriter);
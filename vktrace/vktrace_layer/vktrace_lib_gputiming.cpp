@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "vktrace_lib_helpers.h"
+#include "vktrace_common.h"
+#include "vktrace_tracelog.h"
+#include "vktrace_trace_packet_utils.h"
+#include "vktrace_gpu_timing.h"
+#include "vktrace_lib_trim.h"
+#include "vktrace_lib_gputiming.h"
+
+bool g_gpuTimingEnabled = false;
+
+typedef struct GpuTimingCommandBuffer {
+    VkCommandBuffer commandBuffer;
+    VkDevice device;
+    VkCommandPool commandPool;
+    double timestampPeriod;
+    uint64_t timestampMask;
+    VkQueryPool queryPool;  // VK_NULL_HANDLE until the first timed recording
+    bool timed;             // the last recording writes timestamps
+    uint64_t beginPacketIndex;
+    uint64_t submitPacketIndex;
+    uint32_t submitFrame;
+    bool pending;  // submitted and not read yet
+} GpuTimingCommandBuffer;
+
+typedef struct GpuTimingDevice {
+    double timestampPeriod;
+    std::vector<uint32_t> timestampValidBits;  // by queue family
+} GpuTimingDevice;
+
+// Calls on command buffers may come from any thread, so everything is under one lock
+static std::mutex s_lock;
+static std::unordered_map<VkDevice, GpuTimingDevice> s_devices;
+static std::unordered_map<VkCommandPool, std::pair<VkDevice, uint32_t>> s_commandPools;
+static std::unordered_map<VkCommandBuffer, GpuTimingCommandBuffer*> s_commandBuffers;
+static std::vector<GpuTimingCommandBuffer*> s_pending;
+static uint32_t s_frame = 0;
+
+// ------------------------------------------------------------------------------------------------
+static GpuTimingCommandBuffer* find(VkCommandBuffer commandBuffer) {
+    auto found = s_commandBuffers.find(commandBuffer);
+    return found != s_commandBuffers.end() ? found->second : NULL;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Returns false if wait is false and the execution hasn't finished yet
+static bool read_results(GpuTimingCommandBuffer* pCommandBuffer, bool wait) {
+    uint64_t results[2];
+    VkQueryResultFlags flags = VK_QUERY_RESULT_64_BIT | (wait ? VK_QUERY_RESULT_WAIT_BIT : 0);
+    VkResult result = mdd(pCommandBuffer->device)
+                          ->devTable.GetQueryPoolResults(pCommandBuffer->device, pCommandBuffer->queryPool, 0, 2, sizeof(results),
+                                                         results, sizeof(uint64_t), flags);
+    if (result == VK_NOT_READY) return false;
+
+    pCommandBuffer->pending = false;
+    if (result != VK_SUCCESS) {
+        vktrace_LogWarning("Failed to read the GPU timestamps of a command buffer.");
+        return true;
+    }
+
+    uint64_t ticks = (results[1] - results[0]) & pCommandBuffer->timestampMask;
+    vktrace_trace_packet_header* pHeader =
+        vktrace_create_trace_packet(VKTRACE_TID_VULKAN, VKTRACE_TPI_GPU_TIMING, sizeof(vktrace_gpu_timing), 0);
+    vktrace_gpu_timing* pPacket = (vktrace_gpu_timing*)pHeader->pBody;
+    pPacket->header = pHeader;
+    pPacket->commandBuffer = pCommandBuffer->commandBuffer;
+    pPacket->beginPacketIndex = pCommandBuffer->beginPacketIndex;
+    pPacket->submitPacketIndex = pCommandBuffer->submitPacketIndex;
+    pPacket->gpuTime = (uint64_t)(ticks * pCommandBuffer->timestampPeriod + 0.5);
+    pPacket->frame = pCommandBuffer->submitFrame;
+    vktrace_finalize_trace_packet(pHeader);
+    vktrace_submit_trace_packet(&pHeader, vktrace_trace_get_trace_file());
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+static void release(VkCommandBuffer commandBuffer) {
+    auto found = s_commandBuffers.find(commandBuffer);
+    if (found == s_commandBuffers.end()) return;
+    GpuTimingCommandBuffer* pCommandBuffer = found->second;
+    // The application has waited for the command buffer before freeing it
+    if (pCommandBuffer->pending) {
+        read_results(pCommandBuffer, true);
+    }
+    if (pCommandBuffer->queryPool != VK_NULL_HANDLE) {
+        mdd(pCommandBuffer->device)->devTable.DestroyQueryPool(pCommandBuffer->device, pCommandBuffer->queryPool, NULL);
+    }
+    s_pending.erase(std::remove(s_pending.begin(), s_pending.end(), pCommandBuffer), s_pending.end());
+    s_commandBuffers.erase(found);
+    delete pCommandBuffer;
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_gpu_timing_start() {
+    const char* env_gpu_timing = vktrace_get_global_var(VKTRACE_GPU_TIMING_ENV);
+    if (env_gpu_timing == NULL || strcmp(env_gpu_timing, "1") != 0) return;
+
+    if (g_trimEnabled) {
+        vktrace_LogWarning("Command buffers aren't timed on the GPU in trimmed traces.");
+        return;
+    }
+    g_gpuTimingEnabled = true;
+    vktrace_LogVerbose("Timing command buffers on the GPU.");
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_gpu_timing_add_device(VkPhysicalDevice physicalDevice, VkDevice device) {
+    VkPhysicalDeviceProperties properties;
+    mid(physicalDevice)->instTable.GetPhysicalDeviceProperties(physicalDevice, &properties);
+    uint32_t count = 0;
+    mid(physicalDevice)->instTable.GetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, NULL);
+    std::vector<VkQueueFamilyProperties> families(count);
+    mid(physicalDevice)->instTable.GetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, families.data());
+
+    std::lock_guard<std::mutex> lock(s_lock);
+    GpuTimingDevice& info = s_devices[device];
+    info.timestampPeriod = properties.limits.timestampPeriod;
+    info.timestampValidBits.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        info.timestampValidBits.push_back(families[i].timestampValidBits);
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_gpu_timing_add_command_pool(VkDevice device, VkCommandPool commandPool, uint32_t queueFamilyIndex) {
+    std::lock_guard<std::mutex> lock(s_lock);
+    s_commandPools[commandPool] = std::make_pair(device, queueFamilyIndex);
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_gpu_timing_add_command_buffers(VkDevice device, const VkCommandBufferAllocateInfo* pAllocateInfo,
+                                            const VkCommandBuffer* pCommandBuffers) {
+    // Secondary command buffers can't reset queries inside the render pass they continue
+    if (pAllocateInfo->level != VK_COMMAND_BUFFER_LEVEL_PRIMARY) return;
+
+    std::lock_guard<std::mutex> lock(s_lock);
+    auto pool = s_commandPools.find(pAllocateInfo->commandPool);
+    if (pool == s_commandPools.end()) return;
+    auto info = s_devices.find(device);
+    if (info == s_devices.end() || pool->second.second >= info->second.timestampValidBits.size()) return;
+    uint32_t validBits = info->second.timestampValidBits[pool->second.second];
+    if (validBits == 0) return;
+
+    for (uint32_t i = 0; i < pAllocateInfo->commandBufferCount; i++) {
+        release(pCommandBuffers[i]);
+        GpuTimingCommandBuffer* pCommandBuffer = new GpuTimingCommandBuffer();
+        pCommandBuffer->commandBuffer = pCommandBuffers[i];
+        pCommandBuffer->device = device;
+        pCommandBuffer->commandPool = pAllocateInfo->commandPool;
+        pCommandBuffer->timestampPeriod = info->second.timestampPeriod;
+        pCommandBuffer->timestampMask = validBits >= 64 ? UINT64_MAX : (UINT64_C(1) << validBits) - 1;
+        pCommandBuffer->queryPool = VK_NULL_HANDLE;
+        pCommandBuffer->timed = false;
+        pCommandBuffer->beginPacketIndex = 0;
+        pCommandBuffer->submitPacketIndex = 0;
+        pCommandBuffer->submitFrame = 0;
+        pCommandBuffer->pending = false;
+        s_commandBuffers[pCommandBuffers[i]] = pCommandBuffer;
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_gpu_timing_reset_command_buffer(VkCommandBuffer commandBuffer) {
+    std::lock_guard<std::mutex> lock(s_lock);
+    GpuTimingCommandBuffer* pCommandBuffer = find(commandBuffer);
+    if (pCommandBuffer == NULL) return;
+    // The application has waited for the command buffer before recording it again
+    if (pCommandBuffer->pending) {
+        read_results(pCommandBuffer, true);
+    }
+    pCommandBuffer->timed = false;
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_gpu_timing_begin_command_buffer(VkCommandBuffer commandBuffer, uint64_t packetIndex,
+                                             VkCommandBufferUsageFlags flags) {
+    std::lock_guard<std::mutex> lock(s_lock);
+    GpuTimingCommandBuffer* pCommandBuffer = find(commandBuffer);
+    if (pCommandBuffer == NULL || (flags & VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT) != 0) return;
+
+    VkLayerDispatchTable& devTable = mdd(pCommandBuffer->device)->devTable;
+    if (pCommandBuffer->queryPool == VK_NULL_HANDLE) {
+        VkQueryPoolCreateInfo createInfo = {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO, NULL, 0, VK_QUERY_TYPE_TIMESTAMP, 2, 0};
+        if (devTable.CreateQueryPool(pCommandBuffer->device, &createInfo, NULL, &pCommandBuffer->queryPool) != VK_SUCCESS) {
+            vktrace_LogWarning("Failed to create a timestamp query pool, a command buffer won't be timed.");
+            pCommandBuffer->queryPool = VK_NULL_HANDLE;
+            return;
+        }
+    }
+
+    devTable.CmdResetQueryPool(commandBuffer, pCommandBuffer->queryPool, 0, 2);
+    devTable.CmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pCommandBuffer->queryPool, 0);
+    pCommandBuffer->timed = true;
+    pCommandBuffer->beginPacketIndex = packetIndex;
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_gpu_timing_end_command_buffer(VkCommandBuffer commandBuffer) {
+    std::lock_guard<std::mutex> lock(s_lock);
+    GpuTimingCommandBuffer* pCommandBuffer = find(commandBuffer);
+    if (pCommandBuffer == NULL || !pCommandBuffer->timed) return;
+    mdd(pCommandBuffer->device)
+        ->devTable.CmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pCommandBuffer->queryPool, 1);
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_gpu_timing_begin_submit(uint32_t submitCount, const VkSubmitInfo* pSubmits) {
+    std::lock_guard<std::mutex> lock(s_lock);
+    for (uint32_t s = 0; s < submitCount; s++) {
+        for (uint32_t i = 0; i < pSubmits[s].commandBufferCount; i++) {
+            GpuTimingCommandBuffer* pCommandBuffer = find(pSubmits[s].pCommandBuffers[i]);
+            // Without simultaneous use the earlier submission has finished
+            if (pCommandBuffer != NULL && pCommandBuffer->pending) {
+                read_results(pCommandBuffer, true);
+            }
+        }
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_gpu_timing_end_submit(uint64_t packetIndex, uint32_t submitCount, const VkSubmitInfo* pSubmits) {
+    std::lock_guard<std::mutex> lock(s_lock);
+    for (uint32_t s = 0; s < submitCount; s++) {
+        for (uint32_t i = 0; i < pSubmits[s].commandBufferCount; i++) {
+            GpuTimingCommandBuffer* pCommandBuffer = find(pSubmits[s].pCommandBuffers[i]);
+            if (pCommandBuffer == NULL || !pCommandBuffer->timed) continue;
+            pCommandBuffer->submitPacketIndex = packetIndex;
+            pCommandBuffer->submitFrame = s_frame;
+            pCommandBuffer->pending = true;
+            s_pending.push_back(pCommandBuffer);
+        }
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_gpu_timing_end_frame() {
+    std::lock_guard<std::mutex> lock(s_lock);
+    s_frame++;
+    auto end = std::remove_if(s_pending.begin(), s_pending.end(), [](GpuTimingCommandBuffer* pCommandBuffer) {
+        return !pCommandBuffer->pending || read_results(pCommandBuffer, false);
+    });
+    s_pending.erase(end, s_pending.end());
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_gpu_timing_free_command_buffers(uint32_t commandBufferCount, const VkCommandBuffer* pCommandBuffers) {
+    std::lock_guard<std::mutex> lock(s_lock);
+    for (uint32_t i = 0; i < commandBufferCount; i++) {
+        release(pCommandBuffers[i]);
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_gpu_timing_destroy_command_pool(VkCommandPool commandPool) {
+    std::lock_guard<std::mutex> lock(s_lock);
+    std::vector<VkCommandBuffer> commandBuffers;
+    for (auto it = s_commandBuffers.begin(); it != s_commandBuffers.end(); ++it) {
+        if (it->second->commandPool == commandPool) commandBuffers.push_back(it->first);
+    }
+    for (VkCommandBuffer commandBuffer : commandBuffers) {
+        release(commandBuffer);
+    }
+    s_commandPools.erase(commandPool);
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_gpu_timing_destroy_device(VkDevice device) {
+    std::lock_guard<std::mutex> lock(s_lock);
+    std::vector<VkCommandBuffer> commandBuffers;
+    for (auto it = s_commandBuffers.begin(); it != s_commandBuffers.end(); ++it) {
+        if (it->second->device == device) commandBuffers.push_back(it->first);
+    }
+    for (VkCommandBuffer commandBuffer : commandBuffers) {
+        release(commandBuffer);
+    }
+    for (auto it = s_commandPools.begin(); it != s_commandPools.end();) {
+        if (it->second.first == device) {
+            it = s_commandPools.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    s_devices.erase(device);
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  GPU timing
+//
+//     When VKTRACE_GPU_TIMING is set to 1, every recording of a primary command buffer gets a
+//     timestamp query pool of its own, reset and written at the start of the recording and written
+//     again at its end. The calls go straight down the chain and aren't traced. Once a submission
+//     of the command buffer has executed, its GPU time is written as a VKTRACE_TPI_GPU_TIMING
+//     packet (see vktrace_gpu_timing.h). Results are read without waiting at each present, and
+//     otherwise before the command buffer is recorded, submitted again or freed, when the
+//     application has already waited for it. Command buffers recorded for simultaneous use aren't
+//     timed, as their executions would share the queries.
+//
+//     The functions that may write packets must be called before the packet of the call is created.
+
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+extern bool g_gpuTimingEnabled;
+
+// Start timing command buffers if it has been enabled with VKTRACE_GPU_TIMING.
+void vktrace_gpu_timing_start();
+
+void vktrace_gpu_timing_add_device(VkPhysicalDevice physicalDevice, VkDevice device);
+void vktrace_gpu_timing_add_command_pool(VkDevice device, VkCommandPool commandPool, uint32_t queueFamilyIndex);
+void vktrace_gpu_timing_add_command_buffers(VkDevice device, const VkCommandBufferAllocateInfo* pAllocateInfo,
+                                            const VkCommandBuffer* pCommandBuffers);
+
+// Before the packet of vkBeginCommandBuffer is created, and after the successful real call
+void vktrace_gpu_timing_reset_command_buffer(VkCommandBuffer commandBuffer);
+void vktrace_gpu_timing_begin_command_buffer(VkCommandBuffer commandBuffer, uint64_t packetIndex, VkCommandBufferUsageFlags flags);
+// Before the real vkEndCommandBuffer
+void vktrace_gpu_timing_end_command_buffer(VkCommandBuffer commandBuffer);
+
+// Before the packet of vkQueueSubmit is created, and after the successful real call
+void vktrace_gpu_timing_begin_submit(uint32_t submitCount, const VkSubmitInfo* pSubmits);
+void vktrace_gpu_timing_end_submit(uint64_t packetIndex, uint32_t submitCount, const VkSubmitInfo* pSubmits);
+// After the packet of vkQueuePresentKHR has been written
+void vktrace_gpu_timing_end_frame();
+
+// Before the packets of the destroy calls are created
+void vktrace_gpu_timing_free_command_buffers(uint32_t commandBufferCount, const VkCommandBuffer* pCommandBuffers);
+void vktrace_gpu_timing_destroy_command_pool(VkCommandPool commandPool);
+void vktrace_gpu_timing_destroy_device(VkDevice device);
@@ -29,7 +29,6 @@
 #include "vk_struct_size_helper.h"
 
 // Support for shadowing CPU mapped memory
-// TODO better handling of multiple range rather than fixed array
 typedef struct _VKAllocInfo {
     VkDeviceSize totalSize;
     VkDeviceSize rangeSize;
@@ -37,16 +36,22 @@ typedef struct _VKAllocInfo {
     BOOL didFlush;
     VkDeviceMemory handle;
     uint8_t *pData;
-    BOOL valid;
 } VKAllocInfo;
 
+// The entries are looked up by handle on every map, unmap, flush and invalidate. They stay at the same address until the
+// memory is freed, so callers can keep using an entry while they hold g_memInfoLock.
 typedef struct _VKMemInfo {
-    unsigned int numEntrys;
-    VKAllocInfo *pEntrys;
-    VKAllocInfo *pLastMapped;
-    unsigned int capacity;
+    std::unordered_map<VkDeviceMemory, VKAllocInfo> entries;
+    // Bumped whenever an entry is removed, which invalidates the hints of all threads
+    uint64_t generation;
 } VKMemInfo;
 
+// The entry the thread looked up last, as the calls on an allocation tend to come together
+typedef struct _VKMemInfoHint {
+    VKAllocInfo *pEntry;
+    uint64_t generation;
+} VKMemInfoHint;
+
 typedef struct _layer_device_data {
     VkLayerDispatchTable devTable;
     bool KHRDeviceSwapchainEnabled;
@@ -65,7 +70,11 @@ typedef struct _layer_instance_data {
 
 // defined in manually written file: vktrace_lib_trace.c
 extern VKMemInfo g_memInfo;
-extern VKTRACE_CRITICAL_SECTION g_memInfoLock;
+// Held shared to look up entries and change them, and exclusive to add or remove entries. Changing an entry under the shared
+// lock is safe because the application has to synchronize the calls that map and unmap the same memory, and flushes only ever
+// set didFlush.
+extern VKTRACE_RW_LOCK g_memInfoLock;
+extern VKTRACE_THREAD_LOCAL VKMemInfoHint g_memInfoHint;
 extern std::unordered_map<void *, layer_device_data *> g_deviceDataMap;
 extern std::unordered_map<void *, layer_instance_data *> g_instanceDataMap;
 
@@ -75,120 +84,46 @@ inline dispatch_key get_dispatch_key(const void *object) { return (dispatch_key)
 layer_instance_data *mid(void *object);
 layer_device_data *mdd(void *object);
 
-static void init_mem_info_entrys(VKAllocInfo *ptr, const unsigned int num) {
-    unsigned int i;
-    for (i = 0; i < num; i++) {
-        VKAllocInfo *entry = ptr + i;
-        entry->pData = NULL;
-        entry->totalSize = 0;
-        entry->rangeSize = 0;
-        entry->rangeOffset = 0;
-        entry->didFlush = FALSE;
-        memset(&entry->handle, 0, sizeof(VkDeviceMemory));
-        entry->valid = FALSE;
-    }
-}
-
-// caller must hold the g_memInfoLock
-static void init_mem_info() {
-    g_memInfo.numEntrys = 0;
-    g_memInfo.capacity = 4096;
-    g_memInfo.pLastMapped = NULL;
-
-    g_memInfo.pEntrys = VKTRACE_NEW_ARRAY(VKAllocInfo, g_memInfo.capacity);
-
-    if (g_memInfo.pEntrys == NULL)
-        vktrace_LogError("init_mem_info()  malloc failed.");
-    else
-        init_mem_info_entrys(g_memInfo.pEntrys, g_memInfo.capacity);
-}
-
-// caller must hold the g_memInfoLock
-static void delete_mem_info() {
-    VKTRACE_DELETE(g_memInfo.pEntrys);
-    g_memInfo.pEntrys = NULL;
-    g_memInfo.numEntrys = 0;
-    g_memInfo.capacity = 0;
-    g_memInfo.pLastMapped = NULL;
-}
-
-// caller must hold the g_memInfoLock
-static VKAllocInfo *get_mem_info_entry() {
-    unsigned int i;
-    VKAllocInfo *entry;
-    if (g_memInfo.numEntrys > g_memInfo.capacity) {
-        vktrace_LogError("get_mem_info_entry() bad internal state numEntrys %u.", g_memInfo.numEntrys);
-        return NULL;
-    }
-
-    entry = g_memInfo.pEntrys;
-    for (i = 0; i < g_memInfo.numEntrys; i++) {
-        if ((entry + i)->valid == FALSE) return entry + i;
-    }
-    if (g_memInfo.numEntrys == g_memInfo.capacity) {  // grow the array 2x
-        g_memInfo.capacity *= 2;
-        g_memInfo.pEntrys = (VKAllocInfo *)VKTRACE_REALLOC(g_memInfo.pEntrys, g_memInfo.capacity * sizeof(VKAllocInfo));
-        if (g_memInfo.pEntrys == NULL) vktrace_LogError("get_mem_info_entry() realloc failed.");
-        vktrace_LogDebug("realloc memInfo from %u to %u", g_memInfo.capacity / 2, g_memInfo.capacity);
-        // init the newly added entrys
-        init_mem_info_entrys(g_memInfo.pEntrys + g_memInfo.capacity / 2, g_memInfo.capacity / 2);
-    }
-
-    assert(g_memInfo.numEntrys < g_memInfo.capacity);
-    entry = g_memInfo.pEntrys + g_memInfo.numEntrys;
-    g_memInfo.numEntrys++;
-    assert(entry->valid == FALSE);
-    return entry;
-}
-
-// caller must hold the g_memInfoLock
+// caller must hold the g_memInfoLock, shared or exclusive
 static VKAllocInfo *find_mem_info_entry(const VkDeviceMemory handle) {
-    VKAllocInfo *entry;
-    unsigned int i;
-    entry = g_memInfo.pEntrys;
-    if (g_memInfo.pLastMapped && g_memInfo.pLastMapped->handle == handle && g_memInfo.pLastMapped->valid) {
-        return g_memInfo.pLastMapped;
-    }
-    for (i = 0; i < g_memInfo.numEntrys; i++) {
-        if ((entry + i)->valid && (handle == (entry + i)->handle)) {
-            return entry + i;
-        }
+    if (g_memInfoHint.pEntry != NULL && g_memInfoHint.generation == g_memInfo.generation &&
+        g_memInfoHint.pEntry->handle == handle) {
+        return g_memInfoHint.pEntry;
     }
+    std::unordered_map<VkDeviceMemory, VKAllocInfo>::iterator it = g_memInfo.entries.find(handle);
+    if (it == g_memInfo.entries.end()) return NULL;
 
-    return NULL;
+    g_memInfoHint.pEntry = &it->second;
+    g_memInfoHint.generation = g_memInfo.generation;
+    return &it->second;
 }
 
 static VKAllocInfo *find_mem_info_entry_lock(const VkDeviceMemory handle) {
     VKAllocInfo *res;
-    vktrace_enter_critical_section(&g_memInfoLock);
+    vktrace_enter_rw_lock_shared(&g_memInfoLock);
     res = find_mem_info_entry(handle);
-    vktrace_leave_critical_section(&g_memInfoLock);
+    vktrace_leave_rw_lock_shared(&g_memInfoLock);
     return res;
 }
 
 static void add_new_handle_to_mem_info(const VkDeviceMemory handle, VkDeviceSize size, void *pData) {
     VKAllocInfo *entry;
 
-    vktrace_enter_critical_section(&g_memInfoLock);
-    if (g_memInfo.capacity == 0) init_mem_info();
-
-    entry = get_mem_info_entry();
-    if (entry) {
-        entry->valid = TRUE;
-        entry->handle = handle;
-        entry->totalSize = size;
-        entry->rangeSize = 0;
-        entry->rangeOffset = 0;
-        entry->didFlush = FALSE;
-        entry->pData = (uint8_t *)pData;  // NOTE: VKFreeMemory will free this mem, so no malloc()
-    }
-    vktrace_leave_critical_section(&g_memInfoLock);
+    vktrace_enter_rw_lock_exclusive(&g_memInfoLock);
+    entry = &g_memInfo.entries[handle];
+    entry->handle = handle;
+    entry->totalSize = size;
+    entry->rangeSize = 0;
+    entry->rangeOffset = 0;
+    entry->didFlush = FALSE;
+    entry->pData = (uint8_t *)pData;  // NOTE: VKFreeMemory will free this mem, so no malloc()
+    vktrace_leave_rw_lock_exclusive(&g_memInfoLock);
 }
 
 static void add_data_to_mem_info(const VkDeviceMemory handle, VkDeviceSize rangeSize, VkDeviceSize rangeOffset, void *pData) {
     VKAllocInfo *entry;
 
-    vktrace_enter_critical_section(&g_memInfoLock);
+    vktrace_enter_rw_lock_shared(&g_memInfoLock);
     entry = find_mem_info_entry(handle);
     if (entry) {
         entry->pData = (uint8_t *)pData;
@@ -199,33 +134,13 @@ static void add_data_to_mem_info(const VkDeviceMemory handle, VkDeviceSize range
         entry->rangeOffset = rangeOffset;
         assert(entry->totalSize >= entry->rangeSize + rangeOffset);
     }
-    g_memInfo.pLastMapped = entry;
-    vktrace_leave_critical_section(&g_memInfoLock);
+    vktrace_leave_rw_lock_shared(&g_memInfoLock);
 }
 
 static void rm_handle_from_mem_info(const VkDeviceMemory handle) {
-    VKAllocInfo *entry;
-
-    vktrace_enter_critical_section(&g_memInfoLock);
-    entry = find_mem_info_entry(handle);
-    if (entry) {
-        entry->valid = FALSE;
-        entry->pData = NULL;
-        entry->totalSize = 0;
-        entry->rangeSize = 0;
-        entry->rangeOffset = 0;
-        entry->didFlush = FALSE;
-        memset(&entry->handle, 0, sizeof(VkDeviceMemory));
-
-        if (entry == g_memInfo.pLastMapped) g_memInfo.pLastMapped = NULL;
-        // adjust numEntrys to be last valid entry in list
-        do {
-            entry = g_memInfo.pEntrys + g_memInfo.numEntrys - 1;
-            if (entry->valid == FALSE) g_memInfo.numEntrys--;
-        } while ((entry->valid == FALSE) && (g_memInfo.numEntrys > 0));
-        if (g_memInfo.numEntrys == 0) delete_mem_info();
-    }
-    vktrace_leave_critical_section(&g_memInfoLock);
+    vktrace_enter_rw_lock_exclusive(&g_memInfoLock);
+    if (g_memInfo.entries.erase(handle) != 0) g_memInfo.generation++;
+    vktrace_leave_rw_lock_exclusive(&g_memInfoLock);
 }
 
 static void add_alloc_memory_to_trace_packet(vktrace_trace_packet_header *pHeader, void **ppOut, const void *pIn) {
@@ -14,6 +14,7 @@
 * limitations under the License.
 */
 
+#include <mutex>
 #include "vktrace_common.h"
 #include "vktrace_pageguard_memorycopy.h"
 #include "vktrace_lib_pagestatusarray.h"
@@ -22,6 +23,15 @@
 #include "vktrace_lib_pageguard.h"
 #include "vktrace_lib_trim.h"
 
+#if defined(PLATFORM_LINUX) && !defined(ANDROID)
+#include <linux/userfaultfd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#if defined(UFFDIO_WRITEPROTECT) && defined(__NR_userfaultfd)
+#define PAGEGUARD_USERFAULTFD_SUPPORTED
+#endif
+#endif
+
 #if !defined(ANDROID)
 static const bool PAGEGUARD_PAGEGUARD_ENABLE_DEFAULT = true;
 #else
@@ -73,6 +83,9 @@ uint32_t OPTHandlerRefAmount = 0;  // for persistent map and multi-threading env
 // configured without /proc/self/pagemap support.
 static bool verifyPlatformPageGuardSupport(void) {
 #if defined(PLATFORM_LINUX)
+    // userfaultfd doesn't need the pagemap
+    if (getPageGuardTrackingMethod() == PAGEGUARD_TRACKING_USERFAULTFD) return true;
+
     int pmFd = -1, crFd = -1;
     void* p = nullptr;
     size_t pageSize = pageguardGetSystemPageSize();
@@ -173,6 +186,26 @@ bool getEnableReadProcessFlag(const char* name) {
 bool getEnableReadPMBFlag() { return getEnableReadProcessFlag(VKTRACE_PAGEGUARD_ENABLE_READ_PMB_ENV); }
 bool getEnableReadPMBPostProcessFlag() { return getEnableReadProcessFlag(VKTRACE_PAGEGUARD_ENABLE_READ_POST_PROCESS_ENV); }
 
+bool getEnablePageDiffFlag() {
+    static bool EnablePageDiff;
+    static bool FirstTimeRun = true;
+    if (FirstTimeRun) {
+        EnablePageDiff = (vktrace_get_global_var(VKTRACE_PAGEGUARD_ENABLE_PAGE_DIFF_ENV) != NULL);
+        FirstTimeRun = false;
+    }
+    return EnablePageDiff;
+}
+
+bool getEnableAdaptiveFlushFlag() {
+    static bool EnableAdaptiveFlush;
+    static bool FirstTimeRun = true;
+    if (FirstTimeRun) {
+        EnableAdaptiveFlush = (vktrace_get_global_var(VKTRACE_PAGEGUARD_ENABLE_ADAPTIVE_FLUSH_ENV) != NULL);
+        FirstTimeRun = false;
+    }
+    return EnableAdaptiveFlush;
+}
+
 #if defined(WIN32)
 void setPageGuardExceptionHandler() {
     vktrace_sem_wait(ref_amount_sem_id);
@@ -211,9 +244,64 @@ size_t pageguardGetAdjustedSize(size_t size) {
 #if defined(PLATFORM_LINUX)
 // Keep a map of memory allocations and sizes.
 // We need the size when we want to free the memory on Linux.
+// Changed data packages are allocated on the memcpy worker threads too, so the map has its own lock.
 static std::unordered_map<void*, size_t> allocateMemoryMap;
+static std::mutex allocateMemoryMapLock;
+
+// Size of the transparent huge pages shadow copies are backed by, 0 if VKTRACE_PMB_HUGE_PAGES isn't set to 1 or the
+// kernel doesn't have them.
+static size_t pageguardGetHugePageSize() {
+    static size_t HugePageSize = 0;
+    static bool FirstTimeRun = true;
+    if (FirstTimeRun) {
+        FirstTimeRun = false;
+        const char* env_huge_pages = vktrace_get_global_var(VKTRACE_PMB_HUGE_PAGES_ENV);
+        if ((env_huge_pages != NULL) && (strcmp(env_huge_pages, "1") == 0)) {
+            FILE* pFile = fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r");
+            if (pFile != NULL) {
+                unsigned long long size;
+                if (fscanf(pFile, "%llu", &size) == 1) {
+                    HugePageSize = (size_t)size;
+                }
+                fclose(pFile);
+            }
+            if (HugePageSize == 0) {
+                vktrace_LogWarning("Transparent huge pages are not available, mapped memory copies use normal pages.");
+            }
+        }
+    }
+    return HugePageSize;
+}
 #endif
 
+VkDeviceSize pageguardGetTrackingBlockSize() {
+    static VkDeviceSize TrackingBlockSize = pageguardGetSystemPageSize();
+    static bool FirstTimeRun = true;
+    if (FirstTimeRun) {
+        FirstTimeRun = false;
+        const char* env_block_size = vktrace_get_global_var(VKTRACE_PMB_BLOCK_SIZE_ENV);
+        if (env_block_size != NULL) {
+            VkDeviceSize blockSize;
+#if defined(PLATFORM_LINUX)
+            // Only userfaultfd tracking doesn't look at each page on its own
+            bool blocksSupported = (getPageGuardTrackingMethod() == PAGEGUARD_TRACKING_USERFAULTFD);
+#else
+            bool blocksSupported = false;
+#endif
+            if (!blocksSupported) {
+                vktrace_LogWarning("%s needs userfaultfd tracking, pmb is tracked in pages.", VKTRACE_PMB_BLOCK_SIZE_ENV);
+            } else if ((sscanf(env_block_size, "%" PRIu64, &blockSize) != 1) || (blockSize < TrackingBlockSize) ||
+                       ((blockSize & (blockSize - 1)) != 0)) {
+                vktrace_LogWarning("%s must be a power of two of at least the page size, pmb is tracked in pages.",
+                                   VKTRACE_PMB_BLOCK_SIZE_ENV);
+            } else {
+                TrackingBlockSize = blockSize;
+            }
+        }
+    }
+    return TrackingBlockSize;
+}
+
 // Page guard only works for virtual memory. Real device memory
 // sometimes doesn't have a page concept, so we can't use page guard
 // to track it (or check dirty bits in /proc/<pid>/pagemap).
@@ -227,24 +315,216 @@ void* pageguardAllocateMemory(size_t size) {
                                       PAGE_READWRITE);
 #else
         pMemory = mmap(NULL, pageguardGetAdjustedSize(size), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-        if (pMemory != nullptr) allocateMemoryMap[pMemory] = pageguardGetAdjustedSize(size);
+        if (pMemory != nullptr) {
+            std::lock_guard<std::mutex> lock(allocateMemoryMapLock);
+            allocateMemoryMap[pMemory] = pageguardGetAdjustedSize(size);
+        }
 #endif
     }
     if (pMemory == nullptr) vktrace_LogError("pageguardAllocateMemory(%d) memory allocation failed", size);
     return pMemory;
 }
 
+void* pageguardAllocateShadowMemory(size_t size) {
+#if defined(PLATFORM_LINUX)
+    size_t hugePageSize = pageguardGetHugePageSize();
+    size_t adjustedSize = pageguardGetAdjustedSize(size);
+    if ((hugePageSize != 0) && (adjustedSize >= hugePageSize)) {
+        // Map a huge page more and trim the mapping to start at a huge page boundary, so the kernel can back all of it
+        // with huge pages. Protecting parts of a huge page smaller than itself splits it again.
+        PBYTE pMapped = (PBYTE)mmap(NULL, adjustedSize + hugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (pMapped != MAP_FAILED) {
+            PBYTE pMemory = (PBYTE)(((uint64_t)pMapped + hugePageSize - 1) & ~((uint64_t)hugePageSize - 1));
+            if (pMemory > pMapped) {
+                munmap(pMapped, (size_t)(pMemory - pMapped));
+            }
+            size_t tailSize = (size_t)((pMapped + adjustedSize + hugePageSize) - (pMemory + adjustedSize));
+            if (tailSize > 0) {
+                munmap(pMemory + adjustedSize, tailSize);
+            }
+            madvise(pMemory, adjustedSize, MADV_HUGEPAGE);
+            std::lock_guard<std::mutex> lock(allocateMemoryMapLock);
+            allocateMemoryMap[pMemory] = adjustedSize;
+            return pMemory;
+        }
+    }
+#endif
+    return pageguardAllocateMemory(size);
+}
+
 void pageguardFreeMemory(void* pMemory) {
     if (pMemory) {
 #if defined(WIN32)
         VirtualFree(pMemory, 0, MEM_RELEASE);
 #else
-        munmap(pMemory, allocateMemoryMap[pMemory]);
-        allocateMemoryMap.erase(pMemory);
+        size_t size;
+        {
+            std::lock_guard<std::mutex> lock(allocateMemoryMapLock);
+            size = allocateMemoryMap[pMemory];
+            allocateMemoryMap.erase(pMemory);
+        }
+        munmap(pMemory, size);
 #endif
     }
 }
 
+#if defined(PLATFORM_LINUX)
+#if defined(PAGEGUARD_USERFAULTFD_SUPPORTED)
+// With userfaultfd tracking, the shadow copies of mapped memory are registered with userfaultfd_fd and write-protected.
+// The first write to a page blocks the writing thread and sends a fault message to userfaultfdHandler, which marks the
+// page changed and lets the write go ahead. getMappedDirtyPagesLinux write-protects the changed pages again before a
+// flush copies them. Faults of many pages are read and handled in one go, and pages which are only read never fault.
+static int userfaultfd_fd = -1;
+
+static bool userfaultfdWriteProtect(PBYTE pMemory, size_t size, bool bProtect) {
+    struct uffdio_writeprotect writeProtect;
+    writeProtect.range.start = (uint64_t)pMemory;
+    writeProtect.range.len = size;
+    // Removing the protection also wakes up any thread blocked writing to the range
+    writeProtect.mode = bProtect ? UFFDIO_WRITEPROTECT_MODE_WP : 0;
+    return ioctl(userfaultfd_fd, UFFDIO_WRITEPROTECT, &writeProtect) == 0;
+}
+
+static bool userfaultfdRegister(PBYTE pMemory, size_t size) {
+    struct uffdio_register reg;
+    reg.range.start = (uint64_t)pMemory;
+    reg.range.len = size;
+    reg.mode = UFFDIO_REGISTER_MODE_WP;
+    return (ioctl(userfaultfd_fd, UFFDIO_REGISTER, &reg) == 0) && ((reg.ioctls & ((uint64_t)1 << _UFFDIO_WRITEPROTECT)) != 0);
+}
+
+static void userfaultfdUnregister(PBYTE pMemory, size_t size) {
+    struct uffdio_range range;
+    range.start = (uint64_t)pMemory;
+    range.len = size;
+    ioctl(userfaultfd_fd, UFFDIO_UNREGISTER, &range);
+}
+
+static VKTRACE_THREAD_ROUTINE_RETURN_TYPE userfaultfdHandler(LPVOID pParam) {
+    size_t pageSize = pageguardGetSystemPageSize();
+    struct uffd_msg msgs[64];
+    for (;;) {
+        ssize_t readLen = read(userfaultfd_fd, msgs, sizeof(msgs));
+        if (readLen <= 0) {
+            if ((readLen < 0) && (errno == EINTR || errno == EAGAIN)) continue;
+            break;
+        }
+
+        // The page is marked and its protection removed under the lock, so a flush that write-protects it again and
+        // copies it either sees the write or makes it fault once more.
+        pageguardEnter();
+        for (size_t i = 0; i < (size_t)readLen / sizeof(msgs[0]); i++) {
+            if (msgs[i].event != UFFD_EVENT_PAGEFAULT) continue;
+            PBYTE addr = (PBYTE)(msgs[i].arg.pagefault.address & ~((uint64_t)pageSize - 1));
+            LPPageGuardMappedMemory pMappedMem = getPageGuardControlInstance().findMappedMemoryObject(addr);
+            if (pMappedMem) {
+                int64_t index = pMappedMem->getIndexOfChangedBlockByAddr(addr);
+                if (index >= 0) {
+                    pMappedMem->setMappedBlockChanged(index, true, BLOCK_FLAG_ARRAY_CHANGED);
+                    // The whole block is saved at the next flush, so writes to the rest of it don't need to fault
+                    PBYTE pBlock;
+                    VkDeviceSize blockSize;
+                    pMappedMem->getChangedRangeByIndex(index, &pBlock, &blockSize);
+                    userfaultfdWriteProtect(pBlock, pageguardGetAdjustedSize((size_t)blockSize), false);
+                    continue;
+                }
+            }
+            userfaultfdWriteProtect(addr, pageSize, false);
+        }
+        pageguardExit();
+    }
+    return 0;
+}
+
+static bool userfaultfdInitialize() {
+    int fd = (int)syscall(__NR_userfaultfd, O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct uffdio_api api;
+    api.api = UFFD_API;
+    api.features = UFFD_FEATURE_PAGEFAULT_FLAG_WP;
+    api.ioctls = 0;
+    if ((ioctl(fd, UFFDIO_API, &api) != 0) || ((api.features & UFFD_FEATURE_PAGEFAULT_FLAG_WP) == 0)) {
+        close(fd);
+        return false;
+    }
+    userfaultfd_fd = fd;
+
+    // Some kernels know the feature but can't write-protect anonymous memory, so try it on a page.
+    size_t pageSize = pageguardGetSystemPageSize();
+    PBYTE p = (PBYTE)mmap(NULL, pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    bool initialized = (p != MAP_FAILED);
+    if (initialized) {
+        p[0] = 1;
+        initialized = userfaultfdRegister(p, pageSize) && userfaultfdWriteProtect(p, pageSize, true) &&
+                      userfaultfdWriteProtect(p, pageSize, false);
+        munmap(p, pageSize);
+    }
+    if (initialized) {
+        // The handler lives as long as the process, like the memory it watches.
+        initialized = (vktrace_platform_create_thread(userfaultfdHandler, nullptr) != VKTRACE_NULL_THREAD);
+    }
+    if (!initialized) {
+        close(fd);
+        userfaultfd_fd = -1;
+    }
+    return initialized;
+}
+#endif
+
+PageGuardTrackingMethod getPageGuardTrackingMethod() {
+    static PageGuardTrackingMethod TrackingMethod = PAGEGUARD_TRACKING_SOFT_DIRTY;
+    static bool FirstTimeRun = true;
+    if (FirstTimeRun) {
+        FirstTimeRun = false;
+        const char* env_tracking = vktrace_get_global_var(VKTRACE_PMB_TRACKING_ENV);
+        if ((env_tracking == NULL) || (strcmp(env_tracking, "softdirty") != 0)) {
+#if defined(PAGEGUARD_USERFAULTFD_SUPPORTED) && !defined(PAGEGUARD_ADD_PAGEGUARD_ON_REAL_MAPPED_MEMORY)
+            // Only the shadow copies of mapped memory can be registered
+            if (userfaultfdInitialize()) {
+                TrackingMethod = PAGEGUARD_TRACKING_USERFAULTFD;
+            }
+#endif
+            if ((TrackingMethod != PAGEGUARD_TRACKING_USERFAULTFD) && (env_tracking != NULL)) {
+                vktrace_LogWarning("userfaultfd write-protection is not available, using soft-dirty bits to track pmb.");
+            }
+        }
+        vktrace_LogVerbose("Tracking pmb with %s.",
+                           (TrackingMethod == PAGEGUARD_TRACKING_USERFAULTFD) ? "userfaultfd" : "soft-dirty bits");
+    }
+    return TrackingMethod;
+}
+
+void pageguardTrackMemory(PBYTE pMemory, size_t size) {
+#if defined(PAGEGUARD_USERFAULTFD_SUPPORTED)
+    if (getPageGuardTrackingMethod() == PAGEGUARD_TRACKING_USERFAULTFD) {
+        size = pageguardGetAdjustedSize(size);
+        if (!userfaultfdRegister(pMemory, size) || !userfaultfdWriteProtect(pMemory, size, true)) {
+            VKTRACE_FATAL_ERROR("Failed to write-protect mapped memory with userfaultfd.");
+        }
+    }
+#endif
+}
+
+void pageguardUntrackMemory(PBYTE pMemory, size_t size) {
+#if defined(PAGEGUARD_USERFAULTFD_SUPPORTED)
+    if (getPageGuardTrackingMethod() == PAGEGUARD_TRACKING_USERFAULTFD) {
+        size = pageguardGetAdjustedSize(size);
+        userfaultfdWriteProtect(pMemory, size, false);
+        userfaultfdUnregister(pMemory, size);
+    }
+#endif
+}
+
+void pageguardWriteProtectPages(PBYTE pMemory, size_t size) {
+#if defined(PAGEGUARD_USERFAULTFD_SUPPORTED)
+    if (!userfaultfdWriteProtect(pMemory, size, true)) {
+        VKTRACE_FATAL_ERROR("Failed to write-protect mapped memory with userfaultfd.");
+    }
+#endif
+}
+#endif
+
 DWORD pageguardGetSystemPageSize() {
 #if defined(PLATFORM_LINUX)
     return getpagesize();
@@ -283,18 +563,34 @@ void flushTargetChangedMappedMemory(LPPageGuardMappedMemory TargetMappedMemory,
     }
 }
 
+static void prepareChangedDataPackageTask(void* pMappedMemory) {
+    reinterpret_cast<LPPageGuardMappedMemory>(pMappedMemory)->prepareChangedDataPackage();
+}
+
 void flushAllChangedMappedMemory(vkFlushMappedMemoryRangesFunc pFunc) {
     LPPageGuardMappedMemory pMappedMemoryTemp;
     uint64_t amount = getPageGuardControlInstance().getMapMemory().size();
     if (amount) {
-        int i = 0;
-        VkMappedMemoryRange* pMemoryRanges = new VkMappedMemoryRange[1];  // amount
+        // Finding and packing the changed pages of one mapped memory doesn't touch any other, so that is done for all of them
+        // on the memcpy worker threads first. The packets are then created here one after the other, and only for mapped
+        // memory which changed.
+        std::vector<void*> mappedMemories;
+        mappedMemories.reserve((size_t)amount);
         for (std::unordered_map<VkDeviceMemory, PageGuardMappedMemory>::iterator it =
                  getPageGuardControlInstance().getMapMemory().begin();
              it != getPageGuardControlInstance().getMapMemory().end(); it++) {
-            pMappedMemoryTemp = &(it->second);
-            flushTargetChangedMappedMemory(pMappedMemoryTemp, pFunc, pMemoryRanges);
-            i++;
+            mappedMemories.push_back(&(it->second));
+        }
+        vktrace_pageguard_run_tasks_multithread(prepareChangedDataPackageTask, mappedMemories.data(), (int)mappedMemories.size());
+
+        VkMappedMemoryRange* pMemoryRanges = new VkMappedMemoryRange[1];  // amount
+        for (size_t i = 0; i < mappedMemories.size(); i++) {
+            pMappedMemoryTemp = reinterpret_cast<LPPageGuardMappedMemory>(mappedMemories[i]);
+            if (pMappedMemoryTemp->isPreparedChangedDataPackageEmpty()) {
+                pMappedMemoryTemp->discardPreparedChangedDataPackage();
+            } else {
+                flushTargetChangedMappedMemory(pMappedMemoryTemp, pFunc, pMemoryRanges);
+            }
         }
         delete[] pMemoryRanges;
     }
@@ -430,7 +726,7 @@ VkResult vkFlushMappedMemoryRangesWithoutAPICall(VkDevice device, uint32_t memor
     free(ppTmpData);
 
     // now the actual memory
-    vktrace_enter_critical_section(&g_memInfoLock);
+    vktrace_enter_rw_lock_shared(&g_memInfoLock);
     for (iter = 0; iter < memoryRangeCount; iter++) {
         VkMappedMemoryRange* pRange = (VkMappedMemoryRange*)&pMemoryRanges[iter];
         VKAllocInfo* pEntry = find_mem_info_entry(pRange->memory);
@@ -469,7 +765,7 @@ VkResult vkFlushMappedMemoryRangesWithoutAPICall(VkDevice device, uint32_t memor
 #ifdef USE_PAGEGUARD_SPEEDUP
     delete[] ppPackageData;
 #endif
-    vktrace_leave_critical_section(&g_memInfoLock);
+    vktrace_leave_rw_lock_shared(&g_memInfoLock);
 
     // now finalize the ppData array since it is done being updated
     vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->ppData));
@@ -92,19 +92,42 @@
 // Page table entry dirty bit.
 // See https://www.kernel.org/doc/Documentation/vm/pagemap.txt
 #define PTE_DIRTY_BIT (1ULL << 55)
+
+// How writes to mapped memory are detected on Linux.
+typedef enum {
+    PAGEGUARD_TRACKING_SOFT_DIRTY,   // soft-dirty bits in /proc/self/pagemap are read by getMappedDirtyPagesLinux
+    PAGEGUARD_TRACKING_USERFAULTFD,  // pages are write-protected, the first write to a page faults to the userfaultfd handler
+} PageGuardTrackingMethod;
 #endif
 
 VkDeviceSize& ref_target_range_size();
 bool getPageGuardEnableFlag();
 bool getEnableReadPMBFlag();
+bool getEnablePageDiffFlag();
+bool getEnableAdaptiveFlushFlag();
+#if defined(PLATFORM_LINUX)
+PageGuardTrackingMethod getPageGuardTrackingMethod();
+
+// Start or stop reporting writes to pMemory, which must come from pageguardAllocateMemory, to the userfaultfd handler.
+// Nothing to do for soft-dirty tracking.
+void pageguardTrackMemory(PBYTE pMemory, size_t size);
+void pageguardUntrackMemory(PBYTE pMemory, size_t size);
+
+// Write-protect the pages again so the next write to them is reported, page aligned.
+void pageguardWriteProtectPages(PBYTE pMemory, size_t size);
+#endif
 #if defined(WIN32)
 void setPageGuardExceptionHandler();
 void removePageGuardExceptionHandler();
 #endif
 size_t pageguardGetAdjustedSize(size_t size);
 void* pageguardAllocateMemory(size_t size);
+// Allocates the copy of mapped memory handed to the application, backed by huge pages if VKTRACE_PMB_HUGE_PAGES is set.
+void* pageguardAllocateShadowMemory(size_t size);
 void pageguardFreeMemory(void* pMemory);
 DWORD pageguardGetSystemPageSize();
+// Size of the blocks writes to mapped memory are tracked in, VKTRACE_PMB_BLOCK_SIZE or the page size.
+VkDeviceSize pageguardGetTrackingBlockSize();
 
 void pageguardEnter();
 void pageguardExit();
@@ -27,6 +27,7 @@
 #include "vktrace_lib_pageguardmappedmemory.h"
 #include "vktrace_lib_pageguardcapture.h"
 #include "vktrace_lib_pageguard.h"
+#include "vktrace_blob_store.h"
 
 PageGuardCapture::PageGuardCapture() {
     EmptyChangedInfoArray.offset = 0;
@@ -52,7 +53,7 @@ void PageGuardCapture::vkMapMemoryPageGuardHandle(VkDevice device, VkDeviceMemor
     PageGuardMappedMemory OPTmappedmem;
     if (getPageGuardEnableFlag()) {
 #ifdef PAGEGUARD_TARGET_RANGE_SIZE_CONTROL
-        if (size >= ref_target_range_size())
+        if (size >= ref_target_range_size() || PromotedMemory.find(memory) != PromotedMemory.end())
 #endif
         {
             OPTmappedmem.vkMapMemoryPageGuardHandle(device, memory, offset, size, flags, ppData);
@@ -76,6 +77,7 @@ void PageGuardCapture::vkUnmapMemoryPageGuardHandle(VkDevice device, VkDeviceMem
     MapMemoryPtr.erase(memory);
     MapMemoryOffset.erase(memory);
     MapMemorySize.erase(memory);
+    MapMemoryFlushHashes.erase(memory);
 }
 
 void* PageGuardCapture::getMappedMemoryPointer(VkDevice device, VkDeviceMemory memory) { return MapMemoryPtr[memory]; }
@@ -101,8 +103,12 @@ bool PageGuardCapture::vkFlushMappedMemoryRangesPageGuardHandle(VkDevice device,
             if (pRange->size == VK_WHOLE_SIZE) {
                 pRange->size = lpOPTMemoryTemp->getMappedSize() - (pRange->offset - lpOPTMemoryTemp->MappedOffset);
             }
-            if (lpOPTMemoryTemp->vkFlushMappedMemoryRangePageGuardHandle(device, pRange->memory, pRange->offset, pRange->size,
-                                                                         nullptr, nullptr, nullptr)) {
+            bool bMemoryChanged;
+            if (!lpOPTMemoryTemp->takePreparedChangedDataPackage(&bMemoryChanged)) {
+                bMemoryChanged = lpOPTMemoryTemp->vkFlushMappedMemoryRangePageGuardHandle(device, pRange->memory, pRange->offset,
+                                                                                          pRange->size, nullptr, nullptr, nullptr);
+            }
+            if (bMemoryChanged) {
                 bChanged = true;
             }
         } else {
@@ -111,6 +117,13 @@ bool PageGuardCapture::vkFlushMappedMemoryRangesPageGuardHandle(VkDevice device,
             if (RealRangeSize == VK_WHOLE_SIZE) {
                 RealRangeSize = MapMemorySize[pRange->memory] - (pRange->offset - MapMemoryOffset[pRange->memory]);
             }
+            if (getEnableAdaptiveFlushFlag()) {
+                ppPackageDataforOutOfMap[i] = createChangedDataPackageByHash(
+                    device, pRange->memory, pRange->offset - getMappedMemoryOffset(device, pRange->memory), RealRangeSize);
+                if (ppPackageDataforOutOfMap[i] != nullptr) {
+                    continue;
+                }
+            }
             ppPackageDataforOutOfMap[i] = (PBYTE)pageguardAllocateMemory(RealRangeSize + 2 * sizeof(PageGuardChangedBlockInfo));
             PageGuardChangedBlockInfo* pInfoTemp = (PageGuardChangedBlockInfo*)ppPackageDataforOutOfMap[i];
             pInfoTemp[0].offset = 1;
@@ -192,8 +205,7 @@ VkDeviceSize PageGuardCapture::getALLChangedPackageSizeInMappedMemory(VkDevice d
         if (pMappedMemoryTemp) {
             pMappedMemoryTemp->getChangedDataPackage(&PackageSize);
         } else {
-            PageGuardChangedBlockInfo* pInfoTemp = (PageGuardChangedBlockInfo*)ppPackageDataforOutOfMap[i];
-            PackageSize = pInfoTemp->length + 2 * sizeof(PageGuardChangedBlockInfo);
+            getChangedDataPackageOutOfMap(ppPackageDataforOutOfMap, i, &PackageSize);
         }
         allChangedPackageSize += PackageSize;
     }
@@ -205,11 +217,120 @@ PBYTE PageGuardCapture::getChangedDataPackageOutOfMap(PBYTE* ppPackageDataforOut
     PBYTE pDataPackage = (PBYTE)ppPackageDataforOutOfMap[dwRangeIndex];
     PageGuardChangedBlockInfo* pInfo = (PageGuardChangedBlockInfo*)pDataPackage;
     if (pSize) {
-        *pSize = sizeof(PageGuardChangedBlockInfo) * 2 + pInfo->length;
+        *pSize = sizeof(PageGuardChangedBlockInfo) * (pInfo->offset + 1) + pInfo->length;
     }
     return pDataPackage;
 }
 
+// return nullptr if the range is to be saved in full
+PBYTE PageGuardCapture::createChangedDataPackageByHash(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset,
+                                                       VkDeviceSize size) {
+    VkDeviceSize mappedSize = getMappedMemorySize(device, memory);
+    std::unordered_map<VkDeviceMemory, PageGuardFlushHashes>::iterator hashes_it = MapMemoryFlushHashes.find(memory);
+    if (hashes_it == MapMemoryFlushHashes.end()) {
+        size_t chunkCount = (size_t)((mappedSize + PAGEGUARD_ADAPTIVE_CHUNK_SIZE - 1) / PAGEGUARD_ADAPTIVE_CHUNK_SIZE);
+        PageGuardFlushHashes newHashes;
+        newHashes.chunkHashes.resize(chunkCount * 2);
+        newHashes.chunkHashValid.resize(chunkCount, false);
+        newHashes.flushCount = 0;
+        newHashes.hotFlushCount = 0;
+        newHashes.fullCopyFlushCount = 0;
+        hashes_it = MapMemoryFlushHashes.insert(std::make_pair(memory, newHashes)).first;
+    }
+    PageGuardFlushHashes& hashes = hashes_it->second;
+
+    hashes.flushCount++;
+    if (getPageGuardEnableFlag() && mappedSize >= PAGEGUARD_ADAPTIVE_PROMOTE_SIZE &&
+        hashes.flushCount >= PAGEGUARD_ADAPTIVE_PROMOTE_FLUSHES) {
+        PromotedMemory.insert(memory);
+    }
+    if (hashes.fullCopyFlushCount > 0) {
+        hashes.fullCopyFlushCount--;
+        return nullptr;
+    }
+
+    // Chunks start at the mapped offset, find the ones which changed and merge neighbours into blocks
+    PBYTE pMappedData = reinterpret_cast<PBYTE>(getMappedMemoryPointer(device, memory));
+    std::vector<PageGuardChangedBlockInfo> blocks;
+    VkDeviceSize changedSize = 0;
+    uint32_t comparedChunks = 0, changedChunks = 0;
+    VkDeviceSize rangeEnd = offset + size;
+    for (VkDeviceSize chunkStart = offset - offset % PAGEGUARD_ADAPTIVE_CHUNK_SIZE; chunkStart < rangeEnd;
+         chunkStart += PAGEGUARD_ADAPTIVE_CHUNK_SIZE) {
+        size_t chunk = (size_t)(chunkStart / PAGEGUARD_ADAPTIVE_CHUNK_SIZE);
+        VkDeviceSize chunkEnd = chunkStart + PAGEGUARD_ADAPTIVE_CHUNK_SIZE;
+        if (chunkEnd > mappedSize) {
+            chunkEnd = mappedSize;
+        }
+        VkDeviceSize blockStart = chunkStart > offset ? chunkStart : offset;
+        VkDeviceSize blockEnd = chunkEnd < rangeEnd ? chunkEnd : rangeEnd;
+        bool changed = true;
+        if (blockStart == chunkStart && blockEnd == chunkEnd) {
+            uint64_t hash0, hash1;
+            vktrace_blob_hash(pMappedData + chunkStart, chunkEnd - chunkStart, &hash0, &hash1);
+            if (hashes.chunkHashValid[chunk]) {
+                changed = (hash0 != hashes.chunkHashes[chunk * 2]) || (hash1 != hashes.chunkHashes[chunk * 2 + 1]);
+                comparedChunks++;
+                if (changed) {
+                    changedChunks++;
+                }
+            }
+            hashes.chunkHashes[chunk * 2] = hash0;
+            hashes.chunkHashes[chunk * 2 + 1] = hash1;
+            hashes.chunkHashValid[chunk] = true;
+        } else {
+            // Parts of the chunk out of the range may have changed too, only a flush of all of it can be compared later
+            hashes.chunkHashValid[chunk] = false;
+        }
+        if (!changed) {
+            continue;
+        }
+        if (!blocks.empty() && blocks.back().offset + blocks.back().length == blockStart) {
+            blocks.back().length += (DWORD)(blockEnd - blockStart);
+        } else {
+            PageGuardChangedBlockInfo block;
+            block.offset = (DWORD)blockStart;
+            block.length = (DWORD)(blockEnd - blockStart);
+            block.reserve0 = 0;
+            block.reserve1 = 0;
+            blocks.push_back(block);
+        }
+        changedSize += blockEnd - blockStart;
+    }
+
+    if (comparedChunks > 0 && changedChunks * 4 > comparedChunks * 3) {
+        hashes.hotFlushCount++;
+        if (hashes.hotFlushCount >= PAGEGUARD_ADAPTIVE_HOT_FLUSHES) {
+            hashes.hotFlushCount = 0;
+            hashes.fullCopyFlushCount = PAGEGUARD_ADAPTIVE_FULL_COPY_FLUSHES;
+            hashes.chunkHashValid.assign(hashes.chunkHashValid.size(), false);
+        }
+    } else if (comparedChunks > 0) {
+        hashes.hotFlushCount = 0;
+    }
+
+    PBYTE pPackage = (PBYTE)pageguardAllocateMemory((size_t)(sizeof(PageGuardChangedBlockInfo) * (blocks.size() + 1) + changedSize));
+    PageGuardChangedBlockInfo* pInfo = (PageGuardChangedBlockInfo*)pPackage;
+    pInfo[0].offset = (DWORD)blocks.size();
+    pInfo[0].length = (DWORD)changedSize;
+    pInfo[0].reserve0 = 0;
+    pInfo[0].reserve1 = 0;
+    PBYTE pData = (PBYTE)(pInfo + blocks.size() + 1);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        pInfo[i + 1] = blocks[i];
+        vktrace_pageguard_memcpy(pData, pMappedData + blocks[i].offset, blocks[i].length);
+        pData += blocks[i].length;
+    }
+    return pPackage;
+}
+
+void PageGuardCapture::invalidateFlushHashes(VkDeviceMemory memory) {
+    std::unordered_map<VkDeviceMemory, PageGuardFlushHashes>::iterator hashes_it = MapMemoryFlushHashes.find(memory);
+    if (hashes_it != MapMemoryFlushHashes.end()) {
+        hashes_it->second.chunkHashValid.assign(hashes_it->second.chunkHashValid.size(), false);
+    }
+}
+
 void PageGuardCapture::clearChangedDataPackageOutOfMap(PBYTE* ppPackageDataforOutOfMap, DWORD dwRangeIndex) {
     pageguardFreeMemory(ppPackageDataforOutOfMap[dwRangeIndex]);
     ppPackageDataforOutOfMap[dwRangeIndex] = nullptr;
@@ -17,6 +17,8 @@
 
 #include <stdbool.h>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include "vulkan/vulkan.h"
 #include "vktrace_platform.h"
 #include "vktrace_common.h"
@@ -42,6 +44,35 @@
 
 //#define PAGEGUARD_ADD_PAGEGUARD_ON_REAL_MAPPED_MEMORY
 
+// Adaptive flushes, enabled by VKTRACE_PAGEGUARD_ENABLE_ADAPTIVE_FLUSH
+//
+//     Mapped memory that isn't page guarded, because it is smaller than the target range size or PMB tracking is off, is
+//     normally saved in full at every flush. With adaptive flushes the flushed range is hashed in chunks, and only the
+//     chunks whose hash changed since the last flush are saved, in the same changed block package page guarded memory
+//     uses. Chunks the range only partly covers are always saved.
+//
+//     Memory where most chunks change at every flush gains nothing from hashing, so after PAGEGUARD_ADAPTIVE_HOT_FLUSHES
+//     such flushes in a row it is saved in full for PAGEGUARD_ADAPTIVE_FULL_COPY_FLUSHES flushes before hashing is tried
+//     again. Memory of at least PAGEGUARD_ADAPTIVE_PROMOTE_SIZE that is flushed PAGEGUARD_ADAPTIVE_PROMOTE_FLUSHES times
+//     is page guarded the next time it is mapped, so it isn't read in full at every flush either.
+//
+//     Hashes are dropped when the memory is invalidated or unmapped. Writes of the GPU to host coherent memory that the
+//     application never invalidates aren't seen, so if it then writes back what it last flushed that write is missed.
+
+#define PAGEGUARD_ADAPTIVE_CHUNK_SIZE 4096
+#define PAGEGUARD_ADAPTIVE_HOT_FLUSHES 8
+#define PAGEGUARD_ADAPTIVE_FULL_COPY_FLUSHES 64
+#define PAGEGUARD_ADAPTIVE_PROMOTE_SIZE (1024 * 1024)
+#define PAGEGUARD_ADAPTIVE_PROMOTE_FLUSHES 16
+
+typedef struct {
+    std::vector<uint64_t> chunkHashes;  // two per chunk
+    std::vector<bool> chunkHashValid;
+    uint32_t flushCount;
+    uint32_t hotFlushCount;       // flushes in a row that changed most of the chunks they compared
+    uint32_t fullCopyFlushCount;  // flushes left to save in full
+} PageGuardFlushHashes;
+
 typedef VkResult (*vkFlushMappedMemoryRangesFunc)(VkDevice device, uint32_t memoryRangeCount,
                                                   const VkMappedMemoryRange* pMemoryRanges);
 
@@ -52,10 +83,16 @@ typedef class PageGuardCapture {
     std::unordered_map<VkDeviceMemory, PBYTE> MapMemoryPtr;
     std::unordered_map<VkDeviceMemory, VkDeviceSize> MapMemorySize;
     std::unordered_map<VkDeviceMemory, VkDeviceSize> MapMemoryOffset;
+    std::unordered_map<VkDeviceMemory, PageGuardFlushHashes> MapMemoryFlushHashes;
+    // Memory to page guard the next time it's mapped, whatever its size
+    std::unordered_set<VkDeviceMemory> PromotedMemory;
 #if defined(PLATFORM_LINUX) && !defined(ANDROID)
     int clearRefsFd;
 #endif
 
+    /// package of the changed chunks of a flushed range of memory that isn't page guarded, see Adaptive flushes
+    PBYTE createChangedDataPackageByHash(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size);
+
    public:
     PageGuardCapture();
 
@@ -94,6 +131,9 @@ typedef class PageGuardCapture {
 
     void clearChangedDataPackageOutOfMap(PBYTE* ppPackageDataforOutOfMap, DWORD dwRangeIndex);
 
+    /// forget what the memory held at its last flush, the next flush saves every chunk of it
+    void invalidateFlushHashes(VkDeviceMemory memory);
+
     bool isHostWriteFlagSetInMemoryBarriers(uint32_t memoryBarrierCount, const VkMemoryBarrier* pMemoryBarriers);
 
     bool isHostWriteFlagSetInBufferMemoryBarrier(uint32_t memoryBarrierCount, const VkBufferMemoryBarrier* pMemoryBarriers);
@@ -45,7 +45,10 @@ PageGuardMappedMemory::PageGuardMappedMemory()
       pRealMappedData(nullptr),
       pChangedDataPackage(nullptr),
       MappedSize(0),
-      PageGuardSize(pageguardGetSystemPageSize()),
+      PageGuardSize(pageguardGetTrackingBlockSize()),
+      pReferenceData(nullptr),
+      ChangedDataPackagePrepared(false),
+      PreparedDataChanged(false),
       pPageStatus(nullptr),
       BlockConflictError(false),
       PageSizeLeft(0),
@@ -166,6 +169,8 @@ uint64_t PageGuardMappedMemory::getMappedBlockSize(uint64_t index) {
     return mappedBlockSize;
 }
 
+uint64_t PageGuardMappedMemory::getMappedBlockAmount() { return PageGuardAmount; }
+
 uint64_t PageGuardMappedMemory::getMappedBlockOffset(uint64_t index) {
     uint64_t mappedBlockOffset = 0;
     if (index < PageGuardAmount) {
@@ -273,7 +278,7 @@ bool PageGuardMappedMemory::vkMapMemoryPageGuardHandle(VkDevice device, VkDevice
     MappedOffset = offset;
 #ifndef PAGEGUARD_ADD_PAGEGUARD_ON_REAL_MAPPED_MEMORY
     pRealMappedData = (PBYTE)*ppData;
-    pMappedData = (PBYTE)pageguardAllocateMemory(size);
+    pMappedData = (PBYTE)pageguardAllocateShadowMemory(size);
 #ifndef WIN32
     // the memcpy is only for other plaforms, for win32, here we only create shadow memory,
     // but we do not sync the content with real mapped memory for the shadow memory,
@@ -282,6 +287,9 @@ bool PageGuardMappedMemory::vkMapMemoryPageGuardHandle(VkDevice device, VkDevice
     // for non-win32 platforms, so far we haven't found similiar page guard handler, so need
     // to keep this memcpy.
     vktrace_pageguard_memcpy(pMappedData, pRealMappedData, size);
+#if defined(PLATFORM_LINUX)
+    pageguardTrackMemory(pMappedData, (size_t)size);
+#endif
 #endif
     *ppData = pMappedData;
 #else
@@ -300,6 +308,11 @@ bool PageGuardMappedMemory::vkMapMemoryPageGuardHandle(VkDevice device, VkDevice
     }
     pPageStatus = new PageStatusArray(PageGuardAmount);
     assert(pPageStatus);
+    if (getEnablePageDiffFlag()) {
+        // Pages are filled in by their first flush, which still saves the whole page.
+        pReferenceData = (PBYTE)pageguardAllocateShadowMemory(size);
+        ReferenceValid.assign(PageGuardAmount, false);
+    }
     if (!setAllPageGuardAndFlag(true, false)) {
         handleSuccessfully = false;
     }
@@ -327,6 +340,9 @@ void PageGuardMappedMemory::vkUnmapMemoryPageGuardHandle(VkDevice device, VkDevi
 #endif
         clearChangedDataPackage();
 #ifndef PAGEGUARD_ADD_PAGEGUARD_ON_REAL_MAPPED_MEMORY
+#if defined(PLATFORM_LINUX)
+        pageguardUntrackMemory(pMappedData, (size_t)MappedSize);
+#endif
         if (MappedData == nullptr) {
             pageguardFreeMemory(pMappedData);
         } else {
@@ -342,6 +358,13 @@ void PageGuardMappedMemory::vkUnmapMemoryPageGuardHandle(VkDevice device, VkDevi
 #endif
         delete pPageStatus;
         pPageStatus = nullptr;
+        if (pReferenceData) {
+            pageguardFreeMemory(pReferenceData);
+            pReferenceData = nullptr;
+        }
+        ReferenceValid.clear();
+        DiffRanges.clear();
+        ChangedDataPackagePrepared = false;
         delete[] pPageChecksum;
         pPageChecksum = nullptr;
         MappedMemory = (VkDeviceMemory) nullptr;
@@ -391,6 +414,10 @@ bool PageGuardMappedMemory::isRangeIncluded(VkDeviceSize RangeOffsetLimit, VkDev
 // return the amount of changed blocks.
 DWORD PageGuardMappedMemory::getChangedBlockInfo(VkDeviceSize RangeOffset, VkDeviceSize RangeSize, DWORD *pdwSaveSize,
                                                  DWORD *pInfoSize, PBYTE pData, DWORD DataOffset, int useWhich) {
+    if (pReferenceData) {
+        return getChangedRangeInfo(pdwSaveSize, pInfoSize, pData, DataOffset, useWhich);
+    }
+
     DWORD dwAmount = getChangedBlockAmount(useWhich), dwIndex = 0, offset = 0;
     DWORD infosize = sizeof(PageGuardChangedBlockInfo) * (dwAmount + 1), SaveSize = 0, CurrentBlockSize = 0;
     PBYTE pChangedData;
@@ -451,6 +478,80 @@ DWORD PageGuardMappedMemory::getChangedBlockInfo(VkDeviceSize RangeOffset, VkDev
     return dwAmount;
 }
 
+DWORD PageGuardMappedMemory::getChangedRangeInfo(DWORD *pdwSaveSize, DWORD *pInfoSize, PBYTE pData, DWORD DataOffset,
+                                                 int useWhich) {
+    DWORD SaveSize = 0;
+    if (pData == nullptr) {
+        DiffRanges.clear();
+        for (uint64_t i = 0; i < PageGuardAmount; i++) {
+            if (!isMappedBlockChanged(i, useWhich)) {
+                continue;
+            }
+            DWORD offset = (DWORD)getMappedBlockOffset(i);
+            size_t blockSize = (size_t)getMappedBlockSize(i);
+#ifdef WIN32
+            // Reset the write count before looking at the page rather than before the copy, a write into a
+            // part of the page which we have already found unchanged then still marks the page as changed
+            // again when page guard is rearmed.
+            PVOID Addresses[1];
+            ULONG Granularity;
+            ULONG_PTR Count = 1;
+            UINT rval = GetWriteWatch(WRITE_WATCH_FLAG_RESET, pMappedData + offset, (SIZE_T)pageguardGetSystemPageSize(),
+                                      Addresses, &Count, &Granularity);
+            assert(rval == 0);
+#endif
+            // A page without reference contents is saved whole. Otherwise ranges stay in chunk granularity,
+            // an info entry costs about as much as the unchanged bytes it would save.
+            PBYTE pCurrent = pMappedData + offset, pReference = pReferenceData + offset;
+            bool referenceValid = ReferenceValid[i];
+            size_t start = referenceValid ? vktrace_pageguard_find_difference(pCurrent, pReference, 0, blockSize) : 0;
+            while (start < blockSize) {
+                size_t end = referenceValid ? vktrace_pageguard_find_match(pCurrent, pReference, start, blockSize) : blockSize;
+                if (!DiffRanges.empty() && (DiffRanges.back().offset + DiffRanges.back().length == offset + start)) {
+                    // Continues a range from the previous page
+                    DiffRanges.back().length += (uint32_t)(end - start);
+                } else {
+                    DiffRanges.push_back({(uint32_t)(offset + start), (uint32_t)(end - start), 0, 0});
+                }
+                start = (end < blockSize) ? vktrace_pageguard_find_difference(pCurrent, pReference, end, blockSize) : blockSize;
+            }
+        }
+    }
+
+    DWORD dwAmount = (DWORD)DiffRanges.size();
+    DWORD infosize = sizeof(PageGuardChangedBlockInfo) * (dwAmount + 1);
+    PageGuardChangedBlockInfo *pChangedInfoArray = (PageGuardChangedBlockInfo *)(pData ? (pData + DataOffset) : nullptr);
+    for (DWORD i = 0; i < dwAmount; i++) {
+        const PageGuardChangedBlockInfo &range = DiffRanges[i];
+        if (pChangedInfoArray) {
+            pChangedInfoArray[i + 1] = range;
+            PBYTE pChangedData = pData + DataOffset + infosize + SaveSize;
+            vktrace_pageguard_memcpy(pChangedData, pMappedData + range.offset, range.length);
+            // What was saved, not what is in mapped memory now, another thread may have written to it meanwhile.
+            vktrace_pageguard_memcpy(pReferenceData + range.offset, pChangedData, range.length);
+        }
+        SaveSize += range.length;
+    }
+    if (pChangedInfoArray) {
+        pChangedInfoArray[0].offset = dwAmount;
+        pChangedInfoArray[0].length = SaveSize;
+        pChangedInfoArray[0].reserve0 = 0;
+        pChangedInfoArray[0].reserve1 = 0;
+        for (uint64_t i = 0; i < PageGuardAmount; i++) {
+            if (isMappedBlockChanged(i, useWhich)) {
+                ReferenceValid[i] = true;
+            }
+        }
+    }
+    if (pInfoSize) {
+        *pInfoSize = infosize;
+    }
+    if (pdwSaveSize) {
+        *pdwSaveSize = SaveSize;
+    }
+    return dwAmount;
+}
+
 // return: if memory already changed;
 //        evenif no change to mmeory, it will still allocate memory for info array which only include one
 //        PageGuardChangedBlockInfo,its  offset and length are all 0;
@@ -509,6 +610,29 @@ void PageGuardMappedMemory::clearChangedDataPackage() {
     }
 }
 
+void PageGuardMappedMemory::prepareChangedDataPackage() {
+    PreparedDataChanged =
+        vkFlushMappedMemoryRangePageGuardHandle(MappedDevice, MappedMemory, MappedOffset, MappedSize, nullptr, nullptr, nullptr);
+    ChangedDataPackagePrepared = true;
+}
+
+bool PageGuardMappedMemory::takePreparedChangedDataPackage(bool *pChanged) {
+    bool prepared = ChangedDataPackagePrepared;
+    if (prepared) {
+        *pChanged = PreparedDataChanged;
+        ChangedDataPackagePrepared = false;
+    }
+    return prepared;
+}
+
+bool PageGuardMappedMemory::isPreparedChangedDataPackageEmpty() { return ChangedDataPackagePrepared && !PreparedDataChanged; }
+
+void PageGuardMappedMemory::discardPreparedChangedDataPackage() {
+    clearChangedDataPackage();
+    resetMemoryObjectAllChangedFlagAndPageGuard();
+    ChangedDataPackagePrepared = false;
+}
+
 // get ptr and size of OPTChangedDataPackage;
 PBYTE PageGuardMappedMemory::getChangedDataPackage(VkDeviceSize *pSize) {
     PBYTE pResultDataPackage = nullptr;
@@ -17,6 +17,7 @@
 
 #include <stdbool.h>
 #include <unordered_map>
+#include <vector>
 #include "vulkan/vulkan.h"
 #include "vktrace_platform.h"
 #include "vktrace_common.h"
@@ -47,6 +48,13 @@ typedef class PageGuardMappedMemory {
 
     VkDeviceSize PageGuardSize;  /// size for one block
 
+    PBYTE pReferenceData;  /// if not nullptr, page diffing is enabled and it holds the contents of pMappedData as of the last flush,
+                           /// so that only the ranges which really changed in a dirty page are saved
+    std::vector<bool> ReferenceValid;                    /// if the page in pReferenceData has been filled yet
+    std::vector<PageGuardChangedBlockInfo> DiffRanges;  /// changed ranges found by the size pass of getChangedRangeInfo
+    bool ChangedDataPackagePrepared;                    /// pChangedDataPackage was built by prepareChangedDataPackage
+    bool PreparedDataChanged;                           /// what vkFlushMappedMemoryRangePageGuardHandle returned for it
+
    protected:
     PageStatusArray *pPageStatus;
     bool BlockConflictError;  /// record if any block has been read by host and also write by host
@@ -88,6 +96,8 @@ typedef class PageGuardMappedMemory {
 
     uint64_t getMappedBlockSize(uint64_t index);
 
+    uint64_t getMappedBlockAmount();
+
     uint64_t getMappedBlockOffset(uint64_t index);
 
     bool isNoMappedBlockChanged();
@@ -143,9 +153,28 @@ typedef class PageGuardMappedMemory {
 
     void clearChangedDataPackage();
 
+    /// build the changed data package for the whole mapped range ahead of the flush, this can run on any thread as long as
+    /// nothing else uses this object meanwhile. The next vkFlushMappedMemoryRangesPageGuardHandle for this memory takes it
+    /// instead of building its own.
+    void prepareChangedDataPackage();
+
+    /// return: if there is a prepared package, *pChanged is set to whether the memory changed
+    bool takePreparedChangedDataPackage(bool *pChanged);
+
+    /// return: if the prepared package holds no changed data, in which case no flush packet is needed for it
+    bool isPreparedChangedDataPackageEmpty();
+
+    /// release a prepared package that won't be flushed and rearm page guard as the flush would have done
+    void discardPreparedChangedDataPackage();
+
     /// get ptr and size of OPTChangedDataPackage;
     PBYTE getChangedDataPackage(VkDeviceSize *pSize);
 
+    /// getChangedBlockInfo for page diffing, the info array gets one entry per changed range instead of per changed page.
+    /// The ranges are found when pData==nullptr and saved in DiffRanges, the following call with pData!=nullptr copies them
+    /// and updates pReferenceData with what was copied.
+    DWORD getChangedRangeInfo(DWORD *pdwSaveSize, DWORD *pInfoSize, PBYTE pData, DWORD DataOffset, int useWhich);
+
     uint64_t getPageChecksum(uint64_t index);
 
     void setPageChecksum(uint64_t index, uint64_t sum);
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "vktrace_lib_helpers.h"
+#include "vktrace_common.h"
+#include "vktrace_tracelog.h"
+#include "vktrace_trace_packet_utils.h"
+#include "vktrace_blob_store.h"
+#include "vktrace_query_digest.h"
+#include "vktrace_vk_vk_packets.h"
+#include "vktrace_lib_trim.h"
+#include "vktrace_lib_querydigest.h"
+
+static bool s_queryDigestsEnabled = false;
+
+#define DEVICE_QUERY(_call, _object)                                                 \
+    case VKTRACE_TPI_VK_##_call: {                                                   \
+        const packet_##_call* pPacket = (const packet_##_call*)pHeader->pBody;       \
+        pDigest->dispatchable = (uint64_t)(uintptr_t)pPacket->device;                \
+        pDigest->object = (uint64_t)pPacket->_object;                                \
+        return true;                                                                 \
+    }
+
+#define PHYSICAL_DEVICE_QUERY(_call)                                                 \
+    case VKTRACE_TPI_VK_##_call: {                                                   \
+        const packet_##_call* pPacket = (const packet_##_call*)pHeader->pBody;       \
+        pDigest->dispatchable = (uint64_t)(uintptr_t)pPacket->physicalDevice;        \
+        pDigest->object = 0;                                                         \
+        return true;                                                                 \
+    }
+
+// ------------------------------------------------------------------------------------------------
+// Fills in the handles of pDigest if the packet is one of the queries that are digested
+static bool get_query_handles(const vktrace_trace_packet_header* pHeader, vktrace_query_digest* pDigest) {
+    switch (pHeader->packet_id) {
+        DEVICE_QUERY(vkGetBufferMemoryRequirements, buffer)
+        DEVICE_QUERY(vkGetImageMemoryRequirements, image)
+        DEVICE_QUERY(vkGetImageSparseMemoryRequirements, image)
+        DEVICE_QUERY(vkGetImageSubresourceLayout, image)
+        DEVICE_QUERY(vkGetRenderAreaGranularity, renderPass)
+        DEVICE_QUERY(vkGetDeviceMemoryCommitment, memory)
+        PHYSICAL_DEVICE_QUERY(vkGetPhysicalDeviceFeatures)
+        PHYSICAL_DEVICE_QUERY(vkGetPhysicalDeviceFormatProperties)
+        PHYSICAL_DEVICE_QUERY(vkGetPhysicalDeviceImageFormatProperties)
+        PHYSICAL_DEVICE_QUERY(vkGetPhysicalDeviceFeatures2KHR)
+        PHYSICAL_DEVICE_QUERY(vkGetPhysicalDeviceFormatProperties2KHR)
+        PHYSICAL_DEVICE_QUERY(vkGetPhysicalDeviceImageFormatProperties2KHR)
+        PHYSICAL_DEVICE_QUERY(vkEnumerateDeviceLayerProperties)
+        PHYSICAL_DEVICE_QUERY(vkEnumerateDeviceExtensionProperties)
+        default:
+            return false;
+    }
+}
+
+#undef DEVICE_QUERY
+#undef PHYSICAL_DEVICE_QUERY
+
+// ------------------------------------------------------------------------------------------------
+static void on_packet_submit(vktrace_trace_packet_header* pHeader) {
+    vktrace_query_digest digest = {};
+    if (!get_query_handles(pHeader, &digest)) return;
+
+    // The body's pointer to the header holds an address, the rest is the parameters and the results
+    const size_t skip = sizeof(vktrace_trace_packet_header) + sizeof(vktrace_trace_packet_header*);
+    if (pHeader->size < sizeof(vktrace_trace_packet_header) + sizeof(vktrace_query_digest) || pHeader->size < skip) return;
+    uint64_t hash1;
+    vktrace_blob_hash((const uint8_t*)pHeader + skip, pHeader->size - skip, &digest.digest, &hash1);
+    digest.callId = pHeader->packet_id;
+
+    digest.header = pHeader;
+    memcpy((void*)pHeader->pBody, &digest, sizeof(digest));
+    pHeader->packet_id = VKTRACE_TPI_QUERY_DIGEST;
+    pHeader->size = sizeof(vktrace_trace_packet_header) + sizeof(vktrace_query_digest);
+    pHeader->next_buffers_offset = pHeader->size;
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_query_digests_start() {
+    const char* env_query_digests = vktrace_get_global_var(VKTRACE_QUERY_DIGESTS_ENV);
+    if (env_query_digests == NULL || strcmp(env_query_digests, "1") != 0) return;
+
+    if (g_trimEnabled) {
+        vktrace_LogWarning("Queries aren't digested in trimmed traces.");
+        return;
+    }
+    vktrace_set_packet_submit_callback(on_packet_submit);
+    s_queryDigestsEnabled = true;
+    vktrace_LogVerbose("Digesting the results of query calls.");
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_query_digests_stop() {
+    if (!s_queryDigestsEnabled) return;
+
+    s_queryDigestsEnabled = false;
+    vktrace_set_packet_submit_callback(NULL);
+}
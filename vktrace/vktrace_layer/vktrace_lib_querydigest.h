@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  Query digests
+//
+//     When VKTRACE_QUERY_DIGESTS is set to 1, the packets of the query calls that vkreplay doesn't
+//     need the traced results of are turned into VKTRACE_TPI_QUERY_DIGEST packets (see
+//     vktrace_query_digest.h) as they are submitted. The packet is rewritten in place, so it keeps
+//     its index and times. The queries vkreplay maps devices and memory types with, like
+//     vkGetPhysicalDeviceProperties and vkGetPhysicalDeviceMemoryProperties, are traced as usual.
+
+#pragma once
+
+// Start digesting queries if it has been enabled with VKTRACE_QUERY_DIGESTS.
+void vktrace_query_digests_start();
+void vktrace_query_digests_stop();
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "vktrace_platform.h"
+#include "vktrace_common.h"
+#include "vktrace_trace_packet_utils.h"
+#include "vktrace_lib_shardwriter.h"
+#include "vktrace_lib_trim.h"
+#include "vk_timeline.h"
+
+// Buffer of each shard's FILE, so a thread only makes a write call every this many bytes
+static const size_t SHARD_WRITER_BUFFER_SIZE = 1024 * 1024;
+
+static const size_t SHARD_WRITER_MAX_PATH = 4096;
+
+static std::string s_shardDir;
+static uint32_t s_shardCount = 0;
+static bool s_shardsOpen = false;
+
+// Only taken when a thread opens its shard and when all of them are closed, never to write a packet
+static VKTRACE_CRITICAL_SECTION s_shardsLock;
+static std::vector<FILE*> s_shards;
+
+static VKTRACE_THREAD_LOCAL FILE* s_pThreadShard = NULL;
+
+static FILE* open_shard() {
+    vktrace_enter_critical_section(&s_shardsLock);
+    FILE* pShard = NULL;
+    if (s_shardsOpen) {
+        char path[SHARD_WRITER_MAX_PATH];
+        snprintf(path, sizeof(path), VKTRACE_SHARD_FILE_FORMAT, s_shardDir.c_str(), (uint32_t)vktrace_get_pid(), s_shardCount);
+        pShard = fopen(path, "wb");
+        if (pShard != NULL) {
+            setvbuf(pShard, NULL, _IOFBF, SHARD_WRITER_BUFFER_SIZE);
+            s_shards.push_back(pShard);
+            s_shardCount++;
+        } else {
+            vktrace_LogError("Failed to create trace shard %s.", path);
+        }
+    }
+    vktrace_leave_critical_section(&s_shardsLock);
+    return pShard;
+}
+
+static void shard_writer_queue_packet(vktrace_trace_packet_header* pHeader, FileLike* pFile) {
+    FILE* pShard = s_pThreadShard;
+    if (pShard == NULL) {
+        pShard = s_pThreadShard = open_shard();
+    }
+
+    uint64_t writeStart = vk_timeline_enabled() ? vk_timeline_now() : 0;
+    size_t size = (size_t)pHeader->size;
+    bool res = pShard != NULL && fwrite(pHeader, 1, size, pShard) == size;
+    if (writeStart != 0) {
+        vk_timeline_zone("vktrace", "write shard", writeStart, vk_timeline_now());
+    }
+    if (!res) {
+        // Leaving the packet out would leave a hole in the packet indices the shards are merged by
+        vktrace_LogWarning("Failed to write trace packet to its shard.");
+        exit(1);
+    }
+    vktrace_delete_trace_packet(&pHeader);
+}
+
+static const vktrace_trace_packet_writer s_shardPacketWriter = {shard_writer_queue_packet};
+
+bool vktrace_shard_writer_start() {
+    if (s_shardsOpen) return true;
+
+    const char* env_shard_dir = vktrace_get_global_var(VKTRACE_SHARD_DIR_ENV);
+    if (env_shard_dir == NULL || strlen(env_shard_dir) == 0) return false;
+    // Trim windows are cut by markers in the packet stream, which the shards' packets don't go through
+    if (g_trimEnabled) {
+        vktrace_LogWarning("Trimmed traces aren't written to shards.");
+        return false;
+    }
+    if (strlen(env_shard_dir) + 32 > SHARD_WRITER_MAX_PATH) {
+        vktrace_LogError("Trace shard directory %s is too long, not writing shards.", env_shard_dir);
+        return false;
+    }
+    s_shardDir = env_shard_dir;
+
+    // The starting thread's shard tells whether the directory takes them at all
+    vktrace_create_critical_section(&s_shardsLock);
+    s_shardsOpen = true;
+    s_pThreadShard = open_shard();
+    if (s_pThreadShard == NULL) {
+        s_shardsOpen = false;
+        vktrace_delete_critical_section(&s_shardsLock);
+        return false;
+    }
+    vktrace_set_trace_packet_writer(&s_shardPacketWriter);
+    vktrace_LogVerbose("Writing the trace packets of each thread to a shard in %s.", s_shardDir.c_str());
+    return true;
+}
+
+void vktrace_shard_writer_stop() {
+    if (!s_shardsOpen) return;
+
+    vktrace_set_trace_packet_writer(NULL);
+    vktrace_enter_critical_section(&s_shardsLock);
+    for (size_t i = 0; i < s_shards.size(); i++) {
+        fclose(s_shards[i]);
+    }
+    s_shards.clear();
+    s_shardsOpen = false;
+    vktrace_leave_critical_section(&s_shardsLock);
+    s_pThreadShard = NULL;
+    vktrace_LogVerbose("Wrote %u trace shards.", s_shardCount);
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  Sharded trace writer
+//
+//     Even the asynchronous writer funnels the packets of every application thread through one
+//     ring and one writer thread. When VKTRACE_SHARD_DIR names a directory, each application thread
+//     instead writes its packets to a shard file of its own in that directory, through a buffered
+//     FILE that no other thread touches. The only thing the threads share is the atomic
+//     global_packet_index their packets are numbered with.
+//
+//     Shards are named with VKTRACE_SHARD_FILE_FORMAT and hold packets just like they are sent to
+//     vktrace. Once the process stops tracing, vktrace merges its shards into the trace file in
+//     global_packet_index order and deletes them.
+
+#pragma once
+
+// Install the sharded packet writer if VKTRACE_SHARD_DIR names a directory shards can be created
+// in. Returns whether it was installed. Must be called before any thread other than the caller can
+// write trace packets.
+bool vktrace_shard_writer_start();
+
+// Write out and close every shard and go back to writing packets to the trace FileLike. Must be
+// called before the packet that tells vktrace the process is done, which vktrace merges the shards
+// after. Safe to call if the writer was never started.
+void vktrace_shard_writer_stop();
@@ -39,6 +39,8 @@
 #include "vktrace_interconnect.h"
 #include "vktrace_filelike.h"
 #include "vktrace_trace_packet_utils.h"
+#include "vktrace_blob_store.h"
+#include "vktrace_packet_arena.h"
 #include "vktrace_vk_exts.h"
 #include <stdio.h>
 
@@ -47,6 +49,11 @@
 #include "vktrace_lib_pageguardmappedmemory.h"
 #include "vktrace_lib_pageguardcapture.h"
 #include "vktrace_lib_pageguard.h"
+#include "vktrace_lib_asyncwriter.h"
+#include "vktrace_lib_shardwriter.h"
+#include "vktrace_lib_cmdblock.h"
+#include "vktrace_lib_gputiming.h"
+#include "vktrace_lib_querydigest.h"
 
 // Intentionally include the struct_size source file
 #include "vk_struct_size_helper.c"
@@ -58,12 +65,18 @@ VKTRACER_LEAVE _Unload(void) {
             vktrace_trace_packet_header *pHeader =
                 vktrace_create_trace_packet(VKTRACE_TID_VULKAN, VKTRACE_TPI_MARKER_TERMINATE_PROCESS, 0, 0);
             vktrace_finalize_trace_packet(pHeader);
-            vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
-            vktrace_delete_trace_packet(&pHeader);
+            // Making the packet wrote out the held back command blocks, which vktrace has to find in the shards
+            vktrace_shard_writer_stop();
+            vktrace_submit_trace_packet(&pHeader, vktrace_trace_get_trace_file());
+            vktrace_cmd_blocks_stop();
+            vktrace_query_digests_stop();
+            vktrace_async_writer_stop();
             vktrace_free(vktrace_trace_get_trace_file());
             vktrace_trace_set_trace_file(NULL);
             vktrace_deinitialize_trace_packet_utils();
             trim::deinitialize();
+            // Last, once trim has deleted the packets it kept
+            vktrace_packet_arena_deinitialize();
         }
         if (gMessageStream != NULL) {
             vktrace_MessageStream_destroy(&gMessageStream);
@@ -73,8 +86,9 @@ VKTRACER_LEAVE _Unload(void) {
 }
 
 // declared as extern in vktrace_lib_helpers.h
-VKTRACE_CRITICAL_SECTION g_memInfoLock;
-VKMemInfo g_memInfo = {0, NULL, NULL, 0};
+VKTRACE_RW_LOCK g_memInfoLock;
+VKMemInfo g_memInfo;
+VKTRACE_THREAD_LOCAL VKMemInfoHint g_memInfoHint;
 
 std::unordered_map<void*, layer_device_data*> g_deviceDataMap;
 std::unordered_map<void*, layer_instance_data*> g_instanceDataMap;
@@ -221,7 +235,34 @@ void getMappedDirtyPagesLinux(void) {
     // If pageguard isn't enabled, we don't need to do anythhing
     if (!getPageGuardEnableFlag()) return;
 
-    vktrace_enter_critical_section(&g_memInfoLock);
+    vktrace_enter_rw_lock_shared(&g_memInfoLock);
+
+    if (getPageGuardTrackingMethod() == PAGEGUARD_TRACKING_USERFAULTFD) {
+        // The userfaultfd handler has already marked the pages written to. Write-protect them again before they get
+        // copied, so the next write to them marks them for the next flush.
+        for (std::unordered_map<VkDeviceMemory, PageGuardMappedMemory>::iterator it =
+                 getPageGuardControlInstance().getMapMemory().begin();
+             it != getPageGuardControlInstance().getMapMemory().end(); it++) {
+            pMappedMem = &(it->second);
+            pEntry = find_mem_info_entry(pMappedMem->getMappedMemory());
+            addr = pEntry->pData;
+            if (!addr) continue;
+            uint64_t nBlocks = pMappedMem->getMappedBlockAmount();
+            for (uint64_t i = 0; i < nBlocks;) {
+                if (!pMappedMem->isMappedBlockChanged(i, BLOCK_FLAG_ARRAY_CHANGED)) {
+                    i++;
+                    continue;
+                }
+                uint64_t firstBlock = i;
+                while ((i < nBlocks) && pMappedMem->isMappedBlockChanged(i, BLOCK_FLAG_ARRAY_CHANGED)) i++;
+                uint64_t runOffset = pMappedMem->getMappedBlockOffset(firstBlock);
+                uint64_t runSize = pMappedMem->getMappedBlockOffset(i - 1) + pMappedMem->getMappedBlockSize(i - 1) - runOffset;
+                pageguardWriteProtectPages(addr + runOffset, pageguardGetAdjustedSize((size_t)runSize));
+            }
+        }
+        vktrace_leave_rw_lock_shared(&g_memInfoLock);
+        return;
+    }
 
     // Open pagefile, open the pipe, and set a SIGSEGV handler
     if (pmFd == -1) {
@@ -341,7 +382,7 @@ void getMappedDirtyPagesLinux(void) {
             }
         }
     }
-    vktrace_leave_critical_section(&g_memInfoLock);
+    vktrace_leave_rw_lock_shared(&g_memInfoLock);
 }
 #endif
 
@@ -404,7 +445,7 @@ VKTRACER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL __HOOKED_vkMapMemory(VkDevice dev
     CREATE_TRACE_PACKET(vkMapMemory, sizeof(void*));
     result = mdd(device)->devTable.MapMemory(device, memory, offset, size, flags, ppData);
     vktrace_set_packet_entrypoint_end_time(pHeader);
-    entry = find_mem_info_entry(memory);
+    entry = find_mem_info_entry_lock(memory);
 
     // For vktrace usage, clamp the memory size to the total size less offset if VK_WHOLE_SIZE is specified.
     if (size == VK_WHOLE_SIZE) {
@@ -468,7 +509,7 @@ VKTRACER_EXPORT VKAPI_ATTR void VKAPI_CALL __HOOKED_vkUnmapMemory(VkDevice devic
 
     // insert into packet the data that was written by CPU between the vkMapMemory call and here
     // Note must do this prior to the real vkUnMap() or else may get a FAULT
-    vktrace_enter_critical_section(&g_memInfoLock);
+    vktrace_enter_rw_lock_shared(&g_memInfoLock);
     entry = find_mem_info_entry(memory);
     if (entry && entry->pData != NULL) {
         if (!entry->didFlush) {
@@ -483,11 +524,11 @@ VKTRACER_EXPORT VKAPI_ATTR void VKAPI_CALL __HOOKED_vkUnmapMemory(VkDevice devic
     pPacket = interpret_body_as_vkUnmapMemory(pHeader);
     if (siz) {
         assert(entry->handle == memory);
-        vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pData), siz, entry->pData);
+        vktrace_add_blob_to_trace_packet(pHeader, (void**)&(pPacket->pData), siz, entry->pData);
         vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pData));
     }
     entry->pData = NULL;
-    vktrace_leave_critical_section(&g_memInfoLock);
+    vktrace_leave_rw_lock_shared(&g_memInfoLock);
     pHeader->entrypoint_begin_time = vktrace_get_time();
     mdd(device)->devTable.UnmapMemory(device, memory);
     vktrace_set_packet_entrypoint_end_time(pHeader);
@@ -602,7 +643,7 @@ VKTRACER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL __HOOKED_vkInvalidateMappedMemory
     free(ppTmpData);
 
     // now the actual memory
-    vktrace_enter_critical_section(&g_memInfoLock);
+    vktrace_enter_rw_lock_shared(&g_memInfoLock);
     for (iter = 0; iter < memoryRangeCount; iter++) {
         VkMappedMemoryRange* pRange = (VkMappedMemoryRange*)&pMemoryRanges[iter];
         VKAllocInfo* pEntry = find_mem_info_entry(pRange->memory);
@@ -613,16 +654,20 @@ VKTRACER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL __HOOKED_vkInvalidateMappedMemory
             assert(pEntry->totalSize >= pRange->size);
             assert(pRange->offset >= pEntry->rangeOffset &&
                    (pRange->offset + pRange->size) <= (pEntry->rangeOffset + pEntry->rangeSize));
-            vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->ppData[iter]), pRange->size,
-                                               pEntry->pData + pRange->offset);
+            vktrace_add_blob_to_trace_packet(pHeader, (void**)&(pPacket->ppData[iter]), pRange->size,
+                                             pEntry->pData + pRange->offset);
             vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->ppData[iter]));
             pEntry->didFlush = TRUE;  // Do we need didInvalidate?
+#ifdef USE_PAGEGUARD_SPEEDUP
+            // What the GPU wrote may now be read and written back, so it can't be compared with the last flush
+            getPageGuardControlInstance().invalidateFlushHashes(pRange->memory);
+#endif
         } else {
             vktrace_LogError("Failed to copy app memory into trace packet (idx = %u) on vkInvalidateMappedMemoryRanges",
                              pHeader->global_packet_index);
         }
     }
-    vktrace_leave_critical_section(&g_memInfoLock);
+    vktrace_leave_rw_lock_shared(&g_memInfoLock);
 
     // now finalize the ppData array since it is done being updated
     vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->ppData));
@@ -695,7 +740,7 @@ VKTRACER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL __HOOKED_vkFlushMappedMemoryRange
     free(ppTmpData);
 
     // now the actual memory
-    vktrace_enter_critical_section(&g_memInfoLock);
+    vktrace_enter_rw_lock_shared(&g_memInfoLock);
     for (iter = 0; iter < memoryRangeCount; iter++) {
         VkMappedMemoryRange* pRange = (VkMappedMemoryRange*)&pMemoryRanges[iter];
         VKAllocInfo* pEntry = find_mem_info_entry(pRange->memory);
@@ -722,20 +767,20 @@ VKTRACER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL __HOOKED_vkFlushMappedMemoryRange
             VkDeviceSize OPTPackageSizeTemp = 0;
             if (pOPTMemoryTemp) {
                 PBYTE pOPTDataTemp = pOPTMemoryTemp->getChangedDataPackage(&OPTPackageSizeTemp);
-                vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->ppData[iter]), ROUNDUP_TO_4(OPTPackageSizeTemp),
-                                                   pOPTDataTemp);
+                vktrace_add_blob_to_trace_packet(pHeader, (void**)&(pPacket->ppData[iter]), ROUNDUP_TO_4(OPTPackageSizeTemp),
+                                                 pOPTDataTemp);
                 pOPTMemoryTemp->clearChangedDataPackage();
                 pOPTMemoryTemp->resetMemoryObjectAllChangedFlagAndPageGuard();
             } else {
                 PBYTE pOPTDataTemp =
                     getPageGuardControlInstance().getChangedDataPackageOutOfMap(ppPackageData, iter, &OPTPackageSizeTemp);
-                vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->ppData[iter]), ROUNDUP_TO_4(OPTPackageSizeTemp),
-                                                   pOPTDataTemp);
+                vktrace_add_blob_to_trace_packet(pHeader, (void**)&(pPacket->ppData[iter]), ROUNDUP_TO_4(OPTPackageSizeTemp),
+                                                 pOPTDataTemp);
                 getPageGuardControlInstance().clearChangedDataPackageOutOfMap(ppPackageData, iter);
             }
 #else
-            vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->ppData[iter]), ROUNDUP_TO_4(rangeSize),
-                                               pEntry->pData + pRange->offset);
+            vktrace_add_blob_to_trace_packet(pHeader, (void**)&(pPacket->ppData[iter]), ROUNDUP_TO_4(rangeSize),
+                                             pEntry->pData + pRange->offset);
 #endif
             vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->ppData[iter]));
             pEntry->didFlush = TRUE;
@@ -747,7 +792,7 @@ VKTRACER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL __HOOKED_vkFlushMappedMemoryRange
 #ifdef USE_PAGEGUARD_SPEEDUP
     delete[] ppPackageData;
 #endif
-    vktrace_leave_critical_section(&g_memInfoLock);
+    vktrace_leave_rw_lock_shared(&g_memInfoLock);
 
     // now finalize the ppData array since it is done being updated
     vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->ppData));
@@ -786,6 +831,9 @@ VKTRACER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL __HOOKED_vkAllocateCommandBuffers
                         get_struct_chain_size((void*)pAllocateInfo) + sizeof(VkCommandBuffer) * pAllocateInfo->commandBufferCount);
     result = mdd(device)->devTable.AllocateCommandBuffers(device, pAllocateInfo, pCommandBuffers);
     vktrace_set_packet_entrypoint_end_time(pHeader);
+    if (g_gpuTimingEnabled && result == VK_SUCCESS) {
+        vktrace_gpu_timing_add_command_buffers(device, pAllocateInfo, pCommandBuffers);
+    }
     pPacket = interpret_body_as_vkAllocateCommandBuffers(pHeader);
     pPacket->device = device;
     vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pAllocateInfo), sizeof(VkCommandBufferAllocateInfo),
@@ -827,9 +875,15 @@ VKTRACER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL __HOOKED_vkBeginCommandBuffer(VkC
     VkResult result;
     vktrace_trace_packet_header* pHeader;
     packet_vkBeginCommandBuffer* pPacket = NULL;
+    if (g_gpuTimingEnabled) {
+        vktrace_gpu_timing_reset_command_buffer(commandBuffer);
+    }
     CREATE_TRACE_PACKET(vkBeginCommandBuffer, get_struct_chain_size((void*)pBeginInfo));
     result = mdd(commandBuffer)->devTable.BeginCommandBuffer(commandBuffer, pBeginInfo);
     vktrace_set_packet_entrypoint_end_time(pHeader);
+    if (g_gpuTimingEnabled && result == VK_SUCCESS) {
+        vktrace_gpu_timing_begin_command_buffer(commandBuffer, pHeader->global_packet_index, pBeginInfo->flags);
+    }
     pPacket = interpret_body_as_vkBeginCommandBuffer(pHeader);
     pPacket->commandBuffer = commandBuffer;
     vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pBeginInfo), sizeof(VkCommandBufferBeginInfo), pBeginInfo);
@@ -994,6 +1048,9 @@ VKTRACER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL __HOOKED_vkCreateDevice(VkPhysica
     // Setup device dispatch table for extensions
     ext_init_create_device(mdd(*pDevice), *pDevice, fpGetDeviceProcAddr, pCreateInfo->enabledExtensionCount,
                            pCreateInfo->ppEnabledExtensionNames);
+    if (g_gpuTimingEnabled) {
+        vktrace_gpu_timing_add_device(physicalDevice, *pDevice);
+    }
 
     // remove the loader extended createInfo structure
     VkDeviceCreateInfo localCreateInfo;
@@ -1192,6 +1249,25 @@ static void send_vk_api_version_packet() {
     FINISH_TRACE_PACKET();
 }
 
+// A trim window's packets are written long after they were made, and each window to a trace file of its
+// own, so blob packets could end up in another file than the packets referring to them
+static void start_blob_store(bool sharded) {
+    const char* env_dedup_blobs = vktrace_get_global_var(VKTRACE_DEDUP_BLOBS_ENV);
+    if (env_dedup_blobs == NULL || strcmp(env_dedup_blobs, "1") != 0) return;
+
+    if (g_trimEnabled) {
+        vktrace_LogWarning("Repeated payloads aren't deduplicated in trimmed traces.");
+        return;
+    }
+    // A blob packet is made after the packet referring to it, so merging shards by packet index would put it behind
+    if (sharded) {
+        vktrace_LogWarning("Repeated payloads aren't deduplicated in sharded traces.");
+        return;
+    }
+    vktrace_blob_store_start_tracing(vktrace_trace_get_trace_file());
+    vktrace_LogVerbose("Deduplicating repeated payloads of %u bytes or more.", VKTRACE_BLOB_MIN_SIZE);
+}
+
 VKTRACER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL __HOOKED_vkCreateInstance(const VkInstanceCreateInfo* pCreateInfo,
                                                                          const VkAllocationCallbacks* pAllocator,
                                                                          VkInstance* pInstance) {
@@ -1269,6 +1345,14 @@ VKTRACER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL __HOOKED_vkCreateInstance(const V
     if (firstCreateInstance) {
         if (!send_vk_trace_file_header(*pInstance)) vktrace_LogError("Failed to write trace file header");
         send_vk_api_version_packet();
+        bool sharded = vktrace_shard_writer_start();
+        if (!sharded) {
+            vktrace_async_writer_start();
+        }
+        start_blob_store(sharded);
+        vktrace_cmd_blocks_start();
+        vktrace_gpu_timing_start();
+        vktrace_query_digests_start();
         firstCreateInstance = false;
     }
 
@@ -2171,9 +2255,15 @@ VKTRACER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL __HOOKED_vkQueueSubmit(VkQueue qu
     for (uint32_t i = 0; i < submitCount; ++i) {
         arrayByteCount += vk_size_vksubmitinfo(&pSubmits[i]);
     }
+    if (g_gpuTimingEnabled) {
+        vktrace_gpu_timing_begin_submit(submitCount, pSubmits);
+    }
     CREATE_TRACE_PACKET(vkQueueSubmit, arrayByteCount);
     result = mdd(queue)->devTable.QueueSubmit(queue, submitCount, pSubmits, fence);
     vktrace_set_packet_entrypoint_end_time(pHeader);
+    if (g_gpuTimingEnabled && result == VK_SUCCESS) {
+        vktrace_gpu_timing_end_submit(pHeader->global_packet_index, submitCount, pSubmits);
+    }
     pPacket = interpret_body_as_vkQueueSubmit(pHeader);
     pPacket->queue = queue;
     pPacket->submitCount = submitCount;
@@ -2319,7 +2409,7 @@ VKTRACER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL __HOOKED_vkQueueBindSparse(VkQueu
 
         vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pBindInfo[i].pImageBinds),
                                            pPacket->pBindInfo[i].imageBindCount * sizeof(VkSparseImageMemoryBindInfo),
-                                           pBindInfo[i].pImageOpaqueBinds);
+                                           pBindInfo[i].pImageBinds);
         for (uint32_t j = 0; j < pPacket->pBindInfo[i].imageBindCount; j++) {
             VkSparseImageMemoryBindInfo* pSparseImageMemoryBindInfo =
                 (VkSparseImageMemoryBindInfo*)&pPacket->pBindInfo[i].pImageBinds[j];
@@ -2921,7 +3011,7 @@ VKTRACER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL __HOOKED_vkCreateImage(VkDevice d
     } else {
         vktrace_finalize_trace_packet(pHeader);
 #if TRIM_USE_ORDERED_IMAGE_CREATION
-        trim::add_Image_call(trim::copy_packet(pHeader));
+        trim::add_Image_call(*pImage, trim::copy_packet(pHeader));
 #endif  // TRIM_USE_ORDERED_IMAGE_CREATION"
         trim::ObjectInfo& info = trim::add_Image_object(*pImage);
         info.belongsToDevice = device;
@@ -3195,13 +3285,15 @@ VKTRACER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL __HOOKED_vkGetSwapchainImagesKHR(
         trim::ObjectInfo* pInfo = trim::get_SwapchainKHR_objectInfo(swapchain);
         if (pInfo != NULL) {
             if (pSwapchainImageCount != NULL && pSwapchainImages == NULL) {
-                if (g_trimIsPreTrim) {
-                    // only want to replay this call if it was made PRE trim frames.
+                if (g_trimIsPreTrim || g_trimWindows) {
+                    // only want to replay this call if it was made PRE trim frames, or before a later trim window.
+                    vktrace_delete_trace_packet(&pInfo->ObjectInfo.SwapchainKHR.pGetSwapchainImageCountPacket);
                     pInfo->ObjectInfo.SwapchainKHR.pGetSwapchainImageCountPacket = trim::copy_packet(pHeader);
                 }
             } else if (pSwapchainImageCount != NULL && pSwapchainImages != NULL) {
-                if (g_trimIsPreTrim) {
-                    // only want to replay this call if it was made PRE trim frames.
+                if (g_trimIsPreTrim || g_trimWindows) {
+                    // only want to replay this call if it was made PRE trim frames, or before a later trim window.
+                    vktrace_delete_trace_packet(&pInfo->ObjectInfo.SwapchainKHR.pGetSwapchainImagesPacket);
                     pInfo->ObjectInfo.SwapchainKHR.pGetSwapchainImagesPacket = trim::copy_packet(pHeader);
                 }
                 for (uint32_t i = 0; i < *pSwapchainImageCount; i++) {
@@ -3278,9 +3370,23 @@ VKTRACER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL __HOOKED_vkQueuePresentKHR(VkQueu
         }
     }
 
+    if (g_gpuTimingEnabled) {
+        vktrace_gpu_timing_end_frame();
+    }
+
     if (g_trimEnabled) {
         g_trimFrameCounter++;
-        if (trim::is_trim_trigger_enabled(trim::enum_trim_trigger::hotKey)
+        if (g_trimRingFrames > 0) {
+            bool triggered =
+                (trim::is_trim_trigger_enabled(trim::enum_trim_trigger::hotKey) && trim::is_hotkey_trim_triggered()) ||
+                (trim::is_trim_trigger_enabled(trim::enum_trim_trigger::port) && trim::is_port_trim_triggered()) ||
+                (trim::is_trim_trigger_enabled(trim::enum_trim_trigger::hitch) && trim::is_hitch_trim_triggered());
+            if (g_trimIsInTrim && triggered) {
+                vktrace_LogAlways("Writing the trim ring at frame: %d", g_trimFrameCounter - 1);
+                trim::write_ring();
+            }
+            trim::end_ring_frame();
+        } else if (trim::is_trim_trigger_enabled(trim::enum_trim_trigger::hotKey)
          || trim::is_trim_trigger_enabled(trim::enum_trim_trigger::port)) {
             if (!g_trimAlreadyFinished)
             {
@@ -13,6 +13,9 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <algorithm>
+#include <deque>
+#include <vector>
 #include "vktrace_lib_trim.h"
 #include "vktrace_lib_helpers.h"
 #include "vktrace_trace_packet_utils.h"
@@ -33,6 +36,9 @@ uint64_t g_trimFrameCounter = 0;
 uint64_t g_trimStartFrame = 0;
 uint64_t g_trimEndFrame = UINT64_MAX;
 bool g_trimAlreadyFinished = false;
+bool g_trimCompact = false;
+bool g_trimWindows = false;
+uint32_t g_trimRingFrames = 0;
 #ifdef PLATFORM_LINUX
 int g_trimPort = 8100;
 int g_trigger_socket = -1;
@@ -45,6 +51,53 @@ static StateTracker s_trimGlobalStateTracker;
 // A snapshot of the GlobalStateTracker taken at the start of the trim frames.
 static StateTracker s_trimStateTrackerSnapshot;
 
+//=========================================================================
+// Trim ring
+//
+// With VKTRACE_TRIM_RING_FRAMES, the packets are kept in a ring instead of
+// being written, in segments of g_trimRingFrames frames. The ring holds the
+// segment being traced and the one before it, and a copy of the global state
+// tracker taken at the start of each. When a segment is complete, the one
+// before it is dropped and a new one starts, so the ring always holds the
+// last g_trimRingFrames to 2 * g_trimRingFrames frames. The trigger writes
+// the objects as they were at the start of the ring, followed by the
+// packets of the ring.
+//
+// Only the object state is copied at the start of a segment. Image and
+// buffer contents are read back when the ring is written, so a resource
+// starts with the contents it has at the end of the ring, and one destroyed
+// within the ring with undefined contents. Resources the ring writes
+// before reading them replay as traced.
+//=========================================================================
+static StateTracker s_trimRingStateTrackers[2];
+// Index of the tracker of the ring start, the other one is of the segment being traced
+static uint32_t s_trimRingStart = 0;
+static std::deque<vktrace_trace_packet_header *> s_trimRingPackets;
+// Index in s_trimRingPackets of the first packet of the segment being traced
+static size_t s_trimRingSegmentStart = 0;
+static uint32_t s_trimRingSegmentFrames = 0;
+
+//=========================================================================
+// Hitch trigger
+//
+// With the hitch trigger, the time from each present to the next is
+// compared with a limit, in milliseconds or as a multiple of the median of
+// the last frames. A frame over the limit writes the ring out half a ring
+// later, so it holds frames before and after the slow one. The ring is
+// written at most once per interval, as the application stalls while it is
+// read back and written.
+//=========================================================================
+static const uint32_t HITCH_MEDIAN_FRAMES = 64;
+static const uint32_t HITCH_DEFAULT_RING_FRAMES = 10;
+static double s_hitchLimitMs = 0.0;       // not used if 0
+static double s_hitchMedianFactor = 3.0;  // not used if 0
+static uint64_t s_hitchIntervalNs = 10 * 1000000000ULL;
+static std::vector<uint64_t> s_hitchFrameTimes;  // of the last HITCH_MEDIAN_FRAMES frames, in ns
+static size_t s_hitchNextFrameTime = 0;
+static uint64_t s_hitchLastPresent = 0;  // 0 if the next frame isn't timed
+static uint64_t s_hitchLastWrite = 0;
+static uint32_t s_hitchWriteIn = 0;  // presents until the ring is written, 0 if no hitch is waiting
+
 // Maximum length of the VKTRACE_TRIM_TRIGGER environment variable
 static const int MAX_TRIM_TRIGGER_OPTION_STRING_LENGTH = 32;
 
@@ -105,11 +158,6 @@ static std::unordered_map<VkDevice, std::unordered_map<uint32_t, VkCommandPool>>
 //=========================================================================
 static std::unordered_map<const void *, VkAllocationCallbacks> s_trimAllocatorMap;
 
-//=========================================================================
-// Associates a Device to a trim-specific CommandBuffer
-//=========================================================================
-static std::unordered_map<VkDevice, VkCommandBuffer> s_deviceToCommandBufferMap;
-
 //=========================================================================
 // Start trimming
 //=========================================================================
@@ -129,15 +177,185 @@ void stop() {
     g_trimIsInTrim = false;
     g_trimIsPostTrim = true;
 
+    if (g_trimRingFrames > 0) {
+        // Nothing was written since the ring was last written out, the frames still in it are dropped
+        vktrace_enter_critical_section(&trimRecordedPacketLock);
+        for (size_t i = 0; i < s_trimRingPackets.size(); i++) {
+            vktrace_delete_trace_packet(&s_trimRingPackets[i]);
+        }
+        s_trimRingPackets.clear();
+        s_trimRingSegmentStart = 0;
+        vktrace_leave_critical_section(&trimRecordedPacketLock);
+        g_trimAlreadyFinished = true;
+        return;
+    }
+
     // write packets to destroy all created objects
     write_destroy_packets();
 
     // clean up
     s_trimStateTrackerSnapshot.clear();
+    s_imageToStagedInfoMap.clear();
+    s_bufferToStagedInfoMap.clear();
+
+    if (g_trimWindows) {
+        // vktrace writes the packets after this marker to the trace file of the next window. The global
+        // state tracker kept tracking during this window, so the next start snapshots it again.
+        vktrace_trace_packet_header *pHeader =
+            vktrace_create_trace_packet(VKTRACE_TID_VULKAN, VKTRACE_TPI_MARKER_TRIM_WINDOW_END, 0, 0);
+        vktrace_finalize_trace_packet(pHeader);
+        write_packet(pHeader);
+
+        // Wait for the trigger again, with the frame count of the trigger option
+        g_trimIsPostTrim = false;
+        g_trimIsPreTrim = true;
+        if (g_trimEndFrame < UINT64_MAX && g_trimEndFrame >= g_trimStartFrame) {
+            g_trimEndFrame -= g_trimStartFrame;
+        }
+        return;
+    }
 
     g_trimAlreadyFinished = true;
 }
 
+//=========================================================================
+// Generates a vkMapMemory for the memory objects of stateTracker the
+// application keeps mapped.
+//=========================================================================
+static void generatePersistentMapPackets(StateTracker &stateTracker) {
+    for (auto iter = stateTracker.createdDeviceMemorys.begin(); iter != stateTracker.createdDeviceMemorys.end(); iter++) {
+        // if the application still has this memory mapped, then we need to make
+        // sure the trim trace file leaves it mapped, so let's generate one more
+        // call to vkMapBuffer.
+        bool bCurrentlyMapped = (iter->second.ObjectInfo.DeviceMemory.mappedAddress != NULL);
+        if (bCurrentlyMapped) {
+            VkDevice device = iter->second.belongsToDevice;
+            VkDeviceMemory deviceMemory = iter->first;
+            VkDeviceSize offset = 0;
+            VkDeviceSize size = ROUNDUP_TO_4(iter->second.ObjectInfo.DeviceMemory.size);
+            VkMemoryMapFlags flags = 0;
+            void *pData = iter->second.ObjectInfo.DeviceMemory.mappedAddress;
+
+            if (size != 0) {
+                vktrace_delete_trace_packet(&iter->second.ObjectInfo.DeviceMemory.pPersistentlyMapMemoryPacket);
+                vktrace_trace_packet_header *pPersistentlyMapMemory =
+                    generate::vkMapMemory(false, device, deviceMemory, offset, size, flags, &pData);
+                iter->second.ObjectInfo.DeviceMemory.pPersistentlyMapMemoryPacket = pPersistentlyMapMemory;
+            }
+        }
+    }
+}
+
+//=========================================================================
+// Moves the contents read back for a resource in the current state into its
+// state at the start of the ring.
+//=========================================================================
+static void moveResourceContents(vktrace_trace_packet_header **ppMapMemoryPacket,
+                                 vktrace_trace_packet_header **ppUnmapMemoryPacket,
+                                 vktrace_trace_packet_header **ppCurrentMapMemoryPacket,
+                                 vktrace_trace_packet_header **ppCurrentUnmapMemoryPacket) {
+    vktrace_delete_trace_packet(ppMapMemoryPacket);
+    vktrace_delete_trace_packet(ppUnmapMemoryPacket);
+    *ppMapMemoryPacket = *ppCurrentMapMemoryPacket;
+    *ppUnmapMemoryPacket = *ppCurrentUnmapMemoryPacket;
+    *ppCurrentMapMemoryPacket = NULL;
+    *ppCurrentUnmapMemoryPacket = NULL;
+}
+
+//=========================================================================
+// Write the trim ring
+//=========================================================================
+void write_ring() {
+    vktrace_enter_critical_section(&trimRecordedPacketLock);
+
+    // Read back the current contents of the images and buffers
+    snapshot_state_tracker();
+
+    vktrace_enter_critical_section(&trimStateTrackerLock);
+    // and recreate the objects as they were at the start of the ring, with those contents.
+    StateTracker &ringStart = s_trimRingStateTrackers[s_trimRingStart];
+    for (auto obj = ringStart.createdImages.begin(); obj != ringStart.createdImages.end(); obj++) {
+        auto current = s_trimStateTrackerSnapshot.createdImages.find(obj->first);
+        if (current != s_trimStateTrackerSnapshot.createdImages.end()) {
+            moveResourceContents(&obj->second.ObjectInfo.Image.pMapMemoryPacket, &obj->second.ObjectInfo.Image.pUnmapMemoryPacket,
+                                 &current->second.ObjectInfo.Image.pMapMemoryPacket,
+                                 &current->second.ObjectInfo.Image.pUnmapMemoryPacket);
+        } else {
+            // Destroyed within the ring, there is nothing to stage
+            obj->second.ObjectInfo.Image.needsStagingBuffer = false;
+        }
+    }
+    for (auto obj = ringStart.createdBuffers.begin(); obj != ringStart.createdBuffers.end(); obj++) {
+        auto current = s_trimStateTrackerSnapshot.createdBuffers.find(obj->first);
+        if (current != s_trimStateTrackerSnapshot.createdBuffers.end()) {
+            moveResourceContents(&obj->second.ObjectInfo.Buffer.pMapMemoryPacket,
+                                 &obj->second.ObjectInfo.Buffer.pUnmapMemoryPacket,
+                                 &current->second.ObjectInfo.Buffer.pMapMemoryPacket,
+                                 &current->second.ObjectInfo.Buffer.pUnmapMemoryPacket);
+        } else {
+            obj->second.ObjectInfo.Buffer.needsStagingBuffer = false;
+        }
+    }
+    s_trimStateTrackerSnapshot.clear();
+    s_trimStateTrackerSnapshot = ringStart;
+    generatePersistentMapPackets(s_trimStateTrackerSnapshot);
+    vktrace_leave_critical_section(&trimStateTrackerLock);
+
+    write_all_referenced_object_calls();
+    for (size_t i = 0; i < s_trimRingPackets.size(); i++) {
+        vktrace_write_trace_packet(s_trimRingPackets[i], vktrace_trace_get_trace_file());
+        vktrace_delete_trace_packet(&s_trimRingPackets[i]);
+    }
+    s_trimRingPackets.clear();
+    write_destroy_packets();
+
+    s_trimStateTrackerSnapshot.clear();
+    s_imageToStagedInfoMap.clear();
+    s_bufferToStagedInfoMap.clear();
+
+    vktrace_trace_packet_header *pHeader =
+        vktrace_create_trace_packet(VKTRACE_TID_VULKAN, VKTRACE_TPI_MARKER_TRIM_WINDOW_END, 0, 0);
+    vktrace_finalize_trace_packet(pHeader);
+    vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
+    vktrace_delete_trace_packet(&pHeader);
+
+    // The next time, the ring starts from here
+    vktrace_enter_critical_section(&trimStateTrackerLock);
+    for (uint32_t i = 0; i < 2; i++) {
+        s_trimRingStateTrackers[i].clear();
+        s_trimRingStateTrackers[i] = s_trimGlobalStateTracker;
+    }
+    vktrace_leave_critical_section(&trimStateTrackerLock);
+    s_trimRingSegmentStart = 0;
+    s_trimRingSegmentFrames = 0;
+
+    vktrace_leave_critical_section(&trimRecordedPacketLock);
+}
+
+//=========================================================================
+void end_ring_frame() {
+    if (g_trimRingFrames == 0 || ++s_trimRingSegmentFrames < g_trimRingFrames) {
+        return;
+    }
+
+    // The segment before the one just completed falls out of the ring, and a new segment starts
+    vktrace_enter_critical_section(&trimRecordedPacketLock);
+    for (size_t i = 0; i < s_trimRingSegmentStart; i++) {
+        vktrace_delete_trace_packet(&s_trimRingPackets[i]);
+    }
+    s_trimRingPackets.erase(s_trimRingPackets.begin(), s_trimRingPackets.begin() + s_trimRingSegmentStart);
+    s_trimRingSegmentStart = s_trimRingPackets.size();
+    s_trimRingSegmentFrames = 0;
+
+    StateTracker &segmentStart = s_trimRingStateTrackers[s_trimRingStart];
+    s_trimRingStart ^= 1;
+    vktrace_enter_critical_section(&trimStateTrackerLock);
+    segmentStart.clear();
+    segmentStart = s_trimGlobalStateTracker;
+    vktrace_leave_critical_section(&trimStateTrackerLock);
+    vktrace_leave_critical_section(&trimRecordedPacketLock);
+}
+
 //=========================================================================
 void AddImageTransition(VkCommandBuffer commandBuffer, ImageTransition transition) {
     s_trimGlobalStateTracker.AddImageTransition(commandBuffer, transition);
@@ -391,12 +609,56 @@ bool is_port_trim_triggered() {
 #endif
 }
 
+//=========================================================================
+// Time the frame that was just presented and detect if it's a hitch.
+//=========================================================================
+bool is_hitch_trim_triggered() {
+    uint64_t now = vktrace_get_time();
+    uint64_t frameTime = s_hitchLastPresent != 0 ? now - s_hitchLastPresent : 0;
+    s_hitchLastPresent = now;
+
+    if (frameTime > 0) {
+        bool hitch = s_hitchLimitMs > 0.0 && frameTime > s_hitchLimitMs * 1000000.0;
+        if (s_hitchMedianFactor > 0.0 && s_hitchFrameTimes.size() == HITCH_MEDIAN_FRAMES) {
+            std::vector<uint64_t> frameTimes(s_hitchFrameTimes);
+            std::nth_element(frameTimes.begin(), frameTimes.begin() + HITCH_MEDIAN_FRAMES / 2, frameTimes.end());
+            hitch = hitch || frameTime > frameTimes[HITCH_MEDIAN_FRAMES / 2] * s_hitchMedianFactor;
+        }
+        if (s_hitchFrameTimes.size() < HITCH_MEDIAN_FRAMES) {
+            s_hitchFrameTimes.push_back(frameTime);
+        } else {
+            s_hitchFrameTimes[s_hitchNextFrameTime] = frameTime;
+            s_hitchNextFrameTime = (s_hitchNextFrameTime + 1) % HITCH_MEDIAN_FRAMES;
+        }
+
+        // A hitch while one is waiting is written with it
+        if (hitch && s_hitchWriteIn == 0) {
+            if (s_hitchLastWrite != 0 && now - s_hitchLastWrite < s_hitchIntervalNs) {
+                vktrace_LogVerbose("Frame %" PRIu64 " took %.1f ms, too soon after the last trim ring was written.",
+                                   g_trimFrameCounter - 1, frameTime / 1000000.0);
+            } else {
+                vktrace_LogAlways("Frame %" PRIu64 " took %.1f ms.", g_trimFrameCounter - 1, frameTime / 1000000.0);
+                s_hitchWriteIn = g_trimRingFrames / 2 + 1;
+            }
+        }
+    }
+
+    if (s_hitchWriteIn > 0 && --s_hitchWriteIn == 0) {
+        // The next frame includes writing the ring
+        s_hitchLastWrite = now;
+        s_hitchLastPresent = 0;
+        return true;
+    }
+    return false;
+}
+
 //=========================================================================
 char *getTraceTriggerOptionString(enum enum_trim_trigger triggerType) {
     static const char TRIM_TRIGGER_HOTKEY_TYPE_STRING[] = "hotkey";
     static const char TRIM_TRIGGER_FRAMES_TYPE_STRING[] = "frames";
     static const char TRIM_TRIGGER_FRAMES_DEFAULT_HOTKEY_STRING[] = "F12";
     static const char TRIM_TRIGGER_FRAMES_TYPE_PORT[] = "port";
+    static const char TRIM_TRIGGER_HITCH_TYPE_STRING[] = "hitch";
 
     static bool firstTimeRunning = true;
     static enum enum_trim_trigger trimTriggerType = enum_trim_trigger::none;
@@ -435,6 +697,11 @@ char *getTraceTriggerOptionString(enum enum_trim_trigger triggerType) {
                 }
             } else if (strcmp(typeString, TRIM_TRIGGER_FRAMES_TYPE_PORT) == 0) {
                 trimTriggerType = enum_trim_trigger::port;
+            } else if (strcmp(typeString, TRIM_TRIGGER_HITCH_TYPE_STRING) == 0) {
+                trimTriggerType = enum_trim_trigger::hitch;
+                if (trim_trigger_option[0] == '-') {
+                    trim_trigger_option++; // Remove the '-'
+                }
             }
         }
     }
@@ -557,13 +824,59 @@ void initialize() {
 			// vktrace_Log* cause some sort of crash if called here.
 			printf("-tr port option not supported. Ignoring.");
 #endif
-        } 
+        } else if (trim::is_trim_trigger_enabled(trim::enum_trim_trigger::hitch)) {
+            // The hitch specification looks like: hitch[-<limit>][,<seconds>]
+            // where the limit is in milliseconds, or a multiple of the median
+            // frame time if it ends with 'x'.
+            const char *trimHitchOption = getTraceTriggerOptionString(enum_trim_trigger::hitch);
+            char *end = NULL;
+            double limit = strtod(trimHitchOption, &end);
+            if (end != trimHitchOption && limit > 0.0) {
+                if (*end == 'x') {
+                    s_hitchMedianFactor = limit;
+                    end++;
+                } else {
+                    s_hitchLimitMs = limit;
+                    s_hitchMedianFactor = 0.0;
+                }
+            }
+            unsigned int seconds = 0;
+            if (end != NULL && sscanf(end, ",%u", &seconds) == 1) {
+                s_hitchIntervalNs = seconds * 1000000000ULL;
+            }
+            g_trimEnabled = true;
+        }
     }
     if (g_trimEnabled) {
+        const char *trimCompact = vktrace_get_global_var(VKTRACE_TRIM_COMPACT_ENV);
+        g_trimCompact = (trimCompact != NULL && strcmp(trimCompact, "1") == 0);
+        const char *trimWindows = vktrace_get_global_var(VKTRACE_TRIM_WINDOWS_ENV);
+        g_trimWindows = (trimWindows != NULL && strcmp(trimWindows, "1") == 0) &&
+                        (is_trim_trigger_enabled(enum_trim_trigger::hotKey) || is_trim_trigger_enabled(enum_trim_trigger::port));
+        const char *trimRingFrames = vktrace_get_global_var(VKTRACE_TRIM_RING_FRAMES_ENV);
+        if (trimRingFrames != NULL &&
+            (is_trim_trigger_enabled(enum_trim_trigger::hotKey) || is_trim_trigger_enabled(enum_trim_trigger::port) ||
+             is_trim_trigger_enabled(enum_trim_trigger::hitch))) {
+            g_trimRingFrames = static_cast<uint32_t>(strtoul(trimRingFrames, NULL, 10));
+        }
+        if (g_trimRingFrames == 0 && is_trim_trigger_enabled(enum_trim_trigger::hitch)) {
+            g_trimRingFrames = HITCH_DEFAULT_RING_FRAMES;
+        }
+        if (g_trimRingFrames > 0) {
+            // The ring is traced like a trim window that starts with the application, and the
+            // trigger writes it out without stopping it, so the frame count of the trigger option
+            // is ignored.
+            g_trimWindows = true;
+            g_trimIsPreTrim = false;
+            g_trimIsInTrim = true;
+            g_trimEndFrame = UINT64_MAX;
+        }
+
         vktrace_create_critical_section(&trimStateTrackerLock);
         vktrace_create_critical_section(&trimRecordedPacketLock);
         vktrace_create_critical_section(&trimCommandBufferPacketLock);
         vktrace_create_critical_section(&trimTransitionMapLock);
+        vktrace_create_critical_section(&trimShaderCodeLock);
     }
 }
 
@@ -571,6 +884,8 @@ void initialize() {
 void deinitialize() {
     s_trimStateTrackerSnapshot.clear();
     s_trimGlobalStateTracker.clear();
+    s_trimRingStateTrackers[0].clear();
+    s_trimRingStateTrackers[1].clear();
     
 #ifdef PLATFORM_LINUX
     if (g_trigger_socket >= 0)
@@ -580,6 +895,7 @@ void deinitialize() {
     vktrace_delete_critical_section(&trimStateTrackerLock);
     vktrace_delete_critical_section(&trimCommandBufferPacketLock);
     vktrace_delete_critical_section(&trimTransitionMapLock);
+    vktrace_delete_critical_section(&trimShaderCodeLock);
 }
 
 //=========================================================================
@@ -721,77 +1037,6 @@ VkCommandPool getCommandPoolFromDevice(VkDevice device, uint32_t queueFamilyInde
     return queueFamilyIter->second;
 }
 
-//=========================================================================
-// Find existing trim-specific CommandBuffer from the Device, or
-// create a new one.
-//=========================================================================
-VkCommandBuffer getCommandBufferFromDevice(VkDevice device, VkCommandPool commandPool = VK_NULL_HANDLE,
-                                           uint32_t queueFamilyIndex = 0) {
-    assert(device != VK_NULL_HANDLE);
-
-    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
-    if (s_deviceToCommandBufferMap.find(device) == s_deviceToCommandBufferMap.end()) {
-        if (commandPool == VK_NULL_HANDLE) {
-            commandPool = getCommandPoolFromDevice(device, queueFamilyIndex);
-        }
-
-        // allocate a new command buffer on the device
-        VkCommandBufferAllocateInfo allocateInfo;
-        allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocateInfo.pNext = NULL;
-        allocateInfo.commandPool = commandPool;
-        allocateInfo.level = (VkCommandBufferLevel)VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocateInfo.commandBufferCount = 1;
-
-        VkResult result = mdd(device)->devTable.AllocateCommandBuffers(device, &allocateInfo, &commandBuffer);
-        assert(result == VK_SUCCESS);
-        if (result == VK_SUCCESS) {
-            s_deviceToCommandBufferMap[device] = commandBuffer;
-        }
-    } else {
-        commandBuffer = s_deviceToCommandBufferMap[device];
-    }
-
-    return commandBuffer;
-}
-
-//=========================================================================
-StagingInfo createStagingBuffer(VkDevice device, VkCommandPool commandPool, VkCommandBuffer commandBuffer,
-                                uint32_t queueFamilyIndex, VkDeviceSize size) {
-    StagingInfo stagingInfo = {};
-
-    stagingInfo.commandPool = commandPool;
-    stagingInfo.commandBuffer = commandBuffer;
-
-    VkQueue queue = trim::get_DeviceQueue(device, queueFamilyIndex, 0);
-    stagingInfo.queue = queue;
-
-    stagingInfo.bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    stagingInfo.bufferCreateInfo.pNext = NULL;
-    stagingInfo.bufferCreateInfo.flags = 0;
-    stagingInfo.bufferCreateInfo.size = size;
-    stagingInfo.bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-    stagingInfo.bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    stagingInfo.bufferCreateInfo.queueFamilyIndexCount = 0;
-    stagingInfo.bufferCreateInfo.pQueueFamilyIndices = NULL;
-
-    mdd(device)->devTable.CreateBuffer(device, &stagingInfo.bufferCreateInfo, NULL, &stagingInfo.buffer);
-
-    mdd(device)->devTable.GetBufferMemoryRequirements(device, stagingInfo.buffer, &stagingInfo.bufferMemoryRequirements);
-
-    stagingInfo.memoryAllocationInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    stagingInfo.memoryAllocationInfo.pNext = NULL;
-    stagingInfo.memoryAllocationInfo.allocationSize = stagingInfo.bufferMemoryRequirements.size;
-    stagingInfo.memoryAllocationInfo.memoryTypeIndex =
-        FindMemoryTypeIndex(device, stagingInfo.bufferMemoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-
-    mdd(device)->devTable.AllocateMemory(device, &stagingInfo.memoryAllocationInfo, nullptr, &stagingInfo.memory);
-
-    mdd(device)->devTable.BindBufferMemory(device, stagingInfo.buffer, stagingInfo.memory, 0);
-
-    return stagingInfo;
-}
-
 //=========================================================================
 void generateCreateStagingBuffer(VkDevice device, StagingInfo stagingInfo) {
     vktrace_trace_packet_header *pHeader =
@@ -976,605 +1221,737 @@ void generateMapUnmap(bool makeCalls, VkDevice device, VkDeviceMemory memory, Vk
     }
 }
 
-//=============================================================================
-// Use this to snapshot the global state tracker at the start of the trim
-// frames.
-//=============================================================================
-void snapshot_state_tracker() {
-    vktrace_enter_critical_section(&trimStateTrackerLock);
-    s_trimStateTrackerSnapshot = s_trimGlobalStateTracker;
-
-    //
-    // Copying all the buffers is a length process, it include the following
-    // sub-processes:
-    //
-    // for (any image in all tracked images)
-    // {
-    //    1a) Transition the image into host - readable state.
-    //    2a) Map, copy, unmap the image.
-    //    3a) Transition the images back to their previous state.
-    // }
-    //
-    // for (any buffer in all tracked buffers)
-    // {
-    //    1b) Transition the buffers into host - readable state.
-    //    2b) Map, copy, unmap the buffer.
-    //    3b) Transition the buffer back to their previous state.
-    // }
-    //
-    // 4) Destroy the command pools, command buffers, and fences.
-    //
-    // Please note: the above sub-process order arrangement include some
-    // consideration about driver limitation:
-    //
-    // Some driver has limitation on the max GPU memory allocations. For
-    // some title with heavily sub-allocation behavior, the staging memory
-    // allocations needed by trim will be a large number, the following
-    // sub-process order minimize the active GPU memory allocations needed
-    // by trim at same time, and avoid the allocations (needed by trim and
-    // by the title itself) beyond driver limitation. Otherwise, it cause
-    // some title hang problem due to fail to allocate memory.
-
-    // a) dump all images, the process include the following sub-process:
-    //    1a) Transition the image into host - readable state.
-    //    2a) Map, copy, unmap the image.
-    //    3a) Transition the image back to their previous state.
-    //
-    for (auto imageIter = s_trimStateTrackerSnapshot.createdImages.begin();
-         imageIter != s_trimStateTrackerSnapshot.createdImages.end(); imageIter++) {
-        VkDevice device = imageIter->second.belongsToDevice;
-        VkImage image = imageIter->first;
-
-        // 1a) Transition the image into host-readable state.
-
-        if (device == VK_NULL_HANDLE) {
-            // this is likely a swapchain image which we haven't associated a
-            // device to, just skip over it.
-            continue;
-        }
+//=========================================================================
+// Image and buffer contents are read back at trim start in batches. The
+// copies and barriers for the resources of one device and queue family are
+// recorded into one command buffer until a batch's worth of memory is read
+// back by it, and while the GPU runs that batch the contents of the
+// previous one are copied into map / unmap packets. Resources that need a
+// staging buffer get a range of the staging block of the batch instead of
+// their own buffer and memory.
+//=========================================================================
+static const VkDeviceSize TRIM_SNAPSHOT_BATCH_SIZE = 64 * 1024 * 1024;
 
-        uint32_t queueFamilyIndex = imageIter->second.ObjectInfo.Image.queueFamilyIndex;
+// Staging ranges start at a multiple of every texel block size, including
+// the 12 bytes of the 96-bit formats.
+static const VkDeviceSize TRIM_SNAPSHOT_STAGING_ALIGNMENT = 768;
 
-        if (imageIter->second.ObjectInfo.Image.sharingMode == VK_SHARING_MODE_CONCURRENT) {
-            queueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        }
-
-        VkCommandPool commandPool = getCommandPoolFromDevice(device, queueFamilyIndex);
-        VkCommandBuffer commandBuffer = getCommandBufferFromDevice(device, commandPool);
+struct SnapshotItem {
+    VkImage image;
+    VkBuffer buffer;
+    ObjectInfo *pInfo;
+    VkDeviceSize stagingOffset;
+};
 
-        // Begin the command buffer
-        VkCommandBufferBeginInfo commandBufferBeginInfo;
-        commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        commandBufferBeginInfo.pNext = NULL;
-        commandBufferBeginInfo.pInheritanceInfo = NULL;
-        commandBufferBeginInfo.flags = 0;
-        VkResult result = mdd(device)->devTable.BeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
-        assert(result == VK_SUCCESS);
-        if (result != VK_SUCCESS) continue;
+struct SnapshotBatch {
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+
+    // Staging block, persistently mapped
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    void *pData = NULL;
+    bool coherent = true;
+
+    VkDeviceSize used = 0;
+    bool recording = false;
+    bool submitted = false;
+    std::vector<SnapshotItem> items;
+};
 
-        if (imageIter->second.ObjectInfo.Image.needsStagingBuffer) {
-            StagingInfo stagingInfo = createStagingBuffer(device, commandPool, commandBuffer,
-                                                          (queueFamilyIndex == VK_QUEUE_FAMILY_IGNORED) ? 0 : queueFamilyIndex,
-                                                          imageIter->second.ObjectInfo.Image.memorySize);
+struct SnapshotQueue {
+    VkDevice device = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkQueue queue = VK_NULL_HANDLE;
+    SnapshotBatch batches[2];
+    uint32_t current = 0;
 
-            // From Docs: srcImage must have a sample count equal to
-            // VK_SAMPLE_COUNT_1_BIT
-            // From Docs: srcImage must have been created with
-            // VK_IMAGE_USAGE_TRANSFER_SRC_BIT usage flag
+    // Resources read back without a staging buffer, which are transitioned
+    // back once all host reads are done
+    std::vector<SnapshotItem> restoreItems;
+};
 
-            // Copy from device_local image to host_visible buffer
+//=========================================================================
+// Fills in the create infos the trace recreates the staging buffer of a
+// resource with. The contents are read back through the given buffer and
+// memory of a staging block, which the trace uses the handles of.
+//=========================================================================
+StagingInfo createStagingBuffer(VkDevice device, VkCommandPool commandPool, VkCommandBuffer commandBuffer,
+                                uint32_t queueFamilyIndex, VkDeviceSize size, VkBuffer buffer, VkDeviceMemory memory) {
+    StagingInfo stagingInfo = {};
 
-            VkImageAspectFlags aspectMask = imageIter->second.ObjectInfo.Image.aspectMask;
-            if (aspectMask == (VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT)) {
-                stagingInfo.imageCopyRegions.reserve(2);
+    stagingInfo.commandPool = commandPool;
+    stagingInfo.commandBuffer = commandBuffer;
 
-                // First depth, then stencil
-                VkImageSubresource sub;
-                sub.arrayLayer = 0;
-                sub.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-                sub.mipLevel = 0;
-                {
-                    VkSubresourceLayout layout;
-                    mdd(device)->devTable.GetImageSubresourceLayout(device, image, &sub, &layout);
-
-                    VkBufferImageCopy copyRegion = {};
-
-                    copyRegion.bufferRowLength = 0;
-                    copyRegion.bufferImageHeight = 0;
-                    // On some platform, originally set to layout.rowPitch and layout.arrayPitch
-                    // cause write outside of staging buffer memory size and hang at following
-                    // queue submission in other frames after finish trim starting process when
-                    // trim some titles.
-                    //
-                    // Here we set bufferRowLength and bufferImageHeight to 0 make the image
-                    // copy to be tightly packed according to the imageExtent, the change fix
-                    // the above problem.
-                    //
-                    // Although bufferRowLength,bufferImageHeight can be set to greater than
-                    // the width and height member of imageExtent, but because we allocate memory
-                    // for the staging buffer by image memory size and here we copy whole image,
-                    // so greater than imageExtent take a risk that the copy beyond the staging
-                    // buffer memory size.
-
-                    copyRegion.bufferOffset = layout.offset;
-                    copyRegion.imageExtent.depth = 1;
-                    copyRegion.imageExtent.width = imageIter->second.ObjectInfo.Image.extent.width;
-                    copyRegion.imageExtent.height = imageIter->second.ObjectInfo.Image.extent.height;
-                    copyRegion.imageOffset.x = 0;
-                    copyRegion.imageOffset.y = 0;
-                    copyRegion.imageOffset.z = 0;
-                    copyRegion.imageSubresource.aspectMask = sub.aspectMask;
-                    copyRegion.imageSubresource.baseArrayLayer = 0;
-                    copyRegion.imageSubresource.layerCount = imageIter->second.ObjectInfo.Image.arrayLayers;
-                    copyRegion.imageSubresource.mipLevel = 0;
-
-                    stagingInfo.imageCopyRegions.push_back(copyRegion);
-                }
+    VkQueue queue = trim::get_DeviceQueue(device, queueFamilyIndex, 0);
+    stagingInfo.queue = queue;
 
-                sub.aspectMask = VK_IMAGE_ASPECT_STENCIL_BIT;
-                {
-                    VkSubresourceLayout layout;
-                    mdd(device)->devTable.GetImageSubresourceLayout(device, image, &sub, &layout);
-
-                    VkBufferImageCopy copyRegion = {};
-
-                    copyRegion.bufferRowLength = 0;
-                    copyRegion.bufferImageHeight = 0;
-                    // set bufferRowLength and bufferImageHeight to 0 make the image
-                    // copy to be tightly packed according to the imageExtent.
-
-                    copyRegion.bufferOffset = layout.offset;
-                    copyRegion.imageExtent.depth = 1;
-                    copyRegion.imageExtent.width = imageIter->second.ObjectInfo.Image.extent.width;
-                    copyRegion.imageExtent.height = imageIter->second.ObjectInfo.Image.extent.height;
-                    copyRegion.imageOffset.x = 0;
-                    copyRegion.imageOffset.y = 0;
-                    copyRegion.imageOffset.z = 0;
-                    copyRegion.imageSubresource.aspectMask = sub.aspectMask;
-                    copyRegion.imageSubresource.baseArrayLayer = 0;
-                    copyRegion.imageSubresource.layerCount = imageIter->second.ObjectInfo.Image.arrayLayers;
-                    copyRegion.imageSubresource.mipLevel = 0;
-
-                    stagingInfo.imageCopyRegions.push_back(copyRegion);
-                }
-            } else {
-                VkImageSubresource sub;
-                sub.arrayLayer = 0;
-                sub.aspectMask = aspectMask;
-                sub.mipLevel = 0;
-
-                // need to make a VkBufferImageCopy for each mip level
-                stagingInfo.imageCopyRegions.reserve(imageIter->second.ObjectInfo.Image.mipLevels);
-                for (uint32_t i = 0; i < imageIter->second.ObjectInfo.Image.mipLevels; i++) {
-                    VkSubresourceLayout lay;
-                    sub.mipLevel = i;
-                    mdd(device)->devTable.GetImageSubresourceLayout(device, image, &sub, &lay);
-
-                    VkBufferImageCopy copyRegion = {};
-                    copyRegion.bufferRowLength = 0;    //< tightly packed texels
-                    copyRegion.bufferImageHeight = 0;  //< tightly packed texels
-                    copyRegion.bufferOffset = lay.offset;
-                    copyRegion.imageExtent.depth = 1;
-                    copyRegion.imageExtent.width = (imageIter->second.ObjectInfo.Image.extent.width >> i);
-                    copyRegion.imageExtent.height = (imageIter->second.ObjectInfo.Image.extent.height >> i);
-                    copyRegion.imageOffset.x = 0;
-                    copyRegion.imageOffset.y = 0;
-                    copyRegion.imageOffset.z = 0;
-                    copyRegion.imageSubresource.aspectMask = aspectMask;
-                    copyRegion.imageSubresource.baseArrayLayer = 0;
-                    copyRegion.imageSubresource.layerCount = imageIter->second.ObjectInfo.Image.arrayLayers;
-                    copyRegion.imageSubresource.mipLevel = i;
-
-                    stagingInfo.imageCopyRegions.push_back(copyRegion);
-                }
-            }
+    stagingInfo.bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    stagingInfo.bufferCreateInfo.pNext = NULL;
+    stagingInfo.bufferCreateInfo.flags = 0;
+    stagingInfo.bufferCreateInfo.size = size;
+    stagingInfo.bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    stagingInfo.bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    stagingInfo.bufferCreateInfo.queueFamilyIndexCount = 0;
+    stagingInfo.bufferCreateInfo.pQueueFamilyIndices = NULL;
 
-            // From docs: srcImageLayout must specify the layout of the image
-            // subresources of srcImage specified in pRegions at the time this
-            // command is executed on a VkDevice
-            // From docs: srcImageLayout must be either of
-            // VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL or VK_IMAGE_LAYOUT_GENERAL
-            VkImageLayout srcImageLayout = imageIter->second.ObjectInfo.Image.mostRecentLayout;
-
-            // Transition the image so that it's in an optimal transfer source
-            // layout.
-            transitionImage(device, commandBuffer, image, imageIter->second.ObjectInfo.Image.accessFlags,
-                            imageIter->second.ObjectInfo.Image.accessFlags, queueFamilyIndex, srcImageLayout,
-                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, aspectMask, imageIter->second.ObjectInfo.Image.arrayLayers,
-                            imageIter->second.ObjectInfo.Image.mipLevels);
-
-            mdd(device)->devTable.CmdCopyImageToBuffer(
-                commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, stagingInfo.buffer,
-                static_cast<uint32_t>(stagingInfo.imageCopyRegions.size()), stagingInfo.imageCopyRegions.data());
-
-            // save the staging info for later
-            s_imageToStagedInfoMap[image] = stagingInfo;
-
-            // now that the image data is in a host-readable buffer
-            // transition image back to it's previous layout
-            transitionImage(device, commandBuffer, image, imageIter->second.ObjectInfo.Image.accessFlags,
-                            imageIter->second.ObjectInfo.Image.accessFlags, queueFamilyIndex, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                            srcImageLayout, aspectMask, imageIter->second.ObjectInfo.Image.arrayLayers,
-                            imageIter->second.ObjectInfo.Image.mipLevels);
-        } else {
-            // Create a pipeline barrier to make it host readable
-            transitionImage(device, commandBuffer, image, imageIter->second.ObjectInfo.Image.accessFlags, VK_ACCESS_HOST_READ_BIT,
-                            queueFamilyIndex, imageIter->second.ObjectInfo.Image.mostRecentLayout,
-                            imageIter->second.ObjectInfo.Image.mostRecentLayout, imageIter->second.ObjectInfo.Image.aspectMask,
-                            imageIter->second.ObjectInfo.Image.arrayLayers, imageIter->second.ObjectInfo.Image.mipLevels);
-        }
+    // The buffer is only created for its memory requirements
+    VkBuffer sizingBuffer = VK_NULL_HANDLE;
+    mdd(device)->devTable.CreateBuffer(device, &stagingInfo.bufferCreateInfo, NULL, &sizingBuffer);
+    mdd(device)->devTable.GetBufferMemoryRequirements(device, sizingBuffer, &stagingInfo.bufferMemoryRequirements);
+    mdd(device)->devTable.DestroyBuffer(device, sizingBuffer, NULL);
 
-        // End the CommandBuffer
-        mdd(device)->devTable.EndCommandBuffer(commandBuffer);
+    stagingInfo.memoryAllocationInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    stagingInfo.memoryAllocationInfo.pNext = NULL;
+    stagingInfo.memoryAllocationInfo.allocationSize = stagingInfo.bufferMemoryRequirements.size;
+    stagingInfo.memoryAllocationInfo.memoryTypeIndex =
+        FindMemoryTypeIndex(device, stagingInfo.bufferMemoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
 
-        // now submit the command buffer
-        VkSubmitInfo submitInfo = {};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.pNext = NULL;
-        submitInfo.waitSemaphoreCount = 0;
-        submitInfo.pWaitSemaphores = NULL;
-        submitInfo.pWaitDstStageMask = NULL;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
-        submitInfo.signalSemaphoreCount = 0;
-        submitInfo.pSignalSemaphores = NULL;
+    stagingInfo.buffer = buffer;
+    stagingInfo.memory = memory;
 
-        // Submit the queue and wait for it to complete
-        VkQueue queue = trim::get_DeviceQueue(device, queueFamilyIndex, 0);
+    return stagingInfo;
+}
 
-        mdd(device)->devTable.QueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
-        VkResult waitResult = mdd(device)->devTable.QueueWaitIdle(queue);
-        assert(waitResult == VK_SUCCESS);
-        if (waitResult != VK_SUCCESS) continue;
+//=========================================================================
+static void destroySnapshotStaging(VkDevice device, SnapshotBatch *pBatch) {
+    if (pBatch->buffer != VK_NULL_HANDLE) {
+        mdd(device)->devTable.DestroyBuffer(device, pBatch->buffer, NULL);
+        pBatch->buffer = VK_NULL_HANDLE;
+    }
+    if (pBatch->memory != VK_NULL_HANDLE) {
+        mdd(device)->devTable.FreeMemory(device, pBatch->memory, NULL);
+        pBatch->memory = VK_NULL_HANDLE;
+    }
+    pBatch->size = 0;
+    pBatch->pData = NULL;
+}
 
-        // 2a) Map, copy, unmap the image.
-        device = imageIter->second.belongsToDevice;
-        image = imageIter->first;
+//=========================================================================
+static bool createSnapshotStaging(VkDevice device, SnapshotBatch *pBatch, VkDeviceSize size) {
+    VkBufferCreateInfo bufferCreateInfo = {};
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.size = size;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkResult result = mdd(device)->devTable.CreateBuffer(device, &bufferCreateInfo, NULL, &pBatch->buffer);
+    if (result != VK_SUCCESS) return false;
+
+    VkMemoryRequirements memoryRequirements;
+    mdd(device)->devTable.GetBufferMemoryRequirements(device, pBatch->buffer, &memoryRequirements);
+
+    VkMemoryAllocateInfo memoryAllocateInfo = {};
+    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memoryAllocateInfo.allocationSize = memoryRequirements.size;
+    memoryAllocateInfo.memoryTypeIndex =
+        FindMemoryTypeIndex(device, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    pBatch->coherent =
+        (LookUpMemoryProperties(device, memoryAllocateInfo.memoryTypeIndex) & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+    result = mdd(device)->devTable.AllocateMemory(device, &memoryAllocateInfo, NULL, &pBatch->memory);
+    if (result == VK_SUCCESS) {
+        result = mdd(device)->devTable.BindBufferMemory(device, pBatch->buffer, pBatch->memory, 0);
+    }
+    if (result == VK_SUCCESS) {
+        result = mdd(device)->devTable.MapMemory(device, pBatch->memory, 0, VK_WHOLE_SIZE, 0, &pBatch->pData);
+    }
+    if (result != VK_SUCCESS) {
+        vktrace_LogError("Failed to create a %" PRIu64 " byte staging block for the trim snapshot.", size);
+        destroySnapshotStaging(device, pBatch);
+        return false;
+    }
+    pBatch->size = size;
+    return true;
+}
 
-        VkDeviceMemory memory = imageIter->second.ObjectInfo.Image.memory;
-        VkDeviceSize offset = imageIter->second.ObjectInfo.Image.memoryOffset;
-        VkDeviceSize size = ROUNDUP_TO_4(imageIter->second.ObjectInfo.Image.memorySize);
+//=========================================================================
+// Copies the contents of the resources of a finished batch into map /
+// unmap packets.
+//=========================================================================
+static void readbackSnapshotBatch(SnapshotQueue &queue, SnapshotBatch *pBatch) {
+    VkDevice device = queue.device;
+    VkResult waitResult = mdd(device)->devTable.WaitForFences(device, 1, &pBatch->fence, VK_TRUE, UINT64_MAX);
+    assert(waitResult == VK_SUCCESS);
+    mdd(device)->devTable.ResetFences(device, 1, &pBatch->fence);
+    pBatch->submitted = false;
+    if (waitResult != VK_SUCCESS) {
+        pBatch->items.clear();
+        return;
+    }
+
+    if (pBatch->pData != NULL && !pBatch->coherent) {
+        VkMappedMemoryRange range = {};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = pBatch->memory;
+        range.offset = 0;
+        range.size = VK_WHOLE_SIZE;
+        mdd(device)->devTable.InvalidateMappedMemoryRanges(device, 1, &range);
+    }
+
+    for (size_t i = 0; i < pBatch->items.size(); i++) {
+        const SnapshotItem &item = pBatch->items[i];
+        bool isImage = (item.image != VK_NULL_HANDLE);
+        bool needsStagingBuffer = isImage ? item.pInfo->ObjectInfo.Image.needsStagingBuffer
+                                          : item.pInfo->ObjectInfo.Buffer.needsStagingBuffer;
+        VkDeviceMemory memory = isImage ? item.pInfo->ObjectInfo.Image.memory : item.pInfo->ObjectInfo.Buffer.memory;
+        VkDeviceSize offset = isImage ? item.pInfo->ObjectInfo.Image.memoryOffset : item.pInfo->ObjectInfo.Buffer.memoryOffset;
+        VkDeviceSize size =
+            ROUNDUP_TO_4(isImage ? item.pInfo->ObjectInfo.Image.memorySize : item.pInfo->ObjectInfo.Buffer.size);
+        vktrace_trace_packet_header **ppMapMemoryPacket =
+            isImage ? &item.pInfo->ObjectInfo.Image.pMapMemoryPacket : &item.pInfo->ObjectInfo.Buffer.pMapMemoryPacket;
+        vktrace_trace_packet_header **ppUnmapMemoryPacket =
+            isImage ? &item.pInfo->ObjectInfo.Image.pUnmapMemoryPacket : &item.pInfo->ObjectInfo.Buffer.pUnmapMemoryPacket;
+
+        if (size == 0) {
+            continue;
+        }
 
-        if (imageIter->second.ObjectInfo.Image.needsStagingBuffer) {
+        if (needsStagingBuffer) {
             // Note that the staged memory object won't be in the state tracker,
-            // so we want to swap out the buffer and memory
-            // that will be mapped / unmapped.
-            StagingInfo staged = s_imageToStagedInfoMap[image];
-            memory = staged.memory;
-            offset = 0;
+            // and the trace maps the whole staging memory of the resource,
+            // which is this range of the staging block.
+            generateMapUnmap(false, device, pBatch->memory, 0, size, 0, (BYTE *)pBatch->pData + item.stagingOffset,
+                             ppMapMemoryPacket, ppUnmapMemoryPacket);
+            continue;
+        }
 
-            void *mappedAddress = NULL;
+        auto memoryIter = s_trimStateTrackerSnapshot.createdDeviceMemorys.find(memory);
+        assert(isImage || memoryIter != s_trimStateTrackerSnapshot.createdDeviceMemorys.end());
+        if (memoryIter != s_trimStateTrackerSnapshot.createdDeviceMemorys.end()) {
+            void *mappedAddress = memoryIter->second.ObjectInfo.DeviceMemory.mappedAddress;
+            VkDeviceSize mappedOffset = memoryIter->second.ObjectInfo.DeviceMemory.mappedOffset;
+            VkDeviceSize mappedSize = memoryIter->second.ObjectInfo.DeviceMemory.mappedSize;
 
-            if (size != 0) {
-                generateMapUnmap(true, device, memory, offset, size, 0, mappedAddress,
-                                 &imageIter->second.ObjectInfo.Image.pMapMemoryPacket,
-                                 &imageIter->second.ObjectInfo.Image.pUnmapMemoryPacket);
+            // actually map the memory if it was not already mapped.
+            bool bAlreadyMapped = (mappedAddress != NULL);
+            if (bAlreadyMapped) {
+                // I imagine there could be a scenario where the
+                // application has persistently
+                // mapped PART of the memory, which may not contain the
+                // resource that we're trying to copy right now.
+                // In that case, there will be errors due to this code.
+                // We know the range of memory that is mapped
+                // so we should be able to confirm whether or not we get
+                // into this situation.
+                bAlreadyMapped = (offset >= mappedOffset && (offset + size) <= (mappedOffset + mappedSize));
             }
-        } else {
-            auto memoryIter = s_trimStateTrackerSnapshot.createdDeviceMemorys.find(memory);
-
-            if (memoryIter != s_trimStateTrackerSnapshot.createdDeviceMemorys.end()) {
-                void *mappedAddress = memoryIter->second.ObjectInfo.DeviceMemory.mappedAddress;
-                VkDeviceSize mappedOffset = memoryIter->second.ObjectInfo.DeviceMemory.mappedOffset;
-                VkDeviceSize mappedSize = memoryIter->second.ObjectInfo.DeviceMemory.mappedSize;
-
-                if (size != 0) {
-                    // actually map the memory if it was not already mapped.
-                    bool bAlreadyMapped = (mappedAddress != NULL);
-                    if (bAlreadyMapped) {
-                        // I imagine there could be a scenario where the
-                        // application has persistently
-                        // mapped PART of the memory, which may not contain the
-                        // image that we're trying to copy right now.
-                        // In that case, there will be errors due to this code.
-                        // We know the range of memory that is mapped
-                        // so we should be able to confirm whether or not we get
-                        // into this situation.
-                        bAlreadyMapped = (offset >= mappedOffset && (offset + size) <= (mappedOffset + mappedSize));
-                    }
 
-                    generateMapUnmap(!bAlreadyMapped, device, memory, offset, size, 0, mappedAddress,
-                                     &imageIter->second.ObjectInfo.Image.pMapMemoryPacket,
-                                     &imageIter->second.ObjectInfo.Image.pUnmapMemoryPacket);
-                }
-            }
+            generateMapUnmap(!bAlreadyMapped, device, memory, offset, size, 0, mappedAddress, ppMapMemoryPacket,
+                             ppUnmapMemoryPacket);
         }
+        queue.restoreItems.push_back(item);
+    }
+    pBatch->items.clear();
+}
 
-        // 3a) Transition the image back to their previous state.
-        device = imageIter->second.belongsToDevice;
-        image = imageIter->first;
+//=========================================================================
+// Submits the batch being recorded, then reads back the previous batch
+// while the GPU runs this one.
+//=========================================================================
+static void submitSnapshotBatch(SnapshotQueue &queue) {
+    SnapshotBatch *pBatch = &queue.batches[queue.current];
+    VkDevice device = queue.device;
+    mdd(device)->devTable.EndCommandBuffer(pBatch->commandBuffer);
+    pBatch->recording = false;
 
-        queueFamilyIndex = imageIter->second.ObjectInfo.Image.queueFamilyIndex;
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &pBatch->commandBuffer;
+    VkResult result = mdd(device)->devTable.QueueSubmit(queue.queue, 1, &submitInfo, pBatch->fence);
+    assert(result == VK_SUCCESS);
+    if (result == VK_SUCCESS) {
+        pBatch->submitted = true;
+    } else {
+        pBatch->items.clear();
+    }
 
-        if (imageIter->second.ObjectInfo.Image.sharingMode == VK_SHARING_MODE_CONCURRENT) {
-            queueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        }
+    queue.current ^= 1;
+    if (queue.batches[queue.current].submitted) {
+        readbackSnapshotBatch(queue, &queue.batches[queue.current]);
+    }
+}
 
-        commandPool = getCommandPoolFromDevice(device, queueFamilyIndex);
-        commandBuffer = getCommandBufferFromDevice(device, commandPool);
+//=========================================================================
+static bool beginSnapshotBatch(SnapshotQueue &queue, SnapshotBatch *pBatch) {
+    VkDevice device = queue.device;
+    if (pBatch->submitted) {
+        readbackSnapshotBatch(queue, pBatch);
+    }
 
-        // Begin the command buffer
-        memset(reinterpret_cast<void *>(&commandBufferBeginInfo), 0, sizeof(VkCommandBufferBeginInfo));
-        commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        commandBufferBeginInfo.pNext = NULL;
-        commandBufferBeginInfo.pInheritanceInfo = NULL;
-        commandBufferBeginInfo.flags = 0;
-        result = mdd(device)->devTable.BeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+    if (pBatch->commandBuffer == VK_NULL_HANDLE) {
+        VkCommandBufferAllocateInfo allocateInfo = {};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocateInfo.commandPool = queue.commandPool;
+        allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocateInfo.commandBufferCount = 1;
+        VkResult result = mdd(device)->devTable.AllocateCommandBuffers(device, &allocateInfo, &pBatch->commandBuffer);
         assert(result == VK_SUCCESS);
-        if (result != VK_SUCCESS) continue;
-
-        // only need to restore the images that did NOT need a staging buffer
-        if (imageIter->second.ObjectInfo.Image.needsStagingBuffer) {
-            // delete the staging objects
-            StagingInfo staged = s_imageToStagedInfoMap[image];
-            mdd(device)->devTable.DestroyBuffer(device, staged.buffer, NULL);
-            mdd(device)->devTable.FreeMemory(device, staged.memory, NULL);
-        } else {
-            transitionImage(device, commandBuffer, image, VK_ACCESS_HOST_READ_BIT, imageIter->second.ObjectInfo.Image.accessFlags,
-                            queueFamilyIndex, imageIter->second.ObjectInfo.Image.mostRecentLayout,
-                            imageIter->second.ObjectInfo.Image.mostRecentLayout, imageIter->second.ObjectInfo.Image.aspectMask,
-                            imageIter->second.ObjectInfo.Image.arrayLayers, imageIter->second.ObjectInfo.Image.mipLevels);
+        if (result != VK_SUCCESS) {
+            pBatch->commandBuffer = VK_NULL_HANDLE;
+            return false;
         }
+    }
+    if (pBatch->fence == VK_NULL_HANDLE) {
+        VkFenceCreateInfo fenceCreateInfo = {};
+        fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkResult result = mdd(device)->devTable.CreateFence(device, &fenceCreateInfo, NULL, &pBatch->fence);
+        assert(result == VK_SUCCESS);
+        if (result != VK_SUCCESS) return false;
+    }
 
-        // End the CommandBuffer
-        mdd(device)->devTable.EndCommandBuffer(commandBuffer);
+    VkCommandBufferBeginInfo commandBufferBeginInfo = {};
+    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VkResult result = mdd(device)->devTable.BeginCommandBuffer(pBatch->commandBuffer, &commandBufferBeginInfo);
+    assert(result == VK_SUCCESS);
+    if (result != VK_SUCCESS) return false;
 
-        // now submit the command buffer
-        memset(reinterpret_cast<void *>(&submitInfo), 0, sizeof(VkSubmitInfo));
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.pNext = NULL;
-        submitInfo.waitSemaphoreCount = 0;
-        submitInfo.pWaitSemaphores = NULL;
-        submitInfo.pWaitDstStageMask = NULL;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
-        submitInfo.signalSemaphoreCount = 0;
-        submitInfo.pSignalSemaphores = NULL;
+    pBatch->used = 0;
+    pBatch->recording = true;
+    return true;
+}
 
-        // Submit the queue and wait for it to complete
-        queue = trim::get_DeviceQueue(device, queueFamilyIndex, 0);
+//=========================================================================
+// Returns the batch to record the readback of size bytes in, with a large
+// enough staging block if the resource needs a staging buffer.
+//=========================================================================
+static SnapshotBatch *getSnapshotBatch(SnapshotQueue &queue, VkDeviceSize size, bool needsStagingBuffer) {
+    SnapshotBatch *pBatch = &queue.batches[queue.current];
+    VkDeviceSize capacity = std::max(pBatch->size, TRIM_SNAPSHOT_BATCH_SIZE);
+    if (pBatch->recording && !pBatch->items.empty() && pBatch->used + size > capacity) {
+        submitSnapshotBatch(queue);
+        pBatch = &queue.batches[queue.current];
+    }
+    if (!pBatch->recording && !beginSnapshotBatch(queue, pBatch)) {
+        return NULL;
+    }
 
-        mdd(device)->devTable.QueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
-        waitResult = mdd(device)->devTable.QueueWaitIdle(queue);
-        assert(waitResult == VK_SUCCESS);
+    // The staging block is only replaced while no recorded copy uses it
+    if (needsStagingBuffer && pBatch->used + size > pBatch->size) {
+        destroySnapshotStaging(queue.device, pBatch);
+        if (!createSnapshotStaging(queue.device, pBatch, std::max(pBatch->used + size, TRIM_SNAPSHOT_BATCH_SIZE))) {
+            return NULL;
+        }
     }
+    return pBatch;
+}
 
-    // b) Dump all buffers, the process include the following sub-process:
-    //    1b) Transition the buffer into host - readable state.
-    //    2b) Map, copy, unmap the buffer.
-    //    3b) Transition the buffer back to their previous state.
-    for (auto bufferIter = s_trimStateTrackerSnapshot.createdBuffers.begin();
-         bufferIter != s_trimStateTrackerSnapshot.createdBuffers.end(); bufferIter++) {
-        VkDevice device = bufferIter->second.belongsToDevice;
-        VkBuffer buffer = static_cast<VkBuffer>(bufferIter->first);
+//=========================================================================
+static SnapshotQueue &getSnapshotQueue(std::map<std::pair<VkDevice, uint32_t>, SnapshotQueue> &queues, VkDevice device,
+                                       uint32_t queueFamilyIndex) {
+    if (queueFamilyIndex == VK_QUEUE_FAMILY_IGNORED) {
+        queueFamilyIndex = 0;
+    }
+    SnapshotQueue &queue = queues[std::make_pair(device, queueFamilyIndex)];
+    if (queue.device == VK_NULL_HANDLE) {
+        queue.device = device;
+        queue.commandPool = getCommandPoolFromDevice(device, queueFamilyIndex);
+        queue.queue = trim::get_DeviceQueue(device, queueFamilyIndex, 0);
+    }
+    return queue;
+}
 
-        // 1b) Transition the buffer into host-readable state.
+//=========================================================================
+static void recordImageSnapshot(SnapshotQueue &queue, VkImage image, ObjectInfo &info) {
+    VkDevice device = queue.device;
+    uint32_t queueFamilyIndex = info.ObjectInfo.Image.queueFamilyIndex;
 
-        uint32_t queueFamilyIndex = bufferIter->second.ObjectInfo.Buffer.queueFamilyIndex;
+    if (info.ObjectInfo.Image.sharingMode == VK_SHARING_MODE_CONCURRENT) {
+        queueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    }
 
-        VkCommandPool commandPool = getCommandPoolFromDevice(device, queueFamilyIndex);
-        VkCommandBuffer commandBuffer = getCommandBufferFromDevice(device, commandPool);
+    bool needsStagingBuffer = info.ObjectInfo.Image.needsStagingBuffer;
+    VkDeviceSize size = ROUNDUP_TO_4(info.ObjectInfo.Image.memorySize);
+    SnapshotBatch *pBatch = getSnapshotBatch(queue, size, needsStagingBuffer);
+    if (pBatch == NULL) return;
+    VkCommandBuffer commandBuffer = pBatch->commandBuffer;
 
-        // Begin the command buffer
-        VkCommandBufferBeginInfo commandBufferBeginInfo;
-        commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        commandBufferBeginInfo.pNext = NULL;
-        commandBufferBeginInfo.pInheritanceInfo = NULL;
-        commandBufferBeginInfo.flags = 0;
-        VkResult result = mdd(device)->devTable.BeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
-        assert(result == VK_SUCCESS);
-        if (result != VK_SUCCESS) continue;
-
-        // If the buffer needs a staging buffer, it's because it's on
-        // DEVICE_LOCAL memory that is not HOST_VISIBLE.
-        // So we have to create another buffer and memory that IS HOST_VISIBLE
-        // so that we can copy the data
-        // from the DEVICE_LOCAL memory into HOST_VISIBLE memory, then map /
-        // unmap the HOST_VISIBLE memory object.
-        // The staging info is kept so that we can generate similar calls in the
-        // trace file in order to recreate
-        // the DEVICE_LOCAL buffer.
-        if (bufferIter->second.ObjectInfo.Buffer.needsStagingBuffer) {
-            StagingInfo stagingInfo = createStagingBuffer(device, commandPool, commandBuffer, queueFamilyIndex,
-                                                          bufferIter->second.ObjectInfo.Buffer.size);
-
-            // Copy from device_local buffer to host_visible buffer
-            stagingInfo.copyRegion.srcOffset = 0;
-            stagingInfo.copyRegion.dstOffset = 0;
-            stagingInfo.copyRegion.size = bufferIter->second.ObjectInfo.Buffer.size;
-
-            transitionBuffer(device, commandBuffer, buffer, VK_ACCESS_FLAG_BITS_MAX_ENUM, VK_ACCESS_TRANSFER_READ_BIT, 0,
-                             bufferIter->second.ObjectInfo.Buffer.size, true);
-            mdd(device)->devTable.CmdCopyBuffer(commandBuffer, buffer, stagingInfo.buffer, 1, &stagingInfo.copyRegion);
-            transitionBuffer(device, commandBuffer, buffer, VK_ACCESS_TRANSFER_READ_BIT,
-                             bufferIter->second.ObjectInfo.Buffer.accessFlags, 0, bufferIter->second.ObjectInfo.Buffer.size, true);
-
-            // save the staging info for later
-            s_bufferToStagedInfoMap[buffer] = stagingInfo;
-        } else {
-            transitionBuffer(device, commandBuffer, buffer, bufferIter->second.ObjectInfo.Buffer.accessFlags,
-                             VK_ACCESS_HOST_READ_BIT, 0, bufferIter->second.ObjectInfo.Buffer.size);
-        }
+    SnapshotItem item = {};
+    item.image = image;
+    item.pInfo = &info;
+    item.stagingOffset = pBatch->used;
 
-        // TODO: LESS THAN IDEAL TO END & SUBMIT these super small command buffers
-        // End the CommandBuffer
-        mdd(device)->devTable.EndCommandBuffer(commandBuffer);
+    if (needsStagingBuffer) {
+        StagingInfo stagingInfo = createStagingBuffer(device, queue.commandPool, commandBuffer,
+                                                      (queueFamilyIndex == VK_QUEUE_FAMILY_IGNORED) ? 0 : queueFamilyIndex,
+                                                      info.ObjectInfo.Image.memorySize, pBatch->buffer, pBatch->memory);
 
-        // now submit the command buffer
-        VkSubmitInfo submitInfo = {};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.pNext = NULL;
-        submitInfo.waitSemaphoreCount = 0;
-        submitInfo.pWaitSemaphores = NULL;
-        submitInfo.pWaitDstStageMask = NULL;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
-        submitInfo.signalSemaphoreCount = 0;
-        submitInfo.pSignalSemaphores = NULL;
+        // From Docs: srcImage must have a sample count equal to
+        // VK_SAMPLE_COUNT_1_BIT
+        // From Docs: srcImage must have been created with
+        // VK_IMAGE_USAGE_TRANSFER_SRC_BIT usage flag
 
-        // Submit the queue and wait for it to complete
-        VkQueue queue = trim::get_DeviceQueue(device, queueFamilyIndex, 0);
+        // Copy from device_local image to host_visible buffer
 
-        mdd(device)->devTable.QueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
-        VkResult waitResult = mdd(device)->devTable.QueueWaitIdle(queue);
-        assert(waitResult == VK_SUCCESS);
-        if (waitResult != VK_SUCCESS) continue;
+        VkImageAspectFlags aspectMask = info.ObjectInfo.Image.aspectMask;
+        if (aspectMask == (VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT)) {
+            stagingInfo.imageCopyRegions.reserve(2);
 
-        // 2b) Map, copy, unmap the buffer.
+            // First depth, then stencil
+            VkImageSubresource sub;
+            sub.arrayLayer = 0;
+            sub.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+            sub.mipLevel = 0;
+            {
+                VkSubresourceLayout layout;
+                mdd(device)->devTable.GetImageSubresourceLayout(device, image, &sub, &layout);
+
+                VkBufferImageCopy copyRegion = {};
+
+                copyRegion.bufferRowLength = 0;
+                copyRegion.bufferImageHeight = 0;
+                // On some platform, originally set to layout.rowPitch and layout.arrayPitch
+                // cause write outside of staging buffer memory size and hang at following
+                // queue submission in other frames after finish trim starting process when
+                // trim some titles.
+                //
+                // Here we set bufferRowLength and bufferImageHeight to 0 make the image
+                // copy to be tightly packed according to the imageExtent, the change fix
+                // the above problem.
+                //
+                // Although bufferRowLength,bufferImageHeight can be set to greater than
+                // the width and height member of imageExtent, but because we allocate memory
+                // for the staging buffer by image memory size and here we copy whole image,
+                // so greater than imageExtent take a risk that the copy beyond the staging
+                // buffer memory size.
+
+                copyRegion.bufferOffset = layout.offset;
+                copyRegion.imageExtent.depth = 1;
+                copyRegion.imageExtent.width = info.ObjectInfo.Image.extent.width;
+                copyRegion.imageExtent.height = info.ObjectInfo.Image.extent.height;
+                copyRegion.imageOffset.x = 0;
+                copyRegion.imageOffset.y = 0;
+                copyRegion.imageOffset.z = 0;
+                copyRegion.imageSubresource.aspectMask = sub.aspectMask;
+                copyRegion.imageSubresource.baseArrayLayer = 0;
+                copyRegion.imageSubresource.layerCount = info.ObjectInfo.Image.arrayLayers;
+                copyRegion.imageSubresource.mipLevel = 0;
+
+                stagingInfo.imageCopyRegions.push_back(copyRegion);
+            }
+
+            sub.aspectMask = VK_IMAGE_ASPECT_STENCIL_BIT;
+            {
+                VkSubresourceLayout layout;
+                mdd(device)->devTable.GetImageSubresourceLayout(device, image, &sub, &layout);
+
+                VkBufferImageCopy copyRegion = {};
+
+                copyRegion.bufferRowLength = 0;
+                copyRegion.bufferImageHeight = 0;
+                // set bufferRowLength and bufferImageHeight to 0 make the image
+                // copy to be tightly packed according to the imageExtent.
+
+                copyRegion.bufferOffset = layout.offset;
+                copyRegion.imageExtent.depth = 1;
+                copyRegion.imageExtent.width = info.ObjectInfo.Image.extent.width;
+                copyRegion.imageExtent.height = info.ObjectInfo.Image.extent.height;
+                copyRegion.imageOffset.x = 0;
+                copyRegion.imageOffset.y = 0;
+                copyRegion.imageOffset.z = 0;
+                copyRegion.imageSubresource.aspectMask = sub.aspectMask;
+                copyRegion.imageSubresource.baseArrayLayer = 0;
+                copyRegion.imageSubresource.layerCount = info.ObjectInfo.Image.arrayLayers;
+                copyRegion.imageSubresource.mipLevel = 0;
+
+                stagingInfo.imageCopyRegions.push_back(copyRegion);
+            }
+        } else {
+            VkImageSubresource sub;
+            sub.arrayLayer = 0;
+            sub.aspectMask = aspectMask;
+            sub.mipLevel = 0;
+
+            // need to make a VkBufferImageCopy for each mip level
+            stagingInfo.imageCopyRegions.reserve(info.ObjectInfo.Image.mipLevels);
+            for (uint32_t i = 0; i < info.ObjectInfo.Image.mipLevels; i++) {
+                VkSubresourceLayout lay;
+                sub.mipLevel = i;
+                mdd(device)->devTable.GetImageSubresourceLayout(device, image, &sub, &lay);
+
+                VkBufferImageCopy copyRegion = {};
+                copyRegion.bufferRowLength = 0;    //< tightly packed texels
+                copyRegion.bufferImageHeight = 0;  //< tightly packed texels
+                copyRegion.bufferOffset = lay.offset;
+                copyRegion.imageExtent.depth = 1;
+                copyRegion.imageExtent.width = (info.ObjectInfo.Image.extent.width >> i);
+                copyRegion.imageExtent.height = (info.ObjectInfo.Image.extent.height >> i);
+                copyRegion.imageOffset.x = 0;
+                copyRegion.imageOffset.y = 0;
+                copyRegion.imageOffset.z = 0;
+                copyRegion.imageSubresource.aspectMask = aspectMask;
+                copyRegion.imageSubresource.baseArrayLayer = 0;
+                copyRegion.imageSubresource.layerCount = info.ObjectInfo.Image.arrayLayers;
+                copyRegion.imageSubresource.mipLevel = i;
+
+                stagingInfo.imageCopyRegions.push_back(copyRegion);
+            }
+        }
 
-        device = bufferIter->second.belongsToDevice;
-        buffer = bufferIter->first;
+        // The trace copies from the start of its own staging buffer, the
+        // snapshot from the range of the staging block.
+        std::vector<VkBufferImageCopy> blockCopyRegions = stagingInfo.imageCopyRegions;
+        for (size_t i = 0; i < blockCopyRegions.size(); i++) {
+            blockCopyRegions[i].bufferOffset += item.stagingOffset;
+        }
 
-        VkDeviceMemory memory = bufferIter->second.ObjectInfo.Buffer.memory;
-        VkDeviceSize offset = bufferIter->second.ObjectInfo.Buffer.memoryOffset;
-        VkDeviceSize size = ROUNDUP_TO_4(bufferIter->second.ObjectInfo.Buffer.size);
+        // From docs: srcImageLayout must specify the layout of the image
+        // subresources of srcImage specified in pRegions at the time this
+        // command is executed on a VkDevice
+        // From docs: srcImageLayout must be either of
+        // VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL or VK_IMAGE_LAYOUT_GENERAL
+        VkImageLayout srcImageLayout = info.ObjectInfo.Image.mostRecentLayout;
+
+        // Transition the image so that it's in an optimal transfer source
+        // layout.
+        transitionImage(device, commandBuffer, image, info.ObjectInfo.Image.accessFlags, info.ObjectInfo.Image.accessFlags,
+                        queueFamilyIndex, srcImageLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, aspectMask,
+                        info.ObjectInfo.Image.arrayLayers, info.ObjectInfo.Image.mipLevels);
+
+        mdd(device)->devTable.CmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, pBatch->buffer,
+                                                   static_cast<uint32_t>(blockCopyRegions.size()), blockCopyRegions.data());
+
+        // save the staging info for later
+        s_imageToStagedInfoMap[image] = stagingInfo;
+
+        // now that the image data is in a host-readable buffer
+        // transition image back to it's previous layout
+        transitionImage(device, commandBuffer, image, info.ObjectInfo.Image.accessFlags, info.ObjectInfo.Image.accessFlags,
+                        queueFamilyIndex, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, srcImageLayout, aspectMask,
+                        info.ObjectInfo.Image.arrayLayers, info.ObjectInfo.Image.mipLevels);
+    } else {
+        // Create a pipeline barrier to make it host readable
+        transitionImage(device, commandBuffer, image, info.ObjectInfo.Image.accessFlags, VK_ACCESS_HOST_READ_BIT, queueFamilyIndex,
+                        info.ObjectInfo.Image.mostRecentLayout, info.ObjectInfo.Image.mostRecentLayout,
+                        info.ObjectInfo.Image.aspectMask, info.ObjectInfo.Image.arrayLayers, info.ObjectInfo.Image.mipLevels);
+    }
 
-        void *mappedAddress = NULL;
-        VkDeviceSize mappedOffset = 0;
-        VkDeviceSize mappedSize = 0;
+    pBatch->items.push_back(item);
+    pBatch->used +=
+        (size + TRIM_SNAPSHOT_STAGING_ALIGNMENT - 1) / TRIM_SNAPSHOT_STAGING_ALIGNMENT * TRIM_SNAPSHOT_STAGING_ALIGNMENT;
+}
 
-        if (bufferIter->second.ObjectInfo.Buffer.needsStagingBuffer) {
-            // Note that the staged memory object won't be in the state tracker,
-            // so we want to swap out the buffer and memory
-            // that will be mapped / unmapped.
-            StagingInfo staged = s_bufferToStagedInfoMap[buffer];
-            buffer = staged.buffer;
-            memory = staged.memory;
-            offset = 0;
+//=========================================================================
+static void recordBufferSnapshot(SnapshotQueue &queue, VkBuffer buffer, ObjectInfo &info) {
+    VkDevice device = queue.device;
+    uint32_t queueFamilyIndex = info.ObjectInfo.Buffer.queueFamilyIndex;
+
+    bool needsStagingBuffer = info.ObjectInfo.Buffer.needsStagingBuffer;
+    VkDeviceSize size = ROUNDUP_TO_4(info.ObjectInfo.Buffer.size);
+    SnapshotBatch *pBatch = getSnapshotBatch(queue, size, needsStagingBuffer);
+    if (pBatch == NULL) return;
+    VkCommandBuffer commandBuffer = pBatch->commandBuffer;
+
+    SnapshotItem item = {};
+    item.buffer = buffer;
+    item.pInfo = &info;
+    item.stagingOffset = pBatch->used;
+
+    // If the buffer needs a staging buffer, it's because it's on
+    // DEVICE_LOCAL memory that is not HOST_VISIBLE.
+    // So we have to copy the data from the DEVICE_LOCAL memory into a
+    // HOST_VISIBLE staging block, then copy it out of the block.
+    // The staging info is kept so that we can generate similar calls in the
+    // trace file in order to recreate
+    // the DEVICE_LOCAL buffer.
+    if (needsStagingBuffer) {
+        StagingInfo stagingInfo = createStagingBuffer(device, queue.commandPool, commandBuffer, queueFamilyIndex,
+                                                      info.ObjectInfo.Buffer.size, pBatch->buffer, pBatch->memory);
+
+        // Copy from device_local buffer to host_visible buffer
+        stagingInfo.copyRegion.srcOffset = 0;
+        stagingInfo.copyRegion.dstOffset = 0;
+        stagingInfo.copyRegion.size = info.ObjectInfo.Buffer.size;
+
+        VkBufferCopy blockCopyRegion = stagingInfo.copyRegion;
+        blockCopyRegion.dstOffset = item.stagingOffset;
+
+        transitionBuffer(device, commandBuffer, buffer, VK_ACCESS_FLAG_BITS_MAX_ENUM, VK_ACCESS_TRANSFER_READ_BIT, 0,
+                         info.ObjectInfo.Buffer.size, true);
+        mdd(device)->devTable.CmdCopyBuffer(commandBuffer, buffer, pBatch->buffer, 1, &blockCopyRegion);
+        transitionBuffer(device, commandBuffer, buffer, VK_ACCESS_TRANSFER_READ_BIT, info.ObjectInfo.Buffer.accessFlags, 0,
+                         info.ObjectInfo.Buffer.size, true);
+
+        // save the staging info for later
+        s_bufferToStagedInfoMap[buffer] = stagingInfo;
+    } else {
+        transitionBuffer(device, commandBuffer, buffer, info.ObjectInfo.Buffer.accessFlags, VK_ACCESS_HOST_READ_BIT, 0,
+                         info.ObjectInfo.Buffer.size);
+    }
+
+    pBatch->items.push_back(item);
+    pBatch->used +=
+        (size + TRIM_SNAPSHOT_STAGING_ALIGNMENT - 1) / TRIM_SNAPSHOT_STAGING_ALIGNMENT * TRIM_SNAPSHOT_STAGING_ALIGNMENT;
+}
+
+//=========================================================================
+// Submits and reads back the last batches, transitions the resources read
+// back without a staging buffer back to their previous state and destroys
+// the batches.
+//=========================================================================
+static void finishSnapshotQueue(SnapshotQueue &queue) {
+    VkDevice device = queue.device;
+    if (queue.batches[queue.current].recording) {
+        if (queue.batches[queue.current].items.empty()) {
+            mdd(device)->devTable.EndCommandBuffer(queue.batches[queue.current].commandBuffer);
+            queue.batches[queue.current].recording = false;
         } else {
-            auto memoryIter = s_trimStateTrackerSnapshot.createdDeviceMemorys.find(memory);
-            assert(memoryIter != s_trimStateTrackerSnapshot.createdDeviceMemorys.end());
-            if (memoryIter != s_trimStateTrackerSnapshot.createdDeviceMemorys.end()) {
-                mappedAddress = memoryIter->second.ObjectInfo.DeviceMemory.mappedAddress;
-                mappedOffset = memoryIter->second.ObjectInfo.DeviceMemory.mappedOffset;
-                mappedSize = memoryIter->second.ObjectInfo.DeviceMemory.mappedSize;
-            }
+            submitSnapshotBatch(queue);
+        }
+    }
+    for (uint32_t i = 0; i < 2; i++) {
+        if (queue.batches[i].submitted) {
+            readbackSnapshotBatch(queue, &queue.batches[i]);
         }
+    }
 
-        if (size != 0) {
-            // actually map the memory if it was not already mapped.
-            bool bAlreadyMapped = (mappedAddress != NULL);
-            if (bAlreadyMapped) {
-                // I imagine there could be a scenario where the application has
-                // persistently
-                // mapped PART of the memory, which may not contain the image
-                // that we're trying to copy right now.
-                // In that case, there will be errors due to this code. We know
-                // the range of memory that is mapped
-                // so we should be able to confirm whether or not we get into
-                // this situation.
-                bAlreadyMapped = (offset >= mappedOffset && (offset + size) <= (mappedOffset + mappedSize));
+    if (!queue.restoreItems.empty() && beginSnapshotBatch(queue, &queue.batches[0])) {
+        VkCommandBuffer commandBuffer = queue.batches[0].commandBuffer;
+        for (size_t i = 0; i < queue.restoreItems.size(); i++) {
+            const SnapshotItem &item = queue.restoreItems[i];
+            if (item.image != VK_NULL_HANDLE) {
+                uint32_t queueFamilyIndex = item.pInfo->ObjectInfo.Image.queueFamilyIndex;
+                if (item.pInfo->ObjectInfo.Image.sharingMode == VK_SHARING_MODE_CONCURRENT) {
+                    queueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                }
+                transitionImage(device, commandBuffer, item.image, VK_ACCESS_HOST_READ_BIT,
+                                item.pInfo->ObjectInfo.Image.accessFlags, queueFamilyIndex,
+                                item.pInfo->ObjectInfo.Image.mostRecentLayout, item.pInfo->ObjectInfo.Image.mostRecentLayout,
+                                item.pInfo->ObjectInfo.Image.aspectMask, item.pInfo->ObjectInfo.Image.arrayLayers,
+                                item.pInfo->ObjectInfo.Image.mipLevels);
+            } else {
+                transitionBuffer(device, commandBuffer, item.buffer, VK_ACCESS_HOST_READ_BIT,
+                                 item.pInfo->ObjectInfo.Buffer.accessFlags, 0, item.pInfo->ObjectInfo.Buffer.size);
             }
+        }
+        mdd(device)->devTable.EndCommandBuffer(commandBuffer);
+        queue.batches[0].recording = false;
 
-            generateMapUnmap(!bAlreadyMapped, device, memory, offset, size, 0, mappedAddress,
-                             &bufferIter->second.ObjectInfo.Buffer.pMapMemoryPacket,
-                             &bufferIter->second.ObjectInfo.Buffer.pUnmapMemoryPacket);
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        VkResult result = mdd(device)->devTable.QueueSubmit(queue.queue, 1, &submitInfo, queue.batches[0].fence);
+        assert(result == VK_SUCCESS);
+        if (result == VK_SUCCESS) {
+            mdd(device)->devTable.WaitForFences(device, 1, &queue.batches[0].fence, VK_TRUE, UINT64_MAX);
         }
+    }
+    queue.restoreItems.clear();
 
-        // 3b) Transition the buffer back to their previous state.
-
-        device = bufferIter->second.belongsToDevice;
-        buffer = static_cast<VkBuffer>(bufferIter->first);
+    for (uint32_t i = 0; i < 2; i++) {
+        SnapshotBatch *pBatch = &queue.batches[i];
+        destroySnapshotStaging(device, pBatch);
+        if (pBatch->fence != VK_NULL_HANDLE) {
+            mdd(device)->devTable.DestroyFence(device, pBatch->fence, NULL);
+        }
+        if (pBatch->commandBuffer != VK_NULL_HANDLE) {
+            mdd(device)->devTable.FreeCommandBuffers(device, queue.commandPool, 1, &pBatch->commandBuffer);
+        }
+    }
+}
 
-        queueFamilyIndex = bufferIter->second.ObjectInfo.Buffer.queueFamilyIndex;
+//=============================================================================
+// Use this to snapshot the global state tracker at the start of the trim
+// frames.
+//=============================================================================
+void snapshot_state_tracker() {
+    vktrace_enter_critical_section(&trimStateTrackerLock);
+    s_trimStateTrackerSnapshot = s_trimGlobalStateTracker;
 
-        commandPool = getCommandPoolFromDevice(device, queueFamilyIndex);
-        commandBuffer = getCommandBufferFromDevice(device, commandPool);
+    //
+    // Copying all the resources is a length process, it include the
+    // following sub-processes, done in batches per device and queue family:
+    //
+    // for (any image and buffer in all tracked images and buffers)
+    // {
+    //    1) Transition the resource into host - readable state, or copy it
+    //       into a range of a host-visible staging block.
+    //    2) Once the batch is done on the GPU, and while the next batch
+    //       runs, map, copy, unmap the resource.
+    // }
+    //
+    // 3) Transition the resources back to their previous state.
+    // 4) Destroy the command pools, command buffers, and fences.
+    //
+    // Please note: staging memory is allocated as two blocks per queue
+    // family rather than per resource. Some driver has limitation on the
+    // max GPU memory allocations, and some title with heavily
+    // sub-allocation behavior would otherwise need a large number of
+    // staging allocations at once, beyond driver limitation.
+    std::map<std::pair<VkDevice, uint32_t>, SnapshotQueue> snapshotQueues;
+
+    // a) dump all images
+    for (auto imageIter = s_trimStateTrackerSnapshot.createdImages.begin();
+         imageIter != s_trimStateTrackerSnapshot.createdImages.end(); imageIter++) {
+        VkDevice device = imageIter->second.belongsToDevice;
+        VkImage image = imageIter->first;
 
-        // Begin the command buffer
-        memset(reinterpret_cast<void *>(&commandBufferBeginInfo), 0, sizeof(VkCommandBufferBeginInfo));
-        commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        commandBufferBeginInfo.pNext = NULL;
-        commandBufferBeginInfo.pInheritanceInfo = NULL;
-        commandBufferBeginInfo.flags = 0;
-        result = mdd(device)->devTable.BeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
-        assert(result == VK_SUCCESS);
-        if (result != VK_SUCCESS) continue;
-
-        if (bufferIter->second.ObjectInfo.Buffer.needsStagingBuffer) {
-            // if this buffer had a staging buffer, then we only need to do
-            // delete the staging objects
-            StagingInfo staged = s_bufferToStagedInfoMap[buffer];
-            mdd(device)->devTable.DestroyBuffer(device, staged.buffer, NULL);
-            mdd(device)->devTable.FreeMemory(device, staged.memory, NULL);
-        } else {
-            transitionBuffer(device, commandBuffer, buffer, VK_ACCESS_HOST_READ_BIT,
-                             bufferIter->second.ObjectInfo.Buffer.accessFlags, 0, bufferIter->second.ObjectInfo.Buffer.size);
+        if (device == VK_NULL_HANDLE) {
+            // this is likely a swapchain image which we haven't associated a
+            // device to, just skip over it.
+            continue;
         }
 
-        // End the CommandBuffer
-        mdd(device)->devTable.EndCommandBuffer(commandBuffer);
+        SnapshotQueue &queue = getSnapshotQueue(snapshotQueues, device, imageIter->second.ObjectInfo.Image.queueFamilyIndex);
+        recordImageSnapshot(queue, image, imageIter->second);
+    }
 
-        // now submit the command buffer
-        memset(reinterpret_cast<void *>(&submitInfo), 0, sizeof(VkSubmitInfo));
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.pNext = NULL;
-        submitInfo.waitSemaphoreCount = 0;
-        submitInfo.pWaitSemaphores = NULL;
-        submitInfo.pWaitDstStageMask = NULL;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
-        submitInfo.signalSemaphoreCount = 0;
-        submitInfo.pSignalSemaphores = NULL;
+    // b) Dump all buffers
+    for (auto bufferIter = s_trimStateTrackerSnapshot.createdBuffers.begin();
+         bufferIter != s_trimStateTrackerSnapshot.createdBuffers.end(); bufferIter++) {
+        VkDevice device = bufferIter->second.belongsToDevice;
+        VkBuffer buffer = static_cast<VkBuffer>(bufferIter->first);
 
-        // Submit the queue and wait for it to complete
-        queue = trim::get_DeviceQueue(device, queueFamilyIndex, 0);
+        SnapshotQueue &queue = getSnapshotQueue(snapshotQueues, device, bufferIter->second.ObjectInfo.Buffer.queueFamilyIndex);
+        recordBufferSnapshot(queue, buffer, bufferIter->second);
+    }
 
-        mdd(device)->devTable.QueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
-        waitResult = mdd(device)->devTable.QueueWaitIdle(queue);
-        assert(waitResult == VK_SUCCESS);
+    // 3) Read back the last batches and transition the resources back
+    for (auto queueIter = snapshotQueues.begin(); queueIter != snapshotQueues.end(); queueIter++) {
+        finishSnapshotQueue(queueIter->second);
     }
-    // 4) Destroy the command pools / command buffers and fences
+
+    // 4) Destroy the command pools of every queue family used, which frees
+    // their command buffers
     for (auto deviceIter = s_trimStateTrackerSnapshot.createdDevices.begin();
          deviceIter != s_trimStateTrackerSnapshot.createdDevices.end(); deviceIter++) {
         VkDevice device = reinterpret_cast<VkDevice>(deviceIter->first);
-        VkCommandBuffer commandBuffer = getCommandBufferFromDevice(device);
-
-        mdd(device)->devTable.ResetCommandBuffer(commandBuffer, VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT);
-        s_deviceToCommandBufferMap.erase(device);
-
-        // command pools
-        VkCommandPool commandPool = getCommandPoolFromDevice(device);
-        mdd(device)->devTable.ResetCommandPool(device, commandPool, VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT);
-        mdd(device)->devTable.DestroyCommandPool(device, commandPool, NULL);
-        s_deviceToCommandPoolMap.erase(device);
-    }
-
-    // Now: generate a vkMapMemory to recreate the persistently mapped buffers
-    for (auto iter = s_trimStateTrackerSnapshot.createdDeviceMemorys.begin();
-         iter != s_trimStateTrackerSnapshot.createdDeviceMemorys.end(); iter++) {
-        // if the application still has this memory mapped, then we need to make
-        // sure the trim trace file leaves it mapped, so let's generate one more
-        // call to vkMapBuffer.
-        bool bCurrentlyMapped = (iter->second.ObjectInfo.DeviceMemory.mappedAddress != NULL);
-        if (bCurrentlyMapped) {
-            VkDevice device = iter->second.belongsToDevice;
-            VkDeviceMemory deviceMemory = iter->first;
-            VkDeviceSize offset = 0;
-            VkDeviceSize size = ROUNDUP_TO_4(iter->second.ObjectInfo.DeviceMemory.size);
-            VkMemoryMapFlags flags = 0;
-            void *pData = iter->second.ObjectInfo.DeviceMemory.mappedAddress;
 
-            if (size != 0) {
-                vktrace_trace_packet_header *pPersistentlyMapMemory =
-                    generate::vkMapMemory(false, device, deviceMemory, offset, size, flags, &pData);
-                iter->second.ObjectInfo.DeviceMemory.pPersistentlyMapMemoryPacket = pPersistentlyMapMemory;
+        auto commandPoolsIter = s_deviceToCommandPoolMap.find(device);
+        if (commandPoolsIter != s_deviceToCommandPoolMap.end()) {
+            for (auto poolIter = commandPoolsIter->second.begin(); poolIter != commandPoolsIter->second.end(); poolIter++) {
+                mdd(device)->devTable.DestroyCommandPool(device, poolIter->second, NULL);
             }
+            s_deviceToCommandPoolMap.erase(commandPoolsIter);
         }
     }
 
+    // Now: generate a vkMapMemory to recreate the persistently mapped buffers
+    generatePersistentMapPackets(s_trimStateTrackerSnapshot);
+
     vktrace_leave_critical_section(&trimStateTrackerLock);
 }
 
+
 //=========================================================================
-void add_Image_call(vktrace_trace_packet_header *pHeader) {
+void add_Image_call(VkImage image, vktrace_trace_packet_header *pHeader) {
     if (pHeader != NULL) {
         vktrace_enter_critical_section(&trimStateTrackerLock);
-        s_trimGlobalStateTracker.add_Image_call(pHeader);
+        s_trimGlobalStateTracker.add_Image_call(image, pHeader);
         vktrace_leave_critical_section(&trimStateTrackerLock);
     }
 }
 
+//=========================================================================
+void remove_Image_calls(VkImage image) {
+    vktrace_enter_critical_section(&trimStateTrackerLock);
+    s_trimGlobalStateTracker.remove_Image_calls(image);
+    vktrace_leave_critical_section(&trimStateTrackerLock);
+}
+
 //=========================================================================
 ObjectInfo &add_Instance_object(VkInstance var) {
     vktrace_enter_critical_section(&trimStateTrackerLock);
@@ -2666,6 +3043,264 @@ TRIM_MARK_OBJECT_REFERENCE_WITH_DEVICE_DEPENDENCY(PipelineLayout)
 TRIM_MARK_OBJECT_REFERENCE_WITH_DEVICE_DEPENDENCY(Sampler)
 TRIM_MARK_OBJECT_REFERENCE_WITH_DEVICE_DEPENDENCY(DescriptorSetLayout)
 
+//=========================================================================
+// The trace recreates the contents of resources in batches too: resources
+// of one device and queue family that need a staging buffer get a range of
+// one staging buffer of the batch, and their copies and layout transitions
+// are recorded into one command buffer, so replay submits and waits once per
+// batch instead of once per resource. Each batch is created, submitted and
+// destroyed before the next one, so batches reuse the handles of the
+// snapshot's staging blocks.
+//=========================================================================
+struct TraceUploadItem {
+    VkImage image;
+    VkBuffer buffer;
+    ObjectInfo *pInfo;
+    VkDeviceSize stagingOffset;
+};
+
+struct TraceUploadBatch {
+    VkDevice device = VK_NULL_HANDLE;
+    uint32_t queueFamilyIndex = 0;
+    // Create infos and handles of the first resource with a staging buffer,
+    // sized for the whole batch when it is written
+    StagingInfo stagingInfo;
+    bool staged = false;
+    VkDeviceSize used = 0;
+    std::vector<TraceUploadItem> items;
+};
+
+typedef std::map<std::pair<VkDevice, uint32_t>, TraceUploadBatch> TraceUploadBatches;
+
+static void writeTracePacket(vktrace_trace_packet_header *pHeader) {
+    vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
+    vktrace_delete_trace_packet(&pHeader);
+}
+
+// Writes the map / unmap packets of a resource's staged contents so they
+// fill its range of the batch's staging memory.
+static void writeStagedContents(const TraceUploadBatch &batch, const TraceUploadItem &item,
+                                vktrace_trace_packet_header **ppMapMemoryPacket,
+                                vktrace_trace_packet_header **ppUnmapMemoryPacket) {
+    if (*ppMapMemoryPacket != NULL) {
+        // Only plain members are changed, the packet's pointers stay finalized
+        packet_vkMapMemory *pMapMemory = (packet_vkMapMemory *)(*ppMapMemoryPacket)->pBody;
+        pMapMemory->memory = batch.stagingInfo.memory;
+        pMapMemory->offset = item.stagingOffset;
+        vktrace_write_trace_packet(*ppMapMemoryPacket, vktrace_trace_get_trace_file());
+        vktrace_delete_trace_packet(ppMapMemoryPacket);
+    }
+    if (*ppUnmapMemoryPacket != NULL) {
+        packet_vkUnmapMemory *pUnmapMemory = (packet_vkUnmapMemory *)(*ppUnmapMemoryPacket)->pBody;
+        pUnmapMemory->memory = batch.stagingInfo.memory;
+        vktrace_write_trace_packet(*ppUnmapMemoryPacket, vktrace_trace_get_trace_file());
+        vktrace_delete_trace_packet(ppUnmapMemoryPacket);
+    }
+}
+
+// Records the barrier that moves an image read back without a staging buffer
+// from its initial layout to its most recent one.
+static void generateRestoreImageLayout(VkDevice device, VkCommandBuffer commandBuffer, VkImage image, ObjectInfo &info) {
+    VkImageLayout initialLayout = info.ObjectInfo.Image.initialLayout;
+    VkImageLayout desiredLayout = info.ObjectInfo.Image.mostRecentLayout;
+    uint32_t queueFamilyIndex = info.ObjectInfo.Image.queueFamilyIndex;
+    if (info.ObjectInfo.Image.sharingMode == VK_SHARING_MODE_CONCURRENT) {
+        queueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    }
+    uint32_t srcAccessMask = (initialLayout == VK_IMAGE_LAYOUT_PREINITIALIZED) ? VK_ACCESS_HOST_WRITE_BIT : 0;
+    VkImageAspectFlags aspectMask = getImageAspectFromFormat(info.ObjectInfo.Image.format);
+
+    VkImageMemoryBarrier imageMemoryBarrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                                               NULL,
+                                               srcAccessMask,
+                                               0,  // dstAccessMask, determined below
+                                               initialLayout,
+                                               desiredLayout,
+                                               queueFamilyIndex,
+                                               queueFamilyIndex,
+                                               image,
+                                               {aspectMask, 0, info.ObjectInfo.Image.mipLevels, 0,
+                                                info.ObjectInfo.Image.arrayLayers}};
+
+    if (desiredLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+        /* Make sure anything that was copying from this image has
+         * completed */
+        imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    }
+
+    if (desiredLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) {
+        imageMemoryBarrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    }
+
+    if (desiredLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
+        imageMemoryBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    }
+
+    if (desiredLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+        /* Make sure any Copy or CPU writes to image are flushed */
+        imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+    }
+
+    writeTracePacket(generate::vkCmdPipelineBarrier(false, commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, 0, NULL, 0, NULL, 1,
+                                                    &imageMemoryBarrier));
+}
+
+// Writes the calls that recreate the contents of a batch's resources and
+// empties it.
+static void writeTraceUploadBatch(TraceUploadBatch &batch) {
+    if (batch.items.empty()) return;
+    VkDevice device = batch.device;
+    StagingInfo &stagingInfo = batch.stagingInfo;
+
+    if (batch.staged) {
+        // Size the staging buffer and its memory for every range of the batch
+        stagingInfo.bufferCreateInfo.size = batch.used;
+        stagingInfo.bufferCreateInfo.usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        VkBuffer sizingBuffer = VK_NULL_HANDLE;
+        mdd(device)->devTable.CreateBuffer(device, &stagingInfo.bufferCreateInfo, NULL, &sizingBuffer);
+        mdd(device)->devTable.GetBufferMemoryRequirements(device, sizingBuffer, &stagingInfo.bufferMemoryRequirements);
+        mdd(device)->devTable.DestroyBuffer(device, sizingBuffer, NULL);
+        stagingInfo.memoryAllocationInfo.allocationSize = stagingInfo.bufferMemoryRequirements.size;
+        stagingInfo.memoryAllocationInfo.memoryTypeIndex = FindMemoryTypeIndex(
+            device, stagingInfo.bufferMemoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        generateCreateStagingBuffer(device, stagingInfo);
+
+        for (size_t i = 0; i < batch.items.size(); i++) {
+            TraceUploadItem &item = batch.items[i];
+            if (item.image != VK_NULL_HANDLE && item.pInfo->ObjectInfo.Image.needsStagingBuffer) {
+                writeStagedContents(batch, item, &item.pInfo->ObjectInfo.Image.pMapMemoryPacket,
+                                    &item.pInfo->ObjectInfo.Image.pUnmapMemoryPacket);
+            } else if (item.buffer != VK_NULL_HANDLE) {
+                writeStagedContents(batch, item, &item.pInfo->ObjectInfo.Buffer.pMapMemoryPacket,
+                                    &item.pInfo->ObjectInfo.Buffer.pUnmapMemoryPacket);
+            }
+        }
+    }
+
+    // Arbitrarily named handles, replaced at replay time like any other
+    uint64_t cmdPoolUint = 0xAAAAAAAA;
+    VkCommandPool commandPool = (VkCommandPool)cmdPoolUint;
+    uint64_t cmdBufferUint = 0xBBBBBBBB;
+    VkCommandBuffer commandBuffer = (VkCommandBuffer)cmdBufferUint;
+
+    const VkCommandPoolCreateInfo cmdPoolCreateInfo = {
+        VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, NULL,
+        VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, batch.queueFamilyIndex};
+    writeTracePacket(generate::vkCreateCommandPool(false, device, &cmdPoolCreateInfo, NULL, &commandPool));
+
+    const VkCommandBufferAllocateInfo cmdBufferAllocInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, NULL, commandPool,
+                                                            VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1};
+    writeTracePacket(generate::vkAllocateCommandBuffers(false, device, &cmdBufferAllocInfo, &commandBuffer));
+
+    VkCommandBufferBeginInfo cmdBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL, 0, NULL};
+    writeTracePacket(generate::vkBeginCommandBuffer(false, commandBuffer, &cmdBufferBeginInfo));
+
+    for (size_t i = 0; i < batch.items.size(); i++) {
+        const TraceUploadItem &item = batch.items[i];
+        ObjectInfo &info = *item.pInfo;
+        if (item.buffer != VK_NULL_HANDLE) {
+            // Transition Buffer to be writeable
+            generateTransitionBuffer(device, commandBuffer, item.buffer, 0, VK_ACCESS_TRANSFER_WRITE_BIT, 0,
+                                     info.ObjectInfo.Buffer.size);
+
+            VkBufferCopy copyRegion = s_bufferToStagedInfoMap[item.buffer].copyRegion;
+            copyRegion.srcOffset = item.stagingOffset;
+            copyRegion.dstOffset = 0;
+            writeTracePacket(
+                generate::vkCmdCopyBuffer(false, commandBuffer, stagingInfo.buffer, item.buffer, 1, &copyRegion));
+
+            // transition buffer to final access mask
+            generateTransitionBuffer(device, commandBuffer, item.buffer, VK_ACCESS_TRANSFER_WRITE_BIT,
+                                     info.ObjectInfo.Buffer.accessFlags, 0, info.ObjectInfo.Buffer.size);
+        } else if (info.ObjectInfo.Image.needsStagingBuffer) {
+            uint32_t queueFamilyIndex = info.ObjectInfo.Image.queueFamilyIndex;
+            if (info.ObjectInfo.Image.sharingMode == VK_SHARING_MODE_CONCURRENT) {
+                queueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            }
+
+            // Transition image to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+            generateTransitionImage(device, commandBuffer, item.image, 0, VK_ACCESS_TRANSFER_WRITE_BIT, queueFamilyIndex,
+                                    VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                    info.ObjectInfo.Image.aspectMask, info.ObjectInfo.Image.arrayLayers,
+                                    info.ObjectInfo.Image.mipLevels);
+
+            // The regions copy from the start of the resource's own range
+            std::vector<VkBufferImageCopy> copyRegions = s_imageToStagedInfoMap[item.image].imageCopyRegions;
+            for (size_t j = 0; j < copyRegions.size(); j++) {
+                copyRegions[j].bufferOffset += item.stagingOffset;
+            }
+            writeTracePacket(generate::vkCmdCopyBufferToImage(false, commandBuffer, stagingInfo.buffer, item.image,
+                                                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                                              static_cast<uint32_t>(copyRegions.size()), copyRegions.data()));
+
+            // transition image to final layout
+            generateTransitionImage(device, commandBuffer, item.image, VK_ACCESS_TRANSFER_WRITE_BIT,
+                                    info.ObjectInfo.Image.accessFlags, queueFamilyIndex, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                    info.ObjectInfo.Image.mostRecentLayout, info.ObjectInfo.Image.aspectMask,
+                                    info.ObjectInfo.Image.arrayLayers, info.ObjectInfo.Image.mipLevels);
+        } else {
+            generateRestoreImageLayout(device, commandBuffer, item.image, info);
+        }
+    }
+
+    writeTracePacket(generate::vkEndCommandBuffer(false, commandBuffer));
+
+    // just using the first queue of the family, we don't yet verify if this
+    // even exists, just assuming.
+    VkQueue queue = trim::get_DeviceQueue(device, batch.queueFamilyIndex, 0);
+    VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO, NULL, 0, NULL, NULL, 1, &commandBuffer, 0, NULL};
+    writeTracePacket(generate::vkQueueSubmit(false, queue, 1, &submitInfo, VK_NULL_HANDLE));
+    writeTracePacket(generate::vkQueueWaitIdle(false, queue));
+
+    if (batch.staged) {
+        generateDestroyStagingBuffer(device, stagingInfo);
+    }
+    writeTracePacket(generate::vkFreeCommandBuffers(false, device, commandPool, 1, &commandBuffer));
+    writeTracePacket(generate::vkDestroyCommandPool(false, device, commandPool, NULL));
+
+    batch.staged = false;
+    batch.used = 0;
+    batch.items.clear();
+}
+
+// Adds a resource to the batch of its device and queue family, writing the
+// batch first if the resource's staged contents don't fit in it.
+static void addTraceUpload(TraceUploadBatches &batches, VkDevice device, uint32_t queueFamilyIndex, VkImage image,
+                           VkBuffer buffer, ObjectInfo &info) {
+    TraceUploadBatch &batch = batches[std::make_pair(device, queueFamilyIndex)];
+    batch.device = device;
+    batch.queueFamilyIndex = queueFamilyIndex;
+
+    TraceUploadItem item = {image, buffer, &info, 0};
+    bool needsStagingBuffer =
+        (image != VK_NULL_HANDLE) ? info.ObjectInfo.Image.needsStagingBuffer : info.ObjectInfo.Buffer.needsStagingBuffer;
+    if (needsStagingBuffer) {
+        const StagingInfo &stagingInfo =
+            (image != VK_NULL_HANDLE) ? s_imageToStagedInfoMap[image] : s_bufferToStagedInfoMap[buffer];
+        // The unmap packets hold the size rounded up to 4 bytes
+        VkDeviceSize size = ROUNDUP_TO_4(stagingInfo.bufferCreateInfo.size);
+        if (batch.staged && batch.used + size > TRIM_SNAPSHOT_BATCH_SIZE) {
+            writeTraceUploadBatch(batch);
+        }
+        if (!batch.staged) {
+            batch.stagingInfo = stagingInfo;
+            batch.staged = true;
+        }
+        item.stagingOffset = batch.used;
+        batch.used += (size + TRIM_SNAPSHOT_STAGING_ALIGNMENT - 1) / TRIM_SNAPSHOT_STAGING_ALIGNMENT *
+                      TRIM_SNAPSHOT_STAGING_ALIGNMENT;
+    }
+    batch.items.push_back(item);
+}
+
+static void writeTraceUploadBatches(TraceUploadBatches &batches) {
+    for (auto iter = batches.begin(); iter != batches.end(); iter++) {
+        writeTraceUploadBatch(iter->second);
+    }
+    batches.clear();
+}
+
 //=========================================================================
 // Recreate all objects
 //=========================================================================
@@ -2906,6 +3541,7 @@ void write_all_referenced_object_calls() {
     }
 
     vktrace_LogDebug("Recreating Images.");
+    TraceUploadBatches uploadBatches;
     for (auto obj = stateTracker.createdImages.begin(); obj != stateTracker.createdImages.end(); obj++) {
         VkImage image = obj->first;
         VkDevice device = obj->second.belongsToDevice;
@@ -2919,272 +3555,14 @@ void write_all_referenced_object_calls() {
             continue;
         }
 
-        uint32_t queueFamilyIndex = obj->second.ObjectInfo.Image.queueFamilyIndex;
-        if (obj->second.ObjectInfo.Image.sharingMode == VK_SHARING_MODE_CONCURRENT) {
-            queueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        }
-
-        if (obj->second.ObjectInfo.Image.needsStagingBuffer) {
-            // make a staging buffer and copy the data into the image (similar
-            // to what we do for buffers)
-            StagingInfo stagingInfo = s_imageToStagedInfoMap[image];
-            stagingInfo.bufferCreateInfo.usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-
-            // generate packets needed to create a staging buffer
-            generateCreateStagingBuffer(device, stagingInfo);
-
-            // here's where we map / unmap to insert data into the buffer
-            {
-                // write map / unmap packets so the memory contents gets set on
-                // replay
-                if (obj->second.ObjectInfo.Image.pMapMemoryPacket != NULL) {
-                    vktrace_write_trace_packet(obj->second.ObjectInfo.Image.pMapMemoryPacket, vktrace_trace_get_trace_file());
-                    vktrace_delete_trace_packet(&(obj->second.ObjectInfo.Image.pMapMemoryPacket));
-                }
-
-                if (obj->second.ObjectInfo.Image.pUnmapMemoryPacket != NULL) {
-                    vktrace_write_trace_packet(obj->second.ObjectInfo.Image.pUnmapMemoryPacket, vktrace_trace_get_trace_file());
-                    vktrace_delete_trace_packet(&(obj->second.ObjectInfo.Image.pUnmapMemoryPacket));
-                }
-            }
-
-            const VkCommandPoolCreateInfo cmdPoolCreateInfo = {
-                VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, NULL,
-                VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-                obj->second.ObjectInfo.Image.queueFamilyIndex};
-            vktrace_trace_packet_header *pCreateCommandPoolPacket =
-                generate::vkCreateCommandPool(false, device, &cmdPoolCreateInfo, NULL, &stagingInfo.commandPool);
-            vktrace_write_trace_packet(pCreateCommandPoolPacket, vktrace_trace_get_trace_file());
-            vktrace_delete_trace_packet(&pCreateCommandPoolPacket);
-
-            // create command buffer
-            VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
-            commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-            commandBufferAllocateInfo.pNext = NULL;
-            commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-            commandBufferAllocateInfo.commandBufferCount = 1;
-            commandBufferAllocateInfo.commandPool = stagingInfo.commandPool;
-
-            vktrace_trace_packet_header *pHeader =
-                generate::vkAllocateCommandBuffers(false, device, &commandBufferAllocateInfo, &stagingInfo.commandBuffer);
-            vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
-            vktrace_delete_trace_packet(&pHeader);
-
-            VkCommandBufferBeginInfo commandBufferBeginInfo;
-            commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            commandBufferBeginInfo.pNext = NULL;
-            commandBufferBeginInfo.flags = 0;
-            commandBufferBeginInfo.pInheritanceInfo = NULL;
-
-            pHeader = generate::vkBeginCommandBuffer(false, stagingInfo.commandBuffer, &commandBufferBeginInfo);
-            vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
-            vktrace_delete_trace_packet(&pHeader);
-
-            // Transition image to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-            generateTransitionImage(device, stagingInfo.commandBuffer, image, 0, VK_ACCESS_TRANSFER_WRITE_BIT, queueFamilyIndex,
-                                    VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                    obj->second.ObjectInfo.Image.aspectMask, obj->second.ObjectInfo.Image.arrayLayers,
-                                    obj->second.ObjectInfo.Image.mipLevels);
-
-            // issue call to copy buffer
-            pHeader = generate::vkCmdCopyBufferToImage(
-                false, stagingInfo.commandBuffer, stagingInfo.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                static_cast<uint32_t>(stagingInfo.imageCopyRegions.size()), stagingInfo.imageCopyRegions.data());
-            vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
-            vktrace_delete_trace_packet(&pHeader);
-
-            // transition image to final layout
-            generateTransitionImage(device, stagingInfo.commandBuffer, image, VK_ACCESS_TRANSFER_WRITE_BIT,
-                                    obj->second.ObjectInfo.Image.accessFlags, queueFamilyIndex,
-                                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, obj->second.ObjectInfo.Image.mostRecentLayout,
-                                    obj->second.ObjectInfo.Image.aspectMask, obj->second.ObjectInfo.Image.arrayLayers,
-                                    obj->second.ObjectInfo.Image.mipLevels);
-
-            pHeader = generate::vkEndCommandBuffer(false, stagingInfo.commandBuffer);
-            vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
-            vktrace_delete_trace_packet(&pHeader);
-
-            // Queue submit the command buffer
-            VkSubmitInfo submitInfo = {};
-            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-            submitInfo.pNext = NULL;
-            submitInfo.commandBufferCount = 1;
-            submitInfo.pCommandBuffers = &stagingInfo.commandBuffer;
-            submitInfo.pSignalSemaphores = NULL;
-            submitInfo.signalSemaphoreCount = 0;
-            submitInfo.pWaitDstStageMask = NULL;
-            submitInfo.pWaitSemaphores = NULL;
-            submitInfo.waitSemaphoreCount = 0;
-
-            pHeader = generate::vkQueueSubmit(false, stagingInfo.queue, 1, &submitInfo, VK_NULL_HANDLE);
-            vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
-            vktrace_delete_trace_packet(&pHeader);
-
-            // wait for queue to finish
-            pHeader = generate::vkQueueWaitIdle(false, stagingInfo.queue);
-            vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
-            vktrace_delete_trace_packet(&pHeader);
-
-            // delete staging buffer
-            generateDestroyStagingBuffer(device, stagingInfo);
-
-            // delete command buffer
-            pHeader = generate::vkFreeCommandBuffers(false, device, stagingInfo.commandPool, 1, &stagingInfo.commandBuffer);
-            vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
-            vktrace_delete_trace_packet(&pHeader);
-
-            // delete command pool
-            vktrace_trace_packet_header *pDestroyCommandPoolPacket =
-                generate::vkDestroyCommandPool(false, device, stagingInfo.commandPool, nullptr);
-            vktrace_write_trace_packet(pDestroyCommandPoolPacket, vktrace_trace_get_trace_file());
-            vktrace_delete_trace_packet(&pDestroyCommandPoolPacket);
-        } else {
-            VkImageLayout initialLayout = obj->second.ObjectInfo.Image.initialLayout;
-            VkImageLayout desiredLayout = obj->second.ObjectInfo.Image.mostRecentLayout;
-
-            // Need to make sure images have the correct VkImageLayout.
-            if (obj->second.ObjectInfo.Image.bIsSwapchainImage == false) {
-                uint32_t mipLevels = obj->second.ObjectInfo.Image.mipLevels;
-                uint32_t arrayLayers = obj->second.ObjectInfo.Image.arrayLayers;
-                VkFormat format = obj->second.ObjectInfo.Image.format;
-                uint32_t srcAccessMask = (initialLayout == VK_IMAGE_LAYOUT_PREINITIALIZED) ? VK_ACCESS_HOST_WRITE_BIT : 0;
-                VkImageAspectFlags aspectMask = getImageAspectFromFormat(format);
-
-                uint32_t srcQueueFamilyIndex = queueFamilyIndex;
-                uint32_t dstQueueFamilyIndex = queueFamilyIndex;
-
-                // This current approach is SUPER _NOT_ efficient.
-                // We should create a command pool on each device only once.
-                // We should only create one Command Buffer in each pool.
-                // We should batch all the VkImageMemoryBarrier structs into a
-                // single call to VkCmdPipelineBarrier (per-device).
-                // We should only end the command buffers once
-                // We should only queue submit them once
-                // We should only delete them once
-                // Instead, this code is doing all of the above, for every
-                // single image transition.
-
-                // This means:
-                // 0) Need a VkCommandPool. Arbitrarily name it something
-                // so that it has a unique handle which will be replaced
-                // at replay time.
-                uint64_t cmdPoolUint = 0xAAAAAAAA;
-                VkCommandPool tmpCommandPool = (VkCommandPool)cmdPoolUint;
-                const VkCommandPoolCreateInfo cmdPoolCreateInfo = {
-                    VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, NULL,
-                    VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-                    obj->second.ObjectInfo.Image.queueFamilyIndex};
-
-                // Need to actually make these calls so that we get a
-                // commandPool and CommandBuffer object to use in the generated
-                // call
-                vktrace_trace_packet_header *pCreateCommandPoolPacket =
-                    generate::vkCreateCommandPool(false, device, &cmdPoolCreateInfo, NULL, &tmpCommandPool);
-                vktrace_write_trace_packet(pCreateCommandPoolPacket, vktrace_trace_get_trace_file());
-                vktrace_delete_trace_packet(&pCreateCommandPoolPacket);
-
-                // 1) Create & begin a command buffer. Arbitrarily name it something
-                // so that it has a unique handle which will be replaced
-                // at replay time.
-                uint64_t cmdBufferUint = 0xBBBBBBBB;
-                VkCommandBuffer tmpCommandBuffer = (VkCommandBuffer)cmdBufferUint;
-                const VkCommandBufferAllocateInfo cmdBufferAllocInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, NULL,
-                                                                        tmpCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1};
-                vktrace_trace_packet_header *pAllocateCommandBufferPacket =
-                    generate::vkAllocateCommandBuffers(false, device, &cmdBufferAllocInfo, &tmpCommandBuffer);
-                vktrace_write_trace_packet(pAllocateCommandBufferPacket, vktrace_trace_get_trace_file());
-                vktrace_delete_trace_packet(&pAllocateCommandBufferPacket);
-
-                VkCommandBufferBeginInfo cmdBufferBeginInfo = {
-                    VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL, 0, NULL,
-                };
-
-                vktrace_trace_packet_header *pBeginCommandBufferPacket =
-                    generate::vkBeginCommandBuffer(false, tmpCommandBuffer, &cmdBufferBeginInfo);
-                vktrace_write_trace_packet(pBeginCommandBufferPacket, vktrace_trace_get_trace_file());
-                vktrace_delete_trace_packet(&pBeginCommandBufferPacket);
-
-                // 2) Make VkImageMemoryBarrier structs to change the image's
-                // layout
-                VkImageMemoryBarrier imageMemoryBarrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-                                                           NULL,
-                                                           srcAccessMask,
-                                                           0,  // dstAccessMask, determined below
-                                                           initialLayout,
-                                                           desiredLayout,
-                                                           srcQueueFamilyIndex,
-                                                           dstQueueFamilyIndex,
-                                                           image,
-                                                           {aspectMask, 0, mipLevels, 0, arrayLayers}};
-
-                if (desiredLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-                    /* Make sure anything that was copying from this image has
-                     * completed */
-                    imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-                }
-
-                if (desiredLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) {
-                    imageMemoryBarrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-                }
-
-                if (desiredLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-                    imageMemoryBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-                }
-
-                if (desiredLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-                    /* Make sure any Copy or CPU writes to image are flushed */
-                    imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
-                }
-
-                VkImageMemoryBarrier *pmemory_barrier = &imageMemoryBarrier;
-
-                VkPipelineStageFlags src_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-                VkPipelineStageFlags dest_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-
-                // 3) Use VkCmdPipelineBarrier to transition the images
-                vktrace_trace_packet_header *pCmdPipelineBarrierPacket = generate::vkCmdPipelineBarrier(
-                    false, tmpCommandBuffer, src_stages, dest_stages, 0, 0, NULL, 0, NULL, 1, pmemory_barrier);
-                vktrace_write_trace_packet(pCmdPipelineBarrierPacket, vktrace_trace_get_trace_file());
-                vktrace_delete_trace_packet(&pCmdPipelineBarrierPacket);
-
-                // 4) VkEndCommandBuffer()
-                vktrace_trace_packet_header *pEndCommandBufferPacket = generate::vkEndCommandBuffer(false, tmpCommandBuffer);
-                vktrace_write_trace_packet(pEndCommandBufferPacket, vktrace_trace_get_trace_file());
-                vktrace_delete_trace_packet(&pEndCommandBufferPacket);
-
-                VkQueue trimQueue = VK_NULL_HANDLE;
-                uint32_t queueIndex = 0;  // just using the first queue
-                                          // available, we don't yet verify if
-                                          // this even exists, just assuming.
-                trimQueue = trim::get_DeviceQueue(device, queueFamilyIndex, queueIndex);
-
-                // 5) vkQueueSubmit()
-                VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO, NULL, 0, NULL, NULL, 1, &tmpCommandBuffer, 0, NULL};
-                VkFence nullFence = VK_NULL_HANDLE;
-                vktrace_trace_packet_header *pQueueSubmitPacket =
-                    generate::vkQueueSubmit(false, trimQueue, 1, &submitInfo, nullFence);
-                vktrace_write_trace_packet(pQueueSubmitPacket, vktrace_trace_get_trace_file());
-                vktrace_delete_trace_packet(&pQueueSubmitPacket);
-
-                // 5a) vkWaitQueueIdle()
-                vktrace_trace_packet_header *pQueueWaitIdlePacket = generate::vkQueueWaitIdle(false, trimQueue);
-                vktrace_write_trace_packet(pQueueWaitIdlePacket, vktrace_trace_get_trace_file());
-                vktrace_delete_trace_packet(&pQueueWaitIdlePacket);
-
-                // 6) vkResetCommandPool() or vkFreeCommandBuffers()
-                vktrace_trace_packet_header *pResetCommandPoolPacket =
-                    generate::vkResetCommandPool(false, device, tmpCommandPool, VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT);
-                vktrace_write_trace_packet(pResetCommandPoolPacket, vktrace_trace_get_trace_file());
-                vktrace_delete_trace_packet(&pResetCommandPoolPacket);
-
-                // 7) vkDestroyCommandPool()
-                vktrace_trace_packet_header *pDestroyCommandPoolPacket =
-                    generate::vkDestroyCommandPool(false, device, tmpCommandPool, NULL);
-                vktrace_write_trace_packet(pDestroyCommandPoolPacket, vktrace_trace_get_trace_file());
-                vktrace_delete_trace_packet(&pDestroyCommandPoolPacket);
-            }
+        // Images read back without a staging buffer only need their layout
+        // restored, which swapchain images get from the presentation engine.
+        if (obj->second.ObjectInfo.Image.needsStagingBuffer || obj->second.ObjectInfo.Image.bIsSwapchainImage == false) {
+            addTraceUpload(uploadBatches, device, obj->second.ObjectInfo.Image.queueFamilyIndex, image, VK_NULL_HANDLE,
+                           obj->second);
         }
     }
+    writeTraceUploadBatches(uploadBatches);
     vktrace_LogDebug("Recreating Images (Done).");
 
     // ImageView
@@ -3213,113 +3591,8 @@ void write_all_referenced_object_calls() {
         }
 
         if (obj->second.ObjectInfo.Buffer.needsStagingBuffer) {
-            StagingInfo stagingInfo = s_bufferToStagedInfoMap[buffer];
-            stagingInfo.bufferCreateInfo.usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-
-            // Generate packets to create the staging buffer
-            generateCreateStagingBuffer(device, stagingInfo);
-
-            // here's where we map / unmap to insert data into the buffer
-            {
-                // write map / unmap packets so the memory contents gets set on
-                // replay
-                if (obj->second.ObjectInfo.Buffer.pMapMemoryPacket != NULL) {
-                    vktrace_write_trace_packet(obj->second.ObjectInfo.Buffer.pMapMemoryPacket, vktrace_trace_get_trace_file());
-                    vktrace_delete_trace_packet(&(obj->second.ObjectInfo.Buffer.pMapMemoryPacket));
-                }
-
-                if (obj->second.ObjectInfo.Buffer.pUnmapMemoryPacket != NULL) {
-                    vktrace_write_trace_packet(obj->second.ObjectInfo.Buffer.pUnmapMemoryPacket, vktrace_trace_get_trace_file());
-                    vktrace_delete_trace_packet(&(obj->second.ObjectInfo.Buffer.pUnmapMemoryPacket));
-                }
-            }
-
-            const VkCommandPoolCreateInfo cmdPoolCreateInfo = {
-                VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, NULL,
-                VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-                obj->second.ObjectInfo.Buffer.queueFamilyIndex};
-            vktrace_trace_packet_header *pCreateCommandPoolPacket =
-                generate::vkCreateCommandPool(false, device, &cmdPoolCreateInfo, NULL, &stagingInfo.commandPool);
-            vktrace_write_trace_packet(pCreateCommandPoolPacket, vktrace_trace_get_trace_file());
-            vktrace_delete_trace_packet(&pCreateCommandPoolPacket);
-
-            // create command buffer
-            VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
-            commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-            commandBufferAllocateInfo.pNext = NULL;
-            commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-            commandBufferAllocateInfo.commandBufferCount = 1;
-            commandBufferAllocateInfo.commandPool = stagingInfo.commandPool;
-
-            vktrace_trace_packet_header *pHeader =
-                generate::vkAllocateCommandBuffers(false, device, &commandBufferAllocateInfo, &stagingInfo.commandBuffer);
-            vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
-            vktrace_delete_trace_packet(&pHeader);
-
-            VkCommandBufferBeginInfo commandBufferBeginInfo;
-            commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            commandBufferBeginInfo.pNext = NULL;
-            commandBufferBeginInfo.flags = 0;
-            commandBufferBeginInfo.pInheritanceInfo = NULL;
-
-            pHeader = generate::vkBeginCommandBuffer(false, stagingInfo.commandBuffer, &commandBufferBeginInfo);
-            vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
-            vktrace_delete_trace_packet(&pHeader);
-
-            // Transition Buffer to be writeable
-            generateTransitionBuffer(device, stagingInfo.commandBuffer, buffer, 0, VK_ACCESS_TRANSFER_WRITE_BIT, 0,
-                                     obj->second.ObjectInfo.Buffer.size);
-
-            // issue call to copy buffer
-            stagingInfo.copyRegion.dstOffset = 0;
-            stagingInfo.copyRegion.srcOffset = 0;
-            pHeader =
-                generate::vkCmdCopyBuffer(false, stagingInfo.commandBuffer, stagingInfo.buffer, buffer, 1, &stagingInfo.copyRegion);
-            vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
-            vktrace_delete_trace_packet(&pHeader);
-
-            // transition buffer to final access mask
-            generateTransitionBuffer(device, stagingInfo.commandBuffer, buffer, VK_ACCESS_TRANSFER_WRITE_BIT,
-                                     obj->second.ObjectInfo.Buffer.accessFlags, 0, obj->second.ObjectInfo.Buffer.size);
-
-            pHeader = generate::vkEndCommandBuffer(false, stagingInfo.commandBuffer);
-            vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
-            vktrace_delete_trace_packet(&pHeader);
-
-            // Queue submit the command buffer
-            VkSubmitInfo submitInfo = {};
-            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-            submitInfo.pNext = NULL;
-            submitInfo.commandBufferCount = 1;
-            submitInfo.pCommandBuffers = &stagingInfo.commandBuffer;
-            submitInfo.pSignalSemaphores = NULL;
-            submitInfo.signalSemaphoreCount = 0;
-            submitInfo.pWaitDstStageMask = NULL;
-            submitInfo.pWaitSemaphores = NULL;
-            submitInfo.waitSemaphoreCount = 0;
-
-            pHeader = generate::vkQueueSubmit(false, stagingInfo.queue, 1, &submitInfo, VK_NULL_HANDLE);
-            vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
-            vktrace_delete_trace_packet(&pHeader);
-
-            // wait for queue to finish
-            pHeader = generate::vkQueueWaitIdle(false, stagingInfo.queue);
-            vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
-            vktrace_delete_trace_packet(&pHeader);
-
-            // delete staging buffer
-            generateDestroyStagingBuffer(device, stagingInfo);
-
-            // delete command buffer
-            pHeader = generate::vkFreeCommandBuffers(false, device, stagingInfo.commandPool, 1, &stagingInfo.commandBuffer);
-            vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
-            vktrace_delete_trace_packet(&pHeader);
-
-            // delete command pool
-            vktrace_trace_packet_header *pDestroyCommandPoolPacket =
-                generate::vkDestroyCommandPool(false, device, stagingInfo.commandPool, nullptr);
-            vktrace_write_trace_packet(pDestroyCommandPoolPacket, vktrace_trace_get_trace_file());
-            vktrace_delete_trace_packet(&pDestroyCommandPoolPacket);
+            addTraceUpload(uploadBatches, device, obj->second.ObjectInfo.Buffer.queueFamilyIndex, VK_NULL_HANDLE, buffer,
+                           obj->second);
         } else {
             // write map / unmap packets so the memory contents gets set on
             // replay
@@ -3334,6 +3607,7 @@ void write_all_referenced_object_calls() {
             }
         }
     }
+    writeTraceUploadBatches(uploadBatches);
     vktrace_LogDebug("Recreating Buffers (Done).");
 
     // DeviceMemory
@@ -3779,12 +4053,36 @@ void reset_DescriptorPool(VkDescriptorPool descriptorPool) {
     vktrace_leave_critical_section(&trimStateTrackerLock);
 }
 
+//=========================================================================
+void reset_CommandPool(VkCommandPool commandPool) {
+    std::vector<VkCommandBuffer> commandBuffers;
+    vktrace_enter_critical_section(&trimStateTrackerLock);
+    for (auto cbIter = s_trimGlobalStateTracker.createdCommandBuffers.begin();
+         cbIter != s_trimGlobalStateTracker.createdCommandBuffers.end(); cbIter++) {
+        if (cbIter->second.ObjectInfo.CommandBuffer.commandPool == commandPool) {
+            commandBuffers.push_back((VkCommandBuffer)cbIter->first);
+        }
+    }
+    vktrace_leave_critical_section(&trimStateTrackerLock);
+
+    for (size_t i = 0; i < commandBuffers.size(); i++) {
+        remove_CommandBuffer_calls(commandBuffers[i]);
+        ClearImageTransitions(commandBuffers[i]);
+        ClearBufferTransitions(commandBuffers[i]);
+    }
+}
+
 //===============================================
 // Packet Recording for frames of interest
 //===============================================
 void write_packet(vktrace_trace_packet_header *pHeader) {
-    vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
-    vktrace_delete_trace_packet(&pHeader);
+    if (g_trimRingFrames > 0) {
+        vktrace_enter_critical_section(&trimRecordedPacketLock);
+        s_trimRingPackets.push_back(pHeader);
+        vktrace_leave_critical_section(&trimRecordedPacketLock);
+        return;
+    }
+    vktrace_submit_trace_packet(&pHeader, vktrace_trace_get_trace_file());
 }
 
 //=============================================================================
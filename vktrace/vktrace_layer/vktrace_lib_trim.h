@@ -48,6 +48,19 @@ extern uint64_t g_trimStartFrame;
 extern uint64_t g_trimEndFrame;
 extern bool g_trimAlreadyFinished;
 
+// Only set once based on the VKTRACE_TRIM_COMPACT env var.
+extern bool g_trimCompact;
+
+// Only set once based on the VKTRACE_TRIM_WINDOWS env var, and only for the
+// hotkey and port triggers. Always set with the ring.
+extern bool g_trimWindows;
+
+// Only set once based on the VKTRACE_TRIM_RING_FRAMES env var, and only for
+// the hotkey, port and hitch triggers. When not 0, the trace is kept in a ring
+// of the last frames instead of being written, and the trigger writes it out.
+// The hitch trigger always uses the ring.
+extern uint32_t g_trimRingFrames;
+
 namespace trim {
 void initialize();
 void deinitialize();
@@ -57,6 +70,7 @@ enum enum_trim_trigger {
     frameCounter,  // trim trigger base on startFrame and endFrame
     hotKey,        // trim trigger base on hotKey
     port,          // trim trigger based on a network message
+    hitch,         // trim trigger based on the time between presents
 };
 
 // when the funtion first time run, it Check ENV viarable VKTRACE_TRIM_TRIGGER
@@ -93,6 +107,8 @@ enum enum_key_state {
 bool is_hotkey_trim_triggered();
 // return if a read on the trigger port triggers.
 bool is_port_trim_triggered();
+// At each present, return if the ring is to be written for a slow frame.
+bool is_hitch_trim_triggered();
 
 static const uint32_t INVALID_BINDING_INDEX = std::numeric_limits<uint32_t>::max();
 
@@ -103,6 +119,11 @@ void snapshot_state_tracker();
 void start();
 void stop();
 
+// Writes the frames kept in the ring as a trim window.
+void write_ring();
+// After the packet of vkQueuePresentKHR has been kept in the ring
+void end_ring_frame();
+
 // Outputs object-related trace packets to the trace file.
 void write_all_referenced_object_calls();
 void write_packet(vktrace_trace_packet_header *pHeader);
@@ -118,7 +139,8 @@ void add_CommandBuffer_call(VkCommandBuffer commandBuffer, vktrace_trace_packet_
 void remove_CommandBuffer_calls(VkCommandBuffer commandBuffer);
 
 #if TRIM_USE_ORDERED_IMAGE_CREATION
-void add_Image_call(vktrace_trace_packet_header *pHeader);
+void add_Image_call(VkImage image, vktrace_trace_packet_header *pHeader);
+void remove_Image_calls(VkImage image);
 #endif  // TRIM_USE_ORDERED_IMAGE_CREATION
 
 void AddImageTransition(VkCommandBuffer commandBuffer, ImageTransition transition);
@@ -132,6 +154,7 @@ void ClearBufferTransitions(VkCommandBuffer commandBuffer);
 //-----------------------
 
 void reset_DescriptorPool(VkDescriptorPool descriptorPool);
+void reset_CommandPool(VkCommandPool commandPool);
 
 VkMemoryPropertyFlags LookUpMemoryProperties(VkDevice device, uint32_t memoryTypeIndex);
 
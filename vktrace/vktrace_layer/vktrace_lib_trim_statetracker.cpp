@@ -13,12 +13,139 @@
 * See the License for the specific language governing permissions and
 * limitations under the License.
 */
+#include <iterator>
 #include "vktrace_lib_trim_statetracker.h"
 #include "vktrace_lib_trim.h"
 
 namespace trim {
 // declared extern in statetracker.h
 VKTRACE_CRITICAL_SECTION trimTransitionMapLock;
+VKTRACE_CRITICAL_SECTION trimShaderCodeLock;
+
+// In compact mode, shader modules and the pipelines that keep a copy of their
+// create info share one copy of identical SPIR-V, which is freed with its
+// last reference. Outside of compact mode every create info has its own copy.
+struct SharedShaderCode {
+    size_t codeSize;
+    uint64_t hash;
+    uint32_t refCount;
+};
+static std::unordered_map<const uint32_t *, SharedShaderCode> s_sharedShaderCode;
+static std::unordered_multimap<uint64_t, const uint32_t *> s_sharedShaderCodeByHash;
+
+//-------------------------------------------------------------------------
+static uint64_t hash_shader_code(const uint32_t *pCode, size_t codeSize) {
+    // FNV-1a
+    const uint8_t *pBytes = reinterpret_cast<const uint8_t *>(pCode);
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < codeSize; i++) {
+        hash = (hash ^ pBytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+//-------------------------------------------------------------------------
+static const uint32_t *acquire_shader_code(const uint32_t *pCode, size_t codeSize) {
+    if (pCode == nullptr) {
+        return nullptr;
+    }
+    if (!g_trimCompact) {
+        uint32_t *pCodeCopy = static_cast<uint32_t *>(malloc(codeSize));
+        memcpy(pCodeCopy, pCode, codeSize);
+        return pCodeCopy;
+    }
+
+    vktrace_enter_critical_section(&trimShaderCodeLock);
+    auto shared = s_sharedShaderCode.find(pCode);
+    if (shared != s_sharedShaderCode.end()) {
+        shared->second.refCount++;
+        vktrace_leave_critical_section(&trimShaderCodeLock);
+        return pCode;
+    }
+
+    uint64_t hash = hash_shader_code(pCode, codeSize);
+    auto range = s_sharedShaderCodeByHash.equal_range(hash);
+    for (auto iter = range.first; iter != range.second; ++iter) {
+        SharedShaderCode &code = s_sharedShaderCode[iter->second];
+        if (code.codeSize == codeSize && memcmp(iter->second, pCode, codeSize) == 0) {
+            code.refCount++;
+            vktrace_leave_critical_section(&trimShaderCodeLock);
+            return iter->second;
+        }
+    }
+
+    uint32_t *pCodeCopy = static_cast<uint32_t *>(malloc(codeSize));
+    memcpy(pCodeCopy, pCode, codeSize);
+    SharedShaderCode code = {codeSize, hash, 1};
+    s_sharedShaderCode[pCodeCopy] = code;
+    s_sharedShaderCodeByHash.insert(std::make_pair(hash, pCodeCopy));
+    vktrace_leave_critical_section(&trimShaderCodeLock);
+    return pCodeCopy;
+}
+
+//-------------------------------------------------------------------------
+static void release_shader_code(const uint32_t *pCode) {
+    if (!g_trimCompact) {
+        free(const_cast<uint32_t *>(pCode));
+        return;
+    }
+
+    vktrace_enter_critical_section(&trimShaderCodeLock);
+    auto shared = s_sharedShaderCode.find(pCode);
+    if (shared != s_sharedShaderCode.end() && --shared->second.refCount == 0) {
+        auto range = s_sharedShaderCodeByHash.equal_range(shared->second.hash);
+        for (auto iter = range.first; iter != range.second; ++iter) {
+            if (iter->second == pCode) {
+                s_sharedShaderCodeByHash.erase(iter);
+                break;
+            }
+        }
+        s_sharedShaderCode.erase(shared);
+        free(const_cast<uint32_t *>(pCode));
+    }
+    vktrace_leave_critical_section(&trimShaderCodeLock);
+}
+
+//-------------------------------------------------------------------------
+static bool equal_VkAttachmentReferences(uint32_t count, const VkAttachmentReference *pA, const VkAttachmentReference *pB) {
+    if ((pA == nullptr) != (pB == nullptr)) return false;
+    for (uint32_t i = 0; pA != nullptr && i < count; i++) {
+        if (pA[i].attachment != pB[i].attachment || pA[i].layout != pB[i].layout) return false;
+    }
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// The dependencies aren't kept with the copied create infos, so only their
+// count is compared. Pipelines only need a compatible render pass anyway.
+static bool equal_VkRenderPassCreateInfo(const VkRenderPassCreateInfo &a, const VkRenderPassCreateInfo &b) {
+    if (a.flags != b.flags || a.attachmentCount != b.attachmentCount || a.subpassCount != b.subpassCount ||
+        a.dependencyCount != b.dependencyCount) {
+        return false;
+    }
+    if (a.attachmentCount > 0 && memcmp(a.pAttachments, b.pAttachments, a.attachmentCount * sizeof(VkAttachmentDescription)) != 0) {
+        return false;
+    }
+    for (uint32_t i = 0; i < a.subpassCount; i++) {
+        const VkSubpassDescription &subpassA = a.pSubpasses[i];
+        const VkSubpassDescription &subpassB = b.pSubpasses[i];
+        if (subpassA.flags != subpassB.flags || subpassA.pipelineBindPoint != subpassB.pipelineBindPoint ||
+            subpassA.inputAttachmentCount != subpassB.inputAttachmentCount ||
+            subpassA.colorAttachmentCount != subpassB.colorAttachmentCount ||
+            subpassA.preserveAttachmentCount != subpassB.preserveAttachmentCount ||
+            !equal_VkAttachmentReferences(subpassA.inputAttachmentCount, subpassA.pInputAttachments, subpassB.pInputAttachments) ||
+            !equal_VkAttachmentReferences(subpassA.colorAttachmentCount, subpassA.pColorAttachments, subpassB.pColorAttachments) ||
+            !equal_VkAttachmentReferences(subpassA.colorAttachmentCount, subpassA.pResolveAttachments,
+                                          subpassB.pResolveAttachments) ||
+            !equal_VkAttachmentReferences(1, subpassA.pDepthStencilAttachment, subpassB.pDepthStencilAttachment)) {
+            return false;
+        }
+        for (uint32_t j = 0; j < subpassA.preserveAttachmentCount; j++) {
+            if (subpassA.pPreserveAttachments[j] != subpassB.pPreserveAttachments[j]) return false;
+        }
+    }
+    return true;
+}
 
 //-------------------------------------------------------------------------
 #define COPY_PACKET(packet) packet = copy_packet(packet)
@@ -96,7 +223,25 @@ void StateTracker::remove_CommandBuffer_calls(VkCommandBuffer commandBuffer) {
 }
 
 #if TRIM_USE_ORDERED_IMAGE_CREATION
-void StateTracker::add_Image_call(vktrace_trace_packet_header *pHeader) { m_image_calls.push_back(pHeader); }
+void StateTracker::add_Image_call(VkImage image, vktrace_trace_packet_header *pHeader) {
+    m_image_calls.push_back(pHeader);
+    if (g_trimCompact) {
+        m_imageCallsByImage[image].push_back(std::prev(m_image_calls.end()));
+    }
+}
+
+//-------------------------------------------------------------------------
+void StateTracker::remove_Image_calls(VkImage image) {
+    auto calls = m_imageCallsByImage.find(image);
+    if (calls != m_imageCallsByImage.end()) {
+        for (size_t i = 0; i < calls->second.size(); i++) {
+            vktrace_trace_packet_header *pHeader = *calls->second[i];
+            vktrace_delete_trace_packet(&pHeader);
+            m_image_calls.erase(calls->second[i]);
+        }
+        m_imageCallsByImage.erase(calls);
+    }
+}
 #endif  // TRIM_USE_ORDERED_IMAGE_CREATION
 
 //-------------------------------------------------------------------------
@@ -224,6 +369,7 @@ void StateTracker::clear() {
         vktrace_delete_trace_packet(&pHeader);
     }
     m_image_calls.clear();
+    m_imageCallsByImage.clear();
 
     for (auto renderPassIter = m_renderPassVersions.begin(); renderPassIter != m_renderPassVersions.end(); ++renderPassIter) {
         std::vector<VkRenderPassCreateInfo *> versions = renderPassIter->second;
@@ -348,9 +494,13 @@ void StateTracker::copy_VkRenderPassCreateInfo(VkRenderPassCreateInfo *pDst, con
 }
 
 void StateTracker::add_RenderPassCreateInfo(VkRenderPass renderPass, const VkRenderPassCreateInfo *pCreateInfo) {
+    std::vector<VkRenderPassCreateInfo *> &versions = m_renderPassVersions[renderPass];
+    if (g_trimCompact && !versions.empty() && equal_VkRenderPassCreateInfo(*versions.back(), *pCreateInfo)) {
+        return;
+    }
     VkRenderPassCreateInfo *pCopyCreateInfo = static_cast<VkRenderPassCreateInfo *>(VKTRACE_NEW(VkRenderPassCreateInfo));
     copy_VkRenderPassCreateInfo(pCopyCreateInfo, *pCreateInfo);
-    m_renderPassVersions[renderPass].push_back(pCopyCreateInfo);
+    versions.push_back(pCopyCreateInfo);
 }
 
 //-------------------------------------------------------------------------
@@ -554,10 +704,8 @@ StateTracker &StateTracker::operator=(const StateTracker &other) {
 
     createdShaderModules = other.createdShaderModules;
     for (auto obj = createdShaderModules.begin(); obj != createdShaderModules.end(); obj++) {
-        uint32_t *pCodeCopy = static_cast<uint32_t *>(malloc(obj->second.ObjectInfo.ShaderModule.createInfo.codeSize));
-        memcpy(pCodeCopy, obj->second.ObjectInfo.ShaderModule.createInfo.pCode,
-               obj->second.ObjectInfo.ShaderModule.createInfo.codeSize);
-        obj->second.ObjectInfo.ShaderModule.createInfo.pCode = pCodeCopy;
+        obj->second.ObjectInfo.ShaderModule.createInfo.pCode = acquire_shader_code(
+            obj->second.ObjectInfo.ShaderModule.createInfo.pCode, obj->second.ObjectInfo.ShaderModule.createInfo.codeSize);
     }
 
     createdPipelineLayouts = other.createdPipelineLayouts;
@@ -696,9 +844,7 @@ void StateTracker::copy_VkShaderModuleCreateInfo(VkShaderModuleCreateInfo *pDst,
         *pDst = src;
 
         if (src.pCode != nullptr) {
-            uint32_t *pCodeCopy = static_cast<uint32_t *>(malloc(src.codeSize));
-            memcpy(pCodeCopy, src.pCode, src.codeSize);
-            pDst->pCode = pCodeCopy;
+            pDst->pCode = acquire_shader_code(src.pCode, src.codeSize);
         }
         pDst->pNext = nullptr;
     }
@@ -709,8 +855,7 @@ void StateTracker::copy_VkShaderModuleCreateInfo(VkShaderModuleCreateInfo *pDst,
 void StateTracker::delete_VkShaderModuleCreateInfo(VkShaderModuleCreateInfo *pModule) {
     if (pModule != nullptr) {
         if (pModule->pCode != nullptr) {
-            uint32_t *pCode = const_cast<uint32_t *>(pModule->pCode);
-            free(pCode);
+            release_shader_code(pModule->pCode);
             pModule->pCode = nullptr;
         }
         pModule->codeSize = 0;
@@ -1469,9 +1614,7 @@ void StateTracker::remove_RenderPass(const VkRenderPass var) {
 void StateTracker::remove_ShaderModule(const VkShaderModule var) {
     ObjectInfo *pInfo = get_ShaderModule(var);
     if (pInfo != nullptr) {
-        uint32_t *pCode = const_cast<uint32_t *>(pInfo->ObjectInfo.ShaderModule.createInfo.pCode);
-        free(pCode);
-        pInfo->ObjectInfo.ShaderModule.createInfo.pCode = nullptr;
+        delete_VkShaderModuleCreateInfo(&pInfo->ObjectInfo.ShaderModule.createInfo);
     }
     createdShaderModules.erase(var);
 }
@@ -45,6 +45,7 @@ struct ImageTransition {
 };
 
 extern VKTRACE_CRITICAL_SECTION trimTransitionMapLock;
+extern VKTRACE_CRITICAL_SECTION trimShaderCodeLock;
 
 // VkCmdPipelineBarrier can transition memory to a different accessMask, but
 // the change doesn't happen when the API call is made but rather when the
@@ -302,7 +303,9 @@ class StateTracker {
     uint32_t get_RenderPassVersion(VkRenderPass renderPass);
 
 #if TRIM_USE_ORDERED_IMAGE_CREATION
-    void add_Image_call(vktrace_trace_packet_header *pHeader);
+    void add_Image_call(VkImage image, vktrace_trace_packet_header *pHeader);
+    // Only the calls of images added in compact mode are known
+    void remove_Image_calls(VkImage image);
 #endif  // TRIM_USE_ORDERED_IMAGE_CREATION
 
     StateTracker &operator=(const StateTracker &other);
@@ -416,6 +419,11 @@ class StateTracker {
     // same size requirements as they had a trace-time.
     std::list<vktrace_trace_packet_header *> m_image_calls;
 
+    // In compact mode, the packets of m_image_calls made for each image, so
+    // they can be dropped when the image is destroyed before trim starts.
+    // Snapshots don't keep this.
+    std::unordered_map<VkImage, std::vector<std::list<vktrace_trace_packet_header *>::iterator>> m_imageCallsByImage;
+
     std::unordered_map<VkInstance, ObjectInfo> createdInstances;
     std::unordered_map<VkPhysicalDevice, ObjectInfo> createdPhysicalDevices;
     std::unordered_map<VkDevice, ObjectInfo> createdDevices;
@@ -26,7 +26,8 @@
 #include "vktrace_vk_packet_id.h"
 #include "vktrace_tracelog.h"
 
-static vkreplayer_settings s_defaultVkReplaySettings = {NULL, 1, -1, -1, NULL, NULL, NULL};
+static vkreplayer_settings s_defaultVkReplaySettings = {NULL, 1, -1, -1, NULL, NULL, NULL, 0, 0, FALSE, FALSE, FALSE, 0, NULL, FALSE,
+                                                         0, FALSE, 0};
 
 vkReplay* g_pReplayer = NULL;
 VKTRACE_CRITICAL_SECTION g_handlerLock;
@@ -129,8 +130,15 @@ vktrace_replay::VKTRACE_REPLAY_RESULT VKTRACER_CDECL VkReplayReplay(vktrace_trac
     vktrace_replay::VKTRACE_REPLAY_RESULT result = vktrace_replay::VKTRACE_REPLAY_ERROR;
     if (g_pReplayer != NULL) {
         result = g_pReplayer->replay(pPacket);
-
-        if (result == vktrace_replay::VKTRACE_REPLAY_SUCCESS) result = g_pReplayer->pop_validation_msgs();
+        g_pReplayer->forget_unused_objects(pPacket->global_packet_index);
+
+        // Command buffer recording may be replayed on several threads, and validation messages
+        // are pushed from whichever thread the layers report them on
+        if (result == vktrace_replay::VKTRACE_REPLAY_SUCCESS) {
+            vktrace_enter_critical_section(&g_handlerLock);
+            result = g_pReplayer->pop_validation_msgs();
+            vktrace_leave_critical_section(&g_handlerLock);
+        }
     }
     return result;
 }
@@ -155,3 +163,15 @@ void VKTRACER_CDECL VkReplayResetFrameNumber(int frameNumber) {
         g_pReplayer->reset_frame_number(frameNumber);
     }
 }
+
+void VKTRACER_CDECL VkReplaySaveLoopState() {
+    if (g_pReplayer != NULL) {
+        g_pReplayer->save_loop_state();
+    }
+}
+
+void VKTRACER_CDECL VkReplayRestoreLoopState() {
+    if (g_pReplayer != NULL) {
+        g_pReplayer->restore_loop_state();
+    }
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "vkreplay_annotations.h"
+#include "vkreplay_vk_func_ptrs.h"
+#include "vktrace_platform.h"
+#include "vktrace_tracelog.h"
+
+namespace vktrace_replay {
+
+static bool enables_debug_marker(const VkDeviceCreateInfo *pCreateInfo) {
+    for (uint32_t i = 0; i < pCreateInfo->enabledExtensionCount; i++) {
+        if (strcmp(pCreateInfo->ppEnabledExtensionNames[i], VK_EXT_DEBUG_MARKER_EXTENSION_NAME) == 0) return true;
+    }
+    return false;
+}
+
+bool ReplayAnnotations::adds_extension(VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo *pCreateInfo) {
+    if (enables_debug_marker(pCreateInfo)) return false;
+    uint32_t count = 0;
+    m_vkFuncs.real_vkEnumerateDeviceExtensionProperties(physicalDevice, NULL, &count, NULL);
+    std::vector<VkExtensionProperties> properties(count);
+    if (count > 0) m_vkFuncs.real_vkEnumerateDeviceExtensionProperties(physicalDevice, NULL, &count, properties.data());
+    for (uint32_t i = 0; i < count; i++) {
+        if (strcmp(properties[i].extensionName, VK_EXT_DEBUG_MARKER_EXTENSION_NAME) == 0) return true;
+    }
+    vktrace_LogWarning("The replay device doesn't support %s, replay won't be annotated.", VK_EXT_DEBUG_MARKER_EXTENSION_NAME);
+    return false;
+}
+
+void ReplayAnnotations::add_device(VkDevice device, const VkDeviceCreateInfo *pCreateInfo) {
+    if (!enables_debug_marker(pCreateInfo)) return;
+    Device info;
+    info.pCmdDebugMarkerBegin =
+        (PFN_vkCmdDebugMarkerBeginEXT)m_vkFuncs.real_vkGetDeviceProcAddr(device, "vkCmdDebugMarkerBeginEXT");
+    info.pCmdDebugMarkerEnd = (PFN_vkCmdDebugMarkerEndEXT)m_vkFuncs.real_vkGetDeviceProcAddr(device, "vkCmdDebugMarkerEndEXT");
+    info.pCmdDebugMarkerInsert =
+        (PFN_vkCmdDebugMarkerInsertEXT)m_vkFuncs.real_vkGetDeviceProcAddr(device, "vkCmdDebugMarkerInsertEXT");
+    if (info.pCmdDebugMarkerBegin != NULL && info.pCmdDebugMarkerEnd != NULL && info.pCmdDebugMarkerInsert != NULL) {
+        m_devices[device] = info;
+    }
+}
+
+void ReplayAnnotations::add_command_buffers(VkDevice device, const VkCommandBufferAllocateInfo *pAllocateInfo,
+                                            const VkCommandBuffer *pCommandBuffers) {
+    auto found = m_devices.find(device);
+    if (found == m_devices.end()) return;
+    for (uint32_t i = 0; i < pAllocateInfo->commandBufferCount; i++) {
+        CommandBuffer &commandBuffer = m_commandBuffers[pCommandBuffers[i]];
+        commandBuffer.device = device;
+        commandBuffer.commandPool = pAllocateInfo->commandPool;
+        commandBuffer.pDevice = &found->second;
+        commandBuffer.open = false;
+    }
+}
+
+ReplayAnnotations::CommandBuffer *ReplayAnnotations::find(VkCommandBuffer commandBuffer) {
+    auto found = m_commandBuffers.find(commandBuffer);
+    return found != m_commandBuffers.end() ? &found->second : NULL;
+}
+
+void ReplayAnnotations::begin_command_buffer(VkCommandBuffer commandBuffer, int frame, uint64_t packetIndex) {
+    CommandBuffer *pCommandBuffer = find(commandBuffer);
+    if (pCommandBuffer == NULL) return;
+    char name[64];
+    snprintf(name, sizeof(name), "frame %d, vkBeginCommandBuffer #%" PRIu64, frame, packetIndex);
+    VkDebugMarkerMarkerInfoEXT markerInfo = {VK_STRUCTURE_TYPE_DEBUG_MARKER_MARKER_INFO_EXT, NULL, name, {0.0f, 0.0f, 0.0f, 0.0f}};
+    pCommandBuffer->pDevice->pCmdDebugMarkerBegin(commandBuffer, &markerInfo);
+    pCommandBuffer->open = true;
+}
+
+void ReplayAnnotations::end_command_buffer(VkCommandBuffer commandBuffer) {
+    CommandBuffer *pCommandBuffer = find(commandBuffer);
+    if (pCommandBuffer == NULL || !pCommandBuffer->open) return;
+    pCommandBuffer->pDevice->pCmdDebugMarkerEnd(commandBuffer);
+    pCommandBuffer->open = false;
+}
+
+void ReplayAnnotations::tag(VkCommandBuffer commandBuffer, uint64_t packetIndex, const char *pName) {
+    CommandBuffer *pCommandBuffer = find(commandBuffer);
+    if (pCommandBuffer == NULL || !pCommandBuffer->open) return;
+    char name[96];
+    snprintf(name, sizeof(name), "#%" PRIu64 " %s", packetIndex, pName);
+    VkDebugMarkerMarkerInfoEXT markerInfo = {VK_STRUCTURE_TYPE_DEBUG_MARKER_MARKER_INFO_EXT, NULL, name, {0.0f, 0.0f, 0.0f, 0.0f}};
+    pCommandBuffer->pDevice->pCmdDebugMarkerInsert(commandBuffer, &markerInfo);
+}
+
+void ReplayAnnotations::free_command_buffers(uint32_t commandBufferCount, const VkCommandBuffer *pCommandBuffers) {
+    for (uint32_t i = 0; i < commandBufferCount; i++) {
+        m_commandBuffers.erase(pCommandBuffers[i]);
+    }
+}
+
+void ReplayAnnotations::destroy_command_pool(VkCommandPool commandPool) {
+    for (auto it = m_commandBuffers.begin(); it != m_commandBuffers.end();) {
+        if (it->second.commandPool == commandPool) {
+            it = m_commandBuffers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ReplayAnnotations::destroy_device(VkDevice device) {
+    for (auto it = m_commandBuffers.begin(); it != m_commandBuffers.end();) {
+        if (it->second.device == device) {
+            it = m_commandBuffers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_devices.erase(device);
+}
+
+} /* namespace vktrace_replay */
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <unordered_map>
+#include "vulkan/vulkan.h"
+
+struct vkFuncs;
+
+/* Labels the commands replay records with VK_EXT_debug_marker, so captures of vkreplay in a GPU
+ * profiler show where each call of the trace went. Each recording is a region named after the
+ * frame it was recorded in and the global_packet_index of its vkBeginCommandBuffer, and every
+ * recording call is tagged with its global_packet_index. The debug marker regions of the trace
+ * are replayed as they were. The extension is enabled on the devices that support it, usually
+ * only while a profiler's layer is loaded. All handles are the replay ones. Recording calls may
+ * come from the recording threads, everything else from the replay thread while they are idle. */
+namespace vktrace_replay {
+
+class ReplayAnnotations {
+   public:
+    explicit ReplayAnnotations(const vkFuncs &funcs) : m_vkFuncs(funcs) {}
+
+    // Whether VK_EXT_debug_marker has to be added to the extensions of pCreateInfo
+    bool adds_extension(VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo *pCreateInfo);
+    // After the real vkCreateDevice, with the extensions it enabled
+    void add_device(VkDevice device, const VkDeviceCreateInfo *pCreateInfo);
+    void add_command_buffers(VkDevice device, const VkCommandBufferAllocateInfo *pAllocateInfo,
+                             const VkCommandBuffer *pCommandBuffers);
+
+    // After the real vkBeginCommandBuffer, and before the real vkEndCommandBuffer
+    void begin_command_buffer(VkCommandBuffer commandBuffer, int frame, uint64_t packetIndex);
+    void end_command_buffer(VkCommandBuffer commandBuffer);
+    // Before the real recording call
+    void tag(VkCommandBuffer commandBuffer, uint64_t packetIndex, const char *pName);
+
+    // Before the real destroy calls
+    void free_command_buffers(uint32_t commandBufferCount, const VkCommandBuffer *pCommandBuffers);
+    void destroy_command_pool(VkCommandPool commandPool);
+    void destroy_device(VkDevice device);
+
+   private:
+    struct Device {
+        PFN_vkCmdDebugMarkerBeginEXT pCmdDebugMarkerBegin;
+        PFN_vkCmdDebugMarkerEndEXT pCmdDebugMarkerEnd;
+        PFN_vkCmdDebugMarkerInsertEXT pCmdDebugMarkerInsert;
+    };
+
+    struct CommandBuffer {
+        VkDevice device;
+        VkCommandPool commandPool;
+        const Device *pDevice;
+        bool open;  // in the region of its recording
+    };
+
+    CommandBuffer *find(VkCommandBuffer commandBuffer);
+
+    const vkFuncs &m_vkFuncs;
+    std::unordered_map<VkDevice, Device> m_devices;
+    std::unordered_map<VkCommandBuffer, CommandBuffer> m_commandBuffers;
+};
+
+} /* namespace vktrace_replay */
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdlib.h>
+#include "vkreplay_arena.h"
+#include "vktrace_platform.h"
+
+namespace vktrace_replay {
+
+// Allocations are aligned for any type the replay arrays hold
+static const size_t ARENA_ALIGNMENT = 16;
+
+// A thread's arena lives as long as the thread replays, which for the replay and recording
+// threads is until vkreplay exits
+static VKTRACE_THREAD_LOCAL ReplayArena *s_pThreadArena = NULL;
+
+ReplayArena &ReplayArena::current() {
+    if (s_pThreadArena == NULL) {
+        s_pThreadArena = new ReplayArena();
+    }
+    return *s_pThreadArena;
+}
+
+ReplayArena::~ReplayArena() {
+    for (auto &block : m_blocks) {
+        free(block.pData);
+    }
+}
+
+void *ReplayArena::alloc(size_t size) {
+    if (size == 0) return NULL;
+
+    size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+    if (m_block < m_blocks.size() && m_offset + size <= m_blocks[m_block].size) {
+        void *pMemory = m_blocks[m_block].pData + m_offset;
+        m_offset += size;
+        return pMemory;
+    }
+
+    // Move on to the next block, or put a new one in front of it if it's too small. The first
+    // allocation starts at block 0 offset 0 without a block, hence the check for an empty list.
+    size_t next = m_blocks.empty() ? 0 : m_block + 1;
+    if (next == m_blocks.size() || m_blocks[next].size < size) {
+        Block block;
+        block.size = size > blockSize ? size : blockSize;
+        block.pData = (uint8_t *)malloc(block.size);
+        if (block.pData == NULL) return NULL;
+        m_blocks.insert(m_blocks.begin() + next, block);
+    }
+    m_block = next;
+    m_offset = size;
+    return m_blocks[m_block].pData;
+}
+
+} /* namespace vktrace_replay */
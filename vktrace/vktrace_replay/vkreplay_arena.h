@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/* Scratch memory for the arrays of remapped handles and structures a packet is replayed with,
+ * which are only needed until its call returns. Each thread replaying packets bump-allocates out
+ * of blocks of its own, and a ReplayArenaScope around the replay of a packet hands everything
+ * allocated in it back when it ends, so replay doesn't go to the heap for every call. The blocks
+ * are kept for the next packets. Nothing allocated here may be kept past the packet's replay. */
+namespace vktrace_replay {
+
+class ReplayArena {
+   public:
+    struct Mark {
+        size_t block;
+        size_t offset;
+    };
+
+    ~ReplayArena();
+
+    // The arena of the calling thread
+    static ReplayArena &current();
+
+    // Returns NULL for size 0, like vktrace_malloc. The memory isn't initialized.
+    void *alloc(size_t size);
+
+    Mark mark() const { return {m_block, m_offset}; }
+    // Frees everything allocated since mark was taken
+    void rewind(const Mark &mark) {
+        m_block = mark.block;
+        m_offset = mark.offset;
+    }
+
+   private:
+    static const size_t blockSize = 64 * 1024;
+
+    ReplayArena() : m_block(0), m_offset(0) {}
+
+    struct Block {
+        uint8_t *pData;
+        size_t size;
+    };
+    std::vector<Block> m_blocks;
+    size_t m_block;
+    size_t m_offset;
+};
+
+// Rewinds the calling thread's arena to where it was when the scope began
+class ReplayArenaScope {
+   public:
+    ReplayArenaScope() : m_arena(ReplayArena::current()), m_mark(m_arena.mark()) {}
+    ~ReplayArenaScope() { m_arena.rewind(m_mark); }
+
+   private:
+    ReplayArenaScope(const ReplayArenaScope &) = delete;
+    ReplayArenaScope &operator=(const ReplayArenaScope &) = delete;
+
+    ReplayArena &m_arena;
+    ReplayArena::Mark m_mark;
+};
+
+} /* namespace vktrace_replay */
+
+// Like VKTRACE_NEW_ARRAY, for arrays that only live until the packet has been replayed. They aren't deleted.
+#define VKTRACE_REPLAY_NEW_ARRAY(type, count) (type *)vktrace_replay::ReplayArena::current().alloc(sizeof(type) * (count))
@@ -0,0 +1,350 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include "vkreplay_compare.h"
+#include "vkreplay_placement.h"
+#include "vktrace_platform.h"
+#include "vktrace_tracelog.h"
+#include "screenshot_encode.h"
+
+extern "C" {
+#include "vktrace_trace_packet_utils.h"
+}
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VKREPLAY_USE_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define VKREPLAY_USE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace vktrace_replay {
+
+// How long a worker waits between looking for a screenshot the layer hasn't written yet
+static const unsigned int SCREENSHOT_POLL_MS = 5;
+// How long after finish() screenshots that still haven't been written are waited for
+static const uint64_t SCREENSHOT_WAIT_NS = 2000000000;
+// Samples per row and column of each of the 9x8 cells of the perceptual hash
+static const uint32_t HASH_CELL_SAMPLES = 8;
+
+static const char *const resultNames[] = {"match", "different", "hash_different", "size_different", "missing", "missing_golden"};
+
+// Largest difference between the bytes of a and b
+static unsigned int max_difference(const uint8_t *a, const uint8_t *b, size_t size) {
+    size_t i = 0;
+    unsigned int maxDifference = 0;
+#if defined(VKREPLAY_USE_SSE2) || defined(VKREPLAY_USE_NEON)
+    uint8_t lanes[16];
+#if defined(VKREPLAY_USE_SSE2)
+    __m128i max = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        max = _mm_max_epu8(max, _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va)));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), max);
+#else
+    uint8x16_t max = vdupq_n_u8(0);
+    for (; i + 16 <= size; i += 16) {
+        max = vmaxq_u8(max, vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+    }
+    vst1q_u8(lanes, max);
+#endif
+    for (int lane = 0; lane < 16; lane++) {
+        maxDifference = std::max(maxDifference, (unsigned int)lanes[lane]);
+    }
+#endif
+    for (; i < size; i++) {
+        maxDifference = std::max(maxDifference, (unsigned int)abs(a[i] - b[i]));
+    }
+    return maxDifference;
+}
+
+// Difference hash of a packed RGB image: a bit per pair of neighboring cells of a 9x8 grid, set if
+// the left one is darker. The luma of a cell is that of a grid of pixels sampled in it, so the
+// hash costs the same for every image size.
+static uint64_t perceptual_hash(const std::vector<uint8_t> &pixels, uint32_t width, uint32_t height) {
+    uint32_t luma[8][9] = {};
+    for (uint32_t sy = 0; sy < 8 * HASH_CELL_SAMPLES; sy++) {
+        uint32_t y = (uint32_t)((2ull * sy + 1) * height / (2 * 8 * HASH_CELL_SAMPLES));
+        for (uint32_t sx = 0; sx < 9 * HASH_CELL_SAMPLES; sx++) {
+            uint32_t x = (uint32_t)((2ull * sx + 1) * width / (2 * 9 * HASH_CELL_SAMPLES));
+            const uint8_t *pPixel = &pixels[3 * ((size_t)y * width + x)];
+            luma[sy / HASH_CELL_SAMPLES][sx / HASH_CELL_SAMPLES] += 2 * pPixel[0] + 5 * pPixel[1] + pPixel[2];
+        }
+    }
+    uint64_t hash = 0;
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            hash = hash << 1 | (luma[y][x] < luma[y][x + 1] ? 1 : 0);
+        }
+    }
+    return hash;
+}
+
+static bool file_exists(const char *filename) {
+    FILE *pFile = fopen(filename, "rb");
+    if (pFile == NULL) return false;
+    fclose(pFile);
+    return true;
+}
+
+static unsigned int bit_count(uint64_t value) {
+    unsigned int count = 0;
+    for (; value != 0; value &= value - 1) {
+        count++;
+    }
+    return count;
+}
+
+ScreenshotComparer::ScreenshotComparer(const char *goldenDir, const char *screenshotList, unsigned int tolerance,
+                                       unsigned int diffPpm, unsigned int hashDistance, const char *reportFile)
+    : m_goldenDir(goldenDir),
+      m_range(false),
+      m_tolerance(tolerance),
+      m_diffPpm(diffPpm),
+      m_hashDistance(hashDistance),
+      m_reportFile(reportFile != NULL ? reportFile : ""),
+      m_nextFrame(0),
+      m_finishing(false),
+      m_finishTime(0) {
+    // The layer writes screenshots in the format VK_SCREENSHOT_FILE_FORMAT asks for, PPM otherwise
+    screenshot::ScreenshotFileFormat fileFormat = screenshot::SCREENSHOT_FILE_FORMAT_PPM;
+    const char *pFileFormat = getenv("VK_SCREENSHOT_FILE_FORMAT");
+    if (pFileFormat != NULL && *pFileFormat != '\0') {
+        screenshot::parseScreenshotFileFormat(pFileFormat, &fileFormat);
+    }
+    m_extension = screenshot::screenshotFileExtension(fileFormat);
+
+    // Frames are picked the way the layer picks them
+    memset(&m_frameRange, 0, sizeof(m_frameRange));
+    if (screenshot::isOptionBelongToScreenShotRange(screenshotList)) {
+        m_range = screenshot::initScreenShotFrameRange(screenshotList, &m_frameRange) == 0;
+    } else {
+        std::string list(screenshotList);
+        size_t begin = 0;
+        while (begin < list.size()) {
+            size_t end = list.find(',', begin);
+            if (end == std::string::npos) end = list.size();
+            if (list[begin] >= '0' && list[begin] <= '9') {
+                m_frameList.insert(atoi(list.c_str() + begin));
+            }
+            begin = end + 1;
+        }
+    }
+
+    // One core is left to replay
+    unsigned int threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    for (unsigned int i = 0; i < threadCount; i++) {
+        m_threads.push_back(std::thread(&ScreenshotComparer::thread_func, this));
+    }
+}
+
+ScreenshotComparer::~ScreenshotComparer() {
+    if (!m_finishing) {
+        finish();
+    }
+}
+
+bool ScreenshotComparer::is_screenshot_frame(int frame) const {
+    if (!m_range) {
+        return m_frameList.count(frame) != 0;
+    }
+    if (!m_frameRange.valid || frame < m_frameRange.startFrame || (frame - m_frameRange.startFrame) % m_frameRange.interval != 0) {
+        return false;
+    }
+    return m_frameRange.count == screenshot::SCREEN_SHOT_FRAMES_UNLIMITED ||
+           (frame - m_frameRange.startFrame) / m_frameRange.interval < m_frameRange.count;
+}
+
+void ScreenshotComparer::frames_presented(int frameCount) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool queued = false;
+    for (; m_nextFrame < frameCount; m_nextFrame++) {
+        if (is_screenshot_frame(m_nextFrame)) {
+            m_queue.push_back(m_nextFrame);
+            queued = true;
+        }
+    }
+    if (queued) {
+        m_queued.notify_all();
+    }
+}
+
+// Where the layer writes the screenshot of the frame
+std::string ScreenshotComparer::screenshot_file(int frame) const {
+#if defined(ANDROID)
+    return "/sdcard/Android/" + std::to_string(frame) + "." + m_extension;
+#else
+    return std::to_string(frame) + "." + m_extension;
+#endif
+}
+
+void ScreenshotComparer::compare(Comparison &comparison) const {
+    std::string name = std::to_string(comparison.frame) + "." + m_extension;
+
+    // Golden screenshots may be in either file format
+    std::string goldenFile = m_goldenDir + "/" + name;
+    if (!file_exists(goldenFile.c_str())) {
+        goldenFile = m_goldenDir + "/" + std::to_string(comparison.frame) + "." +
+                     screenshot::screenshotFileExtension(m_extension == "ppm" ? screenshot::SCREENSHOT_FILE_FORMAT_QOI
+                                                                              : screenshot::SCREENSHOT_FILE_FORMAT_PPM);
+    }
+
+    uint32_t width, height, goldenWidth, goldenHeight;
+    std::vector<uint8_t> pixels, goldenPixels;
+    if (!screenshot::readScreenshotFile(screenshot_file(comparison.frame).c_str(), &width, &height, &pixels)) {
+        comparison.result = COMPARE_MISSING;
+        return;
+    }
+    if (!screenshot::readScreenshotFile(goldenFile.c_str(), &goldenWidth, &goldenHeight, &goldenPixels)) {
+        comparison.result = COMPARE_MISSING_GOLDEN;
+        return;
+    }
+    if (width != goldenWidth || height != goldenHeight) {
+        comparison.result = COMPARE_SIZE_DIFFERENT;
+        return;
+    }
+    if (width == 0 || height == 0) {
+        comparison.result = COMPARE_MATCH;
+        return;
+    }
+
+    comparison.hashDistance = bit_count(perceptual_hash(pixels, width, height) ^ perceptual_hash(goldenPixels, width, height));
+    if (comparison.hashDistance > m_hashDistance) {
+        comparison.result = COMPARE_HASH_DIFFERENT;
+        return;
+    }
+
+    // Rows are compared as a whole first, only those with a difference above the tolerance are
+    // gone through pixel by pixel
+    size_t rowSize = 3 * (size_t)width;
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t *pRow = &pixels[y * rowSize];
+        const uint8_t *pGoldenRow = &goldenPixels[y * rowSize];
+        unsigned int rowDifference = max_difference(pRow, pGoldenRow, rowSize);
+        comparison.maxDifference = std::max(comparison.maxDifference, rowDifference);
+        if (rowDifference <= m_tolerance) continue;
+        for (uint32_t x = 0; x < width; x++) {
+            if (max_difference(pRow + 3 * x, pGoldenRow + 3 * x, 3) > m_tolerance) {
+                comparison.differentPixels++;
+            }
+        }
+    }
+    bool match = comparison.differentPixels * 1000000 <= (uint64_t)m_diffPpm * width * height;
+    comparison.result = match ? COMPARE_MATCH : COMPARE_DIFFERENT;
+}
+
+void ScreenshotComparer::thread_func() {
+    place_current_thread(THREAD_ROLE_WORKER);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_queued.wait(lock, [this] { return m_finishing || !m_queue.empty(); });
+        if (m_queue.empty()) return;
+        int frame = m_queue.front();
+        m_queue.pop_front();
+        lock.unlock();
+
+        // The layer writes screenshots on a thread of its own, and renames them once they are complete
+        std::string filename = screenshot_file(frame);
+        for (;;) {
+            if (file_exists(filename.c_str())) break;
+            lock.lock();
+            bool waited = m_finishing && vktrace_get_time() - m_finishTime > SCREENSHOT_WAIT_NS;
+            lock.unlock();
+            if (waited) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(SCREENSHOT_POLL_MS));
+        }
+
+        Comparison comparison = {frame, COMPARE_MISSING, 0, 0, 0};
+        compare(comparison);
+
+        lock.lock();
+        m_comparisons.push_back(comparison);
+    }
+}
+
+bool ScreenshotComparer::finish() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_finishing = true;
+        m_finishTime = vktrace_get_time();
+    }
+    m_queued.notify_all();
+    for (auto &thread : m_threads) {
+        thread.join();
+    }
+    m_threads.clear();
+    uint64_t waitTime = vktrace_get_time() - m_finishTime;
+
+    std::sort(m_comparisons.begin(), m_comparisons.end(),
+              [](const Comparison &a, const Comparison &b) { return a.frame < b.frame; });
+    unsigned int counts[COMPARE_RESULT_COUNT] = {};
+    for (const Comparison &comparison : m_comparisons) {
+        counts[comparison.result]++;
+        switch (comparison.result) {
+            case COMPARE_MATCH:
+                break;
+            case COMPARE_DIFFERENT:
+                vktrace_LogError("Frame %d differs from the golden screenshot in %" PRIu64 " pixels, by up to %u.",
+                                 comparison.frame, comparison.differentPixels, comparison.maxDifference);
+                break;
+            case COMPARE_HASH_DIFFERENT:
+                vktrace_LogError("Frame %d looks different from the golden screenshot, the perceptual hashes differ in %u bits.",
+                                 comparison.frame, comparison.hashDistance);
+                break;
+            case COMPARE_SIZE_DIFFERENT:
+                vktrace_LogError("Frame %d has a different size than the golden screenshot.", comparison.frame);
+                break;
+            case COMPARE_MISSING:
+                vktrace_LogError("No screenshot of frame %d was written.", comparison.frame);
+                break;
+            default:
+                vktrace_LogError("There is no golden screenshot of frame %d in %s.", comparison.frame, m_goldenDir.c_str());
+                break;
+        }
+    }
+
+    if (!m_reportFile.empty()) {
+        FILE *pReport = fopen(m_reportFile.c_str(), "w");
+        if (pReport == NULL) {
+            vktrace_LogError("Failed to open '%s' to write the screenshot comparison report to.", m_reportFile.c_str());
+        } else {
+            fprintf(pReport, "frame,result,different_pixels,max_difference,hash_distance\n");
+            for (const Comparison &comparison : m_comparisons) {
+                fprintf(pReport, "%d,%s,%" PRIu64 ",%u,%u\n", comparison.frame, resultNames[comparison.result],
+                        comparison.differentPixels, comparison.maxDifference, comparison.hashDistance);
+            }
+            fclose(pReport);
+        }
+    }
+
+    unsigned int different = counts[COMPARE_DIFFERENT] + counts[COMPARE_SIZE_DIFFERENT];
+    unsigned int missing = counts[COMPARE_MISSING] + counts[COMPARE_MISSING_GOLDEN];
+    vktrace_LogAlways("Compared %zu screenshots with %s: %u matched, %u differed, %u were rejected by their perceptual hash, "
+                      "%u were missing. Waited %.3f s for comparisons after replay.",
+                      m_comparisons.size(), m_goldenDir.c_str(), counts[COMPARE_MATCH], different, counts[COMPARE_HASH_DIFFERENT],
+                      missing, waitTime / 1000000000.0);
+    return counts[COMPARE_MATCH] == m_comparisons.size();
+}
+
+} /* namespace vktrace_replay */
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "screenshot_parsing.h"
+
+/* Compares the screenshots the screenshot layer writes during replay with golden screenshots of
+ * the same frames, on worker threads while replay goes on. Replay tells the comparer which frames
+ * it has presented, and a worker picks up each frame's screenshot once the layer has written it.
+ * A perceptual hash of both images rejects frames that look different right away. The others are
+ * compared pixel by pixel, pixels whose channels all differ by no more than the tolerance match,
+ * and a frame matches if few enough of its pixels don't. */
+namespace vktrace_replay {
+
+class ScreenshotComparer {
+   public:
+    // goldenDir holds the golden screenshots, named like the layer names the screenshots it writes.
+    // The other arguments are the settings of the same names, reportFile may be NULL.
+    ScreenshotComparer(const char *goldenDir, const char *screenshotList, unsigned int tolerance, unsigned int diffPpm,
+                       unsigned int hashDistance, const char *reportFile);
+    ~ScreenshotComparer();
+
+    // Replay has presented the frames below frameCount, queues those with screenshots not yet queued
+    void frames_presented(int frameCount);
+    // Once the layer has written every screenshot, after the device is destroyed, waits for the
+    // comparisons and reports them. Returns false if a frame didn't match.
+    bool finish();
+
+   private:
+    enum Result {
+        COMPARE_MATCH,
+        COMPARE_DIFFERENT,
+        COMPARE_HASH_DIFFERENT,  // rejected by the perceptual hash
+        COMPARE_SIZE_DIFFERENT,
+        COMPARE_MISSING,         // the layer didn't write the screenshot
+        COMPARE_MISSING_GOLDEN,
+        COMPARE_RESULT_COUNT,
+    };
+
+    struct Comparison {
+        int frame;
+        Result result;
+        uint64_t differentPixels;
+        unsigned int maxDifference;  // largest difference of a channel
+        unsigned int hashDistance;   // bits the perceptual hashes differ in
+    };
+
+    bool is_screenshot_frame(int frame) const;
+    std::string screenshot_file(int frame) const;
+    void compare(Comparison &comparison) const;
+    void thread_func();
+
+    std::string m_goldenDir;
+    std::string m_extension;  // of the files the layer writes
+    bool m_range;
+    screenshot::FrameRange m_frameRange;
+    std::set<int> m_frameList;
+    unsigned int m_tolerance;
+    unsigned int m_diffPpm;
+    unsigned int m_hashDistance;
+    std::string m_reportFile;
+
+    int m_nextFrame;  // first frame not yet queued
+    std::mutex m_mutex;
+    std::condition_variable m_queued;
+    std::deque<int> m_queue;
+    bool m_finishing;
+    uint64_t m_finishTime;
+    std::vector<Comparison> m_comparisons;
+    std::vector<std::thread> m_threads;
+};
+
+} /* namespace vktrace_replay */
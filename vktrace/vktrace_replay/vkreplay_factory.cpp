@@ -58,6 +58,8 @@ vktrace_trace_packet_replay_library* ReplayFactory::Create(uint8_t tracerId) {
             pReplayer->Dump = VkReplayDump;
             pReplayer->GetFrameNumber = VkReplayGetFrameNumber;
             pReplayer->ResetFrameNumber = VkReplayResetFrameNumber;
+            pReplayer->SaveLoopState = VkReplaySaveLoopState;
+            pReplayer->RestoreLoopState = VkReplayRestoreLoopState;
         }
     }
 
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <inttypes.h>
+#include "vkreplay_fastforward.h"
+#include "vktrace_platform.h"
+#include "vktrace_tracelog.h"
+
+namespace vktrace_replay {
+
+// Usage of an image whose rendered contents something may read afterwards
+static const VkImageUsageFlags FAST_FORWARD_READ_USAGE = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT |
+                                                         VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+FastForward::FastForward(int targetFrame) : m_targetFrame(targetFrame), m_active(targetFrame > 0), m_droppedDraws(0) {
+    if (m_active) {
+        vktrace_LogVerbose("Fast-forwarding to frame %d.", m_targetFrame);
+    }
+}
+
+void FastForward::add_image(VkImage image, VkImageUsageFlags usage) {
+    // Handles aren't forgotten when the objects are destroyed, a handle reused for another object
+    // only keeps draws that could have been dropped
+    if ((usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) != 0 &&
+        (usage & FAST_FORWARD_READ_USAGE) != 0) {
+        m_keptImages.insert(image);
+    }
+}
+
+void FastForward::add_image_view(VkImage image, VkImageView imageView) {
+    if (m_keptImages.count(image) != 0) {
+        m_keptImageViews.insert(imageView);
+    }
+}
+
+void FastForward::add_framebuffer(VkFramebuffer framebuffer, uint32_t attachmentCount, const VkImageView *pAttachments) {
+    for (uint32_t i = 0; i < attachmentCount && pAttachments != NULL; i++) {
+        if (m_keptImageViews.count(pAttachments[i]) != 0) {
+            m_keptFramebuffers.insert(framebuffer);
+            return;
+        }
+    }
+}
+
+void FastForward::add_command_buffers(uint32_t commandBufferCount, const VkCommandBuffer *pCommandBuffers) {
+    for (uint32_t i = 0; i < commandBufferCount; i++) {
+        CommandBuffer &info = m_commandBuffers[pCommandBuffers[i]];
+        info = CommandBuffer();
+    }
+}
+
+bool FastForward::keeps_draws(VkFramebuffer framebuffer) const {
+    return framebuffer == VK_NULL_HANDLE || m_keptFramebuffers.count(framebuffer) != 0;
+}
+
+void FastForward::begin_command_buffer(VkCommandBuffer commandBuffer, VkCommandBufferUsageFlags flags, VkFramebuffer framebuffer) {
+    auto it = m_commandBuffers.find(commandBuffer);
+    if (it == m_commandBuffers.end()) return;
+
+    CommandBuffer &info = it->second;
+    info.mayDrop = m_active && (info.recorded || (flags & VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT) != 0);
+    info.recorded = true;
+    info.dropping = info.mayDrop && (flags & VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT) != 0 && !keeps_draws(framebuffer);
+    info.dropped = false;
+    info.reported = false;
+}
+
+void FastForward::begin_render_pass(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer) {
+    auto it = m_commandBuffers.find(commandBuffer);
+    if (it == m_commandBuffers.end()) return;
+
+    it->second.dropping = it->second.mayDrop && !keeps_draws(framebuffer);
+}
+
+bool FastForward::skip_draw(VkCommandBuffer commandBuffer) {
+    auto it = m_commandBuffers.find(commandBuffer);
+    if (it == m_commandBuffers.end() || !it->second.dropping) return false;
+
+    it->second.dropped = true;
+    m_droppedDraws++;
+    return true;
+}
+
+void FastForward::submit(int frame, uint32_t submitCount, const VkSubmitInfo *pSubmits) {
+    if (m_active) return;
+
+    for (uint32_t i = 0; i < submitCount; i++) {
+        for (uint32_t j = 0; j < pSubmits[i].commandBufferCount; j++) {
+            auto it = m_commandBuffers.find(pSubmits[i].pCommandBuffers[j]);
+            if (it != m_commandBuffers.end() && it->second.dropped && !it->second.reported) {
+                vktrace_LogWarning(
+                    "Command buffer %p, recorded without its draws before frame %d, is submitted again in frame %d. Its draws "
+                    "are missing.",
+                    pSubmits[i].pCommandBuffers[j], m_targetFrame, frame);
+                it->second.reported = true;
+            }
+        }
+    }
+}
+
+void FastForward::end_frame(int frame) {
+    if (!m_active || frame < m_targetFrame) return;
+
+    m_active = false;
+    vktrace_LogVerbose("Reached frame %d, left out %" PRIu64 " draws on the way.", frame, m_droppedDraws.load());
+}
+
+} /* namespace vktrace_replay */
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+#include "vulkan/vulkan.h"
+
+/* Replays the frames before a target frame without the draws that only make what those frames
+ * show, so replay gets to the target quickly with the objects, memory contents and descriptor sets
+ * it would have had. Everything but draws is replayed, render passes included, so the layout
+ * transitions, clears and resolves they do still happen. The draws of a render pass instance are
+ * dropped unless one of its attachments is an image that can be read after being rendered to:
+ * one that is sampled, used as storage or input attachment, or copied from. Those are the render
+ * targets a later frame may read.
+ *
+ * Draws are dropped while recording, so a recording submitted again after the target would be
+ * missing them. Only recordings that aren't expected to be submitted again drop draws: those
+ * begun with VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, and the later recordings of command
+ * buffers the trace records again and again. Submitting a recording that dropped draws after the
+ * target is reported. All handles are the replay ones. Recording calls may come from the
+ * recording threads, everything else from the replay thread while they are idle. */
+namespace vktrace_replay {
+
+class FastForward {
+   public:
+    explicit FastForward(int targetFrame);
+
+    // After the successful real create calls
+    void add_image(VkImage image, VkImageUsageFlags usage);
+    void add_image_view(VkImage image, VkImageView imageView);
+    void add_framebuffer(VkFramebuffer framebuffer, uint32_t attachmentCount, const VkImageView *pAttachments);
+    void add_command_buffers(uint32_t commandBufferCount, const VkCommandBuffer *pCommandBuffers);
+
+    // After the successful real vkBeginCommandBuffer, with the framebuffer a secondary command
+    // buffer continues a render pass in, if any
+    void begin_command_buffer(VkCommandBuffer commandBuffer, VkCommandBufferUsageFlags flags, VkFramebuffer framebuffer);
+    // Before the real vkCmdBeginRenderPass
+    void begin_render_pass(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer);
+    // Whether the draw about to be recorded into commandBuffer is to be left out
+    bool skip_draw(VkCommandBuffer commandBuffer);
+
+    // After a successful real vkQueueSubmit
+    void submit(int frame, uint32_t submitCount, const VkSubmitInfo *pSubmits);
+    // After the real vkQueuePresentKHR, with the number of the frame that starts
+    void end_frame(int frame);
+
+   private:
+    struct CommandBuffer {
+        bool recorded;   // the trace recorded the command buffer before
+        bool mayDrop;    // the recording isn't expected to be submitted again
+        bool dropping;   // in a render pass instance whose draws are dropped
+        bool dropped;    // draws of the recording were dropped
+        bool reported;   // a submission after the target was reported
+    };
+
+    bool keeps_draws(VkFramebuffer framebuffer) const;
+
+    int m_targetFrame;
+    bool m_active;
+    std::atomic<uint64_t> m_droppedDraws;
+
+    // Only changed from the replay thread
+    std::unordered_map<VkCommandBuffer, CommandBuffer> m_commandBuffers;
+    // Images that can be read after being rendered to, their views and the framebuffers using them
+    std::unordered_set<VkImage> m_keptImages;
+    std::unordered_set<VkImageView> m_keptImageViews;
+    std::unordered_set<VkFramebuffer> m_keptFramebuffers;
+};
+
+} /* namespace vktrace_replay */
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include "vkreplay_headless.h"
+#include "vkreplay_vk_func_ptrs.h"
+#include "vktrace_platform.h"
+#include "vktrace_tracelog.h"
+
+namespace vktrace_replay {
+
+HeadlessSwapchains::~HeadlessSwapchains() {
+    // The devices of swapchains the trace never destroyed may be gone already
+    for (size_t i = 0; i < m_swapchains.size(); i++) {
+        delete m_swapchains[i];
+    }
+}
+
+VkSurfaceKHR HeadlessSwapchains::create_surface() { return (VkSurfaceKHR)++m_surfaceCount; }
+
+VkResult HeadlessSwapchains::create_swapchain(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex,
+                                              const VkSwapchainCreateInfoKHR *pCreateInfo, VkSwapchainKHR *pSwapchain) {
+    Swapchain *pNew = new Swapchain();
+    pNew->physicalDevice = physicalDevice;
+    pNew->device = device;
+    m_vkFuncs.real_vkGetDeviceQueue(device, queueFamilyIndex, 0, &pNew->queue);
+    pNew->createInfo = *pCreateInfo;
+    pNew->createInfo.pNext = NULL;
+    if (pCreateInfo->imageSharingMode == VK_SHARING_MODE_CONCURRENT && pCreateInfo->pQueueFamilyIndices != NULL) {
+        pNew->queueFamilyIndices.assign(pCreateInfo->pQueueFamilyIndices,
+                                        pCreateInfo->pQueueFamilyIndices + pCreateInfo->queueFamilyIndexCount);
+    }
+    pNew->createInfo.pQueueFamilyIndices = pNew->queueFamilyIndices.data();
+    pNew->createInfo.oldSwapchain = VK_NULL_HANDLE;
+
+    m_swapchains.push_back(pNew);
+    *pSwapchain = (VkSwapchainKHR)(uintptr_t)pNew;
+    return VK_SUCCESS;
+}
+
+void HeadlessSwapchains::destroy_swapchain(VkSwapchainKHR swapchain) {
+    auto found = std::find(m_swapchains.begin(), m_swapchains.end(), get(swapchain));
+    if (found == m_swapchains.end()) return;
+    Swapchain *pSwapchain = *found;
+    for (size_t i = 0; i < pSwapchain->images.size(); i++) {
+        Image &image = pSwapchain->images[i];
+        wait_for_present(pSwapchain, image);
+        m_vkFuncs.real_vkDestroyFence(pSwapchain->device, image.presented, NULL);
+        m_vkFuncs.real_vkDestroyImage(pSwapchain->device, image.image, NULL);
+        m_vkFuncs.real_vkFreeMemory(pSwapchain->device, image.memory, NULL);
+    }
+    m_swapchains.erase(found);
+    delete pSwapchain;
+}
+
+VkResult HeadlessSwapchains::create_image(Swapchain *pSwapchain, Image *pImage) {
+    const VkSwapchainCreateInfoKHR &info = pSwapchain->createInfo;
+    VkImageCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    createInfo.imageType = VK_IMAGE_TYPE_2D;
+    createInfo.format = info.imageFormat;
+    createInfo.extent.width = info.imageExtent.width;
+    createInfo.extent.height = info.imageExtent.height;
+    createInfo.extent.depth = 1;
+    createInfo.mipLevels = 1;
+    createInfo.arrayLayers = info.imageArrayLayers;
+    createInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    createInfo.usage = info.imageUsage;
+    createInfo.sharingMode = info.imageSharingMode;
+    createInfo.queueFamilyIndexCount = (uint32_t)pSwapchain->queueFamilyIndices.size();
+    createInfo.pQueueFamilyIndices = pSwapchain->queueFamilyIndices.data();
+    createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkResult result = m_vkFuncs.real_vkCreateImage(pSwapchain->device, &createInfo, NULL, &pImage->image);
+    if (result != VK_SUCCESS) return result;
+
+    VkMemoryRequirements requirements;
+    m_vkFuncs.real_vkGetImageMemoryRequirements(pSwapchain->device, pImage->image, &requirements);
+    VkPhysicalDeviceMemoryProperties properties;
+    m_vkFuncs.real_vkGetPhysicalDeviceMemoryProperties(pSwapchain->physicalDevice, &properties);
+    uint32_t memoryType = UINT32_MAX;
+    for (uint32_t i = 0; i < properties.memoryTypeCount; i++) {
+        if ((requirements.memoryTypeBits & (1 << i)) == 0) continue;
+        if (memoryType == UINT32_MAX || (properties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0) {
+            memoryType = i;
+            if ((properties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0) break;
+        }
+    }
+    VkMemoryAllocateInfo allocateInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, requirements.size, memoryType};
+    result = memoryType != UINT32_MAX
+                 ? m_vkFuncs.real_vkAllocateMemory(pSwapchain->device, &allocateInfo, NULL, &pImage->memory)
+                 : VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    if (result == VK_SUCCESS) {
+        result = m_vkFuncs.real_vkBindImageMemory(pSwapchain->device, pImage->image, pImage->memory, 0);
+        if (result != VK_SUCCESS) {
+            m_vkFuncs.real_vkFreeMemory(pSwapchain->device, pImage->memory, NULL);
+        }
+    }
+    if (result != VK_SUCCESS) {
+        m_vkFuncs.real_vkDestroyImage(pSwapchain->device, pImage->image, NULL);
+        return result;
+    }
+
+    VkFenceCreateInfo fenceInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, NULL, 0};
+    result = m_vkFuncs.real_vkCreateFence(pSwapchain->device, &fenceInfo, NULL, &pImage->presented);
+    if (result != VK_SUCCESS) {
+        m_vkFuncs.real_vkDestroyImage(pSwapchain->device, pImage->image, NULL);
+        m_vkFuncs.real_vkFreeMemory(pSwapchain->device, pImage->memory, NULL);
+        return result;
+    }
+    pImage->presenting = false;
+    return VK_SUCCESS;
+}
+
+VkResult HeadlessSwapchains::get_images(VkSwapchainKHR swapchain, uint32_t *pImageCount, VkImage *pImages) {
+    Swapchain *pSwapchain = get(swapchain);
+    uint32_t count = std::max(*pImageCount, pSwapchain->createInfo.minImageCount);
+    while (pSwapchain->images.size() < count) {
+        Image image;
+        VkResult result = create_image(pSwapchain, &image);
+        if (result != VK_SUCCESS) {
+            vktrace_LogError("Failed to create an offscreen image of %ux%u for a headless swapchain.",
+                             pSwapchain->createInfo.imageExtent.width, pSwapchain->createInfo.imageExtent.height);
+            return result;
+        }
+        pSwapchain->images.push_back(image);
+    }
+    if (pImages != NULL) {
+        for (uint32_t i = 0; i < *pImageCount; i++) {
+            pImages[i] = pSwapchain->images[i].image;
+        }
+    }
+    return VK_SUCCESS;
+}
+
+void HeadlessSwapchains::wait_for_present(Swapchain *pSwapchain, Image &image) {
+    if (!image.presenting) return;
+    m_vkFuncs.real_vkWaitForFences(pSwapchain->device, 1, &image.presented, VK_TRUE, UINT64_MAX);
+    m_vkFuncs.real_vkResetFences(pSwapchain->device, 1, &image.presented);
+    image.presenting = false;
+}
+
+VkResult HeadlessSwapchains::acquire(VkSwapchainKHR swapchain, uint32_t imageIndex, VkSemaphore semaphore, VkFence fence) {
+    Swapchain *pSwapchain = get(swapchain);
+    if (imageIndex >= pSwapchain->images.size()) {
+        vktrace_LogError("Trace acquired image %u of a headless swapchain with %zu images.", imageIndex,
+                         pSwapchain->images.size());
+        return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
+    wait_for_present(pSwapchain, pSwapchain->images[imageIndex]);
+    if (semaphore == VK_NULL_HANDLE && fence == VK_NULL_HANDLE) return VK_SUCCESS;
+
+    VkSubmitInfo submit = {};
+    submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit.signalSemaphoreCount = semaphore != VK_NULL_HANDLE ? 1 : 0;
+    submit.pSignalSemaphores = &semaphore;
+    return m_vkFuncs.real_vkQueueSubmit(pSwapchain->queue, 1, &submit, fence);
+}
+
+VkResult HeadlessSwapchains::present(VkQueue queue, const VkPresentInfoKHR *pPresentInfo) {
+    std::vector<VkPipelineStageFlags> waitStages(pPresentInfo->waitSemaphoreCount, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    VkResult result = VK_SUCCESS;
+    for (uint32_t i = 0; i < pPresentInfo->swapchainCount; i++) {
+        Swapchain *pSwapchain = get(pPresentInfo->pSwapchains[i]);
+        uint32_t imageIndex = pPresentInfo->pImageIndices[i];
+        VkResult swapchainResult = VK_ERROR_VALIDATION_FAILED_EXT;
+        if (imageIndex < pSwapchain->images.size()) {
+            Image &image = pSwapchain->images[imageIndex];
+            wait_for_present(pSwapchain, image);
+            // The first submit consumes the semaphores
+            VkSubmitInfo submit = {};
+            submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            if (i == 0) {
+                submit.waitSemaphoreCount = pPresentInfo->waitSemaphoreCount;
+                submit.pWaitSemaphores = pPresentInfo->pWaitSemaphores;
+                submit.pWaitDstStageMask = waitStages.data();
+            }
+            swapchainResult = m_vkFuncs.real_vkQueueSubmit(queue, 1, &submit, image.presented);
+            image.presenting = swapchainResult == VK_SUCCESS;
+        }
+        if (pPresentInfo->pResults != NULL) {
+            pPresentInfo->pResults[i] = swapchainResult;
+        }
+        if (result == VK_SUCCESS) {
+            result = swapchainResult;
+        }
+    }
+    return result;
+}
+
+} /* namespace vktrace_replay */
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <vector>
+#include "vulkan/vulkan.h"
+
+struct vkFuncs;
+
+/* Stands in for surfaces and swapchains when replaying without a window. Surfaces are handles
+ * nothing is created for, and a swapchain is a set of images in device memory with the create
+ * info of the traced swapchain. An acquire hands out the image the trace acquired once the
+ * previous present of it has finished, and signals the semaphore and fence on the device's queue.
+ * A present waits for its semaphores in an empty submit that signals a fence of the image. All
+ * handles are the replay ones except the image indices, which are the traced ones. */
+namespace vktrace_replay {
+
+class HeadlessSwapchains {
+   public:
+    explicit HeadlessSwapchains(const vkFuncs &funcs) : m_vkFuncs(funcs), m_surfaceCount(0) {}
+    ~HeadlessSwapchains();
+
+    VkSurfaceKHR create_surface();
+
+    VkResult create_swapchain(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex,
+                              const VkSwapchainCreateInfoKHR *pCreateInfo, VkSwapchainKHR *pSwapchain);
+    void destroy_swapchain(VkSwapchainKHR swapchain);
+    // *pImageCount is the trace's count, which the swapchain creates as many images as
+    VkResult get_images(VkSwapchainKHR swapchain, uint32_t *pImageCount, VkImage *pImages);
+    VkResult acquire(VkSwapchainKHR swapchain, uint32_t imageIndex, VkSemaphore semaphore, VkFence fence);
+    VkResult present(VkQueue queue, const VkPresentInfoKHR *pPresentInfo);
+
+   private:
+    struct Image {
+        VkImage image;
+        VkDeviceMemory memory;
+        VkFence presented;  // signaled once the last present of the image is done
+        bool presenting;
+    };
+
+    struct Swapchain {
+        VkPhysicalDevice physicalDevice;
+        VkDevice device;
+        VkQueue queue;
+        VkSwapchainCreateInfoKHR createInfo;
+        std::vector<uint32_t> queueFamilyIndices;
+        std::vector<Image> images;
+    };
+
+    static Swapchain *get(VkSwapchainKHR swapchain) { return (Swapchain *)(uintptr_t)swapchain; }
+    VkResult create_image(Swapchain *pSwapchain, Image *pImage);
+    void wait_for_present(Swapchain *pSwapchain, Image &image);
+
+    const vkFuncs &m_vkFuncs;
+    std::vector<Swapchain *> m_swapchains;
+    uint64_t m_surfaceCount;
+};
+
+} /* namespace vktrace_replay */
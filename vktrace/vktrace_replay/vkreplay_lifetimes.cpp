@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <inttypes.h>
+#include <string.h>
+#include <algorithm>
+#include "vkreplay_lifetimes.h"
+#include "vktrace_platform.h"
+#include "vktrace_tracelog.h"
+#include "vktrace_trace_packet_utils.h"
+#include "vktrace_vk_packet_id.h"
+#include "vktrace_vk_vk_packets.h"
+
+// 64K bits, so each lookup that misses costs a multiply and a load from an array that stays in cache
+static const size_t LIFETIME_FILTER_BITS = 16;
+
+namespace vktrace_replay {
+
+static inline size_t filter_bit(uint64_t handle) {
+    return (size_t)((handle * 0x9E3779B97F4A7C15ULL) >> (64 - LIFETIME_FILTER_BITS));
+}
+
+// Pointer in a raw packet body, or NULL if the size bytes it points at don't lie within the packet
+static void *packet_pointer(vktrace_trace_packet_header *pPacket, const void *pOffset, size_t size) {
+    uintptr_t offset = (uintptr_t)pOffset;
+    if (offset == 0 || offset > pPacket->size - sizeof(vktrace_trace_packet_header) ||
+        size > pPacket->size - sizeof(vktrace_trace_packet_header) - offset) {
+        return NULL;
+    }
+    return vktrace_trace_packet_interpret_buffer_pointer(pPacket, (intptr_t)pOffset);
+}
+
+bool TraceLifetimes::is_recording_packet(const vktrace_trace_packet_header *pPacket) {
+    if (pPacket->packet_id == VKTRACE_TPI_VK_vkBeginCommandBuffer || pPacket->packet_id == VKTRACE_TPI_VK_vkEndCommandBuffer ||
+        pPacket->packet_id == VKTRACE_TPI_CMD_BLOCK) {
+        return true;
+    }
+    const char *pName = vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)pPacket->packet_id);
+    return pName != NULL && strncmp(pName, "vkCmd", 5) == 0;
+}
+
+void TraceLifetimes::add_object(ObjectType type, uint64_t handle, size_t releasePoint) {
+    if (handle == 0) return;
+    LiveObject &object = m_live[handle];
+    object.type = type;
+    object.releasePoint = releasePoint;
+    size_t bit = filter_bit(handle);
+    m_filter[bit / 64] |= 1ULL << (bit % 64);
+}
+
+void TraceLifetimes::use_object(uint64_t handle, size_t releasePoint) {
+    size_t bit = filter_bit(handle);
+    if ((m_filter[bit / 64] & (1ULL << (bit % 64))) == 0) return;
+    auto it = m_live.find(handle);
+    if (it != m_live.end()) {
+        it->second.releasePoint = releasePoint;
+    }
+}
+
+void TraceLifetimes::use_objects(const uint8_t *pBytes, size_t size, size_t releasePoint) {
+    // Structs in a packet are packed at 4 byte alignment, and so are the words of a command block
+    for (size_t offset = 0; offset + sizeof(uint64_t) <= size; offset += 4) {
+        uint64_t word;
+        memcpy(&word, pBytes + offset, sizeof(word));
+        if (word != 0) {
+            use_object(word, releasePoint);
+        }
+    }
+}
+
+void TraceLifetimes::scan_packet(const vktrace_trace_packet_header *pPacket, size_t releasePoint) {
+    vktrace_trace_packet_header *pHeader = const_cast<vktrace_trace_packet_header *>(pPacket);
+    const uint8_t *pBody = (const uint8_t *)pPacket + sizeof(vktrace_trace_packet_header);
+    size_t bodySize = (size_t)pPacket->size - sizeof(vktrace_trace_packet_header);
+
+    switch (pPacket->packet_id) {
+        // The data written to mapped memory is most of these packets, only the memory objects are worth looking for
+        case VKTRACE_TPI_VK_vkFlushMappedMemoryRanges:
+        case VKTRACE_TPI_VK_vkInvalidateMappedMemoryRanges: {
+            if (bodySize < sizeof(packet_vkFlushMappedMemoryRanges)) return;
+            const packet_vkFlushMappedMemoryRanges *pBodyPacket = (const packet_vkFlushMappedMemoryRanges *)pBody;
+            const VkMappedMemoryRange *pRanges = (const VkMappedMemoryRange *)packet_pointer(
+                pHeader, pBodyPacket->pMemoryRanges, (size_t)pBodyPacket->memoryRangeCount * sizeof(VkMappedMemoryRange));
+            for (uint32_t i = 0; pRanges != NULL && i < pBodyPacket->memoryRangeCount; i++) {
+                use_object((uint64_t)(pRanges[i].memory), releasePoint);
+            }
+            return;
+        }
+        case VKTRACE_TPI_VK_vkUnmapMemory:
+            if (bodySize < sizeof(packet_vkUnmapMemory)) return;
+            use_object((uint64_t)(((const packet_vkUnmapMemory *)pBody)->memory), releasePoint);
+            return;
+        // An object destroyed by the trace is already forgotten by the call that destroys it
+        case VKTRACE_TPI_VK_vkDestroyBuffer:
+            if (bodySize < sizeof(packet_vkDestroyBuffer)) return;
+            m_live.erase((uint64_t)(((const packet_vkDestroyBuffer *)pBody)->buffer));
+            return;
+        case VKTRACE_TPI_VK_vkDestroyImage:
+            if (bodySize < sizeof(packet_vkDestroyImage)) return;
+            m_live.erase((uint64_t)(((const packet_vkDestroyImage *)pBody)->image));
+            return;
+        case VKTRACE_TPI_VK_vkFreeMemory:
+            if (bodySize < sizeof(packet_vkFreeMemory)) return;
+            m_live.erase((uint64_t)(((const packet_vkFreeMemory *)pBody)->memory));
+            return;
+        default:
+            break;
+    }
+
+    // Past the body's pointer to its header, which holds an address in the traced process
+    if (bodySize > sizeof(vktrace_trace_packet_header *)) {
+        use_objects(pBody + sizeof(vktrace_trace_packet_header *), bodySize - sizeof(vktrace_trace_packet_header *), releasePoint);
+    }
+
+    switch (pPacket->packet_id) {
+        case VKTRACE_TPI_VK_vkCreateBuffer: {
+            const packet_vkCreateBuffer *pBodyPacket = (const packet_vkCreateBuffer *)pBody;
+            if (bodySize < sizeof(packet_vkCreateBuffer) || pBodyPacket->result != VK_SUCCESS) return;
+            const VkBuffer *pBuffer = (const VkBuffer *)packet_pointer(pHeader, pBodyPacket->pBuffer, sizeof(VkBuffer));
+            if (pBuffer != NULL) add_object(OBJECT_BUFFER, (uint64_t)(*pBuffer), releasePoint);
+            break;
+        }
+        case VKTRACE_TPI_VK_vkCreateImage: {
+            const packet_vkCreateImage *pBodyPacket = (const packet_vkCreateImage *)pBody;
+            if (bodySize < sizeof(packet_vkCreateImage) || pBodyPacket->result != VK_SUCCESS) return;
+            const VkImage *pImage = (const VkImage *)packet_pointer(pHeader, pBodyPacket->pImage, sizeof(VkImage));
+            if (pImage != NULL) add_object(OBJECT_IMAGE, (uint64_t)(*pImage), releasePoint);
+            break;
+        }
+        case VKTRACE_TPI_VK_vkAllocateMemory: {
+            const packet_vkAllocateMemory *pBodyPacket = (const packet_vkAllocateMemory *)pBody;
+            if (bodySize < sizeof(packet_vkAllocateMemory) || pBodyPacket->result != VK_SUCCESS) return;
+            const VkDeviceMemory *pMemory =
+                (const VkDeviceMemory *)packet_pointer(pHeader, pBodyPacket->pMemory, sizeof(VkDeviceMemory));
+            if (pMemory != NULL) add_object(OBJECT_MEMORY, (uint64_t)(*pMemory), releasePoint);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+bool TraceLifetimes::analyze(FileLike *pFile) {
+    uint64_t startTime = vktrace_get_time();
+    size_t position = vktrace_FileLike_GetCurrentPosition(pFile);
+    m_filter.assign(((size_t)1 << LIFETIME_FILTER_BITS) / 64, 0);
+
+    // global_packet_index of each call objects can be released at, in trace order. Objects used by a
+    // packet are released at the first such call after it.
+    std::vector<uint64_t> releasePoints;
+    uint64_t packets = 0;
+    vktrace_trace_packet_header *pPacket;
+    while ((pPacket = vktrace_read_trace_packet(pFile)) != NULL) {
+        if (pPacket->packet_id >= VKTRACE_TPI_VK_vkApiVersion && pPacket->packet_id != VKTRACE_TPI_BLOB &&
+            pPacket->tracer_id == VKTRACE_TID_VULKAN) {
+            if (!is_recording_packet(pPacket)) {
+                releasePoints.push_back(pPacket->global_packet_index);
+            }
+            scan_packet(pPacket, releasePoints.size());
+            packets++;
+        }
+        vktrace_free(pPacket);
+    }
+
+    // Objects still live at the end are released after their last use, unless nothing can be released after it
+    std::vector<std::pair<size_t, Object>> released;
+    for (auto it = m_live.begin(); it != m_live.end(); ++it) {
+        if (it->second.releasePoint < releasePoints.size()) {
+            Object object = {it->second.type, it->first};
+            released.push_back(std::make_pair(it->second.releasePoint, object));
+        }
+    }
+    std::sort(released.begin(), released.end(),
+              [](const std::pair<size_t, Object> &a, const std::pair<size_t, Object> &b) { return a.first < b.first; });
+    m_released.reserve(released.size());
+    for (size_t i = 0; i < released.size(); i++) {
+        if (i == 0 || released[i].first != released[i - 1].first) {
+            ReleasePoint point = {(uint32_t)m_released.size(), 0};
+            m_releasePoints[releasePoints[released[i].first]] = point;
+        }
+        m_releasePoints[releasePoints[released[i].first]].count++;
+        m_released.push_back(released[i].second);
+    }
+
+    std::unordered_map<uint64_t, LiveObject>().swap(m_live);
+    std::vector<uint64_t>().swap(m_filter);
+    vktrace_LogVerbose("Found the last use of %" PRIu64 " objects in %" PRIu64 " calls in %.1f ms.", (uint64_t)m_released.size(),
+                       packets, (vktrace_get_time() - startTime) / 1000000.0);
+
+    if (!vktrace_FileLike_SetCurrentPosition(pFile, position)) {
+        vktrace_LogError("Failed to go back to the first packet of the trace file.");
+        return false;
+    }
+    return true;
+}
+
+} /* namespace vktrace_replay */
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+extern "C" {
+#include "vktrace_filelike.h"
+#include "vktrace_trace_packet_identifiers.h"
+}
+
+/* Finds, before replay, the last call that uses each buffer, image and memory allocation the trace
+ * creates and never destroys, so the replayer can forget about them after that call instead of
+ * keeping their bookkeeping until the end. Traces that never destroy anything otherwise keep all of
+ * it for every object they ever created.
+ *
+ * A call uses an object if its packet body holds the object's trace handle anywhere, at any 4 byte
+ * alignment, so data that happens to look like a handle only makes an object live longer. The
+ * objects are released at the first call after their last use that isn't a command buffer
+ * recording call: vkreplay replays those on the replay thread once the recording threads are idle.
+ * All handles are the trace ones. */
+namespace vktrace_replay {
+
+class TraceLifetimes {
+   public:
+    enum ObjectType { OBJECT_BUFFER, OBJECT_IMAGE, OBJECT_MEMORY };
+
+    struct Object {
+        ObjectType type;
+        uint64_t handle;
+    };
+
+    TraceLifetimes() {}
+
+    // Read the packets of pFile from where it is to the end, and go back there. Returns false if
+    // it can't go back.
+    bool analyze(FileLike *pFile);
+
+    // Objects that neither the call with global_packet_index nor any later call uses, or NULL if there aren't any
+    const Object *released_at(uint64_t packetIndex, uint32_t *pCount) const {
+        auto it = m_releasePoints.find(packetIndex);
+        if (it == m_releasePoints.end()) {
+            *pCount = 0;
+            return NULL;
+        }
+        *pCount = it->second.count;
+        return &m_released[it->second.first];
+    }
+
+    size_t released_count() const { return m_released.size(); }
+
+   private:
+    struct LiveObject {
+        ObjectType type;
+        size_t releasePoint;  // into the calls that objects can be released at
+    };
+
+    struct ReleasePoint {
+        uint32_t first;  // into m_released
+        uint32_t count;
+    };
+
+    static bool is_recording_packet(const vktrace_trace_packet_header *pPacket);
+    void add_object(ObjectType type, uint64_t handle, size_t releasePoint);
+    void use_objects(const uint8_t *pBytes, size_t size, size_t releasePoint);
+    void use_object(uint64_t handle, size_t releasePoint);
+    void scan_packet(const vktrace_trace_packet_header *pPacket, size_t releasePoint);
+
+    std::unordered_map<uint64_t, LiveObject> m_live;
+    // Bit per hash of the live handles, which most words of a packet miss
+    std::vector<uint64_t> m_filter;
+
+    std::unordered_map<uint64_t, ReleasePoint> m_releasePoints;  // by global_packet_index
+    std::vector<Object> m_released;
+};
+
+} /* namespace vktrace_replay */
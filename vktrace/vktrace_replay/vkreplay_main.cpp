@@ -22,7 +22,13 @@
  **************************************************************************/
 
 #include <stdio.h>
+#include <inttypes.h>
+#include <memory>
 #include <string>
+#if defined(WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
 #if defined(ANDROID)
 #include <sstream>
 #include <android/log.h>
@@ -31,14 +37,29 @@
 #include "vktrace_common.h"
 #include "vktrace_tracelog.h"
 #include "vktrace_filelike.h"
+#include "vktrace_compression.h"
 #include "vktrace_trace_packet_utils.h"
+#include "vktrace_blob_store.h"
 #include "vkreplay_main.h"
 #include "vkreplay_factory.h"
 #include "vkreplay_seq.h"
+#include "vkreplay_profile.h"
+#include "vkreplay_threads.h"
+#include "vkreplay_relocations.h"
 #include "vkreplay_window.h"
+#include "vkreplay_segments.h"
+#include "vkreplay_pacing.h"
+#include "vkreplay_placement.h"
+#include "vkreplay_compare.h"
+#include "vkreplay_recording_cache.h"
+#include "vktrace_vk_packet_id.h"
+#include "vk_timeline.h"
 #include "screenshot_parsing.h"
 
-vkreplayer_settings replaySettings = {NULL, 1, -1, -1, NULL, NULL, NULL};
+vkreplayer_settings replaySettings = {NULL, 1, -1, -1, NULL, NULL, NULL, 0, 0, FALSE, FALSE, FALSE, 0, NULL, FALSE, 0, FALSE, 0, 0, NULL, NULL, NULL, NULL, FALSE, FALSE, NULL, 0, 0, 10, NULL, NULL, FALSE, FALSE, FALSE, NULL};
+
+// Start of each frame in the trace file, empty if the trace doesn't have a frame table
+static std::vector<vktrace_frame_table_entry> frameTable;
 
 vktrace_SettingInfo g_settings_info[] = {
     {"o",
@@ -47,7 +68,7 @@ vktrace_SettingInfo g_settings_info[] = {
      {&replaySettings.pTraceFilePath},
      {&replaySettings.pTraceFilePath},
      TRUE,
-     "The trace file to open and replay."},
+     "The trace file to open and replay. \"-\" replays the trace arriving on the standard input, while it arrives."},
     {"t",
      "TraceFile",
      VKTRACE_SETTING_STRING,
@@ -93,6 +114,227 @@ vktrace_SettingInfo g_settings_info[] = {
      {&replaySettings.screenshotColorFormat},
      TRUE,
      "Color Space format of screenshot files. Formats are UNORM, SNORM, USCALED, SSCALED, UINT, SINT, SRGB"},
+    {"pf",
+     "PrefetchFrames",
+     VKTRACE_SETTING_UINT,
+     {&replaySettings.prefetchFrames},
+     {&replaySettings.prefetchFrames},
+     TRUE,
+     "Number of frames to read and interpret ahead of replay on a separate thread. 0 disables prefetching."},
+    {"cp",
+     "CaptureProfile",
+     VKTRACE_SETTING_UINT,
+     {&replaySettings.captureProfileFrames},
+     {&replaySettings.captureProfileFrames},
+     TRUE,
+     "Instead of replaying, print how much time the driver and vktrace spent in each API when the trace was captured, and "
+     "break down the <uint> frames with the most vktrace overhead. 0 replays the trace."},
+    {"mt",
+     "MultithreadedReplay",
+     VKTRACE_SETTING_BOOL,
+     {&replaySettings.multithreadedReplay},
+     {&replaySettings.multithreadedReplay},
+     TRUE,
+     "Record command buffers on one thread per thread of the traced application, like it did. Can't be combined with "
+     "PrefetchFrames."},
+    {"lrs",
+     "LoopRestoreState",
+     VKTRACE_SETTING_BOOL,
+     {&replaySettings.loopRestoreState},
+     {&replaySettings.loopRestoreState},
+     TRUE,
+     "Save the contents of all device memory when replay reaches LoopStartFrame, and copy them back before every later "
+     "loop, so each loop starts from the same state."},
+    {"pc",
+     "PipelineCache",
+     VKTRACE_SETTING_BOOL,
+     {&replaySettings.pipelineCache},
+     {&replaySettings.pipelineCache},
+     TRUE,
+     "Create pipelines with a pipeline cache that is kept in a file next to the trace, one per GPU and driver version, so "
+     "later replays of the trace don't compile them again."},
+    {"pt",
+     "PipelineThreads",
+     VKTRACE_SETTING_UINT,
+     {&replaySettings.pipelineThreads},
+     {&replaySettings.pipelineThreads},
+     TRUE,
+     "Number of threads that compile the pipelines of consecutive vkCreate*Pipelines calls while replay continues up to the "
+     "first call that could use them. 0 compiles them on the replay thread. Can't be combined with MultithreadedReplay."},
+    {"gt",
+     "GpuTimestamps",
+     VKTRACE_SETTING_STRING,
+     {&replaySettings.gpuTimestampsFile},
+     {&replaySettings.gpuTimestampsFile},
+     TRUE,
+     "Time each primary command buffer, render pass and debug marker region on the GPU, and write one line per region and "
+     "submission to the CSV file <string>, with the frame, the global_packet_index of the call that began the region and its "
+     "GPU time in milliseconds."},
+    {"hl",
+     "Headless",
+     VKTRACE_SETTING_BOOL,
+     {&replaySettings.headless},
+     {&replaySettings.headless},
+     TRUE,
+     "Replay without a window. Swapchain images are offscreen images, and presents only wait for their semaphores, so "
+     "replay isn't held to the display's refresh rate. Screenshot has no effect."},
+    {"sa",
+     "Suballocate",
+     VKTRACE_SETTING_UINT,
+     {&replaySettings.suballocationBlockSize},
+     {&replaySettings.suballocationBlockSize},
+     TRUE,
+     "Place memory allocations of up to a quarter of <uint> MiB in blocks of <uint> MiB of the same memory type, so the "
+     "driver makes fewer allocations and traces with many of them stay under maxMemoryAllocationCount. 0 allocates each one "
+     "on its own."},
+    {"cpl",
+     "CollapsePolling",
+     VKTRACE_SETTING_BOOL,
+     {&replaySettings.collapsePolling},
+     {&replaySettings.collapsePolling},
+     TRUE,
+     "Skip the vkGetFenceStatus, vkGetEventStatus and vkGetQueryPoolResults calls that found the fence, event or queries "
+     "not ready when traced, and replay the call that found them ready as a blocking wait."},
+    {"ff",
+     "FastForward",
+     VKTRACE_SETTING_UINT,
+     {&replaySettings.fastForwardFrame},
+     {&replaySettings.fastForwardFrame},
+     TRUE,
+     "Replay the frames before frame <uint> without the draws of render passes that only render to images nothing reads "
+     "back, to get to that frame quickly. 0 replays every draw."},
+    {"seg",
+     "Segments",
+     VKTRACE_SETTING_UINT,
+     {&replaySettings.segments},
+     {&replaySettings.segments},
+     TRUE,
+     "Split the frames into <uint> segments and replay them at the same time, each in a vkreplay process of its own that "
+     "fast-forwards to its first frame. Screenshots and GPU timestamps of the segments are gathered as if the trace had been "
+     "replayed in one go. Needs a trace file with a frame table. 0 replays the trace in this process."},
+    {"pace",
+     "Pacing",
+     VKTRACE_SETTING_STRING,
+     {&replaySettings.pacing},
+     {&replaySettings.pacing},
+     TRUE,
+     "Replay at the pace the trace was captured at instead of as fast as possible. \"calls\" holds each call back until as "
+     "long after the first as it was made in the traced run, \"frames\" only each vkQueuePresentKHR. Frames that fell behind "
+     "are logged with full verbosity and summed up at the end."},
+    {"rc",
+     "ReplayCores",
+     VKTRACE_SETTING_STRING,
+     {&replaySettings.replayCores},
+     {&replaySettings.replayCores},
+     TRUE,
+     "Cores the replay thread runs on, as comma separated cores and ranges of cores like \"0,2-3\"."},
+    {"ioc",
+     "IoCores",
+     VKTRACE_SETTING_STRING,
+     {&replaySettings.ioCores},
+     {&replaySettings.ioCores},
+     TRUE,
+     "Cores the threads that read the trace ahead of replay run on, for PrefetchFrames and streamed traces."},
+    {"wc",
+     "WorkerCores",
+     VKTRACE_SETTING_STRING,
+     {&replaySettings.workerCores},
+     {&replaySettings.workerCores},
+     TRUE,
+     "Cores the threads of MultithreadedReplay and PipelineThreads run on."},
+    {"rp",
+     "RaisePriority",
+     VKTRACE_SETTING_BOOL,
+     {&replaySettings.raisePriority},
+     {&replaySettings.raisePriority},
+     TRUE,
+     "Raise the priority of the threads of vkreplay. On Linux this needs CAP_SYS_NICE or a high enough RLIMIT_NICE."},
+    {"lm",
+     "LockMemory",
+     VKTRACE_SETTING_BOOL,
+     {&replaySettings.lockMemory},
+     {&replaySettings.lockMemory},
+     TRUE,
+     "Lock the mapped trace file in memory, so replay doesn't wait on it being read in. RLIMIT_MEMLOCK has to allow it."},
+    {"cg",
+     "CompareGolden",
+     VKTRACE_SETTING_STRING,
+     {&replaySettings.compareGolden},
+     {&replaySettings.compareGolden},
+     TRUE,
+     "Directory of golden screenshots to compare the screenshots Screenshot takes with while replaying. vkreplay fails if a "
+     "frame doesn't match."},
+    {"ctl",
+     "CompareTolerance",
+     VKTRACE_SETTING_UINT,
+     {&replaySettings.compareTolerance},
+     {&replaySettings.compareTolerance},
+     TRUE,
+     "How much each channel of a pixel may differ from the golden screenshot for the pixel to match, up to 255. Default is 0."},
+    {"cdp",
+     "CompareDiffPpm",
+     VKTRACE_SETTING_UINT,
+     {&replaySettings.compareDiffPpm},
+     {&replaySettings.compareDiffPpm},
+     TRUE,
+     "How many pixels per million may not match for a frame to match. Default is 0."},
+    {"chd",
+     "CompareHashDistance",
+     VKTRACE_SETTING_UINT,
+     {&replaySettings.compareHashDistance},
+     {&replaySettings.compareHashDistance},
+     TRUE,
+     "Frames whose 64 bit perceptual hashes differ in more bits than this don't match without comparing their pixels, 64 "
+     "always compares them. Default is 10."},
+    {"cr",
+     "CompareReport",
+     VKTRACE_SETTING_STRING,
+     {&replaySettings.compareReport},
+     {&replaySettings.compareReport},
+     TRUE,
+     "CSV file to write the result of comparing each screenshot to."},
+    {"vo",
+     "ValidateOnly",
+     VKTRACE_SETTING_STRING,
+     {&replaySettings.validateOnly},
+     {&replaySettings.validateOnly},
+     TRUE,
+     "Replay only to check the calls with VK_LAYER_LUNARG_standard_validation, on the driver of the ICD manifest <string>, "
+     "such as a mock ICD or a CPU implementation, so no GPU is needed. Implies Headless, and the contents of mapped memory "
+     "aren't written. vkreplay fails if any call fails validation."},
+    {"sr",
+     "SkipRerecording",
+     VKTRACE_SETTING_BOOL,
+     {&replaySettings.skipRerecording},
+     {&replaySettings.skipRerecording},
+     TRUE,
+     "Don't record a command buffer again when the trace records the same commands into it as last time, "
+     "the command buffer still holds them. Command buffer and command pool resets are skipped."},
+    {"ru",
+     "ReleaseUnused",
+     VKTRACE_SETTING_BOOL,
+     {&replaySettings.releaseUnused},
+     {&replaySettings.releaseUnused},
+     TRUE,
+     "Find the last call that uses each buffer, image and memory allocation before replay, and forget them after it, "
+     "for traces that never destroy what they create. The pages of a mapped trace file are given back once replayed. "
+     "Ignored with NumLoops and for streamed traces."},
+    {"an",
+     "Annotate",
+     VKTRACE_SETTING_BOOL,
+     {&replaySettings.annotate},
+     {&replaySettings.annotate},
+     TRUE,
+     "Label the commands replay records with VK_EXT_debug_marker for GPU profilers: a region per recording, named after "
+     "its frame and the global_packet_index of its vkBeginCommandBuffer, and a marker per call with its global_packet_index."},
+    {"bf",
+     "BatchFile",
+     VKTRACE_SETTING_STRING,
+     {&replaySettings.batchFile},
+     {&replaySettings.batchFile},
+     TRUE,
+     "Replay each trace file listed in <string>, one path per line, one after the other in this process. Each trace gets "
+     "its own replayer, and with PipelineCache they all share one pipeline cache kept next to <string>."},
 #if _DEBUG
     {"v",
      "Verbosity",
@@ -117,22 +359,63 @@ vktrace_SettingInfo g_settings_info[] = {
 vktrace_SettingGroup g_replaySettingGroup = {"vkreplay", sizeof(g_settings_info) / sizeof(g_settings_info[0]), &g_settings_info[0]};
 
 namespace vktrace_replay {
-int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_trace_packet_replay_library* replayerArray[],
-              vkreplayer_settings settings) {
+// Replay and free the recording packets the cache held back, ahead of the packet that released them
+static void replay_released_packets(RecordingCache* pRecordingCache, vktrace_trace_packet_replay_library* replayer,
+                                    RecordingThreads* pRecordingThreads) {
+    std::vector<vktrace_trace_packet_header*> released = pRecordingCache->take_released();
+    for (size_t i = 0; i < released.size(); i++) {
+        if (pRecordingThreads == NULL || !pRecordingThreads->queue(released[i], replayer)) {
+            vktrace_trace_packet_header* pInterpreted = replayer->Interpret(released[i]);
+            if (pInterpreted == NULL || replayer->Replay(pInterpreted) != VKTRACE_REPLAY_SUCCESS) {
+                vktrace_LogError("Failed to replay packet_id %d, with global_packet_index %d.", released[i]->packet_id,
+                                 released[i]->global_packet_index);
+            }
+        }
+        vktrace_free(released[i]);
+    }
+}
+
+int main_loop(vktrace_replay::ReplayDisplay display, AbstractSequencer& seq, vktrace_trace_packet_replay_library* replayerArray[],
+              vkreplayer_settings settings, ScreenshotComparer* pComparer) {
     int err = 0;
     vktrace_trace_packet_header* packet;
     unsigned int res;
+    unsigned int validationFailures = 0;
+    // Calls replayed on this thread and the time spent in them, for comparing layers and drivers
+    uint64_t replayedCalls = 0;
+    uint64_t replayTime = 0;
+    // Each call, and each frame from the end of the last one, is a zone on the timeline when it is recording
+    bool timeline = vk_timeline_enabled();
+    uint64_t frameStart = timeline ? vk_timeline_now() : 0;
+    vk_timeline_thread_name("vkreplay");
     vktrace_trace_packet_replay_library* replayer = NULL;
     vktrace_trace_packet_message* msgPacket;
     struct seqBookmark startingPacket;
 
     bool trace_running = true;
     int prevFrameNumber = -1;
+    RecordingThreads* pRecordingThreads = settings.multithreadedReplay ? new RecordingThreads() : NULL;
+    RecordingCache* pRecordingCache = settings.skipRerecording ? new RecordingCache() : NULL;
+    Pacer* pPacer = NULL;
+    if (settings.pacing != NULL) {
+        pPacer = new Pacer(strcmp(settings.pacing, "frames") == 0 ? Pacer::PACE_FRAMES : Pacer::PACE_CALLS);
+    }
+    // Later loops patch the pointers in each packet instead of interpreting it again
+    PacketRelocations* pRelocations = settings.numLoops > 1 ? new PacketRelocations() : NULL;
 
     // record the location of looping start packet
     seq.record_bookmark();
     seq.get_bookmark(startingPacket);
+
+    // With a frame table the start of the loop range is known up front, otherwise it gets recorded once replay reaches it
+    bool loopStartKnown = false;
+    if (settings.loopStartFrame > 0 && (size_t)settings.loopStartFrame < frameTable.size()) {
+        startingPacket.file_offset = frameTable[settings.loopStartFrame].packet_offset;
+        loopStartKnown = true;
+    }
     unsigned int totalLoops = settings.numLoops;
+    // Looping from the first frame recreates everything anyway
+    bool restoreLoopState = settings.loopRestoreState && settings.numLoops > 1 && settings.loopStartFrame > 0;
     while (settings.numLoops > 0) {
         while (trace_running) {
             display.process_event();
@@ -176,8 +459,41 @@ int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_tra
                         continue;
                     }
                     if (packet->packet_id >= VKTRACE_TPI_VK_vkApiVersion) {
-                        // replay the API packet
-                        res = replayer->Replay(replayer->Interpret(packet));
+                        // The frames fast-forwarded through aren't paced
+                        if (pPacer != NULL && replayer->GetFrameNumber() >= (int)settings.fastForwardFrame) {
+                            pPacer->wait(packet, replayer->GetFrameNumber());
+                        }
+                        if (pRecordingCache != NULL) {
+                            bool held = pRecordingCache->filter(packet);
+                            replay_released_packets(pRecordingCache, replayer, pRecordingThreads);
+                            if (held) {
+                                // the command buffer may still hold this recording
+                                break;
+                            }
+                        }
+                        if (pRecordingThreads != NULL && pRecordingThreads->queue(packet, replayer)) {
+                            // recording calls are replayed on the worker for the traced thread
+                            break;
+                        }
+
+                        // replay the API packet, interpreting it first unless the sequencer already did
+                        vktrace_trace_packet_header* pInterpreted;
+                        if (!seq.get_interpreted_packet(&pInterpreted)) {
+                            pInterpreted =
+                                pRelocations != NULL ? pRelocations->interpret(replayer, packet) : replayer->Interpret(packet);
+                        }
+                        uint64_t replayStart = vktrace_get_time();
+                        uint64_t zoneStart = timeline ? vk_timeline_now() : 0;
+                        res = replayer->Replay(pInterpreted);
+                        replayTime += vktrace_get_time() - replayStart;
+                        replayedCalls++;
+                        if (timeline) {
+                            vk_timeline_zone("vkreplay", vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)packet->packet_id),
+                                             zoneStart, vk_timeline_now());
+                        }
+                        if (res == VKTRACE_REPLAY_VALIDATION_ERROR) {
+                            validationFailures++;
+                        }
                         if (res != VKTRACE_REPLAY_SUCCESS) {
                             vktrace_LogError("Failed to replay packet_id %d, with global_packet_index %d.", packet->packet_id,
                                              packet->global_packet_index);
@@ -192,13 +508,31 @@ int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_tra
                         int frameNumber = replayer->GetFrameNumber();
                         if (prevFrameNumber != frameNumber) {
                             prevFrameNumber = frameNumber;
+                            if (timeline) {
+                                char frameName[32];
+                                snprintf(frameName, sizeof(frameName), "Frame %d", frameNumber - 1);
+                                uint64_t frameEnd = vk_timeline_now();
+                                vk_timeline_zone("vkreplay", frameName, frameStart, frameEnd);
+                                frameStart = frameEnd;
+                            }
+                            if (pComparer != NULL) {
+                                pComparer->frames_presented(frameNumber);
+                            }
 
                             // Only set the loop start location in the first loop when loopStartFrame is not 0
                             if (frameNumber == settings.loopStartFrame && settings.loopStartFrame > 0 &&
                                 settings.numLoops == totalLoops) {
-                                // record the location of looping start packet
-                                seq.record_bookmark();
-                                seq.get_bookmark(startingPacket);
+                                if (!loopStartKnown) {
+                                    // record the location of looping start packet
+                                    seq.record_bookmark();
+                                    seq.get_bookmark(startingPacket);
+                                }
+                                if (restoreLoopState) {
+                                    if (pRecordingThreads != NULL) {
+                                        pRecordingThreads->sync();
+                                    }
+                                    replayer->SaveLoopState();
+                                }
                             }
 
                             if (frameNumber == settings.loopEndFrame) {
@@ -214,24 +548,64 @@ int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_tra
                 }
             }
         }
+        if (pRecordingCache != NULL && replayer != NULL) {
+            // the next loop starts over with the recordings, so nothing stays held back
+            pRecordingCache->reset();
+            replay_released_packets(pRecordingCache, replayer, pRecordingThreads);
+        }
+        if (pRecordingThreads != NULL) {
+            pRecordingThreads->sync();
+        }
         settings.numLoops--;
         if (settings.numLoops)
             vktrace_LogAlways("Loop number %d completed. Remaining loops:%d", settings.numLoops + 1, settings.numLoops);
 
         // if screenshot is enabled run it for one cycle only
         // as all consecutive cycles must generate same screen
+        if (pComparer != NULL && replayer != NULL) {
+            pComparer->frames_presented(replayer->GetFrameNumber());
+        }
         if (replaySettings.screenshotList != NULL) {
             vktrace_free((char*)replaySettings.screenshotList);
             replaySettings.screenshotList = NULL;
         }
-        seq.set_bookmark(startingPacket);
+        if (settings.numLoops > 0) {
+            seq.set_bookmark(startingPacket);
+        }
+        if (pPacer != NULL) {
+            pPacer->restart();
+        }
         trace_running = true;
         if (replayer != NULL) {
             replayer->ResetFrameNumber(settings.loopStartFrame);
+            if (restoreLoopState && settings.numLoops > 0) {
+                replayer->RestoreLoopState();
+            }
         }
     }
 
 out:
+    if (pPacer != NULL) {
+        pPacer->report();
+        delete pPacer;
+    }
+    if (replayedCalls > 0) {
+        vktrace_LogVerbose("Replayed %" PRIu64 " calls in %.3f ms, %.1f ns per call.", replayedCalls, replayTime / 1000000.0,
+                           (double)replayTime / replayedCalls);
+    }
+    vk_timeline_flush();
+    if (pRecordingCache != NULL) {
+        pRecordingCache->report();
+        delete pRecordingCache;
+    }
+    if (settings.validateOnly != NULL) {
+        vktrace_LogAlways("%u calls failed validation.", validationFailures);
+        if (validationFailures > 0 && err == 0) {
+            err = -1;
+        }
+    }
+    delete pRecordingThreads;
+    delete pRelocations;
     seq.clean_up();
     if (replaySettings.screenshotList != NULL) {
         vktrace_free((char*)replaySettings.screenshotList);
@@ -294,10 +668,9 @@ void loggingCallback(VktraceLogLevel level, const char* pMessage) {
 
 static bool readPortabilityTable() {
     size_t tableSize;
-    int originalFilePos;
+    size_t originalFilePos;
 
     originalFilePos = vktrace_FileLike_GetCurrentPosition(traceFile);
-    if (-1 == originalFilePos) return false;
     if (!vktrace_FileLike_SetCurrentPosition(traceFile, traceFile->mFileLen - sizeof(size_t))) return false;
     if (!vktrace_FileLike_ReadRaw(traceFile, &tableSize, sizeof(size_t))) return false;
     if (tableSize == 0) return true;
@@ -312,75 +685,15 @@ static bool readPortabilityTable() {
     return true;
 }
 
-int vkreplay_main(int argc, char** argv, vktrace_window_handle window = 0) {
+// Replays the trace at replaySettings.pTraceFilePath, which is freed, and merges the settings of its replayers into
+// *ppAllSettings
+static int replay_trace(int argc, char** argv, vktrace_window_handle window, vktrace_SettingGroup** ppAllSettings,
+                        unsigned int* pNumAllSettings) {
     int err = 0;
-    vktrace_SettingGroup* pAllSettings = NULL;
-    unsigned int numAllSettings = 0;
 
-    // Default verbosity level
-    vktrace_LogSetCallback(loggingCallback);
-    vktrace_LogSetLevel(VKTRACE_LOG_ERROR);
-
-    // apply settings from cmd-line args
-    if (vktrace_SettingGroup_init_from_cmdline(&g_replaySettingGroup, argc, argv, &replaySettings.pTraceFilePath) != 0) {
-        // invalid options specified
-        if (pAllSettings != NULL) {
-            vktrace_SettingGroup_Delete_Loaded(&pAllSettings, &numAllSettings);
-        }
-        return -1;
-    }
-
-    // merge settings so that new settings will get written into the settings file
-    vktrace_SettingGroup_merge(&g_replaySettingGroup, &pAllSettings, &numAllSettings);
-
-    // Set verbosity level
-    if (replaySettings.verbosity == NULL || !strcmp(replaySettings.verbosity, "errors"))
-        replaySettings.verbosity = "errors";
-    else if (!strcmp(replaySettings.verbosity, "quiet"))
-        vktrace_LogSetLevel(VKTRACE_LOG_NONE);
-    else if (!strcmp(replaySettings.verbosity, "warnings"))
-        vktrace_LogSetLevel(VKTRACE_LOG_WARNING);
-    else if (!strcmp(replaySettings.verbosity, "full"))
-        vktrace_LogSetLevel(VKTRACE_LOG_VERBOSE);
-#if _DEBUG
-    else if (!strcmp(replaySettings.verbosity, "debug"))
-        vktrace_LogSetLevel(VKTRACE_LOG_DEBUG);
-#endif
-    else {
-        vktrace_SettingGroup_print(&g_replaySettingGroup);
-        // invalid options specified
-        if (pAllSettings != NULL) {
-            vktrace_SettingGroup_Delete_Loaded(&pAllSettings, &numAllSettings);
-        }
-        return -1;
-    }
-
-    // Set up environment for screenshot
-    if (replaySettings.screenshotList != NULL) {
-        if (!screenshot::checkParsingFrameRange(replaySettings.screenshotList)) {
-            vktrace_LogError("Screenshot range error");
-            vktrace_SettingGroup_print(&g_replaySettingGroup);
-            if (pAllSettings != NULL) {
-                vktrace_SettingGroup_Delete_Loaded(&pAllSettings, &numAllSettings);
-            }
-            return -1;
-        } else {
-            // Set env var that communicates list to ScreenShot layer
-            vktrace_set_global_var("VK_SCREENSHOT_FRAMES", replaySettings.screenshotList);
-        }
-    } else {
-        vktrace_set_global_var("VK_SCREENSHOT_FRAMES", "");
-    }
-
-    // Set up environment for screenshot color space format
-    if (replaySettings.screenshotColorFormat != NULL && replaySettings.screenshotList != NULL) {
-        vktrace_set_global_var("VK_SCREENSHOT_FORMAT", replaySettings.screenshotColorFormat);
-    }else if (replaySettings.screenshotColorFormat != NULL && replaySettings.screenshotList == NULL) {
-        vktrace_LogWarning("Screenshot format should be used when screenshot enabled!");
-        vktrace_set_global_var("VK_SCREENSHOT_FORMAT", "");
-    } else {
-        vktrace_set_global_var("VK_SCREENSHOT_FORMAT", "");
-    }
+    // Nothing is left from the trace replayed before
+    frameTable.clear();
+    portabilityTable.clear();
 
     // open the trace file
     char* pTraceFile = replaySettings.pTraceFilePath;
@@ -388,34 +701,32 @@ int vkreplay_main(int argc, char** argv, vktrace_window_handle window = 0) {
     vktrace_trace_file_header* pFileHeader;  // File header, including gpuinfo structs
 
     FILE* tracefp;
+    // A streamed trace can only be read front to back
+    bool streamed = pTraceFile != NULL && strcmp(pTraceFile, "-") == 0;
 
-    if (pTraceFile != NULL && strlen(pTraceFile) > 0) {
+    if (streamed) {
+#if defined(WIN32)
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        tracefp = stdin;
+    } else if (pTraceFile != NULL && strlen(pTraceFile) > 0) {
         tracefp = fopen(pTraceFile, "rb");
         if (tracefp == NULL) {
             vktrace_LogError("Cannot open trace file: '%s'.", pTraceFile);
             // invalid options specified
-            if (pAllSettings != NULL) {
-                vktrace_SettingGroup_Delete_Loaded(&pAllSettings, &numAllSettings);
-            }
             vktrace_free(pTraceFile);
             return -1;
         }
     } else {
         vktrace_LogError("No trace file specified.");
         vktrace_SettingGroup_print(&g_replaySettingGroup);
-        if (pAllSettings != NULL) {
-            vktrace_SettingGroup_Delete_Loaded(&pAllSettings, &numAllSettings);
-        }
         return -1;
     }
 
     // read the header
-    traceFile = vktrace_FileLike_create_file(tracefp);
+    traceFile = streamed ? vktrace_FileLike_create_stream(tracefp) : vktrace_FileLike_create_file(tracefp);
     if (vktrace_FileLike_ReadRaw(traceFile, &fileHeader, sizeof(fileHeader)) == false) {
         vktrace_LogError("Unable to read header from file.");
-        if (pAllSettings != NULL) {
-            vktrace_SettingGroup_Delete_Loaded(&pAllSettings, &numAllSettings);
-        }
         fclose(tracefp);
         vktrace_free(pTraceFile);
         vktrace_free(traceFile);
@@ -424,6 +735,7 @@ int vkreplay_main(int argc, char** argv, vktrace_window_handle window = 0) {
 
     // set global version num
     vktrace_set_trace_version(fileHeader.trace_file_version);
+    vktrace_blob_store_initialize();
 
     // Make sure trace file version is supported
     if (fileHeader.trace_file_version < VKTRACE_TRACE_FILE_VERSION_MINIMUM_COMPATIBLE) {
@@ -446,16 +758,30 @@ int vkreplay_main(int argc, char** argv, vktrace_window_handle window = 0) {
         return -1;
     }
 
+    if (streamed && fileHeader.compression_type != VKTRACE_COMPRESSION_NONE) {
+        vktrace_LogError("Compressed trace files can't be streamed.");
+        fclose(tracefp);
+        vktrace_free(pTraceFile);
+        vktrace_free(traceFile);
+        return -1;
+    }
+
+    // From here on all reads and offsets are in the uncompressed stream
+    if (!vktrace_FileLike_EnableDecompression(traceFile, &fileHeader)) {
+        vktrace_LogError("Unable to read compressed trace file %s.", pTraceFile);
+        fclose(tracefp);
+        vktrace_free(pTraceFile);
+        vktrace_free(traceFile);
+        return -1;
+    }
+
     // Allocate a new header that includes space for all gpuinfo structs
     if (!(pFileHeader = (vktrace_trace_file_header*)vktrace_malloc(sizeof(vktrace_trace_file_header) +
                                                                    fileHeader.n_gpuinfo * sizeof(struct_gpuinfo)))) {
         vktrace_LogError("Can't allocate space for trace file header.");
-        if (pAllSettings != NULL) {
-            vktrace_SettingGroup_Delete_Loaded(&pAllSettings, &numAllSettings);
-        }
         fclose(tracefp);
         vktrace_free(pTraceFile);
-        vktrace_free(traceFile);
+        vktrace_FileLike_destroy(&traceFile);
         return -1;
     }
 
@@ -463,20 +789,73 @@ int vkreplay_main(int argc, char** argv, vktrace_window_handle window = 0) {
     *pFileHeader = fileHeader;
     if (vktrace_FileLike_ReadRaw(traceFile, pFileHeader + 1, pFileHeader->n_gpuinfo * sizeof(struct_gpuinfo)) == false) {
         vktrace_LogError("Unable to read header from file.");
-        if (pAllSettings != NULL) {
-            vktrace_SettingGroup_Delete_Loaded(&pAllSettings, &numAllSettings);
-        }
         fclose(tracefp);
         vktrace_free(pTraceFile);
-        vktrace_free(traceFile);
+        vktrace_FileLike_destroy(&traceFile);
         return -1;
     }
 
-    // read portability table if it exists
-    if (pFileHeader->portability_table_valid) pFileHeader->portability_table_valid = readPortabilityTable();
+    // read portability table if it exists, the tables at the end of a streamed trace haven't arrived yet
+    if (pFileHeader->portability_table_valid) pFileHeader->portability_table_valid = !streamed && readPortabilityTable();
     if (!pFileHeader->portability_table_valid)
         vktrace_LogAlways("Trace file does not appear to contain portability table. Will not attempt to map memoryType indices.");
 
+    // read frame table if it exists
+    uint64_t frameCount = 0;
+    vktrace_frame_table_entry* pFrameTable = NULL;
+    if (!streamed && vktrace_read_frame_table(traceFile, pFileHeader, &frameCount, &pFrameTable)) {
+        frameTable.assign(pFrameTable, pFrameTable + frameCount);
+        vktrace_free(pFrameTable);
+        vktrace_LogVerbose("Trace file contains %" PRIu64 " frames.", frameCount);
+        if (replaySettings.loopStartFrame > 0 && (uint64_t)replaySettings.loopStartFrame >= frameCount) {
+            vktrace_LogWarning("LoopStartFrame %d is past the last frame of the trace (%" PRIu64 ").", replaySettings.loopStartFrame,
+                               frameCount - 1);
+        }
+        if (replaySettings.loopEndFrame > 0 && (uint64_t)replaySettings.loopEndFrame >= frameCount) {
+            vktrace_LogWarning("LoopEndFrame %d is past the last frame of the trace (%" PRIu64 ").", replaySettings.loopEndFrame,
+                               frameCount - 1);
+        }
+    }
+
+    if (replaySettings.captureProfileFrames > 0) {
+        Sequencer profileSequencer(traceFile);
+        err = vktrace_replay::print_capture_profile(profileSequencer, replaySettings.captureProfileFrames);
+        fclose(tracefp);
+        vktrace_free(pTraceFile);
+        vktrace_FileLike_destroy(&traceFile);
+        return err;
+    }
+
+    if (replaySettings.segments > 1) {
+#if defined(ANDROID)
+        vktrace_LogWarning("Segments is ignored on Android.");
+#else
+        if (frameTable.empty()) {
+            vktrace_LogError("Segments needs a trace file with a frame table.");
+            err = -1;
+        } else {
+            err = vktrace_replay::replay_segments(argc, argv, replaySettings, frameTable.size());
+        }
+        fclose(tracefp);
+        vktrace_free(pTraceFile);
+        vktrace_FileLike_destroy(&traceFile);
+        return err;
+#endif
+    }
+
+    if (streamed && replaySettings.numLoops > 1) {
+        vktrace_LogWarning("NumLoops is ignored for a streamed trace, it can't be replayed again.");
+        replaySettings.numLoops = 1;
+    }
+    if (replaySettings.releaseUnused && (streamed || replaySettings.numLoops > 1)) {
+        // Every loop uses the objects again, and a stream can't be read ahead to the end
+        vktrace_LogWarning("ReleaseUnused is ignored with NumLoops and for a streamed trace.");
+        replaySettings.releaseUnused = FALSE;
+    }
+    if (replaySettings.releaseUnused && replaySettings.skipRerecording) {
+        vktrace_LogWarning("With SkipRerecording, ReleaseUnused only gives back the pages of the trace file.");
+    }
+
     // load any API specific driver libraries and init replayer objects
     uint8_t tidApi = VKTRACE_TID_RESERVED;
     vktrace_trace_packet_replay_library* replayer[VKTRACE_MAX_TRACER_ID_ARRAY_SIZE];
@@ -501,6 +880,12 @@ int vkreplay_main(int argc, char** argv, vktrace_window_handle window = 0) {
         replayer[i] = NULL;
     }
 
+    if (replaySettings.pipelineThreads > 0 && replaySettings.multithreadedReplay) {
+        // Pipelines compiled in the background only get mapped on the replay thread, recording threads look them up
+        vktrace_LogWarning("PipelineThreads is ignored with MultithreadedReplay.");
+        replaySettings.pipelineThreads = 0;
+    }
+
     for (uint64_t i = 0; i < pFileHeader->tracer_count; i++) {
         uint8_t tracerId = pFileHeader->tracer_id_array[i].id;
         tidApi = tracerId;
@@ -516,32 +901,26 @@ int vkreplay_main(int argc, char** argv, vktrace_window_handle window = 0) {
 
             if (replayer[tracerId] == NULL) {
                 // replayer failed to be created
-                if (pAllSettings != NULL) {
-                    vktrace_SettingGroup_Delete_Loaded(&pAllSettings, &numAllSettings);
-                }
                 fclose(tracefp);
                 vktrace_free(pTraceFile);
-                vktrace_free(traceFile);
+                vktrace_FileLike_destroy(&traceFile);
                 return -1;
             }
 
             // merge the replayer's settings into the list of all settings so that we can output a comprehensive settings file later
             // on.
-            vktrace_SettingGroup_merge(replayer[tracerId]->GetSettings(), &pAllSettings, &numAllSettings);
+            vktrace_SettingGroup_merge(replayer[tracerId]->GetSettings(), ppAllSettings, pNumAllSettings);
 
             // update the replayer with the loaded settings
-            replayer[tracerId]->UpdateFromSettings(pAllSettings, numAllSettings);
+            replayer[tracerId]->UpdateFromSettings(*ppAllSettings, *pNumAllSettings);
 
             // Initialize the replayer
             err = replayer[tracerId]->Initialize(&disp, &replaySettings, pFileHeader);
             if (err) {
                 vktrace_LogError("Couldn't Initialize replayer for TracerId %d.", tracerId);
-                if (pAllSettings != NULL) {
-                    vktrace_SettingGroup_Delete_Loaded(&pAllSettings, &numAllSettings);
-                }
                 fclose(tracefp);
                 vktrace_free(pTraceFile);
-                vktrace_free(traceFile);
+                vktrace_FileLike_destroy(&traceFile);
                 return err;
             }
         }
@@ -549,18 +928,50 @@ int vkreplay_main(int argc, char** argv, vktrace_window_handle window = 0) {
 
     if (tidApi == VKTRACE_TID_RESERVED) {
         vktrace_LogError("No API specified in tracefile for replaying.");
-        if (pAllSettings != NULL) {
-            vktrace_SettingGroup_Delete_Loaded(&pAllSettings, &numAllSettings);
-        }
         fclose(tracefp);
         vktrace_free(pTraceFile);
-        vktrace_free(traceFile);
+        vktrace_FileLike_destroy(&traceFile);
         return -1;
     }
 
     // main loop
-    Sequencer sequencer(traceFile);
-    err = vktrace_replay::main_loop(disp, sequencer, replayer, replaySettings);
+    // Replay straight out of a mapping of the trace file when possible, otherwise read each packet in
+    Sequencer fileSequencer(traceFile);
+    MappedSequencer mappedSequencer;
+    std::unique_ptr<StreamSequencer> pStreamSequencer;
+    AbstractSequencer* pSequencer = &fileSequencer;
+    if (streamed) {
+        pStreamSequencer.reset(new StreamSequencer(tracefp, pFileHeader->first_packet_offset));
+        pSequencer = pStreamSequencer.get();
+    } else if (pFileHeader->compression_type == VKTRACE_COMPRESSION_NONE &&
+               mappedSequencer.open(tracefp, pFileHeader->first_packet_offset)) {
+        mappedSequencer.set_release_replayed(replaySettings.releaseUnused == TRUE);
+        pSequencer = &mappedSequencer;
+    } else {
+        vktrace_LogVerbose("Not mapping the trace file, packets will be read from it as they are replayed.");
+    }
+    if (replaySettings.prefetchFrames > 0 && replaySettings.multithreadedReplay) {
+        // Recording threads copy packets before they are interpreted, prefetched packets already are
+        vktrace_LogWarning("PrefetchFrames is ignored with MultithreadedReplay.");
+        replaySettings.prefetchFrames = 0;
+    }
+    if (replaySettings.prefetchFrames > 0 && replaySettings.skipRerecording) {
+        // Held back recording packets are copied before they are interpreted, like on recording threads
+        vktrace_LogWarning("PrefetchFrames is ignored with SkipRerecording.");
+        replaySettings.prefetchFrames = 0;
+    }
+    std::unique_ptr<ScreenshotComparer> pComparer;
+    if (replaySettings.compareGolden != NULL) {
+        pComparer.reset(new ScreenshotComparer(replaySettings.compareGolden, replaySettings.screenshotList,
+                                               replaySettings.compareTolerance, replaySettings.compareDiffPpm,
+                                               replaySettings.compareHashDistance, replaySettings.compareReport));
+    }
+    if (replaySettings.prefetchFrames > 0) {
+        PrefetchSequencer prefetchSequencer(pSequencer, replayer, replaySettings.prefetchFrames);
+        err = vktrace_replay::main_loop(disp, prefetchSequencer, replayer, replaySettings, pComparer.get());
+    } else {
+        err = vktrace_replay::main_loop(disp, *pSequencer, replayer, replaySettings, pComparer.get());
+    }
 
     for (int i = 0; i < VKTRACE_MAX_TRACER_ID_ARRAY_SIZE; i++) {
         if (replayer[i] != NULL) {
@@ -569,14 +980,195 @@ int vkreplay_main(int argc, char** argv, vktrace_window_handle window = 0) {
         }
     }
 
-    if (pAllSettings != NULL) {
-        vktrace_SettingGroup_Delete_Loaded(&pAllSettings, &numAllSettings);
+    // The screenshot layer has written every screenshot once the device is gone
+    if (pComparer != NULL && !pComparer->finish() && err == 0) {
+        err = -1;
     }
 
+
     fclose(tracefp);
     vktrace_free(pTraceFile);
-    vktrace_free(traceFile);
+    vktrace_FileLike_destroy(&traceFile);
+    vktrace_blob_store_deinitialize();
+
+    return err;
+}
+
+// Replays the traces listed in replaySettings.batchFile one after the other. Each gets its own replayer, so nothing the
+// replay of one trace maps or tracks is seen by the next.
+static int replay_batch(int argc, char** argv, vktrace_window_handle window, vktrace_SettingGroup** ppAllSettings,
+                        unsigned int* pNumAllSettings) {
+    if (replaySettings.pTraceFilePath != NULL) {
+        vktrace_LogError("Give either a trace file or BatchFile.");
+        vktrace_SettingGroup_print(&g_replaySettingGroup);
+        return -1;
+    }
+    if (replaySettings.segments > 1) {
+        vktrace_LogWarning("Segments is ignored with BatchFile.");
+        replaySettings.segments = 0;
+    }
+
+    FILE* pBatchFile = fopen(replaySettings.batchFile, "r");
+    if (pBatchFile == NULL) {
+        vktrace_LogError("Cannot open batch file: '%s'.", replaySettings.batchFile);
+        return -1;
+    }
+    // Blank lines and lines starting with '#' aren't traces
+    std::vector<std::string> traces;
+    char line[4096];
+    while (fgets(line, sizeof(line), pBatchFile) != NULL) {
+        size_t length = strlen(line);
+        while (length > 0 && isspace((unsigned char)line[length - 1])) {
+            line[--length] = '\0';
+        }
+        if (length > 0 && line[0] != '#') {
+            traces.push_back(line);
+        }
+    }
+    fclose(pBatchFile);
+    if (traces.empty()) {
+        vktrace_LogError("Batch file '%s' doesn't list any trace files.", replaySettings.batchFile);
+        return -1;
+    }
+
+    int err = 0;
+    size_t failed = 0;
+    uint64_t startTime = vktrace_get_time();
+    for (size_t i = 0; i < traces.size(); i++) {
+        if (traces[i] == "-") {
+            vktrace_LogError("A batch can't replay the standard input.");
+            err = -1;
+            failed++;
+            continue;
+        }
+        vktrace_LogAlways("Replaying '%s', trace %zu of %zu.", traces[i].c_str(), i + 1, traces.size());
+        replaySettings.pTraceFilePath = vktrace_allocate_and_copy(traces[i].c_str());
+        int traceErr = replay_trace(argc, argv, window, ppAllSettings, pNumAllSettings);
+        replaySettings.pTraceFilePath = NULL;
+        if (traceErr != 0) {
+            vktrace_LogError("Replay of '%s' failed.", traces[i].c_str());
+            err = traceErr;
+            failed++;
+        }
+    }
+    vktrace_LogAlways("Replayed %zu traces in %.3f s, %zu failed.", traces.size(), (vktrace_get_time() - startTime) / 1000000000.0,
+                      failed);
+    return err;
+}
+
+int vkreplay_main(int argc, char** argv, vktrace_window_handle window = 0) {
+    int err = 0;
+    vktrace_SettingGroup* pAllSettings = NULL;
+    unsigned int numAllSettings = 0;
+
+    // Default verbosity level
+    vktrace_LogSetCallback(loggingCallback);
+    vktrace_LogSetLevel(VKTRACE_LOG_ERROR);
+
+    // apply settings from cmd-line args
+    if (vktrace_SettingGroup_init_from_cmdline(&g_replaySettingGroup, argc, argv, &replaySettings.pTraceFilePath) != 0) {
+        // invalid options specified
+        if (pAllSettings != NULL) {
+            vktrace_SettingGroup_Delete_Loaded(&pAllSettings, &numAllSettings);
+        }
+        return -1;
+    }
+
+    // merge settings so that new settings will get written into the settings file
+    vktrace_SettingGroup_merge(&g_replaySettingGroup, &pAllSettings, &numAllSettings);
+
+    // Set verbosity level
+    if (replaySettings.verbosity == NULL || !strcmp(replaySettings.verbosity, "errors"))
+        replaySettings.verbosity = "errors";
+    else if (!strcmp(replaySettings.verbosity, "quiet"))
+        vktrace_LogSetLevel(VKTRACE_LOG_NONE);
+    else if (!strcmp(replaySettings.verbosity, "warnings"))
+        vktrace_LogSetLevel(VKTRACE_LOG_WARNING);
+    else if (!strcmp(replaySettings.verbosity, "full"))
+        vktrace_LogSetLevel(VKTRACE_LOG_VERBOSE);
+#if _DEBUG
+    else if (!strcmp(replaySettings.verbosity, "debug"))
+        vktrace_LogSetLevel(VKTRACE_LOG_DEBUG);
+#endif
+    else {
+        vktrace_SettingGroup_print(&g_replaySettingGroup);
+        // invalid options specified
+        if (pAllSettings != NULL) {
+            vktrace_SettingGroup_Delete_Loaded(&pAllSettings, &numAllSettings);
+        }
+        return -1;
+    }
+
+    if (replaySettings.pacing != NULL && strcmp(replaySettings.pacing, "calls") != 0 && strcmp(replaySettings.pacing, "frames") != 0) {
+        vktrace_LogError("Pacing must be \"calls\" or \"frames\".");
+        vktrace_SettingGroup_print(&g_replaySettingGroup);
+        if (pAllSettings != NULL) {
+            vktrace_SettingGroup_Delete_Loaded(&pAllSettings, &numAllSettings);
+        }
+        return -1;
+    }
+
+    if (replaySettings.validateOnly != NULL) {
+        // The loader only sees the driver of the manifest, and nothing is shown
+        vktrace_set_global_var("VK_ICD_FILENAMES", replaySettings.validateOnly);
+        replaySettings.headless = TRUE;
+    }
+
+    if (!init_thread_placement(replaySettings.replayCores, replaySettings.ioCores, replaySettings.workerCores,
+                               replaySettings.raisePriority == TRUE, replaySettings.lockMemory == TRUE)) {
+        vktrace_SettingGroup_print(&g_replaySettingGroup);
+        if (pAllSettings != NULL) {
+            vktrace_SettingGroup_Delete_Loaded(&pAllSettings, &numAllSettings);
+        }
+        return -1;
+    }
+    place_current_thread(THREAD_ROLE_REPLAY);
+
+    // Set up environment for screenshot
+    if (replaySettings.screenshotList != NULL) {
+        if (!screenshot::checkParsingFrameRange(replaySettings.screenshotList)) {
+            vktrace_LogError("Screenshot range error");
+            vktrace_SettingGroup_print(&g_replaySettingGroup);
+            if (pAllSettings != NULL) {
+                vktrace_SettingGroup_Delete_Loaded(&pAllSettings, &numAllSettings);
+            }
+            return -1;
+        } else {
+            // Set env var that communicates list to ScreenShot layer
+            vktrace_set_global_var("VK_SCREENSHOT_FRAMES", replaySettings.screenshotList);
+        }
+    } else {
+        vktrace_set_global_var("VK_SCREENSHOT_FRAMES", "");
+    }
+
+    if (replaySettings.compareGolden != NULL && replaySettings.screenshotList == NULL) {
+        vktrace_LogError("CompareGolden needs Screenshot to take the screenshots to compare.");
+        vktrace_SettingGroup_print(&g_replaySettingGroup);
+        if (pAllSettings != NULL) {
+            vktrace_SettingGroup_Delete_Loaded(&pAllSettings, &numAllSettings);
+        }
+        return -1;
+    }
 
+    // Set up environment for screenshot color space format
+    if (replaySettings.screenshotColorFormat != NULL && replaySettings.screenshotList != NULL) {
+        vktrace_set_global_var("VK_SCREENSHOT_FORMAT", replaySettings.screenshotColorFormat);
+    }else if (replaySettings.screenshotColorFormat != NULL && replaySettings.screenshotList == NULL) {
+        vktrace_LogWarning("Screenshot format should be used when screenshot enabled!");
+        vktrace_set_global_var("VK_SCREENSHOT_FORMAT", "");
+    } else {
+        vktrace_set_global_var("VK_SCREENSHOT_FORMAT", "");
+    }
+
+    if (replaySettings.batchFile != NULL) {
+        err = replay_batch(argc, argv, window, &pAllSettings, &numAllSettings);
+    } else {
+        err = replay_trace(argc, argv, window, &pAllSettings, &numAllSettings);
+    }
+
+    if (pAllSettings != NULL) {
+        vktrace_SettingGroup_Delete_Loaded(&pAllSettings, &numAllSettings);
+    }
     return err;
 }
 
@@ -30,6 +30,34 @@ typedef struct vkreplayer_settings {
     const char* screenshotList;
     const char* screenshotColorFormat;
     const char* verbosity;
+    unsigned int prefetchFrames;
+    unsigned int captureProfileFrames;
+    BOOL multithreadedReplay;
+    BOOL loopRestoreState;
+    BOOL pipelineCache;
+    unsigned int pipelineThreads;
+    const char* gpuTimestampsFile;
+    BOOL headless;
+    unsigned int suballocationBlockSize;
+    BOOL collapsePolling;
+    unsigned int fastForwardFrame;
+    unsigned int segments;
+    const char* pacing;
+    const char* replayCores;
+    const char* ioCores;
+    const char* workerCores;
+    BOOL raisePriority;
+    BOOL lockMemory;
+    const char* compareGolden;
+    unsigned int compareTolerance;
+    unsigned int compareDiffPpm;
+    unsigned int compareHashDistance;
+    const char* compareReport;
+    const char* validateOnly;
+    BOOL skipRerecording;
+    BOOL releaseUnused;
+    BOOL annotate;
+    const char* batchFile;
 } vkreplayer_settings;
 
 #include <vector>
@@ -28,7 +28,7 @@ class objMemory {
 
 class gpuMemory {
    public:
-    gpuMemory() : m_pendingAlloc(false) { m_allocInfo.allocationSize = 0; }
+    gpuMemory() : m_pendingAlloc(false), m_dedicated(false) { m_allocInfo.allocationSize = 0; }
     ~gpuMemory() {}
     // memory mapping functions for app writes into mapped memory
     bool isPendingAlloc() { return m_pendingAlloc; }
@@ -36,8 +36,22 @@ class gpuMemory {
     void setAllocInfo(const VkMemoryAllocateInfo *info, const bool pending) {
         m_pendingAlloc = pending;
         m_allocInfo = *info;
+        // The chain lives in the packet, so only what is needed of it is kept
+        m_allocInfo.pNext = NULL;
+        m_dedicated = false;
+        for (const VkMemoryAllocateInfo *pNext = (const VkMemoryAllocateInfo *)info->pNext; pNext != NULL;
+             pNext = (const VkMemoryAllocateInfo *)pNext->pNext) {
+            if (pNext->sType == VK_STRUCTURE_TYPE_DEDICATED_ALLOCATION_MEMORY_ALLOCATE_INFO_NV ||
+                pNext->sType == VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO_KHR) {
+                m_dedicated = true;
+            }
+        }
     }
 
+    const VkMemoryAllocateInfo &getAllocInfo() const { return m_allocInfo; }
+    // Whether the allocation is dedicated to one image or buffer, which nothing else may be bound to
+    bool isDedicated() const { return m_dedicated; }
+
     void setMemoryDataAddr(void *pBuf) {
         if (m_mapRange.empty()) {
             return;
@@ -68,13 +82,25 @@ class gpuMemory {
         if (pChangedInfoArray[0].length) {
             PBYTE pChangedData = (PBYTE)(pSrcData) + sizeof(PageGuardChangedBlockInfo) * (pChangedInfoArray[0].offset + 1);
             DWORD CurrentOffset = 0;
+            // The data of the blocks is packed in order, so blocks that are adjacent in memory are copied together
+            size_t runOffset = 0, runLength = 0;
+            PBYTE pRunData = pChangedData;
             for (DWORD i = 0; i < pChangedInfoArray[0].offset; i++) {
-                if ((size_t)pChangedInfoArray[i + 1].length) {
-                    memcpy(mr.pData + (size_t)pChangedInfoArray[i + 1].offset, pChangedData + CurrentOffset,
-                           (size_t)pChangedInfoArray[i + 1].length);
+                size_t offset = (size_t)pChangedInfoArray[i + 1].offset;
+                size_t length = (size_t)pChangedInfoArray[i + 1].length;
+                if (length) {
+                    if (runLength && runOffset + runLength == offset) {
+                        runLength += length;
+                    } else {
+                        if (runLength) vktrace_pageguard_memcpy(mr.pData + runOffset, pRunData, runLength);
+                        runOffset = offset;
+                        runLength = length;
+                        pRunData = pChangedData + CurrentOffset;
+                    }
                 }
                 CurrentOffset += pChangedInfoArray[i + 1].length;
             }
+            if (runLength) vktrace_pageguard_memcpy(mr.pData + runOffset, pRunData, runLength);
         }
     }
 
@@ -111,7 +137,7 @@ class gpuMemory {
             assert(offset >= mr.offset);
             assert(size <= mr.size && (size + offset) <= (size_t)m_allocInfo.allocationSize);
         }
-        memcpy(mr.pData + offset, pSrcData, size);
+        vktrace_pageguard_memcpy(mr.pData + offset, pSrcData, size);
         if (!mr.pending && entire_map) m_mapRange.pop_back();
     }
 
@@ -119,6 +145,7 @@ class gpuMemory {
 
    private:
     bool m_pendingAlloc;
+    bool m_dedicated;
     struct MapRange {
         bool pending;
         size_t size;
@@ -142,6 +169,8 @@ typedef struct _bufferObj {
 typedef struct _devicememoryObj {
     gpuMemory *pGpuMem;
     VkDeviceMemory replayDeviceMemory;
+    VkDeviceSize replayOffset;  // where the allocation starts in replayDeviceMemory
+    bool suballocated;          // replayDeviceMemory is a block other allocations share
 } devicememoryObj;
 
 class vkReplayObjMapper {
@@ -153,7 +182,7 @@ class vkReplayObjMapper {
     void init_objMemCount(const uint64_t handle, const VkDebugReportObjectTypeEXT objectType, const uint32_t &num) {
         switch (objectType) {
             case VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT: {
-                std::map<VkBuffer, bufferObj>::iterator it = m_buffers.find((VkBuffer)handle);
+                std::unordered_map<VkBuffer, bufferObj>::iterator it = m_buffers.find((VkBuffer)handle);
                 if (it != m_buffers.end()) {
                     objMemory obj = it->second.bufferMem;
                     obj.setCount(num);
@@ -162,7 +191,7 @@ class vkReplayObjMapper {
                 break;
             }
             case VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT: {
-                std::map<VkImage, imageObj>::iterator it = m_images.find((VkImage)handle);
+                std::unordered_map<VkImage, imageObj>::iterator it = m_images.find((VkImage)handle);
                 if (it != m_images.end()) {
                     objMemory obj = it->second.imageMem;
                     obj.setCount(num);
@@ -180,7 +209,7 @@ class vkReplayObjMapper {
                          const unsigned int num) {
         switch (objectType) {
             case VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT: {
-                std::map<VkBuffer, bufferObj>::iterator it = m_buffers.find((VkBuffer)handle);
+                std::unordered_map<VkBuffer, bufferObj>::iterator it = m_buffers.find((VkBuffer)handle);
                 if (it != m_buffers.end()) {
                     objMemory obj = it->second.bufferMem;
                     obj.setReqs(pMemReqs, num);
@@ -189,7 +218,7 @@ class vkReplayObjMapper {
                 break;
             }
             case VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT: {
-                std::map<VkImage, imageObj>::iterator it = m_images.find((VkImage)handle);
+                std::unordered_map<VkImage, imageObj>::iterator it = m_images.find((VkImage)handle);
                 if (it != m_images.end()) {
                     objMemory obj = it->second.imageMem;
                     obj.setReqs(pMemReqs, num);
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <inttypes.h>
+#include <chrono>
+#include <thread>
+#include "vkreplay_pacing.h"
+#include "vktrace_tracelog.h"
+
+extern "C" {
+#include "vktrace_trace_packet_utils.h"
+}
+
+namespace vktrace_replay {
+
+// How late a call may be replayed before its frame counts as behind the capture
+static const uint64_t PACING_LATE_NS = 1000000;
+// Sleeps end this much before a call is due, the rest is spun away as sleeps overshoot
+static const uint64_t PACING_SPIN_NS = 2000000;
+
+Pacer::Pacer(Mode mode)
+    : m_mode(mode),
+      m_started(false),
+      m_traceStart(0),
+      m_replayStart(0),
+      m_pacedFrames(0),
+      m_lateFrames(0),
+      m_lastFrame(-1),
+      m_lastFrameLate(false),
+      m_maxLateness(0),
+      m_maxLatenessFrame(0) {}
+
+void Pacer::wait(const vktrace_trace_packet_header *pHeader, int frame) {
+    if (m_mode == PACE_FRAMES && pHeader->packet_id != VKTRACE_TPI_VK_vkQueuePresentKHR) return;
+
+    uint64_t now = vktrace_get_time();
+    if (!m_started) {
+        m_started = true;
+        m_traceStart = pHeader->entrypoint_begin_time;
+        m_replayStart = now;
+    }
+    if (frame != m_lastFrame) {
+        m_lastFrame = frame;
+        m_lastFrameLate = false;
+        m_pacedFrames++;
+    }
+
+    // Calls of other threads can have begun before the first paced one, those are due right away
+    uint64_t due = m_replayStart;
+    if (pHeader->entrypoint_begin_time > m_traceStart) {
+        due += pHeader->entrypoint_begin_time - m_traceStart;
+    }
+    if (now > due) {
+        uint64_t lateness = now - due;
+        if (lateness > m_maxLateness) {
+            m_maxLateness = lateness;
+            m_maxLatenessFrame = frame;
+        }
+        if (lateness > PACING_LATE_NS && !m_lastFrameLate) {
+            m_lastFrameLate = true;
+            m_lateFrames++;
+            vktrace_LogVerbose("Frame %d is %.3f ms behind the capture at packet %" PRIu64 ".", frame, lateness / 1000000.0,
+                               pHeader->global_packet_index);
+        }
+        return;
+    }
+
+    if (due - now > PACING_SPIN_NS) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(due - now - PACING_SPIN_NS));
+    }
+    while (vktrace_get_time() < due) {
+    }
+}
+
+void Pacer::report() const {
+    if (m_pacedFrames == 0) return;
+
+    vktrace_LogAlways("Paced %" PRIu64 " frames to the capture, %" PRIu64 " fell behind by more than %.3f ms.", m_pacedFrames,
+                      m_lateFrames, PACING_LATE_NS / 1000000.0);
+    if (m_maxLateness > 0) {
+        vktrace_LogAlways("Replay was at most %.3f ms behind the capture, in frame %d.", m_maxLateness / 1000000.0,
+                          m_maxLatenessFrame);
+    }
+}
+
+} /* namespace vktrace_replay */
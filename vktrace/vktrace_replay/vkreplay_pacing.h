@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stdint.h>
+
+extern "C" {
+#include "vktrace_trace_packet_identifiers.h"
+}
+
+/* Holds replay back to the cadence the trace was captured at, instead of replaying as fast as
+ * possible. Each paced packet is due when as much time has passed since the first paced packet as
+ * had passed between their entrypoint_begin_times in the traced run. Replay sleeps until shortly
+ * before that and spins the rest of the way. Replay that falls behind isn't slowed down any
+ * further, it catches up by replaying the calls that are already due right away. The frames in
+ * which a call was due more than PACING_LATE_NS before replay got to it are logged, and report()
+ * sums them up. */
+namespace vktrace_replay {
+
+class Pacer {
+   public:
+    enum Mode {
+        PACE_CALLS,   // every API call
+        PACE_FRAMES,  // vkQueuePresentKHR only
+    };
+
+    explicit Pacer(Mode mode);
+
+    // Before the packet is replayed in frame, returns once it is due
+    void wait(const vktrace_trace_packet_header *pHeader, int frame);
+    // Starts timing again from the next packet, e.g. after replay went back to the start of a loop
+    void restart() { m_started = false; }
+    void report() const;
+
+   private:
+    Mode m_mode;
+    bool m_started;
+    uint64_t m_traceStart;   // entrypoint_begin_time of the first paced packet
+    uint64_t m_replayStart;  // when replay got to it
+
+    uint64_t m_pacedFrames;
+    uint64_t m_lateFrames;
+    int m_lastFrame;
+    bool m_lastFrameLate;
+    uint64_t m_maxLateness;
+    int m_maxLatenessFrame;
+};
+
+} /* namespace vktrace_replay */
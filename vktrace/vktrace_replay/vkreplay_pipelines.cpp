@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "vkreplay_pipelines.h"
+#include "vkreplay_placement.h"
+
+namespace vktrace_replay {
+
+PipelineThreads::PipelineThreads(unsigned int threadCount) : m_pendingJobs(0), m_exit(false) {
+    for (unsigned int i = 0; i < threadCount; i++) {
+        m_threads.push_back(std::thread(&PipelineThreads::thread_func, this));
+    }
+}
+
+PipelineThreads::~PipelineThreads() {
+    sync();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_exit = true;
+    }
+    m_jobQueued.notify_all();
+    for (size_t i = 0; i < m_threads.size(); i++) {
+        m_threads[i].join();
+    }
+}
+
+void PipelineThreads::queue(const std::function<void()> &job) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(job);
+        m_pendingJobs++;
+    }
+    m_jobQueued.notify_one();
+}
+
+void PipelineThreads::sync() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this] { return m_pendingJobs == 0; });
+}
+
+void PipelineThreads::thread_func() {
+    place_current_thread(THREAD_ROLE_WORKER);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_jobQueued.wait(lock, [this] { return m_exit || !m_jobs.empty(); });
+        if (m_jobs.empty()) return;
+
+        std::function<void()> job = m_jobs.front();
+        m_jobs.pop_front();
+        lock.unlock();
+
+        job();
+
+        lock.lock();
+        if (--m_pendingJobs == 0) {
+            m_idle.notify_all();
+        }
+    }
+}
+
+} /* namespace vktrace_replay */
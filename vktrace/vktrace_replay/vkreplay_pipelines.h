@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Compiles pipelines on a pool of worker threads. The replayer remaps the create infos and keeps
+ * its own copy of them, the workers only call the driver, and the replayer adds the pipelines to
+ * its object maps once sync() returns. */
+namespace vktrace_replay {
+
+class PipelineThreads {
+   public:
+    explicit PipelineThreads(unsigned int threadCount);
+    ~PipelineThreads();
+
+    // Run job on the first idle worker
+    void queue(const std::function<void()> &job);
+
+    // Wait until every queued job has run.
+    void sync();
+
+   private:
+    void thread_func();
+
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_jobs;
+
+    std::mutex m_mutex;
+    std::condition_variable m_jobQueued;
+    std::condition_variable m_idle;
+    size_t m_pendingJobs;
+    bool m_exit;
+};
+
+} /* namespace vktrace_replay */
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
+#include <errno.h>
+#include <sys/mman.h>
+#endif
+#if defined(PLATFORM_LINUX)
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "vkreplay_placement.h"
+#include "vktrace_platform.h"
+#include "vktrace_tracelog.h"
+
+namespace vktrace_replay {
+
+// Niceness of threads whose priority is raised, on Linux
+static const int RAISED_NICENESS = -10;
+
+static const char *const roleNames[THREAD_ROLE_COUNT] = {"replay", "I/O", "worker"};
+
+static std::vector<unsigned int> s_cores[THREAD_ROLE_COUNT];
+static bool s_raisePriority = false;
+static bool s_lockMemory = false;
+
+static bool parse_core_list(const char *pList, std::vector<unsigned int> *pCores) {
+    pCores->clear();
+    if (pList == NULL) return true;
+
+    const char *pNext = pList;
+    while (*pNext != '\0') {
+        char *pEnd;
+        unsigned long first = strtoul(pNext, &pEnd, 10);
+        if (pEnd == pNext) return false;
+        unsigned long last = first;
+        if (*pEnd == '-') {
+            pNext = pEnd + 1;
+            last = strtoul(pNext, &pEnd, 10);
+            if (pEnd == pNext || last < first) return false;
+        }
+        for (unsigned long core = first; core <= last; core++) {
+            pCores->push_back((unsigned int)core);
+        }
+        if (*pEnd == ',') {
+            pEnd++;
+        } else if (*pEnd != '\0') {
+            return false;
+        }
+        pNext = pEnd;
+    }
+    return !pCores->empty();
+}
+
+bool init_thread_placement(const char *replayCores, const char *ioCores, const char *workerCores, bool raisePriority,
+                           bool lockMemory) {
+    const char *lists[THREAD_ROLE_COUNT] = {replayCores, ioCores, workerCores};
+    for (int role = 0; role < THREAD_ROLE_COUNT; role++) {
+        if (!parse_core_list(lists[role], &s_cores[role])) {
+            vktrace_LogError("Can't parse the %s cores \"%s\", expected cores and ranges of cores like \"0,2-3\".",
+                             roleNames[role], lists[role]);
+            return false;
+        }
+#if defined(PLATFORM_OSX)
+        if (!s_cores[role].empty()) {
+            vktrace_LogWarning("Threads can't be moved to cores of their own on macOS, the %s cores are ignored.", roleNames[role]);
+            s_cores[role].clear();
+        }
+#endif
+    }
+    s_raisePriority = raisePriority;
+    s_lockMemory = lockMemory;
+    return true;
+}
+
+void place_current_thread(ThreadRole role) {
+    const std::vector<unsigned int> &cores = s_cores[role];
+#if defined(PLATFORM_LINUX)
+    if (!cores.empty()) {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        for (size_t i = 0; i < cores.size(); i++) {
+            if (cores[i] < CPU_SETSIZE) CPU_SET(cores[i], &cpuSet);
+        }
+        // 0 is the calling thread
+        if (sched_setaffinity(0, sizeof(cpuSet), &cpuSet) != 0) {
+            vktrace_LogWarning("Failed to move a %s thread to its cores, error %d.", roleNames[role], errno);
+        }
+    }
+    if (s_raisePriority && setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), RAISED_NICENESS) != 0) {
+        vktrace_LogWarning("Failed to raise the priority of a %s thread, error %d. It needs CAP_SYS_NICE or a high enough "
+                           "RLIMIT_NICE.",
+                           roleNames[role], errno);
+    }
+#elif defined(WIN32)
+    if (!cores.empty()) {
+        DWORD_PTR mask = 0;
+        for (size_t i = 0; i < cores.size(); i++) {
+            if (cores[i] < sizeof(mask) * 8) mask |= (DWORD_PTR)1 << cores[i];
+        }
+        if (SetThreadAffinityMask(GetCurrentThread(), mask) == 0) {
+            vktrace_LogWarning("Failed to move a %s thread to its cores, error %lu.", roleNames[role], GetLastError());
+        }
+    }
+    if (s_raisePriority && !SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST)) {
+        vktrace_LogWarning("Failed to raise the priority of a %s thread, error %lu.", roleNames[role], GetLastError());
+    }
+#else
+    (void)cores;
+#endif
+}
+
+void lock_replay_memory(void *pBase, size_t size) {
+    if (!s_lockMemory || pBase == NULL || size == 0) return;
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
+    if (mlock(pBase, size) != 0) {
+        vktrace_LogWarning("Failed to lock %zu bytes in memory, error %d. RLIMIT_MEMLOCK may be too low.", size, errno);
+    }
+#elif defined(WIN32)
+    // The working set has to be big enough to hold the locked pages
+    SIZE_T minimumSize, maximumSize;
+    if (GetProcessWorkingSetSize(GetCurrentProcess(), &minimumSize, &maximumSize)) {
+        SetProcessWorkingSetSize(GetCurrentProcess(), minimumSize + size, maximumSize + size);
+    }
+    if (!VirtualLock(pBase, size)) {
+        vktrace_LogWarning("Failed to lock %zu bytes in memory, error %lu.", size, GetLastError());
+    }
+#endif
+}
+
+} /* namespace vktrace_replay */
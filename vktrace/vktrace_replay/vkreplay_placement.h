@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stddef.h>
+
+/* Where the threads of vkreplay run and at what priority, so that benchmark timings don't pick up
+ * the noise of threads moving between cores or preempting each other. Each thread places itself
+ * when it starts, by its role: the replay thread, the I/O threads reading the trace ahead of it,
+ * or the worker threads recording command buffers and creating pipelines. Threads of a role
+ * without a core set are left to the scheduler. Placement is set up once, before any thread
+ * places itself. Cores can't be chosen on macOS. */
+namespace vktrace_replay {
+
+enum ThreadRole {
+    THREAD_ROLE_REPLAY,
+    THREAD_ROLE_IO,
+    THREAD_ROLE_WORKER,
+    THREAD_ROLE_COUNT,
+};
+
+// Core lists are comma separated cores and ranges of cores, like "0,2-3", or NULL. Returns false
+// if one can't be parsed.
+bool init_thread_placement(const char *replayCores, const char *ioCores, const char *workerCores, bool raisePriority,
+                           bool lockMemory);
+
+// Moves the calling thread to the cores of its role, and raises its priority if that was asked for
+void place_current_thread(ThreadRole role);
+
+// Keeps the pages of the range resident if locking memory was asked for, e.g. those of the mapped
+// trace file, so replay doesn't wait on page faults. They stay locked until they are unmapped.
+void lock_replay_memory(void *pBase, size_t size);
+
+} /* namespace vktrace_replay */
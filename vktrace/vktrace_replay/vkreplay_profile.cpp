@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <inttypes.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "vkreplay_profile.h"
+#include "vktrace_vk_packet_id.h"
+#include "vktrace_tracelog.h"
+
+namespace vktrace_replay {
+
+// Bucket 0 holds calls with less than 1us of overhead, bucket i calls with [2^(i-1), 2^i) us, and
+// the last bucket everything from 1ms up.
+static const unsigned int PROFILE_HISTOGRAM_BUCKETS = 12;
+
+// Number of APIs listed for each of the worst frames
+static const unsigned int PROFILE_FRAME_TOP_APIS = 3;
+
+struct ApiProfile {
+    uint64_t calls;
+    uint64_t overheadTime;
+    uint64_t maxOverheadTime;
+    uint64_t driverTime;
+    uint64_t histogram[PROFILE_HISTOGRAM_BUCKETS];
+};
+
+struct FrameApiCost {
+    uint16_t packetId;
+    uint64_t calls;
+    uint64_t overheadTime;
+};
+
+struct FrameProfile {
+    uint64_t frame;
+    uint64_t calls;
+    uint64_t overheadTime;
+    uint64_t driverTime;
+    std::vector<FrameApiCost> topApis;
+};
+
+static unsigned int histogram_bucket(uint64_t overheadTime) {
+    uint64_t us = overheadTime / 1000;
+    unsigned int bucket = 0;
+    while (us > 0 && bucket < PROFILE_HISTOGRAM_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static bool greater_overhead(const FrameApiCost &a, const FrameApiCost &b) { return a.overheadTime > b.overheadTime; }
+
+static const char *api_name(uint16_t packetId) { return vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)packetId); }
+
+static void finish_frame(uint64_t frame, const std::unordered_map<uint16_t, FrameApiCost> &apis, std::vector<FrameProfile> &frames) {
+    FrameProfile profile = {frame, 0, 0, 0, std::vector<FrameApiCost>()};
+    std::vector<FrameApiCost> costs;
+    costs.reserve(apis.size());
+    for (auto it = apis.begin(); it != apis.end(); ++it) {
+        costs.push_back(it->second);
+        profile.calls += it->second.calls;
+        profile.overheadTime += it->second.overheadTime;
+    }
+    if (profile.calls == 0) return;
+
+    size_t top = std::min(costs.size(), (size_t)PROFILE_FRAME_TOP_APIS);
+    std::partial_sort(costs.begin(), costs.begin() + top, costs.end(), greater_overhead);
+    profile.topApis.assign(costs.begin(), costs.begin() + top);
+    frames.push_back(profile);
+}
+
+int print_capture_profile(AbstractSequencer &seq, unsigned int worstFrames) {
+    std::unordered_map<uint16_t, ApiProfile> apis;
+    std::unordered_map<uint16_t, FrameApiCost> frameApis;
+    std::vector<FrameProfile> frames;
+    uint64_t frame = 0;
+    uint64_t frameDriverTime = 0;
+    uint64_t totalCalls = 0;
+    uint64_t totalOverheadTime = 0;
+    uint64_t totalDriverTime = 0;
+
+    vktrace_trace_packet_header *pHeader;
+    while ((pHeader = seq.get_next_packet()) != NULL) {
+        if (pHeader->packet_id < VKTRACE_TPI_VK_vkApiVersion) continue;
+
+        // Packets that vktrace makes up itself have all four times equal and count as free
+        uint64_t totalTime = pHeader->vktrace_end_time > pHeader->vktrace_begin_time
+                                 ? pHeader->vktrace_end_time - pHeader->vktrace_begin_time
+                                 : 0;
+        uint64_t driverTime = pHeader->entrypoint_end_time > pHeader->entrypoint_begin_time
+                                  ? pHeader->entrypoint_end_time - pHeader->entrypoint_begin_time
+                                  : 0;
+        uint64_t overheadTime = totalTime > driverTime ? totalTime - driverTime : 0;
+
+        auto found = apis.find(pHeader->packet_id);
+        if (found == apis.end()) {
+            ApiProfile profile = {};
+            found = apis.insert(std::make_pair(pHeader->packet_id, profile)).first;
+        }
+        ApiProfile &api = found->second;
+        api.calls++;
+        api.overheadTime += overheadTime;
+        api.maxOverheadTime = std::max(api.maxOverheadTime, overheadTime);
+        api.driverTime += driverTime;
+        api.histogram[histogram_bucket(overheadTime)]++;
+        totalCalls++;
+        totalOverheadTime += overheadTime;
+        totalDriverTime += driverTime;
+
+        FrameApiCost &frameApi = frameApis[pHeader->packet_id];
+        frameApi.packetId = pHeader->packet_id;
+        frameApi.calls++;
+        frameApi.overheadTime += overheadTime;
+        frameDriverTime += driverTime;
+
+        // A frame ends with its present, like the frame numbers the replayer reports
+        if (pHeader->packet_id == VKTRACE_TPI_VK_vkQueuePresentKHR) {
+            finish_frame(frame, frameApis, frames);
+            frames.back().driverTime = frameDriverTime;
+            frameApis.clear();
+            frameDriverTime = 0;
+            frame++;
+        }
+    }
+    if (!frameApis.empty()) {
+        finish_frame(frame, frameApis, frames);
+        frames.back().driverTime = frameDriverTime;
+    }
+
+    if (totalCalls == 0) {
+        vktrace_LogError("Trace file contains no API calls to profile.");
+        return -1;
+    }
+
+    vktrace_LogAlways("Capture profile: %" PRIu64 " API calls in %" PRIu64 " frames, %.3f ms in vktrace, %.3f ms in the driver.",
+                      totalCalls, (uint64_t)frames.size(), totalOverheadTime / 1000000.0, totalDriverTime / 1000000.0);
+
+    // Most expensive APIs first
+    std::vector<std::pair<uint16_t, const ApiProfile *>> sorted;
+    sorted.reserve(apis.size());
+    for (auto it = apis.begin(); it != apis.end(); ++it) {
+        sorted.push_back(std::make_pair(it->first, &it->second));
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [](const std::pair<uint16_t, const ApiProfile *> &a, const std::pair<uint16_t, const ApiProfile *> &b) {
+                  return a.second->overheadTime > b.second->overheadTime;
+              });
+
+    vktrace_LogAlways("%-44s %10s %14s %12s %12s %14s %12s", "API", "calls", "vktrace (us)", "mean (us)", "max (us)",
+                      "driver (us)", "mean (us)");
+    for (size_t i = 0; i < sorted.size(); i++) {
+        const ApiProfile &api = *sorted[i].second;
+        vktrace_LogAlways("%-44s %10" PRIu64 " %14.1f %12.2f %12.1f %14.1f %12.2f", api_name(sorted[i].first), api.calls,
+                          api.overheadTime / 1000.0, api.overheadTime / 1000.0 / api.calls, api.maxOverheadTime / 1000.0,
+                          api.driverTime / 1000.0, api.driverTime / 1000.0 / api.calls);
+    }
+
+    std::string line;
+    char text[128];
+    line = "vktrace overhead per call (us)";
+    line.resize(44, ' ');
+    for (unsigned int b = 0; b < PROFILE_HISTOGRAM_BUCKETS; b++) {
+        if (b == PROFILE_HISTOGRAM_BUCKETS - 1) {
+            snprintf(text, sizeof(text), " %7s", ">=1024");
+        } else {
+            char bound[16];
+            snprintf(bound, sizeof(bound), "<%u", 1u << b);
+            snprintf(text, sizeof(text), " %7s", bound);
+        }
+        line += text;
+    }
+    vktrace_LogAlways("%s", line.c_str());
+    for (size_t i = 0; i < sorted.size(); i++) {
+        const ApiProfile &api = *sorted[i].second;
+        snprintf(text, sizeof(text), "%-44s", api_name(sorted[i].first));
+        line = text;
+        for (unsigned int b = 0; b < PROFILE_HISTOGRAM_BUCKETS; b++) {
+            snprintf(text, sizeof(text), " %7" PRIu64, api.histogram[b]);
+            line += text;
+        }
+        vktrace_LogAlways("%s", line.c_str());
+    }
+
+    size_t frameCount = std::min(frames.size(), (size_t)worstFrames);
+    std::partial_sort(frames.begin(), frames.begin() + frameCount, frames.end(),
+                      [](const FrameProfile &a, const FrameProfile &b) { return a.overheadTime > b.overheadTime; });
+    if (frameCount > 0) {
+        vktrace_LogAlways("Frames with the most vktrace overhead:");
+    }
+    for (size_t i = 0; i < frameCount; i++) {
+        const FrameProfile &profile = frames[i];
+        line.clear();
+        for (size_t a = 0; a < profile.topApis.size(); a++) {
+            snprintf(text, sizeof(text), "%s%s %.1f us (%" PRIu64 ")", a == 0 ? "" : ", ", api_name(profile.topApis[a].packetId),
+                     profile.topApis[a].overheadTime / 1000.0, profile.topApis[a].calls);
+            line += text;
+        }
+        vktrace_LogAlways("Frame %" PRIu64 ": %" PRIu64 " calls, %.1f us in vktrace, %.1f us in the driver; %s", profile.frame,
+                          profile.calls, profile.overheadTime / 1000.0, profile.driverTime / 1000.0, line.c_str());
+    }
+    return 0;
+}
+
+} /* namespace vktrace_replay */
@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  Capture profile
+//
+//     Every packet records when vktrace started and finished handling the call
+//     (vktrace_begin_time/vktrace_end_time) and the time spent calling down the chain
+//     (entrypoint_begin_time/entrypoint_end_time). The difference between the two is what tracing
+//     the call cost the application, so a trace is its own profile of the capture.
+//
+//     print_capture_profile walks the packets of a trace without replaying them and logs, for each
+//     API, how often it was called, the time spent in the driver and in vktrace, and a histogram of
+//     the vktrace overhead per call. It then breaks down the frames vktrace slowed down the most by
+//     the APIs that cost the most in each of them.
+
+#pragma once
+
+#include "vkreplay_seq.h"
+
+namespace vktrace_replay {
+
+// Returns 0 on success. worstFrames is the number of frames to break down.
+int print_capture_profile(AbstractSequencer &seq, unsigned int worstFrames);
+
+} /* namespace vktrace_replay */
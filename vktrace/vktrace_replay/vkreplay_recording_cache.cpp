@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string.h>
+#include "vkreplay_recording_cache.h"
+#include "vktrace_cmd_block.h"
+#include "vktrace_tracelog.h"
+#include "vktrace_trace_packet_utils.h"
+#include "vktrace_vk_packet_id.h"
+
+namespace vktrace_replay {
+
+// The body of every recording packet starts like this
+typedef struct {
+    vktrace_trace_packet_header *header;
+    VkCommandBuffer commandBuffer;
+} recording_packet_prefix;
+
+static const recording_packet_prefix *packet_prefix(const vktrace_trace_packet_header *pPacket) {
+    return (const recording_packet_prefix *)((uintptr_t)pPacket + sizeof(vktrace_trace_packet_header));
+}
+
+RecordingCache::~RecordingCache() {
+    for (auto it = m_activeRecordings.begin(); it != m_activeRecordings.end(); ++it) {
+        for (size_t i = 0; i < it->second.held.size(); i++) {
+            vktrace_free(it->second.held[i]);
+        }
+    }
+    for (size_t i = 0; i < m_released.size(); i++) {
+        vktrace_free(m_released[i]);
+    }
+}
+
+bool RecordingCache::is_recording_packet(const vktrace_trace_packet_header *pPacket) {
+    if (pPacket->packet_id == VKTRACE_TPI_VK_vkBeginCommandBuffer || pPacket->packet_id == VKTRACE_TPI_VK_vkEndCommandBuffer ||
+        pPacket->packet_id == VKTRACE_TPI_CMD_BLOCK) {
+        return true;
+    }
+    const char *pName = vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)pPacket->packet_id);
+    return pName != NULL && strncmp(pName, "vkCmd", 5) == 0;
+}
+
+bool RecordingCache::invalidates_recordings(const vktrace_trace_packet_header *pPacket) {
+    if (pPacket->packet_id == VKTRACE_TPI_VK_vkUpdateDescriptorSets ||
+        pPacket->packet_id == VKTRACE_TPI_VK_vkUpdateDescriptorSetWithTemplateKHR ||
+        pPacket->packet_id == VKTRACE_TPI_VK_vkResetDescriptorPool) {
+        return true;
+    }
+    // A destroyed object's handle can come back as a different object, that the trace's handle then maps to
+    const char *pName = vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)pPacket->packet_id);
+    return pName != NULL && (strncmp(pName, "vkDestroy", 9) == 0 || strncmp(pName, "vkFree", 6) == 0);
+}
+
+uint64_t RecordingCache::hash_packet(const vktrace_trace_packet_header *pPacket) {
+    // FNV-1a over the call and its raw body, after the body's pointer to the header, which holds an address in the
+    // traced process. Pointers in raw bodies are offsets into the body, so identical calls hash the same.
+    const size_t skip = sizeof(vktrace_trace_packet_header) + sizeof(vktrace_trace_packet_header *);
+    uint64_t hash = 14695981039346656037ULL;
+    hash = (hash ^ pPacket->packet_id) * 1099511628211ULL;
+    const uint8_t *pBytes = (const uint8_t *)pPacket + skip;
+    size_t size = (pPacket->size > skip) ? (size_t)pPacket->size - skip : 0;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, pBytes + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ULL;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ pBytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool RecordingCache::executes_commands(const vktrace_trace_packet_header *pPacket) {
+    if (pPacket->packet_id == VKTRACE_TPI_VK_vkCmdExecuteCommands) {
+        return true;
+    }
+    if (pPacket->packet_id != VKTRACE_TPI_CMD_BLOCK) {
+        return false;
+    }
+    // Walk the opcodes of the block's entries
+    const vktrace_cmd_block *pBlock = (const vktrace_cmd_block *)packet_prefix(pPacket);
+    const uint8_t *pStream = vktrace_cmd_block_stream(pBlock);
+    uint32_t offset = 0;
+    while (pBlock->streamSize - offset >= VKTRACE_CMD_BLOCK_ENTRY_HEADER_SIZE) {
+        uint16_t opcode, words;
+        memcpy(&opcode, pStream + offset, sizeof(opcode));
+        memcpy(&words, pStream + offset + sizeof(opcode), sizeof(words));
+        if (opcode == VKTRACE_TPI_VK_vkCmdExecuteCommands) {
+            return true;
+        }
+        if ((uint64_t)words * 4 > pBlock->streamSize - offset - VKTRACE_CMD_BLOCK_ENTRY_HEADER_SIZE) {
+            break;
+        }
+        offset += VKTRACE_CMD_BLOCK_ENTRY_HEADER_SIZE + (uint32_t)words * 4;
+    }
+    return false;
+}
+
+bool RecordingCache::is_one_time_submit(vktrace_trace_packet_header *pPacket) {
+    const packet_vkBeginCommandBuffer *pBody = (const packet_vkBeginCommandBuffer *)packet_prefix(pPacket);
+    const VkCommandBufferBeginInfo *pBeginInfo = (const VkCommandBufferBeginInfo *)vktrace_trace_packet_interpret_buffer_pointer(
+        pPacket, (intptr_t)pBody->pBeginInfo);
+    return pBeginInfo == NULL || (pBeginInfo->flags & VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT) != 0;
+}
+
+void RecordingCache::release(ActiveRecording &active) {
+    active.matching = false;
+    m_released.insert(m_released.end(), active.held.begin(), active.held.end());
+    active.held.clear();
+    recorded_again();
+}
+
+void RecordingCache::release_all() {
+    for (auto it = m_activeRecordings.begin(); it != m_activeRecordings.end(); ++it) {
+        if (it->second.matching) {
+            release(it->second);
+        }
+    }
+}
+
+bool RecordingCache::hold(ActiveRecording &active, vktrace_trace_packet_header *pPacket) {
+    // The sequencer reuses the packet's memory once the next one is read
+    vktrace_trace_packet_header *pCopy = (vktrace_trace_packet_header *)vktrace_malloc((size_t)pPacket->size);
+    if (pCopy == NULL) {
+        return false;
+    }
+    memcpy(pCopy, pPacket, (size_t)pPacket->size);
+    pCopy->pBody = (uintptr_t)pCopy + sizeof(vktrace_trace_packet_header);
+    active.held.push_back(pCopy);
+    return true;
+}
+
+void RecordingCache::recorded_again() {
+    // A command buffer recorded again leaves the primary command buffers that executed it invalid
+    for (auto it = m_lastRecordings.begin(); it != m_lastRecordings.end(); ++it) {
+        if (it->second.executesCommands) {
+            it->second.reusable = false;
+        }
+    }
+    for (auto it = m_activeRecordings.begin(); it != m_activeRecordings.end(); ++it) {
+        if (it->second.matching && it->second.executesCommands) {
+            release(it->second);
+        }
+    }
+}
+
+bool RecordingCache::filter(vktrace_trace_packet_header *pPacket) {
+    if (pPacket->packet_id == VKTRACE_TPI_VK_vkResetCommandBuffer || pPacket->packet_id == VKTRACE_TPI_VK_vkResetCommandPool) {
+        return true;
+    }
+    if (!is_recording_packet(pPacket)) {
+        if (pPacket->packet_id == VKTRACE_TPI_VK_vkAllocateCommandBuffers) {
+            // A new command buffer can have the trace handle of a freed one
+            release_all();
+            m_lastRecordings.clear();
+        } else if (invalidates_recordings(pPacket)) {
+            release_all();
+            m_epoch++;
+        }
+        return false;
+    }
+
+    VkCommandBuffer commandBuffer = packet_prefix(pPacket)->commandBuffer;
+    if (pPacket->packet_id == VKTRACE_TPI_VK_vkBeginCommandBuffer) {
+        ActiveRecording &active = m_activeRecordings[commandBuffer];
+        if (active.matching) {
+            release(active);
+        }
+        auto last = m_lastRecordings.find(commandBuffer);
+        active.hashes.clear();
+        active.reusable = !is_one_time_submit(pPacket);
+        active.executesCommands = false;
+        active.matching = active.reusable && last != m_lastRecordings.end() && last->second.reusable && last->second.epoch == m_epoch;
+        if (!active.matching) {
+            recorded_again();
+        }
+        m_recordings++;
+    }
+    auto activeIt = m_activeRecordings.find(commandBuffer);
+    if (activeIt == m_activeRecordings.end()) {
+        // Recorded from before the trace started
+        return false;
+    }
+    ActiveRecording &active = activeIt->second;
+
+    uint64_t hash = hash_packet(pPacket);
+    active.hashes.push_back(hash);
+    active.executesCommands = active.executesCommands || executes_commands(pPacket);
+    bool held = false;
+    if (active.matching) {
+        const Recording &last = m_lastRecordings[commandBuffer];
+        size_t index = active.hashes.size() - 1;
+        if (index < last.hashes.size() && last.hashes[index] == hash && hold(active, pPacket)) {
+            held = true;
+        } else {
+            release(active);
+        }
+    }
+
+    if (pPacket->packet_id == VKTRACE_TPI_VK_vkEndCommandBuffer) {
+        Recording &last = m_lastRecordings[commandBuffer];
+        if (active.matching && active.hashes.size() == last.hashes.size()) {
+            // The command buffer still holds this recording
+            for (size_t i = 0; i < active.held.size(); i++) {
+                vktrace_free(active.held[i]);
+            }
+            m_reusedRecordings++;
+        } else {
+            // Shorter than the last recording, the held back packets include this one
+            if (active.matching) {
+                release(active);
+            }
+            last.hashes.swap(active.hashes);
+            last.epoch = m_epoch;
+            last.reusable = active.reusable;
+            last.executesCommands = active.executesCommands;
+        }
+        m_activeRecordings.erase(activeIt);
+    }
+    return held;
+}
+
+std::vector<vktrace_trace_packet_header *> RecordingCache::take_released() {
+    std::vector<vktrace_trace_packet_header *> released;
+    released.swap(m_released);
+    return released;
+}
+
+void RecordingCache::reset() {
+    release_all();
+    m_activeRecordings.clear();
+    m_lastRecordings.clear();
+}
+
+void RecordingCache::report() const {
+    vktrace_LogVerbose("Reused %" PRIu64 " of %" PRIu64 " command buffer recordings.", m_reusedRecordings, m_recordings);
+}
+
+} /* namespace vktrace_replay */
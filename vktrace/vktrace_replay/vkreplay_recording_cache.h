@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+#include "vulkan/vulkan.h"
+
+extern "C" {
+#include "vktrace_trace_packet_identifiers.h"
+}
+
+/* Skips recording a command buffer again when the trace records exactly what it recorded last time.
+ * Every packet from vkBeginCommandBuffer to vkEndCommandBuffer is hashed, without its packet header.
+ * When a command buffer is begun again, its packets are held back for as long as their hashes match
+ * the last recording. If the recording ends identical, the held back packets are dropped and the
+ * command buffer still holds what it was recorded with. At the first packet that differs they are
+ * released to be replayed ahead of it.
+ *
+ * The last recordings stop being reused when the objects they use could have changed: on any call
+ * that destroys or frees an object, updates descriptor sets or allocates command buffers, and for
+ * recordings that execute secondary command buffers, whenever another command buffer is recorded.
+ * vkResetCommandBuffer and vkResetCommandPool are dropped, since vkBeginCommandBuffer resets the
+ * command buffers that are recorded again; command pools are created with
+ * VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT for that. Recordings begun with
+ * VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT can't be submitted again and are never reused. */
+namespace vktrace_replay {
+
+class RecordingCache {
+   public:
+    RecordingCache() : m_epoch(0), m_reusedRecordings(0), m_recordings(0) {}
+    ~RecordingCache();
+
+    // Returns true if pPacket was held back or dropped, and false if the caller replays it. Either way
+    // the caller first replays and frees what take_released() returns.
+    bool filter(vktrace_trace_packet_header *pPacket);
+
+    // Copies of raw held back packets, in trace order, that have to be replayed now
+    std::vector<vktrace_trace_packet_header *> take_released();
+
+    // Release every held back packet and forget every recording, for when replay starts over
+    void reset();
+
+    // Log how many recordings were reused
+    void report() const;
+
+   private:
+    struct Recording {
+        std::vector<uint64_t> hashes;  // hash of each packet of the last complete recording
+        uint64_t epoch;                // m_epoch when it ended
+        bool reusable;                 // ended, and can be submitted again
+        bool executesCommands;         // calls vkCmdExecuteCommands
+    };
+
+    struct ActiveRecording {
+        std::vector<uint64_t> hashes;                       // hashes of the packets so far
+        std::vector<vktrace_trace_packet_header *> held;    // packets held back while they match
+        bool matching;                                      // every packet so far matched the last recording
+        bool reusable;
+        bool executesCommands;
+    };
+
+    static bool is_recording_packet(const vktrace_trace_packet_header *pPacket);
+    static bool invalidates_recordings(const vktrace_trace_packet_header *pPacket);
+    static uint64_t hash_packet(const vktrace_trace_packet_header *pPacket);
+    static bool executes_commands(const vktrace_trace_packet_header *pPacket);
+    static bool is_one_time_submit(vktrace_trace_packet_header *pPacket);
+
+    void release(ActiveRecording &active);
+    void release_all();
+    bool hold(ActiveRecording &active, vktrace_trace_packet_header *pPacket);
+    void recorded_again();
+
+    std::unordered_map<VkCommandBuffer, Recording> m_lastRecordings;
+    std::unordered_map<VkCommandBuffer, ActiveRecording> m_activeRecordings;
+    std::vector<vktrace_trace_packet_header *> m_released;
+    uint64_t m_epoch;
+    uint64_t m_reusedRecordings;
+    uint64_t m_recordings;
+};
+
+} /* namespace vktrace_replay */
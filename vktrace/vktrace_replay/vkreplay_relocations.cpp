@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <inttypes.h>
+#include <string.h>
+#include "vkreplay_relocations.h"
+#include "vkreplay_factory.h"
+#include "vktrace_tracelog.h"
+
+namespace vktrace_replay {
+
+// Interpreting is cheap next to replaying packets bigger than this, which mostly hold buffer
+// contents, so they aren't worth copying and comparing.
+static const uint64_t RELOCATION_MAX_PACKET_SIZE = 1024 * 1024;
+
+PacketRelocations::~PacketRelocations() {
+    vktrace_LogVerbose("Replayed %" PRIu64 " packets by relocating their pointers, interpreted %" PRIu64 ".", m_relocatedPackets,
+                       m_interpretedPackets);
+}
+
+vktrace_trace_packet_header *PacketRelocations::interpret(vktrace_trace_packet_replay_library *pReplayer,
+                                                          vktrace_trace_packet_header *pPacket) {
+    auto found = m_packets.find(pPacket->global_packet_index);
+    if (found != m_packets.end() && found->second.size == pPacket->size && found->second.packetId == pPacket->packet_id) {
+        const PacketEntry &entry = found->second;
+        if (!entry.relocatable) {
+            m_interpretedPackets++;
+            return pReplayer->Interpret(pPacket);
+        }
+
+        uint8_t *pBytes = (uint8_t *)pPacket;
+        if (entry.setsHeader) {
+            memcpy(pBytes + sizeof(vktrace_trace_packet_header), &pPacket, sizeof(pPacket));
+        }
+        for (uint32_t i = 0; i < entry.offsetCount; i++) {
+            uintptr_t pointer;
+            memcpy(&pointer, pBytes + m_offsets[entry.firstOffset + i], sizeof(pointer));
+            pointer += pPacket->pBody;
+            memcpy(pBytes + m_offsets[entry.firstOffset + i], &pointer, sizeof(pointer));
+        }
+        m_relocatedPackets++;
+        return pPacket;
+    }
+
+    PacketEntry entry = {pPacket->size, pPacket->packet_id, false, false, (uint32_t)m_offsets.size(), 0};
+    bool compare = pPacket->size <= RELOCATION_MAX_PACKET_SIZE;
+    if (compare) {
+        m_raw.assign((uint8_t *)pPacket, (uint8_t *)pPacket + (size_t)pPacket->size);
+    }
+    vktrace_trace_packet_header *pInterpreted = pReplayer->Interpret(pPacket);
+    if (compare && pInterpreted == pPacket) {
+        entry.relocatable = find_relocations(pInterpreted, entry);
+    }
+    m_packets[pPacket->global_packet_index] = entry;
+    m_interpretedPackets++;
+    return pInterpreted;
+}
+
+bool PacketRelocations::find_relocations(const vktrace_trace_packet_header *pInterpreted, PacketEntry &entry) {
+    uint8_t *pRaw = m_raw.data();
+    const uint8_t *pNew = (const uint8_t *)pInterpreted;
+    const size_t size = (size_t)entry.size;
+    const uintptr_t base = pInterpreted->pBody;
+
+    if (memcmp(pRaw, pNew, sizeof(vktrace_trace_packet_header)) != 0) {
+        return false;
+    }
+
+    // Packet structs start with a pointer to the packet header
+    const vktrace_trace_packet_header *pHeaderMember;
+    if (size >= sizeof(vktrace_trace_packet_header) + sizeof(pHeaderMember)) {
+        memcpy(&pHeaderMember, pNew + sizeof(vktrace_trace_packet_header), sizeof(pHeaderMember));
+        if (pHeaderMember == pInterpreted) {
+            memcpy(pRaw + sizeof(vktrace_trace_packet_header), &pHeaderMember, sizeof(pHeaderMember));
+            entry.setsHeader = true;
+        }
+    }
+
+    // Every changed byte has to belong to a pointer that went from an offset to base + offset.
+    // Nothing inside a pointer is left unaccounted for, so patching them reproduces pNew exactly.
+    size_t i = sizeof(vktrace_trace_packet_header);
+    size_t pointerEnd = i;
+    while (i < size) {
+        if (pRaw[i] == pNew[i]) {
+            i++;
+            continue;
+        }
+
+        // Low bytes of the pointer holding byte i may not have changed
+        size_t start = i >= pointerEnd + sizeof(uintptr_t) - 1 ? i - (sizeof(uintptr_t) - 1) : pointerEnd;
+        bool found = false;
+        for (size_t j = start; j <= i && j + sizeof(uintptr_t) <= size; j++) {
+            uintptr_t offset, pointer;
+            memcpy(&offset, pRaw + j, sizeof(offset));
+            memcpy(&pointer, pNew + j, sizeof(pointer));
+            if (offset != 0 && pointer == offset + base) {
+                m_offsets.push_back((uint32_t)j);
+                pointerEnd = i = j + sizeof(uintptr_t);
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            m_offsets.resize(entry.firstOffset);
+            return false;
+        }
+    }
+    entry.offsetCount = (uint32_t)(m_offsets.size() - entry.firstOffset);
+    return true;
+}
+
+} /* namespace vktrace_replay */
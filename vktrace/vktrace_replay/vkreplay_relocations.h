@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+extern "C" {
+#include "vktrace_trace_packet_identifiers.h"
+}
+
+/* Remembers where interpreting each packet patched a pointer, so the packet can be made ready for
+ * replay again without going through the replayer's interpret functions.
+ * In a packet as it is stored in the trace, every pointer is an offset from the packet body, and
+ * interpreting a packet mostly adds the body's address to each of them. The first time a packet
+ * is interpreted its raw bytes are compared with the result. If adding the body's address at the
+ * offsets that changed reproduces the result exactly, those offsets are kept for the packet, and
+ * they are all that needs patching when a later loop reads it again. Other packets are always
+ * interpreted. */
+namespace vktrace_replay {
+
+struct vktrace_trace_packet_replay_library;
+
+class PacketRelocations {
+   public:
+    PacketRelocations() : m_relocatedPackets(0), m_interpretedPackets(0) {}
+    ~PacketRelocations();
+
+    // Same as pReplayer->Interpret(pPacket); pPacket must be raw.
+    vktrace_trace_packet_header *interpret(vktrace_trace_packet_replay_library *pReplayer, vktrace_trace_packet_header *pPacket);
+
+   private:
+    struct PacketEntry {
+        uint64_t size;
+        uint16_t packetId;
+        bool relocatable;
+        bool setsHeader;       // interpreting points the body's header member at the packet
+        uint32_t firstOffset;  // into m_offsets
+        uint32_t offsetCount;
+    };
+
+    bool find_relocations(const vktrace_trace_packet_header *pInterpreted, PacketEntry &entry);
+
+    std::unordered_map<uint64_t, PacketEntry> m_packets;  // by global_packet_index
+    std::vector<uint32_t> m_offsets;                      // packet offsets of the pointers of all the packets
+    std::vector<uint8_t> m_raw;                           // copy of the packet being interpreted for the first time
+    uint64_t m_relocatedPackets;
+    uint64_t m_interpretedPackets;
+};
+
+} /* namespace vktrace_replay */
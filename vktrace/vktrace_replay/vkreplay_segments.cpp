@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#if !defined(WIN32)
+#include <sys/wait.h>
+#endif
+#include "vkreplay_segments.h"
+#include "vktrace_platform.h"
+#include "vktrace_tracelog.h"
+#include "vktrace_trace_packet_utils.h"
+#include "screenshot_parsing.h"
+
+namespace vktrace_replay {
+
+// Options each segment gets values of its own for, given by their short and long names
+static const char *const segmentOptions[][2] = {
+    {"seg", "Segments"},      {"ff", "FastForward"}, {"l", "NumLoops"},       {"lsf", "LoopStartFrame"},
+    {"lef", "LoopEndFrame"}, {"s", "Screenshot"},   {"gt", "GpuTimestamps"}, {"cr", "CompareReport"},
+};
+
+struct Segment {
+    uint64_t startFrame;
+    uint64_t endFrame;  // first frame of the next segment
+    std::string gpuTimestampsFile;
+    std::string compareReportFile;
+#if defined(WIN32)
+    PROCESS_INFORMATION process;
+#else
+    pid_t process;
+#endif
+    bool running;
+    uint64_t startTime;
+    uint64_t endTime;
+};
+
+static bool is_segment_option(const char *arg) {
+    const char *name = NULL;
+    int nameIndex = 0;
+    if (strncmp(arg, "--", 2) == 0) {
+        name = arg + 2;
+        nameIndex = 1;
+    } else if (arg[0] == '-') {
+        name = arg + 1;
+    } else {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(segmentOptions) / sizeof(segmentOptions[0]); i++) {
+        if (strcmp(name, segmentOptions[i][nameIndex]) == 0) return true;
+    }
+    return false;
+}
+
+// The screenshots to take in [startFrame, endFrame), in the format of --Screenshot, or an empty
+// string if there are none
+static std::string segment_screenshots(const char *screenshotList, uint64_t startFrame, uint64_t endFrame) {
+    std::string frames;
+    if (screenshot::isOptionBelongToScreenShotRange(screenshotList)) {
+        screenshot::FrameRange range;
+        if (screenshot::initScreenShotFrameRange(screenshotList, &range) != 0) return frames;
+
+        uint64_t first = range.startFrame;
+        uint64_t interval = range.interval;
+        if (first < startFrame) {
+            first += (startFrame - first + interval - 1) / interval * interval;
+        }
+        uint64_t last = endFrame;
+        if (range.count != screenshot::SCREEN_SHOT_FRAMES_UNLIMITED) {
+            last = std::min(last, range.startFrame + (uint64_t)range.count * interval);
+        }
+        if (first >= last) return frames;
+
+        // Written as <start>-<frame count>-<interval>, the frame count covers the last screenshot
+        uint64_t count = (last - first + interval - 1) / interval;
+        frames = std::to_string(first) + "-" + std::to_string((count - 1) * interval + 1) + "-" + std::to_string(interval);
+    } else {
+        std::string list(screenshotList);
+        size_t begin = 0;
+        while (begin < list.size()) {
+            size_t end = list.find(',', begin);
+            if (end == std::string::npos) end = list.size();
+            std::string item = list.substr(begin, end - begin);
+            uint64_t frame = strtoull(item.c_str(), NULL, 10);
+            if (!item.empty() && frame >= startFrame && frame < endFrame) {
+                if (!frames.empty()) frames += ",";
+                frames += item;
+            }
+            begin = end + 1;
+        }
+    }
+    return frames;
+}
+
+static bool spawn_segment(const std::vector<std::string> &args, Segment *pSegment) {
+    std::string exePath;
+    char *pExeDirectory = vktrace_platform_get_current_executable_directory();
+    if (pExeDirectory != NULL) {
+        std::string exeName(args[0]);
+        size_t separator = exeName.find_last_of("/\\");
+        exePath = std::string(pExeDirectory) + "/" + (separator == std::string::npos ? exeName : exeName.substr(separator + 1));
+        vktrace_free(pExeDirectory);
+    } else {
+        exePath = args[0];
+    }
+
+#if defined(WIN32)
+    std::string commandLine = "\"" + exePath + "\"";
+    for (size_t i = 1; i < args.size(); i++) {
+        commandLine += " \"" + args[i] + "\"";
+    }
+    STARTUPINFO si = {0};
+    si.cb = sizeof(si);
+    memset(&pSegment->process, 0, sizeof(pSegment->process));
+    if (!CreateProcess(NULL, &commandLine[0], NULL, NULL, TRUE, 0, NULL, NULL, &si, &pSegment->process)) {
+        vktrace_LogError("Failed to spawn '%s'.", exePath.c_str());
+        return false;
+    }
+#else
+    std::vector<char *> argv;
+    argv.push_back(const_cast<char *>(exePath.c_str()));
+    for (size_t i = 1; i < args.size(); i++) {
+        argv.push_back(const_cast<char *>(args[i].c_str()));
+    }
+    argv.push_back(NULL);
+    pSegment->process = fork();
+    if (pSegment->process == -1) {
+        vktrace_LogError("Failed to spawn '%s'.", exePath.c_str());
+        return false;
+    } else if (pSegment->process == 0) {
+        execv(exePath.c_str(), &argv[0]);
+        vktrace_LogError("Failed to spawn '%s'.", exePath.c_str());
+        _exit(1);
+    }
+#endif
+    return true;
+}
+
+// Waits for the segment's process and returns its exit code
+static int wait_for_segment(Segment *pSegment) {
+#if defined(WIN32)
+    DWORD exitCode = 1;
+    WaitForSingleObject(pSegment->process.hProcess, INFINITE);
+    GetExitCodeProcess(pSegment->process.hProcess, &exitCode);
+    CloseHandle(pSegment->process.hThread);
+    CloseHandle(pSegment->process.hProcess);
+    return (int)exitCode;
+#else
+    int status = 0;
+    while (waitpid(pSegment->process, &status, 0) == -1) {
+        if (errno != EINTR) return 1;
+    }
+    if (WIFEXITED(status)) return WEXITSTATUS(status);
+    vktrace_LogError("Segment process %d was terminated by signal %d.", pSegment->process,
+                     WIFSIGNALED(status) ? WTERMSIG(status) : 0);
+    return 1;
+#endif
+}
+
+// Appends the rows of a CSV file the segment wrote, which start with their frame, for the frames of
+// the segment to pOut, and removes the file. The header is only written once.
+static void merge_segment_rows(const Segment &segment, const std::string &filename, FILE *pOut, bool *pHeaderWritten) {
+    FILE *pIn = fopen(filename.c_str(), "r");
+    if (pIn == NULL) {
+        vktrace_LogError("Failed to open '%s' to read the rows of segment frames from.", filename.c_str());
+        return;
+    }
+
+    // Lines longer than the buffer are read in pieces, which go where their line's first piece went
+    char line[1024];
+    bool header = true;
+    bool lineStart = true;
+    bool keep = false;
+    while (fgets(line, sizeof(line), pIn) != NULL) {
+        if (lineStart) {
+            if (header) {
+                keep = !*pHeaderWritten;
+            } else {
+                // Rows start with the frame, those of the frames fast-forwarded through are left out
+                uint64_t frame = strtoull(line, NULL, 10);
+                keep = frame >= segment.startFrame && frame < segment.endFrame;
+            }
+        }
+        if (keep) fputs(line, pOut);
+        lineStart = strchr(line, '\n') != NULL;
+        if (lineStart && header) {
+            *pHeaderWritten = true;
+            header = false;
+        }
+    }
+    fclose(pIn);
+    remove(filename.c_str());
+}
+
+// Opens a file the rows the segments wrote are merged into, or returns NULL
+static FILE *open_merged_file(const char *filename) {
+    if (filename == NULL) return NULL;
+    FILE *pFile = fopen(filename, "w");
+    if (pFile == NULL) {
+        vktrace_LogError("Failed to open '%s' to write the rows of the segments to.", filename);
+    }
+    return pFile;
+}
+
+int replay_segments(int argc, char **argv, const vkreplayer_settings &settings, uint64_t frameCount) {
+    uint64_t segmentCount = std::min<uint64_t>(settings.segments, frameCount);
+    if (segmentCount < 2) {
+        vktrace_LogError("The trace has %" PRIu64 " frames, too few to replay in segments.", frameCount);
+        return -1;
+    }
+    if (settings.numLoops != 1 || settings.loopStartFrame != -1 || settings.loopEndFrame != -1) {
+        vktrace_LogWarning("NumLoops, LoopStartFrame and LoopEndFrame are ignored with Segments.");
+    }
+    if (settings.fastForwardFrame > 0) {
+        vktrace_LogWarning("FastForward is ignored with Segments.");
+    }
+
+    // The options every segment shares
+    std::vector<std::string> commonArgs;
+    commonArgs.push_back(argv[0]);
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!is_segment_option(argv[i])) {
+            commonArgs.push_back(argv[i]);
+            commonArgs.push_back(argv[i + 1]);
+        }
+    }
+
+    std::vector<Segment> segments(segmentCount);
+    int err = 0;
+    uint64_t startTime = vktrace_get_time();
+    for (uint64_t i = 0; i < segmentCount; i++) {
+        Segment &segment = segments[i];
+        segment.startFrame = frameCount * i / segmentCount;
+        segment.endFrame = frameCount * (i + 1) / segmentCount;
+        segment.running = false;
+
+        std::vector<std::string> args(commonArgs);
+        if (segment.startFrame > 0) {
+            args.push_back("-ff");
+            args.push_back(std::to_string(segment.startFrame));
+        }
+        if (segment.endFrame < frameCount) {
+            args.push_back("-lef");
+            args.push_back(std::to_string(segment.endFrame));
+        }
+        if (settings.screenshotList != NULL) {
+            std::string screenshots = segment_screenshots(settings.screenshotList, segment.startFrame, segment.endFrame);
+            if (!screenshots.empty()) {
+                args.push_back("-s");
+                args.push_back(screenshots);
+            }
+        }
+        if (settings.gpuTimestampsFile != NULL) {
+            segment.gpuTimestampsFile = std::string(settings.gpuTimestampsFile) + ".segment" + std::to_string(i);
+            args.push_back("-gt");
+            args.push_back(segment.gpuTimestampsFile);
+        }
+        if (settings.compareReport != NULL) {
+            segment.compareReportFile = std::string(settings.compareReport) + ".segment" + std::to_string(i);
+            args.push_back("-cr");
+            args.push_back(segment.compareReportFile);
+        }
+
+        vktrace_LogVerbose("Starting segment %" PRIu64 " for frames %" PRIu64 " to %" PRIu64 ".", i, segment.startFrame,
+                           segment.endFrame - 1);
+        segment.startTime = vktrace_get_time();
+        if (!spawn_segment(args, &segment)) {
+            err = -1;
+            break;
+        }
+        segment.running = true;
+    }
+
+    for (uint64_t i = 0; i < segmentCount; i++) {
+        Segment &segment = segments[i];
+        if (!segment.running) continue;
+        int exitCode = wait_for_segment(&segment);
+        segment.endTime = vktrace_get_time();
+        if (exitCode != 0) {
+            vktrace_LogError("Segment %" PRIu64 " for frames %" PRIu64 " to %" PRIu64 " failed with %d.", i, segment.startFrame,
+                             segment.endFrame - 1, exitCode);
+            err = -1;
+        }
+    }
+
+    // Segments that ran to the end are reported and merged, even if another one failed
+    FILE *pGpuTimestamps = open_merged_file(settings.gpuTimestampsFile);
+    FILE *pCompareReport = open_merged_file(settings.compareReport);
+    bool gpuTimestampsHeaderWritten = false;
+    bool compareReportHeaderWritten = false;
+    for (uint64_t i = 0; i < segmentCount; i++) {
+        const Segment &segment = segments[i];
+        if (!segment.running) continue;
+        vktrace_LogAlways("Segment %" PRIu64 ": frames %" PRIu64 " to %" PRIu64 " replayed in %.3f s.", i, segment.startFrame,
+                          segment.endFrame - 1, (segment.endTime - segment.startTime) / 1000000000.0);
+        if (pGpuTimestamps != NULL) {
+            merge_segment_rows(segment, segment.gpuTimestampsFile, pGpuTimestamps, &gpuTimestampsHeaderWritten);
+        }
+        if (pCompareReport != NULL) {
+            merge_segment_rows(segment, segment.compareReportFile, pCompareReport, &compareReportHeaderWritten);
+        }
+    }
+    if (pGpuTimestamps != NULL) {
+        fclose(pGpuTimestamps);
+    }
+    if (pCompareReport != NULL) {
+        fclose(pCompareReport);
+    }
+    vktrace_LogAlways("Replayed %" PRIu64 " frames in %" PRIu64 " segments in %.3f s.", frameCount, segmentCount,
+                      (vktrace_get_time() - startTime) / 1000000000.0);
+
+    return err;
+}
+
+} /* namespace vktrace_replay */
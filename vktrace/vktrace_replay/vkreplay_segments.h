@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "vktrace_common.h"
+#include "vkreplay_main.h"
+
+/* Replays the frames of a trace as consecutive segments at the same time, each in a vkreplay
+ * process of its own started with the command line of this one. A segment gets to its first
+ * frame with --FastForward and stops at the first frame of the next one with --LoopEndFrame, so
+ * the frames it replays with all their draws are the ones of its segment. Each segment only takes
+ * the screenshots of its own frames, the screenshot layer names them after the frame so they end
+ * up next to each other. The GPU timestamps of each segment go to a file of its own, and their
+ * rows for the frames of the segment are merged into the --GpuTimestamps file once all segments
+ * are done. */
+namespace vktrace_replay {
+
+// Returns 0 when every segment replayed successfully
+int replay_segments(int argc, char **argv, const vkreplayer_settings &settings, uint64_t frameCount);
+
+} /* namespace vktrace_replay */
@@ -18,25 +18,478 @@
  *
  * Author: Jon Ashburn <jon@lunarg.com>
  **************************************************************************/
+#include <inttypes.h>
+#include <string.h>
+#include <algorithm>
 #include "vkreplay_seq.h"
 
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined(WIN32)
+#include <io.h>
+#endif
+
 extern "C" {
+#include "vktrace_blob_store.h"
 #include "vktrace_trace_packet_utils.h"
 }
+#include "vkreplay_factory.h"
+#include "vkreplay_placement.h"
+
+// Upper bound on the bytes PrefetchSequencer keeps queued, so a trace with huge frames (like the
+// first one, where most resources get loaded) can't read the whole file into memory.
+static const size_t PREFETCH_MAX_QUEUED_BYTES = 256 * 1024 * 1024;
+
+// Upper bound on the bytes StreamSequencer reads ahead of replay, and the size of each read. Small
+// reads let replay start on packets as soon as they arrive.
+static const size_t STREAM_MAX_BUFFERED_BYTES = 256 * 1024 * 1024;
+static const size_t STREAM_CHUNK_SIZE = 64 * 1024;
+
+// MappedSequencer gives back the pages of replayed packets once they add up to this much, so a
+// madvise call covers many packets
+static const uint64_t MAPPED_RELEASE_BYTES = 16 * 1024 * 1024;
 
 namespace vktrace_replay {
 
+// Blob packets only go into the blob store, nothing past the sequencers gets to see them
+static vktrace_trace_packet_header *read_trace_packet(FileLike *pFile) {
+    vktrace_trace_packet_header *pHeader;
+    while ((pHeader = vktrace_read_trace_packet(pFile)) != NULL && pHeader->packet_id == VKTRACE_TPI_BLOB) {
+        vktrace_blob_store_add_packet(pHeader);
+        vktrace_free(pHeader);
+    }
+    return pHeader;
+}
+
+vktrace_trace_packet_header *AbstractSequencer::take_next_packet(bool &owned) {
+    vktrace_trace_packet_header *pHeader = get_next_packet();
+    owned = false;
+    if (pHeader == NULL) return NULL;
+
+    vktrace_trace_packet_header *pCopy = (vktrace_trace_packet_header *)vktrace_malloc((size_t)pHeader->size);
+    if (pCopy == NULL) return NULL;
+    memcpy(pCopy, pHeader, (size_t)pHeader->size);
+    pCopy->pBody = (uintptr_t)pCopy + sizeof(vktrace_trace_packet_header);
+    owned = true;
+    return pCopy;
+}
+
 vktrace_trace_packet_header *Sequencer::get_next_packet() {
     vktrace_free(m_lastPacket);
     if (!m_pFile) return (NULL);
-    m_lastPacket = vktrace_read_trace_packet(m_pFile);
+    m_lastPacket = read_trace_packet(m_pFile);
     return (m_lastPacket);
 }
 
 void Sequencer::get_bookmark(seqBookmark &bookmark) { bookmark.file_offset = m_bookmark.file_offset; }
 
-void Sequencer::set_bookmark(const seqBookmark &bookmark) { vktrace_FileLike_SetCurrentPosition(m_pFile, m_bookmark.file_offset); }
+void Sequencer::set_bookmark(const seqBookmark &bookmark) { vktrace_FileLike_SetCurrentPosition(m_pFile, (size_t)bookmark.file_offset); }
 
 void Sequencer::record_bookmark() { m_bookmark.file_offset = vktrace_FileLike_GetCurrentPosition(m_pFile); }
 
+vktrace_trace_packet_header *Sequencer::take_next_packet(bool &owned) {
+    owned = true;
+    if (!m_pFile) return (NULL);
+    return read_trace_packet(m_pFile);
+}
+
+bool MappedSequencer::open(FILE *pFile, uint64_t firstPacketOffset) {
+    m_pFile = pFile;
+    if (!map_file()) {
+        return false;
+    }
+    m_offset = firstPacketOffset;
+    return true;
+}
+
+bool MappedSequencer::map_file() {
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
+    struct stat fileStat;
+    int fd = fileno(m_pFile);
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+        return false;
+    }
+    // Private and writable: pages the replayer patches become private copies, the rest stay shared with the page cache
+    void *pBase = mmap(NULL, (size_t)fileStat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (pBase == MAP_FAILED) {
+        return false;
+    }
+    madvise(pBase, (size_t)fileStat.st_size, MADV_SEQUENTIAL);
+    m_pBase = (uint8_t *)pBase;
+    m_size = (uint64_t)fileStat.st_size;
+#elif defined(WIN32)
+    HANDLE hFile = (HANDLE)_get_osfhandle(_fileno(m_pFile));
+    LARGE_INTEGER fileSize;
+    if (hFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0) {
+        return false;
+    }
+    m_hMapping = CreateFileMapping(hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    if (m_hMapping == NULL) {
+        return false;
+    }
+    m_pBase = (uint8_t *)MapViewOfFile(m_hMapping, FILE_MAP_COPY, 0, 0, 0);
+    if (m_pBase == NULL) {
+        CloseHandle(m_hMapping);
+        m_hMapping = NULL;
+        return false;
+    }
+    m_size = (uint64_t)fileSize.QuadPart;
+#else
+    return false;
+#endif
+    lock_replay_memory(m_pBase, (size_t)m_size);
+    return true;
+}
+
+void MappedSequencer::unmap_file() {
+    if (m_pBase == NULL) return;
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
+    munmap(m_pBase, (size_t)m_size);
+#elif defined(WIN32)
+    UnmapViewOfFile(m_pBase);
+    CloseHandle(m_hMapping);
+    m_hMapping = NULL;
+#endif
+    m_pBase = NULL;
+    m_size = 0;
+    m_releasedOffset = 0;
+}
+
+void MappedSequencer::release_pages(uint64_t end) {
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
+    uint64_t pageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+    end -= end % pageSize;
+    if (end > m_releasedOffset) {
+        // Pages the replayer patched are thrown away, and read from the file again if they are needed
+        madvise(m_pBase + m_releasedOffset, (size_t)(end - m_releasedOffset), MADV_DONTNEED);
+        m_releasedOffset = end;
+    }
+#endif
+}
+
+vktrace_trace_packet_header *MappedSequencer::get_next_packet() {
+    // The caller is done with the last packet, recording threads and held back recordings replay copies
+    if (m_releaseReplayed && m_offset >= m_releasedOffset + MAPPED_RELEASE_BYTES) {
+        release_pages(m_offset);
+    }
+    return read_next_packet();
+}
+
+vktrace_trace_packet_header *MappedSequencer::read_next_packet() {
+    vktrace_trace_packet_header *pHeader;
+
+    do {
+        if (m_pBase == NULL || m_offset + sizeof(vktrace_trace_packet_header) > m_size) {
+            return NULL;
+        }
+        pHeader = (vktrace_trace_packet_header *)(m_pBase + m_offset);
+        if (pHeader->size < sizeof(vktrace_trace_packet_header) || m_offset + pHeader->size > m_size) {
+            vktrace_LogError("Trace packet at offset %" PRIu64 " runs past the end of the trace file.", m_offset);
+            return NULL;
+        }
+
+        m_offset += pHeader->size;
+        pHeader->pBody = (uintptr_t)pHeader + sizeof(vktrace_trace_packet_header);
+        if (pHeader->packet_id == VKTRACE_TPI_BLOB) {
+            // The store keeps a copy, the mapping goes away at the next set_bookmark
+            vktrace_blob_store_add_packet(pHeader);
+            pHeader = NULL;
+        }
+    } while (pHeader == NULL);
+    return pHeader;
+}
+
+void MappedSequencer::get_bookmark(seqBookmark &bookmark) { bookmark.file_offset = m_bookmark.file_offset; }
+
+void MappedSequencer::set_bookmark(const seqBookmark &bookmark) {
+    // Packets replayed since the bookmark have had their pointers patched in place. Mapping the file
+    // again throws those private pages away so the packets can be interpreted a second time.
+    unmap_file();
+    if (!map_file()) {
+        vktrace_LogError("Failed to map the trace file again, can't go back to the bookmark.");
+        return;
+    }
+    m_offset = bookmark.file_offset;
+}
+
+void MappedSequencer::record_bookmark() { m_bookmark.file_offset = m_offset; }
+
+vktrace_trace_packet_header *MappedSequencer::take_next_packet(bool &owned) {
+    // Packets live in the mapping until the next set_bookmark
+    owned = false;
+    return read_next_packet();
+}
+
+PrefetchSequencer::PrefetchSequencer(AbstractSequencer *pSource, vktrace_trace_packet_replay_library *replayerArray[],
+                                     unsigned int maxFrames)
+    : m_pSource(pSource),
+      m_pReplayerArray(replayerArray),
+      m_maxFrames(maxFrames > 0 ? maxFrames : 1),
+      m_queuedFrames(0),
+      m_queuedBytes(0),
+      m_sourceDone(false),
+      m_exit(false) {
+    m_current.pHeader = NULL;
+    m_current.pInterpreted = NULL;
+    m_current.owned = false;
+    m_bookmark.file_offset = 0;
+    m_endBookmark.file_offset = 0;
+    start();
+}
+
+void PrefetchSequencer::clean_up() {
+    stop();
+    release_packet(m_current);
+}
+
+void PrefetchSequencer::start() {
+    m_queuedFrames = 0;
+    m_queuedBytes = 0;
+    m_sourceDone = false;
+    m_exit = false;
+    m_thread = std::thread(&PrefetchSequencer::thread_func, this);
+}
+
+void PrefetchSequencer::stop() {
+    if (!m_thread.joinable()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_exit = true;
+    }
+    m_packetTaken.notify_all();
+    m_thread.join();
+
+    while (!m_queue.empty()) {
+        release_packet(m_queue.front());
+        m_queue.pop_front();
+    }
+}
+
+void PrefetchSequencer::release_packet(PrefetchedPacket &packet) {
+    if (packet.owned && packet.pHeader != NULL) {
+        vktrace_free(packet.pHeader);
+    }
+    packet.pHeader = NULL;
+    packet.pInterpreted = NULL;
+    packet.owned = false;
+}
+
+void PrefetchSequencer::thread_func() {
+    place_current_thread(THREAD_ROLE_IO);
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            // Always let at least one packet through so a packet bigger than the byte limit can't stall replay
+            m_packetTaken.wait(lock, [this] {
+                return m_exit || m_queue.empty() || (m_queuedFrames < m_maxFrames && m_queuedBytes < PREFETCH_MAX_QUEUED_BYTES);
+            });
+            if (m_exit) return;
+        }
+
+        PrefetchedPacket packet;
+        m_pSource->record_bookmark();
+        m_pSource->get_bookmark(packet.bookmark);
+        packet.pHeader = m_pSource->take_next_packet(packet.owned);
+        packet.pInterpreted = NULL;
+
+        if (packet.pHeader == NULL) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_endBookmark = packet.bookmark;
+            m_sourceDone = true;
+            m_packetQueued.notify_one();
+            return;
+        }
+
+        // Same checks main_loop makes before it hands a packet to a replayer
+        if (packet.pHeader->packet_id >= VKTRACE_TPI_VK_vkApiVersion && packet.pHeader->tracer_id < VKTRACE_MAX_TRACER_ID_ARRAY_SIZE &&
+            packet.pHeader->tracer_id != VKTRACE_TID_RESERVED) {
+            vktrace_trace_packet_replay_library *pReplayer = m_pReplayerArray[packet.pHeader->tracer_id];
+            if (pReplayer != NULL) {
+                packet.pInterpreted = pReplayer->Interpret(packet.pHeader);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (packet.pHeader->packet_id == VKTRACE_TPI_VK_vkQueuePresentKHR) {
+            m_queuedFrames++;
+        }
+        m_queuedBytes += (size_t)packet.pHeader->size;
+        m_queue.push_back(packet);
+        m_packetQueued.notify_one();
+    }
+}
+
+vktrace_trace_packet_header *PrefetchSequencer::get_next_packet() {
+    release_packet(m_current);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_packetQueued.wait(lock, [this] { return !m_queue.empty() || m_sourceDone; });
+    if (m_queue.empty()) return NULL;
+
+    m_current = m_queue.front();
+    m_queue.pop_front();
+    if (m_current.pHeader->packet_id == VKTRACE_TPI_VK_vkQueuePresentKHR) {
+        m_queuedFrames--;
+    }
+    m_queuedBytes -= (size_t)m_current.pHeader->size;
+    m_packetTaken.notify_one();
+    return m_current.pHeader;
+}
+
+bool PrefetchSequencer::get_interpreted_packet(vktrace_trace_packet_header **ppInterpreted) {
+    *ppInterpreted = m_current.pInterpreted;
+    return true;
+}
+
+void PrefetchSequencer::get_bookmark(seqBookmark &bookmark) { bookmark.file_offset = m_bookmark.file_offset; }
+
+void PrefetchSequencer::set_bookmark(const seqBookmark &bookmark) {
+    // The source has to be at rest while it moves, and everything read ahead of this point is stale
+    stop();
+    release_packet(m_current);
+    m_pSource->set_bookmark(bookmark);
+    start();
+}
+
+void PrefetchSequencer::record_bookmark() {
+    // The source is ahead of the replay thread, so the bookmark is where the next packet to be handed out was read from
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_packetQueued.wait(lock, [this] { return !m_queue.empty() || m_sourceDone; });
+    m_bookmark = m_queue.empty() ? m_endBookmark : m_queue.front().bookmark;
+}
+
+StreamSequencer::StreamSequencer(FILE *pStream, uint64_t offset)
+    : m_pStream(pStream),
+      m_lastPacket(NULL),
+      m_offset(offset),
+      m_chunkOffset(0),
+      m_bufferedBytes(0),
+      m_streamDone(false),
+      m_exit(false) {
+    m_bookmark.file_offset = offset;
+    m_thread = std::thread(&StreamSequencer::thread_func, this);
+}
+
+void StreamSequencer::clean_up() {
+    if (m_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_exit = true;
+        }
+        m_chunkTaken.notify_all();
+        // A read that is under way still has to return, when more of the stream arrives or it ends
+        m_thread.join();
+        m_chunks.clear();
+    }
+    vktrace_free(m_lastPacket);
+    m_lastPacket = NULL;
+}
+
+void StreamSequencer::thread_func() {
+    place_current_thread(THREAD_ROLE_IO);
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_chunkTaken.wait(lock, [this] { return m_exit || m_bufferedBytes < STREAM_MAX_BUFFERED_BYTES; });
+            if (m_exit) return;
+        }
+
+        std::vector<uint8_t> chunk(STREAM_CHUNK_SIZE);
+        size_t size = fread(&chunk[0], 1, chunk.size(), m_pStream);
+        chunk.resize(size);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (size > 0) {
+            m_bufferedBytes += size;
+            m_chunks.push_back(std::move(chunk));
+        }
+        if (size < STREAM_CHUNK_SIZE) {
+            if (ferror(m_pStream) != 0) {
+                vktrace_LogError("Failed to read the trace stream.");
+            }
+            m_streamDone = true;
+            m_chunkQueued.notify_one();
+            return;
+        }
+        m_chunkQueued.notify_one();
+    }
+}
+
+bool StreamSequencer::read(void *pBytes, size_t size) {
+    uint8_t *pDst = (uint8_t *)pBytes;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (size > 0) {
+        m_chunkQueued.wait(lock, [this] { return !m_chunks.empty() || m_streamDone; });
+        if (m_chunks.empty()) return false;
+
+        std::vector<uint8_t> &chunk = m_chunks.front();
+        size_t copySize = std::min(size, chunk.size() - m_chunkOffset);
+        memcpy(pDst, &chunk[m_chunkOffset], copySize);
+        pDst += copySize;
+        size -= copySize;
+        m_offset += copySize;
+        m_chunkOffset += copySize;
+        if (m_chunkOffset == chunk.size()) {
+            m_bufferedBytes -= chunk.size();
+            m_chunks.pop_front();
+            m_chunkOffset = 0;
+            m_chunkTaken.notify_one();
+        }
+    }
+    return true;
+}
+
+vktrace_trace_packet_header *StreamSequencer::read_packet() {
+    // Same as read_trace_packet, out of the buffer
+    for (;;) {
+        uint64_t size = 0;
+        if (!read(&size, sizeof(size))) return NULL;
+        if (size < sizeof(vktrace_trace_packet_header)) {
+            vktrace_LogError("Trace stream has a packet of %" PRIu64 " bytes at offset %" PRIu64 ".", size, m_offset - sizeof(size));
+            return NULL;
+        }
+
+        vktrace_trace_packet_header *pHeader = (vktrace_trace_packet_header *)vktrace_malloc((size_t)size);
+        if (pHeader == NULL) {
+            vktrace_LogError("Malloc failed in StreamSequencer of size %" PRIu64 ".", size);
+            return NULL;
+        }
+        pHeader->size = size;
+        if (!read((uint8_t *)pHeader + sizeof(size), (size_t)size - sizeof(size))) {
+            vktrace_LogError("Trace stream ended in the middle of a packet of %" PRIu64 " bytes.", size);
+            vktrace_free(pHeader);
+            return NULL;
+        }
+        pHeader->pBody = (uintptr_t)pHeader + sizeof(vktrace_trace_packet_header);
+
+        if (pHeader->packet_id != VKTRACE_TPI_BLOB) return pHeader;
+        vktrace_blob_store_add_packet(pHeader);
+        vktrace_free(pHeader);
+    }
+}
+
+vktrace_trace_packet_header *StreamSequencer::get_next_packet() {
+    vktrace_free(m_lastPacket);
+    m_lastPacket = read_packet();
+    return m_lastPacket;
+}
+
+vktrace_trace_packet_header *StreamSequencer::take_next_packet(bool &owned) {
+    owned = true;
+    return read_packet();
+}
+
+void StreamSequencer::get_bookmark(seqBookmark &bookmark) { bookmark.file_offset = m_bookmark.file_offset; }
+
+void StreamSequencer::set_bookmark(const seqBookmark &bookmark) {
+    if (bookmark.file_offset != m_offset) {
+        vktrace_LogError("Can't go back to offset %" PRIu64 " in a streamed trace.", bookmark.file_offset);
+    }
+}
+
+void StreamSequencer::record_bookmark() { m_bookmark.file_offset = m_offset; }
+
 } /* namespace vktrace_replay */
@@ -20,6 +20,12 @@
  **************************************************************************/
 #pragma once
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 extern "C" {
 #include "vktrace_filelike.h"
 #include "vktrace_trace_packet_identifiers.h"
@@ -30,8 +36,10 @@ extern "C" {
  * Requires low level file/stream reading/seeking support. */
 namespace vktrace_replay {
 
+struct vktrace_trace_packet_replay_library;
+
 struct seqBookmark {
-    unsigned int file_offset;
+    uint64_t file_offset;
 };
 
 // replay Sequencer interface
@@ -41,6 +49,16 @@ class AbstractSequencer {
     virtual vktrace_trace_packet_header *get_next_packet() = 0;
     virtual void get_bookmark(seqBookmark &bookmark) = 0;
     virtual void set_bookmark(const seqBookmark &bookmark) = 0;
+    virtual void record_bookmark() = 0;
+    virtual void clean_up() = 0;
+
+    // Like get_next_packet, but the packet stays valid after later calls. If owned is set the
+    // caller must vktrace_free it, otherwise it belongs to the sequencer.
+    virtual vktrace_trace_packet_header *take_next_packet(bool &owned);
+
+    // Sequencers that interpret packets themselves return true and the interpreted form of the
+    // packet last returned by get_next_packet.
+    virtual bool get_interpreted_packet(vktrace_trace_packet_header **ppInterpreted) { return false; }
 };
 
 class Sequencer : public AbstractSequencer {
@@ -59,6 +77,7 @@ class Sequencer : public AbstractSequencer {
     void get_bookmark(seqBookmark &bookmark);
     void set_bookmark(const seqBookmark &bookmark);
     void record_bookmark();
+    vktrace_trace_packet_header *take_next_packet(bool &owned);
 
    private:
     vktrace_trace_packet_header *m_lastPacket;
@@ -66,4 +85,138 @@ class Sequencer : public AbstractSequencer {
     FileLike *m_pFile;
 };
 
+// Sequencer that hands out packets straight from a private mapping of the trace file instead of
+// reading each one into its own allocation. The replayer patches pointers inside a packet when it
+// interprets it, which copies only the pages it writes to. Compressed trace files can't be mapped.
+// When asked to, the pages of packets get_next_packet is done with are given back, copied or not.
+class MappedSequencer : public AbstractSequencer {
+   public:
+    MappedSequencer() : m_pFile(NULL), m_pBase(NULL), m_size(0), m_offset(0), m_releaseReplayed(false), m_releasedOffset(0) {
+#if defined(WIN32)
+        m_hMapping = NULL;
+#endif
+        m_bookmark.file_offset = 0;
+    }
+    ~MappedSequencer() { this->clean_up(); }
+
+    void clean_up() { this->unmap_file(); }
+
+    // Map pFile and start at firstPacketOffset. Returns false if the file can't be mapped.
+    bool open(FILE *pFile, uint64_t firstPacketOffset);
+
+    // Whether get_next_packet gives back the pages of the packets before the one it returns
+    void set_release_replayed(bool release) { m_releaseReplayed = release; }
+
+    vktrace_trace_packet_header *get_next_packet();
+    void get_bookmark(seqBookmark &bookmark);
+    void set_bookmark(const seqBookmark &bookmark);
+    void record_bookmark();
+    vktrace_trace_packet_header *take_next_packet(bool &owned);
+
+   private:
+    bool map_file();
+    void unmap_file();
+    vktrace_trace_packet_header *read_next_packet();
+    void release_pages(uint64_t end);
+
+    FILE *m_pFile;
+    uint8_t *m_pBase;
+    uint64_t m_size;
+    uint64_t m_offset;
+    bool m_releaseReplayed;
+    uint64_t m_releasedOffset;  // pages before it were given back
+    seqBookmark m_bookmark;
+#if defined(WIN32)
+    HANDLE m_hMapping;
+#endif
+};
+
+// Sequencer that reads packets from another sequencer on a worker thread and interprets them there,
+// staying up to maxFrames presents ahead of the replay thread so replay doesn't wait on the trace
+// file between calls. Going back to a bookmark throws away whatever was read ahead.
+class PrefetchSequencer : public AbstractSequencer {
+   public:
+    PrefetchSequencer(AbstractSequencer *pSource, vktrace_trace_packet_replay_library *replayerArray[], unsigned int maxFrames);
+    ~PrefetchSequencer() { this->clean_up(); }
+
+    void clean_up();
+
+    vktrace_trace_packet_header *get_next_packet();
+    void get_bookmark(seqBookmark &bookmark);
+    void set_bookmark(const seqBookmark &bookmark);
+    void record_bookmark();
+    bool get_interpreted_packet(vktrace_trace_packet_header **ppInterpreted);
+
+   private:
+    struct PrefetchedPacket {
+        vktrace_trace_packet_header *pHeader;
+        vktrace_trace_packet_header *pInterpreted;
+        bool owned;
+        seqBookmark bookmark;  // where the source was before reading the packet
+    };
+
+    void start();
+    void stop();
+    void thread_func();
+    void release_packet(PrefetchedPacket &packet);
+
+    AbstractSequencer *m_pSource;
+    vktrace_trace_packet_replay_library **m_pReplayerArray;
+    unsigned int m_maxFrames;
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_packetQueued;
+    std::condition_variable m_packetTaken;
+    std::deque<PrefetchedPacket> m_queue;
+    unsigned int m_queuedFrames;
+    size_t m_queuedBytes;
+    bool m_sourceDone;
+    bool m_exit;
+    seqBookmark m_endBookmark;  // where the source was when it ran out of packets
+
+    PrefetchedPacket m_current;
+    seqBookmark m_bookmark;
+};
+
+// Sequencer that replays a trace while it is still arriving through a stream that can't seek,
+// like the standard input of vkreplay fed by a download or a socket. A thread reads up to
+// STREAM_MAX_BUFFERED_BYTES ahead of replay, so the sender only waits on replay once that much is
+// buffered. The stream can't be rewound, so replay can only go forward and bookmarks only say
+// how far it got.
+class StreamSequencer : public AbstractSequencer {
+   public:
+    // pStream is at offset in the trace, the start of the first packet
+    StreamSequencer(FILE *pStream, uint64_t offset);
+    ~StreamSequencer() { this->clean_up(); }
+
+    void clean_up();
+
+    vktrace_trace_packet_header *get_next_packet();
+    void get_bookmark(seqBookmark &bookmark);
+    void set_bookmark(const seqBookmark &bookmark);
+    void record_bookmark();
+    vktrace_trace_packet_header *take_next_packet(bool &owned);
+
+   private:
+    void thread_func();
+    bool read(void *pBytes, size_t size);
+    vktrace_trace_packet_header *read_packet();
+
+    FILE *m_pStream;
+    vktrace_trace_packet_header *m_lastPacket;
+    uint64_t m_offset;  // of the next byte taken out of the buffer
+    seqBookmark m_bookmark;
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_chunkQueued;
+    std::condition_variable m_chunkTaken;
+    std::deque<std::vector<uint8_t>> m_chunks;
+    size_t m_chunkOffset;  // bytes of the front chunk already taken
+    size_t m_bufferedBytes;
+    bool m_streamDone;
+    bool m_exit;
+};
+
 } /* namespace vktrace_replay */
@@ -26,7 +26,9 @@
 // declared as extern in header
 vkreplayer_settings g_vkReplaySettings;
 
-static vkreplayer_settings s_defaultVkReplaySettings = {NULL, 1, -1, -1, NULL, NULL, NULL};
+static vkreplayer_settings s_defaultVkReplaySettings = {NULL, 1, -1, -1, NULL, NULL, NULL, 0, 0, FALSE, FALSE, FALSE, 0, NULL, FALSE,
+                                                         0, FALSE, 0, 0, NULL, NULL, NULL, NULL, FALSE, FALSE, NULL, 0, 0,
+                                                         10, NULL};
 
 vktrace_SettingInfo g_vk_settings_info[] = {
     {"o",
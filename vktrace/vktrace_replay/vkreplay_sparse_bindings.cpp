@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <inttypes.h>
+#include <iterator>
+#include "vkreplay_sparse_bindings.h"
+#include "vktrace_platform.h"
+#include "vktrace_tracelog.h"
+
+namespace vktrace_replay {
+
+SparseBindings::~SparseBindings() {
+    if (m_binds > 0) {
+        vktrace_LogVerbose("Replayed %" PRIu64 " of %" PRIu64 " sparse binds.", m_replayedBinds, m_binds);
+    }
+}
+
+bool SparseBindings::continues(const Range &range, VkDeviceSize rangeStart, VkDeviceSize offset, VkDeviceMemory memory,
+                               VkDeviceSize memoryOffset) {
+    return range.memory == memory && (memory == VK_NULL_HANDLE || range.memoryOffset + (offset - rangeStart) == memoryOffset);
+}
+
+bool SparseBindings::is_bound(const Ranges &ranges, const VkSparseMemoryBind &bind) {
+    VkDeviceSize offset = bind.resourceOffset;
+    VkDeviceSize end = bind.resourceOffset + bind.size;
+    auto it = ranges.upper_bound(offset);
+    if (it == ranges.begin()) {
+        return false;
+    }
+    --it;
+    // Walk the ranges covering the bind, which have to leave no gap and continue its memory
+    while (it->second.end > offset &&
+           continues(it->second, it->first, offset, bind.memory, bind.memoryOffset + (offset - bind.resourceOffset))) {
+        if (it->second.end >= end) {
+            return true;
+        }
+        offset = it->second.end;
+        if (++it == ranges.end() || it->first != offset) {
+            return false;
+        }
+    }
+    return false;
+}
+
+void SparseBindings::erase(Ranges &ranges, VkDeviceSize offset, VkDeviceSize end) {
+    // Cut back a range that starts before offset and overlaps it, keeping any part of it past end
+    auto it = ranges.lower_bound(offset);
+    if (it != ranges.begin()) {
+        auto prev = std::prev(it);
+        if (prev->second.end > offset) {
+            Range cut = prev->second;
+            prev->second.end = offset;
+            if (cut.end > end) {
+                Range tail = {cut.end, cut.memory, cut.memoryOffset + (end - prev->first)};
+                ranges[end] = tail;
+            }
+        }
+    }
+    // Remove the ranges that start inside it, keeping any part of the last one past end
+    while (it != ranges.end() && it->first < end) {
+        Range cut = it->second;
+        VkDeviceSize start = it->first;
+        it = ranges.erase(it);
+        if (cut.end > end) {
+            Range tail = {cut.end, cut.memory, cut.memoryOffset + (end - start)};
+            ranges[end] = tail;
+            break;
+        }
+    }
+}
+
+void SparseBindings::bind(Ranges &ranges, const VkSparseMemoryBind &bind) {
+    VkDeviceSize offset = bind.resourceOffset;
+    VkDeviceSize end = bind.resourceOffset + bind.size;
+    erase(ranges, offset, end);
+
+    Range range = {end, bind.memory, bind.memoryOffset};
+    auto next = ranges.lower_bound(end);
+    if (next != ranges.end() && next->first == end &&
+        continues(range, offset, end, next->second.memory, next->second.memoryOffset)) {
+        range.end = next->second.end;
+        next = ranges.erase(next);
+    }
+    if (next != ranges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->second.end == offset && continues(prev->second, prev->first, offset, bind.memory, bind.memoryOffset)) {
+            prev->second.end = range.end;
+            return;
+        }
+    }
+    ranges[offset] = range;
+}
+
+uint32_t SparseBindings::update(uint64_t resource, VkSparseMemoryBind *pBinds, uint32_t bindCount) {
+    Ranges &ranges = m_resources[resource];
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < bindCount; i++) {
+        VkSparseMemoryBind bind = pBinds[i];
+        if (bind.flags != 0 || bind.size == 0) {
+            erase(ranges, bind.resourceOffset, bind.resourceOffset + bind.size);
+            pBinds[kept++] = bind;
+            continue;
+        }
+        if (is_bound(ranges, bind)) {
+            continue;
+        }
+        SparseBindings::bind(ranges, bind);
+        if (bind.memory != VK_NULL_HANDLE) {
+            m_memoryResources[bind.memory].insert(resource);
+        }
+        if (kept > 0) {
+            VkSparseMemoryBind &last = pBinds[kept - 1];
+            if (last.flags == 0 && last.memory == bind.memory && last.resourceOffset + last.size == bind.resourceOffset &&
+                (bind.memory == VK_NULL_HANDLE || last.memoryOffset + last.size == bind.memoryOffset)) {
+                last.size += bind.size;
+                continue;
+            }
+        }
+        pBinds[kept++] = bind;
+    }
+    m_binds += bindCount;
+    m_replayedBinds += kept;
+    return kept;
+}
+
+void SparseBindings::forget_resource(uint64_t resource) { m_resources.erase(resource); }
+
+void SparseBindings::forget_memory(VkDeviceMemory memory) {
+    auto memoryResources = m_memoryResources.find(memory);
+    if (memoryResources == m_memoryResources.end()) {
+        return;
+    }
+    for (auto resource : memoryResources->second) {
+        auto resourceRanges = m_resources.find(resource);
+        if (resourceRanges == m_resources.end()) {
+            continue;
+        }
+        Ranges &ranges = resourceRanges->second;
+        for (auto it = ranges.begin(); it != ranges.end();) {
+            it = (it->second.memory == memory) ? ranges.erase(it) : std::next(it);
+        }
+    }
+    m_memoryResources.erase(memoryResources);
+}
+
+} /* namespace vktrace_replay */
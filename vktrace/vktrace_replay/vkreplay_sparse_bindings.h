@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include "vulkan/vulkan.h"
+
+/* Keeps the opaque sparse bindings of buffers and images, as the trace made them, so that a batch of
+ * sparse binds can be cut down before it is replayed. Binds that leave a range bound as it already
+ * is, or unbound, are left out, and the binds left that continue each other are merged into one.
+ * Each resource's bindings are an interval map from the start of each range to its end and the
+ * memory bound to it, where adjacent ranges of the same memory are merged, so the state stays
+ * small however many pages are bound one at a time.
+ *
+ * A range is only known once the trace has bound or unbound it, and ranges of freed memory are
+ * forgotten, so binds made before the trace started and binds of reallocated memory are always
+ * replayed. Metadata binds are always replayed, and forget the ranges they cover. All handles are
+ * the trace ones. */
+namespace vktrace_replay {
+
+class SparseBindings {
+   public:
+    SparseBindings() : m_binds(0), m_replayedBinds(0) {}
+    ~SparseBindings();
+
+    // Cut down the trace's binds of resource, which are recorded as made, in place. Returns the
+    // number of binds left at the start of pBinds.
+    uint32_t update(uint64_t resource, VkSparseMemoryBind *pBinds, uint32_t bindCount);
+
+    void forget_resource(uint64_t resource);
+    void forget_memory(VkDeviceMemory memory);
+
+   private:
+    struct Range {
+        VkDeviceSize end;
+        VkDeviceMemory memory;  // VK_NULL_HANDLE where the trace unbound the range
+        VkDeviceSize memoryOffset;
+    };
+    typedef std::map<VkDeviceSize, Range> Ranges;
+
+    static bool continues(const Range &range, VkDeviceSize rangeStart, VkDeviceSize offset, VkDeviceMemory memory,
+                          VkDeviceSize memoryOffset);
+    static bool is_bound(const Ranges &ranges, const VkSparseMemoryBind &bind);
+    static void erase(Ranges &ranges, VkDeviceSize offset, VkDeviceSize end);
+    static void bind(Ranges &ranges, const VkSparseMemoryBind &bind);
+
+    std::unordered_map<uint64_t, Ranges> m_resources;
+    // Resources that had ranges bound to each memory object
+    std::unordered_map<VkDeviceMemory, std::unordered_set<uint64_t>> m_memoryResources;
+    uint64_t m_binds;
+    uint64_t m_replayedBinds;
+};
+
+} /* namespace vktrace_replay */
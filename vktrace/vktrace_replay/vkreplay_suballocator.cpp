@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <iterator>
+#include "vkreplay_suballocator.h"
+#include "vkreplay_vk_func_ptrs.h"
+#include "vktrace_platform.h"
+#include "vktrace_tracelog.h"
+
+namespace vktrace_replay {
+
+MemorySuballocator::~MemorySuballocator() {
+    // The devices of blocks left at exit may be gone already
+    for (auto it = m_blocks.begin(); it != m_blocks.end(); ++it) {
+        delete it->second;
+    }
+}
+
+void MemorySuballocator::add_device(VkPhysicalDevice physicalDevice, VkDevice device) {
+    Device &deviceInfo = m_devices[device];
+    m_vkFuncs.real_vkGetPhysicalDeviceMemoryProperties(physicalDevice, &deviceInfo.memoryProperties);
+    VkPhysicalDeviceProperties properties;
+    m_vkFuncs.real_vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    deviceInfo.nonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+    deviceInfo.alignment = std::max(deviceInfo.nonCoherentAtomSize, properties.limits.bufferImageGranularity);
+}
+
+void MemorySuballocator::add_requirements(VkDevice device, const VkMemoryRequirements &requirements) {
+    auto found = m_devices.find(device);
+    if (found != m_devices.end()) {
+        found->second.alignment = std::max(found->second.alignment, requirements.alignment);
+    }
+}
+
+void MemorySuballocator::destroy_device(VkDevice device) {
+    auto found = m_devices.find(device);
+    if (found == m_devices.end()) return;
+    while (!found->second.blocks.empty()) {
+        destroy_block(found->second.blocks.back());
+    }
+    m_devices.erase(found);
+}
+
+bool MemorySuballocator::allocate(VkDevice device, const VkMemoryAllocateInfo *pAllocateInfo, VkDeviceMemory *pMemory,
+                                  VkDeviceSize *pOffset) {
+    // Dedicated, exported and imported allocations have a pNext chain and stay on their own
+    auto found = m_devices.find(device);
+    if (found == m_devices.end() || pAllocateInfo->pNext != NULL || pAllocateInfo->allocationSize > m_blockSize / 4 ||
+        pAllocateInfo->memoryTypeIndex >= found->second.memoryProperties.memoryTypeCount) {
+        return false;
+    }
+    Device &deviceInfo = found->second;
+    uint32_t memoryTypeIndex = pAllocateInfo->memoryTypeIndex;
+    if (deviceInfo.memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) {
+        return false;
+    }
+
+    // Sizes are rounded up too, so the next suballocation in the block doesn't share a page with it
+    VkDeviceSize alignment = deviceInfo.alignment;
+    VkDeviceSize size = std::max<VkDeviceSize>((pAllocateInfo->allocationSize + alignment - 1) / alignment * alignment, alignment);
+    for (size_t i = 0; i < deviceInfo.blocks.size(); i++) {
+        Block *pBlock = deviceInfo.blocks[i];
+        if (pBlock->memoryTypeIndex == memoryTypeIndex && allocate_from(pBlock, size, alignment, pOffset)) {
+            *pMemory = pBlock->memory;
+            return true;
+        }
+    }
+
+    Block *pBlock = create_block(device, deviceInfo, memoryTypeIndex);
+    if (pBlock == NULL || !allocate_from(pBlock, size, alignment, pOffset)) {
+        return false;
+    }
+    *pMemory = pBlock->memory;
+    return true;
+}
+
+bool MemorySuballocator::allocate_from(Block *pBlock, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *pOffset) {
+    for (auto it = pBlock->freeRanges.begin(); it != pBlock->freeRanges.end(); ++it) {
+        VkDeviceSize rangeStart = it->first;
+        VkDeviceSize rangeEnd = it->first + it->second;
+        VkDeviceSize start = (rangeStart + alignment - 1) / alignment * alignment;
+        if (start + size > rangeEnd) continue;
+
+        pBlock->freeRanges.erase(it);
+        if (start > rangeStart) {
+            pBlock->freeRanges[rangeStart] = start - rangeStart;
+        }
+        if (start + size < rangeEnd) {
+            pBlock->freeRanges[start + size] = rangeEnd - start - size;
+        }
+        pBlock->allocations[start] = size;
+        *pOffset = start;
+        return true;
+    }
+    return false;
+}
+
+void MemorySuballocator::free(VkDeviceMemory memory, VkDeviceSize offset) {
+    auto found = m_blocks.find(memory);
+    if (found == m_blocks.end()) return;
+    Block *pBlock = found->second;
+    auto allocation = pBlock->allocations.find(offset);
+    if (allocation == pBlock->allocations.end()) return;
+
+    VkDeviceSize start = offset;
+    VkDeviceSize end = offset + allocation->second;
+    pBlock->allocations.erase(allocation);
+    if (pBlock->allocations.empty()) {
+        destroy_block(pBlock);
+        return;
+    }
+
+    // Merge with the free ranges on either side
+    auto next = pBlock->freeRanges.lower_bound(start);
+    if (next != pBlock->freeRanges.end() && next->first == end) {
+        end += next->second;
+        next = pBlock->freeRanges.erase(next);
+    }
+    if (next != pBlock->freeRanges.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == start) {
+            start = previous->first;
+            pBlock->freeRanges.erase(previous);
+        }
+    }
+    pBlock->freeRanges[start] = end - start;
+}
+
+void *MemorySuballocator::map(VkDeviceMemory memory, VkDeviceSize offset) {
+    auto found = m_blocks.find(memory);
+    if (found == m_blocks.end() || found->second->pData == NULL) return NULL;
+    return (uint8_t *)found->second->pData + offset;
+}
+
+void MemorySuballocator::translate_range(VkDeviceSize offset, VkDeviceSize size, VkMappedMemoryRange *pRange) {
+    auto found = m_blocks.find(pRange->memory);
+    if (found == m_blocks.end()) return;
+    VkDeviceSize atomSize = m_devices[found->second->device].nonCoherentAtomSize;
+
+    // The suballocation starts and ends at multiples of nonCoherentAtomSize, so the grown range
+    // stays inside of it
+    VkDeviceSize start = offset + pRange->offset;
+    VkDeviceSize end = offset + size;
+    if (pRange->size != VK_WHOLE_SIZE) {
+        end = std::min(end, start + pRange->size);
+    }
+    start = start / atomSize * atomSize;
+    end = (end + atomSize - 1) / atomSize * atomSize;
+    pRange->offset = start;
+    pRange->size = end - start;
+}
+
+MemorySuballocator::Block *MemorySuballocator::create_block(VkDevice device, Device &deviceInfo, uint32_t memoryTypeIndex) {
+    VkMemoryAllocateInfo allocateInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, m_blockSize, memoryTypeIndex};
+    VkDeviceMemory memory;
+    if (m_vkFuncs.real_vkAllocateMemory(device, &allocateInfo, NULL, &memory) != VK_SUCCESS) {
+        vktrace_LogWarning("Failed to allocate a block of memory type %u to suballocate from.", memoryTypeIndex);
+        return NULL;
+    }
+    void *pData = NULL;
+    if ((deviceInfo.memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+        m_vkFuncs.real_vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &pData) != VK_SUCCESS) {
+        vktrace_LogWarning("Failed to map a block of memory type %u to suballocate from.", memoryTypeIndex);
+        m_vkFuncs.real_vkFreeMemory(device, memory, NULL);
+        return NULL;
+    }
+
+    Block *pBlock = new Block();
+    pBlock->device = device;
+    pBlock->memoryTypeIndex = memoryTypeIndex;
+    pBlock->memory = memory;
+    pBlock->pData = pData;
+    pBlock->freeRanges[0] = m_blockSize;
+    deviceInfo.blocks.push_back(pBlock);
+    m_blocks[memory] = pBlock;
+    return pBlock;
+}
+
+void MemorySuballocator::destroy_block(Block *pBlock) {
+    m_vkFuncs.real_vkFreeMemory(pBlock->device, pBlock->memory, NULL);
+    std::vector<Block *> &blocks = m_devices[pBlock->device].blocks;
+    blocks.erase(std::find(blocks.begin(), blocks.end(), pBlock));
+    m_blocks.erase(pBlock->memory);
+    delete pBlock;
+}
+
+} /* namespace vktrace_replay */
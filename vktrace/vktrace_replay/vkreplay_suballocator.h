@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include "vulkan/vulkan.h"
+
+struct vkFuncs;
+
+/* Places the trace's small memory allocations in large VkDeviceMemory blocks of the same memory
+ * type, so replay makes far fewer driver allocations and stays under maxMemoryAllocationCount.
+ * A suballocation is a range of a block, and every offset the trace uses with the traced memory
+ * object has to be moved by the suballocation's offset in the block. The bound resource isn't
+ * known when memory is allocated, so every suballocation starts at the largest alignment any
+ * memory requirements of the device had so far, and at least at bufferImageGranularity and
+ * nonCoherentAtomSize. Host visible blocks stay mapped, since parts of a block may be mapped by
+ * the trace at the same time. All handles are the replay ones. */
+namespace vktrace_replay {
+
+class MemorySuballocator {
+   public:
+    MemorySuballocator(const vkFuncs &funcs, VkDeviceSize blockSize) : m_vkFuncs(funcs), m_blockSize(blockSize) {}
+    ~MemorySuballocator();
+
+    void add_device(VkPhysicalDevice physicalDevice, VkDevice device);
+    void add_requirements(VkDevice device, const VkMemoryRequirements &requirements);
+    // Blocks still allocated on the device are freed
+    void destroy_device(VkDevice device);
+
+    // Returns false if the allocation has to be made with vkAllocateMemory
+    bool allocate(VkDevice device, const VkMemoryAllocateInfo *pAllocateInfo, VkDeviceMemory *pMemory, VkDeviceSize *pOffset);
+    void free(VkDeviceMemory memory, VkDeviceSize offset);
+
+    // Pointer to the suballocation at offset in memory, NULL if the block isn't host visible
+    void *map(VkDeviceMemory memory, VkDeviceSize offset);
+    // Turns a range of the suballocation of size bytes at offset in pRange->memory into a range
+    // of the block, grown to nonCoherentAtomSize
+    void translate_range(VkDeviceSize offset, VkDeviceSize size, VkMappedMemoryRange *pRange);
+
+   private:
+    struct Block {
+        VkDevice device;
+        uint32_t memoryTypeIndex;
+        VkDeviceMemory memory;
+        void *pData;
+        std::map<VkDeviceSize, VkDeviceSize> freeRanges;   // size by offset
+        std::map<VkDeviceSize, VkDeviceSize> allocations;  // size by offset
+    };
+
+    struct Device {
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        VkDeviceSize nonCoherentAtomSize;
+        VkDeviceSize alignment;
+        std::vector<Block *> blocks;
+    };
+
+    bool allocate_from(Block *pBlock, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *pOffset);
+    Block *create_block(VkDevice device, Device &deviceInfo, uint32_t memoryTypeIndex);
+    void destroy_block(Block *pBlock);
+
+    const vkFuncs &m_vkFuncs;
+    VkDeviceSize m_blockSize;
+    std::unordered_map<VkDevice, Device> m_devices;
+    std::unordered_map<VkDeviceMemory, Block *> m_blocks;
+};
+
+} /* namespace vktrace_replay */
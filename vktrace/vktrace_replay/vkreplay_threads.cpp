@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "vkreplay_threads.h"
+#include "vkreplay_factory.h"
+#include "vkreplay_placement.h"
+#include "vktrace_vk_packet_id.h"
+#include "vktrace_tracelog.h"
+#include "vk_timeline.h"
+
+namespace vktrace_replay {
+
+// The body of every recording packet starts like this
+typedef struct {
+    vktrace_trace_packet_header *header;
+    VkCommandBuffer commandBuffer;
+} recording_packet_prefix;
+
+RecordingThreads::~RecordingThreads() {
+    sync();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_exit = true;
+    }
+    for (auto it = m_workers.begin(); it != m_workers.end(); ++it) {
+        it->second->packetQueued.notify_one();
+        it->second->thread.join();
+        delete it->second;
+    }
+}
+
+bool RecordingThreads::is_recording_packet(const vktrace_trace_packet_header *pPacket) {
+    if (pPacket->packet_id == VKTRACE_TPI_VK_vkBeginCommandBuffer || pPacket->packet_id == VKTRACE_TPI_VK_vkEndCommandBuffer ||
+        pPacket->packet_id == VKTRACE_TPI_CMD_BLOCK) {
+        return true;
+    }
+    const char *pName = vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)pPacket->packet_id);
+    return pName != NULL && strncmp(pName, "vkCmd", 5) == 0;
+}
+
+bool RecordingThreads::queue(vktrace_trace_packet_header *pPacket, vktrace_trace_packet_replay_library *pReplayer) {
+    if (!is_recording_packet(pPacket)) {
+        sync();
+        return false;
+    }
+
+    Worker *&pWorker = m_workers[pPacket->thread_id];
+    if (pWorker == NULL) {
+        pWorker = new Worker();
+        pWorker->thread = std::thread(&RecordingThreads::thread_func, this, pWorker);
+    }
+
+    // The application handed the command buffer over from another thread, which it could only do
+    // once that thread was done with it
+    VkCommandBuffer commandBuffer = ((recording_packet_prefix *)((uintptr_t)pPacket + sizeof(vktrace_trace_packet_header)))->commandBuffer;
+    Worker *&pRecorder = m_recorders[commandBuffer];
+    if (pRecorder != pWorker) {
+        if (pRecorder != NULL) {
+            sync();
+        }
+        pRecorder = pWorker;
+    }
+
+    // The sequencer reuses the packet's memory once the next one is read
+    vktrace_trace_packet_header *pCopy = (vktrace_trace_packet_header *)vktrace_malloc((size_t)pPacket->size);
+    if (pCopy == NULL) {
+        vktrace_LogError("Out of memory queueing packet %" PRIu64 " for replay.", pPacket->global_packet_index);
+        sync();
+        return false;
+    }
+    memcpy(pCopy, pPacket, (size_t)pPacket->size);
+    pCopy->pBody = (uintptr_t)pCopy + sizeof(vktrace_trace_packet_header);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        pWorker->queue.push_back(std::make_pair(pCopy, pReplayer));
+        m_pendingPackets++;
+    }
+    pWorker->packetQueued.notify_one();
+    return true;
+}
+
+void RecordingThreads::sync() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this] { return m_pendingPackets == 0; });
+}
+
+void RecordingThreads::thread_func(Worker *pWorker) {
+    place_current_thread(THREAD_ROLE_WORKER);
+    vk_timeline_thread_name("vkreplay recording");
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        pWorker->packetQueued.wait(lock, [this, pWorker] { return m_exit || !pWorker->queue.empty(); });
+        if (pWorker->queue.empty()) return;
+
+        vktrace_trace_packet_header *pPacket = pWorker->queue.front().first;
+        vktrace_trace_packet_replay_library *pReplayer = pWorker->queue.front().second;
+        pWorker->queue.pop_front();
+        lock.unlock();
+
+        {
+            VK_TIMELINE_ZONE("vkreplay", vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)pPacket->packet_id));
+            vktrace_trace_packet_header *pInterpreted = pReplayer->Interpret(pPacket);
+            if (pInterpreted == NULL || pReplayer->Replay(pInterpreted) != VKTRACE_REPLAY_SUCCESS) {
+                vktrace_LogError("Failed to replay packet_id %d, with global_packet_index %d.", pPacket->packet_id,
+                                 pPacket->global_packet_index);
+            }
+        }
+        vktrace_free(pPacket);
+
+        lock.lock();
+        if (--m_pendingPackets == 0) {
+            m_idle.notify_all();
+        }
+    }
+}
+
+} /* namespace vktrace_replay */
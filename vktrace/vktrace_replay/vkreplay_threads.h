@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "vulkan/vulkan.h"
+
+extern "C" {
+#include "vktrace_trace_packet_identifiers.h"
+}
+
+/* Replays command buffer recording on one worker thread per thread of the traced application.
+ * vkBeginCommandBuffer, vkEndCommandBuffer and vkCmd* packets are handed to the worker for the
+ * packet's thread_id, in order, and everything else is replayed on the calling thread once all
+ * the workers are idle. Recording calls only look up objects, so the object maps never change
+ * while workers use them, and submits, fences and object creation and destruction happen in the
+ * traced order relative to all the recording before them. */
+namespace vktrace_replay {
+
+struct vktrace_trace_packet_replay_library;
+
+class RecordingThreads {
+   public:
+    RecordingThreads() : m_pendingPackets(0), m_exit(false) {}
+    ~RecordingThreads();
+
+    // Queue a copy of the raw, not yet interpreted, pPacket on its worker and return true if it is
+    // a recording call. Otherwise wait for the workers and return false, and the caller replays it.
+    bool queue(vktrace_trace_packet_header *pPacket, vktrace_trace_packet_replay_library *pReplayer);
+
+    // Wait until every queued packet has been replayed.
+    void sync();
+
+   private:
+    struct Worker {
+        std::thread thread;
+        std::deque<std::pair<vktrace_trace_packet_header *, vktrace_trace_packet_replay_library *>> queue;
+        std::condition_variable packetQueued;
+    };
+
+    static bool is_recording_packet(const vktrace_trace_packet_header *pPacket);
+    void thread_func(Worker *pWorker);
+
+    std::unordered_map<uint32_t, Worker *> m_workers;
+    // Worker that last recorded into each traced command buffer
+    std::unordered_map<VkCommandBuffer, Worker *> m_recorders;
+
+    std::mutex m_mutex;
+    std::condition_variable m_idle;
+    size_t m_pendingPackets;
+    bool m_exit;
+};
+
+} /* namespace vktrace_replay */
@@ -0,0 +1,300 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <inttypes.h>
+#include <algorithm>
+#include "vkreplay_timestamps.h"
+#include "vkreplay_vk_func_ptrs.h"
+#include "vktrace_platform.h"
+#include "vktrace_tracelog.h"
+
+namespace vktrace_replay {
+
+// Queries a command buffer starts with, two per region. The pool doubles whenever a recording
+// has more regions than fit.
+static const uint32_t GPU_TIMESTAMPS_INITIAL_QUERIES = 64;
+
+static const char *region_name(GpuTimestampsRegion type) {
+    switch (type) {
+        case GPU_TIMESTAMPS_COMMAND_BUFFER:
+            return "command_buffer";
+        case GPU_TIMESTAMPS_RENDER_PASS:
+            return "render_pass";
+        case GPU_TIMESTAMPS_DEBUG_MARKER:
+            return "debug_marker";
+    }
+    return "";
+}
+
+GpuTimestamps::GpuTimestamps(const vkFuncs &funcs, FILE *pFile) : m_vkFuncs(funcs), m_pFile(pFile), m_regionCount(0) {
+    fprintf(m_pFile, "frame,global_packet_index,region,name,gpu_ms\n");
+}
+
+GpuTimestamps::~GpuTimestamps() {
+    // Keep the results of devices the trace never destroyed
+    while (!m_commandBuffers.empty()) {
+        release(m_commandBuffers.begin()->first);
+    }
+    fclose(m_pFile);
+    vktrace_LogVerbose("Wrote GPU times of %" PRIu64 " regions.", m_regionCount);
+}
+
+void GpuTimestamps::add_device(VkPhysicalDevice physicalDevice, VkDevice device) {
+    VkPhysicalDeviceProperties properties;
+    m_vkFuncs.real_vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    uint32_t count = 0;
+    m_vkFuncs.real_vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, NULL);
+    std::vector<VkQueueFamilyProperties> families(count);
+    m_vkFuncs.real_vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, families.data());
+
+    Device &info = m_devices[device];
+    info.timestampPeriod = properties.limits.timestampPeriod;
+    info.timestampValidBits.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        info.timestampValidBits.push_back(families[i].timestampValidBits);
+    }
+}
+
+void GpuTimestamps::add_command_pool(VkDevice device, VkCommandPool commandPool, uint32_t queueFamilyIndex) {
+    m_commandPools[commandPool] = std::make_pair(device, queueFamilyIndex);
+}
+
+void GpuTimestamps::add_command_buffers(const VkCommandBufferAllocateInfo *pAllocateInfo, const VkCommandBuffer *pCommandBuffers) {
+    // Secondary command buffers can't reset queries inside the render pass they continue
+    if (pAllocateInfo->level != VK_COMMAND_BUFFER_LEVEL_PRIMARY) return;
+    auto pool = m_commandPools.find(pAllocateInfo->commandPool);
+    if (pool == m_commandPools.end()) return;
+    auto device = m_devices.find(pool->second.first);
+    if (device == m_devices.end() || pool->second.second >= device->second.timestampValidBits.size()) return;
+    uint32_t validBits = device->second.timestampValidBits[pool->second.second];
+    if (validBits == 0) return;
+
+    for (uint32_t i = 0; i < pAllocateInfo->commandBufferCount; i++) {
+        release(pCommandBuffers[i]);
+        CommandBuffer *pCommandBuffer = new CommandBuffer();
+        pCommandBuffer->device = pool->second.first;
+        pCommandBuffer->commandPool = pAllocateInfo->commandPool;
+        pCommandBuffer->timestampPeriod = device->second.timestampPeriod;
+        pCommandBuffer->timestampMask = validBits >= 64 ? UINT64_MAX : (UINT64_C(1) << validBits) - 1;
+        pCommandBuffer->queryPool = VK_NULL_HANDLE;
+        pCommandBuffer->queryCount = 0;
+        pCommandBuffer->usedQueries = 0;
+        pCommandBuffer->full = false;
+        pCommandBuffer->timed = false;
+        pCommandBuffer->pendingFrame = -1;
+        m_commandBuffers[pCommandBuffers[i]] = pCommandBuffer;
+    }
+}
+
+GpuTimestamps::CommandBuffer *GpuTimestamps::find(VkCommandBuffer commandBuffer) {
+    auto found = m_commandBuffers.find(commandBuffer);
+    return found != m_commandBuffers.end() ? found->second : NULL;
+}
+
+void GpuTimestamps::begin_command_buffer(VkCommandBuffer commandBuffer, uint64_t packetIndex, VkCommandBufferUsageFlags flags) {
+    CommandBuffer *pCommandBuffer = find(commandBuffer);
+    if (pCommandBuffer == NULL) return;
+    if (pCommandBuffer->pendingFrame >= 0) {
+        read_results(pCommandBuffer, true);
+    }
+    pCommandBuffer->timed = false;
+    pCommandBuffer->regions.clear();
+    pCommandBuffer->openRegions.clear();
+    pCommandBuffer->usedQueries = 0;
+    // Executions that overlap would share the queries
+    if ((flags & VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT) != 0) return;
+
+    if (pCommandBuffer->queryPool == VK_NULL_HANDLE || pCommandBuffer->full) {
+        uint32_t queryCount = pCommandBuffer->queryPool == VK_NULL_HANDLE ? GPU_TIMESTAMPS_INITIAL_QUERIES
+                                                                           : pCommandBuffer->queryCount * 2;
+        if (pCommandBuffer->queryPool != VK_NULL_HANDLE) {
+            m_vkFuncs.real_vkDestroyQueryPool(pCommandBuffer->device, pCommandBuffer->queryPool, NULL);
+            pCommandBuffer->queryPool = VK_NULL_HANDLE;
+        }
+        VkQueryPoolCreateInfo createInfo = {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO, NULL, 0, VK_QUERY_TYPE_TIMESTAMP, queryCount,
+                                            0};
+        VkResult result = m_vkFuncs.real_vkCreateQueryPool(pCommandBuffer->device, &createInfo, NULL, &pCommandBuffer->queryPool);
+        if (result != VK_SUCCESS) {
+            vktrace_LogWarning("Failed to create a timestamp query pool, a command buffer won't be timed.");
+            pCommandBuffer->queryPool = VK_NULL_HANDLE;
+            return;
+        }
+        pCommandBuffer->queryCount = queryCount;
+        pCommandBuffer->full = false;
+    }
+
+    m_vkFuncs.real_vkCmdResetQueryPool(commandBuffer, pCommandBuffer->queryPool, 0, pCommandBuffer->queryCount);
+    pCommandBuffer->timed = true;
+    begin_region(commandBuffer, GPU_TIMESTAMPS_COMMAND_BUFFER, packetIndex, NULL);
+}
+
+void GpuTimestamps::end_command_buffer(VkCommandBuffer commandBuffer) {
+    CommandBuffer *pCommandBuffer = find(commandBuffer);
+    if (pCommandBuffer == NULL || !pCommandBuffer->timed) return;
+    // Debug marker regions the trace didn't end in this command buffer end with it
+    while (!pCommandBuffer->openRegions.empty()) {
+        end_region(commandBuffer, pCommandBuffer->regions[pCommandBuffer->openRegions.back()].type);
+    }
+}
+
+void GpuTimestamps::begin_region(VkCommandBuffer commandBuffer, GpuTimestampsRegion type, uint64_t packetIndex,
+                                 const char *pName) {
+    CommandBuffer *pCommandBuffer = find(commandBuffer);
+    if (pCommandBuffer == NULL || !pCommandBuffer->timed) return;
+
+    Region region = {type, packetIndex, pName != NULL ? pName : "", UINT32_MAX};
+    if (pCommandBuffer->usedQueries + 2 <= pCommandBuffer->queryCount) {
+        region.firstQuery = pCommandBuffer->usedQueries;
+        pCommandBuffer->usedQueries += 2;
+        m_vkFuncs.real_vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pCommandBuffer->queryPool,
+                                           region.firstQuery);
+    } else {
+        pCommandBuffer->full = true;
+    }
+    pCommandBuffer->openRegions.push_back(pCommandBuffer->regions.size());
+    pCommandBuffer->regions.push_back(region);
+}
+
+void GpuTimestamps::end_region(VkCommandBuffer commandBuffer, GpuTimestampsRegion type) {
+    CommandBuffer *pCommandBuffer = find(commandBuffer);
+    if (pCommandBuffer == NULL || !pCommandBuffer->timed) return;
+
+    std::vector<size_t> &open = pCommandBuffer->openRegions;
+    for (size_t i = open.size(); i > 0; i--) {
+        const Region &region = pCommandBuffer->regions[open[i - 1]];
+        if (region.type != type) continue;
+        if (region.firstQuery != UINT32_MAX) {
+            m_vkFuncs.real_vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pCommandBuffer->queryPool,
+                                               region.firstQuery + 1);
+        }
+        open.erase(open.begin() + (i - 1));
+        return;
+    }
+}
+
+void GpuTimestamps::begin_submit(uint32_t submitCount, const VkSubmitInfo *pSubmits) {
+    for (uint32_t s = 0; s < submitCount; s++) {
+        for (uint32_t i = 0; i < pSubmits[s].commandBufferCount; i++) {
+            CommandBuffer *pCommandBuffer = find(pSubmits[s].pCommandBuffers[i]);
+            // Without simultaneous use the earlier submission has finished
+            if (pCommandBuffer != NULL && pCommandBuffer->pendingFrame >= 0) {
+                read_results(pCommandBuffer, true);
+            }
+        }
+    }
+}
+
+void GpuTimestamps::end_submit(int frame, uint32_t submitCount, const VkSubmitInfo *pSubmits) {
+    for (uint32_t s = 0; s < submitCount; s++) {
+        for (uint32_t i = 0; i < pSubmits[s].commandBufferCount; i++) {
+            CommandBuffer *pCommandBuffer = find(pSubmits[s].pCommandBuffers[i]);
+            if (pCommandBuffer == NULL || !pCommandBuffer->timed) continue;
+            pCommandBuffer->pendingFrame = frame;
+            m_pending.push_back(pCommandBuffer);
+        }
+    }
+}
+
+void GpuTimestamps::end_frame() {
+    auto end = std::remove_if(m_pending.begin(), m_pending.end(), [this](CommandBuffer *pCommandBuffer) {
+        return pCommandBuffer->pendingFrame < 0 || read_results(pCommandBuffer, false);
+    });
+    m_pending.erase(end, m_pending.end());
+}
+
+void GpuTimestamps::add_capture_time(uint32_t frame, uint64_t beginPacketIndex, uint64_t gpuTime) {
+    std::lock_guard<std::mutex> lock(m_fileMutex);
+    fprintf(m_pFile, "%u,%" PRIu64 ",capture_command_buffer,\"\",%.6f\n", frame, beginPacketIndex, gpuTime / 1000000.0);
+}
+
+bool GpuTimestamps::read_results(CommandBuffer *pCommandBuffer, bool wait) {
+    std::vector<uint64_t> results(pCommandBuffer->usedQueries);
+    VkQueryResultFlags flags = VK_QUERY_RESULT_64_BIT | (wait ? VK_QUERY_RESULT_WAIT_BIT : 0);
+    VkResult result = m_vkFuncs.real_vkGetQueryPoolResults(pCommandBuffer->device, pCommandBuffer->queryPool, 0,
+                                                           pCommandBuffer->usedQueries, results.size() * sizeof(uint64_t),
+                                                           results.data(), sizeof(uint64_t), flags);
+    if (result == VK_NOT_READY) return false;
+
+    int frame = pCommandBuffer->pendingFrame;
+    pCommandBuffer->pendingFrame = -1;
+    if (result != VK_SUCCESS) {
+        vktrace_LogWarning("Failed to read GPU timestamps of frame %d.", frame);
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(m_fileMutex);
+    for (size_t i = 0; i < pCommandBuffer->regions.size(); i++) {
+        const Region &region = pCommandBuffer->regions[i];
+        if (region.firstQuery == UINT32_MAX) continue;
+        uint64_t ticks = (results[region.firstQuery + 1] - results[region.firstQuery]) & pCommandBuffer->timestampMask;
+        fprintf(m_pFile, "%d,%" PRIu64 ",%s,\"", frame, region.packetIndex, region_name(region.type));
+        for (size_t c = 0; c < region.name.size(); c++) {
+            if (region.name[c] == '"') fputc('"', m_pFile);
+            fputc(region.name[c], m_pFile);
+        }
+        fprintf(m_pFile, "\",%.6f\n", ticks * pCommandBuffer->timestampPeriod / 1000000.0);
+        m_regionCount++;
+    }
+    return true;
+}
+
+void GpuTimestamps::release(VkCommandBuffer commandBuffer) {
+    auto found = m_commandBuffers.find(commandBuffer);
+    if (found == m_commandBuffers.end()) return;
+    CommandBuffer *pCommandBuffer = found->second;
+    // The trace has waited for the command buffer before freeing it
+    if (pCommandBuffer->pendingFrame >= 0) {
+        read_results(pCommandBuffer, true);
+    }
+    if (pCommandBuffer->queryPool != VK_NULL_HANDLE) {
+        m_vkFuncs.real_vkDestroyQueryPool(pCommandBuffer->device, pCommandBuffer->queryPool, NULL);
+    }
+    m_pending.erase(std::remove(m_pending.begin(), m_pending.end(), pCommandBuffer), m_pending.end());
+    m_commandBuffers.erase(found);
+    delete pCommandBuffer;
+}
+
+void GpuTimestamps::free_command_buffers(uint32_t commandBufferCount, const VkCommandBuffer *pCommandBuffers) {
+    for (uint32_t i = 0; i < commandBufferCount; i++) {
+        release(pCommandBuffers[i]);
+    }
+}
+
+void GpuTimestamps::destroy_command_pool(VkCommandPool commandPool) {
+    std::vector<VkCommandBuffer> commandBuffers;
+    for (auto it = m_commandBuffers.begin(); it != m_commandBuffers.end(); ++it) {
+        if (it->second->commandPool == commandPool) commandBuffers.push_back(it->first);
+    }
+    free_command_buffers((uint32_t)commandBuffers.size(), commandBuffers.data());
+    m_commandPools.erase(commandPool);
+}
+
+void GpuTimestamps::destroy_device(VkDevice device) {
+    std::vector<VkCommandBuffer> commandBuffers;
+    for (auto it = m_commandBuffers.begin(); it != m_commandBuffers.end(); ++it) {
+        if (it->second->device == device) commandBuffers.push_back(it->first);
+    }
+    free_command_buffers((uint32_t)commandBuffers.size(), commandBuffers.data());
+    for (auto it = m_commandPools.begin(); it != m_commandPools.end();) {
+        if (it->second.first == device) {
+            it = m_commandPools.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_devices.erase(device);
+}
+
+} /* namespace vktrace_replay */
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2017 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "vulkan/vulkan.h"
+
+struct vkFuncs;
+
+/* Times the primary command buffers the trace records, and the render passes and debug marker
+ * regions in them, on the GPU. Every recording resets a query pool of the command buffer and
+ * writes a timestamp at the start and end of each region, and once a submission of the command
+ * buffer has executed one CSV line per region is written, keyed by the global_packet_index of the
+ * call that began the region. Results are read without waiting at each present, and otherwise
+ * before the command buffer is recorded, submitted again or freed, when the trace has already
+ * waited for it. All handles are the replay ones. Recording calls may come from the recording
+ * threads, everything else from the replay thread while they are idle. */
+namespace vktrace_replay {
+
+enum GpuTimestampsRegion {
+    GPU_TIMESTAMPS_COMMAND_BUFFER,
+    GPU_TIMESTAMPS_RENDER_PASS,
+    GPU_TIMESTAMPS_DEBUG_MARKER,
+};
+
+class GpuTimestamps {
+   public:
+    // Takes ownership of pFile
+    GpuTimestamps(const vkFuncs &funcs, FILE *pFile);
+    ~GpuTimestamps();
+
+    void add_device(VkPhysicalDevice physicalDevice, VkDevice device);
+    void add_command_pool(VkDevice device, VkCommandPool commandPool, uint32_t queueFamilyIndex);
+    void add_command_buffers(const VkCommandBufferAllocateInfo *pAllocateInfo, const VkCommandBuffer *pCommandBuffers);
+
+    // After the real vkBeginCommandBuffer
+    void begin_command_buffer(VkCommandBuffer commandBuffer, uint64_t packetIndex, VkCommandBufferUsageFlags flags);
+    // Before the real vkEndCommandBuffer
+    void end_command_buffer(VkCommandBuffer commandBuffer);
+    // Before the real call that begins the region, and after the one that ends it
+    void begin_region(VkCommandBuffer commandBuffer, GpuTimestampsRegion type, uint64_t packetIndex, const char *pName);
+    void end_region(VkCommandBuffer commandBuffer, GpuTimestampsRegion type);
+
+    // Before and after a successful real vkQueueSubmit, with the command buffers it submits
+    void begin_submit(uint32_t submitCount, const VkSubmitInfo *pSubmits);
+    void end_submit(int frame, uint32_t submitCount, const VkSubmitInfo *pSubmits);
+    // After the real vkQueuePresentKHR
+    void end_frame();
+
+    // GPU time in nanoseconds of a command buffer in the traced run, from a VKTRACE_TPI_GPU_TIMING packet
+    void add_capture_time(uint32_t frame, uint64_t beginPacketIndex, uint64_t gpuTime);
+
+    // Before the real destroy calls
+    void free_command_buffers(uint32_t commandBufferCount, const VkCommandBuffer *pCommandBuffers);
+    void destroy_command_pool(VkCommandPool commandPool);
+    void destroy_device(VkDevice device);
+
+   private:
+    struct Region {
+        GpuTimestampsRegion type;
+        uint64_t packetIndex;
+        std::string name;
+        uint32_t firstQuery;  // UINT32_MAX if the query pool was full
+    };
+
+    struct CommandBuffer {
+        VkDevice device;
+        VkCommandPool commandPool;
+        double timestampPeriod;
+        uint64_t timestampMask;
+        VkQueryPool queryPool;
+        uint32_t queryCount;
+        uint32_t usedQueries;
+        bool full;   // the last recording had more regions than fit
+        bool timed;  // the last recording writes timestamps
+        std::vector<Region> regions;
+        std::vector<size_t> openRegions;
+        int pendingFrame;  // frame of the submission that wasn't read yet, or -1
+    };
+
+    struct Device {
+        double timestampPeriod;
+        std::vector<uint32_t> timestampValidBits;  // by queue family
+    };
+
+    CommandBuffer *find(VkCommandBuffer commandBuffer);
+    bool read_results(CommandBuffer *pCommandBuffer, bool wait);
+    void release(VkCommandBuffer commandBuffer);
+
+    const vkFuncs &m_vkFuncs;
+    std::unordered_map<VkDevice, Device> m_devices;
+    std::unordered_map<VkCommandPool, std::pair<VkDevice, uint32_t>> m_commandPools;
+    // Only changed from the replay thread
+    std::unordered_map<VkCommandBuffer, CommandBuffer *> m_commandBuffers;
+    std::vector<CommandBuffer *> m_pending;
+
+    std::mutex m_fileMutex;
+    FILE *m_pFile;
+    uint64_t m_regionCount;
+};
+
+} /* namespace vktrace_replay */
@@ -161,6 +161,11 @@ int vkDisplay::init(const unsigned int gpu_idx) {
         m_initedVK = true;
     }
 #endif
+    if (m_headless) {
+        set_pause_status(false);
+        set_quit_status(false);
+        return 0;
+    }
 #if defined(PLATFORM_LINUX) && !defined(ANDROID)
 #if defined VKREPLAY_USE_WSI_XCB
     const xcb_setup_t *setup;
@@ -240,6 +245,11 @@ int vkDisplay::set_window(vktrace_window_handle hWindow, unsigned int width, uns
 }
 
 int vkDisplay::create_window(const unsigned int width, const unsigned int height) {
+    if (m_headless) {
+        m_windowWidth = width;
+        m_windowHeight = height;
+        return 0;
+    }
 #if defined(PLATFORM_LINUX)
 #if defined(ANDROID)
 #else
@@ -333,6 +343,7 @@ int vkDisplay::create_window(const unsigned int width, const unsigned int height
 }
 
 void vkDisplay::resize_window(const unsigned int width, const unsigned int height) {
+    if (m_headless) return;
     if (width != m_windowWidth || height != m_windowHeight) {
         m_windowWidth = width;
         m_windowHeight = height;
@@ -369,6 +380,7 @@ void vkDisplay::resize_window(const unsigned int width, const unsigned int heigh
 }
 
 void vkDisplay::process_event() {
+    if (m_headless) return;
 #if defined(PLATFORM_LINUX)
 #if defined(ANDROID)
 // TODO
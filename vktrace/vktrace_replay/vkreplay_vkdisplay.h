@@ -46,6 +46,8 @@ class vkDisplay : public vktrace_replay::ReplayDisplayImp {
     void set_pause_status(bool pause) { m_pause = pause; }
     bool get_quit_status() { return m_quit; }
     void set_quit_status(bool quit) { m_quit = quit; }
+    // Without a window nothing connects to the display server
+    void set_headless(bool headless) { m_headless = headless; }
     VkSurfaceKHR get_surface() { return (VkSurfaceKHR)&m_surface; };
 // VK_DEVICE get_device() { return m_dev[m_gpuIdx];}
 #if defined(PLATFORM_LINUX)
@@ -145,4 +147,5 @@ class vkDisplay : public vktrace_replay::ReplayDisplayImp {
     std::vector<char*> m_extensions;
     bool m_pause = false;
     bool m_quit = false;
+    bool m_headless = false;
 };
\ No newline at end of file
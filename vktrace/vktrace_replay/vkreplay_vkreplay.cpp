@@ -30,12 +30,18 @@
 #include "vkreplay_settings.h"
 #include "vkreplay_main.h"
 
+#include <inttypes.h>
 #include <algorithm>
 
 #include "vktrace_vk_vk_packets.h"
 #include "vk_enum_string_helper.h"
 #include "vktrace_vk_packet_id.h"
 #include "vktrace_trace_packet_utils.h"
+#include "vktrace_blob_store.h"
+#include "vktrace_gpu_timing.h"
+#include "vktrace_query_digest.h"
+#include "vkreplay_arena.h"
+#include "vk_safe_struct.cpp"
 
 using namespace std;
 #include "vktrace_pageguard_memorycopy.h"
@@ -54,12 +60,64 @@ vkReplay::vkReplay(vkreplayer_settings *pReplaySettings, vktrace_trace_file_head
     m_pFileHeader = pFileHeader;
     m_pGpuinfo = (struct_gpuinfo *)(pFileHeader + 1);
     m_platformMatch = -1;
+    m_portabilityPlanBuilt = false;
+    m_pPipelineThreads =
+        pReplaySettings->pipelineThreads > 0 ? new vktrace_replay::PipelineThreads(pReplaySettings->pipelineThreads) : NULL;
+    m_pHeadlessSwapchains = pReplaySettings->headless ? new vktrace_replay::HeadlessSwapchains(m_vkFuncs) : NULL;
+    m_display->set_headless(pReplaySettings->headless == TRUE);
+    m_pMemorySuballocator = pReplaySettings->suballocationBlockSize > 0
+                                ? new vktrace_replay::MemorySuballocator(
+                                      m_vkFuncs, (VkDeviceSize)pReplaySettings->suballocationBlockSize * 1024 * 1024)
+                                : NULL;
+    m_collapsePolling = pReplaySettings->collapsePolling == TRUE;
+    m_skippedPolls = 0;
+    m_pGpuTimestamps = NULL;
+    if (pReplaySettings->gpuTimestampsFile != NULL) {
+        FILE *pFile = fopen(pReplaySettings->gpuTimestampsFile, "w");
+        if (pFile != NULL) {
+            m_pGpuTimestamps = new vktrace_replay::GpuTimestamps(m_vkFuncs, pFile);
+        } else {
+            vktrace_LogError("Failed to open '%s' to write GPU timestamps to.", pReplaySettings->gpuTimestampsFile);
+        }
+    }
+    m_pAnnotations = pReplaySettings->annotate ? new vktrace_replay::ReplayAnnotations(m_vkFuncs) : NULL;
+    m_pFastForward = pReplaySettings->fastForwardFrame > 0 ? new vktrace_replay::FastForward(pReplaySettings->fastForwardFrame) : NULL;
+    m_pLifetimes = NULL;
+    m_forgottenObjects = 0;
+
+#if defined(USE_PAGEGUARD_SPEEDUP) && !defined(PAGEGUARD_MEMCPY_USE_PPL_LIB)
+    // Large memory uploads are split across threads
+    vktrace_pageguard_init_multi_threads_memcpy();
+#endif
 }
 
 std::vector<size_t> portabilityTable;
 FileLike *traceFile;
 
 vkReplay::~vkReplay() {
+    finish_pipeline_creation();
+    if (m_skippedPolls > 0) {
+        vktrace_LogVerbose("Skipped %" PRIu64 " polling calls that the trace made before the fence, event or query was ready.",
+                           m_skippedPolls);
+    }
+    delete m_pPipelineThreads;
+    delete m_pGpuTimestamps;
+    delete m_pAnnotations;
+    delete m_pFastForward;
+    if (m_pLifetimes != NULL) {
+        vktrace_LogVerbose("Forgot %" PRIu64 " of %" PRIu64 " objects after their last use.", m_forgottenObjects,
+                           (uint64_t)m_pLifetimes->released_count());
+        delete m_pLifetimes;
+    }
+    delete m_pHeadlessSwapchains;
+    delete m_pMemorySuballocator;
+    // Keep what the trace compiled even if it never destroyed its devices
+    while (!replayPipelineCaches.empty()) {
+        save_pipeline_cache(replayPipelineCaches.begin()->first);
+    }
+#if defined(USE_PAGEGUARD_SPEEDUP) && !defined(PAGEGUARD_MEMCPY_USE_PPL_LIB)
+    vktrace_pageguard_done_multi_threads_memcpy();
+#endif
     delete m_display;
     vktrace_platform_close_library(m_vkFuncs.m_libHandle);
 }
@@ -109,6 +167,14 @@ int vkReplay::init(vktrace_replay::ReplayDisplay &disp) {
         return -1;
     }
 
+    // Held back recording calls may be replayed after a later call, once they differ from the last recording
+    if (g_pReplaySettings->releaseUnused && !g_pReplaySettings->skipRerecording && traceFile != NULL) {
+        m_pLifetimes = new vktrace_replay::TraceLifetimes();
+        if (!m_pLifetimes->analyze(traceFile)) {
+            return -1;
+        }
+    }
+
     return 0;
 }
 
@@ -167,12 +233,16 @@ int vkReplay::dump_validation_data() {
 VkResult vkReplay::manually_replay_vkCreateInstance(packet_vkCreateInstance *pPacket) {
     VkResult replayResult = VK_ERROR_VALIDATION_FAILED_EXT;
     VkInstanceCreateInfo *pCreateInfo;
-    char **ppEnabledLayerNames = NULL, **saved_ppLayers;
     if (!m_display->m_initedVK) {
         VkInstance inst;
 
         const char strScreenShot[] = "VK_LAYER_LUNARG_screenshot";
+        const char strValidation[] = "VK_LAYER_LUNARG_standard_validation";
         pCreateInfo = (VkInstanceCreateInfo *)pPacket->pCreateInfo;
+        char **saved_ppLayers = (char **)pCreateInfo->ppEnabledLayerNames;
+        uint32_t savedLayerCount = pCreateInfo->enabledLayerCount;
+        vector<const char *> layer_names(pCreateInfo->ppEnabledLayerNames,
+                                         pCreateInfo->ppEnabledLayerNames + pCreateInfo->enabledLayerCount);
         if (g_pReplaySettings->screenshotList != NULL) {
             // enable screenshot layer if it is available and not already in list
             bool found_ss = false;
@@ -197,18 +267,26 @@ VkResult vkReplay::manually_replay_vkCreateInstance(packet_vkCreateInstance *pPa
                 }
                 if (found_ss) {
                     // screenshot layer is available so enable it
-                    ppEnabledLayerNames = (char **)vktrace_malloc((pCreateInfo->enabledLayerCount + 1) * sizeof(char *));
-                    for (uint32_t i = 0; i < pCreateInfo->enabledLayerCount && ppEnabledLayerNames; i++) {
-                        ppEnabledLayerNames[i] = (char *)pCreateInfo->ppEnabledLayerNames[i];
-                    }
-                    ppEnabledLayerNames[pCreateInfo->enabledLayerCount] = (char *)vktrace_malloc(strlen(strScreenShot) + 1);
-                    strcpy(ppEnabledLayerNames[pCreateInfo->enabledLayerCount++], strScreenShot);
-                    saved_ppLayers = (char **)pCreateInfo->ppEnabledLayerNames;
-                    pCreateInfo->ppEnabledLayerNames = ppEnabledLayerNames;
+                    layer_names.push_back(strScreenShot);
                 }
                 vktrace_free(props);
             }
         }
+        if (g_pReplaySettings->validateOnly != NULL) {
+            // The calls are only replayed for the validation layers to check them
+            bool found_validation = false;
+            for (uint32_t i = 0; i < pCreateInfo->enabledLayerCount; i++) {
+                if (!strcmp(pCreateInfo->ppEnabledLayerNames[i], strValidation)) {
+                    found_validation = true;
+                    break;
+                }
+            }
+            if (!found_validation) {
+                layer_names.push_back(strValidation);
+            }
+        }
+        pCreateInfo->ppEnabledLayerNames = layer_names.data();
+        pCreateInfo->enabledLayerCount = (uint32_t)layer_names.size();
 
         char **saved_ppExtensions = (char **)pCreateInfo->ppEnabledExtensionNames;
         int savedExtensionCount = pCreateInfo->enabledExtensionCount;
@@ -248,20 +326,23 @@ VkResult vkReplay::manually_replay_vkCreateInstance(packet_vkCreateInstance *pPa
                 extension_names.push_back(pCreateInfo->ppEnabledExtensionNames[i]);
             }
         }
+        // The validation layers report their errors to the callback registered once the instance is created
+        if (g_pReplaySettings->validateOnly != NULL &&
+            find_if(extension_names.begin(), extension_names.end(), [](const char *pName) {
+                return strcmp(pName, VK_EXT_DEBUG_REPORT_EXTENSION_NAME) == 0;
+            }) == extension_names.end()) {
+            extension_names.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+        }
         pCreateInfo->ppEnabledExtensionNames = extension_names.data();
         pCreateInfo->enabledExtensionCount = (uint32_t)extension_names.size();
 
         replayResult = m_vkFuncs.real_vkCreateInstance(pPacket->pCreateInfo, NULL, &inst);
 
+        // restore the packets CreateInfo struct
         pCreateInfo->ppEnabledExtensionNames = saved_ppExtensions;
         pCreateInfo->enabledExtensionCount = savedExtensionCount;
-
-        if (ppEnabledLayerNames) {
-            // restore the packets CreateInfo struct
-            vktrace_free(ppEnabledLayerNames[pCreateInfo->enabledLayerCount - 1]);
-            vktrace_free(ppEnabledLayerNames);
-            pCreateInfo->ppEnabledLayerNames = saved_ppLayers;
-        }
+        pCreateInfo->ppEnabledLayerNames = saved_ppLayers;
+        pCreateInfo->enabledLayerCount = savedLayerCount;
 
         if (replayResult == VK_SUCCESS) {
             m_objMapper.add_to_instances_map(*(pPacket->pInstance), inst);
@@ -417,7 +498,23 @@ VkResult vkReplay::manually_replay_vkCreateDevice(packet_vkCreateDevice *pPacket
             }
         }
 
+        // Annotate adds VK_EXT_debug_marker
+        std::vector<const char *> extensions;
+        uint32_t savedExtensionCount = pCreateInfo->enabledExtensionCount;
+        const char *const *savedExtensions = pCreateInfo->ppEnabledExtensionNames;
+        if (m_pAnnotations != NULL && m_pAnnotations->adds_extension(remappedPhysicalDevice, pCreateInfo)) {
+            extensions.assign(savedExtensions, savedExtensions + savedExtensionCount);
+            extensions.push_back(VK_EXT_DEBUG_MARKER_EXTENSION_NAME);
+            pCreateInfo->enabledExtensionCount = (uint32_t)extensions.size();
+            pCreateInfo->ppEnabledExtensionNames = extensions.data();
+        }
+
         replayResult = m_vkFuncs.real_vkCreateDevice(remappedPhysicalDevice, pPacket->pCreateInfo, NULL, &device);
+        if (m_pAnnotations != NULL && replayResult == VK_SUCCESS) {
+            m_pAnnotations->add_device(device, pCreateInfo);
+        }
+        pCreateInfo->enabledExtensionCount = savedExtensionCount;
+        pCreateInfo->ppEnabledExtensionNames = savedExtensions;
         if (ppEnabledLayerNames) {
             // restore the packets CreateInfo struct
             vktrace_free(ppEnabledLayerNames[pCreateInfo->enabledLayerCount - 1]);
@@ -428,6 +525,18 @@ VkResult vkReplay::manually_replay_vkCreateDevice(packet_vkCreateDevice *pPacket
             m_objMapper.add_to_devices_map(*(pPacket->pDevice), device);
             tracePhysicalDevices[*(pPacket->pDevice)] = pPacket->physicalDevice;
             replayPhysicalDevices[device] = remappedPhysicalDevice;
+            if (pPacket->pCreateInfo->queueCreateInfoCount > 0) {
+                replayDeviceQueueFamily[device] = pPacket->pCreateInfo->pQueueCreateInfos[0].queueFamilyIndex;
+            }
+            if (g_pReplaySettings->pipelineCache) {
+                create_pipeline_cache(device, remappedPhysicalDevice);
+            }
+            if (m_pGpuTimestamps != NULL) {
+                m_pGpuTimestamps->add_device(remappedPhysicalDevice, device);
+            }
+            if (m_pMemorySuballocator != NULL) {
+                m_pMemorySuballocator->add_device(remappedPhysicalDevice, device);
+            }
         }
         m_vkFuncs.real_vkCreateDescriptorUpdateTemplateKHR =
             (vkFuncs::type_vkCreateDescriptorUpdateTemplateKHR)m_vkFuncs.real_vkGetDeviceProcAddr(
@@ -536,6 +645,9 @@ VkResult vkReplay::manually_replay_vkCreateImage(packet_vkCreateImage *pPacket)
         traceImageToDevice[*pPacket->pImage] = pPacket->device;
         replayImageToDevice[local_imageObj.replayImage] = remappedDevice;
         m_objMapper.add_to_images_map(*(pPacket->pImage), local_imageObj);
+        if (m_pFastForward != NULL) {
+            m_pFastForward->add_image(local_imageObj.replayImage, pPacket->pCreateInfo->usage);
+        }
     }
     return replayResult;
 }
@@ -559,12 +671,19 @@ VkResult vkReplay::manually_replay_vkCreateCommandPool(packet_vkCreateCommandPoo
             vktrace_LogError("vkCreateCommandPool failed, bad queueFamilyIndex");
             return VK_ERROR_VALIDATION_FAILED_EXT;
         }
+        // Resets are skipped, beginning a command buffer again has to reset it
+        if (g_pReplaySettings->skipRerecording) {
+            *((VkCommandPoolCreateFlags *)&pPacket->pCreateInfo->flags) |= VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        }
     }
 
     replayResult =
         m_vkFuncs.real_vkCreateCommandPool(remappeddevice, pPacket->pCreateInfo, pPacket->pAllocator, &local_pCommandPool);
     if (replayResult == VK_SUCCESS) {
         m_objMapper.add_to_commandpools_map(*(pPacket->pCommandPool), local_pCommandPool);
+        if (m_pGpuTimestamps != NULL) {
+            m_pGpuTimestamps->add_command_pool(remappeddevice, local_pCommandPool, pPacket->pCreateInfo->queueFamilyIndex);
+        }
     }
     return replayResult;
 }
@@ -616,6 +735,7 @@ void vkReplay::manually_replay_vkDestroyBuffer(packet_vkDestroyBuffer *pPacket)
     }
     m_vkFuncs.real_vkDestroyBuffer(remappedDevice, remappedBuffer, pPacket->pAllocator);
     m_objMapper.rm_from_buffers_map(pPacket->buffer);
+    m_sparseBindings.forget_resource((uint64_t)(pPacket->buffer));
     if (replayGetBufferMemoryRequirements.find(remappedBuffer) != replayGetBufferMemoryRequirements.end())
         replayGetBufferMemoryRequirements.erase(remappedBuffer);
     return;
@@ -634,6 +754,7 @@ void vkReplay::manually_replay_vkDestroyImage(packet_vkDestroyImage *pPacket) {
     }
     m_vkFuncs.real_vkDestroyImage(remappedDevice, remappedImage, pPacket->pAllocator);
     m_objMapper.rm_from_images_map(pPacket->image);
+    m_sparseBindings.forget_resource((uint64_t)(pPacket->image));
     if (replayGetImageMemoryRequirements.find(remappedImage) != replayGetImageMemoryRequirements.end())
         replayGetImageMemoryRequirements.erase(remappedImage);
     return;
@@ -655,7 +776,7 @@ VkResult vkReplay::manually_replay_vkQueueSubmit(packet_vkQueueSubmit *pPacket)
     }
 
     VkSubmitInfo *remappedSubmits = NULL;
-    remappedSubmits = VKTRACE_NEW_ARRAY(VkSubmitInfo, pPacket->submitCount);
+    remappedSubmits = VKTRACE_REPLAY_NEW_ARRAY(VkSubmitInfo, pPacket->submitCount);
     VkCommandBuffer *pRemappedBuffers = NULL;
     VkSemaphore *pRemappedWaitSems = NULL, *pRemappedSignalSems = NULL;
     for (uint32_t submit_idx = 0; submit_idx < pPacket->submitCount; submit_idx++) {
@@ -668,62 +789,98 @@ VkResult vkReplay::manually_replay_vkQueueSubmit(packet_vkQueueSubmit *pPacket)
         // Remap Semaphores & CommandBuffers for this submit
         uint32_t i = 0;
         if (submit->pCommandBuffers != NULL) {
-            pRemappedBuffers = VKTRACE_NEW_ARRAY(VkCommandBuffer, submit->commandBufferCount);
+            pRemappedBuffers = VKTRACE_REPLAY_NEW_ARRAY(VkCommandBuffer, submit->commandBufferCount);
             remappedSubmit->pCommandBuffers = pRemappedBuffers;
             remappedSubmit->commandBufferCount = submit->commandBufferCount;
             for (i = 0; i < submit->commandBufferCount; i++) {
                 *(pRemappedBuffers + i) = m_objMapper.remap_commandbuffers(*(submit->pCommandBuffers + i));
                 if (*(pRemappedBuffers + i) == VK_NULL_HANDLE) {
                     vktrace_LogError("Skipping vkQueueSubmit() due to invalid remapped VkCommandBuffer.");
-                    VKTRACE_DELETE(remappedSubmits);
-                    VKTRACE_DELETE(pRemappedBuffers);
                     return replayResult;
                 }
             }
         }
         if (submit->pWaitSemaphores != NULL) {
-            pRemappedWaitSems = VKTRACE_NEW_ARRAY(VkSemaphore, submit->waitSemaphoreCount);
+            pRemappedWaitSems = VKTRACE_REPLAY_NEW_ARRAY(VkSemaphore, submit->waitSemaphoreCount);
             remappedSubmit->pWaitSemaphores = pRemappedWaitSems;
             remappedSubmit->waitSemaphoreCount = submit->waitSemaphoreCount;
             for (i = 0; i < submit->waitSemaphoreCount; i++) {
                 (*(pRemappedWaitSems + i)) = m_objMapper.remap_semaphores((*(submit->pWaitSemaphores + i)));
                 if (*(pRemappedWaitSems + i) == VK_NULL_HANDLE) {
                     vktrace_LogError("Skipping vkQueueSubmit() due to invalid remapped wait VkSemaphore.");
-                    VKTRACE_DELETE(remappedSubmits);
-                    VKTRACE_DELETE(pRemappedBuffers);
-                    VKTRACE_DELETE(pRemappedWaitSems);
                     return replayResult;
                 }
             }
         }
         if (submit->pSignalSemaphores != NULL) {
-            pRemappedSignalSems = VKTRACE_NEW_ARRAY(VkSemaphore, submit->signalSemaphoreCount);
+            pRemappedSignalSems = VKTRACE_REPLAY_NEW_ARRAY(VkSemaphore, submit->signalSemaphoreCount);
             remappedSubmit->pSignalSemaphores = pRemappedSignalSems;
             remappedSubmit->signalSemaphoreCount = submit->signalSemaphoreCount;
             for (i = 0; i < submit->signalSemaphoreCount; i++) {
                 (*(pRemappedSignalSems + i)) = m_objMapper.remap_semaphores((*(submit->pSignalSemaphores + i)));
                 if (*(pRemappedSignalSems + i) == VK_NULL_HANDLE) {
                     vktrace_LogError("Skipping vkQueueSubmit() due to invalid remapped signal VkSemaphore.");
-                    VKTRACE_DELETE(remappedSubmits);
-                    VKTRACE_DELETE(pRemappedBuffers);
-                    VKTRACE_DELETE(pRemappedWaitSems);
-                    VKTRACE_DELETE(pRemappedSignalSems);
                     return replayResult;
                 }
             }
         }
     }
+    if (m_pGpuTimestamps != NULL) {
+        m_pGpuTimestamps->begin_submit(pPacket->submitCount, remappedSubmits);
+    }
     replayResult = m_vkFuncs.real_vkQueueSubmit(remappedQueue, pPacket->submitCount, remappedSubmits, remappedFence);
-    VKTRACE_DELETE(pRemappedBuffers);
-    VKTRACE_DELETE(pRemappedWaitSems);
-    VKTRACE_DELETE(pRemappedSignalSems);
-    VKTRACE_DELETE(remappedSubmits);
+    if (m_pGpuTimestamps != NULL && replayResult == VK_SUCCESS) {
+        m_pGpuTimestamps->end_submit(m_frameNumber, pPacket->submitCount, remappedSubmits);
+    }
+    if (m_pFastForward != NULL && replayResult == VK_SUCCESS) {
+        m_pFastForward->submit(m_frameNumber, pPacket->submitCount, remappedSubmits);
+    }
     return replayResult;
 }
 
-VkResult vkReplay::manually_replay_vkQueueBindSparse(packet_vkQueueBindSparse *pPacket) {
-    VkResult replayResult = VK_ERROR_VALIDATION_FAILED_EXT;
+bool vkReplay::remap_sparse_memory(VkDeviceMemory traceMemory, VkDeviceMemory *pMemory, VkDeviceSize *pReplayOffset) {
+    if (traceMemory == VK_NULL_HANDLE) {
+        // Unbinds
+        *pMemory = VK_NULL_HANDLE;
+        *pReplayOffset = 0;
+        return true;
+    }
+    auto it = m_objMapper.m_devicememorys.find(traceMemory);
+    if (it == m_objMapper.m_devicememorys.end() || it->second.pGpuMem == NULL) {
+        return false;
+    }
+    *pMemory = it->second.replayDeviceMemory;
+    *pReplayOffset = it->second.replayOffset;
+    return true;
+}
+
+// Copies and remaps the opaque binds of a resource, leaving out those that don't change its bindings. Returns false if a
+// memory object can't be remapped.
+bool vkReplay::remap_sparse_memory_binds(uint64_t traceResource, const VkSparseMemoryBind *pTraceBinds, uint32_t traceBindCount,
+                                         const VkSparseMemoryBind **ppBinds, uint32_t *pBindCount) {
+    VkSparseMemoryBind *pBinds = VKTRACE_REPLAY_NEW_ARRAY(VkSparseMemoryBind, traceBindCount);
+    if (traceBindCount > 0) {
+        memcpy(pBinds, pTraceBinds, sizeof(VkSparseMemoryBind) * traceBindCount);
+    }
+    uint32_t bindCount = m_sparseBindings.update(traceResource, pBinds, traceBindCount);
+
+    // Binds of a batch mostly use the same memory object
+    VkDeviceMemory traceMemory = VK_NULL_HANDLE, replayMemory = VK_NULL_HANDLE;
+    VkDeviceSize replayOffset = 0;
+    for (uint32_t i = 0; i < bindCount; i++) {
+        if ((i == 0 || pBinds[i].memory != traceMemory) && !remap_sparse_memory(pBinds[i].memory, &replayMemory, &replayOffset)) {
+            return false;
+        }
+        traceMemory = pBinds[i].memory;
+        pBinds[i].memory = replayMemory;
+        pBinds[i].memoryOffset += replayOffset;
+    }
+    *ppBinds = pBinds;
+    *pBindCount = bindCount;
+    return true;
+}
 
+VkResult vkReplay::manually_replay_vkQueueBindSparse(packet_vkQueueBindSparse *pPacket) {
     VkQueue remappedQueue = m_objMapper.remap_queues(pPacket->queue);
     if (remappedQueue == VK_NULL_HANDLE) {
         vktrace_LogError("Skipping vkQueueBindSparse() due to invalid remapped VkQueue.");
@@ -732,161 +889,121 @@ VkResult vkReplay::manually_replay_vkQueueBindSparse(packet_vkQueueBindSparse *p
 
     VkFence remappedFence = m_objMapper.remap_fences(pPacket->fence);
     if (pPacket->fence != VK_NULL_HANDLE && remappedFence == VK_NULL_HANDLE) {
-        vktrace_LogError("Skipping vkQueueBindSparse() due to invalid remapped VkPhysicalDevice.");
+        vktrace_LogError("Skipping vkQueueBindSparse() due to invalid remapped VkFence.");
         return VK_ERROR_VALIDATION_FAILED_EXT;
     }
 
-    VkBindSparseInfo *remappedBindSparseInfos = VKTRACE_NEW_ARRAY(VkBindSparseInfo, pPacket->bindInfoCount);
-    VkSparseImageMemoryBind *pRemappedImageMemories = NULL;
-    VkSparseMemoryBind *pRemappedBufferMemories = NULL;
-    VkSparseMemoryBind *pRemappedImageOpaqueMemories = NULL;
-    VkSemaphore *pRemappedWaitSems = NULL;
-    VkSemaphore *pRemappedSignalSems = NULL;
-    VkSparseImageMemoryBindInfo *sIMBinf = NULL;
-    VkSparseBufferMemoryBindInfo *sBMBinf = NULL;
-    VkSparseImageOpaqueMemoryBindInfo *sIMOBinf = NULL;
-
+    VkBindSparseInfo *remappedBindSparseInfos = VKTRACE_REPLAY_NEW_ARRAY(VkBindSparseInfo, pPacket->bindInfoCount);
     memcpy((void *)remappedBindSparseInfos, (void *)(pPacket->pBindInfo), sizeof(VkBindSparseInfo) * pPacket->bindInfoCount);
 
     for (uint32_t bindInfo_idx = 0; bindInfo_idx < pPacket->bindInfoCount; bindInfo_idx++) {
-        if (remappedBindSparseInfos[bindInfo_idx].pBufferBinds) {
-            sBMBinf = VKTRACE_NEW_ARRAY(VkSparseBufferMemoryBindInfo, remappedBindSparseInfos[bindInfo_idx].bufferBindCount);
-            remappedBindSparseInfos[bindInfo_idx].pBufferBinds =
-                (const VkSparseBufferMemoryBindInfo *)(vktrace_trace_packet_interpret_buffer_pointer(
-                    pPacket->header, (intptr_t)remappedBindSparseInfos[bindInfo_idx].pBufferBinds));
-            memcpy((void *)sBMBinf, (void *)remappedBindSparseInfos[bindInfo_idx].pBufferBinds,
-                   sizeof(VkSparseBufferMemoryBindInfo) * remappedBindSparseInfos[bindInfo_idx].bufferBindCount);
-
-            sBMBinf->buffer = m_objMapper.remap_buffers(sBMBinf->buffer);
-
-            if (sBMBinf->buffer == VK_NULL_HANDLE) {
-                vktrace_LogError("Skipping vkQueueBindSparse() due to invalid remapped VkBuffer.");
-                goto FAILURE;
-            }
-
-            if (sBMBinf->bindCount > 0 && sBMBinf->pBinds) {
-                pRemappedBufferMemories = (VkSparseMemoryBind *)(vktrace_trace_packet_interpret_buffer_pointer(
-                    pPacket->header, (intptr_t)remappedBindSparseInfos[bindInfo_idx].pBufferBinds->pBinds));
-            }
-
-            for (uint32_t bindCountIdx = 0; bindCountIdx < sBMBinf->bindCount; bindCountIdx++) {
-                devicememoryObj local_mem = m_objMapper.m_devicememorys.find(pRemappedBufferMemories[bindCountIdx].memory)->second;
-                VkDeviceMemory replay_mem = m_objMapper.remap_devicememorys(pRemappedBufferMemories[bindCountIdx].memory);
-
-                if (replay_mem == VK_NULL_HANDLE || local_mem.pGpuMem == NULL) {
+        VkBindSparseInfo *pBindInfo = &remappedBindSparseInfos[bindInfo_idx];
+
+        if (pBindInfo->pBufferBinds) {
+            const VkSparseBufferMemoryBindInfo *pTraceBinds = (const VkSparseBufferMemoryBindInfo *)(
+                vktrace_trace_packet_interpret_buffer_pointer(pPacket->header, (intptr_t)pBindInfo->pBufferBinds));
+            VkSparseBufferMemoryBindInfo *sBMBinf =
+                VKTRACE_REPLAY_NEW_ARRAY(VkSparseBufferMemoryBindInfo, pBindInfo->bufferBindCount);
+            for (uint32_t i = 0; i < pBindInfo->bufferBindCount; i++) {
+                sBMBinf[i].buffer = m_objMapper.remap_buffers(pTraceBinds[i].buffer);
+                if (sBMBinf[i].buffer == VK_NULL_HANDLE) {
+                    vktrace_LogError("Skipping vkQueueBindSparse() due to invalid remapped VkBuffer.");
+                    return VK_ERROR_VALIDATION_FAILED_EXT;
+                }
+                const VkSparseMemoryBind *pBinds = (const VkSparseMemoryBind *)(vktrace_trace_packet_interpret_buffer_pointer(
+                    pPacket->header, (intptr_t)pTraceBinds[i].pBinds));
+                if (!remap_sparse_memory_binds((uint64_t)(pTraceBinds[i].buffer), pBinds, pBinds ? pTraceBinds[i].bindCount : 0,
+                                               &sBMBinf[i].pBinds, &sBMBinf[i].bindCount)) {
                     vktrace_LogError("Skipping vkQueueBindSparse() due to invalid remapped VkDeviceMemory.");
-                    goto FAILURE;
+                    return VK_ERROR_VALIDATION_FAILED_EXT;
                 }
-                pRemappedBufferMemories[bindCountIdx].memory = replay_mem;
             }
-            sBMBinf->pBinds = pRemappedBufferMemories;
-            remappedBindSparseInfos[bindInfo_idx].pBufferBinds = sBMBinf;
+            pBindInfo->pBufferBinds = sBMBinf;
         }
 
-        if (remappedBindSparseInfos[bindInfo_idx].pImageBinds) {
-            sIMBinf = VKTRACE_NEW_ARRAY(VkSparseImageMemoryBindInfo, remappedBindSparseInfos[bindInfo_idx].imageBindCount);
-            remappedBindSparseInfos[bindInfo_idx].pImageBinds =
-                (const VkSparseImageMemoryBindInfo *)(vktrace_trace_packet_interpret_buffer_pointer(
-                    pPacket->header, (intptr_t)remappedBindSparseInfos[bindInfo_idx].pImageBinds));
-            memcpy((void *)sIMBinf, (void *)remappedBindSparseInfos[bindInfo_idx].pImageBinds,
-                   sizeof(VkSparseImageMemoryBindInfo) * remappedBindSparseInfos[bindInfo_idx].imageBindCount);
-
-            sIMBinf->image = m_objMapper.remap_images(sIMBinf->image);
-
-            if (sIMBinf->image == VK_NULL_HANDLE) {
-                vktrace_LogError("Skipping vkQueueBindSparse() due to invalid remapped VkImage.");
-                goto FAILURE;
-            }
-
-            if (sIMBinf->bindCount > 0 && sIMBinf->pBinds) {
-                pRemappedImageMemories = (VkSparseImageMemoryBind *)(vktrace_trace_packet_interpret_buffer_pointer(
-                    pPacket->header, (intptr_t)remappedBindSparseInfos[bindInfo_idx].pImageBinds->pBinds));
-            }
-            for (uint32_t bindCountIdx = 0; bindCountIdx < sIMBinf->bindCount; bindCountIdx++) {
-                devicememoryObj local_mem = m_objMapper.m_devicememorys.find(pRemappedImageMemories[bindCountIdx].memory)->second;
-                VkDeviceMemory replay_mem = m_objMapper.remap_devicememorys(pRemappedImageMemories[bindCountIdx].memory);
-
-                if (replay_mem == VK_NULL_HANDLE || local_mem.pGpuMem == NULL) {
+        if (pBindInfo->pImageOpaqueBinds) {
+            const VkSparseImageOpaqueMemoryBindInfo *pTraceBinds = (const VkSparseImageOpaqueMemoryBindInfo *)(
+                vktrace_trace_packet_interpret_buffer_pointer(pPacket->header, (intptr_t)pBindInfo->pImageOpaqueBinds));
+            VkSparseImageOpaqueMemoryBindInfo *sIMOBinf =
+                VKTRACE_REPLAY_NEW_ARRAY(VkSparseImageOpaqueMemoryBindInfo, pBindInfo->imageOpaqueBindCount);
+            for (uint32_t i = 0; i < pBindInfo->imageOpaqueBindCount; i++) {
+                sIMOBinf[i].image = m_objMapper.remap_images(pTraceBinds[i].image);
+                if (sIMOBinf[i].image == VK_NULL_HANDLE) {
+                    vktrace_LogError("Skipping vkQueueBindSparse() due to invalid remapped VkImage.");
+                    return VK_ERROR_VALIDATION_FAILED_EXT;
+                }
+                const VkSparseMemoryBind *pBinds = (const VkSparseMemoryBind *)(vktrace_trace_packet_interpret_buffer_pointer(
+                    pPacket->header, (intptr_t)pTraceBinds[i].pBinds));
+                if (!remap_sparse_memory_binds((uint64_t)(pTraceBinds[i].image), pBinds, pBinds ? pTraceBinds[i].bindCount : 0,
+                                               &sIMOBinf[i].pBinds, &sIMOBinf[i].bindCount)) {
                     vktrace_LogError("Skipping vkQueueBindSparse() due to invalid remapped VkDeviceMemory.");
-                    goto FAILURE;
+                    return VK_ERROR_VALIDATION_FAILED_EXT;
                 }
-                pRemappedImageMemories[bindCountIdx].memory = replay_mem;
             }
-            sIMBinf->pBinds = pRemappedImageMemories;
-            remappedBindSparseInfos[bindInfo_idx].pImageBinds = sIMBinf;
+            pBindInfo->pImageOpaqueBinds = sIMOBinf;
         }
 
-        if (remappedBindSparseInfos[bindInfo_idx].pImageOpaqueBinds) {
-            sIMOBinf =
-                VKTRACE_NEW_ARRAY(VkSparseImageOpaqueMemoryBindInfo, remappedBindSparseInfos[bindInfo_idx].imageOpaqueBindCount);
-            remappedBindSparseInfos[bindInfo_idx].pImageOpaqueBinds =
-                (const VkSparseImageOpaqueMemoryBindInfo *)(vktrace_trace_packet_interpret_buffer_pointer(
-                    pPacket->header, (intptr_t)remappedBindSparseInfos[bindInfo_idx].pImageOpaqueBinds));
-            memcpy((void *)sIMOBinf, (void *)remappedBindSparseInfos[bindInfo_idx].pImageOpaqueBinds,
-                   sizeof(VkSparseImageOpaqueMemoryBindInfo) * remappedBindSparseInfos[bindInfo_idx].imageOpaqueBindCount);
-
-            sIMOBinf->image = m_objMapper.remap_images(sIMOBinf->image);
-
-            if (sIMOBinf->image == VK_NULL_HANDLE) {
-                vktrace_LogError("Skipping vkQueueBindSparse() due to invalid remapped VkImage.");
-                goto FAILURE;
-            }
-
-            if (sIMOBinf->bindCount > 0 && sIMOBinf->pBinds) {
-                pRemappedImageOpaqueMemories = (VkSparseMemoryBind *)(vktrace_trace_packet_interpret_buffer_pointer(
-                    pPacket->header, (intptr_t)remappedBindSparseInfos[bindInfo_idx].pImageOpaqueBinds->pBinds));
-            }
-            for (uint32_t bindCountIdx = 0; bindCountIdx < sIMOBinf->bindCount; bindCountIdx++) {
-                devicememoryObj local_mem =
-                    m_objMapper.m_devicememorys.find(pRemappedImageOpaqueMemories[bindCountIdx].memory)->second;
-                VkDeviceMemory replay_mem = m_objMapper.remap_devicememorys(pRemappedImageOpaqueMemories[bindCountIdx].memory);
-
-                if (replay_mem == VK_NULL_HANDLE || local_mem.pGpuMem == NULL) {
-                    vktrace_LogError("Skipping vkQueueBindSparse() due to invalid remapped VkDeviceMemory.");
-                    goto FAILURE;
+        if (pBindInfo->pImageBinds) {
+            const VkSparseImageMemoryBindInfo *pTraceBinds = (const VkSparseImageMemoryBindInfo *)(
+                vktrace_trace_packet_interpret_buffer_pointer(pPacket->header, (intptr_t)pBindInfo->pImageBinds));
+            VkSparseImageMemoryBindInfo *sIMBinf = VKTRACE_REPLAY_NEW_ARRAY(VkSparseImageMemoryBindInfo, pBindInfo->imageBindCount);
+            for (uint32_t i = 0; i < pBindInfo->imageBindCount; i++) {
+                sIMBinf[i].image = m_objMapper.remap_images(pTraceBinds[i].image);
+                if (sIMBinf[i].image == VK_NULL_HANDLE) {
+                    vktrace_LogError("Skipping vkQueueBindSparse() due to invalid remapped VkImage.");
+                    return VK_ERROR_VALIDATION_FAILED_EXT;
+                }
+                const VkSparseImageMemoryBind *pTraceImageBinds = (const VkSparseImageMemoryBind *)(
+                    vktrace_trace_packet_interpret_buffer_pointer(pPacket->header, (intptr_t)pTraceBinds[i].pBinds));
+                sIMBinf[i].bindCount = pTraceImageBinds ? pTraceBinds[i].bindCount : 0;
+                VkSparseImageMemoryBind *pBinds = VKTRACE_REPLAY_NEW_ARRAY(VkSparseImageMemoryBind, sIMBinf[i].bindCount);
+                VkDeviceMemory traceMemory = VK_NULL_HANDLE, replayMemory = VK_NULL_HANDLE;
+                VkDeviceSize replayOffset = 0;
+                for (uint32_t j = 0; j < sIMBinf[i].bindCount; j++) {
+                    pBinds[j] = pTraceImageBinds[j];
+                    if ((j == 0 || pBinds[j].memory != traceMemory) &&
+                        !remap_sparse_memory(pBinds[j].memory, &replayMemory, &replayOffset)) {
+                        vktrace_LogError("Skipping vkQueueBindSparse() due to invalid remapped VkDeviceMemory.");
+                        return VK_ERROR_VALIDATION_FAILED_EXT;
+                    }
+                    traceMemory = pBinds[j].memory;
+                    pBinds[j].memory = replayMemory;
+                    pBinds[j].memoryOffset += replayOffset;
                 }
-                pRemappedImageOpaqueMemories[bindCountIdx].memory = replay_mem;
+                sIMBinf[i].pBinds = pBinds;
             }
-            sIMOBinf->pBinds = pRemappedImageOpaqueMemories;
-            remappedBindSparseInfos[bindInfo_idx].pImageOpaqueBinds = sIMOBinf;
+            pBindInfo->pImageBinds = sIMBinf;
         }
 
-        if (remappedBindSparseInfos[bindInfo_idx].pWaitSemaphores != NULL) {
-            pRemappedWaitSems = VKTRACE_NEW_ARRAY(VkSemaphore, remappedBindSparseInfos[bindInfo_idx].waitSemaphoreCount);
-            remappedBindSparseInfos[bindInfo_idx].pWaitSemaphores = pRemappedWaitSems;
-            for (uint32_t i = 0; i < remappedBindSparseInfos[bindInfo_idx].waitSemaphoreCount; i++) {
-                (*(pRemappedWaitSems + i)) =
-                    m_objMapper.remap_semaphores((*(remappedBindSparseInfos[bindInfo_idx].pWaitSemaphores + i)));
-                if (*(pRemappedWaitSems + i) == VK_NULL_HANDLE) {
-                    vktrace_LogError("Skipping vkQueueSubmit() due to invalid remapped wait VkSemaphore.");
-                    goto FAILURE;
+        if (pBindInfo->pWaitSemaphores != NULL) {
+            VkSemaphore *pRemappedWaitSems = VKTRACE_REPLAY_NEW_ARRAY(VkSemaphore, pBindInfo->waitSemaphoreCount);
+            const VkSemaphore *pTraceWaitSems = (const VkSemaphore *)(vktrace_trace_packet_interpret_buffer_pointer(
+                pPacket->header, (intptr_t)pBindInfo->pWaitSemaphores));
+            for (uint32_t i = 0; i < pBindInfo->waitSemaphoreCount; i++) {
+                pRemappedWaitSems[i] = m_objMapper.remap_semaphores(pTraceWaitSems[i]);
+                if (pRemappedWaitSems[i] == VK_NULL_HANDLE) {
+                    vktrace_LogError("Skipping vkQueueBindSparse() due to invalid remapped wait VkSemaphore.");
+                    return VK_ERROR_VALIDATION_FAILED_EXT;
                 }
             }
+            pBindInfo->pWaitSemaphores = pRemappedWaitSems;
         }
-        if (remappedBindSparseInfos[bindInfo_idx].pSignalSemaphores != NULL) {
-            pRemappedSignalSems = VKTRACE_NEW_ARRAY(VkSemaphore, remappedBindSparseInfos[bindInfo_idx].signalSemaphoreCount);
-            remappedBindSparseInfos[bindInfo_idx].pSignalSemaphores = pRemappedSignalSems;
-            for (uint32_t i = 0; i < remappedBindSparseInfos[bindInfo_idx].signalSemaphoreCount; i++) {
-                (*(pRemappedSignalSems + i)) =
-                    m_objMapper.remap_semaphores((*(remappedBindSparseInfos[bindInfo_idx].pSignalSemaphores + i)));
-                if (*(pRemappedSignalSems + i) == VK_NULL_HANDLE) {
-                    vktrace_LogError("Skipping vkQueueSubmit() due to invalid remapped signal VkSemaphore.");
-                    goto FAILURE;
+        if (pBindInfo->pSignalSemaphores != NULL) {
+            VkSemaphore *pRemappedSignalSems = VKTRACE_REPLAY_NEW_ARRAY(VkSemaphore, pBindInfo->signalSemaphoreCount);
+            const VkSemaphore *pTraceSignalSems = (const VkSemaphore *)(vktrace_trace_packet_interpret_buffer_pointer(
+                pPacket->header, (intptr_t)pBindInfo->pSignalSemaphores));
+            for (uint32_t i = 0; i < pBindInfo->signalSemaphoreCount; i++) {
+                pRemappedSignalSems[i] = m_objMapper.remap_semaphores(pTraceSignalSems[i]);
+                if (pRemappedSignalSems[i] == VK_NULL_HANDLE) {
+                    vktrace_LogError("Skipping vkQueueBindSparse() due to invalid remapped signal VkSemaphore.");
+                    return VK_ERROR_VALIDATION_FAILED_EXT;
                 }
             }
+            pBindInfo->pSignalSemaphores = pRemappedSignalSems;
         }
     }
 
-    replayResult = m_vkFuncs.real_vkQueueBindSparse(remappedQueue, pPacket->bindInfoCount, remappedBindSparseInfos, remappedFence);
-
-FAILURE:
-    VKTRACE_DELETE(remappedBindSparseInfos);
-    VKTRACE_DELETE(sIMBinf);
-    VKTRACE_DELETE(sBMBinf);
-    VKTRACE_DELETE(sIMOBinf);
-    VKTRACE_DELETE(pRemappedSignalSems);
-    VKTRACE_DELETE(pRemappedWaitSems);
-    return replayResult;
+    return m_vkFuncs.real_vkQueueBindSparse(remappedQueue, pPacket->bindInfoCount, remappedBindSparseInfos, remappedFence);
 }
 
 void vkReplay::manually_replay_vkUpdateDescriptorSets(packet_vkUpdateDescriptorSets *pPacket) {
@@ -900,11 +1017,11 @@ void vkReplay::manually_replay_vkUpdateDescriptorSets(packet_vkUpdateDescriptorS
     }
 
     // allocate a new array for the writes and clear the memory, we'll update the contents further down
-    VkWriteDescriptorSet *pRemappedWrites = VKTRACE_NEW_ARRAY(VkWriteDescriptorSet, pPacket->descriptorWriteCount);
+    VkWriteDescriptorSet *pRemappedWrites = VKTRACE_REPLAY_NEW_ARRAY(VkWriteDescriptorSet, pPacket->descriptorWriteCount);
     memset(pRemappedWrites, 0, pPacket->descriptorWriteCount * sizeof(VkWriteDescriptorSet));
 
     // allocate a new array for the copies, and simply copy the original data in since there are no pointers to update.
-    VkCopyDescriptorSet *pRemappedCopies = VKTRACE_NEW_ARRAY(VkCopyDescriptorSet, pPacket->descriptorCopyCount);
+    VkCopyDescriptorSet *pRemappedCopies = VKTRACE_REPLAY_NEW_ARRAY(VkCopyDescriptorSet, pPacket->descriptorCopyCount);
     memcpy(pRemappedCopies, pPacket->pDescriptorCopies, pPacket->descriptorCopyCount * sizeof(VkCopyDescriptorSet));
 
     bool errorBadRemap = false;
@@ -926,7 +1043,7 @@ void vkReplay::manually_replay_vkUpdateDescriptorSets(packet_vkUpdateDescriptorS
         switch (pPacket->pDescriptorWrites[i].descriptorType) {
             case VK_DESCRIPTOR_TYPE_SAMPLER:
                 pRemappedWrites[i].pImageInfo =
-                    VKTRACE_NEW_ARRAY(VkDescriptorImageInfo, pPacket->pDescriptorWrites[i].descriptorCount);
+                    VKTRACE_REPLAY_NEW_ARRAY(VkDescriptorImageInfo, pPacket->pDescriptorWrites[i].descriptorCount);
                 memcpy((void *)pRemappedWrites[i].pImageInfo, pPacket->pDescriptorWrites[i].pImageInfo,
                        pPacket->pDescriptorWrites[i].descriptorCount * sizeof(VkDescriptorImageInfo));
                 for (uint32_t j = 0; j < pPacket->pDescriptorWrites[i].descriptorCount; j++) {
@@ -945,7 +1062,7 @@ void vkReplay::manually_replay_vkUpdateDescriptorSets(packet_vkUpdateDescriptorS
             case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
             case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
                 pRemappedWrites[i].pImageInfo =
-                    VKTRACE_NEW_ARRAY(VkDescriptorImageInfo, pPacket->pDescriptorWrites[i].descriptorCount);
+                    VKTRACE_REPLAY_NEW_ARRAY(VkDescriptorImageInfo, pPacket->pDescriptorWrites[i].descriptorCount);
                 memcpy((void *)pRemappedWrites[i].pImageInfo, pPacket->pDescriptorWrites[i].pImageInfo,
                        pPacket->pDescriptorWrites[i].descriptorCount * sizeof(VkDescriptorImageInfo));
                 for (uint32_t j = 0; j < pPacket->pDescriptorWrites[i].descriptorCount; j++) {
@@ -962,7 +1079,7 @@ void vkReplay::manually_replay_vkUpdateDescriptorSets(packet_vkUpdateDescriptorS
                 break;
             case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
                 pRemappedWrites[i].pImageInfo =
-                    VKTRACE_NEW_ARRAY(VkDescriptorImageInfo, pPacket->pDescriptorWrites[i].descriptorCount);
+                    VKTRACE_REPLAY_NEW_ARRAY(VkDescriptorImageInfo, pPacket->pDescriptorWrites[i].descriptorCount);
                 memcpy((void *)pRemappedWrites[i].pImageInfo, pPacket->pDescriptorWrites[i].pImageInfo,
                        pPacket->pDescriptorWrites[i].descriptorCount * sizeof(VkDescriptorImageInfo));
                 for (uint32_t j = 0; j < pPacket->pDescriptorWrites[i].descriptorCount; j++) {
@@ -989,7 +1106,7 @@ void vkReplay::manually_replay_vkUpdateDescriptorSets(packet_vkUpdateDescriptorS
             case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
             case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
                 pRemappedWrites[i].pTexelBufferView =
-                    VKTRACE_NEW_ARRAY(VkBufferView, pPacket->pDescriptorWrites[i].descriptorCount);
+                    VKTRACE_REPLAY_NEW_ARRAY(VkBufferView, pPacket->pDescriptorWrites[i].descriptorCount);
                 memcpy((void *)pRemappedWrites[i].pTexelBufferView, pPacket->pDescriptorWrites[i].pTexelBufferView,
                        pPacket->pDescriptorWrites[i].descriptorCount * sizeof(VkBufferView));
                 for (uint32_t j = 0; j < pPacket->pDescriptorWrites[i].descriptorCount; j++) {
@@ -1009,7 +1126,7 @@ void vkReplay::manually_replay_vkUpdateDescriptorSets(packet_vkUpdateDescriptorS
             case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
             case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
                 pRemappedWrites[i].pBufferInfo =
-                    VKTRACE_NEW_ARRAY(VkDescriptorBufferInfo, pPacket->pDescriptorWrites[i].descriptorCount);
+                    VKTRACE_REPLAY_NEW_ARRAY(VkDescriptorBufferInfo, pPacket->pDescriptorWrites[i].descriptorCount);
                 memcpy((void *)pRemappedWrites[i].pBufferInfo, pPacket->pDescriptorWrites[i].pBufferInfo,
                        pPacket->pDescriptorWrites[i].descriptorCount * sizeof(VkDescriptorBufferInfo));
                 for (uint32_t j = 0; j < pPacket->pDescriptorWrites[i].descriptorCount; j++) {
@@ -1046,45 +1163,9 @@ void vkReplay::manually_replay_vkUpdateDescriptorSets(packet_vkUpdateDescriptorS
     }
 
     if (!errorBadRemap) {
-        // If an error occurred, don't call the real function, but skip ahead so that memory is cleaned up!
-
         m_vkFuncs.real_vkUpdateDescriptorSets(remappedDevice, pPacket->descriptorWriteCount, pRemappedWrites,
                                               pPacket->descriptorCopyCount, pRemappedCopies);
     }
-
-    for (uint32_t d = 0; d < pPacket->descriptorWriteCount; d++) {
-        switch (pPacket->pDescriptorWrites[d].descriptorType) {
-            case VK_DESCRIPTOR_TYPE_SAMPLER:
-            case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
-            case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
-            case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
-            case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
-                if (pRemappedWrites[d].pImageInfo != NULL) {
-                    VKTRACE_DELETE((void *)pRemappedWrites[d].pImageInfo);
-                    pRemappedWrites[d].pImageInfo = NULL;
-                }
-                break;
-            case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
-            case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
-                if (pRemappedWrites[d].pTexelBufferView != NULL) {
-                    VKTRACE_DELETE((void *)pRemappedWrites[d].pTexelBufferView);
-                    pRemappedWrites[d].pTexelBufferView = NULL;
-                }
-                break;
-            case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
-            case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
-            case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
-            case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
-                if (pRemappedWrites[d].pBufferInfo != NULL) {
-                    VKTRACE_DELETE((void *)pRemappedWrites[d].pBufferInfo);
-                    pRemappedWrites[d].pBufferInfo = NULL;
-                }
-            default:
-                break;
-        }
-    }
-    VKTRACE_DELETE(pRemappedWrites);
-    VKTRACE_DELETE(pRemappedCopies);
 }
 
 VkResult vkReplay::manually_replay_vkCreateDescriptorSetLayout(packet_vkCreateDescriptorSetLayout *pPacket) {
@@ -1149,7 +1230,7 @@ VkResult vkReplay::manually_replay_vkAllocateDescriptorSets(packet_vkAllocateDes
     }
 
     VkDescriptorSetLayout *pRemappedSetLayouts =
-        VKTRACE_NEW_ARRAY(VkDescriptorSetLayout, pPacket->pAllocateInfo->descriptorSetCount);
+        VKTRACE_REPLAY_NEW_ARRAY(VkDescriptorSetLayout, pPacket->pAllocateInfo->descriptorSetCount);
 
     VkDescriptorSetAllocateInfo allocateInfo;
     allocateInfo.pNext = NULL;
@@ -1162,7 +1243,6 @@ VkResult vkReplay::manually_replay_vkAllocateDescriptorSets(packet_vkAllocateDes
         pRemappedSetLayouts[i] = m_objMapper.remap_descriptorsetlayouts(pPacket->pAllocateInfo->pSetLayouts[i]);
         if (pRemappedSetLayouts[i] == VK_NULL_HANDLE) {
             vktrace_LogError("Skipping vkAllocateDescriptorSets() due to invalid remapped VkDescriptorSetLayout.");
-            VKTRACE_DELETE(pRemappedSetLayouts);
             return VK_ERROR_VALIDATION_FAILED_EXT;
         }
     }
@@ -1175,8 +1255,6 @@ VkResult vkReplay::manually_replay_vkAllocateDescriptorSets(packet_vkAllocateDes
         }
     }
 
-    VKTRACE_DELETE(pRemappedSetLayouts);
-
     return replayResult;
 }
 
@@ -1196,13 +1274,12 @@ VkResult vkReplay::manually_replay_vkFreeDescriptorSets(packet_vkFreeDescriptorS
         return VK_ERROR_VALIDATION_FAILED_EXT;
     }
 
-    VkDescriptorSet *localDSs = VKTRACE_NEW_ARRAY(VkDescriptorSet, pPacket->descriptorSetCount);
+    VkDescriptorSet *localDSs = VKTRACE_REPLAY_NEW_ARRAY(VkDescriptorSet, pPacket->descriptorSetCount);
     uint32_t i;
     for (i = 0; i < pPacket->descriptorSetCount; ++i) {
         localDSs[i] = m_objMapper.remap_descriptorsets(pPacket->pDescriptorSets[i]);
         if (localDSs[i] == VK_NULL_HANDLE && pPacket->pDescriptorSets[i] != VK_NULL_HANDLE) {
             vktrace_LogError("Skipping vkFreeDescriptorSets() due to invalid remapped VkDescriptorSet.");
-            VKTRACE_DELETE(localDSs);
             return VK_ERROR_VALIDATION_FAILED_EXT;
         }
     }
@@ -1214,7 +1291,6 @@ VkResult vkReplay::manually_replay_vkFreeDescriptorSets(packet_vkFreeDescriptorS
             m_objMapper.rm_from_descriptorsets_map(pPacket->pDescriptorSets[i]);
         }
     }
-    VKTRACE_DELETE(localDSs);
     return replayResult;
 }
 
@@ -1231,7 +1307,7 @@ void vkReplay::manually_replay_vkCmdBindDescriptorSets(packet_vkCmdBindDescripto
         return;
     }
 
-    VkDescriptorSet *pRemappedSets = (VkDescriptorSet *)vktrace_malloc(sizeof(VkDescriptorSet) * pPacket->descriptorSetCount);
+    VkDescriptorSet *pRemappedSets = VKTRACE_REPLAY_NEW_ARRAY(VkDescriptorSet, pPacket->descriptorSetCount);
     if (pRemappedSets == NULL) {
         vktrace_LogError("Replay of CmdBindDescriptorSets out of memory.");
         return;
@@ -1241,7 +1317,6 @@ void vkReplay::manually_replay_vkCmdBindDescriptorSets(packet_vkCmdBindDescripto
         pRemappedSets[idx] = m_objMapper.remap_descriptorsets(pPacket->pDescriptorSets[idx]);
         if (pRemappedSets[idx] == VK_NULL_HANDLE && pPacket->pDescriptorSets[idx] != VK_NULL_HANDLE) {
             vktrace_LogError("Skipping vkCmdBindDescriptorSets() due to invalid remapped VkDescriptorSet.");
-            vktrace_free(pRemappedSets);
             return;
         }
     }
@@ -1249,7 +1324,6 @@ void vkReplay::manually_replay_vkCmdBindDescriptorSets(packet_vkCmdBindDescripto
     m_vkFuncs.real_vkCmdBindDescriptorSets(remappedCommandBuffer, pPacket->pipelineBindPoint, remappedLayout, pPacket->firstSet,
                                            pPacket->descriptorSetCount, pRemappedSets, pPacket->dynamicOffsetCount,
                                            pPacket->pDynamicOffsets);
-    vktrace_free(pRemappedSets);
     return;
 }
 
@@ -1260,7 +1334,7 @@ void vkReplay::manually_replay_vkCmdBindVertexBuffers(packet_vkCmdBindVertexBuff
         return;
     }
 
-    VkBuffer *pSaveBuff = VKTRACE_NEW_ARRAY(VkBuffer, pPacket->bindingCount);
+    VkBuffer *pSaveBuff = VKTRACE_REPLAY_NEW_ARRAY(VkBuffer, pPacket->bindingCount);
     if (pSaveBuff == NULL && pPacket->bindingCount > 0) {
         vktrace_LogError("Replay of CmdBindVertexBuffers out of memory.");
         return;
@@ -1273,7 +1347,6 @@ void vkReplay::manually_replay_vkCmdBindVertexBuffers(packet_vkCmdBindVertexBuff
             *pBuff = m_objMapper.remap_buffers(pPacket->pBuffers[i]);
             if (*pBuff == VK_NULL_HANDLE && pPacket->pBuffers[i] != VK_NULL_HANDLE) {
                 vktrace_LogError("Skipping vkCmdBindVertexBuffers() due to invalid remapped VkBuffer.");
-                VKTRACE_DELETE(pSaveBuff);
                 return;
             }
         }
@@ -1284,7 +1357,6 @@ void vkReplay::manually_replay_vkCmdBindVertexBuffers(packet_vkCmdBindVertexBuff
         VkBuffer *pBuff = (VkBuffer *)&(pPacket->pBuffers[k]);
         *pBuff = pSaveBuff[k];
     }
-    VKTRACE_DELETE(pSaveBuff);
     return;
 }
 
@@ -1314,6 +1386,22 @@ VkResult vkReplay::manually_replay_vkGetPipelineCacheData(packet_vkGetPipelineCa
     return replayResult;
 }
 
+static bool graphics_pipeline_has_pnext(const VkGraphicsPipelineCreateInfo &createInfo) {
+    if (createInfo.pNext != NULL) return true;
+    for (uint32_t i = 0; i < createInfo.stageCount; i++) {
+        if (createInfo.pStages[i].pNext != NULL) return true;
+    }
+    return (createInfo.pVertexInputState != NULL && createInfo.pVertexInputState->pNext != NULL) ||
+           (createInfo.pInputAssemblyState != NULL && createInfo.pInputAssemblyState->pNext != NULL) ||
+           (createInfo.pTessellationState != NULL && createInfo.pTessellationState->pNext != NULL) ||
+           (createInfo.pViewportState != NULL && createInfo.pViewportState->pNext != NULL) ||
+           (createInfo.pRasterizationState != NULL && createInfo.pRasterizationState->pNext != NULL) ||
+           (createInfo.pMultisampleState != NULL && createInfo.pMultisampleState->pNext != NULL) ||
+           (createInfo.pDepthStencilState != NULL && createInfo.pDepthStencilState->pNext != NULL) ||
+           (createInfo.pColorBlendState != NULL && createInfo.pColorBlendState->pNext != NULL) ||
+           (createInfo.pDynamicState != NULL && createInfo.pDynamicState->pNext != NULL);
+}
+
 VkResult vkReplay::manually_replay_vkCreateComputePipelines(packet_vkCreateComputePipelines *pPacket) {
     VkResult replayResult = VK_ERROR_VALIDATION_FAILED_EXT;
     VkDevice remappeddevice = m_objMapper.remap_devices(pPacket->device);
@@ -1323,8 +1411,13 @@ VkResult vkReplay::manually_replay_vkCreateComputePipelines(packet_vkCreateCompu
         return VK_ERROR_VALIDATION_FAILED_EXT;
     }
 
+    // A pipeline derived from one that is still compiling needs that one mapped first
+    for (i = 0; i < pPacket->createInfoCount && !m_pendingPipelines.empty(); i++) {
+        if (pPacket->pCreateInfos[i].basePipelineHandle != VK_NULL_HANDLE) finish_pipeline_creation();
+    }
+
     VkPipelineCache pipelineCache;
-    pipelineCache = m_objMapper.remap_pipelinecaches(pPacket->pipelineCache);
+    pipelineCache = get_pipeline_cache(remappeddevice, pPacket->pipelineCache);
 
     VkComputePipelineCreateInfo *pLocalCIs = VKTRACE_NEW_ARRAY(VkComputePipelineCreateInfo, pPacket->createInfoCount);
     memcpy((void *)pLocalCIs, (void *)(pPacket->pCreateInfos), sizeof(VkComputePipelineCreateInfo) * pPacket->createInfoCount);
@@ -1357,12 +1450,43 @@ VkResult vkReplay::manually_replay_vkCreateComputePipelines(packet_vkCreateCompu
 
     VkPipeline *local_pPipelines = VKTRACE_NEW_ARRAY(VkPipeline, pPacket->createInfoCount);
 
-    replayResult = m_vkFuncs.real_vkCreateComputePipelines(remappeddevice, pipelineCache, pPacket->createInfoCount, pLocalCIs, NULL,
-                                                           local_pPipelines);
+    bool compileOnThreads = m_pPipelineThreads != NULL && pPacket->result == VK_SUCCESS;
+    for (i = 0; i < pPacket->createInfoCount && compileOnThreads; i++) {
+        // Copies of the create infos don't follow pNext chains
+        compileOnThreads = pLocalCIs[i].pNext == NULL && pLocalCIs[i].stage.pNext == NULL;
+    }
 
-    if (replayResult == VK_SUCCESS) {
+    if (compileOnThreads) {
+        std::shared_ptr<PendingPipelines> pPending(new PendingPipelines());
+        pPending->result = VK_INCOMPLETE;
+        pPending->tracePipelines.assign(pPacket->pPipelines, pPacket->pPipelines + pPacket->createInfoCount);
+        pPending->replayPipelines.resize(pPacket->createInfoCount, VK_NULL_HANDLE);
+        std::shared_ptr<std::vector<safe_VkComputePipelineCreateInfo>> pCreateInfos(
+            new std::vector<safe_VkComputePipelineCreateInfo>());
+        pCreateInfos->reserve(pPacket->createInfoCount);
         for (i = 0; i < pPacket->createInfoCount; i++) {
-            m_objMapper.add_to_pipelines_map(pPacket->pPipelines[i], local_pPipelines[i]);
+            pCreateInfos->emplace_back(&pLocalCIs[i]);
+        }
+
+        PFN_vkCreateComputePipelines createComputePipelines = m_vkFuncs.real_vkCreateComputePipelines;
+        m_pPipelineThreads->queue([=]() {
+            std::vector<VkComputePipelineCreateInfo> createInfos;
+            for (size_t j = 0; j < pCreateInfos->size(); j++) {
+                createInfos.push_back(*(*pCreateInfos)[j].ptr());
+            }
+            pPending->result = createComputePipelines(remappeddevice, pipelineCache, (uint32_t)createInfos.size(), createInfos.data(),
+                                                      NULL, pPending->replayPipelines.data());
+        });
+        m_pendingPipelines.push_back(pPending);
+        replayResult = VK_SUCCESS;
+    } else {
+        replayResult = m_vkFuncs.real_vkCreateComputePipelines(remappeddevice, pipelineCache, pPacket->createInfoCount, pLocalCIs,
+                                                               NULL, local_pPipelines);
+
+        if (replayResult == VK_SUCCESS) {
+            for (i = 0; i < pPacket->createInfoCount; i++) {
+                m_objMapper.add_to_pipelines_map(pPacket->pPipelines[i], local_pPipelines[i]);
+            }
         }
     }
 
@@ -1383,6 +1507,11 @@ VkResult vkReplay::manually_replay_vkCreateGraphicsPipelines(packet_vkCreateGrap
         return VK_ERROR_VALIDATION_FAILED_EXT;
     }
 
+    // A pipeline derived from one that is still compiling needs that one mapped first
+    for (uint32_t i = 0; i < pPacket->createInfoCount && !m_pendingPipelines.empty(); i++) {
+        if (pPacket->pCreateInfos[i].basePipelineHandle != VK_NULL_HANDLE) finish_pipeline_creation();
+    }
+
     // remap shaders from each stage
     VkPipelineShaderStageCreateInfo **ppRemappedStages =
         VKTRACE_NEW_ARRAY(VkPipelineShaderStageCreateInfo *, pPacket->createInfoCount);
@@ -1458,7 +1587,7 @@ VkResult vkReplay::manually_replay_vkCreateGraphicsPipelines(packet_vkCreateGrap
     }
 
     VkPipelineCache remappedPipelineCache;
-    remappedPipelineCache = m_objMapper.remap_pipelinecaches(pPacket->pipelineCache);
+    remappedPipelineCache = get_pipeline_cache(remappedDevice, pPacket->pipelineCache);
     if (remappedPipelineCache == VK_NULL_HANDLE && pPacket->pipelineCache != VK_NULL_HANDLE) {
         vktrace_LogError("Skipping vkCreateGraphicsPipelines() due to invalid remapped VkPipelineCache.");
         for (k = 0; k < pPacket->createInfoCount; k++) {
@@ -1472,12 +1601,43 @@ VkResult vkReplay::manually_replay_vkCreateGraphicsPipelines(packet_vkCreateGrap
     uint32_t createInfoCount = pPacket->createInfoCount;
     VkPipeline *local_pPipelines = VKTRACE_NEW_ARRAY(VkPipeline, pPacket->createInfoCount);
 
-    replayResult = m_vkFuncs.real_vkCreateGraphicsPipelines(remappedDevice, remappedPipelineCache, createInfoCount, pLocalCIs, NULL,
-                                                            local_pPipelines);
+    bool compileOnThreads = m_pPipelineThreads != NULL && pPacket->result == VK_SUCCESS;
+    for (i = 0; i < createInfoCount && compileOnThreads; i++) {
+        // Copies of the create infos don't follow pNext chains
+        compileOnThreads = !graphics_pipeline_has_pnext(pLocalCIs[i]);
+    }
+
+    if (compileOnThreads) {
+        std::shared_ptr<PendingPipelines> pPending(new PendingPipelines());
+        pPending->result = VK_INCOMPLETE;
+        pPending->tracePipelines.assign(pPacket->pPipelines, pPacket->pPipelines + createInfoCount);
+        pPending->replayPipelines.resize(createInfoCount, VK_NULL_HANDLE);
+        std::shared_ptr<std::vector<safe_VkGraphicsPipelineCreateInfo>> pCreateInfos(
+            new std::vector<safe_VkGraphicsPipelineCreateInfo>());
+        pCreateInfos->reserve(createInfoCount);
+        for (i = 0; i < createInfoCount; i++) {
+            pCreateInfos->emplace_back(&pLocalCIs[i]);
+        }
+
+        PFN_vkCreateGraphicsPipelines createGraphicsPipelines = m_vkFuncs.real_vkCreateGraphicsPipelines;
+        m_pPipelineThreads->queue([=]() {
+            std::vector<VkGraphicsPipelineCreateInfo> createInfos;
+            for (size_t j = 0; j < pCreateInfos->size(); j++) {
+                createInfos.push_back(*(*pCreateInfos)[j].ptr());
+            }
+            pPending->result = createGraphicsPipelines(remappedDevice, remappedPipelineCache, (uint32_t)createInfos.size(),
+                                                       createInfos.data(), NULL, pPending->replayPipelines.data());
+        });
+        m_pendingPipelines.push_back(pPending);
+        replayResult = VK_SUCCESS;
+    } else {
+        replayResult = m_vkFuncs.real_vkCreateGraphicsPipelines(remappedDevice, remappedPipelineCache, createInfoCount, pLocalCIs,
+                                                                NULL, local_pPipelines);
 
-    if (replayResult == VK_SUCCESS) {
-        for (i = 0; i < pPacket->createInfoCount; i++) {
-            m_objMapper.add_to_pipelines_map(pPacket->pPipelines[i], local_pPipelines[i]);
+        if (replayResult == VK_SUCCESS) {
+            for (i = 0; i < pPacket->createInfoCount; i++) {
+                m_objMapper.add_to_pipelines_map(pPacket->pPipelines[i], local_pPipelines[i]);
+            }
         }
     }
 
@@ -1540,7 +1700,7 @@ void vkReplay::manually_replay_vkCmdWaitEvents(packet_vkCmdWaitEvents *pPacket)
         return;
     }
 
-    VkEvent *saveEvent = VKTRACE_NEW_ARRAY(VkEvent, pPacket->eventCount);
+    VkEvent *saveEvent = VKTRACE_REPLAY_NEW_ARRAY(VkEvent, pPacket->eventCount);
     uint32_t idx = 0;
     uint32_t numRemapBuf = 0;
     uint32_t numRemapImg = 0;
@@ -1550,12 +1710,11 @@ void vkReplay::manually_replay_vkCmdWaitEvents(packet_vkCmdWaitEvents *pPacket)
         *pEvent = m_objMapper.remap_events(pPacket->pEvents[idx]);
         if (*pEvent == VK_NULL_HANDLE) {
             vktrace_LogError("Skipping vkCmdWaitEvents() due to invalid remapped VkEvent.");
-            VKTRACE_DELETE(saveEvent);
             return;
         }
     }
 
-    VkBuffer *saveBuf = VKTRACE_NEW_ARRAY(VkBuffer, pPacket->bufferMemoryBarrierCount);
+    VkBuffer *saveBuf = VKTRACE_REPLAY_NEW_ARRAY(VkBuffer, pPacket->bufferMemoryBarrierCount);
     for (idx = 0; idx < pPacket->bufferMemoryBarrierCount; idx++) {
         VkBufferMemoryBarrier *pNextBuf = (VkBufferMemoryBarrier *)&(pPacket->pBufferMemoryBarriers[idx]);
         saveBuf[numRemapBuf++] = pNextBuf->buffer;
@@ -1563,8 +1722,6 @@ void vkReplay::manually_replay_vkCmdWaitEvents(packet_vkCmdWaitEvents *pPacket)
         pNextBuf->buffer = m_objMapper.remap_buffers(pNextBuf->buffer);
         if (pNextBuf->buffer == VK_NULL_HANDLE) {
             vktrace_LogError("Skipping vkCmdWaitEvents() due to invalid remapped VkBuffer.");
-            VKTRACE_DELETE(saveEvent);
-            VKTRACE_DELETE(saveBuf);
             return;
         }
         replayDevice = replayBufferToDevice[pNextBuf->buffer];
@@ -1574,12 +1731,10 @@ void vkReplay::manually_replay_vkCmdWaitEvents(packet_vkCmdWaitEvents *pPacket)
             *((uint32_t *)&pPacket->pBufferMemoryBarriers[idx].srcQueueFamilyIndex) = dstReplayIdx;
         } else {
             vktrace_LogError("vkCmdWaitEvents failed, bad srcQueueFamilyIndex");
-            VKTRACE_DELETE(saveEvent);
-            VKTRACE_DELETE(saveBuf);
             return;
         }
     }
-    VkImage *saveImg = VKTRACE_NEW_ARRAY(VkImage, pPacket->imageMemoryBarrierCount);
+    VkImage *saveImg = VKTRACE_REPLAY_NEW_ARRAY(VkImage, pPacket->imageMemoryBarrierCount);
     for (idx = 0; idx < pPacket->imageMemoryBarrierCount; idx++) {
         VkImageMemoryBarrier *pNextImg = (VkImageMemoryBarrier *)&(pPacket->pImageMemoryBarriers[idx]);
         saveImg[numRemapImg++] = pNextImg->image;
@@ -1587,9 +1742,6 @@ void vkReplay::manually_replay_vkCmdWaitEvents(packet_vkCmdWaitEvents *pPacket)
         pNextImg->image = m_objMapper.remap_images(pNextImg->image);
         if (pNextImg->image == VK_NULL_HANDLE) {
             vktrace_LogError("Skipping vkCmdWaitEvents() due to invalid remapped VkImage.");
-            VKTRACE_DELETE(saveEvent);
-            VKTRACE_DELETE(saveBuf);
-            VKTRACE_DELETE(saveImg);
             return;
         }
         replayDevice = replayImageToDevice[pNextImg->image];
@@ -1599,9 +1751,6 @@ void vkReplay::manually_replay_vkCmdWaitEvents(packet_vkCmdWaitEvents *pPacket)
             *((uint32_t *)&pPacket->pImageMemoryBarriers[idx].srcQueueFamilyIndex) = dstReplayIdx;
         } else {
             vktrace_LogError("vkCmdWaitEvents failed, bad srcQueueFamilyIndex");
-            VKTRACE_DELETE(saveEvent);
-            VKTRACE_DELETE(saveBuf);
-            VKTRACE_DELETE(saveImg);
             return;
         }
     }
@@ -1622,9 +1771,6 @@ void vkReplay::manually_replay_vkCmdWaitEvents(packet_vkCmdWaitEvents *pPacket)
         VkEvent *pEvent = (VkEvent *)&(pPacket->pEvents[idx]);
         *pEvent = saveEvent[idx];
     }
-    VKTRACE_DELETE(saveEvent);
-    VKTRACE_DELETE(saveBuf);
-    VKTRACE_DELETE(saveImg);
     return;
 }
 
@@ -1641,8 +1787,8 @@ void vkReplay::manually_replay_vkCmdPipelineBarrier(packet_vkCmdPipelineBarrier
     uint32_t idx = 0;
     uint32_t numRemapBuf = 0;
     uint32_t numRemapImg = 0;
-    VkBuffer *saveBuf = VKTRACE_NEW_ARRAY(VkBuffer, pPacket->bufferMemoryBarrierCount);
-    VkImage *saveImg = VKTRACE_NEW_ARRAY(VkImage, pPacket->imageMemoryBarrierCount);
+    VkBuffer *saveBuf = VKTRACE_REPLAY_NEW_ARRAY(VkBuffer, pPacket->bufferMemoryBarrierCount);
+    VkImage *saveImg = VKTRACE_REPLAY_NEW_ARRAY(VkImage, pPacket->imageMemoryBarrierCount);
     for (idx = 0; idx < pPacket->bufferMemoryBarrierCount; idx++) {
         VkBufferMemoryBarrier *pNextBuf = (VkBufferMemoryBarrier *)&(pPacket->pBufferMemoryBarriers[idx]);
         saveBuf[numRemapBuf++] = pNextBuf->buffer;
@@ -1650,8 +1796,6 @@ void vkReplay::manually_replay_vkCmdPipelineBarrier(packet_vkCmdPipelineBarrier
         pNextBuf->buffer = m_objMapper.remap_buffers(pNextBuf->buffer);
         if (pNextBuf->buffer == VK_NULL_HANDLE && saveBuf[numRemapBuf - 1] != VK_NULL_HANDLE) {
             vktrace_LogError("Skipping vkCmdPipelineBarrier() due to invalid remapped VkBuffer.");
-            VKTRACE_DELETE(saveBuf);
-            VKTRACE_DELETE(saveImg);
             return;
         }
         replayDevice = replayBufferToDevice[pNextBuf->buffer];
@@ -1661,8 +1805,6 @@ void vkReplay::manually_replay_vkCmdPipelineBarrier(packet_vkCmdPipelineBarrier
             *((uint32_t *)&pPacket->pBufferMemoryBarriers[idx].srcQueueFamilyIndex) = dstReplayIdx;
         } else {
             vktrace_LogError("vkCmdPipelineBarrier failed, bad srcQueueFamilyIndex");
-            VKTRACE_DELETE(saveBuf);
-            VKTRACE_DELETE(saveImg);
             return;
         }
     }
@@ -1674,8 +1816,6 @@ void vkReplay::manually_replay_vkCmdPipelineBarrier(packet_vkCmdPipelineBarrier
         pNextImg->image = m_objMapper.remap_images(pNextImg->image);
         if (pNextImg->image == VK_NULL_HANDLE && saveImg[numRemapImg - 1] != VK_NULL_HANDLE) {
             vktrace_LogError("Skipping vkCmdPipelineBarrier() due to invalid remapped VkImage.");
-            VKTRACE_DELETE(saveBuf);
-            VKTRACE_DELETE(saveImg);
             return;
         }
         replayDevice = replayImageToDevice[pNextImg->image];
@@ -1685,8 +1825,6 @@ void vkReplay::manually_replay_vkCmdPipelineBarrier(packet_vkCmdPipelineBarrier
             *((uint32_t *)&pPacket->pImageMemoryBarriers[idx].srcQueueFamilyIndex) = dstReplayIdx;
         } else {
             vktrace_LogError("vkPipelineBarrier failed, bad srcQueueFamilyIndex");
-            VKTRACE_DELETE(saveBuf);
-            VKTRACE_DELETE(saveImg);
             return;
         }
     }
@@ -1703,8 +1841,6 @@ void vkReplay::manually_replay_vkCmdPipelineBarrier(packet_vkCmdPipelineBarrier
         VkImageMemoryBarrier *pNextImg = (VkImageMemoryBarrier *)&(pPacket->pImageMemoryBarriers[idx]);
         pNextImg->image = saveImg[idx];
     }
-    VKTRACE_DELETE(saveBuf);
-    VKTRACE_DELETE(saveImg);
     return;
 }
 
@@ -1746,6 +1882,9 @@ VkResult vkReplay::manually_replay_vkCreateFramebuffer(packet_vkCreateFramebuffe
 
     VkFramebuffer local_framebuffer;
     replayResult = m_vkFuncs.real_vkCreateFramebuffer(remappedDevice, pPacket->pCreateInfo, NULL, &local_framebuffer);
+    if (m_pFastForward != NULL && replayResult == VK_SUCCESS) {
+        m_pFastForward->add_framebuffer(local_framebuffer, pInfo->attachmentCount, pInfo->pAttachments);
+    }
     pInfo->pAttachments = pSavedAttachments;
     pInfo->renderPass = savedRP;
     if (replayResult == VK_SUCCESS) {
@@ -1793,6 +1932,13 @@ void vkReplay::manually_replay_vkCmdBeginRenderPass(packet_vkCmdBeginRenderPass
         vktrace_LogError("Skipping vkCmdBeginRenderPass() due to invalid remapped VkRenderPass.");
         return;
     }
+    if (m_pGpuTimestamps != NULL) {
+        m_pGpuTimestamps->begin_region(remappedCommandBuffer, vktrace_replay::GPU_TIMESTAMPS_RENDER_PASS,
+                                       pPacket->header->global_packet_index, NULL);
+    }
+    if (m_pFastForward != NULL) {
+        m_pFastForward->begin_render_pass(remappedCommandBuffer, local_renderPassBeginInfo.framebuffer);
+    }
     m_vkFuncs.real_vkCmdBeginRenderPass(remappedCommandBuffer, &local_renderPassBeginInfo, pPacket->contents);
     return;
 }
@@ -1820,10 +1966,21 @@ VkResult vkReplay::manually_replay_vkBeginCommandBuffer(packet_vkBeginCommandBuf
         *pFB = m_objMapper.remap_framebuffers(savedFB);
     }
     replayResult = m_vkFuncs.real_vkBeginCommandBuffer(remappedCommandBuffer, pPacket->pBeginInfo);
+    if (m_pFastForward != NULL && replayResult == VK_SUCCESS) {
+        m_pFastForward->begin_command_buffer(remappedCommandBuffer, pInfo != NULL ? pInfo->flags : 0,
+                                             pHinfo != NULL ? pHinfo->framebuffer : VK_NULL_HANDLE);
+    }
     if (pInfo != NULL && pHinfo != NULL) {
         pHinfo->renderPass = savedRP;
         pHinfo->framebuffer = savedFB;
     }
+    if (m_pGpuTimestamps != NULL && replayResult == VK_SUCCESS) {
+        m_pGpuTimestamps->begin_command_buffer(remappedCommandBuffer, pPacket->header->global_packet_index,
+                                               pInfo != NULL ? pInfo->flags : 0);
+    }
+    if (m_pAnnotations != NULL && replayResult == VK_SUCCESS) {
+        m_pAnnotations->begin_command_buffer(remappedCommandBuffer, m_frameNumber, pPacket->header->global_packet_index);
+    }
     return replayResult;
 }
 
@@ -1837,12 +1994,11 @@ VkResult vkReplay::manually_replay_vkWaitForFences(packet_vkWaitForFences *pPack
         return VK_ERROR_VALIDATION_FAILED_EXT;
     }
 
-    VkFence *pFence = VKTRACE_NEW_ARRAY(VkFence, pPacket->fenceCount);
+    VkFence *pFence = VKTRACE_REPLAY_NEW_ARRAY(VkFence, pPacket->fenceCount);
     for (i = 0; i < pPacket->fenceCount; i++) {
         (*(pFence + i)) = m_objMapper.remap_fences((*(pPacket->pFences + i)));
         if (*(pFence + i) == VK_NULL_HANDLE) {
             vktrace_LogError("Skipping vkWaitForFences() due to invalid remapped VkFence.");
-            VKTRACE_DELETE(pFence);
             return VK_ERROR_VALIDATION_FAILED_EXT;
         }
     }
@@ -1857,10 +2013,80 @@ VkResult vkReplay::manually_replay_vkWaitForFences(packet_vkWaitForFences *pPack
                 m_vkFuncs.real_vkWaitForFences(remappedDevice, pPacket->fenceCount, pFence, pPacket->waitAll, pPacket->timeout);
         }
     }
-    VKTRACE_DELETE(pFence);
     return replayResult;
 }
 
+// A run of polls that return VK_NOT_READY (VK_EVENT_RESET for events) and end with one that finds the fence, query or
+// event ready is replayed as a single blocking wait in place of the last poll. The polls that weren't ready have no
+// effect the replay depends on, so they are skipped even when no ready poll follows them.
+VkResult vkReplay::collapse_vkGetFenceStatus(packet_vkGetFenceStatus *pPacket) {
+    if (pPacket->result != VK_SUCCESS) {
+        m_skippedPolls++;
+        return pPacket->result;
+    }
+
+    VkDevice remappedDevice = m_objMapper.remap_devices(pPacket->device);
+    if (remappedDevice == VK_NULL_HANDLE) {
+        vktrace_LogError("Skipping vkGetFenceStatus() due to invalid remapped VkDevice.");
+        return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
+    VkFence remappedFence = m_objMapper.remap_fences(pPacket->fence);
+    if (remappedFence == VK_NULL_HANDLE) {
+        vktrace_LogError("Skipping vkGetFenceStatus() due to invalid remapped VkFence.");
+        return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
+    return m_vkFuncs.real_vkWaitForFences(remappedDevice, 1, &remappedFence, VK_TRUE, UINT64_MAX);
+}
+
+VkResult vkReplay::collapse_vkGetEventStatus(packet_vkGetEventStatus *pPacket) {
+    if (pPacket->result != VK_EVENT_SET) {
+        m_skippedPolls++;
+        return pPacket->result;
+    }
+
+    VkDevice remappedDevice = m_objMapper.remap_devices(pPacket->device);
+    if (remappedDevice == VK_NULL_HANDLE) {
+        vktrace_LogError("Skipping vkGetEventStatus() due to invalid remapped VkDevice.");
+        return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
+    VkEvent remappedEvent = m_objMapper.remap_events(pPacket->event);
+    if (remappedEvent == VK_NULL_HANDLE) {
+        vktrace_LogError("Skipping vkGetEventStatus() due to invalid remapped VkEvent.");
+        return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
+    // The host can't block on an event, so the one poll left spins until the event is set
+    VkResult replayResult;
+    do {
+        replayResult = m_vkFuncs.real_vkGetEventStatus(remappedDevice, remappedEvent);
+    } while (replayResult == VK_EVENT_RESET);
+    return replayResult;
+}
+
+VkResult vkReplay::collapse_vkGetQueryPoolResults(packet_vkGetQueryPoolResults *pPacket) {
+    if (pPacket->result == VK_NOT_READY) {
+        m_skippedPolls++;
+        return pPacket->result;
+    }
+
+    VkDevice remappedDevice = m_objMapper.remap_devices(pPacket->device);
+    if (remappedDevice == VK_NULL_HANDLE) {
+        vktrace_LogError("Skipping vkGetQueryPoolResults() due to invalid remapped VkDevice.");
+        return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
+    VkQueryPool remappedQueryPool = m_objMapper.remap_querypools(pPacket->queryPool);
+    if (remappedQueryPool == VK_NULL_HANDLE) {
+        vktrace_LogError("Skipping vkGetQueryPoolResults() due to invalid remapped VkQueryPool.");
+        return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
+    // All the queries were available when the trace got their results, so waiting for them gets the same ones
+    VkQueryResultFlags flags = pPacket->flags;
+    if (pPacket->result == VK_SUCCESS) {
+        flags = (flags | VK_QUERY_RESULT_WAIT_BIT) & ~VK_QUERY_RESULT_PARTIAL_BIT;
+    }
+    return m_vkFuncs.real_vkGetQueryPoolResults(remappedDevice, remappedQueryPool, pPacket->firstQuery, pPacket->queryCount,
+                                                pPacket->dataSize, pPacket->pData, pPacket->stride, flags);
+}
+
 bool vkReplay::getMemoryTypeIdx(VkDevice traceDevice, VkDevice replayDevice, uint32_t traceIdx,
                                 VkMemoryRequirements *memRequirements, uint32_t *pReplayIdx) {
     VkPhysicalDevice tracePhysicalDevice;
@@ -1926,6 +2152,90 @@ fail:
     return false;
 }
 
+// Walks the portability table once and works out, for every vkAllocateMemory, which bind call is the
+// first to use its memory and which create call makes the bound image or buffer, so replaying a
+// vkAllocateMemory for another GPU doesn't have to search the trace file.
+void vkReplay::build_portability_plan() {
+    struct UnboundAllocation {
+        uint64_t globalPacketIndex;
+        size_t tableIdx;
+    };
+    // Trace memory that hasn't been bound yet, and the table index of the latest create of each image/buffer
+    std::unordered_map<VkDeviceMemory, UnboundAllocation> unbound;
+    std::unordered_map<uint64_t, size_t> createIdx;
+    size_t saveFilePos = vktrace_FileLike_GetCurrentPosition(traceFile);
+
+    m_portabilityPlanBuilt = true;
+    for (size_t i = 0; i < portabilityTable.size(); i++) {
+        vktrace_trace_packet_header packetHeader;
+        if (!vktrace_FileLike_SetCurrentPosition(traceFile, portabilityTable[i]) ||
+            !vktrace_FileLike_ReadRaw(traceFile, &packetHeader, sizeof(packetHeader))) {
+            vktrace_LogError("Failed to read the portability table entries of the trace file.");
+            break;
+        }
+
+        switch (packetHeader.packet_id) {
+            case VKTRACE_TPI_VK_vkAllocateMemory: {
+                // The returned memory handle is at the end of the packet
+                VkDeviceMemory memory;
+                if (vktrace_FileLike_SetCurrentPosition(traceFile,
+                                                        portabilityTable[i] + packetHeader.size - sizeof(VkDeviceMemory *)) &&
+                    vktrace_FileLike_ReadRaw(traceFile, &memory, sizeof(memory))) {
+                    PortableAllocation allocation = {0, 0, false};
+                    m_portabilityPlan[packetHeader.global_packet_index] = allocation;
+                    UnboundAllocation pending = {packetHeader.global_packet_index, i};
+                    unbound[memory] = pending;
+                }
+                break;
+            }
+            case VKTRACE_TPI_VK_vkBindImageMemory:
+            case VKTRACE_TPI_VK_vkBindBufferMemory: {
+                packet_vkBindImageMemory bimPacket;
+                if (!vktrace_FileLike_ReadRaw(traceFile, &bimPacket, sizeof(bimPacket))) break;
+                auto it = unbound.find(bimPacket.memory);
+                if (it == unbound.end()) break;
+                PortableAllocation &allocation = m_portabilityPlan[it->second.globalPacketIndex];
+                allocation.bindIdx = i;
+                // Only a create after the vkAllocateMemory has to be replayed early
+                auto createIt = createIdx.find((uint64_t)bimPacket.image);
+                if (createIt != createIdx.end() && createIt->second > it->second.tableIdx) {
+                    allocation.createIdx = createIt->second;
+                }
+                unbound.erase(it);
+                break;
+            }
+            case VKTRACE_TPI_VK_vkFreeMemory: {
+                packet_vkFreeMemory freeMemoryPacket;
+                if (!vktrace_FileLike_ReadRaw(traceFile, &freeMemoryPacket, sizeof(freeMemoryPacket))) break;
+                auto it = unbound.find(freeMemoryPacket.memory);
+                if (it == unbound.end()) break;
+                m_portabilityPlan[it->second.globalPacketIndex].freedUnbound = true;
+                unbound.erase(it);
+                break;
+            }
+            case VKTRACE_TPI_VK_vkCreateImage:
+            case VKTRACE_TPI_VK_vkCreateBuffer: {
+                // We rely on the fact that packet_vkCreateBuffer has the same layout
+                packet_vkCreateImage createPacket;
+                uint64_t handle;
+                if (!vktrace_FileLike_ReadRaw(traceFile, &createPacket, sizeof(createPacket))) break;
+                uint64_t handleOffset = (uint64_t)(uintptr_t)createPacket.pImage;
+                if (handleOffset == 0 || (handleOffset & VKTRACE_BLOB_REFERENCE_BIT)) break;
+                if (vktrace_FileLike_SetCurrentPosition(traceFile, portabilityTable[i] + sizeof(packetHeader) + handleOffset) &&
+                    vktrace_FileLike_ReadRaw(traceFile, &handle, sizeof(handle))) {
+                    createIdx[handle] = i;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    vktrace_FileLike_SetCurrentPosition(traceFile, saveFilePos);
+    vktrace_LogVerbose("Planned memory type translation for %" PRIu64 " vkAllocateMemory calls.", (uint64_t)m_portabilityPlan.size());
+}
+
 #define FSEEK(_stream, _offset, _whence)                                                               \
     assert(_whence == SEEK_SET);                                                                       \
     if (!vktrace_FileLike_SetCurrentPosition(_stream, _offset)) {                                      \
@@ -1940,20 +2250,56 @@ fail:
         goto wrapItUp;                                                                                 \
     }
 
+vktrace_replay::VKTRACE_REPLAY_RESULT vkReplay::replay_gpu_timing(vktrace_trace_packet_header *packet) {
+    const vktrace_gpu_timing *pPacket = (const vktrace_gpu_timing *)packet->pBody;
+    if (m_pGpuTimestamps != NULL) {
+        m_pGpuTimestamps->add_capture_time(pPacket->frame, pPacket->beginPacketIndex, pPacket->gpuTime);
+    }
+    return vktrace_replay::VKTRACE_REPLAY_SUCCESS;
+}
+
+void vkReplay::annotate(vktrace_trace_packet_header *packet) {
+    const char *pName = "command block";
+    if (packet->packet_id != VKTRACE_TPI_CMD_BLOCK) {
+        pName = vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)packet->packet_id);
+        // The trace's own debug markers are replayed as they are
+        if (pName == NULL || strncmp(pName, "vkCmd", 5) != 0 || strncmp(pName, "vkCmdDebugMarker", 16) == 0) return;
+    }
+    // Recording calls, and command blocks, start with the command buffer after the body's pointer to the header
+    VkCommandBuffer commandBuffer;
+    memcpy(&commandBuffer, (const uint8_t *)packet->pBody + sizeof(vktrace_trace_packet_header *), sizeof(commandBuffer));
+    m_pAnnotations->tag(m_objMapper.remap_commandbuffers(commandBuffer), packet->global_packet_index, pName);
+}
+
+vktrace_replay::VKTRACE_REPLAY_RESULT vkReplay::replay_query_digest(vktrace_trace_packet_header *packet) {
+    // Only memory requirements are kept, for placing allocations. The other queries would return what the replay device
+    // supports, which the trace's calls don't depend on.
+    const vktrace_query_digest *pPacket = (const vktrace_query_digest *)packet->pBody;
+    VkMemoryRequirements memoryRequirements;
+    if (pPacket->callId == VKTRACE_TPI_VK_vkGetBufferMemoryRequirements) {
+        packet_vkGetBufferMemoryRequirements query = {packet, (VkDevice)(uintptr_t)pPacket->dispatchable, (VkBuffer)pPacket->object,
+                                                      &memoryRequirements};
+        manually_replay_vkGetBufferMemoryRequirements(&query);
+    } else if (pPacket->callId == VKTRACE_TPI_VK_vkGetImageMemoryRequirements) {
+        packet_vkGetImageMemoryRequirements query = {packet, (VkDevice)(uintptr_t)pPacket->dispatchable, (VkImage)pPacket->object,
+                                                     &memoryRequirements};
+        manually_replay_vkGetImageMemoryRequirements(&query);
+    }
+    return vktrace_replay::VKTRACE_REPLAY_SUCCESS;
+}
+
 VkResult vkReplay::manually_replay_vkAllocateMemory(packet_vkAllocateMemory *pPacket) {
     VkResult replayResult = VK_ERROR_VALIDATION_FAILED_EXT;
     devicememoryObj local_mem;
+    local_mem.replayOffset = 0;
+    local_mem.suballocated = false;
     VkMemoryRequirements memRequirements;
     uint32_t replayMemTypeIndex;
     vktrace_trace_packet_header packetHeader1;
-    VkDeviceMemory traceAllocateMemoryRval;
     packet_vkBindImageMemory bimPacket;              // We rely on the fact that packet_vkBindBufferMemory is the same size
-    packet_vkFreeMemory freeMemoryPacket;
-    bool foundBindMem;
     VkImage remappedImage = VK_NULL_HANDLE;
     size_t saveFilePos = 0;
     bool doAllocate = true;
-    size_t bindMemIdx;
 
     VkDevice remappedDevice = m_objMapper.remap_devices(pPacket->device);
     if (remappedDevice == VK_NULL_HANDLE) {
@@ -1988,136 +2334,91 @@ VkResult vkReplay::manually_replay_vkAllocateMemory(packet_vkAllocateMemory *pPa
     }
 
     if (m_pFileHeader->portability_table_valid && m_platformMatch != 1) {
-        size_t amIdx;
-        static size_t amSearchPos = 0;
+        if (!m_portabilityPlanBuilt) {
+            build_portability_plan();
+        }
 
         // Save current file position so we can restore it
         saveFilePos = vktrace_FileLike_GetCurrentPosition(traceFile);
 
-        // First find this vkAM call in portabilityTable
         pPacket->header = (vktrace_trace_packet_header *)((PBYTE)pPacket - sizeof(vktrace_trace_packet_header));
-        for (amIdx = amSearchPos; amIdx < portabilityTable.size(); amIdx++) {
-            FSEEK(traceFile, (long)portabilityTable[amIdx], SEEK_SET);
-            FREAD(&packetHeader1, sizeof(vktrace_trace_packet_header), 1, traceFile);  // Read the packet header
-
-            if (packetHeader1.global_packet_index == pPacket->header->global_packet_index &&
-                packetHeader1.packet_id == VKTRACE_TPI_VK_vkAllocateMemory) {
-                // Found it
-                // Save away the vkAM return val from the trace file
-                traceAllocateMemoryRval =
-                    *((VkDeviceMemory *)((PBYTE)pPacket->header + pPacket->header->size - sizeof(VkDeviceMemory *)));
-
-                // Save the index where we will start the next search for vkAM
-                amSearchPos = amIdx + 1;
-                break;
-            }
-        }
-        if (amIdx == portabilityTable.size()) {
+        std::unordered_map<uint64_t, PortableAllocation>::const_iterator it =
+            m_portabilityPlan.find(pPacket->header->global_packet_index);
+        if (it == m_portabilityPlan.end()) {
             // Didn't find the current vkAM packet, something is wrong with the trace file.
             // Just use the index from the trace file and attempt to continue.
             vktrace_LogError("Replay of vkAllocateMemory() failed, trace file may be corrupt.");
             goto wrapItUp;
         }
+        const PortableAllocation &allocation = it->second;
 
-        // Search forward from amIdx for vkBIM/vkBBM call that binds this memory.
-        // If we don't find one, generate an error and do the best we can.
-        foundBindMem = false;
-        for (size_t i = amIdx + 1; !foundBindMem && i < portabilityTable.size(); i++) {
-            FSEEK(traceFile, (long)portabilityTable[i], SEEK_SET);
-            FREAD(&packetHeader1, sizeof(vktrace_trace_packet_header), 1, traceFile);  // Read the packet header
-
-            if (packetHeader1.packet_id == VKTRACE_TPI_VK_vkBindImageMemory ||
-                packetHeader1.packet_id == VKTRACE_TPI_VK_vkBindBufferMemory) {
-                assert(packetHeader1.size == sizeof(packetHeader1) + sizeof(bimPacket));
-                FREAD(&bimPacket, sizeof(bimPacket), 1, traceFile);
-            }
-
-            if (packetHeader1.packet_id == VKTRACE_TPI_VK_vkFreeMemory) {
-                FREAD(&freeMemoryPacket, sizeof(freeMemoryPacket), 1, traceFile);
-                if (freeMemoryPacket.memory == traceAllocateMemoryRval) {
-                    // Found a free of this memory, end the forward search
-                    vktrace_LogWarning("Memory allocated by vkAllocateMemory is not used.");
-                    break;
-                }
-            }
-
-            if (traceAllocateMemoryRval == bimPacket.memory) {
-                // A vkBIM/vkBBM binds memory allocated by this vkAM call.
-                foundBindMem = true;
-                bindMemIdx = i;
-                if (packetHeader1.packet_id == VKTRACE_TPI_VK_vkBindImageMemory)
-                    remappedImage = m_objMapper.remap_images(bimPacket.image);
-                if (packetHeader1.packet_id == VKTRACE_TPI_VK_vkBindBufferMemory)
-                    remappedImage = (VkImage)m_objMapper.remap_buffers((VkBuffer)bimPacket.image);
-            }
-        }
-
-        if (!foundBindMem) {
+        if (allocation.bindIdx == 0) {
             // Didn't find vkBind{Image|Buffer}Memory call for this vkAllocateMemory.
             // This isn't an error - the memory is allocated but never used.
             // So just use the index from the trace file and continue.
+            if (allocation.freedUnbound) {
+                vktrace_LogWarning("Memory allocated by vkAllocateMemory is not used.");
+            }
             goto wrapItUp;
         }
 
+        FSEEK(traceFile, portabilityTable[allocation.bindIdx], SEEK_SET);
+        FREAD(&packetHeader1, sizeof(vktrace_trace_packet_header), 1, traceFile);  // Read the packet header
+        assert(packetHeader1.size == sizeof(packetHeader1) + sizeof(bimPacket));
+        FREAD(&bimPacket, sizeof(bimPacket), 1, traceFile);
+        if (packetHeader1.packet_id == VKTRACE_TPI_VK_vkBindImageMemory) {
+            remappedImage = m_objMapper.remap_images(bimPacket.image);
+        } else {
+            remappedImage = (VkImage)m_objMapper.remap_buffers((VkBuffer)bimPacket.image);
+        }
+
         if (!remappedImage) {
-            // The CreateImage/Buffer command after the AllocMem command, so the image/buffer hasn't
-            // been created yet. Search backwards from the bindMem cmd for the CreateImage/Buffer
-            // command and execute it
-            for (size_t i = bindMemIdx - 1; true; i--) {
-                vktrace_trace_packet_header createPacketHeaderHeader;
-                vktrace_trace_packet_header *pCreatePacketFull;
-                packet_vkCreateImage *pCreatePacket;
-                FSEEK(traceFile, (long)portabilityTable[i], SEEK_SET);
-                FREAD(&createPacketHeaderHeader, sizeof(vktrace_trace_packet_header), 1, traceFile);
-                if ((packetHeader1.packet_id == VKTRACE_TPI_VK_vkBindImageMemory &&
-                     createPacketHeaderHeader.packet_id == VKTRACE_TPI_VK_vkCreateImage) ||
-                    (packetHeader1.packet_id == VKTRACE_TPI_VK_vkBindBufferMemory &&
-                     createPacketHeaderHeader.packet_id == VKTRACE_TPI_VK_vkCreateBuffer)) {
-                    // Read the whole packet
-                    pCreatePacketFull = (vktrace_trace_packet_header *)vktrace_malloc(createPacketHeaderHeader.size);
-                    if (!pCreatePacketFull) {
-                        vktrace_LogError("malloc failed during vkAllocateMemory()");
-                        vktrace_FileLike_SetCurrentPosition(traceFile, saveFilePos);
-                        return VK_ERROR_OUT_OF_HOST_MEMORY;
-                    }
-                    FSEEK(traceFile, (long)portabilityTable[i], SEEK_SET);
-                    FREAD(pCreatePacketFull, createPacketHeaderHeader.size, 1, traceFile);
-                    pCreatePacket = (packet_vkCreateImage *)(pCreatePacketFull + 1);
-                    pCreatePacket->header = pCreatePacketFull;
-                    pCreatePacketFull->pBody = (uintptr_t)pCreatePacket;
-                    pCreatePacket->pImage = (VkImage *)vktrace_trace_packet_interpret_buffer_pointer(
-                        pCreatePacketFull, (intptr_t)pCreatePacket->pImage);
-                    pCreatePacket->pCreateInfo = (VkImageCreateInfo *)vktrace_trace_packet_interpret_buffer_pointer(
-                        pCreatePacketFull, (intptr_t)pCreatePacket->pCreateInfo);
-                    pCreatePacket->pAllocator = (VkAllocationCallbacks *)vktrace_trace_packet_interpret_buffer_pointer(
-                        pCreatePacketFull, (intptr_t)pCreatePacket->pAllocator);
-                    if (*(pCreatePacket->pImage) == bimPacket.image) {
-                        // Create the image/buffer
-                        if (createPacketHeaderHeader.packet_id == VKTRACE_TPI_VK_vkCreateBuffer)
-                            replayResult = manually_replay_vkCreateBuffer((packet_vkCreateBuffer *)pCreatePacket);
-                        else
-                            replayResult = manually_replay_vkCreateImage((packet_vkCreateImage *)pCreatePacket);
-                        vktrace_free(pCreatePacketFull);
-                        if (replayResult != VK_SUCCESS) {
-                            vktrace_LogError("vkCreateBuffer/Image failed during vkAllocateMemory()");
-                            vktrace_FileLike_SetCurrentPosition(traceFile, saveFilePos);
-                            return replayResult;
-                        }
-                        if (packetHeader1.packet_id == VKTRACE_TPI_VK_vkBindImageMemory)
-                            remappedImage = m_objMapper.remap_images(bimPacket.image);
-                        else
-                            remappedImage = (VkImage)m_objMapper.remap_buffers((VkBuffer)bimPacket.image);
-                        break;
-                    }
-                    vktrace_free(pCreatePacketFull);
-                }
-                if (i == amIdx) {
-                    // This image/buffer is not created before it is bound
-                    vktrace_LogError("Bad buffer/image in call to vkBindImageMemory/vkBindBuffer");
-                    vktrace_FileLike_SetCurrentPosition(traceFile, saveFilePos);
-                    return VK_ERROR_VALIDATION_FAILED_EXT;
-                }
+            // The CreateImage/Buffer command is after the AllocMem command, so the image/buffer hasn't
+            // been created yet. Execute it now.
+            vktrace_trace_packet_header createPacketHeaderHeader;
+            vktrace_trace_packet_header *pCreatePacketFull;
+            packet_vkCreateImage *pCreatePacket;
+            if (allocation.createIdx == 0) {
+                // This image/buffer is not created before it is bound
+                vktrace_LogError("Bad buffer/image in call to vkBindImageMemory/vkBindBuffer");
+                vktrace_FileLike_SetCurrentPosition(traceFile, saveFilePos);
+                return VK_ERROR_VALIDATION_FAILED_EXT;
+            }
+            FSEEK(traceFile, portabilityTable[allocation.createIdx], SEEK_SET);
+            FREAD(&createPacketHeaderHeader, sizeof(vktrace_trace_packet_header), 1, traceFile);
+            // Read the whole packet
+            pCreatePacketFull = (vktrace_trace_packet_header *)vktrace_malloc(createPacketHeaderHeader.size);
+            if (!pCreatePacketFull) {
+                vktrace_LogError("malloc failed during vkAllocateMemory()");
+                vktrace_FileLike_SetCurrentPosition(traceFile, saveFilePos);
+                return VK_ERROR_OUT_OF_HOST_MEMORY;
             }
+            FSEEK(traceFile, portabilityTable[allocation.createIdx], SEEK_SET);
+            FREAD(pCreatePacketFull, createPacketHeaderHeader.size, 1, traceFile);
+            pCreatePacket = (packet_vkCreateImage *)(pCreatePacketFull + 1);
+            pCreatePacket->header = pCreatePacketFull;
+            pCreatePacketFull->pBody = (uintptr_t)pCreatePacket;
+            pCreatePacket->pImage =
+                (VkImage *)vktrace_trace_packet_interpret_buffer_pointer(pCreatePacketFull, (intptr_t)pCreatePacket->pImage);
+            pCreatePacket->pCreateInfo = (VkImageCreateInfo *)vktrace_trace_packet_interpret_buffer_pointer(
+                pCreatePacketFull, (intptr_t)pCreatePacket->pCreateInfo);
+            pCreatePacket->pAllocator = (VkAllocationCallbacks *)vktrace_trace_packet_interpret_buffer_pointer(
+                pCreatePacketFull, (intptr_t)pCreatePacket->pAllocator);
+            // Create the image/buffer
+            if (createPacketHeaderHeader.packet_id == VKTRACE_TPI_VK_vkCreateBuffer)
+                replayResult = manually_replay_vkCreateBuffer((packet_vkCreateBuffer *)pCreatePacket);
+            else
+                replayResult = manually_replay_vkCreateImage((packet_vkCreateImage *)pCreatePacket);
+            vktrace_free(pCreatePacketFull);
+            if (replayResult != VK_SUCCESS) {
+                vktrace_LogError("vkCreateBuffer/Image failed during vkAllocateMemory()");
+                vktrace_FileLike_SetCurrentPosition(traceFile, saveFilePos);
+                return replayResult;
+            }
+            if (packetHeader1.packet_id == VKTRACE_TPI_VK_vkBindImageMemory)
+                remappedImage = m_objMapper.remap_images(bimPacket.image);
+            else
+                remappedImage = (VkImage)m_objMapper.remap_buffers((VkBuffer)bimPacket.image);
         }
 
         // Call GIMR/GBMR for the replay image/buffer
@@ -2134,6 +2435,9 @@ VkResult vkReplay::manually_replay_vkAllocateMemory(packet_vkAllocateMemory *pPa
             }
             memRequirements = replayGetBufferMemoryRequirements[(VkBuffer)remappedImage];
         }
+        if (m_pMemorySuballocator != NULL) {
+            m_pMemorySuballocator->add_requirements(remappedDevice, memRequirements);
+        }
 
         VkDeviceSize replayAllocationSize = memRequirements.size;
         if (bimPacket.memoryOffset > 0) {
@@ -2171,7 +2475,15 @@ VkResult vkReplay::manually_replay_vkAllocateMemory(packet_vkAllocateMemory *pPa
 wrapItUp:
 
     if (doAllocate) {
-        replayResult = m_vkFuncs.real_vkAllocateMemory(remappedDevice, pPacket->pAllocateInfo, NULL, &local_mem.replayDeviceMemory);
+        local_mem.suballocated = m_pMemorySuballocator != NULL &&
+                                 m_pMemorySuballocator->allocate(remappedDevice, pPacket->pAllocateInfo,
+                                                                 &local_mem.replayDeviceMemory, &local_mem.replayOffset);
+        if (local_mem.suballocated) {
+            replayResult = VK_SUCCESS;
+        } else {
+            replayResult =
+                m_vkFuncs.real_vkAllocateMemory(remappedDevice, pPacket->pAllocateInfo, NULL, &local_mem.replayDeviceMemory);
+        }
     }
 
     if (saveFilePos) {
@@ -2182,6 +2494,9 @@ wrapItUp:
         local_mem.pGpuMem = new (gpuMemory);
         if (local_mem.pGpuMem) local_mem.pGpuMem->setAllocInfo(pPacket->pAllocateInfo, m_objMapper.m_adjustForGPU);
         m_objMapper.add_to_devicememorys_map(*(pPacket->pMemory), local_mem);
+        if (replayResult == VK_SUCCESS) {
+            replayDeviceMemoryToDevice[local_mem.replayDeviceMemory] = remappedDevice;
+        }
     } else {
         vktrace_LogError("Allocate Memory 0x%lX failed with result = 0x%X\n", *(pPacket->pMemory), replayResult);
     }
@@ -2202,9 +2517,64 @@ void vkReplay::manually_replay_vkFreeMemory(packet_vkFreeMemory *pPacket) {
     devicememoryObj local_mem;
     local_mem = m_objMapper.m_devicememorys.find(pPacket->memory)->second;
     // TODO how/when to free pendingAlloc that did not use and existing devicememoryObj
-    m_vkFuncs.real_vkFreeMemory(remappedDevice, local_mem.replayDeviceMemory, NULL);
+    auto snapshot = loopMemorySnapshots.find(pPacket->memory);
+    if (snapshot != loopMemorySnapshots.end()) {
+        release_loop_memory(snapshot->second);
+        loopMemorySnapshots.erase(snapshot);
+    }
+    if (local_mem.suballocated) {
+        // The block may still hold other allocations
+        m_pMemorySuballocator->free(local_mem.replayDeviceMemory, local_mem.replayOffset);
+    } else {
+        replayDeviceMemoryToDevice.erase(local_mem.replayDeviceMemory);
+        m_vkFuncs.real_vkFreeMemory(remappedDevice, local_mem.replayDeviceMemory, NULL);
+    }
     delete local_mem.pGpuMem;
     m_objMapper.rm_from_devicememorys_map(pPacket->memory);
+    m_sparseBindings.forget_memory(pPacket->memory);
+}
+
+void vkReplay::forget_unused_objects(uint64_t packetIndex) {
+    if (m_pLifetimes == NULL) return;
+    uint32_t count;
+    const vktrace_replay::TraceLifetimes::Object *pObjects = m_pLifetimes->released_at(packetIndex, &count);
+    // The real objects stay, the trace doesn't destroy them, only what replay keeps to find them goes
+    for (uint32_t i = 0; i < count; i++) {
+        switch (pObjects[i].type) {
+            case vktrace_replay::TraceLifetimes::OBJECT_BUFFER: {
+                VkBuffer traceBuffer = (VkBuffer)pObjects[i].handle;
+                VkBuffer replayBuffer = m_objMapper.remap_buffers(traceBuffer);
+                replayGetBufferMemoryRequirements.erase(replayBuffer);
+                replayBufferToDevice.erase(replayBuffer);
+                traceBufferToDevice.erase(traceBuffer);
+                m_objMapper.rm_from_buffers_map(traceBuffer);
+                m_sparseBindings.forget_resource(pObjects[i].handle);
+                break;
+            }
+            case vktrace_replay::TraceLifetimes::OBJECT_IMAGE: {
+                VkImage traceImage = (VkImage)pObjects[i].handle;
+                VkImage replayImage = m_objMapper.remap_images(traceImage);
+                replayGetImageMemoryRequirements.erase(replayImage);
+                replayImageToDevice.erase(replayImage);
+                traceImageToDevice.erase(traceImage);
+                m_objMapper.rm_from_images_map(traceImage);
+                m_sparseBindings.forget_resource(pObjects[i].handle);
+                break;
+            }
+            case vktrace_replay::TraceLifetimes::OBJECT_MEMORY: {
+                VkDeviceMemory traceMemory = (VkDeviceMemory)pObjects[i].handle;
+                auto it = m_objMapper.m_devicememorys.find(traceMemory);
+                if (it != m_objMapper.m_devicememorys.end()) {
+                    // Along with the ranges the trace mapped
+                    delete it->second.pGpuMem;
+                    m_objMapper.m_devicememorys.erase(it);
+                }
+                m_sparseBindings.forget_memory(traceMemory);
+                break;
+            }
+        }
+    }
+    m_forgottenObjects += count;
 }
 
 VkResult vkReplay::manually_replay_vkMapMemory(packet_vkMapMemory *pPacket) {
@@ -2219,8 +2589,14 @@ VkResult vkReplay::manually_replay_vkMapMemory(packet_vkMapMemory *pPacket) {
     devicememoryObj local_mem = m_objMapper.m_devicememorys.find(pPacket->memory)->second;
     void *pData;
     if (!local_mem.pGpuMem->isPendingAlloc()) {
-        replayResult = m_vkFuncs.real_vkMapMemory(remappedDevice, local_mem.replayDeviceMemory, pPacket->offset, pPacket->size,
-                                                  pPacket->flags, &pData);
+        if (local_mem.suballocated) {
+            // Blocks stay mapped
+            pData = m_pMemorySuballocator->map(local_mem.replayDeviceMemory, local_mem.replayOffset + pPacket->offset);
+            replayResult = pData != NULL ? VK_SUCCESS : VK_ERROR_MEMORY_MAP_FAILED;
+        } else {
+            replayResult = m_vkFuncs.real_vkMapMemory(remappedDevice, local_mem.replayDeviceMemory, pPacket->offset, pPacket->size,
+                                                      pPacket->flags, &pData);
+        }
         if (replayResult == VK_SUCCESS) {
             if (local_mem.pGpuMem) {
                 local_mem.pGpuMem->setMemoryMapRange(pData, (size_t)pPacket->size, (size_t)pPacket->offset, false);
@@ -2243,11 +2619,14 @@ void vkReplay::manually_replay_vkUnmapMemory(packet_vkUnmapMemory *pPacket) {
 
     devicememoryObj local_mem = m_objMapper.m_devicememorys.find(pPacket->memory)->second;
     if (!local_mem.pGpuMem->isPendingAlloc()) {
-        if (local_mem.pGpuMem) {
+        // Nothing reads the memory when only validating
+        if (local_mem.pGpuMem && g_pReplaySettings->validateOnly == NULL) {
             if (pPacket->pData)
                 local_mem.pGpuMem->copyMappingData(pPacket->pData, true, 0, 0);  // copies data from packet into memory buffer
         }
-        m_vkFuncs.real_vkUnmapMemory(remappedDevice, local_mem.replayDeviceMemory);
+        if (!local_mem.suballocated) {
+            m_vkFuncs.real_vkUnmapMemory(remappedDevice, local_mem.replayDeviceMemory);
+        }
     } else {
         if (local_mem.pGpuMem) {
             unsigned char *pBuf = (unsigned char *)vktrace_malloc(local_mem.pGpuMem->getMemoryMapSize());
@@ -2282,22 +2661,24 @@ VkResult vkReplay::manually_replay_vkFlushMappedMemoryRanges(packet_vkFlushMappe
         return VK_ERROR_VALIDATION_FAILED_EXT;
     }
 
-    VkMappedMemoryRange *localRanges = VKTRACE_NEW_ARRAY(VkMappedMemoryRange, pPacket->memoryRangeCount);
+    VkMappedMemoryRange *localRanges = VKTRACE_REPLAY_NEW_ARRAY(VkMappedMemoryRange, pPacket->memoryRangeCount);
     memcpy(localRanges, pPacket->pMemoryRanges, sizeof(VkMappedMemoryRange) * (pPacket->memoryRangeCount));
 
-    devicememoryObj *pLocalMems = VKTRACE_NEW_ARRAY(devicememoryObj, pPacket->memoryRangeCount);
+    devicememoryObj *pLocalMems = VKTRACE_REPLAY_NEW_ARRAY(devicememoryObj, pPacket->memoryRangeCount);
     for (uint32_t i = 0; i < pPacket->memoryRangeCount; i++) {
         pLocalMems[i] = m_objMapper.m_devicememorys.find(pPacket->pMemoryRanges[i].memory)->second;
         localRanges[i].memory = m_objMapper.remap_devicememorys(pPacket->pMemoryRanges[i].memory);
         if (localRanges[i].memory == VK_NULL_HANDLE || pLocalMems[i].pGpuMem == NULL) {
             vktrace_LogError("Skipping vkFlushMappedMemoryRanges() due to invalid remapped VkDeviceMemory.");
-            VKTRACE_DELETE(localRanges);
-            VKTRACE_DELETE(pLocalMems);
             return VK_ERROR_VALIDATION_FAILED_EXT;
         }
+        if (pLocalMems[i].suballocated) {
+            m_pMemorySuballocator->translate_range(pLocalMems[i].replayOffset,
+                                                   pLocalMems[i].pGpuMem->getAllocInfo().allocationSize, &localRanges[i]);
+        }
 
         if (!pLocalMems[i].pGpuMem->isPendingAlloc()) {
-            if (pPacket->pMemoryRanges[i].size != 0) {
+            if (pPacket->pMemoryRanges[i].size != 0 && g_pReplaySettings->validateOnly == NULL) {
 #ifdef USE_PAGEGUARD_SPEEDUP
                 if (vktrace_check_min_version(VKTRACE_TRACE_FILE_VERSION_5))
                     pLocalMems[i].pGpuMem->copyMappingDataPageGuard(pPacket->ppData[i]);
@@ -2337,9 +2718,6 @@ VkResult vkReplay::manually_replay_vkFlushMappedMemoryRanges(packet_vkFlushMappe
         replayResult = m_vkFuncs.real_vkFlushMappedMemoryRanges(remappedDevice, pPacket->memoryRangeCount, localRanges);
     }
 
-    VKTRACE_DELETE(localRanges);
-    VKTRACE_DELETE(pLocalMems);
-
     return replayResult;
 }
 
@@ -2354,22 +2732,24 @@ VkResult vkReplay::manually_replay_vkInvalidateMappedMemoryRanges(packet_vkInval
         return VK_ERROR_VALIDATION_FAILED_EXT;
     }
 
-    VkMappedMemoryRange *localRanges = VKTRACE_NEW_ARRAY(VkMappedMemoryRange, pPacket->memoryRangeCount);
+    VkMappedMemoryRange *localRanges = VKTRACE_REPLAY_NEW_ARRAY(VkMappedMemoryRange, pPacket->memoryRangeCount);
     memcpy(localRanges, pPacket->pMemoryRanges, sizeof(VkMappedMemoryRange) * (pPacket->memoryRangeCount));
 
-    devicememoryObj *pLocalMems = VKTRACE_NEW_ARRAY(devicememoryObj, pPacket->memoryRangeCount);
+    devicememoryObj *pLocalMems = VKTRACE_REPLAY_NEW_ARRAY(devicememoryObj, pPacket->memoryRangeCount);
     for (uint32_t i = 0; i < pPacket->memoryRangeCount; i++) {
         pLocalMems[i] = m_objMapper.m_devicememorys.find(pPacket->pMemoryRanges[i].memory)->second;
         localRanges[i].memory = m_objMapper.remap_devicememorys(pPacket->pMemoryRanges[i].memory);
         if (localRanges[i].memory == VK_NULL_HANDLE || pLocalMems[i].pGpuMem == NULL) {
             vktrace_LogError("Skipping vkInvalidsateMappedMemoryRanges() due to invalid remapped VkDeviceMemory.");
-            VKTRACE_DELETE(localRanges);
-            VKTRACE_DELETE(pLocalMems);
             return VK_ERROR_VALIDATION_FAILED_EXT;
         }
+        if (pLocalMems[i].suballocated) {
+            m_pMemorySuballocator->translate_range(pLocalMems[i].replayOffset,
+                                                   pLocalMems[i].pGpuMem->getAllocInfo().allocationSize, &localRanges[i]);
+        }
 
         if (!pLocalMems[i].pGpuMem->isPendingAlloc()) {
-            if (pPacket->pMemoryRanges[i].size != 0) {
+            if (pPacket->pMemoryRanges[i].size != 0 && g_pReplaySettings->validateOnly == NULL) {
                 pLocalMems[i].pGpuMem->copyMappingData(pPacket->ppData[i], false, (size_t)pPacket->pMemoryRanges[i].size,
                                                        (size_t)pPacket->pMemoryRanges[i].offset);
             }
@@ -2386,9 +2766,6 @@ VkResult vkReplay::manually_replay_vkInvalidateMappedMemoryRanges(packet_vkInval
 
     replayResult = m_vkFuncs.real_vkInvalidateMappedMemoryRanges(remappedDevice, pPacket->memoryRangeCount, localRanges);
 
-    VKTRACE_DELETE(localRanges);
-    VKTRACE_DELETE(pLocalMems);
-
     return replayResult;
 }
 
@@ -2418,6 +2795,11 @@ VkResult vkReplay::manually_replay_vkGetPhysicalDeviceSurfaceSupportKHR(packet_v
         return VK_ERROR_VALIDATION_FAILED_EXT;
     }
 
+    // Headless swapchains take what the trace got for its surface
+    if (m_pHeadlessSwapchains != NULL) {
+        return pPacket->result;
+    }
+
     replayResult = m_vkFuncs.real_vkGetPhysicalDeviceSurfaceSupportKHR(remappedphysicalDevice, pPacket->queueFamilyIndex,
                                                                        remappedSurfaceKHR, pPacket->pSupported);
 
@@ -2589,13 +2971,40 @@ VkResult vkReplay::manually_replay_vkBindBufferMemory(packet_vkBindBufferMemory
         memOffsetTemp = pPacket->memoryOffset + replayGetBufferMemoryRequirements[remappedbuffer].alignment - 1;
         memOffsetTemp = memOffsetTemp / replayGetBufferMemoryRequirements[remappedbuffer].alignment;
         memOffsetTemp = memOffsetTemp * replayGetBufferMemoryRequirements[remappedbuffer].alignment;
-        replayResult = m_vkFuncs.real_vkBindBufferMemory(remappeddevice, remappedbuffer, remappedmemory, memOffsetTemp);
+        replayResult = m_vkFuncs.real_vkBindBufferMemory(remappeddevice, remappedbuffer, remappedmemory,
+                                                         memOffsetTemp + replay_memory_offset(pPacket->memory));
     } else {
-        replayResult = m_vkFuncs.real_vkBindBufferMemory(remappeddevice, remappedbuffer, remappedmemory, pPacket->memoryOffset);
+        replayResult = m_vkFuncs.real_vkBindBufferMemory(remappeddevice, remappedbuffer, remappedmemory,
+                                                         pPacket->memoryOffset + replay_memory_offset(pPacket->memory));
     }
     return replayResult;
 }
 
+VkResult vkReplay::manually_replay_vkBindImageMemory(packet_vkBindImageMemory *pPacket) {
+    VkDevice remappeddevice = m_objMapper.remap_devices(pPacket->device);
+    if (pPacket->device != VK_NULL_HANDLE && remappeddevice == VK_NULL_HANDLE) {
+        vktrace_LogError("Error detected in BindImageMemory() due to invalid remapped VkDevice.");
+        return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
+    VkImage remappedimage = m_objMapper.remap_images(pPacket->image);
+    if (pPacket->image != VK_NULL_HANDLE && remappedimage == VK_NULL_HANDLE) {
+        vktrace_LogError("Error detected in BindImageMemory() due to invalid remapped VkImage.");
+        return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
+    VkDeviceMemory remappedmemory = m_objMapper.remap_devicememorys(pPacket->memory);
+    if (pPacket->memory != VK_NULL_HANDLE && remappedmemory == VK_NULL_HANDLE) {
+        vktrace_LogError("Error detected in BindImageMemory() due to invalid remapped VkDeviceMemory.");
+        return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
+    return m_vkFuncs.real_vkBindImageMemory(remappeddevice, remappedimage, remappedmemory,
+                                            pPacket->memoryOffset + replay_memory_offset(pPacket->memory));
+}
+
+VkDeviceSize vkReplay::replay_memory_offset(VkDeviceMemory traceMemory) {
+    auto found = m_objMapper.m_devicememorys.find(traceMemory);
+    return found != m_objMapper.m_devicememorys.end() ? found->second.replayOffset : 0;
+}
+
 void vkReplay::manually_replay_vkGetImageMemoryRequirements(packet_vkGetImageMemoryRequirements *pPacket) {
     VkDevice remappedDevice = m_objMapper.remap_devices(pPacket->device);
     if (remappedDevice == VK_NULL_HANDLE) {
@@ -2611,6 +3020,9 @@ void vkReplay::manually_replay_vkGetImageMemoryRequirements(packet_vkGetImageMem
 
     m_vkFuncs.real_vkGetImageMemoryRequirements(remappedDevice, remappedImage, pPacket->pMemoryRequirements);
     replayGetImageMemoryRequirements[remappedImage] = *(pPacket->pMemoryRequirements);
+    if (m_pMemorySuballocator != NULL) {
+        m_pMemorySuballocator->add_requirements(remappedDevice, *(pPacket->pMemoryRequirements));
+    }
     return;
 }
 
@@ -2629,6 +3041,9 @@ void vkReplay::manually_replay_vkGetBufferMemoryRequirements(packet_vkGetBufferM
 
     m_vkFuncs.real_vkGetBufferMemoryRequirements(remappedDevice, remappedBuffer, pPacket->pMemoryRequirements);
     replayGetBufferMemoryRequirements[remappedBuffer] = *(pPacket->pMemoryRequirements);
+    if (m_pMemorySuballocator != NULL) {
+        m_pMemorySuballocator->add_requirements(remappedDevice, *(pPacket->pMemoryRequirements));
+    }
     return;
 }
 
@@ -2648,6 +3063,11 @@ VkResult vkReplay::manually_replay_vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
         return VK_ERROR_VALIDATION_FAILED_EXT;
     }
 
+    // Headless swapchains take what the trace got for its surface
+    if (m_pHeadlessSwapchains != NULL) {
+        return pPacket->result;
+    }
+
     m_display->resize_window(pPacket->pSurfaceCapabilities->currentExtent.width,
                              pPacket->pSurfaceCapabilities->currentExtent.height);
 
@@ -2673,6 +3093,11 @@ VkResult vkReplay::manually_replay_vkGetPhysicalDeviceSurfaceFormatsKHR(packet_v
         return VK_ERROR_VALIDATION_FAILED_EXT;
     }
 
+    // Headless swapchains take what the trace got for its surface
+    if (m_pHeadlessSwapchains != NULL) {
+        return pPacket->result;
+    }
+
     if (surfFmtCnt.find(pPacket->physicalDevice) != surfFmtCnt.end()) {
         // This query was previously done with pSurfaceFormats set to null. It was a query
         // to determine the size of data to be returned. We saved the size returned during
@@ -2721,6 +3146,11 @@ VkResult vkReplay::manually_replay_vkGetPhysicalDeviceSurfacePresentModesKHR(
         return VK_ERROR_VALIDATION_FAILED_EXT;
     }
 
+    // Headless swapchains take what the trace got for its surface
+    if (m_pHeadlessSwapchains != NULL) {
+        return pPacket->result;
+    }
+
     if (presModeCnt.find(pPacket->physicalDevice) != presModeCnt.end()) {
         // This query was previously done with pSurfaceFormats set to null. It was a query
         // to determine the size of data to be returned. We saved the size returned during
@@ -2794,6 +3224,18 @@ VkResult vkReplay::manually_replay_vkCreateSwapchainKHR(packet_vkCreateSwapchain
         }
     }
 
+    if (m_pHeadlessSwapchains != NULL) {
+        replayResult = m_pHeadlessSwapchains->create_swapchain(replayPhysicalDevices[remappeddevice], remappeddevice,
+                                                               replayDeviceQueueFamily[remappeddevice], pPacket->pCreateInfo,
+                                                               &local_pSwapchain);
+        if (replayResult == VK_SUCCESS) {
+            m_objMapper.add_to_swapchainkhrs_map(*(pPacket->pSwapchain), local_pSwapchain);
+        }
+        (*pSC) = save_oldSwapchain;
+        *pSurf = save_surface;
+        return replayResult;
+    }
+
     // Get the list of VkFormats that are supported:
     VkPhysicalDevice remappedPhysicalDevice = replayPhysicalDevices[remappeddevice];
     uint32_t formatCount;
@@ -2856,7 +3298,11 @@ void vkReplay::manually_replay_vkDestroySwapchainKHR(packet_vkDestroySwapchainKH
         traceSwapchainToImages[pPacket->swapchain].pop_back();
     }
 
-    m_vkFuncs.real_vkDestroySwapchainKHR(remappeddevice, remappedswapchain, pPacket->pAllocator);
+    if (m_pHeadlessSwapchains != NULL) {
+        m_pHeadlessSwapchains->destroy_swapchain(remappedswapchain);
+    } else {
+        m_vkFuncs.real_vkDestroySwapchainKHR(remappeddevice, remappedswapchain, pPacket->pAllocator);
+    }
     m_objMapper.rm_from_swapchainkhrs_map(pPacket->swapchain);
 }
 
@@ -2887,8 +3333,13 @@ VkResult vkReplay::manually_replay_vkGetSwapchainImagesKHR(packet_vkGetSwapchain
         }
     }
 
-    replayResult = m_vkFuncs.real_vkGetSwapchainImagesKHR(remappeddevice, remappedswapchain, pPacket->pSwapchainImageCount,
-                                                          pPacket->pSwapchainImages);
+    if (m_pHeadlessSwapchains != NULL) {
+        replayResult =
+            m_pHeadlessSwapchains->get_images(remappedswapchain, pPacket->pSwapchainImageCount, pPacket->pSwapchainImages);
+    } else {
+        replayResult = m_vkFuncs.real_vkGetSwapchainImagesKHR(remappeddevice, remappedswapchain, pPacket->pSwapchainImageCount,
+                                                              pPacket->pSwapchainImages);
+    }
     if (replayResult == VK_SUCCESS) {
         if (numImages != 0) {
             VkImage *pReplayImages = (VkImage *)pPacket->pSwapchainImages;
@@ -2904,6 +3355,45 @@ VkResult vkReplay::manually_replay_vkGetSwapchainImagesKHR(packet_vkGetSwapchain
     return replayResult;
 }
 
+VkResult vkReplay::manually_replay_vkAcquireNextImageKHR(packet_vkAcquireNextImageKHR *pPacket) {
+    VkResult replayResult = VK_ERROR_VALIDATION_FAILED_EXT;
+    VkDevice remappeddevice = m_objMapper.remap_devices(pPacket->device);
+    if (remappeddevice == VK_NULL_HANDLE) {
+        vktrace_LogError("Skipping vkAcquireNextImageKHR() due to invalid remapped VkDevice.");
+        return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
+
+    VkSwapchainKHR remappedswapchain = m_objMapper.remap_swapchainkhrs(pPacket->swapchain);
+    if (remappedswapchain == VK_NULL_HANDLE) {
+        vktrace_LogError("Skipping vkAcquireNextImageKHR() due to invalid remapped VkSwapchainKHR.");
+        return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
+
+    VkSemaphore remappedsemaphore = m_objMapper.remap_semaphores(pPacket->semaphore);
+    if (pPacket->semaphore != VK_NULL_HANDLE && remappedsemaphore == VK_NULL_HANDLE) {
+        vktrace_LogError("Skipping vkAcquireNextImageKHR() due to invalid remapped VkSemaphore.");
+        return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
+
+    VkFence remappedfence = m_objMapper.remap_fences(pPacket->fence);
+    if (pPacket->fence != VK_NULL_HANDLE && remappedfence == VK_NULL_HANDLE) {
+        vktrace_LogError("Skipping vkAcquireNextImageKHR() due to invalid remapped VkFence.");
+        return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
+
+    uint32_t local_pImageIndex = UINT32_MAX;
+    if (m_pHeadlessSwapchains != NULL) {
+        // Hand out the image the trace got
+        local_pImageIndex = *(pPacket->pImageIndex);
+        replayResult = m_pHeadlessSwapchains->acquire(remappedswapchain, local_pImageIndex, remappedsemaphore, remappedfence);
+    } else {
+        replayResult = m_vkFuncs.real_vkAcquireNextImageKHR(remappeddevice, remappedswapchain, pPacket->timeout, remappedsemaphore,
+                                                            remappedfence, &local_pImageIndex);
+    }
+    m_objMapper.add_to_pImageIndex_map(*(pPacket->pImageIndex), local_pImageIndex);
+    return replayResult;
+}
+
 VkResult vkReplay::manually_replay_vkQueuePresentKHR(packet_vkQueuePresentKHR *pPacket) {
     VkResult replayResult = VK_SUCCESS;
     VkQueue remappedQueue = m_objMapper.remap_queues(pPacket->queue);
@@ -2923,15 +3413,15 @@ VkResult vkReplay::manually_replay_vkQueuePresentKHR(packet_vkQueuePresentKHR *p
     uint32_t remappedImageIndex = UINT32_MAX;
 
     if (pPacket->pPresentInfo->swapchainCount > 5) {
-        pRemappedSwapchains = VKTRACE_NEW_ARRAY(VkSwapchainKHR, pPacket->pPresentInfo->swapchainCount);
+        pRemappedSwapchains = VKTRACE_REPLAY_NEW_ARRAY(VkSwapchainKHR, pPacket->pPresentInfo->swapchainCount);
     }
 
     if (pPacket->pPresentInfo->swapchainCount > 5 && pPacket->pPresentInfo->pResults != NULL) {
-        pResults = VKTRACE_NEW_ARRAY(VkResult, pPacket->pPresentInfo->swapchainCount);
+        pResults = VKTRACE_REPLAY_NEW_ARRAY(VkResult, pPacket->pPresentInfo->swapchainCount);
     }
 
     if (pPacket->pPresentInfo->waitSemaphoreCount > 5) {
-        pRemappedWaitSems = VKTRACE_NEW_ARRAY(VkSemaphore, pPacket->pPresentInfo->waitSemaphoreCount);
+        pRemappedWaitSems = VKTRACE_REPLAY_NEW_ARRAY(VkSemaphore, pPacket->pPresentInfo->waitSemaphoreCount);
     }
 
     if (pRemappedSwapchains == NULL || pRemappedWaitSems == NULL || pResults == NULL) {
@@ -2988,9 +3478,19 @@ VkResult vkReplay::manually_replay_vkQueuePresentKHR(packet_vkQueuePresentKHR *p
             present.pResults = pResults;
         }
 
-        replayResult = m_vkFuncs.real_vkQueuePresentKHR(remappedQueue, &present);
+        if (m_pHeadlessSwapchains != NULL) {
+            replayResult = m_pHeadlessSwapchains->present(remappedQueue, &present);
+        } else {
+            replayResult = m_vkFuncs.real_vkQueuePresentKHR(remappedQueue, &present);
+        }
 
         m_frameNumber++;
+        if (m_pGpuTimestamps != NULL) {
+            m_pGpuTimestamps->end_frame();
+        }
+        if (m_pFastForward != NULL) {
+            m_pFastForward->end_frame(m_frameNumber);
+        }
 
         // Compare the results from the trace file with those just received from the replay.  Report any differences.
         if (present.pResults != NULL) {
@@ -3006,18 +3506,26 @@ VkResult vkReplay::manually_replay_vkQueuePresentKHR(packet_vkQueuePresentKHR *p
     }
 
 out:
+    return replayResult;
+}
 
-    if (pRemappedWaitSems != NULL && pRemappedWaitSems != localSemaphores) {
-        VKTRACE_DELETE(pRemappedWaitSems);
-    }
-    if (pResults != NULL && pResults != localResults) {
-        VKTRACE_DELETE(pResults);
+void vkReplay::manually_replay_vkDestroySurfaceKHR(packet_vkDestroySurfaceKHR *pPacket) {
+    VkInstance remappedinstance = m_objMapper.remap_instances(pPacket->instance);
+    if (pPacket->instance != VK_NULL_HANDLE && remappedinstance == VK_NULL_HANDLE) {
+        vktrace_LogError("Skipping vkDestroySurfaceKHR() due to invalid remapped VkInstance.");
+        return;
     }
-    if (pRemappedSwapchains != NULL && pRemappedSwapchains != localSwapchains) {
-        VKTRACE_DELETE(pRemappedSwapchains);
+
+    VkSurfaceKHR remappedsurface = m_objMapper.remap_surfacekhrs(pPacket->surface);
+    if (pPacket->surface != VK_NULL_HANDLE && remappedsurface == VK_NULL_HANDLE) {
+        vktrace_LogError("Skipping vkDestroySurfaceKHR() due to invalid remapped VkSurfaceKHR.");
+        return;
     }
 
-    return replayResult;
+    // Headless surfaces are only handles
+    if (m_pHeadlessSwapchains == NULL) {
+        m_vkFuncs.real_vkDestroySurfaceKHR(remappedinstance, remappedsurface, pPacket->pAllocator);
+    }
 }
 
 VkResult vkReplay::manually_replay_vkCreateXcbSurfaceKHR(packet_vkCreateXcbSurfaceKHR *pPacket) {
@@ -3029,6 +3537,11 @@ VkResult vkReplay::manually_replay_vkCreateXcbSurfaceKHR(packet_vkCreateXcbSurfa
         return VK_ERROR_VALIDATION_FAILED_EXT;
     }
 
+    if (m_pHeadlessSwapchains != NULL) {
+        m_objMapper.add_to_surfacekhrs_map(*(pPacket->pSurface), m_pHeadlessSwapchains->create_surface());
+        return VK_SUCCESS;
+    }
+
 #if defined(PLATFORM_LINUX) && !defined(ANDROID)
 #if defined VK_USE_PLATFORM_XCB_KHR && defined VKREPLAY_USE_WSI_XCB
     VkIcdSurfaceXcb *pSurf = (VkIcdSurfaceXcb *)m_display->get_surface();
@@ -3087,6 +3600,11 @@ VkResult vkReplay::manually_replay_vkCreateXlibSurfaceKHR(packet_vkCreateXlibSur
         return VK_ERROR_VALIDATION_FAILED_EXT;
     }
 
+    if (m_pHeadlessSwapchains != NULL) {
+        m_objMapper.add_to_surfacekhrs_map(*(pPacket->pSurface), m_pHeadlessSwapchains->create_surface());
+        return VK_SUCCESS;
+    }
+
 #if defined PLATFORM_LINUX && defined VK_USE_PLATFORM_XLIB_KHR && defined VKREPLAY_USE_WSI_XLIB
     VkIcdSurfaceXlib *pSurf = (VkIcdSurfaceXlib *)m_display->get_surface();
     VkXlibSurfaceCreateInfoKHR createInfo;
@@ -3146,6 +3664,11 @@ VkResult vkReplay::manually_replay_vkCreateWaylandSurfaceKHR(packet_vkCreateWayl
         return VK_ERROR_VALIDATION_FAILED_EXT;
     }
 
+    if (m_pHeadlessSwapchains != NULL) {
+        m_objMapper.add_to_surfacekhrs_map(*(pPacket->pSurface), m_pHeadlessSwapchains->create_surface());
+        return VK_SUCCESS;
+    }
+
 #if defined PLATFORM_LINUX && defined VK_USE_PLATFORM_WAYLAND_KHR && defined VKREPLAY_USE_WSI_WAYLAND
     VkIcdSurfaceWayland *pSurf = (VkIcdSurfaceWayland *)m_display->get_surface();
     VkWaylandSurfaceCreateInfoKHR createInfo;
@@ -3205,6 +3728,11 @@ VkResult vkReplay::manually_replay_vkCreateWin32SurfaceKHR(packet_vkCreateWin32S
         return VK_ERROR_VALIDATION_FAILED_EXT;
     }
 
+    if (m_pHeadlessSwapchains != NULL) {
+        m_objMapper.add_to_surfacekhrs_map(*(pPacket->pSurface), m_pHeadlessSwapchains->create_surface());
+        return VK_SUCCESS;
+    }
+
 #if defined WIN32
     VkIcdSurfaceWin32 *pSurf = (VkIcdSurfaceWin32 *)m_display->get_surface();
     VkWin32SurfaceCreateInfoKHR createInfo;
@@ -3262,6 +3790,11 @@ VkResult vkReplay::manually_replay_vkCreateAndroidSurfaceKHR(packet_vkCreateAndr
         return VK_ERROR_VALIDATION_FAILED_EXT;
     }
 
+    if (m_pHeadlessSwapchains != NULL) {
+        m_objMapper.add_to_surfacekhrs_map(*(pPacket->pSurface), m_pHeadlessSwapchains->create_surface());
+        return VK_SUCCESS;
+    }
+
 #if defined WIN32
     VkIcdSurfaceWin32 *pSurf = (VkIcdSurfaceWin32 *)m_display->get_surface();
     VkWin32SurfaceCreateInfoKHR createInfo;
@@ -3377,7 +3910,7 @@ VkResult vkReplay::manually_replay_vkAllocateCommandBuffers(packet_vkAllocateCom
         return VK_ERROR_VALIDATION_FAILED_EXT;
     }
 
-    VkCommandBuffer *local_pCommandBuffers = new VkCommandBuffer[pPacket->pAllocateInfo->commandBufferCount];
+    VkCommandBuffer *local_pCommandBuffers = VKTRACE_REPLAY_NEW_ARRAY(VkCommandBuffer, pPacket->pAllocateInfo->commandBufferCount);
     VkCommandPool local_CommandPool;
     local_CommandPool = pPacket->pAllocateInfo->commandPool;
     ((VkCommandBufferAllocateInfo *)pPacket->pAllocateInfo)->commandPool =
@@ -3388,6 +3921,15 @@ VkResult vkReplay::manually_replay_vkAllocateCommandBuffers(packet_vkAllocateCom
     }
 
     replayResult = m_vkFuncs.real_vkAllocateCommandBuffers(remappedDevice, pPacket->pAllocateInfo, local_pCommandBuffers);
+    if (m_pGpuTimestamps != NULL && replayResult == VK_SUCCESS) {
+        m_pGpuTimestamps->add_command_buffers(pPacket->pAllocateInfo, local_pCommandBuffers);
+    }
+    if (m_pAnnotations != NULL && replayResult == VK_SUCCESS) {
+        m_pAnnotations->add_command_buffers(remappedDevice, pPacket->pAllocateInfo, local_pCommandBuffers);
+    }
+    if (m_pFastForward != NULL && replayResult == VK_SUCCESS) {
+        m_pFastForward->add_command_buffers(pPacket->pAllocateInfo->commandBufferCount, local_pCommandBuffers);
+    }
     ((VkCommandBufferAllocateInfo *)pPacket->pAllocateInfo)->commandPool = local_CommandPool;
 
     if (replayResult == VK_SUCCESS) {
@@ -3395,7 +3937,6 @@ VkResult vkReplay::manually_replay_vkAllocateCommandBuffers(packet_vkAllocateCom
             m_objMapper.add_to_commandbuffers_map(pPacket->pCommandBuffers[i], local_pCommandBuffers[i]);
         }
     }
-    delete[] local_pCommandBuffers;
     return replayResult;
 }
 
@@ -3408,6 +3949,10 @@ VkBool32 vkReplay::manually_replay_vkGetPhysicalDeviceXcbPresentationSupportKHR(
         return VK_FALSE;
     }
 
+    if (m_pHeadlessSwapchains != NULL) {
+        return VK_TRUE;
+    }
+
 #if defined PLATFORM_LINUX && defined VKREPLAY_USE_WSI_XCB
     VkIcdSurfaceXcb *pSurf = (VkIcdSurfaceXcb *)m_display->get_surface();
     return (m_vkFuncs.real_vkGetPhysicalDeviceXcbPresentationSupportKHR(
@@ -3442,6 +3987,10 @@ VkBool32 vkReplay::manually_replay_vkGetPhysicalDeviceXlibPresentationSupportKHR
         return VK_FALSE;
     }
 
+    if (m_pHeadlessSwapchains != NULL) {
+        return VK_TRUE;
+    }
+
 #if defined PLATFORM_LINUX && defined VKREPLAY_USE_WSI_XCB
     VkIcdSurfaceXcb *pSurf = (VkIcdSurfaceXcb *)m_display->get_surface();
     return (m_vkFuncs.real_vkGetPhysicalDeviceXcbPresentationSupportKHR(
@@ -3476,6 +4025,10 @@ VkBool32 vkReplay::manually_replay_vkGetPhysicalDeviceWaylandPresentationSupport
         return VK_FALSE;
     }
 
+    if (m_pHeadlessSwapchains != NULL) {
+        return VK_TRUE;
+    }
+
 #if defined PLATFORM_LINUX && defined VKREPLAY_USE_WSI_XCB
     VkIcdSurfaceXcb *pSurf = (VkIcdSurfaceXcb *)m_display->get_surface();
     return (m_vkFuncs.real_vkGetPhysicalDeviceXcbPresentationSupportKHR(
@@ -3508,6 +4061,10 @@ VkBool32 vkReplay::manually_replay_vkGetPhysicalDeviceWin32PresentationSupportKH
         return VK_FALSE;
     }
 
+    if (m_pHeadlessSwapchains != NULL) {
+        return VK_TRUE;
+    }
+
 #if defined WIN32
     return (m_vkFuncs.real_vkGetPhysicalDeviceWin32PresentationSupportKHR(remappedphysicalDevice, pPacket->queueFamilyIndex));
 #elif defined PLATFORM_LINUX && defined VKREPLAY_USE_WSI_XCB
@@ -3533,8 +4090,65 @@ VkBool32 vkReplay::manually_replay_vkGetPhysicalDeviceWin32PresentationSupportKH
 #endif
 }
 
-static std::unordered_map<VkDescriptorUpdateTemplateKHR, VkDescriptorUpdateTemplateCreateInfoKHR *>
-    descriptorUpdateTemplateCreateInfo;
+// Where the handles are in the data of updates with a descriptor update template, by how they are remapped, so each
+// update remaps those slots instead of walking the template's entries
+struct DescriptorUpdateTemplatePlan {
+    size_t dataSize;  // bytes of the data the entries reach
+    std::vector<size_t> samplers;
+    std::vector<size_t> imageViews;
+    std::vector<size_t> buffers;
+    std::vector<size_t> bufferViews;
+};
+
+static std::unordered_map<VkDescriptorUpdateTemplateKHR, DescriptorUpdateTemplatePlan> descriptorUpdateTemplatePlans;
+
+static void addDescriptorUpdateTemplatePlan(VkDescriptorUpdateTemplateKHR descriptorUpdateTemplate,
+                                            const VkDescriptorUpdateTemplateCreateInfoKHR *pCreateInfo) {
+    DescriptorUpdateTemplatePlan &plan = descriptorUpdateTemplatePlans[descriptorUpdateTemplate];
+    plan = DescriptorUpdateTemplatePlan();
+    plan.dataSize = 0;
+    for (uint32_t i = 0; i < pCreateInfo->descriptorUpdateEntryCount; i++) {
+        const VkDescriptorUpdateTemplateEntryKHR &entry = pCreateInfo->pDescriptorUpdateEntries[i];
+        for (uint32_t j = 0; j < entry.descriptorCount; j++) {
+            size_t offset = entry.offset + j * entry.stride;
+            size_t size;
+            switch (entry.descriptorType) {
+                case VK_DESCRIPTOR_TYPE_SAMPLER:
+                    plan.samplers.push_back(offset + offsetof(VkDescriptorImageInfo, sampler));
+                    size = sizeof(VkDescriptorImageInfo);
+                    break;
+                case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+                    plan.samplers.push_back(offset + offsetof(VkDescriptorImageInfo, sampler));
+                    plan.imageViews.push_back(offset + offsetof(VkDescriptorImageInfo, imageView));
+                    size = sizeof(VkDescriptorImageInfo);
+                    break;
+                case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+                case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+                case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+                    plan.imageViews.push_back(offset + offsetof(VkDescriptorImageInfo, imageView));
+                    size = sizeof(VkDescriptorImageInfo);
+                    break;
+                case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+                case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+                case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+                case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+                    plan.buffers.push_back(offset + offsetof(VkDescriptorBufferInfo, buffer));
+                    size = sizeof(VkDescriptorBufferInfo);
+                    break;
+                case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+                case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+                    plan.bufferViews.push_back(offset);
+                    size = sizeof(VkBufferView);
+                    break;
+                default:
+                    assert(0);
+                    size = 0;
+                    break;
+            }
+            plan.dataSize = std::max(plan.dataSize, offset + size);
+        }
+    }
+}
 
 VkResult vkReplay::manually_replay_vkCreateDescriptorUpdateTemplateKHR(packet_vkCreateDescriptorUpdateTemplateKHR *pPacket) {
     VkResult replayResult;
@@ -3556,16 +4170,7 @@ VkResult vkReplay::manually_replay_vkCreateDescriptorUpdateTemplateKHR(packet_vk
                                                                       &local_pDescriptorUpdateTemplate);
     if (replayResult == VK_SUCCESS) {
         m_objMapper.add_to_descriptorupdatetemplatekhrs_map(*(pPacket->pDescriptorUpdateTemplate), local_pDescriptorUpdateTemplate);
-        descriptorUpdateTemplateCreateInfo[local_pDescriptorUpdateTemplate] =
-            (VkDescriptorUpdateTemplateCreateInfoKHR *)malloc(sizeof(VkDescriptorUpdateTemplateCreateInfoKHR));
-        memcpy(descriptorUpdateTemplateCreateInfo[local_pDescriptorUpdateTemplate], pPacket->pCreateInfo,
-               sizeof(VkDescriptorUpdateTemplateCreateInfoKHR));
-        descriptorUpdateTemplateCreateInfo[local_pDescriptorUpdateTemplate]->pDescriptorUpdateEntries =
-            (VkDescriptorUpdateTemplateEntryKHR *)malloc(sizeof(VkDescriptorUpdateTemplateEntryKHR) *
-                                                         pPacket->pCreateInfo->descriptorUpdateEntryCount);
-        memcpy((void *)descriptorUpdateTemplateCreateInfo[local_pDescriptorUpdateTemplate]->pDescriptorUpdateEntries,
-               pPacket->pCreateInfo->pDescriptorUpdateEntries,
-               sizeof(VkDescriptorUpdateTemplateEntryKHR) * pPacket->pCreateInfo->descriptorUpdateEntryCount);
+        addDescriptorUpdateTemplatePlan(local_pDescriptorUpdateTemplate, pPacket->pCreateInfo);
     }
     return replayResult;
 }
@@ -3585,59 +4190,36 @@ void vkReplay::manually_replay_vkDestroyDescriptorUpdateTemplateKHR(packet_vkDes
     }
     m_vkFuncs.real_vkDestroyDescriptorUpdateTemplateKHR(remappeddevice, remappedDescriptorUpdateTemplate, pPacket->pAllocator);
     m_objMapper.rm_from_descriptorupdatetemplatekhrs_map(pPacket->descriptorUpdateTemplate);
-
-    if (descriptorUpdateTemplateCreateInfo.find(remappedDescriptorUpdateTemplate) != descriptorUpdateTemplateCreateInfo.end()) {
-        if (descriptorUpdateTemplateCreateInfo[remappedDescriptorUpdateTemplate]) {
-            if (descriptorUpdateTemplateCreateInfo[remappedDescriptorUpdateTemplate]->pDescriptorUpdateEntries)
-                free((void *)descriptorUpdateTemplateCreateInfo[remappedDescriptorUpdateTemplate]->pDescriptorUpdateEntries);
-            free(descriptorUpdateTemplateCreateInfo[remappedDescriptorUpdateTemplate]);
-        }
-        descriptorUpdateTemplateCreateInfo.erase(remappedDescriptorUpdateTemplate);
-    }
+    descriptorUpdateTemplatePlans.erase(remappedDescriptorUpdateTemplate);
 }
 
-void vkReplay::remapHandlesInDescriptorSetWithTemplateData(VkDescriptorUpdateTemplateKHR remappedDescriptorUpdateTemplate,
-                                                           char *pData) {
-    for (uint32_t i = 0; i < descriptorUpdateTemplateCreateInfo[remappedDescriptorUpdateTemplate]->descriptorUpdateEntryCount;
-         i++) {
-        for (uint32_t j = 0;
-             j < descriptorUpdateTemplateCreateInfo[remappedDescriptorUpdateTemplate]->pDescriptorUpdateEntries[i].descriptorCount;
-             j++) {
-            size_t offset =
-                descriptorUpdateTemplateCreateInfo[remappedDescriptorUpdateTemplate]->pDescriptorUpdateEntries[i].offset +
-                j * descriptorUpdateTemplateCreateInfo[remappedDescriptorUpdateTemplate]->pDescriptorUpdateEntries[i].stride;
-            char *update_entry = pData + offset;
-            switch (
-                descriptorUpdateTemplateCreateInfo[remappedDescriptorUpdateTemplate]->pDescriptorUpdateEntries[i].descriptorType) {
-                case VK_DESCRIPTOR_TYPE_SAMPLER:
-                case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
-                case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
-                case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
-                case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT: {
-                    auto image_entry = reinterpret_cast<VkDescriptorImageInfo *>(update_entry);
-                    image_entry->sampler = m_objMapper.remap_samplers(image_entry->sampler);
-                    image_entry->imageView = m_objMapper.remap_imageviews(image_entry->imageView);
-                    break;
-                }
-                case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
-                case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
-                case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
-                case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC: {
-                    auto buffer_entry = reinterpret_cast<VkDescriptorBufferInfo *>(update_entry);
-                    buffer_entry->buffer = m_objMapper.remap_buffers(buffer_entry->buffer);
-                    break;
-                }
-                case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
-                case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER: {
-                    auto buffer_view_handle = reinterpret_cast<VkBufferView *>(update_entry);
-                    *buffer_view_handle = m_objMapper.remap_bufferviews(*buffer_view_handle);
-                    break;
-                }
-                default:
-                    assert(0);
-            }
-        }
-    }
+const void *vkReplay::remapDescriptorSetWithTemplateData(VkDescriptorUpdateTemplateKHR remappedDescriptorUpdateTemplate,
+                                                         const void *pData) {
+    auto found = descriptorUpdateTemplatePlans.find(remappedDescriptorUpdateTemplate);
+    if (found == descriptorUpdateTemplatePlans.end() || pData == NULL) return pData;
+    const DescriptorUpdateTemplatePlan &plan = found->second;
+
+    // The packet keeps the trace's handles, the copy in the packet's scratch memory gets the replay ones
+    uint8_t *pRemapped = (uint8_t *)vktrace_replay::ReplayArena::current().alloc(plan.dataSize);
+    if (pRemapped == NULL) return pData;
+    memcpy(pRemapped, pData, plan.dataSize);
+    for (size_t offset : plan.samplers) {
+        VkSampler *pSampler = (VkSampler *)(pRemapped + offset);
+        *pSampler = m_objMapper.remap_samplers(*pSampler);
+    }
+    for (size_t offset : plan.imageViews) {
+        VkImageView *pImageView = (VkImageView *)(pRemapped + offset);
+        *pImageView = m_objMapper.remap_imageviews(*pImageView);
+    }
+    for (size_t offset : plan.buffers) {
+        VkBuffer *pBuffer = (VkBuffer *)(pRemapped + offset);
+        *pBuffer = m_objMapper.remap_buffers(*pBuffer);
+    }
+    for (size_t offset : plan.bufferViews) {
+        VkBufferView *pBufferView = (VkBufferView *)(pRemapped + offset);
+        *pBufferView = m_objMapper.remap_bufferviews(*pBufferView);
+    }
+    return pRemapped;
 }
 
 void vkReplay::manually_replay_vkUpdateDescriptorSetWithTemplateKHR(packet_vkUpdateDescriptorSetWithTemplateKHR *pPacket) {
@@ -3662,10 +4244,10 @@ void vkReplay::manually_replay_vkUpdateDescriptorSetWithTemplateKHR(packet_vkUpd
     }
 
     // Map handles inside of pData
-    remapHandlesInDescriptorSetWithTemplateData(remappedDescriptorUpdateTemplate, (char *)pPacket->pData);
+    const void *pData = remapDescriptorSetWithTemplateData(remappedDescriptorUpdateTemplate, pPacket->pData);
 
     m_vkFuncs.real_vkUpdateDescriptorSetWithTemplateKHR(remappeddevice, remappedDescriptorSet, remappedDescriptorUpdateTemplate,
-                                                        pPacket->pData);
+                                                        pData);
 }
 
 void vkReplay::manually_replay_vkCmdPushDescriptorSetWithTemplateKHR(packet_vkCmdPushDescriptorSetWithTemplateKHR *pPacket) {
@@ -3690,10 +4272,10 @@ void vkReplay::manually_replay_vkCmdPushDescriptorSetWithTemplateKHR(packet_vkCm
     }
 
     // Map handles inside of pData
-    remapHandlesInDescriptorSetWithTemplateData(remappedDescriptorUpdateTemplate, (char *)pPacket->pData);
+    const void *pData = remapDescriptorSetWithTemplateData(remappedDescriptorUpdateTemplate, pPacket->pData);
 
     m_vkFuncs.real_vkCmdPushDescriptorSetWithTemplateKHR(remappedcommandBuffer, remappedDescriptorUpdateTemplate, remappedlayout,
-                                                         pPacket->set, pPacket->pData);
+                                                         pPacket->set, pData);
 }
 
 VkResult vkReplay::manually_replay_vkRegisterDeviceEventEXT(packet_vkRegisterDeviceEventEXT *pPacket) {
@@ -3802,3 +4384,332 @@ VkResult vkReplay::manually_replay_vkCreateIndirectCommandsLayoutNVX(packet_vkCr
 
     return result;
 }
+
+void vkReplay::save_loop_state() {
+    for (auto it = loopMemorySnapshots.begin(); it != loopMemorySnapshots.end(); ++it) {
+        release_loop_memory(it->second);
+    }
+    loopMemorySnapshots.clear();
+
+    uint64_t skipped = 0;
+    VkDeviceSize savedSize = 0;
+    for (auto it = m_objMapper.m_devicememorys.begin(); it != m_objMapper.m_devicememorys.end(); ++it) {
+        LoopMemorySnapshot snapshot;
+        if (snapshot_loop_memory(it->first, &snapshot)) {
+            loopMemorySnapshots[it->first] = snapshot;
+            savedSize += snapshot.size;
+        } else {
+            skipped++;
+        }
+    }
+    copy_loop_memory(false);
+    vktrace_LogVerbose("Saved %" PRIu64 " bytes in %" PRIu64 " memory allocations for looping.", (uint64_t)savedSize,
+                       (uint64_t)loopMemorySnapshots.size());
+    if (skipped > 0) {
+        vktrace_LogWarning("Contents of %" PRIu64 " memory allocations can't be restored between loops.", skipped);
+    }
+}
+
+void vkReplay::restore_loop_state() {
+    // Allocations made since the snapshot don't have one, and ones the trace freed lost theirs
+    for (auto it = loopMemorySnapshots.begin(); it != loopMemorySnapshots.end();) {
+        auto found = m_objMapper.m_devicememorys.find(it->first);
+        if (found == m_objMapper.m_devicememorys.end() || found->second.replayDeviceMemory != it->second.memory) {
+            release_loop_memory(it->second);
+            it = loopMemorySnapshots.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    copy_loop_memory(true);
+}
+
+bool vkReplay::snapshot_loop_memory(VkDeviceMemory traceMemory, LoopMemorySnapshot *pSnapshot) {
+    const devicememoryObj &mem = m_objMapper.m_devicememorys[traceMemory];
+    auto device = replayDeviceMemoryToDevice.find(mem.replayDeviceMemory);
+    // A dedicated allocation can't have another buffer bound to it
+    if (mem.pGpuMem == NULL || mem.pGpuMem->isDedicated() || device == replayDeviceMemoryToDevice.end() ||
+        replayDeviceQueueFamily.find(device->second) == replayDeviceQueueFamily.end()) {
+        return false;
+    }
+    const VkMemoryAllocateInfo &allocInfo = mem.pGpuMem->getAllocInfo();
+
+    pSnapshot->device = device->second;
+    pSnapshot->memory = mem.replayDeviceMemory;
+    pSnapshot->memoryBuffer = VK_NULL_HANDLE;
+    pSnapshot->savedMemory = VK_NULL_HANDLE;
+    pSnapshot->savedBuffer = VK_NULL_HANDLE;
+    pSnapshot->size = allocInfo.allocationSize;
+
+    // Both allocations are copied through a buffer bound to all of it, which only works for memory
+    // types that buffers can use
+    VkBufferCreateInfo bufferInfo = {VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                                     NULL,
+                                     0,
+                                     allocInfo.allocationSize,
+                                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                     VK_SHARING_MODE_EXCLUSIVE,
+                                     0,
+                                     NULL};
+    VkMemoryRequirements memRequirements;
+    if (m_vkFuncs.real_vkCreateBuffer(pSnapshot->device, &bufferInfo, NULL, &pSnapshot->memoryBuffer) != VK_SUCCESS ||
+        m_vkFuncs.real_vkCreateBuffer(pSnapshot->device, &bufferInfo, NULL, &pSnapshot->savedBuffer) != VK_SUCCESS) {
+        release_loop_memory(*pSnapshot);
+        return false;
+    }
+    m_vkFuncs.real_vkGetBufferMemoryRequirements(pSnapshot->device, pSnapshot->memoryBuffer, &memRequirements);
+    if (mem.replayOffset > allocInfo.allocationSize || memRequirements.size > allocInfo.allocationSize - mem.replayOffset ||
+        !(memRequirements.memoryTypeBits & (1 << allocInfo.memoryTypeIndex)) || mem.replayOffset % memRequirements.alignment != 0) {
+        release_loop_memory(*pSnapshot);
+        return false;
+    }
+
+    VkMemoryAllocateInfo savedInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, memRequirements.size,
+                                      allocInfo.memoryTypeIndex};
+    if (m_vkFuncs.real_vkAllocateMemory(pSnapshot->device, &savedInfo, NULL, &pSnapshot->savedMemory) != VK_SUCCESS ||
+        m_vkFuncs.real_vkBindBufferMemory(pSnapshot->device, pSnapshot->memoryBuffer, pSnapshot->memory, mem.replayOffset) !=
+            VK_SUCCESS ||
+        m_vkFuncs.real_vkBindBufferMemory(pSnapshot->device, pSnapshot->savedBuffer, pSnapshot->savedMemory, 0) != VK_SUCCESS) {
+        release_loop_memory(*pSnapshot);
+        return false;
+    }
+    return true;
+}
+
+void vkReplay::release_loop_memory(LoopMemorySnapshot &snapshot) {
+    m_vkFuncs.real_vkDestroyBuffer(snapshot.device, snapshot.memoryBuffer, NULL);
+    m_vkFuncs.real_vkDestroyBuffer(snapshot.device, snapshot.savedBuffer, NULL);
+    m_vkFuncs.real_vkFreeMemory(snapshot.device, snapshot.savedMemory, NULL);
+    snapshot.memoryBuffer = VK_NULL_HANDLE;
+    snapshot.savedBuffer = VK_NULL_HANDLE;
+    snapshot.savedMemory = VK_NULL_HANDLE;
+}
+
+void vkReplay::copy_loop_memory(bool restore) {
+    std::unordered_map<VkDevice, std::vector<const LoopMemorySnapshot *>> deviceSnapshots;
+    for (auto it = loopMemorySnapshots.begin(); it != loopMemorySnapshots.end(); ++it) {
+        deviceSnapshots[it->second.device].push_back(&it->second);
+    }
+
+    for (auto it = deviceSnapshots.begin(); it != deviceSnapshots.end(); ++it) {
+        VkDevice device = it->first;
+        auto copyQueue = loopCopyQueues.find(device);
+        if (copyQueue == loopCopyQueues.end()) {
+            LoopCopyQueue newQueue = {VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE};
+            m_vkFuncs.real_vkGetDeviceQueue(device, replayDeviceQueueFamily[device], 0, &newQueue.queue);
+            VkCommandPoolCreateInfo poolInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, NULL,
+                                                VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, replayDeviceQueueFamily[device]};
+            VkFenceCreateInfo fenceInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, NULL, 0};
+            if (m_vkFuncs.real_vkCreateCommandPool(device, &poolInfo, NULL, &newQueue.commandPool) != VK_SUCCESS ||
+                m_vkFuncs.real_vkCreateFence(device, &fenceInfo, NULL, &newQueue.fence) != VK_SUCCESS) {
+                vktrace_LogError("Failed to create the objects to save and restore memory with for looping.");
+                m_vkFuncs.real_vkDestroyCommandPool(device, newQueue.commandPool, NULL);
+                continue;
+            }
+            VkCommandBufferAllocateInfo commandBufferInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, NULL,
+                                                             newQueue.commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1};
+            if (m_vkFuncs.real_vkAllocateCommandBuffers(device, &commandBufferInfo, &newQueue.commandBuffer) != VK_SUCCESS) {
+                vktrace_LogError("Failed to create the objects to save and restore memory with for looping.");
+                m_vkFuncs.real_vkDestroyFence(device, newQueue.fence, NULL);
+                m_vkFuncs.real_vkDestroyCommandPool(device, newQueue.commandPool, NULL);
+                continue;
+            }
+            copyQueue = loopCopyQueues.insert(std::make_pair(device, newQueue)).first;
+        }
+        const LoopCopyQueue &queue = copyQueue->second;
+
+        // Whatever the trace submitted has to finish before its memory is copied
+        m_vkFuncs.real_vkDeviceWaitIdle(device);
+
+        VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
+                                              VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, NULL};
+        m_vkFuncs.real_vkBeginCommandBuffer(queue.commandBuffer, &beginInfo);
+        for (size_t i = 0; i < it->second.size(); i++) {
+            const LoopMemorySnapshot &snapshot = *it->second[i];
+            VkBufferCopy region = {0, 0, snapshot.size};
+            m_vkFuncs.real_vkCmdCopyBuffer(queue.commandBuffer, restore ? snapshot.savedBuffer : snapshot.memoryBuffer,
+                                           restore ? snapshot.memoryBuffer : snapshot.savedBuffer, 1, &region);
+        }
+        // Make the copies visible to the host and to everything the trace does next
+        VkMemoryBarrier barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER, NULL, VK_ACCESS_TRANSFER_WRITE_BIT,
+                                   VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_HOST_READ_BIT};
+        m_vkFuncs.real_vkCmdPipelineBarrier(queue.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0,
+                                            NULL, 0, NULL);
+        m_vkFuncs.real_vkEndCommandBuffer(queue.commandBuffer);
+
+        VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO, NULL, 0, NULL, NULL, 1, &queue.commandBuffer, 0, NULL};
+        if (m_vkFuncs.real_vkQueueSubmit(queue.queue, 1, &submitInfo, queue.fence) == VK_SUCCESS) {
+            m_vkFuncs.real_vkWaitForFences(device, 1, &queue.fence, VK_TRUE, UINT64_MAX);
+            m_vkFuncs.real_vkResetFences(device, 1, &queue.fence);
+        } else {
+            vktrace_LogError("Failed to %s memory contents for looping.", restore ? "restore" : "save");
+        }
+    }
+}
+
+void vkReplay::release_loop_state(VkDevice device) {
+    for (auto it = loopMemorySnapshots.begin(); it != loopMemorySnapshots.end();) {
+        if (it->second.device == device) {
+            release_loop_memory(it->second);
+            it = loopMemorySnapshots.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    auto copyQueue = loopCopyQueues.find(device);
+    if (copyQueue != loopCopyQueues.end()) {
+        m_vkFuncs.real_vkDestroyFence(device, copyQueue->second.fence, NULL);
+        m_vkFuncs.real_vkDestroyCommandPool(device, copyQueue->second.commandPool, NULL);
+        loopCopyQueues.erase(copyQueue);
+    }
+    replayDeviceQueueFamily.erase(device);
+}
+
+void vkReplay::create_pipeline_cache(VkDevice device, VkPhysicalDevice physicalDevice) {
+    if (g_pReplaySettings->pTraceFilePath == NULL) {
+        return;
+    }
+
+    // Drivers reject cache data from other GPUs and driver versions, so each gets its own file
+    VkPhysicalDeviceProperties properties;
+    m_vkFuncs.real_vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    char suffix[80];
+    ReplayPipelineCache pipelineCache = {VK_NULL_HANDLE, std::string()};
+    if (g_pReplaySettings->batchFile != NULL) {
+        // The traces of a batch share one cache, what they have in common is compiled once for all of them
+        snprintf(suffix, sizeof(suffix), ".%04x-%04x-%08x.pipelinecache", properties.vendorID, properties.deviceID,
+                 properties.driverVersion);
+        pipelineCache.path = std::string(g_pReplaySettings->batchFile) + suffix;
+    } else {
+        snprintf(suffix, sizeof(suffix), ".%08x%08x%08x%08x.%04x-%04x-%08x.pipelinecache", m_pFileHeader->uuid[0],
+                 m_pFileHeader->uuid[1], m_pFileHeader->uuid[2], m_pFileHeader->uuid[3], properties.vendorID,
+                 properties.deviceID, properties.driverVersion);
+        pipelineCache.path = std::string(g_pReplaySettings->pTraceFilePath) + suffix;
+    }
+
+    std::vector<char> data;
+    FILE *pFile = fopen(pipelineCache.path.c_str(), "rb");
+    if (pFile != NULL) {
+        if (fseek(pFile, 0, SEEK_END) == 0) {
+            long size = ftell(pFile);
+            if (size > 0 && fseek(pFile, 0, SEEK_SET) == 0) {
+                data.resize((size_t)size);
+                if (fread(data.data(), 1, data.size(), pFile) != data.size()) {
+                    data.clear();
+                }
+            }
+        }
+        fclose(pFile);
+    }
+
+    VkPipelineCacheCreateInfo createInfo = {VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO, NULL, 0, data.size(), data.data()};
+    if (m_vkFuncs.real_vkCreatePipelineCache(device, &createInfo, NULL, &pipelineCache.cache) != VK_SUCCESS) {
+        vktrace_LogWarning("Failed to create a pipeline cache from '%s'.", pipelineCache.path.c_str());
+        return;
+    }
+    if (!data.empty()) {
+        vktrace_LogVerbose("Loaded %zu bytes of pipeline cache from '%s'.", data.size(), pipelineCache.path.c_str());
+    }
+    replayPipelineCaches[device] = pipelineCache;
+}
+
+void vkReplay::save_pipeline_cache(VkDevice device) {
+    auto found = replayPipelineCaches.find(device);
+    if (found == replayPipelineCaches.end()) {
+        return;
+    }
+
+    const ReplayPipelineCache &pipelineCache = found->second;
+    size_t size = 0;
+    std::vector<char> data;
+    if (m_vkFuncs.real_vkGetPipelineCacheData(device, pipelineCache.cache, &size, NULL) == VK_SUCCESS && size > 0) {
+        data.resize(size);
+        if (m_vkFuncs.real_vkGetPipelineCacheData(device, pipelineCache.cache, &size, data.data()) != VK_SUCCESS) {
+            size = 0;
+        }
+    }
+    if (size > 0) {
+        FILE *pFile = fopen(pipelineCache.path.c_str(), "wb");
+        if (pFile == NULL || fwrite(data.data(), 1, size, pFile) != size) {
+            vktrace_LogWarning("Failed to write pipeline cache to '%s'.", pipelineCache.path.c_str());
+        }
+        if (pFile != NULL) {
+            fclose(pFile);
+        }
+    }
+    m_vkFuncs.real_vkDestroyPipelineCache(device, pipelineCache.cache, NULL);
+    replayPipelineCaches.erase(found);
+}
+
+VkPipelineCache vkReplay::get_pipeline_cache(VkDevice device, VkPipelineCache tracePipelineCache) {
+    // The persistent cache replaces the trace's own caches, whose data came from the capture's driver
+    auto found = replayPipelineCaches.find(device);
+    if (found != replayPipelineCaches.end()) {
+        return found->second.cache;
+    }
+    return m_objMapper.remap_pipelinecaches(tracePipelineCache);
+}
+
+bool vkReplay::replays_during_pipeline_creation(uint16_t packetId) {
+    // Calls that can't use a pipeline that is still compiling, and are typical between pipeline creations
+    switch (packetId) {
+        case VKTRACE_TPI_VK_vkCreateGraphicsPipelines:
+        case VKTRACE_TPI_VK_vkCreateComputePipelines:
+        case VKTRACE_TPI_VK_vkCreateShaderModule:
+        case VKTRACE_TPI_VK_vkDestroyShaderModule:
+        case VKTRACE_TPI_VK_vkCreatePipelineLayout:
+        case VKTRACE_TPI_VK_vkCreateDescriptorSetLayout:
+        case VKTRACE_TPI_VK_vkCreateRenderPass:
+        case VKTRACE_TPI_VK_vkCreateSampler:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void vkReplay::finish_pipeline_creation() {
+    if (m_pPipelineThreads != NULL) {
+        m_pPipelineThreads->sync();
+    }
+
+    for (size_t i = 0; i < m_pendingPipelines.size(); i++) {
+        const PendingPipelines &pending = *m_pendingPipelines[i];
+        if (pending.result == VK_SUCCESS) {
+            for (size_t j = 0; j < pending.tracePipelines.size(); j++) {
+                m_objMapper.add_to_pipelines_map(pending.tracePipelines[j], pending.replayPipelines[j]);
+            }
+        } else {
+            vktrace_LogError("Creating %zu pipelines on a pipeline thread failed with %s.", pending.tracePipelines.size(),
+                             string_VkResult(pending.result));
+        }
+    }
+    m_pendingPipelines.clear();
+
+    for (size_t i = 0; i < m_pendingShaderModuleDestroys.size(); i++) {
+        m_vkFuncs.real_vkDestroyShaderModule(m_pendingShaderModuleDestroys[i].first, m_pendingShaderModuleDestroys[i].second, NULL);
+    }
+    m_pendingShaderModuleDestroys.clear();
+}
+
+void vkReplay::manually_replay_vkDestroyShaderModule(packet_vkDestroyShaderModule *pPacket) {
+    VkDevice remappedDevice = m_objMapper.remap_devices(pPacket->device);
+    if (pPacket->device != VK_NULL_HANDLE && remappedDevice == VK_NULL_HANDLE) {
+        vktrace_LogError("Skipping vkDestroyShaderModule() due to invalid remapped VkDevice.");
+        return;
+    }
+
+    VkShaderModule remappedShaderModule = m_objMapper.remap_shadermodules(pPacket->shaderModule);
+    if (pPacket->shaderModule != VK_NULL_HANDLE && remappedShaderModule == VK_NULL_HANDLE) {
+        vktrace_LogError("Skipping vkDestroyShaderModule() due to invalid remapped VkShaderModule.");
+        return;
+    }
+
+    if (!m_pendingPipelines.empty()) {
+        // Pipelines that are still compiling may have been created from it
+        m_pendingShaderModuleDestroys.push_back(std::make_pair(remappedDevice, remappedShaderModule));
+        return;
+    }
+    m_vkFuncs.real_vkDestroyShaderModule(remappedDevice, remappedShaderModule, NULL);
+}
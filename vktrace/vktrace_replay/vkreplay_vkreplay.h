@@ -26,6 +26,7 @@
 
 #include <set>
 #include <map>
+#include <memory>
 #include <vector>
 #include <string>
 #if defined(PLATFORM_LINUX)
@@ -38,6 +39,15 @@
 #include "vktrace_multiplatform.h"
 #include "vkreplay_window.h"
 #include "vkreplay_factory.h"
+#include "vkreplay_pipelines.h"
+#include "vkreplay_headless.h"
+#include "vkreplay_suballocator.h"
+#include "vkreplay_timestamps.h"
+#include "vkreplay_annotations.h"
+#include "vkreplay_fastforward.h"
+#include "vkreplay_sparse_bindings.h"
+#include "vkreplay_lifetimes.h"
+#include "vkreplay_arena.h"
 #include "vktrace_trace_packet_identifiers.h"
 #include <unordered_map>
 
@@ -76,6 +86,15 @@ class vkReplay {
     int get_frame_number() { return m_frameNumber; }
     void reset_frame_number(int frameNumber) { m_frameNumber = frameNumber > 0 ? frameNumber : 0; }
 
+    // Copy the contents of every device memory allocation aside, and back into the allocations
+    // that still exist, so each replay of a loop range starts from the same memory contents
+    void save_loop_state();
+    void restore_loop_state();
+
+    // Forget the buffers, images and memory allocations that the call with global_packet_index is
+    // the first call after the last use of, if ReleaseUnused is set
+    void forget_unused_objects(uint64_t packetIndex);
+
    private:
     struct vkFuncs m_vkFuncs;
     vkReplayObjMapper m_objMapper;
@@ -100,6 +119,20 @@ class vkReplay {
     // -1: Not initialized. 0: No match. 1: Match.
     int m_platformMatch;
 
+    // What translating the memory type of each vkAllocateMemory for another GPU needs from later
+    // packets, keyed by the global packet index of the vkAllocateMemory
+    struct PortableAllocation {
+        // Index in portabilityTable of the first vkBindImageMemory/vkBindBufferMemory of the memory, 0 if none
+        size_t bindIdx;
+        // Index of the vkCreateImage/vkCreateBuffer of the bound object if it comes after the allocation, else 0
+        size_t createIdx;
+        // The memory is freed without ever being bound
+        bool freedUnbound;
+    };
+    bool m_portabilityPlanBuilt;
+    std::unordered_map<uint64_t, PortableAllocation> m_portabilityPlan;
+    void build_portability_plan();
+
     struct ValidationMsg {
         VkFlags msgFlags;
         VkDebugReportObjectTypeEXT objType;
@@ -129,6 +162,9 @@ class vkReplay {
     // VkResult manually_replay_vkGetPhysicalDeviceExtensionInfo(packet_vkGetPhysicalDeviceExtensionInfo* pPacket);
     VkResult manually_replay_vkQueueSubmit(packet_vkQueueSubmit* pPacket);
     VkResult manually_replay_vkQueueBindSparse(packet_vkQueueBindSparse* pPacket);
+    bool remap_sparse_memory(VkDeviceMemory traceMemory, VkDeviceMemory* pMemory, VkDeviceSize* pReplayOffset);
+    bool remap_sparse_memory_binds(uint64_t traceResource, const VkSparseMemoryBind* pTraceBinds, uint32_t traceBindCount,
+                                   const VkSparseMemoryBind** ppBinds, uint32_t* pBindCount);
     // VkResult manually_replay_vkGetObjectInfo(packet_vkGetObjectInfo* pPacket);
     // VkResult manually_replay_vkGetImageSubresourceInfo(packet_vkGetImageSubresourceInfo* pPacket);
     void manually_replay_vkUpdateDescriptorSets(packet_vkUpdateDescriptorSets* pPacket);
@@ -137,10 +173,17 @@ class vkReplay {
     VkResult manually_replay_vkAllocateDescriptorSets(packet_vkAllocateDescriptorSets* pPacket);
     VkResult manually_replay_vkFreeDescriptorSets(packet_vkFreeDescriptorSets* pPacket);
     void manually_replay_vkCmdBindDescriptorSets(packet_vkCmdBindDescriptorSets* pPacket);
+    // Replays the calls in a VKTRACE_TPI_CMD_BLOCK packet, generated along with replay()
+    vktrace_replay::VKTRACE_REPLAY_RESULT replay_cmd_block(vktrace_trace_packet_header* packet);
+    // Hands the traced GPU time in a VKTRACE_TPI_GPU_TIMING packet to GpuTimestamps
+    vktrace_replay::VKTRACE_REPLAY_RESULT replay_gpu_timing(vktrace_trace_packet_header* packet);
+    // Queries the replay device again for the results of a VKTRACE_TPI_QUERY_DIGEST packet that replay needs
+    vktrace_replay::VKTRACE_REPLAY_RESULT replay_query_digest(vktrace_trace_packet_header* packet);
     void manually_replay_vkCmdBindVertexBuffers(packet_vkCmdBindVertexBuffers* pPacket);
     VkResult manually_replay_vkGetPipelineCacheData(packet_vkGetPipelineCacheData* pPacket);
     VkResult manually_replay_vkCreateGraphicsPipelines(packet_vkCreateGraphicsPipelines* pPacket);
     VkResult manually_replay_vkCreateComputePipelines(packet_vkCreateComputePipelines* pPacket);
+    void manually_replay_vkDestroyShaderModule(packet_vkDestroyShaderModule* pPacket);
     VkResult manually_replay_vkCreatePipelineLayout(packet_vkCreatePipelineLayout* pPacket);
     void manually_replay_vkCmdWaitEvents(packet_vkCmdWaitEvents* pPacket);
     void manually_replay_vkCmdPipelineBarrier(packet_vkCmdPipelineBarrier* pPacket);
@@ -150,6 +193,10 @@ class vkReplay {
     VkResult manually_replay_vkBeginCommandBuffer(packet_vkBeginCommandBuffer* pPacket);
     VkResult manually_replay_vkAllocateCommandBuffers(packet_vkAllocateCommandBuffers* pPacket);
     VkResult manually_replay_vkWaitForFences(packet_vkWaitForFences* pPacket);
+    // Replace the polling calls if CollapsePolling is set
+    VkResult collapse_vkGetFenceStatus(packet_vkGetFenceStatus* pPacket);
+    VkResult collapse_vkGetEventStatus(packet_vkGetEventStatus* pPacket);
+    VkResult collapse_vkGetQueryPoolResults(packet_vkGetQueryPoolResults* pPacket);
     VkResult manually_replay_vkAllocateMemory(packet_vkAllocateMemory* pPacket);
     void manually_replay_vkFreeMemory(packet_vkFreeMemory* pPacket);
     VkResult manually_replay_vkMapMemory(packet_vkMapMemory* pPacket);
@@ -170,7 +217,9 @@ class vkReplay {
     VkResult manually_replay_vkCreateSwapchainKHR(packet_vkCreateSwapchainKHR* pPacket);
     void manually_replay_vkDestroySwapchainKHR(packet_vkDestroySwapchainKHR* pPacket);
     VkResult manually_replay_vkGetSwapchainImagesKHR(packet_vkGetSwapchainImagesKHR* pPacket);
+    VkResult manually_replay_vkAcquireNextImageKHR(packet_vkAcquireNextImageKHR* pPacket);
     VkResult manually_replay_vkQueuePresentKHR(packet_vkQueuePresentKHR* pPacket);
+    void manually_replay_vkDestroySurfaceKHR(packet_vkDestroySurfaceKHR* pPacket);
     VkResult manually_replay_vkCreateXcbSurfaceKHR(packet_vkCreateXcbSurfaceKHR* pPacket);
     VkBool32 manually_replay_vkGetPhysicalDeviceXcbPresentationSupportKHR(
         packet_vkGetPhysicalDeviceXcbPresentationSupportKHR* pPacket);
@@ -191,6 +240,7 @@ class vkReplay {
     void manually_replay_vkUpdateDescriptorSetWithTemplateKHR(packet_vkUpdateDescriptorSetWithTemplateKHR* pPacket);
     void manually_replay_vkCmdPushDescriptorSetWithTemplateKHR(packet_vkCmdPushDescriptorSetWithTemplateKHR* pPacket);
     VkResult manually_replay_vkBindBufferMemory(packet_vkBindBufferMemory* pPacket);
+    VkResult manually_replay_vkBindImageMemory(packet_vkBindImageMemory* pPacket);
     VkResult manually_replay_vkRegisterDeviceEventEXT(packet_vkRegisterDeviceEventEXT *pPacket);
     VkResult manually_replay_vkRegisterDisplayEventEXT(packet_vkRegisterDisplayEventEXT *pPacket);
     VkResult manually_replay_vkCreateObjectTableNVX(packet_vkCreateObjectTableNVX *pPacket);
@@ -233,6 +283,95 @@ class vkReplay {
     std::unordered_map<VkBuffer, VkDevice> traceBufferToDevice;
     std::unordered_map<VkBuffer, VkDevice> replayBufferToDevice;
 
+    // Map VkDeviceMemory to VkDevice, so we can search for the VkDevice used to allocate memory
+    std::unordered_map<VkDeviceMemory, VkDevice> replayDeviceMemoryToDevice;
+
+    // Places small allocations in shared blocks if Suballocate is set
+    vktrace_replay::MemorySuballocator* m_pMemorySuballocator;
+    // Offset to add to the offsets the trace uses with traceMemory
+    VkDeviceSize replay_memory_offset(VkDeviceMemory traceMemory);
+
+    // Map VkDevice to the first queue family it was created with
+    std::unordered_map<VkDevice, uint32_t> replayDeviceQueueFamily;
+
+    // Copy of an allocation made by save_loop_state(), through buffers that cover both allocations
+    struct LoopMemorySnapshot {
+        VkDevice device;
+        VkDeviceMemory memory;
+        VkBuffer memoryBuffer;
+        VkDeviceMemory savedMemory;
+        VkBuffer savedBuffer;
+        VkDeviceSize size;
+    };
+
+    // Queue and command buffer each device copies memory with
+    struct LoopCopyQueue {
+        VkQueue queue;
+        VkCommandPool commandPool;
+        VkCommandBuffer commandBuffer;
+        VkFence fence;
+    };
+
+    // Map trace VkDeviceMemory to the copy of its contents at the start of the loop
+    std::unordered_map<VkDeviceMemory, LoopMemorySnapshot> loopMemorySnapshots;
+    std::unordered_map<VkDevice, LoopCopyQueue> loopCopyQueues;
+
+    bool snapshot_loop_memory(VkDeviceMemory traceMemory, LoopMemorySnapshot* pSnapshot);
+    void release_loop_memory(LoopMemorySnapshot& snapshot);
+    void copy_loop_memory(bool restore);
+    void release_loop_state(VkDevice device);
+
+    // Pipeline cache every pipeline of a device is created with, and the file it is kept in
+    struct ReplayPipelineCache {
+        VkPipelineCache cache;
+        std::string path;
+    };
+    std::unordered_map<VkDevice, ReplayPipelineCache> replayPipelineCaches;
+
+    void create_pipeline_cache(VkDevice device, VkPhysicalDevice physicalDevice);
+    void save_pipeline_cache(VkDevice device);
+    VkPipelineCache get_pipeline_cache(VkDevice device, VkPipelineCache tracePipelineCache);
+
+    // Pipelines of one vkCreate*Pipelines call that are compiling on the pipeline threads
+    struct PendingPipelines {
+        VkResult result;
+        std::vector<VkPipeline> tracePipelines;
+        std::vector<VkPipeline> replayPipelines;
+    };
+    vktrace_replay::PipelineThreads* m_pPipelineThreads;
+    std::vector<std::shared_ptr<PendingPipelines>> m_pendingPipelines;
+
+    // Shader modules the trace destroyed while pipelines made from them may still be compiling
+    std::vector<std::pair<VkDevice, VkShaderModule>> m_pendingShaderModuleDestroys;
+
+    static bool replays_during_pipeline_creation(uint16_t packetId);
+    void finish_pipeline_creation();
+
+    // Stands in for surfaces and swapchains if Headless is set
+    vktrace_replay::HeadlessSwapchains* m_pHeadlessSwapchains;
+
+    // Times the submitted command buffers on the GPU if GpuTimestamps is set
+    vktrace_replay::GpuTimestamps* m_pGpuTimestamps;
+
+    // Labels the recorded commands with debug markers if Annotate is set
+    vktrace_replay::ReplayAnnotations* m_pAnnotations;
+    // Tags a recording call with its global_packet_index
+    void annotate(vktrace_trace_packet_header* packet);
+
+    // Leaves out draws before the frame FastForward is set to
+    vktrace_replay::FastForward* m_pFastForward;
+
+    // Opaque sparse bindings the trace made, to leave out binds that don't change them
+    vktrace_replay::SparseBindings m_sparseBindings;
+
+    // Where the trace stops using the objects it never destroys, if ReleaseUnused is set
+    vktrace_replay::TraceLifetimes* m_pLifetimes;
+    uint64_t m_forgottenObjects;
+
+    // Polls whose traced result said they weren't ready yet are skipped, and the poll that ends the run waits instead
+    bool m_collapsePolling;
+    uint64_t m_skippedPolls;
+
     // Map VkImage to VkDevice, so we can search for the VkDevice used to create an image
     std::unordered_map<VkImage, VkDevice> traceImageToDevice;
     std::unordered_map<VkImage, VkDevice> replayImageToDevice;
@@ -257,5 +396,7 @@ class vkReplay {
                            uint32_t* pReplayIdx);
     bool getQueueFamilyIdx(VkDevice traceDevice, VkDevice replayDevice, uint32_t traceIdx, uint32_t* pReplayIdx);
 
-    void remapHandlesInDescriptorSetWithTemplateData(VkDescriptorUpdateTemplateKHR remappedDescriptorUpdateTemplate, char* pData);
+    // pData with its handles remapped, in scratch memory that lasts until the packet's replay ends
+    const void* remapDescriptorSetWithTemplateData(VkDescriptorUpdateTemplateKHR remappedDescriptorUpdateTemplate,
+                                                   const void* pData);
 };
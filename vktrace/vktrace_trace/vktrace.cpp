@@ -27,6 +27,7 @@ extern "C" {
 #include "vktrace_common.h"
 #include "vktrace_filelike.h"
 #include "vktrace_interconnect.h"
+#include "vktrace_shared_ring.h"
 #include "vktrace_trace_packet_identifiers.h"
 #include "vktrace_trace_packet_utils.h"
 }
@@ -93,6 +94,75 @@ vktrace_SettingInfo g_settings_info[] = {
      {&g_default_settings.enable_pmb},
      TRUE,
      "Enable tracking of persistently mapped buffers, default is TRUE."},
+    {"z",
+     "Compress",
+     VKTRACE_SETTING_BOOL,
+     {&g_settings.compress_trace},
+     {&g_default_settings.compress_trace},
+     TRUE,
+     "Compress trace packets into LZ4 frames, default is FALSE."},
+    {"ch",
+     "CompactHeaders",
+     VKTRACE_SETTING_BOOL,
+     {&g_settings.compact_headers},
+     {&g_default_settings.compact_headers},
+     TRUE,
+     "Store packet headers in the trace file as variable-length deltas, default is FALSE."},
+    {"dt",
+     "DropTiming",
+     VKTRACE_SETTING_BOOL,
+     {&g_settings.drop_timing},
+     {&g_default_settings.drop_timing},
+     TRUE,
+     "Leave the packet times out of compact headers, default is FALSE."},
+    {"aw",
+     "AsyncWriter",
+     VKTRACE_SETTING_BOOL,
+     {&g_settings.enable_async_writer},
+     {&g_default_settings.enable_async_writer},
+     TRUE,
+     "Send trace packets from a background thread in the trace layer, default is FALSE."},
+    {"sd",
+     "ShardDir",
+     VKTRACE_SETTING_STRING,
+     {&g_settings.shard_dir},
+     {&g_default_settings.shard_dir},
+     TRUE,
+     "Have each thread of the program write its trace packets to a file of its own in <string>, and merge them into the "
+     "trace file when the program is done, default is none. Replaces AsyncWriter and DedupBlobs, and has no effect when "
+     "trimming."},
+    {"db",
+     "DedupBlobs",
+     VKTRACE_SETTING_BOOL,
+     {&g_settings.dedup_blobs},
+     {&g_default_settings.dedup_blobs},
+     TRUE,
+     "Keep shader code and mapped memory contents that the program passes again only once in the trace, default is FALSE. "
+     "Has no effect when trimming."},
+    {"cb",
+     "CmdBlocks",
+     VKTRACE_SETTING_BOOL,
+     {&g_settings.cmd_blocks},
+     {&g_default_settings.cmd_blocks},
+     TRUE,
+     "Trace runs of vkCmd* calls on the same command buffer as single packets, default is FALSE. Has no effect when "
+     "trimming."},
+    {"gt",
+     "GpuTiming",
+     VKTRACE_SETTING_BOOL,
+     {&g_settings.gpu_timing},
+     {&g_default_settings.gpu_timing},
+     TRUE,
+     "Time each primary command buffer on the GPU and keep the times in the trace, default is FALSE. Has no effect when "
+     "trimming."},
+    {"qd",
+     "QueryDigests",
+     VKTRACE_SETTING_BOOL,
+     {&g_settings.query_digests},
+     {&g_default_settings.query_digests},
+     TRUE,
+     "Keep only a digest of the format, feature, memory requirement and layout queries that replay asks the replay device "
+     "again, default is FALSE. Has no effect when trimming."},
 #if _DEBUG
     {"v",
      "Verbosity",
@@ -119,11 +189,35 @@ vktrace_SettingInfo g_settings_info[] = {
      {&g_settings.traceTrigger},
      {&g_default_settings.traceTrigger},
      TRUE,
-     "Start/stop trim by hotkey or frame range:\n\
+     "Start/stop trim by hotkey or frame range, or write the TrimRingFrames ring on slow frames:\n\
                                          hotkey-[F1-F12|TAB|CONTROL]\n\
                                          hotkey-[F1-F12|TAB|CONTROL]-<frameCount>\n\
                                          frames-<startFrame>-<endFrame>\n\
-                                         port[:<portnumber>][,<frameCount>]\n"},
+                                         port[:<portnumber>][,<frameCount>]\n\
+                                         hitch[-<milliseconds>|-<multiple>x][,<seconds>]\n"},
+    {"tc",
+     "TrimCompact",
+     VKTRACE_SETTING_BOOL,
+     {&g_settings.trim_compact},
+     {&g_default_settings.trim_compact},
+     TRUE,
+     "Drop the tracked calls of destroyed images and reset command pools while waiting for trim, default is FALSE."},
+    {"tw",
+     "TrimWindows",
+     VKTRACE_SETTING_BOOL,
+     {&g_settings.trim_windows},
+     {&g_default_settings.trim_windows},
+     TRUE,
+     "Let a hotkey or port TraceTrigger start a trim window again after the last one stopped. Each window is written to its "
+     "own trace file, default is FALSE."},
+    {"trf",
+     "TrimRingFrames",
+     VKTRACE_SETTING_UINT,
+     {&g_settings.trim_ring_frames},
+     {&g_default_settings.trim_ring_frames},
+     TRUE,
+     "Keep only the last <uint> to 2 * <uint> frames and let each hotkey, port or hitch TraceTrigger write them to a trace "
+     "file of their own, default is 0 (off), or 10 with a hitch TraceTrigger."},
     //{ "z", "pauze", VKTRACE_SETTING_BOOL, &g_settings.pause,
     //&g_default_settings.pause, TRUE, "Wait for a key at startup (so a debugger
     // can be attached)" },
@@ -262,18 +356,43 @@ char* find_available_filename(const char* originalFilename, bool bForceOverwrite
     return pOutputFilename;
 }
 
-// Portability table - Table of trace file offsets to packets
-// we need to access to determine what memory index should be used
-// in vkAllocateMemory during trace playback. This table is appended
-// to the trace file.
-std::vector<size_t> portabilityTable;
-uint32_t lastPacketThreadId;
-uint64_t lastPacketIndex;
-uint64_t lastPacketEndTime;
+// ------------------------------------------------------------------------------------------------
+char* find_process_filename(vktrace_process_id processId, uint32_t window) {
+    char suffix[32];
+#ifdef PLATFORM_LINUX
+    if (window == 0) {
+        snprintf(suffix, sizeof(suffix), "-pid%u", (uint32_t)processId);
+    } else {
+        snprintf(suffix, sizeof(suffix), "-pid%u-%u", (uint32_t)processId, window);
+    }
+#elif defined(WIN32)
+    if (window == 0) {
+        _snprintf_s(suffix, sizeof(suffix), _TRUNCATE, "-pid%u", (uint32_t)processId);
+    } else {
+        _snprintf_s(suffix, sizeof(suffix), _TRUNCATE, "-pid%u-%u", (uint32_t)processId, window);
+    }
+#endif
+    const char* pExtension = strrchr(g_settings.output_trace, '.');
+    char* basename = vktrace_allocate_and_copy_n(
+        g_settings.output_trace,
+        (int)((pExtension == NULL) ? strlen(g_settings.output_trace) : pExtension - g_settings.output_trace));
+    char* pNamed = vktrace_copy_and_append(basename, "", suffix);
+    char* pOutputFilename = vktrace_copy_and_append(pNamed, "", pExtension);
+    vktrace_free(pNamed);
+    vktrace_free(basename);
+    return pOutputFilename;
+}
 
-static void vktrace_appendPortabilityPacket(FILE* pTraceFile) {
+void vktrace_appendPortabilityPacket(vktrace_process_info* pProcInfo, vktrace_trace_tables* pTables) {
+    std::vector<size_t>& portabilityTable = pTables->portabilityTable;
+    std::vector<vktrace_frame_table_entry>& frameTable = pTables->frameTable;
+    std::vector<vktrace_frame_stats_entry>& frameStats = pTables->frameStats;
+    FILE* pTraceFile = pProcInfo->pTraceFile;
     vktrace_trace_packet_header hdr;
+    vktrace_frame_table_header frameTableHdr;
     uint64_t one_64 = 1;
+    uint64_t packetOffset;
+    bool packetWritten = false;
 
     if (pTraceFile == NULL) {
         vktrace_LogError("tracefile was not created");
@@ -286,22 +405,69 @@ static void vktrace_appendPortabilityPacket(FILE* pTraceFile) {
     // This will be the last word in the file.
     portabilityTable.push_back(portabilityTable.size());
 
+    // The frame table and frame statistics go in front of the portability table, which is found by
+    // reading backwards from the end of the file.
+    bool hasFrameStats = !frameTable.empty() && frameStats.size() == frameTable.size();
+    if (!hasFrameStats) frameStats.clear();
+    frameTableHdr.frame_count = frameTable.size();
+    size_t frameStatsBodyOffset = sizeof(frameTableHdr) + frameTable.size() * sizeof(vktrace_frame_table_entry);
+    std::vector<uint8_t> body(frameStatsBodyOffset + (hasFrameStats ? sizeof(frameTableHdr) : 0) +
+                              frameStats.size() * sizeof(vktrace_frame_stats_entry) + portabilityTable.size() * sizeof(size_t));
+    uint8_t* pBody = &body[0];
+    memcpy(pBody, &frameTableHdr, sizeof(frameTableHdr));
+    pBody += sizeof(frameTableHdr);
+    if (!frameTable.empty()) memcpy(pBody, &frameTable[0], frameTable.size() * sizeof(vktrace_frame_table_entry));
+    pBody += frameTable.size() * sizeof(vktrace_frame_table_entry);
+    if (hasFrameStats) {
+        memcpy(pBody, &frameTableHdr, sizeof(frameTableHdr));
+        pBody += sizeof(frameTableHdr);
+        memcpy(pBody, &frameStats[0], frameStats.size() * sizeof(vktrace_frame_stats_entry));
+        pBody += frameStats.size() * sizeof(vktrace_frame_stats_entry);
+    }
+    memcpy(pBody, &portabilityTable[0], portabilityTable.size() * sizeof(size_t));
+
     // Append the table packet to the trace file.
-    hdr.size = sizeof(hdr) + portabilityTable.size() * sizeof(size_t);
-    hdr.global_packet_index = lastPacketIndex + 1;
+    hdr.size = sizeof(hdr) + body.size();
+    hdr.global_packet_index = pTables->lastPacketIndex + 1;
     hdr.tracer_id = VKTRACE_TID_VULKAN;
     hdr.packet_id = VKTRACE_TPI_PORTABILITY_TABLE;
-    hdr.thread_id = lastPacketThreadId;
-    hdr.vktrace_begin_time = hdr.entrypoint_begin_time = hdr.entrypoint_end_time = hdr.vktrace_end_time = lastPacketEndTime;
+    hdr.thread_id = pTables->lastPacketThreadId;
+    hdr.vktrace_begin_time = hdr.entrypoint_begin_time = hdr.entrypoint_end_time = hdr.vktrace_end_time =
+        pTables->lastPacketEndTime;
     hdr.next_buffers_offset = 0;
     hdr.pBody = (uintptr_t)NULL;
-    if (0 == Fseek(pTraceFile, 0, SEEK_END) && 1 == fwrite(&hdr, sizeof(hdr), 1, pTraceFile) &&
-        portabilityTable.size() == fwrite(&portabilityTable[0], sizeof(size_t), portabilityTable.size(), pTraceFile)) {
-        // Set the flag in the file header that indicates the portability table has been written
+    if (pProcInfo->pCompressedWriter != NULL) {
+        // The table goes into the last frame, followed by the frame index
+        std::vector<uint8_t> packet(sizeof(hdr) + body.size());
+        memcpy(&packet[0], &hdr, sizeof(hdr));
+        memcpy(&packet[sizeof(hdr)], &body[0], body.size());
+        packetOffset = vktrace_CompressedWriter_GetPosition(pProcInfo->pCompressedWriter);
+        bool tableWritten = vktrace_CompressedWriter_WritePacket(pProcInfo->pCompressedWriter, &packet[0], packet.size()) != FALSE;
+        uint64_t frameIndexOffset = vktrace_CompressedWriter_Finish(pProcInfo->pCompressedWriter);
+        if (frameIndexOffset != 0 && 0 == fseek(pTraceFile, offsetof(vktrace_trace_file_header, frame_index_offset), SEEK_SET)) {
+            fwrite(&frameIndexOffset, sizeof(uint64_t), 1, pTraceFile);
+            packetWritten = tableWritten;
+        }
+    } else if (0 == Fseek(pTraceFile, 0, SEEK_END)) {
+        packetOffset = Ftell(pTraceFile);
+        packetWritten = 1 == fwrite(&hdr, sizeof(hdr), 1, pTraceFile) && 1 == fwrite(&body[0], body.size(), 1, pTraceFile);
+    }
+
+    if (packetWritten) {
+        // Set the flag in the file header that indicates the portability table has been written,
+        // and point the header at the frame table and frame statistics
+        uint64_t frameTableOffset = packetOffset + sizeof(hdr);
+        uint64_t frameStatsOffset = frameTableOffset + frameStatsBodyOffset;
         if (0 == fseek(pTraceFile, offsetof(vktrace_trace_file_header, portability_table_valid), SEEK_SET))
             fwrite(&one_64, sizeof(uint64_t), 1, pTraceFile);
+        if (!frameTable.empty() && 0 == fseek(pTraceFile, offsetof(vktrace_trace_file_header, frame_table_offset), SEEK_SET))
+            fwrite(&frameTableOffset, sizeof(uint64_t), 1, pTraceFile);
+        if (hasFrameStats && 0 == fseek(pTraceFile, offsetof(vktrace_trace_file_header, frame_stats_offset), SEEK_SET))
+            fwrite(&frameStatsOffset, sizeof(uint64_t), 1, pTraceFile);
     }
     portabilityTable.clear();
+    frameTable.clear();
+    frameStats.clear();
     vktrace_LogVerbose("Post processing of trace file completed");
 }
 
@@ -407,6 +573,12 @@ int main(int argc, char* argv[]) {
     }
 
     vktrace_set_global_var(VKTRACE_PMB_ENABLE_ENV, g_settings.enable_pmb ? "1" : "0");
+    vktrace_set_global_var(VKTRACE_ASYNC_WRITER_ENV, g_settings.enable_async_writer ? "1" : "0");
+    vktrace_set_global_var(VKTRACE_SHARD_DIR_ENV, g_settings.shard_dir != NULL ? g_settings.shard_dir : "");
+    vktrace_set_global_var(VKTRACE_DEDUP_BLOBS_ENV, g_settings.dedup_blobs ? "1" : "0");
+    vktrace_set_global_var(VKTRACE_CMD_BLOCKS_ENV, g_settings.cmd_blocks ? "1" : "0");
+    vktrace_set_global_var(VKTRACE_GPU_TIMING_ENV, g_settings.gpu_timing ? "1" : "0");
+    vktrace_set_global_var(VKTRACE_QUERY_DIGESTS_ENV, g_settings.query_digests ? "1" : "0");
 
     if (g_settings.traceTrigger) {
         // Export list to screenshot layer
@@ -414,102 +586,116 @@ int main(int argc, char* argv[]) {
     } else {
         vktrace_set_global_var(VKTRACE_TRIM_TRIGGER_ENV, "");
     }
+    vktrace_set_global_var(VKTRACE_TRIM_COMPACT_ENV, g_settings.trim_compact ? "1" : "0");
+    vktrace_set_global_var(VKTRACE_TRIM_WINDOWS_ENV, g_settings.trim_windows ? "1" : "0");
+    char trimRingFrames[16];
+#ifdef PLATFORM_LINUX
+    snprintf(trimRingFrames, sizeof(trimRingFrames), "%u", g_settings.trim_ring_frames);
+#elif defined(WIN32)
+    _snprintf_s(trimRingFrames, sizeof(trimRingFrames), _TRUNCATE, "%u", g_settings.trim_ring_frames);
+#endif
+    vktrace_set_global_var(VKTRACE_TRIM_RING_FRAMES_ENV, trimRingFrames);
+
+    // Create and start the process or run in server mode. Either way every process that connects
+    // until the program exits, or until vktrace is stopped in server mode, is traced.
+    BOOL procStarted = TRUE;
+    vktrace_process_info procInfo;
+    memset(&procInfo, 0, sizeof(vktrace_process_info));
+    if (g_settings.program != NULL) {
+        procInfo.exeName = vktrace_allocate_and_copy(g_settings.program);
+        procInfo.processArgs = vktrace_allocate_and_copy(g_settings.arguments);
+        procInfo.fullProcessCmdLine = vktrace_copy_and_append(g_settings.program, " ", g_settings.arguments);
+        procInfo.workingDirectory = vktrace_allocate_and_copy(g_settings.working_dir);
+    }
+    procInfo.parentThreadId = vktrace_platform_get_thread_id();
 
-    unsigned int serverIndex = 0;
-    do {
-        // Create and start the process or run in server mode
-
-        BOOL procStarted = TRUE;
-        vktrace_process_info procInfo;
-        memset(&procInfo, 0, sizeof(vktrace_process_info));
-        if (g_settings.program != NULL) {
-            procInfo.exeName = vktrace_allocate_and_copy(g_settings.program);
-            procInfo.processArgs = vktrace_allocate_and_copy(g_settings.arguments);
-            procInfo.fullProcessCmdLine = vktrace_copy_and_append(g_settings.program, " ", g_settings.arguments);
-            procInfo.workingDirectory = vktrace_allocate_and_copy(g_settings.working_dir);
-            procInfo.traceFilename = vktrace_allocate_and_copy(g_settings.output_trace);
-        } else {
-            procInfo.traceFilename = find_available_filename(g_settings.output_trace, true);
-        }
-
-        procInfo.parentThreadId = vktrace_platform_get_thread_id();
-
-        // setup tracer, only Vulkan tracer suppported
-        PrepareTracers(&procInfo.pCaptureThreads);
+    // setup tracer, only Vulkan tracer suppported
+    PrepareTracers(&procInfo.pCaptureThreads);
 
-        if (g_settings.program != NULL) {
-            char* instEnv = vktrace_get_global_var("VK_INSTANCE_LAYERS");
-            // Add ScreenShot layer if enabled
-            if (g_settings.screenshotList && (!instEnv || !strstr(instEnv, "VK_LAYER_LUNARG_screenshot"))) {
-                if (!instEnv || strlen(instEnv) == 0)
-                    vktrace_set_global_var("VK_INSTANCE_LAYERS", "VK_LAYER_LUNARG_screenshot");
-                else {
-                    char* newEnv = vktrace_copy_and_append(instEnv, VKTRACE_LIST_SEPARATOR, "VK_LAYER_LUNARG_screenshot");
-                    vktrace_set_global_var("VK_INSTANCE_LAYERS", newEnv);
-                }
-                instEnv = vktrace_get_global_var("VK_INSTANCE_LAYERS");
-            }
-            char* devEnv = vktrace_get_global_var("VK_DEVICE_LAYERS");
-            if (g_settings.screenshotList && (!devEnv || !strstr(devEnv, "VK_LAYER_LUNARG_screenshot"))) {
-                if (!devEnv || strlen(devEnv) == 0)
-                    vktrace_set_global_var("VK_DEVICE_LAYERS", "VK_LAYER_LUNARG_screenshot");
-                else {
-                    char* newEnv = vktrace_copy_and_append(devEnv, VKTRACE_LIST_SEPARATOR, "VK_LAYER_LUNARG_screenshot");
-                    vktrace_set_global_var("VK_DEVICE_LAYERS", newEnv);
-                }
-                devEnv = vktrace_get_global_var("VK_DEVICE_LAYERS");
-            }
-            // Add vktrace_layer enable env var if needed
-            if (!instEnv || strlen(instEnv) == 0) {
-                vktrace_set_global_var("VK_INSTANCE_LAYERS", "VK_LAYER_LUNARG_vktrace");
-            } else if (instEnv != strstr(instEnv, "VK_LAYER_LUNARG_vktrace")) {
-                char* newEnv = vktrace_copy_and_append("VK_LAYER_LUNARG_vktrace", VKTRACE_LIST_SEPARATOR, instEnv);
+    // A program launched here sends the trace through shared memory rather than the socket. The
+    // processes it starts inherit the ring, but they find it taken and fall back to the socket.
+    SharedRing* pSharedRing = NULL;
+    if (g_settings.program != NULL) {
+        pSharedRing = vktrace_SharedRing_create(VKTRACE_SHARED_RING_SIZE);
+    }
+    vktrace_set_global_var(VKTRACE_SHARED_MEMORY_ENV, pSharedRing != NULL ? vktrace_SharedRing_get_name(pSharedRing) : "");
+
+    if (g_settings.program != NULL) {
+        char* instEnv = vktrace_get_global_var("VK_INSTANCE_LAYERS");
+        // Add ScreenShot layer if enabled
+        if (g_settings.screenshotList && (!instEnv || !strstr(instEnv, "VK_LAYER_LUNARG_screenshot"))) {
+            if (!instEnv || strlen(instEnv) == 0)
+                vktrace_set_global_var("VK_INSTANCE_LAYERS", "VK_LAYER_LUNARG_screenshot");
+            else {
+                char* newEnv = vktrace_copy_and_append(instEnv, VKTRACE_LIST_SEPARATOR, "VK_LAYER_LUNARG_screenshot");
                 vktrace_set_global_var("VK_INSTANCE_LAYERS", newEnv);
             }
-            if (!devEnv || strlen(devEnv) == 0) {
-                vktrace_set_global_var("VK_DEVICE_LAYERS", "VK_LAYER_LUNARG_vktrace");
-            } else if (devEnv != strstr(devEnv, "VK_LAYER_LUNARG_vktrace")) {
-                char* newEnv = vktrace_copy_and_append("VK_LAYER_LUNARG_vktrace", VKTRACE_LIST_SEPARATOR, devEnv);
+            instEnv = vktrace_get_global_var("VK_INSTANCE_LAYERS");
+        }
+        char* devEnv = vktrace_get_global_var("VK_DEVICE_LAYERS");
+        if (g_settings.screenshotList && (!devEnv || !strstr(devEnv, "VK_LAYER_LUNARG_screenshot"))) {
+            if (!devEnv || strlen(devEnv) == 0)
+                vktrace_set_global_var("VK_DEVICE_LAYERS", "VK_LAYER_LUNARG_screenshot");
+            else {
+                char* newEnv = vktrace_copy_and_append(devEnv, VKTRACE_LIST_SEPARATOR, "VK_LAYER_LUNARG_screenshot");
                 vktrace_set_global_var("VK_DEVICE_LAYERS", newEnv);
             }
-            // call CreateProcess to launch the application
-            procStarted = vktrace_process_spawn(&procInfo);
+            devEnv = vktrace_get_global_var("VK_DEVICE_LAYERS");
+        }
+        // Add vktrace_layer enable env var if needed
+        if (!instEnv || strlen(instEnv) == 0) {
+            vktrace_set_global_var("VK_INSTANCE_LAYERS", "VK_LAYER_LUNARG_vktrace");
+        } else if (instEnv != strstr(instEnv, "VK_LAYER_LUNARG_vktrace")) {
+            char* newEnv = vktrace_copy_and_append("VK_LAYER_LUNARG_vktrace", VKTRACE_LIST_SEPARATOR, instEnv);
+            vktrace_set_global_var("VK_INSTANCE_LAYERS", newEnv);
+        }
+        if (!devEnv || strlen(devEnv) == 0) {
+            vktrace_set_global_var("VK_DEVICE_LAYERS", "VK_LAYER_LUNARG_vktrace");
+        } else if (devEnv != strstr(devEnv, "VK_LAYER_LUNARG_vktrace")) {
+            char* newEnv = vktrace_copy_and_append("VK_LAYER_LUNARG_vktrace", VKTRACE_LIST_SEPARATOR, devEnv);
+            vktrace_set_global_var("VK_DEVICE_LAYERS", newEnv);
         }
-        if (procStarted == FALSE) {
-            vktrace_LogError("Failed to set up remote process.");
+        // call CreateProcess to launch the application
+        procStarted = vktrace_process_spawn(&procInfo);
+    }
+    if (procStarted == FALSE) {
+        vktrace_LogError("Failed to set up remote process.");
+        exit(1);
+    } else {
+        if (InjectTracersIntoProcess(&procInfo) == FALSE) {
+            vktrace_LogError("Failed to set up tracer communication threads.");
             exit(1);
-        } else {
-            if (InjectTracersIntoProcess(&procInfo) == FALSE) {
-                vktrace_LogError("Failed to set up tracer communication threads.");
-                exit(1);
-            }
+        }
 
-            // create watchdog thread to monitor existence of remote process
-            if (g_settings.program != NULL)
-            {
-                procInfo.watchdogThread = vktrace_platform_create_thread(Process_RunWatchdogThread, &procInfo);
-            }
+        // create watchdog thread to monitor existence of remote process
+        if (g_settings.program != NULL)
+        {
+            procInfo.watchdogThread = vktrace_platform_create_thread(Process_RunWatchdogThread, &procInfo);
+        }
 
 #if defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
 
-            // Sync wait for local threads and remote process to complete.
-            if (g_settings.program != NULL) {
-                vktrace_linux_sync_wait_for_thread(&procInfo.watchdogThread);
-            }
-
-            vktrace_linux_sync_wait_for_thread(&(procInfo.pCaptureThreads[0].recordingThread));
+        // Sync wait for local threads and remote process to complete.
+        if (g_settings.program != NULL) {
+            vktrace_linux_sync_wait_for_thread(&procInfo.watchdogThread);
+        }
 
 #else
-            vktrace_platform_resume_thread(&procInfo.hThread);
+        vktrace_platform_resume_thread(&procInfo.hThread);
 
-            // Now into the main message loop, listen for hotkeys to send over.
-            exitval = MessageLoop();
+        // Now into the main message loop, listen for hotkeys to send over.
+        exitval = MessageLoop();
 #endif
+
+        // Take no more connections once the program is gone, and wait for those being traced to
+        // finish. In server mode the connections are taken until vktrace is stopped.
+        if (g_settings.program != NULL) {
+            procInfo.serverRequestsTermination = TRUE;
         }
-        vktrace_appendPortabilityPacket(procInfo.pTraceFile);
-        vktrace_process_info_delete(&procInfo);
-        serverIndex++;
-    } while (g_settings.program == NULL);
+        Process_WaitForThread(&(procInfo.pCaptureThreads[0].recordingThread));
+    }
+    vktrace_process_info_delete(&procInfo);
+    vktrace_SharedRing_destroy(&pSharedRing);
 
     vktrace_SettingGroup_delete(&g_settingGroup);
     vktrace_free(g_default_settings.output_trace);
@@ -22,6 +22,7 @@
 
 extern "C" {
 #include "vktrace_settings.h"
+#include "vktrace_trace_packet_identifiers.h"
 }
 
 #include <vector>
@@ -42,18 +43,52 @@ typedef struct vktrace_settings {
     const char* screenshotList;
     const char* screenshotColorFormat;
     BOOL enable_pmb;
+    BOOL enable_async_writer;
+    const char* shard_dir;
+    BOOL dedup_blobs;
+    BOOL cmd_blocks;
+    BOOL gpu_timing;
+    BOOL query_digests;
+    BOOL compress_trace;
+    BOOL compact_headers;
+    BOOL drop_timing;
     const char* verbosity;
     const char* traceTrigger;
+    BOOL trim_compact;
+    BOOL trim_windows;
+    unsigned int trim_ring_frames;
 
 } vktrace_settings;
 
 extern vktrace_settings g_settings;
 
-// Portability table - Table of trace file offsets to packets
-// we need to access to determine what memory index should be used
-// in vkAllocateMemory during trace playback. This table is appended
-// to the trace file.
-extern std::vector<size_t> portabilityTable;
-extern uint32_t lastPacketThreadId;
-extern uint64_t lastPacketIndex;
-extern uint64_t lastPacketEndTime;
+// What vktrace keeps track of while it writes a trace file, and appends to the file at the end
+struct vktrace_trace_tables {
+    // Portability table - Table of trace file offsets to packets
+    // we need to access to determine what memory index should be used
+    // in vkAllocateMemory during trace playback. This table is appended
+    // to the trace file.
+    std::vector<size_t> portabilityTable;
+
+    // Frame table - Offset of the first packet of each frame, see vktrace_frame_table_header.
+    // Written at the start of the portability table packet.
+    std::vector<vktrace_frame_table_entry> frameTable;
+
+    // Frame statistics - What each frame of frameTable holds, see vktrace_frame_stats_entry. The last
+    // entry is the frame being traced. Written after the frame table.
+    std::vector<vktrace_frame_stats_entry> frameStats;
+    // Where the frame being traced started, 0 if it starts with the next packet
+    uint64_t frameStartTime;
+
+    uint32_t lastPacketThreadId;
+    uint64_t lastPacketIndex;
+    uint64_t lastPacketEndTime;
+};
+
+char* find_available_filename(const char* originalFilename, bool bForceOverwrite);
+// Name of the trace file of a process traced while another one was, <output>-pid<processId>.vktrace,
+// with -<window> before the extension for the files of its later trim windows
+char* find_process_filename(vktrace_process_id processId, uint32_t window);
+
+// Writes the frame and portability tables to the end of the trace file and clears them
+void vktrace_appendPortabilityPacket(struct vktrace_process_info* pProcInfo, vktrace_trace_tables* pTables);
@@ -19,6 +19,7 @@
  * Author: Peter Lohrmann <peterl@valvesoftware.com>
  */
 
+#include <queue>
 #include <string>
 #include "vktrace_process.h"
 #include "vktrace.h"
@@ -43,6 +44,9 @@ extern "C" {
 
 const unsigned long kWatchDogPollTime = 250;
 
+// Packets at least this big are received straight into an uncompressed trace file
+const uint64_t kSpliceMinPacketSize = 64 * 1024;
+
 #if defined(WIN32)
 void SafeCloseHandle(HANDLE& _handle) {
     if (_handle) {
@@ -113,15 +117,282 @@ VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunWatchdogThread(LPVOID _procInfoPtr
 bool terminationSignalArrived = false;
 void terminationSignalHandler(int sig) { terminationSignalArrived = true; }
 
+// ------------------------------------------------------------------------------------------------
+// Reads a packet from the socket like vktrace_read_trace_packet. Large packets are written to the
+// trace file while they are received instead, and then only their header is returned, without a body.
+static vktrace_trace_packet_header* receive_trace_packet(FileLike* pSocket, MessageStream* pMessageStream,
+                                                         vktrace_process_info* pProcessInfo, bool* pSpliced) {
+    vktrace_trace_packet_header header;
+    *pSpliced = false;
+    if (vktrace_FileLike_ReadRaw(pSocket, &header, sizeof(header)) == FALSE) {
+        return NULL;
+    }
+
+    vktrace_trace_packet_header* pHeader;
+    // The calls in command blocks are counted for the frame statistics, the blocks are never much
+    // bigger than kSpliceMinPacketSize anyway
+    if (header.size >= kSpliceMinPacketSize && header.packet_id != VKTRACE_TPI_MESSAGE &&
+        header.packet_id != VKTRACE_TPI_CMD_BLOCK && pProcessInfo->pTraceFile != NULL && pProcessInfo->pCompressedWriter == NULL) {
+        vktrace_enter_critical_section(&pProcessInfo->traceFileCriticalSection);
+        bool written = fwrite(&header, sizeof(header), 1, pProcessInfo->pTraceFile) == 1 &&
+                       vktrace_MessageStream_RecvToFile(pMessageStream, pProcessInfo->pTraceFile,
+                                                        (size_t)header.size - sizeof(header)) != FALSE;
+        vktrace_leave_critical_section(&pProcessInfo->traceFileCriticalSection);
+        if (!written) {
+            vktrace_LogError("Failed to write the packet for packet_id = %hu", header.packet_id);
+            return NULL;
+        }
+
+        pHeader = (vktrace_trace_packet_header*)vktrace_malloc(sizeof(header));
+        *pHeader = header;
+        pHeader->pBody = (uintptr_t)NULL;
+        *pSpliced = true;
+        return pHeader;
+    }
+
+    pHeader = (vktrace_trace_packet_header*)vktrace_malloc((size_t)header.size);
+    if (pHeader == NULL) {
+        vktrace_LogError("Malloc failed in receive_trace_packet of size %u.", header.size);
+        return NULL;
+    }
+    *pHeader = header;
+    if (header.size > sizeof(header) &&
+        vktrace_FileLike_ReadRaw(pSocket, pHeader + 1, (size_t)header.size - sizeof(header)) == FALSE) {
+        vktrace_LogError("Failed to read trace packet with size of %u.", header.size);
+        vktrace_free(pHeader);
+        return NULL;
+    }
+    pHeader->pBody = (uintptr_t)pHeader + sizeof(vktrace_trace_packet_header);
+    return pHeader;
+}
+
+// ------------------------------------------------------------------------------------------------
+static int frame_stats_category(uint16_t packetId) {
+    static const std::vector<int> categories = [] {
+        std::vector<int> table(VKTRACE_TPI_QUERY_DIGEST + 1);
+        for (size_t id = 0; id < table.size(); id++) {
+            table[id] = vktrace_frame_stats_call_category(vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)id));
+        }
+        return table;
+    }();
+    return packetId < categories.size() ? categories[packetId] : VKTRACE_FRAME_STATS_CATEGORY_COUNT;
+}
+
+// ------------------------------------------------------------------------------------------------
+static void start_frame_stats(vktrace_trace_tables* pTables, uint64_t startTime) {
+    vktrace_frame_stats_entry stats = {};
+    pTables->frameStats.push_back(stats);
+    pTables->frameStartTime = startTime;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Adds a packet written to the trace file to the statistics of the frame being traced. Packets
+// whose body was spliced into the file only count by their header.
+static void add_frame_stats(vktrace_trace_tables* pTables, const vktrace_trace_packet_header* pHeader) {
+    if (pTables->frameStats.empty()) return;
+
+    vktrace_frame_stats_entry& stats = pTables->frameStats.back();
+    if (pTables->frameStartTime == 0) pTables->frameStartTime = pHeader->vktrace_begin_time;
+    stats.cpu_time =
+        pHeader->vktrace_end_time > pTables->frameStartTime ? pHeader->vktrace_end_time - pTables->frameStartTime : 0;
+    stats.packet_count++;
+
+    if (pHeader->packet_id == VKTRACE_TPI_CMD_BLOCK) {
+        if (pHeader->pBody == (uintptr_t)NULL) return;
+        vktrace_cmd_block_reader reader;
+        uint16_t opcode;
+        vktrace_cmd_block_reader_init(&reader, (const vktrace_cmd_block*)pHeader->pBody);
+        while (vktrace_cmd_block_next(&reader, &opcode)) {
+            int category = frame_stats_category(opcode);
+            if (category != VKTRACE_FRAME_STATS_CATEGORY_COUNT) stats.call_count[category]++;
+        }
+        return;
+    }
+
+    int category = frame_stats_category(pHeader->packet_id);
+    if (category != VKTRACE_FRAME_STATS_CATEGORY_COUNT) stats.call_count[category]++;
+    if (pHeader->packet_id == VKTRACE_TPI_VK_vkFlushMappedMemoryRanges || pHeader->packet_id == VKTRACE_TPI_VK_vkUnmapMemory) {
+        stats.upload_bytes += pHeader->size - sizeof(vktrace_trace_packet_header);
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+// Finishes the trace file of a trim window and starts the file of the next window with the same header
+static bool start_next_trace_file(vktrace_trace_connection* pConnection, const vktrace_trace_file_header& fileHeader,
+                                  const std::vector<struct_gpuinfo>& gpuinfo) {
+    vktrace_process_info* pProcessInfo = &pConnection->traceInfo;
+    vktrace_enter_critical_section(&pProcessInfo->traceFileCriticalSection);
+    vktrace_appendPortabilityPacket(pProcessInfo, &pConnection->tables);
+    vktrace_CompressedWriter_destroy(&pProcessInfo->pCompressedWriter);
+    vktrace_LogDebug("Closing trace file: '%s'", pProcessInfo->traceFilename);
+    fclose(pProcessInfo->pTraceFile);
+    VKTRACE_DELETE(pProcessInfo->traceFilename);
+
+    pConnection->windowCount++;
+    if (pConnection->namedByProcessId) {
+        pProcessInfo->traceFilename = find_process_filename(pProcessInfo->processId, pConnection->windowCount);
+    } else {
+        pProcessInfo->traceFilename = find_available_filename(g_settings.output_trace, true);
+    }
+    pProcessInfo->pTraceFile = fopen(pProcessInfo->traceFilename, "w+b");
+    bool started = pProcessInfo->pTraceFile != NULL;
+    if (started) {
+        vktrace_LogAlways("Writing the next trim window to trace file: '%s'", pProcessInfo->traceFilename);
+        started = fwrite(&fileHeader, sizeof(fileHeader), 1, pProcessInfo->pTraceFile) == 1 &&
+                  fwrite(gpuinfo.data(), sizeof(struct_gpuinfo), gpuinfo.size(), pProcessInfo->pTraceFile) == gpuinfo.size();
+        fflush(pProcessInfo->pTraceFile);
+    }
+    if (started && fileHeader.compression_type != VKTRACE_COMPRESSION_NONE) {
+        pProcessInfo->pCompressedWriter = vktrace_CompressedWriter_create(pProcessInfo->pTraceFile, fileHeader.compression_type);
+        started = pProcessInfo->pCompressedWriter != NULL;
+    }
+    vktrace_leave_critical_section(&pProcessInfo->traceFileCriticalSection);
+    if (!started) {
+        vktrace_LogError("Unable to create trace file %s for the next trim window.", pProcessInfo->traceFilename);
+        return false;
+    }
+
+    // Frame 0 starts with the first packet
+    vktrace_frame_table_entry frame = {fileHeader.first_packet_offset, 0};
+    pConnection->tables.frameTable.push_back(frame);
+    start_frame_stats(&pConnection->tables, 0);
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Writes a packet of the traced process to its trace file and adds it to the tables, spliced if it is in the file already
+static void write_received_packet(vktrace_trace_connection* pConnection, vktrace_trace_packet_header* pHeader, bool spliced,
+                                  size_t* pFileOffset) {
+    vktrace_process_info* pProcessInfo = &pConnection->traceInfo;
+    vktrace_trace_tables* pTables = &pConnection->tables;
+    size_t bytes_written;
+
+    if (pHeader->packet_id == VKTRACE_TPI_MESSAGE) {
+        if (g_settings.print_trace_messages == TRUE) {
+            vktrace_trace_packet_message* pPacket = vktrace_interpret_body_as_trace_packet_message(pHeader);
+            vktrace_LogAlways("Packet %lu: Traced Message (%s): %s", pHeader->global_packet_index,
+                              vktrace_LogLevelToShortString(pPacket->type), pPacket->message);
+            vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->message));
+        }
+    }
+
+    if (pProcessInfo->pTraceFile != NULL) {
+        if (spliced) {
+            // The packet was received into the trace file already
+            bytes_written = (size_t)pHeader->size;
+        } else {
+            vktrace_enter_critical_section(&pProcessInfo->traceFileCriticalSection);
+            if (pProcessInfo->pCompressedWriter != NULL) {
+                bytes_written = vktrace_CompressedWriter_WritePacket(pProcessInfo->pCompressedWriter, pHeader,
+                                                                     (size_t)pHeader->size)
+                                    ? (size_t)pHeader->size
+                                    : 0;
+            } else {
+                bytes_written = fwrite(pHeader, 1, (size_t)pHeader->size, pProcessInfo->pTraceFile);
+                fflush(pProcessInfo->pTraceFile);
+            }
+            vktrace_leave_critical_section(&pProcessInfo->traceFileCriticalSection);
+            if (bytes_written != pHeader->size) {
+                vktrace_LogError("Failed to write the packet for packet_id = %hu", pHeader->packet_id);
+            }
+        }
+
+        // If the packet is one we need to track, add it to the table
+        if (pHeader->packet_id == VKTRACE_TPI_VK_vkBindImageMemory ||
+            pHeader->packet_id == VKTRACE_TPI_VK_vkBindBufferMemory ||
+            pHeader->packet_id == VKTRACE_TPI_VK_vkAllocateMemory || pHeader->packet_id == VKTRACE_TPI_VK_vkDestroyImage ||
+            pHeader->packet_id == VKTRACE_TPI_VK_vkDestroyBuffer || pHeader->packet_id == VKTRACE_TPI_VK_vkFreeMemory ||
+            pHeader->packet_id == VKTRACE_TPI_VK_vkCreateBuffer || pHeader->packet_id == VKTRACE_TPI_VK_vkCreateImage) {
+            pTables->portabilityTable.push_back(*pFileOffset);
+        }
+        add_frame_stats(pTables, pHeader);
+        if (pHeader->packet_id == VKTRACE_TPI_VK_vkQueuePresentKHR) {
+            vktrace_frame_table_entry frame = {*pFileOffset + bytes_written, pHeader->global_packet_index};
+            pTables->frameTable.push_back(frame);
+            start_frame_stats(pTables, pHeader->vktrace_end_time);
+        }
+        pTables->lastPacketIndex = pHeader->global_packet_index;
+        pTables->lastPacketThreadId = pHeader->thread_id;
+        pTables->lastPacketEndTime = pHeader->vktrace_end_time;
+        *pFileOffset += bytes_written;
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+// Merges the trace shards the process wrote, see vktrace_lib_shardwriter.h, into its trace file in global_packet_index
+// order, and deletes them. Only the next packet of each shard is read at a time.
+static void merge_trace_shards(vktrace_trace_connection* pConnection, size_t* pFileOffset) {
+    struct TraceShard {
+        std::string path;
+        FILE* pFile;
+        FileLike* pFileLike;
+        vktrace_trace_packet_header* pHeader;
+    };
+
+    std::vector<TraceShard> shards;
+    for (uint32_t i = 0;; i++) {
+        char path[4096];
+        snprintf(path, sizeof(path), VKTRACE_SHARD_FILE_FORMAT, g_settings.shard_dir, (uint32_t)pConnection->traceInfo.processId,
+                 i);
+        FILE* pFile = fopen(path, "rb");
+        if (pFile == NULL) break;
+        TraceShard shard = {path, pFile, vktrace_FileLike_create_file(pFile), NULL};
+        shard.pHeader = vktrace_read_trace_packet(shard.pFileLike);
+        shards.push_back(shard);
+    }
+    if (shards.empty()) return;
+
+    // Shard with the lowest index next
+    auto later = [&shards](size_t a, size_t b) {
+        return shards[a].pHeader->global_packet_index > shards[b].pHeader->global_packet_index;
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(later)> next(later);
+    for (size_t i = 0; i < shards.size(); i++) {
+        if (shards[i].pHeader != NULL) next.push(i);
+    }
+
+    uint64_t packetCount = 0;
+    while (!next.empty()) {
+        TraceShard& shard = shards[next.top()];
+        next.pop();
+        write_received_packet(pConnection, shard.pHeader, false, pFileOffset);
+        vktrace_delete_trace_packet(&shard.pHeader);
+        packetCount++;
+        shard.pHeader = vktrace_read_trace_packet(shard.pFileLike);
+        if (shard.pHeader != NULL) next.push(&shard - &shards[0]);
+    }
+
+    for (size_t i = 0; i < shards.size(); i++) {
+        VKTRACE_DELETE(shards[i].pFileLike);
+        fclose(shards[i].pFile);
+        remove(shards[i].path.c_str());
+    }
+    vktrace_LogVerbose("Merged %llu packets of process %u from %u trace shards.", (unsigned long long)packetCount,
+                       (uint32_t)pConnection->traceInfo.processId, (uint32_t)shards.size());
+}
+
+// ------------------------------------------------------------------------------------------------
+void Process_WaitForThread(vktrace_thread* pThread) {
+#if defined(WIN32)
+    WaitForSingleObject(*pThread, INFINITE);
+#else
+    vktrace_linux_sync_wait_for_thread(pThread);
+#endif
+}
+
+// ------------------------------------------------------------------------------------------------
+static void delete_connection(vktrace_trace_connection* pConnection) {
+    if (pConnection->pMessageStream != NULL) {
+        vktrace_MessageStream_destroy(&pConnection->pMessageStream);
+    }
+    vktrace_platform_delete_thread(&pConnection->receiveThread);
+    vktrace_process_info_delete(&pConnection->traceInfo);
+    delete pConnection;
+}
+
 // ------------------------------------------------------------------------------------------------
 VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadInfo) {
     vktrace_process_capture_trace_thread_info* pInfo = (vktrace_process_capture_trace_thread_info*)_threadInfo;
-    FileLike* fileLikeSocket;
-    uint64_t fileHeaderSize;
-    vktrace_trace_file_header file_header;
-    vktrace_trace_packet_header* pHeader = NULL;
-    size_t bytes_written;
-    size_t fileOffset;
 #if defined(WIN32)
     BOOL rval;
 #elif defined(PLATFORM_LINUX)
@@ -130,19 +401,120 @@ VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadIn
     sig_t rval;
 #endif
 
-    MessageStream* pMessageStream = vktrace_MessageStream_create(TRUE, "", VKTRACE_BASE_PORT + pInfo->tracerId);
-    if (pMessageStream == NULL) {
+    unsigned int port = VKTRACE_BASE_PORT + pInfo->tracerId;
+    SOCKET listenSocket = vktrace_MessageStream_listen(port);
+    if (listenSocket == INVALID_SOCKET) {
         vktrace_LogError("Thread_CaptureTrace() cannot create message stream.");
         return 1;
     }
 
+#if defined(WIN32)
+    rval = SetConsoleCtrlHandler((PHANDLER_ROUTINE)terminationSignalHandler, TRUE);
+    assert(rval);
+#else
+    rval = signal(SIGHUP, terminationSignalHandler);
+    assert(rval != SIG_ERR);
+    rval = signal(SIGINT, terminationSignalHandler);
+    assert(rval != SIG_ERR);
+    rval = signal(SIGTERM, terminationSignalHandler);
+    assert(rval != SIG_ERR);
+#endif
+
+    std::vector<vktrace_trace_connection*> connections;
+    // The connection writing the files named by OutputTrace, a process that connects while it is
+    // traced gets files named after it instead
+    vktrace_trace_connection* pNamedConnection = NULL;
+    while (!terminationSignalArrived && pInfo->pProcessInfo->serverRequestsTermination == FALSE) {
+        MessageStream* pMessageStream = vktrace_MessageStream_accept(listenSocket, port, kWatchDogPollTime);
+
+        for (size_t i = 0; i < connections.size();) {
+            if (connections[i]->finished) {
+                Process_WaitForThread(&connections[i]->receiveThread);
+                if (connections[i] == pNamedConnection) pNamedConnection = NULL;
+                delete_connection(connections[i]);
+                connections.erase(connections.begin() + i);
+            } else {
+                i++;
+            }
+        }
+        if (pMessageStream == NULL) continue;
+
+        vktrace_trace_connection* pConnection = new vktrace_trace_connection();
+        memset(&pConnection->traceInfo, 0, sizeof(pConnection->traceInfo));
+        pConnection->traceInfo.processId = pMessageStream->mPeerProcessId;
+        pConnection->traceInfo.parentThreadId = pInfo->pProcessInfo->parentThreadId;
+        pConnection->pMessageStream = pMessageStream;
+        pConnection->windowCount = 0;
+        pConnection->finished = false;
+        if (pNamedConnection == NULL) {
+            // Takes the next file index, the files of later trim windows get the ones after it
+            pConnection->traceInfo.traceFilename = find_available_filename(g_settings.output_trace, true);
+            pConnection->namedByProcessId = false;
+            pNamedConnection = pConnection;
+        } else {
+            pConnection->traceInfo.traceFilename = find_process_filename(pMessageStream->mPeerProcessId, 0);
+            pConnection->namedByProcessId = true;
+        }
+        vktrace_LogVerbose("Tracing process %u to trace file '%s'.", (uint32_t)pMessageStream->mPeerProcessId,
+                           pConnection->traceInfo.traceFilename);
+
+        pConnection->receiveThread = vktrace_platform_create_thread(Process_RunReceiveThread, pConnection);
+        if (pConnection->receiveThread == VKTRACE_NULL_THREAD) {
+            vktrace_LogError("Failed to create the thread receiving process %u.", (uint32_t)pMessageStream->mPeerProcessId);
+            if (pConnection == pNamedConnection) pNamedConnection = NULL;
+            delete_connection(pConnection);
+            continue;
+        }
+        connections.push_back(pConnection);
+    }
+
+    // Take no more processes, and let those being traced finish
+    vktrace_MessageStream_close_listener(listenSocket);
+    for (size_t i = 0; i < connections.size(); i++) {
+        Process_WaitForThread(&connections[i]->receiveThread);
+        delete_connection(connections[i]);
+    }
+
+#if defined(WIN32)
+    PostThreadMessage(pInfo->pProcessInfo->parentThreadId, VKTRACE_WM_COMPLETE, 0, 0);
+#endif
+
+// Restore signal handling to default.
+#if defined(WIN32)
+    rval = SetConsoleCtrlHandler((PHANDLER_ROUTINE)terminationSignalHandler, FALSE);
+    assert(rval);
+#else
+    rval = signal(SIGHUP, SIG_DFL);
+    assert(rval != SIG_ERR);
+    rval = signal(SIGINT, SIG_DFL);
+    assert(rval != SIG_ERR);
+    rval = signal(SIGTERM, SIG_DFL);
+    assert(rval != SIG_ERR);
+#endif
+
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunReceiveThread(LPVOID _connection) {
+    vktrace_trace_connection* pConnection = (vktrace_trace_connection*)_connection;
+    vktrace_process_info* pProcessInfo = &pConnection->traceInfo;
+    vktrace_trace_tables* pTables = &pConnection->tables;
+    MessageStream* pMessageStream = pConnection->pMessageStream;
+    FileLike* fileLikeSocket;
+    uint64_t fileHeaderSize;
+    vktrace_trace_file_header file_header;
+    vktrace_trace_packet_header* pHeader = NULL;
+    size_t bytes_written;
+    size_t fileOffset;
+
     // create trace file
-    pInfo->pProcessInfo->pTraceFile = vktrace_open_trace_file(pInfo->pProcessInfo);
+    pProcessInfo->pTraceFile = vktrace_open_trace_file(pProcessInfo);
 
-    if (pInfo->pProcessInfo->pTraceFile == NULL) {
+    if (pProcessInfo->pTraceFile == NULL) {
         // open of trace file generated an error, no sense in continuing.
         vktrace_LogError("Error cannot create trace file.");
-        vktrace_process_info_delete(pInfo->pProcessInfo);
+        pConnection->finished = true;
         return 1;
     }
 
@@ -160,49 +532,68 @@ VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadIn
         file_header.first_packet_offset != sizeof(file_header) + file_header.n_gpuinfo * sizeof(struct_gpuinfo)) {
         // Trace file header we received is the wrong size
         vktrace_LogError("Error creating trace file header. Are vktrace and trace layer the same version?");
-        vktrace_process_info_delete(pInfo->pProcessInfo);
+        VKTRACE_DELETE(fileLikeSocket);
+        pConnection->finished = true;
         return 1;
     }
 
-    vktrace_enter_critical_section(&pInfo->pProcessInfo->traceFileCriticalSection);
+    // The trace layer doesn't know about compression, it is done entirely on this side
+    file_header.compression_type = g_settings.compress_trace ? VKTRACE_COMPRESSION_LZ4 : VKTRACE_COMPRESSION_NONE;
+    if (g_settings.compact_headers) {
+        file_header.compression_type |= VKTRACE_COMPRESSION_COMPACT;
+        if (g_settings.drop_timing) {
+            file_header.compression_type |= VKTRACE_COMPRESSION_NO_TIMING;
+        }
+    }
+    file_header.frame_index_offset = 0;
+    file_header.frame_table_offset = 0;
+    file_header.frame_stats_offset = 0;
+
+    vktrace_enter_critical_section(&pProcessInfo->traceFileCriticalSection);
 
     // Write the trace file header to the file
-    bytes_written = fwrite(&file_header, 1, sizeof(file_header), pInfo->pProcessInfo->pTraceFile);
+    bytes_written = fwrite(&file_header, 1, sizeof(file_header), pProcessInfo->pTraceFile);
 
-    // Read and write the gpu_info structs
-    struct_gpuinfo gpuinfo;
+    // Read and write the gpu_info structs, which the trace files of later trim windows get too
+    std::vector<struct_gpuinfo> gpuinfo((size_t)file_header.n_gpuinfo);
     for (uint64_t i = 0; i < file_header.n_gpuinfo; i++) {
-        vktrace_FileLike_ReadRaw(fileLikeSocket, &gpuinfo, sizeof(struct_gpuinfo));
-        bytes_written += fwrite(&gpuinfo, 1, sizeof(struct_gpuinfo), pInfo->pProcessInfo->pTraceFile);
+        vktrace_FileLike_ReadRaw(fileLikeSocket, &gpuinfo[i], sizeof(struct_gpuinfo));
+        bytes_written += fwrite(&gpuinfo[i], 1, sizeof(struct_gpuinfo), pProcessInfo->pTraceFile);
     }
-    fflush(pInfo->pProcessInfo->pTraceFile);
-    vktrace_leave_critical_section(&pInfo->pProcessInfo->traceFileCriticalSection);
+    fflush(pProcessInfo->pTraceFile);
+    if (file_header.compression_type != VKTRACE_COMPRESSION_NONE) {
+        pProcessInfo->pCompressedWriter =
+            vktrace_CompressedWriter_create(pProcessInfo->pTraceFile, file_header.compression_type);
+    }
+    vktrace_leave_critical_section(&pProcessInfo->traceFileCriticalSection);
 
     if (bytes_written != sizeof(file_header) + file_header.n_gpuinfo * sizeof(struct_gpuinfo)) {
         vktrace_LogError("Unable to write trace file header - fwrite failed.");
-        vktrace_process_info_delete(pInfo->pProcessInfo);
+        VKTRACE_DELETE(fileLikeSocket);
+        pConnection->finished = true;
+        return 1;
+    }
+    if (file_header.compression_type != VKTRACE_COMPRESSION_NONE && pProcessInfo->pCompressedWriter == NULL) {
+        vktrace_LogError("Unable to create trace file compressor.");
+        VKTRACE_DELETE(fileLikeSocket);
+        pConnection->finished = true;
         return 1;
     }
     fileOffset = file_header.first_packet_offset;
+    {
+        // Frame 0 starts with the first packet
+        vktrace_frame_table_entry frame = {file_header.first_packet_offset, 0};
+        pTables->frameTable.push_back(frame);
+        start_frame_stats(pTables, 0);
+    }
 
-#if defined(WIN32)
-    rval = SetConsoleCtrlHandler((PHANDLER_ROUTINE)terminationSignalHandler, TRUE);
-    assert(rval);
-#else
-    rval = signal(SIGHUP, terminationSignalHandler);
-    assert(rval != SIG_ERR);
-    rval = signal(SIGINT, terminationSignalHandler);
-    assert(rval != SIG_ERR);
-    rval = signal(SIGTERM, terminationSignalHandler);
-    assert(rval != SIG_ERR);
-#endif
-
-    while (!terminationSignalArrived && pInfo->pProcessInfo->serverRequestsTermination == FALSE) {
+    while (!terminationSignalArrived && pProcessInfo->serverRequestsTermination == FALSE) {
         // get a packet
         // vktrace_LogDebug("Waiting for a packet...");
 
-        // read entire packet in
-        pHeader = vktrace_read_trace_packet(fileLikeSocket);
+        // read entire packet in, or just its header if the rest went to the trace file already
+        bool spliced;
+        pHeader = receive_trace_packet(fileLikeSocket, pMessageStream, pProcessInfo, &spliced);
 
         if (pHeader == NULL) {
             if (pMessageStream->mErrorNum == WSAECONNRESET) {
@@ -215,73 +606,43 @@ VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadIn
 
         // vktrace_LogDebug("Received packet id: %hu", pHeader->packet_id);
 
-        if (pHeader->pBody == (uintptr_t)NULL) {
+        if (pHeader->pBody == (uintptr_t)NULL && !spliced) {
             vktrace_LogWarning("Received empty packet body for id: %hu", pHeader->packet_id);
         } else {
             // handle special case packets
-            if (pHeader->packet_id == VKTRACE_TPI_MESSAGE) {
-                if (g_settings.print_trace_messages == TRUE) {
-                    vktrace_trace_packet_message* pPacket = vktrace_interpret_body_as_trace_packet_message(pHeader);
-                    vktrace_LogAlways("Packet %lu: Traced Message (%s): %s", pHeader->global_packet_index,
-                                      vktrace_LogLevelToShortString(pPacket->type), pPacket->message);
-                    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->message));
-                }
-            }
-
             if (pHeader->packet_id == VKTRACE_TPI_MARKER_TERMINATE_PROCESS) {
-                pInfo->pProcessInfo->serverRequestsTermination = true;
+                pProcessInfo->serverRequestsTermination = true;
                 vktrace_delete_trace_packet(&pHeader);
                 vktrace_LogVerbose("Thread_CaptureTrace is exiting.");
                 break;
             }
 
-            if (pInfo->pProcessInfo->pTraceFile != NULL) {
-                vktrace_enter_critical_section(&pInfo->pProcessInfo->traceFileCriticalSection);
-                bytes_written = fwrite(pHeader, 1, (size_t)pHeader->size, pInfo->pProcessInfo->pTraceFile);
-                fflush(pInfo->pProcessInfo->pTraceFile);
-                vktrace_leave_critical_section(&pInfo->pProcessInfo->traceFileCriticalSection);
-                if (bytes_written != pHeader->size) {
-                    vktrace_LogError("Failed to write the packet for packet_id = %hu", pHeader->packet_id);
-                }
-
-                // If the packet is one we need to track, add it to the table
-                if (pHeader->packet_id == VKTRACE_TPI_VK_vkBindImageMemory ||
-                    pHeader->packet_id == VKTRACE_TPI_VK_vkBindBufferMemory ||
-                    pHeader->packet_id == VKTRACE_TPI_VK_vkAllocateMemory || pHeader->packet_id == VKTRACE_TPI_VK_vkDestroyImage ||
-                    pHeader->packet_id == VKTRACE_TPI_VK_vkDestroyBuffer || pHeader->packet_id == VKTRACE_TPI_VK_vkFreeMemory ||
-                    pHeader->packet_id == VKTRACE_TPI_VK_vkCreateBuffer || pHeader->packet_id == VKTRACE_TPI_VK_vkCreateImage) {
-                    portabilityTable.push_back(fileOffset);
+            if (pHeader->packet_id == VKTRACE_TPI_MARKER_TRIM_WINDOW_END) {
+                vktrace_delete_trace_packet(&pHeader);
+                if (pProcessInfo->pTraceFile == NULL) continue;
+                if (!start_next_trace_file(pConnection, file_header, gpuinfo)) {
+                    break;
                 }
-                lastPacketIndex = pHeader->global_packet_index;
-                lastPacketThreadId = pHeader->thread_id;
-                lastPacketEndTime = pHeader->vktrace_end_time;
-                fileOffset += bytes_written;
+                fileOffset = file_header.first_packet_offset;
+                continue;
             }
+
+            write_received_packet(pConnection, pHeader, spliced, &fileOffset);
         }
 
         // clean up
         vktrace_delete_trace_packet(&pHeader);
     }
 
-#if defined(WIN32)
-    PostThreadMessage(pInfo->pProcessInfo->parentThreadId, VKTRACE_WM_COMPLETE, 0, 0);
-#endif
+    // The shards are complete once the process is done, it closes them before telling vktrace
+    if (pProcessInfo->pTraceFile != NULL && g_settings.shard_dir != NULL && strlen(g_settings.shard_dir) > 0) {
+        merge_trace_shards(pConnection, &fileOffset);
+    }
 
+    if (pProcessInfo->pTraceFile != NULL) {
+        vktrace_appendPortabilityPacket(pProcessInfo, pTables);
+    }
     VKTRACE_DELETE(fileLikeSocket);
-    vktrace_MessageStream_destroy(&pMessageStream);
-
-// Restore signal handling to default.
-#if defined(WIN32)
-    rval = SetConsoleCtrlHandler((PHANDLER_ROUTINE)terminationSignalHandler, FALSE);
-    assert(rval);
-#else
-    rval = signal(SIGHUP, SIG_DFL);
-    assert(rval != SIG_ERR);
-    rval = signal(SIGINT, SIG_DFL);
-    assert(rval != SIG_ERR);
-    rval = signal(SIGTERM, SIG_DFL);
-    assert(rval != SIG_ERR);
-#endif
-
+    pConnection->finished = true;
     return 0;
 }
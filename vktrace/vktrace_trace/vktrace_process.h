@@ -21,12 +21,40 @@
 
 #pragma once
 
+#include "vktrace.h"
+
 extern "C" {
 #include "vktrace_common.h"
 #include "vktrace_process.h"
 #include "vktrace_interconnect.h"
+#include "vktrace_trace_packet_utils.h"
 }
 
+// A traced process connected to vktrace. Each one is received by a thread of its own into a trace
+// file of its own, so processes traced at the same time don't wait on each other.
+struct vktrace_trace_connection {
+    // The connected process, and the trace file it is written to
+    vktrace_process_info traceInfo;
+    vktrace_trace_tables tables;
+    MessageStream* pMessageStream;
+
+    // Set if the trace files are named after the process, because another process was being traced
+    // when it connected
+    bool namedByProcessId;
+    // Trim windows written so far
+    uint32_t windowCount;
+
+    vktrace_thread receiveThread;
+    volatile bool finished;
+};
+
+// Takes the connections of the traced processes on the tracer's port until the process info asks
+// for termination, then waits for the processes being traced to finish
 VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID);
 
+// Receives one vktrace_trace_connection into its trace file
+VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunReceiveThread(LPVOID);
+
+void Process_WaitForThread(vktrace_thread* pThread);
+
 VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunWatchdogThread(LPVOID);
@@ -22,6 +22,7 @@
 #include <assert.h>
 #include <QDebug>
 #include <QFileDialog>
+#include <QFontMetrics>
 #include <QMoveEvent>
 #include <QPalette>
 #include <QProcess>
@@ -40,9 +41,11 @@
 
 #include "vktraceviewer_controller_factory.h"
 #include "vktraceviewer_qgeneratetracedialog.h"
+#include "vktraceviewer_qtracefileindexer.h"
 #include "vktraceviewer_qtracefileloader.h"
 
 #include "vkreplay_main.h"
+#include "vktrace_blob_store.h"
 //----------------------------------------------------------------------------------------------------------------------
 // globals
 //----------------------------------------------------------------------------------------------------------------------
@@ -83,6 +86,10 @@ vktraceviewer::vktraceviewer(QWidget* parent)
       m_pGenerateTraceButton(NULL),
       m_pTimeline(NULL),
       m_pGenerateTraceDialog(NULL),
+      m_bSearchPending(false),
+      m_searchFromRow(0),
+      m_bSearchForward(true),
+      m_bSearchFromTextBox(false),
       m_bDelayUpdateUIForContext(false),
       m_bGeneratingTrace(false) {
     ui->setupUi(this);
@@ -221,6 +228,21 @@ QToolButton* vktraceviewer::add_toolbar_button(const QString& title, bool bEnabl
     return pButton;
 }
 
+// Rows whose API calls are measured to size the API call column, rather than rendering every row of the trace
+static const int cCOLUMN_WIDTH_SAMPLES = 64;
+
+// Widest text of column in rows spread evenly over the model
+static int sampled_column_width(QAbstractItemModel* pModel, int column, const QFontMetrics& metrics) {
+    int rows = pModel->rowCount();
+    int samples = qMin(rows, cCOLUMN_WIDTH_SAMPLES);
+    int width = 0;
+    for (int i = 0; i < samples; i++) {
+        int row = (int)((qint64)rows * i / samples);
+        width = qMax(width, metrics.width(pModel->data(pModel->index(row, column)).toString()));
+    }
+    return width;
+}
+
 void vktraceviewer::set_calltree_model(vktraceviewer_QTraceFileModel* pTraceFileModel, QAbstractProxyModel* pModel) {
     if (m_pTraceFileModel == pTraceFileModel && pModel == m_pProxyModel) {
         // Setting model and proxy to the same thing they are already set to, so there's nothing to do!
@@ -229,6 +251,11 @@ void vktraceviewer::set_calltree_model(vktraceviewer_QTraceFileModel* pTraceFile
 
     m_pTraceFileModel = pTraceFileModel;
     m_pProxyModel = pModel;
+    m_bSearchPending = false;
+
+    if (pTraceFileModel != NULL && pTraceFileModel->get_indexer() != NULL) {
+        connect(pTraceFileModel->get_indexer(), SIGNAL(SearchProgress()), this, SLOT(onSearchProgress()), Qt::UniqueConnection);
+    }
 
     if (m_pTimeline != NULL) {
         m_pTimeline->setModel(pTraceFileModel);
@@ -265,10 +292,17 @@ void vktraceviewer::set_calltree_model(vktraceviewer_QTraceFileModel* pTraceFile
         firstEqualWidthColumnIndex = m_pTraceFileModel->columnCount();
         fSharedEqualWidthPct = 1.0f - 0.05f - 0.08f;
     } else {
-        // entrypoint names get the most space
-        ui->treeView->setColumnWidth(vktraceviewer_QTraceFileModel::Column_EntrypointName, width * 0.55);
+        // entrypoint names get the most space, but no more than the API calls of a sample of rows need
+        int entrypointWidth = width * 0.55;
+        if (pTraceFileModel != NULL) {
+            int sampledWidth = sampled_column_width(pTraceFileModel, vktraceviewer_QTraceFileModel::Column_EntrypointName,
+                                                    ui->treeView->fontMetrics()) +
+                               2 * ui->treeView->indentation();
+            entrypointWidth = qBound((int)(width * 0.25), sampledWidth, entrypointWidth);
+        }
+        ui->treeView->setColumnWidth(vktraceviewer_QTraceFileModel::Column_EntrypointName, entrypointWidth);
         firstEqualWidthColumnIndex = 1;
-        fSharedEqualWidthPct = 1.0f - 0.55f;
+        fSharedEqualWidthPct = width > 0 ? 1.0f - (float)entrypointWidth / width : 1.0f - 0.55f;
     }
 
     // the remaining space is divided among visible columns
@@ -457,14 +491,14 @@ void vktraceviewer::GenerateTraceFileStats() {
     uint64_t totalTraceTime = 0;
 
     if (m_traceFileInfo.packetCount > 0) {
-        uint64_t start = m_traceFileInfo.pPacketOffsets[0].pHeader->entrypoint_begin_time;
-        uint64_t end = m_traceFileInfo.pPacketOffsets[m_traceFileInfo.packetCount - 1].pHeader->entrypoint_end_time;
+        uint64_t start = m_traceFileInfo.pPacketOffsets[0].header.entrypoint_begin_time;
+        uint64_t end = m_traceFileInfo.pPacketOffsets[m_traceFileInfo.packetCount - 1].header.entrypoint_end_time;
         totalTraceTime = end - start;
     }
 
     QMap<uint16_t, vtvApiUsageStats> statMap;
     for (uint64_t i = 0; i < m_traceFileInfo.packetCount; i++) {
-        vktrace_trace_packet_header* pHeader = m_traceFileInfo.pPacketOffsets[i].pHeader;
+        vktrace_trace_packet_header* pHeader = &m_traceFileInfo.pPacketOffsets[i].header;
         if (pHeader->packet_id >= VKTRACE_TPI_VK_vkApiVersion) {
             totalStats.totalCallCount++;
             totalStats.totalCpuExecutionTime += (pHeader->entrypoint_end_time - pHeader->entrypoint_begin_time);
@@ -583,6 +617,9 @@ void vktraceviewer::onTraceFileLoaded(bool bSuccess, const vktraceviewer_trace_f
         m_pController = vtvCreateQController();
 #endif
 
+        // The packets are read from the trace file as they are shown
+        vktraceviewer_open_packet_cache(&m_traceFileInfo, m_pController);
+
         if (m_pController != NULL) {
             connect(m_pController, SIGNAL(OutputMessage(VktraceLogLevel, const QString&)), this,
                     SLOT(OnOutputMessage(VktraceLogLevel, const QString&)));
@@ -644,14 +681,12 @@ void vktraceviewer::close_trace_file() {
         m_pTimeline->repaint();
     }
 
-    if (m_traceFileInfo.packetCount > 0) {
-        for (unsigned int i = 0; i < m_traceFileInfo.packetCount; i++) {
-            if (m_traceFileInfo.pPacketOffsets[i].pHeader != NULL) {
-                vktrace_free(m_traceFileInfo.pPacketOffsets[i].pHeader);
-                m_traceFileInfo.pPacketOffsets[i].pHeader = NULL;
-            }
-        }
+    vktraceviewer_close_packet_cache(&m_traceFileInfo);
 
+    // Blob ids start over in every trace file
+    vktrace_blob_store_deinitialize();
+
+    if (m_traceFileInfo.packetCount > 0) {
         VKTRACE_DELETE(m_traceFileInfo.pPacketOffsets);
         m_traceFileInfo.pPacketOffsets = NULL;
         m_traceFileInfo.packetCount = 0;
@@ -701,11 +736,13 @@ void vktraceviewer::on_actionExport_API_Calls_triggered() {
         }
 
         // iterate through every packet
-        for (unsigned int i = 0; i < m_traceFileInfo.packetCount; i++) {
-            vktraceviewer_trace_file_packet_offsets* pOffsets = &m_traceFileInfo.pPacketOffsets[i];
-            vktrace_trace_packet_header* pHeader = pOffsets->pHeader;
-            assert(pHeader != NULL);
+        for (uint64_t i = 0; i < m_traceFileInfo.packetCount; i++) {
+            vktrace_trace_packet_header* pHeader = vktraceviewer_read_trace_packet(&m_traceFileInfo, i);
+            if (pHeader == NULL) {
+                continue;
+            }
             QString string = m_pTraceFileModel->get_packet_string(pHeader);
+            vktrace_free(pHeader);
 
             // output packet string
             fprintf(pFile, "%s\n", string.toStdString().c_str());
@@ -864,8 +901,14 @@ void vktraceviewer::on_searchTextBox_textChanged(const QString& searchText) {
     palette.setColor(QPalette::Base, m_searchTextboxBackgroundColor);
     ui->searchTextBox->setPalette(palette);
 
+    m_bSearchPending = false;
     if (m_pTraceFileModel != NULL) {
         m_pTraceFileModel->set_highlight_search_string(searchText);
+
+        // get the worker threads going before the user asks for the next match
+        if (m_pTraceFileModel->get_indexer() != NULL) {
+            start_search();
+        }
     }
 
     // need to briefly give the treeview focus so that it properly redraws and highlights the matching rows
@@ -876,91 +919,75 @@ void vktraceviewer::on_searchTextBox_textChanged(const QString& searchText) {
 
 void vktraceviewer::on_searchNextButton_clicked() {
     if (m_pTraceFileModel != NULL) {
-        QModelIndex index = ui->treeView->currentIndex();
-        if (!index.isValid()) {
-            // If there was no valid current index, then get the first index in the trace file model.
-            index = m_pTraceFileModel->index(0, vktraceviewer_QTraceFileModel::Column_EntrypointName);
-        }
-
-        // Need to make sure this index is in model-space
-        if (index.model() == m_pProxyModel) {
-            index = mapTreeIndexToModel(index);
-        }
-
-        // get the next item in the list
-        // TODO: this means that we won't be able to hit "Next" and select the first item in the trace file.
-        // However, if we move this into the loop below, then hitting "Next" will always result in finding the same item.
-        index = index.sibling(index.row() + 1, vktraceviewer_QTraceFileModel::Column_EntrypointName);
-
-        // Can't get column count from the TreeView, so need to ask both the model and proxy if it exists.
-        int columnCount = m_pTraceFileModel->columnCount(index);
-        if (m_pProxyModel != NULL) {
-            columnCount = m_pProxyModel->columnCount(index);
-        }
-
-        while (index.isValid()) {
-            for (int column = 0; column < columnCount; column++) {
-                if (ui->treeView->isColumnHidden(column)) continue;
-
-                QModelIndex treeIndex = mapTreeIndexFromModel(m_pTraceFileModel->index(index.row(), column, index.parent()));
-                if (treeIndex.data(Qt::DisplayRole).toString().contains(ui->searchTextBox->text(), Qt::CaseInsensitive)) {
-                    // Get the first column so that it can be selected
-                    QModelIndex srcIndex =
-                        m_pTraceFileModel->index(index.row(), vktraceviewer_QTraceFileModel::Column_EntrypointName, index.parent());
-                    selectApicallModelIndex(srcIndex, true, true);
-                    ui->treeView->setFocus();
-                    return;
-                }
-            }
-
-            // wasn't found in that row, so check the next one
-            index = index.sibling(index.row() + 1, vktraceviewer_QTraceFileModel::Column_EntrypointName);
-        }
+        // If there was no valid current index, then start from the first index in the trace file model.
+        QModelIndex index = mapTreeIndexToModel(ui->treeView->currentIndex());
+        find_search_match(index.isValid() ? index.row() + 1 : 0, true, false);
     }
 }
 
 void vktraceviewer::on_searchPrevButton_clicked() {
     if (m_pTraceFileModel != NULL) {
-        QModelIndex index = ui->treeView->currentIndex();
-        if (!index.isValid()) {
-            // If there was no valid current index, then get the first index in the trace file model.
-            index = m_pTraceFileModel->index(0, vktraceviewer_QTraceFileModel::Column_EntrypointName);
+        QModelIndex index = mapTreeIndexToModel(ui->treeView->currentIndex());
+        if (index.isValid()) {
+            find_search_match(index.row() - 1, false, false);
         }
+    }
+}
 
-        // Need to make sure this index is in model-space
-        if (index.model() == m_pProxyModel) {
-            index = mapTreeIndexToModel(index);
-        }
+void vktraceviewer::start_search() {
+    // Only the columns shown in the tree are searched
+    QBitArray columns(m_pTraceFileModel->columnCount());
+    for (int column = 0; column < columns.count(); column++) {
+        columns.setBit(column, !ui->treeView->isColumnHidden(column));
+    }
+    m_pTraceFileModel->get_indexer()->search(ui->searchTextBox->text(), columns);
+}
 
-        // get the next item in the list
-        // TODO: this means that we won't be able to hit "Prev" and select the first item in the trace file.
-        // However, if we move this into the loop below, then hitting "Prev" will always result in finding the same item.
-        index = index.sibling(index.row() - 1, vktraceviewer_QTraceFileModel::Column_EntrypointName);
+void vktraceviewer::find_search_match(int fromRow, bool bForward, bool bFromTextBox) {
+    m_bSearchPending = false;
+    vktraceviewer_QTraceFileIndexer* pIndexer = m_pTraceFileModel->get_indexer();
+    if (pIndexer == NULL) {
+        return;
+    }
 
-        // Can't get column count from the TreeView, so need to ask both the model and proxy if it exists.
-        int columnCount = m_pTraceFileModel->columnCount(index);
-        if (m_pProxyModel != NULL) {
-            columnCount = m_pProxyModel->columnCount(index);
-        }
+    // The packets are searched on the indexer's threads, this only looks at what they found so far
+    start_search();
+    bool bSearching = false;
+    int row = pIndexer->findMatch(fromRow, bForward, bSearching);
 
-        while (index.isValid()) {
-            for (int column = 0; column < columnCount; column++) {
-                if (ui->treeView->isColumnHidden(column)) continue;
-
-                QModelIndex treeIndex = mapTreeIndexFromModel(m_pTraceFileModel->index(index.row(), column, index.parent()));
-                if (treeIndex.data(Qt::DisplayRole).toString().contains(ui->searchTextBox->text(), Qt::CaseInsensitive)) {
-                    // Get the first column so that it can be selected
-                    QModelIndex srcIndex =
-                        m_pTraceFileModel->index(index.row(), vktraceviewer_QTraceFileModel::Column_EntrypointName, index.parent());
-                    selectApicallModelIndex(srcIndex, true, true);
-                    ui->treeView->setFocus();
-                    return;
-                }
-            }
+    // Searching from the text box goes on from the top when nothing is found below
+    if (row == -1 && !bSearching && bFromTextBox && fromRow > 0) {
+        fromRow = 0;
+        row = pIndexer->findMatch(fromRow, bForward, bSearching);
+    }
 
-            // wasn't found in that row, so check the next one
-            index = index.sibling(index.row() - 1, vktraceviewer_QTraceFileModel::Column_EntrypointName);
+    if (row != -1) {
+        // Get the first column so that it can be selected
+        QModelIndex srcIndex = m_pTraceFileModel->index(row, vktraceviewer_QTraceFileModel::Column_EntrypointName);
+        selectApicallModelIndex(srcIndex, true, true);
+        if (bFromTextBox) {
+            ui->searchTextBox->setFocus();
+        } else {
+            ui->treeView->setFocus();
         }
+    } else if (bSearching) {
+        // look again once more rows have been searched, see onSearchProgress
+        m_bSearchPending = true;
+        m_searchFromRow = fromRow;
+        m_bSearchForward = bForward;
+        m_bSearchFromTextBox = bFromTextBox;
+    } else if (bFromTextBox) {
+        // no items were found, so set the textbox background to red (it will get cleared to the original color if the user
+        // edits the search text)
+        QPalette palette(ui->searchTextBox->palette());
+        palette.setColor(QPalette::Base, Qt::red);
+        ui->searchTextBox->setPalette(palette);
+    }
+}
+
+void vktraceviewer::onSearchProgress() {
+    if (m_bSearchPending && m_pTraceFileModel != NULL) {
+        find_search_match(m_searchFromRow, m_bSearchForward, m_bSearchFromTextBox);
     }
 }
 
@@ -1024,62 +1051,9 @@ void vktraceviewer::on_nextDrawcallButton_clicked() {
 
 void vktraceviewer::on_searchTextBox_returnPressed() {
     if (m_pTraceFileModel != NULL) {
-        QModelIndex index = ui->treeView->indexBelow(ui->treeView->currentIndex());
-        bool bFound = false;
-
-        // search down from the current index
-        while (index.isValid()) {
-            for (int column = 0; column < m_pTraceFileModel->columnCount(index); column++) {
-                if (m_pTraceFileModel->data(m_pTraceFileModel->index(index.row(), column, index.parent()), Qt::DisplayRole)
-                        .toString()
-                        .contains(ui->searchTextBox->text(), Qt::CaseInsensitive)) {
-                    bFound = true;
-                    break;
-                }
-            }
-
-            if (bFound) {
-                break;
-            } else {
-                // wasn't found in that row, so check the next one
-                index = ui->treeView->indexBelow(index);
-            }
-        }
-
-        // if not found yet, then search from the root down to the current node
-        if (!bFound) {
-            index = m_pTraceFileModel->index(0, 0);
-
-            while (index.isValid() && index != ui->treeView->currentIndex()) {
-                for (int column = 0; column < m_pTraceFileModel->columnCount(index); column++) {
-                    if (m_pTraceFileModel->data(m_pTraceFileModel->index(index.row(), column, index.parent()), Qt::DisplayRole)
-                            .toString()
-                            .contains(ui->searchTextBox->text(), Qt::CaseInsensitive)) {
-                        bFound = true;
-                        break;
-                    }
-                }
-
-                if (bFound) {
-                    break;
-                } else {
-                    // wasn't found in that row, so check the next one
-                    index = ui->treeView->indexBelow(index);
-                }
-            }
-        }
-
-        if (bFound && index.isValid()) {
-            // a valid item was found, scroll to it and select it
-            selectApicallModelIndex(index, true, true);
-            ui->searchTextBox->setFocus();
-        } else {
-            // no items were found, so set the textbox background to red (it will get cleared to the original color if the user
-            // edits the search text)
-            QPalette palette(ui->searchTextBox->palette());
-            palette.setColor(QPalette::Base, Qt::red);
-            ui->searchTextBox->setPalette(palette);
-        }
+        // search down from the current index, and then from the root down
+        QModelIndex index = mapTreeIndexToModel(ui->treeView->currentIndex());
+        find_search_match(index.isValid() ? index.row() + 1 : 0, true, true);
     }
 }
 
@@ -113,6 +113,7 @@ class vktraceviewer : public QMainWindow, public vktraceviewer_view {
     void on_nextDrawcallButton_clicked();
 
     void on_searchTextBox_returnPressed();
+    void onSearchProgress();
 
     void on_contextComboBox_currentIndexChanged(int index);
 
@@ -145,6 +146,13 @@ class vktraceviewer : public QMainWindow, public vktraceviewer_view {
     QModelIndex mapTreeIndexToModel(const QModelIndex& treeIndex) const;
     QModelIndex mapTreeIndexFromModel(const QModelIndex& modelIndex) const;
 
+    // Starts the indexer searching for the text in the search box, unless it already is
+    void start_search();
+
+    // Selects the first row the search matched from fromRow on, or up from it. If rows that way
+    // are still being searched, it is tried again as the search gets further.
+    void find_search_match(int fromRow, bool bForward, bool bFromTextBox);
+
     static float u64ToFloat(uint64_t value);
     void build_timeline_model();
 
@@ -161,6 +169,10 @@ class vktraceviewer : public QMainWindow, public vktraceviewer_view {
     vktraceviewer_QGenerateTraceDialog* m_pGenerateTraceDialog;
 
     QColor m_searchTextboxBackgroundColor;
+    bool m_bSearchPending;
+    int m_searchFromRow;
+    bool m_bSearchForward;
+    bool m_bSearchFromTextBox;
     bool m_bDelayUpdateUIForContext;
     bool m_bGeneratingTrace;
 };
@@ -24,6 +24,10 @@
 #include <QCoreApplication>
 #include "vktraceviewer_trace_file_utils.h"
 
+extern "C" {
+#include "vktrace_vk_packet_id.h"
+}
+
 vktraceviewer_QReplayWorker* g_pWorker;
 static uint64_t s_currentReplayPacket = 0;
 
@@ -66,6 +70,9 @@ vktraceviewer_QReplayWorker::vktraceviewer_QReplayWorker()
       m_currentReplayPacketIndex(0),
       m_pActionRunToHere(NULL),
       m_pauseAtPacketIndex((uint64_t)-1),
+      m_replayFrame(0),
+      m_checkpointPacketIndex((uint64_t)-1),
+      m_checkpointFrame(0),
       m_pReplayWindow(NULL),
       m_pReplayWindowWidth(0),
       m_pReplayWindowHeight(0),
@@ -235,11 +242,20 @@ void vktraceviewer_QReplayWorker::playCurrentTraceFile(uint64_t startPacketIndex
         emit ReplayProgressUpdate(m_currentReplayPacketIndex);
 
         pCurPacket = &pTraceFileInfo->pPacketOffsets[i];
-        s_currentReplayPacket = pCurPacket->pHeader->global_packet_index;
-        switch (pCurPacket->pHeader->packet_id) {
+        s_currentReplayPacket = pCurPacket->header.global_packet_index;
+        // Read just for the replay, so playing the trace doesn't push the shown packets out of the cache
+        vktrace_trace_packet_header* pPacket = vktraceviewer_read_trace_packet(pTraceFileInfo, i);
+        if (pPacket == NULL) {
+            replayWorkerLoggingCallback(VKTRACE_LOG_ERROR, QString("Failed to read packet %1.")
+                                                               .arg(pCurPacket->header.global_packet_index)
+                                                               .toStdString()
+                                                               .c_str());
+            continue;
+        }
+        switch (pCurPacket->header.packet_id) {
             case VKTRACE_TPI_MESSAGE: {
                 vktrace_trace_packet_message* msgPacket;
-                msgPacket = (vktrace_trace_packet_message*)pCurPacket->pHeader;
+                msgPacket = (vktrace_trace_packet_message*)pPacket->pBody;
                 replayWorkerLoggingCallback(msgPacket->type, msgPacket->message);
                 break;
             }
@@ -255,31 +271,36 @@ void vktraceviewer_QReplayWorker::playCurrentTraceFile(uint64_t startPacketIndex
                 break;
             case VKTRACE_TPI_PORTABILITY_TABLE:
                 break;
+            case VKTRACE_TPI_BLOB:
+                // Already in the blob store, the loader added it
+                break;
             // TODO processing code for all the above cases
             default: {
-                if (pCurPacket->pHeader->tracer_id >= VKTRACE_MAX_TRACER_ID_ARRAY_SIZE ||
-                    pCurPacket->pHeader->tracer_id == VKTRACE_TID_RESERVED) {
+                if (pCurPacket->header.tracer_id >= VKTRACE_MAX_TRACER_ID_ARRAY_SIZE ||
+                    pCurPacket->header.tracer_id == VKTRACE_TID_RESERVED) {
                     replayWorkerLoggingCallback(VKTRACE_LOG_WARNING, QString("Tracer_id from packet num packet %1 invalid.")
-                                                                         .arg(pCurPacket->pHeader->packet_id)
+                                                                         .arg(pCurPacket->header.packet_id)
                                                                          .toStdString()
                                                                          .c_str());
+                    vktrace_free(pPacket);
                     continue;
                 }
-                replayer = m_pReplayers[pCurPacket->pHeader->tracer_id];
+                replayer = m_pReplayers[pCurPacket->header.tracer_id];
                 if (replayer == NULL) {
                     replayWorkerLoggingCallback(
                         VKTRACE_LOG_WARNING,
-                        QString("Tracer_id %1 has no valid replayer.").arg(pCurPacket->pHeader->tracer_id).toStdString().c_str());
+                        QString("Tracer_id %1 has no valid replayer.").arg(pCurPacket->header.tracer_id).toStdString().c_str());
+                    vktrace_free(pPacket);
                     continue;
                 }
-                if (pCurPacket->pHeader->packet_id >= VKTRACE_TPI_VK_vkApiVersion) {
+                if (pCurPacket->header.packet_id >= VKTRACE_TPI_VK_vkApiVersion) {
                     // replay the API packet
                     try {
-                        res = replayer->Replay(pCurPacket->pHeader);
+                        res = replayer->Replay(pPacket);
                     } catch (std::exception& e) {
                         replayWorkerLoggingCallback(VKTRACE_LOG_ERROR,
                                                     QString("Caught std::exception while replaying packet %1: %2")
-                                                        .arg(pCurPacket->pHeader->global_packet_index)
+                                                        .arg(pCurPacket->header.global_packet_index)
                                                         .arg(e.what())
                                                         .toStdString()
                                                         .c_str());
@@ -293,14 +314,14 @@ void vktraceviewer_QReplayWorker::playCurrentTraceFile(uint64_t startPacketIndex
                     if (res == vktrace_replay::VKTRACE_REPLAY_ERROR || res == vktrace_replay::VKTRACE_REPLAY_INVALID_ID ||
                         res == vktrace_replay::VKTRACE_REPLAY_CALL_ERROR) {
                         replayWorkerLoggingCallback(VKTRACE_LOG_ERROR, QString("Failed to replay packet %1.")
-                                                                           .arg(pCurPacket->pHeader->global_packet_index)
+                                                                           .arg(pCurPacket->header.global_packet_index)
                                                                            .toStdString()
                                                                            .c_str());
                     } else if (res == vktrace_replay::VKTRACE_REPLAY_BAD_RETURN) {
                         replayWorkerLoggingCallback(
                             VKTRACE_LOG_WARNING,
                             QString("Replay of packet %1 has diverged from trace due to a different return value.")
-                                .arg(pCurPacket->pHeader->global_packet_index)
+                                .arg(pCurPacket->header.global_packet_index)
                                 .toStdString()
                                 .c_str());
                     } else if (res == vktrace_replay::VKTRACE_REPLAY_INVALID_PARAMS ||
@@ -309,48 +330,63 @@ void vktraceviewer_QReplayWorker::playCurrentTraceFile(uint64_t startPacketIndex
                         // warnings here.
                     } else if (res != vktrace_replay::VKTRACE_REPLAY_SUCCESS) {
                         replayWorkerLoggingCallback(VKTRACE_LOG_ERROR, QString("Unknown error caused by packet %1.")
-                                                                           .arg(pCurPacket->pHeader->global_packet_index)
+                                                                           .arg(pCurPacket->header.global_packet_index)
                                                                            .toStdString()
                                                                            .c_str());
                     }
                 } else {
                     replayWorkerLoggingCallback(VKTRACE_LOG_ERROR, QString("Bad packet type id=%1, index=%2.")
-                                                                       .arg(pCurPacket->pHeader->packet_id)
-                                                                       .arg(pCurPacket->pHeader->global_packet_index)
+                                                                       .arg(pCurPacket->header.packet_id)
+                                                                       .arg(pCurPacket->header.global_packet_index)
                                                                        .toStdString()
                                                                        .c_str());
                 }
             }
         }
 
+        vktrace_free(pPacket);
+
+        if (pCurPacket->header.tracer_id == VKTRACE_TID_VULKAN &&
+            pCurPacket->header.packet_id == VKTRACE_TPI_VK_vkQueuePresentKHR) {
+            m_replayFrame++;
+            if (m_replayFrame % VKTRACEVIEWER_CHECKPOINT_FRAMES == 0 && i + 1 < pTraceFileInfo->packetCount) {
+                saveCheckpoint(i + 1);
+            }
+        }
+
         // Process events and pause or stop if needed
-        if (m_bPauseReplay || m_pauseAtPacketIndex == pCurPacket->pHeader->global_packet_index) {
-            if (m_pauseAtPacketIndex == pCurPacket->pHeader->global_packet_index) {
+        if (m_bPauseReplay || m_pauseAtPacketIndex == pCurPacket->header.global_packet_index) {
+            if (m_pauseAtPacketIndex == pCurPacket->header.global_packet_index) {
                 // reset
                 m_pauseAtPacketIndex = -1;
             }
 
             m_bReplayInProgress = false;
-            doReplayPaused(pCurPacket->pHeader->global_packet_index);
+            doReplayPaused(pCurPacket->header.global_packet_index);
             return;
         }
 
         if (m_bStopReplay) {
             m_bReplayInProgress = false;
-            doReplayStopped(pCurPacket->pHeader->global_packet_index);
+            doReplayStopped(pCurPacket->header.global_packet_index);
             return;
         }
     }
 
     m_bReplayInProgress = false;
-    doReplayFinished(pCurPacket->pHeader->global_packet_index);
+    doReplayFinished(pCurPacket->header.global_packet_index);
 }
 
 void vktraceviewer_QReplayWorker::onPlayToHere() {
     m_pauseAtPacketIndex = m_pView->get_current_packet_index();
     if (m_pauseAtPacketIndex <= m_currentReplayPacketIndex || m_currentReplayPacketIndex == 0) {
-        // pause location is behind the current replay position, so restart the replay.
-        StartReplay();
+        // pause location is behind the current replay position, so restart the replay, from the
+        // checkpoint if there is one before the pause location.
+        if (m_checkpointPacketIndex <= m_pauseAtPacketIndex) {
+            resumeFromCheckpoint();
+        } else {
+            StartReplay();
+        }
     } else {
         // pause location is ahead of current replay position, so continue the replay.
         ContinueReplay();
@@ -364,6 +400,8 @@ void vktraceviewer_QReplayWorker::StartReplay() {
     // Reset some flags and play the replay from the beginning
     m_bPauseReplay = false;
     m_bStopReplay = false;
+    m_replayFrame = 0;
+    m_checkpointPacketIndex = (uint64_t)-1;
     playCurrentTraceFile(0);
 }
 
@@ -407,7 +445,7 @@ void vktraceviewer_QReplayWorker::StopReplay() {
         // Replay is not in progress means:
         // 1) replay wasn't started (in which case stop button should be disabled and we can't get to this point),
         // 2) replay is currently paused, so do same actions as if the replay detected that it should stop.
-        uint64_t packetIndex = this->m_pTraceFileInfo->pPacketOffsets[m_currentReplayPacketIndex].pHeader->global_packet_index;
+        uint64_t packetIndex = this->m_pTraceFileInfo->pPacketOffsets[m_currentReplayPacketIndex].header.global_packet_index;
         doReplayStopped(packetIndex);
     }
 }
@@ -450,6 +488,34 @@ void vktraceviewer_QReplayWorker::DetachReplay(bool detach) {
     }
 }
 
+void vktraceviewer_QReplayWorker::saveCheckpoint(uint64_t packetIndex) {
+    for (int i = 0; i < VKTRACE_MAX_TRACER_ID_ARRAY_SIZE; i++) {
+        if (m_pReplayers[i] != NULL && m_pReplayers[i]->SaveLoopState != NULL) {
+            m_pReplayers[i]->SaveLoopState();
+        }
+    }
+    m_checkpointPacketIndex = packetIndex;
+    m_checkpointFrame = m_replayFrame;
+}
+
+void vktraceviewer_QReplayWorker::resumeFromCheckpoint() {
+    emit ReplayStarted();
+
+    // Only memory contents go back to how they were at the checkpoint. Objects the trace created
+    // after it are created again as replay goes forward.
+    for (int i = 0; i < VKTRACE_MAX_TRACER_ID_ARRAY_SIZE; i++) {
+        if (m_pReplayers[i] != NULL && m_pReplayers[i]->RestoreLoopState != NULL) {
+            m_pReplayers[i]->RestoreLoopState();
+            m_pReplayers[i]->ResetFrameNumber((int)m_checkpointFrame);
+        }
+    }
+
+    m_bPauseReplay = false;
+    m_bStopReplay = false;
+    m_replayFrame = m_checkpointFrame;
+    playCurrentTraceFile(m_checkpointPacketIndex);
+}
+
 void vktraceviewer_QReplayWorker::doReplayPaused(uint64_t packetIndex) { emit ReplayPaused(packetIndex); }
 
 void vktraceviewer_QReplayWorker::doReplayStopped(uint64_t packetIndex) {
@@ -457,6 +523,7 @@ void vktraceviewer_QReplayWorker::doReplayStopped(uint64_t packetIndex) {
 
     // Replay will start again from the beginning, so setup for that now.
     m_currentReplayPacketIndex = 0;
+    m_checkpointPacketIndex = (uint64_t)-1;
 }
 
 void vktraceviewer_QReplayWorker::doReplayFinished(uint64_t packetIndex) {
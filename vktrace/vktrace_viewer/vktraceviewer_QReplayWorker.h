@@ -28,6 +28,9 @@
 // Replay from vktraceviewer doesn't work yet. Disable it for now.
 #define ENABLE_REPLAY false
 
+// Replay keeps a checkpoint to seek back to every this many frames
+#define VKTRACEVIEWER_CHECKPOINT_FRAMES 30
+
 class vktraceviewer_QReplayWorker : public QObject {
     Q_OBJECT
    public:
@@ -91,6 +94,13 @@ class vktraceviewer_QReplayWorker : public QObject {
     QAction* m_pActionRunToHere;
     uint64_t m_pauseAtPacketIndex;
 
+    // Seeking back to a call replays forward from the last checkpoint, if it comes before the call,
+    // instead of from the start of the trace. The replayers hold on to the memory contents of one
+    // checkpoint, which is refreshed every VKTRACEVIEWER_CHECKPOINT_FRAMES frames as replay goes on.
+    uint64_t m_replayFrame;
+    uint64_t m_checkpointPacketIndex;  // the first packet of the checkpoint's frame, or -1 if there is none
+    uint64_t m_checkpointFrame;
+
     QWidget* m_pReplayWindow;
     int m_pReplayWindowWidth;
     int m_pReplayWindowHeight;
@@ -106,6 +116,9 @@ class vktraceviewer_QReplayWorker : public QObject {
     vktrace_replay::ReplayFactory m_replayerFactory;
     vktrace_replay::vktrace_trace_packet_replay_library* m_pReplayers[VKTRACE_MAX_TRACER_ID_ARRAY_SIZE];
 
+    void saveCheckpoint(uint64_t packetIndex);
+    void resumeFromCheckpoint();
+
     void doReplayPaused(uint64_t packetIndex);
     void doReplayStopped(uint64_t packetIndex);
     void doReplayFinished(uint64_t packetIndex);
@@ -20,17 +20,26 @@
  **************************************************************************/
 #pragma once
 
+#include <QCache>
 #include <QColor>
 #include <QFont>
 #include <QSize>
 #include <qabstractitemmodel.h>
 #include "vktraceviewer_trace_file_utils.h"
 
+class vktraceviewer_QTraceFileIndexer;
+
+// Rendered API calls of the rows that were shown are kept up to this many characters in total, dropping the least
+// recently used first
+#define VKTRACEVIEWER_PACKET_STRING_CACHE_SIZE (16 * 1024 * 1024)
+
 class vktraceviewer_QTraceFileModel : public QAbstractItemModel {
     Q_OBJECT
    public:
     vktraceviewer_QTraceFileModel(QObject* parent, vktraceviewer_trace_file_info* pTraceFileInfo) : QAbstractItemModel(parent) {
         m_pTraceFileInfo = pTraceFileInfo;
+        m_pIndexer = NULL;
+        m_packetStrings.setMaxCost(VKTRACEVIEWER_PACKET_STRING_CACHE_SIZE);
     }
 
     virtual ~vktraceviewer_QTraceFileModel() {}
@@ -120,8 +129,18 @@ class vktraceviewer_QTraceFileModel : public QAbstractItemModel {
         if (role == Qt::DisplayRole) {
             switch (index.column()) {
                 case Column_EntrypointName: {
-                    vktrace_trace_packet_header* pHeader = (vktrace_trace_packet_header*)index.internalPointer();
+                    // Only the rows that are shown get their packet read from the trace file and rendered
+                    const QString* pCached = m_packetStrings.object(index.row());
+                    if (pCached != NULL) {
+                        return *pCached;
+                    }
+                    vktrace_trace_packet_header* pHeader = vktraceviewer_get_trace_packet(m_pTraceFileInfo, index.row());
+                    if (pHeader == NULL) {
+                        return QString("Unreadable packet %1")
+                            .arg(((vktrace_trace_packet_header*)index.internalPointer())->packet_id);
+                    }
                     QString apiStr = this->get_packet_string(pHeader);
+                    m_packetStrings.insert(index.row(), new QString(apiStr), qMax(apiStr.size(), 1));
                     return apiStr;
                 }
                 case Column_TracerId:
@@ -164,8 +183,12 @@ class vktraceviewer_QTraceFileModel : public QAbstractItemModel {
             tip += QString("<tr><td>pBody</td><td>= %1</td></tr>").arg(pHeader->pBody);
             tip += "<br>";
 #endif
+            vktrace_trace_packet_header* pPacket = vktraceviewer_get_trace_packet(m_pTraceFileInfo, index.row());
+            if (pPacket == NULL) {
+                return QVariant();
+            }
             tip += "<tr><td><b>";
-            QString multiline = this->get_packet_string_multiline(pHeader);
+            QString multiline = this->get_packet_string_multiline(pPacket);
             // only replaces the first '('
             multiline.replace(multiline.indexOf("("), 1, "</b>(</td><td/></tr><tr><td>");
             multiline.replace(", ", ", </td></tr><tr><td>");
@@ -191,7 +214,8 @@ class vktraceviewer_QTraceFileModel : public QAbstractItemModel {
             return QModelIndex();
         }
 
-        vktrace_trace_packet_header* pHeader = m_pTraceFileInfo->pPacketOffsets[row].pHeader;
+        // The views only need the header of the packet, which stays where it is
+        vktrace_trace_packet_header* pHeader = &m_pTraceFileInfo->pPacketOffsets[row].header;
         void* pData = NULL;
         switch (column) {
             case Column_EntrypointName:
@@ -253,7 +277,14 @@ class vktraceviewer_QTraceFileModel : public QAbstractItemModel {
 
     void set_highlight_search_string(const QString searchString) { m_searchString = searchString; }
 
+    // Groups and searches the rows on worker threads, NULL if the rows aren't indexed
+    void set_indexer(vktraceviewer_QTraceFileIndexer* pIndexer) { m_pIndexer = pIndexer; }
+    vktraceviewer_QTraceFileIndexer* get_indexer() const { return m_pIndexer; }
+
    private:
     vktraceviewer_trace_file_info* m_pTraceFileInfo;
+    vktraceviewer_QTraceFileIndexer* m_pIndexer;
     QString m_searchString;
+    // By row
+    mutable QCache<int, QString> m_packetStrings;
 };
@@ -0,0 +1,175 @@
+/**************************************************************************
+ *
+ * Copyright (C) 2017 LunarG, Inc.
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **************************************************************************/
+#include "vktraceviewer_qthumbnailgenerator.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QProcessEnvironment>
+
+#include "vktrace_tracelog.h"
+
+// How often the cache directory is checked for new thumbnails, in milliseconds
+static const int THUMBNAIL_POLL_INTERVAL = 250;
+// At most this many thumbnails are loaded at a time, so the UI thread isn't held up
+static const int THUMBNAILS_PER_POLL = 32;
+// Written to the cache directory once the replay has made all the thumbnails
+static const char* const THUMBNAILS_COMPLETE_FILE = "complete";
+
+vktraceviewer_QThumbnailGenerator::vktraceviewer_QThumbnailGenerator(const QString& traceFilePath, int scale)
+    : QObject(NULL),
+      m_traceFilePath(QFileInfo(traceFilePath).absoluteFilePath()),
+      m_cacheDirectory(m_traceFilePath + ".thumbnails"),
+      m_scale(scale),
+      m_pReplayProcess(NULL),
+      m_bReplayDone(false) {
+    m_pollTimer.setInterval(THUMBNAIL_POLL_INTERVAL);
+    connect(&m_pollTimer, SIGNAL(timeout()), this, SLOT(onPollTimer()));
+}
+
+vktraceviewer_QThumbnailGenerator::~vktraceviewer_QThumbnailGenerator() {
+    m_pollTimer.stop();
+
+    // An unfinished cache doesn't get the complete file, so it is made again next time
+    if (m_pReplayProcess != NULL) {
+        disconnect(m_pReplayProcess, SIGNAL(finished(int, QProcess::ExitStatus)), this,
+                   SLOT(onReplayFinished(int, QProcess::ExitStatus)));
+        m_pReplayProcess->kill();
+        m_pReplayProcess->waitForFinished(-1);
+        delete m_pReplayProcess;
+        m_pReplayProcess = NULL;
+    }
+}
+
+void vktraceviewer_QThumbnailGenerator::start() {
+    QFileInfo completeFile(QDir(m_cacheDirectory).filePath(THUMBNAILS_COMPLETE_FILE));
+    if (completeFile.exists() && completeFile.lastModified() >= QFileInfo(m_traceFilePath).lastModified()) {
+        m_bReplayDone = true;
+        m_pollTimer.start();
+        return;
+    }
+
+    // Thumbnails of an older trace file or of an unfinished replay are made again
+    QDir cacheDirectory(m_cacheDirectory);
+    if (cacheDirectory.exists() && !cacheDirectory.removeRecursively()) {
+        vktrace_LogWarning("Failed to remove the thumbnails in '%s'.", m_cacheDirectory.toStdString().c_str());
+        return;
+    }
+    if (!QDir().mkpath(m_cacheDirectory)) {
+        vktrace_LogWarning("Failed to create '%s' for thumbnails.", m_cacheDirectory.toStdString().c_str());
+        return;
+    }
+
+    // The screenshots are written to the working directory of vkreplay
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    environment.insert("VK_SCREENSHOT_THUMBNAIL_SCALE", QString::number(m_scale));
+    environment.insert("VK_SCREENSHOT_THUMBNAIL_ONLY", "1");
+    environment.insert("VK_SCREENSHOT_FILE_FORMAT", "PPM");
+
+    m_pReplayProcess = new QProcess();
+    m_pReplayProcess->setProcessEnvironment(environment);
+    m_pReplayProcess->setWorkingDirectory(m_cacheDirectory);
+    m_pReplayProcess->setStandardOutputFile(QProcess::nullDevice());
+    m_pReplayProcess->setStandardErrorFile(QProcess::nullDevice());
+    connect(m_pReplayProcess, SIGNAL(finished(int, QProcess::ExitStatus)), this,
+            SLOT(onReplayFinished(int, QProcess::ExitStatus)));
+
+    QString replayer = QCoreApplication::applicationDirPath() + "/vkreplay";
+    QStringList arguments;
+    arguments << "-o" << m_traceFilePath << "-s"
+              << "all";
+    m_pReplayProcess->start(replayer, arguments);
+    if (!m_pReplayProcess->waitForStarted()) {
+        vktrace_LogWarning("Failed to start '%s' to make thumbnails.", replayer.toStdString().c_str());
+        delete m_pReplayProcess;
+        m_pReplayProcess = NULL;
+        return;
+    }
+    m_pollTimer.start();
+}
+
+QPixmap vktraceviewer_QThumbnailGenerator::thumbnail(int frame) const {
+    if (frame < 0 || frame >= m_thumbnails.count()) {
+        return QPixmap();
+    }
+    return m_thumbnails[frame];
+}
+
+void vktraceviewer_QThumbnailGenerator::onPollTimer() {
+    if (!loadThumbnails() && m_bReplayDone) {
+        m_pollTimer.stop();
+    }
+}
+
+void vktraceviewer_QThumbnailGenerator::onReplayFinished(int exitCode, QProcess::ExitStatus exitStatus) {
+    if (exitStatus == QProcess::NormalExit && exitCode == 0) {
+        QFile completeFile(QDir(m_cacheDirectory).filePath(THUMBNAILS_COMPLETE_FILE));
+        completeFile.open(QIODevice::WriteOnly);
+    } else {
+        vktrace_LogWarning("Replaying the trace to make thumbnails failed with %d, the later frames have none.", exitCode);
+    }
+    m_pReplayProcess->deleteLater();
+    m_pReplayProcess = NULL;
+
+    // The remaining thumbnails are loaded by the timer
+    m_bReplayDone = true;
+}
+
+QString vktraceviewer_QThumbnailGenerator::thumbnailPath(int frame) const {
+    return QDir(m_cacheDirectory).filePath(QString("%1_thumbnail.ppm").arg(frame));
+}
+
+QString vktraceviewer_QThumbnailGenerator::screenshotPath(int frame) const {
+    return QDir(m_cacheDirectory).filePath(QString("%1.ppm").arg(frame));
+}
+
+bool vktraceviewer_QThumbnailGenerator::loadThumbnails() {
+    int firstFrame = m_thumbnails.count();
+    while (m_thumbnails.count() - firstFrame < THUMBNAILS_PER_POLL) {
+        int frame = m_thumbnails.count();
+
+        // Without the layer's compute shader there are only full size screenshots, which are shrunk here
+        QString path = thumbnailPath(frame);
+        if (!QFile::exists(path)) {
+            path = screenshotPath(frame);
+            if (!QFile::exists(path)) {
+                break;
+            }
+        }
+
+        // The screenshots are written in frame order, so one is complete once the next one is there
+        if (!m_bReplayDone && !QFile::exists(thumbnailPath(frame + 1)) && !QFile::exists(screenshotPath(frame + 1))) {
+            break;
+        }
+
+        QImage image(path);
+        if (image.height() > VKTRACEVIEWER_THUMBNAIL_HEIGHT) {
+            image = image.scaledToHeight(VKTRACEVIEWER_THUMBNAIL_HEIGHT, Qt::SmoothTransformation);
+        }
+        m_thumbnails.append(QPixmap::fromImage(image));
+    }
+
+    int count = m_thumbnails.count() - firstFrame;
+    if (count > 0) {
+        emit ThumbnailsLoaded(firstFrame, count);
+    }
+    return count > 0;
+}
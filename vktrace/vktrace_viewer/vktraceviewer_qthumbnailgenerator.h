@@ -0,0 +1,73 @@
+/**************************************************************************
+ *
+ * Copyright (C) 2017 LunarG, Inc.
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **************************************************************************/
+#ifndef VKTRACEVIEWER_QTHUMBNAILGENERATOR_H
+#define VKTRACEVIEWER_QTHUMBNAILGENERATOR_H
+
+#include <QObject>
+#include <QPixmap>
+#include <QProcess>
+#include <QTimer>
+#include <QVector>
+
+// Thumbnails taller than this are shrunk to it for the frame rows
+#define VKTRACEVIEWER_THUMBNAIL_HEIGHT 64
+
+// Makes a thumbnail of every frame of a trace file by replaying it with vkreplay in a process of
+// its own, with the screenshot layer writing downsampled screenshots of each frame. They are
+// cached in the <trace file>.thumbnails directory next to the trace, so opening the trace again
+// shows them without replaying it. The thumbnails are picked up as the replay writes them, and
+// handed to the UI thread with a signal, so they show up frame by frame while the trace is
+// browsed.
+class vktraceviewer_QThumbnailGenerator : public QObject {
+    Q_OBJECT
+   public:
+    // Screenshots are downsampled by scale, which is at least 2
+    vktraceviewer_QThumbnailGenerator(const QString& traceFilePath, int scale);
+    virtual ~vktraceviewer_QThumbnailGenerator();
+
+    // Loads the cached thumbnails, and starts replaying the trace if they aren't all there
+    void start();
+
+    // Returns a null pixmap if the frame doesn't have a thumbnail yet
+    QPixmap thumbnail(int frame) const;
+
+   signals:
+    // Emitted when the thumbnails of frames firstFrame to firstFrame + count - 1 are loaded
+    void ThumbnailsLoaded(int firstFrame, int count);
+
+   private slots:
+    void onPollTimer();
+    void onReplayFinished(int exitCode, QProcess::ExitStatus exitStatus);
+
+   private:
+    QString m_traceFilePath;
+    QString m_cacheDirectory;
+    int m_scale;
+    QProcess* m_pReplayProcess;
+    QTimer m_pollTimer;
+    bool m_bReplayDone;
+    QVector<QPixmap> m_thumbnails;
+
+    QString thumbnailPath(int frame) const;
+    QString screenshotPath(int frame) const;
+    // Loads some of the thumbnails from the next frame on that are done being written, returns
+    // false if there weren't any
+    bool loadThumbnails();
+};
+
+#endif  // VKTRACEVIEWER_QTHUMBNAILGENERATOR_H
@@ -28,6 +28,7 @@
 #define _USE_MATH_DEFINES
 #endif
 #include <math.h>
+#include <algorithm>
 #include "vktraceviewer_qtimelineview.h"
 #include "vktraceviewer_QTraceFileModel.h"
 
@@ -92,10 +93,7 @@ void vktraceviewer_QTimelineItemDelegate::paint(QPainter *painter, const QStyleO
                 rect.setWidth(1);
             }
 
-            float duration = u64ToFloat(pHeader->entrypoint_end_time - pHeader->entrypoint_begin_time);
-            float durationRatio = duration / pTimeline->getMaxItemDuration();
-            int intensity = std::min(255, (int)(durationRatio * 255.0f));
-            QColor color(intensity, 255 - intensity, 0);
+            QColor color = pTimeline->getItemColor(pHeader->entrypoint_end_time - pHeader->entrypoint_begin_time);
 
             // add gradient to the items better distinguish between the end of one and beginning of the next
             QLinearGradient linearGrad(rect.center(), rect.bottomRight());
@@ -139,6 +137,7 @@ QSize vktraceviewer_QTimelineItemDelegate::sizeHint(const QStyleOptionViewItem &
 vktraceviewer_QTimelineView::vktraceviewer_QTimelineView(QWidget *parent)
     : QAbstractItemView(parent),
       m_maxItemDuration(0),
+      m_finestBucketDuration(1),
       m_maxZoom(0.001f),
       m_threadHeight(0),
       m_hashIsDirty(true),
@@ -174,6 +173,10 @@ void vktraceviewer_QTimelineView::setModel(QAbstractItemModel *pModel) {
 
     m_threadIdList.clear();
     m_threadMask.clear();
+    m_threadArea.clear();
+    m_threadIndex.clear();
+    m_threadRows.clear();
+    m_threadBuckets.clear();
     m_maxItemDuration = 0;
     m_rawStartTime = 0;
     m_rawEndTime = 0;
@@ -189,27 +192,42 @@ void vktraceviewer_QTimelineView::setModel(QAbstractItemModel *pModel) {
 
     int numRows = model()->rowCount();
     for (int i = 0; i < numRows; i++) {
+        const vktrace_trace_packet_header *pHeader = rowHeader(i);
+        if (pHeader == NULL) {
+            continue;
+        }
+
         // Count number of unique thread Ids
-        QModelIndex item = model()->index(i, vktraceviewer_QTraceFileModel::Column_ThreadId);
-        if (item.isValid()) {
-            uint32_t threadId = item.data().toUInt();
-            if (!m_threadIdList.contains(threadId)) {
-                m_threadIdList.append(threadId);
-                m_threadMask.insert(threadId, QVector<int>());
-                m_threadArea.append(QRect());
-            }
+        QHash<uint32_t, int>::iterator thread = m_threadIndex.find(pHeader->thread_id);
+        if (thread == m_threadIndex.end()) {
+            thread = m_threadIndex.insert(pHeader->thread_id, m_threadIdList.count());
+            m_threadIdList.append(pHeader->thread_id);
+            m_threadMask.insert(pHeader->thread_id, QVector<int>());
+            m_threadArea.append(QRect());
+            m_threadRows.append(QVector<int>());
         }
+        m_threadRows[thread.value()].append(i);
 
         // Find duration of longest item
-        item = model()->index(i, vktraceviewer_QTraceFileModel::Column_CpuDuration);
-        if (item.isValid()) {
-            float duration = item.data().toFloat();
+        if (pHeader->entrypoint_end_time > pHeader->entrypoint_begin_time) {
+            float duration = u64ToFloat(pHeader->entrypoint_end_time - pHeader->entrypoint_begin_time);
             if (m_maxItemDuration < duration) {
                 m_maxItemDuration = duration;
             }
         }
     }
 
+    // The rows of a thread are looked up by time while painting
+    for (int t = 0; t < m_threadRows.count(); t++) {
+        QVector<int> &rows = m_threadRows[t];
+        auto beginsEarlier = [this](int a, int b) {
+            return rowHeader(a)->entrypoint_begin_time < rowHeader(b)->entrypoint_begin_time;
+        };
+        if (!std::is_sorted(rows.begin(), rows.end(), beginsEarlier)) {
+            std::stable_sort(rows.begin(), rows.end(), beginsEarlier);
+        }
+    }
+
     // Get start time
     QModelIndex start = model()->index(0, vktraceviewer_QTraceFileModel::Column_BeginTime);
     if (start.isValid()) {
@@ -224,6 +242,7 @@ void vktraceviewer_QTimelineView::setModel(QAbstractItemModel *pModel) {
 
     // the duration to viewport scale should allow us to map the entire timeline into the current window width.
     m_lineLength = m_rawEndTime - m_rawStartTime;
+    buildBuckets();
 
     int initialTimelineWidth = viewport()->width() - 2 * m_margin - m_scrollBarWidth;
     m_durationToViewportScale = (float)initialTimelineWidth / u64ToFloat(m_lineLength);
@@ -236,6 +255,123 @@ void vktraceviewer_QTimelineView::setModel(QAbstractItemModel *pModel) {
     verticalScrollBar()->setSingleStep(1);
 }
 
+//-----------------------------------------------------------------------------
+const vktrace_trace_packet_header *vktraceviewer_QTimelineView::rowHeader(int row) const {
+    QModelIndex index = model()->index(row, vktraceviewer_QTraceFileModel::Column_EntrypointName);
+    return (const vktrace_trace_packet_header *)index.internalPointer();
+}
+
+//-----------------------------------------------------------------------------
+uint32_t vktraceviewer_QTimelineView::finestBucketIndex(uint64_t time) const {
+    if (time <= m_rawStartTime) {
+        return 0;
+    }
+    return (uint32_t)qMin((uint64_t)VKTRACEVIEWER_TIMELINE_FINEST_BUCKETS - 1, (time - m_rawStartTime) / m_finestBucketDuration);
+}
+
+//-----------------------------------------------------------------------------
+static void addToBucket(QVector<vktraceviewer_QTimelineBucket> &level, const vktraceviewer_QTimelineBucket &added) {
+    if (level.isEmpty() || level.last().index != added.index) {
+        level.append(added);
+        return;
+    }
+
+    vktraceviewer_QTimelineBucket &bucket = level.last();
+    bucket.count += added.count;
+    bucket.minBeginTime = qMin(bucket.minBeginTime, added.minBeginTime);
+    bucket.maxEndTime = qMax(bucket.maxEndTime, added.maxEndTime);
+    if (added.maxDuration > bucket.maxDuration) {
+        bucket.maxDuration = added.maxDuration;
+        bucket.maxDurationRow = added.maxDurationRow;
+    }
+}
+
+//-----------------------------------------------------------------------------
+void vktraceviewer_QTimelineView::buildBuckets() {
+    m_finestBucketDuration =
+        qMax((uint64_t)1, (m_lineLength + VKTRACEVIEWER_TIMELINE_FINEST_BUCKETS - 1) / VKTRACEVIEWER_TIMELINE_FINEST_BUCKETS);
+
+    int levelCount = 1;
+    while ((VKTRACEVIEWER_TIMELINE_FINEST_BUCKETS >> (levelCount - 1)) > 1) {
+        levelCount++;
+    }
+
+    m_threadBuckets.resize(m_threadIdList.count());
+    for (int t = 0; t < m_threadIdList.count(); t++) {
+        QVector<QVector<vktraceviewer_QTimelineBucket> > &levels = m_threadBuckets[t];
+        levels.resize(levelCount);
+
+        // The rows are in order of their begin time, so each one goes into the last bucket or a new one after it
+        const QVector<int> &rows = m_threadRows[t];
+        for (int r = 0; r < rows.count(); r++) {
+            const vktrace_trace_packet_header *pHeader = rowHeader(rows[r]);
+            if (pHeader->entrypoint_end_time <= pHeader->entrypoint_begin_time) {
+                continue;
+            }
+
+            vktraceviewer_QTimelineBucket packet;
+            packet.index = finestBucketIndex(pHeader->entrypoint_begin_time);
+            packet.count = 1;
+            packet.minBeginTime = pHeader->entrypoint_begin_time;
+            packet.maxEndTime = pHeader->entrypoint_end_time;
+            packet.maxDuration = pHeader->entrypoint_end_time - pHeader->entrypoint_begin_time;
+            packet.maxDurationRow = rows[r];
+            addToBucket(levels[0], packet);
+        }
+
+        // Each coarser level joins pairs of buckets of the level before
+        for (int level = 1; level < levelCount; level++) {
+            const QVector<vktraceviewer_QTimelineBucket> &finer = levels[level - 1];
+            for (int b = 0; b < finer.count(); b++) {
+                vktraceviewer_QTimelineBucket bucket = finer[b];
+                bucket.index >>= 1;
+                addToBucket(levels[level], bucket);
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+int vktraceviewer_QTimelineView::bucketLevelForZoom() const {
+    // The packets themselves are drawn once the finest buckets are wider than a pixel
+    float bucketWidth = u64ToFloat(m_finestBucketDuration) * m_zoomFactor;
+    if (bucketWidth > 1.0f || m_threadBuckets.isEmpty()) {
+        return -1;
+    }
+
+    // otherwise the coarsest level that still has a bucket per pixel or more
+    int level = 0;
+    int levelCount = m_threadBuckets[0].count();
+    while (level + 1 < levelCount && bucketWidth * 2 <= 1.0f) {
+        bucketWidth *= 2;
+        level++;
+    }
+    return level;
+}
+
+//-----------------------------------------------------------------------------
+uint64_t vktraceviewer_QTimelineView::timeAtViewportX(int x) const {
+    int contentX = x - m_margin + horizontalScrollBar()->value();
+    if (contentX <= 0) {
+        return m_rawStartTime;
+    }
+    return m_rawStartTime + (uint64_t)((float)contentX / m_zoomFactor);
+}
+
+//-----------------------------------------------------------------------------
+int vktraceviewer_QTimelineView::firstThreadRowEndingAfter(int threadIndex, uint64_t time) const {
+    const QVector<int> &rows = m_threadRows[threadIndex];
+    int first = std::lower_bound(rows.begin(), rows.end(), time,
+                                 [this](int row, uint64_t t) { return rowHeader(row)->entrypoint_begin_time < t; }) -
+                rows.begin();
+
+    // The calls of a thread don't overlap, so only the one before can still be running at that time
+    if (first > 0 && rowHeader(rows[first - 1])->entrypoint_end_time > time) {
+        first--;
+    }
+    return first;
+}
+
 //-----------------------------------------------------------------------------
 void vktraceviewer_QTimelineView::calculateRectsIfNecessary() {
     if (!m_hashIsDirty) {
@@ -253,44 +389,45 @@ void vktraceviewer_QTimelineView::calculateRectsIfNecessary() {
         this->m_threadArea[threadIndex] = QRect(0, top, viewport()->width(), itemHeight);
     }
 
-    int numRows = model()->rowCount();
-    for (int row = 0; row < numRows; row++) {
-        QRectF rect;
-        QModelIndex item = model()->index(row, vktraceviewer_QTraceFileModel::Column_EntrypointName);
+    m_hashIsDirty = false;
+    viewport()->update();
+}
 
-        vktrace_trace_packet_header *pHeader = (vktrace_trace_packet_header *)item.internalPointer();
+//-----------------------------------------------------------------------------
+QRectF vktraceviewer_QTimelineView::itemRect(const QModelIndex &item) const {
+    QRectF rect;
+    if (!item.isValid() || model() == NULL) {
+        return rect;
+    }
 
-        // make sure item is valid size
-        if (pHeader->entrypoint_end_time > pHeader->entrypoint_begin_time) {
-            int threadIndex = m_threadIdList.indexOf(pHeader->thread_id);
-            int topOffset = (m_threadHeight * threadIndex) + (m_threadHeight * 0.5);
+    // The rect is worked out from the packet header when it is needed, rather than kept for every packet
+    const vktrace_trace_packet_header *pHeader = rowHeader(item.row());
 
-            uint64_t duration = pHeader->entrypoint_end_time - pHeader->entrypoint_begin_time;
+    // make sure item is valid size
+    if (pHeader != NULL && pHeader->entrypoint_end_time > pHeader->entrypoint_begin_time) {
+        int itemHeight = m_threadHeight * 0.4;
+        int threadIndex = m_threadIndex.value(pHeader->thread_id);
+        int topOffset = (m_threadHeight * threadIndex) + (m_threadHeight * 0.5);
 
-            float leftOffset = u64ToFloat(pHeader->entrypoint_begin_time - m_rawStartTime);
-            float Width = u64ToFloat(duration);
+        uint64_t duration = pHeader->entrypoint_end_time - pHeader->entrypoint_begin_time;
 
-            // create the rect that represents this item
-            rect.setLeft(leftOffset);
-            rect.setTop(topOffset - (itemHeight / 2));
-            rect.setWidth(Width);
-            rect.setHeight(itemHeight);
-        }
+        float leftOffset = u64ToFloat(pHeader->entrypoint_begin_time - m_rawStartTime);
+        float Width = u64ToFloat(duration);
 
-        m_rowToRectMap[row] = rect;
+        // create the rect that represents this item
+        rect.setLeft(leftOffset);
+        rect.setTop(topOffset - (itemHeight / 2));
+        rect.setWidth(Width);
+        rect.setHeight(itemHeight);
     }
-
-    m_hashIsDirty = false;
-    viewport()->update();
+    return rect;
 }
 
 //-----------------------------------------------------------------------------
-QRectF vktraceviewer_QTimelineView::itemRect(const QModelIndex &item) const {
-    QRectF rect;
-    if (item.isValid()) {
-        rect = m_rowToRectMap.value(item.row());
-    }
-    return rect;
+QColor vktraceviewer_QTimelineView::getItemColor(uint64_t duration) const {
+    float durationRatio = u64ToFloat(duration) / getMaxItemDuration();
+    int intensity = std::min(255, (int)(durationRatio * 255.0f));
+    return QColor(intensity, 255 - intensity, 0);
 }
 
 //-----------------------------------------------------------------------------
@@ -455,29 +592,42 @@ QModelIndex vktraceviewer_QTimelineView::indexAt(const QPoint &point) const {
     float wy = (float)point.y();
 
     // Early out if the point is not in the areas covered by timeline items
-    bool inThreadArea = false;
+    int threadIndex = -1;
     for (int i = 0; i < m_threadArea.size(); i++) {
         if (wy >= m_threadArea[i].top() && wy <= m_threadArea[i].bottom()) {
-            inThreadArea = true;
+            threadIndex = i;
             break;
         }
     }
 
-    if (inThreadArea == false) {
+    if (threadIndex == -1) {
         // point is outside the areas that timeline items are drawn to.
         return QModelIndex();
     }
 
-    // Transform the view coordinates into content widget coordinates.
-    int x = point.x() - m_margin + horizontalScrollBar()->value();
-    float wx = (float)x / m_zoomFactor;
+    // Transform the view coordinates into a time on the timeline, and look for the call running then
+    uint64_t time = timeAtViewportX(point.x());
+    const QVector<int> &rows = m_threadRows[threadIndex];
+    int first = firstThreadRowEndingAfter(threadIndex, time);
+    if (first < rows.count()) {
+        const vktrace_trace_packet_header *pHeader = rowHeader(rows[first]);
+        if (pHeader->entrypoint_begin_time <= time && pHeader->entrypoint_end_time > time) {
+            return model()->index(rows[first], vktraceviewer_QTraceFileModel::Column_EntrypointName);
+        }
+    }
 
-    QHashIterator<int, QRectF> iter(m_rowToRectMap);
-    while (iter.hasNext()) {
-        iter.next();
-        QRectF value = iter.value();
-        if (value.contains(wx, wy)) {
-            return model()->index(iter.key(), vktraceviewer_QTraceFileModel::Column_EntrypointName);
+    // When zoomed out the calls are too narrow to hit, so the longest call of the bucket under the point is taken
+    int level = bucketLevelForZoom();
+    if (level >= 0) {
+        const QVector<vktraceviewer_QTimelineBucket> &buckets = m_threadBuckets[threadIndex][level];
+        uint32_t index = finestBucketIndex(time) >> level;
+        auto bucket = std::upper_bound(buckets.begin(), buckets.end(), index,
+                                       [](uint32_t i, const vktraceviewer_QTimelineBucket &b) { return i < b.index; });
+        if (bucket != buckets.begin()) {
+            --bucket;
+            if (bucket->minBeginTime <= time && bucket->maxEndTime > time) {
+                return model()->index(bucket->maxDurationRow, vktraceviewer_QTraceFileModel::Column_EntrypointName);
+            }
         }
     }
 
@@ -561,12 +711,25 @@ void vktraceviewer_QTimelineView::paint(QPainter *painter, QPaintEvent *event) {
         drawBaseTimelines(&pixmapPainter, event->rect(), threadList);
 
         if (model() != NULL) {
-            int numRows = model()->rowCount();
-
-            for (int r = 0; r < numRows; r++) {
-                QModelIndex index = model()->index(r, vktraceviewer_QTraceFileModel::Column_EntrypointName);
-
-                drawTimelineItem(&pixmapPainter, index);
+            // Only the calls in view are drawn, or their buckets where there are more of them than pixels
+            int level = bucketLevelForZoom();
+            uint64_t startTime = timeAtViewportX(0);
+            uint64_t endTime = timeAtViewportX(viewport()->width());
+            for (int t = 0; t < m_threadIdList.size(); t++) {
+                const QVector<int> &rows = m_threadRows[t];
+                int firstRow = firstThreadRowEndingAfter(t, startTime);
+                auto beginsLater = [this](uint64_t time, int row) { return time < rowHeader(row)->entrypoint_begin_time; };
+                int endRow = std::upper_bound(rows.begin() + firstRow, rows.end(), endTime, beginsLater) - rows.begin();
+
+                if (level < 0 || endRow - firstRow <= viewport()->width()) {
+                    for (int r = firstRow; r < endRow; r++) {
+                        QModelIndex index = model()->index(rows[r], vktraceviewer_QTraceFileModel::Column_EntrypointName);
+
+                        drawTimelineItem(&pixmapPainter, index);
+                    }
+                } else {
+                    drawTimelineBuckets(&pixmapPainter, t, level, startTime, endTime);
+                }
             }
         }
     }
@@ -658,3 +821,48 @@ void vktraceviewer_QTimelineView::drawTimelineItem(QPainter *painter, const QMod
         itemDelegate()->paint(painter, option, index);
     }
 }
+
+//-----------------------------------------------------------------------------
+void vktraceviewer_QTimelineView::drawTimelineBuckets(QPainter *painter, int threadIndex, int level, uint64_t startTime,
+                                                      uint64_t endTime) {
+    const QVector<vktraceviewer_QTimelineBucket> &buckets = m_threadBuckets[threadIndex][level];
+
+    // A call that begins in the bucket before may still be running at the start
+    uint32_t startIndex = finestBucketIndex(startTime) >> level;
+    auto bucket = std::lower_bound(buckets.begin(), buckets.end(), startIndex,
+                                   [](const vktraceviewer_QTimelineBucket &b, uint32_t index) { return b.index < index; });
+    if (bucket != buckets.begin()) {
+        --bucket;
+    }
+
+    int itemHeight = m_threadHeight * 0.4;
+    int top = (m_threadHeight * threadIndex) + (m_threadHeight * 0.5) - itemHeight / 2;
+    QVector<int> &mask = m_threadMask[m_threadIdList[threadIndex]];
+
+    painter->save();
+    painter->setPen(Qt::NoPen);
+    for (; bucket != buckets.end() && bucket->minBeginTime <= endTime; ++bucket) {
+        // a bucket covers from its first call to the end of its last, and is at least a pixel wide
+        int left = m_margin + (int)scalePositionHorizontally(qMax(bucket->minBeginTime, m_rawStartTime)) - horizontalOffset();
+        int right = m_margin + (int)scalePositionHorizontally(qMax(bucket->maxEndTime, m_rawStartTime)) - horizontalOffset();
+        left = qMax(0, left);
+        right = qMin(right, viewport()->width() - 1);
+        if (right < left) {
+            continue;
+        }
+
+        // check mask to determine if this bucket should be drawn, or if something has already covered it's pixels
+        bool drawBucket = false;
+        for (int pixel = left; pixel <= right; pixel++) {
+            if (mask[pixel] == 0) {
+                drawBucket = true;
+                mask[pixel] = 1;
+            }
+        }
+
+        if (drawBucket) {
+            painter->fillRect(QRect(left, top, right - left + 1, itemHeight), getItemColor(bucket->maxDuration));
+        }
+    }
+    painter->restore();
+}
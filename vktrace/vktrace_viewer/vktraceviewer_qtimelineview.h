@@ -38,6 +38,25 @@ QT_END_NAMESPACE
 #include <QPen>
 #include <QScrollBar>
 
+// The packets of each thread are also added up into buckets of time, which are drawn instead of the
+// packets when the timeline is zoomed out too far for them to be told apart. This many buckets span
+// the finest level, each coarser level has half as many.
+#define VKTRACEVIEWER_TIMELINE_FINEST_BUCKETS (1 << 16)
+
+struct vktraceviewer_QTimelineBucket {
+    // the position of the bucket on its level
+    uint32_t index;
+
+    // the packets beginning in it
+    uint32_t count;
+    uint64_t minBeginTime;
+    uint64_t maxEndTime;
+    uint64_t maxDuration;
+
+    // the longest of them stands for the bucket when it is clicked
+    int maxDurationRow;
+};
+
 class vktraceviewer_QTimelineItemDelegate : public QAbstractItemDelegate {
     Q_OBJECT
    public:
@@ -67,6 +86,7 @@ class vktraceviewer_QTimelineView : public QAbstractItemView {
     QList<uint32_t> getModelThreadList() const;
     QRectF itemRect(const QModelIndex &item) const;
     float getMaxItemDuration() const { return m_maxItemDuration; }
+    QColor getItemColor(uint64_t duration) const;
 
     void deletePixmap() {
         if (m_pPixmap != NULL) {
@@ -85,6 +105,13 @@ class vktraceviewer_QTimelineView : public QAbstractItemView {
     QList<uint32_t> m_threadIdList;
     QHash<uint32_t, QVector<int> > m_threadMask;
     QList<QRect> m_threadArea;
+    QHash<uint32_t, int> m_threadIndex;
+    // the rows of each thread in m_threadIdList, ordered by their begin time
+    QVector<QVector<int> > m_threadRows;
+    // the buckets of each thread in m_threadIdList, from the finest level to the coarsest.
+    // Only buckets with packets in them are kept, in order.
+    QVector<QVector<QVector<vktraceviewer_QTimelineBucket> > > m_threadBuckets;
+    uint64_t m_finestBucketDuration;
     float m_maxItemDuration;
     uint64_t m_rawStartTime;
     uint64_t m_rawEndTime;
@@ -93,7 +120,6 @@ class vktraceviewer_QTimelineView : public QAbstractItemView {
     float m_zoomFactor;
     float m_maxZoom;
     int m_threadHeight;
-    QHash<int, QRectF> m_rowToRectMap;
     bool m_hashIsDirty;
     int m_margin;
     int m_scrollBarWidth;
@@ -102,9 +128,17 @@ class vktraceviewer_QTimelineView : public QAbstractItemView {
     QPixmap *m_pPixmap;
     vktraceviewer_QTimelineItemDelegate m_itemDelegate;
 
+    const vktrace_trace_packet_header *rowHeader(int row) const;
+    void buildBuckets();
+    int bucketLevelForZoom() const;
+    uint64_t timeAtViewportX(int x) const;
+    uint32_t finestBucketIndex(uint64_t time) const;
+    int firstThreadRowEndingAfter(int threadIndex, uint64_t time) const;
+
     void calculateRectsIfNecessary();
     void drawBaseTimelines(QPainter *painter, const QRect &rect, const QList<uint32_t> &threadList);
     void drawTimelineItem(QPainter *painter, const QModelIndex &index);
+    void drawTimelineBuckets(QPainter *painter, int threadIndex, int level, uint64_t startTime, uint64_t endTime);
 
     QRectF viewportRect(const QModelIndex &index) const;
     float scaleDurationHorizontally(uint64_t value) const;
@@ -0,0 +1,242 @@
+/**************************************************************************
+ *
+ * Copyright (C) 2017 LunarG, Inc.
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **************************************************************************/
+#include "vktraceviewer_qtracefileindexer.h"
+#include "vktraceviewer_QTraceFileModel.h"
+
+#include <QRunnable>
+
+#include <algorithm>
+
+extern "C" {
+#include "vktrace_vk_packet_id.h"
+}
+
+//-----------------------------------------------------------------------------
+class vktraceviewer_IndexChunkTask : public QRunnable {
+   public:
+    vktraceviewer_IndexChunkTask(vktraceviewer_QTraceFileIndexer* pIndexer, int chunk) : m_pIndexer(pIndexer), m_chunk(chunk) {}
+
+    virtual void run() {
+        if (m_pIndexer->m_bCancelled) {
+            return;
+        }
+
+        // Frames only depend on the packet headers, which are already in memory
+        std::vector<int>& frameEndRows = m_pIndexer->m_indexChunks[m_chunk].frameEndRows;
+        int endRow = m_pIndexer->chunkEndRow(m_chunk);
+        for (int row = m_pIndexer->chunkFirstRow(m_chunk); row < endRow; row++) {
+            const vktrace_trace_packet_header* pHeader = &m_pIndexer->m_pTraceFileInfo->pPacketOffsets[row].header;
+            if (pHeader->tracer_id == VKTRACE_TID_VULKAN && pHeader->packet_id == VKTRACE_TPI_VK_vkQueuePresentKHR) {
+                frameEndRows.push_back(row);
+            }
+        }
+
+        QMetaObject::invokeMethod(m_pIndexer, "onChunkIndexed", Qt::QueuedConnection, Q_ARG(int, m_chunk));
+    }
+
+   private:
+    vktraceviewer_QTraceFileIndexer* m_pIndexer;
+    int m_chunk;
+};
+
+//-----------------------------------------------------------------------------
+class vktraceviewer_SearchChunkTask : public QRunnable {
+   public:
+    vktraceviewer_SearchChunkTask(vktraceviewer_QTraceFileIndexer* pIndexer,
+                                  const std::shared_ptr<vktraceviewer_QTraceFileIndexer::SearchState>& pSearch, int chunk)
+        : m_pIndexer(pIndexer), m_pSearch(pSearch), m_chunk(chunk) {}
+
+    virtual void run() {
+        if (m_pIndexer->m_bCancelled || m_pSearch->bCancelled) {
+            return;
+        }
+
+        // The packet cache belongs to the UI thread, so the packets are read here with a file handle of this task's own
+        vktraceviewer_trace_file_packet_reader* pReader = NULL;
+        if (m_pSearch->columns.testBit(vktraceviewer_QTraceFileModel::Column_EntrypointName)) {
+            pReader = vktraceviewer_open_packet_reader(m_pIndexer->m_pTraceFileInfo, m_pIndexer->m_pController);
+        }
+
+        const vktraceviewer_QTraceFileModel* pModel = m_pIndexer->m_pModel;
+        std::vector<int>& matches = m_pSearch->chunkMatches[m_chunk];
+        int endRow = m_pIndexer->chunkEndRow(m_chunk);
+        for (int row = m_pIndexer->chunkFirstRow(m_chunk); row < endRow && !m_pSearch->bCancelled; row++) {
+            bool bMatch = false;
+            for (int column = 0; column < m_pSearch->columns.count() && !bMatch; column++) {
+                if (!m_pSearch->columns.testBit(column)) {
+                    continue;
+                }
+
+                // Only the entrypoint column needs the packet, the others come from the header
+                if (column == vktraceviewer_QTraceFileModel::Column_EntrypointName) {
+                    vktrace_trace_packet_header* pPacket =
+                        pReader != NULL ? vktraceviewer_read_trace_packet(pReader, m_pIndexer->m_pTraceFileInfo, row) : NULL;
+                    if (pPacket != NULL) {
+                        bMatch = pModel->get_packet_string(pPacket).contains(m_pSearch->text, Qt::CaseInsensitive);
+                        vktrace_free(pPacket);
+                    }
+                } else {
+                    bMatch = pModel->data(pModel->index(row, column), Qt::DisplayRole)
+                                 .toString()
+                                 .contains(m_pSearch->text, Qt::CaseInsensitive);
+                }
+            }
+
+            if (bMatch) {
+                matches.push_back(row);
+            }
+        }
+
+        vktraceviewer_close_packet_reader(pReader);
+
+        QMetaObject::invokeMethod(m_pIndexer, "onChunkSearched", Qt::QueuedConnection, Q_ARG(int, m_pSearch->id),
+                                  Q_ARG(int, m_chunk));
+    }
+
+   private:
+    vktraceviewer_QTraceFileIndexer* m_pIndexer;
+    std::shared_ptr<vktraceviewer_QTraceFileIndexer::SearchState> m_pSearch;
+    int m_chunk;
+};
+
+//-----------------------------------------------------------------------------
+vktraceviewer_QTraceFileIndexer::vktraceviewer_QTraceFileIndexer(vktraceviewer_trace_file_info* pTraceFileInfo,
+                                                                 const vktraceviewer_QTraceFileModel* pModel,
+                                                                 vktraceviewer_QController* pController)
+    : QObject(NULL),
+      m_pTraceFileInfo(pTraceFileInfo),
+      m_pModel(pModel),
+      m_pController(pController),
+      m_rowCount((int)pTraceFileInfo->packetCount),
+      m_nextChunkToIndex(0),
+      m_indexedRowCount(0),
+      m_nextSearchId(0),
+      m_bCancelled(false) {
+    m_chunkCount = (m_rowCount + VKTRACEVIEWER_INDEX_CHUNK_SIZE - 1) / VKTRACEVIEWER_INDEX_CHUNK_SIZE;
+    m_indexChunks.resize(m_chunkCount);
+    for (int chunk = 0; chunk < m_chunkCount; chunk++) {
+        m_indexChunks[chunk].bIndexed = false;
+    }
+}
+
+//-----------------------------------------------------------------------------
+vktraceviewer_QTraceFileIndexer::~vktraceviewer_QTraceFileIndexer() {
+    // The tasks use the trace file info and the model, which go away after this
+    m_bCancelled = true;
+    m_threadPool.clear();
+    m_threadPool.waitForDone();
+}
+
+//-----------------------------------------------------------------------------
+int vktraceviewer_QTraceFileIndexer::chunkEndRow(int chunk) const {
+    return std::min(chunkFirstRow(chunk) + VKTRACEVIEWER_INDEX_CHUNK_SIZE, m_rowCount);
+}
+
+//-----------------------------------------------------------------------------
+void vktraceviewer_QTraceFileIndexer::start() {
+    for (int chunk = 0; chunk < m_chunkCount; chunk++) {
+        m_threadPool.start(new vktraceviewer_IndexChunkTask(this, chunk));
+    }
+}
+
+//-----------------------------------------------------------------------------
+void vktraceviewer_QTraceFileIndexer::onChunkIndexed(int chunk) {
+    m_indexChunks[chunk].bIndexed = true;
+
+    // Pass on every chunk that no longer waits on an earlier one
+    int firstRow = m_indexedRowCount;
+    while (m_nextChunkToIndex < m_chunkCount && m_indexChunks[m_nextChunkToIndex].bIndexed) {
+        IndexChunk& indexed = m_indexChunks[m_nextChunkToIndex];
+        m_frameEndRows.insert(m_frameEndRows.end(), indexed.frameEndRows.begin(), indexed.frameEndRows.end());
+        std::vector<int>().swap(indexed.frameEndRows);
+        m_indexedRowCount = chunkEndRow(m_nextChunkToIndex);
+        m_nextChunkToIndex++;
+    }
+
+    if (m_indexedRowCount > firstRow) {
+        emit PacketsIndexed(firstRow, m_indexedRowCount - firstRow);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void vktraceviewer_QTraceFileIndexer::search(const QString& text, const QBitArray& columns) {
+    if (m_pSearch) {
+        if (m_pSearch->text == text && m_pSearch->columns == columns) {
+            return;
+        }
+        m_pSearch->bCancelled = true;
+    }
+
+    m_pSearch = std::make_shared<SearchState>();
+    m_pSearch->id = m_nextSearchId++;
+    m_pSearch->text = text;
+    m_pSearch->columns = columns;
+    m_pSearch->bCancelled = false;
+    m_pSearch->chunkMatches.resize(m_chunkCount);
+    m_pSearch->chunkSearched.resize(m_chunkCount, false);
+    if (text.isEmpty()) {
+        return;
+    }
+
+    for (int chunk = 0; chunk < m_chunkCount; chunk++) {
+        m_threadPool.start(new vktraceviewer_SearchChunkTask(this, m_pSearch, chunk));
+    }
+}
+
+//-----------------------------------------------------------------------------
+void vktraceviewer_QTraceFileIndexer::onChunkSearched(int searchId, int chunk) {
+    // Results of a search that was replaced are dropped
+    if (!m_pSearch || m_pSearch->id != searchId) {
+        return;
+    }
+
+    m_pSearch->chunkSearched[chunk] = true;
+    emit SearchProgress();
+}
+
+//-----------------------------------------------------------------------------
+int vktraceviewer_QTraceFileIndexer::findMatch(int fromRow, bool bForward, bool& bSearching) const {
+    bSearching = false;
+    if (!m_pSearch || m_pSearch->text.isEmpty() || fromRow < 0 || fromRow >= m_rowCount) {
+        return -1;
+    }
+
+    int step = bForward ? 1 : -1;
+    for (int chunk = fromRow / VKTRACEVIEWER_INDEX_CHUNK_SIZE; chunk >= 0 && chunk < m_chunkCount; chunk += step) {
+        if (!m_pSearch->chunkSearched[chunk]) {
+            // A match in there would come before any in the chunks after it
+            bSearching = true;
+            return -1;
+        }
+
+        const std::vector<int>& matches = m_pSearch->chunkMatches[chunk];
+        if (bForward) {
+            auto match = std::lower_bound(matches.begin(), matches.end(), fromRow);
+            if (match != matches.end()) {
+                return *match;
+            }
+        } else {
+            auto match = std::upper_bound(matches.begin(), matches.end(), fromRow);
+            if (match != matches.begin()) {
+                return *(match - 1);
+            }
+        }
+    }
+
+    return -1;
+}
@@ -0,0 +1,121 @@
+/**************************************************************************
+ *
+ * Copyright (C) 2017 LunarG, Inc.
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **************************************************************************/
+#ifndef VKTRACEVIEWER_QTRACEFILEINDEXER_H
+#define VKTRACEVIEWER_QTRACEFILEINDEXER_H
+
+#include <QBitArray>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "vktraceviewer_trace_file_utils.h"
+
+class vktraceviewer_QTraceFileModel;
+
+// The packets are indexed and searched in chunks of this many, each by one task of the thread pool
+#define VKTRACEVIEWER_INDEX_CHUNK_SIZE 16384
+
+// Indexes the packets of a trace file and searches them on a pool of worker threads, so the UI
+// stays responsive while a large trace is worked through. Results are handed to the UI thread
+// with signals as each chunk of packets is done.
+class vktraceviewer_QTraceFileIndexer : public QObject {
+    Q_OBJECT
+   public:
+    vktraceviewer_QTraceFileIndexer(vktraceviewer_trace_file_info* pTraceFileInfo, const vktraceviewer_QTraceFileModel* pModel,
+                                    vktraceviewer_QController* pController);
+    virtual ~vktraceviewer_QTraceFileIndexer();
+
+    // Queues the whole trace file to be indexed
+    void start();
+
+    // Rows from 0 up to this one are indexed. Rows are made available in order, so a chunk that
+    // has been indexed waits for the ones before it.
+    int indexedRowCount() const { return m_indexedRowCount; }
+
+    // The indexed rows of vkQueuePresentKHR packets in increasing order, which each end a frame
+    const std::vector<int>& frameEndRows() const { return m_frameEndRows; }
+
+    // Searches all the rows for text in the given columns of the model, on the worker threads.
+    // Doesn't restart if the same search is already running or done, and cancels any other.
+    void search(const QString& text, const QBitArray& columns);
+
+    // Returns the first row the search matched from fromRow on, or from fromRow back if bForward
+    // is false. Returns -1 if there is none, setting bSearching if that is only because some rows
+    // in that direction haven't been searched yet.
+    int findMatch(int fromRow, bool bForward, bool& bSearching) const;
+
+   signals:
+    // Emitted when rows are added to the index, in order
+    void PacketsIndexed(int firstRow, int rowCount);
+
+    // Emitted whenever more rows have been searched
+    void SearchProgress();
+
+   private slots:
+    void onChunkIndexed(int chunk);
+    void onChunkSearched(int searchId, int chunk);
+
+   private:
+    friend class vktraceviewer_IndexChunkTask;
+    friend class vktraceviewer_SearchChunkTask;
+
+    struct IndexChunk {
+        // Written by the worker thread, read on the UI thread once the chunk is indexed
+        std::vector<int> frameEndRows;
+        bool bIndexed;
+    };
+
+    struct SearchState {
+        int id;
+        QString text;
+        QBitArray columns;
+        std::atomic<bool> bCancelled;
+
+        // Each chunk's matching rows are written by the worker thread that searches it, and only
+        // read on the UI thread once chunkSearched is set.
+        std::vector<std::vector<int>> chunkMatches;
+        std::vector<bool> chunkSearched;
+    };
+
+    vktraceviewer_trace_file_info* m_pTraceFileInfo;
+    const vktraceviewer_QTraceFileModel* m_pModel;
+    vktraceviewer_QController* m_pController;
+
+    int m_rowCount;
+    int m_chunkCount;
+    std::vector<IndexChunk> m_indexChunks;
+    int m_nextChunkToIndex;
+    int m_indexedRowCount;
+    std::vector<int> m_frameEndRows;
+
+    // Shared with the tasks of the search, which may outlive it being cancelled
+    std::shared_ptr<SearchState> m_pSearch;
+    int m_nextSearchId;
+
+    std::atomic<bool> m_bCancelled;
+    QThreadPool m_threadPool;
+
+    int chunkFirstRow(int chunk) const { return chunk * VKTRACEVIEWER_INDEX_CHUNK_SIZE; }
+    int chunkEndRow(int chunk) const;
+};
+
+#endif  // VKTRACEVIEWER_QTRACEFILEINDEXER_H
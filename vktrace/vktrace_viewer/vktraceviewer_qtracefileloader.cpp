@@ -22,7 +22,11 @@
 #include "vktraceviewer_qtracefileloader.h"
 #include "vktraceviewer_controller_factory.h"
 
+#include <vector>
+
 extern "C" {
+#include "vktrace_blob_store.h"
+#include "vktrace_filelike.h"
 #include "vktrace_trace_packet_utils.h"
 }
 
@@ -72,45 +76,7 @@ void vktraceviewer_QTraceFileLoader::loadTraceFile(const QString& filename) {
                 connect(m_pController, SIGNAL(OutputMessage(VktraceLogLevel, uint64_t, const QString&)), this,
                         SIGNAL(OutputMessage(VktraceLogLevel, uint64_t, const QString&)));
 
-                // interpret the trace file packets
-                for (uint64_t i = 0; i < m_traceFileInfo.packetCount; i++) {
-                    vktraceviewer_trace_file_packet_offsets* pOffsets = &m_traceFileInfo.pPacketOffsets[i];
-                    switch (pOffsets->pHeader->packet_id) {
-                        case VKTRACE_TPI_MESSAGE:
-                            m_traceFileInfo.pPacketOffsets[i].pHeader =
-                                vktrace_interpret_body_as_trace_packet_message(pOffsets->pHeader)->pHeader;
-                            break;
-                        case VKTRACE_TPI_MARKER_CHECKPOINT:
-                            break;
-                        case VKTRACE_TPI_MARKER_API_BOUNDARY:
-                            break;
-                        case VKTRACE_TPI_MARKER_API_GROUP_BEGIN:
-                            break;
-                        case VKTRACE_TPI_MARKER_API_GROUP_END:
-                            break;
-                        case VKTRACE_TPI_MARKER_TERMINATE_PROCESS:
-                            break;
-                        case VKTRACE_TPI_PORTABILITY_TABLE:
-                            break;
-                        // TODO processing code for all the above cases
-                        default: {
-                            vktrace_trace_packet_header* pHeader = m_pController->InterpretTracePacket(pOffsets->pHeader);
-                            if (pHeader == NULL) {
-                                bOpened = false;
-                                emit OutputMessage(VKTRACE_LOG_ERROR,
-                                                   QString("Unrecognized packet type: %1").arg(pOffsets->pHeader->packet_id));
-                                m_traceFileInfo.pPacketOffsets[i].pHeader = NULL;
-                                break;
-                            }
-                            m_traceFileInfo.pPacketOffsets[i].pHeader = pHeader;
-                        }
-                    }
-
-                    // break from loop if there is an error
-                    if (bOpened == false) {
-                        break;
-                    }
-                }
+                // Packets are only read and interpreted once the viewer shows them, see vktraceviewer_get_trace_packet
 
 #ifdef USE_STATIC_CONTROLLER_LIBRARY
                 vtvDeleteQController(&m_pController);
@@ -208,99 +174,67 @@ bool vktraceviewer_QTraceFileLoader::populate_trace_file_info(vktraceviewer_trac
     // Set global version num
     vktrace_set_trace_version(pTraceFileInfo->pHeader->trace_file_version);
 
-    // Find out how many trace packets there are.
-
-    // Seek to first packet
-    long first_offset = pTraceFileInfo->pHeader->first_packet_offset;
-    int seekResult = Fseek(pTraceFileInfo->pFile, first_offset, SEEK_SET);
-    if (seekResult != 0) {
-        emit OutputMessage(VKTRACE_LOG_WARNING, "Failed to seek to the first packet offset in the trace file.");
+    // Walk the packets through a FileLike so compressed trace files are read the same way as uncompressed ones
+    FileLike* pFileLike = vktrace_FileLike_create_file(pTraceFileInfo->pFile);
+    if (pFileLike == NULL || !vktrace_FileLike_EnableDecompression(pFileLike, pTraceFileInfo->pHeader)) {
+        vktrace_free(pFileLike);
+        vktrace_free(pTraceFileInfo->pHeader);
+        emit OutputMessage(VKTRACE_LOG_ERROR, "Unable to read compressed trace file.");
+        return false;
     }
 
-    // "Walk" through each packet based on the packet size (which is the first 64-bits of the packet header)
+    // Index the packets without reading them in. "Walk" through each packet based on the packet
+    // size, which is the first 64-bits of the packet header, and keep a copy of that header.
+    std::vector<vktraceviewer_trace_file_packet_offsets> packetOffsets;
+    vktrace_blob_store_initialize();
     uint64_t fileOffset = pTraceFileInfo->pHeader->first_packet_offset;
-    uint64_t packetSize = 0;
-    while (1 == fread(&packetSize, sizeof(uint64_t), 1, pTraceFileInfo->pFile)) {
-        // success!
-        pTraceFileInfo->packetCount++;
-        fileOffset += packetSize;
-
-        seekResult = fseek(pTraceFileInfo->pFile, packetSize - sizeof(uint64_t), SEEK_CUR);
-        if (seekResult != 0) {
-            emit OutputMessage(VKTRACE_LOG_ERROR, "Error while seeking through trace file.");
+    vktraceviewer_trace_file_packet_offsets offsets;
+    while (fileOffset + sizeof(vktrace_trace_packet_header) <= pFileLike->mFileLen) {
+        if (!vktrace_FileLike_SetCurrentPosition(pFileLike, fileOffset) ||
+            !vktrace_FileLike_ReadRaw(pFileLike, &offsets.header, sizeof(vktrace_trace_packet_header))) {
+            emit OutputMessage(VKTRACE_LOG_ERROR, "Error while reading trace file.");
             break;
         }
-
-        if (ferror(pTraceFileInfo->pFile) != 0) {
-            emit OutputMessage(VKTRACE_LOG_ERROR, "Error while reading trace file.");
+        if (offsets.header.size < sizeof(vktrace_trace_packet_header) || fileOffset + offsets.header.size > pFileLike->mFileLen) {
+            emit OutputMessage(VKTRACE_LOG_WARNING, "The last packet in the trace file is incomplete.");
             break;
         }
+
+        // Packets read later may refer to blobs, so their payloads go into the store now
+        if (offsets.header.packet_id == VKTRACE_TPI_BLOB) {
+            vktrace_trace_packet_header* pBlobPacket = (vktrace_trace_packet_header*)vktrace_malloc((size_t)offsets.header.size);
+            if (pBlobPacket != NULL) {
+                *pBlobPacket = offsets.header;
+                if (vktrace_FileLike_ReadRaw(pFileLike, pBlobPacket + 1, (size_t)(offsets.header.size - sizeof(*pBlobPacket)))) {
+                    pBlobPacket->pBody = (uintptr_t)(pBlobPacket + 1);
+                    vktrace_blob_store_add_packet(pBlobPacket);
+                }
+                vktrace_free(pBlobPacket);
+            }
+        }
+
+        // success!
+        offsets.fileOffset = fileOffset;
+        offsets.header.pBody = 0;
+        packetOffsets.push_back(offsets);
+        fileOffset += offsets.header.size;
+    }
+
+    // If the last packet is the portability table, remove it
+    if (!packetOffsets.empty() && packetOffsets.back().header.packet_id == VKTRACE_TPI_PORTABILITY_TABLE) {
+        packetOffsets.pop_back();
     }
 
+    pTraceFileInfo->packetCount = packetOffsets.size();
     if (pTraceFileInfo->packetCount == 0) {
-        if (ferror(pTraceFileInfo->pFile) != 0) {
-            perror("File Read error:");
-            emit OutputMessage(VKTRACE_LOG_ERROR, "There was an error reading the trace file.");
-            return false;
-        } else if (feof(pTraceFileInfo->pFile) != 0) {
-            emit OutputMessage(VKTRACE_LOG_WARNING, "Reached the end of the file.");
-        }
         emit OutputMessage(VKTRACE_LOG_WARNING, "There are no trace packets in this trace file.");
         pTraceFileInfo->pPacketOffsets = NULL;
     } else {
         pTraceFileInfo->pPacketOffsets = VKTRACE_NEW_ARRAY(vktraceviewer_trace_file_packet_offsets, pTraceFileInfo->packetCount);
-
-        // rewind to first packet and this time, populate the packet offsets
-        if (fseek(pTraceFileInfo->pFile, first_offset, SEEK_SET) != 0) {
-            vktrace_free(pTraceFileInfo->pHeader);
-            emit OutputMessage(VKTRACE_LOG_ERROR, "Unable to rewind trace file to gather packet offsets.");
-            return false;
-        }
-
-        unsigned int packetIndex = 0;
-        fileOffset = first_offset;
-        while (1 == fread(&packetSize, sizeof(uint64_t), 1, pTraceFileInfo->pFile)) {
-            // the fread confirms that this packet exists
-            // NOTE: We do not actually read the entire packet into memory right now.
-            pTraceFileInfo->pPacketOffsets[packetIndex].fileOffset = fileOffset;
-
-            // rewind slightly
-            seekResult = fseek(pTraceFileInfo->pFile, -1 * (long)sizeof(uint64_t), SEEK_CUR);
-
-            if (seekResult != 0) {
-                emit OutputMessage(VKTRACE_LOG_ERROR, "Error while seeking between packets.");
-                break;
-            }
-
-            // allocate space for the packet and read it in
-            pTraceFileInfo->pPacketOffsets[packetIndex].pHeader = (vktrace_trace_packet_header*)vktrace_malloc(packetSize);
-            if (1 != fread(pTraceFileInfo->pPacketOffsets[packetIndex].pHeader, packetSize, 1, pTraceFileInfo->pFile)) {
-                vktrace_free(pTraceFileInfo->pHeader);
-                emit OutputMessage(VKTRACE_LOG_ERROR, "Unable to read in a trace packet.");
-                return false;
-            }
-
-            // adjust pointer to body of the packet
-            pTraceFileInfo->pPacketOffsets[packetIndex].pHeader->pBody =
-                (uintptr_t)pTraceFileInfo->pPacketOffsets[packetIndex].pHeader + sizeof(vktrace_trace_packet_header);
-
-            // now seek to what should be the next packet
-            fileOffset += packetSize;
-            packetIndex++;
-        }
-
-        // If the last packet is the portability table, remove it
-        if (pTraceFileInfo->pPacketOffsets[pTraceFileInfo->packetCount - 1].pHeader->packet_id == VKTRACE_TPI_PORTABILITY_TABLE) {
-            vktrace_free(pTraceFileInfo->pPacketOffsets[pTraceFileInfo->packetCount - 1].pHeader);
-            pTraceFileInfo->packetCount--;
-        }
-
-        if (fseek(pTraceFileInfo->pFile, first_offset, SEEK_SET) != 0) {
-            vktrace_free(pTraceFileInfo->pHeader);
-            emit OutputMessage(VKTRACE_LOG_ERROR, "Unable to rewind trace file to restore position.");
-            return false;
-        }
+        memcpy(pTraceFileInfo->pPacketOffsets, packetOffsets.data(),
+               pTraceFileInfo->packetCount * sizeof(vktraceviewer_trace_file_packet_offsets));
     }
 
+    vktrace_FileLike_destroy(&pFileLike);
     return true;
 }
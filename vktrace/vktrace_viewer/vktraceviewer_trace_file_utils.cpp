@@ -19,8 +19,36 @@
  * Author: Peter Lohrmann <peterl@valvesoftware.com> <plohrmann@gmail.com>
  **************************************************************************/
 #include "vktraceviewer_trace_file_utils.h"
+#include "vktraceviewer_controller.h"
 #include "vktrace_memory.h"
 
+#include <list>
+#include <unordered_map>
+
+extern "C" {
+#include "vktrace_filelike.h"
+#include "vktrace_trace_packet_utils.h"
+}
+
+struct vktraceviewer_trace_file_packet_reader {
+    FILE* pFile;
+    FileLike* pFileLike;
+    vktraceviewer_QController* pController;
+};
+
+struct vktraceviewer_trace_file_packet_cache {
+    vktraceviewer_trace_file_packet_reader* pReader;
+
+    // Indices of the cached packets, the most recently used first
+    std::list<uint64_t> recentlyUsed;
+    struct CachedPacket {
+        vktrace_trace_packet_header* pHeader;
+        std::list<uint64_t>::iterator recentlyUsedPosition;
+    };
+    std::unordered_map<uint64_t, CachedPacket> packets;
+    uint64_t cachedSize;
+};
+
 BOOL vktraceviewer_populate_trace_file_info(vktraceviewer_trace_file_info* pTraceFileInfo) {
     vktrace_trace_file_header header;
 
@@ -101,28 +129,16 @@ BOOL vktraceviewer_populate_trace_file_info(vktraceviewer_trace_file_info* pTrac
 
         unsigned int packetIndex = 0;
         fileOffset = first_offset;
-        while (1 == fread(&packetSize, sizeof(uint64_t), 1, pTraceFileInfo->pFile)) {
-            // the fread confirms that this packet exists
-            // NOTE: We do not actually read the entire packet into memory right now.
+        while (packetIndex < pTraceFileInfo->packetCount &&
+               1 == fread(&pTraceFileInfo->pPacketOffsets[packetIndex].header, sizeof(vktrace_trace_packet_header), 1,
+                          pTraceFileInfo->pFile)) {
+            // Only the header is read now, the packet is read when it is needed
             pTraceFileInfo->pPacketOffsets[packetIndex].fileOffset = fileOffset;
-
-            // rewind slightly
-            Fseek(pTraceFileInfo->pFile, -1 * (long)sizeof(uint64_t), SEEK_CUR);
-
-            // allocate space for the packet and read it in
-            pTraceFileInfo->pPacketOffsets[packetIndex].pHeader = (vktrace_trace_packet_header*)vktrace_malloc(packetSize);
-            if (1 != fread(pTraceFileInfo->pPacketOffsets[packetIndex].pHeader, packetSize, 1, pTraceFileInfo->pFile)) {
-                vktraceviewer_output_error("Unable to read in a trace packet.");
-                vktrace_free(pTraceFileInfo->pHeader);
-                return FALSE;
-            }
-
-            // adjust pointer to body of the packet
-            pTraceFileInfo->pPacketOffsets[packetIndex].pHeader->pBody =
-                (uintptr_t)pTraceFileInfo->pPacketOffsets[packetIndex].pHeader + sizeof(vktrace_trace_packet_header);
+            pTraceFileInfo->pPacketOffsets[packetIndex].header.pBody = 0;
 
             // now seek to what should be the next packet
-            fileOffset += packetSize;
+            fileOffset += pTraceFileInfo->pPacketOffsets[packetIndex].header.size;
+            Fseek(pTraceFileInfo->pFile, fileOffset, SEEK_SET);
             packetIndex++;
         }
 
@@ -135,3 +151,174 @@ BOOL vktraceviewer_populate_trace_file_info(vktraceviewer_trace_file_info* pTrac
 
     return TRUE;
 }
+
+//-----------------------------------------------------------------------------
+vktraceviewer_trace_file_packet_reader* vktraceviewer_open_packet_reader(vktraceviewer_trace_file_info* pTraceFileInfo,
+                                                                         vktraceviewer_QController* pController) {
+    FILE* pFile = fopen(pTraceFileInfo->filename, "rb");
+    if (pFile == NULL) {
+        return NULL;
+    }
+    FileLike* pFileLike = vktrace_FileLike_create_file(pFile);
+    if (pFileLike == NULL || !vktrace_FileLike_EnableDecompression(pFileLike, pTraceFileInfo->pHeader)) {
+        vktrace_FileLike_destroy(&pFileLike);
+        fclose(pFile);
+        return NULL;
+    }
+
+    vktraceviewer_trace_file_packet_reader* pReader = new vktraceviewer_trace_file_packet_reader();
+    pReader->pFile = pFile;
+    pReader->pFileLike = pFileLike;
+    pReader->pController = pController;
+    return pReader;
+}
+
+//-----------------------------------------------------------------------------
+void vktraceviewer_close_packet_reader(vktraceviewer_trace_file_packet_reader* pReader) {
+    if (pReader == NULL) {
+        return;
+    }
+    vktrace_FileLike_destroy(&pReader->pFileLike);
+    fclose(pReader->pFile);
+    delete pReader;
+}
+
+//-----------------------------------------------------------------------------
+BOOL vktraceviewer_open_packet_cache(vktraceviewer_trace_file_info* pTraceFileInfo, vktraceviewer_QController* pController) {
+    assert(pTraceFileInfo->pPacketCache == NULL);
+    vktraceviewer_trace_file_packet_reader* pReader = vktraceviewer_open_packet_reader(pTraceFileInfo, pController);
+    if (pReader == NULL) {
+        vktraceviewer_output_error("Unable to open the trace file again to read packets from.");
+        return FALSE;
+    }
+
+    vktraceviewer_trace_file_packet_cache* pCache = new vktraceviewer_trace_file_packet_cache();
+    pCache->pReader = pReader;
+    pCache->cachedSize = 0;
+    pTraceFileInfo->pPacketCache = pCache;
+    return TRUE;
+}
+
+//-----------------------------------------------------------------------------
+void vktraceviewer_close_packet_cache(vktraceviewer_trace_file_info* pTraceFileInfo) {
+    vktraceviewer_trace_file_packet_cache* pCache = pTraceFileInfo->pPacketCache;
+    if (pCache == NULL) {
+        return;
+    }
+    for (auto it = pCache->packets.begin(); it != pCache->packets.end(); ++it) {
+        vktrace_free(it->second.pHeader);
+    }
+    vktraceviewer_close_packet_reader(pCache->pReader);
+    delete pCache;
+    pTraceFileInfo->pPacketCache = NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Returns NULL and sets error if the packet can't be read or interpreted
+static vktrace_trace_packet_header* read_trace_packet(vktraceviewer_trace_file_packet_reader* pReader,
+                                                      const vktraceviewer_trace_file_info* pTraceFileInfo, uint64_t packetIndex,
+                                                      QString& error) {
+    const vktraceviewer_trace_file_packet_offsets* pOffsets = &pTraceFileInfo->pPacketOffsets[packetIndex];
+    vktrace_trace_packet_header* pHeader = (vktrace_trace_packet_header*)vktrace_malloc((size_t)pOffsets->header.size);
+    if (pHeader == NULL) {
+        error = "Unable to allocate memory for a trace packet.";
+        return NULL;
+    }
+    if (!vktrace_FileLike_SetCurrentPosition(pReader->pFileLike, (size_t)pOffsets->fileOffset) ||
+        !vktrace_FileLike_ReadRaw(pReader->pFileLike, pHeader, (size_t)pOffsets->header.size)) {
+        vktrace_free(pHeader);
+        error = "Unable to read in a trace packet.";
+        return NULL;
+    }
+
+    // adjust pointer to body of the packet
+    pHeader->pBody = (uintptr_t)pHeader + sizeof(vktrace_trace_packet_header);
+
+    switch (pHeader->packet_id) {
+        case VKTRACE_TPI_MESSAGE:
+            vktrace_interpret_body_as_trace_packet_message(pHeader);
+            break;
+        case VKTRACE_TPI_MARKER_CHECKPOINT:
+        case VKTRACE_TPI_MARKER_API_BOUNDARY:
+        case VKTRACE_TPI_MARKER_API_GROUP_BEGIN:
+        case VKTRACE_TPI_MARKER_API_GROUP_END:
+        case VKTRACE_TPI_MARKER_TERMINATE_PROCESS:
+        case VKTRACE_TPI_PORTABILITY_TABLE:
+        case VKTRACE_TPI_BLOB:
+            break;
+        default: {
+            vktrace_trace_packet_header* pInterpretedHeader =
+                pReader->pController != NULL ? pReader->pController->InterpretTracePacket(pHeader) : NULL;
+            if (pInterpretedHeader == NULL) {
+                error = QString("Unrecognized packet type: %1").arg(pHeader->packet_id);
+                vktrace_free(pHeader);
+                return NULL;
+            }
+            pHeader = pInterpretedHeader;
+        }
+    }
+    return pHeader;
+}
+
+//-----------------------------------------------------------------------------
+vktrace_trace_packet_header* vktraceviewer_read_trace_packet(vktraceviewer_trace_file_info* pTraceFileInfo, uint64_t packetIndex) {
+    vktraceviewer_trace_file_packet_cache* pCache = pTraceFileInfo->pPacketCache;
+    if (pCache == NULL || packetIndex >= pTraceFileInfo->packetCount) {
+        return NULL;
+    }
+
+    QString error;
+    vktrace_trace_packet_header* pHeader = read_trace_packet(pCache->pReader, pTraceFileInfo, packetIndex, error);
+    if (pHeader == NULL) {
+        vktraceviewer_output_error(packetIndex, error);
+    }
+    return pHeader;
+}
+
+//-----------------------------------------------------------------------------
+vktrace_trace_packet_header* vktraceviewer_read_trace_packet(vktraceviewer_trace_file_packet_reader* pReader,
+                                                             const vktraceviewer_trace_file_info* pTraceFileInfo,
+                                                             uint64_t packetIndex) {
+    if (packetIndex >= pTraceFileInfo->packetCount) {
+        return NULL;
+    }
+
+    QString error;
+    return read_trace_packet(pReader, pTraceFileInfo, packetIndex, error);
+}
+
+//-----------------------------------------------------------------------------
+vktrace_trace_packet_header* vktraceviewer_get_trace_packet(vktraceviewer_trace_file_info* pTraceFileInfo, uint64_t packetIndex) {
+    vktraceviewer_trace_file_packet_cache* pCache = pTraceFileInfo->pPacketCache;
+    if (pCache == NULL) {
+        return NULL;
+    }
+
+    auto found = pCache->packets.find(packetIndex);
+    if (found != pCache->packets.end()) {
+        pCache->recentlyUsed.splice(pCache->recentlyUsed.begin(), pCache->recentlyUsed, found->second.recentlyUsedPosition);
+        return found->second.pHeader;
+    }
+
+    vktrace_trace_packet_header* pHeader = vktraceviewer_read_trace_packet(pTraceFileInfo, packetIndex);
+    if (pHeader == NULL) {
+        return NULL;
+    }
+
+    // Make room, but keep at least the packet being returned even if it is larger than the cache
+    uint64_t size = pTraceFileInfo->pPacketOffsets[packetIndex].header.size;
+    while (!pCache->recentlyUsed.empty() && pCache->cachedSize + size > VKTRACEVIEWER_PACKET_CACHE_SIZE) {
+        auto evicted = pCache->packets.find(pCache->recentlyUsed.back());
+        pCache->cachedSize -= pTraceFileInfo->pPacketOffsets[evicted->first].header.size;
+        vktrace_free(evicted->second.pHeader);
+        pCache->packets.erase(evicted);
+        pCache->recentlyUsed.pop_back();
+    }
+
+    pCache->recentlyUsed.push_front(packetIndex);
+    vktraceviewer_trace_file_packet_cache::CachedPacket& cached = pCache->packets[packetIndex];
+    cached.pHeader = pHeader;
+    cached.recentlyUsedPosition = pCache->recentlyUsed.begin();
+    pCache->cachedSize += size;
+    return pHeader;
+}
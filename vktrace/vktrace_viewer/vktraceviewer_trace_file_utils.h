@@ -29,12 +29,25 @@ extern "C" {
 }
 #include "vktraceviewer_output.h"
 
+// Packets of API calls are interpreted by the controller of the tracer that recorded them
+class vktraceviewer_QController;
+
+// Packets read from the trace file on demand, see vktraceviewer_get_trace_packet
+struct vktraceviewer_trace_file_packet_cache;
+
+// Reads packets from a trace file handle of its own, see vktraceviewer_open_packet_reader
+struct vktraceviewer_trace_file_packet_reader;
+
+// Decoded packets are kept up to this many bytes in total, dropping the least recently used first
+#define VKTRACEVIEWER_PACKET_CACHE_SIZE (64 * 1024 * 1024)
+
 struct vktraceviewer_trace_file_packet_offsets {
     // the file offset to this particular packet
-    unsigned int fileOffset;
+    uint64_t fileOffset;
 
-    // Pointer to the packet header if it's been read from disk
-    vktrace_trace_packet_header* pHeader;
+    // The header of the packet, read when the file is opened. Its pBody is not valid, the whole
+    // packet comes from vktraceviewer_get_trace_packet.
+    vktrace_trace_packet_header header;
 };
 
 struct vktraceviewer_trace_file_info {
@@ -53,8 +66,37 @@ struct vktraceviewer_trace_file_info {
 
     // array of packet offsets
     vktraceviewer_trace_file_packet_offsets* pPacketOffsets;
+
+    // NULL until vktraceviewer_open_packet_cache
+    vktraceviewer_trace_file_packet_cache* pPacketCache;
 };
 
 BOOL vktraceviewer_populate_trace_file_info(vktraceviewer_trace_file_info* pTraceFileInfo);
 
+// Opens the trace file again to read packets from once the packet offsets are populated.
+// pController may be NULL, in which case only packets that aren't API calls can be decoded.
+BOOL vktraceviewer_open_packet_cache(vktraceviewer_trace_file_info* pTraceFileInfo, vktraceviewer_QController* pController);
+void vktraceviewer_close_packet_cache(vktraceviewer_trace_file_info* pTraceFileInfo);
+
+// Returns the interpreted packet at packetIndex, reading it from the trace file unless it is cached.
+// The packet belongs to the cache and stays valid until the next call. Returns NULL if the packet
+// couldn't be read or interpreted.
+vktrace_trace_packet_header* vktraceviewer_get_trace_packet(vktraceviewer_trace_file_info* pTraceFileInfo, uint64_t packetIndex);
+
+// Same as vktraceviewer_get_trace_packet, but the packet isn't added to the cache and the caller
+// frees it with vktrace_free. For walking through the whole trace without flushing the cache.
+vktrace_trace_packet_header* vktraceviewer_read_trace_packet(vktraceviewer_trace_file_info* pTraceFileInfo, uint64_t packetIndex);
+
+// Opens the trace file again for a thread other than the UI thread to read packets from, since
+// the packet cache may only be used by the UI thread. Returns NULL if the file can't be opened.
+vktraceviewer_trace_file_packet_reader* vktraceviewer_open_packet_reader(vktraceviewer_trace_file_info* pTraceFileInfo,
+                                                                         vktraceviewer_QController* pController);
+void vktraceviewer_close_packet_reader(vktraceviewer_trace_file_packet_reader* pReader);
+
+// Same as the above, but reading with pReader. Errors aren't reported, as that can only be done
+// on the UI thread.
+vktrace_trace_packet_header* vktraceviewer_read_trace_packet(vktraceviewer_trace_file_packet_reader* pReader,
+                                                             const vktraceviewer_trace_file_info* pTraceFileInfo,
+                                                             uint64_t packetIndex);
+
 #endif  // VKTRACEVIEWER_TRACE_FILE_UTILS_H_
@@ -50,7 +50,9 @@ vktraceviewer_vk_QController::vktraceviewer_vk_QController()
       m_pDrawStateDiagram(NULL),
       m_pCommandBuffersDiagram(NULL),
       m_pReplayWidget(NULL),
-      m_pTraceFileModel(NULL) {
+      m_pTraceFileModel(NULL),
+      m_pTraceFileIndexer(NULL),
+      m_pThumbnailGenerator(NULL) {
     s_pController = this;
     vktrace_LogSetCallback(controllerLoggingCallback);
     vktrace_LogSetLevel(VKTRACE_LOG_ERROR);
@@ -119,7 +121,19 @@ bool vktraceviewer_vk_QController::LoadTraceFile(vktraceviewer_trace_file_info*
 
     assert(m_pTraceFileModel == NULL);
     m_pTraceFileModel = new vktraceviewer_vk_QFileModel(NULL, pTraceFileInfo);
+    m_pTraceFileIndexer = new vktraceviewer_QTraceFileIndexer(pTraceFileInfo, m_pTraceFileModel, this);
+    m_pTraceFileModel->set_indexer(m_pTraceFileIndexer);
+    if (g_vkTraceViewerSettings.thumbnailScale > 1) {
+        assert(m_pThumbnailGenerator == NULL);
+        m_pThumbnailGenerator =
+            new vktraceviewer_QThumbnailGenerator(pTraceFileInfo->filename, g_vkTraceViewerSettings.thumbnailScale);
+        m_groupByFramesProxy.setThumbnailGenerator(m_pThumbnailGenerator);
+    }
     updateCallTreeBasedOnSettings();
+    m_pTraceFileIndexer->start();
+    if (m_pThumbnailGenerator != NULL) {
+        m_pThumbnailGenerator->start();
+    }
 
     deleteStateDumps();
 
@@ -289,6 +303,18 @@ void vktraceviewer_vk_QController::UnloadTraceFile(void) {
         m_pView = NULL;
     }
 
+    // The proxies are grouped by the indexer, and the indexer's threads use the model
+    m_groupByFramesProxy.setSourceModel(NULL);
+    m_groupByFramesProxy.setThumbnailGenerator(NULL);
+    if (m_pThumbnailGenerator != NULL) {
+        delete m_pThumbnailGenerator;
+        m_pThumbnailGenerator = NULL;
+    }
+    if (m_pTraceFileIndexer != NULL) {
+        delete m_pTraceFileIndexer;
+        m_pTraceFileIndexer = NULL;
+    }
+
     if (m_pTraceFileModel != NULL) {
         delete m_pTraceFileModel;
         m_pTraceFileModel = NULL;
@@ -25,6 +25,8 @@
 #include "vktraceviewer_QReplayWidget.h"
 #include "vktraceviewer_QReplayWorker.h"
 #include "vktraceviewer_vk_qfile_model.h"
+#include "vktraceviewer_qtracefileindexer.h"
+#include "vktraceviewer_qthumbnailgenerator.h"
 #include "vktraceviewer_controller.h"
 #include <QLabel>
 #include <QScrollArea>
@@ -73,6 +75,8 @@ class vktraceviewer_vk_QController : public vktraceviewer_QController {
     vktraceviewer_qsvgviewer* m_pCommandBuffersDiagram;
     vktraceviewer_QReplayWidget* m_pReplayWidget;
     vktraceviewer_vk_QFileModel* m_pTraceFileModel;
+    vktraceviewer_QTraceFileIndexer* m_pTraceFileIndexer;
+    vktraceviewer_QThumbnailGenerator* m_pThumbnailGenerator;
     vktraceviewer_vk_QGroupFramesProxyModel m_groupByFramesProxy;
     vktraceviewer_QGroupThreadsProxyModel m_groupByThreadsProxy;
 
@@ -19,36 +19,60 @@
  **************************************************************************/
 #include "vktraceviewer_vk_qgroupframesproxymodel.h"
 
-extern "C" {
-#include "vktrace_vk_packet_id.h"
-}
+#include <algorithm>
 
 void vktraceviewer_vk_QGroupFramesProxyModel::buildGroups() {
+    beginResetModel();
     m_mapSourceRowToProxyGroupRow.clear();
+    m_mapSourceRowToFrameIndex.clear();
     m_frameList.clear();
     m_curFrameCount = 0;
 
     if (sourceModel() != NULL) {
-        FrameInfo* pCurFrame = addNewFrame();
-        m_mapSourceRowToProxyGroupRow.reserve(sourceModel()->rowCount());
-        for (int srcRow = 0; srcRow < sourceModel()->rowCount(); srcRow++) {
-            int proxyRow = pCurFrame->mapChildRowToSourceRow.count();
+        addNewFrame();
+        if (m_pIndexer != NULL) {
+            m_mapSourceRowToProxyGroupRow.reserve(sourceModel()->rowCount());
+            m_mapSourceRowToFrameIndex.reserve(sourceModel()->rowCount());
+            appendSourceRows(0, m_pIndexer->indexedRowCount(), false);
+        }
+    }
+    endResetModel();
+}
 
-            // map source row to it's corresponding row in the proxy group.
-            m_mapSourceRowToProxyGroupRow.append(proxyRow);
+void vktraceviewer_vk_QGroupFramesProxyModel::appendSourceRows(int beginRow, int endRow, bool bNotify) {
+    // A new frame starts after each vkQueuePresentKHR
+    const std::vector<int>& frameEndRows = m_pIndexer->frameEndRows();
+    std::vector<int>::const_iterator frameEnd = std::lower_bound(frameEndRows.begin(), frameEndRows.end(), beginRow);
 
-            // add this src row to the current proxy group.
+    int srcRow = beginRow;
+    while (srcRow < endRow) {
+        // add the rows up to the end of the current frame to it
+        bool bFrameEnds = (frameEnd != frameEndRows.end() && *frameEnd < endRow);
+        int lastRow = bFrameEnds ? *frameEnd : endRow - 1;
+        FrameInfo *pCurFrame = &m_frameList[m_curFrameCount - 1];
+        int firstProxyRow = pCurFrame->mapChildRowToSourceRow.count();
+        if (bNotify) {
+            beginInsertRows(pCurFrame->modelIndex, firstProxyRow, firstProxyRow + lastRow - srcRow);
+        }
+        for (; srcRow <= lastRow; srcRow++) {
+            // map source row to it's corresponding row in the proxy group.
+            m_mapSourceRowToProxyGroupRow.append(pCurFrame->mapChildRowToSourceRow.count());
+            m_mapSourceRowToFrameIndex.append(pCurFrame->frameIndex);
             pCurFrame->mapChildRowToSourceRow.append(srcRow);
+        }
+        if (bNotify) {
+            endInsertRows();
+        }
 
-            // Should a new frame be started based on the API call in the previous row?
-            // If source data is a frame boundary make a new frame
-            QModelIndex tmpIndex = sourceModel()->index(srcRow, 0);
-            assert(tmpIndex.isValid());
-            vktrace_trace_packet_header* pHeader = (vktrace_trace_packet_header*)tmpIndex.internalPointer();
-            if (pHeader != NULL && pHeader->tracer_id == VKTRACE_TID_VULKAN &&
-                pHeader->packet_id == VKTRACE_TPI_VK_vkQueuePresentKHR) {
-                pCurFrame = addNewFrame();
+        if (bFrameEnds) {
+            if (bNotify) {
+                beginInsertRows(QModelIndex(), m_curFrameCount, m_curFrameCount);
+            }
+            addNewFrame();
+            if (bNotify) {
+                endInsertRows();
             }
-        }  // end for each source row
+            ++frameEnd;
+        }
     }
 }
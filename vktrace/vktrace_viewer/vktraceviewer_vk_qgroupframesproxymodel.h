@@ -22,6 +22,8 @@
 #define VKTRACEVIEWER_VK_QGROUPFRAMESPROXYMODEL_H
 
 #include "vktraceviewer_QTraceFileModel.h"
+#include "vktraceviewer_qtracefileindexer.h"
+#include "vktraceviewer_qthumbnailgenerator.h"
 #include <QAbstractProxyModel>
 #include <QStandardItem>
 
@@ -36,7 +38,8 @@ struct FrameInfo {
 class vktraceviewer_vk_QGroupFramesProxyModel : public QAbstractProxyModel {
     Q_OBJECT
    public:
-    vktraceviewer_vk_QGroupFramesProxyModel(QObject *parent = 0) : QAbstractProxyModel(parent), m_curFrameCount(0) {
+    vktraceviewer_vk_QGroupFramesProxyModel(QObject *parent = 0)
+        : QAbstractProxyModel(parent), m_curFrameCount(0), m_pIndexer(NULL), m_pThumbnails(NULL) {
         buildGroups();
     }
 
@@ -49,10 +52,31 @@ class vktraceviewer_vk_QGroupFramesProxyModel : public QAbstractProxyModel {
             sourceModel = NULL;
         }
 
+        // The frames are grouped by the indexer of the source model as it gets to them
+        if (m_pIndexer != NULL) {
+            disconnect(m_pIndexer, SIGNAL(PacketsIndexed(int, int)), this, SLOT(onPacketsIndexed(int, int)));
+        }
+        m_pIndexer = (sourceModel != NULL) ? ((vktraceviewer_QTraceFileModel *)sourceModel)->get_indexer() : NULL;
+        if (m_pIndexer != NULL) {
+            connect(m_pIndexer, SIGNAL(PacketsIndexed(int, int)), this, SLOT(onPacketsIndexed(int, int)));
+        }
+
         QAbstractProxyModel::setSourceModel(sourceModel);
         buildGroups();
     }
 
+    //---------------------------------------------------------------------------------------------
+    // Frames show their thumbnail from the generator once it has one, NULL to show none
+    void setThumbnailGenerator(vktraceviewer_QThumbnailGenerator *pThumbnails) {
+        if (m_pThumbnails != NULL) {
+            disconnect(m_pThumbnails, SIGNAL(ThumbnailsLoaded(int, int)), this, SLOT(onThumbnailsLoaded(int, int)));
+        }
+        m_pThumbnails = pThumbnails;
+        if (m_pThumbnails != NULL) {
+            connect(m_pThumbnails, SIGNAL(ThumbnailsLoaded(int, int)), this, SLOT(onThumbnailsLoaded(int, int)));
+        }
+    }
+
     //---------------------------------------------------------------------------------------------
     virtual int rowCount(const QModelIndex &parent) const {
         if (!parent.isValid()) {
@@ -95,6 +119,11 @@ class vktraceviewer_vk_QGroupFramesProxyModel : public QAbstractProxyModel {
             } else {
                 return QVariant(QString(""));
             }
+        } else if (role == Qt::DecorationRole && index.column() == 0 && m_pThumbnails != NULL) {
+            QPixmap thumbnail = m_pThumbnails->thumbnail(m_frameList[index.row()].frameIndex);
+            if (!thumbnail.isNull()) {
+                return QVariant(thumbnail);
+            }
         }
 
         return QVariant();
@@ -183,20 +212,13 @@ class vktraceviewer_vk_QGroupFramesProxyModel : public QAbstractProxyModel {
         if (!sourceIndex.isValid()) return QModelIndex();
 
         int srcRow = sourceIndex.row();
-        int proxyRow = m_mapSourceRowToProxyGroupRow[srcRow];
-
-        // figure out which frame has the srcRow as a child
-        const FrameInfo *pProxyGroup = NULL;
-        QListIterator<FrameInfo> frameIter(m_frameList);
-        while (frameIter.hasNext()) {
-            const FrameInfo *pFrame = &frameIter.next();
-            if (pFrame->mapChildRowToSourceRow.contains(srcRow)) {
-                pProxyGroup = pFrame;
-                break;
-            }
+        if (srcRow >= m_mapSourceRowToProxyGroupRow.count()) {
+            // the row hasn't been grouped into a frame yet
+            return QModelIndex();
         }
 
-        return createIndex(proxyRow, sourceIndex.column(), pProxyGroup->frameIndex);
+        int proxyRow = m_mapSourceRowToProxyGroupRow[srcRow];
+        return createIndex(proxyRow, sourceIndex.column(), m_mapSourceRowToFrameIndex[srcRow]);
     }
 
     //---------------------------------------------------------------------------------------------
@@ -210,11 +232,26 @@ class vktraceviewer_vk_QGroupFramesProxyModel : public QAbstractProxyModel {
         return results;
     }
 
+    //---------------------------------------------------------------------------------------------
+   private slots:
+    void onPacketsIndexed(int firstRow, int rowCount) { appendSourceRows(firstRow, firstRow + rowCount, true); }
+
+    void onThumbnailsLoaded(int firstFrame, int count) {
+        // Frames that haven't been grouped yet show their thumbnails when they are
+        int lastFrame = qMin(firstFrame + count, m_frameList.count()) - 1;
+        if (firstFrame <= lastFrame) {
+            emit dataChanged(index(firstFrame, 0), index(lastFrame, 0), QVector<int>() << Qt::DecorationRole);
+        }
+    }
+
     //---------------------------------------------------------------------------------------------
    private:
     QList<FrameInfo> m_frameList;
     QList<int> m_mapSourceRowToProxyGroupRow;
+    QList<int> m_mapSourceRowToFrameIndex;
     int m_curFrameCount;
+    vktraceviewer_QTraceFileIndexer *m_pIndexer;
+    vktraceviewer_QThumbnailGenerator *m_pThumbnails;
 
     //---------------------------------------------------------------------------------------------
     bool isFrame(const QModelIndex &proxyIndex) const {
@@ -254,6 +291,7 @@ class vktraceviewer_vk_QGroupFramesProxyModel : public QAbstractProxyModel {
 
     //---------------------------------------------------------------------------------------------
     void buildGroups();
+    void appendSourceRows(int beginRow, int endRow, bool bNotify);
 };
 
 #endif  // VKTRACEVIEWER_VK_QGROUPFRAMESPROXYMODEL_H
@@ -46,6 +46,9 @@ vktrace_SettingInfo g_vk_settings[] = {
      &s_defaultVkSettings.replay_window_width, TRUE, "Width of replay window on startup."},
     {"rh", "ReplayWindowHeight", VKTRACE_SETTING_INT, &g_vkTraceViewerSettings.replay_window_height,
      &s_defaultVkSettings.replay_window_height, TRUE, "Height of replay window on startup."},
+    {"ts", "ThumbnailScale", VKTRACE_SETTING_INT, &g_vkTraceViewerSettings.thumbnailScale, &s_defaultVkSettings.thumbnailScale,
+     TRUE, "Show a thumbnail of each frame, made by replaying the trace in the background, downsampled by this factor. 0 to "
+           "disable."},
 };
 
 vktrace_SettingGroup g_vkTraceViewerSettingGroup = {"vktraceviewer_vk", sizeof(g_vk_settings) / sizeof(g_vk_settings[0]),
@@ -63,4 +66,5 @@ void initialize_default_settings() {
     s_defaultVkSettings.replay_window_width = 100;
     s_defaultVkSettings.replay_window_height = 100;
     s_defaultVkSettings.separate_replay_window = TRUE;
+    s_defaultVkSettings.thumbnailScale = 8;
 };
@@ -37,6 +37,7 @@ typedef struct vktraceviewer_vk_settings {
     int replay_window_width;
     int replay_window_height;
     BOOL separate_replay_window;
+    int thumbnailScale;
 } vktraceviewer_vk_settings;
 
 extern vktraceviewer_vk_settings g_vkTraceViewerSettings;